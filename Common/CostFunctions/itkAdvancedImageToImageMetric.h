@@ -24,19 +24,34 @@
 #include "itkGradientImageFilter.h"
 #include "itkBSplineInterpolateImageFunction.h"
 #include "itkReducedDimensionBSplineInterpolateImageFunction.h"
+#include "itkAdvancedBSplineInterpolateImageFunction.h"
 #include "itkAdvancedLinearInterpolateImageFunction.h"
+#include "itkAdvancedRayCastInterpolateImageFunction.h"
 #include "itkLimiterFunctionBase.h"
+#include "itkMultipleValuesCostFunctionInterface.h"
 #include "itkFixedArray.h"
 #include "itkAdvancedTransform.h"
 #include "vnl/vnl_sparse_matrix.h"
 
 #include "itkImageMaskSpatialObject.h"
+#include "itkImageMaskBitmap.h"
 
 // Needed for checking for B-spline for faster implementation
 #include "itkAdvancedBSplineDeformableTransform.h"
 #include "itkAdvancedCombinationTransform.h"
+#include "itkAdvancedMatrixOffsetTransformBase.h"
+#include "itkRecursiveBSplineTransform.h"
 
 #include "itkPlatformMultiThreader.h"
+#include "itkPersistentThreadPool.h"
+#include "itkReusableBufferPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace itk
 {
@@ -66,6 +81,12 @@ namespace itk
  *   unless you have a good reason for it...
  * \li Some convenience functions are provided, such as the IsInsideMovingMask
  *   and CheckNumberOfSamples.
+ * \li Metrics that implement GetValueWithTransform() and
+ *   GetValueAndDerivativeWithTransform() can be evaluated at parameters without
+ *   modifying the metric or its transform, using a copy of the CurrentTransform
+ *   with these parameters. This allows GetValues() and GetValuesAndDerivatives()
+ *   to evaluate several parameter vectors concurrently, and several threads to
+ *   call GetValueWithoutSideEffects() on one metric at the same time.
  *
  * The parameters used in this class are:
  * \parameter MovingImageDerivativeScales: scale the moving image derivatives. Use\n
@@ -79,7 +100,8 @@ namespace itk
 
 template< class TFixedImage, class TMovingImage >
 class AdvancedImageToImageMetric :
-  public ImageToImageMetric< TFixedImage, TMovingImage >
+  public ImageToImageMetric< TFixedImage, TMovingImage >,
+  public MultipleValuesCostFunctionInterface
 {
 public:
 
@@ -133,6 +155,7 @@ public:
 
   typedef ImageMaskSpatialObject< itkGetStaticConstMacro( FixedImageDimension ) > FixedImageMaskSpatialObject2Type;
   typedef ImageMaskSpatialObject< itkGetStaticConstMacro( MovingImageDimension ) > MovingImageMaskSpatialObject2Type;
+  typedef ImageMaskBitmap< itkGetStaticConstMacro( MovingImageDimension ) >        MovingImageMaskBitmapType;
 
   /** Some useful extra typedefs. */
   typedef typename FixedImageType::PixelType               FixedImagePixelType;
@@ -144,6 +167,8 @@ public:
   typedef typename ImageSamplerType::Pointer                      ImageSamplerPointer;
   typedef typename ImageSamplerType::OutputVectorContainerType    ImageSampleContainerType;
   typedef typename ImageSamplerType::OutputVectorContainerPointer ImageSampleContainerPointer;
+  typedef typename ImageSamplerType::ImplicitSampleContainerType  ImplicitSampleContainerType;
+  typedef typename ImageSamplerType::ImageSampleType              ImageSampleType;
 
   /** Typedefs for Limiter support. */
   typedef LimiterFunctionBase< RealType, FixedImageDimension >  FixedImageLimiterType;
@@ -158,6 +183,7 @@ public:
   typedef AdvancedTransform<
     ScalarType, FixedImageDimension, MovingImageDimension >      AdvancedTransformType;
   typedef typename AdvancedTransformType::NumberOfParametersType NumberOfParametersType;
+  typedef typename AdvancedTransformType::Pointer                AdvancedTransformPointer;
 
   /** Typedef's for the B-spline transform. */
   typedef AdvancedCombinationTransform< ScalarType, FixedImageDimension >          CombinationTransformType;
@@ -168,6 +194,16 @@ public:
   typedef typename BSplineOrder2TransformType::Pointer                             BSplineOrder2TransformPointer;
   typedef typename BSplineOrder3TransformType::Pointer                             BSplineOrder3TransformPointer;
 
+  /** Typedef's for the transforms that have a fused kernel. */
+  typedef AdvancedMatrixOffsetTransformBase<
+    ScalarType, FixedImageDimension, MovingImageDimension >                  MatrixOffsetTransformType;
+  typedef RecursiveBSplineTransform< ScalarType, FixedImageDimension, 3 > RecursiveBSplineOrder3TransformType;
+
+  /** Typedefs for GetValues(). */
+  typedef MultipleValuesCostFunctionInterface::ParametersVectorType ParametersVectorType;
+  typedef MultipleValuesCostFunctionInterface::MeasureVectorType    MeasureVectorType;
+  typedef MultipleValuesCostFunctionInterface::DerivativeVectorType DerivativeVectorType;
+
   /** Hessian type; for SelfHessian (experimental feature) */
   typedef typename DerivativeType::ValueType    HessianValueType;
   typedef vnl_sparse_matrix< HessianValueType > HessianType;
@@ -254,6 +290,44 @@ public:
   itkSetMacro( MovingImageDerivativeScales, MovingImageDerivativeScalesType );
   itkGetConstReferenceMacro( MovingImageDerivativeScales, MovingImageDerivativeScalesType );
 
+  /** Select whether the InitialTransform of an AdvancedCombinationTransform
+   * that uses composition is evaluated once at the samples, instead of every
+   * iteration. The cache is rebuilt when the sampler generates new samples or
+   * the InitialTransform is modified, so it pays off when the samples are
+   * reused over the iterations. Linear initial transforms are not cached,
+   * since they are cheaper to evaluate than to look up. The transform holds
+   * a single cache, so enable this for only one of the metrics that share a
+   * transform; default: false.
+   */
+  itkSetMacro( UseInitialTransformCache, bool );
+  itkGetConstMacro( UseInitialTransformCache, bool );
+
+  /** Select whether the current transform of an AdvancedCombinationTransform
+   * is asked to cache its parameter independent parts at the samples, see
+   * AdvancedTransform::CachePoints(). Only some transforms cache anything,
+   * such as the WeightedCombinationTransform, which caches its fixed
+   * sub-transforms. The cache is rebuilt when the sampler generates new
+   * samples or the cache was removed by the transform. As for the
+   * InitialTransform cache, enable this for only one of the metrics that
+   * share a transform; default: false.
+   */
+  itkSetMacro( UseTransformPointCache, bool );
+  itkGetConstMacro( UseTransformPointCache, bool );
+
+  /** Select whether the hot configurations are evaluated by fused kernels.
+   * Initialize() then checks whether the transform is an Euler, affine or
+   * other matrix-offset transform, or a third order (recursive) B-spline
+   * transform, in a combination transform without initial transform, and
+   * whether the interpolator is a linear or B-spline interpolator. The
+   * transform points, the Jacobians and the moving image values and
+   * derivatives of those are computed by non-virtual calls to the concrete
+   * classes, which the compiler inlines in the loops over the samples. Any
+   * other configuration takes the generic path. The results are the same;
+   * default: false.
+   */
+  itkSetMacro( UseFusedKernels, bool );
+  itkGetConstMacro( UseFusedKernels, bool );
+
   /** Initialize the Metric by making sure that all the components
    *  are present and plugged together correctly.
    * \li Call the superclass' implementation
@@ -269,9 +343,142 @@ public:
    */
   virtual void GetSelfHessian( const TransformParametersType & parameters, HessianType & H ) const;
 
-  /** Set number of threads to use for computations. */
+  /** Compute the values at several parameter vectors. If the metric supports
+   * GetValueWithTransform(), the samples are updated once and the parameter
+   * vectors are evaluated concurrently, which leaves the transform at the first
+   * of them. Otherwise GetValue() is called for each of them.
+   */
+  void GetValues( const ParametersVectorType & parameters,
+    MeasureVectorType & values ) const override;
+
+  /** Compute the values and derivatives at several parameter vectors, like
+   * GetValues(), using GetValueAndDerivativeWithTransform().
+   */
+  void GetValuesAndDerivatives( const ParametersVectorType & parameters,
+    MeasureVectorType & values, DerivativeVectorType & derivatives ) const override;
+
+  /** Compute the value at the given parameters without modifying the metric,
+   * its image sampler or its transform, so that several threads may call it
+   * concurrently. The samples of the last update of the image sampler are
+   * used, so GetValue() or BeforeThreadedGetValueAndDerivative() should be
+   * called first. Returns false, without computing the value, if the metric
+   * or the transform does not support it.
+   */
+  bool GetValueWithoutSideEffects( const TransformParametersType & parameters,
+    MeasureType & value ) const;
+
+  /** Compute the value and derivative like GetValueWithoutSideEffects(). */
+  bool GetValueAndDerivativeWithoutSideEffects( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const;
+
+  /** Get whether GetValueAndDerivative() may run concurrently with that of
+   * other metrics, see SetSupportsConcurrentEvaluation().
+   */
+  itkGetConstMacro( SupportsConcurrentEvaluation, bool );
+
+  /** Experimental, for the parallel mini-batches of the optimizer: set the
+   * transform parameters and update the samples once.
+   * A B-spline transform keeps referring to the parameters, so that the
+   * updates of the optimizer are seen by GetValueAndSparseDerivativeOfSamples().
+   * Returns the number of samples.
+   */
+  virtual SizeValueType BeforeParallelMiniBatches( const TransformParametersType & parameters ) const;
+
+  /** Experimental: compute the value and the derivative of the samples with
+   * the given indices in the sample container, at the current parameters of
+   * the transform, without modifying the metric, so that several threads may
+   * call it concurrently. The optimizer changes the parameters only between
+   * such concurrent calls. The derivative should be
+   * zero on entry; on return, only the entries listed in the sorted indices
+   * are nonzero. Implementations should set SupportsParallelMiniBatches in
+   * their constructor.
+   */
+  virtual void GetValueAndSparseDerivativeOfSamples(
+    const SizeValueType * sampleIds, const SizeValueType numberOfSampleIds,
+    MeasureType & value, DerivativeType & derivative,
+    typename AdvancedTransformType::NonZeroJacobianIndicesType & indices ) const;
+
+  /** Get whether GetValueAndSparseDerivativeOfSamples() is implemented. */
+  itkGetConstMacro( SupportsParallelMiniBatches, bool );
+
+  /** The function that returns whether the derivative of the sample at a
+   * fixed image point only affects parameters that the optimizer does not
+   * update in the current iteration. It is called concurrently.
+   */
+  typedef std::function< bool ( const typename TransformType::InputPointType & ) > FrozenSampleFunctionType;
+
+  /** Set/Get the frozen sample function; empty by default. A metric that
+   * supports it skips these samples in GetValueAndDerivative(), but counts
+   * them as valid samples, so that the derivative of the other parameters
+   * does not change. The value then lacks the terms of the skipped samples.
+   */
+  virtual void SetFrozenSampleFunction( const FrozenSampleFunctionType & function );
+
+  const FrozenSampleFunctionType & GetFrozenSampleFunction( void ) const
+  {
+    return this->m_FrozenSampleFunction;
+  }
+
+  /** Get whether GetValueAndDerivative() skips the frozen samples. */
+  itkGetConstMacro( SupportsFrozenSamples, bool );
+
+  /** The function that reduces the raw state of an evaluation, for example
+   * over the processes of a distributed evaluation that each hold a part of
+   * the samples. It must replace each entry of the array by its sum over all
+   * the parts. The raw state is what the threads of this process reduced,
+   * before the metric normalizes it: the sums over the samples and the
+   * number of pixels counted, and the derivative, which is linear in the
+   * normalization of the reduced sums. It is called by the thread that
+   * evaluates the metric, not by the threads of the samples.
+   */
+  typedef std::function< void ( DerivativeValueType *, const SizeValueType ) > RawStateReductionFunctionType;
+
+  /** Set/Get the raw state reduction function; empty by default. A metric
+   * that supports it calls it in GetValue() and GetValueAndDerivative(),
+   * first for its sums and then for its derivative.
+   */
+  virtual void SetRawStateReductionFunction( const RawStateReductionFunctionType & function );
+
+  const RawStateReductionFunctionType & GetRawStateReductionFunction( void ) const
+  {
+    return this->m_RawStateReductionFunction;
+  }
+
+  /** Get whether GetValue() and GetValueAndDerivative() reduce the raw state. */
+  itkGetConstMacro( SupportsRawStateReduction, bool );
+
+  /** Set number of threads to use for computations. With the automatic
+   * selection of the number of work units, this is the maximum.
+   */
   virtual void SetNumberOfWorkUnits( ThreadIdType numberOfThreads );
 
+  /** Select the number of threads automatically in each resolution. The
+   * candidates are halved from the maximum down to one thread, and are at most
+   * one thread per 256 samples, and per as many nonzero Jacobian entries of the
+   * samples as there are parameters, since fewer samples per thread do not pay
+   * for the barriers and the reduction of the derivatives.
+   * BeforeThreadedGetValueAndDerivative() times the first evaluations of the
+   * resolution for the candidates, until one is twice as slow as the best,
+   * and continues with the fastest. Ignored with the deterministic reduction.
+   * Default: false.
+   */
+  itkSetMacro( AutomaticNumberOfWorkUnits, bool );
+  itkGetConstReferenceMacro( AutomaticNumberOfWorkUnits, bool );
+  itkBooleanMacro( AutomaticNumberOfWorkUnits );
+
+  /** The number of threads and the shortest measured time in seconds per
+   * evaluation, of each candidate of the automatic selection.
+   */
+  typedef std::vector< std::pair< ThreadIdType, double > > WorkUnitsCalibrationType;
+
+  /** Get the candidates that were timed in this resolution by the automatic
+   * selection of the number of threads.
+   */
+  const WorkUnitsCalibrationType & GetWorkUnitsCalibration( void ) const
+  {
+    return this->m_WorkUnitsCalibration;
+  }
+
   /** Switch the function BeforeThreadedGetValueAndDerivative on or off. */
   itkSetMacro( UseMetricSingleThreaded, bool );
   itkGetConstReferenceMacro( UseMetricSingleThreaded, bool );
@@ -283,6 +490,73 @@ public:
   itkGetConstReferenceMacro( UseMultiThread, bool );
   itkBooleanMacro( UseMultiThread );
 
+  /** Select sparse accumulation of the derivative in the multi-threaded code.
+   * Instead of a full-length derivative per thread, each thread then only
+   * stores the (index, value) pairs of the derivative contributions of its
+   * samples, grouped by the thread that owns the parameter range of the index.
+   * AccumulateDerivativesThreaderCallback() merges the pairs of each range.
+   * This saves memory and time for transforms with sparse Jacobians, such as
+   * the B-spline. Only metrics that call AddSparseDerivativeTerms() support it.
+   */
+  itkSetMacro( UseSparseDerivativeAccumulation, bool );
+  itkGetConstReferenceMacro( UseSparseDerivativeAccumulation, bool );
+  itkBooleanMacro( UseSparseDerivativeAccumulation );
+
+  /** Select accumulation of the per-sample derivative contributions in single
+   * precision in the multi-threaded code. Each thread then adds the
+   * contributions of its samples to a float copy of the derivative, which
+   * halves the memory traffic and doubles the SIMD width of the inner loop.
+   * The float copy is added to the double precision derivative of the thread
+   * after a limited number of samples, and the derivatives of the threads are
+   * summed in double precision, so that the rounding errors do not grow with
+   * the number of samples. This is accurate enough for most intensity based
+   * metrics. It is ignored when UseSparseDerivativeAccumulation is on. Only
+   * metrics that call AddSinglePrecisionDerivativeTerms() support it.
+   */
+  itkSetMacro( UseSinglePrecisionDerivativeAccumulation, bool );
+  itkGetConstReferenceMacro( UseSinglePrecisionDerivativeAccumulation, bool );
+  itkBooleanMacro( UseSinglePrecisionDerivativeAccumulation );
+
+  /** Select the deterministic reduction in the multi-threaded code. The
+   * samples are then split in DeterministicReductionNumberOfChunks chunks,
+   * whatever the number of threads, and the results of the chunks are summed
+   * in the order of the chunks. The persistent thread pool hands out the
+   * chunks to its threads, so all threads are used, and the value and
+   * derivative are bit-identical for any number of threads. This costs one
+   * derivative, or one joint histogram, per chunk instead of per thread.
+   */
+  itkSetMacro( UseDeterministicReduction, bool );
+  itkGetConstReferenceMacro( UseDeterministicReduction, bool );
+  itkBooleanMacro( UseDeterministicReduction );
+
+  /** Set/Get the number of chunks of the deterministic reduction. The
+   * default is 64, which keeps 64 threads busy.
+   */
+  itkSetClampMacro( DeterministicReductionNumberOfChunks, ThreadIdType,
+    1, NumericTraits< ThreadIdType >::max() );
+  itkGetConstMacro( DeterministicReductionNumberOfChunks, ThreadIdType );
+
+  /** The maximum of MovingImagePrefetchDepth. */
+  itkStaticConstMacro( MaximumMovingImagePrefetchDepth, unsigned int, 4 );
+
+  /** Set/Get the number of blocks of MovingImageBatchSize samples that the
+   * pipelined threaded loops transform ahead of the interpolation. The
+   * moving image data of the samples of a block that is transformed ahead
+   * is prefetched, so that it is in the cache when the block is
+   * interpolated. 0 disables the pipelining. The default is 0, the maximum
+   * is MaximumMovingImagePrefetchDepth. Only metrics whose threaded loop is
+   * pipelined with TransformMovingImageBatch() support it.
+   */
+  itkSetClampMacro( MovingImagePrefetchDepth, unsigned int, 0, MaximumMovingImagePrefetchDepth );
+  itkGetConstMacro( MovingImagePrefetchDepth, unsigned int );
+
+  /** Get the number of chunks of the multi-threaded computations, which
+   * sizes and reduces the per-thread variables: the
+   * DeterministicReductionNumberOfChunks with the deterministic reduction,
+   * and the number of work units otherwise.
+   */
+  ThreadIdType GetNumberOfReductionChunks( void ) const;
+
   /** Contains calls from GetValueAndDerivative that are thread-unsafe,
    * together with preparation for multi-threading.
    * Note that the only reason why this function is not protected, is
@@ -291,6 +565,51 @@ public:
   virtual void BeforeThreadedGetValueAndDerivative(
     const TransformParametersType & parameters ) const;
 
+  /** The transform evaluated at the samples of an image sampler: the mapped
+   * points and, optionally, the sparse Jacobians, in the order of the sample
+   * container. Metrics that use the same image sampler and transform, such as
+   * the metrics of a CombinationImageToImageMetric, can share it.
+   */
+  struct SharedTransformEvaluationType
+  {
+    typename ImageSampleContainerType::ConstPointer                m_SampleContainer;
+    ModifiedTimeType                                               m_SampleUpdateTime;
+    std::vector< typename AdvancedTransformType::OutputPointType > m_MappedPoints;
+    SizeValueType                                                  m_NumberOfNonZeroJacobianIndices;
+    std::vector< double >                                          m_Jacobians;
+    typename AdvancedTransformType::NonZeroJacobianIndicesType     m_NonZeroJacobianIndices;
+  };
+  typedef std::shared_ptr< const SharedTransformEvaluationType > SharedTransformEvaluationConstPointer;
+
+  /** Evaluate the transform at the current samples. The Jacobians are only
+   * stored if computeJacobians is true, the transform is an AdvancedTransform,
+   * and they need less than MaximumSharedJacobianMemory bytes. Call it after
+   * BeforeThreadedGetValueAndDerivative().
+   */
+  SharedTransformEvaluationConstPointer ComputeSharedTransformEvaluation(
+    const bool computeJacobians ) const;
+
+  /** Let the functions that take the index of a sample in the sample
+   * container, such as TransformSamplePoint() and the TransformMovingImageBatch()
+   * with a first sample, look up the samples of the given evaluation instead
+   * of evaluating the transform. Set a null pointer when the samples or the
+   * transform parameters change.
+   */
+  void SetSharedTransformEvaluation( const SharedTransformEvaluationConstPointer & evaluation ) const
+  {
+    this->m_SharedTransformEvaluation = evaluation;
+  }
+
+
+  const SharedTransformEvaluationConstPointer & GetSharedTransformEvaluation( void ) const
+  {
+    return this->m_SharedTransformEvaluation;
+  }
+
+
+  /** The memory limit of the Jacobians of ComputeSharedTransformEvaluation(). */
+  static const SizeValueType MaximumSharedJacobianMemory = 256 * 1024 * 1024;
+
 protected:
 
   /** Constructor. */
@@ -319,12 +638,21 @@ protected:
   typedef BSplineInterpolateImageFunction<
     MovingImageType, CoordinateRepresentationType, float >       BSplineInterpolatorFloatType;
   typedef typename BSplineInterpolatorFloatType::Pointer BSplineInterpolatorFloatPointer;
+  typedef AdvancedBSplineInterpolateImageFunction<
+    MovingImageType, CoordinateRepresentationType, double >      AdvancedBSplineInterpolatorType;
+  typedef typename AdvancedBSplineInterpolatorType::Pointer AdvancedBSplineInterpolatorPointer;
+  typedef AdvancedBSplineInterpolateImageFunction<
+    MovingImageType, CoordinateRepresentationType, float >       AdvancedBSplineInterpolatorFloatType;
+  typedef typename AdvancedBSplineInterpolatorFloatType::Pointer AdvancedBSplineInterpolatorFloatPointer;
   typedef ReducedDimensionBSplineInterpolateImageFunction<
     MovingImageType, CoordinateRepresentationType, double >      ReducedBSplineInterpolatorType;
   typedef typename ReducedBSplineInterpolatorType::Pointer ReducedBSplineInterpolatorPointer;
   typedef AdvancedLinearInterpolateImageFunction<
     MovingImageType, CoordinateRepresentationType >              LinearInterpolatorType;
   typedef typename LinearInterpolatorType::Pointer              LinearInterpolatorPointer;
+  typedef AdvancedRayCastInterpolateImageFunction<
+    MovingImageType, CoordinateRepresentationType >              RayCastInterpolatorType;
+  typedef typename RayCastInterpolatorType::Pointer             RayCastInterpolatorPointer;
   typedef typename BSplineInterpolatorType::CovariantVectorType MovingImageDerivativeType;
   typedef GradientImageFilter<
     MovingImageType, RealType, RealType >                        CentralDifferenceGradientFilterType;
@@ -341,23 +669,85 @@ protected:
    */
   mutable ImageSamplerPointer m_ImageSampler;
 
+  /** Cache the InitialTransform of a combination transform at the current
+   * samples, if UseInitialTransformCache is true and the cache is out of
+   * date; called by BeforeThreadedGetValueAndDerivative().
+   */
+  void UpdateInitialTransformCache( void ) const;
+
+  /** The update time of the samples and the modification time of the
+   * InitialTransform when the InitialTransform cache was built.
+   */
+  mutable ModifiedTimeType m_InitialTransformCacheSampleTime;
+  mutable ModifiedTimeType m_InitialTransformCacheTransformTime;
+
+  /** Let the current transform of a combination transform cache its
+   * parameter independent parts at the points it receives for the current
+   * samples, if UseTransformPointCache is true and the cache is out of date;
+   * called by BeforeThreadedGetValueAndDerivative().
+   */
+  void UpdateTransformPointCache( void ) const;
+
+  /** The update time of the samples and the transform when the transform
+   * point cache was built.
+   */
+  mutable ModifiedTimeType m_TransformPointCacheSampleTime;
+  mutable const void *     m_TransformPointCacheTransform;
+
   /** Variables for image derivative computation. */
-  bool                                   m_InterpolatorIsLinear;
-  bool                                   m_InterpolatorIsBSpline;
-  bool                                   m_InterpolatorIsBSplineFloat;
-  bool                                   m_InterpolatorIsReducedBSpline;
-  LinearInterpolatorPointer              m_LinearInterpolator;
-  BSplineInterpolatorPointer             m_BSplineInterpolator;
-  BSplineInterpolatorFloatPointer        m_BSplineInterpolatorFloat;
-  ReducedBSplineInterpolatorPointer      m_ReducedBSplineInterpolator;
+  bool                                    m_InterpolatorIsLinear;
+  bool                                    m_InterpolatorIsBSpline;
+  bool                                    m_InterpolatorIsBSplineFloat;
+  bool                                    m_InterpolatorIsReducedBSpline;
+  LinearInterpolatorPointer               m_LinearInterpolator;
+  BSplineInterpolatorPointer              m_BSplineInterpolator;
+  BSplineInterpolatorFloatPointer         m_BSplineInterpolatorFloat;
+  AdvancedBSplineInterpolatorPointer      m_AdvancedBSplineInterpolator;
+  AdvancedBSplineInterpolatorFloatPointer m_AdvancedBSplineInterpolatorFloat;
+  ReducedBSplineInterpolatorPointer       m_ReducedBSplineInterpolator;
+  RayCastInterpolatorPointer              m_RayCastInterpolator;
 
   CentralDifferenceGradientFilterPointer m_CentralDifferenceGradientFilter;
 
+  /** The bitmap of the moving image mask, for fast inside tests. */
+  typename MovingImageMaskBitmapType::Pointer m_MovingImageMaskBitmap;
+
   /** Variables to store the AdvancedTransform. */
   bool m_TransformIsAdvanced;
   typename AdvancedTransformType::Pointer m_AdvancedTransform;
   mutable bool m_TransformIsBSpline;
 
+  /** The transforms and interpolators that have a fused kernel. */
+  enum FusedTransformKindType
+  {
+    NoFusedTransform,
+    FusedMatrixOffsetTransform,
+    FusedBSplineOrder3Transform,
+    FusedRecursiveBSplineOrder3Transform
+  };
+  enum FusedInterpolatorKindType
+  {
+    NoFusedInterpolator,
+    FusedLinearInterpolator,
+    FusedBSplineInterpolator,
+    FusedBSplineInterpolatorFloat
+  };
+
+  /** Variables for the fused kernels, set by CheckForFusedKernels().
+   * The transform pointers refer to the current transform of the
+   * combination transform, the one of m_FusedTransformKind.
+   */
+  mutable FusedTransformKindType                      m_FusedTransformKind;
+  mutable FusedInterpolatorKindType                   m_FusedInterpolatorKind;
+  mutable const MatrixOffsetTransformType *           m_FusedMatrixOffsetTransform;
+  mutable const BSplineOrder3TransformType *          m_FusedBSplineTransform;
+  mutable const RecursiveBSplineOrder3TransformType * m_FusedRecursiveBSplineTransform;
+
+  /** Select the fused kernels for the transform and the interpolator, if
+   * UseFusedKernels is true and their combination supports it.
+   */
+  void CheckForFusedKernels( void ) const;
+
   /** Variables for the Limiters. */
   FixedImageLimiterPointer     m_FixedImageLimiter;
   MovingImageLimiterPointer    m_MovingImageLimiter;
@@ -401,10 +791,108 @@ protected:
   /** AccumulateDerivatives threader callback function. */
   static ITK_THREAD_RETURN_TYPE AccumulateDerivativesThreaderCallback( void * arg );
 
+  /** Threader callback that adds the derivatives of the work units on each
+   * NUMA node to the derivative of the first work unit on that node, so that
+   * AccumulateDerivativesThreaderCallback() then only reads one derivative
+   * per node. Launched by LaunchThreaderCallback() with NUMA placement.
+   */
+  static ITK_THREAD_RETURN_TYPE AccumulateNUMANodeDerivativesThreaderCallback( void * arg );
+
+  /** Threader callback that initializes the per thread variables. Each work
+   * unit initializes its own, so that with NUMA placement their memory is
+   * first touched on the node of the thread that uses it.
+   */
+  static ITK_THREAD_RETURN_TYPE InitializePerThreadVariablesThreaderCallback( void * arg );
+
+  /** With NUMA placement of the PersistentThreadPool, spread the pages of the
+   * fixed and moving images and of the coefficients of a B-spline transform
+   * over the NUMA nodes. They are read by the threads of all nodes, and are
+   * otherwise all on the node of the thread that read or computed them.
+   */
+  void InterleaveImagesOverNUMANodes( void ) const;
+
+  /** Execute a threader callback for all work units on the persistent thread
+   * pool, which is shared with the samplers and the optimizers. Contrary to
+   * m_Threader, this does not create new threads at every call.
+   */
+  void LaunchThreaderCallback(
+    PersistentThreadPool::ThreadFunctionType callback, void * userData ) const;
+
+  /** Call sliceFunction( slice ) for the slices 0 to numberOfSlices - 1 of a
+   * metric over the last dimension. When each slice only contributes to its
+   * own block of parameters, as for a StackTransform, the slices are processed
+   * in parallel on the persistent thread pool, and may write directly to the
+   * derivative. Otherwise, or without multi-threading, they are processed
+   * serially by the calling thread.
+   */
+  template< class TSliceFunction >
+  void ProcessSlices( const unsigned int numberOfSlices,
+    const bool slicesHaveDisjointParameters,
+    const TSliceFunction & sliceFunction ) const;
+
+  /** ProcessSlices threader callback function, one slice per work unit. */
+  template< class TSliceFunction >
+  static ITK_THREAD_RETURN_TYPE SliceThreaderCallback( void * arg );
+
+  /** Call tileFunction( sampleBegin, sampleEnd, positionBegin, positionEnd )
+   * for tiles that together cover the samples 0 to numberOfSamples - 1 times
+   * the last dimension positions 0 to numberOfPositions - 1 of a metric over
+   * the last dimension. The tiles are processed in parallel on the persistent
+   * thread pool. With fewer samples than tiles, the positions are split as
+   * well, so that few samples of many positions still use all threads.
+   * Without multi-threading, a single tile covers everything.
+   */
+  template< class TTileFunction >
+  void ProcessSampleAndPositionTiles( const unsigned long numberOfSamples,
+    const unsigned int numberOfPositions,
+    const TTileFunction & tileFunction ) const;
+
+  /** The tiling of ProcessSampleAndPositionTiles(). */
+  template< class TTileFunction >
+  struct SampleAndPositionTilesType
+  {
+    const TTileFunction * st_TileFunction;
+    unsigned long         st_NumberOfSamples;
+    unsigned long         st_SamplesPerTile;
+    unsigned int          st_NumberOfPositions;
+    unsigned int          st_PositionsPerTile;
+    unsigned int          st_NumberOfPositionTiles;
+  };
+
+  /** ProcessSampleAndPositionTiles threader callback function, one tile per
+   * work unit.
+   */
+  template< class TTileFunction >
+  static ITK_THREAD_RETURN_TYPE SampleAndPositionTileThreaderCallback( void * arg );
+
   /** Variables for multi-threading. */
   bool m_UseMetricSingleThreaded;
   bool m_UseMultiThread;
   bool m_UseOpenMP;
+  bool m_UseSparseDerivativeAccumulation;
+  bool m_UseSinglePrecisionDerivativeAccumulation;
+  bool m_UseDeterministicReduction;
+
+  ThreadIdType m_DeterministicReductionNumberOfChunks;
+  unsigned int m_MovingImagePrefetchDepth;
+
+  /** Variables for the automatic selection of the number of threads. */
+  bool                                          m_AutomaticNumberOfWorkUnits;
+  ThreadIdType                                  m_MaximumNumberOfWorkUnits;
+  mutable std::vector< ThreadIdType >           m_WorkUnitsCandidates;
+  mutable WorkUnitsCalibrationType              m_WorkUnitsCalibration;
+  mutable unsigned int                          m_WorkUnitsMeasurements;
+  mutable bool                                  m_WorkUnitsCalibrationRunning;
+  mutable std::chrono::steady_clock::time_point m_WorkUnitsCalibrationStart;
+
+  /** Initialize the candidates of the automatic selection of the number of threads. */
+  void InitializeWorkUnitsCalibration( void );
+
+  /** Time the evaluation that just finished, and move on to the next candidate. */
+  void CalibrateNumberOfWorkUnits( void ) const;
+
+  /** Change the number of threads during a resolution. */
+  void SwitchNumberOfWorkUnits( const ThreadIdType numberOfThreads ) const;
 
   /** Helper structs that multi-threads the computation of
    * the metric derivative using ITK threads.
@@ -416,9 +904,17 @@ protected:
     // Used for accumulating derivatives
     DerivativeValueType * st_DerivativePointer;
     DerivativeValueType   st_NormalizationFactor;
+    // Whether the derivatives were summed per NUMA node first
+    bool st_NUMANodeDerivativesAccumulated;
   };
   mutable MultiThreaderParameterType m_ThreaderMetricParameters;
 
+  /** With NUMA placement, the work units executed on each NUMA node, the
+   * first of which accumulates the derivatives of that node. Empty when the
+   * derivatives are not summed per node.
+   */
+  mutable std::vector< std::vector< ThreadIdType > > m_NUMANodeWorkUnits;
+
   /** Most metrics will perform multi-threading by letting
    * each thread compute a part of the value and derivative.
    *
@@ -441,12 +937,23 @@ protected:
   mutable AlignedGetValuePerThreadStruct * m_GetValuePerThreadVariables;
   mutable ThreadIdType                     m_GetValuePerThreadVariablesSize;
 
+  /** A derivative contribution (parameter index, value), used for sparse accumulation. */
+  typedef std::pair< NumberOfParametersType, DerivativeValueType > SparseDerivativeTermType;
+  typedef std::vector< SparseDerivativeTermType >                  SparseDerivativeTermsType;
+
   // test per thread struct with padding and alignment
   struct GetValueAndDerivativePerThreadStruct
   {
     SizeValueType  st_NumberOfPixelsCounted;
     MeasureType    st_Value;
     DerivativeType st_Derivative;
+    // The memory of st_Derivative, which is kept over the resolutions
+    ReusableBuffer< DerivativeValueType > st_DerivativeBuffer;
+    // The sparse derivative contributions, one vector per owning thread
+    std::vector< SparseDerivativeTermsType > st_SparseDerivativeTerms;
+    // The single precision derivative contributions since the last flush
+    std::vector< float > st_SinglePrecisionDerivative;
+    SizeValueType        st_NumberOfSinglePrecisionSamples;
   };
   itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, GetValueAndDerivativePerThreadStruct,
     PaddedGetValueAndDerivativePerThreadStruct );
@@ -455,9 +962,71 @@ protected:
   mutable AlignedGetValueAndDerivativePerThreadStruct * m_GetValueAndDerivativePerThreadVariables;
   mutable ThreadIdType                                  m_GetValueAndDerivativePerThreadVariablesSize;
 
+  /** The number of parameters owned by each thread in the sparse accumulation. */
+  mutable NumberOfParametersType m_SparseDerivativeRangeSize;
+
+  /** The number of samples after which the single precision derivative of a
+   * thread is added to its double precision derivative.
+   */
+  mutable SizeValueType m_SinglePrecisionFlushInterval;
+
+  /** Per-thread scratch memory for the temporaries of the threaded metric
+   * computations, such as the sparse Jacobians and their indices. The arrays
+   * are sized once per resolution in InitializeThreadingParameters(), so that
+   * the threads do not allocate memory every iteration.
+   */
+  struct ScratchArenaStruct
+  {
+    NonZeroJacobianIndicesType sa_NonZeroJacobianIndices;
+    DerivativeType             sa_ImageJacobian;
+    DerivativeType             sa_ImageJacobian2;
+    TransformJacobianType      sa_TransformJacobian;
+    typename AdvancedTransformType::JacobianOfSpatialJacobianType sa_JacobianOfSpatialJacobian;
+    typename AdvancedTransformType::JacobianOfSpatialHessianType sa_JacobianOfSpatialHessian;
+  };
+  itkPadStruct( ITK_CACHE_LINE_ALIGNMENT, ScratchArenaStruct,
+    PaddedScratchArenaStruct );
+  itkAlignedTypedef( ITK_CACHE_LINE_ALIGNMENT, PaddedScratchArenaStruct,
+    AlignedScratchArenaStruct );
+  mutable AlignedScratchArenaStruct * m_ScratchArenas;
+  mutable ThreadIdType                m_ScratchArenasSize;
+
+  /** Get the scratch memory of a thread. */
+  ScratchArenaStruct & GetScratchArena( const ThreadIdType threadId ) const
+  {
+    return this->m_ScratchArenas[ threadId ];
+  }
+
+
   /** Initialize some multi-threading related parameters. */
   virtual void InitializeThreadingParameters( void ) const;
 
+  /** Store the derivative contributions factor * imageJacobian[ i ] at the
+   * parameters nzji[ i ] of one sample, for sparse accumulation by the thread
+   * threadId. Only to be called when UseSparseDerivativeAccumulation is on.
+   */
+  void AddSparseDerivativeTerms( const ThreadIdType threadId,
+    const DerivativeType & imageJacobian,
+    const NonZeroJacobianIndicesType & nzji,
+    const DerivativeValueType factor ) const;
+
+  /** Add the derivative contributions factor * imageJacobian[ i ] of one
+   * sample to the single precision derivative of the thread threadId, for
+   * the parameters nzji[ i ]. Only to be called when
+   * UseSinglePrecisionDerivativeAccumulation is on and
+   * UseSparseDerivativeAccumulation is off.
+   */
+  void AddSinglePrecisionDerivativeTerms( const ThreadIdType threadId,
+    const DerivativeType & imageJacobian,
+    const NonZeroJacobianIndicesType & nzji,
+    const DerivativeValueType factor ) const;
+
+  /** Add the single precision derivative of the thread threadId to its double
+   * precision derivative st_Derivative, and reset it. To be called at the end
+   * of a threaded derivative computation that uses AddSinglePrecisionDerivativeTerms().
+   */
+  void FlushSinglePrecisionDerivative( const ThreadIdType threadId ) const;
+
   /** Protected methods ************** */
 
   /** Methods for image sampler support **********/
@@ -469,6 +1038,50 @@ protected:
    * Make sure to set it before calling Initialize; default: false. */
   itkSetMacro( UseImageSampler, bool );
 
+  /** Inheriting classes can specify whether they apply the importance weights
+   * of the image samplers that produce them. Initialize() throws an exception
+   * for such a sampler otherwise; default: false. */
+  itkSetMacro( UseImageSampleWeights, bool );
+  itkGetConstMacro( UseImageSampleWeights, bool );
+
+  /** Get the importance weights of the current samples of the image sampler,
+   * in the order of its output, or a null pointer when all samples have
+   * weight one. */
+  const double * GetImageSampleWeights( void ) const
+  {
+    if( !this->m_UseImageSampler || !this->m_ImageSampler->GetUseSampleWeights() )
+    {
+      return nullptr;
+    }
+    return this->m_ImageSampler->GetSampleWeights().data();
+  }
+
+
+  /** Inheriting classes can specify whether they read the samples with
+   * GetFixedImageSamples(), so that they support the samplers that describe
+   * their samples implicitly. Initialize() throws an exception for such a
+   * sampler otherwise; default: false. */
+  itkSetMacro( UseImplicitImageSamples, bool );
+  itkGetConstMacro( UseImplicitImageSamples, bool );
+
+  /** Get the implicit samples of the image sampler, or a null pointer when
+   * the samples are stored in its output. */
+  const ImplicitSampleContainerType * GetImplicitImageSamples( void ) const
+  {
+    return this->m_UseImageSampler ? this->m_ImageSampler->GetImplicitOutput() : nullptr;
+  }
+
+
+  /** Get the number of samples of the image sampler, stored or implicit. */
+  SizeValueType GetNumberOfFixedImageSamples( void ) const;
+
+  /** Get the coordinates and the fixed image values of n consecutive samples
+   * of the image sampler, starting at sample begin, from its output or from
+   * its implicit samples. */
+  void GetFixedImageSamples( const SizeValueType begin, const SizeValueType n,
+    FixedImagePointType * fixedPoints, RealType * fixedImageValues ) const;
+
+
   /** Check if enough samples have been found to compute a reliable
    * estimate of the value/derivative; throws an exception if not. */
   virtual void CheckNumberOfSamples(
@@ -493,6 +1106,67 @@ protected:
     RealType & movingImageValue,
     MovingImageDerivativeType * gradient ) const;
 
+  /** The number of samples a threaded loop passes at once to
+   * EvaluateMovingImageValuesAndDerivatives().
+   */
+  itkStaticConstMacro( MovingImageBatchSize, unsigned int, 64 );
+
+  /** Compute the image values (and possibly derivatives) at a batch of n
+   * transformed points, like EvaluateMovingImageValueAndDerivative(). Only
+   * the points for which sampleOk is true on input are evaluated; sampleOk
+   * is set to false for those outside the moving image buffer. If no
+   * gradients are wanted, set the gradients argument to 0. The choice of
+   * the interpolation method is made once for the batch, and for the
+   * B-spline and linear interpolators their value and derivative kernels
+   * are called without virtual function calls. Without gradients, the rays
+   * of a ray cast interpolator are traced together, sharing their setup.
+   */
+  virtual void EvaluateMovingImageValuesAndDerivatives(
+    const MovingImagePointType * mappedPoints,
+    RealType * movingImageValues,
+    MovingImageDerivativeType * gradients,
+    bool * sampleOk,
+    const SizeValueType n ) const;
+
+  /** Prefetch the moving image data that EvaluateMovingImageValuesAndDerivatives()
+   * reads for the n mapped points for which sampleOk is true: the coefficients
+   * of the B-spline interpolator, or the pixels and gradient image pixels of
+   * the linear interpolator. Does nothing for the other interpolators.
+   */
+  void PrefetchMovingImageValuesAndDerivatives( const MovingImagePointType * mappedPoints,
+    const bool * sampleOk, const SizeValueType n ) const;
+
+  /** The first stage of a pipelined threaded loop: transform a batch of n
+   * fixed image points with TransformPoints(), check if the mapped points
+   * are inside the moving mask, and, if MovingImagePrefetchDepth is not 0,
+   * prefetch their moving image data. The interpolation of the batch should
+   * follow MovingImagePrefetchDepth batches later, when the prefetched data
+   * has arrived.
+   */
+  void TransformMovingImageBatch( const FixedImagePointType * fixedPoints,
+    MovingImagePointType * mappedPoints, bool * sampleOk, const SizeValueType n ) const;
+
+  /** As above, for the n consecutive samples of the sample container that
+   * start at firstSample, so that the mapped points of a shared transform
+   * evaluation are looked up.
+   */
+  void TransformMovingImageBatch( const FixedImagePointType * fixedPoints,
+    MovingImagePointType * mappedPoints, bool * sampleOk, const SizeValueType n,
+    const SizeValueType firstSample ) const;
+
+  /** As above, but the samples for which the FrozenSampleFunction returns
+   * true are not transformed, and get a false sampleOk. Returns the number
+   * of these frozen samples.
+   */
+  SizeValueType TransformUnfrozenMovingImageBatch( const FixedImagePointType * fixedPoints,
+    MovingImagePointType * mappedPoints, bool * sampleOk, const SizeValueType n,
+    const SizeValueType firstSample ) const;
+
+  /** Multiply the moving image gradient with the MovingImageDerivativeScales,
+   * if UseMovingImageDerivativeScales is true.
+   */
+  void ScaleMovingImageDerivative( MovingImageDerivativeType & gradient ) const;
+
   /** Computes the inner product of transform Jacobian with moving image gradient.
    * The results are stored in imageJacobian, which is supposed
    * to have the right size (same length as Jacobian's number of columns).
@@ -513,6 +1187,58 @@ protected:
   /** Check if the transform is a B-spline. Called by Initialize. */
   virtual void CheckForBSplineTransform( void ) const;
 
+  /** Create a copy of the transform with the given parameters, which allows
+   * the metric to be evaluated at these parameters without setting the
+   * parameters of the shared transform. Only the CurrentTransform of a
+   * combination transform is copied; the InitialTransform is shared. Returns
+   * null if the transform cannot be copied exactly. Thread-safe.
+   */
+  AdvancedTransformPointer CreateTransformCopy( const TransformParametersType & parameters ) const;
+
+  /** Compute the value and the number of valid samples at the current samples,
+   * using the given transform instead of the shared one. Implementations may
+   * not modify the metric, so that they can be called concurrently, and
+   * should set SupportsGetValueWithTransform in their constructor.
+   */
+  virtual void GetValueWithTransform( const AdvancedTransformType * transform,
+    MeasureType & value, SizeValueType & numberOfPixelsCounted ) const;
+
+  /** Compute the value and derivative like GetValueWithTransform(). */
+  virtual void GetValueAndDerivativeWithTransform( const AdvancedTransformType * transform,
+    MeasureType & value, DerivativeType & derivative, SizeValueType & numberOfPixelsCounted ) const;
+
+  /** Inheriting classes specify whether they implement GetValueWithTransform()
+   * and GetValueAndDerivativeWithTransform(); default: false.
+   */
+  itkSetMacro( SupportsGetValueWithTransform, bool );
+  itkSetMacro( SupportsGetValueAndDerivativeWithTransform, bool );
+
+  /** Inheriting classes specify whether their GetValueAndDerivative() may run
+   * concurrently with that of other metrics that share the transform and the
+   * image sampler, when UseMetricSingleThreaded is false. This requires that
+   * it leaves the transform parameters and the samples to
+   * BeforeThreadedGetValueAndDerivative(); default: false.
+   */
+  itkSetMacro( SupportsConcurrentEvaluation, bool );
+
+  /** Inheriting classes specify whether they implement
+   * GetValueAndSparseDerivativeOfSamples(); default: false.
+   */
+  itkSetMacro( SupportsParallelMiniBatches, bool );
+
+  /** Inheriting classes specify whether their GetValueAndDerivative() skips
+   * the samples of the FrozenSampleFunction; default: false.
+   */
+  itkSetMacro( SupportsFrozenSamples, bool );
+
+  /** Inheriting classes specify whether they call the
+   * RawStateReductionFunction; default: false.
+   */
+  itkSetMacro( SupportsRawStateReduction, bool );
+
+  /** Reduce the given raw state with the RawStateReductionFunction, if set. */
+  void ReduceRawState( DerivativeValueType * rawState, const SizeValueType size ) const;
+
   /** Transform a point from FixedImage domain to MovingImage domain.
    * This function also checks if mapped point is within support region of
    * the transform. It returns true if so, and false otherwise.
@@ -521,6 +1247,15 @@ protected:
     const FixedImagePointType & fixedImagePoint,
     MovingImagePointType & mappedPoint ) const;
 
+  /** Transform a batch of n points from FixedImage domain to MovingImage domain.
+   * For an AdvancedTransform the batch is passed on to its TransformPoints(),
+   * otherwise TransformPoint() is called for each point.
+   */
+  virtual void TransformPoints(
+    const FixedImagePointType * fixedImagePoints,
+    MovingImagePointType * mappedPoints,
+    const SizeValueType n ) const;
+
   /** This function returns a reference to the transform Jacobians.
    * This is either a reference to the full TransformJacobian or
    * a reference to a sparse Jacobians.
@@ -532,6 +1267,49 @@ protected:
     TransformJacobianType & jacobian,
     NonZeroJacobianIndicesType & nzji ) const;
 
+  /** Get the shared transform evaluation if it applies to the samples of
+   * this metric: the evaluation is of the current output of the image
+   * sampler, which was not updated since. Returns a null pointer otherwise.
+   */
+  const SharedTransformEvaluationType * GetValidSharedTransformEvaluation( void ) const
+  {
+    const SharedTransformEvaluationType * evaluation = this->m_SharedTransformEvaluation.get();
+    if( evaluation == nullptr || !this->m_UseImageSampler
+      || evaluation->m_SampleContainer.GetPointer() != this->GetImageSampler()->GetOutput()
+      || evaluation->m_SampleContainer->GetUpdateMTime() != evaluation->m_SampleUpdateTime )
+    {
+      return nullptr;
+    }
+    return evaluation;
+  }
+
+
+  /** Like TransformPoint(), for the sample with the given index in the
+   * sample container, of which fixedImagePoint is the point. The mapped
+   * point is looked up in the shared transform evaluation, if any.
+   */
+  bool TransformSamplePoint( const SizeValueType sampleIndex,
+    const FixedImagePointType & fixedImagePoint, MovingImagePointType & mappedPoint ) const;
+
+  /** Like EvaluateTransformJacobian(), for the sample with the given index
+   * in the sample container. The Jacobian is looked up in the shared
+   * transform evaluation, if it stores the Jacobians.
+   */
+  bool EvaluateSampleTransformJacobian( const SizeValueType sampleIndex,
+    const FixedImagePointType & fixedImagePoint,
+    TransformJacobianType & jacobian, NonZeroJacobianIndicesType & nzji ) const;
+
+  /** Like the EvaluateJacobianWithImageGradientProduct() of the advanced
+   * transform, for the sample with the given index in the sample container.
+   * With the Jacobians of a shared transform evaluation, the product is
+   * computed from the stored Jacobian.
+   */
+  void EvaluateSampleJacobianWithImageGradientProduct( const SizeValueType sampleIndex,
+    const FixedImagePointType & fixedImagePoint,
+    const MovingImageDerivativeType & movingImageDerivative,
+    DerivativeType & imageJacobian, NonZeroJacobianIndicesType & nzji ) const;
+
+
   /** Convenience method: check if point is inside the moving mask. *****************/
   virtual bool IsInsideMovingMask( const MovingImagePointType & point ) const;
 
@@ -552,16 +1330,95 @@ private:
   AdvancedImageToImageMetric( const Self & ); // purposely not implemented
   void operator=( const Self & );             // purposely not implemented
 
+  /** Copy the CurrentTransform of a combination transform, without checking
+   * that the copy is exact.
+   */
+  AdvancedTransformPointer CopyTransform( const TransformParametersType & parameters ) const;
+
+  /** Evaluate the values and derivatives of a batch of points with the
+   * value and derivative kernel of the given interpolator. With VFused, the
+   * interpolator must be exactly of type TInterpolator, which is called
+   * non-virtually.
+   */
+  template< class TInterpolator, bool VFused = false >
+  void EvaluateMovingImageValuesAndDerivativesWith( const TInterpolator * interpolator,
+    const MovingImagePointType * mappedPoints, RealType * movingImageValues,
+    MovingImageDerivativeType * gradients, bool * sampleOk, const SizeValueType n ) const;
+
+  /** PrefetchMovingImageValuesAndDerivatives() with the given interpolator. */
+  template< class TInterpolator >
+  void PrefetchMovingImageValuesAndDerivativesWith( const TInterpolator * interpolator,
+    const MovingImagePointType * mappedPoints, const bool * sampleOk, const SizeValueType n ) const;
+
+  /** Evaluate the values of a batch of points with the ray cast interpolator. */
+  void EvaluateMovingImageValuesWithRayCast( const MovingImagePointType * mappedPoints,
+    RealType * movingImageValues, const bool * sampleOk, const SizeValueType n ) const;
+
+  /** Create the transform copies for GetValues() and GetValuesAndDerivatives(),
+   * after updating the samples. Returns false if they should evaluate serially.
+   */
+  bool CreateTransformCopies( const ParametersVectorType & parameters,
+    const bool supported, std::vector< AdvancedTransformPointer > & transforms ) const;
+
+  /** The data passed to the threads by GetValues() and GetValuesAndDerivatives().
+   * The derivatives are only computed if m_Derivatives is not null.
+   */
+  struct GetValuesMultiThreaderParameterType
+  {
+    const Self *                                    m_Metric;
+    const std::vector< AdvancedTransformPointer > * m_Transforms;
+    MeasureVectorType *                             m_Values;
+    DerivativeVectorType *                          m_Derivatives;
+    std::vector< SizeValueType > *                  m_NumberOfPixelsCounted;
+  };
+
+  /** Compute the value, and possibly the derivative, of one parameter vector per work unit. */
+  static ITK_THREAD_RETURN_TYPE GetValuesThreaderCallback( void * arg );
+
+  /** Execute GetValuesThreaderCallback() and check the numbers of valid samples. */
+  void LaunchGetValuesThreaderCallback( const std::vector< AdvancedTransformPointer > & transforms,
+    MeasureVectorType & values, DerivativeVectorType * derivatives ) const;
+
+  /** The check of CheckNumberOfSamples(), without storing the number of pixels. */
+  void CheckNumberOfValidSamples( const SizeValueType numberOfPixelsCounted ) const;
+
   /** Private member variables. */
   bool   m_UseImageSampler;
+  bool   m_UseInitialTransformCache;
+  bool   m_UseTransformPointCache;
+  bool   m_UseFusedKernels;
+  bool   m_UseImageSampleWeights;
+  bool   m_UseImplicitImageSamples;
   bool   m_UseFixedImageLimiter;
   bool   m_UseMovingImageLimiter;
   double m_RequiredRatioOfValidSamples;
+  bool   m_SupportsGetValueWithTransform;
+  bool   m_SupportsGetValueAndDerivativeWithTransform;
+  bool   m_SupportsConcurrentEvaluation;
+  bool   m_SupportsParallelMiniBatches;
+  bool   m_SupportsFrozenSamples;
+  bool   m_SupportsRawStateReduction;
   bool   m_UseMovingImageDerivativeScales;
   bool   m_ScaleGradientWithRespectToMovingImageOrientation;
 
   MovingImageDerivativeScalesType m_MovingImageDerivativeScales;
 
+  /** The function that selects the samples that may be skipped. */
+  FrozenSampleFunctionType m_FrozenSampleFunction;
+
+  /** The function that reduces the raw state over the parts of the samples. */
+  RawStateReductionFunctionType m_RawStateReductionFunction;
+
+  /** Whether a copy of the transform maps like the transform itself: -1 if
+   * not checked since Initialize(), else 0 or 1. Checked by CreateTransformCopy().
+   */
+  mutable std::atomic< int > m_TransformCopyIsExact;
+
+  /** The transform evaluation looked up by TransformPoint() and
+   * EvaluateTransformJacobian(), if not null.
+   */
+  mutable SharedTransformEvaluationConstPointer m_SharedTransformEvaluation;
+
 };
 
 } // end namespace itk
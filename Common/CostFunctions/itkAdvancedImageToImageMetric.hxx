@@ -22,6 +22,9 @@
 
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
 #include "itkComputeImageExtremaFilter.h"
+#include "itkImageRandomSamplerOverlap.h"
+#include "itkNUMATopology.h"
+#include "itkProfiler.h"
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -29,6 +32,10 @@
 
 #include "itkTimeProbe.h"
 
+#include <algorithm>
+#include <cmath>
+#include <typeinfo>
+
 namespace itk
 {
 
@@ -50,17 +57,43 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 
   this->m_ImageSampler                = 0;
   this->m_UseImageSampler             = false;
+  this->m_UseImageSampleWeights       = false;
+  this->m_UseImplicitImageSamples     = false;
   this->m_RequiredRatioOfValidSamples = 0.25;
 
-  this->m_LinearInterpolator              = 0;
-  this->m_BSplineInterpolator             = 0;
-  this->m_BSplineInterpolatorFloat        = 0;
-  this->m_ReducedBSplineInterpolator      = 0;
-  this->m_InterpolatorIsLinear            = false;
-  this->m_InterpolatorIsBSpline           = false;
-  this->m_InterpolatorIsBSplineFloat      = false;
-  this->m_InterpolatorIsReducedBSpline    = false;
-  this->m_CentralDifferenceGradientFilter = 0;
+  this->m_SupportsGetValueWithTransform              = false;
+  this->m_SupportsGetValueAndDerivativeWithTransform = false;
+  this->m_SupportsConcurrentEvaluation               = false;
+  this->m_SupportsParallelMiniBatches                = false;
+  this->m_SupportsFrozenSamples                      = false;
+  this->m_SupportsRawStateReduction                  = false;
+  this->m_TransformCopyIsExact                       = -1;
+
+  this->m_UseInitialTransformCache           = false;
+  this->m_UseTransformPointCache             = false;
+  this->m_UseFusedKernels                    = false;
+  this->m_FusedTransformKind                 = NoFusedTransform;
+  this->m_FusedInterpolatorKind              = NoFusedInterpolator;
+  this->m_FusedMatrixOffsetTransform         = nullptr;
+  this->m_FusedBSplineTransform              = nullptr;
+  this->m_FusedRecursiveBSplineTransform     = nullptr;
+  this->m_InitialTransformCacheSampleTime    = 0;
+  this->m_InitialTransformCacheTransformTime = 0;
+  this->m_TransformPointCacheSampleTime      = 0;
+  this->m_TransformPointCacheTransform       = nullptr;
+
+  this->m_LinearInterpolator               = 0;
+  this->m_BSplineInterpolator              = 0;
+  this->m_BSplineInterpolatorFloat         = 0;
+  this->m_AdvancedBSplineInterpolator      = 0;
+  this->m_AdvancedBSplineInterpolatorFloat = 0;
+  this->m_ReducedBSplineInterpolator       = 0;
+  this->m_RayCastInterpolator              = 0;
+  this->m_InterpolatorIsLinear             = false;
+  this->m_InterpolatorIsBSpline            = false;
+  this->m_InterpolatorIsBSplineFloat       = false;
+  this->m_InterpolatorIsReducedBSpline     = false;
+  this->m_CentralDifferenceGradientFilter  = 0;
 
   this->m_AdvancedTransform                                = 0;
   this->m_TransformIsAdvanced                              = false;
@@ -85,27 +118,43 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   this->m_MovingImageMaxLimit   = NumericTraits< MovingImageLimiterOutputType >::One;
 
   /** Threading related variables. */
-  this->m_UseMetricSingleThreaded = true;
-  this->m_UseMultiThread = false;
+  this->m_UseMetricSingleThreaded                  = true;
+  this->m_UseMultiThread                           = false;
+  this->m_UseSparseDerivativeAccumulation          = false;
+  this->m_UseSinglePrecisionDerivativeAccumulation = false;
+  this->m_UseDeterministicReduction                = false;
+  this->m_DeterministicReductionNumberOfChunks     = 64;
+  this->m_MovingImagePrefetchDepth                 = 0;
+  this->m_AutomaticNumberOfWorkUnits               = false;
+  this->m_MaximumNumberOfWorkUnits                 = 0;
+  this->m_WorkUnitsMeasurements                    = 0;
+  this->m_WorkUnitsCalibrationRunning              = false;
+  this->m_SparseDerivativeRangeSize                = 0;
+  this->m_SinglePrecisionFlushInterval             = 0;
 
   /** OpenMP related. Switch to on when available */
 #ifdef ELASTIX_USE_OPENMP
   this->m_UseOpenMP = true;
 
-  const int nthreads = static_cast< int >( Self::GetNumberOfWorkUnits() );
+  const int nthreads = static_cast< int >( Superclass::GetNumberOfWorkUnits() );
   omp_set_num_threads( nthreads );
 #else
   this->m_UseOpenMP = false;
 #endif
 
   /** Initialize the m_ThreaderMetricParameters. */
-  this->m_ThreaderMetricParameters.st_Metric = this;
+  this->m_ThreaderMetricParameters.st_Metric                         = this;
+  this->m_ThreaderMetricParameters.st_NUMANodeDerivativesAccumulated = false;
 
   // Multi-threading structs
   this->m_GetValuePerThreadVariables                  = nullptr;
   this->m_GetValuePerThreadVariablesSize              = 0;
   this->m_GetValueAndDerivativePerThreadVariables     = nullptr;
   this->m_GetValueAndDerivativePerThreadVariablesSize = 0;
+  this->m_ScratchArenas                               = nullptr;
+  this->m_ScratchArenasSize                           = 0;
+
+  this->m_MovingImageMaskBitmap = MovingImageMaskBitmapType::New();
 
 } // end Constructor
 
@@ -120,6 +169,7 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 {
   delete[] this->m_GetValuePerThreadVariables;
   delete[] this->m_GetValueAndDerivativePerThreadVariables;
+  delete[] this->m_ScratchArenas;
 } // end Destructor
 
 
@@ -135,14 +185,34 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   // Note: This is a workaround for ITK5, which renamed NumberOfThreads
   // to NumberOfWorkUnits
   Superclass::SetNumberOfWorkUnits( numberOfThreads );
+  this->m_MaximumNumberOfWorkUnits = Superclass::GetNumberOfWorkUnits();
 
 #ifdef ELASTIX_USE_OPENMP
-  const int nthreads = static_cast< int >( Self::GetNumberOfWorkUnits() );
+  const int nthreads = static_cast< int >( Superclass::GetNumberOfWorkUnits() );
   omp_set_num_threads( nthreads );
 #endif
 } // end SetNumberOfWorkUnits()
 
 
+/**
+ * ********************* GetNumberOfReductionChunks ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ThreadIdType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetNumberOfReductionChunks( void ) const
+{
+  /** The chunks of the deterministic reduction do not depend on the threads. */
+  if( this->m_UseDeterministicReduction )
+  {
+    return this->m_DeterministicReductionNumberOfChunks;
+  }
+  return Superclass::GetNumberOfWorkUnits();
+
+} // end GetNumberOfReductionChunks()
+
+
 /**
  * ********************* Initialize ****************************
  */
@@ -158,6 +228,9 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   /** Setup the parameters for the gray value limiters. */
   this->InitializeLimiters();
 
+  /** Compute the bitmap of the moving image mask. */
+  this->m_MovingImageMaskBitmap->SetMask( this->m_MovingImageMask );
+
   /** Connect the image sampler */
   this->InitializeImageSampler();
 
@@ -170,15 +243,172 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   /** Check if the transform is a B-spline transform. */
   this->CheckForBSplineTransform();
 
+  /** Check if the transform and interpolator have fused kernels. */
+  this->CheckForFusedKernels();
+
+  /** The transform may have changed, so check the copies again. */
+  this->m_TransformCopyIsExact = -1;
+
+  /** Spread the images over the NUMA nodes. */
+  this->InterleaveImagesOverNUMANodes();
+
   /** Initialize some threading related parameters. */
   if( this->m_UseMultiThread )
   {
+    this->InitializeWorkUnitsCalibration();
     this->InitializeThreadingParameters();
   }
 
 } // end Initialize()
 
 
+/**
+ * ********************* InitializeWorkUnitsCalibration ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializeWorkUnitsCalibration( void )
+{
+  this->m_WorkUnitsCandidates.clear();
+  this->m_WorkUnitsCalibration.clear();
+  this->m_WorkUnitsMeasurements       = 0;
+  this->m_WorkUnitsCalibrationRunning = this->m_AutomaticNumberOfWorkUnits
+    && !this->m_UseDeterministicReduction;
+  if( this->m_WorkUnitsCalibrationRunning && this->m_MaximumNumberOfWorkUnits == 0 )
+  {
+    this->m_MaximumNumberOfWorkUnits = Superclass::GetNumberOfWorkUnits();
+  }
+
+  /** Start every resolution with the maximum number of threads, also when a
+   * previous resolution selected fewer.
+   */
+  if( this->m_MaximumNumberOfWorkUnits != 0
+    && Superclass::GetNumberOfWorkUnits() != this->m_MaximumNumberOfWorkUnits )
+  {
+    Superclass::SetNumberOfWorkUnits( this->m_MaximumNumberOfWorkUnits );
+#ifdef ELASTIX_USE_OPENMP
+    omp_set_num_threads( static_cast< int >( this->m_MaximumNumberOfWorkUnits ) );
+#endif
+  }
+
+} // end InitializeWorkUnitsCalibration()
+
+
+/**
+ * ********************* CalibrateNumberOfWorkUnits ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::CalibrateNumberOfWorkUnits( void ) const
+{
+  typedef std::chrono::steady_clock ClockType;
+
+  /** The first evaluation of the resolution chooses the candidates: the
+   * maximum that the samples and parameters justify, halved down to one.
+   */
+  if( this->m_WorkUnitsCandidates.empty() )
+  {
+    const SizeValueType numberOfSamples = this->m_UseImageSampler
+      ? this->GetImageSampler()->GetOutput()->Size() : 0;
+    ThreadIdType maximum = std::max< ThreadIdType >( this->m_MaximumNumberOfWorkUnits, 1 );
+    if( numberOfSamples > 0 )
+    {
+      const double nnzji = this->m_AdvancedTransform.IsNotNull()
+        ? static_cast< double >( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() )
+        : static_cast< double >( this->GetNumberOfParameters() );
+      const double bySamples  = static_cast< double >( numberOfSamples ) / 256.0;
+      const double byJacobian = static_cast< double >( numberOfSamples ) * nnzji
+        / std::max( static_cast< double >( this->GetNumberOfParameters() ), 1.0 );
+      const double limit = std::max( std::floor( std::min( bySamples, byJacobian ) ), 1.0 );
+      if( limit < static_cast< double >( maximum ) )
+      {
+        maximum = static_cast< ThreadIdType >( limit );
+      }
+    }
+    for( ThreadIdType n = maximum; n >= 1; n /= 2 )
+    {
+      this->m_WorkUnitsCandidates.push_back( n );
+    }
+
+    this->m_WorkUnitsCalibration.push_back( std::make_pair(
+      this->m_WorkUnitsCandidates[ 0 ], NumericTraits< double >::max() ) );
+    this->SwitchNumberOfWorkUnits( this->m_WorkUnitsCandidates[ 0 ] );
+    this->m_WorkUnitsCalibrationRunning = this->m_WorkUnitsCandidates.size() > 1;
+    this->m_WorkUnitsCalibrationStart   = ClockType::now();
+    return;
+  }
+
+  /** The time since the previous evaluation, including the step of the
+   * optimizer, is that of the current candidate; keep the shortest of two.
+   */
+  const double seconds = std::chrono::duration< double >(
+    ClockType::now() - this->m_WorkUnitsCalibrationStart ).count();
+  double & currentTime = this->m_WorkUnitsCalibration.back().second;
+  currentTime = std::min( currentTime, seconds );
+  if( ++this->m_WorkUnitsMeasurements < 2 )
+  {
+    this->m_WorkUnitsCalibrationStart = ClockType::now();
+    return;
+  }
+  this->m_WorkUnitsMeasurements = 0;
+
+  auto best = this->m_WorkUnitsCalibration.begin();
+  for( auto it = this->m_WorkUnitsCalibration.begin(); it != this->m_WorkUnitsCalibration.end(); ++it )
+  {
+    if( it->second < best->second )
+    {
+      best = it;
+    }
+  }
+
+  /** Try the next candidate, unless the current one is twice as slow as the best. */
+  const std::size_t next = this->m_WorkUnitsCalibration.size();
+  if( next < this->m_WorkUnitsCandidates.size() && currentTime <= 2.0 * best->second )
+  {
+    this->m_WorkUnitsCalibration.push_back( std::make_pair(
+      this->m_WorkUnitsCandidates[ next ], NumericTraits< double >::max() ) );
+    this->SwitchNumberOfWorkUnits( this->m_WorkUnitsCandidates[ next ] );
+    this->m_WorkUnitsCalibrationStart = ClockType::now();
+    return;
+  }
+
+  /** Continue the resolution with the fastest candidate. */
+  this->m_WorkUnitsCalibrationRunning = false;
+  this->SwitchNumberOfWorkUnits( best->first );
+
+} // end CalibrateNumberOfWorkUnits()
+
+
+/**
+ * ********************* SwitchNumberOfWorkUnits ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SwitchNumberOfWorkUnits( const ThreadIdType numberOfThreads ) const
+{
+  if( numberOfThreads == Superclass::GetNumberOfWorkUnits() )
+  {
+    return;
+  }
+
+  /** The maximum set by SetNumberOfWorkUnits() is kept. */
+  const_cast< Self * >( this )->Superclass::SetNumberOfWorkUnits( numberOfThreads );
+#ifdef ELASTIX_USE_OPENMP
+  omp_set_num_threads( static_cast< int >( numberOfThreads ) );
+#endif
+
+  /** Resize the variables of the threads. */
+  this->InitializeThreadingParameters();
+
+} // end SwitchNumberOfWorkUnits()
+
+
 /**
  * ********************* InitializeThreadingParameters ****************************
  */
@@ -188,7 +418,7 @@ void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::InitializeThreadingParameters( void ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Resize and initialize the threading related parameters.
    * The SetSize() functions do not resize the data when this is not
@@ -216,21 +446,269 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     this->m_GetValueAndDerivativePerThreadVariablesSize = numberOfThreads;
   }
 
-  /** Some initialization. */
-  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  /** Only resize the array of structs when needed. */
+  if( this->m_ScratchArenasSize != numberOfThreads )
   {
-    this->m_GetValuePerThreadVariables[ i ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
-    this->m_GetValuePerThreadVariables[ i ].st_Value                 = NumericTraits< MeasureType >::Zero;
+    delete[] this->m_ScratchArenas;
+    this->m_ScratchArenas     = new AlignedScratchArenaStruct[ numberOfThreads ];
+    this->m_ScratchArenasSize = numberOfThreads;
+  }
 
-    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
-    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value                 = NumericTraits< MeasureType >::Zero;
-    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.SetSize( this->GetNumberOfParameters() );
-    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  /** Each work unit sizes and initializes its own variables. */
+  PersistentThreadPool::GetInstance()->SingleMethodExecute( numberOfThreads,
+    Self::InitializePerThreadVariablesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( this ) ) );
+
+  /** With NUMA placement, group the work units per node, so that the dense
+   * derivatives are summed on each node before they are summed over the nodes.
+   * The deterministic reduction keeps summing them in the order of the chunks.
+   */
+  this->m_NUMANodeWorkUnits.clear();
+  if( !this->m_UseSparseDerivativeAccumulation && !this->m_UseDeterministicReduction )
+  {
+    const PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+    for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+    {
+      const unsigned int node = pool->GetNUMANodeOfWorkUnit( i, numberOfThreads );
+      if( node >= this->m_NUMANodeWorkUnits.size() )
+      {
+        this->m_NUMANodeWorkUnits.resize( node + 1 );
+      }
+      this->m_NUMANodeWorkUnits[ node ].push_back( i );
+    }
+    if( this->m_NUMANodeWorkUnits.size() < 2 )
+    {
+      this->m_NUMANodeWorkUnits.clear();
+    }
   }
 
+  const NumberOfParametersType nnzji = this->m_AdvancedTransform.IsNotNull()
+    ? this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() : 0;
+
+  /** Flush the single precision derivative after at most this many samples,
+   * but not more often than that the flushes cost as much as the accumulation.
+   */
+  this->m_SinglePrecisionFlushInterval = std::max< SizeValueType >( 256,
+    ( this->GetNumberOfParameters() + nnzji - 1 ) / std::max< NumberOfParametersType >( nnzji, 1 ) );
+
+  /** The parameter range owned by each thread, identical to the split of
+   * AccumulateDerivativesThreaderCallback().
+   */
+  this->m_SparseDerivativeRangeSize = static_cast< NumberOfParametersType >(
+    std::ceil( static_cast< double >( this->GetNumberOfParameters() )
+    / static_cast< double >( numberOfThreads ) ) );
+
 } // end InitializeThreadingParameters()
 
 
+/**
+ * ********************* InitializePerThreadVariablesThreaderCallback ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InitializePerThreadVariablesThreaderCallback( void * arg )
+{
+  const ThreadInfoType * infoStruct      = static_cast< ThreadInfoType * >( arg );
+  const ThreadIdType     i               = infoStruct->WorkUnitID;
+  const ThreadIdType     numberOfThreads = infoStruct->NumberOfWorkUnits;
+  const Self *           metric          = static_cast< const Self * >( infoStruct->UserData );
+
+  /** Size the scratch memory for the sparse Jacobians of the current transform. */
+  const NumberOfParametersType nnzji = metric->m_AdvancedTransform.IsNotNull()
+    ? metric->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() : 0;
+  ScratchArenaStruct & arena = metric->m_ScratchArenas[ i ];
+  arena.sa_NonZeroJacobianIndices.resize( nnzji );
+  arena.sa_ImageJacobian.SetSize( nnzji );
+  arena.sa_ImageJacobian2.SetSize( nnzji );
+  arena.sa_TransformJacobian.SetSize( MovingImageDimension, nnzji );
+  arena.sa_JacobianOfSpatialJacobian.resize( nnzji );
+  arena.sa_JacobianOfSpatialHessian.resize( nnzji );
+
+  /** Some initialization. */
+  metric->m_GetValuePerThreadVariables[ i ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
+  metric->m_GetValuePerThreadVariables[ i ].st_Value                 = NumericTraits< MeasureType >::Zero;
+
+  AlignedGetValueAndDerivativePerThreadStruct & threadVariables
+    = metric->m_GetValueAndDerivativePerThreadVariables[ i ];
+  threadVariables.st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
+  threadVariables.st_Value                 = NumericTraits< MeasureType >::Zero;
+
+  /** With sparse accumulation no full-length derivative is needed per thread. */
+  if( metric->m_UseSparseDerivativeAccumulation )
+  {
+    threadVariables.st_Derivative.SetSize( 0 );
+    threadVariables.st_DerivativeBuffer.Release();
+    threadVariables.st_SparseDerivativeTerms.resize( numberOfThreads );
+    for( ThreadIdType j = 0; j < numberOfThreads; ++j )
+    {
+      threadVariables.st_SparseDerivativeTerms[ j ].clear();
+    }
+  }
+  else
+  {
+    /** The derivative uses the memory of the buffer, which only grows. */
+    threadVariables.st_DerivativeBuffer.SetSize( metric->GetNumberOfParameters() );
+    threadVariables.st_Derivative.SetData( threadVariables.st_DerivativeBuffer.GetBufferPointer(),
+      metric->GetNumberOfParameters(), false );
+    threadVariables.st_Derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+    threadVariables.st_SparseDerivativeTerms.clear();
+  }
+
+  /** The single precision derivative is only used without sparse accumulation. */
+  threadVariables.st_NumberOfSinglePrecisionSamples = 0;
+  if( metric->m_UseSinglePrecisionDerivativeAccumulation && !metric->m_UseSparseDerivativeAccumulation )
+  {
+    threadVariables.st_SinglePrecisionDerivative.assign( metric->GetNumberOfParameters(), 0.0f );
+  }
+  else
+  {
+    std::vector< float >().swap( threadVariables.st_SinglePrecisionDerivative );
+  }
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end InitializePerThreadVariablesThreaderCallback()
+
+
+/**
+ * ********************* InterleaveImagesOverNUMANodes ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::InterleaveImagesOverNUMANodes( void ) const
+{
+  if( !PersistentThreadPool::GetInstance()->GetNUMAPlacement()
+    || NUMATopology::GetNumberOfNodes() < 2 )
+  {
+    return;
+  }
+
+  /** The buffers of the current resolution. */
+  if( this->m_FixedImage.IsNotNull() )
+  {
+    NUMATopology::InterleaveMemory( this->m_FixedImage->GetBufferPointer(),
+      this->m_FixedImage->GetBufferedRegion().GetNumberOfPixels() * sizeof( FixedImagePixelType ) );
+  }
+  if( this->m_MovingImage.IsNotNull() )
+  {
+    NUMATopology::InterleaveMemory( this->m_MovingImage->GetBufferPointer(),
+      this->m_MovingImage->GetBufferedRegion().GetNumberOfPixels() * sizeof( MovingImagePixelType ) );
+  }
+
+  /** The coefficient images of a B-spline transform wrap its parameters. */
+  if( this->m_TransformIsBSpline )
+  {
+    const TransformParametersType & parameters = this->m_Transform->GetParameters();
+    NUMATopology::InterleaveMemory( parameters.data_block(),
+      parameters.GetSize() * sizeof( typename TransformParametersType::ValueType ) );
+  }
+
+} // end InterleaveImagesOverNUMANodes()
+
+
+/**
+ * ********************* AddSparseDerivativeTerms ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::AddSparseDerivativeTerms( const ThreadIdType threadId,
+  const DerivativeType & imageJacobian,
+  const NonZeroJacobianIndicesType & nzji,
+  const DerivativeValueType factor ) const
+{
+  std::vector< SparseDerivativeTermsType > & terms
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_SparseDerivativeTerms;
+  const NumberOfParametersType rangeSize = this->m_SparseDerivativeRangeSize;
+
+  for( unsigned int i = 0; i < imageJacobian.GetSize(); ++i )
+  {
+    const NumberOfParametersType index = nzji[ i ];
+    terms[ index / rangeSize ].push_back( SparseDerivativeTermType( index, factor * imageJacobian[ i ] ) );
+  }
+
+} // end AddSparseDerivativeTerms()
+
+
+/**
+ * ********************* AddSinglePrecisionDerivativeTerms ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::AddSinglePrecisionDerivativeTerms( const ThreadIdType threadId,
+  const DerivativeType & imageJacobian,
+  const NonZeroJacobianIndicesType & nzji,
+  const DerivativeValueType factor ) const
+{
+  AlignedGetValueAndDerivativePerThreadStruct & threadVariables
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+  float *            derivative = threadVariables.st_SinglePrecisionDerivative.data();
+  const float        f          = static_cast< float >( factor );
+  const double *     imjac      = imageJacobian.data_block();
+  const unsigned int size       = imageJacobian.GetSize();
+
+  if( nzji.size() == this->GetNumberOfParameters() )
+  {
+    /** Loop over all Jacobians. */
+    for( unsigned int mu = 0; mu < size; ++mu )
+    {
+      derivative[ mu ] += f * static_cast< float >( imjac[ mu ] );
+    }
+  }
+  else
+  {
+    /** Only pick the nonzero Jacobians. */
+    for( unsigned int i = 0; i < size; ++i )
+    {
+      derivative[ nzji[ i ] ] += f * static_cast< float >( imjac[ i ] );
+    }
+  }
+
+  /** Bound the number of single precision additions to each element. */
+  if( ++threadVariables.st_NumberOfSinglePrecisionSamples == this->m_SinglePrecisionFlushInterval )
+  {
+    this->FlushSinglePrecisionDerivative( threadId );
+  }
+
+} // end AddSinglePrecisionDerivativeTerms()
+
+
+/**
+ * ********************* FlushSinglePrecisionDerivative ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::FlushSinglePrecisionDerivative( const ThreadIdType threadId ) const
+{
+  AlignedGetValueAndDerivativePerThreadStruct & threadVariables
+    = this->m_GetValueAndDerivativePerThreadVariables[ threadId ];
+  if( threadVariables.st_NumberOfSinglePrecisionSamples == 0 )
+  {
+    return;
+  }
+
+  float *               singleDerivative = threadVariables.st_SinglePrecisionDerivative.data();
+  DerivativeValueType * derivative       = threadVariables.st_Derivative.data_block();
+  const SizeValueType   size             = threadVariables.st_SinglePrecisionDerivative.size();
+  for( SizeValueType mu = 0; mu < size; ++mu )
+  {
+    derivative[ mu ]      += static_cast< DerivativeValueType >( singleDerivative[ mu ] );
+    singleDerivative[ mu ] = 0.0f;
+  }
+  threadVariables.st_NumberOfSinglePrecisionSamples = 0;
+
+} // end FlushSinglePrecisionDerivative()
+
+
 /**
  * ****************** InitializeLimiters *****************************
  */
@@ -369,15 +847,90 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
       itkExceptionMacro( << "ImageSampler is not present" );
     }
 
+    /** Ignoring the importance weights would bias the metric. */
+    if( this->m_ImageSampler->GetUseSampleWeights() && !this->m_UseImageSampleWeights )
+    {
+      itkExceptionMacro( << "ERROR: the image sampler "
+                         << this->m_ImageSampler->GetNameOfClass()
+                         << " produces importance weights, which are not supported by this metric." );
+    }
+
+    /** The samples cannot be read from the empty output. */
+    if( this->m_ImageSampler->GetUseImplicitOutput() && this->m_ImageSampler->SupportsImplicitOutput()
+      && !this->m_UseImplicitImageSamples )
+    {
+      itkExceptionMacro( << "ERROR: the image sampler "
+                         << this->m_ImageSampler->GetNameOfClass()
+                         << " describes its samples implicitly, which is not supported by this metric." );
+    }
+
     /** Initialize the Image Sampler. */
     this->m_ImageSampler->SetInput( this->m_FixedImage );
     this->m_ImageSampler->SetMask( this->m_FixedImageMask );
     this->m_ImageSampler->SetInputImageRegion( this->GetFixedImageRegion() );
+
+    /** A sampler that only samples the overlap needs the moving side. */
+    typedef ImageRandomSamplerOverlap< FixedImageType > OverlapSamplerType;
+    OverlapSamplerType * overlapSampler
+      = dynamic_cast< OverlapSamplerType * >( this->m_ImageSampler.GetPointer() );
+    if( overlapSampler != nullptr )
+    {
+      overlapSampler->SetTransform( this->m_Transform );
+      overlapSampler->SetMovingImage( this->m_MovingImage );
+      overlapSampler->SetMovingImageMask( this->m_MovingImageMask );
+    }
   }
 
 } // end InitializeImageSampler()
 
 
+/**
+ * ****************** GetNumberOfFixedImageSamples **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetNumberOfFixedImageSamples( void ) const
+{
+  const ImplicitSampleContainerType * implicitSamples = this->GetImplicitImageSamples();
+  if( implicitSamples != nullptr )
+  {
+    return implicitSamples->Size();
+  }
+  return this->GetImageSampler()->GetOutput()->Size();
+
+} // end GetNumberOfFixedImageSamples()
+
+
+/**
+ * ****************** GetFixedImageSamples **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetFixedImageSamples( const SizeValueType begin, const SizeValueType n,
+  FixedImagePointType * fixedPoints, RealType * fixedImageValues ) const
+{
+  const ImplicitSampleContainerType * implicitSamples = this->GetImplicitImageSamples();
+  if( implicitSamples != nullptr )
+  {
+    implicitSamples->GetSamples( begin, n, fixedPoints, fixedImageValues );
+    return;
+  }
+
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    const ImageSampleType & sample = sampleContainer->ElementAt( begin + i );
+    fixedPoints[ i ]      = sample.m_ImageCoordinates;
+    fixedImageValues[ i ] = static_cast< RealType >( sample.m_ImageValue );
+  }
+
+} // end GetFixedImageSamples()
+
+
 /**
  * ****************** CheckForBSplineInterpolator **********************
  */
@@ -407,6 +960,8 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     this->m_BSplineInterpolator = 0;
     itkDebugMacro( "Interpolator is not B-spline" );
   }
+  this->m_AdvancedBSplineInterpolator
+    = dynamic_cast< AdvancedBSplineInterpolatorType * >( this->m_Interpolator.GetPointer() );
 
   this->m_InterpolatorIsBSplineFloat = false;
   BSplineInterpolatorFloatType * testPtr2
@@ -422,6 +977,8 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     this->m_BSplineInterpolatorFloat = 0;
     itkDebugMacro( "Interpolator is not BSplineFloat" );
   }
+  this->m_AdvancedBSplineInterpolatorFloat
+    = dynamic_cast< AdvancedBSplineInterpolatorFloatType * >( this->m_Interpolator.GetPointer() );
 
   this->m_InterpolatorIsReducedBSpline = false;
   ReducedBSplineInterpolatorType * testPtr3
@@ -451,6 +1008,9 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
     this->m_LinearInterpolator = 0;
   }
 
+  this->m_RayCastInterpolator
+    = dynamic_cast< RayCastInterpolatorType * >( this->m_Interpolator.GetPointer() );
+
   /** Don't overwrite the gradient image if GetComputeGradient() == true.
    * Otherwise we can use a forward difference derivative, or the derivative
    * provided by the B-spline interpolator.
@@ -471,10 +1031,7 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
      * For more details see the post about "2D/3D registration memory issue" in
      * elastix's mailing list (2 July 2012).
      */
-    typedef itk::AdvancedRayCastInterpolateImageFunction<
-      MovingImageType, CoordinateRepresentationType >       RayCastInterpolatorType;
-    const bool interpolatorIsRayCast
-      = dynamic_cast< RayCastInterpolatorType * >( this->m_Interpolator.GetPointer() ) != 0;
+    const bool interpolatorIsRayCast = this->m_RayCastInterpolator.IsNotNull();
 
     if( !this->m_InterpolatorIsBSpline && !this->m_InterpolatorIsBSplineFloat
       && !this->m_InterpolatorIsReducedBSpline
@@ -575,45 +1132,155 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* EvaluateMovingImageValueAndDerivative ******************
+ * ****************** CheckForFusedKernels **********************
  */
 
 template< class TFixedImage, class TMovingImage >
-bool
+void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::EvaluateMovingImageValueAndDerivative(
-  const MovingImagePointType & mappedPoint,
-  RealType & movingImageValue,
-  MovingImageDerivativeType * gradient ) const
+::CheckForFusedKernels( void ) const
 {
-  /** Check if mapped point inside image buffer. */
-  MovingImageContinuousIndexType cindex;
-  this->m_Interpolator->ConvertPointToContinuousIndex( mappedPoint, cindex );
-  bool sampleOk = this->m_Interpolator->IsInsideBuffer( cindex );
-  if( sampleOk )
+  this->m_FusedTransformKind             = NoFusedTransform;
+  this->m_FusedInterpolatorKind          = NoFusedInterpolator;
+  this->m_FusedMatrixOffsetTransform     = nullptr;
+  this->m_FusedBSplineTransform          = nullptr;
+  this->m_FusedRecursiveBSplineTransform = nullptr;
+  if( !this->m_UseFusedKernels || !this->m_TransformIsAdvanced )
   {
-    /** Compute value and possibly derivative. */
-    if( gradient )
+    return;
+  }
+
+  /** The transform: the current transform of a combination transform
+   * without initial transform. The B-spline transforms are matched exactly,
+   * since their subclasses may override the evaluation. The matrix-offset
+   * subclasses, such as the Euler and affine transforms, only differ in
+   * their parameterization, i.e. in their Jacobian, which is therefore
+   * called virtually.
+   */
+  const CombinationTransformType * comboTransform
+    = dynamic_cast< const CombinationTransformType * >( this->m_AdvancedTransform.GetPointer() );
+  if( comboTransform != nullptr && comboTransform->GetInitialTransform() == nullptr )
+  {
+    const AdvancedTransformType * currentTransform
+      = dynamic_cast< const AdvancedTransformType * >( comboTransform->GetCurrentTransform() );
+    if( currentTransform != nullptr )
+    {
+      if( typeid( *currentTransform ) == typeid( RecursiveBSplineOrder3TransformType ) )
+      {
+        this->m_FusedTransformKind             = FusedRecursiveBSplineOrder3Transform;
+        this->m_FusedRecursiveBSplineTransform
+          = dynamic_cast< const RecursiveBSplineOrder3TransformType * >( currentTransform );
+      }
+      else if( typeid( *currentTransform ) == typeid( BSplineOrder3TransformType ) )
+      {
+        this->m_FusedTransformKind    = FusedBSplineOrder3Transform;
+        this->m_FusedBSplineTransform = dynamic_cast< const BSplineOrder3TransformType * >( currentTransform );
+      }
+      else
+      {
+        this->m_FusedMatrixOffsetTransform = dynamic_cast< const MatrixOffsetTransformType * >( currentTransform );
+        if( this->m_FusedMatrixOffsetTransform != nullptr )
+        {
+          this->m_FusedTransformKind = FusedMatrixOffsetTransform;
+        }
+      }
+    }
+  }
+
+  /** The interpolator, only if it computes the moving image derivatives. */
+  if( !this->GetComputeGradient() )
+  {
+    const InterpolatorType * interpolator = this->m_Interpolator.GetPointer();
+    if( this->m_InterpolatorIsLinear && typeid( *interpolator ) == typeid( LinearInterpolatorType ) )
+    {
+      this->m_FusedInterpolatorKind = FusedLinearInterpolator;
+    }
+    else if( this->m_AdvancedBSplineInterpolator.IsNotNull()
+      && typeid( *interpolator ) == typeid( AdvancedBSplineInterpolatorType ) )
+    {
+      this->m_FusedInterpolatorKind = FusedBSplineInterpolator;
+    }
+    else if( this->m_AdvancedBSplineInterpolatorFloat.IsNotNull()
+      && typeid( *interpolator ) == typeid( AdvancedBSplineInterpolatorFloatType ) )
+    {
+      this->m_FusedInterpolatorKind = FusedBSplineInterpolatorFloat;
+    }
+  }
+
+  itkDebugMacro( "Fused transform kind: " << this->m_FusedTransformKind
+                                          << ", fused interpolator kind: " << this->m_FusedInterpolatorKind );
+
+} // end CheckForFusedKernels()
+
+
+/**
+ * ******************* EvaluateMovingImageValueAndDerivative ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateMovingImageValueAndDerivative(
+  const MovingImagePointType & mappedPoint,
+  RealType & movingImageValue,
+  MovingImageDerivativeType * gradient ) const
+{
+  Profiler::ScopedTimer timer( Profiler::Interpolator );
+
+  /** Check if mapped point inside image buffer. */
+  MovingImageContinuousIndexType cindex;
+  this->m_Interpolator->ConvertPointToContinuousIndex( mappedPoint, cindex );
+  bool sampleOk = this->m_Interpolator->IsInsideBuffer( cindex );
+  if( sampleOk )
+  {
+    /** Compute value and possibly derivative. */
+    if( gradient )
     {
       if( this->m_InterpolatorIsBSpline && !this->GetComputeGradient() )
       {
-        /** Compute moving image value and gradient using the B-spline kernel. */
-        this->m_BSplineInterpolator->EvaluateValueAndDerivativeAtContinuousIndex(
-          cindex, movingImageValue, *gradient );
+        /** Compute moving image value and gradient using the B-spline kernel,
+         * with the fused kernel of the advanced interpolator if possible.
+         */
+        if( this->m_FusedInterpolatorKind == FusedBSplineInterpolator )
+        {
+          this->m_AdvancedBSplineInterpolator->AdvancedBSplineInterpolatorType
+          ::EvaluateValueAndDerivativeAtContinuousIndex( cindex, movingImageValue, *gradient );
+        }
+        else if( this->m_AdvancedBSplineInterpolator.IsNotNull() )
+        {
+          this->m_AdvancedBSplineInterpolator->EvaluateValueAndDerivativeAtContinuousIndex(
+            cindex, movingImageValue, *gradient );
+        }
+        else
+        {
+          this->m_BSplineInterpolator->EvaluateValueAndDerivativeAtContinuousIndex(
+            cindex, movingImageValue, *gradient );
+        }
       }
       else if( this->m_InterpolatorIsBSplineFloat && !this->GetComputeGradient() )
       {
         /** Compute moving image value and gradient using the B-spline kernel. */
-        this->m_BSplineInterpolatorFloat->EvaluateValueAndDerivativeAtContinuousIndex(
-          cindex, movingImageValue, *gradient );
+        if( this->m_FusedInterpolatorKind == FusedBSplineInterpolatorFloat )
+        {
+          this->m_AdvancedBSplineInterpolatorFloat->AdvancedBSplineInterpolatorFloatType
+          ::EvaluateValueAndDerivativeAtContinuousIndex( cindex, movingImageValue, *gradient );
+        }
+        else if( this->m_AdvancedBSplineInterpolatorFloat.IsNotNull() )
+        {
+          this->m_AdvancedBSplineInterpolatorFloat->EvaluateValueAndDerivativeAtContinuousIndex(
+            cindex, movingImageValue, *gradient );
+        }
+        else
+        {
+          this->m_BSplineInterpolatorFloat->EvaluateValueAndDerivativeAtContinuousIndex(
+            cindex, movingImageValue, *gradient );
+        }
       }
       else if( this->m_InterpolatorIsReducedBSpline && !this->GetComputeGradient() )
       {
         /** Compute moving image value and gradient using the B-spline kernel. */
-        movingImageValue = this->m_Interpolator->EvaluateAtContinuousIndex( cindex );
-        ( *gradient )    = this->m_ReducedBSplineInterpolator->EvaluateDerivativeAtContinuousIndex( cindex );
-        //this->m_ReducedBSplineInterpolator->EvaluateValueAndDerivativeAtContinuousIndex(
-        //  cindex, movingImageValue, *gradient );
+        this->m_ReducedBSplineInterpolator->EvaluateValueAndDerivativeAtContinuousIndex(
+          cindex, movingImageValue, *gradient );
       }
       else if( this->m_InterpolatorIsLinear && !this->GetComputeGradient() )
       {
@@ -636,44 +1303,7 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
       }
 
       /** The moving image gradient is multiplied with its scales, when requested. */
-      if( this->m_UseMovingImageDerivativeScales )
-      {
-        if( !this->m_ScaleGradientWithRespectToMovingImageOrientation )
-        {
-          for( unsigned int i = 0; i < MovingImageDimension; ++i )
-          {
-            ( *gradient )[ i ] *= this->m_MovingImageDerivativeScales[ i ];
-          }
-        }
-        else
-        {
-          /** Optionally, the scales are applied with respect to the moving image orientation.
-           * The above default option implicitly applies the scales with respect to the
-           * orientation of the transformation axis. In some cases you may want to restrict
-           * moving image motion with respect to its own axes. This is achieved below by pre
-           * and post rotation by the direction cosines of the moving image.
-           * First the gradient is rotated backwards to a standardized axis.
-           */
-          typedef typename MovingImageType::DirectionType::InternalMatrixType InternalMatrixType;
-          const InternalMatrixType M                    = this->GetMovingImage()->GetDirection().GetVnlMatrix();
-          vnl_vector< double >     rotated_gradient_vnl = M.transpose() * gradient->GetVnlVector();
-
-          /** Then scales are applied. */
-          for( unsigned int i = 0; i < MovingImageDimension; ++i )
-          {
-            rotated_gradient_vnl[ i ] *= this->m_MovingImageDerivativeScales[ i ];
-          }
-
-          /** The scaled gradient is then rotated forwards again. */
-          rotated_gradient_vnl = M * rotated_gradient_vnl;
-
-          /** Copy the vnl version back to the original. */
-          for( unsigned int i = 0; i < MovingImageDimension; ++i )
-          {
-            ( *gradient )[ i ] = rotated_gradient_vnl[ i ];
-          }
-        }
-      } // end if m_UseMovingImageDerivativeScales
+      this->ScaleMovingImageDerivative( *gradient );
     } // end if gradient
     else
     {
@@ -687,178 +1317,1405 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * *************** EvaluateTransformJacobianInnerProduct ****************
+ * ******************* EvaluateMovingImageValuesAndDerivatives ******************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::EvaluateTransformJacobianInnerProduct(
-  const TransformJacobianType & jacobian,
-  const MovingImageDerivativeType & movingImageDerivative,
-  DerivativeType & imageJacobian ) const
+::EvaluateMovingImageValuesAndDerivatives(
+  const MovingImagePointType * mappedPoints,
+  RealType * movingImageValues,
+  MovingImageDerivativeType * gradients,
+  bool * sampleOk,
+  const SizeValueType n ) const
 {
-  typedef typename TransformJacobianType::const_iterator JacobianIteratorType;
-  typedef typename DerivativeType::iterator              DerivativeIteratorType;
-
-  /** Multiple the 1-by-dim vector movingImageDerivative with the
-   * dim-by-length matrix jacobian, to get a 1-by-length vector imageJacobian.
-   * An optimized route can be taken for B-spline transforms.
+  /** Select the interpolation method once for the whole batch. The value-only
+   * and gradient image cases evaluate the points one by one, except for the
+   * ray cast interpolator, which traces the rays of a batch together.
    */
-  if( this->m_TransformIsBSpline )
+  const bool useKernel = gradients && !this->GetComputeGradient();
+  if( useKernel && this->m_FusedInterpolatorKind == FusedBSplineInterpolator )
   {
-    // For the B-spline we know that the Jacobian is mostly empty.
-    //       [ j ... j 0 ... 0 0 ... 0 ]
-    // jac = [ 0 ... 0 j ... j 0 ... 0 ]
-    //       [ 0 ... 0 0 ... 0 j ... j ]
-    const unsigned int sizeImageJacobian              = imageJacobian.GetSize();
-    const unsigned int numberOfParametersPerDimension = sizeImageJacobian / FixedImageDimension;
-    unsigned int       counter                        = 0;
-    for( unsigned int dim = 0; dim < FixedImageDimension; ++dim )
+    this->template EvaluateMovingImageValuesAndDerivativesWith< AdvancedBSplineInterpolatorType, true >(
+      this->m_AdvancedBSplineInterpolator.GetPointer(), mappedPoints, movingImageValues, gradients, sampleOk, n );
+  }
+  else if( useKernel && this->m_FusedInterpolatorKind == FusedBSplineInterpolatorFloat )
+  {
+    this->template EvaluateMovingImageValuesAndDerivativesWith< AdvancedBSplineInterpolatorFloatType, true >(
+      this->m_AdvancedBSplineInterpolatorFloat.GetPointer(), mappedPoints, movingImageValues, gradients, sampleOk, n );
+  }
+  else if( useKernel && this->m_FusedInterpolatorKind == FusedLinearInterpolator )
+  {
+    this->template EvaluateMovingImageValuesAndDerivativesWith< LinearInterpolatorType, true >(
+      this->m_LinearInterpolator.GetPointer(), mappedPoints, movingImageValues, gradients, sampleOk, n );
+  }
+  else if( useKernel && this->m_AdvancedBSplineInterpolator.IsNotNull() )
+  {
+    this->EvaluateMovingImageValuesAndDerivativesWith( this->m_AdvancedBSplineInterpolator.GetPointer(),
+      mappedPoints, movingImageValues, gradients, sampleOk, n );
+  }
+  else if( useKernel && this->m_AdvancedBSplineInterpolatorFloat.IsNotNull() )
+  {
+    this->EvaluateMovingImageValuesAndDerivativesWith( this->m_AdvancedBSplineInterpolatorFloat.GetPointer(),
+      mappedPoints, movingImageValues, gradients, sampleOk, n );
+  }
+  else if( useKernel && this->m_InterpolatorIsLinear )
+  {
+    this->EvaluateMovingImageValuesAndDerivativesWith( this->m_LinearInterpolator.GetPointer(),
+      mappedPoints, movingImageValues, gradients, sampleOk, n );
+  }
+  else if( !gradients && this->m_RayCastInterpolator.IsNotNull() )
+  {
+    this->EvaluateMovingImageValuesWithRayCast( mappedPoints, movingImageValues, sampleOk, n );
+  }
+  else
+  {
+    for( SizeValueType i = 0; i < n; ++i )
     {
-      const double imDeriv = movingImageDerivative[ dim ];
-      for( unsigned int mu = 0; mu < numberOfParametersPerDimension; ++mu )
+      if( sampleOk[ i ] )
       {
-        imageJacobian( counter )
-          = jacobian( dim, counter ) * imDeriv;
-        ++counter;
+        sampleOk[ i ] = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoints[ i ], movingImageValues[ i ], gradients ? gradients + i : 0 );
       }
     }
   }
-  else
+
+} // end EvaluateMovingImageValuesAndDerivatives()
+
+
+/**
+ * ******************* PrefetchMovingImageValuesAndDerivatives ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::PrefetchMovingImageValuesAndDerivatives( const MovingImagePointType * mappedPoints,
+  const bool * sampleOk, const SizeValueType n ) const
+{
+  /** The same interpolators as the kernels of EvaluateMovingImageValuesAndDerivatives(). */
+  if( this->GetComputeGradient() )
   {
-    /** Otherwise perform a full multiplication. */
-    JacobianIteratorType jac = jacobian.begin();
-    imageJacobian.Fill( 0.0 );
-    const unsigned int sizeImageJacobian = imageJacobian.GetSize();
+    return;
+  }
+  if( this->m_AdvancedBSplineInterpolator.IsNotNull() )
+  {
+    this->PrefetchMovingImageValuesAndDerivativesWith(
+      this->m_AdvancedBSplineInterpolator.GetPointer(), mappedPoints, sampleOk, n );
+  }
+  else if( this->m_AdvancedBSplineInterpolatorFloat.IsNotNull() )
+  {
+    this->PrefetchMovingImageValuesAndDerivativesWith(
+      this->m_AdvancedBSplineInterpolatorFloat.GetPointer(), mappedPoints, sampleOk, n );
+  }
+  else if( this->m_InterpolatorIsLinear )
+  {
+    this->PrefetchMovingImageValuesAndDerivativesWith(
+      this->m_LinearInterpolator.GetPointer(), mappedPoints, sampleOk, n );
+  }
 
-    for( unsigned int dim = 0; dim < FixedImageDimension; ++dim )
+} // end PrefetchMovingImageValuesAndDerivatives()
+
+
+/**
+ * ******************* PrefetchMovingImageValuesAndDerivativesWith ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TInterpolator >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::PrefetchMovingImageValuesAndDerivativesWith( const TInterpolator * interpolator,
+  const MovingImagePointType * mappedPoints, const bool * sampleOk, const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    if( sampleOk[ i ] )
     {
-      const double           imDeriv = movingImageDerivative[ dim ];
-      DerivativeIteratorType imjac   = imageJacobian.begin();
+      typename TInterpolator::ContinuousIndexType cindex;
+      interpolator->ConvertPointToContinuousIndex( mappedPoints[ i ], cindex );
+      interpolator->PrefetchAtContinuousIndex( cindex );
+    }
+  }
 
-      for( unsigned int mu = 0; mu < sizeImageJacobian; ++mu )
+} // end PrefetchMovingImageValuesAndDerivativesWith()
+
+
+/**
+ * ******************* TransformMovingImageBatch ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformMovingImageBatch( const FixedImagePointType * fixedPoints,
+  MovingImagePointType * mappedPoints, bool * sampleOk, const SizeValueType n ) const
+{
+  this->TransformPoints( fixedPoints, mappedPoints, n );
+  std::fill_n( sampleOk, n, true );
+
+  /** Check if the points are inside the moving mask. */
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    if( sampleOk[ i ] )
+    {
+      sampleOk[ i ] = this->IsInsideMovingMask( mappedPoints[ i ] );
+    }
+  }
+
+  if( this->m_MovingImagePrefetchDepth > 0 )
+  {
+    this->PrefetchMovingImageValuesAndDerivatives( mappedPoints, sampleOk, n );
+  }
+
+} // end TransformMovingImageBatch()
+
+
+/**
+ * ******************* TransformMovingImageBatch ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformMovingImageBatch( const FixedImagePointType * fixedPoints,
+  MovingImagePointType * mappedPoints, bool * sampleOk, const SizeValueType n,
+  const SizeValueType firstSample ) const
+{
+  const SharedTransformEvaluationType * evaluation = this->GetValidSharedTransformEvaluation();
+  if( evaluation == nullptr || firstSample + n > evaluation->m_MappedPoints.size() )
+  {
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, sampleOk, n );
+    return;
+  }
+
+  /** Look up the mapped points, and check if they are inside the moving mask. */
+  std::copy_n( evaluation->m_MappedPoints.begin() + firstSample, n, mappedPoints );
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    sampleOk[ i ] = this->IsInsideMovingMask( mappedPoints[ i ] );
+  }
+
+  if( this->m_MovingImagePrefetchDepth > 0 )
+  {
+    this->PrefetchMovingImageValuesAndDerivatives( mappedPoints, sampleOk, n );
+  }
+
+} // end TransformMovingImageBatch()
+
+
+/**
+ * ******************* TransformUnfrozenMovingImageBatch ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformUnfrozenMovingImageBatch( const FixedImagePointType * fixedPoints,
+  MovingImagePointType * mappedPoints, bool * sampleOk, const SizeValueType n,
+  const SizeValueType firstSample ) const
+{
+  if( !this->m_FrozenSampleFunction )
+  {
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, sampleOk, n, firstSample );
+    return 0;
+  }
+
+  /** Transform the unfrozen samples as one batch, per MovingImageBatchSize samples. */
+  SizeValueType numberOfFrozenSamples = 0;
+  for( SizeValueType chunkBegin = 0; chunkBegin < n; chunkBegin += MovingImageBatchSize )
+  {
+    const unsigned int chunkSize = static_cast< unsigned int >(
+      std::min< SizeValueType >( n - chunkBegin, MovingImageBatchSize ) );
+
+    FixedImagePointType  unfrozenFixedPoints[ MovingImageBatchSize ];
+    MovingImagePointType unfrozenMappedPoints[ MovingImageBatchSize ];
+    bool                 unfrozenSampleOk[ MovingImageBatchSize ];
+    unsigned int         unfrozenSamples[ MovingImageBatchSize ];
+    unsigned int         numberOfUnfrozenSamples = 0;
+    for( unsigned int i = 0; i < chunkSize; ++i )
+    {
+      if( this->m_FrozenSampleFunction( fixedPoints[ chunkBegin + i ] ) )
       {
-        ( *imjac ) += ( *jac ) * imDeriv;
-        ++imjac;
-        ++jac;
+        sampleOk[ chunkBegin + i ] = false;
+        ++numberOfFrozenSamples;
+      }
+      else
+      {
+        unfrozenSamples[ numberOfUnfrozenSamples ]       = i;
+        unfrozenFixedPoints[ numberOfUnfrozenSamples++ ] = fixedPoints[ chunkBegin + i ];
+      }
+    }
+
+    /** Without frozen samples, the mapped points of a shared transform
+     * evaluation can still be looked up.
+     */
+    if( numberOfUnfrozenSamples == chunkSize )
+    {
+      this->TransformMovingImageBatch( fixedPoints + chunkBegin, mappedPoints + chunkBegin,
+        sampleOk + chunkBegin, chunkSize, firstSample + chunkBegin );
+      continue;
+    }
+    if( numberOfUnfrozenSamples > 0 )
+    {
+      this->TransformMovingImageBatch( unfrozenFixedPoints, unfrozenMappedPoints,
+        unfrozenSampleOk, numberOfUnfrozenSamples );
+    }
+    for( unsigned int k = 0; k < numberOfUnfrozenSamples; ++k )
+    {
+      mappedPoints[ chunkBegin + unfrozenSamples[ k ] ] = unfrozenMappedPoints[ k ];
+      sampleOk[ chunkBegin + unfrozenSamples[ k ] ]     = unfrozenSampleOk[ k ];
+    }
+  }
+  return numberOfFrozenSamples;
+
+} // end TransformUnfrozenMovingImageBatch()
+
+
+/**
+ * ******************* EvaluateMovingImageValuesAndDerivativesWith ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TInterpolator, bool VFused >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateMovingImageValuesAndDerivativesWith( const TInterpolator * interpolator,
+  const MovingImagePointType * mappedPoints, RealType * movingImageValues,
+  MovingImageDerivativeType * gradients, bool * sampleOk, const SizeValueType n ) const
+{
+  Profiler::ScopedTimer timer( Profiler::Interpolator, n );
+
+  /** The fused kernel calls the functions of TInterpolator non-virtually,
+   * the exact type of the interpolator has been checked by CheckForFusedKernels().
+   */
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    if( !sampleOk[ i ] )
+    {
+      continue;
+    }
+
+    /** Check if mapped point inside image buffer. */
+    typename TInterpolator::ContinuousIndexType cindex;
+    interpolator->ConvertPointToContinuousIndex( mappedPoints[ i ], cindex );
+    sampleOk[ i ] = VFused ? interpolator->TInterpolator::IsInsideBuffer( cindex )
+      : interpolator->IsInsideBuffer( cindex );
+    if( sampleOk[ i ] )
+    {
+      if( VFused )
+      {
+        interpolator->TInterpolator::EvaluateValueAndDerivativeAtContinuousIndex(
+          cindex, movingImageValues[ i ], gradients[ i ] );
+      }
+      else
+      {
+        interpolator->EvaluateValueAndDerivativeAtContinuousIndex(
+          cindex, movingImageValues[ i ], gradients[ i ] );
+      }
+      this->ScaleMovingImageDerivative( gradients[ i ] );
+    }
+  }
+
+} // end EvaluateMovingImageValuesAndDerivativesWith()
+
+
+/**
+ * ******************* EvaluateMovingImageValuesWithRayCast ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateMovingImageValuesWithRayCast( const MovingImagePointType * mappedPoints,
+  RealType * movingImageValues, const bool * sampleOk, const SizeValueType n ) const
+{
+  Profiler::ScopedTimer timer( Profiler::Interpolator, n );
+
+  /** Gather the valid points, and trace their rays in batches, in the order
+   * of the samples. The ray cast interpolator accepts all points.
+   */
+  typedef typename RayCastInterpolatorType::OutputType RayCastOutputType;
+  const unsigned int   batchSize = MovingImageBatchSize;
+  MovingImagePointType points[ batchSize ];
+  RayCastOutputType    values[ batchSize ];
+  for( SizeValueType begin = 0; begin < n; begin += batchSize )
+  {
+    const SizeValueType end          = std::min< SizeValueType >( begin + batchSize, n );
+    unsigned int        numberOfRays = 0;
+    for( SizeValueType i = begin; i < end; ++i )
+    {
+      if( sampleOk[ i ] )
+      {
+        points[ numberOfRays++ ] = mappedPoints[ i ];
       }
     }
+
+    this->m_RayCastInterpolator->EvaluateBatch( points, values, numberOfRays );
+
+    numberOfRays = 0;
+    for( SizeValueType i = begin; i < end; ++i )
+    {
+      if( sampleOk[ i ] )
+      {
+        movingImageValues[ i ] = static_cast< RealType >( values[ numberOfRays++ ] );
+      }
+    }
+  }
+
+} // end EvaluateMovingImageValuesWithRayCast()
+
+
+/**
+ * ******************* ScaleMovingImageDerivative ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ScaleMovingImageDerivative( MovingImageDerivativeType & gradient ) const
+{
+  if( this->m_UseMovingImageDerivativeScales )
+  {
+    if( !this->m_ScaleGradientWithRespectToMovingImageOrientation )
+    {
+      for( unsigned int i = 0; i < MovingImageDimension; ++i )
+      {
+        gradient[ i ] *= this->m_MovingImageDerivativeScales[ i ];
+      }
+    }
+    else
+    {
+      /** Optionally, the scales are applied with respect to the moving image orientation.
+       * The above default option implicitly applies the scales with respect to the
+       * orientation of the transformation axis. In some cases you may want to restrict
+       * moving image motion with respect to its own axes. This is achieved below by pre
+       * and post rotation by the direction cosines of the moving image.
+       * First the gradient is rotated backwards to a standardized axis.
+       */
+      typedef typename MovingImageType::DirectionType::InternalMatrixType InternalMatrixType;
+      const InternalMatrixType M                    = this->GetMovingImage()->GetDirection().GetVnlMatrix();
+      vnl_vector< double >     rotated_gradient_vnl = M.transpose() * gradient.GetVnlVector();
+
+      /** Then scales are applied. */
+      for( unsigned int i = 0; i < MovingImageDimension; ++i )
+      {
+        rotated_gradient_vnl[ i ] *= this->m_MovingImageDerivativeScales[ i ];
+      }
+
+      /** The scaled gradient is then rotated forwards again. */
+      rotated_gradient_vnl = M * rotated_gradient_vnl;
+
+      /** Copy the vnl version back to the original. */
+      for( unsigned int i = 0; i < MovingImageDimension; ++i )
+      {
+        gradient[ i ] = rotated_gradient_vnl[ i ];
+      }
+    }
+  }
+
+} // end ScaleMovingImageDerivative()
+
+
+/**
+ * *************** EvaluateTransformJacobianInnerProduct ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateTransformJacobianInnerProduct(
+  const TransformJacobianType & jacobian,
+  const MovingImageDerivativeType & movingImageDerivative,
+  DerivativeType & imageJacobian ) const
+{
+  typedef typename TransformJacobianType::const_iterator JacobianIteratorType;
+  typedef typename DerivativeType::iterator              DerivativeIteratorType;
+
+  /** Multiple the 1-by-dim vector movingImageDerivative with the
+   * dim-by-length matrix jacobian, to get a 1-by-length vector imageJacobian.
+   * An optimized route can be taken for B-spline transforms.
+   */
+  if( this->m_TransformIsBSpline )
+  {
+    // For the B-spline we know that the Jacobian is mostly empty.
+    //       [ j ... j 0 ... 0 0 ... 0 ]
+    // jac = [ 0 ... 0 j ... j 0 ... 0 ]
+    //       [ 0 ... 0 0 ... 0 j ... j ]
+    const unsigned int sizeImageJacobian              = imageJacobian.GetSize();
+    const unsigned int numberOfParametersPerDimension = sizeImageJacobian / FixedImageDimension;
+    unsigned int       counter                        = 0;
+    for( unsigned int dim = 0; dim < FixedImageDimension; ++dim )
+    {
+      const double imDeriv = movingImageDerivative[ dim ];
+      for( unsigned int mu = 0; mu < numberOfParametersPerDimension; ++mu )
+      {
+        imageJacobian( counter )
+          = jacobian( dim, counter ) * imDeriv;
+        ++counter;
+      }
+    }
+  }
+  else
+  {
+    /** Otherwise perform a full multiplication. */
+    JacobianIteratorType jac = jacobian.begin();
+    imageJacobian.Fill( 0.0 );
+    const unsigned int sizeImageJacobian = imageJacobian.GetSize();
+
+    for( unsigned int dim = 0; dim < FixedImageDimension; ++dim )
+    {
+      const double           imDeriv = movingImageDerivative[ dim ];
+      DerivativeIteratorType imjac   = imageJacobian.begin();
+
+      for( unsigned int mu = 0; mu < sizeImageJacobian; ++mu )
+      {
+        ( *imjac ) += ( *jac ) * imDeriv;
+        ++imjac;
+        ++jac;
+      }
+    }
+  }
+
+} // end EvaluateTransformJacobianInnerProduct()
+
+
+/**
+ * ********************** TransformPoint ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformPoint(
+  const FixedImagePointType & fixedImagePoint,
+  MovingImagePointType & mappedPoint ) const
+{
+  Profiler::ScopedTimer timer( Profiler::Transform );
+  switch( this->m_FusedTransformKind )
+  {
+    case FusedMatrixOffsetTransform:
+      mappedPoint = this->m_FusedMatrixOffsetTransform->MatrixOffsetTransformType::TransformPoint(
+        fixedImagePoint );
+      break;
+    case FusedBSplineOrder3Transform:
+      mappedPoint = this->m_FusedBSplineTransform->BSplineOrder3TransformType::TransformPoint(
+        fixedImagePoint );
+      break;
+    case FusedRecursiveBSplineOrder3Transform:
+      mappedPoint = this->m_FusedRecursiveBSplineTransform->RecursiveBSplineOrder3TransformType::TransformPoint(
+        fixedImagePoint );
+      break;
+    default:
+      mappedPoint = this->m_Transform->TransformPoint( fixedImagePoint );
+  }
+
+  /** For future use: return whether the sample is valid */
+  const bool valid = true;
+  return valid;
+
+} // end TransformPoint()
+
+
+/**
+ * ********************** TransformSamplePoint ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformSamplePoint( const SizeValueType sampleIndex,
+  const FixedImagePointType & fixedImagePoint, MovingImagePointType & mappedPoint ) const
+{
+  const SharedTransformEvaluationType * evaluation = this->GetValidSharedTransformEvaluation();
+  if( evaluation != nullptr && sampleIndex < evaluation->m_MappedPoints.size() )
+  {
+    mappedPoint = evaluation->m_MappedPoints[ sampleIndex ];
+    return true;
+  }
+  return this->TransformPoint( fixedImagePoint, mappedPoint );
+
+} // end TransformSamplePoint()
+
+
+/**
+ * ********************** TransformPoints ************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::TransformPoints(
+  const FixedImagePointType * fixedImagePoints,
+  MovingImagePointType * mappedPoints,
+  const SizeValueType n ) const
+{
+  if( this->m_FusedTransformKind != NoFusedTransform )
+  {
+    Profiler::ScopedTimer timer( Profiler::Transform, n );
+    switch( this->m_FusedTransformKind )
+    {
+      case FusedMatrixOffsetTransform:
+        this->m_FusedMatrixOffsetTransform->MatrixOffsetTransformType::TransformPoints(
+          fixedImagePoints, mappedPoints, n );
+        break;
+      case FusedBSplineOrder3Transform:
+        this->m_FusedBSplineTransform->BSplineOrder3TransformType::TransformPoints(
+          fixedImagePoints, mappedPoints, n );
+        break;
+      default:
+        this->m_FusedRecursiveBSplineTransform->RecursiveBSplineOrder3TransformType::TransformPoints(
+          fixedImagePoints, mappedPoints, n );
+    }
+  }
+  else if( this->m_TransformIsAdvanced )
+  {
+    Profiler::ScopedTimer timer( Profiler::Transform, n );
+    this->m_AdvancedTransform->TransformPoints( fixedImagePoints, mappedPoints, n );
+  }
+  else
+  {
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      this->TransformPoint( fixedImagePoints[ i ], mappedPoints[ i ] );
+    }
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * *************** EvaluateTransformJacobian ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateTransformJacobian(
+  const FixedImagePointType & fixedImagePoint,
+  TransformJacobianType & jacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  Profiler::ScopedTimer timer( Profiler::TransformJacobian );
+
+  /** The fused kernels of the B-spline transforms, and the current transform of
+   * the matrix-offset transforms, whose Jacobian depends on the parameterization.
+   */
+  switch( this->m_FusedTransformKind )
+  {
+    case FusedMatrixOffsetTransform:
+      this->m_FusedMatrixOffsetTransform->GetJacobian( fixedImagePoint, jacobian, nzji );
+      break;
+    case FusedBSplineOrder3Transform:
+      this->m_FusedBSplineTransform->BSplineOrder3TransformType::GetJacobian(
+        fixedImagePoint, jacobian, nzji );
+      break;
+    case FusedRecursiveBSplineOrder3Transform:
+      this->m_FusedRecursiveBSplineTransform->RecursiveBSplineOrder3TransformType::GetJacobian(
+        fixedImagePoint, jacobian, nzji );
+      break;
+    default:
+      /** Advanced transform: generic sparse Jacobian support */
+      this->m_AdvancedTransform->GetJacobian(
+        fixedImagePoint, jacobian, nzji );
+  }
+
+  /** For future use: return whether the sample is valid */
+  const bool valid = true;
+  return valid;
+
+} // end EvaluateTransformJacobian()
+
+
+/**
+ * *************** EvaluateSampleTransformJacobian ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateSampleTransformJacobian( const SizeValueType sampleIndex,
+  const FixedImagePointType & fixedImagePoint,
+  TransformJacobianType & jacobian, NonZeroJacobianIndicesType & nzji ) const
+{
+  const SharedTransformEvaluationType * evaluation = this->GetValidSharedTransformEvaluation();
+  if( evaluation == nullptr || evaluation->m_NumberOfNonZeroJacobianIndices == 0
+    || sampleIndex >= evaluation->m_MappedPoints.size() )
+  {
+    return this->EvaluateTransformJacobian( fixedImagePoint, jacobian, nzji );
+  }
+
+  const SizeValueType nnzji = evaluation->m_NumberOfNonZeroJacobianIndices;
+  if( jacobian.rows() != MovingImageDimension || jacobian.cols() != nnzji )
+  {
+    jacobian.set_size( MovingImageDimension, nnzji );
+  }
+  const double * jacobianValues = evaluation->m_Jacobians.data() + sampleIndex * MovingImageDimension * nnzji;
+  std::copy( jacobianValues, jacobianValues + MovingImageDimension * nnzji, jacobian.data_block() );
+  nzji.assign( evaluation->m_NonZeroJacobianIndices.begin() + sampleIndex * nnzji,
+    evaluation->m_NonZeroJacobianIndices.begin() + ( sampleIndex + 1 ) * nnzji );
+  return true;
+
+} // end EvaluateSampleTransformJacobian()
+
+
+/**
+ * *************** EvaluateSampleJacobianWithImageGradientProduct ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateSampleJacobianWithImageGradientProduct( const SizeValueType sampleIndex,
+  const FixedImagePointType & fixedImagePoint,
+  const MovingImageDerivativeType & movingImageDerivative,
+  DerivativeType & imageJacobian, NonZeroJacobianIndicesType & nzji ) const
+{
+  const SharedTransformEvaluationType * evaluation = this->GetValidSharedTransformEvaluation();
+  if( evaluation == nullptr || evaluation->m_NumberOfNonZeroJacobianIndices == 0
+    || sampleIndex >= evaluation->m_MappedPoints.size() )
+  {
+    this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+      fixedImagePoint, movingImageDerivative, imageJacobian, nzji );
+    return;
+  }
+
+  /** The product (dM/dx)^T (dT/dmu) of the stored Jacobian, of which row d
+   * holds the derivatives of dimension d.
+   */
+  const SizeValueType nnzji          = evaluation->m_NumberOfNonZeroJacobianIndices;
+  const double *      jacobianValues = evaluation->m_Jacobians.data() + sampleIndex * MovingImageDimension * nnzji;
+  if( imageJacobian.GetSize() != nnzji )
+  {
+    imageJacobian.SetSize( nnzji );
+  }
+  imageJacobian.Fill( 0.0 );
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    const double   imDeriv = movingImageDerivative[ d ];
+    const double * row     = jacobianValues + d * nnzji;
+    for( SizeValueType mu = 0; mu < nnzji; ++mu )
+    {
+      imageJacobian[ mu ] += row[ mu ] * imDeriv;
+    }
+  }
+  nzji.assign( evaluation->m_NonZeroJacobianIndices.begin() + sampleIndex * nnzji,
+    evaluation->m_NonZeroJacobianIndices.begin() + ( sampleIndex + 1 ) * nnzji );
+
+} // end EvaluateSampleJacobianWithImageGradientProduct()
+
+
+/**
+ * *************** ComputeSharedTransformEvaluation ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename AdvancedImageToImageMetric< TFixedImage, TMovingImage >::SharedTransformEvaluationConstPointer
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeSharedTransformEvaluation( const bool computeJacobians ) const
+{
+  /** The evaluation of the previous samples may not be looked up here. */
+  this->m_SharedTransformEvaluation.reset();
+
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  const SizeValueType              numberOfSamples = sampleContainer->Size();
+
+  std::shared_ptr< SharedTransformEvaluationType > evaluation
+    = std::make_shared< SharedTransformEvaluationType >();
+  evaluation->m_SampleContainer  = sampleContainer;
+  evaluation->m_SampleUpdateTime = sampleContainer->GetUpdateMTime();
+  evaluation->m_MappedPoints.resize( numberOfSamples );
+
+  /** Only store the Jacobians if they fit in the memory limit. */
+  SizeValueType nnzji = 0;
+  if( computeJacobians && this->m_TransformIsAdvanced )
+  {
+    nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
+    const double bytes = static_cast< double >( numberOfSamples ) * nnzji
+      * ( MovingImageDimension * sizeof( double ) + sizeof( typename NonZeroJacobianIndicesType::value_type ) );
+    if( bytes > static_cast< double >( MaximumSharedJacobianMemory ) )
+    {
+      nnzji = 0;
+    }
+  }
+  evaluation->m_NumberOfNonZeroJacobianIndices = nnzji;
+  evaluation->m_Jacobians.resize( numberOfSamples * MovingImageDimension * nnzji );
+  evaluation->m_NonZeroJacobianIndices.resize( numberOfSamples * nnzji );
+
+  /** Evaluate the transform in chunks of samples, which write disjoint parts. */
+  const SizeValueType chunkSize      = 4096;
+  const unsigned int  numberOfChunks
+    = static_cast< unsigned int >( ( numberOfSamples + chunkSize - 1 ) / chunkSize );
+  SharedTransformEvaluationType & result = *evaluation;
+  this->ProcessSlices( numberOfChunks, true,
+    [this, sampleContainer, numberOfSamples, nnzji, &result]( const unsigned int chunk )
+    {
+      const SizeValueType begin = chunk * chunkSize;
+      const SizeValueType end   = std::min( begin + chunkSize, numberOfSamples );
+
+      std::vector< FixedImagePointType > fixedPoints( end - begin );
+      for( SizeValueType i = begin; i < end; ++i )
+      {
+        fixedPoints[ i - begin ] = sampleContainer->ElementAt( i ).m_ImageCoordinates;
+      }
+      this->TransformPoints( fixedPoints.data(), result.m_MappedPoints.data() + begin, end - begin );
+
+      if( nnzji == 0 )
+      {
+        return;
+      }
+      Profiler::ScopedTimer      timer( Profiler::TransformJacobian, end - begin );
+      TransformJacobianType      jacobian( MovingImageDimension, nnzji );
+      NonZeroJacobianIndicesType nzji( nnzji );
+      for( SizeValueType i = begin; i < end; ++i )
+      {
+        this->m_AdvancedTransform->GetJacobian( fixedPoints[ i - begin ], jacobian, nzji );
+        std::copy( jacobian.data_block(), jacobian.data_block() + MovingImageDimension * nnzji,
+          result.m_Jacobians.data() + i * MovingImageDimension * nnzji );
+        std::copy( nzji.begin(), nzji.end(), result.m_NonZeroJacobianIndices.data() + i * nnzji );
+      }
+    } );
+
+  return evaluation;
+
+} // end ComputeSharedTransformEvaluation()
+
+
+/**
+ * ************************** IsInsideMovingMask *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::IsInsideMovingMask( const MovingImagePointType & point ) const
+{
+  /** If a mask has been set: */
+  if( this->m_MovingImageMask.IsNotNull() )
+  {
+    if( this->m_MovingImageMaskBitmap->GetMask() == this->m_MovingImageMask.GetPointer() )
+    {
+      return this->m_MovingImageMaskBitmap->IsInsideInWorldSpace( point );
+    }
+    return this->m_MovingImageMask->IsInsideInWorldSpace( point );
+  }
+
+  /** If no mask has been set, just return true. */
+  return true;
+
+} // end IsInsideMovingMask()
+
+
+/**
+ * *********************** GetSelfHessian ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetSelfHessian(
+  const TransformParametersType & itkNotUsed( parameters ),
+  HessianType & H ) const
+{
+  itkDebugMacro( "GetSelfHessian()" );
+
+  /** Set identity matrix as default implementation. */
+  H.set_size( this->GetNumberOfParameters(),
+    this->GetNumberOfParameters() );
+  //H.Fill(0.0);
+  //H.fill_diagonal(1.0);
+  for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
+  {
+    H( i, i ) = 1.0;
+  }
+
+} // end GetSelfHessian()
+
+
+/**
+ * *********************** GetValues ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetValues( const ParametersVectorType & parameters,
+  MeasureVectorType & values ) const
+{
+  std::vector< AdvancedTransformPointer > transforms;
+  if( this->CreateTransformCopies( parameters, this->m_SupportsGetValueWithTransform, transforms ) )
+  {
+    this->LaunchGetValuesThreaderCallback( transforms, values, nullptr );
+    return;
+  }
+
+  values.resize( parameters.size() );
+  for( std::size_t i = 0; i < parameters.size(); ++i )
+  {
+    values[ i ] = this->GetValue( parameters[ i ] );
+  }
+
+} // end GetValues()
+
+
+/**
+ * *********************** GetValuesAndDerivatives ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetValuesAndDerivatives( const ParametersVectorType & parameters,
+  MeasureVectorType & values, DerivativeVectorType & derivatives ) const
+{
+  std::vector< AdvancedTransformPointer > transforms;
+  if( this->CreateTransformCopies( parameters, this->m_SupportsGetValueAndDerivativeWithTransform, transforms ) )
+  {
+    this->LaunchGetValuesThreaderCallback( transforms, values, &derivatives );
+    return;
+  }
+
+  values.resize( parameters.size() );
+  derivatives.resize( parameters.size() );
+  for( std::size_t i = 0; i < parameters.size(); ++i )
+  {
+    this->GetValueAndDerivative( parameters[ i ], values[ i ], derivatives[ i ] );
+  }
+
+} // end GetValuesAndDerivatives()
+
+
+/**
+ * *********************** CreateTransformCopies ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::CreateTransformCopies( const ParametersVectorType & parameters,
+  const bool supported, std::vector< AdvancedTransformPointer > & transforms ) const
+{
+  transforms.clear();
+  if( parameters.size() < 2 || !supported || !this->m_UseMetricSingleThreaded )
+  {
+    return false;
+  }
+
+  /** Update the samples and the shared transform only once. */
+  this->BeforeThreadedGetValueAndDerivative( parameters[ 0 ] );
+
+  for( const TransformParametersType & param : parameters )
+  {
+    AdvancedTransformPointer transform = this->CreateTransformCopy( param );
+    if( transform.IsNull() )
+    {
+      transforms.clear();
+      return false;
+    }
+    transforms.push_back( transform );
+  }
+  return true;
+
+} // end CreateTransformCopies()
+
+
+/**
+ * *********************** LaunchGetValuesThreaderCallback ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::LaunchGetValuesThreaderCallback( const std::vector< AdvancedTransformPointer > & transforms,
+  MeasureVectorType & values, DerivativeVectorType * derivatives ) const
+{
+  /** Compute each parameter vector in its own work unit. */
+  std::vector< SizeValueType > numberOfPixelsCounted( transforms.size(), 0 );
+  values.resize( transforms.size() );
+  if( derivatives != nullptr )
+  {
+    derivatives->resize( transforms.size() );
+  }
+
+  GetValuesMultiThreaderParameterType temp;
+  temp.m_Metric                = this;
+  temp.m_Transforms            = &transforms;
+  temp.m_Values                = &values;
+  temp.m_Derivatives           = derivatives;
+  temp.m_NumberOfPixelsCounted = &numberOfPixelsCounted;
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    static_cast< ThreadIdType >( transforms.size() ), Self::GetValuesThreaderCallback, &temp );
+
+  /** Check if enough samples were valid, like GetValue() does. */
+  const SizeValueType numberOfSamples = this->GetImageSampler()->GetOutput()->Size();
+  for( const SizeValueType count : numberOfPixelsCounted )
+  {
+    this->CheckNumberOfSamples( numberOfSamples, count );
+  }
+
+} // end LaunchGetValuesThreaderCallback()
+
+
+/**
+ * *********************** GetValuesThreaderCallback ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetValuesThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const ThreadIdType                          i    = infoStruct->WorkUnitID;
+  const GetValuesMultiThreaderParameterType * temp
+    = static_cast< GetValuesMultiThreaderParameterType * >( infoStruct->UserData );
+
+  if( temp->m_Derivatives == nullptr )
+  {
+    temp->m_Metric->GetValueWithTransform( ( *temp->m_Transforms )[ i ].GetPointer(),
+      ( *temp->m_Values )[ i ], ( *temp->m_NumberOfPixelsCounted )[ i ] );
+  }
+  else
+  {
+    temp->m_Metric->GetValueAndDerivativeWithTransform( ( *temp->m_Transforms )[ i ].GetPointer(),
+      ( *temp->m_Values )[ i ], ( *temp->m_Derivatives )[ i ], ( *temp->m_NumberOfPixelsCounted )[ i ] );
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end GetValuesThreaderCallback()
+
+
+/**
+ * *********************** GetValueWithoutSideEffects ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueWithoutSideEffects( const TransformParametersType & parameters,
+  MeasureType & value ) const
+{
+  if( !this->m_SupportsGetValueWithTransform )
+  {
+    return false;
+  }
+  const AdvancedTransformPointer transform = this->CreateTransformCopy( parameters );
+  if( transform.IsNull() )
+  {
+    return false;
+  }
+
+  SizeValueType numberOfPixelsCounted = 0;
+  this->GetValueWithTransform( transform.GetPointer(), value, numberOfPixelsCounted );
+  this->CheckNumberOfValidSamples( numberOfPixelsCounted );
+  return true;
+
+} // end GetValueWithoutSideEffects()
+
+
+/**
+ * *********************** GetValueAndDerivativeWithoutSideEffects ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivativeWithoutSideEffects( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  if( !this->m_SupportsGetValueAndDerivativeWithTransform )
+  {
+    return false;
+  }
+  const AdvancedTransformPointer transform = this->CreateTransformCopy( parameters );
+  if( transform.IsNull() )
+  {
+    return false;
+  }
+
+  SizeValueType numberOfPixelsCounted = 0;
+  this->GetValueAndDerivativeWithTransform( transform.GetPointer(), value, derivative, numberOfPixelsCounted );
+  this->CheckNumberOfValidSamples( numberOfPixelsCounted );
+  return true;
+
+} // end GetValueAndDerivativeWithoutSideEffects()
+
+
+/**
+ * *********************** CheckNumberOfValidSamples ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::CheckNumberOfValidSamples( const SizeValueType numberOfPixelsCounted ) const
+{
+  const SizeValueType numberOfSamples = this->GetImageSampler()->GetOutput()->Size();
+  if( numberOfPixelsCounted < numberOfSamples * this->GetRequiredRatioOfValidSamples() )
+  {
+    itkExceptionMacro( "Too many samples map outside moving image buffer: "
+        << numberOfPixelsCounted << " / " << numberOfSamples << std::endl );
+  }
+
+} // end CheckNumberOfValidSamples()
+
+
+/**
+ * *********************** GetValueWithTransform ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueWithTransform( const AdvancedTransformType * itkNotUsed( transform ),
+  MeasureType & itkNotUsed( value ), SizeValueType & itkNotUsed( numberOfPixelsCounted ) ) const
+{
+  itkExceptionMacro( << "GetValueWithTransform() is not implemented by this metric." );
+
+} // end GetValueWithTransform()
+
+
+/**
+ * *********************** GetValueAndDerivativeWithTransform ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivativeWithTransform( const AdvancedTransformType * itkNotUsed( transform ),
+  MeasureType & itkNotUsed( value ), DerivativeType & itkNotUsed( derivative ),
+  SizeValueType & itkNotUsed( numberOfPixelsCounted ) ) const
+{
+  itkExceptionMacro( << "GetValueAndDerivativeWithTransform() is not implemented by this metric." );
+
+} // end GetValueAndDerivativeWithTransform()
+
+
+/**
+ * *********************** SetFrozenSampleFunction ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SetFrozenSampleFunction( const FrozenSampleFunctionType & function )
+{
+  this->m_FrozenSampleFunction = function;
+  this->Modified();
+
+} // end SetFrozenSampleFunction()
+
+
+/**
+ * *********************** SetRawStateReductionFunction ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SetRawStateReductionFunction( const RawStateReductionFunctionType & function )
+{
+  this->m_RawStateReductionFunction = function;
+  this->Modified();
+
+} // end SetRawStateReductionFunction()
+
+
+/**
+ * *********************** ReduceRawState ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ReduceRawState( DerivativeValueType * rawState, const SizeValueType size ) const
+{
+  if( this->m_RawStateReductionFunction )
+  {
+    this->m_RawStateReductionFunction( rawState, size );
+  }
+
+} // end ReduceRawState()
+
+
+/**
+ * *********************** BeforeParallelMiniBatches ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+SizeValueType
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::BeforeParallelMiniBatches( const TransformParametersType & parameters ) const
+{
+  if( !this->m_SupportsParallelMiniBatches || !this->m_UseImageSampler )
+  {
+    itkExceptionMacro( << "The parallel mini-batches are not supported by this metric." );
+  }
+
+  this->SetTransformParameters( parameters );
+  this->GetImageSampler()->Update();
+  return this->GetNumberOfFixedImageSamples();
+
+} // end BeforeParallelMiniBatches()
+
+
+/**
+ * ****************** GetValueAndSparseDerivativeOfSamples *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndSparseDerivativeOfSamples(
+  const SizeValueType * itkNotUsed( sampleIds ), const SizeValueType itkNotUsed( numberOfSampleIds ),
+  MeasureType & itkNotUsed( value ), DerivativeType & itkNotUsed( derivative ),
+  typename AdvancedTransformType::NonZeroJacobianIndicesType & itkNotUsed( indices ) ) const
+{
+  itkExceptionMacro( << "GetValueAndSparseDerivativeOfSamples() is not implemented by this metric." );
+
+} // end GetValueAndSparseDerivativeOfSamples()
+
+
+/**
+ * *********************** CreateTransformCopy ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename AdvancedImageToImageMetric< TFixedImage, TMovingImage >::AdvancedTransformPointer
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::CreateTransformCopy( const TransformParametersType & parameters ) const
+{
+  if( this->m_TransformCopyIsExact == 0 || !this->m_UseImageSampler )
+  {
+    return nullptr;
+  }
+
+  /** A transform may have state that is neither in its parameters nor in its
+   * fixed parameters, and then the copy differs from the original. Check once
+   * that a copy at the current parameters maps the first sample identically.
+   */
+  if( this->m_TransformCopyIsExact < 0 )
+  {
+    const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+    if( sampleContainer->Size() == 0 )
+    {
+      return nullptr;
+    }
+    const AdvancedTransformPointer copy = this->CopyTransform( this->m_Transform->GetParameters() );
+    if( copy.IsNull() )
+    {
+      this->m_TransformCopyIsExact = 0;
+      return nullptr;
+    }
+
+    const FixedImagePointType & fixedPoint   = sampleContainer->ElementAt( 0 ).m_ImageCoordinates;
+    const MovingImagePointType  originalPoint = this->m_Transform->TransformPoint( fixedPoint );
+    const MovingImagePointType  copiedPoint   = copy->TransformPoint( fixedPoint );
+    bool                        exact         = true;
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      exact &= std::abs( originalPoint[ d ] - copiedPoint[ d ] ) <= 1e-6 * ( 1.0 + std::abs( originalPoint[ d ] ) );
+    }
+    this->m_TransformCopyIsExact = exact ? 1 : 0;
+    if( !exact )
+    {
+      return nullptr;
+    }
   }
 
-} // end EvaluateTransformJacobianInnerProduct()
+  return this->CopyTransform( parameters );
+
+} // end CreateTransformCopy()
 
 
 /**
- * ********************** TransformPoint ************************
+ * *********************** CopyTransform ***********************
  */
 
 template< class TFixedImage, class TMovingImage >
-bool
+typename AdvancedImageToImageMetric< TFixedImage, TMovingImage >::AdvancedTransformPointer
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::TransformPoint(
-  const FixedImagePointType & fixedImagePoint,
-  MovingImagePointType & mappedPoint ) const
+::CopyTransform( const TransformParametersType & parameters ) const
 {
-  mappedPoint = this->m_Transform->TransformPoint( fixedImagePoint );
-
-  /** For future use: return whether the sample is valid */
-  const bool valid = true;
-  return valid;
-
-} // end TransformPoint()
-
+  CombinationTransformType * comboTransform
+    = dynamic_cast< CombinationTransformType * >( this->m_AdvancedTransform.GetPointer() );
+  if( comboTransform == nullptr || comboTransform->GetCurrentTransform() == nullptr )
+  {
+    return nullptr;
+  }
 
-/**
- * *************** EvaluateTransformJacobian ****************
- */
+  /** Copy the CurrentTransform, which is the one that owns the parameters. */
+  const typename CombinationTransformType::CurrentTransformType * currentTransform
+    = comboTransform->GetCurrentTransform();
+  const NumberOfParametersType numberOfParameters = currentTransform->GetNumberOfParameters();
 
-template< class TFixedImage, class TMovingImage >
-bool
-AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::EvaluateTransformJacobian(
-  const FixedImagePointType & fixedImagePoint,
-  TransformJacobianType & jacobian,
-  NonZeroJacobianIndicesType & nzji ) const
-{
-  /** Advanced transform: generic sparse Jacobian support */
-  this->m_AdvancedTransform->GetJacobian(
-    fixedImagePoint, jacobian, nzji );
+  typename CombinationTransformType::CurrentTransformPointer currentCopy
+    = dynamic_cast< typename CombinationTransformType::CurrentTransformType * >(
+    currentTransform->CreateAnother().GetPointer() );
+  if( currentCopy.IsNull() || parameters.GetSize() != numberOfParameters )
+  {
+    return nullptr;
+  }
+  currentCopy->SetFixedParameters( currentTransform->GetFixedParameters() );
+  if( currentCopy->GetNumberOfParameters() != numberOfParameters )
+  {
+    return nullptr;
+  }
+  currentCopy->SetParametersByValue( parameters );
 
-  /** For future use: return whether the sample is valid */
-  const bool valid = true;
-  return valid;
+  typename CombinationTransformType::Pointer comboCopy = CombinationTransformType::New();
+  comboCopy->SetCurrentTransform( currentCopy );
+  comboCopy->SetInitialTransform( comboTransform->GetModifiableInitialTransform() );
+  comboCopy->SetUseComposition( comboTransform->GetUseComposition() );
+  comboCopy->SetUseAddition( comboTransform->GetUseAddition() );
+  return comboCopy.GetPointer();
 
-} // end EvaluateTransformJacobian()
+} // end CopyTransform()
 
 
 /**
- * ************************** IsInsideMovingMask *************************
+ * *********************** BeforeThreadedGetValueAndDerivative ***********************
  */
 
 template< class TFixedImage, class TMovingImage >
-bool
+void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::IsInsideMovingMask( const MovingImagePointType & point ) const
+::BeforeThreadedGetValueAndDerivative( const TransformParametersType & parameters ) const
 {
-  /** If a mask has been set: */
-  if( this->m_MovingImageMask.IsNotNull() )
+  /** In this function do all stuff that cannot be multi-threaded. */
+  if( this->m_UseMetricSingleThreaded )
   {
-    return this->m_MovingImageMask->IsInsideInWorldSpace( point );
+    this->SetTransformParameters( parameters );
+    if( this->m_UseImageSampler )
+    {
+      Profiler::ScopedTimer timer( Profiler::ImageSampler );
+      this->GetImageSampler()->Update();
+      this->UpdateInitialTransformCache();
+      this->UpdateTransformPointCache();
+    }
   }
 
-  /** If no mask has been set, just return true. */
-  return true;
+  /** Time the first evaluations of the resolution, to select the number of threads. */
+  if( this->m_WorkUnitsCalibrationRunning && this->m_UseMultiThread )
+  {
+    this->CalibrateNumberOfWorkUnits();
+  }
 
-} // end IsInsideMovingMask()
+} // end BeforeThreadedGetValueAndDerivative()
 
 
 /**
- * *********************** GetSelfHessian ***********************
+ * *********************** UpdateInitialTransformCache ***********************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::GetSelfHessian(
-  const TransformParametersType & itkNotUsed( parameters ),
-  HessianType & H ) const
+::UpdateInitialTransformCache( void ) const
 {
-  itkDebugMacro( "GetSelfHessian()" );
+  CombinationTransformType * comboTransform
+    = dynamic_cast< CombinationTransformType * >( this->m_AdvancedTransform.GetPointer() );
+  if( comboTransform == nullptr )
+  {
+    return;
+  }
 
-  /** Set identity matrix as default implementation. */
-  H.set_size( this->GetNumberOfParameters(),
-    this->GetNumberOfParameters() );
-  //H.Fill(0.0);
-  //H.fill_diagonal(1.0);
-  for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
+  /** Only a non-linear initial transform that is composed is worth caching. */
+  const typename CombinationTransformType::InitialTransformType * initialTransform
+    = comboTransform->GetInitialTransform();
+  if( !this->m_UseInitialTransformCache || initialTransform == nullptr
+    || !comboTransform->GetUseComposition() || initialTransform->IsLinear() )
   {
-    H( i, i ) = 1.0;
+    if( comboTransform->GetNumberOfCachedInitialTransformPoints() > 0 )
+    {
+      comboTransform->RemoveInitialTransformCache();
+    }
+    return;
   }
 
-} // end GetSelfHessian()
+  /** Only rebuild the cache for new samples or a modified initial transform. */
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  if( comboTransform->GetNumberOfCachedInitialTransformPoints() > 0
+    && this->m_InitialTransformCacheSampleTime == sampleContainer->GetUpdateMTime()
+    && this->m_InitialTransformCacheTransformTime == initialTransform->GetMTime() )
+  {
+    return;
+  }
+
+  const SizeValueType                numberOfSamples = sampleContainer->Size();
+  std::vector< FixedImagePointType > points( numberOfSamples );
+  for( SizeValueType i = 0; i < numberOfSamples; ++i )
+  {
+    points[ i ] = sampleContainer->ElementAt( i ).m_ImageCoordinates;
+  }
+  comboTransform->CacheInitialTransform( points.data(), numberOfSamples );
+
+  this->m_InitialTransformCacheSampleTime    = sampleContainer->GetUpdateMTime();
+  this->m_InitialTransformCacheTransformTime = initialTransform->GetMTime();
+
+} // end UpdateInitialTransformCache()
 
 
 /**
- * *********************** BeforeThreadedGetValueAndDerivative ***********************
+ * *********************** UpdateTransformPointCache ***********************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
-::BeforeThreadedGetValueAndDerivative( const TransformParametersType & parameters ) const
+::UpdateTransformPointCache( void ) const
 {
-  /** In this function do all stuff that cannot be multi-threaded. */
-  if( this->m_UseMetricSingleThreaded )
+  CombinationTransformType * comboTransform
+    = dynamic_cast< CombinationTransformType * >( this->m_AdvancedTransform.GetPointer() );
+  if( comboTransform == nullptr || comboTransform->GetCurrentTransform() == nullptr )
   {
-    this->SetTransformParameters( parameters );
-    if( this->m_UseImageSampler )
+    return;
+  }
+
+  typename CombinationTransformType::CurrentTransformType * currentTransform
+    = comboTransform->GetModifiableCurrentTransform();
+  if( !this->m_UseTransformPointCache )
+  {
+    if( currentTransform->GetNumberOfCachedPoints() > 0 )
     {
-      this->GetImageSampler()->Update();
+      currentTransform->RemovePointCache();
     }
+    return;
   }
 
-} // end BeforeThreadedGetValueAndDerivative()
+  /** Only rebuild the cache for new samples or another transform. */
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  if( currentTransform->GetNumberOfCachedPoints() > 0
+    && this->m_TransformPointCacheSampleTime == sampleContainer->GetUpdateMTime()
+    && this->m_TransformPointCacheTransform == currentTransform )
+  {
+    return;
+  }
+
+  /** The current transform receives the samples mapped by the initial
+   * transform when composition is used, and the samples themselves
+   * otherwise.
+   */
+  const typename CombinationTransformType::InitialTransformType * initialTransform
+    = comboTransform->GetInitialTransform();
+  const bool                         mapped          = initialTransform != nullptr && comboTransform->GetUseComposition();
+  const SizeValueType                numberOfSamples = sampleContainer->Size();
+  std::vector< FixedImagePointType > points( numberOfSamples );
+  for( SizeValueType i = 0; i < numberOfSamples; ++i )
+  {
+    const FixedImagePointType & point = sampleContainer->ElementAt( i ).m_ImageCoordinates;
+    points[ i ] = mapped ? initialTransform->TransformPoint( point ) : point;
+  }
+  currentTransform->CachePoints( points.data(), numberOfSamples );
+
+  this->m_TransformPointCacheSampleTime = sampleContainer->GetUpdateMTime();
+  this->m_TransformPointCacheTransform  = currentTransform;
+
+} // end UpdateTransformPointCache()
 
 
 /**
@@ -892,12 +2749,9 @@ void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchGetValueThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->GetValueThreaderCallback,
-    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-
   /** Launch. */
-  this->m_Threader->SingleMethodExecute();
+  this->LaunchThreaderCallback( this->GetValueThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
 
 } // end LaunchGetValueThreaderCallback()
 
@@ -933,12 +2787,9 @@ void
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchGetValueAndDerivativeThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->GetValueAndDerivativeThreaderCallback,
-    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-
   /** Launch. */
-  this->m_Threader->SingleMethodExecute();
+  this->LaunchThreaderCallback( this->GetValueAndDerivativeThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
 
 } // end LaunchGetValueAndDerivativeThreaderCallback()
 
@@ -952,6 +2803,8 @@ ITK_THREAD_RETURN_TYPE
 AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 ::AccumulateDerivativesThreaderCallback( void * arg )
 {
+  Profiler::ScopedTimer timer( Profiler::MetricReduction );
+
   ThreadInfoType * infoStruct  = static_cast< ThreadInfoType * >( arg );
   ThreadIdType     threadID    = infoStruct->WorkUnitID;
   ThreadIdType     nrOfThreads = infoStruct->NumberOfWorkUnits;
@@ -972,6 +2825,55 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
    */
   const DerivativeValueType zero          = NumericTraits< DerivativeValueType >::Zero;
   const DerivativeValueType normalization = 1.0 / temp->st_NormalizationFactor;
+
+  /** With sparse accumulation, this thread sums the terms that all threads
+   * stored for its range. The terms are cleared, but keep their memory.
+   */
+  if( temp->st_Metric->m_UseSparseDerivativeAccumulation )
+  {
+    for( unsigned int j = jmin; j < jmax; ++j )
+    {
+      temp->st_DerivativePointer[ j ] = zero;
+    }
+
+    for( ThreadIdType i = 0; i < nrOfThreads; ++i )
+    {
+      SparseDerivativeTermsType & terms
+        = temp->st_Metric->m_GetValueAndDerivativePerThreadVariables[ i ].st_SparseDerivativeTerms[ threadID ];
+      for( typename SparseDerivativeTermsType::const_iterator it = terms.begin(); it != terms.end(); ++it )
+      {
+        temp->st_DerivativePointer[ it->first ] += it->second * normalization;
+      }
+      terms.clear();
+    }
+
+    return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+  }
+
+  /** After the sums per NUMA node, only the first work unit of each node
+   * has a nonzero derivative.
+   */
+  if( temp->st_NUMANodeDerivativesAccumulated )
+  {
+    const std::vector< std::vector< ThreadIdType > > & nodeWorkUnits = temp->st_Metric->m_NUMANodeWorkUnits;
+    for( unsigned int j = jmin; j < jmax; ++j )
+    {
+      DerivativeValueType tmp = zero;
+      for( std::size_t node = 0; node < nodeWorkUnits.size(); ++node )
+      {
+        if( !nodeWorkUnits[ node ].empty() )
+        {
+          DerivativeType & nodeDerivative
+            = temp->st_Metric->m_GetValueAndDerivativePerThreadVariables[ nodeWorkUnits[ node ][ 0 ] ].st_Derivative;
+          tmp += nodeDerivative[ j ];
+          nodeDerivative[ j ] = zero;
+        }
+      }
+      temp->st_DerivativePointer[ j ] = tmp * normalization;
+    }
+    return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+  }
+
   for( unsigned int j = jmin; j < jmax; ++j )
   {
     DerivativeValueType tmp = zero;
@@ -990,6 +2892,242 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
 } // end AccumulateDerivativesThreaderCallback()
 
 
+/**
+ *********** AccumulateNUMANodeDerivativesThreaderCallback *************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::AccumulateNUMANodeDerivativesThreaderCallback( void * arg )
+{
+  Profiler::ScopedTimer timer( Profiler::MetricReduction );
+
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadID   = infoStruct->WorkUnitID;
+
+  MultiThreaderParameterType * temp
+    = static_cast< MultiThreaderParameterType * >( infoStruct->UserData );
+
+  /** Find the work units of the node of this work unit. */
+  const std::vector< std::vector< ThreadIdType > > & nodeWorkUnits = temp->st_Metric->m_NUMANodeWorkUnits;
+  const std::vector< ThreadIdType > *                workUnits     = nullptr;
+  std::size_t                                        position      = 0;
+  for( std::size_t node = 0; node < nodeWorkUnits.size() && workUnits == nullptr; ++node )
+  {
+    const std::vector< ThreadIdType >::const_iterator it
+      = std::find( nodeWorkUnits[ node ].begin(), nodeWorkUnits[ node ].end(), threadID );
+    if( it != nodeWorkUnits[ node ].end() )
+    {
+      workUnits = &nodeWorkUnits[ node ];
+      position  = it - nodeWorkUnits[ node ].begin();
+    }
+  }
+  if( workUnits == nullptr || workUnits->size() < 2 )
+  {
+    return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+  }
+
+  /** The work units of a node split the parameters, and each adds the
+   * derivatives of the other work units of the node to the derivative of the
+   * first, for its range [ jmin, jmax [. The added derivatives are reset.
+   */
+  const unsigned int numPar  = temp->st_Metric->GetNumberOfParameters();
+  const unsigned int subSize = static_cast< unsigned int >(
+    std::ceil( static_cast< double >( numPar )
+    / static_cast< double >( workUnits->size() ) ) );
+  const unsigned int jmin = static_cast< unsigned int >( position ) * subSize;
+  unsigned int       jmax = static_cast< unsigned int >( position + 1 ) * subSize;
+  jmax = ( jmax > numPar ) ? numPar : jmax;
+
+  const DerivativeValueType zero = NumericTraits< DerivativeValueType >::Zero;
+  DerivativeType &          nodeDerivative
+    = temp->st_Metric->m_GetValueAndDerivativePerThreadVariables[ ( *workUnits )[ 0 ] ].st_Derivative;
+  for( unsigned int j = jmin; j < jmax; ++j )
+  {
+    DerivativeValueType tmp = zero;
+    for( std::size_t k = 1; k < workUnits->size(); ++k )
+    {
+      DerivativeType & derivative
+        = temp->st_Metric->m_GetValueAndDerivativePerThreadVariables[ ( *workUnits )[ k ] ].st_Derivative;
+      tmp += derivative[ j ];
+      derivative[ j ] = zero;
+    }
+    nodeDerivative[ j ] += tmp;
+  }
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end AccumulateNUMANodeDerivativesThreaderCallback()
+
+
+/**
+ * *********************** LaunchThreaderCallback ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::LaunchThreaderCallback(
+  PersistentThreadPool::ThreadFunctionType callback, void * userData ) const
+{
+  const PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+
+  /** With NUMA placement, the dense derivatives are first summed per node,
+   * so that few derivatives are read from the memory of other nodes.
+   */
+  if( callback == &Self::AccumulateDerivativesThreaderCallback
+    && userData == &this->m_ThreaderMetricParameters )
+  {
+    const bool perNode = !this->m_NUMANodeWorkUnits.empty() && !this->m_UseSparseDerivativeAccumulation;
+    if( perNode )
+    {
+      pool->SingleMethodExecute( Self::GetNumberOfReductionChunks(),
+        Self::AccumulateNUMANodeDerivativesThreaderCallback, userData );
+    }
+    this->m_ThreaderMetricParameters.st_NUMANodeDerivativesAccumulated = perNode;
+  }
+
+  pool->SingleMethodExecute( Self::GetNumberOfReductionChunks(), callback, userData );
+
+} // end LaunchThreaderCallback()
+
+
+/**
+ * *********************** SliceThreaderCallback ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TSliceFunction >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SliceThreaderCallback( void * arg )
+{
+  const ThreadInfoType * infoStruct    = static_cast< ThreadInfoType * >( arg );
+  const TSliceFunction * sliceFunction = static_cast< const TSliceFunction * >( infoStruct->UserData );
+
+  ( *sliceFunction )( static_cast< unsigned int >( infoStruct->WorkUnitID ) );
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end SliceThreaderCallback()
+
+
+/**
+ * *********************** ProcessSlices ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TSliceFunction >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ProcessSlices( const unsigned int numberOfSlices,
+  const bool slicesHaveDisjointParameters,
+  const TSliceFunction & sliceFunction ) const
+{
+  if( !slicesHaveDisjointParameters || !this->m_UseMultiThread )
+  {
+    for( unsigned int slice = 0; slice < numberOfSlices; ++slice )
+    {
+      sliceFunction( slice );
+    }
+    return;
+  }
+
+  /** The pool hands out the slices one by one, which balances the load
+   * when the slices have different numbers of valid samples.
+   */
+  PersistentThreadPool::GetInstance()->SingleMethodExecute( numberOfSlices,
+    Self::template SliceThreaderCallback< TSliceFunction >,
+    const_cast< TSliceFunction * >( &sliceFunction ) );
+
+} // end ProcessSlices()
+
+
+/**
+ * *********************** SampleAndPositionTileThreaderCallback ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TTileFunction >
+ITK_THREAD_RETURN_TYPE
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::SampleAndPositionTileThreaderCallback( void * arg )
+{
+  const ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  const SampleAndPositionTilesType< TTileFunction > * tiles
+    = static_cast< const SampleAndPositionTilesType< TTileFunction > * >( infoStruct->UserData );
+
+  const unsigned long sampleTile   = infoStruct->WorkUnitID / tiles->st_NumberOfPositionTiles;
+  const unsigned int  positionTile = infoStruct->WorkUnitID % tiles->st_NumberOfPositionTiles;
+
+  const unsigned long sampleBegin   = sampleTile * tiles->st_SamplesPerTile;
+  const unsigned long sampleEnd     = std::min( sampleBegin + tiles->st_SamplesPerTile,
+    tiles->st_NumberOfSamples );
+  const unsigned int  positionBegin = positionTile * tiles->st_PositionsPerTile;
+  const unsigned int  positionEnd   = std::min( positionBegin + tiles->st_PositionsPerTile,
+    tiles->st_NumberOfPositions );
+
+  ( *tiles->st_TileFunction )( sampleBegin, sampleEnd, positionBegin, positionEnd );
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end SampleAndPositionTileThreaderCallback()
+
+
+/**
+ * *********************** ProcessSampleAndPositionTiles ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TTileFunction >
+void
+AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+::ProcessSampleAndPositionTiles( const unsigned long numberOfSamples,
+  const unsigned int numberOfPositions,
+  const TTileFunction & tileFunction ) const
+{
+  if( numberOfSamples == 0 || numberOfPositions == 0 )
+  {
+    return;
+  }
+  if( !this->m_UseMultiThread )
+  {
+    tileFunction( 0, numberOfSamples, 0, numberOfPositions );
+    return;
+  }
+
+  /** A few tiles per work unit, so that the pool balances the load. The
+   * samples are split first; the positions only when there are too few
+   * samples for the tiles.
+   */
+  const unsigned long numberOfTiles = 4 * static_cast< unsigned long >( this->GetNumberOfWorkUnits() );
+
+  SampleAndPositionTilesType< TTileFunction > tiles;
+  tiles.st_TileFunction      = &tileFunction;
+  tiles.st_NumberOfSamples   = numberOfSamples;
+  tiles.st_NumberOfPositions = numberOfPositions;
+
+  const unsigned long sampleTiles = std::min( numberOfSamples, numberOfTiles );
+  tiles.st_SamplesPerTile = ( numberOfSamples + sampleTiles - 1 ) / sampleTiles;
+  const unsigned long numberOfSampleTiles
+    = ( numberOfSamples + tiles.st_SamplesPerTile - 1 ) / tiles.st_SamplesPerTile;
+
+  const unsigned int positionTiles = static_cast< unsigned int >( std::min(
+    static_cast< unsigned long >( numberOfPositions ),
+    ( numberOfTiles + numberOfSampleTiles - 1 ) / numberOfSampleTiles ) );
+  tiles.st_PositionsPerTile      = ( numberOfPositions + positionTiles - 1 ) / positionTiles;
+  tiles.st_NumberOfPositionTiles
+    = ( numberOfPositions + tiles.st_PositionsPerTile - 1 ) / tiles.st_PositionsPerTile;
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    static_cast< ThreadIdType >( numberOfSampleTiles * tiles.st_NumberOfPositionTiles ),
+    Self::template SampleAndPositionTileThreaderCallback< TTileFunction >,
+    &tiles );
+
+} // end ProcessSampleAndPositionTiles()
+
+
 /**
  * *********************** CheckNumberOfSamples ***********************
  */
@@ -1079,6 +3217,15 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
   os << indent.GetNextIndent() << "AdvancedTransform: "
      << this->m_AdvancedTransform.GetPointer() << std::endl;
 
+  /** Variables of the fused kernels. */
+  os << indent << "Variables of the fused kernels: " << std::endl;
+  os << indent.GetNextIndent() << "UseFusedKernels: "
+     << this->m_UseFusedKernels << std::endl;
+  os << indent.GetNextIndent() << "FusedTransformKind: "
+     << this->m_FusedTransformKind << std::endl;
+  os << indent.GetNextIndent() << "FusedInterpolatorKind: "
+     << this->m_FusedInterpolatorKind << std::endl;
+
   /** Other variables. */
   os << indent << "Other variables of the AdvancedImageToImageMetric: " << std::endl;
   os << indent.GetNextIndent() << "RequiredRatioOfValidSamples: "
@@ -1087,6 +3234,16 @@ AdvancedImageToImageMetric< TFixedImage, TMovingImage >
      << this->m_UseMovingImageDerivativeScales << std::endl;
   os << indent.GetNextIndent() << "MovingImageDerivativeScales: "
      << this->m_MovingImageDerivativeScales << std::endl;
+  os << indent.GetNextIndent() << "UseSparseDerivativeAccumulation: "
+     << this->m_UseSparseDerivativeAccumulation << std::endl;
+  os << indent.GetNextIndent() << "UseSinglePrecisionDerivativeAccumulation: "
+     << this->m_UseSinglePrecisionDerivativeAccumulation << std::endl;
+  os << indent.GetNextIndent() << "UseDeterministicReduction: "
+     << this->m_UseDeterministicReduction << std::endl;
+  os << indent.GetNextIndent() << "DeterministicReductionNumberOfChunks: "
+     << this->m_DeterministicReductionNumberOfChunks << std::endl;
+  os << indent.GetNextIndent() << "MovingImagePrefetchDepth: "
+     << this->m_MovingImagePrefetchDepth << std::endl;
 
 } // end PrintSelf()
 
@@ -19,6 +19,7 @@
 #define __itkMultiInputImageToImageMetricBase_h
 
 #include "itkAdvancedImageToImageMetric.h"
+#include "itkKernelFunctionBase2.h"
 #include <vector>
 
 /** Macro for setting the number of objects. */
@@ -40,6 +41,16 @@ namespace itk
  *
  * \brief Implements a metric base class that takes multiple inputs.
  *
+ * EvaluateMovingImageValuesAndDerivatives() evaluates all moving images at
+ * a point. With UseInterleavedMovingImageCoefficients, and moving images
+ * that have the same geometry and B-spline interpolators of the same order,
+ * it computes the B-spline weights once for all images. It then gathers the
+ * coefficients of all images at each voxel of the support from one buffer,
+ * in which they are stored next to each other.
+ *
+ * With UseFixedFeatureImageCache, the values of the fixed feature images,
+ * i.e. all fixed images except the first, are interpolated once per set of
+ * samples, instead of every iteration.
  *
  * \ingroup RegistrationMetrics
  *
@@ -314,6 +325,28 @@ public:
 
   /** ******************** Other public functions ******************** */
 
+  /** Select whether Initialize() stores the B-spline coefficients of all
+   * moving images interleaved per voxel, for
+   * EvaluateMovingImageValuesAndDerivatives(). This needs memory for a
+   * double per voxel per moving image, in addition to the interpolators.
+   * It is only used for moving images with the same geometry, and B-spline
+   * interpolators of the same order, from 1 to 3. Default: false.
+   */
+  itkSetMacro( UseInterleavedMovingImageCoefficients, bool );
+  itkGetConstMacro( UseInterleavedMovingImageCoefficients, bool );
+  itkBooleanMacro( UseInterleavedMovingImageCoefficients );
+
+  /** Select whether to cache the values of the fixed feature images at the
+   * samples. These values only change when the sampler generates new
+   * samples, so with a full or grid sampler, or with NewSamplesEveryIteration
+   * set to false, the fixed feature images are interpolated once instead of
+   * every iteration. The cache costs a double per sample per fixed feature
+   * image; default: false.
+   */
+  itkSetMacro( UseFixedFeatureImageCache, bool );
+  itkGetConstMacro( UseFixedFeatureImageCache, bool );
+  itkBooleanMacro( UseFixedFeatureImageCache );
+
   /** Initialisation. */
   void Initialize( void ) override;
 
@@ -330,6 +363,8 @@ protected:
   typedef typename Superclass::MovingImageIndexType           MovingImageIndexType;
   typedef typename Superclass::MovingImageDerivativeType      MovingImageDerivativeType;
   typedef typename Superclass::MovingImageContinuousIndexType MovingImageContinuousIndexType;
+  typedef typename Superclass::FixedImagePointType            FixedImagePointType;
+  typedef typename Superclass::ImageSampleContainerType       ImageSampleContainerType;
 
   /** Typedef's for the moving image interpolators. */
   typedef typename Superclass::BSplineInterpolatorType BSplineInterpolatorType;
@@ -352,6 +387,35 @@ protected:
     RealType & movingImageValue,
     MovingImageDerivativeType * gradient ) const override;
 
+  /** Compute the values, and the derivatives if gradients is not null, of
+   * all moving images at mappedPoint, without the moving image derivative
+   * scales. Returns false if mappedPoint is outside a moving image buffer.
+   */
+  bool EvaluateMovingImageValuesAndDerivatives(
+    const MovingImagePointType & mappedPoint,
+    RealType * values,
+    MovingImageDerivativeType * gradients ) const;
+
+  /** Interpolate the fixed feature images at the current samples, if
+   * UseFixedFeatureImageCache is true and the cache is out of date. Must be
+   * called after the sampler has been updated.
+   */
+  void UpdateFixedFeatureImageCache( void ) const;
+
+  /** Get the values of the fixed images 1 to NumberOfFixedImages - 1 at the
+   * sample with the given index in the sample container, or null if they are
+   * not cached.
+   */
+  const double * GetCachedFixedFeatureImageValues( const SizeValueType sampleIndex ) const
+  {
+    if( !this->m_FixedFeatureImageCacheIsValid )
+    {
+      return nullptr;
+    }
+    return &this->m_FixedFeatureImageCache[ sampleIndex * ( this->m_NumberOfFixedImages - 1 ) ];
+  }
+
+
   /** IsInsideMovingMask: Returns the AND of all moving image masks. */
   bool IsInsideMovingMask(
     const MovingImagePointType & mappedPoint ) const override;
@@ -373,9 +437,38 @@ private:
   MultiInputImageToImageMetricBase( const Self & ); // purposely not implemented
   void operator=( const Self & );                   // purposely not implemented
 
+  /** Store the interleaved B-spline coefficients, if selected and possible. */
+  void InitializeInterleavedCoefficients( void );
+
+  /** Map an index relative to the buffer start into [0, length) with the
+   * mirror boundary conditions of the B-spline interpolators.
+   */
+  static OffsetValueType MirrorIndex( OffsetValueType index, const OffsetValueType length );
+
   /** Private member variables. */
   FixedImageRegionType m_DummyFixedImageRegion;
 
+  /** The interleaved B-spline coefficients: the coefficients of all moving
+   * images at voxel v start at m_InterleavedCoefficients[ v * NumberOfMovingImages ].
+   */
+  typedef FixedArray< OffsetValueType, MovingImageDimension > OffsetArrayType;
+  bool                                   m_UseInterleavedMovingImageCoefficients;
+  std::vector< double >                  m_InterleavedCoefficients;
+  unsigned int                           m_InterleavedSplineOrder;
+  KernelFunctionBase2< double >::Pointer m_InterleavedKernel;
+  KernelFunctionBase2< double >::Pointer m_InterleavedDerivativeKernel;
+  OffsetArrayType                        m_InterleavedBufferStart;
+  OffsetArrayType                        m_InterleavedBufferLength;
+  OffsetArrayType                        m_InterleavedStrides;
+
+  /** The values of the fixed feature images at the samples, stored per
+   * sample, and the update time of the samples for which they were computed.
+   */
+  bool                          m_UseFixedFeatureImageCache;
+  mutable std::vector< double > m_FixedFeatureImageCache;
+  mutable ModifiedTimeType      m_FixedFeatureImageCacheSampleTime;
+  mutable bool                  m_FixedFeatureImageCacheIsValid;
+
   unsigned int m_NumberOfFixedImages;
   unsigned int m_NumberOfFixedImageMasks;
   unsigned int m_NumberOfFixedImageRegions;
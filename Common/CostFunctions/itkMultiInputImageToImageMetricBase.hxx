@@ -19,6 +19,12 @@
 #define _itkMultiInputImageToImageMetricBase_hxx
 
 #include "itkMultiInputImageToImageMetricBase.h"
+#include "itkMultiThreadedBSplineDecompositionImageFilter.h"
+#include "itkBSplineDerivativeKernelFunction2.h"
+#include "itkBSplineKernelFunction2.h"
+
+#include <algorithm>
+#include <cmath>
 
 /** Macros to reduce some copy-paste work.
  * These macros provide the implementation of
@@ -116,7 +122,12 @@ MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
   this->m_NumberOfInterpolators           = 0;
   this->m_NumberOfFixedImageInterpolators = 0;
 
-  this->m_InterpolatorsAreBSpline = false;
+  this->m_InterpolatorsAreBSpline               = false;
+  this->m_UseInterleavedMovingImageCoefficients = false;
+  this->m_InterleavedSplineOrder                = 0;
+  this->m_UseFixedFeatureImageCache             = false;
+  this->m_FixedFeatureImageCacheSampleTime      = 0;
+  this->m_FixedFeatureImageCacheIsValid         = false;
 
 } // end Constructor()
 
@@ -248,12 +259,167 @@ MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
   /** Check for B-spline interpolators. */
   this->CheckForBSplineInterpolators();
 
+  /** Interleave the B-spline coefficients of the moving images. */
+  this->InitializeInterleavedCoefficients();
+
+  /** The fixed images may have changed. */
+  this->m_FixedFeatureImageCacheIsValid = false;
+
   /** Call the superclass' implementation. */
   this->Superclass::Initialize();
 
 } // end Initialize()
 
 
+/**
+ * ****************** InitializeInterleavedCoefficients **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
+::InitializeInterleavedCoefficients( void )
+{
+  this->m_InterleavedCoefficients.clear();
+  this->m_InterleavedKernel           = nullptr;
+  this->m_InterleavedDerivativeKernel = nullptr;
+  if( !this->m_UseInterleavedMovingImageCoefficients || !this->m_InterpolatorsAreBSpline
+    || this->m_NumberOfMovingImages < 2 )
+  {
+    return;
+  }
+
+  /** All moving images should have the same geometry and spline order. */
+  const MovingImageType *                      firstImage  = this->m_MovingImageVector[ 0 ];
+  const typename MovingImageType::RegionType & region      = firstImage->GetBufferedRegion();
+  const unsigned int                           splineOrder = this->m_BSplineInterpolatorVector[ 0 ]->GetSplineOrder();
+  if( splineOrder < 1 || splineOrder > 3 )
+  {
+    itkDebugMacro( << "Spline order " << splineOrder << " is not interleaved." );
+    return;
+  }
+  for( unsigned int i = 1; i < this->m_NumberOfMovingImages; ++i )
+  {
+    const MovingImageType * image = this->m_MovingImageVector[ i ];
+    if( image->GetBufferedRegion() != region
+      || image->GetOrigin() != firstImage->GetOrigin()
+      || image->GetSpacing() != firstImage->GetSpacing()
+      || image->GetDirection() != firstImage->GetDirection()
+      || this->m_BSplineInterpolatorVector[ i ]->GetSplineOrder() != splineOrder )
+    {
+      itkDebugMacro( << "Moving image " << i << " differs from moving image 0, "
+                     << "so the coefficients are not interleaved." );
+      return;
+    }
+  }
+
+  /** Compute the B-spline coefficients of each image, and store them interleaved. */
+  typedef Image< double, MovingImageDimension > CoefficientImageType;
+  typedef MultiThreadedBSplineDecompositionImageFilter<
+    MovingImageType, CoefficientImageType >     DecompositionFilterType;
+
+  const unsigned int    numberOfImages = this->m_NumberOfMovingImages;
+  const SizeValueType   numberOfVoxels = region.GetNumberOfPixels();
+  std::vector< double > coefficients( numberOfVoxels * numberOfImages );
+  for( unsigned int i = 0; i < numberOfImages; ++i )
+  {
+    typename DecompositionFilterType::Pointer filter = DecompositionFilterType::New();
+    filter->SetSplineOrder( splineOrder );
+    filter->SetInput( this->m_MovingImageVector[ i ] );
+    filter->Update();
+    if( filter->GetOutput()->GetBufferedRegion() != region )
+    {
+      return;
+    }
+    const double * imageCoefficients = filter->GetOutput()->GetBufferPointer();
+    for( SizeValueType v = 0; v < numberOfVoxels; ++v )
+    {
+      coefficients[ v * numberOfImages + i ] = imageCoefficients[ v ];
+    }
+  }
+  this->m_InterleavedCoefficients.swap( coefficients );
+
+  OffsetValueType stride = 1;
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    this->m_InterleavedBufferStart[ d ]  = region.GetIndex()[ d ];
+    this->m_InterleavedBufferLength[ d ] = static_cast< OffsetValueType >( region.GetSize()[ d ] );
+    this->m_InterleavedStrides[ d ]      = stride;
+    stride                              *= this->m_InterleavedBufferLength[ d ];
+  }
+
+  this->m_InterleavedSplineOrder = splineOrder;
+  switch( splineOrder )
+  {
+    case 1:
+      this->m_InterleavedKernel           = BSplineKernelFunction2< 1 >::New();
+      this->m_InterleavedDerivativeKernel = BSplineDerivativeKernelFunction2< 1 >::New();
+      break;
+    case 2:
+      this->m_InterleavedKernel           = BSplineKernelFunction2< 2 >::New();
+      this->m_InterleavedDerivativeKernel = BSplineDerivativeKernelFunction2< 2 >::New();
+      break;
+    default:
+      this->m_InterleavedKernel           = BSplineKernelFunction2< 3 >::New();
+      this->m_InterleavedDerivativeKernel = BSplineDerivativeKernelFunction2< 3 >::New();
+      break;
+  }
+
+} // end InitializeInterleavedCoefficients()
+
+
+/**
+ * ****************** UpdateFixedFeatureImageCache **********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
+::UpdateFixedFeatureImageCache( void ) const
+{
+  if( !this->m_UseFixedFeatureImageCache || this->GetNumberOfFixedImages() < 2 )
+  {
+    this->m_FixedFeatureImageCacheIsValid = false;
+    return;
+  }
+
+  /** Only rebuild the cache for new samples. */
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  if( this->m_FixedFeatureImageCacheIsValid
+    && this->m_FixedFeatureImageCacheSampleTime == sampleContainer->GetUpdateMTime() )
+  {
+    return;
+  }
+
+  const SizeValueType numberOfSamples  = sampleContainer->Size();
+  const unsigned int  numberOfFeatures = this->GetNumberOfFixedImages() - 1;
+  this->m_FixedFeatureImageCache.resize( numberOfSamples * numberOfFeatures );
+
+  /** Interpolate the fixed feature images in a chunk of samples per work unit. */
+  const unsigned int  numberOfChunks = Self::GetNumberOfReductionChunks();
+  const SizeValueType chunkSize      = ( numberOfSamples + numberOfChunks - 1 ) / numberOfChunks;
+  this->ProcessSlices( numberOfChunks, true,
+    [this, sampleContainer, numberOfSamples, numberOfFeatures, chunkSize]( const unsigned int chunk )
+    {
+      const SizeValueType chunkBegin = std::min( chunk * chunkSize, numberOfSamples );
+      const SizeValueType chunkEnd   = std::min( chunkBegin + chunkSize, numberOfSamples );
+      for( SizeValueType i = chunkBegin; i < chunkEnd; ++i )
+      {
+        const FixedImagePointType & fixedPoint = sampleContainer->ElementAt( i ).m_ImageCoordinates;
+        double *                    values     = &this->m_FixedFeatureImageCache[ i * numberOfFeatures ];
+        for( unsigned int j = 0; j < numberOfFeatures; ++j )
+        {
+          values[ j ] = this->m_FixedImageInterpolatorVector[ j + 1 ]->Evaluate( fixedPoint );
+        }
+      }
+    } );
+
+  this->m_FixedFeatureImageCacheSampleTime = sampleContainer->GetUpdateMTime();
+  this->m_FixedFeatureImageCacheIsValid    = true;
+
+} // end UpdateFixedFeatureImageCache()
+
+
 /**
  * ********************* InitializeImageSampler ****************************
  */
@@ -271,6 +437,14 @@ MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
       itkExceptionMacro( << "ImageSampler is not present" );
     }
 
+    /** Ignoring the importance weights would bias the metric. */
+    if( this->m_ImageSampler->GetUseSampleWeights() && !this->GetUseImageSampleWeights() )
+    {
+      itkExceptionMacro( << "ERROR: the image sampler "
+                         << this->m_ImageSampler->GetNameOfClass()
+                         << " produces importance weights, which are not supported by this metric." );
+    }
+
     /** Initialize the Image Sampler: set the fixed images. */
     for( unsigned int i = 0; i < this->GetNumberOfFixedImages(); ++i )
     {
@@ -322,6 +496,169 @@ MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
 } // end EvaluateMovingImageValueAndDerivative()
 
 
+/**
+ * ******************* EvaluateMovingImageValuesAndDerivatives ******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
+::EvaluateMovingImageValuesAndDerivatives(
+  const MovingImagePointType & mappedPoint,
+  RealType * values,
+  MovingImageDerivativeType * gradients ) const
+{
+  const unsigned int numberOfImages = this->m_NumberOfMovingImages;
+
+  /** Without interleaved coefficients, evaluate the interpolators one by one. */
+  if( this->m_InterleavedCoefficients.empty() )
+  {
+    for( unsigned int i = 0; i < numberOfImages; ++i )
+    {
+      if( !this->m_InterpolatorVector[ i ]->IsInsideBuffer( mappedPoint ) )
+      {
+        return false;
+      }
+      values[ i ] = this->m_InterpolatorVector[ i ]->Evaluate( mappedPoint );
+      if( gradients )
+      {
+        gradients[ i ] = this->m_BSplineInterpolatorVector[ i ]->EvaluateDerivative( mappedPoint );
+      }
+    }
+    return true;
+  }
+
+  /** The moving images have the same geometry, so one check suffices. */
+  if( !this->m_InterpolatorVector[ 0 ]->IsInsideBuffer( mappedPoint ) )
+  {
+    return false;
+  }
+  MovingImageContinuousIndexType cindex;
+  this->m_InterpolatorVector[ 0 ]->ConvertPointToContinuousIndex( mappedPoint, cindex );
+
+  /** Compute the weights and the offsets of the support once for all images. */
+  const unsigned int splineOrder = this->m_InterleavedSplineOrder;
+  const unsigned int supportSize = splineOrder + 1;
+  double             weights[ MovingImageDimension ][ 4 ];
+  double             derivativeWeights[ MovingImageDimension ][ 4 ];
+  OffsetValueType    offsets[ MovingImageDimension ][ 4 ];
+  unsigned int       numberOfSupportPoints = 1;
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    const double          x     = cindex[ d ];
+    const OffsetValueType start = static_cast< OffsetValueType >(
+      std::floor( splineOrder % 2 == 1 ? x : x + 0.5 ) ) - splineOrder / 2;
+    const double u = x - static_cast< double >( start );
+    this->m_InterleavedKernel->Evaluate( u, weights[ d ] );
+    if( gradients )
+    {
+      this->m_InterleavedDerivativeKernel->Evaluate( u, derivativeWeights[ d ] );
+    }
+    for( unsigned int k = 0; k < supportSize; ++k )
+    {
+      offsets[ d ][ k ] = this->m_InterleavedStrides[ d ] * MirrorIndex(
+        start + k - this->m_InterleavedBufferStart[ d ], this->m_InterleavedBufferLength[ d ] );
+    }
+    numberOfSupportPoints *= supportSize;
+  }
+
+  std::fill( values, values + numberOfImages, 0.0 );
+  if( gradients )
+  {
+    std::fill( gradients, gradients + numberOfImages, MovingImageDerivativeType( 0.0 ) );
+  }
+
+  /** Gather the coefficients of all images at each point of the support. */
+  unsigned int supportIndex[ MovingImageDimension ] = {};
+  for( unsigned int p = 0; p < numberOfSupportPoints; ++p )
+  {
+    OffsetValueType offset = 0;
+    double          weight = 1.0;
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      offset += offsets[ d ][ supportIndex[ d ] ];
+      weight *= weights[ d ][ supportIndex[ d ] ];
+    }
+
+    const double * coefficients = this->m_InterleavedCoefficients.data() + offset * numberOfImages;
+    for( unsigned int i = 0; i < numberOfImages; ++i )
+    {
+      values[ i ] += weight * coefficients[ i ];
+    }
+
+    if( gradients )
+    {
+      for( unsigned int d = 0; d < MovingImageDimension; ++d )
+      {
+        double derivativeWeight = 1.0;
+        for( unsigned int d1 = 0; d1 < MovingImageDimension; ++d1 )
+        {
+          derivativeWeight *= d1 == d
+            ? derivativeWeights[ d1 ][ supportIndex[ d1 ] ] : weights[ d1 ][ supportIndex[ d1 ] ];
+        }
+        for( unsigned int i = 0; i < numberOfImages; ++i )
+        {
+          gradients[ i ][ d ] += derivativeWeight * coefficients[ i ];
+        }
+      }
+    }
+
+    /** Step to the next point of the support. */
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      if( ++supportIndex[ d ] < supportSize )
+      {
+        break;
+      }
+      supportIndex[ d ] = 0;
+    }
+  }
+
+  /** Take the spacing and the direction into account, like the interpolators. */
+  if( gradients )
+  {
+    const MovingImageType * image = this->m_MovingImageVector[ 0 ];
+    for( unsigned int i = 0; i < numberOfImages; ++i )
+    {
+      for( unsigned int d = 0; d < MovingImageDimension; ++d )
+      {
+        gradients[ i ][ d ] /= image->GetSpacing()[ d ];
+      }
+      MovingImageDerivativeType orientedGradient;
+      image->TransformLocalVectorToPhysicalVector( gradients[ i ], orientedGradient );
+      gradients[ i ] = orientedGradient;
+    }
+  }
+
+  return true;
+
+} // end EvaluateMovingImageValuesAndDerivatives()
+
+
+/**
+ * ************************ MirrorIndex *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+OffsetValueType
+MultiInputImageToImageMetricBase< TFixedImage, TMovingImage >
+::MirrorIndex( OffsetValueType index, const OffsetValueType length )
+{
+  if( length == 1 )
+  {
+    return 0;
+  }
+  const OffsetValueType period = 2 * length - 2;
+  index %= period;
+  if( index < 0 )
+  {
+    index += period;
+  }
+  return index < length ? index : period - index;
+
+} // end MirrorIndex()
+
+
 /**
  * ************************ IsInsideMovingMask *************************
  */
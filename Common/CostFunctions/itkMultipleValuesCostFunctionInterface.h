@@ -0,0 +1,78 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMultipleValuesCostFunctionInterface_h
+#define __itkMultipleValuesCostFunctionInterface_h
+
+#include "itkSingleValuedCostFunction.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class MultipleValuesCostFunctionInterface
+ *
+ * \brief Interface of the cost functions that can compute their value, or
+ * their value and derivative, at several parameter vectors in one call.
+ *
+ * The finite difference optimizers need the value of the cost function at
+ * many perturbed parameter vectors, and a line search may try several step
+ * lengths at once. A cost function that implements this interface may compute
+ * these concurrently, which GetValue() cannot, because it sets the parameters
+ * of a shared transform. The results are identical to the ones of GetValue()
+ * and GetValueAndDerivative() for each parameter vector. The optimizers find
+ * the interface by a dynamic_cast of the cost function.
+ *
+ * \ingroup Metrics
+ */
+
+class MultipleValuesCostFunctionInterface
+{
+public:
+
+  /** The parameter vectors and their values. The element typedefs of the
+   * cost functions are not repeated, to avoid ambiguities in the classes that
+   * implement this interface.
+   */
+  typedef std::vector< SingleValuedCostFunction::ParametersType > ParametersVectorType;
+  typedef std::vector< SingleValuedCostFunction::MeasureType >    MeasureVectorType;
+  typedef std::vector< SingleValuedCostFunction::DerivativeType > DerivativeVectorType;
+
+  /** Compute values[ i ] as the value at parameters[ i ], for all i. */
+  virtual void GetValues( const ParametersVectorType & parameters,
+    MeasureVectorType & values ) const = 0;
+
+  /** Compute values[ i ] and derivatives[ i ] at parameters[ i ], for all i. */
+  virtual void GetValuesAndDerivatives( const ParametersVectorType & parameters,
+    MeasureVectorType & values, DerivativeVectorType & derivatives ) const = 0;
+
+protected:
+
+  MultipleValuesCostFunctionInterface() {}
+  virtual ~MultipleValuesCostFunctionInterface() {}
+
+private:
+
+  MultipleValuesCostFunctionInterface( const MultipleValuesCostFunctionInterface & ); // purposely not implemented
+  void operator=( const MultipleValuesCostFunctionInterface & );                      // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMultipleValuesCostFunctionInterface_h
@@ -215,6 +215,33 @@ public:
   itkSetMacro( FiniteDifferencePerturbation, double );
   itkGetConstMacro( FiniteDifferencePerturbation, double );
 
+  /** Whether the multi-threaded joint histogram should be computed using
+   * shards, instead of thread private histograms. In the default mode every
+   * thread fills a full private joint histogram, which are summed afterwards
+   * by a single thread. In the sharded mode the (limited) fixed and moving image
+   * values of the samples are computed first, after which each thread fills a
+   * disjoint band of fixed image bins of the shared joint histogram. This
+   * avoids the private histograms and the serial merge step, and the
+   * result is bit-identical to the single-threaded computation.
+   * This option should be set before calling Initialize(); Default: false.
+   */
+  itkSetMacro( UseShardedPDFAccumulation, bool );
+  itkGetConstMacro( UseShardedPDFAccumulation, bool );
+  itkBooleanMacro( UseShardedPDFAccumulation );
+
+  /** Whether to cache the lowest affected fixed histogram bin and the fixed
+   * Parzen values of every sample. The fixed image values of the samples only
+   * change when the sampler generates new samples, so with a full or grid
+   * sampler, or with NewSamplesEveryIteration set to false, the fixed Parzen
+   * window is evaluated once instead of every iteration. The joint histogram
+   * and the low memory derivative of the mutual information use the cache.
+   * The results are identical to the uncached computation. The cache costs
+   * ( FixedKernelBSplineOrder + 2 ) numbers per sample; default: false.
+   */
+  itkSetMacro( UseFixedParzenWindowCache, bool );
+  itkGetConstMacro( UseFixedParzenWindowCache, bool );
+  itkBooleanMacro( UseFixedParzenWindowCache );
+
 protected:
 
   /** The constructor. */
@@ -292,6 +319,9 @@ protected:
   double                        m_FixedParzenTermToIndexOffset;
   double                        m_MovingParzenTermToIndexOffset;
 
+  /** The memory of m_JointPDFDerivatives, which is kept over the resolutions. */
+  ReusableBuffer< PDFDerivativeValueType > m_JointPDFDerivativesBuffer;
+
   /** Kernels for computing Parzen histograms and derivatives. */
   KernelFunctionPointer m_FixedKernel;
   KernelFunctionPointer m_MovingKernel;
@@ -321,6 +351,42 @@ protected:
   mutable AlignedParzenWindowHistogramGetValueAndDerivativePerThreadStruct * m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables;
   mutable ThreadIdType                                                       m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariablesSize;
 
+  /** The limited fixed and moving image values of all samples, as used by the
+   * sharded joint histogram accumulation.
+   */
+  struct ParzenWindowHistogramSampleValuesType
+  {
+    RealType m_FixedImageValue;
+    RealType m_MovingImageValue;
+    bool     m_SampleOk;
+  };
+  mutable std::vector< ParzenWindowHistogramSampleValuesType > m_ParzenWindowHistogramSampleValues;
+
+  /** The lowest affected fixed histogram bin and the fixed Parzen values of
+   * every sample, stored per sample, and the update time of the samples for
+   * which they were computed.
+   */
+  mutable std::vector< OffsetValueType > m_FixedParzenWindowIndices;
+  mutable std::vector< PDFValueType >    m_FixedParzenWindowValues;
+  mutable ModifiedTimeType               m_FixedParzenWindowCacheSampleTime;
+  mutable bool                           m_FixedParzenWindowCacheIsValid;
+
+  /** Compute the fixed Parzen windows of the current samples, if
+   * UseFixedParzenWindowCache is true and the cache is out of date. Must be
+   * called after the sampler has been updated.
+   */
+  void UpdateFixedParzenWindowCache( void ) const;
+
+  /** Get the lowest fixed histogram bin affected by a sample and its fixed
+   * Parzen values, which is supposed to have the right size already. They are
+   * read from the cache if it is up to date, and computed from the limited
+   * fixed image value otherwise.
+   */
+  void EvaluateFixedParzenWindow(
+    const RealType & fixedImageValue, const SizeValueType sampleIndex,
+    OffsetValueType & fixedParzenWindowIndex,
+    ParzenValueContainerType & fixedParzenValues ) const;
+
   /** Initialize threading related parameters. */
   void InitializeThreadingParameters( void ) const override;
 
@@ -336,6 +402,25 @@ protected:
   /** Helper function to launch the threads. */
   void LaunchComputePDFsThreaderCallback( void ) const;
 
+  /** Multi-threaded computation of the sample values, used by the sharded
+   * joint histogram accumulation.
+   */
+  inline void ThreadedComputePDFSampleValues( ThreadIdType threadId );
+
+  /** Multi-threaded accumulation of a band of fixed image bins of the joint
+   * histogram, using the sample values computed by ThreadedComputePDFSampleValues.
+   */
+  inline void ThreadedAccumulateJointPDFShard( ThreadIdType threadId );
+
+  /** Helper function to launch the threads. */
+  static ITK_THREAD_RETURN_TYPE ComputePDFSampleValuesThreaderCallback( void * arg );
+
+  /** Helper function to launch the threads. */
+  static ITK_THREAD_RETURN_TYPE AccumulateJointPDFShardThreaderCallback( void * arg );
+
+  /** Compute the joint histogram multi-threadedly using shards. */
+  void ComputePDFsSharded( void ) const;
+
   /** Compute the Parzen values given an image value and a starting histogram index
    * Compute the values at (parzenWindowIndex - parzenWindowTerm + k) for
    * k = 0 ... kernelsize-1
@@ -347,6 +432,32 @@ protected:
     const KernelFunctionType * kernel,
     ParzenValueContainerType & parzenValues ) const;
 
+  /** The maximum number of samples that is processed at once by UpdateJointPDFBlock(). */
+  itkStaticConstMacro( ParzenWindowBlockSize, unsigned int, 64 );
+
+  /** Evaluate the Parzen values for a block of kernel arguments at once.
+   * The kernel type is resolved at compile time from the spline order, which
+   * avoids a virtual call per sample and allows the compiler to vectorize
+   * the loop. The values of argument i are stored at parzenValues[ i * ( splineOrder + 1 ) ].
+   */
+  void EvaluateParzenValuesBlock(
+    const double * arguments, unsigned int numberOfArguments,
+    const KernelFunctionType * kernel, unsigned int splineOrder,
+    double * parzenValues ) const;
+
+  /** Update the joint PDF with a block of at most ParzenWindowBlockSize pixel pairs.
+   * Only the fixed image bins in the range [fixedBinBegin, fixedBinEnd) are
+   * updated. The contributions are added in the same order as by
+   * UpdateJointPDFAndDerivatives(), so the results are bit-identical.
+   * If sampleIndices is nonzero, the fixed Parzen windows of these samples
+   * are read from the fixed Parzen window cache.
+   */
+  void UpdateJointPDFBlock(
+    const RealType * fixedImageValues, const RealType * movingImageValues,
+    unsigned int numberOfValues,
+    OffsetValueType fixedBinBegin, OffsetValueType fixedBinEnd,
+    JointPDFType * jointPDF, const SizeValueType * sampleIndices ) const;
+
   /** Update the joint PDF with a pixel pair; on demand also updates the
    * pdf derivatives (if the Jacobian pointers are nonzero).
    */
@@ -497,6 +608,8 @@ private:
   bool          m_UseExplicitPDFDerivatives;
   bool          m_UseFiniteDifferenceDerivative;
   double        m_FiniteDifferencePerturbation;
+  bool          m_UseShardedPDFAccumulation;
+  bool          m_UseFixedParzenWindowCache;
 
 };
 
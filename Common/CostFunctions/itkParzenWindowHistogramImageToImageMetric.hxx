@@ -25,6 +25,7 @@
 #include "itkImageLinearIteratorWithIndex.h"
 #include "itkImageScanlineIterator.h"
 #include "vnl/vnl_math.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -62,10 +63,16 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   this->m_UseDerivative                 = false;
   this->m_UseFiniteDifferenceDerivative = false;
   this->m_FiniteDifferencePerturbation  = 1.0;
+  this->m_UseShardedPDFAccumulation     = false;
+  this->m_UseFixedParzenWindowCache     = false;
+
+  this->m_FixedParzenWindowCacheSampleTime = 0;
+  this->m_FixedParzenWindowCacheIsValid    = false;
 
   this->SetUseImageSampler( true );
   this->SetUseFixedImageLimiter( true );
   this->SetUseMovingImageLimiter( true );
+  this->SetSupportsConcurrentEvaluation( true );
 
   this->m_UseExplicitPDFDerivatives = true;
 
@@ -112,6 +119,10 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
      << this->m_FixedKernelBSplineOrder << std::endl;
   os << indent << "MovingKernelBSplineOrder: "
      << this->m_MovingKernelBSplineOrder << std::endl;
+  os << indent << "UseShardedPDFAccumulation: "
+     << this->m_UseShardedPDFAccumulation << std::endl;
+  os << indent << "UseFixedParzenWindowCache: "
+     << this->m_UseFixedParzenWindowCache << std::endl;
 
   /*double m_MovingImageNormalizedMin;
   double m_FixedImageNormalizedMin;
@@ -147,6 +158,11 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   /** Set up the Parzen windows. */
   this->InitializeKernels();
 
+  /** The bins and the fixed image limiter may have changed. */
+  this->m_FixedParzenWindowCacheIsValid = false;
+  this->m_FixedParzenWindowIndices.clear();
+  this->m_FixedParzenWindowValues.clear();
+
   /** If the user plans to use a finite difference derivative,
    * allocate some memory for the perturbed alpha variables.
    */
@@ -283,6 +299,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     if( this->GetUseFiniteDifferenceDerivative() )
     {
       this->m_JointPDFDerivatives = 0;
+      this->m_JointPDFDerivativesBuffer.Release();
 
       this->m_IncrementalJointPDFRight = JointPDFDerivativesType::New();
       this->m_IncrementalJointPDFLeft  = JointPDFDerivativesType::New();
@@ -334,9 +351,16 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
         this->m_IncrementalJointPDFRight = 0;
         this->m_IncrementalJointPDFLeft  = 0;
 
+        /** The largest member of this class, which grows with the number of
+         * parameters in every resolution. Its buffer only grows, and comes from
+         * the pool that keeps the memory of the previous registration stages.
+         */
+        const SizeValueType numberOfPDFDerivatives = jointPDFDerivativesRegion.GetNumberOfPixels();
+        this->m_JointPDFDerivativesBuffer.SetSize( numberOfPDFDerivatives );
         this->m_JointPDFDerivatives = JointPDFDerivativesType::New();
         this->m_JointPDFDerivatives->SetRegions( jointPDFDerivativesRegion );
-        this->m_JointPDFDerivatives->Allocate();
+        this->m_JointPDFDerivatives->GetPixelContainer()->SetImportPointer(
+          this->m_JointPDFDerivativesBuffer.GetBufferPointer(), numberOfPDFDerivatives, false );
       }
       else
       {
@@ -350,6 +374,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
           this->m_JointPDFDerivatives->Allocate();
           this->m_JointPDFDerivatives->GetPixelContainer()->Squeeze();
         }
+        this->m_JointPDFDerivativesBuffer.Release();
       }
     }
   }
@@ -358,6 +383,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     this->m_JointPDFDerivatives      = 0;
     this->m_IncrementalJointPDFRight = 0;
     this->m_IncrementalJointPDFLeft  = 0;
+    this->m_JointPDFDerivativesBuffer.Release();
   }
 
 } // end InitializeHistograms()
@@ -470,7 +496,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   jointPDFRegion.SetIndex( jointPDFIndex );
   jointPDFRegion.SetSize( jointPDFSize );
 
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Only resize the array of structs when needed. */
   if( this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariablesSize != numberOfThreads )
@@ -487,8 +513,14 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   {
     this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = NumericTraits< SizeValueType >::Zero;
 
-    // Initialize the joint pdf
+    // Initialize the joint pdf. The sharded accumulation does not need the
+    // thread private histograms, so release them in that case.
     JointPDFPointer & jointPDF = this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_JointPDF;
+    if( this->m_UseShardedPDFAccumulation )
+    {
+      jointPDF = nullptr;
+      continue;
+    }
     if( jointPDF.IsNull() ) { jointPDF = JointPDFType::New(); }
     if( jointPDF->GetLargestPossibleRegion() != jointPDFRegion )
     {
@@ -554,6 +586,232 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 } // end EvaluateParzenValues()
 
 
+/**
+ * ********************** EvaluateParzenValuesBlock ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateParzenValuesBlock(
+  const double * arguments, unsigned int numberOfArguments,
+  const KernelFunctionType * kernel, unsigned int splineOrder,
+  double * parzenValues ) const
+{
+  /** The kernels are created in InitializeKernels() according to the spline order. */
+  switch( splineOrder )
+  {
+    case 0:
+      static_cast< const BSplineKernelFunction2< 0 > * >( kernel )
+        ->EvaluateBlock( arguments, parzenValues, numberOfArguments ); break;
+    case 1:
+      static_cast< const BSplineKernelFunction2< 1 > * >( kernel )
+        ->EvaluateBlock( arguments, parzenValues, numberOfArguments ); break;
+    case 2:
+      static_cast< const BSplineKernelFunction2< 2 > * >( kernel )
+        ->EvaluateBlock( arguments, parzenValues, numberOfArguments ); break;
+    case 3:
+      static_cast< const BSplineKernelFunction2< 3 > * >( kernel )
+        ->EvaluateBlock( arguments, parzenValues, numberOfArguments ); break;
+    default:
+      itkExceptionMacro( << "The following BSplineOrder is not implemented: " << splineOrder );
+  }
+
+} // end EvaluateParzenValuesBlock()
+
+
+/**
+ * ********************** UpdateJointPDFBlock ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateJointPDFBlock(
+  const RealType * fixedImageValues, const RealType * movingImageValues,
+  unsigned int numberOfValues,
+  OffsetValueType fixedBinBegin, OffsetValueType fixedBinEnd,
+  JointPDFType * jointPDF, const SizeValueType * sampleIndices ) const
+{
+  const OffsetValueType fixedWindowSize  = static_cast< OffsetValueType >( this->m_JointPDFWindow.GetSize()[ 1 ] );
+  const OffsetValueType movingWindowSize = static_cast< OffsetValueType >( this->m_JointPDFWindow.GetSize()[ 0 ] );
+
+  /** Determine the Parzen window indices and kernel arguments of the whole block. */
+  OffsetValueType fixedParzenWindowIndices[ ParzenWindowBlockSize ];
+  OffsetValueType movingParzenWindowIndices[ ParzenWindowBlockSize ];
+  double          fixedArguments[ ParzenWindowBlockSize ];
+  double          movingArguments[ ParzenWindowBlockSize ];
+  for( unsigned int i = 0; i < numberOfValues; ++i )
+  {
+    /** Determine Parzen window arguments (see eq. 6 of Mattes paper [2]). */
+    const double movingImageParzenWindowTerm
+      = movingImageValues[ i ] / this->m_MovingImageBinSize - this->m_MovingImageNormalizedMin;
+
+    /** The lowest bin numbers affected by this pixel: */
+    movingParzenWindowIndices[ i ] = static_cast< OffsetValueType >( std::floor(
+      movingImageParzenWindowTerm + this->m_MovingParzenTermToIndexOffset ) );
+    movingArguments[ i ] = static_cast< double >( movingParzenWindowIndices[ i ] ) - movingImageParzenWindowTerm;
+  }
+
+  /** Evaluate the Parzen values of the whole block at once. */
+  double fixedParzenValues[ ParzenWindowBlockSize * 4 ];
+  double movingParzenValues[ ParzenWindowBlockSize * 4 ];
+  if( sampleIndices )
+  {
+    /** Gather the fixed Parzen windows of the samples from the cache. */
+    for( unsigned int i = 0; i < numberOfValues; ++i )
+    {
+      const PDFValueType * cachedValues
+        = &this->m_FixedParzenWindowValues[ sampleIndices[ i ] * fixedWindowSize ];
+      fixedParzenWindowIndices[ i ] = this->m_FixedParzenWindowIndices[ sampleIndices[ i ] ];
+      std::copy( cachedValues, cachedValues + fixedWindowSize, fixedParzenValues + i * fixedWindowSize );
+    }
+  }
+  else
+  {
+    for( unsigned int i = 0; i < numberOfValues; ++i )
+    {
+      const double fixedImageParzenWindowTerm
+        = fixedImageValues[ i ] / this->m_FixedImageBinSize - this->m_FixedImageNormalizedMin;
+      fixedParzenWindowIndices[ i ] = static_cast< OffsetValueType >( std::floor(
+        fixedImageParzenWindowTerm + this->m_FixedParzenTermToIndexOffset ) );
+      fixedArguments[ i ] = static_cast< double >( fixedParzenWindowIndices[ i ] ) - fixedImageParzenWindowTerm;
+    }
+    this->EvaluateParzenValuesBlock( fixedArguments, numberOfValues,
+      this->m_FixedKernel, this->m_FixedKernelBSplineOrder, fixedParzenValues );
+  }
+  this->EvaluateParzenValuesBlock( movingArguments, numberOfValues,
+    this->m_MovingKernel, this->m_MovingKernelBSplineOrder, movingParzenValues );
+
+  /** Loop over the Parzen window regions and increment the values.
+   * The joint histogram is stored with the moving image bins running fastest.
+   */
+  const OffsetValueType numberOfMovingBins = static_cast< OffsetValueType >( this->m_NumberOfMovingHistogramBins );
+  PDFValueType *        pdfBuffer          = jointPDF->GetBufferPointer();
+  for( unsigned int i = 0; i < numberOfValues; ++i )
+  {
+    const OffsetValueType fixedIndex = fixedParzenWindowIndices[ i ];
+    const OffsetValueType f_begin    = std::max( fixedBinBegin - fixedIndex, OffsetValueType( 0 ) );
+    const OffsetValueType f_end      = std::min( fixedBinEnd - fixedIndex, fixedWindowSize );
+    const double *        fvs        = fixedParzenValues + i * fixedWindowSize;
+    const double *        mvs        = movingParzenValues + i * movingWindowSize;
+    for( OffsetValueType f = f_begin; f < f_end; ++f )
+    {
+      const double   fv  = fvs[ f ];
+      PDFValueType * ptr = pdfBuffer
+        + ( fixedIndex + f ) * numberOfMovingBins + movingParzenWindowIndices[ i ];
+      for( OffsetValueType m = 0; m < movingWindowSize; ++m )
+      {
+        ptr[ m ] += static_cast< PDFValueType >( fv * mvs[ m ] );
+      }
+    }
+  }
+
+} // end UpdateJointPDFBlock()
+
+
+/**
+ * ********************** UpdateFixedParzenWindowCache ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::UpdateFixedParzenWindowCache( void ) const
+{
+  if( !this->m_UseFixedParzenWindowCache )
+  {
+    this->m_FixedParzenWindowCacheIsValid = false;
+    return;
+  }
+
+  /** Only rebuild the cache for new samples. */
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  if( this->m_FixedParzenWindowCacheIsValid
+    && this->m_FixedParzenWindowCacheSampleTime == sampleContainer->GetUpdateMTime() )
+  {
+    return;
+  }
+
+  const SizeValueType numberOfSamples = sampleContainer->Size();
+  const SizeValueType fixedWindowSize = this->m_JointPDFWindow.GetSize()[ 1 ];
+  this->m_FixedParzenWindowIndices.resize( numberOfSamples );
+  this->m_FixedParzenWindowValues.resize( numberOfSamples * fixedWindowSize );
+
+  /** Compute the fixed Parzen windows in blocks, in a chunk of samples per work unit. */
+  const unsigned int  numberOfChunks = Self::GetNumberOfReductionChunks();
+  const SizeValueType chunkSize      = ( numberOfSamples + numberOfChunks - 1 ) / numberOfChunks;
+  this->ProcessSlices( numberOfChunks, true,
+    [this, sampleContainer, numberOfSamples, fixedWindowSize, chunkSize]( const unsigned int chunk )
+    {
+      const SizeValueType chunkBegin = std::min( chunk * chunkSize, numberOfSamples );
+      const SizeValueType chunkEnd   = std::min( chunkBegin + chunkSize, numberOfSamples );
+      double              fixedArguments[ ParzenWindowBlockSize ];
+      for( SizeValueType blockBegin = chunkBegin; blockBegin < chunkEnd; blockBegin += ParzenWindowBlockSize )
+      {
+        const unsigned int blockSize = static_cast< unsigned int >(
+          std::min< SizeValueType >( chunkEnd - blockBegin, ParzenWindowBlockSize ) );
+        for( unsigned int i = 0; i < blockSize; ++i )
+        {
+          /** Make sure the value falls within the histogram range. */
+          const RealType fixedImageValue = this->GetFixedImageLimiter()->Evaluate(
+            static_cast< RealType >( sampleContainer->ElementAt( blockBegin + i ).m_ImageValue ) );
+          const double fixedImageParzenWindowTerm
+            = fixedImageValue / this->m_FixedImageBinSize - this->m_FixedImageNormalizedMin;
+          const OffsetValueType fixedParzenWindowIndex = static_cast< OffsetValueType >( std::floor(
+            fixedImageParzenWindowTerm + this->m_FixedParzenTermToIndexOffset ) );
+
+          this->m_FixedParzenWindowIndices[ blockBegin + i ] = fixedParzenWindowIndex;
+          fixedArguments[ i ] = static_cast< double >( fixedParzenWindowIndex ) - fixedImageParzenWindowTerm;
+        }
+        this->EvaluateParzenValuesBlock( fixedArguments, blockSize,
+          this->m_FixedKernel, this->m_FixedKernelBSplineOrder,
+          &this->m_FixedParzenWindowValues[ blockBegin * fixedWindowSize ] );
+      }
+    } );
+
+  this->m_FixedParzenWindowCacheSampleTime = sampleContainer->GetUpdateMTime();
+  this->m_FixedParzenWindowCacheIsValid    = true;
+
+} // end UpdateFixedParzenWindowCache()
+
+
+/**
+ * ********************** EvaluateFixedParzenWindow ***************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateFixedParzenWindow(
+  const RealType & fixedImageValue, const SizeValueType sampleIndex,
+  OffsetValueType & fixedParzenWindowIndex,
+  ParzenValueContainerType & fixedParzenValues ) const
+{
+  if( this->m_FixedParzenWindowCacheIsValid )
+  {
+    const SizeValueType  fixedWindowSize = fixedParzenValues.GetSize();
+    const PDFValueType * cachedValues    = &this->m_FixedParzenWindowValues[ sampleIndex * fixedWindowSize ];
+    fixedParzenWindowIndex = this->m_FixedParzenWindowIndices[ sampleIndex ];
+    std::copy( cachedValues, cachedValues + fixedWindowSize, fixedParzenValues.begin() );
+    return;
+  }
+
+  /** Determine the Parzen window argument (see eq. 6 of Mattes paper [2]). */
+  const double fixedImageParzenWindowTerm
+    = fixedImageValue / this->m_FixedImageBinSize - this->m_FixedImageNormalizedMin;
+
+  /** The lowest bin number affected by this pixel: */
+  fixedParzenWindowIndex = static_cast< OffsetValueType >( std::floor(
+    fixedImageParzenWindowTerm + this->m_FixedParzenTermToIndexOffset ) );
+
+  this->EvaluateParzenValues(
+    fixedImageParzenWindowTerm, fixedParzenWindowIndex,
+    this->m_FixedKernel, fixedParzenValues );
+
+} // end EvaluateFixedParzenWindow()
+
+
 /**
  * ********************** UpdateJointPDFAndDerivatives ***************
  */
@@ -1046,6 +1304,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
    * - Now you can call GetValueAndDerivative multi-threaded.
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
+  this->UpdateFixedParzenWindowCache();
 
   /** Get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
@@ -1064,7 +1323,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     MovingImagePointType        mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -1137,6 +1396,13 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
    * - Now you can call GetValueAndDerivative multi-threaded.
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
+  this->UpdateFixedParzenWindowCache();
+
+  /** Compute the joint histogram without thread private copies. */
+  if( this->m_UseShardedPDFAccumulation )
+  {
+    return this->ComputePDFsSharded();
+  }
 
   /** Launch multi-threading JointPDF computation. */
   this->LaunchComputePDFsThreaderCallback();
@@ -1170,67 +1436,92 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
   /** Get the samples for this thread. */
   const unsigned long nrOfSamplesPerThreads
     = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( Self::GetNumberOfWorkUnits() ) ) );
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
 
   unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
   unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
   pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
   pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
-  fbegin                                                 += (int)pos_begin;
-  fend                                                   += (int)pos_end;
-
   /** Create variables to store intermediate results. circumvent false sharing */
   unsigned long numberOfPixelsCounted = 0;
 
+  /** The samples are transformed per block, so that the transform can
+   * process a whole block of points at once. The valid samples are collected
+   * in blocks as well, so that the Parzen values of a whole block can be
+   * computed at once.
+   */
+  const OffsetValueType numberOfFixedBins = static_cast< OffsetValueType >( this->m_NumberOfFixedHistogramBins );
+  FixedImagePointType   fixedPoints[ ParzenWindowBlockSize ];
+  MovingImagePointType  mappedPoints[ ParzenWindowBlockSize ];
+  RealType              fixedImageValues[ ParzenWindowBlockSize ];
+  RealType              movingImageValues[ ParzenWindowBlockSize ];
+  SizeValueType         sampleIndices[ ParzenWindowBlockSize ];
+  bool                  samplesOk[ ParzenWindowBlockSize ];
+  unsigned int          blockSize = 0;
+
+  /** The fixed Parzen windows are read from the cache, if available. */
+  const SizeValueType * cachedSampleIndices = this->m_FixedParzenWindowCacheIsValid ? sampleIndices : nullptr;
+
   /** Loop over sample container and compute contribution of each sample to pdfs. */
-  for( fiter = fbegin; fiter != fend; ++fiter )
+  for( unsigned long pointsBegin = pos_begin; pointsBegin < pos_end; pointsBegin += ParzenWindowBlockSize )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImagePointType        mappedPoint;
-
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
+    const unsigned int numberOfPoints = ( pos_end - pointsBegin < ParzenWindowBlockSize )
+      ? static_cast< unsigned int >( pos_end - pointsBegin ) : ParzenWindowBlockSize;
 
-    /** Compute the moving image value and check if the point is
-     * inside the moving image buffer.
+    /** Read fixed coordinates, transform the points of this block, and
+     * check if they are inside the moving mask.
      */
-    if( sampleOk )
+    for( unsigned int i = 0; i < numberOfPoints; ++i )
     {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, 0 );
+      fixedPoints[ i ] = sampleContainer->ElementAt( pointsBegin + i ).m_ImageCoordinates;
     }
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, numberOfPoints, pointsBegin );
 
-    if( sampleOk )
+    for( unsigned int i = 0; i < numberOfPoints; ++i )
     {
-      numberOfPixelsCounted++;
+      const MovingImagePointType & mappedPoint = mappedPoints[ i ];
+      RealType                     movingImageValue;
+      bool                         sampleOk = samplesOk[ i ];
 
-      /** Get the fixed image value. */
-      RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
+      /** Compute the moving image value and check if the point is
+       * inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, 0 );
+      }
 
-      /** Make sure the values fall within the histogram range. */
-      fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
-      movingImageValue = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
+      if( sampleOk )
+      {
+        numberOfPixelsCounted++;
 
-      /** Compute this sample's contribution to the joint distributions. */
-      this->UpdateJointPDFAndDerivatives(
-        fixedImageValue, movingImageValue, 0, 0,
-        jointPDF.GetPointer() );
+        /** Get the fixed image value. */
+        RealType fixedImageValue = static_cast< RealType >(
+          sampleContainer->ElementAt( pointsBegin + i ).m_ImageValue );
+
+        /** Make sure the values fall within the histogram range. */
+        fixedImageValues[ blockSize ]  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
+        movingImageValues[ blockSize ] = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
+        sampleIndices[ blockSize ]     = pointsBegin + i;
+        ++blockSize;
+
+        /** Compute the contribution of a full block to the joint distributions. */
+        if( blockSize == ParzenWindowBlockSize )
+        {
+          this->UpdateJointPDFBlock( fixedImageValues, movingImageValues, blockSize,
+            0, numberOfFixedBins, jointPDF.GetPointer(), cachedSampleIndices );
+          blockSize = 0;
+        }
+      }
     }
   } // end iterating over fixed image spatial sample container for loop
 
+  /** Process the remaining samples. */
+  this->UpdateJointPDFBlock( fixedImageValues, movingImageValues, blockSize,
+    0, numberOfFixedBins, jointPDF.GetPointer(), cachedSampleIndices );
+
   /** Only update these variables at the end to prevent unnecessary "false sharing". */
   this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
 
@@ -1246,7 +1537,7 @@ void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 ::AfterThreadedComputePDFs( void ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted
@@ -1335,17 +1626,281 @@ void
 ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchComputePDFsThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->ComputePDFsThreaderCallback,
+  /** Launch. */
+  this->LaunchThreaderCallback( this->ComputePDFsThreaderCallback,
     const_cast< void * >( static_cast< const void * >(
       &this->m_ParzenWindowHistogramThreaderParameters ) ) );
 
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
-
 } // end LaunchComputePDFsThreaderCallback()
 
 
+/**
+ * ************************ ComputePDFsSharded **************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePDFsSharded( void ) const
+{
+  /** Make room for the sample values. This does not reallocate when
+   * the number of samples does not grow.
+   */
+  const unsigned long numberOfSamples = this->GetImageSampler()->GetOutput()->Size();
+  this->m_ParzenWindowHistogramSampleValues.resize( numberOfSamples );
+
+  /** Launch multi-threaded computation of the sample values. */
+  this->LaunchThreaderCallback( this->ComputePDFSampleValuesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >(
+      &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+
+  /** Accumulate the number of pixels. */
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
+  this->m_NumberOfPixelsCounted = 0;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted
+      += this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted;
+
+    /** Reset this variable for the next iteration. */
+    this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
+  }
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
+
+  /** Compute alpha. */
+  this->m_Alpha = 1.0 / static_cast< double >( this->m_NumberOfPixelsCounted );
+
+  /** Launch multi-threaded accumulation of the joint histogram shards. */
+  this->LaunchThreaderCallback( this->AccumulateJointPDFShardThreaderCallback,
+    const_cast< void * >( static_cast< const void * >(
+      &this->m_ParzenWindowHistogramThreaderParameters ) ) );
+
+} // end ComputePDFsSharded()
+
+
+/**
+ * ******************* ThreadedComputePDFSampleValues *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedComputePDFSampleValues( ThreadIdType threadId )
+{
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
+  const unsigned long         sampleContainerSize = sampleContainer->Size();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  unsigned long numberOfPixelsCounted = 0;
+
+  /** The samples are transformed per block, so that the transform can
+   * process a whole block of points at once.
+   */
+  FixedImagePointType  fixedPoints[ ParzenWindowBlockSize ];
+  MovingImagePointType mappedPoints[ ParzenWindowBlockSize ];
+  bool                 samplesOk[ ParzenWindowBlockSize ];
+
+  /** Loop over the samples and compute the values of each sample. */
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += ParzenWindowBlockSize )
+  {
+    const unsigned int blockSize = ( pos_end - blockBegin < ParzenWindowBlockSize )
+      ? static_cast< unsigned int >( pos_end - blockBegin ) : ParzenWindowBlockSize;
+
+    /** Read fixed coordinates, transform the points of this block, and
+     * check if they are inside the moving mask.
+     */
+    for( unsigned int i = 0; i < blockSize; ++i )
+    {
+      fixedPoints[ i ] = sampleContainer->ElementAt( blockBegin + i ).m_ImageCoordinates;
+    }
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
+
+    for( unsigned int i = 0; i < blockSize; ++i )
+    {
+      const unsigned long          pos         = blockBegin + i;
+      const MovingImagePointType & mappedPoint = mappedPoints[ i ];
+      RealType                     movingImageValue;
+      bool                         sampleOk = samplesOk[ i ];
+
+      /** Compute the moving image value and check if the point is
+       * inside the moving image buffer.
+       */
+      if( sampleOk )
+      {
+        sampleOk = this->EvaluateMovingImageValueAndDerivative(
+          mappedPoint, movingImageValue, 0 );
+      }
+
+      ParzenWindowHistogramSampleValuesType & sampleValues
+        = this->m_ParzenWindowHistogramSampleValues[ pos ];
+      sampleValues.m_SampleOk = sampleOk;
+
+      if( sampleOk )
+      {
+        numberOfPixelsCounted++;
+
+        /** Get the fixed image value. */
+        RealType fixedImageValue = static_cast< RealType >( sampleContainer->ElementAt( pos ).m_ImageValue );
+
+        /** Make sure the values fall within the histogram range. */
+        sampleValues.m_FixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
+        sampleValues.m_MovingImageValue = this->GetMovingImageLimiter()->Evaluate( movingImageValue );
+      }
+    }
+  } // end iterating over fixed image spatial sample container for loop
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_ParzenWindowHistogramGetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+} // end ThreadedComputePDFSampleValues()
+
+
+/**
+ * ******************* ThreadedAccumulateJointPDFShard *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedAccumulateJointPDFShard( ThreadIdType threadId )
+{
+  /** Get the band of fixed image bins owned by this thread. */
+  const OffsetValueType numberOfFixedBins = static_cast< OffsetValueType >( this->m_NumberOfFixedHistogramBins );
+  const OffsetValueType nrOfBinsPerThread
+    = static_cast< OffsetValueType >( std::ceil( static_cast< double >( numberOfFixedBins )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  OffsetValueType bin_begin = nrOfBinsPerThread * threadId;
+  OffsetValueType bin_end   = nrOfBinsPerThread * ( threadId + 1 );
+  bin_begin = ( bin_begin > numberOfFixedBins ) ? numberOfFixedBins : bin_begin;
+  bin_end   = ( bin_end > numberOfFixedBins ) ? numberOfFixedBins : bin_end;
+  if( bin_begin == bin_end ) { return; }
+
+  /** The joint histogram is stored with the moving image bins running fastest,
+   * so a band of fixed image bins is a contiguous part of the buffer.
+   */
+  const OffsetValueType numberOfMovingBins = static_cast< OffsetValueType >( this->m_NumberOfMovingHistogramBins );
+  PDFValueType *        pdfBuffer          = this->m_JointPDF->GetBufferPointer();
+  std::fill( pdfBuffer + bin_begin * numberOfMovingBins, pdfBuffer + bin_end * numberOfMovingBins,
+    NumericTraits< PDFValueType >::ZeroValue() );
+
+  /** Loop over all samples in the original order, so that every bin receives
+   * its contributions in the same order as in the single-threaded code.
+   * The samples contributing to this band are collected in blocks.
+   */
+  const OffsetValueType fixedWindowSize = static_cast< OffsetValueType >( this->m_JointPDFWindow.GetSize()[ 1 ] );
+  RealType              fixedImageValues[ ParzenWindowBlockSize ];
+  RealType              movingImageValues[ ParzenWindowBlockSize ];
+  SizeValueType         sampleIndices[ ParzenWindowBlockSize ];
+  unsigned int          blockSize = 0;
+
+  /** The fixed Parzen windows are read from the cache, if available. */
+  const bool            useCache            = this->m_FixedParzenWindowCacheIsValid;
+  const SizeValueType * cachedSampleIndices = useCache ? sampleIndices : nullptr;
+
+  typedef typename std::vector< ParzenWindowHistogramSampleValuesType >::const_iterator SampleValuesIteratorType;
+  const SampleValuesIteratorType sbegin = this->m_ParzenWindowHistogramSampleValues.begin();
+  const SampleValuesIteratorType send   = this->m_ParzenWindowHistogramSampleValues.end();
+  for( SampleValuesIteratorType sit = sbegin; sit != send; ++sit )
+  {
+    if( !( *sit ).m_SampleOk ) { continue; }
+
+    /** The lowest fixed bin number affected by this pixel. */
+    const SizeValueType sampleIndex = static_cast< SizeValueType >( sit - sbegin );
+    OffsetValueType     fixedImageParzenWindowIndex;
+    if( useCache )
+    {
+      fixedImageParzenWindowIndex = this->m_FixedParzenWindowIndices[ sampleIndex ];
+    }
+    else
+    {
+      const double fixedImageParzenWindowTerm
+        = ( *sit ).m_FixedImageValue / this->m_FixedImageBinSize - this->m_FixedImageNormalizedMin;
+      fixedImageParzenWindowIndex = static_cast< OffsetValueType >( std::floor(
+        fixedImageParzenWindowTerm + this->m_FixedParzenTermToIndexOffset ) );
+    }
+
+    /** Skip samples that do not contribute to this band. */
+    if( fixedImageParzenWindowIndex + fixedWindowSize <= bin_begin
+      || fixedImageParzenWindowIndex >= bin_end ) { continue; }
+
+    fixedImageValues[ blockSize ]  = ( *sit ).m_FixedImageValue;
+    movingImageValues[ blockSize ] = ( *sit ).m_MovingImageValue;
+    sampleIndices[ blockSize ]     = sampleIndex;
+    ++blockSize;
+
+    if( blockSize == ParzenWindowBlockSize )
+    {
+      this->UpdateJointPDFBlock( fixedImageValues, movingImageValues, blockSize,
+        bin_begin, bin_end, this->m_JointPDF.GetPointer(), cachedSampleIndices );
+      blockSize = 0;
+    }
+  }
+
+  /** Process the remaining samples. */
+  this->UpdateJointPDFBlock( fixedImageValues, movingImageValues, blockSize,
+    bin_begin, bin_end, this->m_JointPDF.GetPointer(), cachedSampleIndices );
+
+} // end ThreadedAccumulateJointPDFShard()
+
+
+/**
+ * **************** ComputePDFSampleValuesThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePDFSampleValuesThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->WorkUnitID;
+
+  ParzenWindowHistogramMultiThreaderParameterType * temp
+    = static_cast< ParzenWindowHistogramMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputePDFSampleValues( threadId );
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end ComputePDFSampleValuesThreaderCallback()
+
+
+/**
+ * **************** AccumulateJointPDFShardThreaderCallback *******
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
+::AccumulateJointPDFShardThreaderCallback( void * arg )
+{
+  ThreadInfoType * infoStruct = static_cast< ThreadInfoType * >( arg );
+  ThreadIdType     threadId   = infoStruct->WorkUnitID;
+
+  ParzenWindowHistogramMultiThreaderParameterType * temp
+    = static_cast< ParzenWindowHistogramMultiThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedAccumulateJointPDFShard( threadId );
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end AccumulateJointPDFShardThreaderCallback()
+
+
 /**
  * ************************ ComputePDFsAndPDFDerivatives *******************
  */
@@ -1399,7 +1954,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
     MovingImageDerivativeType   movingImageDerivative;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -1429,7 +1984,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
         movingImageValue, movingImageDerivative );
 
       /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateSampleTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the inner product (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
@@ -1520,7 +2075,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
      * if not, skip this sample.
      */
     MovingImagePointType mappedPoint;
-    bool                 sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool                 sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     if( sampleOk )
     {
@@ -1570,7 +2125,7 @@ ParzenWindowHistogramImageToImageMetric< TFixedImage, TMovingImage >
        * function of its parameters, so that we can evaluate T(x;\mu+delta_ek)
        * as T(x) + delta * dT/dmu_k.
        */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateSampleTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       MovingImagePointType mappedPointRight;
       MovingImagePointType mappedPointLeft;
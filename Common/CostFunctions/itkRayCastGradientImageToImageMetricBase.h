@@ -0,0 +1,209 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkRayCastGradientImageToImageMetricBase_h
+#define __itkRayCastGradientImageToImageMetricBase_h
+
+#include "itkAdvancedImageToImageMetric.h"
+#include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include "itkCastImageFilter.h"
+#include "itkNeighborhoodOperatorImageFilter.h"
+#include "itkOptimizer.h"
+#include "itkPersistentThreadPool.h"
+#include "itkSobelOperator.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/**
+ * \class RayCastGradientImageToImageMetricBase
+ * \brief A base class for the 2D-3D metrics that compare the gradients of
+ * the fixed image with those of the projection of the moving image.
+ *
+ * The fixed image is a projection image, stored as a 3D image of one slice,
+ * and the moving image is projected by an AdvancedRayCastInterpolateImageFunction.
+ * Instead of projecting the moving image on the whole fixed image grid at
+ * every evaluation, this class only casts the rays that are needed at the
+ * samples of the image sampler: the projection gradient at a sample is the
+ * 3x3 Sobel stencil in the plane of the fixed image, which needs eight rays.
+ * The rays of the samples are cast by the threads of the PersistentThreadPool.
+ *
+ * The Sobel gradients of the fixed image are computed once per resolution,
+ * in Initialize(), and read at the nearest voxel of each sample. After
+ * ComputeSampleGradients(), the fixed and projection gradients of the
+ * samples are available to the inheriting classes, that define GetValue().
+ *
+ * The ray casting has no derivative with respect to the transform
+ * parameters, so the derivative is computed by central finite differences
+ * of GetValue(), on the same samples. The step of parameter i is
+ * DerivativeDelta / sqrt( Scales[ i ] ).
+ *
+ * \ingroup Metrics
+ */
+
+template< class TFixedImage, class TMovingImage >
+class RayCastGradientImageToImageMetricBase :
+  public AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef RayCastGradientImageToImageMetricBase                   Self;
+  typedef AdvancedImageToImageMetric< TFixedImage, TMovingImage > Superclass;
+  typedef SmartPointer< Self >                                    Pointer;
+  typedef SmartPointer< const Self >                              ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( RayCastGradientImageToImageMetricBase, AdvancedImageToImageMetric );
+
+  /** Typedefs from the superclass. */
+  typedef typename Superclass::RealType                 RealType;
+  typedef typename Superclass::TransformType            TransformType;
+  typedef typename TransformType::ScalarType            ScalarType;
+  typedef typename Superclass::TransformParametersType  TransformParametersType;
+  typedef typename Superclass::InterpolatorType         InterpolatorType;
+  typedef typename Superclass::MeasureType              MeasureType;
+  typedef typename Superclass::DerivativeType           DerivativeType;
+  typedef typename Superclass::FixedImageType           FixedImageType;
+  typedef typename Superclass::MovingImageType          MovingImageType;
+  typedef typename Superclass::FixedImagePointType      FixedImagePointType;
+  typedef typename Superclass::MovingImagePointType     MovingImagePointType;
+  typedef typename Superclass::ImageSampleContainerType ImageSampleContainerType;
+  typedef typename itk::Optimizer::ScalesType           ScalesType;
+
+  itkStaticConstMacro( FixedImageDimension, unsigned int, TFixedImage::ImageDimension );
+
+  /** The gradients are computed in the plane of the projection image. */
+  itkStaticConstMacro( GradientDimension, unsigned int, 2 );
+
+  /** The ray caster that projects the moving image. */
+  typedef AdvancedRayCastInterpolateImageFunction<
+    MovingImageType, ScalarType >                       RayCastInterpolatorType;
+
+  /** Typedefs for the Sobel gradients of the fixed image. */
+  typedef itk::Image< RealType,
+    itkGetStaticConstMacro( FixedImageDimension ) >     FixedGradientImageType;
+  typedef typename FixedGradientImageType::Pointer     FixedGradientImagePointer;
+  typedef typename FixedGradientImageType::PixelType   FixedGradientPixelType;
+  typedef CastImageFilter< FixedImageType,
+    FixedGradientImageType >                            CastFixedImageFilterType;
+  typedef NeighborhoodOperatorImageFilter<
+    FixedGradientImageType, FixedGradientImageType >    FixedSobelFilterType;
+
+  /** The fixed and projection gradients at a sample. */
+  struct SampleGradientType
+  {
+    RealType m_FixedGradient[ GradientDimension ];
+    RealType m_MovedGradient[ GradientDimension ];
+  };
+  typedef std::vector< SampleGradientType > SampleGradientsType;
+
+  /** Get the derivative by central finite differences of GetValue(). */
+  void GetDerivative( const TransformParametersType & parameters,
+    DerivativeType & derivative ) const override;
+
+  /** Get the value and the derivative. */
+  void GetValueAndDerivative( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const override;
+
+  /** Initialize the metric, and compute the gradients of the fixed image. */
+  void Initialize( void ) override;
+
+  /** Set/Get the scales of the parameters, used for the finite differences. */
+  itkSetMacro( Scales, ScalesType );
+  itkGetConstReferenceMacro( Scales, ScalesType );
+
+  /** Set/Get the value of Delta used for computing derivatives by finite
+   * differences in the GetDerivative() method.
+   */
+  itkSetMacro( DerivativeDelta, double );
+  itkGetConstReferenceMacro( DerivativeDelta, double );
+
+protected:
+
+  RayCastGradientImageToImageMetricBase();
+  ~RayCastGradientImageToImageMetricBase() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Set the parameters, update the image sampler, and compute the fixed and
+   * projection gradients of all samples into m_SampleGradients.
+   */
+  void ComputeSampleGradients( const TransformParametersType & parameters ) const;
+
+  /** Get the Sobel gradient image of the fixed image along a dimension. */
+  const FixedGradientImageType * GetFixedGradientImage( const unsigned int dimension ) const
+  {
+    return this->m_FixedSobelFilters[ dimension ]->GetOutput();
+  }
+
+
+  /** The gradients of the samples, computed by ComputeSampleGradients(). */
+  mutable SampleGradientsType m_SampleGradients;
+
+private:
+
+  RayCastGradientImageToImageMetricBase( const Self & ); // purposely not implemented
+  void operator=( const Self & );                        // purposely not implemented
+
+  /** Compute the gradients of the samples of a work unit. */
+  void ThreadedComputeSampleGradients( const ThreadIdType workUnit,
+    const ThreadIdType numberOfWorkUnits ) const;
+
+  /** Compute the gradients of the samples of a work unit. */
+  static ITK_THREAD_RETURN_TYPE ComputeSampleGradientsThreaderCallback( void * arg );
+
+  /** The data passed to ComputeSampleGradientsThreaderCallback(). */
+  struct SampleGradientsThreaderParameterType
+  {
+    const Self * m_Metric;
+  };
+
+  /** Return the value of the ray through a point of the fixed image. */
+  RealType CastRay( const FixedImagePointType & fixedPoint ) const;
+
+  ScalesType m_Scales;
+  double     m_DerivativeDelta;
+
+  /** The ray caster of the moving image, with its transform. */
+  const RayCastInterpolatorType * m_RayCaster;
+
+  /** The steps in physical space between the voxels of the fixed image. */
+  typename FixedImagePointType::VectorType m_FixedImageSteps[ GradientDimension ];
+
+  /** The Sobel gradients of the fixed image. */
+  typename CastFixedImageFilterType::Pointer m_CastFixedImageFilter;
+
+  SobelOperator< FixedGradientPixelType,
+  itkGetStaticConstMacro( FixedImageDimension ) >
+  m_FixedSobelOperators[ FixedImageDimension ];
+
+  typename FixedSobelFilterType::Pointer m_FixedSobelFilters[ FixedImageDimension ];
+
+  ZeroFluxNeumannBoundaryCondition< FixedGradientImageType > m_FixedBoundCond;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkRayCastGradientImageToImageMetricBase.hxx"
+#endif
+
+#endif // end #ifndef __itkRayCastGradientImageToImageMetricBase_h
@@ -0,0 +1,305 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkRayCastGradientImageToImageMetricBase_hxx
+#define __itkRayCastGradientImageToImageMetricBase_hxx
+
+#include "itkRayCastGradientImageToImageMetricBase.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/**
+ * ***************** Constructor *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::RayCastGradientImageToImageMetricBase()
+{
+  this->SetUseImageSampler( true );
+
+  this->m_DerivativeDelta      = 0.001;
+  this->m_RayCaster            = nullptr;
+  this->m_CastFixedImageFilter = CastFixedImageFilterType::New();
+
+  for( unsigned int i = 0; i < GradientDimension; ++i )
+  {
+    this->m_FixedImageSteps[ i ].Fill( 0.0 );
+  }
+
+} // end Constructor
+
+
+/**
+ * ***************** Initialize *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::Initialize( void )
+{
+  /** Initialize the base class. */
+  Superclass::Initialize();
+
+  /** The moving image is projected by the ray caster. */
+  this->m_RayCaster = dynamic_cast< const RayCastInterpolatorType * >( this->GetInterpolator() );
+  if( this->m_RayCaster == nullptr )
+  {
+    itkExceptionMacro( << "ERROR: the " << this->GetNameOfClass() << " is currently "
+                       << "only suitable for 2D-3D registration.\n"
+                       << "  Therefore it expects an interpolator of type RayCastInterpolator." );
+  }
+
+  /** Compute the gradients of the fixed image, once per resolution. */
+  this->m_CastFixedImageFilter->SetInput( this->m_FixedImage );
+  this->m_CastFixedImageFilter->Update();
+
+  for( unsigned int i = 0; i < FixedImageDimension; ++i )
+  {
+    this->m_FixedSobelOperators[ i ].SetDirection( i );
+    this->m_FixedSobelOperators[ i ].CreateDirectional();
+    this->m_FixedSobelFilters[ i ] = FixedSobelFilterType::New();
+    this->m_FixedSobelFilters[ i ]->OverrideBoundaryCondition( &this->m_FixedBoundCond );
+    this->m_FixedSobelFilters[ i ]->SetOperator( this->m_FixedSobelOperators[ i ] );
+    this->m_FixedSobelFilters[ i ]->SetInput( this->m_CastFixedImageFilter->GetOutput() );
+    this->m_FixedSobelFilters[ i ]->UpdateLargestPossibleRegion();
+  }
+
+  /** The steps to the neighboring voxels in the plane of the fixed image. */
+  for( unsigned int i = 0; i < GradientDimension; ++i )
+  {
+    for( unsigned int j = 0; j < FixedImageDimension; ++j )
+    {
+      this->m_FixedImageSteps[ i ][ j ]
+        = this->m_FixedImage->GetDirection()[ j ][ i ] * this->m_FixedImage->GetSpacing()[ i ];
+    }
+  }
+
+} // end Initialize()
+
+
+/**
+ * ***************** CastRay *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >::RealType
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::CastRay( const FixedImagePointType & fixedPoint ) const
+{
+  /** Like the projection by a ResampleImageFilter, with 0 outside the moving image. */
+  const MovingImagePointType mappedPoint
+    = this->m_RayCaster->GetTransform()->TransformPoint( fixedPoint );
+  if( !this->m_RayCaster->IsInsideBuffer( mappedPoint ) )
+  {
+    return NumericTraits< RealType >::ZeroValue();
+  }
+  return static_cast< RealType >( this->m_RayCaster->Evaluate( mappedPoint ) );
+
+} // end CastRay()
+
+
+/**
+ * ***************** ComputeSampleGradients *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::ComputeSampleGradients( const TransformParametersType & parameters ) const
+{
+  /** Set the parameters and update the image sampler. */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  const SizeValueType numberOfSamples = this->GetImageSampler()->GetOutput()->Size();
+  if( numberOfSamples == 0 )
+  {
+    itkExceptionMacro( << "ERROR: the image sampler did not generate any samples." );
+  }
+  this->m_SampleGradients.resize( numberOfSamples );
+
+  /** Cast the rays of the samples in parallel. */
+  SampleGradientsThreaderParameterType temp;
+  temp.m_Metric = this;
+  const ThreadIdType numberOfWorkUnits = this->m_UseMultiThread
+    ? static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( Self::GetNumberOfWorkUnits(), numberOfSamples ) ) )
+    : 1;
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    numberOfWorkUnits, Self::ComputeSampleGradientsThreaderCallback, &temp );
+
+  this->m_NumberOfPixelsCounted = numberOfSamples;
+
+} // end ComputeSampleGradients()
+
+
+/**
+ * ***************** ComputeSampleGradientsThreaderCallback *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::ComputeSampleGradientsThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const SampleGradientsThreaderParameterType * temp
+    = static_cast< SampleGradientsThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedComputeSampleGradients(
+    infoStruct->WorkUnitID, infoStruct->NumberOfWorkUnits );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end ComputeSampleGradientsThreaderCallback()
+
+
+/**
+ * ***************** ThreadedComputeSampleGradients *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::ThreadedComputeSampleGradients( const ThreadIdType workUnit,
+  const ThreadIdType numberOfWorkUnits ) const
+{
+  const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+  const SizeValueType              numberOfSamples = sampleContainer->Size();
+
+  const SizeValueType chunkSize = ( numberOfSamples + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+  const SizeValueType begin     = std::min( workUnit * chunkSize, numberOfSamples );
+  const SizeValueType end       = std::min( begin + chunkSize, numberOfSamples );
+
+  typename FixedImageType::IndexType fixedIndex;
+  RealType                           rays[ 3 ][ 3 ];
+  for( SizeValueType s = begin; s < end; ++s )
+  {
+    const FixedImagePointType & fixedPoint = sampleContainer->ElementAt( s ).m_ImageCoordinates;
+    SampleGradientType &        gradients  = this->m_SampleGradients[ s ];
+
+    /** Read the cached fixed gradients at the nearest voxel. */
+    const bool insideFixedImage = this->m_FixedImage->TransformPhysicalPointToIndex( fixedPoint, fixedIndex );
+    for( unsigned int d = 0; d < GradientDimension; ++d )
+    {
+      gradients.m_FixedGradient[ d ] = insideFixedImage
+        ? this->GetFixedGradientImage( d )->GetPixel( fixedIndex )
+        : NumericTraits< RealType >::ZeroValue();
+    }
+
+    /** Cast the rays through the eight neighbors in the plane. */
+    for( int i = -1; i <= 1; ++i )
+    {
+      for( int j = -1; j <= 1; ++j )
+      {
+        if( i == 0 && j == 0 )
+        {
+          continue;
+        }
+        FixedImagePointType neighbor = fixedPoint;
+        neighbor += this->m_FixedImageSteps[ 0 ] * static_cast< double >( i );
+        neighbor += this->m_FixedImageSteps[ 1 ] * static_cast< double >( j );
+        rays[ i + 1 ][ j + 1 ] = this->CastRay( neighbor );
+      }
+    }
+
+    /** Apply the Sobel stencil. */
+    gradients.m_MovedGradient[ 0 ]
+      = ( rays[ 2 ][ 0 ] + 2.0 * rays[ 2 ][ 1 ] + rays[ 2 ][ 2 ] )
+      - ( rays[ 0 ][ 0 ] + 2.0 * rays[ 0 ][ 1 ] + rays[ 0 ][ 2 ] );
+    gradients.m_MovedGradient[ 1 ]
+      = ( rays[ 0 ][ 2 ] + 2.0 * rays[ 1 ][ 2 ] + rays[ 2 ][ 2 ] )
+      - ( rays[ 0 ][ 0 ] + 2.0 * rays[ 1 ][ 0 ] + rays[ 2 ][ 0 ] );
+  }
+
+} // end ThreadedComputeSampleGradients()
+
+
+/**
+ * ***************** GetDerivative *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::GetDerivative( const TransformParametersType & parameters,
+  DerivativeType & derivative ) const
+{
+  TransformParametersType testPoint          = parameters;
+  const unsigned int      numberOfParameters = this->GetNumberOfParameters();
+  derivative = DerivativeType( numberOfParameters );
+
+  for( unsigned int i = 0; i < numberOfParameters; i++ )
+  {
+    const double scale = this->m_Scales.Size() == numberOfParameters ? this->m_Scales[ i ] : 1.0;
+    const double delta = this->m_DerivativeDelta / std::sqrt( scale );
+    testPoint[ i ] -= delta;
+    const MeasureType valuep0 = this->GetValue( testPoint );
+    testPoint[ i ] += 2 * delta;
+    const MeasureType valuep1 = this->GetValue( testPoint );
+    derivative[ i ] = ( valuep1 - valuep0 ) / ( 2 * delta );
+    testPoint[ i ]  = parameters[ i ];
+  }
+
+  /** Leave the transform at the requested parameters. */
+  this->SetTransformParameters( parameters );
+
+} // end GetDerivative()
+
+
+/**
+ * ***************** GetValueAndDerivative *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::GetValueAndDerivative( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  value = this->GetValue( parameters );
+  this->GetDerivative( parameters, derivative );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ***************** PrintSelf *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+RayCastGradientImageToImageMetricBase< TFixedImage, TMovingImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "DerivativeDelta: " << this->m_DerivativeDelta << std::endl;
+  os << indent << "Scales: " << this->m_Scales << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkRayCastGradientImageToImageMetricBase_hxx
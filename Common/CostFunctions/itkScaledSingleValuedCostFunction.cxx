@@ -57,10 +57,10 @@ ScaledSingleValuedCostFunction
 
   MeasureType returnvalue = NumericTraits< MeasureType >::Zero;
 
-  if( this->m_UseScales )
+  if( this->m_UseScales || this->GetUseActiveParameters() )
   {
-    ParametersType scaledParameters = parameters;
-    this->ConvertScaledToUnscaledParameters( scaledParameters );
+    ParametersType scaledParameters;
+    this->ComputeUnscaledParameters( parameters, scaledParameters );
     returnvalue = this->m_UnscaledCostFunction->GetValue( scaledParameters );
   }
   else
@@ -77,6 +77,64 @@ ScaledSingleValuedCostFunction
 } // end GetValue()
 
 
+/**
+ * ******************** GetValues *****************************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::GetValues( const ParametersVectorType & parameters,
+  MeasureVectorType & values ) const
+{
+  /** Without a multiple values interface, the values are computed one by one. */
+  const MultipleValuesCostFunctionInterface * unscaledCostFunction
+    = dynamic_cast< const MultipleValuesCostFunctionInterface * >(
+    this->m_UnscaledCostFunction.GetPointer() );
+  if( unscaledCostFunction == nullptr )
+  {
+    values.resize( parameters.size() );
+    for( std::size_t i = 0; i < parameters.size(); ++i )
+    {
+      values[ i ] = this->GetValue( parameters[ i ] );
+    }
+    return;
+  }
+
+  /** This function also checks if the UnscaledCostFunction has been set */
+  const unsigned int numberOfParameters = this->GetNumberOfParameters();
+  for( const ParametersType & param : parameters )
+  {
+    if( param.GetSize() != numberOfParameters )
+    {
+      itkExceptionMacro( << "Number of parameters is not like the unscaled cost function expects." );
+    }
+  }
+
+  if( this->m_UseScales || this->GetUseActiveParameters() )
+  {
+    ParametersVectorType scaledParameters( parameters.size() );
+    for( std::size_t i = 0; i < parameters.size(); ++i )
+    {
+      this->ComputeUnscaledParameters( parameters[ i ], scaledParameters[ i ] );
+    }
+    unscaledCostFunction->GetValues( scaledParameters, values );
+  }
+  else
+  {
+    unscaledCostFunction->GetValues( parameters, values );
+  }
+
+  if( this->GetNegateCostFunction() )
+  {
+    for( MeasureType & value : values )
+    {
+      value = -value;
+    }
+  }
+
+} // end GetValues()
+
+
 /**
  * ******************** GetDerivative **************************
  */
@@ -95,17 +153,12 @@ ScaledSingleValuedCostFunction
     itkExceptionMacro( << "Number of parameters is not like the unscaled cost function expects." );
   }
 
-  if( this->m_UseScales )
+  if( this->m_UseScales || this->GetUseActiveParameters() )
   {
-    ParametersType scaledParameters = parameters;
-    this->ConvertScaledToUnscaledParameters( scaledParameters );
+    ParametersType scaledParameters;
+    this->ComputeUnscaledParameters( parameters, scaledParameters );
     this->m_UnscaledCostFunction->GetDerivative( scaledParameters, derivative );
-
-    const ScalesType & scales = this->GetScales();
-    for( unsigned int i = 0; i < numberOfParameters; ++i )
-    {
-      derivative[ i ] /= scales[ i ];
-    }
+    this->ConvertUnscaledToScaledDerivative( derivative );
   }
   else
   {
@@ -140,18 +193,12 @@ ScaledSingleValuedCostFunction
     itkExceptionMacro( << "Number of parameters is not like the unscaled cost function expects." );
   }
 
-  if( this->m_UseScales )
+  if( this->m_UseScales || this->GetUseActiveParameters() )
   {
-
-    ParametersType scaledParameters = parameters;
-    this->ConvertScaledToUnscaledParameters( scaledParameters );
+    ParametersType scaledParameters;
+    this->ComputeUnscaledParameters( parameters, scaledParameters );
     this->m_UnscaledCostFunction->GetValueAndDerivative( scaledParameters, value, derivative );
-
-    const ScalesType & scales = this->GetScales();
-    for( unsigned int i = 0; i < numberOfParameters; ++i )
-    {
-      derivative[ i ] /= scales[ i ];
-    }
+    this->ConvertUnscaledToScaledDerivative( derivative );
   }
   else
   {
@@ -167,6 +214,71 @@ ScaledSingleValuedCostFunction
 } // end GetValueAndDerivative()
 
 
+/**
+ * **************** GetValuesAndDerivatives ************************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::GetValuesAndDerivatives( const ParametersVectorType & parameters,
+  MeasureVectorType & values, DerivativeVectorType & derivatives ) const
+{
+  /** Without a multiple values interface, the values are computed one by one. */
+  const MultipleValuesCostFunctionInterface * unscaledCostFunction
+    = dynamic_cast< const MultipleValuesCostFunctionInterface * >(
+    this->m_UnscaledCostFunction.GetPointer() );
+  if( unscaledCostFunction == nullptr )
+  {
+    values.resize( parameters.size() );
+    derivatives.resize( parameters.size() );
+    for( std::size_t i = 0; i < parameters.size(); ++i )
+    {
+      this->GetValueAndDerivative( parameters[ i ], values[ i ], derivatives[ i ] );
+    }
+    return;
+  }
+
+  /** This function also checks if the UnscaledCostFunction has been set */
+  const unsigned int numberOfParameters = this->GetNumberOfParameters();
+  for( const ParametersType & param : parameters )
+  {
+    if( param.GetSize() != numberOfParameters )
+    {
+      itkExceptionMacro( << "Number of parameters is not like the unscaled cost function expects." );
+    }
+  }
+
+  if( this->m_UseScales || this->GetUseActiveParameters() )
+  {
+    ParametersVectorType scaledParameters( parameters.size() );
+    for( std::size_t i = 0; i < parameters.size(); ++i )
+    {
+      this->ComputeUnscaledParameters( parameters[ i ], scaledParameters[ i ] );
+    }
+    unscaledCostFunction->GetValuesAndDerivatives( scaledParameters, values, derivatives );
+
+    for( DerivativeType & derivative : derivatives )
+    {
+      this->ConvertUnscaledToScaledDerivative( derivative );
+    }
+  }
+  else
+  {
+    unscaledCostFunction->GetValuesAndDerivatives( parameters, values, derivatives );
+  }
+
+  if( this->GetNegateCostFunction() )
+  {
+    for( std::size_t i = 0; i < values.size(); ++i )
+    {
+      values[ i ]      = -values[ i ];
+      derivatives[ i ] = -derivatives[ i ];
+    }
+  }
+
+} // end GetValuesAndDerivatives()
+
+
 /**
  * **************** GetNumberOfParameters ************************
  */
@@ -179,6 +291,10 @@ ScaledSingleValuedCostFunction
   {
     itkExceptionMacro( << "UnscaledCostFunction has not been set!" );
   }
+  if( this->GetUseActiveParameters() )
+  {
+    return this->m_ActiveParameterIndices.size();
+  }
   return this->m_UnscaledCostFunction->GetNumberOfParameters();
 
 } // end GetNumberOfParameters()
@@ -199,6 +315,7 @@ ScaledSingleValuedCostFunction
   {
     this->m_SquaredScales[ i ] = vnl_math::sqr( scales[ i ] );
   }
+  this->UpdateActiveScales();
   this->Modified();
 
 } // end SetScales()
@@ -219,11 +336,104 @@ ScaledSingleValuedCostFunction
   {
     this->m_Scales[ i ] = std::sqrt( squaredScales[ i ] );
   }
+  this->UpdateActiveScales();
   this->Modified();
 
 } // end SetSquaredScales()
 
 
+/**
+ * **************** SetActiveParameterIndices *********************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::SetActiveParameterIndices( const ActiveParameterIndicesType & indices )
+{
+  for( std::size_t i = 1; i < indices.size(); ++i )
+  {
+    if( indices[ i ] <= indices[ i - 1 ] )
+    {
+      itkExceptionMacro( << "The active parameter indices are not strictly increasing." );
+    }
+  }
+
+  this->m_ActiveParameterIndices = indices;
+  this->UpdateActiveScales();
+  this->Modified();
+
+} // end SetActiveParameterIndices()
+
+
+/**
+ * **************** GetUseActiveParameters *********************
+ */
+
+bool
+ScaledSingleValuedCostFunction
+::GetUseActiveParameters( void ) const
+{
+  return !this->m_ActiveParameterIndices.empty();
+
+} // end GetUseActiveParameters()
+
+
+/**
+ * **************** SetFullParameters *********************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::SetFullParameters( const ParametersType & parameters )
+{
+  this->m_FullParameters = parameters;
+  this->Modified();
+
+} // end SetFullParameters()
+
+
+/**
+ * **************** UpdateActiveScales *********************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::UpdateActiveScales( void )
+{
+  /** A mismatch of the scales is reported when they are used. */
+  const ActiveParameterIndicesType & indices = this->m_ActiveParameterIndices;
+  if( indices.empty() || indices.back() >= this->m_Scales.GetSize() )
+  {
+    this->m_ActiveScales.SetSize( 0 );
+    return;
+  }
+
+  this->m_ActiveScales.SetSize( indices.size() );
+  for( std::size_t i = 0; i < indices.size(); ++i )
+  {
+    this->m_ActiveScales[ i ] = this->m_Scales[ indices[ i ] ];
+  }
+
+} // end UpdateActiveScales()
+
+
+/**
+ * **************** GetScalesOfExposedParameters *********************
+ */
+
+const ScaledSingleValuedCostFunction::ScalesType &
+ScaledSingleValuedCostFunction
+::GetScalesOfExposedParameters( void ) const
+{
+  if( this->GetUseActiveParameters() )
+  {
+    return this->m_ActiveScales;
+  }
+  return this->m_Scales;
+
+} // end GetScalesOfExposedParameters()
+
+
 /**
  * *************** ConvertScaledToUnscaledParameters ********************
  */
@@ -235,7 +445,7 @@ ScaledSingleValuedCostFunction
   if( this->m_UseScales )
   {
     const unsigned int numberOfParameters = parameters.GetSize();
-    const ScalesType & scales             = this->GetScales();
+    const ScalesType & scales             = this->GetScalesOfExposedParameters();
     if( scales.GetSize() != numberOfParameters )
     {
       itkExceptionMacro( << "Number of scales is not correct." );
@@ -262,7 +472,7 @@ ScaledSingleValuedCostFunction
   if( this->m_UseScales )
   {
     const unsigned int numberOfParameters = parameters.GetSize();
-    const ScalesType & scales             = this->GetScales();
+    const ScalesType & scales             = this->GetScalesOfExposedParameters();
     if( scales.GetSize() != numberOfParameters )
     {
       itkExceptionMacro( << "Number of scales is not correct." );
@@ -278,6 +488,144 @@ ScaledSingleValuedCostFunction
 } // end ConvertUnscaledToScaledParameters()
 
 
+/**
+ * *************** ConvertActiveToFullParameters ********************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::ConvertActiveToFullParameters( const ParametersType & activeParameters,
+  ParametersType & fullParameters ) const
+{
+  const ActiveParameterIndicesType & indices = this->m_ActiveParameterIndices;
+  if( activeParameters.GetSize() != indices.size() )
+  {
+    itkExceptionMacro( << "Number of active parameters is not correct." );
+  }
+  if( this->m_UnscaledCostFunction.IsNull()
+    || this->m_FullParameters.GetSize() != this->m_UnscaledCostFunction->GetNumberOfParameters() )
+  {
+    itkExceptionMacro( << "The full parameters have not been set correctly." );
+  }
+
+  fullParameters = this->m_FullParameters;
+  for( std::size_t i = 0; i < indices.size(); ++i )
+  {
+    fullParameters[ indices[ i ] ] = activeParameters[ i ];
+  }
+
+} // end ConvertActiveToFullParameters()
+
+
+/**
+ * *************** ConvertFullToActiveParameters ********************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::ConvertFullToActiveParameters( const ParametersType & fullParameters,
+  ParametersType & activeParameters ) const
+{
+  const ActiveParameterIndicesType & indices = this->m_ActiveParameterIndices;
+  if( !indices.empty() && indices.back() >= fullParameters.GetSize() )
+  {
+    itkExceptionMacro( << "Number of parameters is smaller than the largest active parameter index." );
+  }
+
+  activeParameters.SetSize( indices.size() );
+  for( std::size_t i = 0; i < indices.size(); ++i )
+  {
+    activeParameters[ i ] = fullParameters[ indices[ i ] ];
+  }
+
+} // end ConvertFullToActiveParameters()
+
+
+/**
+ * *************** ComputeUnscaledParameters ********************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::ComputeUnscaledParameters( const ParametersType & scaledParameters,
+  ParametersType & unscaledParameters ) const
+{
+  if( this->GetUseActiveParameters() )
+  {
+    ParametersType activeParameters = scaledParameters;
+    this->ConvertScaledToUnscaledParameters( activeParameters );
+    this->ConvertActiveToFullParameters( activeParameters, unscaledParameters );
+  }
+  else
+  {
+    unscaledParameters = scaledParameters;
+    this->ConvertScaledToUnscaledParameters( unscaledParameters );
+  }
+
+} // end ComputeUnscaledParameters()
+
+
+/**
+ * *************** ComputeScaledParameters ********************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::ComputeScaledParameters( const ParametersType & unscaledParameters,
+  ParametersType & scaledParameters ) const
+{
+  if( this->GetUseActiveParameters() )
+  {
+    this->ConvertFullToActiveParameters( unscaledParameters, scaledParameters );
+  }
+  else
+  {
+    scaledParameters = unscaledParameters;
+  }
+  this->ConvertUnscaledToScaledParameters( scaledParameters );
+
+} // end ComputeScaledParameters()
+
+
+/**
+ * *************** ConvertUnscaledToScaledDerivative ********************
+ */
+
+void
+ScaledSingleValuedCostFunction
+::ConvertUnscaledToScaledDerivative( DerivativeType & derivative ) const
+{
+  if( this->GetUseActiveParameters() )
+  {
+    const ActiveParameterIndicesType & indices = this->m_ActiveParameterIndices;
+    const DerivativeType               fullDerivative = derivative;
+    if( indices.back() >= fullDerivative.GetSize() )
+    {
+      itkExceptionMacro( << "Number of derivatives is smaller than the largest active parameter index." );
+    }
+    derivative.SetSize( indices.size() );
+    for( std::size_t i = 0; i < indices.size(); ++i )
+    {
+      derivative[ i ] = fullDerivative[ indices[ i ] ];
+    }
+  }
+
+  if( this->m_UseScales )
+  {
+    const ScalesType & scales = this->GetScalesOfExposedParameters();
+    if( scales.GetSize() != derivative.GetSize() )
+    {
+      itkExceptionMacro( << "Number of scales is not correct." );
+    }
+    for( unsigned int i = 0; i < derivative.GetSize(); ++i )
+    {
+      derivative[ i ] /= scales[ i ];
+    }
+  }
+
+} // end ConvertUnscaledToScaledDerivative()
+
+
 /**
  * *************** PrintSelf ********************
  */
@@ -293,6 +641,8 @@ ScaledSingleValuedCostFunction
      << ( this->m_UseScales ? "true" : "false" ) << std::endl;
   os << indent << "Scales: " << this->m_Scales << std::endl;
   os << indent << "SquaredScales: " << this->m_SquaredScales << std::endl;
+  os << indent << "NumberOfActiveParameters: "
+     << this->m_ActiveParameterIndices.size() << std::endl;
   os << indent << "NegateCostFunction: "
      << ( this->m_NegateCostFunction ? "true" : "false" ) << std::endl;
   os << indent << "UnscaledCostFunction: "
@@ -20,7 +20,9 @@
 #define __itkScaledSingleValuedCostFunction_h
 
 #include "itkSingleValuedCostFunction.h"
+#include "itkMultipleValuesCostFunctionInterface.h"
 #include "itkIntTypes.h" //temp, needed for IdentifierType
+#include <vector>
 
 namespace itk
 {
@@ -33,10 +35,22 @@ namespace itk
  * By default it does not apply any scaling. Use the method SetUseScales(true)
  * to enable the use of scales.
  *
+ * GetValues() and GetValuesAndDerivatives() pass the scaled parameter
+ * vectors on to the unscaled cost function, if it implements the
+ * MultipleValuesCostFunctionInterface.
+ *
+ * Optionally, only a subset of the parameters of the unscaled cost function,
+ * the active parameters, is exposed. GetNumberOfParameters() then returns the
+ * number of active parameters, and the parameter vectors and derivatives
+ * passed to and returned by this cost function only contain those. The
+ * inactive parameters keep the values of the FullParameters.
+ *
  * \ingroup Numerics
  */
 
-class ScaledSingleValuedCostFunction : public SingleValuedCostFunction
+class ScaledSingleValuedCostFunction :
+  public SingleValuedCostFunction,
+  public MultipleValuesCostFunctionInterface
 {
 public:
 
@@ -63,11 +77,18 @@ public:
 
   typedef Array< double > ScalesType;
 
+  /** The indices of the active parameters in the full parameter vector. */
+  typedef std::vector< NumberOfParametersType > ActiveParameterIndicesType;
+
   /** Divide the parameters by the scales and call the GetValue routine
    * of the unscaled cost function.
    */
   MeasureType GetValue( const ParametersType & parameters ) const override;
 
+  /** Same procedure as in GetValue, for several parameter vectors. */
+  void GetValues( const ParametersVectorType & parameters,
+    MeasureVectorType & values ) const override;
+
   /** Divide the parameters by the scales, call the GetDerivative routine
    * of the unscaled cost function and divide the resulting derivative by
    * the scales.
@@ -82,7 +103,13 @@ public:
     MeasureType & value,
     DerivativeType & derivative ) const override;
 
-  /** Ask the UnscaledCostFunction how many parameters it has. */
+  /** Same procedure as in GetValueAndDerivative, for several parameter vectors. */
+  void GetValuesAndDerivatives( const ParametersVectorType & parameters,
+    MeasureVectorType & values, DerivativeVectorType & derivatives ) const override;
+
+  /** Ask the UnscaledCostFunction how many parameters it has, or return the
+   * number of active parameters, if they are used.
+   */
   NumberOfParametersType GetNumberOfParameters( void ) const override;
 
   /** Set the cost function that needs scaling. */
@@ -120,12 +147,47 @@ public:
   /** Get the flag to negate the cost function or not. */
   itkGetConstMacro( NegateCostFunction, bool );
 
+  /** Set the indices of the active parameters, in strictly increasing order.
+   * An empty vector, the default, makes all parameters active.
+   */
+  virtual void SetActiveParameterIndices( const ActiveParameterIndicesType & indices );
+
+  /** Get the indices of the active parameters. */
+  itkGetConstReferenceMacro( ActiveParameterIndices, ActiveParameterIndicesType );
+
+  /** Whether only the active parameters are exposed. */
+  virtual bool GetUseActiveParameters( void ) const;
+
+  /** Set the full, unscaled, parameter vector, which provides the values of
+   * the inactive parameters.
+   */
+  virtual void SetFullParameters( const ParametersType & parameters );
+
+  /** Get the full, unscaled, parameter vector. */
+  itkGetConstReferenceMacro( FullParameters, ParametersType );
+
   /** Convert the parameters from scaled to unscaled: x = y/s. */
   virtual void ConvertScaledToUnscaledParameters( ParametersType & parameters ) const;
 
   /** Convert the parameters from unscaled to scaled: y = x*s. */
   virtual void ConvertUnscaledToScaledParameters( ParametersType & parameters ) const;
 
+  /** Insert the active parameters in a copy of the FullParameters. */
+  virtual void ConvertActiveToFullParameters(
+    const ParametersType & activeParameters, ParametersType & fullParameters ) const;
+
+  /** Extract the active parameters from a full parameter vector. */
+  virtual void ConvertFullToActiveParameters(
+    const ParametersType & fullParameters, ParametersType & activeParameters ) const;
+
+  /** Compute the full unscaled parameters from the (active) scaled parameters. */
+  virtual void ComputeUnscaledParameters(
+    const ParametersType & scaledParameters, ParametersType & unscaledParameters ) const;
+
+  /** Compute the (active) scaled parameters from the full unscaled parameters. */
+  virtual void ComputeScaledParameters(
+    const ParametersType & unscaledParameters, ParametersType & scaledParameters ) const;
+
 protected:
 
   /** The constructor. */
@@ -143,9 +205,23 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );                   // purposely not implemented
 
+  /** Compute the scales of the active parameters. */
+  void UpdateActiveScales( void );
+
+  /** Return the scales of the active parameters, or all scales. */
+  const ScalesType & GetScalesOfExposedParameters( void ) const;
+
+  /** Extract the active elements of the derivative of the unscaled cost
+   * function and divide them by the scales.
+   */
+  void ConvertUnscaledToScaledDerivative( DerivativeType & derivative ) const;
+
   /** Member variables. */
   ScalesType                      m_Scales;
   ScalesType                      m_SquaredScales;
+  ScalesType                      m_ActiveScales;
+  ActiveParameterIndicesType      m_ActiveParameterIndices;
+  ParametersType                  m_FullParameters;
   SingleValuedCostFunctionPointer m_UnscaledCostFunction;
   bool                            m_UseScales;
   bool                            m_NegateCostFunction;
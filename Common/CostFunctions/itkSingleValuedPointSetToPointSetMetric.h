@@ -40,6 +40,7 @@
 #include "itkMacro.h"
 #include "itkSpatialObject.h"
 #include "itkPointSet.h"
+#include "itkPersistentThreadPool.h"
 
 namespace itk
 {
@@ -171,6 +172,13 @@ public:
   itkGetConstReferenceMacro( UseMetricSingleThreaded, bool );
   itkBooleanMacro( UseMetricSingleThreaded );
 
+  /** Set/Get whether the metrics that support it process the points in
+   * parallel, using the persistent thread pool. Default: false.
+   */
+  itkSetMacro( UseMultiThread, bool );
+  itkGetConstReferenceMacro( UseMultiThread, bool );
+  itkBooleanMacro( UseMultiThread );
+
 protected:
 
   SingleValuedPointSetToPointSetMetric();
@@ -179,6 +187,22 @@ protected:
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const override;
 
+  /** The minimum number of points per chunk of ProcessPointChunks(). */
+  static const SizeValueType MinimumPointChunkSize = 64;
+
+  /** Return the number of chunks in which ProcessPointChunks() splits
+   * the given number of points. It is 1 without multi-threading.
+   */
+  ThreadIdType GetNumberOfPointChunks( const SizeValueType numberOfPoints ) const;
+
+  /** Call functor( chunk, begin, end ) for the GetNumberOfPointChunks()
+   * contiguous chunks of [0, numberOfPoints). The chunks are processed in
+   * parallel when UseMultiThread is on, so the functor should only write
+   * to the results of its own chunk.
+   */
+  template< class TFunctor >
+  void ProcessPointChunks( const SizeValueType numberOfPoints, const TFunctor & functor ) const;
+
   /** Member variables. */
   FixedPointSetConstPointer   m_FixedPointSet;
   MovingPointSetConstPointer  m_MovingPointSet;
@@ -190,9 +214,23 @@ protected:
 
   /** Variables for multi-threading. */
   bool m_UseMetricSingleThreaded;
+  bool m_UseMultiThread;
 
 private:
 
+  /** The data passed to the threads by ProcessPointChunks(). */
+  template< class TFunctor >
+  struct PointChunkThreaderParameterType
+  {
+    const TFunctor * m_Functor;
+    SizeValueType    m_NumberOfPoints;
+    SizeValueType    m_ChunkSize;
+  };
+
+  /** ProcessPointChunks threader callback function, one chunk per work unit. */
+  template< class TFunctor >
+  static ITK_THREAD_RETURN_TYPE PointChunkThreaderCallback( void * arg );
+
   SingleValuedPointSetToPointSetMetric( const Self & ); // purposely not implemented
   void operator=( const Self & );                       // purposely not implemented
 
@@ -36,6 +36,8 @@
 
 #include "itkSingleValuedPointSetToPointSetMetric.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
@@ -56,6 +58,7 @@ SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
   this->m_NumberOfPointsCounted = 0;
 
   this->m_UseMetricSingleThreaded = true;
+  this->m_UseMultiThread          = false;
 
 } // end Constructor
 
@@ -135,6 +138,80 @@ SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
 } // end BeforeThreadedGetValueAndDerivative()
 
 
+/**
+ * ******************* GetNumberOfPointChunks ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+ThreadIdType
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::GetNumberOfPointChunks( const SizeValueType numberOfPoints ) const
+{
+  if( !this->m_UseMultiThread )
+  {
+    return 1;
+  }
+  const SizeValueType maximumNumberOfChunks
+    = ( numberOfPoints + MinimumPointChunkSize - 1 ) / MinimumPointChunkSize;
+  return static_cast< ThreadIdType >( std::max< SizeValueType >( 1, std::min< SizeValueType >(
+    maximumNumberOfChunks, PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() ) ) );
+
+} // end GetNumberOfPointChunks()
+
+
+/**
+ * ******************* ProcessPointChunks ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+template< class TFunctor >
+void
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::ProcessPointChunks( const SizeValueType numberOfPoints, const TFunctor & functor ) const
+{
+  const ThreadIdType numberOfChunks = this->GetNumberOfPointChunks( numberOfPoints );
+  if( numberOfChunks <= 1 )
+  {
+    functor( 0, 0, numberOfPoints );
+    return;
+  }
+
+  PointChunkThreaderParameterType< TFunctor > temp;
+  temp.m_Functor        = &functor;
+  temp.m_NumberOfPoints = numberOfPoints;
+  temp.m_ChunkSize      = ( numberOfPoints + numberOfChunks - 1 ) / numberOfChunks;
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    numberOfChunks, Self::template PointChunkThreaderCallback< TFunctor >, &temp );
+
+} // end ProcessPointChunks()
+
+
+/**
+ * ******************* PointChunkThreaderCallback ***********************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+template< class TFunctor >
+ITK_THREAD_RETURN_TYPE
+SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
+::PointChunkThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const PointChunkThreaderParameterType< TFunctor > * temp
+    = static_cast< PointChunkThreaderParameterType< TFunctor > * >( infoStruct->UserData );
+
+  const ThreadIdType  chunk = infoStruct->WorkUnitID;
+  const SizeValueType begin = std::min( chunk * temp->m_ChunkSize, temp->m_NumberOfPoints );
+  const SizeValueType end   = std::min( begin + temp->m_ChunkSize, temp->m_NumberOfPoints );
+  ( *temp->m_Functor )( chunk, begin, end );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end PointChunkThreaderCallback()
+
+
 /**
  * ******************* PrintSelf ***********************
  */
@@ -151,6 +228,7 @@ SingleValuedPointSetToPointSetMetric< TFixedPointSet, TMovingPointSet >
   os << "Fixed mask: " << this->m_FixedImageMask.GetPointer() << std::endl;
   os << "Moving mask: " << this->m_MovingImageMask.GetPointer() << std::endl;
   os << "Transform: " << this->m_Transform.GetPointer() << std::endl;
+  os << "UseMultiThread: " << this->m_UseMultiThread << std::endl;
 
 } // end PrintSelf()
 
@@ -0,0 +1,281 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkAdvancedBSplineDeformableTransform.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+
+namespace
+{
+  using TransformType = itk::AdvancedBSplineDeformableTransform<double, 2, 3>;
+  using PointType = TransformType::InputPointType;
+
+  TransformType::Pointer CreateTransform(TransformType::ParametersType& parameters)
+  {
+    const auto transform = TransformType::New();
+    TransformType::OriginType gridOrigin;
+    gridOrigin.Fill(-4.0);
+    TransformType::SpacingType gridSpacing;
+    gridSpacing.Fill(4.0);
+    TransformType::SizeType gridSize;
+    gridSize.Fill(8);
+    transform->SetGridOrigin(gridOrigin);
+    transform->SetGridSpacing(gridSpacing);
+    transform->SetGridRegion(TransformType::RegionType(gridSize));
+
+    parameters.SetSize(transform->GetNumberOfParameters());
+    for (unsigned int i = 0; i < parameters.GetSize(); ++i)
+    {
+      parameters[i] = std::sin(0.7 * i);
+    }
+    transform->SetParameters(parameters);
+    return transform;
+  }
+
+  void PrecomputeWeightTables(TransformType& transform)
+  {
+    TransformType::OriginType latticeOrigin;
+    latticeOrigin.Fill(0.5);
+    TransformType::SpacingType latticeSpacing;
+    latticeSpacing.Fill(1.0);
+    TransformType::DirectionType latticeDirection;
+    latticeDirection.SetIdentity();
+    TransformType::SizeType latticeSize;
+    latticeSize.Fill(16);
+    transform.PrecomputeWeightTables(latticeOrigin, latticeSpacing, latticeDirection,
+      TransformType::RegionType(latticeSize));
+  }
+
+  void ExpectEqualTransformations(const TransformType& expected, const TransformType& actual, const PointType& point)
+  {
+    const auto expectedPoint = expected.TransformPoint(point);
+    const auto actualPoint = actual.TransformPoint(point);
+    for (unsigned int d = 0; d < 2; ++d)
+    {
+      EXPECT_NEAR(actualPoint[d], expectedPoint[d], 1e-10);
+    }
+
+    TransformType::JacobianType expectedJacobian;
+    TransformType::JacobianType actualJacobian;
+    TransformType::NonZeroJacobianIndicesType expectedIndices;
+    TransformType::NonZeroJacobianIndicesType actualIndices;
+    expected.GetJacobian(point, expectedJacobian, expectedIndices);
+    actual.GetJacobian(point, actualJacobian, actualIndices);
+    EXPECT_EQ(actualIndices, expectedIndices);
+    for (unsigned int i = 0; i < expectedJacobian.rows(); ++i)
+    {
+      for (unsigned int j = 0; j < expectedJacobian.cols(); ++j)
+      {
+        EXPECT_NEAR(actualJacobian[i][j], expectedJacobian[i][j], 1e-10);
+      }
+    }
+  }
+}
+
+
+GTEST_TEST(AdvancedBSplineDeformableTransform, WeightTablesGiveTheSameResultOnTheLattice)
+{
+  TransformType::ParametersType parameters;
+  TransformType::ParametersType parametersWithTables;
+  const auto transform = CreateTransform(parameters);
+  const auto transformWithTables = CreateTransform(parametersWithTables);
+  PrecomputeWeightTables(*transformWithTables);
+  ASSERT_TRUE(transformWithTables->GetHasWeightTables());
+
+  for (unsigned int y = 0; y < 16; ++y)
+  {
+    for (unsigned int x = 0; x < 16; ++x)
+    {
+      PointType point;
+      point[0] = 0.5 + x;
+      point[1] = 0.5 + y;
+      ExpectEqualTransformations(*transform, *transformWithTables, point);
+    }
+  }
+}
+
+
+GTEST_TEST(AdvancedBSplineDeformableTransform, WeightTablesGiveTheSameResultOffTheLattice)
+{
+  TransformType::ParametersType parameters;
+  TransformType::ParametersType parametersWithTables;
+  const auto transform = CreateTransform(parameters);
+  const auto transformWithTables = CreateTransform(parametersWithTables);
+  PrecomputeWeightTables(*transformWithTables);
+
+  for (unsigned int i = 0; i < 20; ++i)
+  {
+    PointType point;
+    point[0] = 0.3 + 0.77 * i;
+    point[1] = 15.2 - 0.61 * i;
+    ExpectEqualTransformations(*transform, *transformWithTables, point);
+  }
+}
+
+
+GTEST_TEST(AdvancedBSplineDeformableTransform, ChangingTheGridRemovesTheWeightTables)
+{
+  TransformType::ParametersType parameters;
+  const auto transform = CreateTransform(parameters);
+  PrecomputeWeightTables(*transform);
+  ASSERT_TRUE(transform->GetHasWeightTables());
+
+  TransformType::SpacingType gridSpacing;
+  gridSpacing.Fill(3.0);
+  transform->SetGridSpacing(gridSpacing);
+  EXPECT_FALSE(transform->GetHasWeightTables());
+}
+
+
+GTEST_TEST(AdvancedBSplineDeformableTransform, RotatedLatticeHasNoWeightTables)
+{
+  TransformType::ParametersType parameters;
+  const auto transform = CreateTransform(parameters);
+
+  TransformType::OriginType latticeOrigin;
+  latticeOrigin.Fill(0.5);
+  TransformType::SpacingType latticeSpacing;
+  latticeSpacing.Fill(1.0);
+  TransformType::DirectionType latticeDirection;
+  latticeDirection[0][0] = std::cos(0.1);
+  latticeDirection[0][1] = -std::sin(0.1);
+  latticeDirection[1][0] = std::sin(0.1);
+  latticeDirection[1][1] = std::cos(0.1);
+  TransformType::SizeType latticeSize;
+  latticeSize.Fill(16);
+  transform->PrecomputeWeightTables(latticeOrigin, latticeSpacing, latticeDirection,
+    TransformType::RegionType(latticeSize));
+  EXPECT_FALSE(transform->GetHasWeightTables());
+}
+
+
+GTEST_TEST(AdvancedBSplineDeformableTransform, CompactCoefficientsGiveTheSameTransformation)
+{
+  TransformType::ParametersType parameters;
+  TransformType::ParametersType compactParameters;
+  const auto transform = CreateTransform(parameters);
+  const auto compactTransform = CreateTransform(compactParameters);
+  compactTransform->SetUseCompactCoefficients(true);
+  ASSERT_TRUE(compactTransform->GetUseCompactCoefficients());
+
+  for (unsigned int i = 0; i < 20; ++i)
+  {
+    PointType point;
+    point[0] = 0.3 + 0.77 * i;
+    point[1] = 15.2 - 0.61 * i;
+    const auto expectedPoint = transform->TransformPoint(point);
+    const auto actualPoint = compactTransform->TransformPoint(point);
+    for (unsigned int d = 0; d < 2; ++d)
+    {
+      EXPECT_NEAR(actualPoint[d], expectedPoint[d], 1e-5);
+    }
+  }
+}
+
+
+GTEST_TEST(AdvancedBSplineDeformableTransform, SetParametersUpdatesTheCompactCoefficients)
+{
+  TransformType::ParametersType parameters;
+  const auto transform = CreateTransform(parameters);
+  transform->SetUseCompactCoefficients(true);
+
+  TransformType::ParametersType zeroParameters(transform->GetNumberOfParameters());
+  zeroParameters.Fill(0.0);
+  transform->SetParameters(zeroParameters);
+
+  PointType point;
+  point[0] = 5.3;
+  point[1] = 7.1;
+  const auto transformedPoint = transform->TransformPoint(point);
+  for (unsigned int d = 0; d < 2; ++d)
+  {
+    EXPECT_EQ(transformedPoint[d], point[d]);
+  }
+}
+
+
+GTEST_TEST(AdvancedBSplineDeformableTransform, TransformScanlineEqualsTransformPoint)
+{
+  TransformType::ParametersType parameters;
+  const auto transform = CreateTransform(parameters);
+
+  // An aligned scanline uses the column sums, an oblique one falls back to TransformPoint.
+  for (const double stepY : { 0.0, 0.13 })
+  {
+    PointType startPoint;
+    startPoint[0] = -6.0;
+    startPoint[1] = 3.7;
+    TransformType::InputVectorType step;
+    step[0] = 0.45;
+    step[1] = stepY;
+
+    const unsigned int numberOfPoints = 60;
+    std::vector<PointType> outputPoints(numberOfPoints);
+    transform->TransformScanline(startPoint, step, outputPoints.data(), numberOfPoints);
+
+    for (unsigned int i = 0; i < numberOfPoints; ++i)
+    {
+      const auto expectedPoint = transform->TransformPoint(startPoint + step * static_cast<double>(i));
+      for (unsigned int d = 0; d < 2; ++d)
+      {
+        EXPECT_NEAR(outputPoints[i][d], expectedPoint[d], 1e-10);
+      }
+    }
+  }
+}
+
+
+GTEST_TEST(AdvancedBSplineDeformableTransform, GetSpatialJacobianScanlineEqualsGetSpatialJacobian)
+{
+  TransformType::ParametersType parameters;
+  const auto transform = CreateTransform(parameters);
+
+  // An aligned scanline uses the column sums, an oblique one falls back to GetSpatialJacobian.
+  for (const double stepY : { 0.0, 0.13 })
+  {
+    PointType startPoint;
+    startPoint[0] = -6.0;
+    startPoint[1] = 3.7;
+    TransformType::InputVectorType step;
+    step[0] = 0.45;
+    step[1] = stepY;
+
+    const unsigned int numberOfPoints = 60;
+    std::vector<TransformType::SpatialJacobianType> sjs(numberOfPoints);
+    transform->GetSpatialJacobianScanline(startPoint, step, sjs.data(), numberOfPoints);
+
+    for (unsigned int i = 0; i < numberOfPoints; ++i)
+    {
+      TransformType::SpatialJacobianType expectedSJ;
+      transform->GetSpatialJacobian(startPoint + step * static_cast<double>(i), expectedSJ);
+      for (unsigned int r = 0; r < 2; ++r)
+      {
+        for (unsigned int c = 0; c < 2; ++c)
+        {
+          EXPECT_NEAR(sjs[i](r, c), expectedSJ(r, c), 1e-10);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,129 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkAdvancedCombinationTransform.h"
+
+#include "itkAdvancedTranslationTransform.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+namespace
+{
+  using CombinationTransformType = itk::AdvancedCombinationTransform<double, 2>;
+  using TranslationTransformType = itk::AdvancedTranslationTransform<double, 2>;
+  using PointType = CombinationTransformType::InputPointType;
+
+  TranslationTransformType::Pointer CreateTranslation(const double x, const double y)
+  {
+    const auto transform = TranslationTransformType::New();
+    TranslationTransformType::OutputVectorType offset;
+    offset[0] = x;
+    offset[1] = y;
+    transform->SetOffset(offset);
+    return transform;
+  }
+
+  void ExpectTransformPointsEqualsTransformPoint(const CombinationTransformType& transform)
+  {
+    std::vector<PointType> inputPoints(5);
+    for (unsigned int i = 0; i < inputPoints.size(); ++i)
+    {
+      inputPoints[i][0] = i;
+      inputPoints[i][1] = 0.5 * i;
+    }
+
+    std::vector<PointType> outputPoints(inputPoints.size());
+    transform.TransformPoints(inputPoints.data(), outputPoints.data(), inputPoints.size());
+
+    for (unsigned int i = 0; i < inputPoints.size(); ++i)
+    {
+      EXPECT_EQ(outputPoints[i], transform.TransformPoint(inputPoints[i]));
+    }
+  }
+}
+
+
+GTEST_TEST(AdvancedCombinationTransform, TransformPointsWithoutInitialTransform)
+{
+  const auto transform = CombinationTransformType::New();
+  transform->SetCurrentTransform(CreateTranslation(1.0, 2.0));
+  ExpectTransformPointsEqualsTransformPoint(*transform);
+}
+
+
+GTEST_TEST(AdvancedCombinationTransform, TransformPointsUseComposition)
+{
+  const auto transform = CombinationTransformType::New();
+  transform->SetInitialTransform(CreateTranslation(-3.0, 0.25));
+  transform->SetCurrentTransform(CreateTranslation(1.0, 2.0));
+  transform->SetUseComposition(true);
+  ExpectTransformPointsEqualsTransformPoint(*transform);
+}
+
+
+GTEST_TEST(AdvancedCombinationTransform, TransformPointsUseAddition)
+{
+  const auto transform = CombinationTransformType::New();
+  transform->SetInitialTransform(CreateTranslation(-3.0, 0.25));
+  transform->SetCurrentTransform(CreateTranslation(1.0, 2.0));
+  transform->SetUseAddition(true);
+  ExpectTransformPointsEqualsTransformPoint(*transform);
+}
+
+
+GTEST_TEST(AdvancedCombinationTransform, InitialTransformCacheIsUsedForCachedPoints)
+{
+  const auto transform = CombinationTransformType::New();
+  const auto initialTransform = CreateTranslation(-3.0, 0.25);
+  transform->SetInitialTransform(initialTransform);
+  transform->SetCurrentTransform(CreateTranslation(1.0, 2.0));
+  transform->SetUseComposition(true);
+
+  PointType cachedPoint;
+  cachedPoint[0] = 1.5;
+  cachedPoint[1] = -2.0;
+  const auto expectedPoint = transform->TransformPoint(cachedPoint);
+  transform->CacheInitialTransform(&cachedPoint, 1);
+  EXPECT_EQ(transform->GetNumberOfCachedInitialTransformPoints(), 1u);
+  EXPECT_EQ(transform->TransformPoint(cachedPoint), expectedPoint);
+
+  /** The cache assumes a constant initial transform, so a modification only
+   * affects the points that are not cached.
+   */
+  TranslationTransformType::OutputVectorType offset;
+  offset[0] = 5.0;
+  offset[1] = 5.0;
+  initialTransform->SetOffset(offset);
+  EXPECT_EQ(transform->TransformPoint(cachedPoint), expectedPoint);
+
+  PointType otherPoint;
+  otherPoint[0] = 0.0;
+  otherPoint[1] = 0.0;
+  const auto transformedPoint = transform->TransformPoint(otherPoint);
+  EXPECT_EQ(transformedPoint[0], 6.0);
+  EXPECT_EQ(transformedPoint[1], 7.0);
+  ExpectTransformPointsEqualsTransformPoint(*transform);
+
+  transform->SetInitialTransform(CreateTranslation(0.0, 0.0));
+  EXPECT_EQ(transform->GetNumberOfCachedInitialTransformPoints(), 0u);
+}
@@ -0,0 +1,116 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkAdvancedTransformToDisplacementFieldSource.h"
+
+#include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+
+namespace
+{
+  using BSplineTransformType = itk::AdvancedBSplineDeformableTransform<double, 2, 3>;
+  using DisplacementFieldType = itk::Image<itk::Vector<float, 2>, 2>;
+  using SourceType = itk::AdvancedTransformToDisplacementFieldSource<DisplacementFieldType, double>;
+
+  BSplineTransformType::Pointer CreateBSplineTransform()
+  {
+    const auto transform = BSplineTransformType::New();
+    BSplineTransformType::OriginType gridOrigin;
+    gridOrigin.Fill(-4.0);
+    BSplineTransformType::SpacingType gridSpacing;
+    gridSpacing.Fill(4.0);
+    BSplineTransformType::SizeType gridSize;
+    gridSize.Fill(8);
+    transform->SetGridOrigin(gridOrigin);
+    transform->SetGridSpacing(gridSpacing);
+    transform->SetGridRegion(BSplineTransformType::RegionType(gridSize));
+
+    BSplineTransformType::ParametersType parameters(transform->GetNumberOfParameters());
+    for (unsigned int i = 0; i < parameters.GetSize(); ++i)
+    {
+      parameters[i] = std::sin(0.7 * i);
+    }
+    transform->SetParametersByValue(parameters);
+    return transform;
+  }
+
+  void ExpectDisplacementsOfTransform(const DisplacementFieldType& field, const BSplineTransformType& transform)
+  {
+    itk::ImageRegionConstIteratorWithIndex<DisplacementFieldType> it(&field, field.GetBufferedRegion());
+    for (; !it.IsAtEnd(); ++it)
+    {
+      DisplacementFieldType::PointType point;
+      field.TransformIndexToPhysicalPoint(it.GetIndex(), point);
+      const auto transformedPoint = transform.TransformPoint(point);
+      for (unsigned int d = 0; d < 2; ++d)
+      {
+        EXPECT_NEAR(it.Get()[d], transformedPoint[d] - point[d], 1e-5);
+      }
+    }
+  }
+}
+
+
+GTEST_TEST(AdvancedTransformToDisplacementFieldSource, DisplacementsEqualTransformPoint)
+{
+  const auto transform = CreateBSplineTransform();
+  const auto source = SourceType::New();
+  SourceType::SizeType size;
+  size[0] = 23;
+  size[1] = 17;
+  SourceType::SpacingType spacing;
+  spacing[0] = 0.9;
+  spacing[1] = 1.3;
+  SourceType::OriginType origin;
+  origin[0] = -2.0;
+  origin[1] = 1.5;
+  source->SetOutputSize(size);
+  source->SetOutputSpacing(spacing);
+  source->SetOutputOrigin(origin);
+  source->SetTransform(transform);
+  source->Update();
+
+  ExpectDisplacementsOfTransform(*source->GetOutput(), *transform);
+}
+
+
+GTEST_TEST(AdvancedTransformToDisplacementFieldSource, RotatedOutputEqualsTransformPoint)
+{
+  const auto transform = CreateBSplineTransform();
+  const auto source = SourceType::New();
+  SourceType::SizeType size;
+  size.Fill(15);
+  SourceType::DirectionType direction;
+  direction[0][0] = std::cos(0.3);
+  direction[0][1] = -std::sin(0.3);
+  direction[1][0] = std::sin(0.3);
+  direction[1][1] = std::cos(0.3);
+  source->SetOutputSize(size);
+  source->SetOutputDirection(direction);
+  source->SetTransform(transform);
+  source->Update();
+
+  ExpectDisplacementsOfTransform(*source->GetOutput(), *transform);
+}
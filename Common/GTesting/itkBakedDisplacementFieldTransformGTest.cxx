@@ -0,0 +1,133 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkBakedDisplacementFieldTransform.h"
+
+#include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkAdvancedTranslationTransform.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+
+namespace
+{
+  using BakedTransformType = itk::BakedDisplacementFieldTransform<double, 2>;
+  using BSplineTransformType = itk::AdvancedBSplineDeformableTransform<double, 2, 3>;
+  using TranslationTransformType = itk::AdvancedTranslationTransform<double, 2>;
+  using PointType = BakedTransformType::InputPointType;
+
+  BSplineTransformType::Pointer CreateBSplineTransform()
+  {
+    const auto transform = BSplineTransformType::New();
+    BSplineTransformType::OriginType gridOrigin;
+    gridOrigin.Fill(-4.0);
+    BSplineTransformType::SpacingType gridSpacing;
+    gridSpacing.Fill(4.0);
+    BSplineTransformType::SizeType gridSize;
+    gridSize.Fill(8);
+    transform->SetGridOrigin(gridOrigin);
+    transform->SetGridSpacing(gridSpacing);
+    transform->SetGridRegion(BSplineTransformType::RegionType(gridSize));
+
+    BSplineTransformType::ParametersType parameters(transform->GetNumberOfParameters());
+    for (unsigned int i = 0; i < parameters.GetSize(); ++i)
+    {
+      parameters[i] = std::sin(0.7 * i);
+    }
+    transform->SetParametersByValue(parameters);
+    return transform;
+  }
+
+  BakedTransformType::Pointer CreateBakedTransform(const BakedTransformType::BakedTransformType* transform)
+  {
+    const auto bakedTransform = BakedTransformType::New();
+    bakedTransform->SetBakedTransform(transform);
+    BakedTransformType::GridSizeType gridSize;
+    gridSize[0] = 9;
+    gridSize[1] = 7;
+    BakedTransformType::GridSpacingType gridSpacing;
+    gridSpacing.Fill(1.5);
+    BakedTransformType::GridOriginType gridOrigin;
+    gridOrigin[0] = 1.0;
+    gridOrigin[1] = 2.0;
+    bakedTransform->SetGridSize(gridSize);
+    bakedTransform->SetGridSpacing(gridSpacing);
+    bakedTransform->SetGridOrigin(gridOrigin);
+    bakedTransform->ComputeDisplacementField();
+    return bakedTransform;
+  }
+}
+
+
+GTEST_TEST(BakedDisplacementFieldTransform, GridPointsMatchBakedTransform)
+{
+  const auto transform = CreateBSplineTransform();
+  const auto bakedTransform = CreateBakedTransform(transform);
+
+  for (unsigned int i = 0; i < 9; ++i)
+  {
+    for (unsigned int j = 0; j < 7; ++j)
+    {
+      PointType point;
+      point[0] = 1.0 + 1.5 * i;
+      point[1] = 2.0 + 1.5 * j;
+      const auto expectedPoint = transform->TransformPoint(point);
+      const auto bakedPoint = bakedTransform->TransformPoint(point);
+      EXPECT_NEAR(bakedPoint[0], expectedPoint[0], 1e-5);
+      EXPECT_NEAR(bakedPoint[1], expectedPoint[1], 1e-5);
+    }
+  }
+}
+
+
+GTEST_TEST(BakedDisplacementFieldTransform, InterpolatesTranslationExactly)
+{
+  const auto transform = TranslationTransformType::New();
+  TranslationTransformType::OutputVectorType offset;
+  offset[0] = 0.25;
+  offset[1] = -3.0;
+  transform->SetOffset(offset);
+  const auto bakedTransform = CreateBakedTransform(transform);
+
+  PointType point;
+  point[0] = 3.3;
+  point[1] = 10.9;
+  const auto bakedPoint = bakedTransform->TransformPoint(point);
+  EXPECT_NEAR(bakedPoint[0], 3.55, 1e-6);
+  EXPECT_NEAR(bakedPoint[1], 7.9, 1e-6);
+}
+
+
+GTEST_TEST(BakedDisplacementFieldTransform, PointsOutsideGridUseBakedTransform)
+{
+  const auto transform = CreateBSplineTransform();
+  const auto bakedTransform = CreateBakedTransform(transform);
+
+  PointType point;
+  point[0] = 0.5;
+  point[1] = 5.0;
+  EXPECT_EQ(bakedTransform->TransformPoint(point), transform->TransformPoint(point));
+  point[0] = 14.5;
+  point[1] = 11.5;
+  EXPECT_EQ(bakedTransform->TransformPoint(point), transform->TransformPoint(point));
+  EXPECT_EQ(bakedTransform->GetNumberOfParameters(), 0u);
+}
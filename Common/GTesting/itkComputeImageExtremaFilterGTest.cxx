@@ -289,3 +289,39 @@ GTEST_TEST(ComputeImageExtremaFilter, OneNonZeroPixelValueMaskedIn)
   Expect_one_non_zero_pixel_value_masked_in<itk::Image<short, 3>>({ {2, 3, 4} });
   Expect_one_non_zero_pixel_value_masked_in<itk::Image<unsigned char, 4>>({ {2, 3, 4, 5} });
 }
+
+
+GTEST_TEST(ComputeImageExtremaFilter, MaximumNumberOfVoxelsVisitsEveryKthLine)
+{
+  using ImageType = itk::Image<short, 2>;
+
+  const auto image = ImageType::New();
+  image->SetRegions(ImageType::SizeType{ {4, 4} });
+  image->Allocate();
+
+  // Each pixel value equals the index of its line.
+  for (itk::IndexValueType y = 0; y < 4; ++y)
+  {
+    for (itk::IndexValueType x = 0; x < 4; ++x)
+    {
+      image->SetPixel({ {x, y} }, static_cast<short>(y));
+    }
+  }
+
+  const auto filter = ComputeImageExtremaFilter<ImageType>::New();
+  filter->SetInput(image);
+  filter->SetMaximumNumberOfVoxels(8);
+  filter->Update();
+
+  // Only the lines 0 and 2 are visited.
+  EXPECT_EQ(filter->GetMinimum(), 0);
+  EXPECT_EQ(filter->GetMaximum(), 2);
+  EXPECT_EQ(filter->GetSum(), 8.0);
+
+  filter->SetMaximumNumberOfVoxels(0);
+  filter->Update();
+
+  EXPECT_EQ(filter->GetMinimum(), 0);
+  EXPECT_EQ(filter->GetMaximum(), 3);
+  EXPECT_EQ(filter->GetSum(), 24.0);
+}
@@ -0,0 +1,256 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// First include the header file to be tested:
+#include "itkDenseLinearAlgebra.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+
+namespace
+{
+  using itk::DenseLinearAlgebra;
+  using MatrixType = vnl_matrix<double>;
+  using VectorType = vnl_vector<double>;
+
+  // Returns a rows x cols matrix with reproducible, well spread values.
+  MatrixType CreateMatrix(const unsigned int rows, const unsigned int cols, const double seed = 0.0)
+  {
+    MatrixType A(rows, cols);
+    for (unsigned int i = 0; i < rows; ++i)
+    {
+      for (unsigned int j = 0; j < cols; ++j)
+      {
+        A(i, j) = std::sin(1.7 * i + 0.3 * j * j + seed) + (i == j ? 2.0 : 0.0);
+      }
+    }
+    return A;
+  }
+
+
+  // Returns A^T * A, a symmetric positive semi-definite matrix.
+  MatrixType CreateSymmetricMatrix(const unsigned int n, const unsigned int rank)
+  {
+    const MatrixType A = CreateMatrix(rank, n);
+    MatrixType       S(n, n, 0.0);
+    for (unsigned int i = 0; i < n; ++i)
+    {
+      for (unsigned int j = 0; j < n; ++j)
+      {
+        for (unsigned int k = 0; k < rank; ++k)
+        {
+          S(i, j) += A(k, i) * A(k, j);
+        }
+      }
+    }
+    return S;
+  }
+
+
+  void ExpectEqualMatrices(const MatrixType& A, const MatrixType& B, const double tolerance)
+  {
+    ASSERT_EQ(A.rows(), B.rows());
+    ASSERT_EQ(A.cols(), B.cols());
+    for (unsigned int i = 0; i < A.rows(); ++i)
+    {
+      for (unsigned int j = 0; j < A.cols(); ++j)
+      {
+        EXPECT_NEAR(A(i, j), B(i, j), tolerance);
+      }
+    }
+  }
+
+
+  MatrixType Identity(const unsigned int n)
+  {
+    MatrixType I(n, n, 0.0);
+    I.set_identity();
+    return I;
+  }
+
+} // namespace
+
+
+GTEST_TEST(DenseLinearAlgebra, MultiplyEqualsVnlProduct)
+{
+  const MatrixType A = CreateMatrix(17, 9);
+  const MatrixType B = CreateMatrix(9, 13, 1.0);
+  const MatrixType D = CreateMatrix(17, 13, 2.0);
+
+  MatrixType C;
+  DenseLinearAlgebra::Multiply(A, B, C);
+  ExpectEqualMatrices(C, A * B, 1e-12);
+
+  DenseLinearAlgebra::TransposeMultiply(A, D, C);
+  ExpectEqualMatrices(C, A.transpose() * D, 1e-12);
+
+  vnl_matrix<float> Af(5, 4);
+  vnl_matrix<float> Bf(4, 3);
+  for (unsigned int i = 0; i < 4; ++i)
+  {
+    for (unsigned int j = 0; j < 5; ++j)
+    {
+      Af(j, i) = static_cast<float>(A(j, i));
+    }
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      Bf(i, j) = static_cast<float>(B(i, j));
+    }
+  }
+  vnl_matrix<float> Cf;
+  DenseLinearAlgebra::Multiply(Af, Bf, Cf);
+  const vnl_matrix<float> expected = Af * Bf;
+  ASSERT_EQ(Cf.rows(), 5u);
+  ASSERT_EQ(Cf.cols(), 3u);
+  for (unsigned int i = 0; i < 5; ++i)
+  {
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      EXPECT_NEAR(Cf(i, j), expected(i, j), 1e-5);
+    }
+  }
+}
+
+
+GTEST_TEST(DenseLinearAlgebra, QRInverseIsInverse)
+{
+  const unsigned int n = 24;
+  const MatrixType   A = CreateMatrix(n, n);
+
+  MatrixType inverse;
+  DenseLinearAlgebra::QRInverse(A, inverse);
+  ExpectEqualMatrices(A * inverse, Identity(n), 1e-10);
+}
+
+
+GTEST_TEST(DenseLinearAlgebra, PseudoInverseSatisfiesMoorePenroseConditions)
+{
+  // A singular matrix of rank 3.
+  const MatrixType A = CreateSymmetricMatrix(8, 3);
+
+  MatrixType inverse;
+  DenseLinearAlgebra::PseudoInverse(A, 1e-8, inverse);
+  ASSERT_EQ(inverse.rows(), A.cols());
+  ASSERT_EQ(inverse.cols(), A.rows());
+
+  ExpectEqualMatrices(A * inverse * A, A, 1e-9);
+  ExpectEqualMatrices(inverse * A * inverse, inverse, 1e-9);
+  ExpectEqualMatrices((A * inverse).transpose(), A * inverse, 1e-9);
+
+  // A non-singular matrix has its inverse as pseudo-inverse.
+  const MatrixType B = CreateMatrix(10, 10);
+  DenseLinearAlgebra::PseudoInverse(B, 0.0, inverse);
+  ExpectEqualMatrices(B * inverse, Identity(10), 1e-10);
+}
+
+
+GTEST_TEST(DenseLinearAlgebra, SymmetricEigensystemReturnsAscendingEigenPairs)
+{
+  const unsigned int n = 12;
+  const MatrixType   S = CreateSymmetricMatrix(n, n);
+
+  VectorType eigenValues;
+  MatrixType eigenVectors;
+  DenseLinearAlgebra::SymmetricEigensystem(S, eigenValues, eigenVectors);
+  ASSERT_EQ(eigenValues.size(), n);
+  ASSERT_EQ(eigenVectors.rows(), n);
+  ASSERT_EQ(eigenVectors.cols(), n);
+
+  for (unsigned int j = 0; j < n; ++j)
+  {
+    if (j > 0)
+    {
+      EXPECT_LE(eigenValues[j - 1], eigenValues[j]);
+    }
+    const VectorType v = eigenVectors.get_column(j);
+    EXPECT_NEAR(v.magnitude(), 1.0, 1e-12);
+
+    const VectorType residual = S * v - eigenValues[j] * v;
+    EXPECT_NEAR(residual.magnitude(), 0.0, 1e-10 * eigenValues[n - 1]);
+  }
+}
+
+
+GTEST_TEST(DenseLinearAlgebra, SingularValuesOfSymmetricMatrixAreDescendingEigenValues)
+{
+  const unsigned int n = 10;
+  const MatrixType   S = CreateSymmetricMatrix(n, 6);
+
+  VectorType singularValues;
+  MatrixType V;
+  DenseLinearAlgebra::SingularValueDecomposition(S, singularValues, V);
+  ASSERT_EQ(singularValues.size(), n);
+  ASSERT_EQ(V.rows(), n);
+
+  VectorType eigenValues;
+  MatrixType eigenVectors;
+  DenseLinearAlgebra::SymmetricEigensystem(S, eigenValues, eigenVectors);
+
+  for (unsigned int j = 0; j < n; ++j)
+  {
+    EXPECT_NEAR(singularValues[j], std::abs(eigenValues[n - 1 - j]), 1e-10 * singularValues[0]);
+  }
+
+  // The columns of V with a non-zero singular value are eigenvectors.
+  for (unsigned int j = 0; j < 6; ++j)
+  {
+    const VectorType v        = V.get_column(j);
+    const VectorType residual = S * v - singularValues[j] * v;
+    EXPECT_NEAR(residual.magnitude(), 0.0, 1e-9 * singularValues[0]);
+  }
+}
+
+
+GTEST_TEST(DenseLinearAlgebra, MatrixExponentialOfRotationGenerator)
+{
+  const double angle = 0.7;
+  MatrixType   A(3, 3, 0.0);
+  A(0, 1) = -angle;
+  A(1, 0) = angle;
+
+  MatrixType expected(3, 3, 0.0);
+  expected(0, 0) = std::cos(angle);
+  expected(0, 1) = -std::sin(angle);
+  expected(1, 0) = std::sin(angle);
+  expected(1, 1) = std::cos(angle);
+  expected(2, 2) = 1.0;
+
+  MatrixType exponential;
+  DenseLinearAlgebra::MatrixExponential(A, exponential);
+  ExpectEqualMatrices(exponential, expected, 1e-12);
+
+  vnl_matrix<float> Af(2, 2, 0.0f);
+  Af(0, 1) = static_cast<float>(-angle);
+  Af(1, 0) = static_cast<float>(angle);
+  vnl_matrix<float> exponentialf;
+  DenseLinearAlgebra::MatrixExponential(Af, exponentialf);
+  EXPECT_NEAR(exponentialf(0, 0), std::cos(angle), 1e-6);
+  EXPECT_NEAR(exponentialf(1, 0), std::sin(angle), 1e-6);
+}
+
+
+GTEST_TEST(DenseLinearAlgebra, NumberOfThreads)
+{
+  EXPECT_GE(DenseLinearAlgebra::GetNumberOfThreads(), 1u);
+  if (!DenseLinearAlgebra::IsUsingEigen())
+  {
+    EXPECT_EQ(DenseLinearAlgebra::GetNumberOfThreads(), 1u);
+  }
+}
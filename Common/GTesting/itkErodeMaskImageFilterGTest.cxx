@@ -0,0 +1,115 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkErodeMaskImageFilter.h"
+
+#include "itkParabolicErodeImageFilter.h"
+
+#include <itkImage.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIteratorWithIndex.h>
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using MaskImageType = itk::Image<unsigned char, 3>;
+  using ErodeMaskFilterType = itk::ErodeMaskImageFilter<MaskImageType>;
+  using ParabolicErodeFilterType = itk::ParabolicErodeImageFilter<MaskImageType, MaskImageType>;
+
+  /** A mask with a block, that is cut by any split of the image. */
+  MaskImageType::Pointer CreateMask()
+  {
+    MaskImageType::SizeType size = { { 24, 17, 19 } };
+    const auto maskImage = MaskImageType::New();
+    maskImage->SetRegions(size);
+    maskImage->Allocate();
+    maskImage->FillBuffer(0);
+
+    for (itk::ImageRegionIteratorWithIndex<MaskImageType> it(maskImage, maskImage->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+      const auto index = it.GetIndex();
+      if (index[0] > 2 && index[0] < 21 && index[1] > 1 && index[1] < 15 && index[2] > 3 && index[2] < 16)
+      {
+        it.Set(1);
+      }
+    }
+    return maskImage;
+  }
+
+  bool AreEqual(const MaskImageType * image1, const MaskImageType * image2)
+  {
+    itk::ImageRegionConstIterator<MaskImageType> it1(image1, image1->GetBufferedRegion());
+    itk::ImageRegionConstIterator<MaskImageType> it2(image2, image2->GetBufferedRegion());
+    for (; !it1.IsAtEnd(); ++it1, ++it2)
+    {
+      if (it1.Get() != it2.Get())
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+
+GTEST_TEST(ErodeMaskImageFilter, MultiThreadedErosionAgreesWithSingleThreaded)
+{
+  const auto maskImage = CreateMask();
+
+  MaskImageType::Pointer outputs[2];
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    const auto erosion = ParabolicErodeFilterType::New();
+    erosion->SetScale(5.0);
+    erosion->SetInput(maskImage);
+    erosion->SetNumberOfWorkUnits(i == 0 ? 1 : 5);
+    erosion->Update();
+    outputs[i] = erosion->GetOutput();
+  }
+
+  EXPECT_TRUE(AreEqual(outputs[0], outputs[1]));
+}
+
+
+GTEST_TEST(ErodeMaskImageFilter, CachedErosionAgreesWithErosion)
+{
+  const auto maskImage = CreateMask();
+  ErodeMaskFilterType::ScheduleType schedule(2, 3);
+  schedule.Fill(2);
+  ErodeMaskFilterType::ClearCache();
+
+  MaskImageType::Pointer outputs[3];
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    const auto erosion = ErodeMaskFilterType::New();
+    erosion->SetInput(maskImage);
+    erosion->SetSchedule(schedule);
+    erosion->SetIsMovingMask(true);
+    erosion->SetUseCache(i > 0);
+    erosion->Update();
+    outputs[i] = erosion->GetOutput();
+  }
+
+  EXPECT_TRUE(AreEqual(outputs[0], outputs[1]));
+  EXPECT_EQ(outputs[1]->GetBufferPointer(), outputs[2]->GetBufferPointer());
+  ErodeMaskFilterType::ClearCache();
+}
@@ -0,0 +1,157 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkAdvancedTransform.h"
+
+#include "itkAdvancedEuler3DTransform.h"
+#include "itkAdvancedMatrixOffsetTransformBase.h"
+#include "itkAdvancedRigid2DTransform.h"
+#include "itkAdvancedSimilarity2DTransform.h"
+#include "itkAdvancedSimilarity3DTransform.h"
+#include "itkAdvancedTranslationTransform.h"
+#include "itkAdvancedVersorRigid3DTransform.h"
+#include "itkStackTransform.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+
+namespace
+{
+  template <typename TTransform>
+  void SetArbitraryParameters(TTransform& transform)
+  {
+    auto parameters = transform.GetParameters();
+    for (unsigned int i = 0; i < parameters.GetSize(); ++i)
+    {
+      parameters[i] += 0.1 * std::sin(1.3 * i + 0.4);
+    }
+    transform.SetParameters(parameters);
+  }
+
+  template <typename TTransform>
+  void ExpectFusedProductEqualsDenseProduct(const TTransform& transform, const typename TTransform::InputPointType& point)
+  {
+    using DerivativeType = typename TTransform::DerivativeType;
+    constexpr auto dimension = TTransform::OutputSpaceDimension;
+
+    typename TTransform::MovingImageGradientType gradient;
+    for (unsigned int d = 0; d < dimension; ++d)
+    {
+      gradient[d] = 0.5 + std::cos(2.1 * d + 0.3);
+    }
+
+    typename TTransform::JacobianType jacobian;
+    typename TTransform::NonZeroJacobianIndicesType expectedIndices;
+    transform.GetJacobian(point, jacobian, expectedIndices);
+
+    DerivativeType imageJacobian(transform.GetNumberOfNonZeroJacobianIndices());
+    imageJacobian.Fill(12345.0);
+    typename TTransform::NonZeroJacobianIndicesType actualIndices;
+    transform.EvaluateJacobianWithImageGradientProduct(point, gradient, imageJacobian, actualIndices);
+
+    EXPECT_EQ(actualIndices, expectedIndices);
+    ASSERT_EQ(imageJacobian.GetSize(), jacobian.cols());
+    for (unsigned int mu = 0; mu < jacobian.cols(); ++mu)
+    {
+      double expected = 0.0;
+      for (unsigned int d = 0; d < dimension; ++d)
+      {
+        expected += gradient[d] * jacobian[d][mu];
+      }
+      EXPECT_NEAR(imageJacobian[mu], expected, 1e-10);
+    }
+  }
+
+  template <typename TTransform>
+  void TestTransform(TTransform& transform)
+  {
+    typename TTransform::InputPointType center;
+    for (unsigned int d = 0; d < TTransform::InputSpaceDimension; ++d)
+    {
+      center[d] = 1.5 - d;
+    }
+    transform.SetCenter(center);
+    SetArbitraryParameters(transform);
+
+    typename TTransform::InputPointType point;
+    for (unsigned int d = 0; d < TTransform::InputSpaceDimension; ++d)
+    {
+      point[d] = 3.0 + 2.0 * d;
+    }
+    ExpectFusedProductEqualsDenseProduct(transform, point);
+  }
+}
+
+
+GTEST_TEST(EvaluateJacobianWithImageGradientProduct, MatrixOffsetTransforms)
+{
+  TestTransform(*itk::AdvancedMatrixOffsetTransformBase<double, 2, 2>::New());
+  TestTransform(*itk::AdvancedMatrixOffsetTransformBase<double, 3, 3>::New());
+  TestTransform(*itk::AdvancedEuler3DTransform<double>::New());
+  TestTransform(*itk::AdvancedRigid2DTransform<double>::New());
+  TestTransform(*itk::AdvancedSimilarity2DTransform<double>::New());
+  TestTransform(*itk::AdvancedSimilarity3DTransform<double>::New());
+  TestTransform(*itk::AdvancedVersorRigid3DTransform<double>::New());
+}
+
+
+GTEST_TEST(EvaluateJacobianWithImageGradientProduct, TranslationTransform)
+{
+  const auto transform = itk::AdvancedTranslationTransform<double, 3>::New();
+  SetArbitraryParameters(*transform);
+
+  itk::AdvancedTranslationTransform<double, 3>::InputPointType point;
+  point.Fill(2.0);
+  ExpectFusedProductEqualsDenseProduct(*transform, point);
+}
+
+
+GTEST_TEST(EvaluateJacobianWithImageGradientProduct, StackTransform)
+{
+  using SubTransformType = itk::AdvancedRigid2DTransform<double>;
+  using StackTransformType = itk::StackTransform<double, 3, 3>;
+
+  const auto transform = StackTransformType::New();
+  const unsigned int numberOfSubTransforms = 4;
+  transform->SetNumberOfSubTransforms(numberOfSubTransforms);
+  transform->SetStackOrigin(0.0);
+  transform->SetStackSpacing(1.0);
+  for (unsigned int i = 0; i < numberOfSubTransforms; ++i)
+  {
+    const auto subTransform = SubTransformType::New();
+    auto parameters = subTransform->GetParameters();
+    parameters[0] = 0.1 * i;
+    parameters[1] = 1.0 + i;
+    parameters[2] = -2.0 * i;
+    subTransform->SetParameters(parameters);
+    transform->SetSubTransform(i, subTransform);
+  }
+
+  for (unsigned int i = 0; i < numberOfSubTransforms; ++i)
+  {
+    StackTransformType::InputPointType point;
+    point[0] = 1.5;
+    point[1] = -0.5;
+    point[2] = i;
+    ExpectFusedProductEqualsDenseProduct(*transform, point);
+  }
+}
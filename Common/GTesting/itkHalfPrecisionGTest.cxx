@@ -0,0 +1,107 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkHalfPrecision.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+
+namespace
+{
+  using itk::HalfPrecision;
+
+  bool IsNaN(const HalfPrecision::HalfType half)
+  {
+    return (half & 0x7c00u) == 0x7c00u && (half & 0x03ffu) != 0;
+  }
+}
+
+
+GTEST_TEST(HalfPrecision, RoundTripOfAllHalves)
+{
+  for (std::uint32_t i = 0; i <= 0xffffu; ++i)
+  {
+    const auto half = static_cast<HalfPrecision::HalfType>(i);
+    if (IsNaN(half))
+    {
+      EXPECT_TRUE(std::isnan(HalfPrecision::ToFloat(half)));
+      EXPECT_TRUE(IsNaN(HalfPrecision::FromFloat(HalfPrecision::ToFloat(half))));
+    }
+    else
+    {
+      EXPECT_EQ(HalfPrecision::FromFloat(HalfPrecision::ToFloat(half)), half);
+    }
+  }
+}
+
+
+GTEST_TEST(HalfPrecision, KnownValues)
+{
+  EXPECT_EQ(HalfPrecision::FromFloat(0.0f), 0x0000u);
+  EXPECT_EQ(HalfPrecision::FromFloat(-0.0f), 0x8000u);
+  EXPECT_EQ(HalfPrecision::FromFloat(1.0f), 0x3c00u);
+  EXPECT_EQ(HalfPrecision::FromFloat(-2.0f), 0xc000u);
+  EXPECT_EQ(HalfPrecision::FromFloat(65504.0f), 0x7bffu);
+  EXPECT_EQ(HalfPrecision::FromFloat(65519.0f), 0x7bffu);
+  EXPECT_EQ(HalfPrecision::FromFloat(65520.0f), 0x7c00u);
+  EXPECT_EQ(HalfPrecision::FromFloat(std::numeric_limits<float>::infinity()), 0x7c00u);
+  EXPECT_EQ(HalfPrecision::FromFloat(std::ldexp(1.0f, -24)), 0x0001u);
+  EXPECT_EQ(HalfPrecision::FromFloat(std::ldexp(1.0f, -25)), 0x0000u);
+  EXPECT_EQ(HalfPrecision::FromFloat(std::ldexp(1.5f, -25)), 0x0001u);
+  EXPECT_EQ(HalfPrecision::FromFloat(std::ldexp(1.0f, -14)), 0x0400u);
+  EXPECT_EQ(HalfPrecision::FromFloat(1e-10f), 0x0000u);
+}
+
+
+GTEST_TEST(HalfPrecision, RoundsToNearestEven)
+{
+  /** Halfway between 1 and the next half rounds down to the even 1, and
+   * halfway between the next two halves rounds up to the even one.
+   */
+  EXPECT_EQ(HalfPrecision::FromFloat(1.0f + std::ldexp(1.0f, -11)), 0x3c00u);
+  EXPECT_EQ(HalfPrecision::FromFloat(1.0f + 3.0f * std::ldexp(1.0f, -11)), 0x3c02u);
+  EXPECT_EQ(HalfPrecision::FromFloat(std::nextafter(1.0f + std::ldexp(1.0f, -11), 2.0f)), 0x3c01u);
+
+  /** The same in the subnormal range. */
+  EXPECT_EQ(HalfPrecision::FromFloat(std::ldexp(2.5f, -24)), 0x0002u);
+  EXPECT_EQ(HalfPrecision::FromFloat(std::ldexp(3.5f, -24)), 0x0004u);
+}
+
+
+GTEST_TEST(HalfPrecision, RelativeErrorOfNormalValues)
+{
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> distribution(-60000.0f, 60000.0f);
+
+  for (unsigned int i = 0; i < 100000; ++i)
+  {
+    const float value = distribution(generator);
+    const float converted = HalfPrecision::ToFloat(HalfPrecision::FromFloat(value));
+    if (std::abs(value) >= std::ldexp(1.0f, -14))
+    {
+      EXPECT_LE(std::abs(converted - value), std::ldexp(std::abs(value), -11));
+    }
+  }
+}
@@ -0,0 +1,173 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+// First include the header file to be tested:
+#include "itkImageFullSampler.h"
+
+#include <itkImage.h>
+#include <itkImageMaskSpatialObject.h>
+#include <itkImageRegionIteratorWithIndex.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 3>;
+  using SamplerType = itk::ImageFullSampler<ImageType>;
+  using MaskImageType = itk::Image<unsigned char, 3>;
+  using MaskSpatialObjectType = itk::ImageMaskSpatialObject<3>;
+
+  ImageType::Pointer CreateImage()
+  {
+    const auto image = ImageType::New();
+    ImageType::SizeType size;
+    size.Fill(9);
+    image->SetRegions(size);
+    image->Allocate();
+
+    itk::ImageRegionIteratorWithIndex<ImageType> it(image, image->GetBufferedRegion());
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+      const auto index = it.GetIndex();
+      it.Set(static_cast<float>(index[0] + 10 * index[1] + 100 * index[2]));
+    }
+    return image;
+  }
+
+  std::vector<SamplerType::ImageSampleType> GetSamples(const bool useMultiThread, const unsigned int numberOfWorkUnits)
+  {
+    const auto sampler = SamplerType::New();
+    sampler->SetInput(CreateImage());
+    sampler->SetUseMultiThread(useMultiThread);
+    sampler->SetNumberOfWorkUnits(numberOfWorkUnits);
+    sampler->Update();
+
+    const auto& output = *sampler->GetOutput();
+    return std::vector<SamplerType::ImageSampleType>(output.begin(), output.end());
+  }
+
+  MaskSpatialObjectType::Pointer CreateMask()
+  {
+    const auto maskImage = MaskImageType::New();
+    MaskImageType::SizeType size;
+    size.Fill(9);
+    maskImage->SetRegions(size);
+    maskImage->Allocate();
+
+    // Two separate runs on some of the scan lines.
+    itk::ImageRegionIteratorWithIndex<MaskImageType> it(maskImage, maskImage->GetBufferedRegion());
+    for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+    {
+      const auto index = it.GetIndex();
+      const bool inside = (index[1] % 3 == 1) && ((index[0] >= 2 && index[0] < 5) || index[0] == 7);
+      it.Set(inside ? 1 : 0);
+    }
+
+    const auto mask = MaskSpatialObjectType::New();
+    mask->SetImage(maskImage);
+    mask->Update();
+    return mask;
+  }
+
+  void ExpectImplicitSamplesEqualStoredSamples(const MaskSpatialObjectType* const mask)
+  {
+    const auto image = CreateImage();
+
+    const auto sampler = SamplerType::New();
+    sampler->SetInput(image);
+    sampler->SetMask(mask);
+    sampler->Update();
+    const std::vector<SamplerType::ImageSampleType> storedSamples(
+      sampler->GetOutput()->begin(), sampler->GetOutput()->end());
+
+    const auto implicitSampler = SamplerType::New();
+    implicitSampler->SetInput(image);
+    implicitSampler->SetMask(mask);
+    implicitSampler->SetUseImplicitOutput(true);
+    implicitSampler->Update();
+
+    EXPECT_EQ(implicitSampler->GetOutput()->Size(), 0u);
+    const auto implicitSamples = implicitSampler->GetImplicitOutput();
+    ASSERT_NE(implicitSamples, nullptr);
+    ASSERT_EQ(implicitSamples->Size(), storedSamples.size());
+
+    SamplerType::ImageSampleType sample;
+    for (std::size_t i = 0; i < storedSamples.size(); ++i)
+    {
+      implicitSamples->GetSample(i, sample);
+      EXPECT_EQ(sample.m_ImageCoordinates, storedSamples[i].m_ImageCoordinates);
+      EXPECT_EQ(sample.m_ImageValue, storedSamples[i].m_ImageValue);
+    }
+  }
+}
+
+
+GTEST_TEST(ImageFullSampler, ThreadedSamplesEqualSerialSamples)
+{
+  const auto serialSamples = GetSamples(false, 1);
+  ASSERT_EQ(serialSamples.size(), 729u);
+
+  for (const unsigned int numberOfWorkUnits : { 1u, 2u, 4u })
+  {
+    const auto threadedSamples = GetSamples(true, numberOfWorkUnits);
+    ASSERT_EQ(threadedSamples.size(), serialSamples.size());
+    for (std::size_t i = 0; i < serialSamples.size(); ++i)
+    {
+      EXPECT_EQ(threadedSamples[i].m_ImageCoordinates, serialSamples[i].m_ImageCoordinates);
+      EXPECT_EQ(threadedSamples[i].m_ImageValue, serialSamples[i].m_ImageValue);
+    }
+  }
+}
+
+
+GTEST_TEST(ImageFullSampler, RepeatedThreadedUpdatesKeepAllSamples)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateImage());
+  sampler->SetUseMultiThread(true);
+  sampler->SetNumberOfWorkUnits(3);
+  sampler->Update();
+
+  const auto& output = *sampler->GetOutput();
+  ASSERT_EQ(output.Size(), 729u);
+  const std::vector<SamplerType::ImageSampleType> previousSamples(output.begin(), output.end());
+
+  // The second update writes into the container that was swapped out
+  sampler->Modified();
+  sampler->Update();
+
+  ASSERT_EQ(output.Size(), 729u);
+  for (std::size_t i = 0; i < previousSamples.size(); ++i)
+  {
+    EXPECT_EQ(output.ElementAt(i).m_ImageCoordinates, previousSamples[i].m_ImageCoordinates);
+  }
+}
+
+
+GTEST_TEST(ImageFullSampler, ImplicitSamplesEqualStoredSamples)
+{
+  ExpectImplicitSamplesEqualStoredSamples(nullptr);
+}
+
+
+GTEST_TEST(ImageFullSampler, ImplicitSamplesEqualStoredSamplesInsideMask)
+{
+  ExpectImplicitSamplesEqualStoredSamples(CreateMask());
+}
@@ -0,0 +1,117 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkImageGradientImportanceSampler.h"
+
+#include <itkImage.h>
+#include <itkImageRegionIteratorWithIndex.h>
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 2>;
+  using SamplerType = itk::ImageGradientImportanceSampler<ImageType>;
+
+  // Creates an image of 32 x 32 pixels with a step edge between columns 15 and 16.
+  ImageType::Pointer CreateStepEdgeImage()
+  {
+    const auto image = ImageType::New();
+    ImageType::SizeType size;
+    size.Fill(32);
+    image->SetRegions(size);
+    image->Allocate();
+
+    itk::ImageRegionIteratorWithIndex<ImageType> it(image, image->GetBufferedRegion());
+    for (; !it.IsAtEnd(); ++it)
+    {
+      it.Set(it.GetIndex()[0] < 16 ? 0.0f : 100.0f);
+    }
+    return image;
+  }
+}
+
+
+GTEST_TEST(ImageGradientImportanceSampler, PrefersTheEdge)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateStepEdgeImage());
+  sampler->SetNumberOfSamples(10000);
+  sampler->Update();
+
+  const auto& output = *sampler->GetOutput();
+  ASSERT_EQ(output.Size(), 10000u);
+  EXPECT_EQ(sampler->GetNumberOfCandidateVoxels(), 32u * 32u);
+
+  // The two columns next to the edge have 90% of the density, plus their uniform share.
+  unsigned int numberOfEdgeSamples = 0;
+  for (const auto& sample : output)
+  {
+    const double x = sample.m_ImageCoordinates[0];
+    if (x == 15.0 || x == 16.0)
+    {
+      ++numberOfEdgeSamples;
+    }
+  }
+  EXPECT_GT(numberOfEdgeSamples, 8500u);
+  EXPECT_LT(numberOfEdgeSamples, 9500u);
+}
+
+
+GTEST_TEST(ImageGradientImportanceSampler, WeightedMeanIsUnbiased)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateStepEdgeImage());
+  sampler->SetNumberOfSamples(20000);
+  sampler->Update();
+
+  const auto& output = *sampler->GetOutput();
+  const auto& weights = sampler->GetSampleWeights();
+  ASSERT_TRUE(sampler->GetUseSampleWeights());
+  ASSERT_EQ(weights.size(), output.Size());
+
+  double weightedSum = 0.0;
+  double sumOfWeights = 0.0;
+  for (std::size_t i = 0; i < output.Size(); ++i)
+  {
+    weightedSum += weights[i] * output.ElementAt(i).m_ImageValue;
+    sumOfWeights += weights[i];
+  }
+
+  // The mean of the image is 50, and the weights have mean one.
+  EXPECT_NEAR(weightedSum / output.Size(), 50.0, 5.0);
+  EXPECT_NEAR(sumOfWeights / output.Size(), 1.0, 0.1);
+}
+
+
+GTEST_TEST(ImageGradientImportanceSampler, UniformFractionOneSamplesUniformly)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateStepEdgeImage());
+  sampler->SetUniformFraction(1.0);
+  sampler->SetNumberOfSamples(100);
+  sampler->Update();
+
+  for (const double weight : sampler->GetSampleWeights())
+  {
+    EXPECT_FLOAT_EQ(weight, 1.0);
+  }
+}
@@ -0,0 +1,171 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkImageGridSampler.h"
+
+#include <itkImage.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 2>;
+  using SamplerType = itk::ImageGridSampler<ImageType>;
+  using PointsType = std::vector<std::pair<double, double>>;
+
+  ImageType::Pointer CreateImage()
+  {
+    const auto image = ImageType::New();
+    ImageType::SizeType size;
+    size.Fill(10);
+    image->SetRegions(size);
+    image->Allocate();
+    image->FillBuffer(1.0f);
+    return image;
+  }
+
+  PointsType GetSamplePoints(const unsigned int tileSize, const bool useMortonOrder = false)
+  {
+    const auto sampler = SamplerType::New();
+    sampler->SetInput(CreateImage());
+    SamplerType::SampleGridSpacingType spacing;
+    spacing.Fill(2);
+    sampler->SetSampleGridSpacing(spacing);
+    sampler->SetTileSize(tileSize);
+    sampler->SetUseMortonOrder(useMortonOrder);
+    sampler->Update();
+
+    PointsType points;
+    for (const auto& sample : *sampler->GetOutput())
+    {
+      points.emplace_back(sample.m_ImageCoordinates[0], sample.m_ImageCoordinates[1]);
+    }
+    return points;
+  }
+}
+
+
+GTEST_TEST(ImageGridSampler, ScanLineOrderWithoutTiles)
+{
+  const auto points = GetSamplePoints(0);
+  ASSERT_EQ(points.size(), 25u);
+  EXPECT_EQ(points[0], std::make_pair(0.0, 0.0));
+  EXPECT_EQ(points[1], std::make_pair(2.0, 0.0));
+  EXPECT_EQ(points[4], std::make_pair(8.0, 0.0));
+  EXPECT_EQ(points[5], std::make_pair(0.0, 2.0));
+}
+
+
+GTEST_TEST(ImageGridSampler, TileOrderHasTheSameSamples)
+{
+  const auto points = GetSamplePoints(2);
+  ASSERT_EQ(points.size(), 25u);
+
+  // The first tile covers the first two grid points along each dimension.
+  EXPECT_EQ(points[0], std::make_pair(0.0, 0.0));
+  EXPECT_EQ(points[1], std::make_pair(2.0, 0.0));
+  EXPECT_EQ(points[2], std::make_pair(0.0, 2.0));
+  EXPECT_EQ(points[3], std::make_pair(2.0, 2.0));
+  EXPECT_EQ(points[4], std::make_pair(4.0, 0.0));
+
+  auto sortedPoints = points;
+  auto scanLinePoints = GetSamplePoints(0);
+  std::sort(sortedPoints.begin(), sortedPoints.end());
+  std::sort(scanLinePoints.begin(), scanLinePoints.end());
+  EXPECT_EQ(sortedPoints, scanLinePoints);
+}
+
+
+GTEST_TEST(ImageGridSampler, MortonOrderHasTheSameSamples)
+{
+  const auto points = GetSamplePoints(0, true);
+  ASSERT_EQ(points.size(), 25u);
+
+  // The voxel indices (0,0), (2,0), (0,2), (2,2) and (4,0) have the lowest Morton codes.
+  EXPECT_EQ(points[0], std::make_pair(0.0, 0.0));
+  EXPECT_EQ(points[1], std::make_pair(2.0, 0.0));
+  EXPECT_EQ(points[2], std::make_pair(0.0, 2.0));
+  EXPECT_EQ(points[3], std::make_pair(2.0, 2.0));
+  EXPECT_EQ(points[4], std::make_pair(4.0, 0.0));
+  EXPECT_EQ(points[24], std::make_pair(8.0, 8.0));
+
+  auto sortedPoints = points;
+  auto scanLinePoints = GetSamplePoints(0);
+  std::sort(sortedPoints.begin(), sortedPoints.end());
+  std::sort(scanLinePoints.begin(), scanLinePoints.end());
+  EXPECT_EQ(sortedPoints, scanLinePoints);
+}
+
+
+GTEST_TEST(ImageGridSampler, ReusesTheSamplesOfAnUnchangedGrid)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateImage());
+  SamplerType::SampleGridSpacingType spacing;
+  spacing.Fill(3);
+  sampler->SetSampleGridSpacing(spacing);
+  sampler->Update();
+  const std::size_t numberOfSamples = sampler->GetOutput()->Size();
+  ASSERT_EQ(numberOfSamples, 16u);
+
+  // Force the pipeline to execute again.
+  sampler->Modified();
+  sampler->Update();
+  EXPECT_EQ(sampler->GetOutput()->Size(), numberOfSamples);
+}
+
+
+GTEST_TEST(ImageGridSampler, ImplicitSamplesEqualStoredSamples)
+{
+  const auto image = CreateImage();
+  SamplerType::SampleGridSpacingType spacing;
+  spacing.Fill(3);
+
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(image);
+  sampler->SetSampleGridSpacing(spacing);
+  sampler->Update();
+  const auto& storedSamples = *sampler->GetOutput();
+
+  const auto implicitSampler = SamplerType::New();
+  implicitSampler->SetInput(image);
+  implicitSampler->SetSampleGridSpacing(spacing);
+  implicitSampler->SetUseImplicitOutput(true);
+  implicitSampler->Update();
+
+  const auto implicitSamples = implicitSampler->GetImplicitOutput();
+  ASSERT_NE(implicitSamples, nullptr);
+  ASSERT_EQ(implicitSamples->Size(), storedSamples.Size());
+
+  // The runs of grid points along the first dimension are read in blocks.
+  std::vector<SamplerType::ImageSampleType::PointType> points(storedSamples.Size());
+  std::vector<double> values(storedSamples.Size());
+  implicitSamples->GetSamples(0, storedSamples.Size(), points.data(), values.data());
+  for (std::size_t i = 0; i < storedSamples.Size(); ++i)
+  {
+    EXPECT_EQ(points[i], storedSamples.ElementAt(i).m_ImageCoordinates);
+    EXPECT_EQ(values[i], storedSamples.ElementAt(i).m_ImageValue);
+  }
+}
@@ -0,0 +1,97 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkImageMaskBitmap.h"
+
+#include <itkImage.h>
+#include <itkImageMaskSpatialObject.h>
+#include <itkImageRegionIteratorWithIndex.h>
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using BitmapType = itk::ImageMaskBitmap<3>;
+  using MaskSpatialObjectType = BitmapType::ImageMaskSpatialObjectType;
+  using MaskImageType = BitmapType::MaskImageType;
+}
+
+
+GTEST_TEST(ImageMaskBitmap, AgreesWithImageMaskSpatialObject)
+{
+  MaskImageType::SizeType size = { { 21, 10, 13 } };
+  MaskImageType::IndexType start = { { -3, 2, 0 } };
+  MaskImageType::SpacingType spacing;
+  spacing[0] = 0.5;
+  spacing[1] = 1.25;
+  spacing[2] = 2.0;
+  MaskImageType::PointType origin;
+  origin[0] = -10.0;
+  origin[1] = 4.0;
+  origin[2] = 1.5;
+
+  const auto maskImage = MaskImageType::New();
+  maskImage->SetRegions(MaskImageType::RegionType(start, size));
+  maskImage->SetSpacing(spacing);
+  maskImage->SetOrigin(origin);
+  maskImage->Allocate();
+  maskImage->FillBuffer(0);
+
+  /** A sphere that covers some blocks and leaves others empty. */
+  itk::SizeValueType numberOfInsideVoxels = 0;
+  for (itk::ImageRegionIteratorWithIndex<MaskImageType> it(maskImage, maskImage->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+  {
+    const auto index = it.GetIndex();
+    const double dx = index[0] - 4.0;
+    const double dy = index[1] - 6.0;
+    const double dz = index[2] - 5.0;
+    if (dx * dx + dy * dy + dz * dz < 16.0)
+    {
+      it.Set(1);
+      ++numberOfInsideVoxels;
+    }
+  }
+
+  const auto mask = MaskSpatialObjectType::New();
+  mask->SetImage(maskImage);
+  mask->Update();
+
+  const auto bitmap = BitmapType::New();
+  bitmap->SetMask(mask);
+  ASSERT_TRUE(bitmap->GetIsAccelerated());
+  EXPECT_EQ(bitmap->GetNumberOfInsideVoxels(), numberOfInsideVoxels);
+
+  /** Compare at points in between and outside the voxels. */
+  BitmapType::PointType point;
+  for (double x = -12.0; x < 2.0; x += 0.3)
+  {
+    for (double y = 3.0; y < 18.0; y += 0.7)
+    {
+      for (double z = 0.0; z < 30.0; z += 0.9)
+      {
+        point[0] = x;
+        point[1] = y;
+        point[2] = z;
+        EXPECT_EQ(bitmap->IsInsideInWorldSpace(point), mask->IsInsideInWorldSpace(point));
+      }
+    }
+  }
+}
@@ -0,0 +1,99 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkImageQuasiRandomCoordinateSampler.h"
+
+#include <itkImage.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 2>;
+  using SamplerType = itk::ImageQuasiRandomCoordinateSampler<ImageType>;
+
+  ImageType::Pointer CreateImage()
+  {
+    const auto image = ImageType::New();
+    ImageType::SizeType size;
+    size.Fill(16);
+    image->SetRegions(size);
+    image->Allocate();
+    image->FillBuffer(1.0f);
+    return image;
+  }
+}
+
+
+GTEST_TEST(ImageQuasiRandomCoordinateSampler, JitteredGridPutsOneSampleInEachCell)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateImage());
+  sampler->SetSequence(SamplerType::JitteredGrid);
+  sampler->SetNumberOfSamples(64);
+  sampler->Update();
+
+  const auto& output = *sampler->GetOutput();
+  ASSERT_EQ(output.Size(), 64u);
+
+  // The 8 x 8 cells divide the continuous index range [0, 15] of each dimension.
+  std::set<int> cells;
+  for (const auto& sample : output)
+  {
+    int cell = 0;
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+      const double coordinate = sample.m_ImageCoordinates[i];
+      ASSERT_GE(coordinate, 0.0);
+      ASSERT_LE(coordinate, 15.0);
+      cell = 8 * cell + std::min(static_cast<int>(coordinate / 15.0 * 8.0), 7);
+    }
+    cells.insert(cell);
+  }
+  EXPECT_EQ(cells.size(), 64u);
+}
+
+
+GTEST_TEST(ImageQuasiRandomCoordinateSampler, HaltonSamplesAreDistinctAndInside)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateImage());
+  sampler->SetNumberOfSamples(100);
+  sampler->Update();
+
+  const auto& output = *sampler->GetOutput();
+  ASSERT_EQ(output.Size(), 100u);
+
+  std::set<std::pair<double, double>> points;
+  for (const auto& sample : output)
+  {
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+      EXPECT_GE(sample.m_ImageCoordinates[i], 0.0);
+      EXPECT_LE(sample.m_ImageCoordinates[i], 15.0);
+    }
+    points.emplace(sample.m_ImageCoordinates[0], sample.m_ImageCoordinates[1]);
+  }
+  EXPECT_EQ(points.size(), 100u);
+}
@@ -0,0 +1,125 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkImageRandomCoordinateSampler.h"
+
+#include <itkImage.h>
+#include <itkMersenneTwisterRandomVariateGenerator.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 3>;
+  using SamplerType = itk::ImageRandomCoordinateSampler<ImageType>;
+
+  ImageType::Pointer CreateImage()
+  {
+    const auto image = ImageType::New();
+    ImageType::SizeType size;
+    size.Fill(16);
+    image->SetRegions(size);
+    image->Allocate();
+    image->FillBuffer(1.0f);
+    return image;
+  }
+
+  unsigned int CountSameSamples(
+    const std::vector<SamplerType::ImageSampleType>& previousSamples,
+    const SamplerType::ImageSampleContainerType& samples)
+  {
+    unsigned int count = 0;
+    for (std::size_t i = 0; i < previousSamples.size(); ++i)
+    {
+      if (previousSamples[i].m_ImageCoordinates == samples.ElementAt(i).m_ImageCoordinates)
+      {
+        ++count;
+      }
+    }
+    return count;
+  }
+}
+
+
+GTEST_TEST(ImageRandomCoordinateSampler, ReplacesOnlyRefreshFraction)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateImage());
+  sampler->SetNumberOfSamples(100);
+  sampler->SetSampleRefreshFraction(0.25);
+  sampler->Update();
+
+  const auto& output = *sampler->GetOutput();
+  ASSERT_EQ(output.Size(), 100u);
+  const std::vector<SamplerType::ImageSampleType> previousSamples(output.begin(), output.end());
+
+  sampler->SelectNewSamplesOnUpdate();
+  sampler->Update();
+
+  ASSERT_EQ(output.Size(), 100u);
+  EXPECT_EQ(CountSameSamples(previousSamples, output), 75u);
+}
+
+
+GTEST_TEST(ImageRandomCoordinateSampler, ReplacesAllSamplesByDefault)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateImage());
+  sampler->SetNumberOfSamples(100);
+  sampler->Update();
+
+  const auto& output = *sampler->GetOutput();
+  const std::vector<SamplerType::ImageSampleType> previousSamples(output.begin(), output.end());
+
+  sampler->SelectNewSamplesOnUpdate();
+  sampler->Update();
+
+  ASSERT_EQ(output.Size(), 100u);
+  EXPECT_EQ(CountSameSamples(previousSamples, output), 0u);
+}
+
+
+GTEST_TEST(ImageRandomCoordinateSampler, CounterBasedSamplesDoNotDependOnNumberOfWorkUnits)
+{
+  std::vector<SamplerType::ImageSampleType> samples[2];
+  for (unsigned int i = 0; i < 2; ++i)
+  {
+    itk::Statistics::MersenneTwisterRandomVariateGenerator::GetInstance()->SetSeed(121212);
+
+    const auto sampler = SamplerType::New();
+    sampler->SetInput(CreateImage());
+    sampler->SetNumberOfSamples(101);
+    sampler->SetUseCounterBasedRandomGenerator(true);
+    sampler->SetNumberOfWorkUnits(i == 0 ? 1 : 3);
+    sampler->Update();
+
+    const auto& output = *sampler->GetOutput();
+    ASSERT_EQ(output.Size(), 101u);
+    samples[i].assign(output.begin(), output.end());
+  }
+
+  for (std::size_t j = 0; j < samples[0].size(); ++j)
+  {
+    EXPECT_EQ(samples[0][j].m_ImageCoordinates, samples[1][j].m_ImageCoordinates);
+  }
+}
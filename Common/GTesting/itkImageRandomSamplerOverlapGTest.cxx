@@ -0,0 +1,87 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// First include the header file to be tested:
+#include "itkImageRandomSamplerOverlap.h"
+
+#include <itkImage.h>
+#include <itkTranslationTransform.h>
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 2>;
+  using SamplerType = itk::ImageRandomSamplerOverlap<ImageType>;
+
+  ImageType::Pointer CreateImage()
+  {
+    const auto image = ImageType::New();
+    ImageType::SizeType size;
+    size.Fill(32);
+    image->SetRegions(size);
+    image->Allocate();
+    image->FillBuffer(1.0f);
+    return image;
+  }
+}
+
+
+GTEST_TEST(ImageRandomSamplerOverlap, SamplesMapIntoMovingImage)
+{
+  const auto image = CreateImage();
+
+  // Shift the fixed image by 24 voxels along x, so only a quarter overlaps.
+  const auto transform = itk::TranslationTransform<double, 2>::New();
+  itk::TranslationTransform<double, 2>::OutputVectorType offset;
+  offset[0] = 24.0;
+  offset[1] = 0.0;
+  transform->SetOffset(offset);
+
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(image);
+  sampler->SetTransform(transform);
+  sampler->SetMovingImage(image);
+  sampler->SetNumberOfSamples(200);
+  sampler->SetLatticeSize(8);
+  sampler->Update();
+
+  EXPECT_EQ(sampler->GetNumberOfOverlappingCells(), 16u);
+
+  const auto& output = *sampler->GetOutput();
+  ASSERT_EQ(output.Size(), 200u);
+  for (const auto& sample : output)
+  {
+    const auto mappedPoint = transform->TransformPoint(sample.m_ImageCoordinates);
+    EXPECT_LT(mappedPoint[0], 31.5);
+  }
+}
+
+
+GTEST_TEST(ImageRandomSamplerOverlap, SamplesWholeRegionWithoutTransform)
+{
+  const auto sampler = SamplerType::New();
+  sampler->SetInput(CreateImage());
+  sampler->SetNumberOfSamples(100);
+  sampler->SetLatticeSize(4);
+  sampler->Update();
+
+  EXPECT_EQ(sampler->GetNumberOfOverlappingCells(), 16u);
+  EXPECT_EQ(sampler->GetOutput()->Size(), 100u);
+}
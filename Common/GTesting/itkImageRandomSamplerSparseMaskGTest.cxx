@@ -0,0 +1,97 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkImageRandomSamplerSparseMask.h"
+
+#include <itkImage.h>
+#include <itkImageMaskSpatialObject.h>
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 3>;
+  using MaskImageType = itk::Image<unsigned char, 3>;
+  using MaskSpatialObjectType = itk::ImageMaskSpatialObject<3>;
+  using SamplerType = itk::ImageRandomSamplerSparseMask<ImageType>;
+}
+
+
+GTEST_TEST(ImageRandomSamplerSparseMask, DrawsSamplesInsideMask)
+{
+  ImageType::SizeType size;
+  size.Fill(12);
+
+  const auto image = ImageType::New();
+  image->SetRegions(size);
+  image->Allocate();
+
+  const auto maskImage = MaskImageType::New();
+  maskImage->SetRegions(size);
+  maskImage->Allocate();
+  maskImage->FillBuffer(0);
+
+  /** Fill the image with its linear index, and mask two separate runs per scan line. */
+  float value = 0.0f;
+  itk::SizeValueType numberOfMaskVoxels = 0;
+  for (itk::IndexValueType z = 0; z < 12; ++z)
+  {
+    for (itk::IndexValueType y = 0; y < 12; ++y)
+    {
+      for (itk::IndexValueType x = 0; x < 12; ++x)
+      {
+        const ImageType::IndexType index = { { x, y, z } };
+        image->SetPixel(index, value++);
+        if ((y == 3 || y == 8) && ((x >= 2 && x < 5) || x == 9))
+        {
+          maskImage->SetPixel(index, 1);
+          ++numberOfMaskVoxels;
+        }
+      }
+    }
+  }
+
+  const auto mask = MaskSpatialObjectType::New();
+  mask->SetImage(maskImage);
+  mask->Update();
+
+  for (const bool useMultiThread : { false, true })
+  {
+    const auto sampler = SamplerType::New();
+    sampler->SetInput(image);
+    sampler->SetMask(mask);
+    sampler->SetNumberOfSamples(500);
+    sampler->SetUseMultiThread(useMultiThread);
+    sampler->Update();
+
+    EXPECT_EQ(sampler->GetNumberOfMaskVoxels(), numberOfMaskVoxels);
+
+    const auto& output = *sampler->GetOutput();
+    ASSERT_EQ(output.Size(), 500u);
+    for (const auto& sample : output)
+    {
+      ImageType::IndexType index;
+      ASSERT_TRUE(image->TransformPhysicalPointToIndex(sample.m_ImageCoordinates, index));
+      EXPECT_EQ(maskImage->GetPixel(index), 1);
+      EXPECT_EQ(sample.m_ImageValue, image->GetPixel(index));
+    }
+  }
+}
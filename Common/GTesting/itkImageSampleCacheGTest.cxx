@@ -0,0 +1,107 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkImageSampleCache.h"
+
+#include "itkImageFullSampler.h"
+
+#include <itkImage.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 2>;
+  using CacheType = itk::ImageSampleCache<ImageType>;
+  using SamplerType = itk::ImageFullSampler<ImageType>;
+
+  ImageType::Pointer CreateImage(const float value)
+  {
+    const auto image = ImageType::New();
+    ImageType::SizeType size;
+    size.Fill(6);
+    image->SetRegions(size);
+    image->Allocate();
+    image->FillBuffer(value);
+    return image;
+  }
+
+  SamplerType::Pointer CreateSampler(const ImageType * const image)
+  {
+    const auto sampler = SamplerType::New();
+    sampler->SetInput(image);
+    sampler->SetUseSampleCache(true);
+    sampler->Update();
+    return sampler;
+  }
+}
+
+
+GTEST_TEST(ImageSampleCache, FullSamplerReusesTheSamplesOfAnEqualImage)
+{
+  const auto cache = CacheType::GetInstance();
+  cache->Clear();
+  const auto numberOfHits = cache->GetNumberOfHits();
+
+  const auto firstSampler = CreateSampler(CreateImage(2.0f));
+  EXPECT_EQ(cache->GetNumberOfHits(), numberOfHits);
+  EXPECT_EQ(cache->GetNumberOfSamples(), 36u);
+
+  // Another image object with the same contents.
+  const auto secondSampler = CreateSampler(CreateImage(2.0f));
+  EXPECT_EQ(cache->GetNumberOfHits(), numberOfHits + 1);
+  ASSERT_EQ(secondSampler->GetOutput()->Size(), 36u);
+  EXPECT_EQ(secondSampler->GetOutput()->ElementAt(7).m_ImageCoordinates,
+    firstSampler->GetOutput()->ElementAt(7).m_ImageCoordinates);
+  EXPECT_EQ(secondSampler->GetOutput()->ElementAt(7).m_ImageValue, 2.0);
+
+  // Different contents give different samples.
+  const auto thirdSampler = CreateSampler(CreateImage(3.0f));
+  EXPECT_EQ(cache->GetNumberOfHits(), numberOfHits + 1);
+  EXPECT_EQ(thirdSampler->GetOutput()->ElementAt(7).m_ImageValue, 3.0);
+}
+
+
+GTEST_TEST(ImageSampleCache, ReadsTheSamplesFromTheDirectory)
+{
+  const auto cache = CacheType::GetInstance();
+  cache->Clear();
+  cache->SetDirectory(testing::TempDir());
+
+  const auto samples = std::make_shared<CacheType::SampleVectorType>(3);
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    (*samples)[i].m_ImageCoordinates.Fill(i);
+    (*samples)[i].m_ImageValue = 0.5 * i;
+  }
+  cache->Insert(12345, samples);
+  cache->Clear();
+
+  const auto found = cache->Find(12345);
+  cache->SetDirectory("");
+  ASSERT_NE(found, nullptr);
+  ASSERT_EQ(found->size(), 3u);
+  EXPECT_EQ((*found)[2].m_ImageCoordinates[1], 2.0);
+  EXPECT_EQ((*found)[2].m_ImageValue, 1.0);
+  EXPECT_EQ(cache->Find(54321), nullptr);
+}
@@ -0,0 +1,162 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// First include the header file to be tested:
+#include "itkLBFGSHistory.h"
+#include "itkParallelVectorOperations.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+
+namespace
+{
+  using itk::LBFGSHistory;
+  using VectorType = std::vector<double>;
+
+  VectorType CreateVector(const std::size_t size, const double offset, const double scale)
+  {
+    VectorType result(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      result[i] = offset + scale * std::sin(static_cast<double>(i % 101) + offset);
+    }
+    return result;
+  }
+
+
+  double InnerProduct(const VectorType& x, const VectorType& y)
+  {
+    double sum = 0.0;
+    for (std::size_t i = 0; i < x.size(); ++i)
+    {
+      sum += x[i] * y[i];
+    }
+    return sum;
+  }
+
+
+  // The two-loop recursion as in the netlib lbfgs, for pairs given from the oldest to the newest.
+  VectorType ComputeExpectedSearchDirection(const std::vector<VectorType>& s,
+                                            const std::vector<VectorType>& y,
+                                            const VectorType& gradient,
+                                            const VectorType& diagonal)
+  {
+    const std::size_t numberOfPairs = s.size();
+    VectorType q(gradient.size());
+    for (std::size_t j = 0; j < q.size(); ++j)
+    {
+      q[j] = -gradient[j];
+    }
+
+    VectorType alpha(numberOfPairs);
+    for (std::size_t k = numberOfPairs; k-- > 0;)
+    {
+      alpha[k] = InnerProduct(s[k], q) / InnerProduct(y[k], s[k]);
+      for (std::size_t j = 0; j < q.size(); ++j)
+      {
+        q[j] -= alpha[k] * y[k][j];
+      }
+    }
+    for (std::size_t j = 0; j < q.size(); ++j)
+    {
+      q[j] *= diagonal[j];
+    }
+    for (std::size_t k = 0; k < numberOfPairs; ++k)
+    {
+      const double beta = InnerProduct(y[k], q) / InnerProduct(y[k], s[k]);
+      for (std::size_t j = 0; j < q.size(); ++j)
+      {
+        q[j] += (alpha[k] - beta) * s[k][j];
+      }
+    }
+    return q;
+  }
+
+
+  void ExpectSearchDirection(const bool useSinglePrecision, const double relativeTolerance)
+  {
+    const unsigned int memory = 3;
+    const std::size_t size = 3 * itk::ParallelVectorOperations::MinimumChunkSize + 5;
+    const auto gradient = CreateVector(size, 0.5, 1.0);
+    const auto diagonal = CreateVector(size, 2.0, 0.5);
+
+    LBFGSHistory history;
+    history.Initialize(memory, size, useSinglePrecision);
+    EXPECT_EQ(history.GetMemory(), memory);
+    EXPECT_EQ(history.GetNumberOfParameters(), size);
+    EXPECT_EQ(history.GetUseSinglePrecision(), useSinglePrecision);
+
+    // Store five pairs, so that the ring buffer wraps around.
+    std::vector<VectorType> s;
+    std::vector<VectorType> y;
+    unsigned int next = 0;
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+      s.push_back(CreateVector(size, 0.1 * i, 1.0));
+      y.push_back(CreateVector(size, 0.1 * i, 1.5));
+      history.SetPair(next, s.back().data(), y.back().data());
+
+      const double rho = 1.0 / InnerProduct(s.back(), y.back());
+      const double yy = InnerProduct(y.back(), y.back());
+      EXPECT_NEAR(history.GetRho(next), rho, 1e-12 * std::abs(rho));
+      EXPECT_NEAR(history.GetSquaredNormOfY(next), yy, 1e-12 * yy);
+      next = (next + 1) % memory;
+    }
+
+    for (unsigned int numberOfPairs = 0; numberOfPairs <= memory; ++numberOfPairs)
+    {
+      const std::vector<VectorType> newestS(s.end() - numberOfPairs, s.end());
+      const std::vector<VectorType> newestY(y.end() - numberOfPairs, y.end());
+      const auto expected = ComputeExpectedSearchDirection(newestS, newestY, gradient, diagonal);
+
+      VectorType searchDir(size);
+      history.ComputeSearchDirection(gradient.data(), 1.0, diagonal.data(), next, numberOfPairs, searchDir.data());
+
+      const double tolerance = relativeTolerance * std::sqrt(InnerProduct(expected, expected));
+      for (std::size_t j = 0; j < size; ++j)
+      {
+        ASSERT_NEAR(searchDir[j], expected[j], tolerance);
+      }
+
+      // A scalar H0 equals a constant diagonal.
+      const VectorType constantDiagonal(size, 0.75);
+      const auto expectedScalar = ComputeExpectedSearchDirection(newestS, newestY, gradient, constantDiagonal);
+      history.ComputeSearchDirection(gradient.data(), 0.75, nullptr, next, numberOfPairs, searchDir.data());
+      for (std::size_t j = 0; j < size; ++j)
+      {
+        ASSERT_NEAR(searchDir[j], expectedScalar[j], tolerance);
+      }
+    }
+  }
+
+} // namespace
+
+
+GTEST_TEST(LBFGSHistory, ComputeSearchDirectionEqualsTwoLoopRecursion)
+{
+  ExpectSearchDirection(false, 1e-12);
+}
+
+
+GTEST_TEST(LBFGSHistory, ComputeSearchDirectionWithSinglePrecisionHistory)
+{
+  ExpectSearchDirection(true, 1e-5);
+}
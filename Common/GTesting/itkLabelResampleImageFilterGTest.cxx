@@ -0,0 +1,126 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkLabelResampleImageFilter.h"
+
+#include <itkCastImageFilter.h>
+#include <itkEuler3DTransform.h>
+#include <itkImage.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionConstIteratorWithIndex.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkNearestNeighborInterpolateImageFunction.h>
+#include <itkResampleImageFilter.h>
+#include <itkTranslationTransform.h>
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using InputImageType = itk::Image<float, 3>;
+  using LabelImageType = itk::Image<unsigned char, 3>;
+  using FilterType = itk::LabelResampleImageFilter<InputImageType, LabelImageType, double>;
+
+  /** Labels 1 to 4 in blocks, and 0 elsewhere. */
+  InputImageType::Pointer CreateLabelImage()
+  {
+    InputImageType::SizeType size = { { 20, 17, 15 } };
+    const auto image = InputImageType::New();
+    image->SetRegions(size);
+    image->Allocate();
+    for (itk::ImageRegionIteratorWithIndex<InputImageType> it(image, image->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+      const auto index = it.GetIndex();
+      const bool inside = index[0] > 1 && index[0] < 18 && index[1] > 1 && index[1] < 15 && index[2] > 1;
+      it.Set(inside ? static_cast<float>(1 + (index[0] / 6 + 2 * (index[1] / 8)) % 4) : 0.0f);
+    }
+    return image;
+  }
+}
+
+
+GTEST_TEST(LabelResampleImageFilter, NearestNeighborEqualsResampleImageFilter)
+{
+  using NearestInterpolatorType = itk::NearestNeighborInterpolateImageFunction<InputImageType, double>;
+  using ResampleFilterType = itk::ResampleImageFilter<InputImageType, InputImageType, double>;
+  using CastFilterType = itk::CastImageFilter<InputImageType, LabelImageType>;
+
+  const auto inputImage = CreateLabelImage();
+  const auto transform = itk::Euler3DTransform<double>::New();
+  transform->SetRotation(0.1, -0.2, 0.15);
+  itk::Euler3DTransform<double>::OutputVectorType translation;
+  translation.Fill(0.8);
+  transform->SetTranslation(translation);
+  const LabelImageType::SizeType outputSize = { { 18, 19, 13 } };
+
+  const auto filter = FilterType::New();
+  filter->SetInput(inputImage);
+  filter->SetTransform(transform);
+  filter->SetSize(outputSize);
+  filter->SetDefaultPixelValue(7);
+  filter->SetNumberOfWorkUnits(3);
+  filter->Update();
+
+  const auto resampler = ResampleFilterType::New();
+  resampler->SetInput(inputImage);
+  resampler->SetInterpolator(NearestInterpolatorType::New());
+  resampler->SetTransform(transform);
+  resampler->SetSize(outputSize);
+  resampler->SetDefaultPixelValue(7.0f);
+  const auto caster = CastFilterType::New();
+  caster->SetInput(resampler->GetOutput());
+  caster->Update();
+
+  itk::ImageRegionConstIterator<LabelImageType> it1(filter->GetOutput(), filter->GetOutput()->GetBufferedRegion());
+  itk::ImageRegionConstIterator<LabelImageType> it2(caster->GetOutput(), caster->GetOutput()->GetBufferedRegion());
+  for (; !it1.IsAtEnd(); ++it1, ++it2)
+  {
+    EXPECT_EQ(it1.Get(), it2.Get());
+  }
+}
+
+
+GTEST_TEST(LabelResampleImageFilter, MajorityVoteTakesLabelOfLargestWeight)
+{
+  /** With a shift of 0.3 voxel in x, the neighbour at the lower x has the
+   * largest weight, also at the border, where the neighbours are clamped.
+   */
+  const auto inputImage = CreateLabelImage();
+  const auto transform = itk::TranslationTransform<double, 3>::New();
+  itk::TranslationTransform<double, 3>::OutputVectorType translation;
+  translation.Fill(0.0);
+  translation[0] = 0.3;
+  transform->SetOffset(translation);
+
+  const auto filter = FilterType::New();
+  filter->SetInput(inputImage);
+  filter->SetTransform(transform);
+  filter->SetSize(inputImage->GetLargestPossibleRegion().GetSize());
+  filter->UseMajorityVoteOn();
+  filter->Update();
+
+  const auto output = filter->GetOutput();
+  for (itk::ImageRegionConstIteratorWithIndex<LabelImageType> it(output, output->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+  {
+    const auto index = it.GetIndex();
+    EXPECT_EQ(static_cast<float>(it.Get()), inputImage->GetPixel(index));
+  }
+}
@@ -0,0 +1,117 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkMemoryMappedImageFileReader.h"
+
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIterator.h>
+
+#include <itksys/SystemTools.hxx>
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 3>;
+  using ReaderType = itk::MemoryMappedImageFileReader<ImageType>;
+
+  ImageType::Pointer CreateImage()
+  {
+    ImageType::SizeType size = { { 7, 5, 3 } };
+    ImageType::SpacingType spacing;
+    spacing[0] = 0.5;
+    spacing[1] = 1.25;
+    spacing[2] = 2.0;
+    ImageType::PointType origin;
+    origin[0] = -10.0;
+    origin[1] = 4.0;
+    origin[2] = 1.5;
+
+    const auto image = ImageType::New();
+    image->SetRegions(size);
+    image->SetSpacing(spacing);
+    image->SetOrigin(origin);
+    image->Allocate();
+    float value = 0.0f;
+    for (itk::ImageRegionIterator<ImageType> it(image, image->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+      it.Set(value);
+      value += 0.25f;
+    }
+    return image;
+  }
+
+  void WriteImage(const ImageType * image, const std::string & fileName, const bool compress)
+  {
+    const auto writer = itk::ImageFileWriter<ImageType>::New();
+    writer->SetInput(image);
+    writer->SetFileName(fileName);
+    writer->SetUseCompression(compress);
+    writer->Update();
+  }
+}
+
+
+GTEST_TEST(MemoryMappedImageFileReader, MapsUncompressedRawFile)
+{
+  const auto image = CreateImage();
+  const std::string fileName = "MemoryMappedImageFileReaderGTest.mhd";
+  WriteImage(image, fileName, false);
+
+  const auto mappedImage = ReaderType::Read(fileName);
+  ASSERT_TRUE(mappedImage.IsNotNull());
+  EXPECT_EQ(mappedImage->GetBufferedRegion(), image->GetBufferedRegion());
+  EXPECT_EQ(mappedImage->GetSpacing(), image->GetSpacing());
+  EXPECT_EQ(mappedImage->GetOrigin(), image->GetOrigin());
+  EXPECT_EQ(mappedImage->GetDirection(), image->GetDirection());
+
+  itk::ImageRegionConstIterator<ImageType> it(image, image->GetBufferedRegion());
+  itk::ImageRegionConstIterator<ImageType> mappedIt(mappedImage, mappedImage->GetBufferedRegion());
+  for (; !it.IsAtEnd(); ++it, ++mappedIt)
+  {
+    EXPECT_EQ(mappedIt.Get(), it.Get());
+  }
+
+  /** Writing to the mapped buffer does not change the file. */
+  mappedImage->GetBufferPointer()[0] = 42.0f;
+  const auto mappedAgain = ReaderType::Read(fileName);
+  ASSERT_TRUE(mappedAgain.IsNotNull());
+  EXPECT_EQ(mappedAgain->GetBufferPointer()[0], 0.0f);
+
+  itksys::SystemTools::RemoveFile(fileName);
+  itksys::SystemTools::RemoveFile("MemoryMappedImageFileReaderGTest.raw");
+}
+
+
+GTEST_TEST(MemoryMappedImageFileReader, DoesNotMapCompressedOrOtherPixelType)
+{
+  const auto image = CreateImage();
+  const std::string fileName = "MemoryMappedImageFileReaderGTest.mha";
+  WriteImage(image, fileName, true);
+  EXPECT_TRUE(ReaderType::Read(fileName).IsNull());
+
+  WriteImage(image, fileName, false);
+  EXPECT_TRUE(itk::MemoryMappedImageFileReader<itk::Image<short, 3>>::Read(fileName).IsNull());
+  EXPECT_TRUE(itk::MemoryMappedImageFileReader<itk::Image<float, 2>>::Read(fileName).IsNull());
+
+  itksys::SystemTools::RemoveFile(fileName);
+}
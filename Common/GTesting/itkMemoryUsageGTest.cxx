@@ -0,0 +1,72 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkMemoryUsage.h"
+
+#include <gtest/gtest.h>
+
+
+GTEST_TEST(MemoryUsage, ParsesSizesWithUnits)
+{
+  std::uint64_t bytes = 0;
+
+  EXPECT_TRUE(itk::MemoryUsage::ParseSize("1000", bytes));
+  EXPECT_EQ(bytes, 1000u);
+  EXPECT_TRUE(itk::MemoryUsage::ParseSize("512B", bytes));
+  EXPECT_EQ(bytes, 512u);
+  EXPECT_TRUE(itk::MemoryUsage::ParseSize("8GB", bytes));
+  EXPECT_EQ(bytes, 8ull << 30);
+  EXPECT_TRUE(itk::MemoryUsage::ParseSize("1.5 gb", bytes));
+  EXPECT_EQ(bytes, 3ull << 29);
+  EXPECT_TRUE(itk::MemoryUsage::ParseSize("256M", bytes));
+  EXPECT_EQ(bytes, 256ull << 20);
+  EXPECT_TRUE(itk::MemoryUsage::ParseSize("2 TB", bytes));
+  EXPECT_EQ(bytes, 2ull << 40);
+}
+
+
+GTEST_TEST(MemoryUsage, RejectsInvalidSizes)
+{
+  std::uint64_t bytes = 42;
+
+  EXPECT_FALSE(itk::MemoryUsage::ParseSize("", bytes));
+  EXPECT_FALSE(itk::MemoryUsage::ParseSize("GB", bytes));
+  EXPECT_FALSE(itk::MemoryUsage::ParseSize("-1GB", bytes));
+  EXPECT_FALSE(itk::MemoryUsage::ParseSize("8XB", bytes));
+  EXPECT_EQ(bytes, 42u);
+}
+
+
+GTEST_TEST(MemoryUsage, FormatsSizes)
+{
+  EXPECT_EQ(itk::MemoryUsage::FormatSize(0), "0 B");
+  EXPECT_EQ(itk::MemoryUsage::FormatSize(1023), "1023 B");
+  EXPECT_EQ(itk::MemoryUsage::FormatSize(3ull << 29), "1.50 GB");
+}
+
+
+GTEST_TEST(MemoryUsage, ReportsPeakResidentMemory)
+{
+  // Running this test takes memory, so the peak cannot be zero on the
+  // platforms that report it.
+#if defined(_WIN32) || defined(__unix__) || defined(__APPLE__)
+  EXPECT_GT(itk::MemoryUsage::GetPeakResidentMemory(), 0u);
+#endif
+}
@@ -0,0 +1,121 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkMultiInputResampleImageFilter.h"
+
+#include <itkAffineTransform.h>
+#include <itkImage.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkLinearInterpolateImageFunction.h>
+#include <itkNearestNeighborInterpolateImageFunction.h>
+#include <itkResampleImageFilter.h>
+
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 3>;
+  using FilterType = itk::MultiInputResampleImageFilter<ImageType, double>;
+  using ResampleFilterType = itk::ResampleImageFilter<ImageType, ImageType, double>;
+  using TransformType = itk::AffineTransform<double, 3>;
+  using LinearInterpolatorType = itk::LinearInterpolateImageFunction<ImageType, double>;
+  using NearestInterpolatorType = itk::NearestNeighborInterpolateImageFunction<ImageType, double>;
+
+  ImageType::Pointer CreateImage(const ImageType::SizeType & size, const double spacing, const double origin)
+  {
+    const auto image = ImageType::New();
+    image->SetRegions(size);
+    image->SetSpacing(spacing);
+    image->SetOrigin(origin);
+    image->Allocate();
+    for (itk::ImageRegionIteratorWithIndex<ImageType> it(image, image->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+      const auto index = it.GetIndex();
+      it.Set(static_cast<float>((index[0] * 7 + index[1] * 3 + index[2] * 11) % 17));
+    }
+    return image;
+  }
+
+  TransformType::Pointer CreateTransform()
+  {
+    const auto transform = TransformType::New();
+    TransformType::OutputVectorType translation;
+    translation[0] = 1.3;
+    translation[1] = -0.7;
+    translation[2] = 2.1;
+    transform->Translate(translation);
+    transform->Rotate(0, 1, 0.2);
+    return transform;
+  }
+
+  ImageType::Pointer Resample(const ImageType * image,
+    FilterType::InterpolatorType * interpolator,
+    const TransformType * transform,
+    const ImageType::SizeType & size)
+  {
+    const auto resampler = ResampleFilterType::New();
+    resampler->SetInput(image);
+    resampler->SetInterpolator(interpolator);
+    resampler->SetTransform(transform);
+    resampler->SetSize(size);
+    resampler->SetDefaultPixelValue(-1.0f);
+    resampler->Update();
+    return resampler->GetOutput();
+  }
+
+  void ExpectNear(const ImageType * image1, const ImageType * image2)
+  {
+    ASSERT_EQ(image1->GetBufferedRegion(), image2->GetBufferedRegion());
+    itk::ImageRegionConstIterator<ImageType> it1(image1, image1->GetBufferedRegion());
+    itk::ImageRegionConstIterator<ImageType> it2(image2, image2->GetBufferedRegion());
+    for (; !it1.IsAtEnd(); ++it1, ++it2)
+    {
+      EXPECT_NEAR(it1.Get(), it2.Get(), 1e-4);
+    }
+  }
+}
+
+
+GTEST_TEST(MultiInputResampleImageFilter, OutputsEqualThoseOfResampleImageFilter)
+{
+  const ImageType::SizeType intensitySize = { { 21, 18, 15 } };
+  const ImageType::SizeType labelSize = { { 12, 10, 9 } };
+  const ImageType::SizeType outputSize = { { 19, 16, 14 } };
+
+  /** The inputs have different geometries. */
+  const auto intensityImage = CreateImage(intensitySize, 1.0, 0.0);
+  const auto labelImage = CreateImage(labelSize, 1.7, -2.5);
+  const auto transform = CreateTransform();
+
+  const auto filter = FilterType::New();
+  filter->SetTransform(transform);
+  filter->SetSize(outputSize);
+  EXPECT_EQ(filter->AddInputImage(intensityImage, LinearInterpolatorType::New(), -1.0f), 0u);
+  EXPECT_EQ(filter->AddInputImage(labelImage, NearestInterpolatorType::New(), -1.0f), 1u);
+  filter->SetNumberOfWorkUnits(3);
+  filter->Update();
+
+  ExpectNear(filter->GetOutput(0),
+    Resample(intensityImage, LinearInterpolatorType::New(), transform, outputSize));
+  ExpectNear(filter->GetOutput(1),
+    Resample(labelImage, NearestInterpolatorType::New(), transform, outputSize));
+}
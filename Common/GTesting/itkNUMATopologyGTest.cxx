@@ -0,0 +1,65 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkNUMATopology.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+GTEST_TEST(NUMATopology, ParsesCPULists)
+{
+  std::vector<unsigned int> cpus;
+
+  EXPECT_TRUE(itk::NUMATopology::ParseCPUList("0-3,8,10-11\n", cpus));
+  EXPECT_EQ(cpus, std::vector<unsigned int>({ 0, 1, 2, 3, 8, 10, 11 }));
+  EXPECT_TRUE(itk::NUMATopology::ParseCPUList("5", cpus));
+  EXPECT_EQ(cpus, std::vector<unsigned int>({ 5 }));
+  EXPECT_TRUE(itk::NUMATopology::ParseCPUList("", cpus));
+  EXPECT_TRUE(cpus.empty());
+}
+
+
+GTEST_TEST(NUMATopology, RejectsInvalidCPULists)
+{
+  std::vector<unsigned int> cpus{ 7 };
+
+  EXPECT_FALSE(itk::NUMATopology::ParseCPUList("3-1", cpus));
+  EXPECT_FALSE(itk::NUMATopology::ParseCPUList("0-", cpus));
+  EXPECT_FALSE(itk::NUMATopology::ParseCPUList("a,b", cpus));
+  EXPECT_EQ(cpus, std::vector<unsigned int>({ 7 }));
+}
+
+
+GTEST_TEST(NUMATopology, DescribesTheMachine)
+{
+  const unsigned int numberOfNodes = itk::NUMATopology::GetNumberOfNodes();
+  EXPECT_GE(numberOfNodes, 1u);
+  EXPECT_TRUE(itk::NUMATopology::GetCPUsOfNode(numberOfNodes).empty());
+
+  // Placing memory never fails hard, also on a single node.
+  std::vector<char> buffer(1 << 20);
+  const bool interleaved = itk::NUMATopology::InterleaveMemory(buffer.data(), buffer.size());
+  if (numberOfNodes == 1)
+  {
+    EXPECT_FALSE(interleaved);
+  }
+}
@@ -0,0 +1,84 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkParallelRadixSort.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+
+namespace
+{
+  using itk::ParallelRadixSort;
+  using itk::SizeValueType;
+
+  const std::vector<SizeValueType> sizes = { 0, 1, 1001, 3 * ParallelRadixSort::MinimumChunkSize + 7 };
+
+  std::vector<SizeValueType> GetExpectedOrder(const std::vector<std::uint64_t>& keys)
+  {
+    std::vector<SizeValueType> order(keys.size());
+    std::iota(order.begin(), order.end(), SizeValueType{ 0 });
+    std::stable_sort(order.begin(), order.end(),
+      [&keys](const SizeValueType i, const SizeValueType j) { return keys[i] < keys[j]; });
+    return order;
+  }
+}
+
+
+GTEST_TEST(ParallelRadixSort, EqualsStableSort)
+{
+  std::mt19937_64 generator(42);
+
+  for (const auto size : sizes)
+  {
+    for (const unsigned int numberOfKeyBits : { 5u, 24u, 64u })
+    {
+      std::vector<std::uint64_t> keys(size);
+      for (auto& key : keys)
+      {
+        key = numberOfKeyBits == 64 ? generator() : generator() % (std::uint64_t{ 1 } << numberOfKeyBits);
+      }
+
+      std::vector<SizeValueType> order(size);
+      ParallelRadixSort::SortIndices(keys.data(), size, numberOfKeyBits, order.data());
+      EXPECT_EQ(order, GetExpectedOrder(keys));
+    }
+  }
+}
+
+
+GTEST_TEST(ParallelRadixSort, KeepsTheOrderOfEqualKeys)
+{
+  const SizeValueType size = 2 * ParallelRadixSort::MinimumChunkSize + 1;
+  const std::vector<std::uint64_t> keys(size, 0x1234);
+
+  std::vector<SizeValueType> order(size);
+  ParallelRadixSort::SortIndices(keys.data(), size, 16, order.data());
+
+  for (SizeValueType i = 0; i < size; ++i)
+  {
+    EXPECT_EQ(order[i], i);
+  }
+}
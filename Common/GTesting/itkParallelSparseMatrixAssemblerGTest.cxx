@@ -0,0 +1,191 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+// First include the header file to be tested:
+#include "itkParallelSparseMatrixAssembler.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+
+namespace
+{
+  using itk::ParallelSparseMatrixAssembler;
+  using itk::SizeValueType;
+  using itk::ThreadIdType;
+
+  using SparseMatrixType = ParallelSparseMatrixAssembler::SparseMatrixType;
+  using EntryMapType = std::map<std::pair<unsigned int, unsigned int>, double>;
+
+  EntryMapType GetEntries(const SparseMatrixType& matrix)
+  {
+    EntryMapType entries;
+    for (unsigned int r = 0; r < matrix.rows(); ++r)
+    {
+      for (const auto& element : matrix.get_row(r))
+      {
+        entries[std::make_pair(r, element.first)] = element.second;
+      }
+    }
+    return entries;
+  }
+
+  bool RowsAreSorted(const SparseMatrixType& matrix)
+  {
+    for (unsigned int r = 0; r < matrix.rows(); ++r)
+    {
+      const auto& rowVector = matrix.get_row(r);
+      for (SizeValueType i = 1; i < rowVector.size(); ++i)
+      {
+        if (rowVector[i - 1].first >= rowVector[i].first)
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+
+GTEST_TEST(ParallelSparseMatrixAssembler, AssemblesTheSumOfTheEntries)
+{
+  const unsigned int rows = 300;
+  const unsigned int columns = 200;
+  const ThreadIdType numberOfWorkUnits = 4;
+  std::mt19937 generator(42);
+
+  ParallelSparseMatrixAssembler assembler;
+  assembler.Initialize(rows, columns, numberOfWorkUnits);
+  EXPECT_EQ(assembler.GetNumberOfWorkUnits(), numberOfWorkUnits);
+
+  /** Integer values, so that the sums are exact in any order. */
+  EntryMapType expected;
+  for (unsigned int i = 0; i < 20000; ++i)
+  {
+    const unsigned int row = generator() % rows;
+    const unsigned int column = generator() % columns;
+    const double value = static_cast<double>(generator() % 7) - 3.0;
+    assembler.AddEntry(i % numberOfWorkUnits, row, column, value);
+    expected[std::make_pair(row, column)] += value;
+  }
+
+  SparseMatrixType matrix;
+  assembler.AssembleRows(matrix);
+
+  EXPECT_EQ(matrix.rows(), rows);
+  EXPECT_EQ(matrix.cols(), columns);
+  EXPECT_TRUE(RowsAreSorted(matrix));
+  EXPECT_EQ(GetEntries(matrix), expected);
+  EXPECT_EQ(assembler.GetNumberOfStoredEntries(), 0);
+}
+
+
+GTEST_TEST(ParallelSparseMatrixAssembler, CompactsDuplicateEntries)
+{
+  const unsigned int size = 10;
+  const SizeValueType numberOfTriplets = 5 * ParallelSparseMatrixAssembler::MinimumBufferSize / 2;
+
+  ParallelSparseMatrixAssembler assembler;
+  assembler.Initialize(size, size, 1);
+  for (SizeValueType i = 0; i < numberOfTriplets; ++i)
+  {
+    assembler.AddEntry(0, i % size, (i / size) % size, 1.0);
+  }
+
+  /** Only the triplets since the last compaction are stored separately. */
+  EXPECT_LE(assembler.GetNumberOfStoredEntries(), size * size + ParallelSparseMatrixAssembler::MinimumBufferSize);
+
+  SparseMatrixType matrix;
+  assembler.AssembleRows(matrix);
+
+  double sum = 0.0;
+  for (const auto& entry : GetEntries(matrix))
+  {
+    sum += entry.second;
+  }
+  EXPECT_EQ(GetEntries(matrix).size(), size * size);
+  EXPECT_EQ(sum, static_cast<double>(numberOfTriplets));
+}
+
+
+GTEST_TEST(ParallelSparseMatrixAssembler, AddsTheUpperTriangularOuterProduct)
+{
+  const std::vector<unsigned long> indices = { 1, 4, 5, 9 };
+  const std::vector<double> values = { 1.0, -2.0, 0.0, 3.0 };
+
+  ParallelSparseMatrixAssembler assembler;
+  assembler.Initialize(10, 10, 2);
+  assembler.AddUpperTriangularOuterProduct(0, indices, values, indices.size(), 2.0, 1e-14);
+  assembler.AddUpperTriangularOuterProduct(1, indices, values, indices.size(), 1.0, 1e-14);
+
+  SparseMatrixType matrix;
+  assembler.AssembleRows(matrix);
+
+  /** The products with the zero value are skipped. */
+  EntryMapType expected;
+  for (SizeValueType i = 0; i < indices.size(); ++i)
+  {
+    for (SizeValueType j = i; j < indices.size(); ++j)
+    {
+      if (values[i] * values[j] != 0.0)
+      {
+        expected[std::make_pair(indices[i], indices[j])] = 3.0 * values[i] * values[j];
+      }
+    }
+  }
+  EXPECT_EQ(GetEntries(matrix), expected);
+}
+
+
+GTEST_TEST(ParallelSparseMatrixAssembler, CopiesRowsToCompressedArrays)
+{
+  const unsigned int rows = 2000;
+  std::mt19937 generator(1);
+
+  SparseMatrixType matrix(rows, rows);
+  SizeValueType numberOfEntries = 0;
+  for (unsigned int r = 0; r < rows; ++r)
+  {
+    for (unsigned int c = r; c < rows; c += 1 + generator() % 20)
+    {
+      matrix(r, c) = r + 0.5 * c;
+      ++numberOfEntries;
+    }
+  }
+
+  std::vector<int> pointers(rows + 1);
+  std::vector<int> indices(numberOfEntries);
+  std::vector<double> values(numberOfEntries);
+  ParallelSparseMatrixAssembler::CopyRowsToCompressedArrays(matrix, pointers.data(), indices.data(), values.data());
+
+  ASSERT_EQ(static_cast<SizeValueType>(pointers[rows]), numberOfEntries);
+  for (unsigned int r = 0; r < rows; ++r)
+  {
+    const auto& rowVector = matrix.get_row(r);
+    ASSERT_EQ(static_cast<SizeValueType>(pointers[r + 1] - pointers[r]), rowVector.size());
+    for (SizeValueType i = 0; i < rowVector.size(); ++i)
+    {
+      EXPECT_EQ(indices[pointers[r] + i], static_cast<int>(rowVector[i].first));
+      EXPECT_EQ(values[pointers[r] + i], rowVector[i].second);
+    }
+  }
+}
@@ -0,0 +1,129 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkParallelVectorOperations.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+
+namespace
+{
+  using itk::ParallelVectorOperations;
+
+  // Sizes below and above the minimum chunk size, not a multiple of 8.
+  const std::vector<std::size_t> sizes = { 0, 1, 1001, 2 * ParallelVectorOperations::MinimumChunkSize + 3,
+    17 * ParallelVectorOperations::MinimumChunkSize + 5 };
+
+  std::vector<double> CreateVector(const std::size_t size, const double offset)
+  {
+    std::vector<double> result(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      result[i] = offset + static_cast<double>(i % 97) / 16.0;
+    }
+    return result;
+  }
+}
+
+
+GTEST_TEST(ParallelVectorOperations, ScaledAddAndAxpy)
+{
+  for (const auto size : sizes)
+  {
+    const auto x = CreateVector(size, 1.0);
+    const auto y = CreateVector(size, -2.0);
+    std::vector<double> z(size);
+
+    ParallelVectorOperations::ScaledAdd(x.data(), 0.5, y.data(), z.data(), size);
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      EXPECT_DOUBLE_EQ(z[i], x[i] + 0.5 * y[i]);
+    }
+
+    ParallelVectorOperations::Axpy(-0.5, y.data(), z.data(), size);
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      EXPECT_DOUBLE_EQ(z[i], x[i] + 0.5 * y[i] - 0.5 * y[i]);
+    }
+  }
+}
+
+
+GTEST_TEST(ParallelVectorOperations, PreconditionedAndAdaGradScaledAdd)
+{
+  for (const auto size : sizes)
+  {
+    const auto x = CreateVector(size, 1.0);
+    const auto p = CreateVector(size, 0.25);
+    const auto g = CreateVector(size, -3.0);
+    std::vector<double> d(size);
+    std::vector<double> z(size);
+
+    ParallelVectorOperations::PreconditionedScaledAdd(x.data(), -2.0, p.data(), g.data(), d.data(), z.data(), size);
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      EXPECT_DOUBLE_EQ(d[i], p[i] * g[i]);
+      EXPECT_DOUBLE_EQ(z[i], x[i] - 2.0 * d[i]);
+    }
+
+    auto s = p;
+    ParallelVectorOperations::AdaGradScaledAdd(x.data(), -2.0, g.data(), 1e-14, s.data(), d.data(), z.data(), size);
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      EXPECT_DOUBLE_EQ(s[i], p[i] + g[i] * g[i]);
+      EXPECT_DOUBLE_EQ(d[i], g[i] / std::sqrt(s[i] + 1e-14));
+      EXPECT_DOUBLE_EQ(z[i], x[i] - 2.0 * d[i]);
+    }
+  }
+}
+
+
+GTEST_TEST(ParallelVectorOperations, InnerProductAndNorm)
+{
+  for (const auto size : sizes)
+  {
+    const auto x = CreateVector(size, 1.0);
+    const auto y = CreateVector(size, -2.0);
+
+    double expectedInnerProduct = 0.0;
+    double expectedSquaredNorm = 0.0;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      expectedInnerProduct += x[i] * y[i];
+      expectedSquaredNorm += x[i] * x[i];
+    }
+
+    const double tolerance = 1e-12 * (1.0 + static_cast<double>(size));
+    EXPECT_NEAR(ParallelVectorOperations::InnerProduct(x.data(), y.data(), size), expectedInnerProduct, tolerance);
+    EXPECT_NEAR(ParallelVectorOperations::SquaredNorm(x.data(), size), expectedSquaredNorm, tolerance);
+    EXPECT_NEAR(ParallelVectorOperations::Norm(x.data(), size), std::sqrt(expectedSquaredNorm), tolerance);
+
+    // The result does not depend on the scheduling of the threads.
+    EXPECT_EQ(ParallelVectorOperations::InnerProduct(x.data(), y.data(), size),
+      ParallelVectorOperations::InnerProduct(x.data(), y.data(), size));
+  }
+}
@@ -0,0 +1,237 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkPersistentThreadPool.h"
+#include "itkNUMATopology.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+  ITK_THREAD_RETURN_TYPE IncrementWorkUnitCount(void* const arg)
+  {
+    const auto info = static_cast<itk::PersistentThreadPool::WorkUnitInfo*>(arg);
+    auto& counts = *static_cast<std::vector<std::atomic<int>>*>(info->UserData);
+    EXPECT_EQ(info->NumberOfWorkUnits, counts.size());
+    ++counts[info->WorkUnitID];
+    return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+  }
+
+  ITK_THREAD_RETURN_TYPE ThrowException(void*)
+  {
+    throw std::runtime_error("work unit failed");
+  }
+
+  ITK_THREAD_RETURN_TYPE ExecuteNestedCall(void* const arg)
+  {
+    const auto info = static_cast<itk::PersistentThreadPool::WorkUnitInfo*>(arg);
+    itk::PersistentThreadPool::GetInstance()->SingleMethodExecute(4, IncrementWorkUnitCount, info->UserData);
+    return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+  }
+
+  struct RendezvousData
+  {
+    std::atomic<unsigned>*     numberOfRunningWorkUnits;
+    unsigned                   numberOfExpectedWorkUnits;
+    std::atomic<unsigned>*     numberOfMetWorkUnits;
+    std::mutex                 mutex;
+    std::set<std::thread::id>  threadIds;
+  };
+
+  // Waits until all work units of all calls run at the same time, or a timeout.
+  ITK_THREAD_RETURN_TYPE MeetOtherWorkUnits(void* const arg)
+  {
+    const auto info = static_cast<itk::PersistentThreadPool::WorkUnitInfo*>(arg);
+    auto& data = *static_cast<RendezvousData*>(info->UserData);
+    {
+      const std::lock_guard<std::mutex> lock(data.mutex);
+      data.threadIds.insert(std::this_thread::get_id());
+    }
+
+    ++*data.numberOfRunningWorkUnits;
+    const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (*data.numberOfRunningWorkUnits < data.numberOfExpectedWorkUnits
+           && std::chrono::steady_clock::now() < timeout)
+    {
+      std::this_thread::yield();
+    }
+    if (*data.numberOfRunningWorkUnits >= data.numberOfExpectedWorkUnits)
+    {
+      ++*data.numberOfMetWorkUnits;
+    }
+    return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+  }
+}
+
+
+GTEST_TEST(PersistentThreadPool, ExecutesEachWorkUnitOnce)
+{
+  const auto pool = itk::PersistentThreadPool::GetInstance();
+  ASSERT_NE(pool, nullptr);
+  EXPECT_EQ(pool, itk::PersistentThreadPool::GetInstance());
+
+  // Call it repeatedly, using more work units than threads.
+  for (unsigned iteration = 0; iteration < 100; ++iteration)
+  {
+    std::vector<std::atomic<int>> counts(64);
+    pool->SingleMethodExecute(64, IncrementWorkUnitCount, &counts);
+
+    for (const auto& count : counts)
+    {
+      EXPECT_EQ(count, 1);
+    }
+  }
+}
+
+
+GTEST_TEST(PersistentThreadPool, RethrowsException)
+{
+  const auto pool = itk::PersistentThreadPool::GetInstance();
+  EXPECT_THROW(pool->SingleMethodExecute(8, ThrowException, nullptr), std::runtime_error);
+
+  // The pool is still usable afterwards.
+  std::vector<std::atomic<int>> counts(8);
+  pool->SingleMethodExecute(8, IncrementWorkUnitCount, &counts);
+
+  for (const auto& count : counts)
+  {
+    EXPECT_EQ(count, 1);
+  }
+}
+
+
+GTEST_TEST(PersistentThreadPool, ExecutesNestedCallSerially)
+{
+  std::vector<std::atomic<int>> counts(4);
+  itk::PersistentThreadPool::GetInstance()->SingleMethodExecute(2, ExecuteNestedCall, &counts);
+
+  for (const auto& count : counts)
+  {
+    EXPECT_EQ(count, 2);
+  }
+}
+
+
+GTEST_TEST(PersistentThreadPool, ExecutesConcurrentCallsFromOtherThreads)
+{
+  const auto pool = itk::PersistentThreadPool::GetInstance();
+
+  // Calls from several threads at once, as of concurrent registrations.
+  std::vector<std::vector<std::atomic<int>>> counts(4);
+  std::vector<std::thread>                   threads;
+  for (auto& threadCounts : counts)
+  {
+    threadCounts = std::vector<std::atomic<int>>(16);
+    threads.emplace_back([pool, &threadCounts]
+    {
+      for (unsigned iteration = 0; iteration < 50; ++iteration)
+      {
+        pool->SingleMethodExecute(16, IncrementWorkUnitCount, &threadCounts);
+      }
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  for (const auto& threadCounts : counts)
+  {
+    for (const auto& count : threadCounts)
+    {
+      EXPECT_EQ(count, 50);
+    }
+  }
+}
+
+
+GTEST_TEST(PersistentThreadPool, SharesThreadsBetweenConcurrentCalls)
+{
+  const auto pool = itk::PersistentThreadPool::GetInstance();
+  const auto maximumNumberOfThreads = pool->GetMaximumNumberOfThreads();
+  pool->SetMaximumNumberOfThreads(4);
+
+  // Two concurrent calls of two work units each, as of two concurrent
+  // registrations that each got half of the threads. All four work units
+  // only run at the same time if both calls are executed on two threads.
+  std::atomic<unsigned> numberOfRunningWorkUnits(0);
+  std::atomic<unsigned> numberOfMetWorkUnits(0);
+  RendezvousData data[2];
+  std::vector<std::thread> threads;
+  for (auto& callData : data)
+  {
+    callData.numberOfRunningWorkUnits = &numberOfRunningWorkUnits;
+    callData.numberOfExpectedWorkUnits = 4;
+    callData.numberOfMetWorkUnits = &numberOfMetWorkUnits;
+    threads.emplace_back([pool, &callData]
+    {
+      pool->SingleMethodExecute(2, MeetOtherWorkUnits, &callData);
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  EXPECT_EQ(numberOfMetWorkUnits, 4);
+  for (const auto& callData : data)
+  {
+    EXPECT_EQ(callData.threadIds.size(), 2);
+  }
+
+  pool->SetMaximumNumberOfThreads(maximumNumberOfThreads);
+}
+
+
+GTEST_TEST(PersistentThreadPool, ExecutesEachWorkUnitOnceWithNUMAPlacement)
+{
+  const auto pool = itk::PersistentThreadPool::GetInstance();
+  const bool placement = pool->GetNUMAPlacement();
+  pool->SetNUMAPlacement(true);
+  EXPECT_TRUE(pool->GetNUMAPlacement());
+
+  // Both with work units assigned to the threads, and with more work units than threads.
+  const unsigned numberOfWorkUnits[] = { 2, pool->GetMaximumNumberOfThreads(), 4 * pool->GetMaximumNumberOfThreads() };
+  for (const unsigned n : numberOfWorkUnits)
+  {
+    for (unsigned iteration = 0; iteration < 20; ++iteration)
+    {
+      std::vector<std::atomic<int>> counts(n);
+      pool->SingleMethodExecute(n, IncrementWorkUnitCount, &counts);
+
+      for (const auto& count : counts)
+      {
+        EXPECT_EQ(count, 1);
+      }
+    }
+    EXPECT_LT(pool->GetNUMANodeOfWorkUnit(n - 1, n), itk::NUMATopology::GetNumberOfNodes());
+  }
+
+  pool->SetNUMAPlacement(placement);
+}
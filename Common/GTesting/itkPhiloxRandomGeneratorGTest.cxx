@@ -0,0 +1,111 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkPhiloxRandomGenerator.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+namespace
+{
+  using itk::PhiloxRandomGenerator;
+  using WordType = PhiloxRandomGenerator::WordType;
+
+  void ExpectOutput(const WordType (&counter)[4], const WordType (&key)[2], const WordType (&expected)[4])
+  {
+    WordType output[4];
+    PhiloxRandomGenerator::Generate(counter, key, output);
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+      EXPECT_EQ(output[i], expected[i]);
+    }
+  }
+}
+
+
+// The known answers of the Random123 library for Philox4x32-10.
+GTEST_TEST(PhiloxRandomGenerator, KnownAnswers)
+{
+  ExpectOutput({ 0, 0, 0, 0 }, { 0, 0 }, { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 });
+  ExpectOutput({ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }, { 0xffffffff, 0xffffffff },
+    { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd });
+  ExpectOutput({ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, { 0xa4093822, 0x299f31d0 },
+    { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 });
+}
+
+
+GTEST_TEST(PhiloxRandomGenerator, FillEqualsSingleVariates)
+{
+  const PhiloxRandomGenerator::KeyType key = 0x0123456789abcdefULL;
+  const std::uint64_t stream = 7;
+
+  // Start at an odd index and end at an even one, to test both remainders.
+  const std::uint64_t firstIndex = 3;
+  std::vector<double> uniforms(10);
+  std::vector<double> normals(10);
+  PhiloxRandomGenerator::FillUniformVariates(key, stream, firstIndex, uniforms.size(), uniforms.data());
+  PhiloxRandomGenerator::FillNormalVariates(key, stream, firstIndex, normals.size(), normals.data());
+
+  for (std::size_t i = 0; i < uniforms.size(); ++i)
+  {
+    EXPECT_EQ(uniforms[i], PhiloxRandomGenerator::GetUniformVariate(key, stream, firstIndex + i));
+    EXPECT_EQ(normals[i], PhiloxRandomGenerator::GetNormalVariate(key, stream, firstIndex + i));
+  }
+}
+
+
+GTEST_TEST(PhiloxRandomGenerator, StreamsDiffer)
+{
+  const PhiloxRandomGenerator::KeyType key = 42;
+  EXPECT_NE(PhiloxRandomGenerator::GetUniformVariate(key, 0, 0), PhiloxRandomGenerator::GetUniformVariate(key, 1, 0));
+  EXPECT_NE(PhiloxRandomGenerator::GetUniformVariate(key, 0, 0), PhiloxRandomGenerator::GetUniformVariate(key + 1, 0, 0));
+}
+
+
+GTEST_TEST(PhiloxRandomGenerator, MomentsOfTheVariates)
+{
+  const unsigned int n = 100000;
+  std::vector<double> uniforms(n);
+  std::vector<double> normals(n);
+  PhiloxRandomGenerator::FillUniformVariates(12345, 0, 0, n, uniforms.data());
+  PhiloxRandomGenerator::FillNormalVariates(12345, 1, 0, n, normals.data());
+
+  double uniformSum = 0.0;
+  double normalSum = 0.0;
+  double normalSquaredSum = 0.0;
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    ASSERT_GE(uniforms[i], 0.0);
+    ASSERT_LT(uniforms[i], 1.0);
+    ASSERT_TRUE(std::isfinite(normals[i]));
+    uniformSum += uniforms[i];
+    normalSum += normals[i];
+    normalSquaredSum += normals[i] * normals[i];
+  }
+
+  // The tolerances are about five standard errors.
+  EXPECT_NEAR(uniformSum / n, 0.5, 0.005);
+  EXPECT_NEAR(normalSum / n, 0.0, 0.02);
+  EXPECT_NEAR(normalSquaredSum / n, 1.0, 0.03);
+}
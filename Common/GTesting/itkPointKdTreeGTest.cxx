@@ -0,0 +1,120 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// First include the header file to be tested:
+#include "itkPointKdTree.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+
+namespace
+{
+  using KdTreeType = itk::PointKdTree<double, 3>;
+  using PointType = KdTreeType::PointType;
+
+  double GetSquaredDistance(const PointType& p, const PointType& q)
+  {
+    double squaredDistance = 0.0;
+    for (unsigned int d = 0; d < 3; ++d)
+    {
+      squaredDistance += (p[d] - q[d]) * (p[d] - q[d]);
+    }
+    return squaredDistance;
+  }
+
+  PointType CreateRandomPoint(std::mt19937& generator, const double range)
+  {
+    std::uniform_real_distribution<double> distribution(-range, range);
+    PointType point;
+    for (unsigned int d = 0; d < 3; ++d)
+    {
+      point[d] = distribution(generator);
+    }
+    return point;
+  }
+}
+
+
+GTEST_TEST(PointKdTree, FindsTheClosestPoint)
+{
+  std::mt19937 generator(42);
+
+  for (const unsigned int numberOfPoints : { 1u, 2u, 3u, 17u, 1000u })
+  {
+    std::vector<PointType> points(numberOfPoints);
+    for (auto& point : points)
+    {
+      point = CreateRandomPoint(generator, 10.0);
+    }
+
+    KdTreeType tree;
+    tree.Build(points);
+    EXPECT_EQ(tree.GetNumberOfPoints(), numberOfPoints);
+
+    // The queries are partly outside the bounding box of the points.
+    for (unsigned int i = 0; i < 200; ++i)
+    {
+      const PointType query = CreateRandomPoint(generator, 15.0);
+
+      double expectedSquaredDistance = std::numeric_limits<double>::max();
+      for (const auto& point : points)
+      {
+        expectedSquaredDistance = std::min(expectedSquaredDistance, GetSquaredDistance(point, query));
+      }
+
+      double squaredDistance = 0.0;
+      const auto closest = tree.FindClosestPoint(query, squaredDistance);
+      ASSERT_LT(closest, numberOfPoints);
+      EXPECT_EQ(squaredDistance, expectedSquaredDistance);
+      EXPECT_EQ(GetSquaredDistance(points[closest], query), expectedSquaredDistance);
+    }
+  }
+}
+
+
+GTEST_TEST(PointKdTree, FindsAPointOfTheQuery)
+{
+  std::mt19937 generator(42);
+
+  // Include duplicate points.
+  std::vector<PointType> points(500);
+  for (auto& point : points)
+  {
+    point = CreateRandomPoint(generator, 10.0);
+  }
+  for (unsigned int i = 0; i < 50; ++i)
+  {
+    points[100 + i] = points[i];
+  }
+
+  KdTreeType tree;
+  tree.Build(points);
+
+  for (const auto& point : points)
+  {
+    double squaredDistance = -1.0;
+    const auto closest = tree.FindClosestPoint(point, squaredDistance);
+    EXPECT_EQ(squaredDistance, 0.0);
+    EXPECT_EQ(points[closest], point);
+  }
+}
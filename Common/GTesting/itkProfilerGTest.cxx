@@ -0,0 +1,75 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkProfiler.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+GTEST_TEST(Profiler, ScopedTimerDoesNotMeasureWhenDisabled)
+{
+  itk::Profiler::SetEnabled(false);
+  itk::Profiler::Reset();
+  {
+    const itk::Profiler::ScopedTimer timer(itk::Profiler::Interpolator);
+  }
+  EXPECT_EQ(itk::Profiler::GetCount(itk::Profiler::Interpolator), 0u);
+  EXPECT_EQ(itk::Profiler::GetSeconds(itk::Profiler::Interpolator), 0.0);
+}
+
+
+GTEST_TEST(Profiler, SumsCountsOverThreads)
+{
+  itk::Profiler::SetEnabled(true);
+  itk::Profiler::Reset();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i)
+  {
+    threads.emplace_back([]
+    {
+      for (int j = 0; j < 100; ++j)
+      {
+        const itk::Profiler::ScopedTimer timer(itk::Profiler::Transform, 2);
+      }
+    });
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  itk::Profiler::Add(itk::Profiler::MetricReduction, 1500000000);
+
+  EXPECT_EQ(itk::Profiler::GetCount(itk::Profiler::Transform), 800u);
+  EXPECT_EQ(itk::Profiler::GetCount(itk::Profiler::MetricReduction), 1u);
+  EXPECT_DOUBLE_EQ(itk::Profiler::GetSeconds(itk::Profiler::MetricReduction), 1.5);
+
+  std::ostringstream json;
+  itk::Profiler::WriteJSONMembers(json, "");
+  EXPECT_NE(json.str().find("\"MetricReduction\": { \"seconds\": 1.5, \"count\": 1 }"), std::string::npos);
+
+  itk::Profiler::Reset();
+  EXPECT_EQ(itk::Profiler::GetCount(itk::Profiler::Transform), 0u);
+  itk::Profiler::SetEnabled(false);
+}
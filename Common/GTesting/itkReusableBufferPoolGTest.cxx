@@ -0,0 +1,91 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+
+ // First include the header file to be tested:
+#include "itkReusableBufferPool.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <sstream>
+
+
+GTEST_TEST(ReusableBufferPool, BufferOnlyGrows)
+{
+  itk::ReusableBufferPool::ReleaseCachedBuffers();
+  itk::ReusableBufferPool::ResetStatistics();
+  {
+    itk::ReusableBuffer<double> buffer;
+    buffer.SetSize(100);
+    const double * const data = buffer.GetBufferPointer();
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(data) % itk::ReusableBufferPool::Alignment, 0u);
+    EXPECT_GE(buffer.GetCapacity(), 100u);
+
+    buffer.SetSize(50);
+    buffer.SetSize(100);
+    EXPECT_EQ(buffer.GetBufferPointer(), data);
+    EXPECT_EQ(buffer.GetSize(), 100u);
+
+    buffer.SetSize(1000);
+    EXPECT_GE(buffer.GetCapacity(), 1000u);
+  }
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfAllocations(), 2u);
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfReuses(), 2u);
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfRequests(), 4u);
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfBytesInUse(), 0u);
+  itk::ReusableBufferPool::ReleaseCachedBuffers();
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfCachedBytes(), 0u);
+}
+
+
+GTEST_TEST(ReusableBufferPool, ReusesReleasedBlocksThatFit)
+{
+  itk::ReusableBufferPool::ReleaseCachedBuffers();
+  itk::ReusableBufferPool::ResetStatistics();
+
+  const void * released = nullptr;
+  {
+    itk::ReusableBuffer<float> buffer;
+    buffer.SetSize(4096);
+    released = buffer.GetBufferPointer();
+  }
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfCachedBytes(), 4096u * sizeof(float));
+
+  /** A block that is much larger than requested is not handed out. */
+  itk::ReusableBuffer<float> small;
+  small.SetSize(16);
+  EXPECT_NE(static_cast<const void *>(small.GetBufferPointer()), released);
+
+  itk::ReusableBuffer<float> fitting;
+  fitting.SetSize(3000);
+  EXPECT_EQ(static_cast<const void *>(fitting.GetBufferPointer()), released);
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfCacheHits(), 1u);
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfAllocations(), 2u);
+  EXPECT_EQ(itk::ReusableBufferPool::GetNumberOfCachedBytes(), 0u);
+
+  std::ostringstream json;
+  itk::ReusableBufferPool::WriteJSONMembers(json, "");
+  EXPECT_NE(json.str().find("\"cacheHits\": 1,"), std::string::npos);
+
+  fitting.Release();
+  EXPECT_EQ(fitting.GetSize(), 0u);
+  EXPECT_EQ(fitting.GetBufferPointer(), nullptr);
+  itk::ReusableBufferPool::ReleaseCachedBuffers();
+}
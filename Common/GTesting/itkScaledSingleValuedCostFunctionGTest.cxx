@@ -0,0 +1,242 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// First include the header file to be tested:
+#include "itkScaledSingleValuedCostFunction.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+namespace
+{
+  // A quadratic cost function with a weight per parameter.
+  class QuadraticCostFunction : public itk::SingleValuedCostFunction
+  {
+  public:
+    using Self = QuadraticCostFunction;
+    using Pointer = itk::SmartPointer<Self>;
+
+    itkNewMacro(Self);
+
+    MeasureType GetValue(const ParametersType& parameters) const override
+    {
+      MeasureType value = 0.0;
+      for (unsigned int i = 0; i < parameters.GetSize(); ++i)
+      {
+        value += (i + 1.0) * parameters[i] * parameters[i];
+      }
+      return value;
+    }
+
+    void GetDerivative(const ParametersType& parameters, DerivativeType& derivative) const override
+    {
+      derivative.SetSize(parameters.GetSize());
+      for (unsigned int i = 0; i < parameters.GetSize(); ++i)
+      {
+        derivative[i] = 2.0 * (i + 1.0) * parameters[i];
+      }
+    }
+
+    unsigned int GetNumberOfParameters() const override
+    {
+      return 3;
+    }
+  };
+
+
+  // The same cost function, which records its calls of GetValues() and GetValuesAndDerivatives().
+  class MultipleValuesQuadraticCostFunction
+    : public QuadraticCostFunction, public itk::MultipleValuesCostFunctionInterface
+  {
+  public:
+    using Self = MultipleValuesQuadraticCostFunction;
+    using Pointer = itk::SmartPointer<Self>;
+
+    itkNewMacro(Self);
+
+    void GetValues(const ParametersVectorType& parameters, MeasureVectorType& values) const override
+    {
+      ++m_NumberOfCalls;
+      values.resize(parameters.size());
+      for (std::size_t i = 0; i < parameters.size(); ++i)
+      {
+        values[i] = this->GetValue(parameters[i]);
+      }
+    }
+
+    void GetValuesAndDerivatives(const ParametersVectorType& parameters,
+                                 MeasureVectorType& values,
+                                 DerivativeVectorType& derivatives) const override
+    {
+      ++m_NumberOfCalls;
+      values.resize(parameters.size());
+      derivatives.resize(parameters.size());
+      for (std::size_t i = 0; i < parameters.size(); ++i)
+      {
+        this->GetValueAndDerivative(parameters[i], values[i], derivatives[i]);
+      }
+    }
+
+    mutable unsigned int m_NumberOfCalls = 0;
+  };
+
+
+  itk::MultipleValuesCostFunctionInterface::ParametersVectorType CreateParameters()
+  {
+    itk::MultipleValuesCostFunctionInterface::ParametersVectorType parameters(4, itk::OptimizerParameters<double>(3));
+    for (std::size_t i = 0; i < parameters.size(); ++i)
+    {
+      for (unsigned int j = 0; j < 3; ++j)
+      {
+        parameters[i][j] = static_cast<double>(i) - 0.5 * j;
+      }
+    }
+    return parameters;
+  }
+
+
+  void ExpectValuesEqualToGetValue(const itk::ScaledSingleValuedCostFunction& costFunction)
+  {
+    const auto parameters = CreateParameters();
+    itk::MultipleValuesCostFunctionInterface::MeasureVectorType values;
+    costFunction.GetValues(parameters, values);
+
+    ASSERT_EQ(values.size(), parameters.size());
+    for (std::size_t i = 0; i < parameters.size(); ++i)
+    {
+      EXPECT_EQ(values[i], costFunction.GetValue(parameters[i]));
+    }
+  }
+
+
+  void ExpectValuesAndDerivativesEqualToGetValueAndDerivative(const itk::ScaledSingleValuedCostFunction& costFunction)
+  {
+    const auto parameters = CreateParameters();
+    itk::MultipleValuesCostFunctionInterface::MeasureVectorType values;
+    itk::MultipleValuesCostFunctionInterface::DerivativeVectorType derivatives;
+    costFunction.GetValuesAndDerivatives(parameters, values, derivatives);
+
+    ASSERT_EQ(values.size(), parameters.size());
+    ASSERT_EQ(derivatives.size(), parameters.size());
+    for (std::size_t i = 0; i < parameters.size(); ++i)
+    {
+      itk::ScaledSingleValuedCostFunction::MeasureType value;
+      itk::ScaledSingleValuedCostFunction::DerivativeType derivative;
+      costFunction.GetValueAndDerivative(parameters[i], value, derivative);
+      EXPECT_EQ(values[i], value);
+      EXPECT_EQ(derivatives[i], derivative);
+    }
+  }
+
+
+  void SetScalesAndNegate(itk::ScaledSingleValuedCostFunction& costFunction)
+  {
+    itk::ScaledSingleValuedCostFunction::ScalesType scales(3);
+    scales[0] = 1.0;
+    scales[1] = 2.0;
+    scales[2] = 0.25;
+    costFunction.SetScales(scales);
+    costFunction.SetUseScales(true);
+    costFunction.SetNegateCostFunction(true);
+  }
+
+} // namespace
+
+
+GTEST_TEST(ScaledSingleValuedCostFunction, GetValuesWithoutMultipleValuesInterface)
+{
+  const auto costFunction = itk::ScaledSingleValuedCostFunction::New();
+  costFunction->SetUnscaledCostFunction(QuadraticCostFunction::New());
+  ExpectValuesEqualToGetValue(*costFunction);
+
+  SetScalesAndNegate(*costFunction);
+  ExpectValuesEqualToGetValue(*costFunction);
+}
+
+
+GTEST_TEST(ScaledSingleValuedCostFunction, GetValuesPassesScaledParametersToMultipleValuesInterface)
+{
+  const auto unscaledCostFunction = MultipleValuesQuadraticCostFunction::New();
+  const auto costFunction = itk::ScaledSingleValuedCostFunction::New();
+  costFunction->SetUnscaledCostFunction(unscaledCostFunction);
+  SetScalesAndNegate(*costFunction);
+
+  ExpectValuesEqualToGetValue(*costFunction);
+  EXPECT_EQ(unscaledCostFunction->m_NumberOfCalls, 1u);
+}
+
+
+GTEST_TEST(ScaledSingleValuedCostFunction, GetValuesAndDerivativesWithoutMultipleValuesInterface)
+{
+  const auto costFunction = itk::ScaledSingleValuedCostFunction::New();
+  costFunction->SetUnscaledCostFunction(QuadraticCostFunction::New());
+  ExpectValuesAndDerivativesEqualToGetValueAndDerivative(*costFunction);
+
+  SetScalesAndNegate(*costFunction);
+  ExpectValuesAndDerivativesEqualToGetValueAndDerivative(*costFunction);
+}
+
+
+GTEST_TEST(ScaledSingleValuedCostFunction, GetValuesAndDerivativesPassesScaledParametersToMultipleValuesInterface)
+{
+  const auto unscaledCostFunction = MultipleValuesQuadraticCostFunction::New();
+  const auto costFunction = itk::ScaledSingleValuedCostFunction::New();
+  costFunction->SetUnscaledCostFunction(unscaledCostFunction);
+  SetScalesAndNegate(*costFunction);
+
+  ExpectValuesAndDerivativesEqualToGetValueAndDerivative(*costFunction);
+  EXPECT_EQ(unscaledCostFunction->m_NumberOfCalls, 1u);
+}
+
+
+GTEST_TEST(ScaledSingleValuedCostFunction, ActiveParametersKeepInactiveParametersFixed)
+{
+  const auto costFunction = itk::ScaledSingleValuedCostFunction::New();
+  costFunction->SetUnscaledCostFunction(QuadraticCostFunction::New());
+  SetScalesAndNegate(*costFunction);
+
+  itk::ScaledSingleValuedCostFunction::ParametersType fullParameters(3);
+  fullParameters[0] = 1.0;
+  fullParameters[1] = -2.0;
+  fullParameters[2] = 3.0;
+  costFunction->SetFullParameters(fullParameters);
+  costFunction->SetActiveParameterIndices({ 0, 2 });
+  EXPECT_EQ(costFunction->GetNumberOfParameters(), 2u);
+
+  // The active parameters are scaled: y = x * s.
+  itk::ScaledSingleValuedCostFunction::ParametersType scaledParameters;
+  costFunction->ComputeScaledParameters(fullParameters, scaledParameters);
+  ASSERT_EQ(scaledParameters.GetSize(), 2u);
+  EXPECT_EQ(scaledParameters[0], 1.0);
+  EXPECT_EQ(scaledParameters[1], 0.75);
+
+  itk::ScaledSingleValuedCostFunction::ParametersType unscaledParameters;
+  costFunction->ComputeUnscaledParameters(scaledParameters, unscaledParameters);
+  EXPECT_EQ(unscaledParameters, fullParameters);
+
+  // F(y) = -f(x), and dF/dy_i = -1/s_i * df/dx_i of the active parameters.
+  itk::ScaledSingleValuedCostFunction::MeasureType value;
+  itk::ScaledSingleValuedCostFunction::DerivativeType derivative;
+  costFunction->GetValueAndDerivative(scaledParameters, value, derivative);
+  EXPECT_EQ(value, -(1.0 + 8.0 + 27.0));
+  ASSERT_EQ(derivative.GetSize(), 2u);
+  EXPECT_EQ(derivative[0], -2.0);
+  EXPECT_EQ(derivative[1], -18.0 / 0.25);
+}
@@ -0,0 +1,119 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "itkStackResampleImageFilter.h"
+
+#include "itkAdvancedTranslationTransform.h"
+#include "itkReducedDimensionBSplineInterpolateImageFunction.h"
+
+#include <itkImage.h>
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkResampleImageFilter.h>
+
+#include <cmath>
+#include <gtest/gtest.h>
+
+
+namespace
+{
+  using ImageType = itk::Image<float, 3>;
+  using FilterType = itk::StackResampleImageFilter<ImageType, double>;
+  using StackTransformType = FilterType::StackTransformType;
+  using SubTransformType = itk::AdvancedTranslationTransform<double, 2>;
+
+  ImageType::Pointer CreateStack()
+  {
+    const ImageType::SizeType size = { { 23, 19, 5 } };
+    const auto image = ImageType::New();
+    image->SetRegions(size);
+    ImageType::SpacingType spacing;
+    spacing[0] = 1.2;
+    spacing[1] = 0.9;
+    spacing[2] = 1.0;
+    image->SetSpacing(spacing);
+    image->Allocate();
+    for (itk::ImageRegionIteratorWithIndex<ImageType> it(image, image->GetBufferedRegion()); !it.IsAtEnd(); ++it)
+    {
+      const auto index = it.GetIndex();
+      it.Set(static_cast<float>(std::sin(0.3 * index[0] + index[2]) * std::cos(0.4 * index[1]) + index[2]));
+    }
+    return image;
+  }
+
+  /** A translation per slice. */
+  StackTransformType::Pointer CreateStackTransform(const unsigned int numberOfSlices)
+  {
+    const auto stackTransform = StackTransformType::New();
+    stackTransform->SetNumberOfSubTransforms(numberOfSlices);
+    stackTransform->SetStackOrigin(0.0);
+    stackTransform->SetStackSpacing(1.0);
+    for (unsigned int t = 0; t < numberOfSlices; ++t)
+    {
+      const auto subTransform = SubTransformType::New();
+      SubTransformType::ParametersType parameters(2);
+      parameters[0] = 0.7 * t - 1.1;
+      parameters[1] = 1.3 - 0.4 * t;
+      subTransform->SetParameters(parameters);
+      stackTransform->SetSubTransform(t, subTransform);
+    }
+    return stackTransform;
+  }
+}
+
+
+GTEST_TEST(StackResampleImageFilter, EqualsResampleImageFilterWithReducedDimensionBSpline)
+{
+  using ReducedDimensionInterpolatorType = itk::ReducedDimensionBSplineInterpolateImageFunction<ImageType, double, double>;
+  using ResampleFilterType = itk::ResampleImageFilter<ImageType, ImageType, double>;
+
+  const auto inputImage = CreateStack();
+  const auto stackTransform = CreateStackTransform(inputImage->GetLargestPossibleRegion().GetSize(2));
+
+  for (unsigned int splineOrder = 0; splineOrder <= 3; splineOrder += 3)
+  {
+    const auto filter = FilterType::New();
+    filter->SetInput(inputImage);
+    filter->SetStackTransform(stackTransform);
+    filter->SetSplineOrder(splineOrder);
+    filter->SetSize(inputImage->GetLargestPossibleRegion().GetSize());
+    filter->SetOutputSpacing(inputImage->GetSpacing());
+    filter->SetDefaultPixelValue(-5.0f);
+    filter->Update();
+
+    const auto interpolator = ReducedDimensionInterpolatorType::New();
+    interpolator->SetSplineOrder(splineOrder);
+    const auto resampler = ResampleFilterType::New();
+    resampler->SetInput(inputImage);
+    resampler->SetInterpolator(interpolator);
+    resampler->SetTransform(stackTransform);
+    resampler->SetSize(inputImage->GetLargestPossibleRegion().GetSize());
+    resampler->SetOutputSpacing(inputImage->GetSpacing());
+    resampler->SetDefaultPixelValue(-5.0f);
+    resampler->Update();
+
+    itk::ImageRegionConstIterator<ImageType> it1(filter->GetOutput(), filter->GetOutput()->GetBufferedRegion());
+    itk::ImageRegionConstIterator<ImageType> it2(resampler->GetOutput(), resampler->GetOutput()->GetBufferedRegion());
+    for (; !it1.IsAtEnd(); ++it1, ++it2)
+    {
+      EXPECT_NEAR(it1.Get(), it2.Get(), 1e-4);
+    }
+  }
+}
@@ -0,0 +1,228 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// First include the header file to be tested:
+#include "itkSubspaceIterationEigenSolver.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+
+namespace
+{
+  using itk::SubspaceIterationEigenSolver;
+  using MatrixType = SubspaceIterationEigenSolver::MatrixType;
+  using VectorType = SubspaceIterationEigenSolver::VectorType;
+
+  // Returns the correlation matrix of G time points that share numberOfModes modes, like the
+  // correlation matrix of the groupwise PCA metrics. A non-zero shift changes it slightly.
+  MatrixType CreateCorrelationMatrix(const unsigned int G, const double shift, const unsigned int numberOfModes = 8)
+  {
+    const unsigned int numberOfSamples = 500;
+    MatrixType         data(numberOfSamples, G);
+    for (unsigned int i = 0; i < numberOfSamples; ++i)
+    {
+      for (unsigned int j = 0; j < G; ++j)
+      {
+        const double t = static_cast<double>(j) / G;
+        data(i, j) = 0.1 * std::sin(1.3 * i * (j + 1) + shift);
+        for (unsigned int m = 0; m < numberOfModes; ++m)
+        {
+          data(i, j) += 4.0 / (m + 1) * std::sin((0.1 + 0.13 * m) * i + m) * std::cos(m * 3.14159 * t + shift);
+        }
+      }
+    }
+
+    MatrixType C(G, G);
+    for (unsigned int j = 0; j < G; ++j)
+    {
+      for (unsigned int l = 0; l < G; ++l)
+      {
+        double meanJ = 0.0;
+        double meanL = 0.0;
+        for (unsigned int i = 0; i < numberOfSamples; ++i)
+        {
+          meanJ += data(i, j) / numberOfSamples;
+          meanL += data(i, l) / numberOfSamples;
+        }
+        double sum = 0.0;
+        for (unsigned int i = 0; i < numberOfSamples; ++i)
+        {
+          sum += (data(i, j) - meanJ) * (data(i, l) - meanL);
+        }
+        C(j, l) = sum;
+      }
+    }
+
+    MatrixType K(G, G);
+    for (unsigned int j = 0; j < G; ++j)
+    {
+      for (unsigned int l = 0; l < G; ++l)
+      {
+        K(j, l) = C(j, l) / std::sqrt(C(j, j) * C(l, l));
+      }
+    }
+    return K;
+  }
+
+
+  void ExpectEqualEigenPairs(const SubspaceIterationEigenSolver& solver, const MatrixType& K)
+  {
+    VectorType allEigenValues;
+    MatrixType allEigenVectors;
+    SubspaceIterationEigenSolver::ComputeAll(K, allEigenValues, allEigenVectors);
+
+    const unsigned int k = solver.GetNumberOfEigenPairs();
+    ASSERT_EQ(solver.GetEigenValues().size(), k);
+    ASSERT_EQ(solver.GetEigenVectors().rows(), K.rows());
+    ASSERT_EQ(solver.GetEigenVectors().cols(), k);
+
+    for (unsigned int j = 0; j < k; ++j)
+    {
+      EXPECT_NEAR(solver.GetEigenValues()[j], allEigenValues[j], 1e-9 * allEigenValues[0]);
+
+      // The eigenvectors are equal up to their sign.
+      double dot = 0.0;
+      for (unsigned int r = 0; r < K.rows(); ++r)
+      {
+        dot += solver.GetEigenVectors()(r, j) * allEigenVectors(r, j);
+      }
+      EXPECT_NEAR(std::abs(dot), 1.0, 1e-6);
+    }
+  }
+
+} // namespace
+
+
+GTEST_TEST(SubspaceIterationEigenSolver, ComputeAllReturnsDescendingEigenPairs)
+{
+  const MatrixType K = CreateCorrelationMatrix(20, 0.0);
+
+  VectorType eigenValues;
+  MatrixType eigenVectors;
+  SubspaceIterationEigenSolver::ComputeAll(K, eigenValues, eigenVectors);
+
+  ASSERT_EQ(eigenValues.size(), 20u);
+  for (unsigned int j = 0; j < 20; ++j)
+  {
+    if (j > 0)
+    {
+      EXPECT_LE(eigenValues[j], eigenValues[j - 1]);
+    }
+
+    // K v = lambda v
+    for (unsigned int r = 0; r < 20; ++r)
+    {
+      double Kv = 0.0;
+      for (unsigned int c = 0; c < 20; ++c)
+      {
+        Kv += K(r, c) * eigenVectors(c, j);
+      }
+      EXPECT_NEAR(Kv, eigenValues[j] * eigenVectors(r, j), 1e-10);
+    }
+  }
+}
+
+
+GTEST_TEST(SubspaceIterationEigenSolver, FirstCallComputesFullEigenDecomposition)
+{
+  const MatrixType K = CreateCorrelationMatrix(60, 0.0);
+
+  SubspaceIterationEigenSolver solver;
+  solver.SetNumberOfEigenPairs(6);
+  solver.Compute(K);
+
+  EXPECT_EQ(solver.GetNumberOfIterations(), 0u);
+  ExpectEqualEigenPairs(solver, K);
+}
+
+
+GTEST_TEST(SubspaceIterationEigenSolver, WarmStartConvergesToSameEigenPairs)
+{
+  SubspaceIterationEigenSolver solver;
+  solver.SetNumberOfEigenPairs(6);
+  solver.Compute(CreateCorrelationMatrix(60, 0.0));
+
+  for (unsigned int iteration = 1; iteration <= 5; ++iteration)
+  {
+    const MatrixType K = CreateCorrelationMatrix(60, 0.01 * iteration);
+    solver.Compute(K);
+
+    EXPECT_GT(solver.GetNumberOfIterations(), 0u);
+    ExpectEqualEigenPairs(solver, K);
+  }
+}
+
+
+GTEST_TEST(SubspaceIterationEigenSolver, ResetAndDisabledSubspaceIterationComputeFullEigenDecomposition)
+{
+  SubspaceIterationEigenSolver solver;
+  solver.SetNumberOfEigenPairs(6);
+  solver.Compute(CreateCorrelationMatrix(60, 0.0));
+
+  solver.Reset();
+  solver.Compute(CreateCorrelationMatrix(60, 0.01));
+  EXPECT_EQ(solver.GetNumberOfIterations(), 0u);
+
+  solver.SetUseSubspaceIteration(false);
+  for (unsigned int iteration = 2; iteration <= 3; ++iteration)
+  {
+    const MatrixType K = CreateCorrelationMatrix(60, 0.01 * iteration);
+    solver.Compute(K);
+    EXPECT_EQ(solver.GetNumberOfIterations(), 0u);
+    ExpectEqualEigenPairs(solver, K);
+  }
+}
+
+
+GTEST_TEST(SubspaceIterationEigenSolver, NoConvergenceComputesFullEigenDecompositionUntilReset)
+{
+  // With 3 modes, the 4th to 6th eigenvalues are close to the next ones.
+  SubspaceIterationEigenSolver solver;
+  solver.SetNumberOfEigenPairs(6);
+  solver.SetMaximumNumberOfIterations(3);
+  solver.Compute(CreateCorrelationMatrix(60, 0.0, 3));
+
+  for (unsigned int iteration = 1; iteration <= 2; ++iteration)
+  {
+    const MatrixType K = CreateCorrelationMatrix(60, 0.01 * iteration, 3);
+    solver.Compute(K);
+    EXPECT_EQ(solver.GetNumberOfIterations(), 0u);
+    ExpectEqualEigenPairs(solver, K);
+  }
+
+  solver.Reset();
+  solver.Compute(CreateCorrelationMatrix(60, 0.0));
+  solver.Compute(CreateCorrelationMatrix(60, 0.01));
+  EXPECT_GT(solver.GetNumberOfIterations(), 0u);
+}
+
+
+GTEST_TEST(SubspaceIterationEigenSolver, SmallMatrixComputesFullEigenDecomposition)
+{
+  // The subspace of 2 * 6 + 2 vectors is more than half of this matrix.
+  SubspaceIterationEigenSolver solver;
+  solver.SetNumberOfEigenPairs(6);
+  solver.Compute(CreateCorrelationMatrix(20, 0.0));
+
+  const MatrixType K = CreateCorrelationMatrix(20, 0.01);
+  solver.Compute(K);
+  EXPECT_EQ(solver.GetNumberOfIterations(), 0u);
+  ExpectEqualEigenPairs(solver, K);
+}
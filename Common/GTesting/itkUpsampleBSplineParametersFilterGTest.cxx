@@ -0,0 +1,157 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// First include the header file to be tested:
+#include "itkUpsampleBSplineParametersFilter.h"
+
+#include <itkArray.h>
+#include <itkImage.h>
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+
+namespace
+{
+  using ArrayType = itk::Array<double>;
+
+  template <unsigned int VDimension>
+  using FilterType = itk::UpsampleBSplineParametersFilter<ArrayType, itk::Image<double, VDimension>>;
+
+
+  // Sets a current grid, and a required grid with half the spacing and the same origin.
+  template <unsigned int VDimension>
+  typename FilterType<VDimension>::Pointer
+  CreateHalvingFilter(const unsigned int splineOrder, const itk::SizeValueType currentSize)
+  {
+    using Filter = FilterType<VDimension>;
+    const auto filter = Filter::New();
+
+    typename Filter::OriginType origin;
+    origin.Fill(1.5);
+    typename Filter::SpacingType spacing;
+    spacing.Fill(4.0);
+    typename Filter::DirectionType direction;
+    direction.SetIdentity();
+    typename Filter::RegionType region;
+    auto size = region.GetSize();
+    size.Fill(currentSize);
+    region.SetSize(size);
+
+    filter->SetBSplineOrder(splineOrder);
+    filter->SetCurrentGridOrigin(origin);
+    filter->SetCurrentGridSpacing(spacing);
+    filter->SetCurrentGridDirection(direction);
+    filter->SetCurrentGridRegion(region);
+
+    size.Fill(2 * currentSize - 1);
+    region.SetSize(size);
+    spacing.Fill(2.0);
+    filter->SetRequiredGridOrigin(origin);
+    filter->SetRequiredGridSpacing(spacing);
+    filter->SetRequiredGridDirection(direction);
+    filter->SetRequiredGridRegion(region);
+    return filter;
+  }
+} // namespace
+
+
+// For a linear B-spline, the control points of the current grid are kept,
+// and the new control points in between are their averages.
+GTEST_TEST(UpsampleBSplineParametersFilter, DyadicRefinementOfLinearBSplineInterpolates)
+{
+  const itk::SizeValueType currentSize = 6;
+  const auto filter = CreateHalvingFilter<1>(1, currentSize);
+  filter->UseDyadicRefinementOn();
+
+  ArrayType input(currentSize);
+  for (unsigned int i = 0; i < currentSize; ++i)
+  {
+    input[i] = std::sin(static_cast<double>(i));
+  }
+  ArrayType output;
+  filter->UpsampleParameters(input, output);
+
+  ASSERT_EQ(output.GetSize(), 2 * currentSize - 1);
+  for (unsigned int i = 0; i < currentSize; ++i)
+  {
+    EXPECT_DOUBLE_EQ(output[2 * i], input[i]);
+  }
+  for (unsigned int i = 0; i + 1 < currentSize; ++i)
+  {
+    EXPECT_DOUBLE_EQ(output[2 * i + 1], 0.5 * (input[i] + input[i + 1]));
+  }
+}
+
+
+// A cubic B-spline with constant coefficients is constant, so the refined
+// coefficients are the same constant, except near the border of the grid.
+GTEST_TEST(UpsampleBSplineParametersFilter, DyadicRefinementOfCubicBSplinePreservesConstant)
+{
+  const itk::SizeValueType currentSize = 5;
+  const itk::SizeValueType requiredSize = 2 * currentSize - 1;
+  const auto filter = CreateHalvingFilter<2>(3, currentSize);
+  filter->UseDyadicRefinementOn();
+
+  const ArrayType input(currentSize * currentSize * 2, 3.0);
+  ArrayType output;
+  filter->UpsampleParameters(input, output);
+
+  ASSERT_EQ(output.GetSize(), requiredSize * requiredSize * 2);
+  for (unsigned int d = 0; d < 2; ++d)
+  {
+    for (unsigned int y = 1; y + 1 < requiredSize; ++y)
+    {
+      for (unsigned int x = 1; x + 1 < requiredSize; ++x)
+      {
+        EXPECT_DOUBLE_EQ(output[(d * requiredSize + y) * requiredSize + x], 3.0);
+      }
+    }
+  }
+}
+
+
+// A required grid that does not halve the spacing is upsampled by the
+// default method.
+GTEST_TEST(UpsampleBSplineParametersFilter, DyadicRefinementFallsBackForOtherSpacings)
+{
+  const itk::SizeValueType currentSize = 6;
+  const auto filter = CreateHalvingFilter<2>(3, currentSize);
+  FilterType<2>::SpacingType spacing;
+  spacing.Fill(1.5);
+  filter->SetRequiredGridSpacing(spacing);
+
+  ArrayType input(currentSize * currentSize * 2);
+  for (unsigned int i = 0; i < input.GetSize(); ++i)
+  {
+    input[i] = std::cos(static_cast<double>(i));
+  }
+
+  ArrayType expected;
+  filter->UpsampleParameters(input, expected);
+  filter->UseDyadicRefinementOn();
+  ArrayType output;
+  filter->UpsampleParameters(input, output);
+
+  ASSERT_EQ(output.GetSize(), expected.GetSize());
+  for (unsigned int i = 0; i < output.GetSize(); ++i)
+  {
+    EXPECT_EQ(output[i], expected[i]);
+  }
+}
@@ -63,7 +63,9 @@ public:
   typedef typename Superclass::ImageSampleType              ImageSampleType;
   typedef typename Superclass::ImageSampleContainerType     ImageSampleContainerType;
   typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
+  typedef typename Superclass::ImplicitSampleContainerType  ImplicitSampleContainerType;
   typedef typename Superclass::MaskType                     MaskType;
+  typedef typename Superclass::SampleCacheKeyType           SampleCacheKeyType;
 
   /** The input image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int,
@@ -89,6 +91,13 @@ public:
   }
 
 
+  /** The full sampler can describe its samples implicitly. */
+  bool SupportsImplicitOutput( void ) const override
+  {
+    return true;
+  }
+
+
 protected:
 
   /** The constructor. */
@@ -102,6 +111,20 @@ protected:
   /** Function that does the work. */
   void GenerateData( void ) override;
 
+  /** Generate the samples, with or without threads. */
+  void GenerateSamples( void );
+
+  /** Describe the samples by the runs of voxels of the rows of the region
+   * that are inside the mask, instead of storing them in the output.
+   */
+  void GenerateImplicitSamples( void );
+
+  /** Without a mask, the number of samples of each work unit is the size of
+   * its region, so the work units write directly into their slice of the
+   * output. With a mask they fill their own containers, which are combined.
+   */
+  void BeforeThreadedGenerateData( void ) override;
+
   /** Multi-threaded function that does the work. */
   void ThreadedGenerateData(
     const InputImageRegionType & inputRegionForThread,
@@ -114,6 +137,9 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );            // purposely not implemented
 
+  /** The index of the first sample of each work unit in the output. */
+  std::vector< unsigned long > m_ThreaderOutputOffsets;
+
 };
 
 } // end namespace itk
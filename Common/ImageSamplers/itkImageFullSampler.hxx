@@ -33,6 +33,41 @@ template< class TInputImage >
 void
 ImageFullSampler< TInputImage >
 ::GenerateData( void )
+{
+  /** Only describe the samples, if requested. */
+  if( this->GetUseImplicitOutput() )
+  {
+    this->GenerateImplicitSamples();
+    return;
+  }
+
+  /** Reuse the samples of an earlier registration, if possible. */
+  SampleCacheKeyType cacheKey = 0;
+  const bool         useCache = this->GetUseSampleCache()
+    && this->ComputeSampleCacheKey( 0, cacheKey );
+  if( useCache && this->CopySamplesFromCache( cacheKey ) )
+  {
+    return;
+  }
+
+  this->GenerateSamples();
+
+  if( useCache )
+  {
+    this->AddSamplesToCache( cacheKey );
+  }
+
+} // end GenerateData()
+
+
+/**
+ * ******************* GenerateSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageFullSampler< TInputImage >
+::GenerateSamples( void )
 {
   /** If desired we exercise a multi-threaded version. */
   if( this->m_UseMultiThread )
@@ -115,7 +150,7 @@ ImageFullSampler< TInputImage >
       inputImage->TransformIndexToPhysicalPoint( index,
         tempSample.m_ImageCoordinates );
 
-      if( mask->IsInsideInWorldSpace( tempSample.m_ImageCoordinates ) )
+      if( this->GetMaskBitmap()->IsInsideInWorldSpace( tempSample.m_ImageCoordinates ) )
       {
         /** Get sampled image value. */
         tempSample.m_ImageValue = iter.Get();
@@ -127,7 +162,119 @@ ImageFullSampler< TInputImage >
     } // end for
   }     // end else (if mask exists)
 
-} // end GenerateData()
+} // end GenerateSamples()
+
+
+/**
+ * ******************* GenerateImplicitSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageFullSampler< TInputImage >
+::GenerateImplicitSamples( void )
+{
+  /** Get handles to the input image and the mask. */
+  InputImageConstPointer          inputImage = this->GetInput();
+  typename MaskType::ConstPointer mask       = this->GetMask();
+
+  /** The output stays empty. */
+  this->GetOutput()->Initialize();
+  this->m_ImplicitOutput->Initialize( inputImage, 1 );
+
+  /** Without a mask, each row of the region is one run. The iterator over
+   * the first column of the region visits the starts of the rows.
+   */
+  typedef ImageRegionConstIteratorWithIndex< InputImageType > InputImageIterator;
+  const InputImageRegionType & region = this->GetCroppedInputImageRegion();
+  if( mask.IsNull() )
+  {
+    InputImageRegionType firstColumn = region;
+    firstColumn.SetSize( 0, 1 );
+    typename ImplicitSampleContainerType::RunContainerType runs( firstColumn.GetNumberOfPixels() );
+    InputImageIterator rowIter( inputImage, firstColumn );
+    SizeValueType      row = 0;
+    for( rowIter.GoToBegin(); !rowIter.IsAtEnd(); ++rowIter, ++row )
+    {
+      runs[ row ].m_Index  = rowIter.GetIndex();
+      runs[ row ].m_Length = region.GetSize( 0 );
+    }
+    this->m_ImplicitOutput->AddRuns( runs );
+    return;
+  }
+
+  if( mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+
+  /** Add the voxels inside the mask, which extend the runs of their rows. */
+  InputImageIterator  iter( inputImage, region );
+  InputImagePointType point;
+  for( iter.GoToBegin(); !iter.IsAtEnd(); ++iter )
+  {
+    const InputImageIndexType & index = iter.GetIndex();
+    inputImage->TransformIndexToPhysicalPoint( index, point );
+    if( this->GetMaskBitmap()->IsInsideInWorldSpace( point ) )
+    {
+      this->m_ImplicitOutput->AddIndex( index );
+    }
+  }
+
+} // end GenerateImplicitSamples()
+
+
+/**
+ * ******************* BeforeThreadedGenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageFullSampler< TInputImage >
+::BeforeThreadedGenerateData( void )
+{
+  /** Initialize the containers of the threads. */
+  Superclass::BeforeThreadedGenerateData();
+  if( this->GetMask() )
+  {
+    return;
+  }
+
+  /** Compute where the samples of each work unit start in the output. */
+  const ThreadIdType numberOfWorkUnits = this->GetNumberOfWorkUnits();
+  this->m_ThreaderOutputOffsets.assign( numberOfWorkUnits, 0 );
+  unsigned long numberOfSamples = 0;
+  for( ThreadIdType threadId = 0; threadId < numberOfWorkUnits; ++threadId )
+  {
+    this->m_ThreaderOutputOffsets[ threadId ] = numberOfSamples;
+    InputImageRegionType splitRegion;
+    if( threadId < this->SplitRequestedRegion( threadId, numberOfWorkUnits, splitRegion ) )
+    {
+      numberOfSamples += splitRegion.GetNumberOfPixels();
+    }
+  }
+
+  /** Try to allocate the output. If no mask is used this can raise std
+   * exceptions when the input image is large.
+   */
+  try
+  {
+    this->AllocateThreaderOutput( numberOfSamples );
+  }
+  catch( std::exception & excp )
+  {
+    std::string message = "std: ";
+    message += excp.what();
+    message += "\nERROR: failed to allocate memory for the sample container.";
+    const char * message2 = message.c_str();
+    itkExceptionMacro( << message2 );
+  }
+  catch( ... )
+  {
+    itkExceptionMacro( << "ERROR: failed to allocate memory for the sample container." );
+  }
+
+} // end BeforeThreadedGenerateData()
 
 
 /**
@@ -143,8 +290,6 @@ ImageFullSampler< TInputImage >
   /** Get handles to the input image, mask and the output. */
   InputImageConstPointer inputImage = this->GetInput();
   typename MaskType::ConstPointer mask = this->GetMask();
-  ImageSampleContainerPointer & sampleContainerThisThread // & ???
-    = this->m_ThreaderSampleContainer[ threadId ];
 
   /** Set up a region iterator within the user specified image region. */
   typedef ImageRegionConstIteratorWithIndex< InputImageType > InputImageIterator;
@@ -152,46 +297,26 @@ ImageFullSampler< TInputImage >
   InputImageIterator iter( inputImage, inputRegionForThread );
 
   /** Fill the sample container. */
-  const unsigned long chunkSize = inputRegionForThread.GetNumberOfPixels();
   if( mask.IsNull() )
   {
-    /** Try to reserve memory. If no mask is used this can raise std
-     * exceptions when the input image is large.
+    /** Simply loop over the image and store all samples in the slice of
+     * this thread in the allocated output.
      */
-    try
-    {
-      sampleContainerThisThread->Reserve( chunkSize );
-    }
-    catch( std::exception & excp )
-    {
-      std::string message = "std: ";
-      message += excp.what();
-      message += "\nERROR: failed to allocate memory for the sample container.";
-      const char * message2 = message.c_str();
-      itkExceptionMacro( << message2 );
-    }
-    catch( ... )
-    {
-      itkExceptionMacro( << "ERROR: failed to allocate memory for the sample container." );
-    }
-
-    /** Simply loop over the image and store all samples in the container. */
-    ImageSampleType tempSample;
-    unsigned long   ind = 0;
+    ImageSampleContainerType & threaderOutput = *this->m_ThreaderOutput;
+    unsigned long              ind            = this->m_ThreaderOutputOffsets[ threadId ];
     for( iter.GoToBegin(); !iter.IsAtEnd(); ++iter, ++ind )
     {
+      ImageSampleType & sample = threaderOutput[ ind ];
+
       /** Get sampled index */
       InputImageIndexType index = iter.GetIndex();
 
       /** Translate index to point */
       inputImage->TransformIndexToPhysicalPoint( index,
-        tempSample.m_ImageCoordinates );
+        sample.m_ImageCoordinates );
 
       /** Get sampled image value */
-      tempSample.m_ImageValue = iter.Get();
-
-      /** Store in container. */
-      sampleContainerThisThread->SetElement( ind, tempSample );
+      sample.m_ImageValue = iter.Get();
 
     } // end for
   } // end if no mask
@@ -202,6 +327,10 @@ ImageFullSampler< TInputImage >
       mask->GetSource()->Update();
     }
 
+    /** The number of samples is unknown, so fill the container of this thread. */
+    ImageSampleContainerPointer & sampleContainerThisThread
+      = this->m_ThreaderSampleContainer[ threadId ];
+
     /** Loop over the image and check if the points falls within the mask. */
     ImageSampleType tempSample;
     for( iter.GoToBegin(); !iter.IsAtEnd(); ++iter )
@@ -213,7 +342,7 @@ ImageFullSampler< TInputImage >
       inputImage->TransformIndexToPhysicalPoint( index,
         tempSample.m_ImageCoordinates );
 
-      if( mask->IsInsideInWorldSpace( tempSample.m_ImageCoordinates ) )
+      if( this->GetMaskBitmap()->IsInsideInWorldSpace( tempSample.m_ImageCoordinates ) )
       {
         /** Get sampled image value. */
         tempSample.m_ImageValue = iter.Get();
@@ -0,0 +1,192 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageGradientImportanceSampler_h
+#define __ImageGradientImportanceSampler_h
+
+#include "itkImageRandomSamplerBase.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace itk
+{
+/** \class ImageGradientImportanceSampler
+ *
+ * \brief Samples voxels of an image with a probability that increases
+ * with the gradient magnitude.
+ *
+ * In large homogeneous regions, uniformly drawn samples hardly contribute to
+ * the derivative of a similarity metric. This sampler draws the voxels of the
+ * InputImageRegion, within the mask if one is given, from the density
+ *
+ *   p(x) = ( 1 - UniformFraction ) |grad I(x)| / sum |grad I| + UniformFraction / N,
+ *
+ * where N is the number of candidate voxels. The uniform part keeps every
+ * voxel reachable. Each sample gets the importance weight 1 / ( N p(x) ),
+ * which has mean one, so that a weighted average over the samples estimates
+ * the average over all voxels. The metric must apply these weights, see
+ * GetSampleWeights().
+ *
+ * The gradient magnitude is computed from the input image, which in the
+ * registration is the output of the fixed image pyramid of the current
+ * resolution. The density is stored in an alias table, which lets each
+ * sample be drawn in constant time. The table is only rebuilt when the input
+ * image, the mask, the input image region or the uniform fraction changes,
+ * so once per resolution. Voxels may be selected multiple times.
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TInputImage >
+class ImageGradientImportanceSampler :
+  public ImageRandomSamplerBase< TInputImage >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageGradientImportanceSampler        Self;
+  typedef ImageRandomSamplerBase< TInputImage > Superclass;
+  typedef SmartPointer< Self >                  Pointer;
+  typedef SmartPointer< const Self >            ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageGradientImportanceSampler, ImageRandomSamplerBase );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass::DataObjectPointer            DataObjectPointer;
+  typedef typename Superclass::OutputVectorContainerType    OutputVectorContainerType;
+  typedef typename Superclass::OutputVectorContainerPointer OutputVectorContainerPointer;
+  typedef typename Superclass::InputImageType               InputImageType;
+  typedef typename Superclass::InputImagePointer            InputImagePointer;
+  typedef typename Superclass::InputImageConstPointer       InputImageConstPointer;
+  typedef typename Superclass::InputImageRegionType         InputImageRegionType;
+  typedef typename Superclass::InputImagePixelType          InputImagePixelType;
+  typedef typename Superclass::ImageSampleType              ImageSampleType;
+  typedef typename Superclass::ImageSampleContainerType     ImageSampleContainerType;
+  typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
+  typedef typename Superclass::MaskType                     MaskType;
+  typedef typename Superclass::ImageSampleValueType         ImageSampleValueType;
+  typedef typename Superclass::SampleWeightsType            SampleWeightsType;
+
+  /** The input image dimension. */
+  itkStaticConstMacro( InputImageDimension, unsigned int,
+    Superclass::InputImageDimension );
+
+  /** Other typdefs. */
+  typedef typename InputImageType::IndexType InputImageIndexType;
+  typedef typename InputImageType::PointType InputImagePointType;
+
+  /** The random number generator used to draw the samples. */
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+  typedef typename RandomGeneratorType::Pointer                  RandomGeneratorPointer;
+
+  /** Set/Get the fraction of the density that is uniform. A larger
+   * fraction gives a lower maximum weight, 1 / UniformFraction, and so
+   * a lower variance in homogeneous images. Default: 0.1.
+   */
+  itkSetClampMacro( UniformFraction, double, 0.0, 1.0 );
+  itkGetConstMacro( UniformFraction, double );
+
+  /** Get the number of voxels that can be sampled, found by the last update. */
+  itkGetConstMacro( NumberOfCandidateVoxels, SizeValueType );
+
+  /** The output samples have importance weights. */
+  bool GetUseSampleWeights( void ) const override
+  {
+    return true;
+  }
+
+
+protected:
+
+  /** The constructor. */
+  ImageGradientImportanceSampler();
+  /** The destructor. */
+  ~ImageGradientImportanceSampler() override {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Function that does the work. */
+  void GenerateData( void ) override;
+
+  /** Multi-threaded functionality that does the work. */
+  void BeforeThreadedGenerateData( void ) override;
+
+  void ThreadedGenerateData(
+    const InputImageRegionType & inputRegionForThread,
+    ThreadIdType threadId ) override;
+
+  /** Build the alias table of the density, if this was not done for the
+   * current input image, mask, input image region and uniform fraction.
+   */
+  virtual void UpdateAliasTable( void );
+
+  /** Draw a candidate voxel from the density. */
+  SizeValueType DrawCandidateVoxel( void ) const;
+
+  /** Get the sample of a candidate voxel. */
+  void GetCandidateVoxelSample( const SizeValueType candidate, ImageSampleType & sample ) const;
+
+  RandomGeneratorPointer m_RandomGenerator;
+
+private:
+
+  /** The private constructor. */
+  ImageGradientImportanceSampler( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );                 // purposely not implemented
+
+  double m_UniformFraction;
+
+  /** The offsets in the input image region of the candidate voxels.
+   * Empty without a mask, in which case all voxels are candidates.
+   */
+  std::vector< SizeValueType > m_CandidateOffsets;
+  SizeValueType                m_NumberOfCandidateVoxels;
+
+  /** The alias table: candidate i is kept if a uniform variate is below
+   * m_AliasProbabilities[ i ], otherwise m_Aliases[ i ] is taken.
+   */
+  std::vector< float >         m_AliasProbabilities;
+  std::vector< std::uint32_t > m_Aliases;
+
+  /** The importance weights of the candidates. */
+  std::vector< float > m_CandidateWeights;
+
+  /** The settings for which the alias table was built. */
+  const InputImageType * m_AliasTableInput;
+  ModifiedTimeType       m_AliasTableInputMTime;
+  const MaskType *       m_AliasTableMask;
+  ModifiedTimeType       m_AliasTableMaskMTime;
+  InputImageRegionType   m_AliasTableRegion;
+  double                 m_AliasTableUniformFraction;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageGradientImportanceSampler.hxx"
+#endif
+
+#endif // end #ifndef __ImageGradientImportanceSampler_h
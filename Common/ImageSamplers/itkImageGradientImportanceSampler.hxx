@@ -0,0 +1,359 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageGradientImportanceSampler_hxx
+#define __ImageGradientImportanceSampler_hxx
+
+#include "itkImageGradientImportanceSampler.h"
+
+#include "itkGradientMagnitudeImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+#include <limits>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TInputImage >
+ImageGradientImportanceSampler< TInputImage >
+::ImageGradientImportanceSampler()
+{
+  /** Setup random generator. */
+  this->m_RandomGenerator = RandomGeneratorType::GetInstance();
+
+  this->m_UniformFraction           = 0.1;
+  this->m_NumberOfCandidateVoxels   = 0;
+  this->m_AliasTableInput           = nullptr;
+  this->m_AliasTableInputMTime      = 0;
+  this->m_AliasTableMask            = nullptr;
+  this->m_AliasTableMaskMTime       = 0;
+  this->m_AliasTableUniformFraction = -1.0;
+
+} // end Constructor
+
+
+/**
+ * ******************* GenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageGradientImportanceSampler< TInputImage >
+::GenerateData( void )
+{
+  /** Get a handle to the output sample container. */
+  ImageSampleContainerPointer sampleContainer = this->GetOutput();
+
+  /** Clear the container. */
+  sampleContainer->Initialize();
+
+  /** Make sure the alias table is up-to-date. */
+  this->UpdateAliasTable();
+
+  /** If desired we exercise a multi-threaded version. */
+  if( this->m_UseMultiThread )
+  {
+    /** Calls ThreadedGenerateData(). */
+    return Superclass::GenerateData();
+  }
+
+  /** Draw the samples and store their weights. */
+  sampleContainer->Reserve( this->GetNumberOfSamples() );
+  this->m_SampleWeights.resize( this->GetNumberOfSamples() );
+  for( unsigned long i = 0; i < this->GetNumberOfSamples(); ++i )
+  {
+    const SizeValueType candidate = this->DrawCandidateVoxel();
+    this->GetCandidateVoxelSample( candidate, sampleContainer->ElementAt( i ) );
+    this->m_SampleWeights[ i ] = this->m_CandidateWeights[ candidate ];
+  }
+
+} // end GenerateData()
+
+
+/**
+ * ******************* BeforeThreadedGenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageGradientImportanceSampler< TInputImage >
+::BeforeThreadedGenerateData( void )
+{
+  /** Draw the candidates, so that the samples do not depend on the threads. */
+  this->m_RandomNumberList.resize( this->GetNumberOfSamples() );
+  this->m_SampleWeights.resize( this->GetNumberOfSamples() );
+  for( unsigned long i = 0; i < this->GetNumberOfSamples(); ++i )
+  {
+    const SizeValueType candidate = this->DrawCandidateVoxel();
+    this->m_RandomNumberList[ i ] = static_cast< double >( candidate );
+    this->m_SampleWeights[ i ]    = this->m_CandidateWeights[ candidate ];
+  }
+
+  /** Each work unit writes its samples directly into its slice. */
+  this->AllocateThreaderOutput( this->GetNumberOfSamples() );
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ******************* ThreadedGenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageGradientImportanceSampler< TInputImage >
+::ThreadedGenerateData( const InputImageRegionType &, ThreadIdType threadId )
+{
+  /** Figure out which samples to process. */
+  unsigned long chunkSize   = this->GetNumberOfSamples() / this->GetNumberOfWorkUnits();
+  unsigned long sampleStart = threadId * chunkSize;
+  if( threadId == this->GetNumberOfWorkUnits() - 1 )
+  {
+    chunkSize = this->GetNumberOfSamples()
+      - ( ( this->GetNumberOfWorkUnits() - 1 ) * chunkSize );
+  }
+
+  /** Convert the drawn candidates to samples, in the slice of this thread
+   * in the allocated output.
+   */
+  ImageSampleContainerType & threaderOutput = *this->m_ThreaderOutput;
+  for( unsigned long i = sampleStart; i < sampleStart + chunkSize; ++i )
+  {
+    const SizeValueType candidate
+      = static_cast< SizeValueType >( this->m_RandomNumberList[ i ] );
+    this->GetCandidateVoxelSample( candidate, threaderOutput[ i ] );
+  }
+
+} // end ThreadedGenerateData()
+
+
+/**
+ * ******************* UpdateAliasTable *******************
+ */
+
+template< class TInputImage >
+void
+ImageGradientImportanceSampler< TInputImage >
+::UpdateAliasTable( void )
+{
+  const InputImageType *       inputImage = this->GetInput();
+  const MaskType *             mask       = this->GetMask();
+  const InputImageRegionType & region     = this->GetCroppedInputImageRegion();
+
+  /** Make sure the mask is up-to-date, before checking its modification time. */
+  if( mask && mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+  const ModifiedTimeType maskMTime = mask ? mask->GetMTime() : 0;
+
+  /** Nothing to do if the table was built for the same settings. */
+  if( this->m_AliasTableInput == inputImage
+    && this->m_AliasTableInputMTime == inputImage->GetMTime()
+    && this->m_AliasTableMask == mask
+    && this->m_AliasTableMaskMTime == maskMTime
+    && this->m_AliasTableRegion == region
+    && this->m_AliasTableUniformFraction == this->m_UniformFraction )
+  {
+    return;
+  }
+
+  /** Compute the gradient magnitude in the input image region. */
+  typedef Image< float, InputImageDimension > GradientMagnitudeImageType;
+  typedef GradientMagnitudeImageFilter<
+    InputImageType, GradientMagnitudeImageType >  GradientMagnitudeFilterType;
+  typename GradientMagnitudeFilterType::Pointer gradientMagnitudeFilter
+    = GradientMagnitudeFilterType::New();
+  gradientMagnitudeFilter->SetInput( inputImage );
+  gradientMagnitudeFilter->GetOutput()->SetRequestedRegion( region );
+  gradientMagnitudeFilter->Update();
+
+  /** Collect the candidate voxels and their gradient magnitudes, in scan line order. */
+  std::vector< double > density;
+  this->m_CandidateOffsets.clear();
+  if( mask )
+  {
+    const typename Superclass::MaskBitmapType * maskBitmap = this->GetMaskBitmap();
+    ImageRegionConstIteratorWithIndex< GradientMagnitudeImageType > it(
+      gradientMagnitudeFilter->GetOutput(), region );
+    InputImagePointType point;
+    SizeValueType       offset = 0;
+    for( it.GoToBegin(); !it.IsAtEnd(); ++it, ++offset )
+    {
+      inputImage->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+      if( maskBitmap->IsInsideInWorldSpace( point ) )
+      {
+        this->m_CandidateOffsets.push_back( offset );
+        density.push_back( it.Get() );
+      }
+    }
+  }
+  else
+  {
+    density.reserve( region.GetNumberOfPixels() );
+    ImageRegionConstIterator< GradientMagnitudeImageType > it(
+      gradientMagnitudeFilter->GetOutput(), region );
+    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+    {
+      density.push_back( it.Get() );
+    }
+  }
+
+  const SizeValueType numberOfCandidates = density.size();
+  if( numberOfCandidates == 0 )
+  {
+    itkExceptionMacro( << "ERROR: the mask does not contain any voxel of the input image region." );
+  }
+  if( numberOfCandidates > std::numeric_limits< std::uint32_t >::max() )
+  {
+    itkExceptionMacro( << "ERROR: the input image region contains too many voxels for the alias table." );
+  }
+
+  /** Scale the density to a mean of one, q = N p, and store the weights 1 / q. */
+  double sumOfGradientMagnitudes = 0.0;
+  for( const double gradientMagnitude : density )
+  {
+    sumOfGradientMagnitudes += gradientMagnitude;
+  }
+  const double uniformFraction = sumOfGradientMagnitudes > 0.0 ? this->m_UniformFraction : 1.0;
+  const double gradientFactor  = sumOfGradientMagnitudes > 0.0
+    ? ( 1.0 - uniformFraction ) * numberOfCandidates / sumOfGradientMagnitudes : 0.0;
+  this->m_CandidateWeights.resize( numberOfCandidates );
+  for( SizeValueType i = 0; i < numberOfCandidates; ++i )
+  {
+    density[ i ]                  = gradientFactor * density[ i ] + uniformFraction;
+    this->m_CandidateWeights[ i ] = static_cast< float >( 1.0 / density[ i ] );
+  }
+
+  /** Build the alias table with Vose's method: pair each candidate with a
+   * density below one with a candidate with a density above one, which
+   * receives the remainder of its cell.
+   */
+  this->m_AliasProbabilities.assign( numberOfCandidates, 1.0f );
+  this->m_Aliases.resize( numberOfCandidates );
+  std::vector< std::uint32_t > small;
+  std::vector< std::uint32_t > large;
+  for( SizeValueType i = 0; i < numberOfCandidates; ++i )
+  {
+    this->m_Aliases[ i ] = static_cast< std::uint32_t >( i );
+    ( density[ i ] < 1.0 ? small : large ).push_back( static_cast< std::uint32_t >( i ) );
+  }
+  while( !small.empty() && !large.empty() )
+  {
+    const std::uint32_t lessThanOne = small.back();
+    small.pop_back();
+    const std::uint32_t moreThanOne = large.back();
+
+    this->m_AliasProbabilities[ lessThanOne ] = static_cast< float >( density[ lessThanOne ] );
+    this->m_Aliases[ lessThanOne ]            = moreThanOne;
+
+    density[ moreThanOne ] -= 1.0 - density[ lessThanOne ];
+    if( density[ moreThanOne ] < 1.0 )
+    {
+      large.pop_back();
+      small.push_back( moreThanOne );
+    }
+  }
+  /** The remaining candidates have a density of one, up to rounding errors,
+   * and keep the probability one of the initialization.
+   */
+
+  this->m_NumberOfCandidateVoxels   = numberOfCandidates;
+  this->m_AliasTableInput           = inputImage;
+  this->m_AliasTableInputMTime      = inputImage->GetMTime();
+  this->m_AliasTableMask            = mask;
+  this->m_AliasTableMaskMTime       = maskMTime;
+  this->m_AliasTableRegion          = region;
+  this->m_AliasTableUniformFraction = this->m_UniformFraction;
+
+} // end UpdateAliasTable()
+
+
+/**
+ * ******************* DrawCandidateVoxel *******************
+ */
+
+template< class TInputImage >
+SizeValueType
+ImageGradientImportanceSampler< TInputImage >
+::DrawCandidateVoxel( void ) const
+{
+  const SizeValueType cell
+    = this->m_RandomGenerator->GetIntegerVariate( this->m_NumberOfCandidateVoxels - 1 );
+  if( this->m_RandomGenerator->GetVariateWithOpenUpperRange() < this->m_AliasProbabilities[ cell ] )
+  {
+    return cell;
+  }
+  return this->m_Aliases[ cell ];
+
+} // end DrawCandidateVoxel()
+
+
+/**
+ * ******************* GetCandidateVoxelSample *******************
+ */
+
+template< class TInputImage >
+void
+ImageGradientImportanceSampler< TInputImage >
+::GetCandidateVoxelSample( const SizeValueType candidate, ImageSampleType & sample ) const
+{
+  const InputImageRegionType & region = this->GetCroppedInputImageRegion();
+
+  /** Convert the offset in the region to an index. */
+  SizeValueType offset = this->m_CandidateOffsets.empty()
+    ? candidate : this->m_CandidateOffsets[ candidate ];
+  InputImageIndexType index;
+  for( unsigned int d = 0; d < InputImageDimension; ++d )
+  {
+    index[ d ] = region.GetIndex( d ) + static_cast< IndexValueType >( offset % region.GetSize( d ) );
+    offset    /= region.GetSize( d );
+  }
+
+  const InputImageType * inputImage = this->GetInput();
+  inputImage->TransformIndexToPhysicalPoint( index, sample.m_ImageCoordinates );
+  sample.m_ImageValue = static_cast< ImageSampleValueType >( inputImage->GetPixel( index ) );
+
+} // end GetCandidateVoxelSample()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TInputImage >
+void
+ImageGradientImportanceSampler< TInputImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "UniformFraction: " << this->m_UniformFraction << std::endl;
+  os << indent << "NumberOfCandidateVoxels: " << this->m_NumberOfCandidateVoxels << std::endl;
+  os << indent << "RandomGenerator: " << this->m_RandomGenerator.GetPointer() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __ImageGradientImportanceSampler_hxx
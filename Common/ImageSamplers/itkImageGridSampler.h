@@ -19,6 +19,9 @@
 #define __ImageGridSampler_h
 
 #include "itkImageSamplerBase.h"
+#include "itkPersistentThreadPool.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -31,6 +34,14 @@ namespace itk
  * The grid can be specified by an integer downsampling factor for
  * each dimension.
  *
+ * The samples are generated in parallel, and emitted tile by tile: the grid
+ * is divided in tiles of TileSize grid points along each dimension, which
+ * are visited in scan line order, as are the grid points within each tile.
+ * Consecutive samples are thus close in space, which improves the locality
+ * of the interpolation of the moving image in the metric. The samples are
+ * cached, and only regenerated when the input image, the mask, the input
+ * image region, the grid spacing or the tile size changes.
+ *
  * \parameter SampleGridSpacing: This parameter controls the spacing
  *    of the uniform grid in all dimensions. This should be given in
  *    index coordinates. \n
@@ -70,7 +81,9 @@ public:
   typedef typename Superclass::ImageSampleType              ImageSampleType;
   typedef typename Superclass::ImageSampleContainerType     ImageSampleContainerType;
   typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
+  typedef typename Superclass::ImplicitSampleContainerType  ImplicitSampleContainerType;
   typedef typename Superclass::MaskType                     MaskType;
+  typedef typename Superclass::SampleCacheKeyType           SampleCacheKeyType;
 
   /** The input image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int,
@@ -131,6 +144,19 @@ public:
   }
 
 
+  /** The grid sampler can describe its samples implicitly. */
+  bool SupportsImplicitOutput( void ) const override
+  {
+    return true;
+  }
+
+
+  /** Set/Get the number of grid points along each dimension of a tile.
+   * A tile size of 0 gives the plain scan line order of the grid. Default: 8.
+   */
+  itkSetMacro( TileSize, unsigned int );
+  itkGetConstMacro( TileSize, unsigned int );
+
 protected:
 
   /** The constructor. */
@@ -145,6 +171,12 @@ protected:
   /** Function that does the work. */
   void GenerateData( void ) override;
 
+  /** Generate the samples of the grid, in tile order. With the implicit
+   * output, only the runs of grid points along the first dimension are
+   * stored.
+   */
+  void GenerateSamples( void );
+
   /** An array of integer spacing factors */
   SampleGridSpacingType m_SampleGridSpacing;
 
@@ -158,6 +190,36 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );      // purposely not implemented
 
+  /** Generate the samples of the tiles of a work unit. */
+  static ITK_THREAD_RETURN_TYPE GridThreaderCallback( void * arg );
+
+  /** The data passed to GridThreaderCallback(). */
+  typedef typename ImplicitSampleContainerType::RunContainerType RunContainerType;
+  struct GridThreaderParameterType
+  {
+    const Self *                                  m_Sampler;
+    SampleGridIndexType                           m_SampleGridIndex;
+    SampleGridSizeType                            m_SampleGridSize;
+    SampleGridSizeType                            m_TileSize;
+    SampleGridSizeType                            m_NumberOfTiles;
+    SizeValueType                                 m_TotalNumberOfTiles;
+    bool                                          m_Implicit;
+    std::vector< std::vector< ImageSampleType > > m_WorkUnitSamples;
+    std::vector< RunContainerType >               m_WorkUnitRuns;
+  };
+
+  unsigned int m_TileSize;
+
+  /** The samples of the last update, and the settings for which they were generated. */
+  std::vector< ImageSampleType > m_CachedSamples;
+  const InputImageType *         m_CachedInput;
+  ModifiedTimeType               m_CachedInputMTime;
+  const MaskType *               m_CachedMask;
+  ModifiedTimeType               m_CachedMaskMTime;
+  InputImageRegionType           m_CachedRegion;
+  SampleGridSpacingType          m_CachedSampleGridSpacing;
+  unsigned int                   m_CachedTileSize;
+
 };
 
 } // end namespace itk
@@ -19,8 +19,9 @@
 #define __ImageGridSampler_hxx
 
 #include "itkImageGridSampler.h"
+#include "itkDataHash.h"
 
-#include "itkImageRegionConstIteratorWithIndex.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -36,6 +37,13 @@ ImageGridSampler< TInputImage >
   this->m_SampleGridSpacing.Fill( 1 );
   this->m_RequestedNumberOfSamples = 0;
   this->m_SampleGridSpacing.Fill( static_cast< SampleGridSpacingValueType >( 0.0 ) );
+  this->m_TileSize         = 8;
+  this->m_CachedInput      = nullptr;
+  this->m_CachedInputMTime = 0;
+  this->m_CachedMask       = nullptr;
+  this->m_CachedMaskMTime  = 0;
+  this->m_CachedSampleGridSpacing.Fill( 0 );
+  this->m_CachedTileSize = 0;
 } // end Constructor
 
 
@@ -74,148 +82,241 @@ ImageGridSampler< TInputImage >
   /** Clear the container. */
   sampleContainer->Initialize();
 
-  /** Set up a region iterator within the user specified image region. */
-  typedef ImageRegionConstIteratorWithIndex< InputImageType > InputImageIterator;
-  InputImageIterator iter( inputImage, this->GetCroppedInputImageRegion() );
-
   /** Take into account the possibility of a smaller bounding box around the mask */
   this->SetNumberOfSamples( this->m_RequestedNumberOfSamples );
 
+  /** Make sure the mask is up-to-date, before checking its modification time. */
+  if( mask.IsNotNull() && mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+  const ModifiedTimeType maskMTime = mask.IsNotNull() ? mask->GetMTime() : 0;
+
+  /** The runs of the implicit samples are cheap to regenerate. */
+  if( this->GetUseImplicitOutput() )
+  {
+    this->GenerateSamples();
+    return;
+  }
+
+  /** Reuse the samples if they were generated for the same settings. */
+  if( this->m_CachedInput == inputImage.GetPointer()
+    && this->m_CachedInputMTime == inputImage->GetMTime()
+    && this->m_CachedMask == mask.GetPointer()
+    && this->m_CachedMaskMTime == maskMTime
+    && this->m_CachedRegion == this->GetCroppedInputImageRegion()
+    && this->m_CachedSampleGridSpacing == this->m_SampleGridSpacing
+    && this->m_CachedTileSize == this->m_TileSize )
+  {
+    sampleContainer->assign( this->m_CachedSamples.begin(), this->m_CachedSamples.end() );
+    return;
+  }
+
+  /** Reuse the samples of an earlier registration, if possible. */
+  DataHash::HashType parameterHash = DataHash::InitialValue;
+  for( unsigned int dim = 0; dim < InputImageDimension; dim++ )
+  {
+    parameterHash = DataHash::CombineValue( parameterHash,
+      static_cast< std::uint64_t >( this->m_SampleGridSpacing[ dim ] ) );
+  }
+  parameterHash = DataHash::CombineValue( parameterHash, this->m_TileSize );
+  SampleCacheKeyType cacheKey = 0;
+  const bool         useCache = this->GetUseSampleCache()
+    && this->ComputeSampleCacheKey( parameterHash, cacheKey );
+  if( !useCache || !this->CopySamplesFromCache( cacheKey ) )
+  {
+    this->GenerateSamples();
+    if( useCache )
+    {
+      this->AddSamplesToCache( cacheKey );
+    }
+  }
+
+  /** Store the samples for the next update. */
+  this->m_CachedSamples.assign( sampleContainer->begin(), sampleContainer->end() );
+  this->m_CachedInput             = inputImage.GetPointer();
+  this->m_CachedInputMTime        = inputImage->GetMTime();
+  this->m_CachedMask              = mask.GetPointer();
+  this->m_CachedMaskMTime         = maskMTime;
+  this->m_CachedRegion            = this->GetCroppedInputImageRegion();
+  this->m_CachedSampleGridSpacing = this->m_SampleGridSpacing;
+  this->m_CachedTileSize          = this->m_TileSize;
+
+} // end GenerateData()
+
+
+/**
+ * ******************* GenerateSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageGridSampler< TInputImage >
+::GenerateSamples( void )
+{
+  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
+
   /** Determine the grid. */
-  SampleGridIndexType index;
-  SampleGridSizeType  sampleGridSize;
-  SampleGridIndexType sampleGridIndex
-    = this->GetCroppedInputImageRegion().GetIndex();
+  GridThreaderParameterType temp;
+  temp.m_Sampler         = this;
+  temp.m_Implicit        = this->GetUseImplicitOutput();
+  temp.m_SampleGridIndex = this->GetCroppedInputImageRegion().GetIndex();
   const InputImageSizeType & inputImageSize
     = this->GetCroppedInputImageRegion().GetSize();
-  unsigned long numberOfSamplesOnGrid = 1;
+  temp.m_TotalNumberOfTiles = 1;
   for( unsigned int dim = 0; dim < InputImageDimension; dim++ )
   {
     /** The number of sample point along one dimension. */
-    sampleGridSize[ dim ] = 1
+    temp.m_SampleGridSize[ dim ] = 1
       + ( ( inputImageSize[ dim ] - 1 ) / this->GetSampleGridSpacing()[ dim ] );
 
     /** The position of the first sample along this dimension is
      * chosen to center the grid nicely on the input image region.
      */
-    sampleGridIndex[ dim ] += ( inputImageSize[ dim ]
-      - ( ( sampleGridSize[ dim ] - 1 ) * this->GetSampleGridSpacing()[ dim ] + 1 ) ) / 2;
+    temp.m_SampleGridIndex[ dim ] += ( inputImageSize[ dim ]
+      - ( ( temp.m_SampleGridSize[ dim ] - 1 ) * this->GetSampleGridSpacing()[ dim ] + 1 ) ) / 2;
 
-    /** Update the number of samples on the grid. */
-    numberOfSamplesOnGrid *= sampleGridSize[ dim ];
+    /** Without tiling, each row of the grid is a tile. */
+    if( this->m_TileSize == 0 )
+    {
+      temp.m_TileSize[ dim ] = dim == 0 ? temp.m_SampleGridSize[ dim ] : 1;
+    }
+    else
+    {
+      temp.m_TileSize[ dim ] = std::min< SizeValueType >( this->m_TileSize, temp.m_SampleGridSize[ dim ] );
+    }
+    temp.m_NumberOfTiles[ dim ]
+      = ( temp.m_SampleGridSize[ dim ] + temp.m_TileSize[ dim ] - 1 ) / temp.m_TileSize[ dim ];
+    temp.m_TotalNumberOfTiles *= temp.m_NumberOfTiles[ dim ];
   }
 
-  /** Prepare for looping over the grid. */
-  unsigned int dim_z = 1;
-  unsigned int dim_t = 1;
-  if( InputImageDimension > 2 )
+  /** Let the threads generate the samples of the tiles. Use more work units
+   * than threads, so that the threads that finish early, for instance
+   * because their tiles are outside the mask, take over the remaining ones.
+   */
+  const ThreadIdType numberOfWorkUnits = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( temp.m_TotalNumberOfTiles,
+    4 * PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() ) ) );
+  temp.m_WorkUnitSamples.resize( numberOfWorkUnits );
+  temp.m_WorkUnitRuns.resize( temp.m_Implicit ? numberOfWorkUnits : 0 );
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    numberOfWorkUnits, Self::GridThreaderCallback, &temp );
+
+  /** Concatenate the runs in tile order. */
+  if( temp.m_Implicit )
   {
-    dim_z = sampleGridSize[ 2 ];
-    if( InputImageDimension > 3 )
+    this->m_ImplicitOutput->Initialize( this->GetInput(), this->GetSampleGridSpacing()[ 0 ] );
+    for( const auto & runs : temp.m_WorkUnitRuns )
     {
-      dim_t = sampleGridSize[ 3 ];
+      this->m_ImplicitOutput->AddRuns( runs );
     }
+    return;
   }
-  index = sampleGridIndex;
 
-  if( mask.IsNull() )
+  /** Concatenate the samples in tile order. */
+  SizeValueType numberOfSamples = 0;
+  for( const auto & samples : temp.m_WorkUnitSamples )
   {
-    /** Ugly loop over the grid. */
-    for( unsigned int t = 0; t < dim_t; t++ )
-    {
-      for( unsigned int z = 0; z < dim_z; z++ )
-      {
-        for( unsigned int y = 0; y < sampleGridSize[ 1 ]; y++ )
-        {
-          for( unsigned int x = 0; x < sampleGridSize[ 0 ]; x++ )
-          {
-            ImageSampleType tempsample;
-
-            // Get sampled fixed image value.
-            tempsample.m_ImageValue = inputImage->GetPixel( index );
-
-            // Translate index to point.
-            inputImage->TransformIndexToPhysicalPoint(
-              index, tempsample.m_ImageCoordinates );
-
-            // Jump to next position on grid.
-            index[ 0 ] += this->m_SampleGridSpacing[ 0 ];
+    numberOfSamples += samples.size();
+  }
+  sampleContainer->reserve( numberOfSamples );
+  for( const auto & samples : temp.m_WorkUnitSamples )
+  {
+    sampleContainer->insert( sampleContainer->end(), samples.begin(), samples.end() );
+  }
 
-            // Store sample in container.
-            sampleContainer->push_back( tempsample );
+} // end GenerateSamples()
 
-          } // end x
-          index[ 0 ]  = sampleGridIndex[ 0 ];
-          index[ 1 ] += this->m_SampleGridSpacing[ 1 ];
 
-        } // end y
-        if( InputImageDimension > 2 )
-        {
-          index[ 1 ]  = sampleGridIndex[ 1 ];
-          index[ 2 ] += this->m_SampleGridSpacing[ 2 ];
-        }
-      } // end z
-      if( InputImageDimension > 3 )
-      {
-        index[ 2 ]  = sampleGridIndex[ 2 ];
-        index[ 3 ] += this->m_SampleGridSpacing[ 3 ];
-      }
-    } // end t
+/**
+ * ******************* GridThreaderCallback *******************
+ */
 
-  } // end if no mask
-  else
+template< class TInputImage >
+ITK_THREAD_RETURN_TYPE
+ImageGridSampler< TInputImage >
+::GridThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const ThreadIdType          workUnit = infoStruct->WorkUnitID;
+  GridThreaderParameterType * temp
+    = static_cast< GridThreaderParameterType * >( infoStruct->UserData );
+
+  const InputImageType *                      inputImage = temp->m_Sampler->GetInput();
+  const typename Superclass::MaskBitmapType * maskBitmap
+    = temp->m_Sampler->GetMask() ? temp->m_Sampler->GetMaskBitmap() : nullptr;
+  const SampleGridSpacingType &    spacing = temp->m_Sampler->GetSampleGridSpacing();
+  std::vector< ImageSampleType > & samples = temp->m_WorkUnitSamples[ workUnit ];
+
+  /** Figure out which tiles to process. */
+  const SizeValueType numberOfWorkUnits = infoStruct->NumberOfWorkUnits;
+  const SizeValueType tileBegin         = temp->m_TotalNumberOfTiles * workUnit / numberOfWorkUnits;
+  const SizeValueType tileEnd           = temp->m_TotalNumberOfTiles * ( workUnit + 1 ) / numberOfWorkUnits;
+
+  ImageSampleType     sample;
+  SampleGridIndexType index;
+  SizeValueType       tileStart[ InputImageDimension ];
+  SizeValueType       tileExtent[ InputImageDimension ];
+  for( SizeValueType tile = tileBegin; tile < tileEnd; ++tile )
   {
-    if( mask->GetSource() )
+    /** Compute the grid points covered by the tile. */
+    SizeValueType remainder    = tile;
+    SizeValueType numberOfRows = 1;
+    for( unsigned int d = 0; d < InputImageDimension; ++d )
     {
-      mask->GetSource()->Update();
+      tileStart[ d ]  = ( remainder % temp->m_NumberOfTiles[ d ] ) * temp->m_TileSize[ d ];
+      tileExtent[ d ] = std::min< SizeValueType >( temp->m_TileSize[ d ],
+        temp->m_SampleGridSize[ d ] - tileStart[ d ] );
+      remainder      /= temp->m_NumberOfTiles[ d ];
+      numberOfRows   *= d > 0 ? tileExtent[ d ] : 1;
     }
-    /* Ugly loop over the grid; checks also if a sample falls within the mask. */
-    for( unsigned int t = 0; t < dim_t; t++ )
+
+    /** Walk over the rows of the tile, in scan line order. */
+    for( SizeValueType row = 0; row < numberOfRows; ++row )
     {
-      for( unsigned int z = 0; z < dim_z; z++ )
+      index[ 0 ] = temp->m_SampleGridIndex[ 0 ] + static_cast< IndexValueType >( tileStart[ 0 ] * spacing[ 0 ] );
+      SizeValueType rowRemainder = row;
+      for( unsigned int d = 1; d < InputImageDimension; ++d )
       {
-        for( unsigned int y = 0; y < sampleGridSize[ 1 ]; y++ )
-        {
-          for( unsigned int x = 0; x < sampleGridSize[ 0 ]; x++ )
-          {
-            ImageSampleType tempsample;
-
-            // Translate index to point.
-            inputImage->TransformIndexToPhysicalPoint(
-              index, tempsample.m_ImageCoordinates );
-
-            if( mask->IsInsideInWorldSpace( tempsample.m_ImageCoordinates ) )
-            {
-              // Get sampled fixed image value.
-              tempsample.m_ImageValue = inputImage->GetPixel( index );
-
-              // Store sample in container.
-              sampleContainer->push_back( tempsample );
-
-            } // end if in mask
-              // Jump to next position on grid
-            index[ 0 ] += this->m_SampleGridSpacing[ 0 ];
+        index[ d ] = temp->m_SampleGridIndex[ d ] + static_cast< IndexValueType >(
+          ( tileStart[ d ] + rowRemainder % tileExtent[ d ] ) * spacing[ d ] );
+        rowRemainder /= tileExtent[ d ];
+      }
 
-          } // end x
-          index[ 0 ]  = sampleGridIndex[ 0 ];
-          index[ 1 ] += this->m_SampleGridSpacing[ 1 ];
+      for( SizeValueType x = 0; x < tileExtent[ 0 ]; ++x )
+      {
+        // Translate index to point.
+        inputImage->TransformIndexToPhysicalPoint( index, sample.m_ImageCoordinates );
 
-        } // end y
-        if( InputImageDimension > 2 )
+        if( !maskBitmap || maskBitmap->IsInsideInWorldSpace( sample.m_ImageCoordinates ) )
         {
-          index[ 1 ]  = sampleGridIndex[ 1 ];
-          index[ 2 ] += this->m_SampleGridSpacing[ 2 ];
+          if( temp->m_Implicit )
+          {
+            // Only store the position on the grid.
+            ImplicitSampleContainerType::AddIndexToRuns( index, spacing[ 0 ],
+              temp->m_WorkUnitRuns[ workUnit ] );
+          }
+          else
+          {
+            // Get sampled fixed image value.
+            sample.m_ImageValue = inputImage->GetPixel( index );
+
+            // Store sample in container.
+            samples.push_back( sample );
+          }
         }
-      } // end z
-      if( InputImageDimension > 3 )
-      {
-        index[ 2 ]  = sampleGridIndex[ 2 ];
-        index[ 3 ] += this->m_SampleGridSpacing[ 3 ];
+
+        // Jump to next position on grid.
+        index[ 0 ] += spacing[ 0 ];
       }
-    } // end t
-  }   // else (if mask exists)
+    }
+  }
 
-} // end GenerateData()
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end GridThreaderCallback()
 
 
 /**
@@ -294,6 +395,8 @@ ImageGridSampler< TInputImage >
      << this->m_SampleGridSpacing << std::endl;
   os << "RequestedNumberOfSamples: "
      << this->m_RequestedNumberOfSamples << std::endl;
+  os << "TileSize: "
+     << this->m_TileSize << std::endl;
 
 } // end PrintSelf()
 
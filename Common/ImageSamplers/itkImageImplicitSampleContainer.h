@@ -0,0 +1,231 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageImplicitSampleContainer_h
+#define __ImageImplicitSampleContainer_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkImageSample.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ImageImplicitSampleContainer
+ *
+ * \brief A container that describes image samples on a grid without storing them.
+ *
+ * Contrary to the VectorDataContainer of ImageSample's that is the output of
+ * the image samplers, this container only stores runs of consecutive grid
+ * points along the first dimension: the index of the first point, the number
+ * of points and the step between them. The coordinates of a sample are
+ * computed from its index when it is requested, and its value is read from
+ * the image buffer. For the full and grid samplers, also with a mask, this
+ * takes a fraction of the memory of the explicit samples, as there is only
+ * one run per row of the grid inside the mask. The samples are the same,
+ * bit for bit, and in the same order, as the explicit ones.
+ *
+ * \sa ImageSamplerBase::GetImplicitOutput()
+ * \ingroup ImageSamplers
+ */
+
+template< class TImage >
+class ImageImplicitSampleContainer : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageImplicitSampleContainer Self;
+  typedef Object                       Superclass;
+  typedef SmartPointer< Self >         Pointer;
+  typedef SmartPointer< const Self >   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageImplicitSampleContainer, Object );
+
+  /** Typedef's. */
+  typedef TImage                              ImageType;
+  typedef typename ImageType::ConstPointer    ImageConstPointer;
+  typedef typename ImageType::IndexType       IndexType;
+  typedef typename IndexType::IndexValueType  IndexValueType;
+  typedef ImageSample< ImageType >            ImageSampleType;
+  typedef typename ImageSampleType::PointType PointType;
+  typedef typename ImageSampleType::RealType  ValueType;
+
+  /** A run of samples: the index of the first sample, the number of samples,
+   * and the number of samples of the preceding runs.
+   */
+  struct RunType
+  {
+    IndexType     m_Index;
+    SizeValueType m_Length;
+    SizeValueType m_Offset;
+  };
+  typedef std::vector< RunType > RunContainerType;
+
+  /** Remove all samples, and set the image and the distance between the
+   * samples of a run along the first dimension.
+   */
+  void Initialize( const ImageType * image, const IndexValueType step )
+  {
+    this->m_Image = image;
+    this->m_Step  = step;
+    this->m_Size  = 0;
+    this->m_Runs.clear();
+    this->Modified();
+  }
+
+
+  /** Get the distance between the samples of a run. */
+  IndexValueType GetStep( void ) const { return this->m_Step; }
+
+  /** Get the number of samples. */
+  SizeValueType Size( void ) const { return this->m_Size; }
+
+  /** Get the runs. */
+  const RunContainerType & GetRuns( void ) const { return this->m_Runs; }
+
+  /** Add the sample at the index to the runs, extending the last run when
+   * the index follows it. The offsets are those within the given runs.
+   */
+  static void AddIndexToRuns( const IndexType & index, const IndexValueType step,
+    RunContainerType & runs )
+  {
+    if( !runs.empty() )
+    {
+      RunType & last = runs.back();
+      IndexType next = last.m_Index;
+      next[ 0 ] += static_cast< IndexValueType >( last.m_Length ) * step;
+      if( next == index )
+      {
+        ++last.m_Length;
+        return;
+      }
+    }
+    RunType run;
+    run.m_Index  = index;
+    run.m_Length = 1;
+    run.m_Offset = runs.empty() ? 0 : runs.back().m_Offset + runs.back().m_Length;
+    runs.push_back( run );
+  }
+
+
+  /** Add the sample at the index. */
+  void AddIndex( const IndexType & index )
+  {
+    AddIndexToRuns( index, this->m_Step, this->m_Runs );
+    ++this->m_Size;
+  }
+
+
+  /** Append the runs, for example of a work unit, after the current ones. */
+  void AddRuns( const RunContainerType & runs )
+  {
+    for( typename RunContainerType::const_iterator it = runs.begin(); it != runs.end(); ++it )
+    {
+      RunType run = *it;
+      run.m_Offset = this->m_Size;
+      this->m_Runs.push_back( run );
+      this->m_Size += run.m_Length;
+    }
+  }
+
+
+  /** Get n consecutive samples, starting at sample begin. The run of the
+   * first sample is searched once, the others are found by stepping.
+   */
+  template< class TValue >
+  void GetSamples( const SizeValueType begin, const SizeValueType n,
+    PointType * points, TValue * values ) const
+  {
+    if( n == 0 )
+    {
+      return;
+    }
+
+    /** The last run that starts at or before the first sample. */
+    RunType key;
+    key.m_Offset = begin;
+    typename RunContainerType::const_iterator run = std::upper_bound(
+      this->m_Runs.begin(), this->m_Runs.end(), key, CompareOffsets ) - 1;
+
+    SizeValueType positionInRun = begin - run->m_Offset;
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      if( positionInRun == run->m_Length )
+      {
+        ++run;
+        positionInRun = 0;
+      }
+      IndexType index = run->m_Index;
+      index[ 0 ] += static_cast< IndexValueType >( positionInRun ) * this->m_Step;
+      this->m_Image->TransformIndexToPhysicalPoint( index, points[ i ] );
+      values[ i ] = static_cast< TValue >( this->m_Image->GetPixel( index ) );
+      ++positionInRun;
+    }
+  }
+
+
+  /** Get sample i. */
+  void GetSample( const SizeValueType i, ImageSampleType & sample ) const
+  {
+    this->GetSamples( i, 1, &sample.m_ImageCoordinates, &sample.m_ImageValue );
+  }
+
+
+protected:
+
+  ImageImplicitSampleContainer() : m_Step( 1 ), m_Size( 0 ) {}
+
+  ~ImageImplicitSampleContainer() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override
+  {
+    Superclass::PrintSelf( os, indent );
+    os << indent << "Size: " << this->m_Size << std::endl;
+    os << indent << "NumberOfRuns: " << this->m_Runs.size() << std::endl;
+    os << indent << "Step: " << this->m_Step << std::endl;
+  }
+
+
+private:
+
+  ImageImplicitSampleContainer( const Self & ); // purposely not implemented
+  void operator=( const Self & );               // purposely not implemented
+
+  static bool CompareOffsets( const RunType & a, const RunType & b )
+  {
+    return a.m_Offset < b.m_Offset;
+  }
+
+
+  ImageConstPointer m_Image;
+  IndexValueType    m_Step;
+  SizeValueType     m_Size;
+  RunContainerType  m_Runs;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __ImageImplicitSampleContainer_h
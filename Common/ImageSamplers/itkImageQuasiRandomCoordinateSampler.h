@@ -0,0 +1,144 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageQuasiRandomCoordinateSampler_h
+#define __ImageQuasiRandomCoordinateSampler_h
+
+#include "itkImageRandomCoordinateSampler.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class ImageQuasiRandomCoordinateSampler
+ *
+ * \brief Samples an image at stratified or low-discrepancy physical coordinates.
+ *
+ * This sampler differs from the ImageRandomCoordinateSampler in the way the
+ * coordinates are generated. Instead of independent uniform coordinates, it
+ * uses one of the following sequences, which cover the image more evenly and
+ * therefore give lower-variance estimates of the metric and its derivative:
+ * \li Halton: the Halton sequence, with bases 2, 3, 5, ..., randomized by a
+ *   random shift modulo one (a Cranley-Patterson rotation).
+ * \li JitteredGrid: the image is divided into a grid of at least
+ *   NumberOfSamples cells. The cells are visited in random order, and one
+ *   uniformly distributed coordinate is drawn within each cell.
+ *
+ * Both sequences are randomized anew at each update, so new samples can be
+ * selected every iteration. Coordinates outside the mask are skipped, and the
+ * sequence continues with the next coordinate. UseRandomSampleRegion is not
+ * supported.
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TInputImage >
+class ImageQuasiRandomCoordinateSampler :
+  public ImageRandomCoordinateSampler< TInputImage >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageQuasiRandomCoordinateSampler           Self;
+  typedef ImageRandomCoordinateSampler< TInputImage > Superclass;
+  typedef SmartPointer< Self >                        Pointer;
+  typedef SmartPointer< const Self >                  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageQuasiRandomCoordinateSampler, ImageRandomCoordinateSampler );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass::InputImageType           InputImageType;
+  typedef typename Superclass::InputImageRegionType     InputImageRegionType;
+  typedef typename Superclass::ImageSampleContainerType ImageSampleContainerType;
+  typedef typename Superclass::MaskType                 MaskType;
+  typedef typename Superclass::InputImagePointValueType InputImagePointValueType;
+
+  /** The input image dimension. */
+  itkStaticConstMacro( InputImageDimension, unsigned int,
+    Superclass::InputImageDimension );
+
+  /** The supported sequences. */
+  enum SequenceType {
+    Halton,
+    JitteredGrid
+  };
+
+  /** Set/Get the sequence used to generate the coordinates. Default: Halton. */
+  itkSetMacro( Sequence, SequenceType );
+  itkGetConstMacro( Sequence, SequenceType );
+
+protected:
+
+  typedef typename Superclass::InputImageContinuousIndexType InputImageContinuousIndexType;
+
+  /** The constructor. */
+  ImageQuasiRandomCoordinateSampler();
+  /** The destructor. */
+  ~ImageQuasiRandomCoordinateSampler() override {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Randomize the sequence and generate the samples. */
+  void GenerateData( void ) override;
+
+  /** Generate the next coordinate of the sequence in a bounding box. */
+  void GenerateRandomCoordinate(
+    const InputImageContinuousIndexType & smallestContIndex,
+    const InputImageContinuousIndexType & largestContIndex,
+    InputImageContinuousIndexType &       randomContIndex ) override;
+
+  /** Start a new randomized sequence. */
+  virtual void ResetSequence( void );
+
+  /** Shuffle the order in which the cells of the jittered grid are visited. */
+  virtual void ShuffleCells( void );
+
+  /** Return the radical inverse of an index in a base. */
+  static double RadicalInverse( unsigned long index, const unsigned int base );
+
+private:
+
+  /** The private constructor. */
+  ImageQuasiRandomCoordinateSampler( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );                    // purposely not implemented
+
+  SequenceType  m_Sequence;
+  unsigned long m_SequenceIndex;
+
+  /** The random shift of the Halton sequence. */
+  double m_Shift[ InputImageDimension ];
+
+  /** The number of jittered grid cells per dimension and their visiting order. */
+  unsigned long                m_NumberOfCellsPerDimension;
+  std::vector< unsigned long > m_CellOrder;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageQuasiRandomCoordinateSampler.hxx"
+#endif
+
+#endif // end #ifndef __ImageQuasiRandomCoordinateSampler_h
@@ -0,0 +1,222 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageQuasiRandomCoordinateSampler_hxx
+#define __ImageQuasiRandomCoordinateSampler_hxx
+
+#include "itkImageQuasiRandomCoordinateSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor ********************
+ */
+
+template< class TInputImage >
+ImageQuasiRandomCoordinateSampler< TInputImage >
+::ImageQuasiRandomCoordinateSampler()
+{
+  this->m_Sequence                  = Halton;
+  this->m_SequenceIndex             = 0;
+  this->m_NumberOfCellsPerDimension = 1;
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    this->m_Shift[ i ] = 0.0;
+  }
+
+} // end Constructor
+
+
+/**
+ * ******************* GenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageQuasiRandomCoordinateSampler< TInputImage >
+::GenerateData( void )
+{
+  if( this->GetUseRandomSampleRegion() )
+  {
+    itkExceptionMacro( << "ERROR: UseRandomSampleRegion is not supported by this sampler." );
+  }
+
+  this->ResetSequence();
+  Superclass::GenerateData();
+
+} // end GenerateData()
+
+
+/**
+ * ******************* ResetSequence *******************
+ */
+
+template< class TInputImage >
+void
+ImageQuasiRandomCoordinateSampler< TInputImage >
+::ResetSequence( void )
+{
+  this->m_SequenceIndex = 0;
+
+  if( this->m_Sequence == Halton )
+  {
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      this->m_Shift[ i ] = this->m_RandomGenerator->GetUniformVariate( 0.0, 1.0 );
+    }
+  }
+  else
+  {
+    /** Use the smallest grid with at least NumberOfSamples cells. */
+    this->m_NumberOfCellsPerDimension = static_cast< unsigned long >( std::ceil(
+      std::pow( static_cast< double >( this->GetNumberOfSamples() ), 1.0 / InputImageDimension ) - 1e-9 ) );
+    this->m_NumberOfCellsPerDimension = std::max( this->m_NumberOfCellsPerDimension, 1ul );
+
+    unsigned long numberOfCells = 1;
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      numberOfCells *= this->m_NumberOfCellsPerDimension;
+    }
+    this->m_CellOrder.resize( numberOfCells );
+    std::iota( this->m_CellOrder.begin(), this->m_CellOrder.end(), 0ul );
+    this->ShuffleCells();
+  }
+
+} // end ResetSequence()
+
+
+/**
+ * ******************* ShuffleCells *******************
+ */
+
+template< class TInputImage >
+void
+ImageQuasiRandomCoordinateSampler< TInputImage >
+::ShuffleCells( void )
+{
+  /** Fisher-Yates shuffle. */
+  for( unsigned long i = this->m_CellOrder.size() - 1; i > 0; --i )
+  {
+    const unsigned long j = this->m_RandomGenerator->GetIntegerVariate( i );
+    std::swap( this->m_CellOrder[ i ], this->m_CellOrder[ j ] );
+  }
+
+} // end ShuffleCells()
+
+
+/**
+ * ******************* GenerateRandomCoordinate *******************
+ */
+
+template< class TInputImage >
+void
+ImageQuasiRandomCoordinateSampler< TInputImage >
+::GenerateRandomCoordinate(
+  const InputImageContinuousIndexType & smallestContIndex,
+  const InputImageContinuousIndexType & largestContIndex,
+  InputImageContinuousIndexType &       randomContIndex )
+{
+  /** The first primes, the bases of the Halton sequence. */
+  static const unsigned int primes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+  static_assert( InputImageDimension <= sizeof( primes ) / sizeof( primes[ 0 ] ),
+    "Too many dimensions for the Halton sequence." );
+
+  double u[ InputImageDimension ];
+  if( this->m_Sequence == Halton )
+  {
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      u[ i ] = RadicalInverse( this->m_SequenceIndex + 1, primes[ i ] ) + this->m_Shift[ i ];
+      u[ i ] = u[ i ] - std::floor( u[ i ] );
+    }
+  }
+  else
+  {
+    /** Visit the cells in a new random order, after all were visited. */
+    const unsigned long numberOfCells = this->m_CellOrder.size();
+    if( this->m_SequenceIndex > 0 && this->m_SequenceIndex % numberOfCells == 0 )
+    {
+      this->ShuffleCells();
+    }
+
+    unsigned long cell = this->m_CellOrder[ this->m_SequenceIndex % numberOfCells ];
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      const unsigned long cellIndex = cell % this->m_NumberOfCellsPerDimension;
+      cell /= this->m_NumberOfCellsPerDimension;
+      u[ i ] = ( cellIndex + this->m_RandomGenerator->GetUniformVariate( 0.0, 1.0 ) )
+        / static_cast< double >( this->m_NumberOfCellsPerDimension );
+    }
+  }
+  ++this->m_SequenceIndex;
+
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    randomContIndex[ i ] = static_cast< InputImagePointValueType >(
+      smallestContIndex[ i ] + u[ i ] * ( largestContIndex[ i ] - smallestContIndex[ i ] ) );
+  }
+
+} // end GenerateRandomCoordinate()
+
+
+/**
+ * ******************* RadicalInverse *******************
+ */
+
+template< class TInputImage >
+double
+ImageQuasiRandomCoordinateSampler< TInputImage >
+::RadicalInverse( unsigned long index, const unsigned int base )
+{
+  const double inverseBase = 1.0 / base;
+  double       factor      = inverseBase;
+  double       result      = 0.0;
+  while( index > 0 )
+  {
+    result += factor * ( index % base );
+    index  /= base;
+    factor *= inverseBase;
+  }
+  return result;
+
+} // end RadicalInverse()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TInputImage >
+void
+ImageQuasiRandomCoordinateSampler< TInputImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Sequence: " << ( this->m_Sequence == Halton ? "Halton" : "JitteredGrid" ) << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __ImageQuasiRandomCoordinateSampler_hxx
@@ -33,6 +33,12 @@ namespace itk
  * This image sampler generates not only samples that correspond with
  * pixel locations, but selects points in physical space.
  *
+ * When the SampleRefreshFraction is smaller than one, each update replaces
+ * only that fraction of the samples of the previous update by new random
+ * samples. The other samples are reused, including their image values, which
+ * saves most of the interpolations and mask tests. The replaced samples are
+ * chosen randomly, so every sample is eventually replaced.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -105,6 +111,14 @@ public:
   itkGetConstMacro( UseRandomSampleRegion, bool );
   itkSetMacro( UseRandomSampleRegion, bool );
 
+  /** Set/Get the fraction of the samples that is replaced at each update.
+   * Samples are only reused when the input image, mask, interpolator and
+   * number of samples are unchanged, and never when UseRandomSampleRegion
+   * is true. Default: 1.0, which selects all samples anew.
+   */
+  itkSetClampMacro( SampleRefreshFraction, double, 0.0, 1.0 );
+  itkGetConstMacro( SampleRefreshFraction, double );
+
 protected:
 
   typedef typename InterpolatorType::ContinuousIndexType InputImageContinuousIndexType;
@@ -133,10 +147,23 @@ protected:
     const InputImageContinuousIndexType & largestContIndex,
     InputImageContinuousIndexType &       randomContIndex );
 
+  /** Whether the samples of the previous update can be partially reused. */
+  virtual bool CanReuseSamples( void ) const;
+
+  /** Replace a fraction of the samples of the previous update. */
+  virtual void GenerateDataWithSampleReuse( void );
+
+  /** Store the output, to be partially reused by the next update. */
+  virtual void StoreSamplesForReuse( void );
+
   InterpolatorPointer    m_Interpolator;
   RandomGeneratorPointer m_RandomGenerator;
   InputImageSpacingType  m_SampleRegionSize;
 
+  /** The corners of the sampling region of the counter-based random numbers. */
+  InputImageContinuousIndexType m_SmallestContIndex;
+  InputImageContinuousIndexType m_LargestContIndex;
+
   /** Generate the two corners of a sampling region, given the two corners
   * of an image. If UseRandomSampleRegion=false, the smallesPoint and largestPoint
   * are just copies of the smallestImagePoint and largestImagePoint
@@ -155,7 +182,17 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );                 // purposely not implemented
 
-  bool m_UseRandomSampleRegion;
+  bool   m_UseRandomSampleRegion;
+  double m_SampleRefreshFraction;
+
+  /** The samples of the previous update and the settings they depend on. */
+  std::vector< ImageSampleType > m_ReusableSamples;
+  std::vector< unsigned long >   m_ReusableSampleOrder;
+  const InputImageType *         m_ReusableSamplesInput;
+  ModifiedTimeType               m_ReusableSamplesInputMTime;
+  const MaskType *               m_ReusableSamplesMask;
+  const InterpolatorType *       m_ReusableSamplesInterpolator;
+  InputImageRegionType           m_ReusableSamplesRegion;
 
 };
 
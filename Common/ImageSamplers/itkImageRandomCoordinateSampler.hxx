@@ -21,6 +21,10 @@
 #include "itkImageRandomCoordinateSampler.h"
 #include "vnl/vnl_math.h"
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
 namespace itk
 {
 
@@ -44,6 +48,12 @@ ImageRandomCoordinateSampler< TInputImage >
   this->m_UseRandomSampleRegion = false;
   this->m_SampleRegionSize.Fill( 1.0 );
 
+  this->m_SampleRefreshFraction       = 1.0;
+  this->m_ReusableSamplesInput        = nullptr;
+  this->m_ReusableSamplesInputMTime   = 0;
+  this->m_ReusableSamplesMask         = nullptr;
+  this->m_ReusableSamplesInterpolator = nullptr;
+
 } // end Constructor
 
 
@@ -56,12 +66,22 @@ void
 ImageRandomCoordinateSampler< TInputImage >
 ::GenerateData( void )
 {
+  /** Only replace a fraction of the previous samples, if possible. */
+  if( this->CanReuseSamples() )
+  {
+    this->GenerateDataWithSampleReuse();
+    return;
+  }
+  this->m_ReusableSamples.clear();
+
   /** Get a handle to the mask. If there was no mask supplied we exercise a multi-threaded version. */
   typename MaskType::ConstPointer mask = this->GetMask();
-  if( mask.IsNull() && this->m_UseMultiThread )
+  if( mask.IsNull() && ( this->m_UseMultiThread || this->m_UseCounterBasedRandomGenerator ) )
   {
     /** Calls ThreadedGenerateData(). */
-    return Superclass::GenerateData();
+    Superclass::GenerateData();
+    this->StoreSamplesForReuse();
+    return;
   }
 
   /** Get handles to the input image, output sample container, and interpolator. */
@@ -157,7 +177,7 @@ ImageRandomCoordinateSampler< TInputImage >
 
       }
       while( !interpolator->IsInsideBuffer( sampleContIndex )
-        || !mask->IsInsideInWorldSpace( samplePoint ) );
+        || !this->GetMaskBitmap()->IsInsideInWorldSpace( samplePoint ) );
 
       /** Compute the value at the point. */
       sampleValue = static_cast< ImageSampleValueType >(
@@ -166,9 +186,156 @@ ImageRandomCoordinateSampler< TInputImage >
     } // end for loop
   } // end if mask
 
+  this->StoreSamplesForReuse();
+
 } // end GenerateData()
 
 
+/**
+ * ******************* CanReuseSamples *******************
+ */
+
+template< class TInputImage >
+bool
+ImageRandomCoordinateSampler< TInputImage >
+::CanReuseSamples( void ) const
+{
+  const InputImageType * inputImage = this->GetInput();
+  return this->m_SampleRefreshFraction < 1.0
+         && !this->m_UseRandomSampleRegion
+         && !this->m_ReusableSamples.empty()
+         && this->m_ReusableSamples.size() == this->GetNumberOfSamples()
+         && this->m_ReusableSamplesInput == inputImage
+         && this->m_ReusableSamplesInputMTime == inputImage->GetMTime()
+         && this->m_ReusableSamplesMask == this->GetMask()
+         && this->m_ReusableSamplesInterpolator == this->m_Interpolator.GetPointer()
+         && this->m_ReusableSamplesRegion == this->GetCroppedInputImageRegion();
+
+} // end CanReuseSamples()
+
+
+/**
+ * ******************* GenerateDataWithSampleReuse *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomCoordinateSampler< TInputImage >
+::GenerateDataWithSampleReuse( void )
+{
+  /** Get handles to the input image, mask, and interpolator. */
+  InputImageConstPointer             inputImage   = this->GetInput();
+  typename MaskType::ConstPointer    mask         = this->GetMask();
+  typename InterpolatorType::Pointer interpolator = this->GetModifiableInterpolator();
+
+  /** The interpolator still has the input image, unless someone replaced it. */
+  if( interpolator->GetInputImage() != inputImage.GetPointer() )
+  {
+    interpolator->SetInputImage( inputImage );
+  }
+  if( mask.IsNotNull() && mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+
+  /** Convert inputImageRegion to bounding box in physical space. */
+  InputImageSizeType unitSize;
+  unitSize.Fill( 1 );
+  InputImageIndexType smallestIndex
+    = this->GetCroppedInputImageRegion().GetIndex();
+  InputImageIndexType largestIndex
+    = smallestIndex + this->GetCroppedInputImageRegion().GetSize() - unitSize;
+  InputImageContinuousIndexType smallestContIndex( smallestIndex );
+  InputImageContinuousIndexType largestContIndex( largestIndex );
+
+  /** Determine the number of samples to replace, at least one. */
+  const unsigned long numberOfSamples    = this->m_ReusableSamples.size();
+  const unsigned long numberOfNewSamples = std::min( numberOfSamples, std::max( 1ul,
+    static_cast< unsigned long >( std::ceil( this->m_SampleRefreshFraction * numberOfSamples ) ) ) );
+
+  unsigned long numberOfSamplesTried        = 0;
+  unsigned long maximumNumberOfSamplesToTry = 10 * numberOfNewSamples;
+
+  /** Select the samples to replace by a partial Fisher-Yates shuffle, and
+   * replace each of them by a new valid sample.
+   */
+  InputImageContinuousIndexType sampleContIndex;
+  for( unsigned long i = 0; i < numberOfNewSamples; ++i )
+  {
+    const unsigned long j = i + static_cast< unsigned long >(
+      this->m_RandomGenerator->GetIntegerVariate( numberOfSamples - i - 1 ) );
+    std::swap( this->m_ReusableSampleOrder[ i ], this->m_ReusableSampleOrder[ j ] );
+
+    ImageSampleType &      sample      = this->m_ReusableSamples[ this->m_ReusableSampleOrder[ i ] ];
+    InputImagePointType &  samplePoint = sample.m_ImageCoordinates;
+    ImageSampleValueType & sampleValue = sample.m_ImageValue;
+
+    /** Walk over the image until we find a valid point. */
+    bool valid = false;
+    do
+    {
+      /** Check if we are not trying eternally to find a valid point. */
+      ++numberOfSamplesTried;
+      if( numberOfSamplesTried > maximumNumberOfSamplesToTry )
+      {
+        this->m_ReusableSamples.clear();
+        itkExceptionMacro( << "Could not find enough image samples within "
+                           << "reasonable time. Probably the mask is too small" );
+      }
+
+      /** Generate a point in the input image region. */
+      this->GenerateRandomCoordinate( smallestContIndex, largestContIndex, sampleContIndex );
+      inputImage->TransformContinuousIndexToPhysicalPoint( sampleContIndex, samplePoint );
+
+      valid = mask.IsNull() || ( interpolator->IsInsideBuffer( sampleContIndex )
+        && this->GetMaskBitmap()->IsInsideInWorldSpace( samplePoint ) );
+    }
+    while( !valid );
+
+    /** Compute the value at the point. */
+    sampleValue = static_cast< ImageSampleValueType >(
+      interpolator->EvaluateAtContinuousIndex( sampleContIndex ) );
+  }
+
+  /** Copy the samples to the output. */
+  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
+  sampleContainer->clear();
+  sampleContainer->insert( sampleContainer->end(),
+    this->m_ReusableSamples.begin(), this->m_ReusableSamples.end() );
+
+} // end GenerateDataWithSampleReuse()
+
+
+/**
+ * ******************* StoreSamplesForReuse *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomCoordinateSampler< TInputImage >
+::StoreSamplesForReuse( void )
+{
+  this->m_ReusableSamples.clear();
+  if( this->m_SampleRefreshFraction >= 1.0 || this->m_UseRandomSampleRegion )
+  {
+    return;
+  }
+
+  const ImageSampleContainerType * sampleContainer = this->GetOutput();
+  this->m_ReusableSamples.assign( sampleContainer->begin(), sampleContainer->end() );
+  this->m_ReusableSampleOrder.resize( this->m_ReusableSamples.size() );
+  std::iota( this->m_ReusableSampleOrder.begin(), this->m_ReusableSampleOrder.end(), 0ul );
+
+  const InputImageType * inputImage   = this->GetInput();
+  this->m_ReusableSamplesInput        = inputImage;
+  this->m_ReusableSamplesInputMTime   = inputImage->GetMTime();
+  this->m_ReusableSamplesMask         = this->GetMask();
+  this->m_ReusableSamplesInterpolator = this->m_Interpolator.GetPointer();
+  this->m_ReusableSamplesRegion       = this->GetCroppedInputImageRegion();
+
+} // end StoreSamplesForReuse()
+
+
 /**
  * ******************* BeforeThreadedGenerateData *******************
  */
@@ -184,7 +351,6 @@ ImageRandomCoordinateSampler< TInputImage >
 
   /** Clear the random number list. */
   this->m_RandomNumberList.resize( 0 );
-  this->m_RandomNumberList.reserve( this->m_NumberOfSamples * InputImageDimension );
 
   /** Convert inputImageRegion to bounding box in physical space. */
   InputImageSizeType  unitSize; unitSize.Fill( 1 );
@@ -198,23 +364,30 @@ ImageRandomCoordinateSampler< TInputImage >
   this->GenerateSampleRegion( smallestImageCIndex, largestImageCIndex,
     smallestCIndex, largestCIndex );
 
-  /** Fill the list with random numbers. */
-  for( unsigned long i = 0; i < this->m_NumberOfSamples; i++ )
+  /** Fill the list with random numbers, unless the threads draw their own
+   * counter-based random numbers.
+   */
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    this->DrawCounterBasedRandomKey();
+    this->m_SmallestContIndex = smallestCIndex;
+    this->m_LargestContIndex  = largestCIndex;
+  }
+  else
   {
-    this->GenerateRandomCoordinate( smallestCIndex, largestCIndex, randomCIndex );
-    for( unsigned int j = 0; j < InputImageDimension; ++j )
+    this->m_RandomNumberList.reserve( this->m_NumberOfSamples * InputImageDimension );
+    for( unsigned long i = 0; i < this->m_NumberOfSamples; i++ )
     {
-      this->m_RandomNumberList.push_back( randomCIndex[ j ] );
+      this->GenerateRandomCoordinate( smallestCIndex, largestCIndex, randomCIndex );
+      for( unsigned int j = 0; j < InputImageDimension; ++j )
+      {
+        this->m_RandomNumberList.push_back( randomCIndex[ j ] );
+      }
     }
   }
 
-  /** Initialize variables needed for threads. */
-  this->m_ThreaderSampleContainer.clear();
-  this->m_ThreaderSampleContainer.resize( this->GetNumberOfWorkUnits() );
-  for( std::size_t i = 0; i < this->GetNumberOfWorkUnits(); i++ )
-  {
-    this->m_ThreaderSampleContainer[ i ] = ImageSampleContainerType::New();
-  }
+  /** Each work unit writes its samples directly into its slice. */
+  this->AllocateThreaderOutput( this->GetNumberOfSamples() );
 
 } // end BeforeThreadedGenerateData()
 
@@ -247,29 +420,30 @@ ImageRandomCoordinateSampler< TInputImage >
       - ( ( this->GetNumberOfWorkUnits() - 1 ) * chunkSize );
   }
 
-  /** Get a reference to the output and reserve memory for it. */
-  ImageSampleContainerPointer & sampleContainerThisThread // & ???
-    = this->m_ThreaderSampleContainer[ threadId ];
-  sampleContainerThisThread->Reserve( chunkSize );
-
-  /** Setup an iterator over the sampleContainerThisThread. */
-  typename ImageSampleContainerType::Iterator iter;
-  typename ImageSampleContainerType::ConstIterator end = sampleContainerThisThread->End();
-
-  /** Fill the local sample container. */
+  /** Fill the slice of this thread in the allocated output. */
+  ImageSampleContainerType &    threaderOutput = *this->m_ThreaderOutput;
+  const unsigned long           outputStart    = sampleStart / InputImageDimension;
   InputImageContinuousIndexType sampleCIndex;
   unsigned long                 sampleId = sampleStart;
-  for( iter = sampleContainerThisThread->Begin(); iter != end; ++iter )
+  for( unsigned long i = outputStart; i < outputStart + chunkSize; ++i )
   {
     /** Create a random point out of InputImageDimension random numbers. */
     for( unsigned int j = 0; j < InputImageDimension; ++j, sampleId++ )
     {
-      sampleCIndex[ j ] = this->m_RandomNumberList[ sampleId ];
+      if( this->m_UseCounterBasedRandomGenerator )
+      {
+        sampleCIndex[ j ] = this->m_SmallestContIndex[ j ] + this->GetCounterBasedUniformVariate( sampleId )
+          * ( this->m_LargestContIndex[ j ] - this->m_SmallestContIndex[ j ] );
+      }
+      else
+      {
+        sampleCIndex[ j ] = this->m_RandomNumberList[ sampleId ];
+      }
     }
 
     /** Make a reference to the current sample in the container. */
-    InputImagePointType &  samplePoint = ( *iter ).Value().m_ImageCoordinates;
-    ImageSampleValueType & sampleValue = ( *iter ).Value().m_ImageValue;
+    InputImagePointType &  samplePoint = threaderOutput[ i ].m_ImageCoordinates;
+    ImageSampleValueType & sampleValue = threaderOutput[ i ].m_ImageValue;
 
     /** Convert to point */
     inputImage->TransformContinuousIndexToPhysicalPoint( sampleCIndex, samplePoint );
@@ -361,6 +535,7 @@ ImageRandomCoordinateSampler< TInputImage >
 
   os << indent << "Interpolator: " << this->m_Interpolator.GetPointer() << std::endl;
   os << indent << "RandomGenerator: " << this->m_RandomGenerator.GetPointer() << std::endl;
+  os << indent << "SampleRefreshFraction: " << this->m_SampleRefreshFraction << std::endl;
 
 } // end PrintSelf()
 
@@ -87,6 +87,11 @@ protected:
   /** Functions that do the work. */
   void GenerateData( void ) override;
 
+  /** Draws the random numbers, and lets the work units write directly into
+   * the output.
+   */
+  void BeforeThreadedGenerateData( void ) override;
+
   void ThreadedGenerateData(
     const InputImageRegionType & inputRegionForThread,
     ThreadIdType threadId ) override;
@@ -37,7 +37,7 @@ ImageRandomSampler< TInputImage >
 {
   /** Get a handle to the mask. If there was no mask supplied we exercise a multi-threaded version. */
   typename MaskType::ConstPointer mask = this->GetMask();
-  if( mask.IsNull() && this->m_UseMultiThread )
+  if( mask.IsNull() && ( this->m_UseMultiThread || this->m_UseCounterBasedRandomGenerator ) )
   {
     /** Calls ThreadedGenerateData(). */
     return Superclass::GenerateData();
@@ -114,7 +114,7 @@ ImageRandomSampler< TInputImage >
         InputImageIndexType index = randIter.GetIndex();
         inputImage->TransformIndexToPhysicalPoint( index, inputPoint );
         /** Check if it's inside the mask. */
-        insideMask = mask->IsInsideInWorldSpace( inputPoint );
+        insideMask = this->GetMaskBitmap()->IsInsideInWorldSpace( inputPoint );
       }
       while( !insideMask );
 
@@ -133,6 +133,24 @@ ImageRandomSampler< TInputImage >
 } // end GenerateData()
 
 
+/**
+ * ******************* BeforeThreadedGenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSampler< TInputImage >
+::BeforeThreadedGenerateData( void )
+{
+  /** Draw the random numbers. */
+  Superclass::BeforeThreadedGenerateData();
+
+  /** Each work unit writes its samples directly into its slice. */
+  this->AllocateThreaderOutput( this->GetNumberOfSamples() );
+
+} // end BeforeThreadedGenerateData()
+
+
 /**
  * ******************* ThreadedGenerateData *******************
  */
@@ -161,22 +179,19 @@ ImageRandomSampler< TInputImage >
       - ( ( this->GetNumberOfWorkUnits() - 1 ) * chunkSize );
   }
 
-  /** Get a reference to the output and reserve memory for it. */
-  ImageSampleContainerPointer & sampleContainerThisThread
-    = this->m_ThreaderSampleContainer[ threadId ];
-  sampleContainerThisThread->Reserve( chunkSize );
-
-  /** Setup an iterator over the sampleContainerThisThread. */
-  typename ImageSampleContainerType::Iterator iter;
-  typename ImageSampleContainerType::ConstIterator end = sampleContainerThisThread->End();
-
-  /** Fill the local sample container. */
-  unsigned long       sampleId    = sampleStart;
-  InputImageSizeType  regionSize  = this->GetCroppedInputImageRegion().GetSize();
-  InputImageIndexType regionIndex = this->GetCroppedInputImageRegion().GetIndex();
-  for( iter = sampleContainerThisThread->Begin(); iter != end; ++iter, sampleId++ )
+  /** Fill the slice of this thread in the allocated output. */
+  ImageSampleContainerType & threaderOutput = *this->m_ThreaderOutput;
+  const unsigned long        sampleEnd      = sampleStart + chunkSize;
+  InputImageSizeType         regionSize     = this->GetCroppedInputImageRegion().GetSize();
+  InputImageIndexType        regionIndex    = this->GetCroppedInputImageRegion().GetIndex();
+  const double               numPixels      = static_cast< double >( this->GetCroppedInputImageRegion().GetNumberOfPixels() );
+  for( unsigned long sampleId = sampleStart; sampleId < sampleEnd; sampleId++ )
   {
-    unsigned long randomPosition = static_cast< unsigned long >( this->m_RandomNumberList[ sampleId ] );
+    ImageSampleType & sample = threaderOutput[ sampleId ];
+
+    unsigned long randomPosition = this->m_UseCounterBasedRandomGenerator
+      ? static_cast< unsigned long >( this->GetCounterBasedUniformVariate( sampleId ) * numPixels )
+      : static_cast< unsigned long >( this->m_RandomNumberList[ sampleId ] );
 
     /** Translate randomPosition to an index, copied from ImageRandomConstIteratorWithIndex. */
     unsigned long       residual;
@@ -192,10 +207,10 @@ ImageRandomSampler< TInputImage >
 
     /** Transform index to the physical coordinates and put it in the sample. */
     inputImage->TransformIndexToPhysicalPoint( positionIndex,
-      ( *iter ).Value().m_ImageCoordinates );
+      sample.m_ImageCoordinates );
 
     /** Get the value and put it in the sample. */
-    ( *iter ).Value().m_ImageValue = static_cast< ImageSampleValueType >( inputImage->GetPixel( positionIndex ) );
+    sample.m_ImageValue = static_cast< ImageSampleValueType >( inputImage->GetPixel( positionIndex ) );
 
   } // end for loop
 
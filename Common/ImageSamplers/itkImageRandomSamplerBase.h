@@ -19,6 +19,7 @@
 #define __ImageRandomSamplerBase_h
 
 #include "itkImageSamplerBase.h"
+#include "itkPhiloxRandomGenerator.h"
 
 namespace itk
 {
@@ -29,6 +30,15 @@ namespace itk
  *
  * It adds the Set/GetNumberOfSamples function.
  *
+ * With UseCounterBasedRandomGenerator the random numbers of each update are
+ * drawn by the PhiloxRandomGenerator from the index of the sample, with a
+ * key that is drawn once per update from the Mersenne Twister. Each thread
+ * then draws the numbers of its own samples, and the samples do not depend
+ * on the number of threads. When no mask prevents it, the samples are then
+ * always generated multi-threaded. This is supported by the
+ * ImageRandomSampler, the ImageRandomCoordinateSampler and the
+ * ImageRandomSamplerSparseMask.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -68,6 +78,12 @@ public:
   itkStaticConstMacro( InputImageDimension, unsigned int,
     Superclass::InputImageDimension );
 
+  /** Set/Get whether the random numbers are drawn by the counter-based
+   * PhiloxRandomGenerator. Default: false.
+   */
+  itkSetMacro( UseCounterBasedRandomGenerator, bool );
+  itkGetConstMacro( UseCounterBasedRandomGenerator, bool );
+
 protected:
 
   /** The constructor. */
@@ -82,9 +98,24 @@ protected:
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const override;
 
+  /** Draw the key of the counter-based random numbers of this update. */
+  void DrawCounterBasedRandomKey( void );
+
+  /** Return the counter-based random number with the given index, uniform
+   * in [0, 1).
+   */
+  double GetCounterBasedUniformVariate( const SizeValueType index ) const
+  {
+    return PhiloxRandomGenerator::GetUniformVariate( this->m_CounterBasedRandomKey, 0, index );
+  }
+
+
   /** Member variable used when threading. */
   std::vector< double > m_RandomNumberList;
 
+  bool                           m_UseCounterBasedRandomGenerator;
+  PhiloxRandomGenerator::KeyType m_CounterBasedRandomKey;
+
 private:
 
   /** The private constructor. */
@@ -34,7 +34,9 @@ template< class TInputImage >
 ImageRandomSamplerBase< TInputImage >
 ::ImageRandomSamplerBase()
 {
-  this->m_NumberOfSamples = 1000;
+  this->m_NumberOfSamples                = 1000;
+  this->m_UseCounterBasedRandomGenerator = false;
+  this->m_CounterBasedRandomKey          = 0;
 
 } // end Constructor
 
@@ -55,18 +57,27 @@ ImageRandomSamplerBase< TInputImage >
 
   /** Clear the random number list. */
   this->m_RandomNumberList.resize( 0 );
-  this->m_RandomNumberList.reserve( this->m_NumberOfSamples );
 
-  /** Fill the list with random numbers. */
-  const double numPixels = static_cast< double >( this->GetCroppedInputImageRegion().GetNumberOfPixels() );
-  localGenerator->GetVariateWithOpenRange( numPixels - 0.5 ); // dummy jump
-  for( unsigned long i = 0; i < this->m_NumberOfSamples; i++ )
+  /** Fill the list with random numbers, unless the threads draw their own
+   * counter-based random numbers.
+   */
+  if( this->m_UseCounterBasedRandomGenerator )
   {
-    const double randomPosition
-      = localGenerator->GetVariateWithOpenRange( numPixels - 0.5 );
-    this->m_RandomNumberList.push_back( randomPosition );
+    this->DrawCounterBasedRandomKey();
+  }
+  else
+  {
+    this->m_RandomNumberList.reserve( this->m_NumberOfSamples );
+    const double numPixels = static_cast< double >( this->GetCroppedInputImageRegion().GetNumberOfPixels() );
+    localGenerator->GetVariateWithOpenRange( numPixels - 0.5 ); // dummy jump
+    for( unsigned long i = 0; i < this->m_NumberOfSamples; i++ )
+    {
+      const double randomPosition
+        = localGenerator->GetVariateWithOpenRange( numPixels - 0.5 );
+      this->m_RandomNumberList.push_back( randomPosition );
+    }
+    localGenerator->GetVariateWithOpenRange( numPixels - 0.5 ); // dummy jump
   }
-  localGenerator->GetVariateWithOpenRange( numPixels - 0.5 ); // dummy jump
 
   /** Initialize variables needed for threads. */
   Superclass::BeforeThreadedGenerateData();
@@ -74,6 +85,27 @@ ImageRandomSamplerBase< TInputImage >
 } // end BeforeThreadedGenerateData()
 
 
+/**
+ * ******************* DrawCounterBasedRandomKey *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerBase< TInputImage >
+::DrawCounterBasedRandomKey( void )
+{
+  /** A new key per update gives independent samples in every iteration,
+   * and keeps the result determined by the seed of the Mersenne Twister.
+   */
+  typedef Statistics::MersenneTwisterRandomVariateGenerator GeneratorType;
+  GeneratorType::Pointer generator = GeneratorType::GetInstance();
+  const PhiloxRandomGenerator::KeyType high = generator->GetIntegerVariate();
+  const PhiloxRandomGenerator::KeyType low  = generator->GetIntegerVariate();
+  this->m_CounterBasedRandomKey = ( high << 32 ) | low;
+
+} // end DrawCounterBasedRandomKey()
+
+
 /**
  * ******************* PrintSelf *******************
  */
@@ -86,6 +118,7 @@ ImageRandomSamplerBase< TInputImage >
   Superclass::PrintSelf( os, indent );
 
   os << indent << "NumberOfSamples: " << this->m_NumberOfSamples << std::endl;
+  os << indent << "UseCounterBasedRandomGenerator: " << this->m_UseCounterBasedRandomGenerator << std::endl;
 
 } // end PrintSelf()
 
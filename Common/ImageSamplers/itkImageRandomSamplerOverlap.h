@@ -0,0 +1,180 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageRandomSamplerOverlap_h
+#define __ImageRandomSamplerOverlap_h
+
+#include "itkImageRandomSamplerBase.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkTransform.h"
+
+#include <vector>
+
+namespace itk
+{
+/** \class ImageRandomSamplerOverlap
+ *
+ * \brief Samples randomly some voxels of the part of an image that maps
+ * into the moving image.
+ *
+ * The InputImageRegion is divided into a coarse lattice of cells. On every
+ * update, the cells are marked that have their center or one of their
+ * corners inside the fixed mask (if any), mapped by the transform inside
+ * the buffer of the moving image and inside the moving mask (if any). The
+ * samples are drawn uniformly from the voxels of the marked cells, so that
+ * hardly any samples are wasted on the part of the fixed image that maps
+ * outside the moving image. The samples within the fixed mask are found as
+ * in the ImageRandomSampler.
+ *
+ * The transform, the moving image and the moving mask are set by the
+ * AdvancedImageToImageMetric. Without a transform or a moving image, all
+ * cells are used. If no cell is marked, all cells are used as well, so that
+ * the metric reports the lack of overlap as usual.
+ *
+ * This sampler is meant to be used with NewSamplesEveryIteration, so that
+ * the map follows the transform.
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TInputImage >
+class ImageRandomSamplerOverlap :
+  public ImageRandomSamplerBase< TInputImage >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageRandomSamplerOverlap             Self;
+  typedef ImageRandomSamplerBase< TInputImage > Superclass;
+  typedef SmartPointer< Self >                  Pointer;
+  typedef SmartPointer< const Self >            ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageRandomSamplerOverlap, ImageRandomSamplerBase );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass::DataObjectPointer            DataObjectPointer;
+  typedef typename Superclass::OutputVectorContainerType    OutputVectorContainerType;
+  typedef typename Superclass::OutputVectorContainerPointer OutputVectorContainerPointer;
+  typedef typename Superclass::InputImageType               InputImageType;
+  typedef typename Superclass::InputImagePointer            InputImagePointer;
+  typedef typename Superclass::InputImageConstPointer       InputImageConstPointer;
+  typedef typename Superclass::InputImageRegionType         InputImageRegionType;
+  typedef typename Superclass::InputImagePixelType          InputImagePixelType;
+  typedef typename Superclass::ImageSampleType              ImageSampleType;
+  typedef typename Superclass::ImageSampleValueType         ImageSampleValueType;
+  typedef typename Superclass::ImageSampleContainerType     ImageSampleContainerType;
+  typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
+  typedef typename Superclass::MaskType                     MaskType;
+  typedef typename Superclass::InputImageSizeType           InputImageSizeType;
+
+  /** The input image dimension. */
+  itkStaticConstMacro( InputImageDimension, unsigned int,
+    Superclass::InputImageDimension );
+
+  /** Other typedefs. */
+  typedef typename InputImageType::IndexType InputImageIndexType;
+  typedef typename InputImageType::PointType InputImagePointType;
+
+  /** The transform from the input image to the moving image, the moving
+   * image and its mask, which have the dimension of the input image.
+   */
+  typedef Transform< double,
+    itkGetStaticConstMacro( InputImageDimension ),
+    itkGetStaticConstMacro( InputImageDimension ) >   TransformType;
+  typedef ImageBase<
+    itkGetStaticConstMacro( InputImageDimension ) >   MovingImageType;
+  typedef MaskType MovingImageMaskType;
+
+  /** The random number generator used to generate random indices. */
+  typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+  typedef typename RandomGeneratorType::Pointer                  RandomGeneratorPointer;
+
+  /** Set/Get the transform that maps the input image to the moving image. */
+  itkSetConstObjectMacro( Transform, TransformType );
+  itkGetConstObjectMacro( Transform, TransformType );
+
+  /** Set/Get the moving image. Only its geometry is used. */
+  itkSetConstObjectMacro( MovingImage, MovingImageType );
+  itkGetConstObjectMacro( MovingImage, MovingImageType );
+
+  /** Set/Get the mask of the moving image. */
+  itkSetConstObjectMacro( MovingImageMask, MovingImageMaskType );
+  itkGetConstObjectMacro( MovingImageMask, MovingImageMaskType );
+
+  /** Set/Get the number of cells of the lattice in each dimension.
+   * Default: 16. */
+  itkSetClampMacro( LatticeSize, unsigned int, 1, NumericTraits< unsigned int >::max() );
+  itkGetConstMacro( LatticeSize, unsigned int );
+
+  /** Get the number of cells that were used in the last update. */
+  itkGetConstMacro( NumberOfOverlappingCells, SizeValueType );
+
+protected:
+
+  /** The constructor. */
+  ImageRandomSamplerOverlap();
+  /** The destructor. */
+  ~ImageRandomSamplerOverlap() override {}
+
+  /** PrintSelf. */
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Function that does the work. */
+  void GenerateData( void ) override;
+
+  /** Find the cells of the lattice that overlap with the moving image. */
+  virtual void UpdateOverlappingCells( void );
+
+  /** Check whether a point of the input image is inside the fixed mask
+   * and maps into the moving image and the moving mask.
+   */
+  bool IsOverlapping( const InputImagePointType & point ) const;
+
+  RandomGeneratorPointer m_RandomGenerator;
+
+private:
+
+  /** The private constructor. */
+  ImageRandomSamplerOverlap( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );            // purposely not implemented
+
+  typename TransformType::ConstPointer       m_Transform;
+  typename MovingImageType::ConstPointer     m_MovingImage;
+  typename MovingImageMaskType::ConstPointer m_MovingImageMask;
+  unsigned int                               m_LatticeSize;
+  SizeValueType                              m_NumberOfOverlappingCells;
+
+  /** The regions of the cells that overlap with the moving image, and the
+   * cumulative number of voxels of these cells.
+   */
+  std::vector< InputImageRegionType > m_OverlappingCells;
+  std::vector< SizeValueType >        m_CumulativeNumberOfVoxels;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageRandomSamplerOverlap.hxx"
+#endif
+
+#endif // end #ifndef __ImageRandomSamplerOverlap_h
@@ -0,0 +1,281 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __ImageRandomSamplerOverlap_hxx
+#define __ImageRandomSamplerOverlap_hxx
+
+#include "itkImageRandomSamplerOverlap.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TInputImage >
+ImageRandomSamplerOverlap< TInputImage >
+::ImageRandomSamplerOverlap()
+{
+  /** Setup random generator. */
+  this->m_RandomGenerator = RandomGeneratorType::GetInstance();
+
+  this->m_LatticeSize              = 16;
+  this->m_NumberOfOverlappingCells = 0;
+
+} // end Constructor
+
+
+/**
+ * ******************* GenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerOverlap< TInputImage >
+::GenerateData( void )
+{
+  /** Get handles to the input image, output sample container, and the mask. */
+  InputImageConstPointer                     inputImage      = this->GetInput();
+  typename ImageSampleContainerType::Pointer sampleContainer = this->GetOutput();
+  typename MaskType::ConstPointer            mask            = this->GetMask();
+
+  /** Update the masks. */
+  if( mask.IsNotNull() && mask->GetSource() )
+  {
+    mask->GetSource()->Update();
+  }
+  if( this->m_MovingImageMask.IsNotNull() && this->m_MovingImageMask->GetSource() )
+  {
+    this->m_MovingImageMask->GetSource()->Update();
+  }
+
+  /** Find the cells that map into the moving image at the current transform. */
+  this->UpdateOverlappingCells();
+  const double numberOfVoxels = static_cast< double >( this->m_CumulativeNumberOfVoxels.back() );
+
+  /** Reserve memory for the output. */
+  sampleContainer->Reserve( this->GetNumberOfSamples() );
+
+  /** Make sure we are not eternally trying to find samples within the mask. */
+  const unsigned long maximumNumberOfTrials = 10 * this->GetNumberOfSamples();
+  unsigned long       numberOfTrials        = 0;
+
+  /** Loop over the sample container. */
+  typename ImageSampleContainerType::Iterator iter;
+  typename ImageSampleContainerType::ConstIterator end = sampleContainer->End();
+  InputImageIndexType positionIndex;
+  InputImagePointType inputPoint;
+  for( iter = sampleContainer->Begin(); iter != end; ++iter )
+  {
+    /** Loop until a valid sample is found. */
+    bool insideMask = false;
+    do
+    {
+      if( numberOfTrials == maximumNumberOfTrials )
+      {
+        /** Squeeze the sample container to the size that is still valid. */
+        typename ImageSampleContainerType::iterator stlnow = sampleContainer->begin();
+        typename ImageSampleContainerType::iterator stlend = sampleContainer->end();
+        stlnow                                            += iter.Index();
+        sampleContainer->erase( stlnow, stlend );
+        itkExceptionMacro( << "Could not find enough image samples within "
+                           << "reasonable time. Probably the mask is too small" );
+      }
+      ++numberOfTrials;
+
+      /** Draw a random voxel of the overlapping cells, and find its cell. */
+      const SizeValueType voxelNumber = std::min(
+        static_cast< SizeValueType >( this->m_RandomGenerator->GetVariateWithOpenUpperRange( numberOfVoxels ) ),
+        this->m_CumulativeNumberOfVoxels.back() - 1 );
+      const std::size_t cell = std::upper_bound( this->m_CumulativeNumberOfVoxels.begin(),
+        this->m_CumulativeNumberOfVoxels.end(), voxelNumber ) - this->m_CumulativeNumberOfVoxels.begin();
+      SizeValueType randomPosition = voxelNumber
+        - ( cell == 0 ? 0 : this->m_CumulativeNumberOfVoxels[ cell - 1 ] );
+
+      /** Translate randomPosition to an index in the cell. */
+      const InputImageRegionType & cellRegion = this->m_OverlappingCells[ cell ];
+      for( unsigned int dim = 0; dim < InputImageDimension; dim++ )
+      {
+        const SizeValueType sizeInThisDimension = cellRegion.GetSize()[ dim ];
+        const SizeValueType residual            = randomPosition % sizeInThisDimension;
+        positionIndex[ dim ] = residual + cellRegion.GetIndex()[ dim ];
+        randomPosition      /= sizeInThisDimension;
+      }
+
+      /** Transform the index to the physical coordinates, and check the mask. */
+      inputImage->TransformIndexToPhysicalPoint( positionIndex, inputPoint );
+      insideMask = mask.IsNull() || this->GetMaskBitmap()->IsInsideInWorldSpace( inputPoint );
+    }
+    while( !insideMask );
+
+    /** Put the coordinates and the value in the sample. */
+    ( *iter ).Value().m_ImageCoordinates = inputPoint;
+    ( *iter ).Value().m_ImageValue
+      = static_cast< ImageSampleValueType >( inputImage->GetPixel( positionIndex ) );
+
+  } // end for loop
+
+} // end GenerateData()
+
+
+/**
+ * ******************* UpdateOverlappingCells *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerOverlap< TInputImage >
+::UpdateOverlappingCells( void )
+{
+  InputImageConstPointer     inputImage = this->GetInput();
+  const InputImageRegionType region     = this->GetCroppedInputImageRegion();
+
+  /** Divide the region into cells of at least one voxel. */
+  InputImageSizeType cellSize;
+  InputImageSizeType numberOfCells;
+  SizeValueType      totalNumberOfCells = 1;
+  for( unsigned int dim = 0; dim < InputImageDimension; ++dim )
+  {
+    const SizeValueType size      = region.GetSize()[ dim ];
+    const SizeValueType latticeSz = std::min( static_cast< SizeValueType >( this->m_LatticeSize ), size );
+    cellSize[ dim ]      = ( size + latticeSz - 1 ) / latticeSz;
+    numberOfCells[ dim ] = ( size + cellSize[ dim ] - 1 ) / cellSize[ dim ];
+    totalNumberOfCells  *= numberOfCells[ dim ];
+  }
+
+  /** Test the center and the corners of each cell. */
+  const bool testOverlap = this->m_Transform.IsNotNull() && this->m_MovingImage.IsNotNull();
+  this->m_OverlappingCells.clear();
+  this->m_CumulativeNumberOfVoxels.clear();
+  SizeValueType numberOfVoxels = 0;
+  for( SizeValueType cellNumber = 0; cellNumber < totalNumberOfCells; ++cellNumber )
+  {
+    InputImageRegionType cellRegion;
+    SizeValueType        residual = cellNumber;
+    for( unsigned int dim = 0; dim < InputImageDimension; ++dim )
+    {
+      const SizeValueType cellIndex = residual % numberOfCells[ dim ];
+      residual /= numberOfCells[ dim ];
+      const SizeValueType offset = cellIndex * cellSize[ dim ];
+      cellRegion.SetIndex( dim, region.GetIndex()[ dim ] + static_cast< IndexValueType >( offset ) );
+      cellRegion.SetSize( dim, std::min( cellSize[ dim ], region.GetSize()[ dim ] - offset ) );
+    }
+
+    bool overlapping = !testOverlap;
+    for( unsigned int corner = 0; corner <= ( 1u << InputImageDimension ) && !overlapping; ++corner )
+    {
+      ContinuousIndex< double, InputImageDimension > cindex;
+      for( unsigned int dim = 0; dim < InputImageDimension; ++dim )
+      {
+        const double first = static_cast< double >( cellRegion.GetIndex()[ dim ] );
+        const double last  = first + static_cast< double >( cellRegion.GetSize()[ dim ] - 1 );
+        if( corner == ( 1u << InputImageDimension ) )
+        {
+          cindex[ dim ] = 0.5 * ( first + last );
+        }
+        else
+        {
+          cindex[ dim ] = ( corner & ( 1u << dim ) ) ? last : first;
+        }
+      }
+      InputImagePointType point;
+      inputImage->TransformContinuousIndexToPhysicalPoint( cindex, point );
+      overlapping = this->IsOverlapping( point );
+    }
+
+    if( overlapping )
+    {
+      numberOfVoxels += cellRegion.GetNumberOfPixels();
+      this->m_OverlappingCells.push_back( cellRegion );
+      this->m_CumulativeNumberOfVoxels.push_back( numberOfVoxels );
+    }
+  }
+  this->m_NumberOfOverlappingCells = this->m_OverlappingCells.size();
+
+  /** Without overlap, sample the whole region, and let the metric complain. */
+  if( this->m_OverlappingCells.empty() )
+  {
+    this->m_OverlappingCells.push_back( region );
+    this->m_CumulativeNumberOfVoxels.push_back( region.GetNumberOfPixels() );
+  }
+
+} // end UpdateOverlappingCells()
+
+
+/**
+ * ******************* IsOverlapping *******************
+ */
+
+template< class TInputImage >
+bool
+ImageRandomSamplerOverlap< TInputImage >
+::IsOverlapping( const InputImagePointType & point ) const
+{
+  /** Check the fixed mask. */
+  if( this->GetMask() != nullptr && !this->GetMaskBitmap()->IsInsideInWorldSpace( point ) )
+  {
+    return false;
+  }
+
+  /** Check the buffer of the moving image, like the interpolators do. */
+  const InputImagePointType mappedPoint = this->m_Transform->TransformPoint( point );
+  ContinuousIndex< double, InputImageDimension > cindex;
+  this->m_MovingImage->TransformPhysicalPointToContinuousIndex( mappedPoint, cindex );
+  const InputImageRegionType & movingRegion = this->m_MovingImage->GetBufferedRegion();
+  for( unsigned int dim = 0; dim < InputImageDimension; ++dim )
+  {
+    const double start = static_cast< double >( movingRegion.GetIndex()[ dim ] ) - 0.5;
+    const double end   = start + static_cast< double >( movingRegion.GetSize()[ dim ] );
+    if( !( cindex[ dim ] >= start && cindex[ dim ] < end ) )
+    {
+      return false;
+    }
+  }
+
+  /** Check the moving mask. */
+  return this->m_MovingImageMask.IsNull()
+         || this->m_MovingImageMask->IsInsideInWorldSpace( mappedPoint );
+
+} // end IsOverlapping()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerOverlap< TInputImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Transform: " << this->m_Transform.GetPointer() << std::endl;
+  os << indent << "MovingImage: " << this->m_MovingImage.GetPointer() << std::endl;
+  os << indent << "MovingImageMask: " << this->m_MovingImageMask.GetPointer() << std::endl;
+  os << indent << "LatticeSize: " << this->m_LatticeSize << std::endl;
+  os << indent << "NumberOfOverlappingCells: " << this->m_NumberOfOverlappingCells << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __ImageRandomSamplerOverlap_hxx
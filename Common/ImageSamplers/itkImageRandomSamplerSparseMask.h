@@ -20,7 +20,9 @@
 
 #include "itkImageRandomSamplerBase.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
-#include "itkImageFullSampler.h"
+#include "itkPersistentThreadPool.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -31,6 +33,13 @@ namespace itk
  * This version takes into account that the mask may be very small.
  * Also, it may be more efficient when very many different sample sets
  * of the same input image are required, because it does some precomputation.
+ *
+ * The precomputation enumerates the voxels inside the mask, in parallel, as a
+ * list of runs of consecutive voxels along the first dimension. The list is
+ * only rebuilt when the input image, the mask, or the input image region
+ * changes, so once per resolution. The samples are drawn from this list
+ * without storing a sample for every voxel inside the mask.
+ *
  * \ingroup ImageSamplers
  */
 
@@ -65,6 +74,8 @@ public:
   typedef typename Superclass::ImageSampleContainerType     ImageSampleContainerType;
   typedef typename Superclass::ImageSampleContainerPointer  ImageSampleContainerPointer;
   typedef typename Superclass::MaskType                     MaskType;
+  typedef typename Superclass::ImageSampleValueType         ImageSampleValueType;
+  typedef typename Superclass::MaskBitmapType               MaskBitmapType;
 
   /** The input image dimension. */
   itkStaticConstMacro( InputImageDimension, unsigned int,
@@ -78,10 +89,17 @@ public:
   typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
   typedef typename RandomGeneratorType::Pointer                  RandomGeneratorPointer;
 
+  /** Get the number of voxels inside the mask, found by the last update. */
+  itkGetConstMacro( NumberOfMaskVoxels, SizeValueType );
+
 protected:
 
-  typedef itk::ImageFullSampler< InputImageType >   InternalFullSamplerType;
-  typedef typename InternalFullSamplerType::Pointer InternalFullSamplerPointer;
+  /** A run of consecutive voxels inside the mask, along the first dimension. */
+  struct MaskRunType
+  {
+    InputImageIndexType m_Index;
+    SizeValueType       m_Length;
+  };
 
   /** The constructor. */
   ImageRandomSamplerSparseMask();
@@ -101,8 +119,15 @@ protected:
     const InputImageRegionType & inputRegionForThread,
     ThreadIdType threadId ) override;
 
-  RandomGeneratorPointer     m_RandomGenerator;
-  InternalFullSamplerPointer m_InternalFullSampler;
+  /** Enumerate the voxels inside the mask, if this was not done for the
+   * current input image, mask and input image region.
+   */
+  virtual void UpdateMaskRuns( void );
+
+  /** Get the sample of the voxel with the given number in the mask runs. */
+  void GetMaskVoxelSample( const SizeValueType voxelNumber, ImageSampleType & sample ) const;
+
+  RandomGeneratorPointer m_RandomGenerator;
 
 private:
 
@@ -111,6 +136,29 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );                // purposely not implemented
 
+  /** Find the mask runs of the scan lines of a work unit. */
+  static ITK_THREAD_RETURN_TYPE MaskRunsThreaderCallback( void * arg );
+
+  /** The data passed to MaskRunsThreaderCallback(). */
+  struct MaskRunsThreaderParameterType
+  {
+    Self *                                    m_Sampler;
+    SizeValueType                             m_NumberOfLines;
+    std::vector< std::vector< MaskRunType > > m_WorkUnitRuns;
+  };
+
+  /** The mask runs, and for each run the number of voxels in the runs before it. */
+  std::vector< MaskRunType >   m_MaskRuns;
+  std::vector< SizeValueType > m_MaskRunOffsets;
+  SizeValueType                m_NumberOfMaskVoxels;
+
+  /** The settings for which the mask runs were computed. */
+  const InputImageType * m_MaskRunsInput;
+  ModifiedTimeType       m_MaskRunsInputMTime;
+  const MaskType *       m_MaskRunsMask;
+  ModifiedTimeType       m_MaskRunsMaskMTime;
+  InputImageRegionType   m_MaskRunsRegion;
+
 };
 
 } // end namespace itk
@@ -20,6 +20,8 @@
 
 #include "itkImageRandomSamplerSparseMask.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
@@ -34,7 +36,11 @@ ImageRandomSamplerSparseMask< TInputImage >
   /** Setup random generator. */
   this->m_RandomGenerator = RandomGeneratorType::GetInstance();
 
-  this->m_InternalFullSampler = InternalFullSamplerType::New();
+  this->m_NumberOfMaskVoxels = 0;
+  this->m_MaskRunsInput      = nullptr;
+  this->m_MaskRunsInputMTime = 0;
+  this->m_MaskRunsMask       = nullptr;
+  this->m_MaskRunsMaskMTime  = 0;
 
 } // end Constructor
 
@@ -57,62 +63,33 @@ ImageRandomSamplerSparseMask< TInputImage >
     itkExceptionMacro( << "ERROR: do not call this function when no mask is supplied." );
   }
 
-  /** Get handles to the input image and output sample container. */
-  InputImageConstPointer      inputImage      = this->GetInput();
+  /** Get a handle to the output sample container. */
   ImageSampleContainerPointer sampleContainer = this->GetOutput();
 
   /** Clear the container. */
   sampleContainer->Initialize();
 
-  /** Make sure the internal full sampler is up-to-date. */
-  this->m_InternalFullSampler->SetInput( inputImage );
-  this->m_InternalFullSampler->SetMask( mask );
-  this->m_InternalFullSampler->SetInputImageRegion( this->GetCroppedInputImageRegion() );
-
-  /** Use try/catch, since the full sampler may crash, due to insufficient memory. */
-  try
+  /** Make sure the list of voxels inside the mask is up-to-date. */
+  this->UpdateMaskRuns();
+  if( this->m_NumberOfMaskVoxels == 0 )
   {
-    this->m_InternalFullSampler->Update();
-  }
-  catch( ExceptionObject & err )
-  {
-    std::string message = "ERROR: This ImageSampler internally uses the "
-      "ImageFullSampler. Updating of this internal sampler raised the "
-      "exception:\n";
-    message += err.GetDescription();
-
-    std::string            fullSamplerMessage = err.GetDescription();
-    std::string::size_type loc                = fullSamplerMessage.find(
-      "ERROR: failed to allocate memory for the sample container", 0 );
-    if( loc != std::string::npos && this->GetMask() == 0 )
-    {
-      message += "\nYou are using the ImageRandomSamplerSparseMask sampler, "
-        "but you did not set a mask. The internal ImageFullSampler therefore "
-        "requires a lot of memory. Consider using the ImageRandomSampler "
-        "instead.";
-    }
-    const char * message2 = message.c_str();
-    itkExceptionMacro( << message2 );
+    itkExceptionMacro( << "ERROR: the mask does not contain any voxel of the input image region." );
   }
 
   /** If desired we exercise a multi-threaded version. */
-  if( this->m_UseMultiThread )
+  if( this->m_UseMultiThread || this->m_UseCounterBasedRandomGenerator )
   {
     /** Calls ThreadedGenerateData(). */
     return Superclass::GenerateData();
   }
 
-  /** Get a handle to the full sampler output. */
-  typename ImageSampleContainerType::Pointer allValidSamples
-    = this->m_InternalFullSampler->GetOutput();
-  unsigned long numberOfValidSamples = allValidSamples->Size();
-
-  /** Take random samples from the allValidSamples-container. */
+  /** Take random samples from the voxels inside the mask. */
+  sampleContainer->Reserve( this->GetNumberOfSamples() );
   for( unsigned int i = 0; i < this->GetNumberOfSamples(); ++i )
   {
-    unsigned long randomIndex
-      = this->m_RandomGenerator->GetIntegerVariate( numberOfValidSamples - 1 );
-    sampleContainer->push_back( allValidSamples->ElementAt( randomIndex ) );
+    const SizeValueType randomIndex
+      = this->m_RandomGenerator->GetIntegerVariate( this->m_NumberOfMaskVoxels - 1 );
+    this->GetMaskVoxelSample( randomIndex, sampleContainer->ElementAt( i ) );
   }
 
 } // end GenerateData()
@@ -129,28 +106,28 @@ ImageRandomSamplerSparseMask< TInputImage >
 {
   /** Clear the random number list. */
   this->m_RandomNumberList.resize( 0 );
-  this->m_RandomNumberList.reserve( this->m_NumberOfSamples );
 
-  /** Get a handle to the full sampler output size. */
-  const unsigned long numberOfValidSamples
-    = this->m_InternalFullSampler->GetOutput()->Size();
-
-  /** Fill the list with random numbers. */
-  for( unsigned int i = 0; i < this->GetNumberOfSamples(); ++i )
+  /** Fill the list with random numbers, unless the threads draw their own
+   * counter-based random numbers.
+   */
+  if( this->m_UseCounterBasedRandomGenerator )
   {
-    unsigned long randomIndex
-      = this->m_RandomGenerator->GetIntegerVariate( numberOfValidSamples - 1 );
-    this->m_RandomNumberList.push_back( randomIndex );
+    this->DrawCounterBasedRandomKey();
   }
-
-  /** Initialize variables needed for threads. */
-  this->m_ThreaderSampleContainer.clear();
-  this->m_ThreaderSampleContainer.resize( this->GetNumberOfWorkUnits() );
-  for( std::size_t i = 0; i < this->GetNumberOfWorkUnits(); i++ )
+  else
   {
-    this->m_ThreaderSampleContainer[ i ] = ImageSampleContainerType::New();
+    this->m_RandomNumberList.reserve( this->m_NumberOfSamples );
+    for( unsigned int i = 0; i < this->GetNumberOfSamples(); ++i )
+    {
+      const SizeValueType randomIndex
+        = this->m_RandomGenerator->GetIntegerVariate( this->m_NumberOfMaskVoxels - 1 );
+      this->m_RandomNumberList.push_back( randomIndex );
+    }
   }
 
+  /** Each work unit writes its samples directly into its slice. */
+  this->AllocateThreaderOutput( this->GetNumberOfSamples() );
+
 } // end BeforeThreadedGenerateData()
 
 
@@ -163,10 +140,6 @@ void
 ImageRandomSamplerSparseMask< TInputImage >
 ::ThreadedGenerateData( const InputImageRegionType &, ThreadIdType threadId )
 {
-  /** Get a handle to the full sampler output. */
-  typename ImageSampleContainerType::Pointer allValidSamples
-    = this->m_InternalFullSampler->GetOutput();
-
   /** Figure out which samples to process. */
   unsigned long chunkSize   = this->GetNumberOfSamples() / this->GetNumberOfWorkUnits();
   unsigned long sampleStart = threadId * chunkSize;
@@ -176,24 +149,187 @@ ImageRandomSamplerSparseMask< TInputImage >
       - ( ( this->GetNumberOfWorkUnits() - 1 ) * chunkSize );
   }
 
-  /** Get a reference to the output and reserve memory for it. */
-  ImageSampleContainerPointer & sampleContainerThisThread
-    = this->m_ThreaderSampleContainer[ threadId ];
-  sampleContainerThisThread->Reserve( chunkSize );
+  /** Take random samples from the voxels inside the mask, and write them
+   * into the slice of this thread in the allocated output.
+   */
+  ImageSampleContainerType & threaderOutput = *this->m_ThreaderOutput;
+  for( unsigned long sampleId = sampleStart; sampleId < sampleStart + chunkSize; sampleId++ )
+  {
+    const SizeValueType randomIndex = this->m_UseCounterBasedRandomGenerator
+      ? static_cast< SizeValueType >( this->GetCounterBasedUniformVariate( sampleId )
+      * static_cast< double >( this->m_NumberOfMaskVoxels ) )
+      : static_cast< SizeValueType >( this->m_RandomNumberList[ sampleId ] );
+    this->GetMaskVoxelSample( randomIndex, threaderOutput[ sampleId ] );
+  }
+
+} // end ThreadedGenerateData()
+
+
+/**
+ * ******************* UpdateMaskRuns *******************
+ */
 
-  /** Setup an iterator over the sampleContainerThisThread. */
-  typename ImageSampleContainerType::Iterator iter;
-  typename ImageSampleContainerType::ConstIterator end = sampleContainerThisThread->End();
+template< class TInputImage >
+void
+ImageRandomSamplerSparseMask< TInputImage >
+::UpdateMaskRuns( void )
+{
+  const InputImageType *       inputImage = this->GetInput();
+  const MaskType *             mask       = this->GetMask();
+  const InputImageRegionType & region     = this->GetCroppedInputImageRegion();
 
-  /** Take random samples from the allValidSamples-container. */
-  unsigned long sampleId = sampleStart;
-  for( iter = sampleContainerThisThread->Begin(); iter != end; ++iter, sampleId++ )
+  /** Make sure the mask is up-to-date, before checking its modification time. */
+  if( mask->GetSource() )
   {
-    unsigned long randomIndex = static_cast< unsigned long >( this->m_RandomNumberList[ sampleId ] );
-    ( *iter ).Value() = allValidSamples->ElementAt( randomIndex );
+    mask->GetSource()->Update();
   }
 
-} // end ThreadedGenerateData()
+  /** Nothing to do if the runs were computed for the same settings. */
+  if( this->m_MaskRunsInput == inputImage
+    && this->m_MaskRunsInputMTime == inputImage->GetMTime()
+    && this->m_MaskRunsMask == mask
+    && this->m_MaskRunsMaskMTime == mask->GetMTime()
+    && this->m_MaskRunsRegion == region )
+  {
+    return;
+  }
+
+  /** Let the threads find the runs of consecutive scan lines. */
+  MaskRunsThreaderParameterType temp;
+  temp.m_Sampler       = this;
+  temp.m_NumberOfLines = region.GetNumberOfPixels() / region.GetSize( 0 );
+  const ThreadIdType numberOfWorkUnits = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( temp.m_NumberOfLines,
+    PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() ) ) );
+  temp.m_WorkUnitRuns.resize( numberOfWorkUnits );
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    numberOfWorkUnits, Self::MaskRunsThreaderCallback, &temp );
+
+  /** Concatenate the runs in scan line order, and compute the offsets. */
+  SizeValueType numberOfRuns = 0;
+  for( const auto & runs : temp.m_WorkUnitRuns )
+  {
+    numberOfRuns += runs.size();
+  }
+  this->m_MaskRuns.clear();
+  this->m_MaskRuns.reserve( numberOfRuns );
+  this->m_MaskRunOffsets.clear();
+  this->m_MaskRunOffsets.reserve( numberOfRuns );
+  this->m_NumberOfMaskVoxels = 0;
+  for( const auto & runs : temp.m_WorkUnitRuns )
+  {
+    for( const MaskRunType & run : runs )
+    {
+      this->m_MaskRuns.push_back( run );
+      this->m_MaskRunOffsets.push_back( this->m_NumberOfMaskVoxels );
+      this->m_NumberOfMaskVoxels += run.m_Length;
+    }
+  }
+
+  this->m_MaskRunsInput      = inputImage;
+  this->m_MaskRunsInputMTime = inputImage->GetMTime();
+  this->m_MaskRunsMask       = mask;
+  this->m_MaskRunsMaskMTime  = mask->GetMTime();
+  this->m_MaskRunsRegion     = region;
+
+} // end UpdateMaskRuns()
+
+
+/**
+ * ******************* MaskRunsThreaderCallback *******************
+ */
+
+template< class TInputImage >
+ITK_THREAD_RETURN_TYPE
+ImageRandomSamplerSparseMask< TInputImage >
+::MaskRunsThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const ThreadIdType              workUnit = infoStruct->WorkUnitID;
+  MaskRunsThreaderParameterType * temp
+    = static_cast< MaskRunsThreaderParameterType * >( infoStruct->UserData );
+
+  const InputImageType *       inputImage = temp->m_Sampler->GetInput();
+  const MaskBitmapType *       maskBitmap = temp->m_Sampler->GetMaskBitmap();
+  const InputImageRegionType & region     = temp->m_Sampler->GetCroppedInputImageRegion();
+  std::vector< MaskRunType > & runs       = temp->m_WorkUnitRuns[ workUnit ];
+
+  /** Figure out which scan lines to process. */
+  const SizeValueType numberOfWorkUnits = infoStruct->NumberOfWorkUnits;
+  const SizeValueType lineBegin         = temp->m_NumberOfLines * workUnit / numberOfWorkUnits;
+  const SizeValueType lineEnd           = temp->m_NumberOfLines * ( workUnit + 1 ) / numberOfWorkUnits;
+  const SizeValueType lineLength        = region.GetSize( 0 );
+
+  InputImageIndexType index;
+  InputImagePointType point;
+  for( SizeValueType line = lineBegin; line < lineEnd; ++line )
+  {
+    /** Compute the index of the first voxel of the scan line. */
+    index[ 0 ] = region.GetIndex( 0 );
+    SizeValueType remainder = line;
+    for( unsigned int d = 1; d < InputImageDimension; ++d )
+    {
+      index[ d ]  = region.GetIndex( d ) + static_cast< IndexValueType >( remainder % region.GetSize( d ) );
+      remainder  /= region.GetSize( d );
+    }
+
+    /** Walk along the scan line and record the runs inside the mask. */
+    bool inRun = false;
+    for( SizeValueType x = 0; x < lineLength; ++x )
+    {
+      index[ 0 ] = region.GetIndex( 0 ) + static_cast< IndexValueType >( x );
+      inputImage->TransformIndexToPhysicalPoint( index, point );
+      if( maskBitmap->IsInsideInWorldSpace( point ) )
+      {
+        if( inRun )
+        {
+          ++runs.back().m_Length;
+        }
+        else
+        {
+          MaskRunType run;
+          run.m_Index  = index;
+          run.m_Length = 1;
+          runs.push_back( run );
+          inRun = true;
+        }
+      }
+      else
+      {
+        inRun = false;
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end MaskRunsThreaderCallback()
+
+
+/**
+ * ******************* GetMaskVoxelSample *******************
+ */
+
+template< class TInputImage >
+void
+ImageRandomSamplerSparseMask< TInputImage >
+::GetMaskVoxelSample( const SizeValueType voxelNumber, ImageSampleType & sample ) const
+{
+  /** Find the run that contains the voxel. */
+  const auto          offset = std::upper_bound( this->m_MaskRunOffsets.begin(),
+    this->m_MaskRunOffsets.end(), voxelNumber ) - 1;
+  const MaskRunType & run    = this->m_MaskRuns[ offset - this->m_MaskRunOffsets.begin() ];
+
+  InputImageIndexType index = run.m_Index;
+  index[ 0 ] += static_cast< IndexValueType >( voxelNumber - *offset );
+
+  const InputImageType * inputImage = this->GetInput();
+  inputImage->TransformIndexToPhysicalPoint( index, sample.m_ImageCoordinates );
+  sample.m_ImageValue = static_cast< ImageSampleValueType >( inputImage->GetPixel( index ) );
+
+} // end GetMaskVoxelSample()
 
 
 /**
@@ -207,7 +343,7 @@ ImageRandomSamplerSparseMask< TInputImage >
 {
   Superclass::PrintSelf( os, indent );
 
-  os << indent << "InternalFullSampler: " << this->m_InternalFullSampler.GetPointer() << std::endl;
+  os << indent << "NumberOfMaskVoxels: " << this->m_NumberOfMaskVoxels << std::endl;
   os << indent << "RandomGenerator: " << this->m_RandomGenerator.GetPointer() << std::endl;
 
 } // end PrintSelf()
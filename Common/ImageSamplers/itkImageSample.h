@@ -28,6 +28,12 @@ namespace itk
  * \brief A class that defines an image sample, which is
  * the coordinates of a point and its value.
  *
+ * The samplers store their samples as an array of these records. A
+ * structure-of-arrays layout is deliberately not offered: every metric,
+ * the multi-input samplers and the per-sample transform evaluation index
+ * this container, and a separate copy in another layout costs more than
+ * the strided reads it would avoid.
+ *
  */
 
 template< class TImage >
@@ -0,0 +1,177 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageSampleCache_h
+#define __itkImageSampleCache_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkImageSample.h"
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ImageSampleCache
+ *
+ * \brief Keeps the samples of the deterministic image samplers, to reuse
+ * them in later registrations of the same process, or of later processes.
+ *
+ * In a batch of registrations to the same fixed image with the same
+ * parameters, the full and grid samplers generate the same samples every
+ * time. With their UseSampleCache flag, they look up their samples in this
+ * cache by a key that combines the hash of the input image, the hash of the
+ * mask, the sampled region and the parameters of the sampler. The cache is
+ * shared by all samplers of the same image type, so it lives as long as the
+ * process, which may run many ElastixFilter registrations.
+ *
+ * The cache keeps at most MaximumNumberOfSamples in memory, and removes the
+ * least recently used sample sets first. When a directory is set, each new
+ * sample set is also written to a file in that directory, named after its
+ * key, and sample sets that are not in memory are read from there. The
+ * files are written to a temporary name first, so that processes that share
+ * the directory never read a partial file.
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TInputImage >
+class ImageSampleCache : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageSampleCache           Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageSampleCache, Object );
+
+  /** Typedefs. */
+  typedef TInputImage                                     InputImageType;
+  typedef ImageSample< InputImageType >                   ImageSampleType;
+  typedef std::vector< ImageSampleType >                  SampleVectorType;
+  typedef std::shared_ptr< const SampleVectorType >       SampleVectorConstPointer;
+  typedef std::uint64_t                                   KeyType;
+
+  /** Get the cache that is shared by all samplers of this image type. */
+  static Pointer GetInstance( void );
+
+  /** Return the hash of the buffer and the geometry of an image. */
+  static KeyType ComputeImageHash( const InputImageType * image );
+
+  /** Return the samples stored with the key, or an empty pointer. */
+  SampleVectorConstPointer Find( const KeyType key );
+
+  /** Store the samples with the key. */
+  void Insert( const KeyType key, const SampleVectorConstPointer & samples );
+
+  /** Remove all samples from memory. The files are left untouched. */
+  void Clear( void );
+
+  /** Set/Get the directory of the files of the cache. Empty, the default,
+   * means that the samples are only kept in memory.
+   */
+  void SetDirectory( const std::string & directory );
+
+  std::string GetDirectory( void ) const;
+
+  /** Set/Get the maximum number of samples kept in memory. */
+  void SetMaximumNumberOfSamples( const SizeValueType maximumNumberOfSamples );
+
+  SizeValueType GetMaximumNumberOfSamples( void ) const;
+
+  /** Get the number of samples kept in memory. */
+  SizeValueType GetNumberOfSamples( void ) const;
+
+  /** Get the number of successful calls of Find(). */
+  SizeValueType GetNumberOfHits( void ) const;
+
+protected:
+
+  ImageSampleCache();
+  ~ImageSampleCache() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  ImageSampleCache( const Self & ); // purposely not implemented
+  void operator=( const Self & );   // purposely not implemented
+
+  /** The least recently used keys come first. */
+  typedef std::list< KeyType > UsageListType;
+
+  struct EntryType
+  {
+    SampleVectorConstPointer         m_Samples;
+    typename UsageListType::iterator m_Usage;
+  };
+
+  typedef std::map< KeyType, EntryType > EntryMapType;
+
+  /** Add the samples to memory, and remove old ones if needed. Not locked. */
+  void InsertInMemory( const KeyType key, const SampleVectorConstPointer & samples );
+
+  /** The header of a file, followed by the samples. */
+  struct FileHeaderType
+  {
+    char          m_Magic[ 8 ];
+    std::uint32_t m_SampleSize;
+    std::uint32_t m_Dimension;
+    std::uint64_t m_Key;
+    std::uint64_t m_NumberOfSamples;
+  };
+
+  /** Identifies the files of the cache, and the version of their format. */
+  static constexpr char FileMagic[ 8 ] = { 'E', 'L', 'X', 'S', 'M', 'P', 'L', '1' };
+
+  /** Read and write the file of a key. Return false on failure. */
+  std::string GetFileName( const KeyType key ) const;
+
+  bool ReadFile( const KeyType key, SampleVectorType & samples ) const;
+
+  bool WriteFile( const KeyType key, const SampleVectorType & samples ) const;
+
+  /** Protects the members below. */
+  mutable std::mutex m_Mutex;
+
+  EntryMapType  m_Entries;
+  UsageListType m_Usage;
+  SizeValueType m_NumberOfSamples;
+  SizeValueType m_MaximumNumberOfSamples;
+  SizeValueType m_NumberOfHits;
+  std::string   m_Directory;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageSampleCache.hxx"
+#endif
+
+#endif // end #ifndef __itkImageSampleCache_h
@@ -0,0 +1,433 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageSampleCache_hxx
+#define __itkImageSampleCache_hxx
+
+#include "itkImageSampleCache.h"
+#include "itkDataHash.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace itk
+{
+
+/** The definition of the magic, which is used as an array. */
+template< class TInputImage >
+constexpr char ImageSampleCache< TInputImage >::FileMagic[ 8 ];
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TInputImage >
+ImageSampleCache< TInputImage >
+::ImageSampleCache()
+{
+  this->m_NumberOfSamples        = 0;
+  this->m_MaximumNumberOfSamples = 16 * 1024 * 1024;
+  this->m_NumberOfHits           = 0;
+
+} // end Constructor
+
+
+/**
+ * ******************* GetInstance *******************
+ */
+
+template< class TInputImage >
+typename ImageSampleCache< TInputImage >::Pointer
+ImageSampleCache< TInputImage >
+::GetInstance( void )
+{
+  /** The initialization of a local static is thread-safe. */
+  static const Pointer instance = []()
+    {
+      Pointer cache = new Self;
+      cache->UnRegister();
+      return cache;
+    }();
+  return instance;
+
+} // end GetInstance()
+
+
+/**
+ * ******************* ComputeImageHash *******************
+ */
+
+template< class TInputImage >
+typename ImageSampleCache< TInputImage >::KeyType
+ImageSampleCache< TInputImage >
+::ComputeImageHash( const InputImageType * image )
+{
+  const unsigned int Dimension = InputImageType::ImageDimension;
+  const typename InputImageType::RegionType & region = image->GetBufferedRegion();
+
+  DataHash::HashType hash = DataHash::InitialValue;
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    hash = DataHash::CombineValue( hash, static_cast< std::int64_t >( region.GetIndex()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< std::uint64_t >( region.GetSize()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< double >( image->GetSpacing()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< double >( image->GetOrigin()[ i ] ) );
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      hash = DataHash::CombineValue( hash, static_cast< double >( image->GetDirection()[ i ][ j ] ) );
+    }
+  }
+  hash = DataHash::Combine( hash, image->GetBufferPointer(),
+    region.GetNumberOfPixels() * sizeof( typename InputImageType::PixelType ) );
+  return hash;
+
+} // end ComputeImageHash()
+
+
+/**
+ * ******************* Find *******************
+ */
+
+template< class TInputImage >
+typename ImageSampleCache< TInputImage >::SampleVectorConstPointer
+ImageSampleCache< TInputImage >
+::Find( const KeyType key )
+{
+  std::string directory;
+  {
+    std::lock_guard< std::mutex > lock( this->m_Mutex );
+    const auto found = this->m_Entries.find( key );
+    if( found != this->m_Entries.end() )
+    {
+      /** Mark the samples as the most recently used. */
+      this->m_Usage.splice( this->m_Usage.end(), this->m_Usage, found->second.m_Usage );
+      ++this->m_NumberOfHits;
+      return found->second.m_Samples;
+    }
+    directory = this->m_Directory;
+  }
+
+  /** Read the file without holding the lock. */
+  if( directory.empty() )
+  {
+    return SampleVectorConstPointer();
+  }
+  auto samples = std::make_shared< SampleVectorType >();
+  if( !this->ReadFile( key, *samples ) )
+  {
+    return SampleVectorConstPointer();
+  }
+
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  this->InsertInMemory( key, samples );
+  ++this->m_NumberOfHits;
+  return samples;
+
+} // end Find()
+
+
+/**
+ * ******************* Insert *******************
+ */
+
+template< class TInputImage >
+void
+ImageSampleCache< TInputImage >
+::Insert( const KeyType key, const SampleVectorConstPointer & samples )
+{
+  std::string directory;
+  {
+    std::lock_guard< std::mutex > lock( this->m_Mutex );
+    this->InsertInMemory( key, samples );
+    directory = this->m_Directory;
+  }
+
+  /** A failure to write only means that later processes cannot reuse them. */
+  if( !directory.empty() )
+  {
+    this->WriteFile( key, *samples );
+  }
+
+} // end Insert()
+
+
+/**
+ * ******************* InsertInMemory *******************
+ */
+
+template< class TInputImage >
+void
+ImageSampleCache< TInputImage >
+::InsertInMemory( const KeyType key, const SampleVectorConstPointer & samples )
+{
+  const auto found = this->m_Entries.find( key );
+  if( found != this->m_Entries.end() )
+  {
+    this->m_NumberOfSamples -= found->second.m_Samples->size();
+    this->m_Usage.erase( found->second.m_Usage );
+    this->m_Entries.erase( found );
+  }
+
+  if( samples->size() > this->m_MaximumNumberOfSamples )
+  {
+    return;
+  }
+
+  /** Remove the least recently used samples until the new ones fit. */
+  while( this->m_NumberOfSamples + samples->size() > this->m_MaximumNumberOfSamples )
+  {
+    const auto oldest = this->m_Entries.find( this->m_Usage.front() );
+    this->m_NumberOfSamples -= oldest->second.m_Samples->size();
+    this->m_Entries.erase( oldest );
+    this->m_Usage.pop_front();
+  }
+
+  EntryType entry;
+  entry.m_Samples = samples;
+  entry.m_Usage   = this->m_Usage.insert( this->m_Usage.end(), key );
+  this->m_Entries[ key ]  = entry;
+  this->m_NumberOfSamples += samples->size();
+
+} // end InsertInMemory()
+
+
+/**
+ * ******************* Clear *******************
+ */
+
+template< class TInputImage >
+void
+ImageSampleCache< TInputImage >
+::Clear( void )
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  this->m_Entries.clear();
+  this->m_Usage.clear();
+  this->m_NumberOfSamples = 0;
+
+} // end Clear()
+
+
+/**
+ * ******************* SetDirectory *******************
+ */
+
+template< class TInputImage >
+void
+ImageSampleCache< TInputImage >
+::SetDirectory( const std::string & directory )
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  this->m_Directory = directory;
+
+} // end SetDirectory()
+
+
+/**
+ * ******************* GetDirectory *******************
+ */
+
+template< class TInputImage >
+std::string
+ImageSampleCache< TInputImage >
+::GetDirectory( void ) const
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  return this->m_Directory;
+
+} // end GetDirectory()
+
+
+/**
+ * ******************* SetMaximumNumberOfSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageSampleCache< TInputImage >
+::SetMaximumNumberOfSamples( const SizeValueType maximumNumberOfSamples )
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  this->m_MaximumNumberOfSamples = maximumNumberOfSamples;
+  while( this->m_NumberOfSamples > this->m_MaximumNumberOfSamples )
+  {
+    const auto oldest = this->m_Entries.find( this->m_Usage.front() );
+    this->m_NumberOfSamples -= oldest->second.m_Samples->size();
+    this->m_Entries.erase( oldest );
+    this->m_Usage.pop_front();
+  }
+
+} // end SetMaximumNumberOfSamples()
+
+
+/**
+ * ******************* GetMaximumNumberOfSamples *******************
+ */
+
+template< class TInputImage >
+SizeValueType
+ImageSampleCache< TInputImage >
+::GetMaximumNumberOfSamples( void ) const
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  return this->m_MaximumNumberOfSamples;
+
+} // end GetMaximumNumberOfSamples()
+
+
+/**
+ * ******************* GetNumberOfSamples *******************
+ */
+
+template< class TInputImage >
+SizeValueType
+ImageSampleCache< TInputImage >
+::GetNumberOfSamples( void ) const
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  return this->m_NumberOfSamples;
+
+} // end GetNumberOfSamples()
+
+
+/**
+ * ******************* GetNumberOfHits *******************
+ */
+
+template< class TInputImage >
+SizeValueType
+ImageSampleCache< TInputImage >
+::GetNumberOfHits( void ) const
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  return this->m_NumberOfHits;
+
+} // end GetNumberOfHits()
+
+
+/**
+ * ******************* GetFileName *******************
+ */
+
+template< class TInputImage >
+std::string
+ImageSampleCache< TInputImage >
+::GetFileName( const KeyType key ) const
+{
+  std::ostringstream name;
+  name << this->GetDirectory() << "/elxImageSamples_"
+       << std::hex << std::setw( 16 ) << std::setfill( '0' ) << key << ".bin";
+  return name.str();
+
+} // end GetFileName()
+
+
+/**
+ * ******************* ReadFile *******************
+ */
+
+template< class TInputImage >
+bool
+ImageSampleCache< TInputImage >
+::ReadFile( const KeyType key, SampleVectorType & samples ) const
+{
+  std::ifstream file( this->GetFileName( key ).c_str(), std::ios::binary );
+  FileHeaderType header;
+  if( !file.read( reinterpret_cast< char * >( &header ), sizeof( header ) )
+    || std::memcmp( header.m_Magic, FileMagic, sizeof( header.m_Magic ) ) != 0
+    || header.m_SampleSize != sizeof( ImageSampleType )
+    || header.m_Dimension != InputImageType::ImageDimension
+    || header.m_Key != key )
+  {
+    return false;
+  }
+
+  samples.resize( header.m_NumberOfSamples );
+  return static_cast< bool >( file.read( reinterpret_cast< char * >( samples.data() ),
+    samples.size() * sizeof( ImageSampleType ) ) );
+
+} // end ReadFile()
+
+
+/**
+ * ******************* WriteFile *******************
+ */
+
+template< class TInputImage >
+bool
+ImageSampleCache< TInputImage >
+::WriteFile( const KeyType key, const SampleVectorType & samples ) const
+{
+  const std::string fileName = this->GetFileName( key );
+
+  /** Write to a unique temporary file, and rename it when complete. */
+  std::random_device randomDevice;
+  std::ostringstream temporaryFileName;
+  temporaryFileName << fileName << "." << std::hex << randomDevice() << ".tmp";
+
+  FileHeaderType header;
+  std::memcpy( header.m_Magic, FileMagic, sizeof( header.m_Magic ) );
+  header.m_SampleSize      = sizeof( ImageSampleType );
+  header.m_Dimension       = InputImageType::ImageDimension;
+  header.m_Key             = key;
+  header.m_NumberOfSamples = samples.size();
+
+  bool written = false;
+  {
+    std::ofstream file( temporaryFileName.str().c_str(), std::ios::binary );
+    written = file.write( reinterpret_cast< const char * >( &header ), sizeof( header ) )
+      && file.write( reinterpret_cast< const char * >( samples.data() ),
+      samples.size() * sizeof( ImageSampleType ) );
+  }
+  if( !written || std::rename( temporaryFileName.str().c_str(), fileName.c_str() ) != 0 )
+  {
+    std::remove( temporaryFileName.str().c_str() );
+    return false;
+  }
+  return true;
+
+} // end WriteFile()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TInputImage >
+void
+ImageSampleCache< TInputImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  os << indent << "NumberOfSampleSets: " << this->m_Entries.size() << std::endl;
+  os << indent << "NumberOfSamples: " << this->m_NumberOfSamples << std::endl;
+  os << indent << "MaximumNumberOfSamples: " << this->m_MaximumNumberOfSamples << std::endl;
+  os << indent << "NumberOfHits: " << this->m_NumberOfHits << std::endl;
+  os << indent << "Directory: " << this->m_Directory << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkImageSampleCache_hxx
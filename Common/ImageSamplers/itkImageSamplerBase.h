@@ -20,8 +20,14 @@
 
 #include "itkImageToVectorContainerFilter.h"
 #include "itkImageSample.h"
+#include "itkImageImplicitSampleContainer.h"
 #include "itkVectorDataContainer.h"
 #include "itkSpatialObject.h"
+#include "itkImageMaskBitmap.h"
+#include "itkImageSampleCache.h"
+
+#include <cstdint>
+#include <future>
 
 namespace itk
 {
@@ -77,6 +83,8 @@ public:
   typedef ImageSample< InputImageType >                         ImageSampleType;
   typedef VectorDataContainer< std::size_t, ImageSampleType >   ImageSampleContainerType;
   typedef typename ImageSampleContainerType::Pointer            ImageSampleContainerPointer;
+  typedef ImageImplicitSampleContainer< InputImageType >        ImplicitSampleContainerType;
+  typedef typename ImplicitSampleContainerType::Pointer         ImplicitSampleContainerPointer;
   typedef typename InputImageType::SizeType                     InputImageSizeType;
   typedef typename InputImageType::IndexType                    InputImageIndexType;
   typedef typename InputImageType::PointType                    InputImagePointType;
@@ -86,7 +94,9 @@ public:
   typedef typename MaskType::Pointer                            MaskPointer;
   typedef typename MaskType::ConstPointer                       MaskConstPointer;
   typedef std::vector< MaskConstPointer >                       MaskVectorType;
+  typedef ImageMaskBitmap< Self::InputImageDimension >          MaskBitmapType;
   typedef std::vector< InputImageRegionType >                   InputImageRegionVectorType;
+  typedef std::vector< double >                                 SampleWeightsType;
 
   /** ******************** Masks ******************** */
 
@@ -168,6 +178,99 @@ public:
   itkSetClampMacro( NumberOfSamples, unsigned long, 1, NumericTraits< unsigned long >::max() );
   itkGetConstMacro( NumberOfSamples, unsigned long );
 
+  /** Returns whether the output samples have importance weights, which
+   * the metric must apply, see GetSampleWeights(). Default: false.
+   */
+  virtual bool GetUseSampleWeights( void ) const
+  {
+    return false;
+  }
+
+
+  /** Set/Get whether the samplers that support it describe their samples
+   * implicitly, by runs of grid points, instead of storing them in the
+   * output. The output is then empty, and the metric computes the points and
+   * reads the values when it needs them, see GetImplicitOutput(). This saves
+   * the memory of the samples. Only the full and grid samplers support it,
+   * the others ignore it. The samples are not sorted in Morton order, nor
+   * cached. Default: false.
+   */
+  itkSetMacro( UseImplicitOutput, bool );
+  itkGetConstMacro( UseImplicitOutput, bool );
+  itkBooleanMacro( UseImplicitOutput );
+
+  /** Returns whether the sampler can describe its samples implicitly. */
+  virtual bool SupportsImplicitOutput( void ) const
+  {
+    return false;
+  }
+
+
+  /** Get the implicit samples, or nullptr when the samples are stored in
+   * the output.
+   */
+  const ImplicitSampleContainerType * GetImplicitOutput( void ) const
+  {
+    return this->m_UseImplicitOutput && this->SupportsImplicitOutput()
+           ? this->m_ImplicitOutput.GetPointer() : nullptr;
+  }
+
+
+  /** Get the importance weights of the output samples, in the order of the
+   * output. Empty when GetUseSampleWeights() returns false.
+   */
+  const SampleWeightsType & GetSampleWeights( void ) const
+  {
+    return this->m_SampleWeights;
+  }
+
+
+  /** Set/Get whether the output samples are sorted by the Morton code
+   * (Z-order) of their voxel index, after they are generated. Consecutive
+   * samples are then close in space, which improves the locality of the
+   * interpolation in the metrics. The set of samples does not change, only
+   * their order. Default: false.
+   */
+  itkSetMacro( UseMortonOrder, bool );
+  itkGetConstMacro( UseMortonOrder, bool );
+  itkBooleanMacro( UseMortonOrder );
+
+  /** Set/Get whether the samplers that generate the same samples for the
+   * same input, such as the full and grid samplers, look up their samples in
+   * the ImageSampleCache before generating them, and store them there
+   * afterwards. Samplers that select random samples ignore it. Default: false.
+   */
+  itkSetMacro( UseSampleCache, bool );
+  itkGetConstMacro( UseSampleCache, bool );
+  itkBooleanMacro( UseSampleCache );
+
+  /** Set/Get whether the samples of the next update are generated on a
+   * background thread, directly after the current samples. The metric then
+   * computes its value and derivative, and the optimizer its step, while the
+   * next samples are selected and their image values are interpolated. Only
+   * the samplers that generate their samples by ThreadedGenerateData() are
+   * pipelined. The random numbers are still drawn by the calling thread, so
+   * the samples are reproducible, although they differ from the ones drawn
+   * without pipelining. The prefetched samples are used by the first Update()
+   * after SelectNewSamplesOnUpdate(), and are discarded when the sampler is
+   * modified otherwise. Call DiscardPrefetchedSamples() before changing the
+   * settings of the sampler or destroying it. Default: false.
+   */
+  itkSetMacro( PipelineSampling, bool );
+  itkGetConstMacro( PipelineSampling, bool );
+  itkBooleanMacro( PipelineSampling );
+
+  /** Wait until the samples that are generated in the background are
+   * finished, and discard them.
+   */
+  void DiscardPrefetchedSamples( void );
+
+  /** Generate the output, and sort it in Morton order if requested. Starts
+   * generating the next samples in the background when PipelineSampling is
+   * enabled.
+   */
+  void UpdateOutputData( DataObject * output ) override;
+
   /** \todo: Temporary, should think about interface. */
   itkSetMacro( UseMultiThread, bool );
 
@@ -196,18 +299,82 @@ protected:
   */
   virtual bool CheckInputImageRegions( void );
 
-  /** Compute the intersection of the InputImageRegion and the bounding box of the mask. */
+  /** Compute the intersection of the InputImageRegion and the bounding box of the mask.
+   * Also updates the bitmap of the first mask.
+   */
   void CropInputImageRegion( void );
 
-  /** Multi-threaded function that does the work. */
+  /** Get the bitmap of the first mask, for fast inside tests. Only valid
+   * when a mask is set, after GenerateInputRequestedRegion().
+   */
+  const MaskBitmapType * GetMaskBitmap( void ) const
+  {
+    return this->m_MaskBitmap.GetPointer();
+  }
+
+
+  /** Typedefs for the cache of the samples. */
+  typedef ImageSampleCache< InputImageType >  SampleCacheType;
+  typedef typename SampleCacheType::KeyType   SampleCacheKeyType;
+
+  /** Compute the key of the samples in the ImageSampleCache, from the hashes
+   * of the input image and the mask, the cropped region, the name of the
+   * sampler and the hash of the other parameters of the sampler. Returns
+   * false when the samples cannot be cached, because the mask cannot be
+   * hashed. Only valid after GenerateInputRequestedRegion().
+   */
+  bool ComputeSampleCacheKey( const SampleCacheKeyType parameterHash, SampleCacheKeyType & key );
+
+  /** Copy the samples of the key from the cache to the output. Returns false
+   * when the cache does not have them.
+   */
+  bool CopySamplesFromCache( const SampleCacheKeyType key );
+
+  /** Store the output samples in the cache. */
+  void AddSamplesToCache( const SampleCacheKeyType key );
+
+  /** Sort the output samples, and their weights, by the Morton code of their
+   * voxel index in the cropped input image region.
+   */
+  virtual void SortOutputInMortonOrder( void );
+
+  /** Multi-threaded function that does the work. Uses the samples that were
+   * generated in the background, if they are still valid.
+   */
+  void GenerateData( void ) override;
+
   void BeforeThreadedGenerateData( void ) override;
 
   void AfterThreadedGenerateData( void ) override;
 
+  /** Let the work units write their samples directly into their own slice
+   * of the m_ThreaderOutput, instead of into the m_ThreaderSampleContainer.
+   * Resizes the m_ThreaderOutput to the given number of samples, which must
+   * be known in advance. Call it in BeforeThreadedGenerateData(), after the
+   * m_ThreaderSampleContainer are initialized.
+   */
+  void AllocateThreaderOutput( const unsigned long numberOfSamples );
+
   /***/
   unsigned long                              m_NumberOfSamples;
   std::vector< ImageSampleContainerPointer > m_ThreaderSampleContainer;
 
+  /** The samples written by the work units after AllocateThreaderOutput().
+   * AfterThreadedGenerateData() swaps them with the output, instead of
+   * concatenating the m_ThreaderSampleContainer into it, so the samples are
+   * not copied. The container is separate from the output, so that the next
+   * samples can be generated in the background while the current ones are
+   * used, and its memory is reused by the next update.
+   */
+  ImageSampleContainerPointer m_ThreaderOutput;
+  bool                        m_UseThreaderOutput;
+
+  /** The importance weights of the output samples, see GetSampleWeights(). */
+  SampleWeightsType m_SampleWeights;
+
+  /** The samples of the samplers that describe them implicitly. */
+  ImplicitSampleContainerPointer m_ImplicitOutput;
+
   //tmp?
   bool m_UseMultiThread;
 
@@ -229,6 +396,46 @@ private:
   InputImageRegionType m_CroppedInputImageRegion;
   InputImageRegionType m_DummyInputImageRegion;
 
+  typename MaskBitmapType::Pointer m_MaskBitmap;
+
+  bool m_UseMortonOrder;
+  bool m_UseSampleCache;
+  bool m_UseImplicitOutput;
+
+  /** Draw the random numbers of the next samples by the calling thread, and
+   * start the work units of ThreadedGenerateData() on a background thread.
+   */
+  void PrefetchNextSamples( void );
+
+  /** Execute the work units of ThreadedGenerateData() one after the other. */
+  void SerialThreadedGenerateData( void );
+
+  /** The state of the pipelined sampling. The prefetched samples are valid as
+   * long as the modified time equals m_PrefetchMTime.
+   */
+  bool                m_PipelineSampling;
+  bool                m_UsedThreadedGenerateData;
+  std::future< void > m_PrefetchedSamples;
+  ModifiedTimeType    m_PrefetchMTime;
+
+  /** The hash of the input image, computed once per modification. */
+  const InputImageType * m_InputImageHashSource;
+  ModifiedTimeType       m_InputImageHashMTime;
+  SampleCacheKeyType     m_InputImageHash;
+
+  /** Compute the Morton codes of the samples of a work unit. */
+  static ITK_THREAD_RETURN_TYPE MortonCodesThreaderCallback( void * arg );
+
+  /** The data passed to MortonCodesThreaderCallback(). */
+  struct MortonCodesThreaderParameterType
+  {
+    const InputImageType *           m_InputImage;
+    const ImageSampleContainerType * m_SampleContainer;
+    InputImageIndexType              m_RegionIndex;
+    unsigned int                     m_BitsPerDimension;
+    std::uint64_t *                  m_MortonCodes;
+  };
+
 };
 
 } // end namespace itk
@@ -19,6 +19,13 @@
 #define __ImageSamplerBase_hxx
 
 #include "itkImageSamplerBase.h"
+#include "itkDataHash.h"
+#include "itkParallelRadixSort.h"
+#include "itkPersistentThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
 namespace itk
 {
@@ -36,6 +43,24 @@ ImageSamplerBase< TInputImage >
   this->m_NumberOfInputImageRegions = 0;
   this->m_NumberOfSamples           = 0;
 
+  this->m_ThreaderOutput    = ImageSampleContainerType::New();
+  this->m_UseThreaderOutput = false;
+
+  this->m_MaskBitmap = MaskBitmapType::New();
+
+  this->m_UseMortonOrder    = false;
+  this->m_UseSampleCache    = false;
+  this->m_UseImplicitOutput = false;
+  this->m_ImplicitOutput    = ImplicitSampleContainerType::New();
+
+  this->m_InputImageHashSource = nullptr;
+  this->m_InputImageHashMTime  = 0;
+  this->m_InputImageHash       = 0;
+
+  this->m_PipelineSampling         = false;
+  this->m_UsedThreadedGenerateData = false;
+  this->m_PrefetchMTime            = 0;
+
   //tmp?
   this->m_UseMultiThread = false;
 
@@ -247,8 +272,15 @@ ImageSamplerBase< TInputImage >
   * the GenerateData method is executed again.
   * Return true to indicate that indeed new samples will be selected.
   * Inheriting subclasses may just return false and do nothing.
+  * The prefetched samples stay valid, if nothing else was modified.
   */
+  const bool prefetchIsValid = this->m_PrefetchedSamples.valid()
+    && this->GetMTime() == this->m_PrefetchMTime;
   this->Modified();
+  if( prefetchIsValid )
+  {
+    this->m_PrefetchMTime = this->GetMTime();
+  }
   return true;
 
 } // end SelectNewSamplesOnUpdate()
@@ -266,7 +298,9 @@ ImageSamplerBase< TInputImage >
   bool ret = true;
   for( unsigned int i = 0; i < this->m_NumberOfMasks; ++i )
   {
-    ret &= this->GetMask( i )->IsInsideInWorldSpace( point );
+    ret &= ( i == 0 && this->m_MaskBitmap->GetMask() == this->m_Mask.GetPointer() )
+      ? this->m_MaskBitmap->IsInsideInWorldSpace( point )
+      : this->GetMask( i )->IsInsideInWorldSpace( point );
   }
 
   return ret;
@@ -342,6 +376,7 @@ ImageSamplerBase< TInputImage >
     }
 
     this->UpdateAllMasks();
+    this->m_MaskBitmap->SetMask( this->m_Mask );
 
     /** Get the indices of the bounding box extremes, based on the first mask.
      * Note that the bounding box is defined in terms of the mask
@@ -406,6 +441,351 @@ ImageSamplerBase< TInputImage >
 } // end CropInputImageRegion()
 
 
+/**
+ * ******************* UpdateOutputData *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::UpdateOutputData( DataObject * output )
+{
+  this->m_UsedThreadedGenerateData = false;
+  Superclass::UpdateOutputData( output );
+
+  if( this->m_UseMortonOrder )
+  {
+    this->SortOutputInMortonOrder();
+  }
+
+  /** Start generating the next samples, while the current ones are used. */
+  if( this->m_PipelineSampling && this->m_UsedThreadedGenerateData
+    && !this->m_PrefetchedSamples.valid() )
+  {
+    this->PrefetchNextSamples();
+  }
+
+} // end UpdateOutputData()
+
+
+/**
+ * ******************* GenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::GenerateData( void )
+{
+  this->m_UsedThreadedGenerateData = true;
+
+  /** Use the prefetched samples, if nothing but the request for new samples
+   * was modified since they were started.
+   */
+  if( this->m_PrefetchedSamples.valid() )
+  {
+    if( this->GetMTime() == this->m_PrefetchMTime )
+    {
+      this->m_PrefetchedSamples.get();
+      this->AfterThreadedGenerateData();
+      return;
+    }
+    this->DiscardPrefetchedSamples();
+  }
+
+  Superclass::GenerateData();
+
+} // end GenerateData()
+
+
+/**
+ * ******************* PrefetchNextSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::PrefetchNextSamples( void )
+{
+  /** The random number generators are not thread-safe, so they are only
+   * used here, by the calling thread. The background thread only executes
+   * the work units, which write to the m_ThreaderSampleContainer. The
+   * output is not touched until the samples are used.
+   */
+  this->BeforeThreadedGenerateData();
+  this->m_PrefetchMTime     = this->GetMTime();
+  this->m_PrefetchedSamples = std::async( std::launch::async,
+    &Self::SerialThreadedGenerateData, this );
+
+} // end PrefetchNextSamples()
+
+
+/**
+ * ******************* SerialThreadedGenerateData *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::SerialThreadedGenerateData( void )
+{
+  /** The pool would serialize these work units with the ones of the metric,
+   * so the background thread executes them itself.
+   */
+  const ThreadIdType numberOfWorkUnits = this->GetNumberOfWorkUnits();
+  for( ThreadIdType threadId = 0; threadId < numberOfWorkUnits; ++threadId )
+  {
+    InputImageRegionType splitRegion;
+    if( threadId < this->SplitRequestedRegion( threadId, numberOfWorkUnits, splitRegion ) )
+    {
+      this->ThreadedGenerateData( splitRegion, threadId );
+    }
+  }
+
+} // end SerialThreadedGenerateData()
+
+
+/**
+ * ******************* DiscardPrefetchedSamples *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::DiscardPrefetchedSamples( void )
+{
+  if( this->m_PrefetchedSamples.valid() )
+  {
+    /** An exception of the background thread concerns samples that are not
+     * used, so it is ignored.
+     */
+    try
+    {
+      this->m_PrefetchedSamples.get();
+    }
+    catch( ... )
+    {
+    }
+  }
+
+} // end DiscardPrefetchedSamples()
+
+
+/**
+ * ******************* ComputeSampleCacheKey *******************
+ */
+
+template< class TInputImage >
+bool
+ImageSamplerBase< TInputImage >
+::ComputeSampleCacheKey( const SampleCacheKeyType parameterHash, SampleCacheKeyType & key )
+{
+  const InputImageType * inputImage = this->GetInput();
+  if( !inputImage || this->m_NumberOfMasks > 1 )
+  {
+    return false;
+  }
+
+  /** Only the bitmap of a mask can be hashed. */
+  SampleCacheKeyType maskHash = 0;
+  if( this->m_Mask.IsNotNull() )
+  {
+    maskHash = this->m_MaskBitmap->ComputeHash();
+    if( maskHash == 0 )
+    {
+      return false;
+    }
+  }
+
+  /** Hashing the image costs about as much as copying it, so only do it when
+   * the image changed.
+   */
+  if( this->m_InputImageHashSource != inputImage
+    || this->m_InputImageHashMTime != inputImage->GetMTime() )
+  {
+    this->m_InputImageHash       = SampleCacheType::ComputeImageHash( inputImage );
+    this->m_InputImageHashSource = inputImage;
+    this->m_InputImageHashMTime  = inputImage->GetMTime();
+  }
+
+  const std::string className = this->GetNameOfClass();
+  DataHash::HashType hash = DataHash::Combine( DataHash::InitialValue, className.data(), className.size() );
+  hash = DataHash::CombineValue( hash, this->m_InputImageHash );
+  hash = DataHash::CombineValue( hash, maskHash );
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    hash = DataHash::CombineValue( hash,
+      static_cast< std::int64_t >( this->m_CroppedInputImageRegion.GetIndex()[ i ] ) );
+    hash = DataHash::CombineValue( hash,
+      static_cast< std::uint64_t >( this->m_CroppedInputImageRegion.GetSize()[ i ] ) );
+  }
+  key = DataHash::CombineValue( hash, parameterHash );
+  return true;
+
+} // end ComputeSampleCacheKey()
+
+
+/**
+ * ******************* CopySamplesFromCache *******************
+ */
+
+template< class TInputImage >
+bool
+ImageSamplerBase< TInputImage >
+::CopySamplesFromCache( const SampleCacheKeyType key )
+{
+  const typename SampleCacheType::SampleVectorConstPointer samples
+    = SampleCacheType::GetInstance()->Find( key );
+  if( !samples )
+  {
+    return false;
+  }
+
+  ImageSampleContainerType * sampleContainer = this->GetOutput();
+  sampleContainer->assign( samples->begin(), samples->end() );
+  return true;
+
+} // end CopySamplesFromCache()
+
+
+/**
+ * ******************* AddSamplesToCache *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::AddSamplesToCache( const SampleCacheKeyType key )
+{
+  const ImageSampleContainerType * sampleContainer = this->GetOutput();
+  SampleCacheType::GetInstance()->Insert( key, std::make_shared< typename SampleCacheType::SampleVectorType >(
+    sampleContainer->begin(), sampleContainer->end() ) );
+
+} // end AddSamplesToCache()
+
+
+/**
+ * ******************* SortOutputInMortonOrder *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::SortOutputInMortonOrder( void )
+{
+  ImageSampleContainerType * sampleContainer = this->GetOutput();
+  const SizeValueType        numberOfSamples = sampleContainer->Size();
+  if( numberOfSamples < 2 || !this->GetInput() )
+  {
+    return;
+  }
+
+  /** Use as many bits per dimension as the largest size of the region needs,
+   * within the 64 bits of a key.
+   */
+  SizeValueType maximumSize = 1;
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    maximumSize = std::max< SizeValueType >( maximumSize, this->m_CroppedInputImageRegion.GetSize()[ i ] );
+  }
+  unsigned int bitsPerDimension = 1;
+  while( bitsPerDimension < 64 / InputImageDimension
+    && ( SizeValueType( 1 ) << bitsPerDimension ) < maximumSize )
+  {
+    ++bitsPerDimension;
+  }
+
+  /** Compute the keys, with one work unit per chunk of samples. */
+  std::vector< std::uint64_t > mortonCodes( numberOfSamples );
+  MortonCodesThreaderParameterType temp;
+  temp.m_InputImage       = this->GetInput();
+  temp.m_SampleContainer  = sampleContainer;
+  temp.m_RegionIndex      = this->m_CroppedInputImageRegion.GetIndex();
+  temp.m_BitsPerDimension = bitsPerDimension;
+  temp.m_MortonCodes      = mortonCodes.data();
+
+  const ThreadIdType numberOfWorkUnits = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads(),
+    numberOfSamples / ParallelRadixSort::MinimumChunkSize ) ) );
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    numberOfWorkUnits, Self::MortonCodesThreaderCallback, &temp );
+
+  /** Sort, and permute the samples and their weights accordingly. */
+  std::vector< SizeValueType > order( numberOfSamples );
+  ParallelRadixSort::SortIndices( mortonCodes.data(), numberOfSamples,
+    InputImageDimension * bitsPerDimension, order.data() );
+
+  std::vector< ImageSampleType > sortedSamples( numberOfSamples );
+  for( SizeValueType i = 0; i < numberOfSamples; ++i )
+  {
+    sortedSamples[ i ] = sampleContainer->ElementAt( order[ i ] );
+  }
+  std::copy( sortedSamples.begin(), sortedSamples.end(), sampleContainer->begin() );
+
+  if( this->m_SampleWeights.size() == numberOfSamples )
+  {
+    SampleWeightsType sortedWeights( numberOfSamples );
+    for( SizeValueType i = 0; i < numberOfSamples; ++i )
+    {
+      sortedWeights[ i ] = this->m_SampleWeights[ order[ i ] ];
+    }
+    this->m_SampleWeights.swap( sortedWeights );
+  }
+
+} // end SortOutputInMortonOrder()
+
+
+/**
+ * ******************* MortonCodesThreaderCallback *******************
+ */
+
+template< class TInputImage >
+ITK_THREAD_RETURN_TYPE
+ImageSamplerBase< TInputImage >
+::MortonCodesThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const MortonCodesThreaderParameterType * temp
+    = static_cast< MortonCodesThreaderParameterType * >( infoStruct->UserData );
+
+  const InputImageType *           inputImage      = temp->m_InputImage;
+  const ImageSampleContainerType * sampleContainer = temp->m_SampleContainer;
+  const unsigned int               bits            = temp->m_BitsPerDimension;
+  const std::int64_t               maximumCoordinate
+    = static_cast< std::int64_t >( ( std::uint64_t( 1 ) << bits ) - 1 );
+
+  const SizeValueType numberOfSamples = sampleContainer->Size();
+  const SizeValueType chunkSize
+    = ( numberOfSamples + infoStruct->NumberOfWorkUnits - 1 ) / infoStruct->NumberOfWorkUnits;
+  const SizeValueType begin = std::min( infoStruct->WorkUnitID * chunkSize, numberOfSamples );
+  const SizeValueType end   = std::min( begin + chunkSize, numberOfSamples );
+
+  ContinuousIndex< InputImagePointValueType, InputImageDimension > cindex;
+  for( SizeValueType i = begin; i < end; ++i )
+  {
+    inputImage->TransformPhysicalPointToContinuousIndex(
+      sampleContainer->ElementAt( i ).m_ImageCoordinates, cindex );
+
+    /** Interleave the bits of the voxel index relative to the region. */
+    std::uint64_t code = 0;
+    for( unsigned int d = 0; d < InputImageDimension; ++d )
+    {
+      const std::int64_t coordinate = std::min( maximumCoordinate, std::max< std::int64_t >( 0,
+        static_cast< std::int64_t >( std::floor( cindex[ d ] + 0.5 ) ) - temp->m_RegionIndex[ d ] ) );
+      for( unsigned int b = 0; b < bits; ++b )
+      {
+        code |= ( ( static_cast< std::uint64_t >( coordinate ) >> b ) & 1 ) << ( b * InputImageDimension + d );
+      }
+    }
+    temp->m_MortonCodes[ i ] = code;
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end MortonCodesThreaderCallback()
+
+
 /**
  * ******************* BeforeThreadedGenerateData *******************
  */
@@ -416,6 +796,7 @@ ImageSamplerBase< TInputImage >
 ::BeforeThreadedGenerateData( void )
 {
   /** Initialize variables needed for threads. */
+  this->m_UseThreaderOutput = false;
   this->m_ThreaderSampleContainer.clear();
   this->m_ThreaderSampleContainer.resize( this->GetNumberOfWorkUnits() );
   for( std::size_t i = 0; i < this->GetNumberOfWorkUnits(); i++ )
@@ -426,6 +807,25 @@ ImageSamplerBase< TInputImage >
 } // end BeforeThreadedGenerateData()
 
 
+/**
+ * ******************* AllocateThreaderOutput *******************
+ */
+
+template< class TInputImage >
+void
+ImageSamplerBase< TInputImage >
+::AllocateThreaderOutput( const unsigned long numberOfSamples )
+{
+  /** The per-thread containers are not used, so release them. */
+  this->m_ThreaderSampleContainer.clear();
+
+  /** Keep the capacity of the previous samples, which were swapped in. */
+  this->m_ThreaderOutput->resize( numberOfSamples );
+  this->m_UseThreaderOutput = true;
+
+} // end AllocateThreaderOutput()
+
+
 /**
  * ******************* AfterThreadedGenerateData *******************
  */
@@ -435,6 +835,17 @@ void
 ImageSamplerBase< TInputImage >
 ::AfterThreadedGenerateData( void )
 {
+  /** The work units wrote directly into the m_ThreaderOutput, so it only
+   * has to be swapped with the output.
+   */
+  if( this->m_UseThreaderOutput )
+  {
+    this->m_UseThreaderOutput = false;
+    this->m_NumberOfSamples   = this->m_ThreaderOutput->size();
+    this->GetOutput()->swap( *this->m_ThreaderOutput );
+    return;
+  }
+
   /** Get the combined number of samples. */
   this->m_NumberOfSamples = 0;
   for( std::size_t i = 0; i < this->GetNumberOfWorkUnits(); i++ )
@@ -485,6 +896,10 @@ ImageSamplerBase< TInputImage >
     os << indent.GetNextIndent() << this->m_InputImageRegionVector[ i ] << std::endl;
   }
   os << indent << "CroppedInputImageRegion" << this->m_CroppedInputImageRegion << std::endl;
+  os << indent << "UseMortonOrder: " << this->m_UseMortonOrder << std::endl;
+  os << indent << "UseSampleCache: " << this->m_UseSampleCache << std::endl;
+  os << indent << "UseImplicitOutput: " << this->m_UseImplicitOutput << std::endl;
+  os << indent << "PipelineSampling: " << this->m_PipelineSampling << std::endl;
 
 } // end PrintSelf()
 
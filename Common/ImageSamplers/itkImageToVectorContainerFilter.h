@@ -20,6 +20,7 @@
 
 #include "itkVectorContainerSource.h"
 #include "itkPlatformMultiThreader.h"
+#include "itkPersistentThreadPool.h"
 
 namespace itk
 {
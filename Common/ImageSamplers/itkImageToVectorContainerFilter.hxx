@@ -227,11 +227,10 @@ ImageToVectorContainerFilter< TInputImage, TOutputVectorContainer >
   ThreadStruct str;
   str.Filter = this;
 
-  this->GetMultiThreader()->SetNumberOfWorkUnits( this->GetNumberOfWorkUnits() );
-  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback, &str );
-
-  // multithread the execution
-  this->GetMultiThreader()->SingleMethodExecute();
+  // multithread the execution on the persistent thread pool, which is
+  // shared with the metrics and the optimizers
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    this->GetNumberOfWorkUnits(), this->ThreaderCallback, &str );
 
   // Call a method that can be overridden by a subclass to perform
   // some calculations after all the threads have completed
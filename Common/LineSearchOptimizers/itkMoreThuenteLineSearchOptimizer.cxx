@@ -20,6 +20,7 @@
 #define __itkMoreThuenteLineSearchOptimizer_cxx
 
 #include "itkMoreThuenteLineSearchOptimizer.h"
+#include <algorithm>
 #include <cmath> // For abs.
 #include <limits>
 
@@ -33,14 +34,15 @@ namespace itk
 MoreThuenteLineSearchOptimizer
 ::MoreThuenteLineSearchOptimizer()
 {
-  this->m_f                         = NumericTraits< MeasureType >::Zero;
-  this->m_dg                        = 0.0;
-  this->m_InitialDerivativeProvided = false;
-  this->m_InitialValueProvided      = false;
-  this->m_MaximumNumberOfIterations = 20;
-  this->m_ValueTolerance            = 1e-4;
-  this->m_GradientTolerance         = 0.9;
-  this->m_IntervalTolerance         = std::numeric_limits< double >::epsilon();
+  this->m_f                             = NumericTraits< MeasureType >::Zero;
+  this->m_dg                            = 0.0;
+  this->m_InitialDerivativeProvided     = false;
+  this->m_InitialValueProvided          = false;
+  this->m_MaximumNumberOfIterations     = 20;
+  this->m_ValueTolerance                = 1e-4;
+  this->m_GradientTolerance             = 0.9;
+  this->m_IntervalTolerance             = std::numeric_limits< double >::epsilon();
+  this->m_NumberOfConcurrentStepLengths = 1;
   this->SetMinimumStepLength( 1e-20 );
   this->SetMaximumStepLength( 1e20 );
 
@@ -167,6 +169,7 @@ MoreThuenteLineSearchOptimizer
     this->ComputeCurrentValueAndDerivative();
     this->m_dg = this->DirectionalDerivative( this->m_g );
     this->TestConvergence( this->m_Stop );
+    this->TestCandidateStepLengths( this->m_Stop );
     this->InvokeEvent( IterationEvent() );
     if( this->m_Stop )
     {
@@ -412,12 +415,68 @@ MoreThuenteLineSearchOptimizer
  * ***************** ComputeCurrentValueAndDerivative ********************
  *
  * Ask the cost function to compute m_f and m_g at the current position.
+ * If possible, the candidate step lengths are evaluated in the same call.
  */
 
 void
 MoreThuenteLineSearchOptimizer
 ::ComputeCurrentValueAndDerivative( void )
 {
+  this->m_CandidateStepLengths.clear();
+  this->m_CandidateValues.clear();
+  this->m_CandidateDerivatives.clear();
+
+  const MultipleValuesCostFunctionInterface * costFunction
+    = dynamic_cast< const MultipleValuesCostFunctionInterface * >( this->GetCostFunction() );
+  std::vector< double > steps;
+  if( this->m_NumberOfConcurrentStepLengths > 1 && costFunction != nullptr )
+  {
+    this->ComputeCandidateStepLengths( steps );
+  }
+
+  if( !steps.empty() )
+  {
+    /** The current position comes first, followed by the candidates. */
+    MultipleValuesCostFunctionInterface::ParametersVectorType parameters(
+      1, this->GetCurrentPosition() );
+    const ParametersType & initialPosition    = this->GetInitialPosition();
+    const ParametersType & LSD                = this->GetLineSearchDirection();
+    const unsigned int     numberOfParameters = initialPosition.GetSize();
+    for( const double step : steps )
+    {
+      ParametersType position = initialPosition;
+      for( unsigned int i = 0; i < numberOfParameters; ++i )
+      {
+        position[ i ] += ( step * LSD[ i ] );
+      }
+      parameters.push_back( position );
+    }
+
+    MultipleValuesCostFunctionInterface::MeasureVectorType    values;
+    MultipleValuesCostFunctionInterface::DerivativeVectorType derivatives;
+    try
+    {
+      costFunction->GetValuesAndDerivatives( parameters, values, derivatives );
+    }
+    catch( ExceptionObject & )
+    {
+      /** A candidate may be invalid, for example because too many samples
+       * map outside the moving image. Evaluate the current position alone.
+       */
+      values.clear();
+    }
+
+    if( values.size() == parameters.size() )
+    {
+      this->m_f = values[ 0 ];
+      this->m_g = derivatives[ 0 ];
+      this->m_CandidateStepLengths = steps;
+      this->m_CandidateValues.assign( values.begin() + 1, values.end() );
+      this->m_CandidateDerivatives.assign( derivatives.begin() + 1, derivatives.end() );
+      return;
+    }
+  }
+
   try
   {
     this->GetCostFunction()->GetValueAndDerivative(
@@ -500,6 +559,109 @@ MoreThuenteLineSearchOptimizer
 } // end TestConvergence()
 
 
+/**
+ * ****************** ComputeCandidateStepLengths ************************
+ *
+ * Compute the candidate step lengths that are evaluated together with m_step:
+ * evenly spread over the bracketed interval of uncertainty, or alternately
+ * larger and smaller than m_step if no minimizer has been bracketed yet.
+ */
+
+void
+MoreThuenteLineSearchOptimizer
+::ComputeCandidateStepLengths( std::vector< double > & steps ) const
+{
+  steps.clear();
+  const unsigned int numberOfCandidates = this->m_NumberOfConcurrentStepLengths - 1;
+
+  double factor = 2.0;
+  for( unsigned int i = 0; i < numberOfCandidates; ++i )
+  {
+    double step = 0.0;
+    if( this->m_brackt )
+    {
+      step = this->m_stepmin + ( this->m_stepmax - this->m_stepmin )
+        * ( i + 1.0 ) / ( numberOfCandidates + 1.0 );
+    }
+    else if( i % 2 == 0 )
+    {
+      step = this->m_step * factor;
+    }
+    else
+    {
+      step    = this->m_step / factor;
+      factor *= 2.0;
+    }
+
+    /** Only use new steps strictly inside the interval. */
+    this->BoundStep( step );
+    if( step > this->m_stepmin && step < this->m_stepmax && step != this->m_step
+      && std::find( steps.begin(), steps.end(), step ) == steps.end() )
+    {
+      steps.push_back( step );
+    }
+  }
+
+} // end ComputeCandidateStepLengths()
+
+
+/**
+ * ****************** TestCandidateStepLengths ************************
+ *
+ * If m_step does not satisfy the strong Wolfe conditions, move to the
+ * candidate step with the lowest value that does, and stop.
+ */
+
+void
+MoreThuenteLineSearchOptimizer
+::TestCandidateStepLengths( bool & stop )
+{
+  if( this->m_SufficientDecreaseConditionSatisfied
+    && this->m_CurvatureConditionSatisfied )
+  {
+    return;
+  }
+
+  const std::size_t numberOfCandidates = this->m_CandidateStepLengths.size();
+  std::size_t       best               = numberOfCandidates;
+  double            bestdg             = 0.0;
+  for( std::size_t i = 0; i < numberOfCandidates; ++i )
+  {
+    const double step = this->m_CandidateStepLengths[ i ];
+    const double dg   = this->DirectionalDerivative( this->m_CandidateDerivatives[ i ] );
+
+    const bool sufficientDecrease
+      = ( this->m_CandidateValues[ i ] <= this->m_finit + step * this->m_dgtest );
+    const bool curvature
+      = ( std::abs( dg ) <= this->GetGradientTolerance() * ( -this->m_dginit ) );
+
+    if( sufficientDecrease && curvature
+      && ( best == numberOfCandidates || this->m_CandidateValues[ i ] < this->m_CandidateValues[ best ] ) )
+    {
+      best   = i;
+      bestdg = dg;
+    }
+  }
+
+  if( best == numberOfCandidates )
+  {
+    return;
+  }
+
+  this->m_step = this->m_CandidateStepLengths[ best ];
+  this->SetCurrentStepLength( this->m_step );
+  this->m_f  = this->m_CandidateValues[ best ];
+  this->m_g  = this->m_CandidateDerivatives[ best ];
+  this->m_dg = bestdg;
+
+  this->m_SufficientDecreaseConditionSatisfied = true;
+  this->m_CurvatureConditionSatisfied          = true;
+  this->m_StopCondition                        = StrongWolfeConditionsSatisfied;
+  stop                                         = true;
+
+} // end TestCandidateStepLengths()
+
+
 /**
  * ****************** ComputeNewStepAndInterval ************************
  *
@@ -1016,6 +1178,8 @@ MoreThuenteLineSearchOptimizer
      << this->m_GradientTolerance << std::endl;
   os << indent << "m_IntervalTolerance: "
      << this->m_IntervalTolerance << std::endl;
+  os << indent << "m_NumberOfConcurrentStepLengths: "
+     << this->m_NumberOfConcurrentStepLengths << std::endl;
 
 } // end PrintSelf()
 
@@ -20,6 +20,9 @@
 #define __itkMoreThuenteLineSearchOptimizer_h
 
 #include "itkLineSearchOptimizer.h"
+#include "itkMultipleValuesCostFunctionInterface.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -64,6 +67,16 @@ namespace itk
  * when rounding errors prevent further progress. In this case stp only
  * satisfies the sufficient decrease condition.
  *
+ * If the NumberOfConcurrentStepLengths is larger than one, and the cost
+ * function implements the MultipleValuesCostFunctionInterface, each
+ * iteration evaluates some candidate step lengths together with the trial
+ * step. Inside a bracketed interval of uncertainty the candidates are spread
+ * evenly over the interval; otherwise they are multiples of the trial step.
+ * If the trial step does not satisfy the strong Wolfe conditions but a
+ * candidate does, the line search stops at the candidate with the lowest
+ * value. Otherwise the candidates are ignored, so that the line search
+ * proceeds exactly as with a single step length.
+ *
  *
  * \ingroup Numerics Optimizers
  */
@@ -166,6 +179,15 @@ public:
   itkSetClampMacro( IntervalTolerance, double, 0.0, NumericTraits< double >::max() );
   itkGetConstMacro( IntervalTolerance, double );
 
+  /** Setting: the number of step lengths that are evaluated concurrently in
+   * each iteration, including the trial step. By default set to 1, which
+   * evaluates the trial step only. Values of 2 to 4 are useful if the cost
+   * function computes several values and derivatives concurrently.
+   */
+  itkSetClampMacro( NumberOfConcurrentStepLengths, unsigned int,
+    1, NumericTraits< unsigned int >::max() );
+  itkGetConstMacro( NumberOfConcurrentStepLengths, unsigned int );
+
 protected:
 
   MoreThuenteLineSearchOptimizer();
@@ -207,6 +229,14 @@ protected:
   /** Check for convergence */
   virtual void TestConvergence( bool & stop );
 
+  /** Compute the candidate step lengths that are evaluated together with m_step. */
+  virtual void ComputeCandidateStepLengths( std::vector< double > & steps ) const;
+
+  /** If m_step does not satisfy the strong Wolfe conditions, move to the
+   * candidate step with the lowest value that does, and stop.
+   */
+  virtual void TestCandidateStepLengths( bool & stop );
+
   /** Update the interval of uncertainty and compute the new step */
   virtual void ComputeNewStepAndInterval( void );
 
@@ -248,6 +278,11 @@ protected:
   bool m_stage1;
   bool m_SafeGuardedStepFailed;
 
+  /** The candidate steps evaluated with m_step, with their values and derivatives. */
+  std::vector< double >                                     m_CandidateStepLengths;
+  MultipleValuesCostFunctionInterface::MeasureVectorType    m_CandidateValues;
+  MultipleValuesCostFunctionInterface::DerivativeVectorType m_CandidateDerivatives;
+
 private:
 
   MoreThuenteLineSearchOptimizer( const Self & ); // purposely not implemented
@@ -257,6 +292,7 @@ private:
   double        m_ValueTolerance;
   double        m_GradientTolerance;
   double        m_IntervalTolerance;
+  unsigned int  m_NumberOfConcurrentStepLengths;
 
 };
 
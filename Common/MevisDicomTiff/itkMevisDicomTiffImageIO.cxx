@@ -24,6 +24,7 @@
 #include "itkMetaDataObject.h"
 #include "itkVersion.h"
 #include "itkNumericTraits.h"
+#include "itkMultiThreaderBase.h"
 
 // developed using gdcm 2.0 and libtiff 3.8.2
 #include "gdcmAttribute.h"
@@ -44,6 +45,7 @@
 #include "gdcmException.h"
 #include "gdcmFileMetaInformation.h"
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -282,7 +284,9 @@ MevisDicomTiffImageIO::CanReadFile( const char * filename )
     t4.close();
   }
 
-  // checking if dcm is valid dcm
+  // checking if dcm is valid dcm; the header is kept for
+  // ReadImageInformation(), so that it is parsed only once
+  m_DcmHeaderFileName = "";
   gdcm::Reader reader;
   reader.SetFileName( m_DcmFileName.c_str() );
   if( !reader.Read() )
@@ -290,8 +294,16 @@ MevisDicomTiffImageIO::CanReadFile( const char * filename )
     itkDebugMacro( << "mevisIO:canreadfile(): error opening dcm file " << m_DcmFileName );
     return false;
   }
+  m_DcmHeader         = reader.GetFile().GetDataSet();
+  m_DcmHeaderFileName = m_DcmFileName;
 
   // checking if tiff is valid tif
+  if( m_IsOpen )
+  {
+    TIFFClose( m_TIFFImage );
+    m_TIFFImage = nullptr;
+    m_IsOpen    = false;
+  }
   m_TIFFImage = TIFFOpen( m_TiffFileName.c_str(), "rc" ); // c is disable strip chopping
   if( m_TIFFImage == nullptr )
   {
@@ -379,10 +391,15 @@ MevisDicomTiffImageIO::ReadImageInformation()
   // reader.Read() to return an error.
   //
   // We trust the dcm header information instead
-  gdcm::ImageReader reader;
-  reader.SetFileName( m_DcmFileName.c_str() );
-  reader.Read();
-  const gdcm::DataSet header = reader.GetFile().GetDataSet();
+  if( m_DcmHeaderFileName != m_DcmFileName )
+  {
+    gdcm::ImageReader reader;
+    reader.SetFileName( m_DcmFileName.c_str() );
+    reader.Read();
+    m_DcmHeader         = reader.GetFile().GetDataSet();
+    m_DcmHeaderFileName = m_DcmFileName;
+  }
+  const gdcm::DataSet & header = m_DcmHeader;
 
   // number of frames --> indicate 3D or not
   // number of temporal positions --> indicate 4D
@@ -821,13 +838,13 @@ MevisDicomTiffImageIO::Read( void * buffer )
   // always assume contigous data (PLANARCONFIG =1)
   // image is either tiled or stripped
   //
-  // TIFFTileSize     returns size of one tile in bytes
-  // TIFFReadTile     reads one tile, returns number of bytes in decoded tile
-  //
-  // note *buffer goes in scanline order!
-  // very inconvenient if the tiff image is tiled, which damned
-  // is the case for mevislab images!
-  // note buffer is already allocated, according to size!
+  // note *buffer goes in scanline order, and holds the IORegion only,
+  // since streamed reading is supported. The tiles (or strips) that
+  // overlap the IORegion are decoded, by multiple threads, each with its
+  // own TIFF handle, since a handle can not be shared by threads. The
+  // part of a tile inside the IORegion is copied row by row into the
+  // buffer, which also handles the tiles at the border of the image and
+  // tiles that are larger than the image.
 
   short int p;
   if( !TIFFGetField( m_TIFFImage, TIFFTAG_PLANARCONFIG, &p ) )
@@ -842,7 +859,10 @@ MevisDicomTiffImageIO::Read( void * buffer )
       return;
     }
   }
-
+  if( m_BitsPerSample % 8 != 0 )
+  {
+    itkExceptionMacro( << "mevisIO:read(): unsupported bits per sample " << m_BitsPerSample );
+  }
   if( m_IsTiled )
   {
     // only works for tile depth == 1 (used by mevislab),
@@ -853,345 +873,149 @@ MevisDicomTiffImageIO::Read( void * buffer )
       itkExceptionMacro( << "mevisIO:read(): unsupported tiledepth (should be one)! " );
       return;
     }
+  }
+  else if( m_TIFFDimension == 3 )
+  {
+    itkExceptionMacro( << "mevisIO:read(): non-tiled 3D dcm/tiff reading not (yet) implemented" );
+    return;
+  }
 
-    // buffer pointer is scanline based (one dimensional array)
-    // tile is positioned on x,y,z; we read each tile, and fill
-    // the corresponding positions in the onedimensional array
-    unsigned char * vol = reinterpret_cast< unsigned char * >( buffer );
-
-    const unsigned int tilesize       = TIFFTileSize( m_TIFFImage );
-    const unsigned int tilerowbytes   = TIFFTileRowSize( m_TIFFImage );
-    const unsigned int bytespersample = m_BitsPerSample / 8;
-
-    unsigned char * tilebuf = static_cast< unsigned char * >( _TIFFmalloc( tilesize ) );
-
-    //
-    // special cases, if the tilexy is larger than or equal to the image
-    // size itself, treat as three separate cases, both are larger/equal,
-    // or only direction
-    //
-    bool tileoversized( false );
+  // the region to read; the z and t indices of a 4D image are both
+  // stored along the depth of the tiff image, z fastest
+  const ImageIORegion & region         = this->GetIORegion();
+  const std::size_t     bytespersample = m_BitsPerSample / 8;
+  const unsigned int    x0             = region.GetIndex( 0 );
+  const unsigned int    y0             = region.GetIndex( 1 );
+  const unsigned int    sx             = region.GetSize( 0 );
+  const unsigned int    sy             = region.GetSize( 1 );
+  const unsigned int    z0             = region.GetImageDimension() > 2 ? region.GetIndex( 2 ) : 0;
+  const unsigned int    sz             = region.GetImageDimension() > 2 ? region.GetSize( 2 ) : 1;
+  const unsigned int    t0             = region.GetImageDimension() > 3 ? region.GetIndex( 3 ) : 0;
+  const unsigned int    st             = region.GetImageDimension() > 3 ? region.GetSize( 3 ) : 1;
+  const unsigned int    dz             = this->GetNumberOfDimensions() > 2 ? m_Dimensions[ 2 ] : 1;
+  if( sx == 0 || sy == 0 || sz == 0 || st == 0 )
+  {
+    return;
+  }
 
-    if( m_TileLength >= m_Length || m_TileWidth >= m_Width )
+  // the tiff slices of the region, with the index of the slice in the buffer
+  std::vector< std::pair< unsigned int, std::size_t > > slices;
+  for( unsigned int t = 0; t < st; ++t )
+  {
+    for( unsigned int z = 0; z < sz; ++z )
     {
-      tileoversized = true;
-
-      // case one both x,y is larger
-      if( m_TileLength >= m_Length && m_TileWidth >= m_Width )
-      {
-        for( unsigned int z0 = 0; z0 < ( m_TIFFDimension == 3 ? m_Depth : 1 ); z0++ )
-        {
-          if( TIFFReadTile( m_TIFFImage, tilebuf, 0, 0, z0, 0 ) < 0 )
-          {
-            _TIFFfree( tilebuf );
-            itkExceptionMacro( << "mevisIO:read(): error reading tile (topleft)" );
-            return;
-          }
-          else
-          {
-            // do row based copy of tile into volume
-            const unsigned     lenx       = m_Width;
-            const unsigned     leny       = m_Length;
-            const unsigned int tilexbytes = lenx * bytespersample;
-
-            unsigned char *    pv = vol;
-            const unsigned int p  = z0 * m_Length * m_Width;
-            pv += p * bytespersample;
-
-            unsigned char * pb = tilebuf;
-            for( unsigned int r = 0; r < leny; ++r )
-            {
-              memcpy( pv, pb, tilexbytes );
-              pv += tilexbytes;
-              pb += tilerowbytes;
-            }
-          }
-        }
-      } // end case one
-
-      // case two, larger x, smaller y
-      if( m_TileWidth >= m_Width && m_TileLength < m_Length )
-      {
-
-        const unsigned     lenx       = m_Width;
-        const unsigned int tilexbytes = lenx * bytespersample;
-
-        const bool my = ( m_Length % m_TileLength == 0 ) ? true : false;
-        for( unsigned int z0 = 0; z0 < ( m_TIFFDimension == 3 ? m_Depth : 1 ); z0++ )
-        {
-          for( unsigned int y0 = 0; y0 < ( my ? m_Length : m_Length - m_TileLength ); y0 += m_TileLength )
-          {
-            if( TIFFReadTile( m_TIFFImage, tilebuf, 0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (top image)" );
-              return;
-            }
-            else
-            {
-
-              unsigned char *    pb = tilebuf;
-              unsigned char *    pv = vol;
-              const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width;
-              pv += p * bytespersample;
-
-              for( unsigned int r = 0; r < m_TileLength; ++r )
-              {
-                memcpy( pv, pb, tilerowbytes );
-                pv += tilexbytes;
-                pb += tilerowbytes;
-              }
-            }
-          }
-
-          if( !my )
-          {
-            const unsigned     leny = m_Length % m_TileLength;
-            const unsigned int y0   = m_Length - leny;
-
-            if( TIFFReadTile( m_TIFFImage, tilebuf, 0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (strip bottom)" );
-              return;
-            }
-            else
-            {
-              unsigned char *    pb = tilebuf;
-              unsigned char *    pv = vol;
-              const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width;
-              pv += p * bytespersample;
-
-              for( unsigned int r = 0; r < leny; ++r )
-              {
-                memcpy( pv, pb, tilexbytes );
-                pv += tilexbytes;
-                pb += tilerowbytes;
-              }
-            }
-          }
-        }
-
-      } // end case two
+      slices.push_back( std::make_pair( ( t0 + t ) * dz + z0 + z,
+        static_cast< std::size_t >( t ) * sz + z ) );
+    }
+  }
 
-      // case three, smaller x, larger y
-      if( m_TileWidth < m_Width && m_TileLength >= m_Length )
+  // the blocks to decode: tiles (x,y,slice) or strips (first row)
+  struct BlockType
+  {
+    unsigned int x;
+    unsigned int y;
+    std::size_t  slice;
+  };
+  std::vector< BlockType > blocks;
+  unsigned int             blockwidth  = m_Width;
+  unsigned int             blocklength = 0;
+  if( m_IsTiled )
+  {
+    blockwidth  = m_TileWidth;
+    blocklength = m_TileLength;
+  }
+  else
+  {
+    uint32 rowsperstrip = m_Length;
+    TIFFGetFieldDefaulted( m_TIFFImage, TIFFTAG_ROWSPERSTRIP, &rowsperstrip );
+    blocklength = std::min< uint32 >( rowsperstrip, m_Length );
+  }
+  if( blockwidth == 0 || blocklength == 0 )
+  {
+    itkExceptionMacro( << "mevisIO:read(): invalid tile or strip size" );
+  }
+  for( std::size_t s = 0; s < slices.size(); ++s )
+  {
+    for( unsigned int by = ( y0 / blocklength ) * blocklength; by < y0 + sy; by += blocklength )
+    {
+      for( unsigned int bx = ( x0 / blockwidth ) * blockwidth; bx < x0 + sx; bx += blockwidth )
       {
+        const BlockType block = { bx, by, s };
+        blocks.push_back( block );
+      }
+    }
+  }
 
-        const unsigned leny = m_Length;
-        const bool     mx   = ( m_Width % m_TileWidth == 0 ) ? true : false;
-
-        for( unsigned int z0 = 0; z0 < ( m_TIFFDimension == 3 ? m_Depth : 1 ); z0++ )
-        {
-          for( unsigned int x0 = 0; x0 < ( mx ? m_Width : m_Width - m_TileWidth ); x0 += m_TileWidth )
-          {
-            // read tile
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, 0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (top image)" );
-              return;
-            }
-            else
-            {
-              unsigned char *    pb = tilebuf;
-              unsigned char *    pv = vol;
-              const unsigned int p  = z0 * m_Length * m_Width + x0;
-              pv += p * bytespersample;
-
-              for( unsigned int r = 0; r < leny; ++r )
-              {
-                memcpy( pv, pb, tilerowbytes );
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-          }
-          // fill strip right
-          if( !mx )
-          {
-            const unsigned     lenx       = m_Width % m_TileWidth;
-            const unsigned int x0         = m_Width - lenx;
-            const unsigned int tilexbytes = lenx * bytespersample;
-
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, 0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (strip right)" );
-              return;
-            }
-            else
-            {
-              unsigned char *    pb = tilebuf;
-              unsigned char *    pv = vol;
-              const unsigned int p  = z0 * m_Length * m_Width + x0;
-              pv += p * bytespersample;
-
-              for( unsigned int r = 0; r < leny; ++r )
-              {
-                memcpy( pv, pb, tilexbytes );
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-          }
-        }
-
-      } // end case three
-
-    } // end oversized tile
+  const tmsize_t blocksize = m_IsTiled ? TIFFTileSize( m_TIFFImage ) : TIFFStripSize( m_TIFFImage );
+  const std::size_t blockrowbytes = m_IsTiled
+    ? static_cast< std::size_t >( TIFFTileRowSize( m_TIFFImage ) )
+    : static_cast< std::size_t >( TIFFScanlineSize( m_TIFFImage ) );
 
-    //
-    // normal case, tile is smaller than image
-    //
-    if( !tileoversized )
+  // decode the blocks with the given handle, from `first', with steps of `step'
+  unsigned char * vol = reinterpret_cast< unsigned char * >( buffer );
+  const auto decodeBlocks = [ & ]( TIFF * tiff, const std::size_t first, const std::size_t step ) -> bool
+  {
+    std::vector< unsigned char > blockbuf( static_cast< std::size_t >( blocksize ) );
+    for( std::size_t i = first; i < blocks.size(); i += step )
     {
-      // is volume direction a multiple of tiledirection?
-      const bool mx = ( m_Width % m_TileWidth == 0 ) ? true : false;
-      const bool my = ( m_Length % m_TileLength == 0 ) ? true : false;
-
-      // fill everything inside ie from topleft
-      for( unsigned int z0 = 0; z0 < ( m_TIFFDimension == 3 ? m_Depth : 1 ); z0++ )
+      const BlockType & block = blocks[ i ];
+      const unsigned int tiffz = slices[ block.slice ].first;
+      const tmsize_t     read  = m_IsTiled
+        ? TIFFReadTile( tiff, &blockbuf[ 0 ], block.x, block.y, m_TIFFDimension == 3 ? tiffz : 0, 0 )
+        : TIFFReadEncodedStrip( tiff, TIFFComputeStrip( tiff, block.y, 0 ), &blockbuf[ 0 ], blocksize );
+      if( read < 0 )
       {
-        for( unsigned int y0 = 0; y0 < ( my ? m_Length : m_Length - m_TileLength ); y0 += m_TileLength )
-        {
-          for( unsigned int x0 = 0; x0 < ( mx ? m_Width : m_Width - m_TileWidth ); x0 += m_TileWidth )
-          {
-            // x0,y0,z0 is position of tile in volume, top left corner
-            // pointer to volume (at 0,0,0)
-            unsigned char * pv = vol;
-
-            // set pointer of volume to y0,x0,z0 position
-            const unsigned int p = z0 * m_Length * m_Width + y0 * m_Width + x0;
-            pv += p * bytespersample;
-
-            // read tile
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (topleft image)" );
-              return;
-            }
-            else
-            {
-              // do row based copy of tile into volume
-              unsigned char * pb = tilebuf;
-              for( unsigned int r = 0; r < m_TileLength; ++r )
-              {
-                memcpy( pv, pb, tilerowbytes );
-                // move pointers
-                // x remain same, y is one complete vol line
-                // (ie width of image)
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-
-          }
-        }
-        // fill boundaries
-        if( !mx )
-        {
-          // x is fixed
-          const unsigned     lenx       = m_Width % m_TileWidth;
-          const unsigned int x0         = m_Width - lenx;
-          const unsigned int tilexbytes = lenx * bytespersample;
-
-          for( unsigned int y0 = 0; y0 < ( my ? m_Length : m_Length - m_TileLength ); y0 += m_TileLength )
-          {
-            unsigned char *    pv = vol;
-            const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width + x0;
-            pv += p * bytespersample;
-
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (ydirection)" );
-              return;
-            }
-            else
-            {
-              unsigned char * pb = tilebuf;
-              for( unsigned int r = 0; r < m_TileLength; ++r )
-              {
-                memcpy( pv, pb, tilexbytes );
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-          }
-        }
-        if( !my )
-        {
-          // y is fixed
-          const unsigned     leny = m_Length % m_TileLength;
-          const unsigned int y0   = m_Length - leny;
-
-          for( unsigned int x0 = 0; x0 < ( mx ? m_Width : m_Width - m_TileWidth ); x0 += m_TileWidth )
-          {
-            unsigned char *    pv = vol;
-            const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width + x0;
-            pv += p * bytespersample;
-
-            if( TIFFReadTile( m_TIFFImage, tilebuf, x0, y0, z0, 0 ) < 0 )
-            {
-              _TIFFfree( tilebuf );
-              itkExceptionMacro( << "mevisIO:read(): error reading tile (x-direction)" );
-              return;
-            }
-            else
-            {
-              unsigned char * pb = tilebuf;
-              for( unsigned int r = 0; r < leny; ++r )
-              {
-                memcpy( pv, pb, tilerowbytes );
-                pv += m_Width * bytespersample;
-                pb += tilerowbytes;
-              }
-            }
-          }
-        }
-        // fill corner bottom
-        if( !mx && !my )
-        {
-          // x0,y0 is fixed
-          const unsigned     lenx       = m_Width % m_TileWidth;
-          const unsigned int x0         = m_Width - lenx;
-          const unsigned int tilexbytes = lenx * bytespersample;
-          const unsigned     leny       = m_Length % m_TileLength;
-          const unsigned int y0         = m_Length - leny;
-
-          unsigned char *    pv = vol;
-          const unsigned int p  = z0 * m_Length * m_Width + y0 * m_Width + x0;
-          pv += p * bytespersample;
+        return false;
+      }
 
-          if( TIFFReadTile( m_TIFFImage, tilebuf, x0, y0, z0, 0 ) < 0 )
-          {
-            _TIFFfree( tilebuf );
-            itkExceptionMacro( << "mevisIO:read(): error reading tile (corner bottom)" );
-            return;
-          }
-          else
-          {
-            unsigned char * pb = tilebuf;
-            for( unsigned int r = 0; r < leny; ++r )
-            {
-              memcpy( pv, pb, tilexbytes );
-              pv += m_Width * bytespersample;
-              pb += tilerowbytes;
-            }
-          }
-        }
+      // copy the rows of the block that are inside the region
+      const unsigned int xb = std::max( block.x, x0 );
+      const unsigned int xe = std::min( std::min( block.x + blockwidth, m_Width ), x0 + sx );
+      const unsigned int yb = std::max( block.y, y0 );
+      const unsigned int ye = std::min( std::min( block.y + blocklength, m_Length ), y0 + sy );
+      const std::size_t  rowbytes = static_cast< std::size_t >( xe - xb ) * bytespersample;
+      for( unsigned int y = yb; y < ye; ++y )
+      {
+        const unsigned char * pb = &blockbuf[ 0 ]
+          + static_cast< std::size_t >( y - block.y ) * blockrowbytes
+          + static_cast< std::size_t >( xb - block.x ) * bytespersample;
+        unsigned char * pv = vol + ( ( slices[ block.slice ].second * sy + ( y - y0 ) ) * sx
+          + ( xb - x0 ) ) * bytespersample;
+        memcpy( pv, pb, rowbytes );
       }
     }
+    return true;
+  };
+
+  // one work unit per thread, each with its own handle; the first work
+  // unit uses the handle of this object
+  MultiThreaderBase::Pointer threader = MultiThreaderBase::New();
+  const std::size_t          numberOfWorkUnits = std::max< std::size_t >( 1, std::min< std::size_t >(
+    blocks.size(), threader->GetMaximumNumberOfThreads() ) );
+  std::vector< char >        succeeded( numberOfWorkUnits, 0 );
+  threader->SetNumberOfWorkUnits( numberOfWorkUnits );
+  threader->ParallelizeArray( 0, numberOfWorkUnits, [ & ]( SizeValueType w )
+  {
+    if( w == 0 )
+    {
+      succeeded[ w ] = decodeBlocks( m_TIFFImage, w, numberOfWorkUnits );
+      return;
+    }
+    TIFF * tiff = TIFFOpen( m_TiffFileName.c_str(), "rc" );
+    if( tiff != nullptr )
+    {
+      succeeded[ w ] = decodeBlocks( tiff, w, numberOfWorkUnits );
+      TIFFClose( tiff );
+    }
+  }, nullptr );
 
-    _TIFFfree( tilebuf );
-  }
-  else
+  for( std::size_t w = 0; w < numberOfWorkUnits; ++w )
   {
-    // if not tiled then img is stripped
-    itkExceptionMacro( << "mevisIO:read(): non-tiled dcm/tiff reading not (yet) implemented" );
-    return;
+    if( !succeeded[ w ] )
+    {
+      itkExceptionMacro( << "mevisIO:read(): error reading " << ( m_IsTiled ? "tile" : "strip" )
+                         << " from " << m_TiffFileName );
+    }
   }
   return;
 }
@@ -1281,6 +1105,9 @@ MevisDicomTiffImageIO
     itkExceptionMacro( << "mevisIO:write(): dcm/tiff writer only supports 2D/3D/4D" );
   }
 
+  // the kept dcm header is not that of the written file
+  m_DcmHeaderFileName = "";
+
   std::ofstream dcmfile( m_DcmFileName.c_str(), std::ios::out | std::ios::binary );
   if( !dcmfile.is_open() )
   {
@@ -26,6 +26,7 @@
 #include "itk_tiff.h"
 #include "gdcmTag.h"
 #include "gdcmAttribute.h"
+#include "gdcmDataSet.h"
 
 #include <fstream>
 #include <string>
@@ -98,6 +99,10 @@ namespace itk
  *  18 apr 2011
  *    added reading dicom tags from sequences of tags, suggestion and
  *    code proposal by Reinhard Hameeteman
+ *  streamed reading
+ *    stripped 2D tiff images can be read, the tiles (or strips) are
+ *    decoded by multiple threads, and only those that overlap the
+ *    requested region are read. The dcm header is read once.
  *
  *  email: rashindra@gmail.com
  *
@@ -132,9 +137,10 @@ public:
 
   virtual void Write( const void * buffer );
 
+  /** Only the tiles (or strips) that overlap the requested region are read. */
   virtual bool CanStreamRead()
   {
-    return false;
+    return true;
   }
 
 
@@ -162,6 +168,10 @@ private:
   std::string m_DcmFileName;
   std::string m_TiffFileName;
 
+  // the dcm header read by CanReadFile(), reused by ReadImageInformation()
+  gdcm::DataSet m_DcmHeader;
+  std::string   m_DcmHeaderFileName;
+
   TIFF *         m_TIFFImage;
   unsigned int   m_TIFFDimension;
   bool           m_IsOpen;
@@ -0,0 +1,173 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkGPUAdvancedMeanSquaresImageToImageMetric_h
+#define __itkGPUAdvancedMeanSquaresImageToImageMetric_h
+
+#include "itkArray.h"
+#include "itkGPUDataManager.h"
+#include "itkGPUImage.h"
+#include "itkOpenCLKernelManager.h"
+
+#include <vector>
+
+namespace itk
+{
+/** Create a helper GPU Kernel class for GPUAdvancedMeanSquaresImageToImageMetric */
+itkGPUKernelClassMacro( GPUAdvancedMeanSquaresImageToImageMetricKernel );
+
+/** \class GPUAdvancedMeanSquaresImageToImageMetric
+ * \brief Computes the value and derivative of the
+ * AdvancedMeanSquaresImageToImageMetric with OpenCL.
+ *
+ * This class evaluates the sum of squared differences over a set of fixed
+ * image samples, and its derivative with respect to the parameters of a
+ * B-spline transform, for a 3D moving image that is interpolated linearly.
+ * It is not a metric itself: the caller supplies the samples, the moving
+ * image and the geometry of the B-spline grid, and normalizes the sums, see
+ * the OpenCLAdvancedMeanSquaresMetric of elastix.
+ *
+ * One work item processes one sample. It maps the sample with the
+ * functions of GPUBSplineTransform.cl, and keeps the B-spline weights to
+ * compute the derivative. The squared differences and the number of valid
+ * samples are reduced in local memory, to one partial sum per work group,
+ * which are added on the host in double precision. The derivative terms of
+ * the parameters in the support of a sample are added to the derivative with
+ * atomics, so the derivative is scattered sparsely on the device.
+ *
+ * The samples and the moving image are copied to the device only when they
+ * are set, so once per resolution for a full sampler, and the parameters
+ * and the derivative once per call. The device works in single precision.
+ *
+ * \ingroup GPUCommon
+ */
+template< typename TFixedImage, typename TMovingImage >
+class ITK_EXPORT GPUAdvancedMeanSquaresImageToImageMetric : public Object
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef GPUAdvancedMeanSquaresImageToImageMetric Self;
+  typedef Object                                   Superclass;
+  typedef SmartPointer< Self >                     Pointer;
+  typedef SmartPointer< const Self >               ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( GPUAdvancedMeanSquaresImageToImageMetric, Object );
+
+  /** The dimension of the images. */
+  itkStaticConstMacro( ImageDimension, unsigned int, TMovingImage::ImageDimension );
+
+  /** Typedefs. */
+  typedef TFixedImage                                  FixedImageType;
+  typedef TMovingImage                                 MovingImageType;
+  typedef Array< double >                              ParametersType;
+  typedef Array< double >                              DerivativeType;
+  typedef GPUImage< float, ImageDimension >            GPUImageType;
+  typedef typename GPUImageType::Pointer               GPUImagePointer;
+  typedef typename GPUDataManager::Pointer             GPUDataManagerPointer;
+  typedef typename FixedImageType::PointType           FixedImagePointType;
+  typedef ImageBase< ImageDimension >                  GridImageType;
+
+  /** Copy the moving image to the device, in single precision. The image
+   * has to start at index zero, and to be buffered completely.
+   */
+  void SetMovingImage( const MovingImageType * movingImage );
+
+  /** Set the fixed image samples, as a point and a value per sample. The
+   * samples are copied to the device.
+   */
+  void SetFixedSamples( const std::vector< FixedImagePointType > & points,
+    const std::vector< float > & values );
+
+  /** Set the spline order and the geometry of the B-spline grid, for
+   * example of a coefficient image of the transform. The grid has to start
+   * at index zero.
+   */
+  void SetGrid( const GridImageType * grid, const unsigned int splineOrder );
+
+  /** Compute the sum of the squared differences over the samples that map
+   * inside the moving image, the derivative of this sum with respect to the
+   * parameters, and the number of these samples. The parameters and the
+   * derivative are in the layout of the B-spline transform.
+   */
+  void GetValueAndDerivative( const ParametersType & parameters,
+    double & measure, DerivativeType & derivative,
+    SizeValueType & numberOfPixelsCounted );
+
+  /** As above, over the first numberOfSamples samples only, so that the
+   * other samples can be evaluated on the CPU meanwhile.
+   */
+  void GetValueAndDerivative( const ParametersType & parameters,
+    double & measure, DerivativeType & derivative,
+    SizeValueType & numberOfPixelsCounted, const SizeValueType numberOfSamples );
+
+  /** Get the number of samples that have been set. */
+  itkGetConstMacro( NumberOfSamples, unsigned int );
+
+protected:
+
+  GPUAdvancedMeanSquaresImageToImageMetric();
+  ~GPUAdvancedMeanSquaresImageToImageMetric() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  GPUAdvancedMeanSquaresImageToImageMetric( const Self & ); // purposely not implemented
+  void operator=( const Self & );                           // purposely not implemented
+
+  /** Allocate a device buffer for a CPU buffer and copy it to the device. */
+  static void CopyToDevice( GPUDataManagerPointer & manager,
+    void * buffer, const std::size_t size, const cl_mem_flags flags );
+
+  OpenCLKernelManager::Pointer m_KernelManager;
+  std::size_t                  m_KernelHandle;
+  std::size_t                  m_LocalSize;
+
+  GPUImagePointer       m_GPUMovingImage;
+  GPUDataManagerPointer m_GPUMovingImageBase;
+  GPUImagePointer       m_GridImage;
+  GPUDataManagerPointer m_GPUGridImageBase;
+  unsigned int          m_SplineOrder;
+  unsigned int          m_NumberOfSamples;
+
+  /** The CPU buffers of the device buffers. */
+  std::vector< float > m_FixedPoints;
+  std::vector< float > m_FixedValues;
+  std::vector< float > m_Parameters;
+  std::vector< float > m_Derivative;
+  std::vector< float > m_PartialSums;
+
+  GPUDataManagerPointer m_GPUFixedPoints;
+  GPUDataManagerPointer m_GPUFixedValues;
+  GPUDataManagerPointer m_GPUParameters;
+  GPUDataManagerPointer m_GPUDerivative;
+  GPUDataManagerPointer m_GPUPartialSums;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkGPUAdvancedMeanSquaresImageToImageMetric.hxx"
+#endif
+
+#endif /* __itkGPUAdvancedMeanSquaresImageToImageMetric_h */
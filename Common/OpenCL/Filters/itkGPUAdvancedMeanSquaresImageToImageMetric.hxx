@@ -0,0 +1,363 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkGPUAdvancedMeanSquaresImageToImageMetric_hxx
+#define __itkGPUAdvancedMeanSquaresImageToImageMetric_hxx
+
+#include "itkGPUAdvancedMeanSquaresImageToImageMetric.h"
+#include "itkGPUBSplineBaseTransform.h"
+#include "itkGPUImageBase.h"
+#include "itkGPUKernelManagerHelperFunctions.h"
+#include "itkGPUMath.h"
+#include "itkOpenCLContext.h"
+#include "itkOpenCLDevice.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+/**
+ * ****************** Constructor ***********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+GPUAdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::GPUAdvancedMeanSquaresImageToImageMetric()
+{
+  if( ImageDimension != 3 )
+  {
+    itkExceptionMacro( "GPUAdvancedMeanSquaresImageToImageMetric supports 3D images." );
+  }
+
+  this->m_SplineOrder     = 3;
+  this->m_NumberOfSamples = 0;
+
+  this->m_GPUMovingImageBase = GPUDataManager::New();
+  this->m_GPUGridImageBase   = GPUDataManager::New();
+  this->m_GPUFixedPoints     = GPUDataManager::New();
+  this->m_GPUFixedValues     = GPUDataManager::New();
+  this->m_GPUParameters      = GPUDataManager::New();
+  this->m_GPUDerivative      = GPUDataManager::New();
+  this->m_GPUPartialSums     = GPUDataManager::New();
+
+  // The local reduction needs a power of two work group size
+  this->m_KernelManager = OpenCLKernelManager::New();
+  const std::size_t maximumLocalSize = std::min< std::size_t >( 256,
+    this->m_KernelManager->GetContext()->GetDefaultDevice().GetMaximumWorkItemsPerGroup() );
+  this->m_LocalSize = 1;
+  while( 2 * this->m_LocalSize <= maximumLocalSize )
+  {
+    this->m_LocalSize *= 2;
+  }
+
+  std::ostringstream defines;
+  defines << "#define DIM_" << int(ImageDimension) << "\n";
+  defines << "#define INPIXELTYPE float\n";
+
+  // The kernel needs the GPUMath, GPUImageBase and GPUBSplineTransform sources
+  std::ostringstream source;
+  source << GPUMathKernel::GetOpenCLSource();
+  source << GPUImageBaseKernel::GetOpenCLSource();
+  source << GPUBSplineTransformKernel::GetOpenCLSource();
+  source << GPUAdvancedMeanSquaresImageToImageMetricKernel::GetOpenCLSource();
+
+  // Build and create kernel
+  const OpenCLProgram program = this->m_KernelManager->BuildProgramFromSourceCode(
+    source.str(), defines.str() );
+  if( program.IsNull() )
+  {
+    itkExceptionMacro( << "Kernel has not been loaded from string:\n"
+                       << defines.str() << std::endl << source.str() );
+  }
+  this->m_KernelHandle
+    = this->m_KernelManager->CreateKernel( program, "AdvancedMeanSquaresValueAndDerivative" );
+
+} // end Constructor
+
+
+/**
+ * ****************** CopyToDevice ***********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+GPUAdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::CopyToDevice( GPUDataManagerPointer & manager,
+  void * buffer, const std::size_t size, const cl_mem_flags flags )
+{
+  manager->Initialize();
+  manager->SetBufferFlag( flags );
+  manager->SetBufferSize( static_cast< unsigned int >( size ) );
+  manager->Allocate();
+  manager->SetCPUBufferPointer( buffer );
+  manager->SetGPUDirtyFlag( true );
+  manager->UpdateGPUBuffer();
+
+} // end CopyToDevice()
+
+
+/**
+ * ****************** SetMovingImage ***********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+GPUAdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::SetMovingImage( const MovingImageType * movingImage )
+{
+  if( movingImage->GetBufferedRegion() != movingImage->GetLargestPossibleRegion() )
+  {
+    itkExceptionMacro( "The moving image has to be buffered completely." );
+  }
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    if( movingImage->GetLargestPossibleRegion().GetIndex()[ i ] != 0 )
+    {
+      itkExceptionMacro( "The moving image has to start at index zero." );
+    }
+  }
+
+  // Convert the moving image to float on the host
+  GPUImagePointer gpuMovingImage = GPUImageType::New();
+  gpuMovingImage->CopyInformation( movingImage );
+  gpuMovingImage->SetRegions( movingImage->GetBufferedRegion() );
+  gpuMovingImage->Allocate();
+
+  const SizeValueType numberOfPixels = movingImage->GetBufferedRegion().GetNumberOfPixels();
+  const typename MovingImageType::PixelType * in = movingImage->GetBufferPointer();
+  float *                                     out = gpuMovingImage->GetBufferPointer();
+  for( SizeValueType i = 0; i < numberOfPixels; ++i )
+  {
+    out[ i ] = static_cast< float >( in[ i ] );
+  }
+
+  // Copy it to the device once
+  gpuMovingImage->GetGPUDataManager()->SetCPUBufferLock( true );
+  gpuMovingImage->GetGPUDataManager()->SetGPUDirtyFlag( true );
+  gpuMovingImage->GetGPUDataManager()->UpdateGPUBuffer();
+
+  this->m_GPUMovingImage = gpuMovingImage;
+  this->Modified();
+
+} // end SetMovingImage()
+
+
+/**
+ * ****************** SetFixedSamples ***********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+GPUAdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::SetFixedSamples( const std::vector< FixedImagePointType > & points,
+  const std::vector< float > & values )
+{
+  this->m_NumberOfSamples = static_cast< unsigned int >( points.size() );
+  this->m_FixedPoints.resize( ImageDimension * points.size() );
+  for( std::size_t i = 0; i < points.size(); ++i )
+  {
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      this->m_FixedPoints[ ImageDimension * i + d ] = static_cast< float >( points[ i ][ d ] );
+    }
+  }
+  this->m_FixedValues = values;
+
+  // Every work group writes a partial measure and count
+  const std::size_t numberOfGroups
+    = ( this->m_NumberOfSamples + this->m_LocalSize - 1 ) / this->m_LocalSize;
+  this->m_PartialSums.assign( 2 * std::max< std::size_t >( numberOfGroups, 1 ), 0.0f );
+
+  if( this->m_NumberOfSamples > 0 )
+  {
+    Self::CopyToDevice( this->m_GPUFixedPoints, this->m_FixedPoints.data(),
+      this->m_FixedPoints.size() * sizeof( float ), CL_MEM_READ_ONLY );
+    Self::CopyToDevice( this->m_GPUFixedValues, this->m_FixedValues.data(),
+      this->m_FixedValues.size() * sizeof( float ), CL_MEM_READ_ONLY );
+  }
+  Self::CopyToDevice( this->m_GPUPartialSums, this->m_PartialSums.data(),
+    this->m_PartialSums.size() * sizeof( float ), CL_MEM_WRITE_ONLY );
+  this->Modified();
+
+} // end SetFixedSamples()
+
+
+/**
+ * ****************** SetGrid ***********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+GPUAdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::SetGrid( const GridImageType * grid, const unsigned int splineOrder )
+{
+  if( splineOrder > 3 )
+  {
+    itkExceptionMacro( "The B-spline grid supports orders 0 to 3." );
+  }
+  for( unsigned int i = 0; i < ImageDimension; ++i )
+  {
+    if( grid->GetLargestPossibleRegion().GetIndex()[ i ] != 0 )
+    {
+      itkExceptionMacro( "The B-spline grid has to start at index zero." );
+    }
+  }
+
+  // Only the geometry of the grid is used
+  this->m_GridImage = GPUImageType::New();
+  this->m_GridImage->CopyInformation( grid );
+  this->m_SplineOrder = splineOrder;
+  this->Modified();
+
+} // end SetGrid()
+
+
+/**
+ * ****************** GetValueAndDerivative ***********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+GPUAdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivative( const ParametersType & parameters,
+  double & measure, DerivativeType & derivative,
+  SizeValueType & numberOfPixelsCounted )
+{
+  this->GetValueAndDerivative( parameters, measure, derivative,
+    numberOfPixelsCounted, this->m_NumberOfSamples );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ****************** GetValueAndDerivative ***********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+GPUAdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivative( const ParametersType & parameters,
+  double & measure, DerivativeType & derivative,
+  SizeValueType & numberOfPixelsCounted, const SizeValueType numberOfSamplesToEvaluate )
+{
+  if( this->m_GPUMovingImage.IsNull() || this->m_GridImage.IsNull() )
+  {
+    itkExceptionMacro( "The moving image and the B-spline grid have to be set." );
+  }
+
+  const SizeValueType numberOfParameters = parameters.GetSize();
+  measure               = 0.0;
+  numberOfPixelsCounted = 0;
+  derivative.SetSize( numberOfParameters );
+  derivative.Fill( 0.0 );
+  const cl_uint numberOfSamples = static_cast< cl_uint >(
+    std::min< SizeValueType >( numberOfSamplesToEvaluate, this->m_NumberOfSamples ) );
+  if( numberOfSamples == 0 )
+  {
+    return;
+  }
+
+  // Copy the parameters, and a zero derivative, to the device
+  this->m_Parameters.resize( numberOfParameters );
+  for( SizeValueType i = 0; i < numberOfParameters; ++i )
+  {
+    this->m_Parameters[ i ] = static_cast< float >( parameters[ i ] );
+  }
+  this->m_Derivative.assign( numberOfParameters, 0.0f );
+  Self::CopyToDevice( this->m_GPUParameters, this->m_Parameters.data(),
+    numberOfParameters * sizeof( float ), CL_MEM_READ_ONLY );
+  Self::CopyToDevice( this->m_GPUDerivative, this->m_Derivative.data(),
+    numberOfParameters * sizeof( float ), CL_MEM_READ_WRITE );
+
+  // Set the arguments
+  const cl_uint splineOrder = this->m_SplineOrder;
+  cl_uint       argidx      = 0;
+  this->m_KernelManager->SetKernelArgWithImage(
+    this->m_KernelHandle, argidx++, this->m_GPUFixedPoints );
+  this->m_KernelManager->SetKernelArgWithImage(
+    this->m_KernelHandle, argidx++, this->m_GPUFixedValues );
+  this->m_KernelManager->SetKernelArg(
+    this->m_KernelHandle, argidx++, sizeof( cl_uint ), &numberOfSamples );
+  SetKernelWithITKImage< GPUImageType >( this->m_KernelManager,
+    this->m_KernelHandle, argidx, this->m_GPUMovingImage,
+    this->m_GPUMovingImageBase, true, true );
+  this->m_KernelManager->SetKernelArgWithImage(
+    this->m_KernelHandle, argidx++, this->m_GPUParameters );
+  SetKernelWithITKImage< GPUImageType >( this->m_KernelManager,
+    this->m_KernelHandle, argidx, this->m_GridImage,
+    this->m_GPUGridImageBase, false, true );
+  this->m_KernelManager->SetKernelArg(
+    this->m_KernelHandle, argidx++, sizeof( cl_uint ), &splineOrder );
+  this->m_KernelManager->SetKernelArgWithImage(
+    this->m_KernelHandle, argidx++, this->m_GPUDerivative );
+  this->m_KernelManager->SetKernelArgWithImage(
+    this->m_KernelHandle, argidx++, this->m_GPUPartialSums );
+  this->m_KernelManager->SetKernelArg(
+    this->m_KernelHandle, argidx++, this->m_LocalSize * sizeof( cl_float ), nullptr );
+  this->m_KernelManager->SetKernelArg(
+    this->m_KernelHandle, argidx++, this->m_LocalSize * sizeof( cl_float ), nullptr );
+
+  // Launch one work item per sample, in the groups of these samples only
+  const std::size_t numberOfGroups
+    = ( numberOfSamples + this->m_LocalSize - 1 ) / this->m_LocalSize;
+  OpenCLEvent event = this->m_KernelManager->LaunchKernel( this->m_KernelHandle,
+    OpenCLSize( numberOfGroups * this->m_LocalSize ), OpenCLSize( this->m_LocalSize ) );
+  event.WaitForFinished();
+
+  // Copy the derivative and the partial sums back, and add the latter
+  this->m_GPUDerivative->SetCPUDirtyFlag( true );
+  this->m_GPUDerivative->UpdateCPUBuffer();
+  this->m_GPUPartialSums->SetCPUDirtyFlag( true );
+  this->m_GPUPartialSums->UpdateCPUBuffer();
+
+  double count = 0.0;
+  for( std::size_t i = 0; i < numberOfGroups; ++i )
+  {
+    measure += this->m_PartialSums[ 2 * i ];
+    count   += this->m_PartialSums[ 2 * i + 1 ];
+  }
+  numberOfPixelsCounted = static_cast< SizeValueType >( count + 0.5 );
+  for( SizeValueType i = 0; i < numberOfParameters; ++i )
+  {
+    derivative[ i ] = this->m_Derivative[ i ];
+  }
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ****************** PrintSelf ***********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+GPUAdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "NumberOfSamples: " << this->m_NumberOfSamples << std::endl;
+  os << indent << "SplineOrder: " << this->m_SplineOrder << std::endl;
+  os << indent << "LocalSize: " << this->m_LocalSize << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif /* __itkGPUAdvancedMeanSquaresImageToImageMetric_hxx */
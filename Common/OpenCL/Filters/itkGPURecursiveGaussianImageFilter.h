@@ -20,6 +20,9 @@
 
 #include "itkRecursiveGaussianImageFilter.h"
 #include "itkGPUInPlaceImageFilter.h"
+#include "itkGPUDataManager.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -29,6 +32,16 @@ itkGPUKernelClassMacro( GPURecursiveGaussianImageFilterKernel );
 /** \class GPURecursiveGaussianImageFilter
  * \brief GPU version of RecursiveGaussianImageFilter.
  *
+ * The recursion runs along one line per work item, which uses the GPU
+ * poorly and reads strided along y and z. Therefore, for the zero order and
+ * a sigma of at most MaximumFIRSigma voxels along the direction, the filter
+ * convolves with the impulse response of the recursion instead, truncated at
+ * twelve sigma, where it has decayed below single precision, and scaled to
+ * the gain of the recursion. One work item computes one pixel, from a tile
+ * of the image in local memory. This gives
+ * the result of the recursion up to the truncation, also for lines that are
+ * too long for the recursion on the device.
+ *
  * \author Denis P. Shamonin and Marius Staring. Division of Image Processing,
  * Department of Radiology, Leiden, The Netherlands
  *
@@ -76,6 +89,14 @@ public:
   itkStaticConstMacro( OutputImageDimension, unsigned int,
     TOutputImage::ImageDimension );
 
+  /** Set/Get the largest sigma, in voxels along the direction, for which the
+   * zero order is computed by the FIR convolution. Set it to zero to always
+   * use the recursion. The default is 4, which covers the default smoothing
+   * schedules of the pyramids.
+   */
+  itkSetMacro( MaximumFIRSigma, ScalarRealType );
+  itkGetConstMacro( MaximumFIRSigma, ScalarRealType );
+
 protected:
 
   GPURecursiveGaussianImageFilter();
@@ -90,8 +111,27 @@ private:
   GPURecursiveGaussianImageFilter( const Self & ); // purposely not implemented
   void operator=( const Self & );                  // purposely not implemented
 
+  /** Compute the weights of the FIR convolution: the impulse response of
+   * the recursion, truncated at \a radius.
+   */
+  void ComputeFIRWeights( const unsigned int radius );
+
+  /** Convolve \a inputData with the FIR weights along the direction, to
+   * \a outputData. Returns false if the tile of the work group does not
+   * fit in the local memory of the device.
+   */
+  bool GPUGenerateDataWithFIR( const GPUDataManager::Pointer & inputData,
+    const GPUDataManager::Pointer & outputData,
+    const typename TOutputImage::SizeType & size, const unsigned int radius );
+
   std::size_t m_FilterGPUKernelHandle;
+  std::size_t m_FIRGPUKernelHandle;
   std::size_t m_DeviceLocalMemorySize;
+
+  ScalarRealType          m_MaximumFIRSigma;
+  std::vector< float >    m_FIRWeights;
+  GPUDataManager::Pointer m_GPUFIRWeights;
+  GPUDataManager::Pointer m_GPUFIRScratch;
 };
 
 } // end namespace itk
@@ -23,6 +23,9 @@
 #include "itkOpenCLEvent.h"
 #include "itkOpenCLDevice.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace itk
 {
 template< typename TInputImage, typename TOutputImage >
@@ -31,6 +34,10 @@ GPURecursiveGaussianImageFilter< TInputImage, TOutputImage >
 {
   std::ostringstream defines;
 
+  this->m_MaximumFIRSigma = 4.0;
+  this->m_GPUFIRWeights   = GPUDataManager::New();
+  this->m_GPUFIRScratch   = GPUDataManager::New();
+
   if( TInputImage::ImageDimension > 3 || TInputImage::ImageDimension < 1 )
   {
     itkExceptionMacro( "GPURecursiveGaussianImageFilter supports 1/2/3D image." );
@@ -73,6 +80,7 @@ GPURecursiveGaussianImageFilter< TInputImage, TOutputImage >
   if( !program.IsNull() )
   {
     this->m_FilterGPUKernelHandle = this->m_GPUKernelManager->CreateKernel( program, "RecursiveGaussianImageFilter" );
+    this->m_FIRGPUKernelHandle    = this->m_GPUKernelManager->CreateKernel( program, "GaussianFIRImageFilter" );
   }
   else
   {
@@ -111,6 +119,21 @@ GPURecursiveGaussianImageFilter< TInputImage, TOutputImage >
   const unsigned int ln       = outSize[ this->GetDirection() ];
   const unsigned int ImageDim = (unsigned int)( TInputImage::ImageDimension );
 
+  // Convolve with the FIR weights for the zero order and small and medium
+  // sigmas, and fall back to the recursion if the tile does not fit.
+  const double sigma = this->GetSigma() / inPtr->GetSpacing()[ this->GetDirection() ];
+  if( this->GetOrder() == CPUSuperclass::ZeroOrder
+    && sigma > 0.0 && sigma <= this->m_MaximumFIRSigma )
+  {
+    const unsigned int radius = static_cast< unsigned int >( std::ceil( 12.0 * sigma ) );
+    if( this->GPUGenerateDataWithFIR( inPtr->GetGPUDataManager(),
+      otPtr->GetGPUDataManager(), outSize, radius ) )
+    {
+      itkDebugMacro( << "GPURecursiveGaussianImageFilter::GPUGenerateData() finished with FIR" );
+      return;
+    }
+  }
+
   // Check if GPU filter are able to perform for this image
   if( ln > this->m_DeviceLocalMemorySize )
   {
@@ -258,6 +281,179 @@ GPURecursiveGaussianImageFilter< TInputImage, TOutputImage >
 }
 
 
+//------------------------------------------------------------------------------
+template< typename TInputImage, typename TOutputImage >
+void
+GPURecursiveGaussianImageFilter< TInputImage, TOutputImage >
+::ComputeFIRWeights( const unsigned int radius )
+{
+  // Filter an impulse in the middle of a zero line, twice as long as the
+  // weights, with the recursion of filter_data_array(). The four zeros of
+  // padding at both ends stand for the samples before and after the line.
+  const unsigned int padding = 4;
+  const unsigned int length  = 4 * radius + 1;
+  const unsigned int center  = padding + 2 * radius;
+
+  std::vector< double > impulse( length + 2 * padding, 0.0 );
+  std::vector< double > causal( impulse.size(), 0.0 );
+  std::vector< double > antiCausal( impulse.size(), 0.0 );
+  impulse[ center ] = 1.0;
+
+  for( unsigned int i = padding; i < padding + length; ++i )
+  {
+    causal[ i ]
+      = this->m_N0 * impulse[ i ] + this->m_N1 * impulse[ i - 1 ]
+      + this->m_N2 * impulse[ i - 2 ] + this->m_N3 * impulse[ i - 3 ]
+      - this->m_D1 * causal[ i - 1 ] - this->m_D2 * causal[ i - 2 ]
+      - this->m_D3 * causal[ i - 3 ] - this->m_D4 * causal[ i - 4 ];
+  }
+  for( unsigned int i = padding + length; i-- > padding; )
+  {
+    antiCausal[ i ]
+      = this->m_M1 * impulse[ i + 1 ] + this->m_M2 * impulse[ i + 2 ]
+      + this->m_M3 * impulse[ i + 3 ] + this->m_M4 * impulse[ i + 4 ]
+      - this->m_D1 * antiCausal[ i + 1 ] - this->m_D2 * antiCausal[ i + 2 ]
+      - this->m_D3 * antiCausal[ i + 3 ] - this->m_D4 * antiCausal[ i + 4 ];
+  }
+
+  // Truncate the response at the radius, and scale it to the gain of the
+  // whole response. The weights are reversed, the kernel convolves from
+  // radius pixels before the pixel to radius pixels after it.
+  double gain = 0.0, truncatedGain = 0.0;
+  for( unsigned int i = padding; i < padding + length; ++i )
+  {
+    const double response = causal[ i ] + antiCausal[ i ];
+    gain += response;
+    if( i + radius >= center && i <= center + radius )
+    {
+      truncatedGain += response;
+    }
+  }
+
+  this->m_FIRWeights.resize( 2 * radius + 1 );
+  const double scale = truncatedGain != 0.0 ? gain / truncatedGain : 1.0;
+  for( unsigned int k = 0; k <= 2 * radius; ++k )
+  {
+    const unsigned int i = center + radius - k;
+    this->m_FIRWeights[ k ] = static_cast< float >( scale * ( causal[ i ] + antiCausal[ i ] ) );
+  }
+}
+
+
+//------------------------------------------------------------------------------
+template< typename TInputImage, typename TOutputImage >
+bool
+GPURecursiveGaussianImageFilter< TInputImage, TOutputImage >
+::GPUGenerateDataWithFIR( const GPUDataManager::Pointer & inputData,
+  const GPUDataManager::Pointer & outputData,
+  const typename TOutputImage::SizeType & size, const unsigned int radius )
+{
+  const unsigned int direction = this->GetDirection();
+  const unsigned int ImageDim  = (unsigned int)( TInputImage::ImageDimension );
+  OpenCLContext *    context   = this->m_GPUKernelManager->GetContext();
+  const OpenCLDevice device    = context->GetActiveDevice();
+
+  // The work group spans 16 or more pixels along the direction, and along x
+  // for coalesced loads. Unused dimensions have size one.
+  std::size_t localSize[ 3 ] = { 1, 1, 1 };
+  if( direction == 0 )
+  {
+    localSize[ 0 ] = 64;
+    localSize[ 1 ] = ImageDim > 1 ? 4 : 1;
+  }
+  else
+  {
+    localSize[ 0 ]         = 16;
+    localSize[ direction ] = 16;
+  }
+  while( localSize[ 0 ] * localSize[ 1 ] * localSize[ 2 ] > device.GetMaximumWorkItemsPerGroup() )
+  {
+    *std::max_element( localSize, localSize + 3 ) /= 2;
+  }
+
+  // The tile is the work group extended by the radius along the direction
+  std::size_t tileSize[ 3 ] = { localSize[ 0 ], localSize[ 1 ], localSize[ 2 ] };
+  tileSize[ direction ] += 2 * radius;
+  const std::size_t tileBytes = tileSize[ 0 ] * tileSize[ 1 ] * tileSize[ 2 ] * sizeof( float );
+  if( tileBytes > device.GetLocalMemorySize() )
+  {
+    return false;
+  }
+
+  cl_uint     imageSize[ 3 ] = { 1, 1, 1 };
+  std::size_t globalSize[ 3 ];
+  for( unsigned int i = 0; i < ImageDim; i++ )
+  {
+    imageSize[ i ] = static_cast< cl_uint >( size[ i ] );
+  }
+  for( unsigned int i = 0; i < 3; i++ )
+  {
+    globalSize[ i ] = ( ( imageSize[ i ] + localSize[ i ] - 1 ) / localSize[ i ] ) * localSize[ i ];
+  }
+
+  // Copy the weights to the device
+  this->ComputeFIRWeights( radius );
+  this->m_GPUFIRWeights->Initialize();
+  this->m_GPUFIRWeights->SetBufferFlag( CL_MEM_READ_ONLY );
+  this->m_GPUFIRWeights->SetBufferSize( static_cast< unsigned int >( this->m_FIRWeights.size() * sizeof( float ) ) );
+  this->m_GPUFIRWeights->Allocate();
+  this->m_GPUFIRWeights->SetCPUBufferPointer( this->m_FIRWeights.data() );
+  this->m_GPUFIRWeights->SetGPUDirtyFlag( true );
+  this->m_GPUFIRWeights->UpdateGPUBuffer();
+
+  // When running in place, the work groups would overwrite the pixels that
+  // their neighbours read, so the pixels are read from a copy of the input.
+  GPUDataManager::Pointer source = inputData;
+  if( inputData->GetBufferSize() > 0
+    && *inputData->GetGPUBufferPointer() == *outputData->GetGPUBufferPointer() )
+  {
+    inputData->UpdateGPUBuffer();
+    if( this->m_GPUFIRScratch->GetBufferSize() != inputData->GetBufferSize() )
+    {
+      this->m_GPUFIRScratch->Initialize();
+      this->m_GPUFIRScratch->SetBufferFlag( CL_MEM_READ_WRITE );
+      this->m_GPUFIRScratch->SetBufferSize( inputData->GetBufferSize() );
+      this->m_GPUFIRScratch->Allocate();
+    }
+    const cl_int error = clEnqueueCopyBuffer( context->GetCommandQueue().GetQueueId(),
+      *inputData->GetGPUBufferPointer(), *this->m_GPUFIRScratch->GetGPUBufferPointer(),
+      0, 0, inputData->GetBufferSize(), 0, nullptr, nullptr );
+    context->ReportError( error, __FILE__, __LINE__, ITK_LOCATION );
+    source = this->m_GPUFIRScratch;
+  }
+
+  // Arguments set up
+  const cl_uint firRadius    = radius;
+  const cl_uint firDirection = direction;
+  int           argidx       = 0;
+  this->m_GPUKernelManager->SetKernelArgWithImage( this->m_FIRGPUKernelHandle,
+    argidx++, source );
+  this->m_GPUKernelManager->SetKernelArgWithImage( this->m_FIRGPUKernelHandle,
+    argidx++, outputData );
+  this->m_GPUKernelManager->SetKernelArgWithImage( this->m_FIRGPUKernelHandle,
+    argidx++, this->m_GPUFIRWeights );
+  this->m_GPUKernelManager->SetKernelArg( this->m_FIRGPUKernelHandle,
+    argidx++, sizeof( cl_uint ), &( firRadius ) );
+  this->m_GPUKernelManager->SetKernelArg( this->m_FIRGPUKernelHandle,
+    argidx++, sizeof( cl_uint ), &( firDirection ) );
+  for( unsigned int i = 0; i < 3; i++ )
+  {
+    this->m_GPUKernelManager->SetKernelArg( this->m_FIRGPUKernelHandle,
+      argidx++, sizeof( cl_uint ), &( imageSize[ i ] ) );
+  }
+  this->m_GPUKernelManager->SetKernelArg( this->m_FIRGPUKernelHandle,
+    argidx++, tileBytes, nullptr );
+
+  // Launch kernel
+  OpenCLEvent event = this->m_GPUKernelManager->LaunchKernel( this->m_FIRGPUKernelHandle,
+    OpenCLSize( globalSize[ 0 ], globalSize[ 1 ], globalSize[ 2 ] ),
+    OpenCLSize( localSize[ 0 ], localSize[ 1 ], localSize[ 2 ] ) );
+  event.WaitForFinished();
+
+  return true;
+}
+
+
 //------------------------------------------------------------------------------
 template< typename TInputImage, typename TOutputImage >
 void
@@ -266,6 +462,7 @@ GPURecursiveGaussianImageFilter< TInputImage, TOutputImage >
 {
   CPUSuperclass::PrintSelf( os, indent );
   GPUSuperclass::PrintSelf( os, indent );
+  os << indent << "MaximumFIRSigma: " << this->m_MaximumFIRSigma << std::endl;
 }
 
 
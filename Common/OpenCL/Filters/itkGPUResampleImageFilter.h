@@ -95,6 +95,11 @@ public:
   typedef GPUCompositeTransformBase<
     InterpolatorPrecisionType, InputImageDimension > CompositeTransformBaseType;
 
+  /** Typedefs for the transform that is evaluated on the host. */
+  typedef Transform< double, OutputImageDimension,
+    InputImageDimension >                           HostTransformType;
+  typedef typename HostTransformType::ConstPointer HostTransformConstPointer;
+
   /** Typedefs for the B-spline interpolator. */
   typedef GPUBSplineInterpolateImageFunction< InputImageType,
     InterpolatorPrecisionType >                                           GPUBSplineInterpolatorType;
@@ -115,11 +120,30 @@ public:
   /** Set the transform. */
   virtual void SetTransform( const TransformType * _arg );
 
+  /** Set/Get a transform that is evaluated on the host. This is meant for
+   * transforms that have no OpenCL implementation. If set, the points of
+   * each split are mapped with this transform on the host, in parallel, and
+   * copied to the device, where only the interpolation is performed. The
+   * transform set with SetTransform() is then not used, and does not have to
+   * be a GPU transform. The host computes the next split while the device
+   * interpolates the current one. Default is nullptr. */
+  itkSetConstObjectMacro( HostTransform, HostTransformType );
+  itkGetConstObjectMacro( HostTransform, HostTransformType );
+
   /** Set/Get the requested number of splits on OpenCL device.
    * Only works for 3D images. For 1D, 2D are always equal 1. */
   itkSetMacro( RequestedNumberOfSplits, unsigned int );
   itkGetConstMacro( RequestedNumberOfSplits, unsigned int );
 
+  /** Set/Get whether the output is copied to the host asynchronously.
+   * If enabled and the image is processed in more than one split, each
+   * split is copied back on a separate command queue, through two pinned
+   * host buffers, while the next split is being computed. Otherwise the
+   * whole output is copied after the last split. Default is false. */
+  itkSetMacro( UseAsynchronousTransfer, bool );
+  itkGetConstMacro( UseAsynchronousTransfer, bool );
+  itkBooleanMacro( UseAsynchronousTransfer );
+
 protected:
 
   GPUResampleImageFilter();
@@ -176,6 +200,28 @@ protected:
   GPUBSplineBaseTransformType * GetGPUBSplineBaseTransform(
     const std::size_t transformIndex );
 
+  /** Map the points of a split with the host transform, in the layout of the
+   * deformation field buffer. */
+  void ComputeMappedPointsOnHost( const OutputImageRegionType & chunkRegion,
+    float * points );
+
+  /** Typedefs for the multi-threaded computation of the mapped points. */
+  typedef MultiThreaderBase::WorkUnitInfo ThreadInfoType;
+  struct MappedPointsThreaderParameterType
+  {
+    Self *                st_Self;
+    OutputImageRegionType st_Region;
+    float *               st_Points;
+  };
+
+  /** Threader callback function for the mapped points. */
+  static ITK_THREAD_RETURN_TYPE ComputeMappedPointsThreaderCallback( void * arg );
+
+  /** Map the points of a part of a split, for one work unit. */
+  void ThreadedComputeMappedPoints( const OutputImageRegionType & chunkRegion,
+    float * points, const ThreadIdType threadId,
+    const ThreadIdType numberOfWorkUnits ) const;
+
 private:
 
   GPUResampleImageFilter( const Self & ); // purposely not implemented
@@ -189,6 +235,15 @@ private:
   GPUDataManagerPointer m_FilterParameters;
   GPUDataManagerPointer m_DeformationFieldBuffer;
   unsigned int          m_RequestedNumberOfSplits;
+  bool                  m_UseAsynchronousTransfer;
+
+  /** The command queue for the asynchronous transfers, on the device of
+   * the active command queue. */
+  OpenCLCommandQueue m_TransferQueue;
+  OpenCLDevice       m_TransferQueueDevice;
+
+  /** The transform that is evaluated on the host. */
+  HostTransformConstPointer m_HostTransform;
 
   typedef std::pair< int, bool >                            TransformHandle;
   typedef std::map< GPUTransformTypeEnum, TransformHandle > TransformsHandle;
@@ -25,9 +25,11 @@
 #include "itkGPUImageBase.h"
 
 #include "itkImageLinearIteratorWithIndex.h"
-#include "itkTimeProbe.h"
+#include "itkOpenCLProfilingTimeProbe.h"
 #include "itkImageRegionSplitterSlowDimension.h"
 
+#include <cstring>
+
 #include "itkOpenCLUtil.h"
 #include "itkOpenCLKernelToImageBridge.h"
 
@@ -81,6 +83,7 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   this->m_TransformBase    = nullptr;
 
   this->m_RequestedNumberOfSplits = 5;
+  this->m_UseAsynchronousTransfer = false;
 
   std::ostringstream defines;
   if( TInputImage::ImageDimension > 3 || TInputImage::ImageDimension < 1 )
@@ -390,10 +393,10 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
 {
   itkDebugMacro( << "GPUResampleImageFilter::GPUGenerateData() called" );
 
-  // Profiling
+  // Profiling, per device of a multi-device context
 #ifdef OPENCL_PROFILING
-  TimeProbe gputimer;
-  gputimer.Start();
+  OpenCLProfilingTimeProbe timer( "GPUResampleImageFilter::GPUGenerateData()",
+    this->m_PreKernelManager->GetContext()->GetActiveDevice() );
 #endif
 
   // Get handles to the input and output images
@@ -501,14 +504,27 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   this->m_DeformationFieldBuffer->SetBufferSize( mem_size_DF );
   this->m_DeformationFieldBuffer->Allocate();
 
-  // Set arguments for pre kernel
-  this->SetArgumentsForPreKernelManager( outPtr );
-
-  // Set arguments for loop kernel
-  this->SetArgumentsForLoopKernelManager( inPtr, outPtr );
-  if( !this->m_TransformIsCombo )  // move below
+  // With a host transform the mapped points are computed on the host, in
+  // the layout of the deformation field buffer, and the pre and loop kernels
+  // are not used.
+  const bool           hostTransform = this->m_HostTransform.IsNotNull();
+  std::vector< float > hostPoints;
+  if( hostTransform )
   {
-    this->SetTransformParametersForLoopKernelManager( 0 );
+    hostPoints.resize( mem_size_DF / sizeof( float ) );
+    this->m_DeformationFieldBuffer->SetCPUBufferPointer( &hostPoints[ 0 ] );
+  }
+  else
+  {
+    // Set arguments for pre kernel
+    this->SetArgumentsForPreKernelManager( outPtr );
+
+    // Set arguments for loop kernel
+    this->SetArgumentsForLoopKernelManager( inPtr, outPtr );
+    if( !this->m_TransformIsCombo )  // move below
+    {
+      this->SetTransformParametersForLoopKernelManager( 0 );
+    }
   }
 
   // Set arguments for post kernel
@@ -516,7 +532,7 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
 
   // Define global and local work size
   const OpenCLSize localWorkSize
-    = OpenCLSize::GetLocalWorkSize( this->m_PreKernelManager->GetContext()->GetDefaultDevice() );
+    = OpenCLSize::GetLocalWorkSize( this->m_PreKernelManager->GetContext()->GetActiveDevice() );
   std::size_t local3D[ 3 ], local2D[ 2 ], local1D;
 
   local3D[ 0 ] = local2D[ 0 ] = local1D = localWorkSize[ 0 ];
@@ -533,6 +549,44 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
   OpenCLSize      global_work_size;
   OpenCLSize      global_work_offset;
 
+  // For the asynchronous transfer, each chunk is copied to one of two pinned
+  // staging buffers on the transfer queue, while the next chunk is computed
+  // on the active queue. A staging buffer is copied to the output image on
+  // the host before it is reused, two chunks later. A chunk of the slowest
+  // dimension split is contiguous in the output buffer.
+  const bool asynchronousTransfer
+    = this->m_UseAsynchronousTransfer && numberOfChunks > 1;
+  OpenCLContext *             context           = this->m_PreKernelManager->GetContext();
+  const GPUDataManagerPointer outputDataManager = outPtr->GetGPUDataManager();
+  OutputImagePixelType *      outputBuffer      = nullptr;
+  OpenCLBuffer                stagingBuffers[ 2 ];
+  void *                      stagingPointers[ 2 ] = { nullptr, nullptr };
+  OpenCLEvent                 transferEvents[ 2 ];
+  std::size_t                 transferOffsets[ 2 ] = { 0, 0 };
+  std::size_t                 transferSizes[ 2 ]   = { 0, 0 };
+
+  if( asynchronousTransfer )
+  {
+    const OpenCLDevice activeDevice = context->GetActiveDevice();
+    if( this->m_TransferQueue.IsNull() || !( this->m_TransferQueueDevice == activeDevice ) )
+    {
+      this->m_TransferQueue       = context->CreateCommandQueue( 0, activeDevice );
+      this->m_TransferQueueDevice = activeDevice;
+    }
+
+    // Get the CPU buffer without triggering a synchronization
+    typedef typename GPUOutputImage::Superclass CPUOutputImageType;
+    outputBuffer = outPtr->CPUOutputImageType::GetBufferPointer();
+
+    const std::size_t stagingSize = totalDFSize * sizeof( OutputImagePixelType );
+    for( unsigned int i = 0; i < 2; ++i )
+    {
+      stagingBuffers[ i ] = context->CreateBufferHost( nullptr,
+        OpenCLMemoryObject::ReadWrite, stagingSize );
+      stagingPointers[ i ] = stagingBuffers[ i ].Map( OpenCLMemoryObject::ReadWrite );
+    }
+  }
+
   /** Loop over the chunks. */
   for( piece = 0; piece < numberOfChunks && !this->GetAbortGenerateData(); ++piece )
   {
@@ -627,61 +681,140 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
     this->m_PostKernelManager->SetGlobalWorkSizeForAllKernels( global_work_size );
     this->m_PostKernelManager->SetGlobalWorkOffsetForAllKernels( global_work_offset );
 
-    // Launch pre kernel
-#if 0 // this should work in theory but doesn't
-    OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle, eventList );
-    eventList.Append( preEvent );
-#else
-    if( eventList.GetSize() == 0 )
+    // Map the points of this chunk on the host, while the device is still
+    // interpolating the previous chunk, and copy them to the device. The
+    // copy is enqueued after the previous post kernel.
+    if( hostTransform )
     {
-      OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle );
-      eventList.Append( preEvent );
+      this->ComputeMappedPointsOnHost( currentChunkRegion, &hostPoints[ 0 ] );
+      this->m_DeformationFieldBuffer->SetGPUDirtyFlag( true );
+      this->m_DeformationFieldBuffer->UpdateGPUBuffer();
     }
     else
     {
+      // Launch pre kernel
+#if 0 // this should work in theory but doesn't
       OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle, eventList );
       eventList.Append( preEvent );
-    }
+#else
+      if( eventList.GetSize() == 0 )
+      {
+        OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle );
+        eventList.Append( preEvent );
+      }
+      else
+      {
+        OpenCLEvent preEvent = this->m_PreKernelManager->LaunchKernel( this->m_FilterPreGPUKernelHandle, eventList );
+        eventList.Append( preEvent );
+      }
 #endif
 
-    // Launch all the loop kernels
-    if( this->m_TransformIsCombo )
-    {
-      typedef GPUCompositeTransformBase< InterpolatorPrecisionType,
-        InputImageDimension > CompositeTransformType;
-      const CompositeTransformType * compositeTransform
-        = dynamic_cast< const CompositeTransformType * >( this->m_TransformBase );
-
-      for( int i = compositeTransform->GetNumberOfTransforms() - 1; i >= 0; i-- )
+      // Launch all the loop kernels
+      if( this->m_TransformIsCombo )
       {
-        /** Set the transform parameters to the loop kernel. */
-        this->SetTransformParametersForLoopKernelManager( i );
+        typedef GPUCompositeTransformBase< InterpolatorPrecisionType,
+          InputImageDimension > CompositeTransformType;
+        const CompositeTransformType * compositeTransform
+          = dynamic_cast< const CompositeTransformType * >( this->m_TransformBase );
 
+        for( int i = compositeTransform->GetNumberOfTransforms() - 1; i >= 0; i-- )
+        {
+          /** Set the transform parameters to the loop kernel. */
+          this->SetTransformParametersForLoopKernelManager( i );
+
+          /** Get the kernel id for this transform and launch it. */
+          std::size_t kernelId = 1e10;
+          this->GetKernelIdFromTransformId( i, kernelId );
+          OpenCLEvent loopEvent = this->m_LoopKernelManager->LaunchKernel( kernelId, eventList );
+          eventList.Append( loopEvent );
+
+        } // end loop over the list of transforms
+      }   // end if is combo
+      else
+      {
         /** Get the kernel id for this transform and launch it. */
         std::size_t kernelId = 1e10;
-        this->GetKernelIdFromTransformId( i, kernelId );
+        this->GetKernelIdFromTransformId( 0, kernelId ); // 0 is dummy for non-combo transform
         OpenCLEvent loopEvent = this->m_LoopKernelManager->LaunchKernel( kernelId, eventList );
         eventList.Append( loopEvent );
+      }
+    }
 
-      } // end loop over the list of transforms
-    }   // end if is combo
+    // Launch the post kernel, which is the first kernel with a host transform
+    OpenCLEvent postEvent;
+    if( eventList.GetSize() == 0 )
+    {
+      postEvent = this->m_PostKernelManager->LaunchKernel(
+        this->m_FilterPostGPUKernelHandle );
+    }
     else
     {
-      /** Get the kernel id for this transform and launch it. */
-      std::size_t kernelId = 1e10;
-      this->GetKernelIdFromTransformId( 0, kernelId ); // 0 is dummy for non-combo transform
-      OpenCLEvent loopEvent = this->m_LoopKernelManager->LaunchKernel( kernelId, eventList );
-      eventList.Append( loopEvent );
+      postEvent = this->m_PostKernelManager->LaunchKernel(
+        this->m_FilterPostGPUKernelHandle, eventList );
     }
-
-    // Launch the post kernel
-    OpenCLEvent postEvent = this->m_PostKernelManager->LaunchKernel(
-      this->m_FilterPostGPUKernelHandle, eventList );
     eventList.Append( postEvent );
+
+    // Submit the post kernel before the host maps the next chunk
+    if( hostTransform && !asynchronousTransfer )
+    {
+      context->Flush();
+    }
+
+    // Copy this chunk to the host while the next one is computed
+    if( asynchronousTransfer )
+    {
+      // Submit the kernels, the transfer queue waits for them
+      context->Flush();
+
+      // Empty the staging buffer of two chunks ago
+      const unsigned int slot = piece % 2;
+      if( !transferEvents[ slot ].IsNull() )
+      {
+        transferEvents[ slot ].WaitForFinished();
+        std::memcpy( reinterpret_cast< char * >( outputBuffer ) + transferOffsets[ slot ],
+          stagingPointers[ slot ], transferSizes[ slot ] );
+      }
+
+      OpenCLEventList transferEventList;
+      transferEventList.Append( postEvent );
+      transferOffsets[ slot ] = outPtr->ComputeOffset( currentChunkRegion.GetIndex() )
+        * sizeof( OutputImagePixelType );
+      transferSizes[ slot ] = currentChunkRegion.GetNumberOfPixels()
+        * sizeof( OutputImagePixelType );
+      transferEvents[ slot ] = outputDataManager->UpdateCPUBufferAsync( this->m_TransferQueue,
+        transferOffsets[ slot ], transferSizes[ slot ], transferEventList, stagingPointers[ slot ] );
+      clFlush( this->m_TransferQueue.GetQueueId() );
+    }
   }
 
   eventList.WaitForFinished();
 
+  if( asynchronousTransfer )
+  {
+    // Empty the remaining staging buffers, in the order of the chunks
+    for( unsigned int i = 0; i < 2; ++i )
+    {
+      const unsigned int slot = ( piece + i ) % 2;
+      if( !transferEvents[ slot ].IsNull() )
+      {
+        transferEvents[ slot ].WaitForFinished();
+        std::memcpy( reinterpret_cast< char * >( outputBuffer ) + transferOffsets[ slot ],
+          stagingPointers[ slot ], transferSizes[ slot ] );
+      }
+    }
+
+    for( unsigned int i = 0; i < 2; ++i )
+    {
+      stagingBuffers[ i ].Unmap( stagingPointers[ i ], true );
+    }
+
+    // The output is complete on the host, unless the filter was aborted
+    if( piece == numberOfChunks )
+    {
+      outputDataManager->SetCPUBufferUpToDate();
+    }
+  }
+
   itkDebugMacro( << "GPUResampleImageFilter::GPUGenerateData() finished" );
 } // end GPUGenerateData()
 
@@ -1169,6 +1302,100 @@ typename GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisi
   return GPUBSplineTransformBase;
 }  // end GetGPUBSplineBaseTransform()
 
+
+/**
+ * ***************** ComputeMappedPointsOnHost ***********************
+ */
+
+template< typename TInputImage, typename TOutputImage, typename TInterpolatorPrecisionType >
+void
+GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::ComputeMappedPointsOnHost( const OutputImageRegionType & chunkRegion,
+  float * points )
+{
+  MappedPointsThreaderParameterType parameters;
+  parameters.st_Self   = this;
+  parameters.st_Region = chunkRegion;
+  parameters.st_Points = points;
+
+  this->GetMultiThreader()->SetNumberOfWorkUnits( this->GetNumberOfWorkUnits() );
+  this->GetMultiThreader()->SetSingleMethod(
+    this->ComputeMappedPointsThreaderCallback, &parameters );
+  this->GetMultiThreader()->SingleMethodExecute();
+
+} // end ComputeMappedPointsOnHost()
+
+
+/**
+ * ***************** ComputeMappedPointsThreaderCallback ***********************
+ */
+
+template< typename TInputImage, typename TOutputImage, typename TInterpolatorPrecisionType >
+ITK_THREAD_RETURN_TYPE
+GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::ComputeMappedPointsThreaderCallback( void * arg )
+{
+  ThreadInfoType *                    infoStruct = static_cast< ThreadInfoType * >( arg );
+  MappedPointsThreaderParameterType * temp
+    = static_cast< MappedPointsThreaderParameterType * >( infoStruct->UserData );
+
+  temp->st_Self->ThreadedComputeMappedPoints( temp->st_Region, temp->st_Points,
+    infoStruct->WorkUnitID, infoStruct->NumberOfWorkUnits );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end ComputeMappedPointsThreaderCallback()
+
+
+/**
+ * ***************** ThreadedComputeMappedPoints ***********************
+ */
+
+template< typename TInputImage, typename TOutputImage, typename TInterpolatorPrecisionType >
+void
+GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::ThreadedComputeMappedPoints( const OutputImageRegionType & chunkRegion,
+  float * points, const ThreadIdType threadId,
+  const ThreadIdType numberOfWorkUnits ) const
+{
+  // The deformation field buffer stores a cl_float3, i.e. four floats, per
+  // point in 3D, and a cl_float2 or cl_float in 2D and 1D.
+  const unsigned int numberOfComponents
+    = OutputImageDimension == 3 ? 4 : OutputImageDimension;
+
+  // Each work unit maps a contiguous range of the points of the chunk
+  const SizeValueType numberOfPoints = chunkRegion.GetNumberOfPixels();
+  const SizeValueType begin          = numberOfPoints * threadId / numberOfWorkUnits;
+  const SizeValueType end            = numberOfPoints * ( threadId + 1 ) / numberOfWorkUnits;
+
+  const OutputImageType *                     output = this->GetOutput();
+  typename HostTransformType::InputPointType  outputPoint;
+  typename HostTransformType::OutputPointType inputPoint;
+  IndexType                                   index;
+  for( SizeValueType i = begin; i < end; ++i )
+  {
+    // The index of the point, with the first dimension running fastest
+    SizeValueType offset = i;
+    for( unsigned int d = 0; d < OutputImageDimension; ++d )
+    {
+      index[ d ] = chunkRegion.GetIndex( d )
+        + static_cast< IndexValueType >( offset % chunkRegion.GetSize( d ) );
+      offset /= chunkRegion.GetSize( d );
+    }
+
+    output->TransformIndexToPhysicalPoint( index, outputPoint );
+    inputPoint = this->m_HostTransform->TransformPoint( outputPoint );
+
+    float * point = points + i * numberOfComponents;
+    for( unsigned int d = 0; d < InputImageDimension; ++d )
+    {
+      point[ d ] = static_cast< float >( inputPoint[ d ] );
+    }
+  }
+
+} // end ThreadedComputeMappedPoints()
+
+
 /**
  * ***************** PrintSelf ***********************
  */
@@ -1180,6 +1407,10 @@ GPUResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
 {
   CPUSuperclass::PrintSelf( os, indent );
   GPUSuperclass::PrintSelf( os, indent );
+
+  os << indent << "RequestedNumberOfSplits: " << this->m_RequestedNumberOfSplits << std::endl;
+  os << indent << "UseAsynchronousTransfer: " << this->m_UseAsynchronousTransfer << std::endl;
+  os << indent << "HostTransform: " << this->m_HostTransform.GetPointer() << std::endl;
 } // end PrintSelf()
 
 
@@ -34,6 +34,8 @@
 *=========================================================================*/
 #include "itkGPUDataManager.h"
 
+#include <cstdint>
+
 namespace itk
 {
 // constructor
@@ -42,6 +44,7 @@ GPUDataManager::GPUDataManager()
   m_Context   = OpenCLContext::GetInstance();
   m_GPUBuffer = nullptr;
   m_CPUBuffer = nullptr;
+  m_ZeroCopy  = false;
 
   m_CPUBufferLock = false;
   m_GPUBufferLock = false;
@@ -93,19 +96,98 @@ GPUDataManager::Allocate()
 
   if( m_BufferSize > 0 )
   {
+    // On unified memory, use an aligned CPU buffer directly, or let OpenCL
+    // allocate host accessible memory if there is no CPU buffer. The size of
+    // a zero-copy buffer is rounded up to a cache line, which stays within
+    // the pages of the CPU buffer.
+    cl_mem_flags flags      = m_MemFlags;
+    void *       hostPtr    = nullptr;
+    std::size_t  bufferSize = m_BufferSize;
+    const cl_mem_flags hostFlags
+      = CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR;
+    m_ZeroCopy = false;
+    if( ( flags & hostFlags ) == 0 && this->HasUnifiedMemory() )
+    {
+      if( m_CPUBuffer == nullptr )
+      {
+        flags |= CL_MEM_ALLOC_HOST_PTR;
+      }
+      else if( reinterpret_cast< std::uintptr_t >( m_CPUBuffer )
+        % GetZeroCopyAlignment() == 0 )
+      {
+        flags     |= CL_MEM_USE_HOST_PTR;
+        hostPtr    = m_CPUBuffer;
+        bufferSize = ( ( bufferSize + 63 ) / 64 ) * 64;
+        m_ZeroCopy = true;
+      }
+    }
+
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
     std::cout << "clCreateBuffer, "
               << this <<  "::Allocate Create GPU buffer of size "
-              << m_BufferSize << " Bytes" << std::endl;
+              << m_BufferSize << " Bytes"
+              << ( m_ZeroCopy ? " using the CPU buffer" : "" ) << std::endl;
 #endif
     m_GPUBuffer = clCreateBuffer( m_Context->GetContextId(),
-      m_MemFlags, m_BufferSize, nullptr, &errid );
+      flags, bufferSize, hostPtr, &errid );
     m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
     m_IsGPUBufferDirty = true;
   }
 }
 
 
+//------------------------------------------------------------------------------
+bool
+GPUDataManager::HasUnifiedMemory() const
+{
+  if( !m_Context->IsCreated() )
+  {
+    return false;
+  }
+
+  const std::list< OpenCLDevice > devices = m_Context->GetDevices();
+  if( devices.empty() )
+  {
+    return false;
+  }
+
+  for( std::list< OpenCLDevice >::const_iterator it = devices.begin(); it != devices.end(); ++it )
+  {
+    if( !it->HasUnifiedMemory() )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+//------------------------------------------------------------------------------
+void
+GPUDataManager::SynchronizeZeroCopyBuffer( const bool toHost )
+{
+  // Mapping for writing invalidates the device contents, so that a driver
+  // that keeps a copy of the buffer does not overwrite the CPU buffer.
+#ifdef CL_VERSION_1_2
+  const cl_map_flags flags = toHost ? CL_MAP_READ : CL_MAP_WRITE_INVALIDATE_REGION;
+#else
+  const cl_map_flags flags = toHost ? CL_MAP_READ : CL_MAP_WRITE;
+#endif
+
+  const cl_command_queue queue = m_Context->GetCommandQueue().GetQueueId();
+  cl_int                 errid;
+  void *                 mapped = clEnqueueMapBuffer( queue, m_GPUBuffer, CL_TRUE,
+    flags, 0, m_BufferSize, 0, nullptr, nullptr, &errid );
+  m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+
+  if( mapped != nullptr )
+  {
+    errid = clEnqueueUnmapMemObject( queue, m_GPUBuffer, mapped, 0, nullptr, nullptr );
+    m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+  }
+}
+
+
 //------------------------------------------------------------------------------
 void
 GPUDataManager::SetCPUBufferPointer( void * ptr )
@@ -159,7 +241,12 @@ GPUDataManager::UpdateCPUBuffer()
 
   MutexHolderType holder( m_Mutex );
 
-  if( m_IsCPUBufferDirty && m_GPUBuffer != nullptr && m_CPUBuffer != nullptr )
+  if( m_IsCPUBufferDirty && m_GPUBuffer != nullptr && m_CPUBuffer != nullptr && m_ZeroCopy )
+  {
+    this->SynchronizeZeroCopyBuffer( true );
+    m_IsCPUBufferDirty = false;
+  }
+  else if( m_IsCPUBufferDirty && m_GPUBuffer != nullptr && m_CPUBuffer != nullptr )
   {
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
     std::cout << "clEnqueueReadBuffer, " << this
@@ -197,7 +284,12 @@ GPUDataManager::UpdateGPUBuffer()
 
   MutexHolderType holder( m_Mutex );
 
-  if( m_IsGPUBufferDirty && m_CPUBuffer != nullptr && m_GPUBuffer != nullptr )
+  if( m_IsGPUBufferDirty && m_CPUBuffer != nullptr && m_GPUBuffer != nullptr && m_ZeroCopy )
+  {
+    this->SynchronizeZeroCopyBuffer( false );
+    m_IsGPUBufferDirty = false;
+  }
+  else if( m_IsGPUBufferDirty && m_CPUBuffer != nullptr && m_GPUBuffer != nullptr )
   {
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
     std::cout << "clEnqueueWriteBuffer, " << this << "::UpdateGPUBuffer CPU->GPU data copy "
@@ -223,6 +315,73 @@ GPUDataManager::UpdateGPUBuffer()
 }
 
 
+//------------------------------------------------------------------------------
+OpenCLEvent
+GPUDataManager::UpdateCPUBufferAsync( const OpenCLCommandQueue & queue,
+  const std::size_t offset, const std::size_t size,
+  const OpenCLEventList & eventList, void * hostPointer )
+{
+  if( size == 0 || m_GPUBuffer == nullptr || offset + size > m_BufferSize )
+  {
+    return OpenCLEvent();
+  }
+
+  MutexHolderType holder( m_Mutex );
+
+  if( hostPointer == nullptr )
+  {
+    if( m_CPUBuffer == nullptr )
+    {
+      return OpenCLEvent();
+    }
+
+    // The CPU buffer of a zero-copy manager is up-to-date once the range is
+    // mapped, the unmap waits for the map.
+    if( m_ZeroCopy )
+    {
+      cl_event     mapEvent;
+      cl_int       errid;
+      void * const mapped = clEnqueueMapBuffer( queue.GetQueueId(), m_GPUBuffer, CL_FALSE,
+        CL_MAP_READ, offset, size, eventList.GetSize(), eventList.GetEventData(), &mapEvent, &errid );
+      m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+      if( mapped == nullptr )
+      {
+        return OpenCLEvent();
+      }
+      errid = clEnqueueUnmapMemObject( queue.GetQueueId(), m_GPUBuffer, mapped, 1, &mapEvent, nullptr );
+      m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+      return OpenCLEvent( mapEvent );
+    }
+
+    hostPointer = static_cast< char * >( m_CPUBuffer ) + offset;
+  }
+
+#if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
+  std::cout << "clEnqueueReadBuffer, " << this
+            << "::UpdateCPUBufferAsync GPU->CPU data copy of "
+            << size << " Bytes at " << offset << std::endl;
+#endif
+
+  cl_event     clEvent;
+  const cl_int errid = clEnqueueReadBuffer( queue.GetQueueId(), m_GPUBuffer, CL_FALSE,
+    offset, size, hostPointer, eventList.GetSize(), eventList.GetEventData(), &clEvent );
+  m_Context->ReportError( errid, __FILE__, __LINE__, ITK_LOCATION );
+
+  return OpenCLEvent( clEvent );
+}
+
+
+//------------------------------------------------------------------------------
+void
+GPUDataManager::SetCPUBufferUpToDate()
+{
+  MutexHolderType holder( m_Mutex );
+
+  m_IsCPUBufferDirty = false;
+  m_IsGPUBufferDirty = false;
+}
+
+
 //------------------------------------------------------------------------------
 cl_mem *
 GPUDataManager::GetGPUBufferPointer()
@@ -287,6 +446,7 @@ GPUDataManager::Graft( const GPUDataManager * data )
 
     m_GPUBuffer = data->m_GPUBuffer;
     m_CPUBuffer = data->m_CPUBuffer;
+    m_ZeroCopy  = data->m_ZeroCopy;
 
     m_IsCPUBufferDirty = data->m_IsCPUBufferDirty;
     m_IsGPUBufferDirty = data->m_IsGPUBufferDirty;
@@ -310,6 +470,7 @@ GPUDataManager::Initialize()
   m_BufferSize       = 0;
   m_GPUBuffer        = nullptr;
   m_CPUBuffer        = nullptr;
+  m_ZeroCopy         = false;
   m_MemFlags         = CL_MEM_READ_WRITE; // default flag
   m_IsGPUBufferDirty = false;
   m_IsCPUBufferDirty = false;
@@ -329,6 +490,7 @@ GPUDataManager::PrintSelf( std::ostream & os, Indent indent ) const
   os << indent << "m_GPUBuffer: " << m_GPUBuffer << std::endl;
   os << indent << "m_IsCPUBufferDirty: " << m_IsCPUBufferDirty << std::endl;
   os << indent << "m_CPUBuffer: " << m_CPUBuffer << std::endl;
+  os << indent << "m_ZeroCopy: " << m_ZeroCopy << std::endl;
   os << indent << "m_CPUBufferLock: " << m_CPUBufferLock << std::endl;
   os << indent << "m_GPUBufferLock: " << m_GPUBufferLock << std::endl;
 }
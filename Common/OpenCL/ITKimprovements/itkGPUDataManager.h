@@ -39,6 +39,7 @@
 #include "itkDataObject.h"
 #include "itkObjectFactory.h"
 #include "itkOpenCLContext.h"
+#include "itkOpenCLEventList.h"
 #include <mutex>
 
 namespace itk
@@ -52,6 +53,12 @@ namespace itk
  * we did not name it GPUImageBase. Rather, this class is a GPU-specific data manager
  * that provides functionalities for CPU-GPU data synchronization and grafting GPU data.
  *
+ * On devices that share the memory of the host, see
+ * OpenCLDevice::HasUnifiedMemory(), a CPU buffer that is aligned to a page
+ * is used by the GPU buffer directly (CL_MEM_USE_HOST_PTR), and the buffers
+ * are synchronized by mapping instead of copying. GPUImage allocates its
+ * pixels aligned on these devices.
+ *
  * \note This file was taken from ITK 4.1.0.
  * It was modified by Denis P. Shamonin and Marius Staring.
  * Division of Image Processing,
@@ -122,8 +129,45 @@ public:
   /** actual CPU->GPU memory copy takes place here */
   virtual void UpdateGPUBuffer();
 
+  /** Non-blocking GPU->CPU copy of \a size bytes at byte \a offset of the
+   * GPU buffer, enqueued on \a queue to start after the events of
+   * \a eventList. The bytes are copied to \a hostPointer, which may for
+   * example be pinned memory, or to the same offset of the CPU buffer if it
+   * is null. Returns the event of the copy, the host memory may only be
+   * read after it has finished. The dirty flags are not changed, call
+   * SetCPUBufferUpToDate() when the whole CPU buffer has been copied. */
+  OpenCLEvent UpdateCPUBufferAsync( const OpenCLCommandQueue & queue,
+    const std::size_t offset, const std::size_t size,
+    const OpenCLEventList & eventList, void * hostPointer = nullptr );
+
+  /** Mark the CPU buffer as up-to-date, after it has been copied
+   * completely with UpdateCPUBufferAsync(). */
+  virtual void SetCPUBufferUpToDate();
+
+  /** Create the GPU buffer. The GPU buffer uses the CPU buffer without
+   * copies if the devices have unified memory and the CPU buffer is aligned
+   * to GetZeroCopyAlignment(), and is allocated in host accessible memory
+   * if the devices have unified memory and there is no CPU buffer. */
   void Allocate();
 
+  /** Returns whether all devices of the context share the memory of the
+   * host. */
+  bool HasUnifiedMemory() const;
+
+  /** Returns whether the GPU buffer uses the CPU buffer, so that
+   * UpdateCPUBuffer() and UpdateGPUBuffer() map it instead of copying. */
+  bool IsZeroCopy() const
+  {
+    return m_ZeroCopy;
+  }
+
+  /** The alignment in bytes of a CPU buffer that the GPU buffer can use
+   * without copies, a page. */
+  static std::size_t GetZeroCopyAlignment()
+  {
+    return 4096;
+  }
+
   /** Synchronize CPU and GPU buffers (using dirty flags) */
   bool Update();
 
@@ -153,6 +197,11 @@ protected:
   virtual ~GPUDataManager();
   virtual void PrintSelf( std::ostream & os, Indent indent ) const;
 
+  /** Map and unmap the GPU buffer of a zero-copy manager, which makes the
+   * device and the host agree on the shared memory. Maps for reading if
+   * \a toHost is true, and for writing otherwise. */
+  void SynchronizeZeroCopyBuffer( const bool toHost );
+
 protected:
 
   unsigned int m_BufferSize; // # of bytes
@@ -170,6 +219,9 @@ protected:
   bool m_IsGPUBufferDirty;
   bool m_IsCPUBufferDirty;
 
+  /** whether the GPU buffer uses the CPU buffer */
+  bool m_ZeroCopy;
+
   /** extra safety flags */
   bool m_CPUBufferLock;
   bool m_GPUBufferLock;
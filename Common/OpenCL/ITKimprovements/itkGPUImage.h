@@ -95,7 +95,8 @@ public:
 
   typedef NeighborhoodAccessorFunctor< Self > NeighborhoodAccessorFunctorType;
 
-  /** Allocate CPU and GPU memory space */
+  /** Allocate CPU and GPU memory space. On devices with unified memory the
+   * pixels are aligned to a page, and shared by the GPU buffer. */
   virtual void Allocate( bool initialize = false ) override;
 
   void AllocateGPU( void );
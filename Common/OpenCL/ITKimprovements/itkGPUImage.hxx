@@ -36,6 +36,7 @@
 #define __itkGPUImage_hxx
 
 #include "itkGPUImage.h"
+#include "itkGPUImportImageContainer.h"
 
 namespace itk
 {
@@ -58,8 +59,22 @@ void
 GPUImage< TPixel, VImageDimension >
 ::Allocate( bool initialize )
 {
-  // allocate CPU memory - calling Allocate() in superclass
-  Superclass::Allocate( initialize );
+  if( !m_Graft && m_DataManager->HasUnifiedMemory() )
+  {
+    // allocate CPU memory aligned to a page, which the GPU buffer then uses
+    // without copies, see GPUDataManager::Allocate()
+    typedef GPUImportImageContainer< SizeValueType, TPixel > AlignedContainerType;
+    this->ComputeOffsetTable();
+    const SizeValueType numPixel = this->GetOffsetTable()[ VImageDimension ];
+    typename AlignedContainerType::Pointer container = AlignedContainerType::New();
+    container->AllocateAligned( numPixel, initialize );
+    Superclass::SetPixelContainer( container );
+  }
+  else
+  {
+    // allocate CPU memory - calling Allocate() in superclass
+    Superclass::Allocate( initialize );
+  }
 
   if( !m_Graft )
   {
@@ -87,6 +87,10 @@ public:
   /** actual CPU->GPU memory copy takes place here */
   virtual void UpdateGPUBuffer();
 
+  /** Mark the CPU buffer as up-to-date and update the time stamps, after
+   * an asynchronous copy of the whole buffer. */
+  virtual void SetCPUBufferUpToDate();
+
   /** Grafting GPU Image Data */
   virtual void Graft( const GPUImageDataManager * data );
 
@@ -73,7 +73,18 @@ GPUImageDataManager< ImageType >::UpdateCPUBuffer()
     * correctly managed. Therefore, we check the time stamp of
     * CPU and GPU data as well
     */
-    if( ( m_IsCPUBufferDirty || ( gpu_time > cpu_time ) ) && m_GPUBuffer != nullptr && m_CPUBuffer != nullptr )
+    if( ( m_IsCPUBufferDirty || ( gpu_time > cpu_time ) ) && m_GPUBuffer != nullptr && m_CPUBuffer != nullptr
+      && this->m_ZeroCopy )
+    {
+      this->SynchronizeZeroCopyBuffer( true );
+
+      m_Image->Modified();
+      this->SetTimeStamp( m_Image->GetTimeStamp() );
+
+      m_IsCPUBufferDirty = false;
+      m_IsGPUBufferDirty = false;
+    }
+    else if( ( m_IsCPUBufferDirty || ( gpu_time > cpu_time ) ) && m_GPUBuffer != nullptr && m_CPUBuffer != nullptr )
     {
       cl_int errid;
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
@@ -128,7 +139,17 @@ GPUImageDataManager< ImageType >::UpdateGPUBuffer()
     * correctly managed. Therefore, we check the time stamp of
     * CPU and GPU data as well
     */
-    if( ( m_IsGPUBufferDirty || ( gpu_time < cpu_time ) ) && m_CPUBuffer != nullptr && m_GPUBuffer != nullptr )
+    if( ( m_IsGPUBufferDirty || ( gpu_time < cpu_time ) ) && m_CPUBuffer != nullptr && m_GPUBuffer != nullptr
+      && this->m_ZeroCopy )
+    {
+      this->SynchronizeZeroCopyBuffer( false );
+
+      this->SetTimeStamp( cpu_time_stamp );
+
+      m_IsCPUBufferDirty = false;
+      m_IsGPUBufferDirty = false;
+    }
+    else if( ( m_IsGPUBufferDirty || ( gpu_time < cpu_time ) ) && m_CPUBuffer != nullptr && m_GPUBuffer != nullptr )
     {
       cl_int errid;
 #if ( defined( _WIN32 ) && defined( _DEBUG ) ) || !defined( NDEBUG )
@@ -157,6 +178,31 @@ GPUImageDataManager< ImageType >::UpdateGPUBuffer()
 }
 
 
+//------------------------------------------------------------------------------
+template< typename ImageType >
+void
+GPUImageDataManager< ImageType >::SetCPUBufferUpToDate()
+{
+  if( m_Image.IsNotNull() )
+  {
+    m_Mutex.lock();
+
+    // Same time stamps as after UpdateCPUBuffer()
+    m_Image->Modified();
+    this->SetTimeStamp( m_Image->GetTimeStamp() );
+
+    m_IsCPUBufferDirty = false;
+    m_IsGPUBufferDirty = false;
+
+    m_Mutex.unlock();
+  }
+  else
+  {
+    Superclass::SetCPUBufferUpToDate();
+  }
+}
+
+
 //------------------------------------------------------------------------------
 template< typename ImageType >
 void
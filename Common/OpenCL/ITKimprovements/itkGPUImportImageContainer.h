@@ -0,0 +1,91 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkGPUImportImageContainer_h
+#define __itkGPUImportImageContainer_h
+
+#include "itkImportImageContainer.h"
+
+namespace itk
+{
+/** \class GPUImportImageContainer
+ * \brief An ImportImageContainer whose memory is aligned to a page.
+ *
+ * AllocateAligned() allocates the elements aligned to
+ * GPUDataManager::GetZeroCopyAlignment() and padded to a whole number of
+ * pages, and imports them into the container, which does not manage them.
+ * The memory is released when the container is destroyed or allocated
+ * again. GPUImage uses this container on devices with unified memory, so
+ * that the GPU buffer uses the pixels without copies.
+ *
+ * If the superclass has to grow the container, for example by Reserve(), it
+ * replaces the aligned memory by memory of its own, which is not aligned.
+ *
+ * \ingroup ITKGPUCommon
+ */
+template< typename TElementIdentifier, typename TElement >
+class ITK_EXPORT GPUImportImageContainer :
+  public ImportImageContainer< TElementIdentifier, TElement >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef GPUImportImageContainer                              Self;
+  typedef ImportImageContainer< TElementIdentifier, TElement > Superclass;
+  typedef SmartPointer< Self >                                 Pointer;
+  typedef SmartPointer< const Self >                           ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( GPUImportImageContainer, ImportImageContainer );
+
+  /** Save the template parameters. */
+  typedef TElementIdentifier ElementIdentifier;
+  typedef TElement           Element;
+
+  /** Allocate \a size aligned elements and import them. The elements are
+   * value-initialized if \a UseDefaultConstructor is true. */
+  void AllocateAligned( const ElementIdentifier size,
+    const bool UseDefaultConstructor = false );
+
+protected:
+
+  GPUImportImageContainer();
+  ~GPUImportImageContainer() override;
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  GPUImportImageContainer( const Self & ); // purposely not implemented
+  void operator=( const Self & );          // purposely not implemented
+
+  /** Release the aligned memory. */
+  void ReleaseAligned( void );
+
+  void * m_AlignedBuffer;
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkGPUImportImageContainer.hxx"
+#endif
+
+#endif /* __itkGPUImportImageContainer_h */
@@ -0,0 +1,117 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkGPUImportImageContainer_hxx
+#define __itkGPUImportImageContainer_hxx
+
+#include "itkGPUImportImageContainer.h"
+#include "itkGPUDataManager.h"
+
+#include <algorithm>
+#include <cstdlib>
+#if defined( _WIN32 )
+#include <malloc.h>
+#endif
+
+namespace itk
+{
+template< typename TElementIdentifier, typename TElement >
+GPUImportImageContainer< TElementIdentifier, TElement >
+::GPUImportImageContainer() :
+  m_AlignedBuffer( nullptr )
+{}
+
+
+//------------------------------------------------------------------------------
+template< typename TElementIdentifier, typename TElement >
+GPUImportImageContainer< TElementIdentifier, TElement >
+::~GPUImportImageContainer()
+{
+  this->ReleaseAligned();
+}
+
+
+//------------------------------------------------------------------------------
+template< typename TElementIdentifier, typename TElement >
+void
+GPUImportImageContainer< TElementIdentifier, TElement >
+::AllocateAligned( const ElementIdentifier size, const bool UseDefaultConstructor )
+{
+  const std::size_t alignment = GPUDataManager::GetZeroCopyAlignment();
+  const std::size_t bytes     = std::max< std::size_t >( 1,
+    ( ( size * sizeof( TElement ) + alignment - 1 ) / alignment ) * alignment );
+
+  void * buffer = nullptr;
+#if defined( _WIN32 )
+  buffer = _aligned_malloc( bytes, alignment );
+#else
+  if( posix_memalign( &buffer, alignment, bytes ) != 0 )
+  {
+    buffer = nullptr;
+  }
+#endif
+  if( buffer == nullptr )
+  {
+    itkExceptionMacro( << "Failed to allocate " << bytes << " bytes aligned to "
+                       << alignment << " bytes." );
+  }
+
+  TElement * elements = static_cast< TElement * >( buffer );
+  if( UseDefaultConstructor )
+  {
+    std::fill( elements, elements + size, TElement() );
+  }
+
+  // Import first, the container does not release the previous memory.
+  this->SetImportPointer( elements, size, false );
+  this->ReleaseAligned();
+  m_AlignedBuffer = buffer;
+}
+
+
+//------------------------------------------------------------------------------
+template< typename TElementIdentifier, typename TElement >
+void
+GPUImportImageContainer< TElementIdentifier, TElement >
+::ReleaseAligned( void )
+{
+  if( m_AlignedBuffer != nullptr )
+  {
+#if defined( _WIN32 )
+    _aligned_free( m_AlignedBuffer );
+#else
+    free( m_AlignedBuffer );
+#endif
+    m_AlignedBuffer = nullptr;
+  }
+}
+
+
+//------------------------------------------------------------------------------
+template< typename TElementIdentifier, typename TElement >
+void
+GPUImportImageContainer< TElementIdentifier, TElement >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+  os << indent << "AlignedBuffer: " << m_AlignedBuffer << std::endl;
+}
+
+
+} // end namespace itk
+
+#endif /* __itkGPUImportImageContainer_hxx */
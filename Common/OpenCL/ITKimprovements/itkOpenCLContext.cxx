@@ -19,12 +19,23 @@
 #include "itkOpenCLKernels.h"
 #include "itkOpenCLProfilingTimeProbe.h"
 
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
 
 #include "itksys/MD5.h"
+#include "itksys/SystemTools.hxx"
 #include "itkOpenCLMacro.h"
 
+// Defined in itkOpenCLProgram.cxx
+namespace OpenCLProgramSupport
+{
+bool GetOpenCLMathAndOptimizationOptions( std::string & options );
+}
+
 namespace itk
 {
 // static variable initialization
@@ -82,7 +93,9 @@ public:
   OpenCLContextPimpl() :
     id( 0 ),
     is_created( false ),
-    last_error( CL_SUCCESS )
+    last_error( CL_SUCCESS ),
+    program_cache_enabled( true ),
+    next_device( 0 )
   {}
 
   ~OpenCLContextPimpl()
@@ -90,6 +103,7 @@ public:
     // Release the command queues for the context.
     command_queue         = OpenCLCommandQueue();
     default_command_queue = OpenCLCommandQueue();
+    device_command_queues.clear();
 
     // Release the context.
     if( is_created )
@@ -107,6 +121,12 @@ public:
   OpenCLCommandQueue default_command_queue;
   OpenCLDevice       default_device;
   cl_int             last_error;
+  bool               program_cache_enabled;
+  std::string        program_cache_directory;
+
+  // The default command queues of the devices other than the default device
+  std::map< cl_device_id, OpenCLCommandQueue > device_command_queues;
+  std::atomic< std::size_t >                   next_device;
 };
 
 //------------------------------------------------------------------------------
@@ -137,10 +157,151 @@ GetOpenCLDebugFileName( const std::string & source )
 }
 
 
+//------------------------------------------------------------------------------
+// Returns the default directory of the program cache
+std::string
+GetOpenCLProgramCacheDefaultDirectory()
+{
+  std::string directory;
+  if( itksys::SystemTools::GetEnv( "ELASTIX_OPENCL_PROGRAM_CACHE_DIR", directory ) )
+  {
+    return directory;
+  }
+
+#if defined( _WIN32 )
+  if( !itksys::SystemTools::GetEnv( "LOCALAPPDATA", directory ) )
+  {
+    return std::string();
+  }
+#elif defined( __APPLE__ )
+  if( !itksys::SystemTools::GetEnv( "HOME", directory ) )
+  {
+    return std::string();
+  }
+  directory.append( "/Library/Caches" );
+#else
+  if( !itksys::SystemTools::GetEnv( "XDG_CACHE_HOME", directory ) || directory.empty() )
+  {
+    if( !itksys::SystemTools::GetEnv( "HOME", directory ) )
+    {
+      return std::string();
+    }
+    directory.append( "/.cache" );
+  }
+#endif
+
+  directory.append( "/elastix/OpenCLProgramCache" );
+  return directory;
+}
+
+
+//------------------------------------------------------------------------------
+// Returns the file name of a program binary in the program cache, which is
+// unique for the device, its driver, the build options and the source code.
+std::string
+GetOpenCLProgramCacheFileName( const std::string & directory,
+  const OpenCLDevice & device,
+  const std::string & buildOptions,
+  const std::string & sourceCode,
+  const std::string & prefixSourceCode,
+  const std::string & postfixSourceCode )
+{
+  std::stringstream key;
+  key << device.GetVendor() << '\n' << device.GetName() << '\n'
+      << device.GetVersion() << '\n' << device.GetDriverVersion() << '\n'
+      << buildOptions << '\n';
+  const std::string keyString = key.str();
+
+  itksysMD5 * md5 = itksysMD5_New();
+  itksysMD5_Initialize( md5 );
+  itksysMD5_Append( md5, (unsigned char *)keyString.c_str(), keyString.size() );
+  itksysMD5_Append( md5, (unsigned char *)prefixSourceCode.c_str(), prefixSourceCode.size() );
+  itksysMD5_Append( md5, (unsigned char *)"\n", 1 );
+  itksysMD5_Append( md5, (unsigned char *)sourceCode.c_str(), sourceCode.size() );
+  itksysMD5_Append( md5, (unsigned char *)"\n", 1 );
+  itksysMD5_Append( md5, (unsigned char *)postfixSourceCode.c_str(), postfixSourceCode.size() );
+  const std::size_t DigestSize = 32u;
+  char              Digest[ DigestSize ];
+  itksysMD5_FinalizeHex( md5, Digest );
+  const std::string hex( Digest, DigestSize );
+  itksysMD5_Delete( md5 );
+
+  return directory + "/ocl-" + hex + ".bin";
+}
+
+
+//------------------------------------------------------------------------------
+// Reads a program binary from the program cache
+bool
+ReadOpenCLProgramBinary( const std::string & fileName,
+  std::vector< unsigned char > & binary )
+{
+  std::ifstream file( fileName.c_str(), std::ifstream::in | std::ifstream::binary );
+  if( file.is_open() == false )
+  {
+    return false;
+  }
+  file.seekg( 0, std::ios::end );
+  const std::streamoff size = file.tellg();
+  if( size <= 0 )
+  {
+    return false;
+  }
+  binary.resize( static_cast< std::size_t >( size ) );
+  file.seekg( 0, std::ios::beg );
+  file.read( reinterpret_cast< char * >( &binary[ 0 ] ), size );
+  return file.good();
+}
+
+
+//------------------------------------------------------------------------------
+// Writes a program binary to the program cache. The binary is written to a
+// temporary file first, which is renamed, so that concurrent processes never
+// read a partially written binary.
+void
+WriteOpenCLProgramBinary( const std::string & fileName,
+  const std::vector< unsigned char > & binary )
+{
+  const std::string directory = itksys::SystemTools::GetFilenamePath( fileName );
+  if( !itksys::SystemTools::MakeDirectory( directory ) )
+  {
+    itkOpenCLWarningMacroGeneric( << "Cannot create OpenCL program cache directory: " << directory );
+    return;
+  }
+
+  std::random_device random;
+  std::stringstream  temporaryFileName;
+  temporaryFileName << fileName << "." << std::hex << random() << ".tmp";
+
+  std::ofstream file( temporaryFileName.str().c_str(), std::ofstream::out | std::ofstream::binary );
+  if( file.is_open() == false )
+  {
+    itkOpenCLWarningMacroGeneric( << "Cannot create OpenCL program cache file: " << temporaryFileName.str() );
+    return;
+  }
+  file.write( reinterpret_cast< const char * >( &binary[ 0 ] ), binary.size() );
+  file.close();
+
+  if( !file.good() || !itksys::SystemTools::RenameFile( temporaryFileName.str(), fileName ) )
+  {
+    itksys::SystemTools::RemoveFile( temporaryFileName.str() );
+  }
+}
+
+
 //------------------------------------------------------------------------------
 OpenCLContext::OpenCLContext() :
   d_ptr( new OpenCLContextPimpl() )
-{}
+{
+  ITK_OPENCL_D( OpenCLContext );
+
+  std::string cache;
+  if( itksys::SystemTools::GetEnv( "ELASTIX_OPENCL_PROGRAM_CACHE", cache ) )
+  {
+    d->program_cache_enabled = !( cache == "OFF" || cache == "off" || cache == "0" );
+  }
+  d->program_cache_directory = GetOpenCLProgramCacheDefaultDirectory();
+}
 
 //------------------------------------------------------------------------------
 // Destructor has to be in cxx, otherwise compiler will print warning messages.
@@ -581,6 +742,7 @@ OpenCLContext::Release()
   {
     d->command_queue         = OpenCLCommandQueue();
     d->default_command_queue = OpenCLCommandQueue();
+    d->device_command_queues.clear();
     clReleaseContext( d->id );
     d->id             = 0;
     d->default_device = OpenCLDevice();
@@ -841,6 +1003,66 @@ OpenCLContext::GetDefaultCommandQueue()
 }
 
 
+//------------------------------------------------------------------------------
+OpenCLCommandQueue
+OpenCLContext::GetDefaultCommandQueue( const OpenCLDevice & device )
+{
+  ITK_OPENCL_D( OpenCLContext );
+  if( device.IsNull() || device == this->GetDefaultDevice() )
+  {
+    return this->GetDefaultCommandQueue();
+  }
+
+  OpenCLCommandQueue & queue = d->device_command_queues[ device.GetDeviceId() ];
+  if( queue.IsNull() )
+  {
+#ifdef OPENCL_PROFILING
+    queue = this->CreateCommandQueue( CL_QUEUE_PROFILING_ENABLE, device );
+#else
+    queue = this->CreateCommandQueue( 0, device );
+#endif
+  }
+  return queue;
+}
+
+
+//------------------------------------------------------------------------------
+OpenCLDevice
+OpenCLContext::GetActiveDevice()
+{
+  const cl_command_queue queue = this->GetActiveQueue();
+  if( !queue )
+  {
+    return OpenCLDevice();
+  }
+
+  cl_device_id device = 0;
+  if( clGetCommandQueueInfo( queue, CL_QUEUE_DEVICE,
+    sizeof( device ), &device, nullptr ) != CL_SUCCESS )
+  {
+    return this->GetDefaultDevice();
+  }
+  return OpenCLDevice( device );
+}
+
+
+//------------------------------------------------------------------------------
+OpenCLDevice
+OpenCLContext::GetNextDevice()
+{
+  ITK_OPENCL_D( OpenCLContext );
+  const std::list< OpenCLDevice > devices = this->GetDevices();
+  if( devices.empty() )
+  {
+    return OpenCLDevice();
+  }
+
+  std::list< OpenCLDevice >::const_iterator device = devices.begin();
+  std::advance( device, d->next_device++ % devices.size() );
+  return *device;
+}
+
+
 //------------------------------------------------------------------------------
 // Returns the active queue handle without incurring retain/release overhead.
 cl_command_queue
@@ -1360,14 +1582,8 @@ OpenCLContext::BuildProgramFromSourceCode( const std::string & sourceCode,
   const std::string & prefixSourceCode,
   const std::string & postfixSourceCode )
 {
-  OpenCLProgram program = this->CreateProgramFromSourceCode( sourceCode,
-    prefixSourceCode, postfixSourceCode );
-
-  if( program.IsNull() || program.Build() )
-  {
-    return program;
-  }
-  return OpenCLProgram();
+  return this->BuildProgramFromSourceCode( std::list< OpenCLDevice >(),
+    sourceCode, prefixSourceCode, postfixSourceCode );
 }
 
 
@@ -1379,17 +1595,116 @@ OpenCLContext::BuildProgramFromSourceCode( const std::list< OpenCLDevice > & dev
   const std::string & postfixSourceCode,
   const std::string & extraBuildOptions )
 {
+  // The cache is used for programs that are built for the default device
+  // only, for which CreateProgramFromBinaryCode() creates the program.
+  // The Intel debugger needs the debug source file, which is not created
+  // for a binary.
+  bool useCache = this->GetProgramCacheEnabled() && !sourceCode.empty();
+#if defined( OPENCL_USE_INTEL_CPU ) && defined( _DEBUG )
+  useCache = false;
+#endif
+  const OpenCLDevice device = this->GetDefaultDevice();
+  if( devices.empty() )
+  {
+    useCache = useCache && this->GetDevices().size() == 1;
+  }
+  else
+  {
+    useCache = useCache && devices.size() == 1 && devices.front() == device;
+  }
+
+  std::string cacheFileName;
+  if( useCache && !device.IsNull() )
+  {
+    std::string buildOptions;
+    OpenCLProgramSupport::GetOpenCLMathAndOptimizationOptions( buildOptions );
+    buildOptions.append( " " );
+    buildOptions.append( extraBuildOptions );
+
+    cacheFileName = GetOpenCLProgramCacheFileName( this->GetProgramCacheDirectory(),
+      device, buildOptions, sourceCode, prefixSourceCode, postfixSourceCode );
+
+    // A binary that cannot be loaded, for example one of an other driver
+    // with the same version string, is replaced by a new build.
+    std::vector< unsigned char > binary;
+    if( ReadOpenCLProgramBinary( cacheFileName, binary ) )
+    {
+      try
+      {
+        OpenCLProgram program = this->CreateProgramFromBinaryCode( &binary[ 0 ], binary.size() );
+        if( !program.IsNull() && program.Build( devices, extraBuildOptions ) )
+        {
+          return program;
+        }
+      }
+      catch( ExceptionObject & )
+      {
+        itkOpenCLWarningMacro( << "Cannot load OpenCL program from cache file: " << cacheFileName );
+      }
+    }
+  }
+
   OpenCLProgram program = this->CreateProgramFromSourceCode( sourceCode,
     prefixSourceCode, postfixSourceCode );
 
   if( program.IsNull() || program.Build( devices, extraBuildOptions ) )
   {
+    if( !program.IsNull() && !cacheFileName.empty() )
+    {
+      const std::list< OpenCLDevice > programDevices = program.GetDevices();
+      const std::vector< std::vector< unsigned char > > binaries = program.GetBinaries();
+      std::list< OpenCLDevice >::const_iterator dev = programDevices.begin();
+      for( std::size_t i = 0; i < binaries.size() && dev != programDevices.end(); ++i, ++dev )
+      {
+        if( *dev == device && !binaries[ i ].empty() )
+        {
+          WriteOpenCLProgramBinary( cacheFileName, binaries[ i ] );
+          break;
+        }
+      }
+    }
     return program;
   }
   return OpenCLProgram();
 }
 
 
+//------------------------------------------------------------------------------
+void
+OpenCLContext::SetProgramCacheEnabled( const bool enabled )
+{
+  ITK_OPENCL_D( OpenCLContext );
+  d->program_cache_enabled = enabled;
+}
+
+
+//------------------------------------------------------------------------------
+bool
+OpenCLContext::GetProgramCacheEnabled() const
+{
+  ITK_OPENCL_D( const OpenCLContext );
+  return d->program_cache_enabled && !d->program_cache_directory.empty();
+}
+
+
+//------------------------------------------------------------------------------
+void
+OpenCLContext::SetProgramCacheDirectory( const std::string & directory )
+{
+  ITK_OPENCL_D( OpenCLContext );
+  d->program_cache_directory = directory;
+}
+
+
+//------------------------------------------------------------------------------
+std::string
+OpenCLContext::GetProgramCacheDirectory() const
+{
+  ITK_OPENCL_D( const OpenCLContext );
+  return d->program_cache_directory;
+}
+
+
 //------------------------------------------------------------------------------
 OpenCLProgram
 OpenCLContext::BuildProgramFromSourceFile( const std::string & filename,
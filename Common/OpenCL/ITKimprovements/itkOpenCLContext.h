@@ -248,6 +248,24 @@ public:
   OpenCLCommandQueue CreateCommandQueue( const cl_command_queue_properties properties,
     const OpenCLDevice & device = OpenCLDevice() );
 
+  /** Returns the default command queue for \a device, which has to be one of
+   * GetDevices(). The queue is created once per device, like
+   * GetDefaultCommandQueue() for GetDefaultDevice(). Make it the active
+   * queue with SetCommandQueue() to issue commands to \a device.
+   * \sa GetDefaultCommandQueue(), SetCommandQueue(), GetNextDevice() */
+  OpenCLCommandQueue GetDefaultCommandQueue( const OpenCLDevice & device );
+
+  /** Returns the device of the active command queue, or a null OpenCLDevice
+   * if the context has not been created yet.
+   * \sa GetCommandQueue(), GetDefaultDevice() */
+  OpenCLDevice GetActiveDevice();
+
+  /** Returns the devices of GetDevices() in turn, to place independent jobs
+   * round-robin on the devices of this context. Can be called from several
+   * threads.
+   * \sa GetDevices(), GetDefaultCommandQueue( const OpenCLDevice & ) */
+  OpenCLDevice GetNextDevice();
+
   /** Creates an OpenCL memory buffer of \a size bytes in length,
    * with the specified \a access mode.
    * The memory is created on the device and will not be accessible
@@ -349,7 +367,12 @@ public:
   /** Creates an OpenCL program object from the supplied STL strings
    * \a sourceCode, \a prefixSourceCode and then builds it.
    * Returns a null OpenCLProgram if the program could not be built.
-   * \sa CreateProgramFromSourceCode(), BuildProgramFromSourceFile() */
+   * If the program cache is enabled and the program is built for a single
+   * device, the binary of a previous build with the same source, build
+   * options, device and driver is loaded from the cache instead of compiling
+   * the source, and a new binary is stored in it.
+   * \sa CreateProgramFromSourceCode(), BuildProgramFromSourceFile(),
+   * SetProgramCacheEnabled() */
   OpenCLProgram BuildProgramFromSourceCode( const std::string & sourceCode,
     const std::string & prefixSourceCode = std::string(),
     const std::string & postfixSourceCode = std::string() );
@@ -374,6 +397,27 @@ public:
     const std::string & postfixSourceCode = std::string(),
     const std::string & extraBuildOptions = std::string() );
 
+  /** Enables or disables the on-disk cache of program binaries used by
+   * BuildProgramFromSourceCode(). The cache is enabled by default, unless
+   * the environment variable \c{ELASTIX_OPENCL_PROGRAM_CACHE} is set to
+   * \c{OFF} or \c{0}.
+   * \sa SetProgramCacheDirectory() */
+  void SetProgramCacheEnabled( const bool enabled );
+
+  bool GetProgramCacheEnabled() const;
+
+  /** Sets the directory of the program cache, which is created when the
+   * first binary is stored. The default is the directory given by the
+   * environment variable \c{ELASTIX_OPENCL_PROGRAM_CACHE_DIR}, or otherwise
+   * \c{elastix/OpenCLProgramCache} in the cache directory of the user:
+   * \c{%LOCALAPPDATA%} on Windows, \c{~/Library/Caches} on macOS and
+   * \c{$XDG_CACHE_HOME} or \c{~/.cache} elsewhere. An empty directory
+   * disables the cache.
+   * \sa SetProgramCacheEnabled() */
+  void SetProgramCacheDirectory( const std::string & directory );
+
+  std::string GetProgramCacheDirectory() const;
+
   /** Returns the list of supported image formats for processing
    * images with the specified image type \a image_type and memory \a flags. */
   std::list< OpenCLImageFormat > GetSupportedImageFormats(
@@ -20,18 +20,46 @@
 namespace itk
 {
 OpenCLProfilingTimeProbe::OpenCLProfilingTimeProbe( const std::string & message ) :
-  m_ProfilingMessage( message )
+  m_ProfilingMessage( message ),
+  m_Stopped( false )
 {
   this->m_Timer.Start();
 }
 
 
+//------------------------------------------------------------------------------
+OpenCLProfilingTimeProbe::OpenCLProfilingTimeProbe( const std::string & message,
+  const OpenCLDevice & device ) :
+  m_ProfilingMessage( message ),
+  m_Stopped( false )
+{
+  if( !device.IsNull() )
+  {
+    this->m_ProfilingMessage += " on device " + device.GetName();
+  }
+  this->m_Timer.Start();
+}
+
+
 //------------------------------------------------------------------------------
 OpenCLProfilingTimeProbe::~OpenCLProfilingTimeProbe()
 {
-  this->m_Timer.Stop();
-  std::cout << this->m_ProfilingMessage << " took "
-            << this->m_Timer.GetMean() << " seconds." << std::endl;
+  this->Stop();
+}
+
+
+//------------------------------------------------------------------------------
+double
+OpenCLProfilingTimeProbe::Stop( void )
+{
+  if( !this->m_Stopped )
+  {
+    this->m_Timer.Stop();
+    this->m_Stopped = true;
+    std::cout << this->m_ProfilingMessage << " took "
+              << this->m_Timer.GetMean() << " seconds." << std::endl;
+  }
+  return this->m_Timer.GetMean();
 }
 
 
@@ -19,6 +19,7 @@
 #define __itkOpenCLProfilingTimeProbe_h
 
 #include "itkOpenCLExport.h"
+#include "itkOpenCLDevice.h"
 #include "itkTimeProbe.h"
 
 #include <string>
@@ -28,6 +29,10 @@ namespace itk
 /** \class OpenCLProfilingTimeProbe
  * \brief Computes the time passed between two points in code.
  *
+ * If a device is given, the name of the device is reported with the time,
+ * to tell the timings of the devices of a multi-device context apart.
+ * The time is reported when the probe is stopped, or destroyed.
+ *
  * \ingroup OpenCL
  * \sa TimeProbe
  */
@@ -38,13 +43,22 @@ public:
   /** Constructor */
   OpenCLProfilingTimeProbe( const std::string & message );
 
-  /** Destructor */
+  /** Constructor for a time that is spent on \a device. */
+  OpenCLProfilingTimeProbe( const std::string & message, const OpenCLDevice & device );
+
+  /** Destructor, stops the probe if it has not been stopped. */
   ~OpenCLProfilingTimeProbe();
 
+  /** Stop the probe, report the time passed and return it in seconds.
+   * Stopping the probe again only returns the time.
+   */
+  double Stop( void );
+
 private:
 
   TimeProbe   m_Timer;
   std::string m_ProfilingMessage;
+  bool        m_Stopped;
 };
 
 } // end namespace itk
@@ -394,6 +394,45 @@ std::list< OpenCLDevice > OpenCLProgram::GetDevices() const
 }
 
 
+//------------------------------------------------------------------------------
+std::vector< std::vector< unsigned char > >
+OpenCLProgram::GetBinaries() const
+{
+  std::vector< std::vector< unsigned char > > binaries;
+  cl_uint                                     size;
+
+  if( clGetProgramInfo( this->m_Id, CL_PROGRAM_NUM_DEVICES,
+    sizeof( size ), &size, 0 ) != CL_SUCCESS || size == 0 )
+  {
+    return binaries;
+  }
+  std::vector< std::size_t > sizes( size );
+  if( clGetProgramInfo( this->m_Id, CL_PROGRAM_BINARY_SIZES,
+    size * sizeof( std::size_t ), &sizes[ 0 ], 0 ) != CL_SUCCESS )
+  {
+    return binaries;
+  }
+
+  // The binaries are copied to buffers allocated by the caller
+  binaries.resize( size );
+  std::vector< unsigned char * > buffers( size, 0 );
+  for( cl_uint i = 0; i < size; ++i )
+  {
+    binaries[ i ].resize( sizes[ i ] );
+    if( sizes[ i ] > 0 )
+    {
+      buffers[ i ] = &binaries[ i ][ 0 ];
+    }
+  }
+  if( clGetProgramInfo( this->m_Id, CL_PROGRAM_BINARIES,
+    size * sizeof( unsigned char * ), &buffers[ 0 ], 0 ) != CL_SUCCESS )
+  {
+    binaries.clear();
+  }
+  return binaries;
+}
+
+
 //------------------------------------------------------------------------------
 OpenCLKernel
 OpenCLProgram::CreateKernel( const std::string & name ) const
@@ -22,6 +22,7 @@
 #include "itkOpenCLKernel.h"
 
 #include <string>
+#include <vector>
 
 namespace itk
 {
@@ -101,6 +102,13 @@ public:
    * \sa GetBinaries() */
   std::list< OpenCLDevice > GetDevices() const;
 
+  /** Returns the binaries of this program, one for each device of
+   * GetDevices() and in the same order, as queried with
+   * \c{CL_PROGRAM_BINARIES}. The binary of a device is empty if the program
+   * has not been built for it.
+   * \sa GetDevices(), OpenCLContext::CreateProgramFromBinaryCode() */
+  std::vector< std::vector< unsigned char > > GetBinaries() const;
+
   /** Creates a kernel for the entry point associated with \a name
    * in this program.
    * \sa Build() */
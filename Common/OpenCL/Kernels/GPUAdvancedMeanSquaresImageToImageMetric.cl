@@ -0,0 +1,261 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+//
+// OpenCL implementation of the value and derivative of
+// itk::AdvancedMeanSquaresImageToImageMetric, for a B-spline transform
+// and a linearly interpolated moving image.
+//
+// This source requires the GPUMath, GPUImageBase and GPUBSplineTransform
+// sources, which have to be prepended.
+
+//------------------------------------------------------------------------------
+// Add a float to a float in global memory. OpenCL 1.1 has no atomic add for
+// floats, so it is emulated by a compare-exchange loop on the bits.
+void atomic_add_global_float( volatile __global float * address, const float value )
+{
+  union { unsigned int u; float f; } old_value, new_value;
+  do
+  {
+    old_value.f = *address;
+    new_value.f = old_value.f + value;
+  }
+  while( atomic_cmpxchg( (volatile __global unsigned int *)address,
+    old_value.u, new_value.u ) != old_value.u );
+}
+
+//------------------------------------------------------------------------------
+#ifdef DIM_3
+// Mirror a continuous index at the image boundaries, like
+// itk::AdvancedLinearInterpolateImageFunction. Returns the sign of the
+// derivative, which flips at a mirrored boundary.
+float mirror_continuous_index( float * cindex, const uint size )
+{
+  float sign = 1.0f;
+  const float end_index = (float)( size ) - 1.0f;
+  if( *cindex < 0.0f )
+  {
+    *cindex = -( *cindex );
+    sign = -1.0f;
+  }
+  if( *cindex > end_index )
+  {
+    *cindex = 2.0f * end_index - ( *cindex );
+    sign = -sign;
+  }
+  if( *cindex > end_index - 1.0e-6f )
+  {
+    *cindex = end_index - 1.0e-6f;
+  }
+  if( *cindex < 0.0f )
+  {
+    *cindex = 0.0f;
+  }
+  return sign;
+}
+
+//------------------------------------------------------------------------------
+// Linear interpolation of the value and the physical gradient of a 3D image
+// at a continuous index, like
+// itk::AdvancedLinearInterpolateImageFunction::EvaluateValueAndDerivative().
+float linear_value_and_derivative_3d( float3 cindex,
+  __global const float * in,
+  __constant GPUImageBase3D * image,
+  float3 * derivative )
+{
+  float sign_x = mirror_continuous_index( &cindex.x, image->size.x );
+  float sign_y = mirror_continuous_index( &cindex.y, image->size.y );
+  float sign_z = mirror_continuous_index( &cindex.z, image->size.z );
+
+  const uint3 base = (uint3)( (uint)floor( cindex.x ),
+    (uint)floor( cindex.y ), (uint)floor( cindex.z ) );
+  const float3 dist = cindex - (float3)( (float)base.x, (float)base.y, (float)base.z );
+  const float3 dinv = (float3)( 1.0f, 1.0f, 1.0f ) - dist;
+
+  // Neighbours along each dimension, clamped for sizes of one
+  const uint nx = min( base.x + 1, image->size.x - 1 ) - base.x;
+  const uint ny = ( min( base.y + 1, image->size.y - 1 ) - base.y ) * image->size.x;
+  const uint nz = ( min( base.z + 1, image->size.z - 1 ) - base.z ) * image->size.x * image->size.y;
+
+  const uint gidx = mad24( image->size.x, mad24( base.z, image->size.y, base.y ), base.x );
+  const float val000 = in[ gidx ];
+  const float val100 = in[ gidx + nx ];
+  const float val010 = in[ gidx + ny ];
+  const float val110 = in[ gidx + nx + ny ];
+  const float val001 = in[ gidx + nz ];
+  const float val101 = in[ gidx + nx + nz ];
+  const float val011 = in[ gidx + ny + nz ];
+  const float val111 = in[ gidx + nx + ny + nz ];
+
+  const float value
+    = val000 * dinv.x * dinv.y * dinv.z
+    + val100 * dist.x * dinv.y * dinv.z
+    + val010 * dinv.x * dist.y * dinv.z
+    + val001 * dinv.x * dinv.y * dist.z
+    + val110 * dist.x * dist.y * dinv.z
+    + val011 * dinv.x * dist.y * dist.z
+    + val101 * dist.x * dinv.y * dist.z
+    + val111 * dist.x * dist.y * dist.z;
+
+  // The derivative with respect to the index
+  float3 dindex;
+  dindex.x = sign_x
+    * ( dinv.y * dinv.z * ( val100 - val000 )
+    + dist.y * dinv.z * ( val110 - val010 )
+    + dinv.y * dist.z * ( val101 - val001 )
+    + dist.y * dist.z * ( val111 - val011 ) );
+  dindex.y = sign_y
+    * ( dinv.x * dinv.z * ( val010 - val000 )
+    + dist.x * dinv.z * ( val110 - val100 )
+    + dinv.x * dist.z * ( val011 - val001 )
+    + dist.x * dist.z * ( val111 - val101 ) );
+  dindex.z = sign_z
+    * ( dinv.x * dinv.y * ( val001 - val000 )
+    + dist.x * dinv.y * ( val101 - val100 )
+    + dinv.x * dist.y * ( val011 - val010 )
+    + dist.x * dist.y * ( val111 - val110 ) );
+
+  // The physical derivative is the transposed physical_point_to_index
+  // matrix times the index derivative.
+  *derivative
+    = dindex.x * image->physical_point_to_index.s012
+    + dindex.y * image->physical_point_to_index.s345
+    + dindex.z * image->physical_point_to_index.s678;
+
+  return value;
+}
+#endif // DIM_3
+
+//------------------------------------------------------------------------------
+// Each work item processes one fixed image sample. The squared differences
+// and the number of valid samples are reduced in local memory to one partial
+// sum per work group, which the host adds. The derivative contributions of
+// the (spline_order + 1)^3 parameters per dimension in the support of the
+// sample are added to the derivative with atomics, with the global indices
+// of the parameters following the layout of the B-spline parameters: the
+// coefficients of dimension d start at d * number_of_parameters_per_dimension.
+// The local size has to be a power of two.
+#ifdef DIM_3
+__kernel void AdvancedMeanSquaresValueAndDerivative(
+  __global const float * fixed_points,
+  __global const float * fixed_values,
+  const uint number_of_samples,
+  __global const float * moving_image,
+  __constant GPUImageBase3D * moving_image_base,
+  __global const float * parameters,
+  __constant GPUImageBase3D * grid_base,
+  const uint spline_order,
+  __global float * derivative,
+  __global float * partial_sums,
+  __local float * local_measure,
+  __local float * local_count )
+{
+  const uint gid = get_global_id( 0 );
+  const uint lid = get_local_id( 0 );
+  const uint local_size = get_local_size( 0 );
+
+  float measure = 0.0f;
+  float count = 0.0f;
+
+  if( gid < number_of_samples )
+  {
+    const float3 fixed_point = (float3)( fixed_points[ 3 * gid ],
+      fixed_points[ 3 * gid + 1 ], fixed_points[ 3 * gid + 2 ] );
+
+    // Map the point with the B-spline transform, keeping the weights for
+    // the derivative. Outside the support the point is not moved.
+    const uint support_size = spline_order + 1;
+    const uint number_of_weights = support_size * support_size * support_size;
+    const uint number_of_parameters_per_dimension
+      = grid_base->size.x * grid_base->size.y * grid_base->size.z;
+    float weights[ 64 ];
+    long3 start_index = (long3)( 0, 0, 0 );
+
+    float3 grid_cindex = transform_physical_point_to_continuous_index_3d( fixed_point,
+      grid_base->physical_point_to_index, grid_base->origin );
+    const bool inside_support = inside_valid_region_3d( &grid_cindex, spline_order, grid_base->size );
+
+    float3 mapped_point = fixed_point;
+    if( inside_support )
+    {
+      start_index = evaluate_3d( grid_cindex, spline_order, support_size,
+        number_of_weights, weights );
+      for( uint k = 0; k < number_of_weights; ++k )
+      {
+        const uint x = start_index.x + ( k % support_size );
+        const uint y = start_index.y + ( k / support_size ) % support_size;
+        const uint z = start_index.z + ( k / support_size / support_size );
+        const uint pidx = mad24( grid_base->size.x, mad24( z, grid_base->size.y, y ), x );
+        mapped_point.x = mad( parameters[ pidx ], weights[ k ], mapped_point.x );
+        mapped_point.y = mad( parameters[ pidx + number_of_parameters_per_dimension ], weights[ k ], mapped_point.y );
+        mapped_point.z = mad( parameters[ pidx + 2 * number_of_parameters_per_dimension ], weights[ k ], mapped_point.z );
+      }
+    }
+
+    // Evaluate the moving image, if the mapped point is inside its buffer
+    const float3 moving_cindex = transform_physical_point_to_continuous_index_3d( mapped_point,
+      moving_image_base->physical_point_to_index, moving_image_base->origin );
+    if( is_continuous_index_inside_3d( moving_cindex, moving_image_base->size ) )
+    {
+      float3 moving_derivative;
+      const float moving_value = linear_value_and_derivative_3d( moving_cindex,
+        moving_image, moving_image_base, &moving_derivative );
+
+      const float diff = moving_value - fixed_values[ gid ];
+      measure = diff * diff;
+      count = 1.0f;
+
+      // Scatter 2 * diff * weight * dM/dx_d to the parameters of the support
+      if( inside_support )
+      {
+        const float3 diff_2 = ( 2.0f * diff ) * moving_derivative;
+        for( uint k = 0; k < number_of_weights; ++k )
+        {
+          const uint x = start_index.x + ( k % support_size );
+          const uint y = start_index.y + ( k / support_size ) % support_size;
+          const uint z = start_index.z + ( k / support_size / support_size );
+          const uint pidx = mad24( grid_base->size.x, mad24( z, grid_base->size.y, y ), x );
+          atomic_add_global_float( &derivative[ pidx ], diff_2.x * weights[ k ] );
+          atomic_add_global_float( &derivative[ pidx + number_of_parameters_per_dimension ], diff_2.y * weights[ k ] );
+          atomic_add_global_float( &derivative[ pidx + 2 * number_of_parameters_per_dimension ], diff_2.z * weights[ k ] );
+        }
+      }
+    }
+  }
+
+  // Reduce the measure and the number of valid samples of the work group
+  local_measure[ lid ] = measure;
+  local_count[ lid ] = count;
+  barrier( CLK_LOCAL_MEM_FENCE );
+  for( uint stride = local_size / 2; stride > 0; stride >>= 1 )
+  {
+    if( lid < stride )
+    {
+      local_measure[ lid ] += local_measure[ lid + stride ];
+      local_count[ lid ] += local_count[ lid + stride ];
+    }
+    barrier( CLK_LOCAL_MEM_FENCE );
+  }
+
+  if( lid == 0 )
+  {
+    const uint group = get_group_id( 0 );
+    partial_sums[ 2 * group ] = local_measure[ 0 ];
+    partial_sums[ 2 * group + 1 ] = local_count[ 0 ];
+  }
+}
+#endif // DIM_3
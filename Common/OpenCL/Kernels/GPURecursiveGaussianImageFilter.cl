@@ -22,7 +22,9 @@
 // \note This work was funded by the Netherlands Organisation for
 // Scientific Research (NWO NRG-2010.02 and NWO 639.021.124).
 //
-// OpenCL implementation of itk::RecursiveGaussianImageFilter
+// OpenCL implementation of itk::RecursiveGaussianImageFilter, by the
+// recursion along one line per work item, or by a separable FIR convolution
+// with the impulse response of the recursion, for small and medium sigmas.
 
 #define _ELASTIX_USE_OPENCL_OPTIMIZATIONS 0
 
@@ -137,6 +139,63 @@ uint get_image_offset( const uint gix,
   return gidx;
 }
 
+//------------------------------------------------------------------------------
+// Convolve the image along the direction with the 2 * radius + 1 weights,
+// one work item per pixel. Each work group first loads its block of the
+// image to the local tile, extended by the radius on both sides along the
+// direction. The indices are clamped at the image boundaries, which extends
+// the border values to infinity like the recursion does. The local size
+// along the direction is larger than one only for the direction itself and
+// x, so that the loads from global memory are coalesced.
+// Unused dimensions have size one.
+__kernel void GaussianFIRImageFilter( __global const INPIXELTYPE *in,
+                                      __global OUTPIXELTYPE *out,
+                                      __constant float *weights,
+                                      uint radius, uint direction,
+                                      uint width, uint height, uint depth,
+                                      __local BUFFPIXELTYPE *tile )
+{
+  const uint3 local_size = (uint3)( get_local_size( 0 ), get_local_size( 1 ), get_local_size( 2 ) );
+  const uint3 local_id   = (uint3)( get_local_id( 0 ), get_local_id( 1 ), get_local_id( 2 ) );
+
+  // The size of the tile, and the image index of its first element
+  const uint3 extension = (uint3)( direction == 0 ? 2 * radius : 0,
+                                   direction == 1 ? 2 * radius : 0,
+                                   direction == 2 ? 2 * radius : 0 );
+  const uint3 tile_size = local_size + extension;
+  const int3  origin    = (int3)( (int)( get_group_id( 0 ) * local_size.x ),
+                                  (int)( get_group_id( 1 ) * local_size.y ),
+                                  (int)( get_group_id( 2 ) * local_size.z ) ) - convert_int3( extension / 2 );
+
+  // Load the tile, with all work items of the group
+  const uint number_of_work_items = local_size.x * local_size.y * local_size.z;
+  const uint number_of_elements   = tile_size.x * tile_size.y * tile_size.z;
+  for ( uint t = get_image_offset( local_id.x, local_id.y, local_id.z, local_size.x, local_size.y );
+        t < number_of_elements; t += number_of_work_items )
+  {
+    const uint x = (uint)clamp( origin.x + (int)( t % tile_size.x ), 0, (int)width - 1 );
+    const uint y = (uint)clamp( origin.y + (int)( ( t / tile_size.x ) % tile_size.y ), 0, (int)height - 1 );
+    const uint z = (uint)clamp( origin.z + (int)( t / ( tile_size.x * tile_size.y ) ), 0, (int)depth - 1 );
+    tile[t] = (BUFFPIXELTYPE)( in[get_image_offset( x, y, z, width, height )] );
+  }
+  barrier( CLK_LOCAL_MEM_FENCE );
+
+  const uint3 index = (uint3)( get_global_id( 0 ), get_global_id( 1 ), get_global_id( 2 ) );
+  if ( index.x < width && index.y < height && index.z < depth )
+  {
+    // The tile element of the first weight is radius pixels before the pixel
+    const uint first  = get_image_offset( local_id.x, local_id.y, local_id.z, tile_size.x, tile_size.y );
+    const uint stride = direction == 0 ? 1 : ( direction == 1 ? tile_size.x : tile_size.x * tile_size.y );
+
+    BUFFPIXELTYPE sum = 0.0f;
+    for ( uint k = 0; k <= 2 * radius; ++k )
+    {
+      sum = mad( (BUFFPIXELTYPE)( weights[k] ), tile[first + k * stride], sum );
+    }
+    out[get_image_offset( index.x, index.y, index.z, width, height )] = (OUTPIXELTYPE)( sum );
+  }
+}
+
 //------------------------------------------------------------------------------
 #ifdef DIM_1
 __kernel void RecursiveGaussianImageFilter( __global const INPIXELTYPE *in,
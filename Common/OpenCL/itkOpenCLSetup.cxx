@@ -19,6 +19,7 @@
 
 #include "itkOpenCLLogger.h"
 #include "itkOpenCLContext.h"
+#include <algorithm>
 #include <sstream>
 
 namespace itk
@@ -28,6 +29,17 @@ bool
 CreateOpenCLContext( std::string & errorMessage,
   const std::string openCLDeviceType,
   const int openCLDeviceID )
+{
+  const std::vector< int > openCLDeviceIDs( 1, openCLDeviceID );
+  return CreateOpenCLContext( errorMessage, openCLDeviceType, openCLDeviceIDs );
+} // end CreateOpenCLContext()
+
+
+//------------------------------------------------------------------------------
+bool
+CreateOpenCLContext( std::string & errorMessage,
+  const std::string openCLDeviceType,
+  const std::vector< int > & openCLDeviceIDs )
 {
   /** Get a handle to an existing OpenCL context. */
   itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
@@ -38,7 +50,8 @@ CreateOpenCLContext( std::string & errorMessage,
   /** The default behavior is that the device ID and type are not supplied.
    * In that case we estimate which is the best performing device and select it.
    */
-  if( openCLDeviceType == "GPU" && openCLDeviceID == -1 )
+  if( openCLDeviceType == "GPU"
+    && ( openCLDeviceIDs.empty() || ( openCLDeviceIDs.size() == 1 && openCLDeviceIDs[ 0 ] == -1 ) ) )
   {
 #if defined( OPENCL_USE_INTEL_CPU ) || defined( OPENCL_USE_AMD_CPU )
     return context->Create( itk::OpenCLContext::DevelopmentSingleMaximumFlopsDevice );
@@ -81,8 +94,18 @@ CreateOpenCLContext( std::string & errorMessage,
     }
   }
 
-  /** Check if user provided the correct OpenCL device ID. */
-  if( ( openCLDeviceID < 0 ) || ( openCLDeviceID > static_cast< int >( devicesByType.size() ) - 1 ) )
+  /** Check if user provided the correct OpenCL device IDs. */
+  int openCLDeviceID = openCLDeviceIDs.empty() ? -1 : openCLDeviceIDs[ 0 ];
+  for( std::size_t i = 0; i < openCLDeviceIDs.size(); ++i )
+  {
+    if( ( openCLDeviceIDs[ i ] < 0 ) || ( openCLDeviceIDs[ i ] > static_cast< int >( devicesByType.size() ) - 1 ) )
+    {
+      openCLDeviceID = openCLDeviceIDs[ i ];
+      break;
+    }
+  }
+  if( openCLDeviceIDs.empty()
+    || ( openCLDeviceID < 0 ) || ( openCLDeviceID > static_cast< int >( devicesByType.size() ) - 1 ) )
   {
     const std::string s = ( devicesByType.size() > 1 ) ? "s" : "";
     std::stringstream errorMessageStream;
@@ -126,25 +149,46 @@ CreateOpenCLContext( std::string & errorMessage,
     return false;
   }
 
-  /** Select the OpenCL device ID. The operator[] does not exist for std::list.
-   * We have to loop over devicesByType and select it. */
+  /** Select the OpenCL device IDs, in the given order, once each. The
+   * operator[] does not exist for std::list. We have to loop over
+   * devicesByType and select them. */
   std::list< itk::OpenCLDevice > selected;
-  int                            deviceID = 0;
-  for( std::list< OpenCLDevice >::const_iterator device = devicesByType.begin();
-    device != devicesByType.end(); ++device )
+  for( std::size_t i = 0; i < openCLDeviceIDs.size(); ++i )
   {
+    int deviceID = 0;
+    for( std::list< OpenCLDevice >::const_iterator device = devicesByType.begin();
+      device != devicesByType.end(); ++device )
     {
-      if( deviceID == openCLDeviceID )
+      if( deviceID == openCLDeviceIDs[ i ] )
       {
-        selected.push_back( *device );
+        if( std::find( selected.begin(), selected.end(), *device ) == selected.end() )
+        {
+          selected.push_back( *device );
+        }
         break;
       }
       ++deviceID;
     }
   }
 
-  /** Create OpenCL context that matches selected device. */
-  if( selected.size() == 1 )
+  /** A context can only hold the devices of one platform. */
+  for( std::list< OpenCLDevice >::const_iterator device = selected.begin();
+    device != selected.end(); ++device )
+  {
+    if( !( ( *device ).GetPlatform() == selected.front().GetPlatform() ) )
+    {
+      std::stringstream errorMessageStream;
+      errorMessageStream << "ERROR: The selected OpenCL devices " << selected.front().GetName()
+                         << " and " << ( *device ).GetName() << " are not of the same platform." << std::endl
+                         << indent << "Please select the devices of one platform only." << std::endl;
+      errorMessage = errorMessageStream.str();
+
+      return false;
+    }
+  }
+
+  /** Create OpenCL context that matches selected devices. */
+  if( !selected.empty() )
   {
     context->Create( selected );
   }
@@ -179,10 +223,14 @@ CreateOpenCLContext( std::string & errorMessage,
    * We are making it minimum requirements for elastix with OpenCL for now.
    * Although this check is too strict for the Intel HD GPU which only supports float (2014).
    * The support for the Intel HD has to be investigated, while Intel OpenCL CPU should work. */
-  if( !context->GetDefaultDevice().HasDouble() )
+  const std::list< OpenCLDevice > contextDevices = context->GetDevices();
+  for( std::list< OpenCLDevice >::const_iterator device = contextDevices.begin();
+    device != contextDevices.end(); ++device )
   {
+    if( ( *device ).HasDouble() ) { continue; }
+
     std::stringstream errorMessageStream;
-    errorMessageStream << "ERROR: OpenCL device: " << context->GetDefaultDevice().GetName()
+    errorMessageStream << "ERROR: OpenCL device: " << ( *device ).GetName()
                        << ", does not support 'double' computations." << std::endl
                        << indent << "OpenCL processing in elastix is disabled, since 'double' support is currently required. "
                        << "Processing will be performed on the CPU instead." << std::endl
@@ -196,6 +244,30 @@ CreateOpenCLContext( std::string & errorMessage,
 } // end CreateOpenCLContext()
 
 
+//------------------------------------------------------------------------------
+bool
+GetOpenCLDeviceIDs( const std::string & deviceList, std::vector< int > & openCLDeviceIDs )
+{
+  openCLDeviceIDs.clear();
+
+  std::stringstream deviceListStream( deviceList );
+  std::string       deviceID;
+  while( std::getline( deviceListStream, deviceID, ',' ) )
+  {
+    std::stringstream deviceIDStream( deviceID );
+    int               id = -1;
+    if( !( deviceIDStream >> id ) || !( deviceIDStream >> std::ws ).eof() || id < 0 )
+    {
+      openCLDeviceIDs.clear();
+      return false;
+    }
+    openCLDeviceIDs.push_back( id );
+  }
+
+  return !openCLDeviceIDs.empty();
+} // end GetOpenCLDeviceIDs()
+
+
 //------------------------------------------------------------------------------
 void
 CreateOpenCLLogger( const std::string & prefixFileName, const std::string & outputDirectory )
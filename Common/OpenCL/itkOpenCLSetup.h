@@ -19,6 +19,7 @@
 #define __itkOpenCLSetup_h
 
 #include <string>
+#include <vector>
 
 /** This file contains helper functionality to enable
  * OpenCL support within elastix and transformix.
@@ -29,6 +30,16 @@ namespace itk
 bool CreateOpenCLContext( std::string & errorMessage,
   const std::string openCLDeviceType, const int openCLDeviceID );
 
+/** Method that is used to create OpenCL context within elastix and transformix,
+ * with all the devices of \a openCLDeviceIDs, which have to be of the same
+ * platform. The jobs are placed on the devices round-robin. */
+bool CreateOpenCLContext( std::string & errorMessage,
+  const std::string openCLDeviceType, const std::vector< int > & openCLDeviceIDs );
+
+/** Method that converts a comma separated list of OpenCL device IDs, such as
+ * "0,1,2,3" of the -gpu command line option. Returns false for an invalid list. */
+bool GetOpenCLDeviceIDs( const std::string & deviceList, std::vector< int > & openCLDeviceIDs );
+
 /** Method that is used to create OpenCL logger within elastix and transformix. */
 void CreateOpenCLLogger( const std::string & prefixFileName, const std::string & outputDirectory );
 
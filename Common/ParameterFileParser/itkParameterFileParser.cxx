@@ -22,8 +22,8 @@
 #include "itkParameterFileParser.h"
 
 #include <itksys/SystemTools.hxx>
-#include <itksys/RegularExpression.hxx>
 
+#include <algorithm>
 #include <fstream>
 
 namespace itk
@@ -168,51 +168,35 @@ ParameterFileParser
    * 4) Remove trailing spaces
    */
   lineOut = lineIn;
-  itksys::SystemTools::ReplaceString( lineOut, "\t", " " );
+  std::replace( lineOut.begin(), lineOut.end(), '\t', ' ' );
 
-  itksys::RegularExpression commentPart( "//" );
-  if( commentPart.find( lineOut ) )
+  const std::string::size_type commentStart = lineOut.find( "//" );
+  if( commentStart != std::string::npos )
   {
-    lineOut = lineOut.substr( 0, commentPart.start() );
-  }
-
-  itksys::RegularExpression leadingSpaces( "^[ ]*(.*)" );
-  leadingSpaces.find( lineOut );
-  lineOut = leadingSpaces.match( 1 );
-
-  itksys::RegularExpression trailingSpaces( "[ \t]+$" );
-  if( trailingSpaces.find( lineOut ) )
-  {
-    lineOut = lineOut.substr( 0, trailingSpaces.start() );
+    lineOut.erase( commentStart );
   }
 
   /**
    * Checks:
-   * 1. Empty line -> false
-   * 2. Comment (line starts with "//") -> false
-   * 3. Line is not between brackets (...) -> exception
-   * 4. Line contains less than two words -> exception
+   * 1. Empty line or comment -> false
+   * 2. Line is not between brackets (...) -> exception
+   * 3. Line contains less than two words -> exception
    *
    * Otherwise return true.
    */
 
-  /** 1. Check for non-empty lines. */
-  itksys::RegularExpression reNonEmptyLine( "[^ ]+" );
-  const bool                match1 = reNonEmptyLine.find( lineOut );
-  if( !match1 )
+  /** 1. Check for non-empty lines. Comments have been removed already. */
+  const std::string::size_type first = lineOut.find_first_not_of( ' ' );
+  if( first == std::string::npos )
   {
+    lineOut.clear();
     return false;
   }
 
-  /** 2. Check for comments. */
-  itksys::RegularExpression reComment( "^//" );
-  const bool                match2 = reComment.find( lineOut );
-  if( match2 )
-  {
-    return false;
-  }
+  const std::string::size_type last = lineOut.find_last_not_of( ' ' );
+  lineOut = lineOut.substr( first, last - first + 1 );
 
-  /** 3. Check if line is between brackets. */
+  /** 2. Check if line is between brackets. */
   if( !itksys::SystemTools::StringStartsWith( lineOut, "(" )
     || !itksys::SystemTools::StringEndsWith( lineOut, ")" ) )
   {
@@ -223,10 +207,10 @@ ParameterFileParser
   /** Remove brackets. */
   lineOut = lineOut.substr( 1, lineOut.size() - 2 );
 
-  /** 4. Check: the line should contain at least two words. */
-  itksys::RegularExpression reTwoWords( "([ ]+)([^ ]+)" );
-  const bool                match4 = reTwoWords.find( lineOut );
-  if( !match4 )
+  /** 3. Check: the line should contain at least two words. */
+  const std::string::size_type firstSpace = lineOut.find( ' ' );
+  if( firstSpace == std::string::npos
+    || lineOut.find_first_not_of( ' ', firstSpace ) == std::string::npos )
   {
     const std::string hint = "Line does not contain a parameter name and value.";
     this->ThrowException( lineIn, hint );
@@ -271,18 +255,20 @@ ParameterFileParser
 
   /** 3) Get the parameter values. */
   std::vector< std::string > parameterValues;
-  for( const auto& value: splittedLine )
+  parameterValues.reserve( splittedLine.size() );
+  for( auto & value: splittedLine )
   {
     if( ! value.empty() )
     {
-      parameterValues.push_back( value );
+      parameterValues.push_back( std::move( value ) );
     }
   }
 
-  /** 4) Perform some checks on the parameter name. */
-  itksys::RegularExpression reInvalidCharacters1( "[.,:;!@#$%^&-+|<>?]" );
-  const bool                match = reInvalidCharacters1.find( parameterName );
-  if( match )
+  /** 4) Perform some checks on the parameter name. The characters are those
+   * of the regular expression [.,:;!@#$%^&-+|<>?] that was used before, in
+   * which &-+ is the range &'()*+.
+   */
+  if( parameterName.find_first_of( ".,:;!@#$%^&'()*+|<>?" ) != std::string::npos )
   {
     const std::string hint = "The parameter \""
       + parameterName
@@ -291,11 +277,10 @@ ParameterFileParser
   }
 
   /** 5) Perform checks on the parameter values. */
-  itksys::RegularExpression reInvalidCharacters2( "[,;!@#$%&|<>?]" );
   for( const auto& parameterValue: parameterValues )
   {
     /** For all entries some characters are not allowed. */
-    if( reInvalidCharacters2.find( parameterValue ) )
+    if( parameterValue.find_first_of( ",;!@#$%&|<>?" ) != std::string::npos )
     {
       const std::string hint = "The parameter value \""
         + parameterValue
@@ -314,7 +299,7 @@ ParameterFileParser
   }
   else
   {
-    this->m_ParameterMap.insert( make_pair( parameterName, parameterValues ) );
+    this->m_ParameterMap.insert( make_pair( parameterName, std::move( parameterValues ) ) );
   }
 
 } // end GetParameterFromLine()
@@ -18,9 +18,80 @@
 
 #include "itkParameterMapInterface.h"
 
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
+
 namespace itk
 {
 
+namespace
+{
+
+/** Check that str consists of an optional sign followed by digits only. */
+bool
+IsPlainInteger( const std::string & str, const bool allowMinus )
+{
+  std::string::size_type start = 0;
+  if( !str.empty() && ( str[ 0 ] == '+' || ( allowMinus && str[ 0 ] == '-' ) ) )
+  {
+    start = 1;
+  }
+  return start < str.size()
+         && str.find_first_not_of( "0123456789", start ) == std::string::npos;
+}
+
+
+/** Convert a plain integer with strtoll, and check the range of T. */
+template< class T >
+bool
+SignedStringToNumber( const std::string & str, T & number )
+{
+  if( !IsPlainInteger( str, true ) )
+  {
+    return false;
+  }
+
+  errno = 0;
+  char *          end   = nullptr;
+  const long long value = std::strtoll( str.c_str(), &end, 10 );
+  if( errno != 0 || *end != '\0'
+    || value < static_cast< long long >( std::numeric_limits< T >::min() )
+    || value > static_cast< long long >( std::numeric_limits< T >::max() ) )
+  {
+    return false;
+  }
+  number = static_cast< T >( value );
+  return true;
+}
+
+
+/** Convert a plain non-negative integer with strtoull, and check the range
+ * of T. A minus sign is left to the string stream.
+ */
+template< class T >
+bool
+UnsignedStringToNumber( const std::string & str, T & number )
+{
+  if( !IsPlainInteger( str, false ) )
+  {
+    return false;
+  }
+
+  errno = 0;
+  char *                   end   = nullptr;
+  const unsigned long long value = std::strtoull( str.c_str(), &end, 10 );
+  if( errno != 0 || *end != '\0'
+    || value > static_cast< unsigned long long >( std::numeric_limits< T >::max() ) )
+  {
+    return false;
+  }
+  number = static_cast< T >( value );
+  return true;
+}
+
+} // end namespace
+
 /**
  * **************** Constructor ***************
  */
@@ -146,6 +217,99 @@ ParameterMapInterface
 } // end StringCast()
 
 
+/**
+ * **************** StringToNumber ***************
+ */
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, double & number )
+{
+  /** Leave inf, nan, hexadecimal numbers and leading spaces, which strtod
+   * accepts, to the string stream.
+   */
+  if( str.empty() || str.find_first_not_of( "0123456789+-.eE" ) != std::string::npos )
+  {
+    return false;
+  }
+
+  errno = 0;
+  char *       end   = nullptr;
+  const double value = std::strtod( str.c_str(), &end );
+  if( errno != 0 || end == str.c_str() || *end != '\0' )
+  {
+    return false;
+  }
+  number = value;
+  return true;
+
+} // end StringToNumber()
+
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, short & number )
+{
+  return SignedStringToNumber( str, number );
+}
+
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, unsigned short & number )
+{
+  return UnsignedStringToNumber( str, number );
+}
+
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, int & number )
+{
+  return SignedStringToNumber( str, number );
+}
+
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, unsigned int & number )
+{
+  return UnsignedStringToNumber( str, number );
+}
+
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, long & number )
+{
+  return SignedStringToNumber( str, number );
+}
+
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, unsigned long & number )
+{
+  return UnsignedStringToNumber( str, number );
+}
+
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, long long & number )
+{
+  return SignedStringToNumber( str, number );
+}
+
+
+bool
+ParameterMapInterface
+::StringToNumber( const std::string & str, unsigned long long & number )
+{
+  return UnsignedStringToNumber( str, number );
+} // end StringToNumber()
+
+
 /**
  * **************** ReadParameter ***************
  */
@@ -93,6 +93,12 @@ public:
   /** Set the parameter map. */
   void SetParameterMap( const ParameterMapType & parMap );
 
+  /** Get the parameter map. */
+  const ParameterMapType & GetParameterMap( void ) const
+  {
+    return this->m_ParameterMap;
+  }
+
   /** Option to print error and warning messages to a stream.
    * The default is true. If set to false no messages are printed.
    */
@@ -399,20 +405,58 @@ private:
 
   bool m_PrintErrorMessages;
 
+  /** Convert a plain decimal number to a double or an integer type without
+   * constructing a string stream. Returns false when the string is not plain
+   * decimal, is not consumed completely or is out of range, in which case
+   * StringCast falls back to the string stream. The parameter maps of the
+   * transform can contain a value per parameter, which makes this matter.
+   */
+  static bool StringToNumber( const std::string & str, double & number );
+
+  static bool StringToNumber( const std::string & str, short & number );
+
+  static bool StringToNumber( const std::string & str, unsigned short & number );
+
+  static bool StringToNumber( const std::string & str, int & number );
+
+  static bool StringToNumber( const std::string & str, unsigned int & number );
+
+  static bool StringToNumber( const std::string & str, long & number );
+
+  static bool StringToNumber( const std::string & str, unsigned long & number );
+
+  static bool StringToNumber( const std::string & str, long long & number );
+
+  static bool StringToNumber( const std::string & str, unsigned long long & number );
+
+  /** Other types always use the string stream. */
+  template< class T >
+  static bool StringToNumber( const std::string &, T & )
+  {
+    return false;
+  }
+
+
   /** A templated function to cast strings to a type T.
    * Returns true when casting was successful and false otherwise.
-   * We make use of the casting functionality of string streams.
+   * Plain decimal numbers are converted by StringToNumber, for other strings
+   * we make use of the casting functionality of string streams.
    */
   template< class T >
   bool StringCast( const std::string & parameterValue, T & casted ) const
   {
-    std::stringstream ss( parameterValue );
-
     /** For (unsigned) char we need a workaround, because ">>" casts it wrongly.
     * It takes the first digit and thinks it is a char. For example:
     * 84 becomes '8', which is asci number 56. So, as a workaround, we use
     * the accumulate type, and then cast back to T.*/
     typename NumericTraits< T >::AccumulateType tempCasted;
+    if( StringToNumber( parameterValue, tempCasted ) )
+    {
+      casted = static_cast< T >( tempCasted );
+      return true;
+    }
+
+    std::stringstream ss( parameterValue );
     ss >> tempCasted;
     casted = static_cast< T >( tempCasted );
     if( ss.bad() || ss.fail() )
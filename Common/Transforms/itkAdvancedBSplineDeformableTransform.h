@@ -39,9 +39,13 @@
 #include "itkImage.h"
 #include "itkImageRegion.h"
 #include "itkBSplineInterpolationWeightFunction2.h"
+#include "itkBSplineKernelFunction2.h"
+#include "itkBSplineDerivativeKernelFunction2.h"
 #include "itkBSplineInterpolationDerivativeWeightFunction.h"
 #include "itkBSplineInterpolationSecondOrderDerivativeWeightFunction.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -203,9 +207,34 @@ public:
   /** This method specifies the region over which the grid resides. */
   void SetGridRegion( const RegionType & region ) override;
 
+  /** Set the grid spacing, direction and origin. These remove the weight tables. */
+  void SetGridSpacing( const SpacingType & spacing ) override;
+
+  void SetGridDirection( const DirectionType & direction ) override;
+
+  void SetGridOrigin( const OriginType & origin ) override;
+
   /** Transform points by a B-spline deformable transformation. */
   OutputPointType TransformPoint( const InputPointType & point ) const override;
 
+  /** Transform a batch of points. Calls the non-virtual TransformPoint() of this class for each point. */
+  void TransformPoints(
+    const InputPointType * inputPoints,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const override;
+
+  /** Transform the points of a scanline. When the scanline is parallel to
+   * the first axis of the grid, the weights along the other axes are the same
+   * for all points. The coefficients are then summed over these axes once per
+   * control point column, and each point only combines SplineOrder + 1
+   * column sums. Other scanlines are transformed point by point.
+   */
+  void TransformScanline(
+    const InputPointType & startPoint,
+    const InputVectorType & step,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const override;
+
   /** Interpolation weights function type. */
   typedef BSplineInterpolationWeightFunction2< ScalarType,
     itkGetStaticConstMacro( SpaceDimension ),
@@ -252,6 +281,27 @@ public:
 
   NumberOfParametersType GetNumberOfNonZeroJacobianIndices( void ) const override;
 
+  /** Precompute the 1D B-spline weights and the support indices of each axis
+   * of a voxel lattice. This requires that each axis of the lattice is
+   * parallel to an axis of the grid, which is the case when the grid has the
+   * direction of the image. For a point on the lattice, TransformPoint(),
+   * GetJacobian() and EvaluateJacobianWithImageGradientProduct() then
+   * look up the 1D weights, instead of evaluating the B-spline kernel, and
+   * only compute their tensor product. Points that are not on the lattice
+   * are handled as before.
+   */
+  void PrecomputeWeightTables( const OriginType & latticeOrigin,
+    const SpacingType & latticeSpacing, const DirectionType & latticeDirection,
+    const RegionType & latticeRegion ) override;
+
+  void RemoveWeightTables( void ) override;
+
+  bool GetHasWeightTables( void ) const override
+  {
+    return this->m_HasWeightTables;
+  }
+
+
   /** Compute the Jacobian of the transformation. */
   void GetJacobian(
     const InputPointType & ipp,
@@ -267,11 +317,34 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image gradient
+   * for a batch of points, without a virtual call per point.
+   */
+  void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * ipps,
+    const MovingImageGradientType * movingImageGradients,
+    DerivativeType * imageJacobians,
+    NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+    const SizeValueType n ) const override;
+
   /** Compute the spatial Jacobian of the transformation. */
   void GetSpatialJacobian(
     const InputPointType & ipp,
     SpatialJacobianType & sj ) const override;
 
+  /** Compute the spatial Jacobians of a scanline. When the scanline is
+   * parallel to the first axis of the grid, the coefficients are summed over
+   * the other axes once per control point column, with the weights of these
+   * axes and with the derivative weights of each of them. Each point then
+   * only combines SplineOrder + 1 column sums per derivative. Other
+   * scanlines are computed point by point.
+   */
+  void GetSpatialJacobianScanline(
+    const InputPointType & startPoint,
+    const InputVectorType & step,
+    SpatialJacobianType * sjs,
+    const SizeValueType n ) const override;
+
   /** Compute the spatial Hessian of the transformation. */
   void GetSpatialHessian(
     const InputPointType & ipp,
@@ -330,6 +403,20 @@ protected:
   typedef typename Superclass::JacobianImageType JacobianImageType;
   typedef typename Superclass::JacobianPixelType JacobianPixelType;
 
+  /** Compute the start index of the support region and the weights at a
+   * continuous grid index, using the weight tables if the index is on their
+   * lattice.
+   */
+  void ComputeWeights( const ContinuousIndexType & cindex,
+    IndexType & supportIndex, WeightsType & weights ) const;
+
+  /** Return whether the support region of a point may wrap around the grid.
+   * The column sums of TransformScanline() and GetSpatialJacobianScanline()
+   * assume that it does not, so these compute the points one by one when a
+   * subclass returns true here.
+   */
+  virtual bool HasPeriodicSupport( void ) const { return false; }
+
   /** Pointer to function used to compute B-spline interpolation weights.
    * For each direction we create a different weights function for thread-
    * safety.
@@ -343,6 +430,29 @@ private:
   AdvancedBSplineDeformableTransform( const Self & ); // purposely not implemented
   void operator=( const Self & );                     // purposely not implemented
 
+  /** The 1D weights and the support start index of a lattice position. */
+  struct WeightTableEntryType
+  {
+    typename IndexType::IndexValueType m_SupportIndex;
+    double                             m_Weights[ VSplineOrder + 1 ];
+  };
+
+  typedef std::vector< WeightTableEntryType > WeightTableType;
+
+  /** The maximum distance, in grid index units, of a point to the lattice
+   * of the weight tables.
+   */
+  static constexpr double WeightTableTolerance = 1e-6;
+
+  /** For each axis, the table of the lattice positions, and the continuous
+   * grid index of the first position and the step between positions.
+   */
+  bool            m_HasWeightTables;
+  WeightTableType m_WeightTables[ NDimensions ];
+  double          m_WeightTableFirstIndex[ NDimensions ];
+  double          m_WeightTableStep[ NDimensions ];
+  double          m_WeightTableInverseStep[ NDimensions ];
+
   friend class MultiBSplineDeformableTransformWithNormal< ScalarType,
   itkGetStaticConstMacro( SpaceDimension ),
   itkGetStaticConstMacro( SplineOrder ) >;
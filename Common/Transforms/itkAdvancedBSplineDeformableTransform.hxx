@@ -43,6 +43,7 @@
 #include "vnl/vnl_math.h"
 #include <vector>
 #include <algorithm> // std::copy
+#include <cmath>
 
 namespace itk
 {
@@ -139,6 +140,8 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   this->m_HasNonZeroSpatialHessian           = true;
   this->m_HasNonZeroJacobianOfSpatialHessian = true;
 
+  this->m_HasWeightTables = false;
+
 } // end Constructor
 
 
@@ -156,6 +159,7 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 {
   if( this->m_GridRegion != region )
   {
+    this->RemoveWeightTables();
 
     this->m_GridRegion = region;
 
@@ -218,6 +222,208 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 }
 
 
+/**
+ * ********************* SetGridSpacing ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::SetGridSpacing( const SpacingType & spacing )
+{
+  if( this->m_GridSpacing != spacing )
+  {
+    this->RemoveWeightTables();
+  }
+  this->Superclass::SetGridSpacing( spacing );
+
+} // end SetGridSpacing()
+
+
+/**
+ * ********************* SetGridDirection ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::SetGridDirection( const DirectionType & direction )
+{
+  if( this->m_GridDirection != direction )
+  {
+    this->RemoveWeightTables();
+  }
+  this->Superclass::SetGridDirection( direction );
+
+} // end SetGridDirection()
+
+
+/**
+ * ********************* SetGridOrigin ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::SetGridOrigin( const OriginType & origin )
+{
+  if( this->m_GridOrigin != origin )
+  {
+    this->RemoveWeightTables();
+  }
+  this->Superclass::SetGridOrigin( origin );
+
+} // end SetGridOrigin()
+
+
+/**
+ * ********************* PrecomputeWeightTables ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::PrecomputeWeightTables( const OriginType & latticeOrigin,
+  const SpacingType & latticeSpacing, const DirectionType & latticeDirection,
+  const RegionType & latticeRegion )
+{
+  this->RemoveWeightTables();
+
+  /** The continuous grid index of lattice index i is firstIndex + step * i. */
+  DirectionType scale;
+  Vector< double, SpaceDimension > originOffset;
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    scale[ i ][ i ]   = latticeSpacing[ i ];
+    originOffset[ i ] = latticeOrigin[ i ] - this->m_GridOrigin[ i ];
+  }
+  const DirectionType                    step       = this->m_PointToIndexMatrix * latticeDirection * scale;
+  const Vector< double, SpaceDimension > firstIndex = this->m_PointToIndexMatrix * originOffset;
+
+  /** The tables are separable only if the lattice axes are parallel to the
+   * grid axes, up to a negligible error over the lattice.
+   */
+  const typename RegionType::IndexType latticeIndex = latticeRegion.GetIndex();
+  const typename RegionType::SizeType  latticeSize  = latticeRegion.GetSize();
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    if( step[ i ][ i ] == 0.0 )
+    {
+      return;
+    }
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      if( i != j && std::abs( step[ i ][ j ] )
+        * ( std::abs( static_cast< double >( latticeIndex[ j ] ) ) + latticeSize[ j ] ) > 0.1 * WeightTableTolerance )
+      {
+        return;
+      }
+    }
+  }
+
+  /** Compute the 1D weights of each axis, like the weights function does. */
+  typedef BSplineKernelFunction2< VSplineOrder > KernelType;
+  typename KernelType::Pointer kernel = KernelType::New();
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    this->m_WeightTableStep[ i ]        = step[ i ][ i ];
+    this->m_WeightTableInverseStep[ i ] = 1.0 / step[ i ][ i ];
+    this->m_WeightTableFirstIndex[ i ]  = firstIndex[ i ] + step[ i ][ i ] * latticeIndex[ i ];
+
+    this->m_WeightTables[ i ].resize( latticeSize[ i ] );
+    for( SizeValueType k = 0; k < latticeSize[ i ]; ++k )
+    {
+      const double         cindex = this->m_WeightTableFirstIndex[ i ] + this->m_WeightTableStep[ i ] * k;
+      WeightTableEntryType & entry = this->m_WeightTables[ i ][ k ];
+      entry.m_SupportIndex = static_cast< typename IndexType::IndexValueType >(
+        std::floor( cindex - ( VSplineOrder - 1.0 ) / 2.0 ) );
+      kernel->Evaluate( cindex - entry.m_SupportIndex, entry.m_Weights );
+    }
+  }
+
+  this->m_HasWeightTables = true;
+
+} // end PrecomputeWeightTables()
+
+
+/**
+ * ********************* RemoveWeightTables ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::RemoveWeightTables( void )
+{
+  this->m_HasWeightTables = false;
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    WeightTableType().swap( this->m_WeightTables[ i ] );
+  }
+
+} // end RemoveWeightTables()
+
+
+/**
+ * ********************* ComputeWeights ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::ComputeWeights( const ContinuousIndexType & cindex,
+  IndexType & supportIndex, WeightsType & weights ) const
+{
+  this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
+
+  if( this->m_HasWeightTables )
+  {
+    /** Look up the 1D weights of each axis. The support index has to match
+     * as well, since a point at a knot may be rounded to either side.
+     */
+    const double * weights1D[ SpaceDimension ];
+    bool           onLattice = true;
+    for( unsigned int i = 0; i < SpaceDimension && onLattice; ++i )
+    {
+      const WeightTableType & table    = this->m_WeightTables[ i ];
+      const double            position = std::floor(
+        ( cindex[ i ] - this->m_WeightTableFirstIndex[ i ] ) * this->m_WeightTableInverseStep[ i ] + 0.5 );
+      if( position < 0.0 || position >= table.size()
+        || std::abs( cindex[ i ] - this->m_WeightTableFirstIndex[ i ]
+        - this->m_WeightTableStep[ i ] * position ) > WeightTableTolerance )
+      {
+        onLattice = false;
+        break;
+      }
+      const WeightTableEntryType & entry = table[ static_cast< std::size_t >( position ) ];
+      onLattice      = entry.m_SupportIndex == supportIndex[ i ];
+      weights1D[ i ] = entry.m_Weights;
+    }
+
+    if( onLattice )
+    {
+      /** The tensor product, with the first dimension running fastest. */
+      const unsigned long numberOfWeights = WeightsFunctionType::NumberOfWeights;
+      for( unsigned long k = 0; k < numberOfWeights; ++k )
+      {
+        unsigned long offset = k;
+        double        weight = 1.0;
+        for( unsigned int i = 0; i < SpaceDimension; ++i )
+        {
+          weight *= weights1D[ i ][ offset % ( VSplineOrder + 1 ) ];
+          offset /= VSplineOrder + 1;
+        }
+        weights[ k ] = weight;
+      }
+      return;
+    }
+  }
+
+  this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
+
+} // end ComputeWeights()
+
+
 // Transform a point
 template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
 void
@@ -258,8 +464,7 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 
   // Compute interpolation weights
   IndexType supportIndex;
-  this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
-  this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
+  this->ComputeWeights( cindex, supportIndex, weights );
 
   // For each dimension, correlate coefficient with weights
   RegionType supportRegion;
@@ -275,6 +480,38 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   const PixelType * basePointer
     = this->m_CoefficientImages[ 0 ]->GetBufferPointer();
 
+  /** With compact coefficients, only the indices are taken from the first
+   * coefficient image, and all coefficients of a control point are read at once.
+   */
+  if( this->m_UseCompactCoefficients )
+  {
+    const typename Superclass::CompactCoefficientType * compactCoefficients
+      = this->m_CompactCoefficients.data();
+    iterator[ 0 ] = IteratorType( this->m_CoefficientImages[ 0 ], supportRegion );
+    while( !iterator[ 0 ].IsAtEnd() )
+    {
+      while( !iterator[ 0 ].IsAtEndOfLine() )
+      {
+        const unsigned long index = &( iterator[ 0 ].Value() ) - basePointer;
+        indices[ counter ] = index;
+        for( unsigned int j = 0; j < SpaceDimension; j++ )
+        {
+          outputPoint[ j ] += static_cast< ScalarType >(
+            weights[ counter ] * compactCoefficients[ index ][ j ] );
+        }
+        ++iterator[ 0 ];
+        ++counter;
+      }
+      iterator[ 0 ].NextLine();
+    }
+
+    for( unsigned int j = 0; j < SpaceDimension; j++ )
+    {
+      outputPoint[ j ] += transformedPoint[ j ];
+    }
+    return;
+  }
+
   for( unsigned int j = 0; j < SpaceDimension; j++ )
   {
     iterator[ j ] = IteratorType( this->m_CoefficientImages[ j ], supportRegion );
@@ -419,8 +656,7 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 
   /** Compute the weights. */
   IndexType supportIndex;
-  this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
-  this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
+  this->ComputeWeights( cindex, supportIndex, weights );
 
   /** Setup support region */
   RegionType supportRegion;
@@ -487,10 +723,9 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   typename WeightsType::ValueType weightsArray[ numberOfWeights ];
   WeightsType weights( weightsArray, numberOfWeights, false );
 
-  /** Compute the B-spline derivative weights. */
+  /** Compute the B-spline weights. */
   IndexType supportIndex;
-  this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
-  this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
+  this->ComputeWeights( cindex, supportIndex, weights );
 
   /** Compute the inner product. */
   NumberOfParametersType counter = 0;
@@ -517,6 +752,182 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ********************* TransformPoints ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    outputPoints[ i ] = this->Self::TransformPoint( inputPoints[ i ] );
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ********************* TransformScanline ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::TransformScanline(
+  const InputPointType & startPoint,
+  const InputVectorType & step,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  if( !this->m_CoefficientImages[ 0 ] || n == 0 || this->HasPeriodicSupport() )
+  {
+    Superclass::TransformScanline( startPoint, step, outputPoints, n );
+    return;
+  }
+
+  /** Compute the continuous grid index of the first point and its increment. */
+  ContinuousIndexType startIndex;
+  this->TransformPointToContinuousGridIndex( startPoint, startIndex );
+  Vector< double, SpaceDimension > tvector;
+  for( unsigned int j = 0; j < SpaceDimension; j++ )
+  {
+    tvector[ j ] = step[ j ];
+  }
+  const Vector< double, SpaceDimension > indexStep = this->m_PointToIndexMatrix * tvector;
+
+  /** The scanline should not move along the other axes of the grid by more
+   * than a negligible fraction of a grid spacing.
+   */
+  for( unsigned int j = 1; j < SpaceDimension; j++ )
+  {
+    if( std::abs( indexStep[ j ] ) * static_cast< double >( n ) > 1e-6 )
+    {
+      Superclass::TransformScanline( startPoint, step, outputPoints, n );
+      return;
+    }
+  }
+
+  /** Outside the valid region along the other axes the displacement is zero. */
+  bool inside = true;
+  for( unsigned int j = 1; j < SpaceDimension; j++ )
+  {
+    inside &= startIndex[ j ] >= this->m_ValidRegionBegin[ j ]
+      && startIndex[ j ] < this->m_ValidRegionEnd[ j ];
+  }
+  if( !inside )
+  {
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      outputPoints[ i ] = startPoint + step * static_cast< ScalarType >( i );
+    }
+    return;
+  }
+
+  /** Compute the weights along the other axes. */
+  typedef BSplineKernelFunction2< VSplineOrder > KernelType;
+  const typename KernelType::Pointer kernel = KernelType::New();
+  const unsigned int                 supportSize = SplineOrder + 1;
+  const double                       supportOffset = ( static_cast< double >( SplineOrder ) - 1.0 ) / 2.0;
+  const IndexType                    gridIndex = this->m_GridRegion.GetIndex();
+
+  IndexType supportIndex;
+  double    weights1D[ SpaceDimension ][ SplineOrder + 1 ];
+  for( unsigned int j = 1; j < SpaceDimension; j++ )
+  {
+    supportIndex[ j ] = static_cast< typename IndexType::IndexValueType >(
+      std::floor( startIndex[ j ] - supportOffset ) );
+    kernel->Evaluate( startIndex[ j ] - static_cast< double >( supportIndex[ j ] ), weights1D[ j ] );
+  }
+
+  /** Sum the coefficients over the other axes, for all columns of the grid. */
+  const SizeValueType   numberOfColumns = this->m_GridRegion.GetSize()[ 0 ];
+  std::vector< double > columnSums( numberOfColumns * SpaceDimension, 0.0 );
+  unsigned int          numberOfOtherWeights = 1;
+  for( unsigned int j = 1; j < SpaceDimension; j++ )
+  {
+    numberOfOtherWeights *= supportSize;
+  }
+
+  for( unsigned int k = 0; k < numberOfOtherWeights; ++k )
+  {
+    double          weight = 1.0;
+    OffsetValueType offset = 0;
+    unsigned int    rest   = k;
+    for( unsigned int j = 1; j < SpaceDimension; j++ )
+    {
+      const unsigned int kj = rest % supportSize;
+      rest   /= supportSize;
+      weight *= weights1D[ j ][ kj ];
+      offset += ( supportIndex[ j ] + kj - gridIndex[ j ] ) * this->m_GridOffsetTable[ j ];
+    }
+
+    for( unsigned int dim = 0; dim < SpaceDimension; dim++ )
+    {
+      const PixelType * coefficients = this->m_CoefficientImages[ dim ]->GetBufferPointer() + offset;
+      for( SizeValueType c = 0; c < numberOfColumns; ++c )
+      {
+        columnSums[ c * SpaceDimension + dim ] += weight * coefficients[ c ];
+      }
+    }
+  }
+
+  /** Combine the column sums of the support of each point. */
+  double weights[ SplineOrder + 1 ];
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    const InputPointType point = startPoint + step * static_cast< ScalarType >( i );
+    outputPoints[ i ] = point;
+
+    const double cindex = startIndex[ 0 ] + static_cast< double >( i ) * indexStep[ 0 ];
+    if( cindex < this->m_ValidRegionBegin[ 0 ] || cindex >= this->m_ValidRegionEnd[ 0 ] )
+    {
+      continue;
+    }
+
+    const OffsetValueType start = static_cast< OffsetValueType >( std::floor( cindex - supportOffset ) );
+    kernel->Evaluate( cindex - static_cast< double >( start ), weights );
+    const double * sums = columnSums.data() + ( start - gridIndex[ 0 ] ) * SpaceDimension;
+    for( unsigned int k = 0; k < supportSize; ++k )
+    {
+      for( unsigned int dim = 0; dim < SpaceDimension; dim++ )
+      {
+        outputPoints[ i ][ dim ] += static_cast< ScalarType >( weights[ k ] * sums[ k * SpaceDimension + dim ] );
+      }
+    }
+  }
+
+} // end TransformScanline()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * ipps,
+  const MovingImageGradientType * movingImageGradients,
+  DerivativeType * imageJacobians,
+  NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+  const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    this->Self::EvaluateJacobianWithImageGradientProduct( ipps[ i ],
+      movingImageGradients[ i ], imageJacobians[ i ], nonZeroJacobianIndices[ i ] );
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 /**
  * ********************* GetSpatialJacobian ****************************
  */
@@ -623,6 +1034,190 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 } // end GetSpatialJacobian()
 
 
+/**
+ * ********************* GetSpatialJacobianScanline ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::GetSpatialJacobianScanline(
+  const InputPointType & startPoint,
+  const InputVectorType & step,
+  SpatialJacobianType * sjs,
+  const SizeValueType n ) const
+{
+  /** The derivative kernel is not defined for the zeroth order. */
+  if( SplineOrder == 0 || !this->m_CoefficientImages[ 0 ] || n == 0 || this->HasPeriodicSupport() )
+  {
+    Superclass::GetSpatialJacobianScanline( startPoint, step, sjs, n );
+    return;
+  }
+
+  /** Compute the continuous grid index of the first point and its increment. */
+  ContinuousIndexType startIndex;
+  this->TransformPointToContinuousGridIndex( startPoint, startIndex );
+  Vector< double, SpaceDimension > tvector;
+  for( unsigned int j = 0; j < SpaceDimension; j++ )
+  {
+    tvector[ j ] = step[ j ];
+  }
+  const Vector< double, SpaceDimension > indexStep = this->m_PointToIndexMatrix * tvector;
+
+  /** The scanline should not move along the other axes of the grid by more
+   * than a negligible fraction of a grid spacing.
+   */
+  for( unsigned int j = 1; j < SpaceDimension; j++ )
+  {
+    if( std::abs( indexStep[ j ] ) * static_cast< double >( n ) > 1e-6 )
+    {
+      Superclass::GetSpatialJacobianScanline( startPoint, step, sjs, n );
+      return;
+    }
+  }
+
+  /** Outside the valid region along the other axes the spatial Jacobian is
+   * the identity.
+   */
+  bool inside = true;
+  for( unsigned int j = 1; j < SpaceDimension; j++ )
+  {
+    inside &= startIndex[ j ] >= this->m_ValidRegionBegin[ j ]
+      && startIndex[ j ] < this->m_ValidRegionEnd[ j ];
+  }
+  if( !inside )
+  {
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      sjs[ i ].SetIdentity();
+    }
+    return;
+  }
+
+  /** Compute the weights and the derivative weights along the other axes,
+   * in the same way as the derivative weight functions.
+   */
+  typedef BSplineKernelFunction2< VSplineOrder >           KernelType;
+  typedef BSplineDerivativeKernelFunction2< VSplineOrder > DerivativeKernelType;
+  const typename KernelType::Pointer           kernel           = KernelType::New();
+  const typename DerivativeKernelType::Pointer derivativeKernel = DerivativeKernelType::New();
+  const unsigned int                           supportSize      = SplineOrder + 1;
+  const double                                 supportOffset    = ( static_cast< double >( SplineOrder ) - 1.0 ) / 2.0;
+  const IndexType                              gridIndex        = this->m_GridRegion.GetIndex();
+
+  IndexType supportIndex;
+  double    weights1D[ SpaceDimension ][ SplineOrder + 1 ];
+  double    derivativeWeights1D[ SpaceDimension ][ SplineOrder + 1 ];
+  for( unsigned int j = 1; j < SpaceDimension; j++ )
+  {
+    supportIndex[ j ] = static_cast< typename IndexType::IndexValueType >(
+      std::floor( startIndex[ j ] - supportOffset ) );
+    double x = startIndex[ j ] - static_cast< double >( supportIndex[ j ] );
+    for( unsigned int k = 0; k < supportSize; ++k )
+    {
+      weights1D[ j ][ k ]           = kernel->Evaluate( x );
+      derivativeWeights1D[ j ][ k ] = derivativeKernel->Evaluate( x );
+      x                            -= 1.0;
+    }
+  }
+
+  /** Sum the coefficients over the other axes, for all columns of the grid.
+   * The sums of derivative direction 0 use the weights of the other axes,
+   * those of a direction j > 0 the derivative weights along axis j instead.
+   */
+  const SizeValueType   numberOfColumns  = this->m_GridRegion.GetSize()[ 0 ];
+  const SizeValueType   sumsPerDirection = numberOfColumns * SpaceDimension;
+  std::vector< double > columnSums( SpaceDimension * sumsPerDirection, 0.0 );
+  unsigned int          numberOfOtherWeights = 1;
+  for( unsigned int j = 1; j < SpaceDimension; j++ )
+  {
+    numberOfOtherWeights *= supportSize;
+  }
+
+  for( unsigned int k = 0; k < numberOfOtherWeights; ++k )
+  {
+    double          directionWeights[ SpaceDimension ];
+    OffsetValueType offset = 0;
+    unsigned int    rest   = k;
+    std::fill_n( directionWeights, SpaceDimension, 1.0 );
+    for( unsigned int j = 1; j < SpaceDimension; j++ )
+    {
+      const unsigned int kj = rest % supportSize;
+      rest /= supportSize;
+      for( unsigned int d = 0; d < SpaceDimension; d++ )
+      {
+        directionWeights[ d ] *= ( d == j ) ? derivativeWeights1D[ j ][ kj ] : weights1D[ j ][ kj ];
+      }
+      offset += ( supportIndex[ j ] + kj - gridIndex[ j ] ) * this->m_GridOffsetTable[ j ];
+    }
+
+    for( unsigned int dim = 0; dim < SpaceDimension; dim++ )
+    {
+      const PixelType * coefficients = this->m_CoefficientImages[ dim ]->GetBufferPointer() + offset;
+      for( unsigned int d = 0; d < SpaceDimension; d++ )
+      {
+        const double weight = directionWeights[ d ];
+        double *     sums   = columnSums.data() + d * sumsPerDirection + dim;
+        for( SizeValueType c = 0; c < numberOfColumns; ++c )
+        {
+          sums[ c * SpaceDimension ] += weight * coefficients[ c ];
+        }
+      }
+    }
+  }
+
+  /** Combine the column sums of the support of each point: with the
+   * derivative weights along the line for direction 0, and with the weights
+   * along the line for the other directions.
+   */
+  double              weights[ SplineOrder + 1 ];
+  double              derivativeWeights[ SplineOrder + 1 ];
+  SpatialJacobianType sj;
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    const double cindex = startIndex[ 0 ] + static_cast< double >( i ) * indexStep[ 0 ];
+    if( cindex < this->m_ValidRegionBegin[ 0 ] || cindex >= this->m_ValidRegionEnd[ 0 ] )
+    {
+      sjs[ i ].SetIdentity();
+      continue;
+    }
+
+    const OffsetValueType start = static_cast< OffsetValueType >( std::floor( cindex - supportOffset ) );
+    double                x     = cindex - static_cast< double >( start );
+    for( unsigned int k = 0; k < supportSize; ++k )
+    {
+      weights[ k ]           = kernel->Evaluate( x );
+      derivativeWeights[ k ] = derivativeKernel->Evaluate( x );
+      x                     -= 1.0;
+    }
+
+    const double * sums = columnSums.data() + ( start - gridIndex[ 0 ] ) * SpaceDimension;
+    sj.Fill( 0.0 );
+    for( unsigned int k = 0; k < supportSize; ++k )
+    {
+      for( unsigned int dim = 0; dim < SpaceDimension; dim++ )
+      {
+        sj( dim, 0 ) += derivativeWeights[ k ] * sums[ k * SpaceDimension + dim ];
+        for( unsigned int d = 1; d < SpaceDimension; d++ )
+        {
+          sj( dim, d ) += weights[ k ] * sums[ d * sumsPerDirection + k * SpaceDimension + dim ];
+        }
+      }
+    }
+
+    /** Take into account grid spacing and direction cosines, and add the
+     * spatial derivative of x.
+     */
+    sjs[ i ] = sj * this->m_PointToIndexMatrix2;
+    for( unsigned int dim = 0; dim < SpaceDimension; dim++ )
+    {
+      sjs[ i ]( dim, dim ) += 1.0;
+    }
+  }
+
+} // end GetSpatialJacobianScanline()
+
+
 /**
  * ********************* GetSpatialHessian ****************************
  */
@@ -1468,6 +2063,7 @@ AdvancedBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 
   os << indent << "WeightsFunction: ";
   os << this->m_WeightsFunction.GetPointer() << std::endl;
+  os << indent << "HasWeightTables: " << this->m_HasWeightTables << std::endl;
 }
 
 
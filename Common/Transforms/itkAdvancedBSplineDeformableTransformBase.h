@@ -22,6 +22,8 @@
 #include "itkImage.h"
 #include "itkImageRegion.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -183,6 +185,24 @@ public:
    */
   virtual void SetCoefficientImages( ImagePointer images[] );
 
+  /** The B-spline coefficients of a control point, in single precision. */
+  typedef Vector< float, itkGetStaticConstMacro( SpaceDimension ) > CompactCoefficientType;
+
+  /** Set/Get whether TransformPoint() of the AdvancedBSplineDeformableTransform
+   * and the RecursiveBSplineTransform uses a compact copy of the B-spline
+   * coefficients, with the SpaceDimension coefficients of each control point
+   * stored next to each other in single precision. The coefficient fetches of
+   * a support point then hit one cache line instead of SpaceDimension, at
+   * the cost of a single precision displacement. The parameters, the
+   * Jacobians and the derivatives of the transform are not affected. The copy
+   * is updated by SetParameters() and SetCoefficientImages(), so a change of
+   * the parameters in place requires another call of SetParameters(). The
+   * default is false.
+   */
+  virtual void SetUseCompactCoefficients( const bool useCompactCoefficients );
+
+  itkGetConstMacro( UseCompactCoefficients, bool );
+
   /** Typedefs for specifying the extend to the grid. */
   typedef ImageRegion< itkGetStaticConstMacro( SpaceDimension ) > RegionType;
 
@@ -280,6 +300,21 @@ public:
 
   NumberOfParametersType GetNumberOfNonZeroJacobianIndices( void ) const override = 0;
 
+  /** Precompute the B-spline weights of the points of a voxel lattice, such
+   * as the fixed image voxels visited by the full and grid samplers. The
+   * lattice is given by the geometry of an image and a region of it. The
+   * tables are removed when the grid changes.
+   */
+  virtual void PrecomputeWeightTables( const OriginType & latticeOrigin,
+    const SpacingType & latticeSpacing, const DirectionType & latticeDirection,
+    const RegionType & latticeRegion ) = 0;
+
+  /** Remove the precomputed B-spline weights. */
+  virtual void RemoveWeightTables( void ) = 0;
+
+  /** Whether precomputed B-spline weights are available. */
+  virtual bool GetHasWeightTables( void ) const = 0;
+
   /** This typedef should be equal to the typedef used
    * in derived classes based on the weights function.
    */
@@ -309,11 +344,18 @@ protected:
   /** Check if a continuous index is inside the valid region. */
   virtual bool InsideValidRegion( const ContinuousIndexType & index ) const;
 
+  /** Copy the coefficient images to the compact coefficients, if they are used. */
+  void UpdateCompactCoefficients( void );
+
   /** Array of images representing the B-spline coefficients
    *  in each dimension.
    */
   ImagePointer m_CoefficientImages[ NDimensions ];
 
+  /** The compact copy of the coefficient images, indexed like their buffers. */
+  std::vector< CompactCoefficientType > m_CompactCoefficients;
+  bool                                  m_UseCompactCoefficients;
+
   /** Variables defining the coefficient grid extend. */
   RegionType     m_GridRegion;
   SpacingType    m_GridSpacing;
@@ -58,6 +58,7 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
     this->m_WrappedImage[ j ]->SetDirection( this->m_GridDirection );
     this->m_CoefficientImages[ j ] = nullptr;
   }
+  this->m_UseCompactCoefficients = false;
 
   this->m_ValidRegion = this->m_GridRegion;
 
@@ -275,6 +276,7 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
     ParametersType * parameters
       = const_cast< ParametersType * >( this->m_InputParametersPointer );
     parameters->Fill( 0.0 );
+    this->UpdateCompactCoefficients();
     this->Modified();
   }
   else
@@ -428,6 +430,8 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
     dataPointer                   += numberOfPixels;
     this->m_CoefficientImages[ j ] = this->m_WrappedImage[ j ];
   }
+
+  this->UpdateCompactCoefficients();
 }
 
 
@@ -537,8 +541,50 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
     this->m_InternalParametersBuffer = ParametersType( 0 );
     this->m_InputParametersPointer   = nullptr;
 
+    this->UpdateCompactCoefficients();
+  }
+
+}
+
+
+// Set whether the compact coefficients are used
+template< class TScalarType, unsigned int NDimensions >
+void
+AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
+::SetUseCompactCoefficients( const bool useCompactCoefficients )
+{
+  if( this->m_UseCompactCoefficients != useCompactCoefficients )
+  {
+    this->m_UseCompactCoefficients = useCompactCoefficients;
+    this->UpdateCompactCoefficients();
+    this->Modified();
+  }
+}
+
+
+// Copy the coefficient images to the compact coefficients
+template< class TScalarType, unsigned int NDimensions >
+void
+AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
+::UpdateCompactCoefficients( void )
+{
+  if( !this->m_UseCompactCoefficients || !this->m_CoefficientImages[ 0 ] )
+  {
+    std::vector< CompactCoefficientType >().swap( this->m_CompactCoefficients );
+    return;
   }
 
+  const SizeValueType numberOfControlPoints
+    = this->m_CoefficientImages[ 0 ]->GetBufferedRegion().GetNumberOfPixels();
+  this->m_CompactCoefficients.resize( numberOfControlPoints );
+  for( unsigned int j = 0; j < SpaceDimension; j++ )
+  {
+    const PixelType * coefficients = this->m_CoefficientImages[ j ]->GetBufferPointer();
+    for( SizeValueType i = 0; i < numberOfControlPoints; ++i )
+    {
+      this->m_CompactCoefficients[ i ][ j ] = static_cast< float >( coefficients[ i ] );
+    }
+  }
 }
 
 
@@ -577,6 +623,8 @@ AdvancedBSplineDeformableTransformBase< TScalarType, NDimensions >
 
   os << indent << "InputParametersPointer: "
      << this->m_InputParametersPointer << std::endl;
+  os << indent << "UseCompactCoefficients: "
+     << ( this->m_UseCompactCoefficients ? "true" : "false" ) << std::endl;
   os << indent << "ValidRegion: " << this->m_ValidRegion << std::endl;
   os << indent << "LastJacobianIndex: " << this->m_LastJacobianIndex << std::endl;
 }
@@ -21,6 +21,10 @@
 #include "itkAdvancedTransform.h"
 #include "itkMacro.h"
 
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
 namespace itk
 {
 
@@ -157,9 +161,46 @@ public:
 
   itkGetConstMacro( UseAddition, bool );
 
+  /** Precompute the points mapped by the InitialTransform and its spatial
+   * Jacobians at a set of points, such as the fixed image samples. When
+   * composition is used, the evaluations at these points then look up the
+   * InitialTransform instead of evaluating it. The InitialTransform is
+   * assumed constant: the cache is removed by SetInitialTransform(), but not
+   * when the InitialTransform itself is modified. Not thread-safe.
+   */
+  virtual void CacheInitialTransform( const InputPointType * points, const SizeValueType n );
+
+  /** Remove the precomputed InitialTransform evaluations. */
+  virtual void RemoveInitialTransformCache( void );
+
+  /** Get the number of points in the InitialTransform cache. */
+  SizeValueType GetNumberOfCachedInitialTransformPoints( void ) const
+  {
+    return this->m_InitialTransformCache.size();
+  }
+
+
   /**  Method to transform a point. */
   OutputPointType TransformPoint( const InputPointType  & point ) const override;
 
+  /** Method to transform a batch of points. When there is no initial
+   * transform, or when composition is used, the batch is forwarded to the
+   * TransformPoints() of the sub-transforms.
+   */
+  void TransformPoints(
+    const InputPointType * inputPoints,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const override;
+
+  /** Method to transform the points of a scanline. Without an initial
+   * transform, the scanline is forwarded to the current transform.
+   */
+  void TransformScanline(
+    const InputPointType & startPoint,
+    const InputVectorType & step,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const override;
+
   /** ITK4 change:
    * The following pure virtual functions must be overloaded.
    * For now just throw an exception, since these are not used in elastix.
@@ -251,11 +292,34 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image gradient
+   * for a batch of points. When possible the batch is forwarded to the
+   * CurrentTransform.
+   */
+  void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * ipps,
+    const MovingImageGradientType * movingImageGradients,
+    DerivativeType * imageJacobians,
+    NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+    const SizeValueType n ) const override;
+
   /** Compute the spatial Jacobian of the transformation. */
   void GetSpatialJacobian(
     const InputPointType & ipp,
     SpatialJacobianType & sj ) const override;
 
+  /** Compute the spatial Jacobians of a scanline. Without an initial
+   * transform, the scanline is forwarded to the current transform. A linear
+   * initial transform maps the scanline to another one, so in composition
+   * mode that one is forwarded to the current transform, and the constant
+   * spatial Jacobian of the initial transform is applied afterwards.
+   */
+  void GetSpatialJacobianScanline(
+    const InputPointType & startPoint,
+    const InputVectorType & step,
+    SpatialJacobianType * sjs,
+    const SizeValueType n ) const override;
+
   /** Compute the spatial Hessian of the transformation. */
   void GetSpatialHessian(
     const InputPointType & ipp,
@@ -623,6 +687,78 @@ protected:
   bool m_UseAddition;
   bool m_UseComposition;
 
+  /** The InitialTransform evaluated at a cached point. */
+  struct InitialTransformCacheEntryType
+  {
+    OutputPointType     m_MappedPoint;
+    SpatialJacobianType m_SpatialJacobian;
+  };
+
+  /** Hash the bit patterns of the coordinates of a point. */
+  struct PointHashType
+  {
+    std::size_t operator()( const InputPointType & point ) const
+    {
+      std::size_t hash = 0;
+      for( unsigned int i = 0; i < NDimensions; ++i )
+      {
+        hash = hash * 31 + std::hash< ScalarType >()( point[ i ] );
+      }
+      return hash;
+    }
+
+
+  };
+
+  typedef std::unordered_map< InputPointType, InitialTransformCacheEntryType, PointHashType >
+    InitialTransformCacheType;
+
+  /** Return the cached InitialTransform evaluation at a point, or a null
+   * pointer if the point is not cached.
+   */
+  inline const InitialTransformCacheEntryType * FindInInitialTransformCache(
+    const InputPointType & point ) const
+  {
+    if( this->m_InitialTransformCache.empty() )
+    {
+      return nullptr;
+    }
+    const typename InitialTransformCacheType::const_iterator it
+      = this->m_InitialTransformCache.find( point );
+    return it != this->m_InitialTransformCache.end() ? &( it->second ) : nullptr;
+  }
+
+
+  /** The InitialTransform applied to a point, from the cache if possible. */
+  inline OutputPointType TransformPointWithInitialTransform( const InputPointType & point ) const
+  {
+    const InitialTransformCacheEntryType * entry = this->FindInInitialTransformCache( point );
+    return entry ? entry->m_MappedPoint : this->m_InitialTransform->TransformPoint( point );
+  }
+
+
+  /** The spatial Jacobian of the InitialTransform at a point and the point
+   * mapped by it, from the cache if possible.
+   */
+  inline void EvaluateInitialTransform( const InputPointType & point,
+    OutputPointType & mappedPoint, SpatialJacobianType & sj0 ) const
+  {
+    const InitialTransformCacheEntryType * entry = this->FindInInitialTransformCache( point );
+    if( entry )
+    {
+      mappedPoint = entry->m_MappedPoint;
+      sj0         = entry->m_SpatialJacobian;
+    }
+    else
+    {
+      mappedPoint = this->m_InitialTransform->TransformPoint( point );
+      this->m_InitialTransform->GetSpatialJacobian( point, sj0 );
+    }
+  }
+
+
+  InitialTransformCacheType m_InitialTransformCache;
+
 private:
 
   AdvancedCombinationTransform( const Self & ); // purposely not implemented
@@ -548,6 +548,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   if( this->m_InitialTransform != _arg )
   {
     this->m_InitialTransform = _arg;
+    this->RemoveInitialTransformCache();
     this->Modified();
     this->UpdateCombinationMethod();
   }
@@ -555,6 +556,46 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 } // end SetInitialTransform()
 
 
+/**
+ * ******************* CacheInitialTransform **********************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::CacheInitialTransform( const InputPointType * points, const SizeValueType n )
+{
+  this->m_InitialTransformCache.clear();
+  if( this->m_InitialTransform.IsNull() )
+  {
+    return;
+  }
+
+  this->m_InitialTransformCache.reserve( n );
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    InitialTransformCacheEntryType & entry = this->m_InitialTransformCache[ points[ i ] ];
+    entry.m_MappedPoint = this->m_InitialTransform->TransformPoint( points[ i ] );
+    this->m_InitialTransform->GetSpatialJacobian( points[ i ], entry.m_SpatialJacobian );
+  }
+
+} // end CacheInitialTransform()
+
+
+/**
+ * ******************* RemoveInitialTransformCache **********************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::RemoveInitialTransformCache( void )
+{
+  InitialTransformCacheType().swap( this->m_InitialTransformCache );
+
+} // end RemoveInitialTransformCache()
+
+
 /**
  * ******************* SetCurrentTransform **********************
  */
@@ -798,7 +839,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 ::TransformPointUseComposition( const InputPointType & point ) const
 {
   return this->m_CurrentTransform->TransformPoint(
-    this->m_InitialTransform->TransformPoint( point ) );
+    this->TransformPointWithInitialTransform( point ) );
 
 } // end TransformPointUseComposition()
 
@@ -865,7 +906,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
   this->m_CurrentTransform->GetJacobian(
-    this->m_InitialTransform->TransformPoint( ipp ),
+    this->TransformPointWithInitialTransform( ipp ),
     j, nonZeroJacobianIndices );
 
 } // end GetJacobianUseComposition()
@@ -939,7 +980,7 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
   this->m_CurrentTransform->EvaluateJacobianWithImageGradientProduct(
-    this->m_InitialTransform->TransformPoint( ipp ),
+    this->TransformPointWithInitialTransform( ipp ),
     movingImageGradient, imageJacobian, nonZeroJacobianIndices );
 
 } // end EvaluateJacobianWithImageGradientProductUseComposition()
@@ -1015,9 +1056,9 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
   SpatialJacobianType & sj ) const
 {
   SpatialJacobianType sj0, sj1;
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
-  this->m_CurrentTransform->GetSpatialJacobian(
-    this->m_InitialTransform->TransformPoint( ipp ), sj1 );
+  OutputPointType     mappedPoint;
+  this->EvaluateInitialTransform( ipp, mappedPoint, sj0 );
+  this->m_CurrentTransform->GetSpatialJacobian( mappedPoint, sj1 );
 
   sj = sj1 * sj0;
 
@@ -1209,10 +1250,10 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 {
   SpatialJacobianType           sj0;
   JacobianOfSpatialJacobianType jsj1;
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
+  OutputPointType               mappedPoint;
+  this->EvaluateInitialTransform( ipp, mappedPoint, sj0 );
   this->m_CurrentTransform->GetJacobianOfSpatialJacobian(
-    this->m_InitialTransform->TransformPoint( ipp ),
-    jsj1, nonZeroJacobianIndices );
+    mappedPoint, jsj1, nonZeroJacobianIndices );
 
   jsj.resize( nonZeroJacobianIndices.size() );
   for( unsigned int mu = 0; mu < nonZeroJacobianIndices.size(); ++mu )
@@ -1238,10 +1279,10 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 {
   SpatialJacobianType           sj0, sj1;
   JacobianOfSpatialJacobianType jsj1;
-  this->m_InitialTransform->GetSpatialJacobian( ipp, sj0 );
+  OutputPointType               mappedPoint;
+  this->EvaluateInitialTransform( ipp, mappedPoint, sj0 );
   this->m_CurrentTransform->GetJacobianOfSpatialJacobian(
-    this->m_InitialTransform->TransformPoint( ipp ),
-    sj1, jsj1, nonZeroJacobianIndices );
+    mappedPoint, sj1, jsj1, nonZeroJacobianIndices );
 
   sj = sj1 * sj0;
   jsj.resize( nonZeroJacobianIndices.size() );
@@ -1613,6 +1654,122 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 } // end TransformPoint()
 
 
+/**
+ * ****************** TransformPoints ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  if( this->m_CurrentTransform.IsNull() )
+  {
+    this->NoCurrentTransformSet();
+  }
+  else if( this->m_InitialTransform.IsNull() )
+  {
+    this->m_CurrentTransform->TransformPoints( inputPoints, outputPoints, n );
+  }
+  else if( this->m_UseComposition )
+  {
+    /** Transform in place: each output point only depends on its own input point. */
+    if( this->m_InitialTransformCache.empty() )
+    {
+      this->m_InitialTransform->TransformPoints( inputPoints, outputPoints, n );
+    }
+    else
+    {
+      for( SizeValueType i = 0; i < n; ++i )
+      {
+        outputPoints[ i ] = this->TransformPointWithInitialTransform( inputPoints[ i ] );
+      }
+    }
+    this->m_CurrentTransform->TransformPoints( outputPoints, outputPoints, n );
+  }
+  else
+  {
+    Superclass::TransformPoints( inputPoints, outputPoints, n );
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ****************** TransformScanline ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::TransformScanline(
+  const InputPointType & startPoint,
+  const InputVectorType & step,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  if( this->m_CurrentTransform.IsNotNull() && this->m_InitialTransform.IsNull() )
+  {
+    this->m_CurrentTransform->TransformScanline( startPoint, step, outputPoints, n );
+  }
+  else
+  {
+    Superclass::TransformScanline( startPoint, step, outputPoints, n );
+  }
+
+} // end TransformScanline()
+
+
+/**
+ * ****************** GetSpatialJacobianScanline ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::GetSpatialJacobianScanline(
+  const InputPointType & startPoint,
+  const InputVectorType & step,
+  SpatialJacobianType * sjs,
+  const SizeValueType n ) const
+{
+  if( this->m_CurrentTransform.IsNull() )
+  {
+    Superclass::GetSpatialJacobianScanline( startPoint, step, sjs, n );
+  }
+  else if( this->m_InitialTransform.IsNull() )
+  {
+    this->m_CurrentTransform->GetSpatialJacobianScanline( startPoint, step, sjs, n );
+  }
+  else if( this->m_UseComposition && this->m_InitialTransform->IsLinear() )
+  {
+    const OutputPointType mappedStart = this->m_InitialTransform->TransformPoint( startPoint );
+    const OutputPointType mappedNext  = this->m_InitialTransform->TransformPoint( startPoint + step );
+    InputVectorType       mappedStep;
+    for( unsigned int j = 0; j < SpaceDimension; j++ )
+    {
+      mappedStep[ j ] = mappedNext[ j ] - mappedStart[ j ];
+    }
+
+    SpatialJacobianType sj0;
+    this->m_InitialTransform->GetSpatialJacobian( startPoint, sj0 );
+    this->m_CurrentTransform->GetSpatialJacobianScanline( mappedStart, mappedStep, sjs, n );
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      sjs[ i ] = sjs[ i ] * sj0;
+    }
+  }
+  else
+  {
+    Superclass::GetSpatialJacobianScanline( startPoint, step, sjs, n );
+  }
+
+} // end GetSpatialJacobianScanline()
+
+
 /**
  * ****************** GetJacobian ****************************
  */
@@ -1652,6 +1809,53 @@ AdvancedCombinationTransform< TScalarType, NDimensions >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ****************** EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< typename TScalarType, unsigned int NDimensions >
+void
+AdvancedCombinationTransform< TScalarType, NDimensions >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * ipps,
+  const MovingImageGradientType * movingImageGradients,
+  DerivativeType * imageJacobians,
+  NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+  const SizeValueType n ) const
+{
+  if( this->m_CurrentTransform.IsNull() )
+  {
+    this->NoCurrentTransformSet();
+  }
+  else if( this->m_InitialTransform.IsNull() || this->m_UseAddition )
+  {
+    this->m_CurrentTransform->EvaluateJacobianWithImageGradientProductBatch(
+      ipps, movingImageGradients, imageJacobians, nonZeroJacobianIndices, n );
+  }
+  else
+  {
+    /** Composition: the Jacobian of the current transform is evaluated
+     * at the points mapped by the initial transform.
+     */
+    std::vector< InputPointType > mappedPoints( n );
+    if( this->m_InitialTransformCache.empty() )
+    {
+      this->m_InitialTransform->TransformPoints( ipps, mappedPoints.data(), n );
+    }
+    else
+    {
+      for( SizeValueType i = 0; i < n; ++i )
+      {
+        mappedPoints[ i ] = this->TransformPointWithInitialTransform( ipps[ i ] );
+      }
+    }
+    this->m_CurrentTransform->EvaluateJacobianWithImageGradientProductBatch(
+      mappedPoints.data(), movingImageGradients, imageJacobians, nonZeroJacobianIndices, n );
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 /**
  * ****************** GetSpatialJacobian ****************************
  */
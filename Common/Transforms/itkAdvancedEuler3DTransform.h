@@ -104,6 +104,9 @@ public:
   typedef typename Superclass::OffsetType                OffsetType;
   typedef typename Superclass::ScalarType                AngleType;
 
+  typedef typename Superclass::DerivativeType          DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
+
   typedef typename Superclass
     ::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
   typedef typename Superclass::SpatialJacobianType SpatialJacobianType;
@@ -135,6 +138,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
   /** Set/Get the order of the computation. Default ZXY */
   itkSetMacro( ComputeZYX, bool );
   itkGetConstMacro( ComputeZYX, bool );
@@ -302,6 +302,27 @@ AdvancedEuler3DTransform< TScalarType >::GetJacobian( const InputPointType & p,
 }
 
 
+// Compute the inner product of the Jacobian with the moving image gradient
+template< class TScalarType >
+void
+AdvancedEuler3DTransform< TScalarType >::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  /** Compute the products with dR/dmu * (p-c) */
+  this->EvaluateJacobianOfSpatialJacobianWithImageGradientProduct(
+    p, movingImageGradient, 0, 3, imageJacobian );
+
+  // the products for the translation part
+  this->EvaluateTranslationWithImageGradientProduct( movingImageGradient, 3, imageJacobian );
+
+  // Copy the constant nonZeroJacobianIndices
+  nzji = this->m_NonZeroJacobianIndices;
+}
+
+
 // Precompute Jacobian of Spatial Jacobian
 template< class TScalarType >
 void
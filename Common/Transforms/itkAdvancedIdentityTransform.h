@@ -103,6 +103,10 @@ public:
   /** Type of the Jacobian matrix. */
   typedef typename Superclass::JacobianType JacobianType;
 
+  /** Standard derivative and image gradient types. */
+  typedef typename Superclass::DerivativeType          DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
+
   /** Standard vector type for this class. */
   typedef Vector< TScalarType,
     itkGetStaticConstMacro( InputSpaceDimension ) >  InputVectorType;
@@ -220,6 +224,20 @@ public:
   }
 
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, which is zero.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType &,
+    const MovingImageGradientType &,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override
+  {
+    imageJacobian.Fill( 0.0 );
+    nonZeroJacobianIndices = this->m_NonZeroJacobianIndices;
+  }
+
+
   /** Compute the spatial Jacobian of the transformation. */
   void GetSpatialJacobian(
     const InputPointType &,
@@ -230,7 +230,12 @@ public:
   typedef itk::BinaryThresholdImageFilter < TImage, TImage >             BinaryThresholdImageFilterType;
   typedef typename TImage::PixelType  InputPixelType;
 
-  /** Set some parameters. */
+  /** Set some parameters. The moments are computed from a grid of about
+   * NumberOfSamplesForCenteredTransformInitialization samples; if it is 0, all
+   * voxels of the requested region are used. The lower threshold is applied
+   * to the pixel values on the fly: a voxel counts with weight 1 if its value
+   * is at least the threshold, and 0 otherwise.
+   */
   itkSetMacro( NumberOfSamplesForCenteredTransformInitialization, SizeValueType );
   itkSetMacro( LowerThresholdForCenterGravity, InputPixelType );
   itkSetMacro( CenterOfGravityUsesLowerThreshold, bool );
@@ -254,6 +259,22 @@ protected:
   /** The threaded implementation of Compute(). */
   virtual inline void ThreadedCompute(ThreadIdType threadID);
 
+  /** The threaded implementation of Compute() over all voxels. Each thread
+   * takes a range of scanlines, and sums the moments in index coordinates;
+   * AfterThreadedCompute() maps them to physical coordinates.
+   */
+  virtual void ThreadedComputeFullImage(ThreadIdType threadID);
+
+  /** Add the sums of the weights, of the weighted indices and of the weighted
+   * squared indices along one contiguous scanline, which starts at the given
+   * index. Four independent partial sums allow the compiler to vectorize
+   * the loop.
+   */
+  static void AccumulateScanline(const InputPixelType * scanline,
+    const SizeValueType length, const double firstIndex,
+    const bool useThreshold, const InputPixelType threshold,
+    double & sum0, double & sum1, double & sum2);
+
   /** Initialize some multi-threading related parameters. */
   virtual void InitializeThreadingParameters(void);
 
@@ -290,6 +311,7 @@ protected:
   InputPixelType m_LowerThresholdForCenterGravity;
   bool           m_CenterOfGravityUsesLowerThreshold;
   ImageSampleContainerPointer m_SampleContainer;
+  bool           m_ComputeOnFullImage;
 
 private:
   AdvancedImageMomentsCalculator( const Self & );
@@ -24,6 +24,8 @@
 #include "vnl/algo/vnl_symmetric_eigensystem.h"
 #include "itkImageRegionConstIteratorWithIndex.h"
 
+#include <algorithm>
+
 namespace itk
 {
 class InvalidImageMomentsError:public ExceptionObject
@@ -77,6 +79,7 @@ AdvancedImageMomentsCalculator< TImage >::AdvancedImageMomentsCalculator(void)
   this->m_CenterOfGravityUsesLowerThreshold = false;
   this->m_NumberOfSamplesForCenteredTransformInitialization = 10000;
   this->m_LowerThresholdForCenterGravity = 500;
+  this->m_ComputeOnFullImage = false;
 }
 
 //----------------------------------------------------------------------
@@ -302,23 +305,21 @@ AdvancedImageMomentsCalculator< TImage >
   m_Cg.Fill(NumericTraits< typename VectorType::ValueType >::ZeroValue());
   m_Cm.Fill(NumericTraits< typename MatrixType::ValueType >::ZeroValue());
 
-  typedef typename ImageType::IndexType IndexType;
+  /** The lower threshold is applied to the pixel values in the threads,
+   * which saves a thresholded copy of the image.
+   */
+  this->m_ComputeOnFullImage
+    = this->m_NumberOfSamplesForCenteredTransformInitialization == 0;
 
   if (!m_Image)
   {
     return;
   }
 
-  if ( this->m_CenterOfGravityUsesLowerThreshold )
+  if (this->m_ComputeOnFullImage)
   {
-    typename BinaryThresholdImageFilterType::Pointer thresholdFilter
-      = BinaryThresholdImageFilterType::New();
-    thresholdFilter->SetInput(this->m_Image);
-    thresholdFilter->SetLowerThreshold(this->m_LowerThresholdForCenterGravity);
-    thresholdFilter->SetInsideValue(1);
-    thresholdFilter->SetOutsideValue(0);
-    thresholdFilter->Update();
-    this->SetImage(thresholdFilter->GetOutput());
+    this->m_SampleContainer = nullptr;
+    return;
   }
 
   this->SampleImage(this->m_SampleContainer);
@@ -379,6 +380,15 @@ AdvancedImageMomentsCalculator< TImage >
     return;
   }
 
+  if (this->m_ComputeOnFullImage)
+  {
+    this->ThreadedComputeFullImage(threadId);
+    return;
+  }
+
+  const bool   useThreshold = this->m_CenterOfGravityUsesLowerThreshold;
+  const double threshold = static_cast< double >(this->m_LowerThresholdForCenterGravity);
+
   ScalarType M0 = 0;
   VectorType M1,Cg;
   M1.Fill(NumericTraits< typename VectorType::ValueType >::ZeroValue());
@@ -413,6 +423,10 @@ AdvancedImageMomentsCalculator< TImage >
   for (threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter)
   {
     double value = (*threader_fiter).Value().m_ImageValue;
+    if (useThreshold)
+    {
+      value = (value >= threshold) ? 1.0 : 0.0;
+    }
     //IndexType indexPosition = (*threader_fiter).GetIndex();
     Point< double, ImageDimension > physicalPosition = (*threader_fiter).Value().m_ImageCoordinates;
 
@@ -443,6 +457,158 @@ AdvancedImageMomentsCalculator< TImage >
 
 }// end ThreadedCompute()
 
+/**
+* ************ ThreadedComputeFullImage ****************************
+*/
+template< typename TImage >
+void
+AdvancedImageMomentsCalculator< TImage >
+::ThreadedComputeFullImage(ThreadIdType threadId)
+{
+  typedef typename ImageType::IndexType      IndexType;
+  typedef typename ImageType::SizeType       SizeType;
+  typedef typename ImageType::IndexValueType IndexValueType;
+
+  const ThreadRegionType region = this->m_Image->GetRequestedRegion();
+  const SizeType         size = region.GetSize();
+  const IndexType        start = region.GetIndex();
+  const SizeValueType    scanlineLength = size[0];
+  SizeValueType          numberOfScanlines = 1;
+  for (unsigned int d = 1; d < ImageDimension; ++d)
+  {
+    numberOfScanlines *= size[d];
+  }
+
+  /** Get the scanlines for this thread. */
+  const ThreadIdType  numberOfThreads = this->m_Threader->GetNumberOfWorkUnits();
+  const SizeValueType scanlinesPerThread
+    = (numberOfScanlines + numberOfThreads - 1) / numberOfThreads;
+  const SizeValueType lineBegin = std::min(numberOfScanlines, scanlinesPerThread * threadId);
+  const SizeValueType lineEnd = std::min(numberOfScanlines, lineBegin + scanlinesPerThread);
+
+  const bool           useThreshold = this->m_CenterOfGravityUsesLowerThreshold;
+  const InputPixelType threshold = this->m_LowerThresholdForCenterGravity;
+  const bool           useMask = this->m_SpatialObjectMask.IsNotNull();
+  const InputPixelType * buffer = this->m_Image->GetBufferPointer();
+
+  ScalarType M0 = 0;
+  VectorType M1;
+  MatrixType M2;
+  M1.Fill(NumericTraits< typename VectorType::ValueType >::ZeroValue());
+  M2.Fill(NumericTraits< typename MatrixType::ValueType >::ZeroValue());
+  SizeValueType numberOfPixelsCounted = 0;
+
+  IndexType                       index;
+  IndexType                       voxel;
+  Point< double, ImageDimension > physicalPosition;
+  for (SizeValueType line = lineBegin; line < lineEnd; ++line)
+  {
+    /** The index of the first voxel of the scanline. */
+    SizeValueType rest = line;
+    index[0] = start[0];
+    for (unsigned int d = 1; d < ImageDimension; ++d)
+    {
+      index[d] = start[d] + static_cast< IndexValueType >(rest % size[d]);
+      rest /= size[d];
+    }
+    const InputPixelType * scanline = buffer + this->m_Image->ComputeOffset(index);
+
+    double sum0 = 0.0;
+    double sum1 = 0.0;
+    double sum2 = 0.0;
+    if (!useMask)
+    {
+      AccumulateScanline(scanline, scanlineLength, static_cast< double >(index[0]),
+        useThreshold, threshold, sum0, sum1, sum2);
+      numberOfPixelsCounted += scanlineLength;
+    }
+    else
+    {
+      voxel = index;
+      for (SizeValueType k = 0; k < scanlineLength; ++k)
+      {
+        voxel[0] = index[0] + static_cast< IndexValueType >(k);
+        this->m_Image->TransformIndexToPhysicalPoint(voxel, physicalPosition);
+        if (this->m_SpatialObjectMask->IsInsideInWorldSpace(physicalPosition))
+        {
+          AccumulateScanline(scanline + k, 1, static_cast< double >(voxel[0]),
+            useThreshold, threshold, sum0, sum1, sum2);
+          ++numberOfPixelsCounted;
+        }
+      }
+    }
+
+    /** Add the sums of the scanline to the moments in index coordinates. */
+    M0 += sum0;
+    M1[0] += sum1;
+    M2[0][0] += sum2;
+    for (unsigned int i = 1; i < ImageDimension; ++i)
+    {
+      const double x = static_cast< double >(index[i]);
+      M1[i] += x * sum0;
+      M2[0][i] += x * sum1;
+      M2[i][0] += x * sum1;
+      for (unsigned int j = 1; j < ImageDimension; ++j)
+      {
+        M2[i][j] += x * static_cast< double >(index[j]) * sum0;
+      }
+    }
+  }
+
+  /** Update the thread struct once. */
+  this->m_ComputePerThreadVariables[threadId].st_M0 = M0;
+  this->m_ComputePerThreadVariables[threadId].st_M1 = M1;
+  this->m_ComputePerThreadVariables[threadId].st_M2 = M2;
+  this->m_ComputePerThreadVariables[threadId].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+}// end ThreadedComputeFullImage()
+
+/**
+* ************ AccumulateScanline ****************************
+*/
+template< typename TImage >
+void
+AdvancedImageMomentsCalculator< TImage >
+::AccumulateScanline(const InputPixelType * scanline,
+  const SizeValueType length, const double firstIndex,
+  const bool useThreshold, const InputPixelType threshold,
+  double & sum0, double & sum1, double & sum2)
+{
+  double partial0[4] = { 0.0, 0.0, 0.0, 0.0 };
+  double partial1[4] = { 0.0, 0.0, 0.0, 0.0 };
+  double partial2[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+  SizeValueType k = 0;
+  for (; k + 4 <= length; k += 4)
+  {
+    for (unsigned int lane = 0; lane < 4; ++lane)
+    {
+      const InputPixelType pixel = scanline[k + lane];
+      const double value = useThreshold
+        ? ((pixel >= threshold) ? 1.0 : 0.0) : static_cast< double >(pixel);
+      const double x = firstIndex + static_cast< double >(k + lane);
+      partial0[lane] += value;
+      partial1[lane] += value * x;
+      partial2[lane] += value * x * x;
+    }
+  }
+  for (; k < length; ++k)
+  {
+    const InputPixelType pixel = scanline[k];
+    const double value = useThreshold
+      ? ((pixel >= threshold) ? 1.0 : 0.0) : static_cast< double >(pixel);
+    const double x = firstIndex + static_cast< double >(k);
+    partial0[0] += value;
+    partial1[0] += value * x;
+    partial2[0] += value * x * x;
+  }
+
+  sum0 += (partial0[0] + partial0[1]) + (partial0[2] + partial0[3]);
+  sum1 += (partial1[0] + partial1[1]) + (partial1[2] + partial1[3]);
+  sum2 += (partial2[0] + partial2[1]) + (partial2[2] + partial2[3]);
+
+}// end AccumulateScanline()
+
  /**
  * *********************** AfterThreadedCompute***************
  */
@@ -481,6 +647,55 @@ AdvancedImageMomentsCalculator< TImage >
       << "Compute(): Total Mass of the image was zero. Aborting here to prevent division by zero later on.");
   }
 
+  // Map the sums over all voxels from index to physical coordinates,
+  // p = origin + A * index, with A the direction times the spacing.
+  if (this->m_ComputeOnFullImage)
+  {
+    const typename ImageType::PointType &     origin = this->m_Image->GetOrigin();
+    const typename ImageType::SpacingType &   spacing = this->m_Image->GetSpacing();
+    const typename ImageType::DirectionType & direction = this->m_Image->GetDirection();
+
+    MatrixType A;
+    for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+      for (unsigned int j = 0; j < ImageDimension; j++)
+      {
+        A[i][j] = direction[i][j] * spacing[j];
+      }
+    }
+
+    VectorType AM1;
+    MatrixType AM2;
+    AM1.Fill(NumericTraits< typename VectorType::ValueType >::ZeroValue());
+    AM2.Fill(NumericTraits< typename MatrixType::ValueType >::ZeroValue());
+    for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+      for (unsigned int j = 0; j < ImageDimension; j++)
+      {
+        AM1[i] += A[i][j] * m_M1[j];
+        for (unsigned int k = 0; k < ImageDimension; k++)
+        {
+          AM2[i][j] += A[i][k] * m_M2[k][j];
+        }
+      }
+    }
+
+    for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+      m_Cg[i] = origin[i] * m_M0 + AM1[i];
+      for (unsigned int j = 0; j < ImageDimension; j++)
+      {
+        double AM2At = 0.0;
+        for (unsigned int k = 0; k < ImageDimension; k++)
+        {
+          AM2At += AM2[i][k] * A[j][k];
+        }
+        m_Cm[i][j] = origin[i] * origin[j] * m_M0
+          + origin[i] * AM1[j] + AM1[i] * origin[j] + AM2At;
+      }
+    }
+  }
+
   // Normalize using the total mass
   for (unsigned int i = 0; i < ImageDimension; i++)
   {
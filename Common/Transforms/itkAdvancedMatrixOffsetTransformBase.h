@@ -146,6 +146,9 @@ public:
   typedef typename Superclass
     ::JacobianOfSpatialHessianType JacobianOfSpatialHessianType;
   typedef typename Superclass::InternalMatrixType InternalMatrixType;
+  typedef typename Superclass::DerivativeType     DerivativeType;
+  typedef typename Superclass
+    ::MovingImageGradientType MovingImageGradientType;
 
   /** Standard matrix type for this class. */
   typedef Matrix< TScalarType,
@@ -343,6 +346,12 @@ public:
    */
   OutputPointType     TransformPoint( const InputPointType & point ) const override;
 
+  /** Transform a batch of points by the affine transformation, without a
+   * virtual call per point.
+   */
+  void TransformPoints( const InputPointType * inputPoints,
+    OutputPointType * outputPoints, const SizeValueType n ) const override;
+
   OutputVectorType    TransformVector( const InputVectorType & vector ) const override;
 
   OutputVnlVectorType TransformVector( const InputVnlVectorType & vector ) const override;
@@ -400,6 +409,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
   /** Compute the spatial Jacobian of the transformation. */
   void GetSpatialJacobian(
     const InputPointType &,
@@ -455,6 +473,23 @@ protected:
   /** Called by constructors: */
   virtual void PrecomputeJacobians( unsigned int paramDims );
 
+  /** Helpers for the EvaluateJacobianWithImageGradientProduct() of the
+   * subclasses. The first sets imageJacobian[ mu ] to the inner product of
+   * the moving image gradient with dA/dmu ( ipp - c ), for the parameters
+   * begin to end - 1, using m_JacobianOfSpatialJacobian. The second sets
+   * the entries of the translation parameters, starting at offset.
+   */
+  void EvaluateJacobianOfSpatialJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    const unsigned int begin, const unsigned int end,
+    DerivativeType & imageJacobian ) const;
+
+  static void EvaluateTranslationWithImageGradientProduct(
+    const MovingImageGradientType & movingImageGradient,
+    const unsigned int offset,
+    DerivativeType & imageJacobian );
+
   /** Destroy an AdvancedMatrixOffsetTransformBase object. */
   ~AdvancedMatrixOffsetTransformBase() override {}
 
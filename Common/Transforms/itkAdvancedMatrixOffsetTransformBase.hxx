@@ -264,6 +264,21 @@ AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensi
 }
 
 
+// Transform a batch of points
+template< class TScalarType, unsigned int NInputDimensions,
+unsigned int NOutputDimensions >
+void
+AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensions >
+::TransformPoints( const InputPointType * inputPoints,
+  OutputPointType * outputPoints, const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    outputPoints[ i ] = m_Matrix * inputPoints[ i ] + m_Offset;
+  }
+}
+
+
 // Transform a vector
 template< class TScalarType, unsigned int NInputDimensions,
 unsigned int NOutputDimensions >
@@ -607,6 +622,95 @@ AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensi
 } // end GetJacobian()
 
 
+/**
+ * ********************* EvaluateJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions,
+unsigned int NOutputDimensions >
+void
+AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  // The nonzero entries of the Jacobian are the entries of v on the
+  // diagonal blocks, so the products can be written down directly.
+  const InputVectorType v = p - this->GetCenter();
+
+  unsigned int blockOffset = 0;
+  for( unsigned int block = 0; block < NInputDimensions; ++block )
+  {
+    const double imDeriv = movingImageGradient[ block ];
+    for( unsigned int dim = 0; dim < NOutputDimensions; ++dim )
+    {
+      imageJacobian[ blockOffset + dim ] = imDeriv * v[ dim ];
+    }
+    blockOffset += NInputDimensions;
+  }
+
+  Self::EvaluateTranslationWithImageGradientProduct(
+    movingImageGradient, blockOffset, imageJacobian );
+
+  // Copy the constant nonZeroJacobianIndices
+  nonZeroJacobianIndices = this->m_NonZeroJacobianIndices;
+
+} // end EvaluateJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* EvaluateJacobianOfSpatialJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions,
+unsigned int NOutputDimensions >
+void
+AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateJacobianOfSpatialJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  const unsigned int begin, const unsigned int end,
+  DerivativeType & imageJacobian ) const
+{
+  const InputVectorType                 pp  = p - this->GetCenter();
+  const JacobianOfSpatialJacobianType & jsj = this->m_JacobianOfSpatialJacobian;
+  for( unsigned int mu = begin; mu < end; ++mu )
+  {
+    const OutputVectorType column = jsj[ mu ] * pp;
+    double                 sum    = 0.0;
+    for( unsigned int i = 0; i < NOutputDimensions; ++i )
+    {
+      sum += movingImageGradient[ i ] * column[ i ];
+    }
+    imageJacobian[ mu ] = sum;
+  }
+
+} // end EvaluateJacobianOfSpatialJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* EvaluateTranslationWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions,
+unsigned int NOutputDimensions >
+void
+AdvancedMatrixOffsetTransformBase< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateTranslationWithImageGradientProduct(
+  const MovingImageGradientType & movingImageGradient,
+  const unsigned int offset,
+  DerivativeType & imageJacobian )
+{
+  for( unsigned int dim = 0; dim < NOutputDimensions; ++dim )
+  {
+    imageJacobian[ offset + dim ] = movingImageGradient[ dim ];
+  }
+
+} // end EvaluateTranslationWithImageGradientProduct()
+
+
 /**
  * ********************* GetSpatialJacobian ****************************
  */
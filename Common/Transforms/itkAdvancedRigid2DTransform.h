@@ -108,6 +108,9 @@ public:
   /// Standard matrix type for this class
   typedef typename Superclass::MatrixType MatrixType;
 
+  typedef typename Superclass::DerivativeType          DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
+
   /// Standard vector type for this class
   typedef typename Superclass::OffsetType OffsetType;
 
@@ -232,6 +235,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
   /**
    * This method creates and returns a new AdvancedRigid2DTransform object
    * which is the inverse of self.
@@ -321,6 +321,34 @@ AdvancedRigid2DTransform< TScalarType >::GetJacobian( const InputPointType & p,
 }
 
 
+// Compute the inner product of the Jacobian with the moving image gradient
+template< class TScalarType >
+void
+AdvancedRigid2DTransform< TScalarType >::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  // Some helper variables
+  const double ca = std::cos( this->GetAngle() );
+  const double sa = std::sin( this->GetAngle() );
+  const double cx = this->GetCenter()[ 0 ];
+  const double cy = this->GetCenter()[ 1 ];
+
+  // product with the derivatives with respect to the angle
+  imageJacobian[ 0 ]
+    = movingImageGradient[ 0 ] * ( -sa * ( p[ 0 ] - cx ) - ca * ( p[ 1 ] - cy ) )
+    + movingImageGradient[ 1 ] * (  ca * ( p[ 0 ] - cx ) - sa * ( p[ 1 ] - cy ) );
+
+  // the products for the translation part
+  this->EvaluateTranslationWithImageGradientProduct( movingImageGradient, 1, imageJacobian );
+
+  // Copy the constant nonZeroJacobianIndices
+  nzji = this->m_NonZeroJacobianIndices;
+}
+
+
 // Precompute Jacobian of Spatial Jacobian
 template< class TScalarType >
 void
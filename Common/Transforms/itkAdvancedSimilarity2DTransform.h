@@ -113,6 +113,9 @@ public:
   /** Offset type. */
   typedef typename Superclass::OffsetType OffsetType;
 
+  typedef typename Superclass::DerivativeType          DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
+
   /** Matrix type. */
   typedef typename Superclass::MatrixType MatrixType;
 
@@ -180,6 +183,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
   /** Set the transformation to an identity. */
   void SetIdentity( void ) override;
 
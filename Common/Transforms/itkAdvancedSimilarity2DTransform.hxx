@@ -220,6 +220,39 @@ AdvancedSimilarity2DTransform< TScalarType >::GetJacobian( const InputPointType
 }
 
 
+// Compute the inner product of the Jacobian with the moving image gradient
+template< class TScalarType >
+void
+AdvancedSimilarity2DTransform< TScalarType >::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  // Some helper variables
+  const double         angle  = this->GetAngle();
+  const double         ca     = std::cos( angle );
+  const double         sa     = std::sin( angle );
+  const InputPointType center = this->GetCenter();
+  const double         px     = p[ 0 ] - center[ 0 ];
+  const double         py     = p[ 1 ] - center[ 1 ];
+  const double         gx     = movingImageGradient[ 0 ];
+  const double         gy     = movingImageGradient[ 1 ];
+
+  // product with the derivatives with respect to the scale
+  imageJacobian[ 0 ] = gx * ( ca * px - sa * py ) + gy * ( sa * px + ca * py );
+
+  // product with the derivatives with respect to the angle
+  imageJacobian[ 1 ] = ( gx * ( -sa * px - ca * py ) + gy * ( ca * px - sa * py ) ) * m_Scale;
+
+  // the products for the translation part
+  this->EvaluateTranslationWithImageGradientProduct( movingImageGradient, 2, imageJacobian );
+
+  // Copy the constant nonZeroJacobianIndices
+  nzji = this->m_NonZeroJacobianIndices;
+}
+
+
 // Set Identity
 template< class TScalarType >
 void
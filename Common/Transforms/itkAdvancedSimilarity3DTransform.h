@@ -105,6 +105,9 @@ public:
   typedef typename Superclass::OffsetType        OffsetType;
   typedef typename Superclass::TranslationType   TranslationType;
 
+  typedef typename Superclass::DerivativeType          DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
+
   /** Versor type. */
   typedef typename Superclass::VersorType VersorType;
   typedef typename Superclass::AxisType   AxisType;
@@ -147,6 +150,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
 protected:
 
   AdvancedSimilarity3DTransform( unsigned int outputSpaceDim,
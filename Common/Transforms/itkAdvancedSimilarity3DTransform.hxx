@@ -256,6 +256,34 @@ AdvancedSimilarity3DTransform< TScalarType >::GetJacobian( const InputPointType
 }
 
 
+// Compute the inner product of the Jacobian with the moving image gradient
+template< class TScalarType >
+void
+AdvancedSimilarity3DTransform< TScalarType >::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  /** Compute the products with dR/dmu * (p-c) */
+  this->EvaluateJacobianOfSpatialJacobianWithImageGradientProduct(
+    p, movingImageGradient, 0, 3, imageJacobian );
+
+  // the products for the translation parameters
+  this->EvaluateTranslationWithImageGradientProduct( movingImageGradient, 3, imageJacobian );
+
+  // the product for the scale parameter
+  const InputVectorType pp  = p - this->GetCenter();
+  const InputVectorType mpp = this->GetMatrix() * pp;
+  imageJacobian[ 6 ] = ( movingImageGradient[ 0 ] * mpp[ 0 ]
+    + movingImageGradient[ 1 ] * mpp[ 1 ]
+    + movingImageGradient[ 2 ] * mpp[ 2 ] ) / m_Scale;
+
+  // Copy the constant nonZeroJacobianIndices
+  nzji = this->m_NonZeroJacobianIndices;
+}
+
+
 // Set the scale factor
 template< class TScalarType >
 void
@@ -161,6 +161,42 @@ public:
   /** Get the number of nonzero Jacobian indices. By default all. */
   virtual NumberOfParametersType GetNumberOfNonZeroJacobianIndices( void ) const;
 
+  /** Transform a batch of n points. The input and output arrays should
+   * both hold at least n points. By default TransformPoint() is called for
+   * each point; subclasses may override this to avoid the virtual call per
+   * point or to share work between points.
+   */
+  virtual void TransformPoints(
+    const InputPointType * inputPoints,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const;
+
+  /** Transform the n points startPoint + i * step, with i = 0, ..., n - 1,
+   * such as the points of a scanline of an image. By default these points
+   * are passed to TransformPoints(); subclasses may override this to share
+   * work between the points of the line.
+   */
+  virtual void TransformScanline(
+    const InputPointType & startPoint,
+    const InputVectorType & step,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const;
+
+  /** Precompute the parts of the transformation that do not depend on its
+   * parameters at a set of points, such as the fixed image samples, so that
+   * later evaluations at exactly these points look them up. By default
+   * nothing is cached; subclasses may override this. Evaluations at other
+   * points are not affected. Not thread-safe.
+   */
+  virtual void CachePoints( const InputPointType * itkNotUsed( points ),
+    const SizeValueType itkNotUsed( n ) ) {}
+
+  /** Remove the evaluations precomputed by CachePoints(). */
+  virtual void RemovePointCache( void ) {}
+
+  /** Get the number of points cached by CachePoints(). */
+  virtual SizeValueType GetNumberOfCachedPoints( void ) const { return 0; }
+
   /** Whether the advanced transform has nonzero matrices. */
   itkGetConstMacro( HasNonZeroSpatialHessian, bool );
   itkGetConstMacro( HasNonZeroJacobianOfSpatialHessian, bool );
@@ -205,6 +241,19 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const;
 
+  /** Compute the inner product of the Jacobian with the moving image gradient
+   * for a batch of n points. All arrays should hold at least n elements, and
+   * each imageJacobians[ i ] should have the size
+   * GetNumberOfNonZeroJacobianIndices(). By default
+   * EvaluateJacobianWithImageGradientProduct() is called for each point.
+   */
+  virtual void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * ipps,
+    const MovingImageGradientType * movingImageGradients,
+    DerivativeType * imageJacobians,
+    NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+    const SizeValueType n ) const;
+
   /** Compute the spatial Jacobian of the transformation.
    *
    * The spatial Jacobian is expressed as a vector of partial derivatives of the
@@ -235,6 +284,17 @@ public:
     const InputPointType & ipp,
     SpatialJacobianType & sj ) const = 0;
 
+  /** Compute the spatial Jacobians at the n points startPoint + i * step,
+   * with i = 0, ..., n - 1, such as the points of a scanline of an image.
+   * By default GetSpatialJacobian() is called for every point; subclasses
+   * may override this to share work between the points of the line.
+   */
+  virtual void GetSpatialJacobianScanline(
+    const InputPointType & startPoint,
+    const InputVectorType & step,
+    SpatialJacobianType * sjs,
+    const SizeValueType n ) const;
+
   /** Override some pure virtual ITK4 functions. */
   void ComputeJacobianWithRespectToParameters(
     const InputPointType & itkNotUsed( p ), JacobianType & itkNotUsed( j ) ) const override
@@ -36,6 +36,8 @@
 
 #include "itkAdvancedTransform.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -107,6 +109,93 @@ AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ********************* TransformPoints ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    outputPoints[ i ] = this->TransformPoint( inputPoints[ i ] );
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ********************* TransformScanline ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::TransformScanline(
+  const InputPointType & startPoint,
+  const InputVectorType & step,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  std::vector< InputPointType > inputPoints( n );
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    inputPoints[ i ] = startPoint + step * static_cast< TScalarType >( i );
+  }
+  this->TransformPoints( inputPoints.data(), outputPoints, n );
+
+} // end TransformScanline()
+
+
+/**
+ * ********************* GetSpatialJacobianScanline ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::GetSpatialJacobianScanline(
+  const InputPointType & startPoint,
+  const InputVectorType & step,
+  SpatialJacobianType * sjs,
+  const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    this->GetSpatialJacobian( startPoint + step * static_cast< TScalarType >( i ), sjs[ i ] );
+  }
+
+} // end GetSpatialJacobianScanline()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+AdvancedTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * ipps,
+  const MovingImageGradientType * movingImageGradients,
+  DerivativeType * imageJacobians,
+  NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+  const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    this->EvaluateJacobianWithImageGradientProduct( ipps[ i ],
+      movingImageGradients[ i ], imageJacobians[ i ], nonZeroJacobianIndices[ i ] );
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 /**
  * ********************* GetNumberOfNonZeroJacobianIndices ****************************
  */
@@ -0,0 +1,165 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAdvancedTransformToDisplacementFieldSource_h
+#define __itkAdvancedTransformToDisplacementFieldSource_h
+
+#include "itkAdvancedTransform.h"
+#include "itkImageSource.h"
+
+namespace itk
+{
+
+/** \class AdvancedTransformToDisplacementFieldSource
+ * \brief Generate the displacement field of an AdvancedTransform.
+ *
+ * This class is similar to the TransformToDisplacementFieldFilter of ITK,
+ * but transforms the output image one scanline at a time, by
+ * AdvancedTransform::TransformScanline(). Transforms that share work between
+ * the points of a scanline, such as the B-spline transform, then compute
+ * the displacement field faster than point by point.
+ *
+ * The output image should have a vector pixel type, such as
+ * itk::Vector<float, ImageDimension>. The output information (size, index,
+ * spacing, origin and direction) should be set. The filter supports
+ * streaming, so that a writer can generate and write the displacement field
+ * in slabs.
+ *
+ * This filter is implemented as a multithreaded filter. It provides a
+ * ThreadedGenerateData() method for its implementation.
+ *
+ * \ingroup GeometricTransforms
+ */
+
+template< class TOutputImage, class TTransformPrecisionType = double >
+class AdvancedTransformToDisplacementFieldSource :
+  public ImageSource< TOutputImage >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef AdvancedTransformToDisplacementFieldSource Self;
+  typedef ImageSource< TOutputImage >                Superclass;
+  typedef SmartPointer< Self >                       Pointer;
+  typedef SmartPointer< const Self >                 ConstPointer;
+
+  typedef TOutputImage                         OutputImageType;
+  typedef typename OutputImageType::Pointer    OutputImagePointer;
+  typedef typename OutputImageType::RegionType OutputImageRegionType;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( AdvancedTransformToDisplacementFieldSource, ImageSource );
+
+  /** Number of dimensions. */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+    TOutputImage::ImageDimension );
+
+  /** Typedefs for transform. */
+  typedef AdvancedTransform< TTransformPrecisionType,
+    itkGetStaticConstMacro( ImageDimension ),
+    itkGetStaticConstMacro( ImageDimension ) >     TransformType;
+  typedef typename TransformType::ConstPointer    TransformPointerType;
+  typedef typename TransformType::InputPointType  InputPointType;
+  typedef typename TransformType::InputVectorType InputVectorType;
+  typedef typename TransformType::OutputPointType OutputPointType;
+
+  /** Typedefs for output image. */
+  typedef typename OutputImageType::PixelType     PixelType;
+  typedef typename PixelType::ValueType           PixelValueType;
+  typedef typename OutputImageType::RegionType    RegionType;
+  typedef typename RegionType::SizeType           SizeType;
+  typedef typename OutputImageType::IndexType     IndexType;
+  typedef typename OutputImageType::PointType     PointType;
+  typedef typename OutputImageType::SpacingType   SpacingType;
+  typedef typename OutputImageType::PointType     OriginType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  /** Set/Get the coordinate transformation. This is the output-to-input
+   * transform, as for the ResampleImageFilter.
+   */
+  itkSetConstObjectMacro( Transform, TransformType );
+  itkGetConstObjectMacro( Transform, TransformType );
+
+  /** Set/Get the size of the output image. */
+  virtual void SetOutputSize( const SizeType & size );
+
+  virtual const SizeType & GetOutputSize();
+
+  /** Set/Get the start index of the output largest possible region.
+   * The default is an index of all zeros.
+   */
+  virtual void SetOutputIndex( const IndexType & index );
+
+  virtual const IndexType & GetOutputIndex();
+
+  /** Set/Get the output image spacing. */
+  itkSetMacro( OutputSpacing, SpacingType );
+  itkGetConstReferenceMacro( OutputSpacing, SpacingType );
+
+  /** Set/Get the output image origin. */
+  itkSetMacro( OutputOrigin, OriginType );
+  itkGetConstReferenceMacro( OutputOrigin, OriginType );
+
+  /** Set/Get the output direction cosine matrix. */
+  itkSetMacro( OutputDirection, DirectionType );
+  itkGetConstReferenceMacro( OutputDirection, DirectionType );
+
+  /** Set the output information of the image. */
+  void GenerateOutputInformation( void ) override;
+
+  /** Check whether the transform is set. */
+  void BeforeThreadedGenerateData( void ) override;
+
+  /** Compute the Modified Time based on changes to the components. */
+  ModifiedTimeType GetMTime( void ) const override;
+
+protected:
+
+  AdvancedTransformToDisplacementFieldSource();
+  ~AdvancedTransformToDisplacementFieldSource() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Compute the displacements of the output region one scanline at a time. */
+  void ThreadedGenerateData(
+    const OutputImageRegionType & outputRegionForThread,
+    ThreadIdType threadId ) override;
+
+private:
+
+  AdvancedTransformToDisplacementFieldSource( const Self & ); // purposely not implemented
+  void operator=( const Self & );                             // purposely not implemented
+
+  /** Member variables. */
+  RegionType           m_OutputRegion;
+  TransformPointerType m_Transform;
+  SpacingType          m_OutputSpacing;
+  OriginType           m_OutputOrigin;
+  DirectionType        m_OutputDirection;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkAdvancedTransformToDisplacementFieldSource.hxx"
+#endif
+
+#endif // end #ifndef __itkAdvancedTransformToDisplacementFieldSource_h
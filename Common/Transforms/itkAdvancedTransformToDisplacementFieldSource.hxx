@@ -0,0 +1,272 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAdvancedTransformToDisplacementFieldSource_hxx
+#define __itkAdvancedTransformToDisplacementFieldSource_hxx
+
+#include "itkAdvancedTransformToDisplacementFieldSource.h"
+
+#include "itkAdvancedIdentityTransform.h"
+#include "itkImageScanlineIterator.h"
+#include "itkProgressReporter.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::AdvancedTransformToDisplacementFieldSource()
+{
+  this->m_OutputSpacing.Fill( 1.0 );
+  this->m_OutputOrigin.Fill( 0.0 );
+  this->m_OutputDirection.SetIdentity();
+
+  SizeType size;
+  size.Fill( 0 );
+  this->m_OutputRegion.SetSize( size );
+
+  IndexType index;
+  index.Fill( 0 );
+  this->m_OutputRegion.SetIndex( index );
+
+  this->m_Transform = AdvancedIdentityTransform< TTransformPrecisionType, ImageDimension >::New();
+
+  // Use the classic (ITK4) threading model, to ensure ThreadedGenerateData is being called.
+  this->itk::ImageSource< TOutputImage >::DynamicMultiThreadingOff();
+
+} // end Constructor
+
+
+/**
+ * ********************* PrintSelf ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "OutputRegion: " << this->m_OutputRegion << std::endl;
+  os << indent << "OutputSpacing: " << this->m_OutputSpacing << std::endl;
+  os << indent << "OutputOrigin: " << this->m_OutputOrigin << std::endl;
+  os << indent << "OutputDirection: " << this->m_OutputDirection << std::endl;
+  os << indent << "Transform: " << this->m_Transform.GetPointer() << std::endl;
+
+} // end PrintSelf()
+
+
+/**
+ * ********************* SetOutputSize ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::SetOutputSize( const SizeType & size )
+{
+  if( this->m_OutputRegion.GetSize() != size )
+  {
+    this->m_OutputRegion.SetSize( size );
+    this->Modified();
+  }
+
+} // end SetOutputSize()
+
+
+/**
+ * ********************* GetOutputSize ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+const typename AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >::SizeType &
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::GetOutputSize( void )
+{
+  return this->m_OutputRegion.GetSize();
+
+} // end GetOutputSize()
+
+
+/**
+ * ********************* SetOutputIndex ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::SetOutputIndex( const IndexType & index )
+{
+  if( this->m_OutputRegion.GetIndex() != index )
+  {
+    this->m_OutputRegion.SetIndex( index );
+    this->Modified();
+  }
+
+} // end SetOutputIndex()
+
+
+/**
+ * ********************* GetOutputIndex ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+const typename AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >::IndexType &
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::GetOutputIndex( void )
+{
+  return this->m_OutputRegion.GetIndex();
+
+} // end GetOutputIndex()
+
+
+/**
+ * ********************* BeforeThreadedGenerateData ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::BeforeThreadedGenerateData( void )
+{
+  if( !this->m_Transform )
+  {
+    itkExceptionMacro( << "Transform not set" );
+  }
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ********************* ThreadedGenerateData ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::ThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread,
+  ThreadIdType threadId )
+{
+  OutputImagePointer outputPtr = this->GetOutput();
+
+  ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
+
+  /** The physical step between two voxels of a scanline. */
+  IndexType index = outputRegionForThread.GetIndex();
+  PointType point;
+  PointType nextPoint;
+  outputPtr->TransformIndexToPhysicalPoint( index, point );
+  ++index[ 0 ];
+  outputPtr->TransformIndexToPhysicalPoint( index, nextPoint );
+  InputVectorType step;
+  for( unsigned int j = 0; j < ImageDimension; j++ )
+  {
+    step[ j ] = nextPoint[ j ] - point[ j ];
+  }
+
+  const SizeValueType            lineLength = outputRegionForThread.GetSize( 0 );
+  std::vector< OutputPointType > transformedPoints( lineLength );
+  InputPointType                 lineStart;
+  PixelType                      displacement;
+
+  ImageScanlineIterator< OutputImageType > it( outputPtr, outputRegionForThread );
+  while( !it.IsAtEnd() )
+  {
+    outputPtr->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+    for( unsigned int j = 0; j < ImageDimension; j++ )
+    {
+      lineStart[ j ] = point[ j ];
+    }
+    this->m_Transform->TransformScanline( lineStart, step, transformedPoints.data(), lineLength );
+
+    for( SizeValueType i = 0; i < lineLength; ++i )
+    {
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+        displacement[ j ] = static_cast< PixelValueType >( transformedPoints[ i ][ j ]
+          - ( lineStart[ j ] + static_cast< TTransformPrecisionType >( i ) * step[ j ] ) );
+      }
+      it.Set( displacement );
+      progress.CompletedPixel();
+      ++it;
+    }
+    it.NextLine();
+  }
+
+} // end ThreadedGenerateData()
+
+
+/**
+ * ********************* GenerateOutputInformation ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::GenerateOutputInformation( void )
+{
+  Superclass::GenerateOutputInformation();
+
+  OutputImagePointer outputPtr = this->GetOutput();
+  if( !outputPtr )
+  {
+    return;
+  }
+
+  outputPtr->SetLargestPossibleRegion( this->m_OutputRegion );
+  outputPtr->SetSpacing( this->m_OutputSpacing );
+  outputPtr->SetOrigin( this->m_OutputOrigin );
+  outputPtr->SetDirection( this->m_OutputDirection );
+
+} // end GenerateOutputInformation()
+
+
+/**
+ * ********************* GetMTime ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+ModifiedTimeType
+AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::GetMTime( void ) const
+{
+  ModifiedTimeType latestTime = Object::GetMTime();
+
+  if( this->m_Transform )
+  {
+    if( latestTime < this->m_Transform->GetMTime() )
+    {
+      latestTime = this->m_Transform->GetMTime();
+    }
+  }
+
+  return latestTime;
+
+} // end GetMTime()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkAdvancedTransformToDisplacementFieldSource_hxx
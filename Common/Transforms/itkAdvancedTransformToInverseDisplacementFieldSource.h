@@ -0,0 +1,160 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAdvancedTransformToInverseDisplacementFieldSource_h
+#define __itkAdvancedTransformToInverseDisplacementFieldSource_h
+
+#include "itkAdvancedTransformToDisplacementFieldSource.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class AdvancedTransformToInverseDisplacementFieldSource
+ * \brief Generate the displacement field of the inverse of an AdvancedTransform.
+ *
+ * For every point \f$y\f$ of the output image, the point \f$x\f$ with
+ * \f$T(x) = y\f$ is found by Newton iterations,
+ * \f$x \leftarrow x - J_T(x)^{-1} ( T(x) - y )\f$, with a step that is
+ * halved until the residual decreases. The output pixel is the displacement
+ * \f$x - y\f$. The solution of a voxel is the initial guess for the next
+ * voxel of the scanline, so that usually only a few iterations are needed.
+ *
+ * The spatial Jacobian \f$J_T\f$ is computed by
+ * AdvancedTransform::GetSpatialJacobian(). If the transform does not
+ * implement it, such as the DeformationFieldInterpolatingTransform, it is
+ * approximated by finite differences. Where the Jacobian is singular, the
+ * fixed point step \f$x \leftarrow x - ( T(x) - y )\f$ is taken instead.
+ *
+ * The iterations stop when \f$|T(x) - y|\f$ is below the Tolerance, times the
+ * smallest output spacing, or after MaximumNumberOfIterations. The number of
+ * points for which the tolerance was not reached is available after the
+ * update, by GetNumberOfUnconvergedPoints(), also when the output is
+ * generated in streamed slabs.
+ *
+ * The Transform, and the output information, are set as for the
+ * AdvancedTransformToDisplacementFieldSource. The output is generated by
+ * multiple threads, and supports streaming.
+ *
+ * \ingroup GeometricTransforms
+ */
+
+template< class TOutputImage, class TTransformPrecisionType = double >
+class AdvancedTransformToInverseDisplacementFieldSource :
+  public AdvancedTransformToDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef AdvancedTransformToInverseDisplacementFieldSource Self;
+  typedef AdvancedTransformToDisplacementFieldSource<
+    TOutputImage, TTransformPrecisionType >                 Superclass;
+  typedef SmartPointer< Self >                              Pointer;
+  typedef SmartPointer< const Self >                        ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( AdvancedTransformToInverseDisplacementFieldSource,
+    AdvancedTransformToDisplacementFieldSource );
+
+  /** Number of dimensions. */
+  itkStaticConstMacro( ImageDimension, unsigned int,
+    TOutputImage::ImageDimension );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass::OutputImageType        OutputImageType;
+  typedef typename Superclass::OutputImagePointer     OutputImagePointer;
+  typedef typename Superclass::OutputImageRegionType  OutputImageRegionType;
+  typedef typename Superclass::TransformType          TransformType;
+  typedef typename Superclass::InputPointType         InputPointType;
+  typedef typename Superclass::InputVectorType        InputVectorType;
+  typedef typename Superclass::OutputPointType        OutputPointType;
+  typedef typename Superclass::PixelType              PixelType;
+  typedef typename Superclass::PixelValueType         PixelValueType;
+  typedef typename Superclass::IndexType              IndexType;
+  typedef typename Superclass::PointType              PointType;
+  typedef typename TransformType::SpatialJacobianType SpatialJacobianType;
+
+  /** Set/Get the maximum number of Newton iterations per point. The default is 50. */
+  itkSetMacro( MaximumNumberOfIterations, unsigned int );
+  itkGetConstMacro( MaximumNumberOfIterations, unsigned int );
+
+  /** Set/Get the maximum distance between the transformed solution and the
+   * output point, relative to the smallest output spacing. The default is 0.001.
+   */
+  itkSetMacro( Tolerance, double );
+  itkGetConstMacro( Tolerance, double );
+
+  /** Get the number of points of the last update for which the tolerance
+   * was not reached. It is summed over the streamed slabs.
+   */
+  itkGetConstMacro( NumberOfUnconvergedPoints, SizeValueType );
+
+  /** Set the output information, and reset the number of unconverged points. */
+  void GenerateOutputInformation( void ) override;
+
+  /** Check whether the transform implements the spatial Jacobian. */
+  void BeforeThreadedGenerateData( void ) override;
+
+  /** Add the number of unconverged points of the threads. */
+  void AfterThreadedGenerateData( void ) override;
+
+protected:
+
+  AdvancedTransformToInverseDisplacementFieldSource();
+  ~AdvancedTransformToInverseDisplacementFieldSource() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Invert the transform for the points of the output region, one scanline
+   * at a time.
+   */
+  void ThreadedGenerateData(
+    const OutputImageRegionType & outputRegionForThread,
+    ThreadIdType threadId ) override;
+
+private:
+
+  AdvancedTransformToInverseDisplacementFieldSource( const Self & ); // purposely not implemented
+  void operator=( const Self & );                                    // purposely not implemented
+
+  /** Find x with T(x) = y, starting at x. Returns whether the tolerance was
+   * reached. The tolerance and the finite difference step are in physical
+   * units.
+   */
+  bool InvertPoint( const OutputPointType & y, InputPointType & x,
+    const double squaredTolerance, const double differenceStep ) const;
+
+  /** Member variables. */
+  unsigned int                 m_MaximumNumberOfIterations;
+  double                       m_Tolerance;
+  SizeValueType                m_NumberOfUnconvergedPoints;
+  std::vector< SizeValueType > m_NumberOfUnconvergedPointsPerThread;
+  bool                         m_UseSpatialJacobian;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkAdvancedTransformToInverseDisplacementFieldSource.hxx"
+#endif
+
+#endif // end #ifndef __itkAdvancedTransformToInverseDisplacementFieldSource_h
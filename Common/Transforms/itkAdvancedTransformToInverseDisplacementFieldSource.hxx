@@ -0,0 +1,314 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAdvancedTransformToInverseDisplacementFieldSource_hxx
+#define __itkAdvancedTransformToInverseDisplacementFieldSource_hxx
+
+#include "itkAdvancedTransformToInverseDisplacementFieldSource.h"
+
+#include "itkImageScanlineIterator.h"
+#include "itkProgressReporter.h"
+#include "vnl/vnl_det.h"
+#include "vnl/vnl_inverse.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+AdvancedTransformToInverseDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::AdvancedTransformToInverseDisplacementFieldSource()
+{
+  this->m_MaximumNumberOfIterations = 50;
+  this->m_Tolerance                 = 0.001;
+  this->m_NumberOfUnconvergedPoints = 0;
+  this->m_UseSpatialJacobian        = true;
+
+} // end Constructor
+
+
+/**
+ * ********************* PrintSelf ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToInverseDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "MaximumNumberOfIterations: " << this->m_MaximumNumberOfIterations << std::endl;
+  os << indent << "Tolerance: " << this->m_Tolerance << std::endl;
+  os << indent << "NumberOfUnconvergedPoints: " << this->m_NumberOfUnconvergedPoints << std::endl;
+
+} // end PrintSelf()
+
+
+/**
+ * ********************* GenerateOutputInformation ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToInverseDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::GenerateOutputInformation( void )
+{
+  Superclass::GenerateOutputInformation();
+
+  /** Called once before the slabs of a streamed update are generated. */
+  this->m_NumberOfUnconvergedPoints = 0;
+
+} // end GenerateOutputInformation()
+
+
+/**
+ * ********************* BeforeThreadedGenerateData ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToInverseDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::BeforeThreadedGenerateData( void )
+{
+  Superclass::BeforeThreadedGenerateData();
+
+  /** Transforms that do not implement the spatial Jacobian throw. */
+  InputPointType      point;
+  SpatialJacobianType sj;
+  for( unsigned int j = 0; j < ImageDimension; j++ )
+  {
+    point[ j ] = this->GetOutput()->GetOrigin()[ j ];
+  }
+  try
+  {
+    this->GetTransform()->GetSpatialJacobian( point, sj );
+    this->m_UseSpatialJacobian = true;
+  }
+  catch( ExceptionObject & )
+  {
+    this->m_UseSpatialJacobian = false;
+  }
+
+  this->m_NumberOfUnconvergedPointsPerThread.assign( this->GetNumberOfWorkUnits(), 0 );
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ********************* AfterThreadedGenerateData ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToInverseDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::AfterThreadedGenerateData( void )
+{
+  for( std::size_t i = 0; i < this->m_NumberOfUnconvergedPointsPerThread.size(); ++i )
+  {
+    this->m_NumberOfUnconvergedPoints += this->m_NumberOfUnconvergedPointsPerThread[ i ];
+  }
+
+} // end AfterThreadedGenerateData()
+
+
+/**
+ * ********************* InvertPoint ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+bool
+AdvancedTransformToInverseDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::InvertPoint( const OutputPointType & y, InputPointType & x,
+  const double squaredTolerance, const double differenceStep ) const
+{
+  const TransformType * transform = this->GetTransform();
+
+  OutputPointType tx = transform->TransformPoint( x );
+  InputVectorType residual;
+  double          squaredError = 0.0;
+  for( unsigned int j = 0; j < ImageDimension; j++ )
+  {
+    residual[ j ]  = tx[ j ] - y[ j ];
+    squaredError  += residual[ j ] * residual[ j ];
+  }
+
+  SpatialJacobianType sj;
+  for( unsigned int iteration = 0; iteration < this->m_MaximumNumberOfIterations; ++iteration )
+  {
+    if( squaredError <= squaredTolerance ) { return true; }
+
+    /** The spatial Jacobian at x, or its forward difference approximation. */
+    if( this->m_UseSpatialJacobian )
+    {
+      transform->GetSpatialJacobian( x, sj );
+    }
+    else
+    {
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+        InputPointType xd = x;
+        xd[ d ] += differenceStep;
+        const OutputPointType txd = transform->TransformPoint( xd );
+        for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+          sj[ j ][ d ] = ( txd[ j ] - tx[ j ] ) / differenceStep;
+        }
+      }
+    }
+
+    /** The Newton step, or the fixed point step if the Jacobian is singular. */
+    InputVectorType step = residual;
+    const double    det  = vnl_det( sj.GetVnlMatrix() );
+    if( std::abs( det ) > 1e-6 )
+    {
+      const typename SpatialJacobianType::InternalMatrixType inverse = vnl_inverse( sj.GetVnlMatrix() );
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+        step[ j ] = 0.0;
+        for( unsigned int k = 0; k < ImageDimension; k++ )
+        {
+          step[ j ] += inverse( j, k ) * residual[ k ];
+        }
+      }
+    }
+
+    /** Halve the step until the residual decreases. */
+    bool decreased = false;
+    for( unsigned int halving = 0; halving < 10 && !decreased; ++halving )
+    {
+      InputPointType xn;
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+        xn[ j ] = x[ j ] - step[ j ];
+      }
+      const OutputPointType txn = transform->TransformPoint( xn );
+      double                newSquaredError = 0.0;
+      InputVectorType       newResidual;
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+        newResidual[ j ]  = txn[ j ] - y[ j ];
+        newSquaredError  += newResidual[ j ] * newResidual[ j ];
+      }
+      if( newSquaredError < squaredError )
+      {
+        x            = xn;
+        tx           = txn;
+        residual     = newResidual;
+        squaredError = newSquaredError;
+        decreased    = true;
+      }
+      else
+      {
+        step *= 0.5;
+      }
+    }
+    if( !decreased ) { break; }
+  }
+
+  return squaredError <= squaredTolerance;
+
+} // end InvertPoint()
+
+
+/**
+ * ********************* ThreadedGenerateData ****************************
+ */
+
+template< class TOutputImage, class TTransformPrecisionType >
+void
+AdvancedTransformToInverseDisplacementFieldSource< TOutputImage, TTransformPrecisionType >
+::ThreadedGenerateData(
+  const OutputImageRegionType & outputRegionForThread,
+  ThreadIdType threadId )
+{
+  OutputImagePointer outputPtr = this->GetOutput();
+
+  ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
+
+  /** The tolerance and the finite difference step, in physical units. */
+  double minimumSpacing = outputPtr->GetSpacing()[ 0 ];
+  for( unsigned int j = 1; j < ImageDimension; j++ )
+  {
+    minimumSpacing = std::min( minimumSpacing, static_cast< double >( outputPtr->GetSpacing()[ j ] ) );
+  }
+  const double tolerance        = this->m_Tolerance * minimumSpacing;
+  const double squaredTolerance = tolerance * tolerance;
+  const double differenceStep   = 0.01 * minimumSpacing;
+
+  /** The physical step between two voxels of a scanline. */
+  IndexType index = outputRegionForThread.GetIndex();
+  PointType point;
+  PointType nextPoint;
+  outputPtr->TransformIndexToPhysicalPoint( index, point );
+  ++index[ 0 ];
+  outputPtr->TransformIndexToPhysicalPoint( index, nextPoint );
+  InputVectorType step;
+  for( unsigned int j = 0; j < ImageDimension; j++ )
+  {
+    step[ j ] = nextPoint[ j ] - point[ j ];
+  }
+
+  SizeValueType   numberOfUnconvergedPoints = 0;
+  OutputPointType y;
+  InputPointType  x;
+  PixelType       displacement;
+
+  ImageScanlineIterator< OutputImageType > it( outputPtr, outputRegionForThread );
+  while( !it.IsAtEnd() )
+  {
+    /** Start each scanline at the point itself, and the next voxels at the
+     * solution of the previous voxel, moved by one voxel.
+     */
+    bool previousConverged = false;
+    while( !it.IsAtEndOfLine() )
+    {
+      outputPtr->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+        y[ j ] = point[ j ];
+        x[ j ] = previousConverged ? x[ j ] + step[ j ] : point[ j ];
+      }
+
+      previousConverged = this->InvertPoint( y, x, squaredTolerance, differenceStep );
+      if( !previousConverged ) { ++numberOfUnconvergedPoints; }
+
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+      {
+        displacement[ j ] = static_cast< PixelValueType >( x[ j ] - y[ j ] );
+      }
+      it.Set( displacement );
+      progress.CompletedPixel();
+      ++it;
+    }
+    it.NextLine();
+  }
+
+  this->m_NumberOfUnconvergedPointsPerThread[ threadId ] = numberOfUnconvergedPoints;
+
+} // end ThreadedGenerateData()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkAdvancedTransformToInverseDisplacementFieldSource_hxx
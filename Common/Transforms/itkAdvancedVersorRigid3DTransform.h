@@ -106,6 +106,9 @@ public:
   typedef typename Superclass::OffsetType        OffsetType;
   typedef typename Superclass::TranslationType   TranslationType;
 
+  typedef typename Superclass::DerivativeType          DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
+
   /** Versor type. */
   typedef typename Superclass::VersorType VersorType;
   typedef typename Superclass::AxisType   AxisType;
@@ -135,6 +138,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
 protected:
 
   AdvancedVersorRigid3DTransform( unsigned int outputSpaceDim,
@@ -144,6 +156,8 @@ protected:
   AdvancedVersorRigid3DTransform();
   ~AdvancedVersorRigid3DTransform(){}
 
+  typedef typename Superclass::VersorJacobianType VersorJacobianType;
+
   void PrintSelf( std::ostream & os, Indent indent ) const override;
 
   /** This method must be made protected here because it is not a safe way of
@@ -142,66 +142,29 @@ const typename AdvancedVersorRigid3DTransform< TScalarType >::ParametersType
   return this->m_Parameters;
 }
 
-// Set parameters
+// Compute the Jacobian
 template< class TScalarType >
 void
 AdvancedVersorRigid3DTransform< TScalarType >::GetJacobian( const InputPointType & p,
   JacobianType & j,
   NonZeroJacobianIndicesType & nzji ) const
 {
-  typedef typename VersorType::ValueType ValueType;
-
   // Initialize the Jacobian. Resizing is only performed when needed.
   // Filling with zeros is needed because the lower loops only visit
   // the nonzero positions.
   j.SetSize( OutputSpaceDimension, ParametersDimension );
   j.Fill( 0.0 );
 
-  // compute derivatives with respect to rotation
-  const ValueType vx = this->GetVersor().GetX();
-  const ValueType vy = this->GetVersor().GetY();
-  const ValueType vz = this->GetVersor().GetZ();
-  const ValueType vw = this->GetVersor().GetW();
-
-  const double px = p[ 0 ] - this->GetCenter()[ 0 ];
-  const double py = p[ 1 ] - this->GetCenter()[ 1 ];
-  const double pz = p[ 2 ] - this->GetCenter()[ 2 ];
-
-  const double vxx = vx * vx;
-  const double vyy = vy * vy;
-  const double vzz = vz * vz;
-  const double vww = vw * vw;
-
-  const double vxy = vx * vy;
-  const double vxz = vx * vz;
-  const double vxw = vx * vw;
-
-  const double vyz = vy * vz;
-  const double vyw = vy * vw;
-
-  const double vzw = vz * vw;
-
   // compute Jacobian with respect to quaternion parameters
-  j[ 0 ][ 0 ] = 2.0 * ( ( vyw + vxz ) * py + ( vzw - vxy ) * pz )
-    / vw;
-  j[ 1 ][ 0 ] = 2.0 * ( ( vyw - vxz ) * px   - 2 * vxw   * py + ( vxx - vww ) * pz )
-    / vw;
-  j[ 2 ][ 0 ] = 2.0 * ( ( vzw + vxy ) * px + ( vww - vxx ) * py   - 2 * vxw   * pz )
-    / vw;
-
-  j[ 0 ][ 1 ] = 2.0 * ( -2 * vyw  * px + ( vxw + vyz ) * py + ( vww - vyy ) * pz )
-    / vw;
-  j[ 1 ][ 1 ] = 2.0 * ( ( vxw - vyz ) * px                + ( vzw + vxy ) * pz )
-    / vw;
-  j[ 2 ][ 1 ] = 2.0 * ( ( vyy - vww ) * px + ( vzw - vxy ) * py   - 2 * vyw   * pz )
-    / vw;
-
-  j[ 0 ][ 2 ] = 2.0 * ( -2 * vzw  * px + ( vzz - vww ) * py + ( vxw - vyz ) * pz )
-    / vw;
-  j[ 1 ][ 2 ] = 2.0 * ( ( vww - vzz ) * px   - 2 * vzw   * py + ( vyw + vxz ) * pz )
-    / vw;
-  j[ 2 ][ 2 ] = 2.0 * ( ( vxw + vyz ) * px + ( vyw - vxz ) * py )
-    / vw;
+  VersorJacobianType jv;
+  this->ComputeVersorJacobian( p, jv );
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    for( unsigned int mu = 0; mu < 3; ++mu )
+    {
+      j[ i ][ mu ] = jv[ i ][ mu ];
+    }
+  }
 
   j[ 0 ][ 3 ] = 1.0;
   j[ 1 ][ 4 ] = 1.0;
@@ -212,6 +175,31 @@ AdvancedVersorRigid3DTransform< TScalarType >::GetJacobian( const InputPointType
 }
 
 
+// Compute the inner product of the Jacobian with the moving image gradient
+template< class TScalarType >
+void
+AdvancedVersorRigid3DTransform< TScalarType >::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  VersorJacobianType jv;
+  this->ComputeVersorJacobian( p, jv );
+  for( unsigned int mu = 0; mu < 3; ++mu )
+  {
+    imageJacobian[ mu ] = movingImageGradient[ 0 ] * jv[ 0 ][ mu ]
+      + movingImageGradient[ 1 ] * jv[ 1 ][ mu ]
+      + movingImageGradient[ 2 ] * jv[ 2 ][ mu ];
+  }
+
+  this->EvaluateTranslationWithImageGradientProduct( movingImageGradient, 3, imageJacobian );
+
+  // Copy the constant nonZeroJacobianIndices
+  nzji = this->m_NonZeroJacobianIndices;
+}
+
+
 // Print self
 template< class TScalarType >
 void
@@ -117,6 +117,9 @@ public:
     ::JacobianOfSpatialHessianType JacobianOfSpatialHessianType;
   typedef typename Superclass::InternalMatrixType InternalMatrixType;
 
+  typedef typename Superclass::DerivativeType          DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
+
   /** VnlQuaternion Type */
   typedef vnl_quaternion< TScalarType > VnlQuaternionType;
 
@@ -154,6 +157,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
 protected:
 
   /** Construct an AdvancedVersorTransform object */
@@ -173,6 +185,13 @@ protected:
   void SetVarVersor( const VersorType & newVersor )
   { m_Versor = newVersor; }
 
+  /** The derivatives of the transformed point with respect to the three
+   * versor parameters, stored as the columns of a 3x3 matrix.
+   */
+  typedef Matrix< double, 3, 3 > VersorJacobianType;
+  void ComputeVersorJacobian( const InputPointType & p,
+    VersorJacobianType & jv ) const;
+
   /** Print contents of a AdvancedVersorTransform */
   void PrintSelf( std::ostream & os, Indent indent ) const override;
 
@@ -193,21 +193,14 @@ AdvancedVersorTransform< TScalarType >
 }
 
 
-/** Get the Jacobian */
+/** Compute the derivatives with respect to the versor parameters */
 template< class TScalarType >
 void
-AdvancedVersorTransform< TScalarType >::GetJacobian( const InputPointType & p,
-  JacobianType & j,
-  NonZeroJacobianIndicesType & nzji ) const
+AdvancedVersorTransform< TScalarType >::ComputeVersorJacobian( const InputPointType & p,
+  VersorJacobianType & jv ) const
 {
   typedef typename VersorType::ValueType ValueType;
 
-  // Initialize the Jacobian. Resizing is only performed when needed.
-  // Filling with zeros is needed because the lower loops only visit
-  // the nonzero positions.
-  j.SetSize( OutputSpaceDimension, ParametersDimension );
-  j.Fill( 0.0 );
-
   // compute derivatives with respect to rotation
   const ValueType vx = m_Versor.GetX();
   const ValueType vy = m_Versor.GetY();
@@ -233,26 +226,74 @@ AdvancedVersorTransform< TScalarType >::GetJacobian( const InputPointType & p,
   const double vzw = vz * vw;
 
   // compute Jacobian with respect to quaternion parameters
-  j[ 0 ][ 0 ] = 2.0 * ( ( vyw + vxz ) * py + ( vzw - vxy ) * pz )
+  jv[ 0 ][ 0 ] = 2.0 * ( ( vyw + vxz ) * py + ( vzw - vxy ) * pz )
     / vw;
-  j[ 1 ][ 0 ] = 2.0 * ( ( vyw - vxz ) * px   - 2 * vxw   * py + ( vxx - vww ) * pz )
+  jv[ 1 ][ 0 ] = 2.0 * ( ( vyw - vxz ) * px   - 2 * vxw   * py + ( vxx - vww ) * pz )
     / vw;
-  j[ 2 ][ 0 ] = 2.0 * ( ( vzw + vxy ) * px + ( vww - vxx ) * py   - 2 * vxw   * pz )
+  jv[ 2 ][ 0 ] = 2.0 * ( ( vzw + vxy ) * px + ( vww - vxx ) * py   - 2 * vxw   * pz )
     / vw;
 
-  j[ 0 ][ 1 ] = 2.0 * ( -2 * vyw  * px + ( vxw + vyz ) * py + ( vww - vyy ) * pz )
+  jv[ 0 ][ 1 ] = 2.0 * ( -2 * vyw  * px + ( vxw + vyz ) * py + ( vww - vyy ) * pz )
     / vw;
-  j[ 1 ][ 1 ] = 2.0 * ( ( vxw - vyz ) * px                + ( vzw + vxy ) * pz )
+  jv[ 1 ][ 1 ] = 2.0 * ( ( vxw - vyz ) * px                + ( vzw + vxy ) * pz )
     / vw;
-  j[ 2 ][ 1 ] = 2.0 * ( ( vyy - vww ) * px + ( vzw - vxy ) * py   - 2 * vyw   * pz )
+  jv[ 2 ][ 1 ] = 2.0 * ( ( vyy - vww ) * px + ( vzw - vxy ) * py   - 2 * vyw   * pz )
     / vw;
 
-  j[ 0 ][ 2 ] = 2.0 * ( -2 * vzw  * px + ( vzz - vww ) * py + ( vxw - vyz ) * pz )
+  jv[ 0 ][ 2 ] = 2.0 * ( -2 * vzw  * px + ( vzz - vww ) * py + ( vxw - vyz ) * pz )
     / vw;
-  j[ 1 ][ 2 ] = 2.0 * ( ( vww - vzz ) * px   - 2 * vzw   * py + ( vyw + vxz ) * pz )
+  jv[ 1 ][ 2 ] = 2.0 * ( ( vww - vzz ) * px   - 2 * vzw   * py + ( vyw + vxz ) * pz )
     / vw;
-  j[ 2 ][ 2 ] = 2.0 * ( ( vxw + vyz ) * px + ( vyw - vxz ) * py )
+  jv[ 2 ][ 2 ] = 2.0 * ( ( vxw + vyz ) * px + ( vyw - vxz ) * py )
     / vw;
+}
+
+
+/** Get the Jacobian */
+template< class TScalarType >
+void
+AdvancedVersorTransform< TScalarType >::GetJacobian( const InputPointType & p,
+  JacobianType & j,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  // Initialize the Jacobian. Resizing is only performed when needed.
+  // Filling with zeros is needed because the lower loops only visit
+  // the nonzero positions.
+  j.SetSize( OutputSpaceDimension, ParametersDimension );
+  j.Fill( 0.0 );
+
+  VersorJacobianType jv;
+  this->ComputeVersorJacobian( p, jv );
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    for( unsigned int mu = 0; mu < 3; ++mu )
+    {
+      j[ i ][ mu ] = jv[ i ][ mu ];
+    }
+  }
+
+  // Copy the constant nonZeroJacobianIndices
+  nzji = this->m_NonZeroJacobianIndices;
+}
+
+
+/** Compute the inner product of the Jacobian with the moving image gradient */
+template< class TScalarType >
+void
+AdvancedVersorTransform< TScalarType >::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  VersorJacobianType jv;
+  this->ComputeVersorJacobian( p, jv );
+  for( unsigned int mu = 0; mu < 3; ++mu )
+  {
+    imageJacobian[ mu ] = movingImageGradient[ 0 ] * jv[ 0 ][ mu ]
+      + movingImageGradient[ 1 ] * jv[ 1 ][ mu ]
+      + movingImageGradient[ 2 ] * jv[ 2 ][ mu ];
+  }
 
   // Copy the constant nonZeroJacobianIndices
   nzji = this->m_NonZeroJacobianIndices;
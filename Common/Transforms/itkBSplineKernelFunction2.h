@@ -94,6 +94,21 @@ public:
   }
 
 
+  /** Evaluate the function at the entire support, for a block of points.
+   * The weights of point i are stored at weights[ i * ( SplineOrder + 1 ) ].
+   * Contrary to the virtual Evaluate(), this function is resolved at compile time,
+   * so that the loop can be inlined and vectorized by the compiler.
+   */
+  inline void EvaluateBlock( const double * u, double * weights, const unsigned int n ) const
+  {
+    Dispatch< VSplineOrder > dispatch;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+      this->Evaluate( dispatch, u[ i ], weights + i * ( SplineOrder + 1 ) );
+    }
+  }
+
+
 protected:
 
   BSplineKernelFunction2(){}
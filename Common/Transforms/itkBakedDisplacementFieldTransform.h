@@ -0,0 +1,272 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBakedDisplacementFieldTransform_h
+#define __itkBakedDisplacementFieldTransform_h
+
+#include "itkAdvancedTransform.h"
+#include "itkImage.h"
+#include "itkPersistentThreadPool.h"
+#include "itkVector.h"
+
+namespace itk
+{
+
+/** \class BakedDisplacementFieldTransform
+ *
+ * \brief Replaces a fixed transform by a displacement field, sampled on a grid.
+ *
+ * A chain of initial transforms is evaluated for every sample of every
+ * iteration, and for every voxel when resampling, although it does not
+ * change. This transform samples such a transform once on a grid, using the
+ * PersistentThreadPool, and afterwards computes TransformPoint() by linear
+ * interpolation of the displacements. Its cost is independent of the length
+ * of the chain.
+ *
+ * The interpolation is an approximation, whose error decreases with the grid
+ * spacing. Points outside the grid are transformed by the original transform.
+ * The spatial derivatives are computed by the original transform as well, so
+ * they are exact. This transform has no parameters: it is meant to be used as
+ * an initial transform that is not optimized.
+ *
+ * \ingroup Transforms
+ */
+
+template< class TScalarType, unsigned int NDimensions = 3 >
+class BakedDisplacementFieldTransform :
+  public AdvancedTransform< TScalarType, NDimensions, NDimensions >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef BakedDisplacementFieldTransform                            Self;
+  typedef AdvancedTransform< TScalarType, NDimensions, NDimensions > Superclass;
+  typedef SmartPointer< Self >                                       Pointer;
+  typedef SmartPointer< const Self >                                 ConstPointer;
+
+  /** New macro for creation of through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( BakedDisplacementFieldTransform, AdvancedTransform );
+
+  /** Dimension of the domain spaces. */
+  itkStaticConstMacro( SpaceDimension, unsigned int, NDimensions );
+
+  /** Superclass typedefs. */
+  typedef typename Superclass::ScalarType                    ScalarType;
+  typedef typename Superclass::ParametersType                ParametersType;
+  typedef typename Superclass::DerivativeType                DerivativeType;
+  typedef typename Superclass::JacobianType                  JacobianType;
+  typedef typename Superclass::InputVectorType               InputVectorType;
+  typedef typename Superclass::OutputVectorType              OutputVectorType;
+  typedef typename Superclass::InputCovariantVectorType      InputCovariantVectorType;
+  typedef typename Superclass::OutputCovariantVectorType     OutputCovariantVectorType;
+  typedef typename Superclass::InputVnlVectorType            InputVnlVectorType;
+  typedef typename Superclass::OutputVnlVectorType           OutputVnlVectorType;
+  typedef typename Superclass::InputPointType                InputPointType;
+  typedef typename Superclass::OutputPointType               OutputPointType;
+  typedef typename Superclass::MovingImageGradientType       MovingImageGradientType;
+  typedef typename Superclass::NonZeroJacobianIndicesType    NonZeroJacobianIndicesType;
+  typedef typename Superclass::SpatialJacobianType           SpatialJacobianType;
+  typedef typename Superclass::JacobianOfSpatialJacobianType JacobianOfSpatialJacobianType;
+  typedef typename Superclass::SpatialHessianType            SpatialHessianType;
+  typedef typename Superclass::JacobianOfSpatialHessianType  JacobianOfSpatialHessianType;
+  typedef typename Superclass::TransformCategoryType         TransformCategoryType;
+
+  /** The transform that is sampled. */
+  typedef Superclass                        BakedTransformType;
+  typedef typename Superclass::ConstPointer BakedTransformConstPointer;
+
+  /** The displacements are stored in single precision, to save memory. */
+  typedef Vector< float, NDimensions >                  DisplacementType;
+  typedef Image< DisplacementType, NDimensions >        DisplacementFieldType;
+  typedef typename DisplacementFieldType::Pointer       DisplacementFieldPointer;
+  typedef typename DisplacementFieldType::SizeType      GridSizeType;
+  typedef typename DisplacementFieldType::SpacingType   GridSpacingType;
+  typedef typename DisplacementFieldType::PointType     GridOriginType;
+  typedef typename DisplacementFieldType::DirectionType GridDirectionType;
+
+  /** Set/Get the transform that is sampled. */
+  virtual void SetBakedTransform( const BakedTransformType * _arg );
+
+  itkGetConstObjectMacro( BakedTransform, BakedTransformType );
+
+  /** Set/Get the grid on which the displacements are sampled. */
+  itkSetMacro( GridSize, GridSizeType );
+  itkGetConstReferenceMacro( GridSize, GridSizeType );
+  itkSetMacro( GridSpacing, GridSpacingType );
+  itkGetConstReferenceMacro( GridSpacing, GridSpacingType );
+  itkSetMacro( GridOrigin, GridOriginType );
+  itkGetConstReferenceMacro( GridOrigin, GridOriginType );
+  itkSetMacro( GridDirection, GridDirectionType );
+  itkGetConstReferenceMacro( GridDirection, GridDirectionType );
+
+  /** Sample the displacements of the baked transform on the grid. Should be
+   * called after the baked transform and the grid are set.
+   */
+  virtual void ComputeDisplacementField( void );
+
+  /** Get the sampled displacements. */
+  itkGetConstObjectMacro( DisplacementField, DisplacementFieldType );
+
+  /** Transform a point, by interpolating the displacement field inside the
+   * grid, and by the baked transform outside of it.
+   */
+  OutputPointType TransformPoint( const InputPointType & point ) const override;
+
+  /** These vector transforms are not implemented for this transform. */
+  OutputVectorType TransformVector( const InputVectorType & ) const override
+  {
+    itkExceptionMacro( << "TransformVector(const InputVectorType &) is not implemented "
+                       << "for BakedDisplacementFieldTransform" );
+  }
+
+
+  OutputVnlVectorType TransformVector( const InputVnlVectorType & ) const override
+  {
+    itkExceptionMacro( << "TransformVector(const InputVnlVectorType &) is not implemented "
+                       << "for BakedDisplacementFieldTransform" );
+  }
+
+
+  OutputCovariantVectorType TransformCovariantVector( const InputCovariantVectorType & ) const override
+  {
+    itkExceptionMacro( << "TransformCovariantVector(const InputCovariantVectorType &) is not implemented "
+                       << "for BakedDisplacementFieldTransform" );
+  }
+
+
+  /** Setting the parameters is not supported, since there are none. */
+  void SetParameters( const ParametersType & ) override
+  {
+    itkExceptionMacro( << "ERROR: SetParameters() is not implemented "
+                       << "for BakedDisplacementFieldTransform.\n"
+                       << "Use SetBakedTransform() and ComputeDisplacementField() instead." );
+  }
+
+
+  /** This transform has no fixed parameters. */
+  void SetFixedParameters( const ParametersType & ) override {}
+
+  const ParametersType & GetFixedParameters( void ) const override
+  {
+    return this->m_FixedParameters;
+  }
+
+
+  bool IsLinear( void ) const override { return false; }
+
+  TransformCategoryType GetTransformCategory( void ) const override
+  {
+    return Self::DisplacementField;
+  }
+
+
+  /** The Jacobian is empty, since this transform has no parameters. */
+  void GetJacobian(
+    const InputPointType & ipp,
+    JacobianType & j,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
+  /** The spatial derivatives are those of the baked transform. */
+  void GetSpatialJacobian(
+    const InputPointType & ipp,
+    SpatialJacobianType & sj ) const override;
+
+  void GetSpatialHessian(
+    const InputPointType & ipp,
+    SpatialHessianType & sh ) const override;
+
+  void GetJacobianOfSpatialJacobian(
+    const InputPointType & ipp,
+    JacobianOfSpatialJacobianType & jsj,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
+  void GetJacobianOfSpatialJacobian(
+    const InputPointType & ipp,
+    SpatialJacobianType & sj,
+    JacobianOfSpatialJacobianType & jsj,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
+  void GetJacobianOfSpatialHessian(
+    const InputPointType & ipp,
+    JacobianOfSpatialHessianType & jsh,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
+  void GetJacobianOfSpatialHessian(
+    const InputPointType & ipp,
+    SpatialHessianType & sh,
+    JacobianOfSpatialHessianType & jsh,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
+protected:
+
+  BakedDisplacementFieldTransform();
+  ~BakedDisplacementFieldTransform() override {}
+
+  /** Print contents of a BakedDisplacementFieldTransform. */
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** The data passed to the threads by ComputeDisplacementField(). */
+  struct BakeThreaderParameterType
+  {
+    const Self *  m_Transform;
+    SizeValueType m_NumberOfRows;
+    SizeValueType m_RowsPerWorkUnit;
+  };
+
+  /** Sample a range of rows of the grid. */
+  static ITK_THREAD_RETURN_TYPE BakeThreaderCallback( void * arg );
+
+  /** Sample the rows [begin, end) of the grid. */
+  void ComputeDisplacementFieldRows( const SizeValueType begin, const SizeValueType end ) const;
+
+private:
+
+  BakedDisplacementFieldTransform( const Self & ); // purposely not implemented
+  void operator=( const Self & );                  // purposely not implemented
+
+  BakedTransformConstPointer m_BakedTransform;
+  DisplacementFieldPointer   m_DisplacementField;
+
+  GridSizeType      m_GridSize;
+  GridSpacingType   m_GridSpacing;
+  GridOriginType    m_GridOrigin;
+  GridDirectionType m_GridDirection;
+
+  /** The mapping from a physical point to a continuous grid index, and the
+   * offsets of the neighbours in the buffer, cached for TransformPoint().
+   */
+  GridDirectionType                          m_PhysicalPointToIndex;
+  FixedArray< OffsetValueType, NDimensions > m_NeighbourOffsets;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkBakedDisplacementFieldTransform.hxx"
+#endif
+
+#endif // end #ifndef __itkBakedDisplacementFieldTransform_h
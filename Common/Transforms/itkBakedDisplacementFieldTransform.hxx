@@ -0,0 +1,447 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBakedDisplacementFieldTransform_hxx
+#define __itkBakedDisplacementFieldTransform_hxx
+
+#include "itkBakedDisplacementFieldTransform.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace itk
+{
+
+/**
+ * ********************* Constructor ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::BakedDisplacementFieldTransform() : Superclass( 0 )
+{
+  this->m_GridSize.Fill( 0 );
+  this->m_GridSpacing.Fill( 1.0 );
+  this->m_GridOrigin.Fill( 0.0 );
+  this->m_GridDirection.SetIdentity();
+  this->m_PhysicalPointToIndex.SetIdentity();
+  this->m_NeighbourOffsets.Fill( 0 );
+
+} // end Constructor
+
+
+/**
+ * ********************* SetBakedTransform ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::SetBakedTransform( const BakedTransformType * _arg )
+{
+  if( this->m_BakedTransform != _arg )
+  {
+    this->m_BakedTransform = _arg;
+    if( _arg )
+    {
+      this->m_HasNonZeroSpatialHessian           = _arg->GetHasNonZeroSpatialHessian();
+      this->m_HasNonZeroJacobianOfSpatialHessian = false;
+    }
+    this->Modified();
+  }
+
+} // end SetBakedTransform()
+
+
+/**
+ * ********************* ComputeDisplacementField ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::ComputeDisplacementField( void )
+{
+  if( this->m_BakedTransform.IsNull() )
+  {
+    itkExceptionMacro( << "ERROR: The baked transform should be set before "
+                       << "the displacement field is computed." );
+  }
+
+  /** Allocate the displacement field on the grid. */
+  DisplacementFieldPointer displacementField = DisplacementFieldType::New();
+  displacementField->SetRegions( this->m_GridSize );
+  displacementField->SetSpacing( this->m_GridSpacing );
+  displacementField->SetOrigin( this->m_GridOrigin );
+  displacementField->SetDirection( this->m_GridDirection );
+  displacementField->Allocate();
+  this->m_DisplacementField = displacementField;
+
+  /** Cache what TransformPoint() needs to find the neighbours of a point. */
+  this->m_PhysicalPointToIndex = displacementField->GetPhysicalPointToIndex();
+  OffsetValueType offset = 1;
+  for( unsigned int d = 0; d < NDimensions; ++d )
+  {
+    this->m_NeighbourOffsets[ d ] = offset;
+    offset                       *= static_cast< OffsetValueType >( this->m_GridSize[ d ] );
+  }
+
+  /** Sample the rows of the grid in parallel. */
+  const SizeValueType rowLength      = this->m_GridSize[ 0 ];
+  const SizeValueType numberOfPixels = displacementField->GetLargestPossibleRegion().GetNumberOfPixels();
+  const SizeValueType numberOfRows   = rowLength > 0 ? numberOfPixels / rowLength : 0;
+
+  const ThreadIdType numberOfWorkUnits = static_cast< ThreadIdType >( std::min< SizeValueType >(
+    numberOfRows, PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() ) );
+
+  BakeThreaderParameterType temp;
+  temp.m_Transform       = this;
+  temp.m_NumberOfRows    = numberOfRows;
+  temp.m_RowsPerWorkUnit = numberOfWorkUnits > 0
+    ? ( numberOfRows + numberOfWorkUnits - 1 ) / numberOfWorkUnits : 0;
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    numberOfWorkUnits, Self::BakeThreaderCallback, &temp );
+
+  this->Modified();
+
+} // end ComputeDisplacementField()
+
+
+/**
+ * ********************* BakeThreaderCallback ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+ITK_THREAD_RETURN_TYPE
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::BakeThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const BakeThreaderParameterType * temp
+    = static_cast< BakeThreaderParameterType * >( infoStruct->UserData );
+
+  const SizeValueType begin = std::min(
+    infoStruct->WorkUnitID * temp->m_RowsPerWorkUnit, temp->m_NumberOfRows );
+  const SizeValueType end = std::min( begin + temp->m_RowsPerWorkUnit, temp->m_NumberOfRows );
+  temp->m_Transform->ComputeDisplacementFieldRows( begin, end );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end BakeThreaderCallback()
+
+
+/**
+ * ********************* ComputeDisplacementFieldRows ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::ComputeDisplacementFieldRows( const SizeValueType begin, const SizeValueType end ) const
+{
+  const SizeValueType            rowLength = this->m_GridSize[ 0 ];
+  std::vector< InputPointType >  inputPoints( rowLength );
+  std::vector< OutputPointType > outputPoints( rowLength );
+  DisplacementType *             buffer = this->m_DisplacementField->GetBufferPointer();
+
+  typename DisplacementFieldType::IndexType index;
+  for( SizeValueType row = begin; row < end; ++row )
+  {
+    /** Compute the index of the first pixel of the row. */
+    SizeValueType rest = row;
+    index[ 0 ] = 0;
+    for( unsigned int d = 1; d < NDimensions; ++d )
+    {
+      index[ d ] = static_cast< IndexValueType >( rest % this->m_GridSize[ d ] );
+      rest      /= this->m_GridSize[ d ];
+    }
+
+    /** Transform the whole row at once. */
+    for( SizeValueType i = 0; i < rowLength; ++i )
+    {
+      index[ 0 ] = static_cast< IndexValueType >( i );
+      this->m_DisplacementField->TransformIndexToPhysicalPoint( index, inputPoints[ i ] );
+    }
+    this->m_BakedTransform->TransformPoints( inputPoints.data(), outputPoints.data(), rowLength );
+
+    DisplacementType * rowBuffer = buffer + row * rowLength;
+    for( SizeValueType i = 0; i < rowLength; ++i )
+    {
+      for( unsigned int d = 0; d < NDimensions; ++d )
+      {
+        rowBuffer[ i ][ d ] = static_cast< float >( outputPoints[ i ][ d ] - inputPoints[ i ][ d ] );
+      }
+    }
+  }
+
+} // end ComputeDisplacementFieldRows()
+
+
+/**
+ * ********************* TransformPoint ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+typename BakedDisplacementFieldTransform< TScalarType, NDimensions >::OutputPointType
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::TransformPoint( const InputPointType & point ) const
+{
+  if( this->m_DisplacementField.IsNull() )
+  {
+    return this->m_BakedTransform->TransformPoint( point );
+  }
+
+  /** Compute the continuous index of the point, and the index of the
+   * neighbour with the lowest index. Points outside the grid are
+   * transformed by the baked transform.
+   */
+  const GridOriginType & origin = this->m_DisplacementField->GetOrigin();
+  double                 fraction[ NDimensions ];
+  OffsetValueType        offset = 0;
+  for( unsigned int d = 0; d < NDimensions; ++d )
+  {
+    double cindex = 0.0;
+    for( unsigned int e = 0; e < NDimensions; ++e )
+    {
+      cindex += this->m_PhysicalPointToIndex[ d ][ e ] * ( point[ e ] - origin[ e ] );
+    }
+
+    const double upper = static_cast< double >( this->m_GridSize[ d ] ) - 1.0;
+    if( !( cindex >= 0.0 && cindex <= upper ) )
+    {
+      return this->m_BakedTransform->TransformPoint( point );
+    }
+
+    /** On the upper border the fraction is one, so the neighbour exists. */
+    OffsetValueType lower = static_cast< OffsetValueType >( cindex );
+    if( lower > 0 && static_cast< double >( lower ) == upper )
+    {
+      --lower;
+    }
+    fraction[ d ] = cindex - static_cast< double >( lower );
+    offset       += lower * this->m_NeighbourOffsets[ d ];
+  }
+
+  /** Linearly interpolate the displacements of the 2^N neighbours. Neighbours
+   * with a zero weight are skipped, which also avoids reading outside a grid
+   * that has a size of one.
+   */
+  const DisplacementType * displacements = this->m_DisplacementField->GetBufferPointer() + offset;
+  OutputPointType          outputPoint   = point;
+  for( unsigned int corner = 0; corner < ( 1u << NDimensions ); ++corner )
+  {
+    double          weight          = 1.0;
+    OffsetValueType neighbourOffset = 0;
+    for( unsigned int d = 0; d < NDimensions; ++d )
+    {
+      if( corner & ( 1u << d ) )
+      {
+        weight          *= fraction[ d ];
+        neighbourOffset += this->m_NeighbourOffsets[ d ];
+      }
+      else
+      {
+        weight *= 1.0 - fraction[ d ];
+      }
+    }
+
+    if( weight != 0.0 )
+    {
+      const DisplacementType & displacement = displacements[ neighbourOffset ];
+      for( unsigned int d = 0; d < NDimensions; ++d )
+      {
+        outputPoint[ d ] += weight * displacement[ d ];
+      }
+    }
+  }
+
+  return outputPoint;
+
+} // end TransformPoint()
+
+
+/**
+ * ********************* GetJacobian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetJacobian(
+  const InputPointType &,
+  JacobianType & j,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  j.SetSize( NDimensions, 0 );
+  nonZeroJacobianIndices.clear();
+
+} // end GetJacobian()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType &,
+  const MovingImageGradientType &,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  imageJacobian.SetSize( 0 );
+  nonZeroJacobianIndices.clear();
+
+} // end EvaluateJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* GetSpatialJacobian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetSpatialJacobian(
+  const InputPointType & ipp,
+  SpatialJacobianType & sj ) const
+{
+  this->m_BakedTransform->GetSpatialJacobian( ipp, sj );
+
+} // end GetSpatialJacobian()
+
+
+/**
+ * ********************* GetSpatialHessian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetSpatialHessian(
+  const InputPointType & ipp,
+  SpatialHessianType & sh ) const
+{
+  this->m_BakedTransform->GetSpatialHessian( ipp, sh );
+
+} // end GetSpatialHessian()
+
+
+/**
+ * ********************* GetJacobianOfSpatialJacobian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetJacobianOfSpatialJacobian(
+  const InputPointType &,
+  JacobianOfSpatialJacobianType & jsj,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  jsj.clear();
+  nonZeroJacobianIndices.clear();
+
+} // end GetJacobianOfSpatialJacobian()
+
+
+/**
+ * ********************* GetJacobianOfSpatialJacobian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetJacobianOfSpatialJacobian(
+  const InputPointType & ipp,
+  SpatialJacobianType & sj,
+  JacobianOfSpatialJacobianType & jsj,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  this->m_BakedTransform->GetSpatialJacobian( ipp, sj );
+  jsj.clear();
+  nonZeroJacobianIndices.clear();
+
+} // end GetJacobianOfSpatialJacobian()
+
+
+/**
+ * ********************* GetJacobianOfSpatialHessian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetJacobianOfSpatialHessian(
+  const InputPointType &,
+  JacobianOfSpatialHessianType & jsh,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  jsh.clear();
+  nonZeroJacobianIndices.clear();
+
+} // end GetJacobianOfSpatialHessian()
+
+
+/**
+ * ********************* GetJacobianOfSpatialHessian ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::GetJacobianOfSpatialHessian(
+  const InputPointType & ipp,
+  SpatialHessianType & sh,
+  JacobianOfSpatialHessianType & jsh,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  this->m_BakedTransform->GetSpatialHessian( ipp, sh );
+  jsh.clear();
+  nonZeroJacobianIndices.clear();
+
+} // end GetJacobianOfSpatialHessian()
+
+
+/**
+ * ********************* PrintSelf ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+BakedDisplacementFieldTransform< TScalarType, NDimensions >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "BakedTransform: " << this->m_BakedTransform.GetPointer() << std::endl;
+  os << indent << "DisplacementField: " << this->m_DisplacementField.GetPointer() << std::endl;
+  os << indent << "GridSize: " << this->m_GridSize << std::endl;
+  os << indent << "GridSpacing: " << this->m_GridSpacing << std::endl;
+  os << indent << "GridOrigin: " << this->m_GridOrigin << std::endl;
+  os << indent << "GridDirection: " << this->m_GridDirection << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkBakedDisplacementFieldTransform_hxx
@@ -25,6 +25,8 @@
 #include "itkBSplineInterpolationDerivativeWeightFunction.h"
 #include "itkBSplineInterpolationSecondOrderDerivativeWeightFunction.h"
 #include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkRecursiveBSplineInterpolationWeightFunction.h"
+#include "itkRecursiveBSplineTransformImplementation.h"
 #include "itkCyclicBSplineDeformableTransform.h"
 
 namespace itk
@@ -35,6 +37,11 @@ namespace itk
  * \brief Deformable transform using a B-spline representation in which the
  *   B-spline grid is formulated in a cyclic way.
  *
+ * The grid index in the last dimension wraps around. The evaluation
+ * functions sum over the SplineOrder + 1 slices of the support region along
+ * the last dimension, at the wrapped grid index, and use the recursive
+ * implementation of the RecursiveBSplineTransform within each slice.
+ *
  * \ingroup Transforms
  */
 template<
@@ -94,6 +101,7 @@ public:
   typedef typename RegionType::IndexType       GridOffsetType;
   typedef typename Superclass::InputPointType  InputPointType;
   typedef typename Superclass::OutputPointType OutputPointType;
+  typedef typename Superclass::InputVectorType InputVectorType;
   typedef typename Superclass::WeightsType     WeightsType;
   typedef typename Superclass::
     ParameterIndexArrayType ParameterIndexArrayType;
@@ -111,10 +119,16 @@ public:
     itkGetStaticConstMacro( SplineOrder ) >     RedWeightsFunctionType;
   typedef typename RedWeightsFunctionType::
     ContinuousIndexType RedContinuousIndexType;
+  typedef RecursiveBSplineInterpolationWeightFunction< ScalarType,
+    itkGetStaticConstMacro( SpaceDimension ),
+    itkGetStaticConstMacro( SplineOrder ) >     RecursiveBSplineWeightFunctionType;
 
   /** This method specifies the region over which the grid resides. */
   void SetGridRegion( const RegionType & region ) override;
 
+  /** Transform a point, without computing the weights and indices. */
+  OutputPointType TransformPoint( const InputPointType & point ) const override;
+
   /** Transform points by a B-spline deformable transformation.
    * On return, weights contains the interpolation weights used to compute the
    * deformation and indices of the x (zeroth) dimension coefficient parameters
@@ -129,6 +143,21 @@ public:
     ParameterIndexArrayType & indices,
     bool & inside ) const override;
 
+  /** Transform a batch of points by TransformPoint(). */
+  void TransformPoints(
+    const InputPointType * inputPoints,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const override;
+
+  /** Transform the points of a scanline point by point. The column sums of
+   * the superclass do not wrap around in the last dimension.
+   */
+  void TransformScanline(
+    const InputPointType & startPoint,
+    const InputVectorType & step,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const override;
+
   /** Compute the Jacobian of the transformation. */
   virtual void GetJacobian(
     const InputPointType & ipp,
@@ -140,6 +169,15 @@ public:
     const InputPointType & ipp,
     SpatialJacobianType & sj ) const override;
 
+  /** Compute the spatial Jacobians of a scanline point by point. The column
+   * sums of the superclass do not wrap around in the last dimension.
+   */
+  void GetSpatialJacobianScanline(
+    const InputPointType & startPoint,
+    const InputVectorType & step,
+    SpatialJacobianType * sjs,
+    const SizeValueType n ) const override;
+
 protected:
 
   CyclicBSplineDeformableTransform();
@@ -149,9 +187,25 @@ protected:
     NonZeroJacobianIndicesType & nonZeroJacobianIndices,
     const RegionType & supportRegion ) const override;
 
+  /** The support region wraps around the grid in the last dimension. */
+  bool HasPeriodicSupport( void ) const override { return true; }
+
   /** Check if a continuous index is inside the valid region. */
   bool InsideValidRegion( const ContinuousIndexType & index ) const override;
 
+  /** Compute the offsets in the coefficient buffer of the first control
+   * point of the SplineOrder + 1 slices of the support region along the last
+   * dimension, in which the grid index wraps around.
+   */
+  void ComputeCyclicSliceOffsets( const IndexType & supportIndex,
+    OffsetValueType * sliceOffsets ) const;
+
+  /** Compute the buffer offsets of the control points in the support region,
+   * in the order of the B-spline weights.
+   */
+  void ComputeCyclicSupportIndices( const IndexType & supportIndex,
+    unsigned long * indices ) const;
+
   /** Split an image region into two regions based on the last dimension. */
   virtual void SplitRegion(
     const RegionType & imageRegion,
@@ -164,6 +218,9 @@ private:
   CyclicBSplineDeformableTransform( const Self & ); // purposely not implemented
   void operator=( const Self & );                   // purposely not implemented
 
+  /** The weights function of the recursive evaluation. */
+  typename RecursiveBSplineWeightFunctionType::Pointer m_RecursiveBSplineWeightFunction;
+
 };
 
 }  // namespace itk
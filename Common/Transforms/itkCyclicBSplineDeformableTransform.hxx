@@ -21,6 +21,7 @@
 #include "itkCyclicBSplineDeformableTransform.h"
 #include "itkContinuousIndex.h"
 #include "itkImageRegionIterator.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -29,7 +30,9 @@ namespace itk
 template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
 CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 ::CyclicBSplineDeformableTransform() : Superclass()
-{}
+{
+  this->m_RecursiveBSplineWeightFunction = RecursiveBSplineWeightFunctionType::New();
+}
 
 /** Destructor. */
 template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
@@ -145,6 +148,133 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 }
 
 
+/** Compute the offsets of the slices of the support region. */
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::ComputeCyclicSliceOffsets(
+  const IndexType & supportIndex,
+  OffsetValueType * sliceOffsets ) const
+{
+  const unsigned int      lastDim     = SpaceDimension - 1;
+  const OffsetValueType * offsetTable = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
+  const IndexType         gridIndex   = this->m_GridRegion.GetIndex();
+  const OffsetValueType   lastDimSize = this->m_GridRegion.GetSize( lastDim );
+
+  /** The support region lies within the grid in the other dimensions. */
+  OffsetValueType offset = 0;
+  for( unsigned int j = 0; j < lastDim; ++j )
+  {
+    offset += ( supportIndex[ j ] - gridIndex[ j ] ) * offsetTable[ j ];
+  }
+
+  /** Wrap the grid index around in the last dimension. */
+  for( unsigned int k = 0; k <= SplineOrder; ++k )
+  {
+    OffsetValueType index = ( supportIndex[ lastDim ] - gridIndex[ lastDim ] + k ) % lastDimSize;
+    if( index < 0 )
+    {
+      index += lastDimSize;
+    }
+    sliceOffsets[ k ] = offset + index * offsetTable[ lastDim ];
+  }
+}
+
+
+/** Compute the buffer offsets of the control points in the support region. */
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::ComputeCyclicSupportIndices(
+  const IndexType & supportIndex,
+  unsigned long * indices ) const
+{
+  OffsetValueType sliceOffsets[ SplineOrder + 1 ];
+  this->ComputeCyclicSliceOffsets( supportIndex, sliceOffsets );
+
+  /** Within a slice the recursive implementation visits the control points
+   * in the order of the weights, the first dimension running fastest.
+   */
+  for( unsigned int k = 0; k <= SplineOrder; ++k )
+  {
+    RecursiveBSplineTransformImplementation< 1, SpaceDimension - 1, SplineOrder, ScalarType >
+      ::ComputeNonZeroJacobianIndices( indices, 0, sliceOffsets[ k ],
+      this->m_CoefficientImages[ 0 ]->GetOffsetTable() );
+  }
+}
+
+
+/** Transform a point, without computing the weights and indices. */
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+typename CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::OutputPointType
+CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::TransformPoint( const InputPointType & point ) const
+{
+  /** Check if the coefficient image has been set. */
+  if( !this->m_CoefficientImages[ 0 ] )
+  {
+    itkWarningMacro( << "B-spline coefficients have not been set" );
+    return point;
+  }
+
+  ContinuousIndexType cindex;
+  this->TransformPointToContinuousGridIndex( point, cindex );
+
+  /** NOTE: if the support region does not lie totally within the grid
+   * (except for the last dimension, which wraps around) we assume
+   * zero displacement and return the input point.
+   */
+  if( !this->InsideValidRegion( cindex ) )
+  {
+    return point;
+  }
+
+  /** Compute the 1D weights of each dimension. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
+
+  IndexType supportIndex;
+  this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+
+  OffsetValueType sliceOffsets[ SplineOrder + 1 ];
+  this->ComputeCyclicSliceOffsets( supportIndex, sliceOffsets );
+
+  /** Sum the displacements of the slices of the support region along the
+   * last dimension, each computed recursively. The last dimension itself is
+   * not displaced.
+   */
+  const double * lastWeights = weightsArray1D + ( SpaceDimension - 1 ) * ( SplineOrder + 1 );
+  ScalarType     displacement[ SpaceDimension - 1 ];
+  ScalarType     sliceDisplacement[ SpaceDimension - 1 ];
+  ScalarType *   mu[ SpaceDimension - 1 ];
+  std::fill_n( displacement, SpaceDimension - 1, NumericTraits< ScalarType >::ZeroValue() );
+  for( unsigned int k = 0; k <= SplineOrder; ++k )
+  {
+    for( unsigned int j = 0; j < SpaceDimension - 1; ++j )
+    {
+      mu[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer() + sliceOffsets[ k ];
+    }
+    RecursiveBSplineTransformImplementation< SpaceDimension - 1, SpaceDimension - 1, SplineOrder, ScalarType >
+      ::TransformPoint( sliceDisplacement, mu, this->m_CoefficientImages[ 0 ]->GetOffsetTable(), weightsArray1D );
+
+    for( unsigned int j = 0; j < SpaceDimension - 1; ++j )
+    {
+      displacement[ j ] += sliceDisplacement[ j ] * lastWeights[ k ];
+    }
+  }
+
+  /** The output point is the start point + displacement. */
+  OutputPointType outputPoint = point;
+  for( unsigned int j = 0; j < SpaceDimension - 1; ++j )
+  {
+    outputPoint[ j ] += displacement[ j ];
+  }
+  return outputPoint;
+}
+
+
 /** Transform a point. */
 template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
 void
@@ -189,52 +319,19 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
   this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
 
-  /** For each dimension, correlate coefficient with weights. */
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  supportRegion.SetIndex( supportIndex );
-
-  /** Split support region into two parts. */
-  RegionType supportRegions[ 2 ];
-  this->SplitRegion( this->m_CoefficientImages[ 0 ]->GetLargestPossibleRegion(),
-    supportRegion, supportRegions[ 0 ], supportRegions[ 1 ] );
+  /** Compute the wrapped indices of the support region. */
+  this->ComputeCyclicSupportIndices( supportIndex, indices.data_block() );
 
-  /** Zero output point elements. */
+  /** For each dimension, correlate coefficient with weights. */
   outputPoint.Fill( NumericTraits< ScalarType >::ZeroValue() );
-
-  unsigned long counter = 0;
-  for( unsigned int r = 0; r < 2; ++r )
+  const unsigned int numberOfWeights = WeightsFunctionType::NumberOfWeights;
+  for( unsigned int j = 0; j < SpaceDimension - 1; j++ )
   {
-    /** Create iterators over the coefficient images
-     * (for both supportRegion1 and supportRegion2.
-     */
-    typedef ImageRegionConstIterator< ImageType > IteratorType;
-    IteratorType iterator[ SpaceDimension ];
-
-    const PixelType * basePointer
-      = this->m_CoefficientImages[ 0 ]->GetBufferPointer();
-
-    for( unsigned int j = 0; j < SpaceDimension - 1; j++ )
+    const PixelType * coefficients = this->m_CoefficientImages[ j ]->GetBufferPointer();
+    for( unsigned int i = 0; i < numberOfWeights; ++i )
     {
-      iterator[ j ] = IteratorType( this->m_CoefficientImages[ j ], supportRegions[ r ] );
+      outputPoint[ j ] += static_cast< ScalarType >( weights[ i ] * coefficients[ indices[ i ] ] );
     }
-
-    /** Loop over this support region. */
-    while( !iterator[ 0 ].IsAtEnd() )
-    {
-      /** Populate the indices array. */
-      indices[ counter ] = &( iterator[ 0 ].Value() ) - basePointer;
-
-      /** Multiply weigth with coefficient to compute displacement. */
-      for( unsigned int j = 0; j < SpaceDimension - 1; j++ )
-      {
-        outputPoint[ j ] += static_cast< ScalarType >(
-          weights[ counter ] * iterator[ j ].Value() );
-        ++iterator[ j ];
-      }
-      ++counter;
-
-    } // end while
   }
 
   /** The output point is the start point + displacement. */
@@ -245,23 +342,69 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 }
 
 
+/** Transform a batch of points. */
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    outputPoints[ i ] = this->Self::TransformPoint( inputPoints[ i ] );
+  }
+}
+
+
+/** Transform the points of a scanline. */
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::TransformScanline(
+  const InputPointType & startPoint,
+  const InputVectorType & step,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    outputPoints[ i ] = this->Self::TransformPoint( startPoint + step * static_cast< ScalarType >( i ) );
+  }
+}
+
+
+/** Compute the spatial Jacobians of a scanline. */
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
+::GetSpatialJacobianScanline(
+  const InputPointType & startPoint,
+  const InputVectorType & step,
+  SpatialJacobianType * sjs,
+  const SizeValueType n ) const
+{
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    this->Self::GetSpatialJacobian( startPoint + step * static_cast< ScalarType >( i ), sjs[ i ] );
+  }
+}
+
+
 /** Compute the Jacobian in one position. */
 template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
 void
 CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 ::GetJacobian( const InputPointType & point, WeightsType & weights, ParameterIndexArrayType & indexes ) const
 {
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  const PixelType * basePointer = this->m_CoefficientImages[ 0 ]->GetBufferPointer();
-
   /** Tranform from world coordinates to grid coordinates. */
   ContinuousIndexType cindex;
   this->TransformPointToContinuousGridIndex( point, cindex );
 
   /** NOTE: if the support region does not lie totally within the grid
-       * we assume zero displacement and return the input point.
-       */
+   * we assume zero displacement and return the input point.
+   */
   if( !this->InsideValidRegion( cindex ) )
   {
     weights.Fill( 0.0 );
@@ -274,28 +417,8 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
   this->m_WeightsFunction->ComputeStartIndex( cindex, supportIndex );
   this->m_WeightsFunction->Evaluate( cindex, supportIndex, weights );
 
-  supportRegion.SetIndex( supportIndex );
-  /** Split support region into two parts. */
-  RegionType supportRegions[ 2 ];
-  this->SplitRegion( this->m_CoefficientImages[ 0 ]->GetLargestPossibleRegion(),
-    supportRegion, supportRegions[ 0 ], supportRegions[ 1 ] );
-
-  /** For each dimension, copy the weight to the support region. */
-  unsigned long counter = 0;
-  typedef ImageRegionIterator< JacobianImageType > IteratorType;
-  for( unsigned int r = 0; r < 2; ++r )
-  {
-    IteratorType iterator = IteratorType( this->m_CoefficientImages[ 0 ], supportRegions[ r ] );
-
-    while( !iterator.IsAtEnd() )
-    {
-      indexes[ counter ] = &( iterator.Value() ) - basePointer;
-
-      /** Go to next coefficient in the support region. */
-      ++counter;
-      ++iterator;
-    }
-  }
+  /** Compute the wrapped indices of the support region. */
+  this->ComputeCyclicSupportIndices( supportIndex, indexes.data_block() );
 }
 
 
@@ -331,64 +454,61 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
     return;
   }
 
-  /** Compute the number of affected B-spline parameters. */
-  /** Allocate memory on the stack: */
-  const SizeValueType numberOfWeights = WeightsFunctionType::NumberOfWeights;
-  typename WeightsType::ValueType weightsArray[ numberOfWeights ];
-  WeightsType weights( weightsArray, numberOfWeights, false );
+  /** Compute the 1D weights and derivative weights of each dimension. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
+  typename WeightsType::ValueType derivativeWeightsArray1D[ numberOfWeights ];
+  WeightsType derivativeWeights1D( derivativeWeightsArray1D, numberOfWeights, false );
 
   IndexType supportIndex;
-  this->m_DerivativeWeightsFunctions[ 0 ]->ComputeStartIndex(
-    cindex, supportIndex );
-  RegionType supportRegion;
-  supportRegion.SetSize( this->m_SupportSize );
-  supportRegion.SetIndex( supportIndex );
+  this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+  this->m_RecursiveBSplineWeightFunction->EvaluateDerivative( cindex, derivativeWeights1D, supportIndex );
 
-  /** Split support region into two parts. */
-  RegionType supportRegions[ 2 ];
-  this->SplitRegion( this->m_CoefficientImages[ 0 ]->GetLargestPossibleRegion(),
-    supportRegion, supportRegions[ 0 ], supportRegions[ 1 ] );
+  OffsetValueType sliceOffsets[ SplineOrder + 1 ];
+  this->ComputeCyclicSliceOffsets( supportIndex, sliceOffsets );
 
-  sj.Fill( 0.0 );
-
-  /** Compute the spatial Jacobian sj:
-       *    dT_{dim} / dx_i = delta_{dim,i} + \sum coefs_{dim} * weights.
-       */
-  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  /** Sum the slices of the support region along the last dimension. Within
+   * a slice, the recursive implementation computes the displacement followed
+   * by its derivatives to the other dimensions. The derivative to the last
+   * dimension is accumulated here.
+   */
+  const double * lastWeights           = weightsArray1D + ( SpaceDimension - 1 ) * ( SplineOrder + 1 );
+  const double * lastDerivativeWeights = derivativeWeightsArray1D + ( SpaceDimension - 1 ) * ( SplineOrder + 1 );
+  double         spatialJacobian[ SpaceDimension * ( SpaceDimension + 1 ) ];
+  double         sliceSpatialJacobian[ SpaceDimension * SpaceDimension ];
+  std::fill_n( spatialJacobian, SpaceDimension * ( SpaceDimension + 1 ), 0.0 );
+
+  ScalarType * mu[ SpaceDimension ];
+  for( unsigned int k = 0; k <= SplineOrder; ++k )
   {
-    /** Compute the derivative weights. */
-    this->m_DerivativeWeightsFunctions[ i ]->Evaluate( cindex, supportIndex, weights );
+    for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+    {
+      mu[ dim ] = this->m_CoefficientImages[ dim ]->GetBufferPointer() + sliceOffsets[ k ];
+    }
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension - 1, SplineOrder, ScalarType >
+      ::GetSpatialJacobian( sliceSpatialJacobian, mu, this->m_CoefficientImages[ 0 ]->GetOffsetTable(),
+      weightsArray1D, derivativeWeightsArray1D );
 
-    /** Compute the spatial Jacobian sj:
-            *    dT_{dim} / dx_i = \sum coefs_{dim} * weights.
-            */
+    for( unsigned int n = 0; n < SpaceDimension * SpaceDimension; ++n )
+    {
+      spatialJacobian[ n ] += sliceSpatialJacobian[ n ] * lastWeights[ k ];
+    }
     for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
     {
-      /** Compute the sum for this dimension. */
-      double sum = 0.0;
-
-      typename WeightsType::const_iterator itWeights = weights.begin();
-
-      for( unsigned int r = 0; r < 2; ++r )
-      {
-        /** Create an iterator over the correct part of the coefficient
-                       * image. Create an iterator over the weights vector.
-                       */
-        ImageRegionConstIterator< ImageType > itCoef(
-        this->m_CoefficientImages[ dim ], supportRegions[ r ] );
-
-        while( !itCoef.IsAtEnd() )
-        {
-          sum += itCoef.Value() * ( *itWeights );
-          ++itWeights;
-          ++itCoef;
-        }
-      } // end for r
-
-      /** Update the spatial Jacobian sj. */
-      sj( dim, i ) += sum;
-    } // end for dim
-  } // end for i
+      spatialJacobian[ SpaceDimension * SpaceDimension + dim ]
+        += sliceSpatialJacobian[ dim ] * lastDerivativeWeights[ k ];
+    }
+  }
+
+  /** Copy the derivatives, skipping the displacement. */
+  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+  {
+    for( unsigned int i = 0; i < SpaceDimension; ++i )
+    {
+      sj( dim, i ) = spatialJacobian[ dim + ( i + 1 ) * SpaceDimension ];
+    }
+  }
 
   /** Take into account grid spacing and direction cosines. */
   sj = sj * this->m_PointToIndexMatrix;
@@ -415,44 +535,20 @@ CyclicBSplineDeformableTransform< TScalarType, NDimensions, VSplineOrder >
 {
   nonZeroJacobianIndices.resize( this->GetNumberOfNonZeroJacobianIndices() );
 
-  /** Split support region into two parts. */
-  RegionType supportRegions[ 2 ];
-  this->SplitRegion( this->m_CoefficientImages[ 0 ]->GetLargestPossibleRegion(),
-    supportRegion, supportRegions[ 0 ], supportRegions[ 1 ] );
+  OffsetValueType sliceOffsets[ SplineOrder + 1 ];
+  this->ComputeCyclicSliceOffsets( supportRegion.GetIndex(), sliceOffsets );
 
-  /** Initialize some helper variables. */
-  const SizeValueType numberOfWeights = WeightsFunctionType::NumberOfWeights;
-  const SizeValueType parametersPerDim
-    = this->GetNumberOfParametersPerDimension();
-  unsigned long mu = 0;
-
-  for( unsigned int r = 0; r < 2; ++r )
+  /** For all control points in the support region, set which of the
+   * indices in the parameter array are non-zero.
+   */
+  const unsigned long parametersPerDim = this->GetNumberOfParametersPerDimension();
+  unsigned long *     nzji             = &nonZeroJacobianIndices[ 0 ];
+  for( unsigned int k = 0; k <= SplineOrder; ++k )
   {
-    /** Create iterator over the coefficient image (for current supportRegion). */
-    ImageRegionConstIteratorWithIndex< ImageType >
-    iterator( this->m_CoefficientImages[ 0 ], supportRegions[ r ] );
-
-    /** For all control points in the support region, set which of the
-            * indices in the parameter array are non-zero.
-            */
-    const PixelType * basePointer = this->m_CoefficientImages[ 0 ]->GetBufferPointer();
-    while( !iterator.IsAtEnd() )
-    {
-      /** Translate the index into a parameter number for the x-direction. */
-      const IdentifierType parameterNumber = &( iterator.Value() ) - basePointer;
-
-      /** Update the nonZeroJacobianIndices for all directions. */
-      for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
-      {
-        nonZeroJacobianIndices[ mu + dim * numberOfWeights ]
-          = parameterNumber + dim * parametersPerDim;
-      }
-
-      /** Increase the iterators. */
-      ++iterator;
-      ++mu;
-    } // end while
-  } // end for (supportregions)
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension - 1, SplineOrder, ScalarType >
+      ::ComputeNonZeroJacobianIndices( nzji, parametersPerDim, sliceOffsets[ k ],
+      this->m_CoefficientImages[ 0 ]->GetOffsetTable() );
+  }
 
 } // end ComputeNonZeroJacobianIndices()
 
@@ -60,6 +60,11 @@ public:
   /** The BSpline order. */
   itkStaticConstMacro( SplineOrder, unsigned int, VSplineOrder );
 
+  /** The number of points that the batch functions process per call of the
+   * recursive implementation.
+   */
+  itkStaticConstMacro( NumberOfPointsPerBatch, unsigned int, 4 );
+
   /** Standard scalar type for this class. */
   typedef typename Superclass::ScalarType                ScalarType;
   typedef typename Superclass::ParametersType            ParametersType;
@@ -133,6 +138,14 @@ public:
    */
   OutputPointType TransformPoint( const InputPointType & point ) const override;
 
+  /** Transform a batch of points. The points are processed in groups of
+   * NumberOfPointsPerBatch by RecursiveBSplineTransformImplementation::TransformPoints().
+   */
+  void TransformPoints(
+    const InputPointType * inputPoints,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const override;
+
   /** Compute the Jacobian of the transformation. */
   void GetJacobian(
     const InputPointType & ipp,
@@ -148,6 +161,17 @@ public:
     DerivativeType & imageJacobian,
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image gradient
+   * for a batch of points. The points are processed in groups of NumberOfPointsPerBatch
+   * by RecursiveBSplineTransformImplementation::EvaluateJacobianWithImageGradientProducts().
+   */
+  void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * ipps,
+    const MovingImageGradientType * movingImageGradients,
+    DerivativeType * imageJacobians,
+    NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+    const SizeValueType n ) const override;
+
   /** Compute the spatial Jacobian of the transformation. */
   void GetSpatialJacobian(
     const InputPointType & ipp,
@@ -165,7 +189,8 @@ public:
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
 
   /** Compute both the spatial Jacobian and the Jacobian of the
-   * spatial Jacobian of the transformation.
+   * spatial Jacobian of the transformation. The B-spline weights are computed
+   * only once for both.
    */
   void GetJacobianOfSpatialJacobian(
     const InputPointType & ipp,
@@ -180,7 +205,8 @@ public:
     NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
 
   /** Compute both the spatial Hessian and the Jacobian of the
-   * spatial Hessian of the transformation.
+   * spatial Hessian of the transformation. The B-spline weights are computed
+   * only once for both.
    */
   void GetJacobianOfSpatialHessian(
     const InputPointType & ipp,
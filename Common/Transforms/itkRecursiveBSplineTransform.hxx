@@ -94,16 +94,26 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
     totalOffsetToSupportIndex += supportIndex[ j ] * bsplineOffsetTable[ j ];
   }
 
-  ScalarType * mu[ SpaceDimension ];
-  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  /** Call the recursive TransformPoint function. */
+  ScalarType displacement[ SpaceDimension ];
+  if( this->m_UseCompactCoefficients )
   {
-    mu[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer() + totalOffsetToSupportIndex;
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::TransformPointInterleaved( displacement,
+      this->m_CompactCoefficients.data() + totalOffsetToSupportIndex,
+      bsplineOffsetTable, weightsArray1D );
   }
+  else
+  {
+    ScalarType * mu[ SpaceDimension ];
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      mu[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer() + totalOffsetToSupportIndex;
+    }
 
-  /** Call the recursive TransformPoint function. */
-  ScalarType displacement[ SpaceDimension ];
-  RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
-    ::TransformPoint( displacement, mu, bsplineOffsetTable, weightsArray1D );
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::TransformPoint( displacement, mu, bsplineOffsetTable, weightsArray1D );
+  }
 
   // The output point is the start point + displacement.
   for( unsigned int j = 0; j < SpaceDimension; ++j )
@@ -250,6 +260,251 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
 } // end EvaluateJacobianWithImageGradientProduct()
 
 
+/**
+ * ********************* TransformPoints ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  /** Check if the coefficient image has been set. The compact coefficients
+   * are handled point by point.
+   */
+  if( !this->m_CoefficientImages[ 0 ] || this->m_UseCompactCoefficients )
+  {
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      outputPoints[ i ] = this->Self::TransformPoint( inputPoints[ i ] );
+    }
+    return;
+  }
+
+  /** Define some constants. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  const unsigned int numberOfPoints  = NumberOfPointsPerBatch;
+
+  /** Allocate the weights of a single point on the stack. */
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
+
+  /** The weights, coefficient pointers and displacements of a batch,
+   * stored point-minor as expected by the recursive implementation.
+   */
+  double        batchWeights1D[ numberOfWeights * numberOfPoints ];
+  ScalarType *  batchMu[ SpaceDimension * numberOfPoints ];
+  ScalarType    batchDisplacements[ SpaceDimension * numberOfPoints ];
+  SizeValueType batchPointIds[ numberOfPoints ];
+
+  const OffsetValueType * bsplineOffsetTable = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
+
+  SizeValueType i = 0;
+  while( i < n )
+  {
+    /** Collect the next batch of points that lie inside the valid region. */
+    unsigned int batchSize = 0;
+    for( ; i < n && batchSize < numberOfPoints; ++i )
+    {
+      /** Convert to continuous index. */
+      ContinuousIndexType cindex;
+      this->TransformPointToContinuousGridIndex( inputPoints[ i ], cindex );
+
+      // NOTE: if the support region does not lie totally within the grid
+      // we assume zero displacement and return the input point
+      if( !this->InsideValidRegion( cindex ) )
+      {
+        outputPoints[ i ] = inputPoints[ i ];
+        continue;
+      }
+
+      // Compute interpolation weighs and store them in weights1D
+      IndexType supportIndex;
+      this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+      for( unsigned int w = 0; w < numberOfWeights; ++w )
+      {
+        batchWeights1D[ w * numberOfPoints + batchSize ] = weightsArray1D[ w ];
+      }
+
+      OffsetValueType totalOffsetToSupportIndex = 0;
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        totalOffsetToSupportIndex += supportIndex[ j ] * bsplineOffsetTable[ j ];
+      }
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        batchMu[ j * numberOfPoints + batchSize ]
+          = this->m_CoefficientImages[ j ]->GetBufferPointer() + totalOffsetToSupportIndex;
+      }
+
+      batchPointIds[ batchSize ] = i;
+      ++batchSize;
+    }
+
+    if( batchSize == 0 )
+    {
+      continue;
+    }
+
+    /** Fill an incomplete batch with copies of its first point. */
+    for( unsigned int p = batchSize; p < numberOfPoints; ++p )
+    {
+      for( unsigned int w = 0; w < numberOfWeights; ++w )
+      {
+        batchWeights1D[ w * numberOfPoints + p ] = batchWeights1D[ w * numberOfPoints ];
+      }
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        batchMu[ j * numberOfPoints + p ] = batchMu[ j * numberOfPoints ];
+      }
+    }
+
+    /** Call the recursive TransformPoints function. */
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::template TransformPoints< NumberOfPointsPerBatch >(
+      batchDisplacements, batchMu, bsplineOffsetTable, batchWeights1D );
+
+    // The output point is the start point + displacement.
+    for( unsigned int p = 0; p < batchSize; ++p )
+    {
+      const SizeValueType id = batchPointIds[ p ];
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        outputPoints[ id ][ j ] = batchDisplacements[ j * numberOfPoints + p ] + inputPoints[ id ][ j ];
+      }
+    }
+  }
+
+} // end TransformPoints()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< class TScalar, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * ipps,
+  const MovingImageGradientType * movingImageGradients,
+  DerivativeType * imageJacobians,
+  NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+  const SizeValueType n ) const
+{
+  /** Define some constants. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  const unsigned int numberOfIndices = RecursiveBSplineWeightFunctionType::NumberOfIndices;
+  const unsigned int numberOfPoints  = NumberOfPointsPerBatch;
+  const NumberOfParametersType nnzji = this->GetNumberOfNonZeroJacobianIndices();
+
+  /** Allocate the weights of a single point on the stack. */
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
+
+  /** The weights, moving image gradients and image Jacobians of a batch,
+   * stored point-minor as expected by the recursive implementation.
+   */
+  double              batchWeights1D[ numberOfWeights * numberOfPoints ];
+  double              batchGradients[ SpaceDimension * numberOfPoints ];
+  ParametersValueType batchImageJacobians[ SpaceDimension * numberOfIndices * numberOfPoints ];
+  IndexType           batchSupportIndices[ numberOfPoints ];
+  SizeValueType       batchPointIds[ numberOfPoints ];
+  double              ones[ numberOfPoints ];
+  for( unsigned int p = 0; p < numberOfPoints; ++p )
+  {
+    ones[ p ] = 1.0;
+  }
+
+  /** Setup support region needed for the nonZeroJacobianIndices. */
+  RegionType supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+
+  SizeValueType i = 0;
+  while( i < n )
+  {
+    /** Collect the next batch of points that lie inside the valid region. */
+    unsigned int batchSize = 0;
+    for( ; i < n && batchSize < numberOfPoints; ++i )
+    {
+      ContinuousIndexType cindex;
+      this->TransformPointToContinuousGridIndex( ipps[ i ], cindex );
+
+      /** NOTE: if the support region does not lie totally within the grid
+       * we assume zero displacement and zero Jacobian.
+       */
+      if( !this->InsideValidRegion( cindex ) )
+      {
+        nonZeroJacobianIndices[ i ].resize( nnzji );
+        for( NumberOfParametersType mu = 0; mu < nnzji; ++mu )
+        {
+          nonZeroJacobianIndices[ i ][ mu ] = mu;
+        }
+        continue;
+      }
+
+      /** Compute the interpolation weights. */
+      this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, batchSupportIndices[ batchSize ] );
+      for( unsigned int w = 0; w < numberOfWeights; ++w )
+      {
+        batchWeights1D[ w * numberOfPoints + batchSize ] = weightsArray1D[ w ];
+      }
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        batchGradients[ j * numberOfPoints + batchSize ] = movingImageGradients[ i ][ j ];
+      }
+
+      batchPointIds[ batchSize ] = i;
+      ++batchSize;
+    }
+
+    if( batchSize == 0 )
+    {
+      continue;
+    }
+
+    /** Fill an incomplete batch with copies of its first point. */
+    for( unsigned int p = batchSize; p < numberOfPoints; ++p )
+    {
+      for( unsigned int w = 0; w < numberOfWeights; ++w )
+      {
+        batchWeights1D[ w * numberOfPoints + p ] = batchWeights1D[ w * numberOfPoints ];
+      }
+      for( unsigned int j = 0; j < SpaceDimension; ++j )
+      {
+        batchGradients[ j * numberOfPoints + p ] = batchGradients[ j * numberOfPoints ];
+      }
+    }
+
+    /** Recursively compute the inner products of the Jacobian and the moving image gradient.
+     * The pointer has changed after this function call.
+     */
+    ParametersValueType * batchImageJacobiansPointer = batchImageJacobians;
+    RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+      ::template EvaluateJacobianWithImageGradientProducts< NumberOfPointsPerBatch >(
+      batchImageJacobiansPointer, batchGradients, batchWeights1D, ones );
+
+    /** Copy the results to the output and compute the nonzero Jacobian indices. */
+    for( unsigned int p = 0; p < batchSize; ++p )
+    {
+      const SizeValueType   id                   = batchPointIds[ p ];
+      ParametersValueType * imageJacobianPointer = imageJacobians[ id ].data_block();
+      for( unsigned int mu = 0; mu < SpaceDimension * numberOfIndices; ++mu )
+      {
+        imageJacobianPointer[ mu ] = batchImageJacobians[ mu * numberOfPoints + p ];
+      }
+
+      supportRegion.SetIndex( batchSupportIndices[ p ] );
+      this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices[ id ], supportRegion );
+    }
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 /**
  * ********************* GetSpatialJacobian ****************************
  */
@@ -541,8 +796,109 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   JacobianOfSpatialJacobianType & jsj,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
-  this->GetJacobianOfSpatialJacobian( ipp, jsj, nonZeroJacobianIndices );
-  this->GetSpatialJacobian( ipp, sj );
+  // Can only compute Jacobian if parameters are set via
+  // SetParameters or SetParametersByValue
+  if( this->m_InputParametersPointer == nullptr )
+  {
+    itkExceptionMacro( << "Cannot compute Jacobian: parameters not set" );
+  }
+
+  jsj.resize( this->GetNumberOfNonZeroJacobianIndices() );
+
+  /** Convert the physical point to a continuous index, which
+   * is needed for the 'Evaluate()' functions below.
+   */
+  ContinuousIndexType cindex;
+  this->TransformPointToContinuousGridIndex( ipp, cindex );
+
+  // NOTE: if the support region does not lie totally within the grid
+  // we assume zero displacement and identity sj and zero jsj.
+  if( !this->InsideValidRegion( cindex ) )
+  {
+    sj.SetIdentity();
+    for( unsigned int i = 0; i < jsj.size(); ++i )
+    {
+      jsj[ i ].Fill( 0.0 );
+    }
+    nonZeroJacobianIndices.resize( this->GetNumberOfNonZeroJacobianIndices() );
+    for( NumberOfParametersType i = 0; i < this->GetNumberOfNonZeroJacobianIndices(); ++i )
+    {
+      nonZeroJacobianIndices[ i ] = i;
+    }
+    return;
+  }
+
+  /** Create storage for the B-spline interpolation weights. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
+  typename WeightsType::ValueType derivativeWeightsArray1D[ numberOfWeights ];
+  WeightsType derivativeWeights1D( derivativeWeightsArray1D, numberOfWeights, false );
+
+  double * weightsPointer           = &( weights1D[ 0 ] );
+  double * derivativeWeightsPointer = &( derivativeWeights1D[ 0 ] );
+
+  /** Compute the interpolation weights once, for both sj and jsj.
+   * In contrast to the normal B-spline weights function, the recursive version
+   * returns the individual weights instead of the multiplied ones.
+   */
+  IndexType supportIndex;
+  this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+  this->m_RecursiveBSplineWeightFunction->EvaluateDerivative( cindex, derivativeWeights1D, supportIndex );
+
+  /** Compute the offset to the start index. */
+  const OffsetValueType * bsplineOffsetTable        = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
+  OffsetValueType         totalOffsetToSupportIndex = 0;
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    totalOffsetToSupportIndex += supportIndex[ j ] * bsplineOffsetTable[ j ];
+  }
+
+  /** Get handles to the mu's. */
+  ScalarType * mu[ SpaceDimension ];
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    mu[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer() + totalOffsetToSupportIndex;
+  }
+
+  /** Recursively compute the spatial Jacobian. */
+  double spatialJacobian[ SpaceDimension * ( SpaceDimension + 1 ) ];
+  RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+    ::GetSpatialJacobian( spatialJacobian, mu, bsplineOffsetTable, weightsPointer, derivativeWeightsPointer );
+
+  /** Copy the correct elements to the spatial Jacobian, skipping the displacement. */
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    for( unsigned int j = 0; j < SpaceDimension; ++j )
+    {
+      sj( i, j ) = spatialJacobian[ i + ( j + 1 ) * SpaceDimension ];
+    }
+  }
+
+  /** Take into account grid spacing and direction cosines. */
+  sj = sj * this->m_PointToIndexMatrix2;
+
+  /** Add the identity matrix, as this is a transformation, not displacement. */
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    sj( j, j ) += 1.0;
+  }
+
+  /** Recursively expand all weights (destroys dummy), and multiply with dc. */
+  double         dummy[ 1 ] = { 1.0 };
+  const double * dc         = this->m_PointToIndexMatrix2.GetVnlMatrix().data_block();
+  double *       jsjPtr     = jsj[ 0 ].GetVnlMatrix().data_block();
+  RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+    ::GetJacobianOfSpatialJacobian( jsjPtr, weightsPointer, derivativeWeightsPointer, dc, dummy );
+
+  /** Setup support region needed for the nonZeroJacobianIndices. */
+  RegionType supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+  supportRegion.SetIndex( supportIndex );
+
+  /** Compute the nonzero Jacobian indices. */
+  this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices, supportRegion );
+
 } // end GetJacobianOfSpatialJacobian()
 
 
@@ -649,8 +1005,134 @@ RecursiveBSplineTransform< TScalar, NDimensions, VSplineOrder >
   JacobianOfSpatialHessianType & jsh,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
-  this->GetJacobianOfSpatialHessian( ipp, jsh, nonZeroJacobianIndices );
-  this->GetSpatialHessian( ipp, sh );
+  // Can only compute Jacobian if parameters are set via
+  // SetParameters or SetParametersByValue
+  if( this->m_InputParametersPointer == nullptr )
+  {
+    itkExceptionMacro( << "Cannot compute Jacobian: parameters not set" );
+  }
+
+  jsh.resize( this->GetNumberOfNonZeroJacobianIndices() );
+
+  /** Convert the physical point to a continuous index, which
+   * is needed for the 'Evaluate()' functions below.
+   */
+  ContinuousIndexType cindex;
+  this->TransformPointToContinuousGridIndex( ipp, cindex );
+
+  // NOTE: if the support region does not lie totally within the grid
+  // we assume zero displacement and zero sh and jsh.
+  if( !this->InsideValidRegion( cindex ) )
+  {
+    for( unsigned int i = 0; i < sh.Size(); ++i )
+    {
+      sh[ i ].Fill( 0.0 );
+    }
+    for( unsigned int i = 0; i < jsh.size(); ++i )
+    {
+      for( unsigned int j = 0; j < jsh[ i ].Size(); ++j )
+      {
+        jsh[ i ][ j ].Fill( 0.0 );
+      }
+    }
+    nonZeroJacobianIndices.resize( this->GetNumberOfNonZeroJacobianIndices() );
+    for( NumberOfParametersType i = 0; i < this->GetNumberOfNonZeroJacobianIndices(); ++i )
+    {
+      nonZeroJacobianIndices[ i ] = i;
+    }
+    return;
+  }
+
+  /** Create storage for the B-spline interpolation weights. */
+  const unsigned int numberOfWeights = RecursiveBSplineWeightFunctionType::NumberOfWeights;
+  typename WeightsType::ValueType weightsArray1D[ numberOfWeights ];
+  WeightsType weights1D( weightsArray1D, numberOfWeights, false );
+  typename WeightsType::ValueType derivativeWeightsArray1D[ numberOfWeights ];
+  WeightsType derivativeWeights1D( derivativeWeightsArray1D, numberOfWeights, false );
+  typename WeightsType::ValueType hessianWeightsArray1D[ numberOfWeights ];
+  WeightsType hessianWeights1D( hessianWeightsArray1D, numberOfWeights, false );
+
+  double * weightsPointer           = &( weights1D[ 0 ] );
+  double * derivativeWeightsPointer = &( derivativeWeights1D[ 0 ] );
+  double * hessianWeightsPointer    = &( hessianWeights1D[ 0 ] );
+
+  /** Compute the interpolation weights once, for both sh and jsh.
+   * In contrast to the normal B-spline weights function, the recursive version
+   * returns the individual weights instead of the multiplied ones.
+   */
+  IndexType supportIndex;
+  this->m_RecursiveBSplineWeightFunction->Evaluate( cindex, weights1D, supportIndex );
+  this->m_RecursiveBSplineWeightFunction->EvaluateDerivative( cindex, derivativeWeights1D, supportIndex );
+  this->m_RecursiveBSplineWeightFunction->EvaluateSecondOrderDerivative( cindex, hessianWeights1D, supportIndex );
+
+  /** Compute the offset to the start index. */
+  const OffsetValueType * bsplineOffsetTable        = this->m_CoefficientImages[ 0 ]->GetOffsetTable();
+  OffsetValueType         totalOffsetToSupportIndex = 0;
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    totalOffsetToSupportIndex += supportIndex[ j ] * bsplineOffsetTable[ j ];
+  }
+
+  /** Get handles to the mu's. */
+  ScalarType * mu[ SpaceDimension ];
+  for( unsigned int j = 0; j < SpaceDimension; ++j )
+  {
+    mu[ j ] = this->m_CoefficientImages[ j ]->GetBufferPointer() + totalOffsetToSupportIndex;
+  }
+
+  /** Recursively compute the spatial Hessian. */
+  double spatialHessian[ SpaceDimension * ( SpaceDimension + 1 ) * ( SpaceDimension + 2 ) / 2 ];
+  RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+    ::GetSpatialHessian( spatialHessian, mu, bsplineOffsetTable,
+    weightsPointer, derivativeWeightsPointer, hessianWeightsPointer );
+
+  /** Copy the correct elements to the spatial Hessian, skipping the
+   * displacement and the spatial Jacobian.
+   */
+  unsigned int k = 2 * SpaceDimension;
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    for( unsigned int j = 0; j < ( i + 1 ) * SpaceDimension; ++j )
+    {
+      sh[ j % SpaceDimension ]( i, j / SpaceDimension ) = spatialHessian[ k + j ];
+    }
+    k += ( i + 2 ) * SpaceDimension;
+  }
+
+  /** Mirror, as only the lower triangle is now filled. */
+  for( unsigned int i = 0; i < SpaceDimension; ++i )
+  {
+    for( unsigned int j = 0; j < SpaceDimension - 1; ++j )
+    {
+      for( unsigned int k = 1; k < SpaceDimension; ++k )
+      {
+        sh[ i ]( j, k ) = sh[ i ]( k, j );
+      }
+    }
+  }
+
+  /** Take into account grid spacing and direction matrix. */
+  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+  {
+    sh[ dim ] = this->m_PointToIndexMatrixTransposed2
+      * ( sh[ dim ] * this->m_PointToIndexMatrix2 );
+  }
+
+  /** Recursively expand all weights (destroys dummy), and multiply with dc^T and dc. */
+  double *       jshPtr     = jsh[ 0 ][ 0 ].GetVnlMatrix().data_block();
+  const double * dc         = this->m_PointToIndexMatrix2.GetVnlMatrix().data_block();
+  double         dummy[ 1 ] = { 1.0 };
+  RecursiveBSplineTransformImplementation< SpaceDimension, SpaceDimension, SplineOrder, TScalar >
+    ::GetJacobianOfSpatialHessian( jshPtr, weightsPointer, derivativeWeightsPointer, hessianWeightsPointer, dc, dummy );
+
+  /** Setup support region needed for the nonZeroJacobianIndices. */
+  RegionType supportRegion;
+  supportRegion.SetSize( this->m_SupportSize );
+  supportRegion.SetIndex( supportIndex );
+
+  /** Compute the nonzero Jacobian indices. */
+  this->ComputeNonZeroJacobianIndices( nonZeroJacobianIndices, supportRegion );
+
 } // end GetJacobianOfSpatialHessian()
 
 
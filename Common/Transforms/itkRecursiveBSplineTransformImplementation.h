@@ -100,6 +100,90 @@ public:
   } // end TransformPoint()
 
 
+  /** TransformPoint recursive implementation for interleaved coefficients.
+   * mu points to the OutputDimension coefficients of the first control point
+   * of the support region, which are stored next to each other.
+   */
+  template< class TCoefficient >
+  static inline void TransformPointInterleaved(
+    OutputPointType opp, const TCoefficient * mu,
+    const OffsetValueType * gridOffsetTable,
+    const double * weights1D )
+  {
+    /** Create a temporary opp and initialize the original. */
+    ScalarType tmp_opp[ OutputDimension ];
+    for( unsigned int j = 0; j < OutputDimension; ++j )
+    {
+      opp[ j ] = 0.0;
+    }
+
+    const OffsetValueType bot = gridOffsetTable[ SpaceDimension - 1 ];
+    for( unsigned int k = 0; k <= SplineOrder; ++k )
+    {
+      /** Recurse. */
+      RecursiveBSplineTransformImplementation< OutputDimension, SpaceDimension - 1, SplineOrder, TScalar >
+        ::TransformPointInterleaved( tmp_opp, mu, gridOffsetTable, weights1D );
+
+      /** Accumulate the weights. */
+      for( unsigned int j = 0; j < OutputDimension; ++j )
+      {
+        opp[ j ] += tmp_opp[ j ] * weights1D[ k + HelperConstVariable ];
+      }
+
+      // move to the next mu
+      mu += bot;
+    }
+  } // end TransformPointInterleaved()
+
+
+  /** TransformPoints recursive implementation.
+   * Computes the displacement of VNumberOfPoints points at once. All arrays
+   * are stored point-minor, i.e. element [ i * VNumberOfPoints + p ] belongs
+   * to point p, so that the innermost loops over the points can be vectorized.
+   */
+  template< unsigned int VNumberOfPoints >
+  static inline void TransformPoints(
+    ScalarType * opp, ScalarType * const * mu,
+    const OffsetValueType * gridOffsetTable,
+    const double * weights1D )
+  {
+    /** Make a copy of the pointers to mu. The pointers will move later. */
+    ScalarType * tmp_mu[ OutputDimension * VNumberOfPoints ];
+    for( unsigned int i = 0; i < OutputDimension * VNumberOfPoints; ++i )
+    {
+      tmp_mu[ i ] = mu[ i ];
+    }
+
+    /** Create a temporary opp and initialize the original. */
+    ScalarType tmp_opp[ OutputDimension * VNumberOfPoints ];
+    for( unsigned int i = 0; i < OutputDimension * VNumberOfPoints; ++i )
+    {
+      opp[ i ] = 0.0;
+    }
+
+    const OffsetValueType bot = gridOffsetTable[ SpaceDimension - 1 ];
+    for( unsigned int k = 0; k <= SplineOrder; ++k )
+    {
+      /** Recurse. */
+      RecursiveBSplineTransformImplementation< OutputDimension, SpaceDimension - 1, SplineOrder, TScalar >
+        ::template TransformPoints< VNumberOfPoints >( tmp_opp, tmp_mu, gridOffsetTable, weights1D );
+
+      /** Accumulate the weights. */
+      const double * weights = weights1D + ( k + HelperConstVariable ) * VNumberOfPoints;
+      for( unsigned int j = 0; j < OutputDimension; ++j )
+      {
+        for( unsigned int p = 0; p < VNumberOfPoints; ++p )
+        {
+          opp[ j * VNumberOfPoints + p ] += tmp_opp[ j * VNumberOfPoints + p ] * weights[ p ];
+
+          // move to the next mu
+          tmp_mu[ j * VNumberOfPoints + p ] += bot;
+        }
+      }
+    }
+  } // end TransformPoints()
+
+
   /** GetJacobian recursive implementation. */
   static inline void GetJacobian(
     ScalarType * & jacobians, const double * weights1D, double value )
@@ -128,6 +212,33 @@ public:
   } // end EvaluateJacobianWithImageGradientProduct()
 
 
+  /** EvaluateJacobianWithImageGradientProducts recursive implementation.
+   * Processes VNumberOfPoints points at once, using the point-minor storage
+   * of TransformPoints() for the weights, the moving image gradients, the
+   * values and the image Jacobians.
+   */
+  template< unsigned int VNumberOfPoints >
+  static inline void EvaluateJacobianWithImageGradientProducts(
+    ScalarType * & imageJacobians, const InternalFloatType * movingImageGradients,
+    const double * weights1D, const double * values )
+  {
+    double tmp_values[ VNumberOfPoints ];
+    for( unsigned int k = 0; k <= SplineOrder; ++k )
+    {
+      const double * weights = weights1D + ( k + HelperConstVariable ) * VNumberOfPoints;
+      for( unsigned int p = 0; p < VNumberOfPoints; ++p )
+      {
+        tmp_values[ p ] = values[ p ] * weights[ p ];
+      }
+
+      /** Recurse. */
+      RecursiveBSplineTransformImplementation< OutputDimension, SpaceDimension - 1, SplineOrder, TScalar >
+        ::template EvaluateJacobianWithImageGradientProducts< VNumberOfPoints >(
+        imageJacobians, movingImageGradients, weights1D, tmp_values );
+    }
+  } // end EvaluateJacobianWithImageGradientProducts()
+
+
   /** ComputeNonZeroJacobianIndices recursive implementation. */
   static inline void ComputeNonZeroJacobianIndices(
     unsigned long * & nzji,
@@ -403,6 +514,34 @@ public:
   } // end TransformPoint()
 
 
+  /** TransformPointInterleaved recursive implementation. */
+  template< class TCoefficient >
+  static inline void TransformPointInterleaved(
+    OutputPointType opp, const TCoefficient * mu,
+    const OffsetValueType * itkNotUsed( gridOffsetTable ),
+    const double * itkNotUsed( weights1D ) )
+  {
+    for( unsigned int j = 0; j < OutputDimension; ++j )
+    {
+      opp[ j ] = ( *mu )[ j ];
+    }
+  } // end TransformPointInterleaved()
+
+
+  /** TransformPoints recursive implementation. */
+  template< unsigned int VNumberOfPoints >
+  static inline void TransformPoints(
+    ScalarType * opp, ScalarType * const * mu,
+    const OffsetValueType * gridOffsetTable,
+    const double * weights1D )
+  {
+    for( unsigned int i = 0; i < OutputDimension * VNumberOfPoints; ++i )
+    {
+      opp[ i ] = *( mu[ i ] );
+    }
+  } // end TransformPoints()
+
+
   /** GetJacobian recursive implementation. */
   static inline void GetJacobian(
     ScalarType * & jacobians, const double * weights1D, double value )
@@ -430,6 +569,24 @@ public:
   } // end EvaluateJacobianWithImageGradientProduct()
 
 
+  /** EvaluateJacobianWithImageGradientProducts recursive implementation. */
+  template< unsigned int VNumberOfPoints >
+  static inline void EvaluateJacobianWithImageGradientProducts(
+    ScalarType * & imageJacobians, const InternalFloatType * movingImageGradients,
+    const double * weights1D, const double * values )
+  {
+    for( unsigned int j = 0; j < OutputDimension; ++j )
+    {
+      ScalarType * imageJacobian = imageJacobians + j * BSplineNumberOfIndices * VNumberOfPoints;
+      for( unsigned int p = 0; p < VNumberOfPoints; ++p )
+      {
+        imageJacobian[ p ] = values[ p ] * movingImageGradients[ j * VNumberOfPoints + p ];
+      }
+    }
+    imageJacobians += VNumberOfPoints;
+  } // end EvaluateJacobianWithImageGradientProducts()
+
+
   /** ComputeNonZeroJacobianIndices recursive implementation. */
   static inline void ComputeNonZeroJacobianIndices(
     unsigned long * & nzji,
@@ -89,6 +89,8 @@ public:
   typedef typename Superclass::OutputPointType       OutputPointType;
   typedef typename Superclass::OutputVectorPixelType OutputVectorPixelType;
   typedef typename Superclass::InputVectorPixelType  InputVectorPixelType;
+  typedef typename Superclass::DerivativeType        DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
 
   /** Sub transform types, having a reduced dimension. */
   typedef AdvancedTransform< TScalarType,
@@ -97,6 +99,8 @@ public:
   typedef typename SubTransformType::Pointer      SubTransformPointer;
   typedef std::vector< SubTransformPointer  >     SubTransformContainerType;
   typedef typename SubTransformType::JacobianType SubTransformJacobianType;
+  typedef typename SubTransformType::MovingImageGradientType
+    SubTransformMovingImageGradientType;
 
   /** Dimension - 1 point types. */
   typedef typename SubTransformType::InputPointType  SubTransformInputPointType;
@@ -143,6 +147,17 @@ public:
     JacobianType & jac,
     NonZeroJacobianIndicesType & nzji ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, using the fused product of the sub transform at the stack
+   * position of the point. Only the Jacobian of that sub transform is
+   * (partially) constructed.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nzji ) const override;
+
   /** Set the parameters. Checks if the number of parameters
    * is correct and sets parameters of sub transforms. */
   void SetParameters( const ParametersType & param ) override;
@@ -180,6 +180,48 @@ StackTransform< TScalarType, NInputDimensions, NOutputDimensions >
 } // end GetJacobian()
 
 
+/**
+ * ********************* EvaluateJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+StackTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & ipp,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  /** Reduce dimension of input point and moving image gradient. The
+   * last row of the Jacobian is zero, so the last component of the
+   * gradient does not contribute.
+   */
+  SubTransformInputPointType          ippr;
+  SubTransformMovingImageGradientType gradientr;
+  for( unsigned int d = 0; d < ReducedInputSpaceDimension; ++d )
+  {
+    ippr[ d ]      = ipp[ d ];
+    gradientr[ d ] = movingImageGradient[ d ];
+  }
+
+  /** Evaluate the product with the right subtransform. */
+  const unsigned int subt
+    = std::min( this->m_NumberOfSubTransforms - 1, static_cast< unsigned int >(
+      std::max( 0,
+      vnl_math::rnd( ( ipp[ ReducedInputSpaceDimension ] - m_StackOrigin ) / m_StackSpacing ) ) ) );
+  this->m_SubTransformContainer[ subt ]->EvaluateJacobianWithImageGradientProduct(
+    ippr, gradientr, imageJacobian, nzji );
+
+  /** Update non zero Jacobian indices. */
+  for( unsigned int i = 0; i < nzji.size(); ++i )
+  {
+    nzji[ i ] += subt * this->m_SubTransformContainer[ 0 ]->GetNumberOfParameters();
+  }
+
+} // end EvaluateJacobianWithImageGradientProduct()
+
+
 /**
  * ********************* GetNumberOfNonZeroJacobianIndices ****************************
  */
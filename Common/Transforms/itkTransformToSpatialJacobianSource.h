@@ -96,6 +96,8 @@ public:
     itkGetStaticConstMacro( ImageDimension ) >     TransformType;
   typedef typename TransformType::ConstPointer        TransformPointerType;
   typedef typename TransformType::SpatialJacobianType SpatialJacobianType;
+  typedef typename TransformType::InputPointType      InputPointType;
+  typedef typename TransformType::InputVectorType     InputVectorType;
 
   /** Typedefs for output image. */
   typedef typename OutputImageType::PixelType PixelType;
@@ -188,7 +190,8 @@ protected:
     ThreadIdType threadId ) override;
 
   /** Default implementation for resampling that works for any
-   * transformation type.
+   * transformation type. The spatial Jacobians are computed per scanline,
+   * by GetSpatialJacobianScanline() of the transform.
    */
   void NonlinearThreadedGenerateData(
     const OutputImageRegionType & outputRegionForThread,
@@ -22,8 +22,9 @@
 
 #include "itkAdvancedIdentityTransform.h"
 #include "itkProgressReporter.h"
-#include "itkImageRegionIteratorWithIndex.h"
+#include "itkImageScanlineIterator.h"
 #include "vnl/vnl_copy.h"
+#include <vector>
 
 namespace itk
 {
@@ -242,39 +243,56 @@ TransformToSpatialJacobianSource< TOutputImage, TTransformPrecisionType >
   // Get the output pointer
   OutputImagePointer outputPtr = this->GetOutput();
 
-  // Create an iterator that will walk the output region for this thread.
-  typedef ImageRegionIteratorWithIndex< TOutputImage > OutputIteratorType;
-  OutputIteratorType it( outputPtr, outputRegionForThread );
-  it.GoToBegin();
+  // Support for progress methods/callbacks
+  ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
 
-  // pixel coordinates
+  // The physical step between two voxels of a scanline
+  IndexType index = outputRegionForThread.GetIndex();
   PointType point;
+  PointType nextPoint;
+  outputPtr->TransformIndexToPhysicalPoint( index, point );
+  ++index[ 0 ];
+  outputPtr->TransformIndexToPhysicalPoint( index, nextPoint );
+  InputVectorType step;
+  for( unsigned int j = 0; j < ImageDimension; j++ )
+  {
+    step[ j ] = nextPoint[ j ] - point[ j ];
+  }
 
-  // Support for progress methods/callbacks
-  ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
+  const SizeValueType                lineLength = outputRegionForThread.GetSize( 0 );
+  std::vector< SpatialJacobianType > sjs( lineLength );
+  InputPointType                     lineStart;
 
-  SpatialJacobianType sj;
-  PixelType           sjOut;
-  const unsigned int  nrElements = sj.GetVnlMatrix().size();
+  PixelType          sjOut;
+  const unsigned int nrElements = sjOut.GetVnlMatrix().size();
 
-  // Walk the output region
+  // Walk the output region, one scanline at a time
+  ImageScanlineIterator< TOutputImage > it( outputPtr, outputRegionForThread );
   while( !it.IsAtEnd() )
   {
-    // Determine the coordinates of the current voxel
+    // Determine the coordinates of the first voxel of the scanline
     outputPtr->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+    for( unsigned int j = 0; j < ImageDimension; j++ )
+    {
+      lineStart[ j ] = point[ j ];
+    }
 
-    this->m_Transform->GetSpatialJacobian( point, sj );
+    this->m_Transform->GetSpatialJacobianScanline( lineStart, step, sjs.data(), lineLength );
 
-    // cast spatial jacobian to output pixel type
-    vnl_copy( sj.GetVnlMatrix().begin(), sjOut.GetVnlMatrix().begin(),
-      nrElements );
+    for( SizeValueType i = 0; i < lineLength; ++i )
+    {
+      // cast spatial jacobian to output pixel type
+      vnl_copy( sjs[ i ].GetVnlMatrix().begin(), sjOut.GetVnlMatrix().begin(),
+        nrElements );
 
-    // Set it
-    it.Set( sjOut );
+      // Set it
+      it.Set( sjOut );
 
-    // Update progress and iterator
-    progress.CompletedPixel();
-    ++it;
+      // Update progress and iterator
+      progress.CompletedPixel();
+      ++it;
+    }
+    it.NextLine();
   }
 
 } // end NonlinearThreadedGenerateData()
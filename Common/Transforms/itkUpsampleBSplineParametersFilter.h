@@ -20,6 +20,9 @@
 
 #include "itkObject.h"
 #include "itkArray.h"
+#include "itkPersistentThreadPool.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -33,6 +36,28 @@ namespace itk
  * on a denser grid. Therefore, the user needs to supply the old B-spline grid
  * (region, spacing, origin, direction), and the required B-spline grid.
  *
+ * In general, the B-spline of each parameter dimension is sampled at the
+ * required grid points by a ResampleImageFilter, after which the
+ * coefficients on the required grid are computed by the
+ * MultiThreadedBSplineDecompositionImageFilter.
+ *
+ * With UseDyadicRefinement, the common case in which the required grid
+ * halves the spacing of the current grid, or keeps it, along each
+ * dimension, is computed by B-spline subdivision instead. A B-spline of
+ * order n equals a sum of n+2 B-splines of half its width, with the
+ * binomial weights C(n+1,j)/2^n, so every required coefficient is a sum of
+ * at most (n+3)/2 current coefficients per dimension. The subdivision is
+ * applied to one dimension at a time, divided over the threads of the
+ * PersistentThreadPool. The result represents exactly the same deformation
+ * as the current coefficients, where the current coefficients outside the
+ * current grid are zero, whereas the general method mirrors the current
+ * coefficients at the boundaries and interpolates the samples. The
+ * subdivision requires the required grid points to lie on the lattice of
+ * the refined current grid, so it is only used when the direction is the
+ * same and the origins differ by a whole number of required grid spacings,
+ * or by a half for even spline orders. Otherwise the general method is
+ * used.
+ *
  */
 
 template< class TArray, class TImage >
@@ -94,6 +119,14 @@ public:
   /** Set the B-spline order. */
   itkSetMacro( BSplineOrder, unsigned int );
 
+  /** Set/Get whether a required grid that halves or keeps the spacing of
+   * the current grid is computed by B-spline subdivision. The default is
+   * false.
+   */
+  itkSetMacro( UseDyadicRefinement, bool );
+  itkGetConstMacro( UseDyadicRefinement, bool );
+  itkBooleanMacro( UseDyadicRefinement );
+
   /** Compute the output parameter array. */
   virtual void UpsampleParameters( const ArrayType & param_in,
     ArrayType & param_out );
@@ -112,6 +145,15 @@ protected:
   /** Function that checks if upsampling is required. */
   virtual bool DoUpsampling( void );
 
+  /** Function that checks if the required grid is a dyadic refinement of
+   * the current grid, and computes the subdivision weights if it is.
+   */
+  virtual bool ComputeDyadicRefinement( void );
+
+  /** Compute the output parameters by B-spline subdivision. */
+  virtual void UpsampleParametersDyadic( const ArrayType & param_in,
+    ArrayType & param_out );
+
 private:
 
   UpsampleBSplineParametersFilter( const Self & ); // purposely not implemented
@@ -127,6 +169,39 @@ private:
   DirectionType m_RequiredGridDirection;
   RegionType    m_RequiredGridRegion;
   unsigned int  m_BSplineOrder;
+  bool          m_UseDyadicRefinement;
+
+  /** The subdivision along one dimension. Required grid point r is the sum
+   * of the current grid points m_FirstTaps[ r ] + i, with the weights
+   * m_Weights[ r * m_NumberOfTaps + i ], for i < m_NumberOfTaps. Taps
+   * outside the current grid have a weight of zero. A dimension that is
+   * the identity is skipped.
+   */
+  struct RefinementType
+  {
+    SizeValueType                  m_CurrentSize;
+    SizeValueType                  m_RequiredSize;
+    unsigned int                   m_NumberOfTaps;
+    bool                           m_IsIdentity;
+    std::vector< OffsetValueType > m_FirstTaps;
+    std::vector< double >          m_Weights;
+  };
+
+  RefinementType m_Refinements[ Dimension ];
+
+  /** The data passed to the threads by UpsampleParametersDyadic(). */
+  struct RefinementThreaderParameterType
+  {
+    const RefinementType * m_Refinement;
+    const ValueType *      m_Input;
+    ValueType *            m_Output;
+    SizeValueType          m_Stride;
+    SizeValueType          m_NumberOfLines;
+    SizeValueType          m_LinesPerWorkUnit;
+  };
+
+  /** Subdivide the lines of a work unit along one dimension. */
+  static ITK_THREAD_RETURN_TYPE RefinementThreaderCallback( void * arg );
 
 };
 
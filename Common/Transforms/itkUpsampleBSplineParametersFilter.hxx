@@ -21,9 +21,12 @@
 #include "itkUpsampleBSplineParametersFilter.h"
 
 #include "itkBSplineResampleImageFunction.h"
-#include "itkBSplineDecompositionImageFilter.h"
+#include "itkMultiThreadedBSplineDecompositionImageFilter.h"
 #include "itkResampleImageFilter.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace itk
 {
 
@@ -35,7 +38,8 @@ template< class TArray, class TImage >
 UpsampleBSplineParametersFilter< TArray, TImage >
 ::UpsampleBSplineParametersFilter()
 {
-  this->m_BSplineOrder = 3;
+  this->m_BSplineOrder        = 3;
+  this->m_UseDyadicRefinement = false;
 
   // Initialize grid settings.
   this->m_CurrentGridOrigin.Fill( 0.0 );
@@ -64,12 +68,19 @@ UpsampleBSplineParametersFilter< TArray, TImage >
     return;
   }
 
+  /** Use B-spline subdivision if possible. */
+  if( this->m_UseDyadicRefinement && this->ComputeDyadicRefinement() )
+  {
+    this->UpsampleParametersDyadic( parameters_in, parameters_out );
+    return;
+  }
+
   /** Typedefs. */
   typedef itk::ResampleImageFilter<
     ImageType, ImageType >                        UpsampleFilterType;
   typedef itk::BSplineResampleImageFunction<
     ImageType, ValueType >                        CoefficientUpsampleFunctionType;
-  typedef itk::BSplineDecompositionImageFilter<
+  typedef itk::MultiThreadedBSplineDecompositionImageFilter<
     ImageType, ImageType >                        DecompositionFilterType;
 
   /** Get the number of parameters. */
@@ -136,9 +147,6 @@ UpsampleBSplineParametersFilter< TArray, TImage >
     try
     {
       decompositionFilter->UpdateLargestPossibleRegion();
-      // \todo: the decomposition filter could be multi-threaded
-      // by deriving it from the RecursiveSeparableImageFilter,
-      // similar to the SmoothingRecursiveGaussianImageFilter.
     }
     catch( itk::ExceptionObject & excp )
     {
@@ -183,6 +191,309 @@ UpsampleBSplineParametersFilter< TArray, TImage >
 } // end DoUpsampling()
 
 
+/**
+ * ******************* ComputeDyadicRefinement *******************
+ */
+
+template< class TArray, class TImage >
+bool
+UpsampleBSplineParametersFilter< TArray, TImage >
+::ComputeDyadicRefinement( void )
+{
+  const double       tolerance   = 1e-6;
+  const unsigned int splineOrder = this->m_BSplineOrder;
+
+  /** The subdivision requires the same direction. */
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      if( std::abs( this->m_CurrentGridDirection[ i ][ j ]
+        - this->m_RequiredGridDirection[ i ][ j ] ) > tolerance )
+      {
+        return false;
+      }
+    }
+  }
+
+  /** The shift of the required origin, in grid coordinates. */
+  const vnl_matrix_fixed< double, Dimension, Dimension > inverseDirection
+    = this->m_CurrentGridDirection.GetInverse();
+  double shift[ Dimension ];
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    shift[ i ] = 0.0;
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      shift[ i ] += inverseDirection( i, j )
+        * ( this->m_RequiredGridOrigin[ j ] - this->m_CurrentGridOrigin[ j ] );
+    }
+  }
+
+  /** The binomial weights of the two-scale relation of a B-spline of this
+   * order: the B-spline equals the sum of a_j times the B-spline of half
+   * its width, shifted by j - (n+1)/2 of those widths, for j in [0, n+1].
+   */
+  std::vector< double > binomial( splineOrder + 2, 0.0 );
+  binomial[ 0 ] = 1.0;
+  for( unsigned int n = 1; n < splineOrder + 2; ++n )
+  {
+    for( unsigned int j = n; j > 0; --j )
+    {
+      binomial[ j ] += binomial[ j - 1 ];
+    }
+  }
+  const double scale = std::ldexp( 1.0, -static_cast< int >( splineOrder ) );
+
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    const double ratio = this->m_CurrentGridSpacing[ i ] / this->m_RequiredGridSpacing[ i ];
+    unsigned int factor = 0;
+    if( std::abs( ratio - 1.0 ) < tolerance )
+    {
+      factor = 1;
+    }
+    else if( std::abs( ratio - 2.0 ) < tolerance )
+    {
+      factor = 2;
+    }
+    else
+    {
+      return false;
+    }
+
+    /** Required grid point r, a grid index, is current grid point m + r
+     * for a factor of 1. For a factor of 2, the current grid point k
+     * contributes a_j to it, with j = m + r - 2k. This requires m to be
+     * a whole number.
+     */
+    double position = shift[ i ] / this->m_RequiredGridSpacing[ i ];
+    if( factor == 2 )
+    {
+      position += 0.5 * ( splineOrder + 1 );
+    }
+    const double          roundedPosition = std::floor( position + 0.5 );
+    const OffsetValueType m               = static_cast< OffsetValueType >( roundedPosition );
+    if( std::abs( position - roundedPosition ) > tolerance )
+    {
+      return false;
+    }
+
+    RefinementType &      refinement    = this->m_Refinements[ i ];
+    const OffsetValueType currentIndex  = this->m_CurrentGridRegion.GetIndex()[ i ];
+    const OffsetValueType requiredIndex = this->m_RequiredGridRegion.GetIndex()[ i ];
+    refinement.m_CurrentSize  = this->m_CurrentGridRegion.GetSize()[ i ];
+    refinement.m_RequiredSize = this->m_RequiredGridRegion.GetSize()[ i ];
+    refinement.m_NumberOfTaps = factor == 1 ? 1 : ( splineOrder + 1 ) / 2 + 1;
+    const unsigned int    numberOfTaps = refinement.m_NumberOfTaps;
+    const OffsetValueType currentSize  = static_cast< OffsetValueType >( refinement.m_CurrentSize );
+    if( currentSize < static_cast< OffsetValueType >( numberOfTaps ) )
+    {
+      return false;
+    }
+
+    refinement.m_FirstTaps.resize( refinement.m_RequiredSize );
+    refinement.m_Weights.assign( refinement.m_RequiredSize * numberOfTaps, 0.0 );
+    refinement.m_IsIdentity = ( factor == 1 && m == currentIndex - requiredIndex
+      && refinement.m_CurrentSize == refinement.m_RequiredSize );
+    for( SizeValueType r = 0; r < refinement.m_RequiredSize; ++r )
+    {
+      /** The first current grid point that contributes, relative to the
+       * start of the current grid region, kept inside the region.
+       */
+      const OffsetValueType rIndex = requiredIndex + static_cast< OffsetValueType >( r );
+      OffsetValueType       first  = m + rIndex;
+      if( factor == 2 )
+      {
+        const OffsetValueType lowest = m + rIndex - static_cast< OffsetValueType >( splineOrder ) - 1;
+        first = lowest >= 0 ? ( lowest + 1 ) / 2 : -( ( -lowest ) / 2 );
+      }
+      first -= currentIndex;
+      const OffsetValueType clampedFirst = std::max< OffsetValueType >( 0,
+        std::min< OffsetValueType >( first, currentSize - numberOfTaps ) );
+      refinement.m_FirstTaps[ r ] = clampedFirst;
+
+      for( unsigned int t = 0; t < numberOfTaps; ++t )
+      {
+        const OffsetValueType k = clampedFirst + t;
+        double                weight = 0.0;
+        if( factor == 1 )
+        {
+          weight = ( k + currentIndex == m + rIndex ) ? 1.0 : 0.0;
+        }
+        else
+        {
+          const OffsetValueType j = m + rIndex - 2 * ( k + currentIndex );
+          if( j >= 0 && j <= static_cast< OffsetValueType >( splineOrder ) + 1 )
+          {
+            weight = scale * binomial[ j ];
+          }
+        }
+        refinement.m_Weights[ r * numberOfTaps + t ] = weight;
+      }
+    }
+  }
+
+  return true;
+
+} // end ComputeDyadicRefinement()
+
+
+/**
+ * ******************* UpsampleParametersDyadic *******************
+ */
+
+template< class TArray, class TImage >
+void
+UpsampleBSplineParametersFilter< TArray, TImage >
+::UpsampleParametersDyadic( const ArrayType & parameters_in,
+  ArrayType & parameters_out )
+{
+  const SizeValueType requiredNumberOfPixels
+    = this->m_RequiredGridRegion.GetNumberOfPixels();
+  parameters_out.SetSize( requiredNumberOfPixels * Dimension );
+
+  /** The sizes of the intermediate result, in which the dimensions before
+   * the current one are refined. The parameter dimension is the outermost.
+   */
+  SizeValueType sizes[ Dimension ];
+  SizeValueType numberOfValues = Dimension;
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    sizes[ i ]      = this->m_Refinements[ i ].m_CurrentSize;
+    numberOfValues *= sizes[ i ];
+  }
+
+  /** The dimensions that are not the identity, of which the last writes the
+   * output parameters.
+   */
+  unsigned int lastDimension = Dimension;
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    if( !this->m_Refinements[ i ].m_IsIdentity )
+    {
+      lastDimension = i;
+    }
+  }
+  if( lastDimension == Dimension )
+  {
+    parameters_out = parameters_in;
+    return;
+  }
+
+  PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+  std::vector< ValueType >      buffers[ 2 ];
+  unsigned int                  currentBuffer = 0;
+  const ValueType *             input         = parameters_in.data_block();
+  SizeValueType                 stride        = 1;
+
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    const RefinementType & refinement = this->m_Refinements[ i ];
+    if( refinement.m_IsIdentity )
+    {
+      stride *= sizes[ i ];
+      continue;
+    }
+
+    /** Refine all lines along this dimension. */
+    const SizeValueType numberOfLines = numberOfValues / sizes[ i ];
+    numberOfValues = numberOfLines * refinement.m_RequiredSize;
+    sizes[ i ]     = refinement.m_RequiredSize;
+    ValueType * output = parameters_out.data_block();
+    if( i != lastDimension )
+    {
+      std::vector< ValueType > & buffer = buffers[ currentBuffer ];
+      buffer.resize( numberOfValues );
+      output        = buffer.data();
+      currentBuffer = 1 - currentBuffer;
+    }
+
+    const SizeValueType numberOfWorkUnits = std::max< SizeValueType >( 1,
+      std::min< SizeValueType >( pool->GetMaximumNumberOfThreads(), numberOfLines ) );
+
+    RefinementThreaderParameterType temp;
+    temp.m_Refinement       = &refinement;
+    temp.m_Input            = input;
+    temp.m_Output           = output;
+    temp.m_Stride           = stride;
+    temp.m_NumberOfLines    = numberOfLines;
+    temp.m_LinesPerWorkUnit = ( numberOfLines + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+    pool->SingleMethodExecute( static_cast< ThreadIdType >( numberOfWorkUnits ),
+      RefinementThreaderCallback, &temp );
+
+    input   = output;
+    stride *= sizes[ i ];
+  }
+
+} // end UpsampleParametersDyadic()
+
+
+/**
+ * ******************* RefinementThreaderCallback *******************
+ */
+
+template< class TArray, class TImage >
+ITK_THREAD_RETURN_TYPE
+UpsampleBSplineParametersFilter< TArray, TImage >
+::RefinementThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const RefinementThreaderParameterType * temp
+    = static_cast< RefinementThreaderParameterType * >( infoStruct->UserData );
+
+  const RefinementType & refinement   = *temp->m_Refinement;
+  const SizeValueType    stride       = temp->m_Stride;
+  const unsigned int     numberOfTaps = refinement.m_NumberOfTaps;
+  const SizeValueType    inputLength  = refinement.m_CurrentSize;
+  const SizeValueType    outputLength = refinement.m_RequiredSize;
+  const SizeValueType    begin        = std::min( infoStruct->WorkUnitID * temp->m_LinesPerWorkUnit,
+    temp->m_NumberOfLines );
+  const SizeValueType end = std::min( begin + temp->m_LinesPerWorkUnit, temp->m_NumberOfLines );
+
+  /** Line l starts at ( l / stride ) * stride * length + l % stride. The
+   * lines with the same l / stride are adjacent in memory, so they are
+   * refined together, with the innermost loop over the lines.
+   */
+  SizeValueType line = begin;
+  while( line < end )
+  {
+    const SizeValueType outer      = line / stride;
+    const SizeValueType firstInner = line % stride;
+    const SizeValueType lastInner  = std::min( stride, firstInner + ( end - line ) );
+    const ValueType *   input      = temp->m_Input + outer * stride * inputLength;
+    ValueType *         output     = temp->m_Output + outer * stride * outputLength;
+
+    for( SizeValueType r = 0; r < outputLength; ++r )
+    {
+      ValueType *    outputLine = output + r * stride;
+      const double * weights    = &refinement.m_Weights[ r * numberOfTaps ];
+      std::fill( outputLine + firstInner, outputLine + lastInner, ValueType( 0 ) );
+      for( unsigned int t = 0; t < numberOfTaps; ++t )
+      {
+        const double weight = weights[ t ];
+        if( weight == 0.0 )
+        {
+          continue;
+        }
+        const ValueType * inputLine
+          = input + ( refinement.m_FirstTaps[ r ] + t ) * stride;
+        for( SizeValueType inner = firstInner; inner < lastInner; ++inner )
+        {
+          outputLine[ inner ] += weight * inputLine[ inner ];
+        }
+      }
+    }
+
+    line += lastInner - firstInner;
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end RefinementThreaderCallback()
+
+
 /**
  * ******************* PrintSelf *******************
  */
@@ -205,6 +516,7 @@ UpsampleBSplineParametersFilter< TArray, TImage >
   os << indent << "RequiredGridRegion: "  << this->m_RequiredGridRegion << std::endl;
 
   os << indent << "BSplineOrder: " << this->m_BSplineOrder << std::endl;
+  os << indent << "UseDyadicRefinement: " << this->m_UseDyadicRefinement << std::endl;
 
 } // end PrintSelf()
 
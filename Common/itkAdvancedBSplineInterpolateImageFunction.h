@@ -0,0 +1,256 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAdvancedBSplineInterpolateImageFunction_h
+#define __itkAdvancedBSplineInterpolateImageFunction_h
+
+#include "itkBSplineInterpolateImageFunction.h"
+#include "itkBSplineCoefficientCache.h"
+#include "itkHalfPrecision.h"
+#include "itkMemoryPrefetch.h"
+#include "itkMultiThreadedBSplineDecompositionImageFilter.h"
+
+#include <vector>
+
+namespace itk
+{
+/** \class AdvancedBSplineInterpolateImageFunction
+ * \brief B-spline interpolation of an image, with a fast combined evaluation
+ * of the value and the derivative.
+ *
+ * The BSplineInterpolateImageFunction evaluates the value and the derivative
+ * at a point for any spline order, with weights and indices in vnl matrices
+ * that are allocated every call. This class adds compile-time specializations
+ * of EvaluateValueAndDerivativeAtContinuousIndex() for the spline orders 1,
+ * 2 and 3, for the dimension of the image. The separable weights and their
+ * derivatives are computed once per dimension, in closed form. The (order+1)^D
+ * coefficients of the support, 64 for a cubic spline in 3D, are gathered in a
+ * contiguous array, after which the value and all derivatives are obtained in
+ * one pass of fixed-length loops, contracting one dimension at a time. These
+ * loops are unrolled and vectorized by the compiler. Other spline orders use
+ * the implementation of the superclass.
+ *
+ * The mirror boundary condition of the superclass is used, so the results
+ * are equal up to rounding.
+ *
+ * Optionally, the specializations read the coefficients from a bricked copy,
+ * in which cubes of BrickSize^D coefficients are contiguous. In a large 3D
+ * image the neighbours along z of a row-major buffer are whole slices apart,
+ * so every evaluation touches (order+1)^2 distant pages. In the bricked copy
+ * the support mostly lies in one or a few bricks. The copy is built when the
+ * input image is set, so once per resolution, and costs the memory of a
+ * second coefficient image.
+ *
+ * Optionally, the specializations read the coefficients from a copy in half
+ * precision, see HalfPrecision, in the bricked or the default layout. This
+ * copy takes a quarter of the memory of double coefficients, so it reduces
+ * the memory traffic of the interpolation, at a relative precision of the
+ * coefficients of 2^-11. The coefficients are converted to double when they
+ * are gathered. In the bricked layout, the half precision copy replaces the
+ * bricked copy. The coefficient image itself is kept, for the evaluations
+ * of the superclass.
+ *
+ * The coefficients are computed by the
+ * MultiThreadedBSplineDecompositionImageFilter, instead of the
+ * single-threaded filter of the superclass.
+ *
+ * With UseCoefficientCache, the coefficients are looked up in the
+ * BSplineCoefficientCache, and stored there when they are computed, so that
+ * interpolators of the same image and spline order, like the interpolator of
+ * the registration and the resample interpolator, compute them only once.
+ *
+ * \sa AdvancedLinearInterpolateImageFunction
+ *
+ * \ingroup ImageFunctions ImageInterpolators
+ */
+template< class TImageType, class TCoordRep = double, class TCoefficientType = double >
+class AdvancedBSplineInterpolateImageFunction :
+  public BSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef AdvancedBSplineInterpolateImageFunction Self;
+  typedef BSplineInterpolateImageFunction<
+    TImageType, TCoordRep, TCoefficientType >     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( AdvancedBSplineInterpolateImageFunction, BSplineInterpolateImageFunction );
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Dimension underlying input image. */
+  itkStaticConstMacro( ImageDimension, unsigned int, Superclass::ImageDimension );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass::OutputType           OutputType;
+  typedef typename Superclass::InputImageType       InputImageType;
+  typedef typename Superclass::IndexType            IndexType;
+  typedef typename Superclass::ContinuousIndexType  ContinuousIndexType;
+  typedef typename Superclass::PointType            PointType;
+  typedef typename Superclass::CoefficientDataType  CoefficientDataType;
+  typedef typename Superclass::CoefficientImageType CoefficientImageType;
+  typedef typename Superclass::CovariantVectorType  CovariantVectorType;
+
+  /** The multi-threaded filter that computes the coefficients. */
+  typedef MultiThreadedBSplineDecompositionImageFilter<
+    TImageType, CoefficientImageType >                            CoefficientFilterType;
+
+  /** The cache of the coefficients. */
+  typedef BSplineCoefficientCache< TImageType, TCoefficientType > CoefficientCacheType;
+
+  /** Set the input image, compute its coefficients multi-threaded, and
+   * build the bricked copy of its coefficients if UseBrickedCoefficients is
+   * true. If UseCoefficientCache is true, the coefficients are taken from
+   * the cache, if they are there.
+   */
+  void SetInputImage( const TImageType * inputData ) override;
+
+  /** Set/Get whether the specializations read the coefficients from a
+   * bricked copy. Rebuilds the copy if the input image is set. The default
+   * is false.
+   */
+  void SetUseBrickedCoefficients( const bool _arg );
+  itkGetConstMacro( UseBrickedCoefficients, bool );
+  itkBooleanMacro( UseBrickedCoefficients );
+
+  /** Set/Get the number of coefficients along each side of a brick. Rebuilds
+   * the bricked copy if there is one. The default is 8.
+   */
+  void SetBrickSize( const unsigned int _arg );
+  itkGetConstMacro( BrickSize, unsigned int );
+
+  /** Set/Get whether the specializations read the coefficients from a copy
+   * in half precision. Rebuilds the copy if the input image is set. The
+   * default is false.
+   */
+  void SetUseHalfPrecisionCoefficients( const bool _arg );
+  itkGetConstMacro( UseHalfPrecisionCoefficients, bool );
+  itkBooleanMacro( UseHalfPrecisionCoefficients );
+
+  /** Set/Get whether SetInputImage() shares the coefficients through the
+   * CoefficientCacheType. Takes effect at the next SetInputImage(). The
+   * default is false.
+   */
+  itkSetMacro( UseCoefficientCache, bool );
+  itkGetConstMacro( UseCoefficientCache, bool );
+  itkBooleanMacro( UseCoefficientCache );
+
+  /** The other overloads of the superclass. */
+  using Superclass::EvaluateValueAndDerivativeAtContinuousIndex;
+
+  /** Method to compute both the value and the derivative. Uses the
+   * specialization for the spline order, if there is one.
+   */
+  void EvaluateValueAndDerivativeAtContinuousIndex(
+    const ContinuousIndexType & x,
+    OutputType & value,
+    CovariantVectorType & deriv ) const
+  {
+    switch( this->GetSplineOrder() )
+    {
+      case 1:
+        return this->EvaluateValueAndDerivativeOptimized< 1 >( x, value, deriv );
+      case 2:
+        return this->EvaluateValueAndDerivativeOptimized< 2 >( x, value, deriv );
+      case 3:
+        return this->EvaluateValueAndDerivativeOptimized< 3 >( x, value, deriv );
+      default:
+        return this->Superclass::EvaluateValueAndDerivativeAtContinuousIndex( x, value, deriv );
+    }
+  }
+
+
+  /** Prefetch the coefficients of the support of x, from the copy that the
+   * specializations read. Does not change the results; it only hides the
+   * memory latency if called well before the evaluation. x needs not be
+   * inside the buffer.
+   */
+  void PrefetchAtContinuousIndex( const ContinuousIndexType & x ) const;
+
+
+protected:
+
+  AdvancedBSplineInterpolateImageFunction();
+  ~AdvancedBSplineInterpolateImageFunction() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  AdvancedBSplineInterpolateImageFunction( const Self & ); // purposely not implemented
+  void operator=( const Self & );                          // purposely not implemented
+
+  /** Build the bricked copy and the half precision copy of the
+   * coefficients, or release them if they are not used.
+   */
+  void UpdateCoefficientCopies( void );
+
+  /** The number of points of the support, (order+1)^D. */
+  static constexpr unsigned int GetSupportSize(
+    const unsigned int width, const unsigned int dimension )
+  {
+    return dimension == 0 ? 1 : width * GetSupportSize( width, dimension - 1 );
+  }
+
+
+  /** Compute the first index of the support along a dimension, and the
+   * weights and their derivatives, for a spline order of 1, 2 or 3.
+   */
+  template< unsigned int VSplineOrder >
+  static void ComputeWeights( const double x, IndexValueType & startIndex,
+    double * weights, double * derivativeWeights );
+
+  /** Method to compute both the value and the derivative, for a fixed
+   * spline order.
+   */
+  template< unsigned int VSplineOrder >
+  void EvaluateValueAndDerivativeOptimized(
+    const ContinuousIndexType & x,
+    OutputType & value,
+    CovariantVectorType & deriv ) const;
+
+  bool         m_UseBrickedCoefficients;
+  unsigned int m_BrickSize;
+  bool         m_UseCoefficientCache;
+  bool         m_UseHalfPrecisionCoefficients;
+
+  /** The bricked copy of the coefficients, and for each dimension the offset
+   * in this copy of each index, relative to the start of the buffered region.
+   * The offset of an index is the sum of the offsets of its components.
+   */
+  std::vector< CoefficientDataType > m_BrickedCoefficients;
+  std::vector< OffsetValueType >     m_BrickedOffsets[ ImageDimension ];
+
+  /** The half precision copy of the coefficients, in the layout of the
+   * bricked copy if there are bricked offsets, and of the coefficient image
+   * otherwise.
+   */
+  std::vector< HalfPrecision::HalfType > m_HalfPrecisionCoefficients;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkAdvancedBSplineInterpolateImageFunction.hxx"
+#endif
+
+#endif // end #ifndef __itkAdvancedBSplineInterpolateImageFunction_h
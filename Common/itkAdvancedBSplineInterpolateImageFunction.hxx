@@ -0,0 +1,580 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAdvancedBSplineInterpolateImageFunction_hxx
+#define __itkAdvancedBSplineInterpolateImageFunction_hxx
+
+#include "itkAdvancedBSplineInterpolateImageFunction.h"
+
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkMath.h"
+#include <algorithm>
+
+namespace itk
+{
+
+/**
+ * ***************** Constructor ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::AdvancedBSplineInterpolateImageFunction()
+{
+  this->m_UseBrickedCoefficients       = false;
+  this->m_BrickSize                    = 8;
+  this->m_UseCoefficientCache          = false;
+  this->m_UseHalfPrecisionCoefficients = false;
+
+} // end Constructor
+
+
+/**
+ * ***************** SetInputImage ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::SetInputImage( const TImageType * inputData )
+{
+  if( inputData == nullptr )
+  {
+    this->Superclass::SetInputImage( inputData );
+    this->UpdateCoefficientCopies();
+    return;
+  }
+
+  /** Look up the coefficients, or compute them with the multi-threaded
+   * filter, instead of the single-threaded filter of the superclass. The
+   * output of our filter is disconnected, so it can be shared.
+   */
+  typename CoefficientCacheType::Pointer      cache;
+  typename CoefficientCacheType::KeyType      key = 0;
+  typename CoefficientImageType::ConstPointer coefficients;
+  if( this->m_UseCoefficientCache )
+  {
+    cache        = CoefficientCacheType::GetInstance();
+    key          = CoefficientCacheType::ComputeKey( inputData, this->GetSplineOrder() );
+    coefficients = cache->Find( key );
+  }
+  if( coefficients.IsNull() )
+  {
+    typename CoefficientFilterType::Pointer filter = CoefficientFilterType::New();
+    filter->SetSplineOrder( this->GetSplineOrder() );
+    filter->SetInput( inputData );
+    filter->Update();
+    typename CoefficientImageType::Pointer output = filter->GetOutput();
+    output->DisconnectPipeline();
+    if( this->m_UseCoefficientCache )
+    {
+      cache->Insert( key, output );
+    }
+    coefficients = output;
+  }
+
+  /** Do what the superclass does after computing the coefficients. */
+  this->m_Coefficients = coefficients;
+  this->Superclass::Superclass::SetInputImage( inputData );
+  this->m_DataLength = inputData->GetBufferedRegion().GetSize();
+  this->UpdateCoefficientCopies();
+
+} // end SetInputImage()
+
+
+/**
+ * ***************** SetUseBrickedCoefficients ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::SetUseBrickedCoefficients( const bool _arg )
+{
+  if( this->m_UseBrickedCoefficients != _arg )
+  {
+    this->m_UseBrickedCoefficients = _arg;
+    this->UpdateCoefficientCopies();
+    this->Modified();
+  }
+
+} // end SetUseBrickedCoefficients()
+
+
+/**
+ * ***************** SetUseHalfPrecisionCoefficients ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::SetUseHalfPrecisionCoefficients( const bool _arg )
+{
+  if( this->m_UseHalfPrecisionCoefficients != _arg )
+  {
+    this->m_UseHalfPrecisionCoefficients = _arg;
+    this->UpdateCoefficientCopies();
+    this->Modified();
+  }
+
+} // end SetUseHalfPrecisionCoefficients()
+
+
+/**
+ * ***************** SetBrickSize ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::SetBrickSize( const unsigned int _arg )
+{
+  if( _arg == 0 )
+  {
+    itkExceptionMacro( << "ERROR: the BrickSize should be larger than 0." );
+  }
+  if( this->m_BrickSize != _arg )
+  {
+    this->m_BrickSize = _arg;
+    this->UpdateCoefficientCopies();
+    this->Modified();
+  }
+
+} // end SetBrickSize()
+
+
+/**
+ * ***************** UpdateCoefficientCopies ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::UpdateCoefficientCopies( void )
+{
+  std::vector< CoefficientDataType >().swap( this->m_BrickedCoefficients );
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    std::vector< OffsetValueType >().swap( this->m_BrickedOffsets[ d ] );
+  }
+  std::vector< HalfPrecision::HalfType >().swap( this->m_HalfPrecisionCoefficients );
+  if( this->m_Coefficients.IsNull() )
+  {
+    return;
+  }
+  if( !this->m_UseBrickedCoefficients )
+  {
+    if( this->m_UseHalfPrecisionCoefficients )
+    {
+      const CoefficientDataType * buffer = this->m_Coefficients->GetBufferPointer();
+      const SizeValueType numberOfCoefficients
+        = this->m_Coefficients->GetBufferedRegion().GetNumberOfPixels();
+      this->m_HalfPrecisionCoefficients.resize( numberOfCoefficients );
+      for( SizeValueType i = 0; i < numberOfCoefficients; ++i )
+      {
+        this->m_HalfPrecisionCoefficients[ i ]
+          = HalfPrecision::FromFloat( static_cast< float >( buffer[ i ] ) );
+      }
+    }
+    return;
+  }
+
+  typedef typename CoefficientImageType::RegionType RegionType;
+  const RegionType & region = this->m_Coefficients->GetBufferedRegion();
+
+  /** The bricks follow each other in row-major order, and so do the
+   * coefficients within a brick. The bricks at the end of a row are padded.
+   */
+  const OffsetValueType brickSize   = static_cast< OffsetValueType >( this->m_BrickSize );
+  OffsetValueType       localStride = 1;
+  OffsetValueType       brickStride = 1;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    brickStride *= brickSize;
+  }
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    const OffsetValueType size           = static_cast< OffsetValueType >( region.GetSize( d ) );
+    const OffsetValueType numberOfBricks = ( size + brickSize - 1 ) / brickSize;
+
+    this->m_BrickedOffsets[ d ].resize( size );
+    for( OffsetValueType i = 0; i < size; ++i )
+    {
+      this->m_BrickedOffsets[ d ][ i ] = ( i / brickSize ) * brickStride + ( i % brickSize ) * localStride;
+    }
+    localStride *= brickSize;
+    brickStride *= numberOfBricks;
+  }
+
+  /** Copy the coefficients. */
+  this->m_BrickedCoefficients.resize( brickStride );
+  const IndexType & start = region.GetIndex();
+  ImageRegionConstIteratorWithIndex< CoefficientImageType > it( this->m_Coefficients, region );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const IndexType & index  = it.GetIndex();
+    OffsetValueType   offset = 0;
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      offset += this->m_BrickedOffsets[ d ][ index[ d ] - start[ d ] ];
+    }
+    this->m_BrickedCoefficients[ offset ] = it.Get();
+  }
+
+  /** Replace the bricked copy by its half precision version. The padding is
+   * zero in both.
+   */
+  if( this->m_UseHalfPrecisionCoefficients )
+  {
+    this->m_HalfPrecisionCoefficients.resize( this->m_BrickedCoefficients.size() );
+    for( SizeValueType i = 0; i < this->m_BrickedCoefficients.size(); ++i )
+    {
+      this->m_HalfPrecisionCoefficients[ i ]
+        = HalfPrecision::FromFloat( static_cast< float >( this->m_BrickedCoefficients[ i ] ) );
+    }
+    std::vector< CoefficientDataType >().swap( this->m_BrickedCoefficients );
+  }
+
+} // end UpdateCoefficientCopies()
+
+
+/**
+ * ***************** ComputeWeights ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+template< unsigned int VSplineOrder >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::ComputeWeights( const double x, IndexValueType & startIndex,
+  double * weights, double * derivativeWeights )
+{
+  /** The same support as the superclass: for odd orders it starts at
+   * floor( x ) - order / 2, for even orders at floor( x + 0.5 ) - order / 2.
+   */
+  if( VSplineOrder == 1 )
+  {
+    startIndex = Math::Floor< IndexValueType >( x );
+    const double t = x - static_cast< double >( startIndex );
+
+    weights[ 0 ]           = 1.0 - t;
+    weights[ 1 ]           = t;
+    derivativeWeights[ 0 ] = -1.0;
+    derivativeWeights[ 1 ] = 1.0;
+  }
+  else if( VSplineOrder == 2 )
+  {
+    startIndex = Math::Floor< IndexValueType >( x + 0.5 ) - 1;
+    const double t  = x - static_cast< double >( startIndex + 1 );
+    const double tm = 0.5 - t;
+    const double tp = 0.5 + t;
+
+    weights[ 0 ]           = 0.5 * tm * tm;
+    weights[ 1 ]           = 0.75 - t * t;
+    weights[ 2 ]           = 0.5 * tp * tp;
+    derivativeWeights[ 0 ] = -tm;
+    derivativeWeights[ 1 ] = -2.0 * t;
+    derivativeWeights[ 2 ] = tp;
+  }
+  else if( VSplineOrder == 3 )
+  {
+    startIndex = Math::Floor< IndexValueType >( x ) - 1;
+    const double t  = x - static_cast< double >( startIndex + 1 );
+    const double t2 = t * t;
+    const double tm = 1.0 - t;
+
+    weights[ 0 ]           = tm * tm * tm / 6.0;
+    weights[ 1 ]           = ( 4.0 - 6.0 * t2 + 3.0 * t2 * t ) / 6.0;
+    weights[ 2 ]           = ( 1.0 + 3.0 * t + 3.0 * t2 - 3.0 * t2 * t ) / 6.0;
+    weights[ 3 ]           = t2 * t / 6.0;
+    derivativeWeights[ 0 ] = -0.5 * tm * tm;
+    derivativeWeights[ 1 ] = 1.5 * t2 - 2.0 * t;
+    derivativeWeights[ 2 ] = 0.5 + t - 1.5 * t2;
+    derivativeWeights[ 3 ] = 0.5 * t2;
+  }
+
+} // end ComputeWeights()
+
+
+/**
+ * ***************** EvaluateValueAndDerivativeOptimized ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+template< unsigned int VSplineOrder >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::EvaluateValueAndDerivativeOptimized(
+  const ContinuousIndexType & x,
+  OutputType & value,
+  CovariantVectorType & deriv ) const
+{
+  const unsigned int Width       = VSplineOrder + 1;
+  const unsigned int SupportSize = GetSupportSize( Width, ImageDimension );
+
+  const CoefficientImageType * coefficients = this->m_Coefficients;
+  const bool                   bricked      = !this->m_BrickedOffsets[ 0 ].empty();
+  const CoefficientDataType *  buffer       = bricked
+    ? this->m_BrickedCoefficients.data() : coefficients->GetBufferPointer();
+  const OffsetValueType * offsetTable = coefficients->GetOffsetTable();
+  const IndexType &       bufferStart = coefficients->GetBufferedRegion().GetIndex();
+
+  /** Compute the separable weights, and the buffer offsets of the support
+   * along each dimension, with the mirror boundary condition of the superclass.
+   */
+  double          weights[ ImageDimension ][ Width ];
+  double          derivativeWeights[ ImageDimension ][ Width ];
+  OffsetValueType offsets[ ImageDimension ][ Width ];
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    IndexValueType startIndex;
+    ComputeWeights< VSplineOrder >( x[ d ], startIndex, weights[ d ], derivativeWeights[ d ] );
+
+    const IndexValueType firstIndex = this->m_StartIndex[ d ];
+    const IndexValueType lastIndex  = this->m_EndIndex[ d ];
+    for( unsigned int k = 0; k < Width; ++k )
+    {
+      IndexValueType index = startIndex + static_cast< IndexValueType >( k );
+      if( this->m_DataLength[ d ] == 1 )
+      {
+        index = firstIndex;
+      }
+      else
+      {
+        if( index < firstIndex )
+        {
+          index = 2 * firstIndex - index;
+        }
+        if( index >= lastIndex )
+        {
+          index = 2 * lastIndex - index;
+        }
+      }
+      offsets[ d ][ k ] = bricked
+        ? this->m_BrickedOffsets[ d ][ index - bufferStart[ d ] ]
+        : ( index - bufferStart[ d ] ) * offsetTable[ d ];
+    }
+  }
+
+  /** Expand the offsets to the whole support, with the first dimension
+   * running fastest, and gather the coefficients in a contiguous array.
+   */
+  OffsetValueType supportOffsets[ SupportSize ];
+  supportOffsets[ 0 ] = 0;
+  unsigned int numberOfOffsets = 1;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    for( unsigned int k = Width; k-- > 0; )
+    {
+      for( unsigned int p = 0; p < numberOfOffsets; ++p )
+      {
+        supportOffsets[ k * numberOfOffsets + p ] = supportOffsets[ p ] + offsets[ d ][ k ];
+      }
+    }
+    numberOfOffsets *= Width;
+  }
+
+  double support[ SupportSize ];
+  if( !this->m_HalfPrecisionCoefficients.empty() )
+  {
+    const HalfPrecision::HalfType * halfBuffer = this->m_HalfPrecisionCoefficients.data();
+    for( unsigned int p = 0; p < SupportSize; ++p )
+    {
+      support[ p ] = static_cast< double >( HalfPrecision::ToFloat( halfBuffer[ supportOffsets[ p ] ] ) );
+    }
+  }
+  else
+  {
+    for( unsigned int p = 0; p < SupportSize; ++p )
+    {
+      support[ p ] = static_cast< double >( buffer[ supportOffsets[ p ] ] );
+    }
+  }
+
+  /** Contract the first dimension: every line of Width coefficients gives
+   * a value and a derivative in that dimension.
+   */
+  double       partial[ ImageDimension + 1 ][ SupportSize / Width ];
+  unsigned int numberOfLines = SupportSize / Width;
+  for( unsigned int line = 0; line < numberOfLines; ++line )
+  {
+    const double * lineSupport = support + line * Width;
+    double         sumValue    = 0.0;
+    double         sumDeriv    = 0.0;
+    for( unsigned int k = 0; k < Width; ++k )
+    {
+      sumValue += weights[ 0 ][ k ] * lineSupport[ k ];
+      sumDeriv += derivativeWeights[ 0 ][ k ] * lineSupport[ k ];
+    }
+    partial[ 0 ][ line ] = sumValue;
+    partial[ 1 ][ line ] = sumDeriv;
+  }
+
+  /** Contract the other dimensions one by one, in place. The values and the
+   * derivatives of the previous dimensions are smoothed with the weights,
+   * the derivative of the current dimension is the values times the
+   * derivative weights. Line l only reads the entries l * Width and up,
+   * so it overwrites nothing that is still needed.
+   */
+  for( unsigned int d = 1; d < ImageDimension; ++d )
+  {
+    numberOfLines /= Width;
+    for( unsigned int line = 0; line < numberOfLines; ++line )
+    {
+      double sums[ ImageDimension + 1 ];
+      for( unsigned int j = 0; j <= d; ++j )
+      {
+        const double * linePartial = partial[ j ] + line * Width;
+        double         sum         = 0.0;
+        for( unsigned int k = 0; k < Width; ++k )
+        {
+          sum += weights[ d ][ k ] * linePartial[ k ];
+        }
+        sums[ j ] = sum;
+      }
+      const double * lineValues = partial[ 0 ] + line * Width;
+      double         sumDeriv   = 0.0;
+      for( unsigned int k = 0; k < Width; ++k )
+      {
+        sumDeriv += derivativeWeights[ d ][ k ] * lineValues[ k ];
+      }
+      for( unsigned int j = 0; j <= d; ++j )
+      {
+        partial[ j ][ line ] = sums[ j ];
+      }
+      partial[ d + 1 ][ line ] = sumDeriv;
+    }
+  }
+
+  /** Convert the derivative from index space to physical space. */
+  const typename InputImageType::SpacingType & spacing = this->GetInputImage()->GetSpacing();
+  value = static_cast< OutputType >( partial[ 0 ][ 0 ] );
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    deriv[ d ] = static_cast< OutputType >( partial[ d + 1 ][ 0 ] / spacing[ d ] );
+  }
+
+  if( this->GetUseImageDirection() )
+  {
+    CovariantVectorType orientedDerivative;
+    this->GetInputImage()->TransformLocalVectorToPhysicalVector( deriv, orientedDerivative );
+    deriv = orientedDerivative;
+  }
+
+} // end EvaluateValueAndDerivativeOptimized()
+
+
+/**
+ * ***************** PrefetchAtContinuousIndex ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::PrefetchAtContinuousIndex( const ContinuousIndexType & x ) const
+{
+  /** The specializations only exist up to order 3. */
+  const unsigned int splineOrder = this->GetSplineOrder();
+  if( splineOrder < 1 || splineOrder > 3 )
+  {
+    return;
+  }
+  const unsigned int width = splineOrder + 1;
+
+  const CoefficientImageType * coefficients = this->m_Coefficients;
+  const bool                   bricked      = !this->m_BrickedOffsets[ 0 ].empty();
+  const OffsetValueType *      offsetTable  = coefficients->GetOffsetTable();
+  const IndexType &            bufferStart  = coefficients->GetBufferedRegion().GetIndex();
+
+  /** The buffer offsets of the support along each dimension, with the
+   * indices clamped to the buffer instead of mirrored.
+   */
+  const double    shift = ( splineOrder % 2 == 0 ) ? 0.5 : 0.0;
+  OffsetValueType offsets[ ImageDimension ][ 4 ];
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    const IndexValueType startIndex = Math::Floor< IndexValueType >( x[ d ] + shift )
+      - static_cast< IndexValueType >( splineOrder / 2 );
+    for( unsigned int k = 0; k < width; ++k )
+    {
+      const IndexValueType index = std::min( std::max( startIndex + static_cast< IndexValueType >( k ),
+        this->m_StartIndex[ d ] ), this->m_EndIndex[ d ] );
+      offsets[ d ][ k ] = bricked
+        ? this->m_BrickedOffsets[ d ][ index - bufferStart[ d ] ]
+        : ( index - bufferStart[ d ] ) * offsetTable[ d ];
+    }
+  }
+
+  /** Prefetch the first and the last coefficient of each line of the
+   * support along the first dimension, which covers its cache lines.
+   */
+  unsigned int numberOfLines = 1;
+  for( unsigned int d = 1; d < ImageDimension; ++d )
+  {
+    numberOfLines *= width;
+  }
+  for( unsigned int line = 0; line < numberOfLines; ++line )
+  {
+    OffsetValueType offset = 0;
+    unsigned int    rest   = line;
+    for( unsigned int d = 1; d < ImageDimension; ++d )
+    {
+      offset += offsets[ d ][ rest % width ];
+      rest   /= width;
+    }
+    for( unsigned int k = 0; k < width; k += width - 1 )
+    {
+      if( !this->m_HalfPrecisionCoefficients.empty() )
+      {
+        MemoryPrefetch::Read( this->m_HalfPrecisionCoefficients.data() + offset + offsets[ 0 ][ k ] );
+      }
+      else if( bricked )
+      {
+        MemoryPrefetch::Read( this->m_BrickedCoefficients.data() + offset + offsets[ 0 ][ k ] );
+      }
+      else
+      {
+        MemoryPrefetch::Read( coefficients->GetBufferPointer() + offset + offsets[ 0 ][ k ] );
+      }
+    }
+  }
+
+} // end PrefetchAtContinuousIndex()
+
+
+/**
+ * ***************** PrintSelf ***********************
+ */
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+AdvancedBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "UseBrickedCoefficients: " << this->m_UseBrickedCoefficients << std::endl;
+  os << indent << "BrickSize: " << this->m_BrickSize << std::endl;
+  os << indent << "UseCoefficientCache: " << this->m_UseCoefficientCache << std::endl;
+  os << indent << "UseHalfPrecisionCoefficients: " << this->m_UseHalfPrecisionCoefficients << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkAdvancedBSplineInterpolateImageFunction_hxx
@@ -19,6 +19,9 @@
 #define __itkAdvancedLinearInterpolateImageFunction_h
 
 #include "itkLinearInterpolateImageFunction.h"
+#include "itkMemoryPrefetch.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -50,6 +53,13 @@ namespace itk
  * We opt to subtract a small number from x, which is computationally efficient,
  * gives cleaner code, and almost exactly the same interpolated value.
  *
+ * Optionally, the derivative is not the derivative of the linear
+ * interpolant, but a linear interpolation of a central difference gradient
+ * image. This gradient image is computed multi-threaded when the input image
+ * is set, so once per resolution, and is stored as one float buffer per
+ * dimension. The value and the gradient are then interpolated in one pass
+ * over the corners, with the same weights and buffer offsets.
+ *
  * \sa VectorAdvancedLinearInterpolateImageFunction
  *
  * \ingroup ImageFunctions ImageInterpolators
@@ -108,17 +118,42 @@ public:
   CovariantVectorType EvaluateDerivativeAtContinuousIndex(
     const ContinuousIndexType & x ) const;
 
+  /** Set the input image, and compute its gradient image if
+   * UseGradientImage is true.
+   */
+  void SetInputImage( const InputImageType * ptr ) override;
+
+  /** Set/Get whether EvaluateValueAndDerivativeAtContinuousIndex()
+   * interpolates a precomputed central difference gradient image. Recomputes
+   * the gradient image if the input image is set. The default is false.
+   */
+  void SetUseGradientImage( const bool _arg );
+  itkGetConstMacro( UseGradientImage, bool );
+  itkBooleanMacro( UseGradientImage );
+
   /** Method to compute both the value and the derivative. */
   void EvaluateValueAndDerivativeAtContinuousIndex(
     const ContinuousIndexType & x,
     OutputType & value,
     CovariantVectorType & deriv ) const
   {
+    if( !this->m_GradientImage.empty() )
+    {
+      return this->EvaluateValueAndDerivativeWithGradientImage( x, value, deriv );
+    }
     return this->EvaluateValueAndDerivativeOptimized(
       Dispatch< ImageDimension >(), x, value, deriv );
   }
 
 
+  /** Prefetch the pixels, and the gradient image pixels if there are any,
+   * that EvaluateValueAndDerivativeAtContinuousIndex() reads at x. Does
+   * not change the results; it only hides the memory latency if called well
+   * before the evaluation. x needs not be inside the buffer.
+   */
+  void PrefetchAtContinuousIndex( const ContinuousIndexType & x ) const;
+
+
 protected:
 
   AdvancedLinearInterpolateImageFunction();
@@ -171,6 +206,39 @@ private:
   }
 
 
+  /** Method to compute both the value and the derivative, from the image
+   * and the gradient image.
+   */
+  void EvaluateValueAndDerivativeWithGradientImage(
+    const ContinuousIndexType & x,
+    OutputType & value,
+    CovariantVectorType & deriv ) const;
+
+  /** Compute the gradient image, or release it if UseGradientImage is false. */
+  void UpdateGradientImage( void );
+
+  /** The data passed to the threads by UpdateGradientImage(). */
+  struct GradientThreaderParameterType
+  {
+    const InputImageType * m_Image;
+    float *                m_GradientImage;
+    SizeValueType          m_NumberOfLines;
+    SizeValueType          m_LinesPerWorkUnit;
+  };
+
+  /** Compute the gradient image on the lines along the first dimension of
+   * one work unit.
+   */
+  static ITK_THREAD_RETURN_TYPE GradientThreaderCallback( void * arg );
+
+  bool m_UseGradientImage;
+
+  /** The gradient image, with respect to the image grid and divided by the
+   * spacing. Component d of pixel p is at d * N + p, with N the number of
+   * pixels of the buffered region.
+   */
+  std::vector< float > m_GradientImage;
+
 };
 
 } // end namespace itk
@@ -19,9 +19,12 @@
 #define __itkAdvancedLinearInterpolateImageFunction_hxx
 
 #include "itkAdvancedLinearInterpolateImageFunction.h"
+#include "itkPersistentThreadPool.h"
 
 #include "vnl/vnl_math.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
@@ -32,7 +35,299 @@ namespace itk
 template< class TInputImage, class TCoordRep >
 AdvancedLinearInterpolateImageFunction< TInputImage, TCoordRep >
 ::AdvancedLinearInterpolateImageFunction()
-{}
+{
+  this->m_UseGradientImage = false;
+}
+
+
+/**
+ * ***************** SetInputImage ***********************
+ */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedLinearInterpolateImageFunction< TInputImage, TCoordRep >
+::SetInputImage( const InputImageType * ptr )
+{
+  this->Superclass::SetInputImage( ptr );
+  this->UpdateGradientImage();
+
+} // end SetInputImage()
+
+
+/**
+ * ***************** SetUseGradientImage ***********************
+ */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedLinearInterpolateImageFunction< TInputImage, TCoordRep >
+::SetUseGradientImage( const bool _arg )
+{
+  if( this->m_UseGradientImage != _arg )
+  {
+    this->m_UseGradientImage = _arg;
+    this->UpdateGradientImage();
+    this->Modified();
+  }
+
+} // end SetUseGradientImage()
+
+
+/**
+ * ***************** UpdateGradientImage ***********************
+ */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedLinearInterpolateImageFunction< TInputImage, TCoordRep >
+::UpdateGradientImage( void )
+{
+  const InputImageType * inputImage = this->GetInputImage();
+  if( !this->m_UseGradientImage || inputImage == nullptr )
+  {
+    std::vector< float >().swap( this->m_GradientImage );
+    return;
+  }
+
+  const typename InputImageType::SizeType & size
+    = inputImage->GetBufferedRegion().GetSize();
+  const SizeValueType numberOfPixels = inputImage->GetBufferedRegion().GetNumberOfPixels();
+  this->m_GradientImage.resize( ImageDimension * numberOfPixels );
+
+  /** The lines along the first dimension are divided over the work units. */
+  const PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+  const SizeValueType numberOfLines     = numberOfPixels / size[ 0 ];
+  const ThreadIdType  numberOfWorkUnits = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( pool->GetMaximumNumberOfThreads(), numberOfLines ) ) );
+
+  GradientThreaderParameterType temp;
+  temp.m_Image            = inputImage;
+  temp.m_GradientImage    = this->m_GradientImage.data();
+  temp.m_NumberOfLines    = numberOfLines;
+  temp.m_LinesPerWorkUnit = ( numberOfLines + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+
+  pool->SingleMethodExecute( numberOfWorkUnits, Self::GradientThreaderCallback, &temp );
+
+} // end UpdateGradientImage()
+
+
+/**
+ * ***************** GradientThreaderCallback ***********************
+ */
+
+template< class TInputImage, class TCoordRep >
+ITK_THREAD_RETURN_TYPE
+AdvancedLinearInterpolateImageFunction< TInputImage, TCoordRep >
+::GradientThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const GradientThreaderParameterType * temp
+    = static_cast< GradientThreaderParameterType * >( infoStruct->UserData );
+
+  const SizeValueType begin = std::min( infoStruct->WorkUnitID * temp->m_LinesPerWorkUnit, temp->m_NumberOfLines );
+  const SizeValueType end   = std::min( begin + temp->m_LinesPerWorkUnit, temp->m_NumberOfLines );
+
+  const InputImageType * inputImage = temp->m_Image;
+  const typename InputImageType::SizeType & size
+    = inputImage->GetBufferedRegion().GetSize();
+  const SizeValueType     numberOfPixels = inputImage->GetBufferedRegion().GetNumberOfPixels();
+  const InputPixelType *  buffer         = inputImage->GetBufferPointer();
+  const OffsetValueType * offsetTable    = inputImage->GetOffsetTable();
+
+  /** Central differences, with a zero flux boundary condition like the
+   * GradientImageFilter.
+   */
+  double scale[ ImageDimension ];
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    scale[ dim ] = 0.5 / inputImage->GetSpacing()[ dim ];
+  }
+
+  for( SizeValueType line = begin; line < end; ++line )
+  {
+    /** The index of the line in the other dimensions. */
+    IndexValueType lineIndex[ ImageDimension ];
+    SizeValueType  rest = line;
+    lineIndex[ 0 ] = 0;
+    for( unsigned int dim = 1; dim < ImageDimension; dim++ )
+    {
+      lineIndex[ dim ] = static_cast< IndexValueType >( rest % size[ dim ] );
+      rest            /= size[ dim ];
+    }
+
+    const OffsetValueType lineOffset = static_cast< OffsetValueType >( line * size[ 0 ] );
+    for( SizeValueType i = 0; i < size[ 0 ]; ++i )
+    {
+      lineIndex[ 0 ] = static_cast< IndexValueType >( i );
+      const OffsetValueType offset = lineOffset + static_cast< OffsetValueType >( i );
+      for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+      {
+        const OffsetValueType up = ( lineIndex[ dim ] + 1 < static_cast< IndexValueType >( size[ dim ] ) )
+          ? offsetTable[ dim ] : 0;
+        const OffsetValueType down = ( lineIndex[ dim ] > 0 ) ? offsetTable[ dim ] : 0;
+        temp->m_GradientImage[ dim * numberOfPixels + offset ] = static_cast< float >( scale[ dim ]
+          * ( static_cast< double >( buffer[ offset + up ] ) - static_cast< double >( buffer[ offset - down ] ) ) );
+      }
+    }
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end GradientThreaderCallback()
+
+
+/**
+ * ***************** EvaluateValueAndDerivativeWithGradientImage ***********************
+ */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedLinearInterpolateImageFunction< TInputImage, TCoordRep >
+::EvaluateValueAndDerivativeWithGradientImage(
+  const ContinuousIndexType & x,
+  OutputType & value,
+  CovariantVectorType & deriv ) const
+{
+  // Get some handles
+  const InputImageType *  inputImage     = this->GetInputImage();
+  const InputPixelType *  buffer         = inputImage->GetBufferPointer();
+  const OffsetValueType * offsetTable    = inputImage->GetOffsetTable();
+  const SizeValueType     numberOfPixels = inputImage->GetBufferedRegion().GetNumberOfPixels();
+
+  /** Create a possibly mirrored version of x. The gradient at a mirrored
+   * position changes sign in the mirrored dimension.
+   */
+  ContinuousIndexType xm = x;
+  double              deriv_sign[ ImageDimension ];
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    deriv_sign[ dim ] = 1.0;
+    if( x[ dim ] < this->m_StartIndex[ dim ] )
+    {
+      xm[ dim ]          = 2.0 * this->m_StartIndex[ dim ] - x[ dim ];
+      deriv_sign[ dim ] *= -1.0;
+    }
+    if( x[ dim ] > this->m_EndIndex[ dim ] )
+    {
+      xm[ dim ]          = 2.0 * this->m_EndIndex[ dim ] - x[ dim ];
+      deriv_sign[ dim ] *= -1.0;
+    }
+
+    /** Separately deal with cases on the image edge. */
+    if( Math::FloatAlmostEqual( xm[ dim ], static_cast< ContinuousIndexValueType >( this->m_EndIndex[ dim ] ) ) )
+    {
+      xm[ dim ] -= 0.000001;
+    }
+  }
+
+  /**
+   * Compute base index = closest index below point
+   * Compute distance from point to base index
+   */
+  IndexType baseIndex;
+  double    dist[ ImageDimension ];
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    baseIndex[ dim ] = Math::Floor< IndexValueType >( xm[ dim ] );
+    dist[ dim ]      = xm[ dim ] - static_cast< double >( baseIndex[ dim ] );
+  }
+  const OffsetValueType baseOffset = inputImage->ComputeOffset( baseIndex );
+
+  /** Interpolate the value and the gradient with the same weights and
+   * offsets of the 2^D corners.
+   */
+  double interpolated = 0.0;
+  double gradient[ ImageDimension ];
+  std::fill_n( gradient, ImageDimension, 0.0 );
+  for( unsigned int corner = 0; corner < ( 1u << ImageDimension ); corner++ )
+  {
+    double          weight = 1.0;
+    OffsetValueType offset = baseOffset;
+    for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+    {
+      if( corner & ( 1u << dim ) )
+      {
+        weight *= dist[ dim ];
+        offset += offsetTable[ dim ];
+      }
+      else
+      {
+        weight *= 1.0 - dist[ dim ];
+      }
+    }
+
+    interpolated += weight * static_cast< double >( buffer[ offset ] );
+    for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+    {
+      gradient[ dim ] += weight * this->m_GradientImage[ dim * numberOfPixels + offset ];
+    }
+  }
+
+  value = static_cast< OutputType >( interpolated );
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    deriv[ dim ] = static_cast< OutputType >( deriv_sign[ dim ] * gradient[ dim ] );
+  }
+
+  /** Take direction cosines into account. */
+  CovariantVectorType orientedDerivative;
+  inputImage->TransformLocalVectorToPhysicalVector( deriv, orientedDerivative );
+  deriv = orientedDerivative;
+
+} // end EvaluateValueAndDerivativeWithGradientImage()
+
+
+/**
+ * ***************** PrefetchAtContinuousIndex ***********************
+ */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedLinearInterpolateImageFunction< TInputImage, TCoordRep >
+::PrefetchAtContinuousIndex( const ContinuousIndexType & x ) const
+{
+  const InputImageType *  inputImage  = this->GetInputImage();
+  const InputPixelType *  buffer      = inputImage->GetBufferPointer();
+  const OffsetValueType * offsetTable = inputImage->GetOffsetTable();
+
+  /** The base index, clamped to the buffer instead of mirrored: the
+   * corners are then the same, or close, for the points that matter.
+   */
+  IndexType baseIndex;
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    const IndexValueType index = Math::Floor< IndexValueType >( x[ dim ] );
+    baseIndex[ dim ] = std::min( std::max( index, this->m_StartIndex[ dim ] ),
+      std::max( this->m_EndIndex[ dim ] - 1, this->m_StartIndex[ dim ] ) );
+  }
+  const OffsetValueType baseOffset = inputImage->ComputeOffset( baseIndex );
+
+  /** The two corners along the first dimension are adjacent in memory, so
+   * only the 2^(D-1) lines along the first dimension are prefetched.
+   */
+  const SizeValueType numberOfPixels = inputImage->GetBufferedRegion().GetNumberOfPixels();
+  for( unsigned int line = 0; line < ( 1u << ( ImageDimension - 1 ) ); line++ )
+  {
+    OffsetValueType offset = baseOffset;
+    for( unsigned int dim = 1; dim < ImageDimension; dim++ )
+    {
+      if( ( line & ( 1u << ( dim - 1 ) ) ) && baseIndex[ dim ] < this->m_EndIndex[ dim ] )
+      {
+        offset += offsetTable[ dim ];
+      }
+    }
+    MemoryPrefetch::ReadRange( buffer + offset, buffer + offset + 2 );
+    for( unsigned int dim = 0; dim < ImageDimension && !this->m_GradientImage.empty(); dim++ )
+    {
+      const float * gradient = this->m_GradientImage.data() + dim * numberOfPixels + offset;
+      MemoryPrefetch::ReadRange( gradient, gradient + 2 );
+    }
+  }
+
+} // end PrefetchAtContinuousIndex()
+
 
 /**
  * ***************** EvaluateDerivativeAtContinuousIndex ***********************
@@ -38,6 +38,8 @@ PURPOSE.  See the above copyright notices for more information.
 #include "itkTransform.h"
 #include "itkVector.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -48,6 +50,16 @@ namespace itk
  * image and uses bilinear interpolation to integrate each plane of
  * voxels traversed.
  *
+ * Planes of voxels that cannot contribute to the integral are skipped:
+ * when the input image and the threshold are set, the image is divided in
+ * bricks of 8x8x8 voxels, and a brick is marked as occupied if a voxel of the
+ * brick, or of the first voxel layer of its neighbours, is above the
+ * threshold. The bilinear interpolation of voxels that are all below the
+ * threshold is below the threshold as well, so the ray does not read the
+ * voxels of unoccupied bricks. The ray ends when it leaves the bounding box
+ * of the voxels above the threshold. The occupancy is not updated when the
+ * intensities of the input image are changed in place.
+ *
  * \warning This interpolator works for 3-dimensional images only.
  *
  * \ingroup ImageFunctions
@@ -130,6 +142,16 @@ public:
    */
   OutputType Evaluate( const PointType & point ) const override;
 
+  /** Interpolate the image at n points, the detector positions of n rays.
+   *
+   * Equals calling Evaluate() for each point, but the focal point is
+   * transformed once, and the volume is set up once for all rays, after
+   * which the rays are traced in the order of the points. Adjacent points
+   * give adjacent rays, that traverse the same voxels.
+   */
+  void EvaluateBatch( const PointType * points, OutputType * values,
+    const SizeValueType n ) const;
+
   /** Interpolate the image at a continuous index position
    *
    * Returns the interpolated image intensity at a
@@ -159,11 +181,16 @@ public:
   /** Get a pointer to the Interpolator.  */
   itkGetConstMacro( FocalPoint, InputPointType );
 
-  /** Connect the Transform. */
-  itkSetMacro( Threshold, double );
-  /** Get a pointer to the Transform.  */
+  /** Set the threshold above which voxels along the ray path are
+   * integrated, and update the occupancy of the bricks.
+   */
+  virtual void SetThreshold( const double threshold );
+  /** Get the threshold. */
   itkGetConstMacro( Threshold, double );
 
+  /** Set the input image, and update the occupancy of the bricks. */
+  void SetInputImage( const TInputImage * ptr ) override;
+
   /** Check if a point is inside the image buffer.
    * \warning For efficiency, no validity checking of
    * the input image pointer is done. */
@@ -213,6 +240,20 @@ private:
   AdvancedRayCastInterpolateImageFunction( const Self & ); // purposely not implemented
   void operator=( const Self & );                          // purposely not implemented
 
+  /** Determine which bricks of the input image contain voxels above the
+   * threshold, and the bounding box of these voxels.
+   */
+  void UpdateOccupancy( void );
+
+  /** For each brick whether it is occupied, the number of bricks along each
+   * dimension, and the first and last index of the voxels above the
+   * threshold.
+   */
+  std::vector< unsigned char > m_OccupiedBricks;
+  int                          m_NumberOfBricks[ 3 ];
+  int                          m_OccupiedStart[ 3 ];
+  int                          m_OccupiedEnd[ 3 ];
+
   SizeType GetRadius() const override
   {
     const InputImageType* const input = this->GetInputImage();
@@ -38,6 +38,8 @@ PURPOSE.  See the above copyright notices for more information.
 
 #include "vnl/vnl_math.h"
 
+#include <algorithm>
+
 // Put the helper class in an anonymous namespace so that it is not
 // exposed to the user
 namespace
@@ -84,6 +86,23 @@ public:
   }
 
 
+  /**
+   * Set the occupancy of the bricks of the image, and the bounding box of
+   * the voxels above the threshold. Without it, every plane is integrated.
+   */
+  void SetOccupancy( const unsigned char * occupiedBricks, const int * numberOfBricks,
+    const int * occupiedStart, const int * occupiedEnd )
+  {
+    m_OccupiedBricks = occupiedBricks;
+    for( unsigned int i = 0; i < 3; i++ )
+    {
+      m_NumberOfBricks[ i ] = numberOfBricks[ i ];
+      m_OccupiedStart[ i ]  = occupiedStart[ i ];
+      m_OccupiedEnd[ i ]    = occupiedEnd[ i ];
+    }
+  }
+
+
   /**
    *  Initialise the ray using the position and direction of a line.
    *
@@ -329,6 +348,15 @@ protected:
   /// The direction of the ray
   double m_RayDirectionInMM[ 3 ];
 
+  /// The occupancy of the bricks of 8x8x8 voxels, or null.
+  const unsigned char * m_OccupiedBricks;
+  /// The number of bricks along each axis.
+  int m_NumberOfBricks[ 3 ];
+  /// The first voxel coordinate of the voxels above the threshold.
+  int m_OccupiedStart[ 3 ];
+  /// The last voxel coordinate of the voxels above the threshold.
+  int m_OccupiedEnd[ 3 ];
+
 };
 
 /* -----------------------------------------------------------------------
@@ -1417,15 +1445,44 @@ RayCastHelper< TInputImage, TCoordRep >
   /* Step along the ray as quickly as possible
      integrating the interpolated intensities. */
 
+  bool enteredBoundingBox = false;
   for( m_NumVoxelPlanesTraversed = 0;
     m_NumVoxelPlanesTraversed < m_TotalRayVoxelPlanes;
     m_NumVoxelPlanesTraversed++ )
   {
-    intensity = this->GetCurrentIntensity();
+    /* Skip the planes of which the four voxels are all at or below the
+       threshold. The voxels of a plane lie in the brick of the first voxel
+       and its first layer of neighbours. */
+
+    bool occupied = true;
+    if( m_OccupiedBricks )
+    {
+      const int * I = m_RayIntersectionVoxelIndex;
+      const bool  insideBoundingBox
+        = ( I[ 0 ] + 1 >= m_OccupiedStart[ 0 ] ) && ( I[ 0 ] <= m_OccupiedEnd[ 0 ] )
+        && ( I[ 1 ] + 1 >= m_OccupiedStart[ 1 ] ) && ( I[ 1 ] <= m_OccupiedEnd[ 1 ] )
+        && ( I[ 2 ] + 1 >= m_OccupiedStart[ 2 ] ) && ( I[ 2 ] <= m_OccupiedEnd[ 2 ] );
+
+      /* The ray is a straight line, so once it has left the bounding box,
+         it does not come back. */
 
-    if( intensity > threshold )
+      if( !insideBoundingBox && enteredBoundingBox )
+      {
+        break;
+      }
+      enteredBoundingBox |= insideBoundingBox;
+      occupied = insideBoundingBox && m_OccupiedBricks[ ( I[ 0 ] >> 3 )
+        + m_NumberOfBricks[ 0 ] * ( ( I[ 1 ] >> 3 ) + m_NumberOfBricks[ 1 ] * ( I[ 2 ] >> 3 ) ) ];
+    }
+
+    if( occupied )
     {
-      integral += intensity - threshold;
+      intensity = this->GetCurrentIntensity();
+
+      if( intensity > threshold )
+      {
+        integral += intensity - threshold;
+      }
     }
     this->IncrementVoxelPointers();
   }
@@ -1494,6 +1551,14 @@ RayCastHelper< TInputImage, TCoordRep >
   {
     m_RayIntersectionVoxelIndex[ i ] = 0;
   }
+
+  m_OccupiedBricks = nullptr;
+  for( i = 0; i < 3; i++ )
+  {
+    m_NumberOfBricks[ i ] = 0;
+    m_OccupiedStart[ i ]  = 0;
+    m_OccupiedEnd[ i ]    = -1;
+  }
 }
 
 
@@ -1524,6 +1589,113 @@ AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
   m_FocalPoint[ 0 ] = 0.;
   m_FocalPoint[ 1 ] = 0.;
   m_FocalPoint[ 2 ] = 0.;
+
+  for( unsigned int i = 0; i < 3; i++ )
+  {
+    m_NumberOfBricks[ i ] = 0;
+    m_OccupiedStart[ i ]  = 0;
+    m_OccupiedEnd[ i ]    = -1;
+  }
+}
+
+
+/* -----------------------------------------------------------------------
+   SetThreshold
+   ----------------------------------------------------------------------- */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
+::SetThreshold( const double threshold )
+{
+  if( m_Threshold != threshold )
+  {
+    m_Threshold = threshold;
+    this->UpdateOccupancy();
+    this->Modified();
+  }
+}
+
+
+/* -----------------------------------------------------------------------
+   SetInputImage
+   ----------------------------------------------------------------------- */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
+::SetInputImage( const TInputImage * ptr )
+{
+  this->Superclass::SetInputImage( ptr );
+  this->UpdateOccupancy();
+}
+
+
+/* -----------------------------------------------------------------------
+   UpdateOccupancy
+   ----------------------------------------------------------------------- */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
+::UpdateOccupancy( void )
+{
+  m_OccupiedBricks.clear();
+  for( unsigned int i = 0; i < 3; i++ )
+  {
+    m_NumberOfBricks[ i ] = 0;
+    m_OccupiedStart[ i ]  = 0;
+    m_OccupiedEnd[ i ]    = -1;
+  }
+  if( this->m_Image.IsNull() )
+  {
+    return;
+  }
+
+  /* The voxels are addressed as in the RayCastHelper. */
+
+  const SizeType size = this->m_Image->GetLargestPossibleRegion().GetSize();
+  const int      nx   = static_cast< int >( size[ 0 ] );
+  const int      ny   = static_cast< int >( size[ 1 ] );
+  const int      nz   = static_cast< int >( size[ 2 ] );
+  for( unsigned int i = 0; i < 3; i++ )
+  {
+    m_NumberOfBricks[ i ] = ( static_cast< int >( size[ i ] ) + 7 ) >> 3;
+    m_OccupiedStart[ i ]  = static_cast< int >( size[ i ] );
+  }
+  m_OccupiedBricks.assign( m_NumberOfBricks[ 0 ] * m_NumberOfBricks[ 1 ] * m_NumberOfBricks[ 2 ], 0 );
+
+  /* A voxel at the first layer of a brick also belongs to the brick before
+     it, so that a plane is inside the brick of its first voxel. */
+
+  const PixelType * voxel = this->m_Image->GetBufferPointer();
+  for( int z = 0; z < nz; z++ )
+  {
+    const int bz[ 2 ] = { z >> 3, ( z > 0 && ( z & 7 ) == 0 ) ? ( z >> 3 ) - 1 : z >> 3 };
+    for( int y = 0; y < ny; y++ )
+    {
+      const int by[ 2 ] = { y >> 3, ( y > 0 && ( y & 7 ) == 0 ) ? ( y >> 3 ) - 1 : y >> 3 };
+      for( int x = 0; x < nx; x++, voxel++ )
+      {
+        if( !( static_cast< double >( *voxel ) > m_Threshold ) )
+        {
+          continue;
+        }
+        const int bx[ 2 ] = { x >> 3, ( x > 0 && ( x & 7 ) == 0 ) ? ( x >> 3 ) - 1 : x >> 3 };
+        for( unsigned int k = 0; k < 8; k++ )
+        {
+          m_OccupiedBricks[ bx[ k & 1 ] + m_NumberOfBricks[ 0 ]
+            * ( by[ ( k >> 1 ) & 1 ] + m_NumberOfBricks[ 1 ] * bz[ k >> 2 ] ) ] = 1;
+        }
+        m_OccupiedStart[ 0 ] = std::min( m_OccupiedStart[ 0 ], x );
+        m_OccupiedStart[ 1 ] = std::min( m_OccupiedStart[ 1 ], y );
+        m_OccupiedStart[ 2 ] = std::min( m_OccupiedStart[ 2 ], z );
+        m_OccupiedEnd[ 0 ]   = std::max( m_OccupiedEnd[ 0 ], x );
+        m_OccupiedEnd[ 1 ]   = std::max( m_OccupiedEnd[ 1 ], y );
+        m_OccupiedEnd[ 2 ]   = std::max( m_OccupiedEnd[ 2 ], z );
+      }
+    }
+  }
 }
 
 
@@ -1556,22 +1728,51 @@ typename AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
 AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
 ::Evaluate( const PointType & point ) const
 {
-  double integral = 0;
+  OutputType value;
+  this->EvaluateBatch( &point, &value, 1 );
+
+  return value;
+}
+
+
+/* -----------------------------------------------------------------------
+   Evaluate at a batch of image positions
+   ----------------------------------------------------------------------- */
+
+template< class TInputImage, class TCoordRep >
+void
+AdvancedRayCastInterpolateImageFunction< TInputImage, TCoordRep >
+::EvaluateBatch( const PointType * points, OutputType * values,
+  const SizeValueType n ) const
+{
+  if( n == 0 )
+  {
+    return;
+  }
 
   OutputPointType transformedFocalPoint
     = m_Transform->TransformPoint( m_FocalPoint );
 
-  DirectionType direction = transformedFocalPoint - point;
-
   RayCastHelper< TInputImage, TCoordRep > ray;
   ray.SetImage( this->m_Image );
   ray.ZeroState();
   ray.Initialise();
+  if( !m_OccupiedBricks.empty() )
+  {
+    ray.SetOccupancy( &m_OccupiedBricks[ 0 ], m_NumberOfBricks, m_OccupiedStart, m_OccupiedEnd );
+  }
+
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    double integral = 0;
+
+    DirectionType direction = transformedFocalPoint - points[ i ];
 
-  ray.SetRay( point, direction );
-  ray.IntegrateAboveThreshold( integral, m_Threshold );
+    ray.SetRay( points[ i ], direction );
+    ray.IntegrateAboveThreshold( integral, m_Threshold );
 
-  return ( static_cast< OutputType >( integral ) );
+    values[ i ] = static_cast< OutputType >( integral );
+  }
 }
 
 
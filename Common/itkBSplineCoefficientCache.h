@@ -0,0 +1,147 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBSplineCoefficientCache_h
+#define __itkBSplineCoefficientCache_h
+
+#include "itkImage.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace itk
+{
+
+/** \class BSplineCoefficientCache
+ *
+ * \brief Keeps the B-spline coefficient images of the interpolators, so
+ * that interpolators of the same image and spline order share them.
+ *
+ * The B-spline interpolator of the registration and the B-spline resample
+ * interpolator each compute the B-spline decomposition of the moving image.
+ * At the last resolution this is usually the same image, and the same
+ * spline order. With their UseCoefficientCache flag, the
+ * AdvancedBSplineInterpolateImageFunction objects look up the coefficients
+ * in this cache by a key that combines the hash of the contents and geometry
+ * of the image with the spline order, so that an image that is an equal copy,
+ * like the last level of an image pyramid, is found as well. The cache is
+ * shared by all interpolators of the same image and coefficient type.
+ *
+ * The cache keeps at most MaximumNumberOfCoefficients in memory, and
+ * removes the least recently used coefficient images first. Interpolators
+ * that use a coefficient image keep it alive after its removal.
+ *
+ * \ingroup ImageFunctions
+ */
+
+template< class TImageType, class TCoefficientType >
+class BSplineCoefficientCache : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef BSplineCoefficientCache    Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( BSplineCoefficientCache, Object );
+
+  /** Typedefs. */
+  typedef TImageType                                  ImageType;
+  typedef Image< TCoefficientType,
+    TImageType::ImageDimension >                      CoefficientImageType;
+  typedef typename CoefficientImageType::ConstPointer CoefficientImageConstPointer;
+  typedef std::uint64_t                               KeyType;
+
+  /** Get the cache that is shared by all interpolators of these types. */
+  static Pointer GetInstance( void );
+
+  /** Return the key of the coefficients of an image for a spline order. */
+  static KeyType ComputeKey( const ImageType * image, const unsigned int splineOrder );
+
+  /** Return the coefficients stored with the key, or an empty pointer. */
+  CoefficientImageConstPointer Find( const KeyType key );
+
+  /** Store the coefficients with the key. */
+  void Insert( const KeyType key, const CoefficientImageType * coefficients );
+
+  /** Remove all coefficients from the cache. */
+  void Clear( void );
+
+  /** Set/Get the maximum number of coefficients kept in the cache. */
+  void SetMaximumNumberOfCoefficients( const SizeValueType maximumNumberOfCoefficients );
+
+  SizeValueType GetMaximumNumberOfCoefficients( void ) const;
+
+  /** Get the number of coefficients kept in the cache. */
+  SizeValueType GetNumberOfCoefficients( void ) const;
+
+  /** Get the number of successful calls of Find(). */
+  SizeValueType GetNumberOfHits( void ) const;
+
+protected:
+
+  BSplineCoefficientCache();
+  ~BSplineCoefficientCache() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  BSplineCoefficientCache( const Self & ); // purposely not implemented
+  void operator=( const Self & );          // purposely not implemented
+
+  /** The least recently used keys come first. */
+  typedef std::list< KeyType > UsageListType;
+
+  struct EntryType
+  {
+    CoefficientImageConstPointer     m_Coefficients;
+    typename UsageListType::iterator m_Usage;
+  };
+
+  typedef std::map< KeyType, EntryType > EntryMapType;
+
+  /** Remove the least recently used coefficients until the number of
+   * coefficients is at most the given number. Not locked.
+   */
+  void Shrink( const SizeValueType numberOfCoefficients );
+
+  /** Protects the members below. */
+  mutable std::mutex m_Mutex;
+
+  EntryMapType  m_Entries;
+  UsageListType m_Usage;
+  SizeValueType m_NumberOfCoefficients;
+  SizeValueType m_MaximumNumberOfCoefficients;
+  SizeValueType m_NumberOfHits;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkBSplineCoefficientCache.hxx"
+#endif
+
+#endif // end #ifndef __itkBSplineCoefficientCache_h
@@ -0,0 +1,275 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkBSplineCoefficientCache_hxx
+#define __itkBSplineCoefficientCache_hxx
+
+#include "itkBSplineCoefficientCache.h"
+#include "itkDataHash.h"
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::BSplineCoefficientCache()
+{
+  this->m_NumberOfCoefficients        = 0;
+  this->m_MaximumNumberOfCoefficients = 256 * 1024 * 1024;
+  this->m_NumberOfHits                = 0;
+
+} // end Constructor
+
+
+/**
+ * ******************* GetInstance *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+typename BSplineCoefficientCache< TImageType, TCoefficientType >::Pointer
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::GetInstance( void )
+{
+  /** The initialization of a local static is thread-safe. */
+  static const Pointer instance = []()
+    {
+      Pointer cache = new Self;
+      cache->UnRegister();
+      return cache;
+    }();
+  return instance;
+
+} // end GetInstance()
+
+
+/**
+ * ******************* ComputeKey *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+typename BSplineCoefficientCache< TImageType, TCoefficientType >::KeyType
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::ComputeKey( const ImageType * image, const unsigned int splineOrder )
+{
+  const unsigned int Dimension = ImageType::ImageDimension;
+  const typename ImageType::RegionType & region = image->GetBufferedRegion();
+
+  DataHash::HashType hash = DataHash::CombineValue( DataHash::InitialValue,
+    static_cast< std::uint32_t >( splineOrder ) );
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    hash = DataHash::CombineValue( hash, static_cast< std::int64_t >( region.GetIndex()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< std::uint64_t >( region.GetSize()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< double >( image->GetSpacing()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< double >( image->GetOrigin()[ i ] ) );
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      hash = DataHash::CombineValue( hash, static_cast< double >( image->GetDirection()[ i ][ j ] ) );
+    }
+  }
+  hash = DataHash::Combine( hash, image->GetBufferPointer(),
+    region.GetNumberOfPixels() * sizeof( typename ImageType::PixelType ) );
+  return hash;
+
+} // end ComputeKey()
+
+
+/**
+ * ******************* Find *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+typename BSplineCoefficientCache< TImageType, TCoefficientType >::CoefficientImageConstPointer
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::Find( const KeyType key )
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  const auto found = this->m_Entries.find( key );
+  if( found == this->m_Entries.end() )
+  {
+    return CoefficientImageConstPointer();
+  }
+
+  /** Mark the coefficients as the most recently used. */
+  this->m_Usage.splice( this->m_Usage.end(), this->m_Usage, found->second.m_Usage );
+  ++this->m_NumberOfHits;
+  return found->second.m_Coefficients;
+
+} // end Find()
+
+
+/**
+ * ******************* Insert *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+void
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::Insert( const KeyType key, const CoefficientImageType * coefficients )
+{
+  const SizeValueType numberOfCoefficients
+    = coefficients->GetBufferedRegion().GetNumberOfPixels();
+
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  const auto found = this->m_Entries.find( key );
+  if( found != this->m_Entries.end() )
+  {
+    this->m_NumberOfCoefficients -= found->second.m_Coefficients->GetBufferedRegion().GetNumberOfPixels();
+    this->m_Usage.erase( found->second.m_Usage );
+    this->m_Entries.erase( found );
+  }
+
+  if( numberOfCoefficients > this->m_MaximumNumberOfCoefficients )
+  {
+    return;
+  }
+  this->Shrink( this->m_MaximumNumberOfCoefficients - numberOfCoefficients );
+
+  EntryType entry;
+  entry.m_Coefficients = coefficients;
+  entry.m_Usage        = this->m_Usage.insert( this->m_Usage.end(), key );
+  this->m_Entries[ key ]        = entry;
+  this->m_NumberOfCoefficients += numberOfCoefficients;
+
+} // end Insert()
+
+
+/**
+ * ******************* Shrink *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+void
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::Shrink( const SizeValueType numberOfCoefficients )
+{
+  while( this->m_NumberOfCoefficients > numberOfCoefficients )
+  {
+    const auto oldest = this->m_Entries.find( this->m_Usage.front() );
+    this->m_NumberOfCoefficients -= oldest->second.m_Coefficients->GetBufferedRegion().GetNumberOfPixels();
+    this->m_Entries.erase( oldest );
+    this->m_Usage.pop_front();
+  }
+
+} // end Shrink()
+
+
+/**
+ * ******************* Clear *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+void
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::Clear( void )
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  this->m_Entries.clear();
+  this->m_Usage.clear();
+  this->m_NumberOfCoefficients = 0;
+
+} // end Clear()
+
+
+/**
+ * ******************* SetMaximumNumberOfCoefficients *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+void
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::SetMaximumNumberOfCoefficients( const SizeValueType maximumNumberOfCoefficients )
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  this->m_MaximumNumberOfCoefficients = maximumNumberOfCoefficients;
+  this->Shrink( maximumNumberOfCoefficients );
+
+} // end SetMaximumNumberOfCoefficients()
+
+
+/**
+ * ******************* GetMaximumNumberOfCoefficients *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+SizeValueType
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::GetMaximumNumberOfCoefficients( void ) const
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  return this->m_MaximumNumberOfCoefficients;
+
+} // end GetMaximumNumberOfCoefficients()
+
+
+/**
+ * ******************* GetNumberOfCoefficients *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+SizeValueType
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::GetNumberOfCoefficients( void ) const
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  return this->m_NumberOfCoefficients;
+
+} // end GetNumberOfCoefficients()
+
+
+/**
+ * ******************* GetNumberOfHits *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+SizeValueType
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::GetNumberOfHits( void ) const
+{
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  return this->m_NumberOfHits;
+
+} // end GetNumberOfHits()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TImageType, class TCoefficientType >
+void
+BSplineCoefficientCache< TImageType, TCoefficientType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  os << indent << "NumberOfCoefficientImages: " << this->m_Entries.size() << std::endl;
+  os << indent << "NumberOfCoefficients: " << this->m_NumberOfCoefficients << std::endl;
+  os << indent << "MaximumNumberOfCoefficients: " << this->m_MaximumNumberOfCoefficients << std::endl;
+  os << indent << "NumberOfHits: " << this->m_NumberOfHits << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkBSplineCoefficientCache_hxx
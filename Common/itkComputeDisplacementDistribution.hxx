@@ -19,6 +19,7 @@
 #define __itkComputeDisplacementDistribution_hxx
 
 #include "itkComputeDisplacementDistribution.h"
+#include "itkPersistentThreadPool.h"
 
 #include <string>
 #include "vnl/vnl_math.h"
@@ -318,13 +319,14 @@ void
 ComputeDisplacementDistribution< TFixedImage, TTransform >
 ::LaunchComputeThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->ComputeThreaderCallback,
+  /** Launch on the threads that are shared with the metrics, instead of
+   * creating and joining threads at every call. m_Threader only holds the
+   * number of work units.
+   */
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    this->m_Threader->GetNumberOfWorkUnits(), this->ComputeThreaderCallback,
     const_cast< void * >( static_cast< const void * >( &this->m_ThreaderParameters ) ) );
 
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
-
 } // end LaunchComputeThreaderCallback()
 
 
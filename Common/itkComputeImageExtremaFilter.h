@@ -21,6 +21,7 @@
 #include "itkStatisticsImageFilter.h"
 #include "itkSpatialObject.h"
 #include "itkImageMaskSpatialObject.h"
+#include "itkImageMaskBitmap.h"
 
 namespace itk
 {
@@ -37,6 +38,17 @@ namespace itk
  * threaded. It computes statistics in each thread then combines them in
  * its AfterThreadedGenerate method.
  *
+ * With UseMask, only the voxels inside the ImageSpatialMask, or else
+ * inside the ImageMask, are taken into account. When the image of the
+ * ImageSpatialMask has the same geometry as the input, the mask is read
+ * along with the input, line by line, with branch-free selects that the
+ * compiler vectorizes. Otherwise the inside tests use an ImageMaskBitmap
+ * of the mask.
+ *
+ * With MaximumNumberOfVoxels, only every k-th line of the image is visited,
+ * such that at most about that number of voxels is read. The results are
+ * then an estimate, from the voxels of the visited lines.
+ *
  * \ingroup MathematicalStatisticsImageFilters
  * \ingroup ITKImageStatistics
  *
@@ -92,6 +104,14 @@ public:
   itkSetConstObjectMacro( ImageSpatialMask, ImageSpatialMaskType );
   itkGetConstObjectMacro( ImageSpatialMask, ImageSpatialMaskType );
 
+  typedef ImageMaskBitmap< itkGetStaticConstMacro(ImageDimension) > MaskBitmapType;
+
+  /** Set/Get the maximum number of voxels that are visited. For a larger
+   * image, only every k-th line is visited. The default, 0, visits all voxels.
+   */
+  itkSetMacro( MaximumNumberOfVoxels, SizeValueType );
+  itkGetConstMacro( MaximumNumberOfVoxels, SizeValueType );
+
 protected:
   ComputeImageExtremaFilter();
   ~ComputeImageExtremaFilter() override {}
@@ -113,11 +133,29 @@ protected:
   ImageSpatialMaskConstPointer  m_ImageSpatialMask;
   bool                  m_UseMask;
   bool                  m_SameGeometry;
+  SizeValueType         m_MaximumNumberOfVoxels;
 
 private:
   ComputeImageExtremaFilter( const Self & );
   void operator = ( const Self & );
 
+  /** Accumulate the statistics of the visited lines of a region. The mask
+   * image has the geometry of the input, or is null to use the bitmap, or
+   * no mask.
+   */
+  void ThreadedComputeStatistics( const RegionType & regionForThread,
+    const typename ImageSpatialMaskType::ImageType * maskImage );
+
+  /** Whether the superclass computes the statistics. */
+  bool UseSuperclass( void ) const
+  {
+    return !this->m_UseMask && this->m_LineStride <= 1;
+  }
+
+  typename MaskBitmapType::Pointer m_MaskBitmap;
+  bool                             m_UseMaskBitmap;
+  SizeValueType                    m_LineStride;
+
   CompensatedSummation<RealType> m_ThreadSum{ 1 };
   CompensatedSummation<RealType> m_SumOfSquares{ 1 };
   SizeValueType m_Count{ 1 };
@@ -19,7 +19,7 @@
 #define itkComputeImageExtremaFilter_hxx
 #include "itkComputeImageExtremaFilter.h"
 
-#include <itkImageRegionConstIterator.h>
+#include <itkImageScanlineConstIterator.h>
 
 namespace itk
 {
@@ -34,14 +34,35 @@ template< typename TInputImage >
 {
   this->m_UseMask = false;
   this->m_SameGeometry = false;
+  this->m_MaximumNumberOfVoxels = 0;
+  this->m_MaskBitmap = MaskBitmapType::New();
+  this->m_UseMaskBitmap = false;
+  this->m_LineStride = 1;
 }
 
+
+/**
+* ********************* BeforeStreamedGenerateData ****************************
+*/
+
 template< typename TInputImage >
 void
 ComputeImageExtremaFilter< TInputImage >
 ::BeforeStreamedGenerateData()
 {
-  if( !this->m_UseMask )
+  /** Visit every k-th line, such that at most about MaximumNumberOfVoxels
+   * voxels are read.
+   */
+  const SizeValueType numberOfVoxels
+    = this->GetInput()->GetLargestPossibleRegion().GetNumberOfPixels();
+  this->m_LineStride = 1;
+  if( this->m_MaximumNumberOfVoxels > 0 && numberOfVoxels > this->m_MaximumNumberOfVoxels )
+  {
+    this->m_LineStride = ( numberOfVoxels + this->m_MaximumNumberOfVoxels - 1 )
+      / this->m_MaximumNumberOfVoxels;
+  }
+
+  if( this->UseSuperclass() )
   {
     Superclass::BeforeStreamedGenerateData();
   }
@@ -54,35 +75,66 @@ ComputeImageExtremaFilter< TInputImage >
     m_ThreadMin = NumericTraits< PixelType >::max();
     m_ThreadMax = NumericTraits< PixelType >::NonpositiveMin();
 
-    if( this->GetImageSpatialMask() )
+    this->m_SameGeometry = false;
+    if( this->m_UseMask && this->GetImageSpatialMask() )
     {
       this->SameGeometry();
     }
-    else
+
+    /** Any other mask is tested with the bitmap, which is only recomputed
+     * when the mask changed.
+     */
+    this->m_UseMaskBitmap = false;
+    if( this->m_UseMask && !this->m_SameGeometry )
     {
-      this->m_SameGeometry = false;
+      if( this->GetImageSpatialMask() )
+      {
+        this->m_MaskBitmap->SetMask( this->GetImageSpatialMask() );
+      }
+      else
+      {
+        this->m_MaskBitmap->SetMask( this->GetImageMask() );
+      }
+      this->m_UseMaskBitmap = this->m_MaskBitmap->GetMask() != nullptr;
     }
   }
 }
 
+
+/**
+* ********************* SameGeometry ****************************
+*/
+
 template< typename TInputImage >
 void
 ComputeImageExtremaFilter< TInputImage >
 ::SameGeometry()
 {
-  if( this->GetInput()->GetLargestPossibleRegion().GetSize() == this->m_ImageSpatialMask->GetImage()->GetLargestPossibleRegion().GetSize()
-    && this->GetInput()->GetOrigin() == this->m_ImageSpatialMask->GetImage()->GetOrigin() )
-  {
-    this->m_SameGeometry = true;
-  }
+  /** The mask image is read at the indices of the input, so the whole mask
+   * image must be buffered, on the grid of the input.
+   */
+  const TInputImage * input = this->GetInput();
+  const typename ImageSpatialMaskType::ImageType * maskImage = this->m_ImageSpatialMask->GetImage();
+
+  this->m_SameGeometry = maskImage != nullptr
+    && input->GetLargestPossibleRegion() == maskImage->GetLargestPossibleRegion()
+    && maskImage->GetBufferedRegion() == maskImage->GetLargestPossibleRegion()
+    && input->GetOrigin() == maskImage->GetOrigin()
+    && input->GetSpacing() == maskImage->GetSpacing()
+    && input->GetDirection() == maskImage->GetDirection();
 }
 
+
+/**
+* ********************* AfterStreamedGenerateData ****************************
+*/
+
 template< typename TInputImage >
 void
 ComputeImageExtremaFilter< TInputImage >
 ::AfterStreamedGenerateData()
 {
-  if (!this->m_UseMask)
+  if( this->UseSuperclass() )
   {
     Superclass::AfterStreamedGenerateData();
   }
@@ -110,110 +162,83 @@ ComputeImageExtremaFilter< TInputImage >
   }
 }
 
+
+/**
+* ********************* ThreadedStreamedGenerateData ****************************
+*/
+
 template< typename TInputImage >
 void
 ComputeImageExtremaFilter< TInputImage >
 ::ThreadedStreamedGenerateData(const RegionType & regionForThread)
 {
-  if( !this->m_UseMask )
+  if( this->UseSuperclass() )
   {
     Superclass::ThreadedStreamedGenerateData( regionForThread );
   }
-  else
+  else if( !this->m_UseMask )
   {
-    if( this->GetImageSpatialMask() )
-    {
-      this->ThreadedGenerateDataImageSpatialMask( regionForThread );
-    }
-    if( this->GetImageMask() )
-    {
-      this->ThreadedGenerateDataImageMask( regionForThread );
-    }
+    this->ThreadedComputeStatistics( regionForThread, nullptr );
+  }
+  else if( this->GetImageSpatialMask() )
+  {
+    this->ThreadedGenerateDataImageSpatialMask( regionForThread );
+  }
+  else if( this->GetImageMask() )
+  {
+    this->ThreadedGenerateDataImageMask( regionForThread );
   }
 } // end ThreadedGenerateData()
 
+
+/**
+* ********************* ThreadedGenerateDataImageSpatialMask ****************************
+*/
+
 template< typename TInputImage >
 void
 ComputeImageExtremaFilter< TInputImage >
 ::ThreadedGenerateDataImageSpatialMask( const RegionType & regionForThread )
 {
-  const SizeValueType size0 = regionForThread.GetSize( 0 );
-  if( size0 == 0 )
-  {
-    return;
-  }
-  RealType  realValue;
-  PixelType value;
-
-  RealType sum = NumericTraits< RealType >::ZeroValue();
-  RealType sumOfSquares = NumericTraits< RealType >::ZeroValue();
-  SizeValueType count = NumericTraits< SizeValueType >::ZeroValue();
-  PixelType min = NumericTraits< PixelType >::max();
-  PixelType max = NumericTraits< PixelType >::NonpositiveMin();
-
-  if( this->m_SameGeometry )
-  {
-    ImageRegionConstIterator< TInputImage > it (this->GetInput(), regionForThread );
-    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
-    {
-      if( this->m_ImageSpatialMask->GetImage()->GetPixel( it.GetIndex()) != NumericTraits< PixelType >::ZeroValue() )
-      {
-        value = it.Get();
-        realValue = static_cast<RealType>( value );
+  this->ThreadedComputeStatistics( regionForThread,
+    this->m_SameGeometry ? this->m_ImageSpatialMask->GetImage() : nullptr );
 
-        min = std::min( min, value );
-        max = std::max( max, value );
+} // end ThreadedGenerateDataImageSpatialMask()
 
-        sum += realValue;
-        sumOfSquares += ( realValue * realValue );
-        ++count;
-      }
-    } // end for
-  }
-  else
-  {
-    ImageRegionConstIterator< TInputImage > it( this->GetInput(), regionForThread );
-    for( it.GoToBegin(); !it.IsAtEnd(); ++it )
-    {
-      PointType point;
-      this->GetInput()->TransformIndexToPhysicalPoint( it.GetIndex(), point );
-      if( this->m_ImageSpatialMask->IsInsideInWorldSpace( point ) )
-      {
-        value = it.Get();
-        realValue = static_cast<RealType>( value );
 
-        min = std::min( min, value );
-        max = std::max( max, value );
+/**
+* ********************* ThreadedGenerateDataImageMask ****************************
+*/
 
-        sum += realValue;
-        sumOfSquares += ( realValue * realValue );
-        ++count;
-      }
-    } // end for
-  } // end if
+template< typename TInputImage >
+void
+ComputeImageExtremaFilter< TInputImage >
+::ThreadedGenerateDataImageMask( const RegionType & regionForThread )
+{
+  this->ThreadedComputeStatistics( regionForThread, nullptr );
 
-  std::lock_guard<std::mutex> mutexHolder(m_Mutex);
-  m_ThreadSum += sum;
-  m_SumOfSquares += sumOfSquares;
-  m_Count += count;
-  m_ThreadMin = std::min(min, m_ThreadMin);
-  m_ThreadMax = std::max(max, m_ThreadMax);
+} // end ThreadedGenerateDataImageMask()
 
-} // end ThreadedGenerateDataImageSpatialMask()
 
+/**
+* ********************* ThreadedComputeStatistics ****************************
+*/
 
 template< typename TInputImage >
 void
 ComputeImageExtremaFilter< TInputImage >
-::ThreadedGenerateDataImageMask( const RegionType & regionForThread )
+::ThreadedComputeStatistics( const RegionType & regionForThread,
+  const typename ImageSpatialMaskType::ImageType * maskImage )
 {
   const SizeValueType size0 = regionForThread.GetSize( 0 );
   if( size0 == 0 )
   {
     return;
   }
-  RealType  realValue;
-  PixelType value;
+
+  const TInputImage *    input = this->GetInput();
+  const RegionType &     largestRegion = input->GetLargestPossibleRegion();
+  const MaskBitmapType * bitmap = this->m_UseMaskBitmap ? this->m_MaskBitmap.GetPointer() : nullptr;
 
   RealType sum = NumericTraits< RealType >::ZeroValue();
   RealType sumOfSquares = NumericTraits< RealType >::ZeroValue();
@@ -221,28 +246,90 @@ ComputeImageExtremaFilter< TInputImage >
   PixelType min = NumericTraits< PixelType >::max();
   PixelType max = NumericTraits< PixelType >::NonpositiveMin();
 
-  ImageRegionConstIterator< TInputImage > it ( this->GetInput(), regionForThread );
-  it.GoToBegin();
-
-  // do the work
+  ImageScanlineConstIterator< TInputImage > it( input, regionForThread );
   while( !it.IsAtEnd() )
   {
-    PointType point;
-    this->GetInput()->TransformIndexToPhysicalPoint( it.GetIndex(), point );
-    if( this->m_ImageMask->IsInsideInWorldSpace( point ) )
+    const IndexType lineIndex = it.GetIndex();
+
+    /** The number of the line in the largest possible region, so that the
+     * same lines are visited for any split of the region.
+     */
+    SizeValueType lineNumber = 0;
+    for( unsigned int d = ImageDimension - 1; d > 0; --d )
+    {
+      lineNumber = lineNumber * largestRegion.GetSize( d )
+        + static_cast< SizeValueType >( lineIndex[ d ] - largestRegion.GetIndex( d ) );
+    }
+    if( lineNumber % this->m_LineStride != 0 )
     {
-      value = it.Get();
-      realValue = static_cast<RealType>( value );
+      it.NextLine();
+      continue;
+    }
+
+    const PixelType * line = input->GetBufferPointer() + input->ComputeOffset( lineIndex );
 
-      min = std::min( min, value );
-      max = std::max( max, value );
+    /** Sum the line separately, which reduces the rounding errors. */
+    RealType lineSum = NumericTraits< RealType >::ZeroValue();
+    RealType lineSumOfSquares = NumericTraits< RealType >::ZeroValue();
 
-      sum += realValue;
-      sumOfSquares +=  ( realValue * realValue );
-      ++count;
+    if( maskImage )
+    {
+      /** Select instead of branch, so that the loop is vectorized. */
+      const typename ImageSpatialMaskType::ImageType::PixelType * maskLine
+        = maskImage->GetBufferPointer() + maskImage->ComputeOffset( lineIndex );
+      for( SizeValueType i = 0; i < size0; ++i )
+      {
+        const bool      inside = maskLine[ i ] != 0;
+        const PixelType value = line[ i ];
+        const RealType  realValue = inside ? static_cast< RealType >( value ) : NumericTraits< RealType >::ZeroValue();
+
+        min = ( inside && value < min ) ? value : min;
+        max = ( inside && max < value ) ? value : max;
+        lineSum += realValue;
+        lineSumOfSquares += realValue * realValue;
+        count += inside ? 1 : 0;
+      }
     }
-    ++it;
-  }// end while
+    else if( bitmap )
+    {
+      IndexType index = lineIndex;
+      PointType point;
+      for( SizeValueType i = 0; i < size0; ++i )
+      {
+        index[ 0 ] = lineIndex[ 0 ] + static_cast< IndexValueType >( i );
+        input->TransformIndexToPhysicalPoint( index, point );
+        if( bitmap->IsInsideInWorldSpace( point ) )
+        {
+          const PixelType value = line[ i ];
+          const RealType  realValue = static_cast< RealType >( value );
+
+          min = std::min( min, value );
+          max = std::max( max, value );
+          lineSum += realValue;
+          lineSumOfSquares += realValue * realValue;
+          ++count;
+        }
+      }
+    }
+    else
+    {
+      for( SizeValueType i = 0; i < size0; ++i )
+      {
+        const PixelType value = line[ i ];
+        const RealType  realValue = static_cast< RealType >( value );
+
+        min = value < min ? value : min;
+        max = max < value ? value : max;
+        lineSum += realValue;
+        lineSumOfSquares += realValue * realValue;
+      }
+      count += size0;
+    }
+
+    sum += lineSum;
+    sumOfSquares += lineSumOfSquares;
+    it.NextLine();
+  } // end while
 
   std::lock_guard<std::mutex> mutexHolder(m_Mutex);
   m_ThreadSum += sum;
@@ -251,7 +338,7 @@ ComputeImageExtremaFilter< TInputImage >
   m_ThreadMin = std::min(min, m_ThreadMin);
   m_ThreadMax = std::max(max, m_ThreadMax);
 
-} // end ThreadedGenerateDataImageMask()
+} // end ThreadedComputeStatistics()
 
 } // end namespace itk
 #endif
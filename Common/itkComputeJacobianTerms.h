@@ -22,6 +22,12 @@
 #include "itkImageRandomSamplerBase.h"
 #include "itkImageRandomCoordinateSampler.h"
 #include "itkScaledSingleValuedNonLinearOptimizer.h"
+#include "itkMultiThreaderBase.h"
+
+#include "vnl/vnl_diag_matrix.h"
+#include "vnl/vnl_sparse_matrix.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -31,6 +37,11 @@ namespace itk
  * More specifically this class computes the Jacobian terms related to the automatic
  * parameter estimation for the adaptive stochastic gradient descent optimizer.
  * Details can be found in the paper.
+ *
+ * The loops over the samples are executed by the threads of the
+ * PersistentThreadPool. For the covariance matrix every work unit adds the
+ * rows of a range of parameters, so the result does not depend on the number
+ * of threads.
  */
 
 template< class TFixedImage, class TTransform >
@@ -145,6 +156,41 @@ protected:
   typedef typename TransformType::ScalarType             CoordinateRepresentationType;
   typedef typename TransformType::NumberOfParametersType NumberOfParametersType;
 
+  /** Typedefs for the covariance matrix C. */
+  typedef double                                   CovarianceValueType;
+  typedef Array2D< CovarianceValueType >           CovarianceMatrixType;
+  typedef vnl_sparse_matrix< CovarianceValueType > SparseCovarianceMatrixType;
+  typedef vnl_diag_matrix< CovarianceValueType >   DiagCovarianceMatrixType;
+
+  /** The data passed to the threads by Compute(). */
+  struct JacobianTermsThreaderParameterType
+  {
+    const Self *                        m_Self;
+    const ImageSampleContainerType *    m_SampleContainer;
+    SparseCovarianceMatrixType *        m_Covariance;
+    CovarianceMatrixType *              m_BandCovariance;
+    const std::vector< unsigned int > * m_BandCovarianceMap;
+    const DiagCovarianceMatrixType *    m_DiagonalCovariance;
+    ThreadIdType                        m_NumberOfWorkUnits;
+    std::vector< double >               m_MaxJJ;
+    std::vector< double >               m_MaxJCJ;
+  };
+
+  /** Add 1/n \sum_j J_j^T J_j to the rows of the covariance matrix that
+   * belong to the parameter range of a work unit.
+   */
+  void ThreadedAccumulateCovariance( const ThreadIdType workUnit,
+    JacobianTermsThreaderParameterType & temp ) const;
+
+  /** Compute maxJJ and maxJCJ over the samples of a work unit. */
+  void ThreadedComputeMaxima( const ThreadIdType workUnit,
+    JacobianTermsThreaderParameterType & temp ) const;
+
+  /** The callbacks of the threads. */
+  static ITK_THREAD_RETURN_TYPE AccumulateCovarianceThreaderCallback( void * arg );
+
+  static ITK_THREAD_RETURN_TYPE ComputeMaximaThreaderCallback( void * arg );
+
   /** Sample the fixed image to compute the Jacobian terms. */
   // \todo: note that this is an exact copy of itk::ComputeDisplacementDistribution
   // in the future it would be better to refactoring this part of the code.
@@ -19,11 +19,12 @@
 #define __itkComputeJacobianTerms_hxx
 
 #include "itkComputeJacobianTerms.h"
+#include "itkPersistentThreadPool.h"
 
 #include "vnl/vnl_math.h"
 #include "vnl/vnl_fastops.h"
-#include "vnl/vnl_diag_matrix.h"
-#include "vnl/vnl_sparse_matrix.h"
+
+#include <algorithm>
 
 namespace itk
 {
@@ -73,13 +74,6 @@ ComputeJacobianTerms< TFixedImage, TTransform >
    * Term 4: maxJCJ, see (54)
    */
 
-  typedef double                                   CovarianceValueType;
-  typedef itk::Array2D< CovarianceValueType >      CovarianceMatrixType;
-  typedef vnl_sparse_matrix< CovarianceValueType > SparseCovarianceMatrixType;
-  typedef SparseCovarianceMatrixType::row          SparseRowType;
-  typedef itk::Array< SizeValueType >              NonZeroJacobianIndicesExpandedType;
-  typedef vnl_diag_matrix< CovarianceValueType >   DiagCovarianceMatrixType;
-
   /** Initialize. */
   TrC = TrCC = maxJJ = maxJCJ = 0.0;
 
@@ -87,45 +81,28 @@ ComputeJacobianTerms< TFixedImage, TTransform >
   ImageSampleContainerPointer sampleContainer; // default-constructed (null)
   SampleFixedImageForJacobianTerms( sampleContainer );
   const SizeValueType nrofsamples = sampleContainer->Size();
-  const double        n           = static_cast< double >( nrofsamples );
 
   /** Get the number of parameters. */
   const unsigned int P = static_cast< unsigned int >(
     this->m_Transform->GetNumberOfParameters() );
 
-  /** Get transform and set current position. */
-  typename TransformType::Pointer transform
-    = this->m_Transform;
   const unsigned int outdim = this->m_Transform->GetOutputSpaceDimension();
 
   /** Get scales vector */
   const ScalesType & scales = this->m_Scales;
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator iter;
-  typename ImageSampleContainerType::ConstIterator begin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator end   = sampleContainer->End();
-  unsigned int samplenr = 0;
-
   /** Variables for nonzerojacobian indices and the Jacobian. */
   NumberOfParametersType sizejacind
     = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
   JacobianType jacj( outdim, sizejacind );
   jacj.Fill( 0.0 );
   NonZeroJacobianIndicesType jacind( sizejacind );
-  jacind[ 0 ] = 0;
-  if( sizejacind > 1 ) { jacind[ 1 ] = 0; }
-  NonZeroJacobianIndicesType prevjacind = jacind;
 
   /** Initialize covariance matrix. Sparse, diagonal, and band form. */
   SparseCovarianceMatrixType cov( P, P );
   DiagCovarianceMatrixType   diagcov( P, 0.0 );
   CovarianceMatrixType       bandcov;
 
-  /** For temporary storage of J'J. */
-  CovarianceMatrixType jactjac( sizejacind, sizejacind );
-  jactjac.Fill( 0.0 );
-
   typedef std::vector< unsigned int >             DifHistType;
   typedef std::pair< unsigned int, unsigned int > FreqPairType;
   typedef std::vector< FreqPairType >             DifHist2Type;
@@ -227,97 +204,18 @@ ComputeJacobianTerms< TFixedImage, TTransform >
    * Compute C = 1/n \sum_i J_i^T J_i
    * Possibly apply scaling afterwards.
    */
-  jacind[ 0 ] = 0;
-  if( sizejacind > 1 ) { jacind[ 1 ] = 0; }
-  for( iter = begin; iter != end; ++iter )
-  {
-    /** Print progress 0-50%.
-     *progressObserver->UpdateAndPrintProgress( samplenr );*/
-    ++samplenr;
-
-    /** Read fixed coordinates and get Jacobian J_j. */
-    const FixedImagePointType & point = ( *iter ).Value().m_ImageCoordinates;
-    this->m_Transform->GetJacobian( point, jacj, jacind  );
-
-    /** Skip invalid Jacobians in the beginning, if any. */
-    if( sizejacind > 1 )
-    {
-      if( jacind[ 0 ] == jacind[ 1 ] ) { continue; }
-    }
-
-    if( jacind == prevjacind )
-    {
-      /** Update sum of J_j^T J_j. */
-      vnl_fastops::inc_X_by_AtA( jactjac, jacj );
-    }
-    else
-    {
-      /** The following should only be done after the first sample. */
-      if( iter != begin )
-      {
-        /** Update covariance matrix. */
-        for( unsigned int pi = 0; pi < sizejacind; ++pi )
-        {
-          const unsigned int p = prevjacind[ pi ];
-          for( unsigned int qi = 0; qi < sizejacind; ++qi )
-          {
-            const unsigned int q = prevjacind[ qi ];
-            if( q >= p )
-            {
-              const double tempval = jactjac( pi, qi ) / n;
-              if( std::abs( tempval ) > 1e-14 )
-              {
-                const unsigned int bandindex = bandcovMap[ q - p ];
-                if( bandindex < bandcovsize )
-                {
-                  bandcov( p, bandindex ) += tempval;
-                }
-                else
-                {
-                  cov( p, q ) += tempval;
-                }
-              }
-            }
-          } // qi
-        }   // pi
-      }     // end if
-
-      /** Initialize jactjac by J_j^T J_j. */
-      vnl_fastops::AtA( jactjac, jacj );
-
-      /** Remember nonzerojacobian indices. */
-      prevjacind = jacind;
-    } // end else
-
-  } // end iter loop: end computation of covariance matrix
-
-  /** Update covariance matrix once again to include last jactjac updates
-   * \todo: a bit ugly that this loop is copied from above.
-   */
-  for( unsigned int pi = 0; pi < sizejacind; ++pi )
-  {
-    const unsigned int p = prevjacind[ pi ];
-    for( unsigned int qi = 0; qi < sizejacind; ++qi )
-    {
-      const unsigned int q = prevjacind[ qi ];
-      if( q >= p )
-      {
-        const double tempval = jactjac( pi, qi ) / n;
-        if( std::abs( tempval ) > 1e-14 )
-        {
-          const unsigned int bandindex = bandcovMap[ q - p ];
-          if( bandindex < bandcovsize )
-          {
-            bandcov( p, bandindex ) += tempval;
-          }
-          else
-          {
-            cov( p, q ) += tempval;
-          }
-        }
-      }
-    } // qi
-  }   // pi
+  const PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+  JacobianTermsThreaderParameterType  temp;
+  temp.m_Self               = this;
+  temp.m_SampleContainer    = sampleContainer.GetPointer();
+  temp.m_Covariance         = &cov;
+  temp.m_BandCovariance     = &bandcov;
+  temp.m_BandCovarianceMap  = &bandcovMap;
+  temp.m_DiagonalCovariance = &diagcov;
+  temp.m_NumberOfWorkUnits  = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( pool->GetMaximumNumberOfThreads(), P ) ) );
+  pool->SingleMethodExecute( temp.m_NumberOfWorkUnits,
+    Self::AccumulateCovarianceThreaderCallback, &temp );
 
   /** Copy the bandmatrix into the sparse matrix and empty the bandcov matrix.
    * \todo: perhaps work further with this bandmatrix instead.
@@ -390,9 +288,172 @@ ComputeJacobianTerms< TFixedImage, TTransform >
    * \li maxJJ = max_j [ ||J_j||_F^2 + 2\sqrt{2} || J_j J_j^T ||_F ]
    * \li maxJCJ = max_j [ Tr( J_j C J_j^T ) + 2\sqrt{2} || J_j C J_j^T ||_F ]
    */
-  maxJJ  = 0.0;
-  maxJCJ = 0.0;
-  const double sqrt2 = std::sqrt( static_cast< double >( 2.0 ) );
+  temp.m_NumberOfWorkUnits = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( 4 * pool->GetMaximumNumberOfThreads(), nrofsamples ) ) );
+  temp.m_MaxJJ.assign( temp.m_NumberOfWorkUnits, 0.0 );
+  temp.m_MaxJCJ.assign( temp.m_NumberOfWorkUnits, 0.0 );
+  pool->SingleMethodExecute( temp.m_NumberOfWorkUnits,
+    Self::ComputeMaximaThreaderCallback, &temp );
+
+  maxJJ  = *std::max_element( temp.m_MaxJJ.begin(), temp.m_MaxJJ.end() );
+  maxJCJ = *std::max_element( temp.m_MaxJCJ.begin(), temp.m_MaxJCJ.end() );
+
+} // end Compute()
+
+
+/**
+ * ************************* ThreadedAccumulateCovariance ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ThreadedAccumulateCovariance( const ThreadIdType workUnit,
+  JacobianTermsThreaderParameterType & temp ) const
+{
+  /** This work unit owns the rows [ rowBegin, rowEnd ) of C. */
+  const SizeValueType P        = this->m_Transform->GetNumberOfParameters();
+  const SizeValueType rowBegin = P * workUnit / temp.m_NumberOfWorkUnits;
+  const SizeValueType rowEnd   = P * ( workUnit + 1 ) / temp.m_NumberOfWorkUnits;
+
+  const ImageSampleContainerType &    sampleContainer = *temp.m_SampleContainer;
+  SparseCovarianceMatrixType &        cov             = *temp.m_Covariance;
+  CovarianceMatrixType &              bandcov         = *temp.m_BandCovariance;
+  const std::vector< unsigned int > & bandcovMap      = *temp.m_BandCovarianceMap;
+  const unsigned int                  bandcovsize     = bandcov.cols();
+  const double                        n               = static_cast< double >( sampleContainer.Size() );
+
+  const unsigned int     outdim     = this->m_Transform->GetOutputSpaceDimension();
+  NumberOfParametersType sizejacind = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  JacobianType           jacj( outdim, sizejacind );
+  jacj.Fill( 0.0 );
+  NonZeroJacobianIndicesType jacind( sizejacind );
+  NonZeroJacobianIndicesType prevjacind;
+
+  /** The sum of J_j^T J_j over a run of samples with the same nonzero
+   * Jacobian indices, and the local indices of its owned rows.
+   */
+  CovarianceMatrixType jactjac( sizejacind, sizejacind );
+  jactjac.Fill( 0.0 );
+  std::vector< unsigned int > ownedIndices;
+  ownedIndices.reserve( sizejacind );
+
+  /** Add the upper triangular part of the owned rows of jactjac to C. */
+  auto updateCovariance = [&]()
+    {
+      for( const unsigned int pi : ownedIndices )
+      {
+        const unsigned int p = prevjacind[ pi ];
+        for( unsigned int qi = 0; qi < sizejacind; ++qi )
+        {
+          const unsigned int q = prevjacind[ qi ];
+          if( q >= p )
+          {
+            const double tempval = jactjac( pi, qi ) / n;
+            if( std::abs( tempval ) > 1e-14 )
+            {
+              const unsigned int bandindex = bandcovMap[ q - p ];
+              if( bandindex < bandcovsize )
+              {
+                bandcov( p, bandindex ) += tempval;
+              }
+              else
+              {
+                cov( p, q ) += tempval;
+              }
+            }
+          }
+        } // qi
+      }   // pi
+    };
+
+  for( SizeValueType s = 0; s < sampleContainer.Size(); ++s )
+  {
+    /** Read fixed coordinates and get Jacobian J_j. */
+    const FixedImagePointType & point = sampleContainer.ElementAt( s ).m_ImageCoordinates;
+    this->m_Transform->GetJacobian( point, jacj, jacind );
+
+    /** Skip invalid Jacobians in the beginning, if any. */
+    if( sizejacind > 1 )
+    {
+      if( jacind[ 0 ] == jacind[ 1 ] ) { continue; }
+    }
+
+    /** Start a new run when the nonzero Jacobian indices change. */
+    if( jacind != prevjacind )
+    {
+      updateCovariance();
+      prevjacind = jacind;
+      jactjac.Fill( 0.0 );
+      ownedIndices.clear();
+      for( unsigned int pi = 0; pi < sizejacind; ++pi )
+      {
+        if( jacind[ pi ] >= rowBegin && jacind[ pi ] < rowEnd )
+        {
+          ownedIndices.push_back( pi );
+        }
+      }
+    }
+
+    /** Update the owned upper triangular part of the sum of J_j^T J_j. */
+    for( const unsigned int pi : ownedIndices )
+    {
+      const unsigned int p = jacind[ pi ];
+      for( unsigned int qi = 0; qi < sizejacind; ++qi )
+      {
+        if( jacind[ qi ] >= p )
+        {
+          double sum = 0.0;
+          for( unsigned int d = 0; d < outdim; ++d )
+          {
+            sum += jacj( d, pi ) * jacj( d, qi );
+          }
+          jactjac( pi, qi ) += sum;
+        }
+      }
+    }
+
+  } // end loop over sample container
+
+  /** Include the last run. */
+  updateCovariance();
+
+} // end ThreadedAccumulateCovariance()
+
+
+/**
+ * ************************* ThreadedComputeMaxima ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ThreadedComputeMaxima( const ThreadIdType workUnit,
+  JacobianTermsThreaderParameterType & temp ) const
+{
+  typedef typename SparseCovarianceMatrixType::row SparseRowType;
+  typedef Array< SizeValueType >                   NonZeroJacobianIndicesExpandedType;
+
+  /** This work unit handles the samples [ sampleBegin, sampleEnd ). */
+  const ImageSampleContainerType & sampleContainer = *temp.m_SampleContainer;
+  const SizeValueType              nrofsamples     = sampleContainer.Size();
+  const SizeValueType              sampleBegin     = nrofsamples * workUnit / temp.m_NumberOfWorkUnits;
+  const SizeValueType              sampleEnd       = nrofsamples * ( workUnit + 1 ) / temp.m_NumberOfWorkUnits;
+
+  SparseCovarianceMatrixType &     cov     = *temp.m_Covariance;
+  const DiagCovarianceMatrixType & diagcov = *temp.m_DiagonalCovariance;
+  const ScalesType &               scales  = this->m_Scales;
+
+  const unsigned int     P          = static_cast< unsigned int >( this->m_Transform->GetNumberOfParameters() );
+  const unsigned int     outdim     = this->m_Transform->GetOutputSpaceDimension();
+  NumberOfParametersType sizejacind = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
+  JacobianType           jacj( outdim, sizejacind );
+  jacj.Fill( 0.0 );
+  NonZeroJacobianIndicesType jacind( sizejacind );
+
+  double       maxJJ  = 0.0;
+  double       maxJCJ = 0.0;
+  const double sqrt2  = std::sqrt( static_cast< double >( 2.0 ) );
 
   JacobianType                       jacjjacj( outdim, outdim );
   JacobianType                       jacjcov( outdim, sizejacind );
@@ -402,12 +463,11 @@ ComputeJacobianTerms< TFixedImage, TTransform >
   JacobianType                       jacjcovjacj( outdim, outdim );
   NonZeroJacobianIndicesExpandedType jacindExpanded( P );
 
-  samplenr = 0;
-  for( iter = begin; iter != end; ++iter )
+  for( SizeValueType s = sampleBegin; s < sampleEnd; ++s )
   {
     /** Read fixed coordinates and get Jacobian. */
-    const FixedImagePointType & point = ( *iter ).Value().m_ImageCoordinates;
-    this->m_Transform->GetJacobian( point, jacj, jacind  );
+    const FixedImagePointType & point = sampleContainer.ElementAt( s ).m_ImageCoordinates;
+    this->m_Transform->GetJacobian( point, jacj, jacind );
 
     /** Apply scales, if necessary. */
     if( this->m_UseScales )
@@ -456,6 +516,7 @@ ComputeJacobianTerms< TFixedImage, TTransform >
       const unsigned int p = jacind[ pi ];
       if( !cov.empty_row( p ) )
       {
+        /** The rows are only read here. */
         SparseRowType & covrowp = cov.get_row( p );
         typename SparseRowType::iterator covrowpit;
 
@@ -502,16 +563,54 @@ ComputeJacobianTerms< TFixedImage, TTransform >
     /** Max_j [JCJ_j]. */
     maxJCJ = std::max( maxJCJ, JCJ_j );
 
-    /** Show progress 50-100%. */
-    //progressObserver->UpdateAndPrintProgress( samplenr + nrofsamples );
-    ++samplenr;
-
   } // end loop over sample container
 
-  /** Finalize progress information. */
-  //progressObserver->PrintProgress( 1.0 );
+  temp.m_MaxJJ[ workUnit ]  = maxJJ;
+  temp.m_MaxJCJ[ workUnit ] = maxJCJ;
 
-} // end Compute()
+} // end ThreadedComputeMaxima()
+
+
+/**
+ * ************************* AccumulateCovarianceThreaderCallback ************************
+ */
+
+template< class TFixedImage, class TTransform >
+ITK_THREAD_RETURN_TYPE
+ComputeJacobianTerms< TFixedImage, TTransform >
+::AccumulateCovarianceThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  JacobianTermsThreaderParameterType * temp
+    = static_cast< JacobianTermsThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Self->ThreadedAccumulateCovariance( infoStruct->WorkUnitID, *temp );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end AccumulateCovarianceThreaderCallback()
+
+
+/**
+ * ************************* ComputeMaximaThreaderCallback ************************
+ */
+
+template< class TFixedImage, class TTransform >
+ITK_THREAD_RETURN_TYPE
+ComputeJacobianTerms< TFixedImage, TTransform >
+::ComputeMaximaThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  JacobianTermsThreaderParameterType * temp
+    = static_cast< JacobianTermsThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Self->ThreadedComputeMaxima( infoStruct->WorkUnitID, *temp );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end ComputeMaximaThreaderCallback()
 
 
 /**
@@ -20,6 +20,8 @@
 
 #include "itkComputeDisplacementDistribution.h"
 
+#include <vector>
+
 
 namespace itk
 {
@@ -143,6 +145,47 @@ protected:
   double m_RegularizationKappa;
   double m_ConditionNumber;
 
+  /** The accumulators of a work unit of Compute() and
+   * ComputeJacobiTypePreconditioner().
+   */
+  struct PreconditionerPerThreadStruct
+  {
+    double                st_MaxJJ;
+    std::vector< double > st_Preconditioner;
+    std::vector< double > st_LocalStepSizeSquared;
+    std::vector< double > st_BinCount;
+  };
+
+  /** To give the threads access to the samples and the gradient. */
+  struct PreconditionerThreaderParameterType
+  {
+    const Self *                                 st_Self;
+    const ImageSampleContainerType *             st_SampleContainer;
+    const DerivativeType *                       st_ExactGradient;
+    bool                                         st_TransformIsBSpline;
+    bool                                         st_JacobiType;
+    std::vector< PreconditionerPerThreadStruct > st_PerThreadVariables;
+  };
+
+  /** Loop over the samples with the threads of the PersistentThreadPool,
+   * each into its own accumulators, and add the sums of the accumulators
+   * to maxJJ, preconditioner, localStepSizeSquared and binCount.
+   */
+  void AccumulatePreconditionerTerms( const ImageSampleContainerType * sampleContainer,
+    const DerivativeType * exactgradient, const bool transformIsBSpline, const bool jacobiType,
+    double & maxJJ, ParametersType & preconditioner,
+    std::vector< double > & localStepSizeSquared, ParametersType & binCount ) const;
+
+  /** The loops over the samples of a work unit. */
+  void ThreadedComputePreconditioner( const ThreadIdType workUnit,
+    PreconditionerThreaderParameterType & temp ) const;
+
+  void ThreadedComputeJacobiTypePreconditioner( const ThreadIdType workUnit,
+    PreconditionerThreaderParameterType & temp ) const;
+
+  /** The callback of the threads. */
+  static ITK_THREAD_RETURN_TYPE PreconditionerThreaderCallback( void * arg );
+
 private:
 
   ComputePreconditionerUsingDisplacementDistribution( const Self & ); // purposely not implemented
@@ -19,6 +19,8 @@
 #define __itkComputePreconditionerUsingDisplacementDistribution_hxx
 
 #include "itkComputePreconditionerUsingDisplacementDistribution.h"
+#include "itkParallelVectorOperations.h"
+#include "itkPersistentThreadPool.h"
 
 #include "vnl/vnl_math.h"
 
@@ -29,6 +31,7 @@
 #include "itkZeroFluxNeumannPadImageFilter.h"
 #include "itkSmoothingRecursiveGaussianImageFilter.h"
 
+#include <algorithm>
 #include <cmath> // For abs.
 
 
@@ -362,35 +365,280 @@ ComputePreconditionerUsingDisplacementDistribution< TFixedImage, TTransform >
   this->SampleFixedImageForJacobianTerms( sampleContainer );
   const SizeValueType nrofsamples = sampleContainer->Size();
 
-  /** Get transform and set current position. */
-  typename TransformType::Pointer transform = this->m_Transform;
+  /** Loop over all voxels in the sample container. */
+  std::vector< double > localStepSizeSquared( P, 0.0 );
+  ParametersType        binCount( P );
+  binCount.Fill( 0.0 );
+  this->AccumulatePreconditionerTerms( sampleContainer.GetPointer(), &exactgradient,
+    transformIsBSpline, false, maxJJ, preconditioner, localStepSizeSquared, binCount );
+
+
+  /** Compute the mean local step sizes and apply the 2 sigma rule. */
+  double maxEigenvalue = -1e+9;
+  double minEigenvalue = 1e+9;
+  for( unsigned int i = 0; i < P; ++i )
+  {
+    /** Mean deformation magnitude. */
+    double nonZeroBin = binCount[ i ];
+
+    const double meanLocalStepSize = preconditioner[ i ] / ( nonZeroBin + 1e-14 );
+    double sigma = localStepSizeSquared[ i ] / ( nonZeroBin + 1e-14 ) - meanLocalStepSize * meanLocalStepSize;
+
+    /** Due to numerical issues, in case of very small squared sums and means,
+     * the standard deviation may become negative. This happens for example in
+     * case of an affine transformation for the translational parameters.
+     */
+    if( sigma < 1e-14 ) sigma = 0;
+
+    /** Apply the 2 sigma rule. */
+    double localStep = meanLocalStepSize + 2.0 * std::sqrt( sigma ) + 1e-14;
+
+    minEigenvalue = std::min( localStep, minEigenvalue );
+    maxEigenvalue = std::max( localStep, maxEigenvalue );
+    preconditioner[ i ] = this->m_MaximumStepLength / localStep;
+
+  } // end loop over step size vector
+
+  /** Constrained the condition number into a given range, here we first try kappa = 2. */
+  double conditionNumber = maxEigenvalue / minEigenvalue;
+
+#if 1
+  elxout << std::scientific;
+  elxout << "The max eigen value is: [ ";
+  elxout << maxEigenvalue << " ";
+  elxout << "]" << std::endl;
+  elxout << "The min eigen value is: [ ";
+  elxout << minEigenvalue << " ";
+  elxout << "]" << std::endl;
+  elxout << "The condition number before constraints is: [ ";
+  elxout << conditionNumber << " ";
+  elxout << "]" << std::endl;
+  elxout << std::fixed;
+#endif
+
+  if( transformIsBSpline && conditionNumber > this->m_ConditionNumber )
+  {
+    minEigenvalue = maxEigenvalue / this->m_ConditionNumber;
+    for( unsigned int i = 0; i < P; ++i )
+    {
+      if( preconditioner[ i ] > this->m_MaximumStepLength / minEigenvalue )
+      {
+        preconditioner[ i ] = this->m_MaximumStepLength / minEigenvalue;
+      }
+    }
+  } // end condition number check.
+
+} // end Compute()
+
+
+/**
+ * ************************* ComputeJacobiTypePreconditioner ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputePreconditionerUsingDisplacementDistribution< TFixedImage, TTransform >
+::ComputeJacobiTypePreconditioner( const ParametersType & mu,
+  double & maxJJ, ParametersType & preconditioner )
+{
+  /** Initialize. */
+  maxJJ = 0.0;
+
+  /** Get the number of parameters. */
+  const unsigned int P = static_cast< unsigned int >(
+    this->m_Transform->GetNumberOfParameters() );
+
+  // Replace by a general check later.
+  bool transformIsBSpline = false;
+  if( P > 13 ) transformIsBSpline = true; // assume B-spline
+
+  /** Get samples. Uses a grid sampler with m_NumberOfJacobianMeasurements samples. */
+  ImageSampleContainerPointer sampleContainer;
+  this->SampleFixedImageForJacobianTerms( sampleContainer );
+  const SizeValueType nrofsamples = sampleContainer->Size();
+
+  /** Loop over all voxels in the sample container. */
+  std::vector< double > localStepSizeSquared;
+  ParametersType        binCount( P );
+  binCount.Fill( 0.0 );
+  this->AccumulatePreconditionerTerms( sampleContainer.GetPointer(), nullptr,
+    transformIsBSpline, true, maxJJ, preconditioner, localStepSizeSquared, binCount );
+
   const unsigned int outdim = this->m_Transform->GetOutputSpaceDimension();
+  double             maxEigenvalue = -1e+9;
+  double minEigenvalue = 1e+9;
+  for( unsigned int i = 0; i < P; ++i )
+  {
+    double nonZeroBin = binCount[ i ] / outdim;
+    if( nonZeroBin > 0 && preconditioner[ i ] > 1e-9 )
+    {
+      double eigenvalue = std::sqrt( preconditioner[ i ] / ( nonZeroBin ) ) + 1e-14;
+      maxEigenvalue = std::max( eigenvalue, maxEigenvalue );
+      minEigenvalue = std::min( eigenvalue, minEigenvalue );
+      preconditioner[ i ] = 1.0 / eigenvalue;
+    }
+  }
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator iter;
-  typename ImageSampleContainerType::ConstIterator begin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator end   = sampleContainer->End();
+#if 0
+  elxout << std::scientific;
+  elxout << "The max eigen value is: [ ";
+  elxout << maxEigenvalue << " ";
+  elxout << "]" << std::endl;
+  elxout << "The min eigen value is: [ ";
+  elxout << minEigenvalue << " ";
+  elxout << "]" << std::endl;
+#endif
+
+  /** Condition number check. */
+  double conditionNumber = maxEigenvalue / minEigenvalue;
+
+  if( transformIsBSpline && conditionNumber > this->m_ConditionNumber )
+  {
+    minEigenvalue = maxEigenvalue / this->m_ConditionNumber;
+    for( unsigned int i = 0; i < P; ++i )
+    {
+      if( preconditioner[ i ] > 1.0 / minEigenvalue )
+      {
+        preconditioner[ i ] = 1.0 / minEigenvalue;
+      }
+    }
+  }
+
+#if 0
+  elxout << std::scientific;
+  elxout << "The condition number after constraints is: [ ";
+  elxout << maxEigenvalue / minEigenvalue << " ";
+  elxout << "]" << std::endl;
+  elxout << std::fixed;
+#endif
+} // end ComputeJacobiTypePreconditioner()
+
+
+/**
+ * ************************* AccumulatePreconditionerTerms ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputePreconditionerUsingDisplacementDistribution< TFixedImage, TTransform >
+::AccumulatePreconditionerTerms( const ImageSampleContainerType * sampleContainer,
+  const DerivativeType * exactgradient, const bool transformIsBSpline, const bool jacobiType,
+  double & maxJJ, ParametersType & preconditioner,
+  std::vector< double > & localStepSizeSquared, ParametersType & binCount ) const
+{
+  const SizeValueType                 P    = this->m_Transform->GetNumberOfParameters();
+  const PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+  const ThreadIdType                  numberOfWorkUnits = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( pool->GetMaximumNumberOfThreads(), sampleContainer->Size() ) ) );
+
+  /** Every work unit accumulates into its own vectors of size P. */
+  PreconditionerThreaderParameterType userData;
+  userData.st_Self               = this;
+  userData.st_SampleContainer    = sampleContainer;
+  userData.st_ExactGradient      = exactgradient;
+  userData.st_TransformIsBSpline = transformIsBSpline;
+  userData.st_JacobiType         = jacobiType;
+  userData.st_PerThreadVariables.resize( numberOfWorkUnits );
+  for( PreconditionerPerThreadStruct & threadVariables : userData.st_PerThreadVariables )
+  {
+    threadVariables.st_MaxJJ = 0.0;
+    threadVariables.st_Preconditioner.assign( P, 0.0 );
+    threadVariables.st_BinCount.assign( P, 0.0 );
+    if( !jacobiType )
+    {
+      threadVariables.st_LocalStepSizeSquared.assign( P, 0.0 );
+    }
+  }
+
+  pool->SingleMethodExecute( numberOfWorkUnits, Self::PreconditionerThreaderCallback, &userData );
+
+  /** Sum the accumulators in a fixed order. */
+  for( const PreconditionerPerThreadStruct & threadVariables : userData.st_PerThreadVariables )
+  {
+    maxJJ = std::max( maxJJ, threadVariables.st_MaxJJ );
+    ParallelVectorOperations::Axpy( 1.0, threadVariables.st_Preconditioner.data(),
+      preconditioner.data_block(), P );
+    ParallelVectorOperations::Axpy( 1.0, threadVariables.st_BinCount.data(),
+      binCount.data_block(), P );
+    if( !jacobiType )
+    {
+      ParallelVectorOperations::Axpy( 1.0, threadVariables.st_LocalStepSizeSquared.data(),
+        localStepSizeSquared.data(), P );
+    }
+  }
+
+} // end AccumulatePreconditionerTerms()
+
+
+/**
+ * ************************* PreconditionerThreaderCallback ************************
+ */
+
+template< class TFixedImage, class TTransform >
+ITK_THREAD_RETURN_TYPE
+ComputePreconditionerUsingDisplacementDistribution< TFixedImage, TTransform >
+::PreconditionerThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  PreconditionerThreaderParameterType * userData
+    = static_cast< PreconditionerThreaderParameterType * >( infoStruct->UserData );
+
+  if( userData->st_JacobiType )
+  {
+    userData->st_Self->ThreadedComputeJacobiTypePreconditioner( infoStruct->WorkUnitID, *userData );
+  }
+  else
+  {
+    userData->st_Self->ThreadedComputePreconditioner( infoStruct->WorkUnitID, *userData );
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end PreconditionerThreaderCallback()
+
+
+/**
+ * ************************* ThreadedComputePreconditioner ************************
+ */
+
+template< class TFixedImage, class TTransform >
+void
+ComputePreconditionerUsingDisplacementDistribution< TFixedImage, TTransform >
+::ThreadedComputePreconditioner( const ThreadIdType workUnit,
+  PreconditionerThreaderParameterType & userData ) const
+{
+  /** This work unit handles the samples [ sampleBegin, sampleEnd ). */
+  const ImageSampleContainerType & sampleContainer   = *userData.st_SampleContainer;
+  const SizeValueType              nrofsamples       = sampleContainer.Size();
+  const SizeValueType              numberOfWorkUnits = userData.st_PerThreadVariables.size();
+  const SizeValueType              sampleBegin       = nrofsamples * workUnit / numberOfWorkUnits;
+  const SizeValueType              sampleEnd         = nrofsamples * ( workUnit + 1 ) / numberOfWorkUnits;
+
+  /** The accumulators of this work unit. */
+  PreconditionerPerThreadStruct & threadVariables = userData.st_PerThreadVariables[ workUnit ];
+  std::vector< double > &         preconditioner  = threadVariables.st_Preconditioner;
+  std::vector< double > &         binCount        = threadVariables.st_BinCount;
+  double                          maxJJ           = 0.0;
 
   /** Variables for nonzerojacobian indices and the Jacobian. */
+  const unsigned int  outdim     = this->m_Transform->GetOutputSpaceDimension();
   const SizeValueType sizejacind = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
-  JacobianType jacj( outdim, sizejacind );
+  JacobianType        jacj( outdim, sizejacind );
   jacj.Fill( 0.0 );
   NonZeroJacobianIndicesType jacind( sizejacind );
-
-  /** Declare temporary variables. Not needed for all methods. check later */
-  DerivativeType jacj_g( outdim );
+  JacobianType               jacjjacj( outdim, outdim );
+  const double               sqrt2 = std::sqrt( static_cast< double >( 2.0 ) );
+  std::vector< double > &    localStepSizeSquared = threadVariables.st_LocalStepSizeSquared;
+  const DerivativeType &     exactgradient        = *userData.st_ExactGradient;
+  const bool                 transformIsBSpline   = userData.st_TransformIsBSpline;
+  DerivativeType             jacj_g( outdim );
   jacj_g.Fill( 0.0 );
-  JacobianType          jacjjacj( outdim, outdim );
-  const double          sqrt2 = std::sqrt( static_cast< double >( 2.0 ) );
-  std::vector< double > localStepSizeSquared( P, 0.0 );
-  ParametersType binCount( P );
-  binCount.Fill( 0.0 );
 
-  /** Loop over all voxels in the sample container. */
-  for( iter = begin; iter != end; ++iter )
+  for( SizeValueType s = sampleBegin; s < sampleEnd; ++s )
   {
     /** Read fixed coordinates and get Jacobian. */
-    const FixedImagePointType & point = ( *iter ).Value().m_ImageCoordinates;
+    const FixedImagePointType & point = sampleContainer.ElementAt( s ).m_ImageCoordinates;
     this->m_Transform->GetJacobian( point, jacj, jacind );
 
     /** Compute 1st part of JJ: ||J_j||_F^2. */
@@ -522,115 +770,47 @@ ComputePreconditionerUsingDisplacementDistribution< TFixedImage, TTransform >
     }
   } // end loop over sample container
 
+  threadVariables.st_MaxJJ = maxJJ;
 
-  /** Compute the mean local step sizes and apply the 2 sigma rule. */
-  double maxEigenvalue = -1e+9;
-  double minEigenvalue = 1e+9;
-  for( unsigned int i = 0; i < P; ++i )
-  {
-    /** Mean deformation magnitude. */
-    double nonZeroBin = binCount[ i ];
-
-    const double meanLocalStepSize = preconditioner[ i ] / ( nonZeroBin + 1e-14 );
-    double sigma = localStepSizeSquared[ i ] / ( nonZeroBin + 1e-14 ) - meanLocalStepSize * meanLocalStepSize;
-
-    /** Due to numerical issues, in case of very small squared sums and means,
-     * the standard deviation may become negative. This happens for example in
-     * case of an affine transformation for the translational parameters.
-     */
-    if( sigma < 1e-14 ) sigma = 0;
-
-    /** Apply the 2 sigma rule. */
-    double localStep = meanLocalStepSize + 2.0 * std::sqrt( sigma ) + 1e-14;
-
-    minEigenvalue = std::min( localStep, minEigenvalue );
-    maxEigenvalue = std::max( localStep, maxEigenvalue );
-    preconditioner[ i ] = this->m_MaximumStepLength / localStep;
-
-  } // end loop over step size vector
-
-  /** Constrained the condition number into a given range, here we first try kappa = 2. */
-  double conditionNumber = maxEigenvalue / minEigenvalue;
-
-#if 1
-  elxout << std::scientific;
-  elxout << "The max eigen value is: [ ";
-  elxout << maxEigenvalue << " ";
-  elxout << "]" << std::endl;
-  elxout << "The min eigen value is: [ ";
-  elxout << minEigenvalue << " ";
-  elxout << "]" << std::endl;
-  elxout << "The condition number before constraints is: [ ";
-  elxout << conditionNumber << " ";
-  elxout << "]" << std::endl;
-  elxout << std::fixed;
-#endif
-
-  if( transformIsBSpline && conditionNumber > this->m_ConditionNumber )
-  {
-    minEigenvalue = maxEigenvalue / this->m_ConditionNumber;
-    for( unsigned int i = 0; i < P; ++i )
-    {
-      if( preconditioner[ i ] > this->m_MaximumStepLength / minEigenvalue )
-      {
-        preconditioner[ i ] = this->m_MaximumStepLength / minEigenvalue;
-      }
-    }
-  } // end condition number check.
-
-} // end Compute()
+} // end ThreadedComputePreconditioner()
 
 
 /**
- * ************************* ComputeJacobiTypePreconditioner ************************
+ * ************************* ThreadedComputeJacobiTypePreconditioner ************************
  */
 
 template< class TFixedImage, class TTransform >
 void
 ComputePreconditionerUsingDisplacementDistribution< TFixedImage, TTransform >
-::ComputeJacobiTypePreconditioner( const ParametersType & mu,
-  double & maxJJ, ParametersType & preconditioner )
+::ThreadedComputeJacobiTypePreconditioner( const ThreadIdType workUnit,
+  PreconditionerThreaderParameterType & userData ) const
 {
-  /** Initialize. */
-  maxJJ = 0.0;
-
-  /** Get the number of parameters. */
-  const unsigned int P = static_cast< unsigned int >(
-    this->m_Transform->GetNumberOfParameters() );
-
-  // Replace by a general check later.
-  bool transformIsBSpline = false;
-  if( P > 13 ) transformIsBSpline = true; // assume B-spline
-
-  /** Get samples. Uses a grid sampler with m_NumberOfJacobianMeasurements samples. */
-  ImageSampleContainerPointer sampleContainer;
-  this->SampleFixedImageForJacobianTerms( sampleContainer );
-  const SizeValueType nrofsamples = sampleContainer->Size();
-
-  /** Get transform and set current position. */
-  typename TransformType::Pointer transform = this->m_Transform;
-  const unsigned int outdim = this->m_Transform->GetOutputSpaceDimension();
-
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator iter;
-  typename ImageSampleContainerType::ConstIterator begin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator end = sampleContainer->End();
+  /** This work unit handles the samples [ sampleBegin, sampleEnd ). */
+  const ImageSampleContainerType & sampleContainer   = *userData.st_SampleContainer;
+  const SizeValueType              nrofsamples       = sampleContainer.Size();
+  const SizeValueType              numberOfWorkUnits = userData.st_PerThreadVariables.size();
+  const SizeValueType              sampleBegin       = nrofsamples * workUnit / numberOfWorkUnits;
+  const SizeValueType              sampleEnd         = nrofsamples * ( workUnit + 1 ) / numberOfWorkUnits;
+
+  /** The accumulators of this work unit. */
+  PreconditionerPerThreadStruct & threadVariables = userData.st_PerThreadVariables[ workUnit ];
+  std::vector< double > &         preconditioner  = threadVariables.st_Preconditioner;
+  std::vector< double > &         binCount        = threadVariables.st_BinCount;
+  double                          maxJJ           = 0.0;
 
   /** Variables for nonzerojacobian indices and the Jacobian. */
+  const unsigned int  outdim     = this->m_Transform->GetOutputSpaceDimension();
   const SizeValueType sizejacind = this->m_Transform->GetNumberOfNonZeroJacobianIndices();
-  JacobianType jacj( outdim, sizejacind );
+  JacobianType        jacj( outdim, sizejacind );
   jacj.Fill( 0.0 );
-  JacobianType          jacjjacj( outdim, outdim );
-  const double          sqrt2 = std::sqrt( static_cast< double >( 2.0 ) );
   NonZeroJacobianIndicesType jacind( sizejacind );
-  ParametersType binCount( P );
-  binCount.Fill( 0.0 );
+  JacobianType               jacjjacj( outdim, outdim );
+  const double               sqrt2 = std::sqrt( static_cast< double >( 2.0 ) );
 
-  /** Loop over all voxels in the sample container. */
-  for( iter = begin; iter != end; ++iter )
+  for( SizeValueType s = sampleBegin; s < sampleEnd; ++s )
   {
     /** Read fixed coordinates and get Jacobian. */
-    const FixedImagePointType & point = ( *iter ).Value().m_ImageCoordinates;
+    const FixedImagePointType & point = sampleContainer.ElementAt( s ).m_ImageCoordinates;
     this->m_Transform->GetJacobian( point, jacj, jacind );
 
     /** Compute 1st part of JJ: ||J_j||_F^2. */
@@ -652,55 +832,11 @@ ComputePreconditionerUsingDisplacementDistribution< TFixedImage, TTransform >
         binCount[ pj ] += 1;
       }
     }
-  }
-
-  double maxEigenvalue = -1e+9;
-  double minEigenvalue = 1e+9;
-  for( unsigned int i = 0; i < P; ++i )
-  {
-    double nonZeroBin = binCount[ i ] / outdim;
-    if( nonZeroBin > 0 && preconditioner[ i ] > 1e-9 )
-    {
-      double eigenvalue = std::sqrt( preconditioner[ i ] / ( nonZeroBin ) ) + 1e-14;
-      maxEigenvalue = std::max( eigenvalue, maxEigenvalue );
-      minEigenvalue = std::min( eigenvalue, minEigenvalue );
-      preconditioner[ i ] = 1.0 / eigenvalue;
-    }
-  }
-
-#if 0
-  elxout << std::scientific;
-  elxout << "The max eigen value is: [ ";
-  elxout << maxEigenvalue << " ";
-  elxout << "]" << std::endl;
-  elxout << "The min eigen value is: [ ";
-  elxout << minEigenvalue << " ";
-  elxout << "]" << std::endl;
-#endif
-
-  /** Condition number check. */
-  double conditionNumber = maxEigenvalue / minEigenvalue;
+  } // end loop over sample container
 
-  if( transformIsBSpline && conditionNumber > this->m_ConditionNumber )
-  {
-    minEigenvalue = maxEigenvalue / this->m_ConditionNumber;
-    for( unsigned int i = 0; i < P; ++i )
-    {
-      if( preconditioner[ i ] > 1.0 / minEigenvalue )
-      {
-        preconditioner[ i ] = 1.0 / minEigenvalue;
-      }
-    }
-  }
+  threadVariables.st_MaxJJ = maxJJ;
 
-#if 0
-  elxout << std::scientific;
-  elxout << "The condition number after constraints is: [ ";
-  elxout << maxEigenvalue / minEigenvalue << " ";
-  elxout << "]" << std::endl;
-  elxout << std::fixed;
-#endif
-} // end ComputeJacobiTypePreconditioner()
+} // end ThreadedComputeJacobiTypePreconditioner()
 
 
 /**
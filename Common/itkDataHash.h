@@ -0,0 +1,98 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkDataHash_h
+#define __itkDataHash_h
+
+#include "itkIntTypes.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace itk
+{
+
+/** \class DataHash
+ *
+ * \brief A fast 64-bit hash of blocks of memory, to identify image data.
+ *
+ * The data is processed eight bytes at a time, with the multiply and
+ * rotate steps of the FNV and Murmur hashes, so that hashing an image costs
+ * about as much as copying it. The hash is meant to detect that two images
+ * or masks have identical contents, not to protect against deliberate
+ * collisions.
+ *
+ * \ingroup ITKCommon
+ */
+
+class DataHash
+{
+public:
+
+  typedef std::uint64_t HashType;
+
+  /** The hash of an empty sequence. */
+  static const HashType InitialValue = 14695981039346656037ULL;
+
+  /** Return the hash of the bytes, combined with the hash seed. */
+  static HashType Combine( HashType seed, const void * data, const SizeValueType numberOfBytes )
+  {
+    const unsigned char * bytes = static_cast< const unsigned char * >( data );
+    SizeValueType i = 0;
+    for( ; i + 8 <= numberOfBytes; i += 8 )
+    {
+      std::uint64_t word;
+      std::memcpy( &word, bytes + i, 8 );
+      seed = Mix( seed, word );
+    }
+    std::uint64_t tail = numberOfBytes;
+    for( ; i < numberOfBytes; ++i )
+    {
+      tail = ( tail << 8 ) | bytes[ i ];
+    }
+    return Mix( seed, tail );
+  }
+
+
+  /** Return the hash of a value, combined with the hash seed. */
+  template< class T >
+  static HashType CombineValue( const HashType seed, const T & value )
+  {
+    return Combine( seed, &value, sizeof( T ) );
+  }
+
+
+private:
+
+  DataHash();                         // purposely not implemented
+  DataHash( const DataHash & );       // purposely not implemented
+  void operator=( const DataHash & ); // purposely not implemented
+
+  static HashType Mix( const HashType seed, std::uint64_t word )
+  {
+    word *= 0x87c37b91114253d5ULL;
+    word  = ( word << 31 ) | ( word >> 33 );
+    word *= 0x4cf5ad432745937fULL;
+    return ( seed ^ word ) * 1099511628211ULL;
+  }
+
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkDataHash_h
@@ -0,0 +1,450 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkDenseLinearAlgebra.h"
+
+#include <algorithm>
+
+#ifdef ELASTIX_USE_EIGEN
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <unsupported/Eigen/MatrixFunctions>
+#else
+#include "vnl/vnl_matrix_exp.h"
+#include "vnl/algo/vnl_qr.h"
+#include "vnl/algo/vnl_svd.h"
+#include "vnl/algo/vnl_svd_economy.h"
+#include "vnl/algo/vnl_symmetric_eigensystem.h"
+#endif
+
+namespace itk
+{
+
+namespace
+{
+
+#ifdef ELASTIX_USE_EIGEN
+
+/** The vnl matrices are stored row by row, the Eigen decompositions work on
+ * column-major copies.
+ */
+template< class T >
+using RowMajorMatrixType = Eigen::Matrix< T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor >;
+template< class T >
+using ColumnMajorMatrixType = Eigen::Matrix< T, Eigen::Dynamic, Eigen::Dynamic >;
+template< class T >
+using VectorType = Eigen::Matrix< T, Eigen::Dynamic, 1 >;
+
+template< class T >
+Eigen::Map< const RowMajorMatrixType< T > >
+EigenMap( const vnl_matrix< T > & A )
+{
+  return Eigen::Map< const RowMajorMatrixType< T > >( A.data_block(), A.rows(), A.cols() );
+}
+
+
+template< class T >
+Eigen::Map< RowMajorMatrixType< T > >
+EigenMap( vnl_matrix< T > & A )
+{
+  return Eigen::Map< RowMajorMatrixType< T > >( A.data_block(), A.rows(), A.cols() );
+}
+
+
+template< class T >
+Eigen::Map< VectorType< T > >
+EigenMap( vnl_vector< T > & v )
+{
+  return Eigen::Map< VectorType< T > >( v.data_block(), v.size() );
+}
+
+
+#if EIGEN_VERSION_AT_LEAST( 3, 3, 0 )
+/** The divide and conquer SVD is much faster for large matrices. */
+template< class T >
+using SVDType = Eigen::BDCSVD< ColumnMajorMatrixType< T > >;
+#else
+template< class T >
+using SVDType = Eigen::JacobiSVD< ColumnMajorMatrixType< T > >;
+#endif
+
+#endif
+
+/**
+ * ******************** MultiplyImplementation ********************
+ */
+
+template< class T >
+void
+MultiplyImplementation( const vnl_matrix< T > & A, const vnl_matrix< T > & B,
+  vnl_matrix< T > & C, const bool transposeA )
+{
+#ifdef ELASTIX_USE_EIGEN
+  C.set_size( transposeA ? A.cols() : A.rows(), B.cols() );
+  if( transposeA )
+  {
+    EigenMap( C ).noalias() = EigenMap( A ).transpose() * EigenMap( B );
+  }
+  else
+  {
+    EigenMap( C ).noalias() = EigenMap( A ) * EigenMap( B );
+  }
+#else
+  if( transposeA )
+  {
+    C = A.transpose() * B;
+  }
+  else
+  {
+    C = A * B;
+  }
+#endif
+
+} // end MultiplyImplementation()
+
+
+/**
+ * ******************** QRInverseImplementation ********************
+ */
+
+template< class T >
+void
+QRInverseImplementation( const vnl_matrix< T > & A, vnl_matrix< T > & inverse )
+{
+#ifdef ELASTIX_USE_EIGEN
+  const ColumnMajorMatrixType< T > a = EigenMap( A );
+  inverse.set_size( A.rows(), A.cols() );
+  EigenMap( inverse ) = a.colPivHouseholderQr().inverse();
+#else
+  inverse = vnl_qr< T >( A ).inverse();
+#endif
+
+} // end QRInverseImplementation()
+
+
+/**
+ * ******************** PseudoInverseImplementation ********************
+ */
+
+template< class T >
+void
+PseudoInverseImplementation( const vnl_matrix< T > & A, const double tolerance,
+  vnl_matrix< T > & inverse )
+{
+#ifdef ELASTIX_USE_EIGEN
+  const SVDType< T > svd( ColumnMajorMatrixType< T >( EigenMap( A ) ),
+    Eigen::ComputeThinU | Eigen::ComputeThinV );
+
+  /** Treat the values like vnl_svd: zero those below the tolerance. */
+  VectorType< T > inverseSingularValues = svd.singularValues();
+  for( typename VectorType< T >::Index i = 0; i < inverseSingularValues.size(); ++i )
+  {
+    const T value = inverseSingularValues[ i ];
+    inverseSingularValues[ i ] = ( value == 0 || value < tolerance ) ? T( 0 ) : T( 1 ) / value;
+  }
+
+  inverse.set_size( A.cols(), A.rows() );
+  EigenMap( inverse ).noalias()
+    = svd.matrixV() * inverseSingularValues.asDiagonal() * svd.matrixU().transpose();
+#else
+  inverse = vnl_svd< T >( A, tolerance ).pinverse();
+#endif
+
+} // end PseudoInverseImplementation()
+
+
+/**
+ * ******************** SymmetricEigensystemImplementation ********************
+ */
+
+template< class T >
+void
+SymmetricEigensystemImplementation( const vnl_matrix< T > & A,
+  vnl_vector< T > & eigenvalues, vnl_matrix< T > & eigenvectors )
+{
+#ifdef ELASTIX_USE_EIGEN
+  const Eigen::SelfAdjointEigenSolver< ColumnMajorMatrixType< T > > eigensystem(
+    ColumnMajorMatrixType< T >( EigenMap( A ) ) );
+
+  eigenvalues.set_size( A.rows() );
+  eigenvectors.set_size( A.rows(), A.rows() );
+  EigenMap( eigenvalues )  = eigensystem.eigenvalues();
+  EigenMap( eigenvectors ) = eigensystem.eigenvectors();
+#else
+  const vnl_symmetric_eigensystem< T > eigensystem( A );
+
+  eigenvalues  = eigensystem.D.diagonal();
+  eigenvectors = eigensystem.V;
+#endif
+
+} // end SymmetricEigensystemImplementation()
+
+
+/**
+ * ******************** SingularValueDecompositionImplementation ********************
+ */
+
+template< class T >
+void
+SingularValueDecompositionImplementation( const vnl_matrix< T > & A,
+  vnl_vector< T > & singularValues, vnl_matrix< T > & V )
+{
+#ifdef ELASTIX_USE_EIGEN
+  const SVDType< T > svd( ColumnMajorMatrixType< T >( EigenMap( A ) ), Eigen::ComputeThinV );
+
+  singularValues.set_size( svd.singularValues().size() );
+  V.set_size( svd.matrixV().rows(), svd.matrixV().cols() );
+  EigenMap( singularValues ) = svd.singularValues();
+  EigenMap( V )              = svd.matrixV();
+#else
+  vnl_svd_economy< T > svd( A );
+
+  singularValues = svd.lambdas();
+  V              = svd.V();
+#endif
+
+} // end SingularValueDecompositionImplementation()
+
+
+/**
+ * ******************** MatrixExponentialImplementation ********************
+ */
+
+template< class T >
+void
+MatrixExponentialImplementation( const vnl_matrix< T > & A, vnl_matrix< T > & exponential )
+{
+#ifdef ELASTIX_USE_EIGEN
+  const ColumnMajorMatrixType< T > a = EigenMap( A );
+  exponential.set_size( A.rows(), A.cols() );
+  EigenMap( exponential ) = a.exp();
+#else
+  /** Compute in double precision, for which vnl instantiates vnl_matrix_exp. */
+  vnl_matrix< double > a( A.rows(), A.cols() );
+  std::copy( A.begin(), A.end(), a.begin() );
+  const vnl_matrix< double > e = vnl_matrix_exp( a );
+  exponential.set_size( A.rows(), A.cols() );
+  std::copy( e.begin(), e.end(), exponential.begin() );
+#endif
+
+} // end MatrixExponentialImplementation()
+
+
+} // end namespace
+
+/**
+ * ******************** IsUsingEigen ********************
+ */
+
+bool
+DenseLinearAlgebra
+::IsUsingEigen( void )
+{
+#ifdef ELASTIX_USE_EIGEN
+  return true;
+#else
+  return false;
+#endif
+
+} // end IsUsingEigen()
+
+
+/**
+ * ******************** SetNumberOfThreads ********************
+ */
+
+void
+DenseLinearAlgebra
+::SetNumberOfThreads( const unsigned int numberOfThreads )
+{
+#ifdef ELASTIX_USE_EIGEN
+  Eigen::setNbThreads( static_cast< int >( numberOfThreads ) );
+#else
+  (void)numberOfThreads;
+#endif
+
+} // end SetNumberOfThreads()
+
+
+/**
+ * ******************** GetNumberOfThreads ********************
+ */
+
+unsigned int
+DenseLinearAlgebra
+::GetNumberOfThreads( void )
+{
+#ifdef ELASTIX_USE_EIGEN
+  return static_cast< unsigned int >( Eigen::nbThreads() );
+#else
+  return 1;
+#endif
+
+} // end GetNumberOfThreads()
+
+
+/**
+ * ******************** Multiply ********************
+ */
+
+void
+DenseLinearAlgebra
+::Multiply( const vnl_matrix< double > & A,
+  const vnl_matrix< double > & B, vnl_matrix< double > & C )
+{
+  MultiplyImplementation( A, B, C, false );
+} // end Multiply()
+
+
+void
+DenseLinearAlgebra
+::Multiply( const vnl_matrix< float > & A,
+  const vnl_matrix< float > & B, vnl_matrix< float > & C )
+{
+  MultiplyImplementation( A, B, C, false );
+} // end Multiply()
+
+
+/**
+ * ******************** TransposeMultiply ********************
+ */
+
+void
+DenseLinearAlgebra
+::TransposeMultiply( const vnl_matrix< double > & A,
+  const vnl_matrix< double > & B, vnl_matrix< double > & C )
+{
+  MultiplyImplementation( A, B, C, true );
+} // end TransposeMultiply()
+
+
+void
+DenseLinearAlgebra
+::TransposeMultiply( const vnl_matrix< float > & A,
+  const vnl_matrix< float > & B, vnl_matrix< float > & C )
+{
+  MultiplyImplementation( A, B, C, true );
+} // end TransposeMultiply()
+
+
+/**
+ * ******************** QRInverse ********************
+ */
+
+void
+DenseLinearAlgebra
+::QRInverse( const vnl_matrix< double > & A, vnl_matrix< double > & inverse )
+{
+  QRInverseImplementation( A, inverse );
+} // end QRInverse()
+
+
+void
+DenseLinearAlgebra
+::QRInverse( const vnl_matrix< float > & A, vnl_matrix< float > & inverse )
+{
+  QRInverseImplementation( A, inverse );
+} // end QRInverse()
+
+
+/**
+ * ******************** PseudoInverse ********************
+ */
+
+void
+DenseLinearAlgebra
+::PseudoInverse( const vnl_matrix< double > & A, const double tolerance,
+  vnl_matrix< double > & inverse )
+{
+  PseudoInverseImplementation( A, tolerance, inverse );
+} // end PseudoInverse()
+
+
+void
+DenseLinearAlgebra
+::PseudoInverse( const vnl_matrix< float > & A, const double tolerance,
+  vnl_matrix< float > & inverse )
+{
+  PseudoInverseImplementation( A, tolerance, inverse );
+} // end PseudoInverse()
+
+
+/**
+ * ******************** SymmetricEigensystem ********************
+ */
+
+void
+DenseLinearAlgebra
+::SymmetricEigensystem( const vnl_matrix< double > & A,
+  vnl_vector< double > & eigenvalues, vnl_matrix< double > & eigenvectors )
+{
+  SymmetricEigensystemImplementation( A, eigenvalues, eigenvectors );
+} // end SymmetricEigensystem()
+
+
+void
+DenseLinearAlgebra
+::SymmetricEigensystem( const vnl_matrix< float > & A,
+  vnl_vector< float > & eigenvalues, vnl_matrix< float > & eigenvectors )
+{
+  SymmetricEigensystemImplementation( A, eigenvalues, eigenvectors );
+} // end SymmetricEigensystem()
+
+
+/**
+ * ******************** SingularValueDecomposition ********************
+ */
+
+void
+DenseLinearAlgebra
+::SingularValueDecomposition( const vnl_matrix< double > & A,
+  vnl_vector< double > & singularValues, vnl_matrix< double > & V )
+{
+  SingularValueDecompositionImplementation( A, singularValues, V );
+} // end SingularValueDecomposition()
+
+
+void
+DenseLinearAlgebra
+::SingularValueDecomposition( const vnl_matrix< float > & A,
+  vnl_vector< float > & singularValues, vnl_matrix< float > & V )
+{
+  SingularValueDecompositionImplementation( A, singularValues, V );
+} // end SingularValueDecomposition()
+
+
+/**
+ * ******************** MatrixExponential ********************
+ */
+
+void
+DenseLinearAlgebra
+::MatrixExponential( const vnl_matrix< double > & A, vnl_matrix< double > & exponential )
+{
+  MatrixExponentialImplementation( A, exponential );
+} // end MatrixExponential()
+
+
+void
+DenseLinearAlgebra
+::MatrixExponential( const vnl_matrix< float > & A, vnl_matrix< float > & exponential )
+{
+  MatrixExponentialImplementation( A, exponential );
+} // end MatrixExponential()
+
+
+} // end namespace itk
@@ -0,0 +1,121 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkDenseLinearAlgebra_h
+#define __itkDenseLinearAlgebra_h
+
+#include "vnl/vnl_matrix.h"
+#include "vnl/vnl_vector.h"
+
+namespace itk
+{
+
+/** \class DenseLinearAlgebra
+ *
+ * \brief The dense matrix products, inverses and decompositions of the
+ * matrix-heavy components.
+ *
+ * The KernelTransform2, the PCAMetric, the StatisticalShapePointPenalty and
+ * the AffineLogTransform compute with dense vnl matrices. When elastix is
+ * built with ELASTIX_USE_EIGEN, the functions of this class wrap those
+ * matrices in Eigen maps, without copying them, and use the vectorized,
+ * cache-blocked kernels of Eigen. Otherwise they call vnl. The results are
+ * the same as those of vnl up to rounding; the eigenvalues and singular
+ * values are in the same order, but the signs of the vectors may differ.
+ *
+ * The products are multi-threaded by Eigen when it is compiled with OpenMP,
+ * see SetNumberOfThreads().
+ *
+ * \ingroup ITKCommon
+ */
+
+class DenseLinearAlgebra
+{
+public:
+
+  /** Whether the functions use Eigen, i.e. whether elastix is built with
+   * ELASTIX_USE_EIGEN.
+   */
+  static bool IsUsingEigen( void );
+
+  /** Set the number of threads of the Eigen products, 0 for the default of
+   * Eigen. Without Eigen, or without OpenMP, this does nothing.
+   */
+  static void SetNumberOfThreads( const unsigned int numberOfThreads );
+
+  /** Get the number of threads of the Eigen products, 1 without Eigen. */
+  static unsigned int GetNumberOfThreads( void );
+
+  /** C = A * B. C may not be A or B. */
+  static void Multiply( const vnl_matrix< double > & A,
+    const vnl_matrix< double > & B, vnl_matrix< double > & C );
+  static void Multiply( const vnl_matrix< float > & A,
+    const vnl_matrix< float > & B, vnl_matrix< float > & C );
+
+  /** C = A^T * B, without forming A^T. C may not be A or B. */
+  static void TransposeMultiply( const vnl_matrix< double > & A,
+    const vnl_matrix< double > & B, vnl_matrix< double > & C );
+  static void TransposeMultiply( const vnl_matrix< float > & A,
+    const vnl_matrix< float > & B, vnl_matrix< float > & C );
+
+  /** The inverse of a square matrix by a QR decomposition with column
+   * pivoting, like vnl_qr< T >( A ).inverse().
+   */
+  static void QRInverse( const vnl_matrix< double > & A, vnl_matrix< double > & inverse );
+  static void QRInverse( const vnl_matrix< float > & A, vnl_matrix< float > & inverse );
+
+  /** The Moore-Penrose pseudo-inverse by a singular value decomposition,
+   * like vnl_svd< T >( A, tolerance ).pinverse(): singular values that are
+   * zero, or smaller than the tolerance, are treated as zero.
+   */
+  static void PseudoInverse( const vnl_matrix< double > & A, const double tolerance,
+    vnl_matrix< double > & inverse );
+  static void PseudoInverse( const vnl_matrix< float > & A, const double tolerance,
+    vnl_matrix< float > & inverse );
+
+  /** The eigenvalues, in ascending order, and the eigenvectors, as the
+   * columns, of a symmetric matrix, like vnl_symmetric_eigensystem< T >.
+   * Only the lower triangle of A is used.
+   */
+  static void SymmetricEigensystem( const vnl_matrix< double > & A,
+    vnl_vector< double > & eigenvalues, vnl_matrix< double > & eigenvectors );
+  static void SymmetricEigensystem( const vnl_matrix< float > & A,
+    vnl_vector< float > & eigenvalues, vnl_matrix< float > & eigenvectors );
+
+  /** The singular values, in descending order, and the right singular
+   * vectors, as the columns of V, like vnl_svd_economy< T >.
+   */
+  static void SingularValueDecomposition( const vnl_matrix< double > & A,
+    vnl_vector< double > & singularValues, vnl_matrix< double > & V );
+  static void SingularValueDecomposition( const vnl_matrix< float > & A,
+    vnl_vector< float > & singularValues, vnl_matrix< float > & V );
+
+  /** The matrix exponential of a square matrix, like vnl_matrix_exp. */
+  static void MatrixExponential( const vnl_matrix< double > & A, vnl_matrix< double > & exponential );
+  static void MatrixExponential( const vnl_matrix< float > & A, vnl_matrix< float > & exponential );
+
+private:
+
+  DenseLinearAlgebra();                             // purposely not implemented
+  DenseLinearAlgebra( const DenseLinearAlgebra & ); // purposely not implemented
+  void operator=( const DenseLinearAlgebra & );     // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkDenseLinearAlgebra_h
@@ -21,6 +21,11 @@
 #include "itkImageToImageFilter.h"
 #include "itkMultiResolutionPyramidImageFilter.h"
 
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <utility>
+
 namespace itk
 {
 /**
@@ -48,6 +53,15 @@ namespace itk
  *   the derivative of the metric.\n
  *   --> <tt>radius = static_cast<unsigned long>( 2 * schedule + 1 );</tt>
  *
+ * With UseCache, the eroded masks are kept in a cache that is shared by all
+ * filters of the same image type, with a key that combines the hash of the
+ * contents and geometry of the input mask with the radius. Registrations
+ * with the same mask and schedule, like the runs of a batch, then erode the
+ * mask only once per resolution. The output shares its buffer with the
+ * cache, so it should not be modified. The cache keeps at most
+ * MaximumNumberOfCachedPixels, and removes the least recently used masks
+ * first.
+ *
  *
  * \sa ParabolicErodeImageFilter
  *
@@ -117,6 +131,19 @@ public:
   itkSetMacro( ResolutionLevel, unsigned int );
   itkGetConstMacro( ResolutionLevel, unsigned int );
 
+  /** Set/Get whether the eroded masks are shared through the cache.
+   * Default: false.
+   */
+  itkSetMacro( UseCache, bool );
+  itkGetConstMacro( UseCache, bool );
+  itkBooleanMacro( UseCache );
+
+  /** The maximum number of pixels of the eroded masks in the cache. */
+  itkStaticConstMacro( MaximumNumberOfCachedPixels, SizeValueType, 64 * 1024 * 1024 );
+
+  /** Remove all eroded masks of this image type from the cache. */
+  static void ClearCache( void );
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   /** Begin concept checking */
   itkConceptMacro( SameDimensionCheck,
@@ -143,9 +170,27 @@ private:
   ErodeMaskImageFilter( const Self & );    // purposely not implemented
   void operator=( const Self & );          // purposely not implemented
 
+  /** The cache of the eroded masks, the most recently used last. */
+  typedef std::uint64_t                                         KeyType;
+  typedef std::list< std::pair< KeyType, OutputImagePointer > > CacheListType;
+
+  struct CacheType
+  {
+    std::mutex    m_Mutex;
+    CacheListType m_Entries;
+  };
+
+  /** Get the cache that is shared by all filters of this type. */
+  static CacheType & GetCache( void );
+
+  /** Return the key of the eroded input mask for a radius. */
+  template< class TRadius >
+  KeyType ComputeKey( const TRadius & radius ) const;
+
   bool         m_IsMovingMask;
   unsigned int m_ResolutionLevel;
   ScheduleType m_Schedule;
+  bool         m_UseCache;
 
 };
 
@@ -20,6 +20,7 @@
 
 #include "itkErodeMaskImageFilter.h"
 #include "itkParabolicErodeImageFilter.h"
+#include "itkDataHash.h"
 //#include "itkThresholdImageFilter.h"
 
 namespace itk
@@ -35,6 +36,7 @@ ErodeMaskImageFilter< TImage >
 {
   this->m_IsMovingMask    = false;
   this->m_ResolutionLevel = 0;
+  this->m_UseCache        = false;
 
   ScheduleType defaultSchedule( 1, InputImageDimension );
   defaultSchedule.Fill( NumericTraits< unsigned int >::OneValue() );
@@ -88,6 +90,27 @@ ErodeMaskImageFilter< TImage >
   threshold->SetOutsideValue( itk::NumericTraits<InputPixelType>::OneValue() );
   threshold->SetInput( this->GetInput() ); */
 
+  /** Look for the eroded mask in the cache. */
+  KeyType key = 0;
+  if( this->m_UseCache )
+  {
+    key = this->ComputeKey( radiusarray );
+
+    CacheType & cache = GetCache();
+    std::lock_guard< std::mutex > lock( cache.m_Mutex );
+    for( typename CacheListType::iterator it = cache.m_Entries.begin();
+      it != cache.m_Entries.end(); ++it )
+    {
+      if( it->first == key )
+      {
+        /** Mark the mask as the most recently used. */
+        cache.m_Entries.splice( cache.m_Entries.end(), cache.m_Entries, it );
+        this->GraftOutput( cache.m_Entries.back().second );
+        return;
+      }
+    }
+  }
+
   /** Create and run the erosion filter. */
   typename ErodeFilterType::Pointer erosion = ErodeFilterType::New();
   erosion->SetUseImageSpacing( false );
@@ -96,14 +119,102 @@ ErodeMaskImageFilter< TImage >
   erosion->SetInput( this->GetInput() );
   erosion->Update();
 
+  OutputImagePointer eroded = erosion->GetOutput();
+  eroded->DisconnectPipeline();
+
   /** Graft the output of the mini-pipeline back onto the filter's output.
    * this copies back the region ivars and meta-data.
    */
-  this->GraftOutput( erosion->GetOutput() );
+  this->GraftOutput( eroded );
+
+  /** Store the eroded mask, and remove the least recently used masks. */
+  const SizeValueType numberOfPixels = eroded->GetBufferedRegion().GetNumberOfPixels();
+  if( this->m_UseCache && numberOfPixels <= MaximumNumberOfCachedPixels )
+  {
+    CacheType & cache = GetCache();
+    std::lock_guard< std::mutex > lock( cache.m_Mutex );
+    SizeValueType numberOfCachedPixels = numberOfPixels;
+    for( typename CacheListType::const_iterator it = cache.m_Entries.begin();
+      it != cache.m_Entries.end(); ++it )
+    {
+      numberOfCachedPixels += it->second->GetBufferedRegion().GetNumberOfPixels();
+    }
+    while( numberOfCachedPixels > MaximumNumberOfCachedPixels )
+    {
+      numberOfCachedPixels -= cache.m_Entries.front().second->GetBufferedRegion().GetNumberOfPixels();
+      cache.m_Entries.pop_front();
+    }
+    cache.m_Entries.push_back( std::make_pair( key, eroded ) );
+  }
 
 } // end GenerateData()
 
 
+/**
+ * ************* ComputeKey *******************
+ */
+
+template< class TImage >
+template< class TRadius >
+typename ErodeMaskImageFilter< TImage >::KeyType
+ErodeMaskImageFilter< TImage >
+::ComputeKey( const TRadius & radius ) const
+{
+  const InputImageType * image = this->GetInput();
+  const typename InputImageType::RegionType & region = image->GetBufferedRegion();
+
+  DataHash::HashType hash = DataHash::InitialValue;
+  for( unsigned int i = 0; i < InputImageDimension; ++i )
+  {
+    hash = DataHash::CombineValue( hash, static_cast< double >( radius[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< std::int64_t >( region.GetIndex()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< std::uint64_t >( region.GetSize()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< double >( image->GetSpacing()[ i ] ) );
+    hash = DataHash::CombineValue( hash, static_cast< double >( image->GetOrigin()[ i ] ) );
+    for( unsigned int j = 0; j < InputImageDimension; ++j )
+    {
+      hash = DataHash::CombineValue( hash, static_cast< double >( image->GetDirection()[ i ][ j ] ) );
+    }
+  }
+  hash = DataHash::Combine( hash, image->GetBufferPointer(),
+    region.GetNumberOfPixels() * sizeof( InputPixelType ) );
+  return hash;
+
+} // end ComputeKey()
+
+
+/**
+ * ************* GetCache *******************
+ */
+
+template< class TImage >
+typename ErodeMaskImageFilter< TImage >::CacheType &
+ErodeMaskImageFilter< TImage >
+::GetCache( void )
+{
+  /** The initialization of a local static is thread-safe. */
+  static CacheType cache;
+  return cache;
+
+} // end GetCache()
+
+
+/**
+ * ************* ClearCache *******************
+ */
+
+template< class TImage >
+void
+ErodeMaskImageFilter< TImage >
+::ClearCache( void )
+{
+  CacheType & cache = GetCache();
+  std::lock_guard< std::mutex > lock( cache.m_Mutex );
+  cache.m_Entries.clear();
+
+} // end ClearCache()
+
+
 } // end namespace itk
 
 #endif
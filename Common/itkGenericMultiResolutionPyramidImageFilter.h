@@ -21,6 +21,8 @@
 #include "itkMultiResolutionPyramidImageFilter.h"
 #include "itkSmoothingRecursiveGaussianImageFilter.h"
 
+#include <future>
+
 namespace itk
 {
 /** \class GenericMultiResolutionPyramidImageFilter
@@ -98,6 +100,40 @@ namespace itk
  * compute only single level of the pyramid via SetCurrentLevel() and
  * SetComputeOnlyForCurrentLevel() methods.
  *
+ * With SetUseCascadedComputation(), all levels are computed from the finest
+ * level to the coarsest, and each level is computed from the next finer
+ * level instead of from the input. Only the remainder of the smoothing is
+ * applied, with sigma = sqrt( sigma_level^2 - sigma_finer^2 ), and the finer
+ * level is rescaled by the ratio of the shrink factors. So the smoothing with
+ * large sigmas runs at a coarse resolution, instead of at the resolution of
+ * the input. The result equals the direct computation up to the error of
+ * rescaling the finer level. A level is computed from the input if its
+ * sigmas or shrink factors are smaller than those of the finer level, or
+ * if the shrinker is used and the ratio of the shrink factors is not an
+ * integer. The cascaded computation needs all levels, so it is not used
+ * when only the current level is computed.
+ *
+ * With SetComputeNextLevelInBackground(), when only the current level is
+ * computed, the next level is computed on a background thread after the
+ * current level, by a separate pipeline on a copy of the input. The
+ * registration can start on the current level in the meantime, and the next
+ * level is ready, or nearly so, when SetCurrentLevel() moves on to it. At
+ * most two levels are then held in memory. The filters of the background
+ * pipeline use a single work unit, so that they leave the other threads to
+ * the registration. The schedules and the number of levels wait for the
+ * background thread when they are set. Call DiscardNextLevel() before
+ * changing the input image in place.
+ *
+ * A level that is smoothed in every dimension and shrunk by the
+ * ShrinkImageFilter is computed one dimension at a time: the input is
+ * smoothed along a dimension and then shrunk along it, before the next
+ * dimension is smoothed. So the later smoothing passes only visit the lines
+ * that the shrinking keeps, and the smoothed image at the full size is not
+ * kept. The pixels equal those of smoothing before shrinking, since the
+ * smoothing along one dimension commutes with the selection along another.
+ * A level that is neither smoothed nor rescaled shares the buffer of the
+ * input, when the input and output types are equal, instead of copying it.
+ *
  * \author Denis P. Shamonin and Marius Staring. Division of Image Processing,
  * Department of Radiology, Leiden, The Netherlands
  *
@@ -220,6 +256,25 @@ public:
   itkGetConstMacro( ComputeOnlyForCurrentLevel, bool );
   itkBooleanMacro( ComputeOnlyForCurrentLevel );
 
+  /** Set/Get whether each level is computed from the next finer level. The
+   * default is false.
+   */
+  itkSetMacro( UseCascadedComputation, bool );
+  itkGetConstMacro( UseCascadedComputation, bool );
+  itkBooleanMacro( UseCascadedComputation );
+
+  /** Set/Get whether the next level is computed in the background, when only
+   * the current level is computed. The default is false.
+   */
+  itkSetMacro( ComputeNextLevelInBackground, bool );
+  itkGetConstMacro( ComputeNextLevelInBackground, bool );
+  itkBooleanMacro( ComputeNextLevelInBackground );
+
+  /** Wait until the level that is computed in the background is finished,
+   * and discard it.
+   */
+  void DiscardNextLevel( void );
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   /** Begin concept checking */
   itkConceptMacro( SameDimensionCheck,
@@ -232,7 +287,11 @@ public:
 protected:
 
   GenericMultiResolutionPyramidImageFilter();
-  ~GenericMultiResolutionPyramidImageFilter() override {}
+  ~GenericMultiResolutionPyramidImageFilter() override
+  {
+    this->DiscardNextLevel();
+  }
+
 
   /** PrintSelf. */
   void PrintSelf( std::ostream & os, Indent indent ) const override;
@@ -266,6 +325,8 @@ protected:
   unsigned int          m_CurrentLevel;
   bool                  m_ComputeOnlyForCurrentLevel;
   bool                  m_SmoothingScheduleDefined;
+  bool                  m_UseCascadedComputation;
+  bool                  m_ComputeNextLevelInBackground;
 
 private:
 
@@ -310,6 +371,46 @@ private:
     typename ImageToImageFilterSameTypes::Pointer & rescaleSameTypes,
     typename ImageToImageFilterDifferentTypes::Pointer & rescaleDifferentTypes );
 
+  /** Typedef for the smoother of the cascaded computation, which smooths a
+   * level of the pyramid.
+   */
+  typedef SmoothingRecursiveGaussianImageFilter<
+    OutputImageType, OutputImageType > LevelSmootherType;
+
+  /** Compute the output of a level from the output of the next finer level.
+   * Returns false if that is not possible, see SetUseCascadedComputation().
+   * This method performs execution.
+   */
+  bool GenerateLevelFromFinerLevel( const unsigned int level,
+    const OutputImagePointer & outputPtr,
+    typename ImageToImageFilterSameTypes::Pointer & rescaleSameTypes );
+
+  /** Compute a level by smoothing and shrinking one dimension at a time,
+   * with the internal filters of TSmoother. Returns a null pointer if not
+   * all sigmas are positive, if a shrink factor is not an integer, if no
+   * dimension is shrunk, or if the resampler is used instead of the
+   * shrinker. A positive number of work units is set in the filters. This
+   * method performs execution.
+   */
+  template< class TSmoother >
+  OutputImagePointer GenerateLevelBySeparableSmoothingAndShrinking(
+    const typename TSmoother::InputImageType * input,
+    const SigmaArrayType & sigmaArray,
+    const RescaleFactorArrayType & shrinkFactors,
+    OutputImageType * outputPtr,
+    const ThreadIdType numberOfWorkUnits ) const;
+
+  /** Start computing the level after the current level on a background
+   * thread, if requested.
+   */
+  void StartNextLevelInBackground( void );
+
+  /** Compute a level with a separate pipeline, that only uses the given
+   * input and output. Executed by the background thread.
+   */
+  OutputImagePointer GenerateLevelInBackground( const unsigned int level,
+    InputImageConstPointer input, OutputImagePointer outputPtr );
+
   /** Initialize m_SmoothingSchedule to default values for backward compatibility. */
   void SetSmoothingScheduleToDefault( void );
 
@@ -348,6 +449,15 @@ private:
   /** Returns true if rescale has been used in pipeline, otherwise return false. */
   bool IsRescaleUsed( void ) const;
 
+  /** The level that is computed in the background. It is valid as long as
+   * the modified times of this filter and of its input equal the ones at the
+   * start.
+   */
+  std::future< OutputImagePointer > m_NextLevel;
+  unsigned int                      m_NextLevelIndex;
+  ModifiedTimeType                  m_NextLevelMTime;
+  ModifiedTimeType                  m_NextLevelInputMTime;
+
 private:
 
   GenericMultiResolutionPyramidImageFilter( const Self & ); // purposely not implemented
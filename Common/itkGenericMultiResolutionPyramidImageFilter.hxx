@@ -22,8 +22,12 @@
 
 #include "itkResampleImageFilter.h"
 #include "itkShrinkImageFilter.h"
+#include "itkCastImageFilter.h"
 #include "itkImageAlgorithm.h"
 
+#include <cmath>
+#include <vector>
+
 namespace // anonymous namespace
 {
 /**
@@ -47,6 +51,59 @@ UpdateAndGraft(
 } // end UpdateAndGraft()
 
 
+/**
+ * ******************* UpdateDetached ***********************
+ */
+
+template< class ImageToImageFilterType, typename OutputImageType >
+typename OutputImageType::Pointer
+UpdateDetached(
+  typename ImageToImageFilterType::Pointer & filter,
+  OutputImageType * outImage )
+{
+  filter->GraftOutput( outImage );
+  filter->UpdateLargestPossibleRegion();
+
+  typename OutputImageType::Pointer output = filter->GetOutput();
+  output->DisconnectPipeline();
+  return output;
+} // end UpdateDetached()
+
+
+/**
+ * ******************* ShareOrCopy ***********************
+ */
+
+template< typename InputImageType, typename OutputImageType >
+void
+ShareOrCopy( const InputImageType * input, OutputImageType * output )
+{
+  ImageAlgorithm::Copy( input, output,
+    input->GetLargestPossibleRegion(), output->GetLargestPossibleRegion() );
+} // end ShareOrCopy()
+
+
+/** The output of the same type shares the buffer of the input, if the input
+ * is buffered completely. The pyramid outputs are not modified in place.
+ */
+template< typename ImageType >
+void
+ShareOrCopy( const ImageType * input, ImageType * output )
+{
+  if( input->GetBufferedRegion() != input->GetLargestPossibleRegion()
+    || output->GetRequestedRegion() != input->GetLargestPossibleRegion() )
+  {
+    ImageAlgorithm::Copy( input, output,
+      input->GetLargestPossibleRegion(), output->GetLargestPossibleRegion() );
+    return;
+  }
+
+  output->SetPixelContainer(
+    const_cast< typename ImageType::PixelContainer * >( input->GetPixelContainer() ) );
+  output->SetBufferedRegion( input->GetBufferedRegion() );
+} // end ShareOrCopy()
+
+
 } // end namespace anonymous
 
 namespace itk
@@ -65,6 +122,12 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
   temp.Fill( NumericTraits< ScalarRealType >::ZeroValue() );
   this->m_SmoothingSchedule        = temp;
   this->m_SmoothingScheduleDefined = false;
+  this->m_UseCascadedComputation   = false;
+
+  this->m_ComputeNextLevelInBackground = false;
+  this->m_NextLevelIndex               = 0;
+  this->m_NextLevelMTime               = 0;
+  this->m_NextLevelInputMTime          = 0;
 } // end Constructor
 
 
@@ -78,6 +141,7 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
 ::SetNumberOfLevels( unsigned int num )
 {
   if( this->m_NumberOfLevels == num ) { return; }
+  this->DiscardNextLevel();
   Superclass::SetNumberOfLevels( num );
 
   /** Resize the smoothing schedule too. */
@@ -113,7 +177,14 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
     /** Only set the modified flag for this filter if the output is computed per level. */
     if( this->m_ComputeOnlyForCurrentLevel )
     {
+      /** The level in the background remains valid. */
+      const bool nextLevelIsValid = this->m_NextLevel.valid()
+        && this->GetMTime() == this->m_NextLevelMTime;
       this->Modified();
+      if( nextLevelIsValid )
+      {
+        this->m_NextLevelMTime = this->GetMTime();
+      }
     }
   }
 } // end SetCurrentLevel()
@@ -147,6 +218,7 @@ void
 GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
 ::SetSchedule( const ScheduleType & schedule )
 {
+  this->DiscardNextLevel();
   Superclass::SetSchedule( schedule );
 
   /** This part is to make sure that only combination of
@@ -175,6 +247,7 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
    * from MultiResolutionPyramidImageFilter and changing m_Schedule
    * to m_RescaleSchedule.
    */
+  this->DiscardNextLevel();
   Superclass::SetSchedule( schedule );
 } // end SetRescaleSchedule()
 
@@ -215,6 +288,8 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
     return;
   }
 
+  this->DiscardNextLevel();
+
   for( unsigned int level = 0; level < this->m_NumberOfLevels; level++ )
   {
     for( unsigned int dim = 0; dim < ImageDimension; dim++ )
@@ -294,10 +369,30 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
   //
   // Pipeline also takes care of memory allocation for N'th output if
   // SetComputeOnlyForCurrentLevel has been set to true.
+  //
+  // In the cascaded computation the levels are computed from fine to coarse,
+  // and a level is computed from the next finer level if possible:
+  // finer level -> smoother -> shrinker/resample -> output
 
   // Get the input and output pointers
   InputImageConstPointer input = this->GetInput();
 
+  // Use the level that was computed in the background, if its settings and
+  // input were not modified since it was started
+  if( this->m_NextLevel.valid() )
+  {
+    if( this->m_ComputeOnlyForCurrentLevel
+      && this->m_NextLevelIndex == this->m_CurrentLevel
+      && this->m_NextLevelMTime == this->GetMTime()
+      && this->m_NextLevelInputMTime == input->GetMTime() )
+    {
+      this->GraftNthOutput( this->m_CurrentLevel, this->m_NextLevel.get() );
+      this->StartNextLevelInBackground();
+      return;
+    }
+    this->DiscardNextLevel();
+  }
+
   // Check if we have to do anything at all
   if( !this->IsSmoothingUsed() && !this->IsRescaleUsed() )
   {
@@ -316,8 +411,7 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
         outputPtr->SetBufferedRegion( input->GetLargestPossibleRegion() );
         outputPtr->Allocate();
 
-        ImageAlgorithm::Copy( input.GetPointer(), outputPtr.GetPointer(),
-          input->GetLargestPossibleRegion(), outputPtr->GetLargestPossibleRegion() );
+        ShareOrCopy( input.GetPointer(), outputPtr.GetPointer() );
       }
     }
     return; // We are done, return
@@ -333,14 +427,20 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
   typename ImageToImageFilterSameTypes::Pointer rescaleSameTypes;
   typename ImageToImageFilterDifferentTypes::Pointer rescaleDifferentTypes;
 
-  for( unsigned int level = 0; level < this->m_NumberOfLevels; ++level )
+  // The cascaded computation needs the finer levels
+  const bool cascaded = this->m_UseCascadedComputation && !this->m_ComputeOnlyForCurrentLevel;
+
+  for( unsigned int i = 0; i < this->m_NumberOfLevels; ++i )
   {
     if( !this->m_ComputeOnlyForCurrentLevel )
     {
-      this->UpdateProgress( static_cast< float >( level )
+      this->UpdateProgress( static_cast< float >( i )
         / static_cast< float >( this->m_NumberOfLevels ) );
     }
 
+    // The cascaded computation starts at the finest level
+    const unsigned int level = cascaded ? this->m_NumberOfLevels - 1 - i : i;
+
     if( this->ComputeForCurrentLevel( level ) )
     {
       // Allocate memory for each output
@@ -348,6 +448,27 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
       outputPtr->SetBufferedRegion( outputPtr->GetRequestedRegion() );
       outputPtr->Allocate();
 
+      // Compute the level from the finer level, if possible
+      if( cascaded && i > 0
+        && this->GenerateLevelFromFinerLevel( level, outputPtr, rescaleSameTypes ) )
+      {
+        continue;
+      }
+
+      // Smooth and shrink one dimension at a time, if possible
+      SigmaArrayType         sigmaArray;
+      RescaleFactorArrayType shrinkFactors;
+      this->GetSigma( level, sigmaArray );
+      this->GetShrinkFactors( level, shrinkFactors );
+      OutputImagePointer separableOutput
+        = this->template GenerateLevelBySeparableSmoothingAndShrinking< SmootherType >(
+        input, sigmaArray, shrinkFactors, outputPtr, 0 );
+      if( separableOutput.IsNotNull() )
+      {
+        this->GraftNthOutput( level, separableOutput );
+        continue;
+      }
+
       // Setup the smoother
       const bool smootherIsUsed = this->SetupSmoother( level, smoother, input );
 
@@ -364,8 +485,7 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
       }
       else if( shrinkerOrResamplerIsUsed == 0 )
       {
-        ImageAlgorithm::Copy( input.GetPointer(), outputPtr.GetPointer(),
-          input->GetLargestPossibleRegion(), outputPtr->GetLargestPossibleRegion() );
+        ShareOrCopy( input.GetPointer(), outputPtr.GetPointer() );
       }
       else if( shrinkerOrResamplerIsUsed == 1 )
       {
@@ -381,9 +501,315 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
 
     }
   } // end for ilevel
+
+  this->StartNextLevelInBackground();
 } // end GenerateData()
 
 
+/**
+ * ******************* StartNextLevelInBackground ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+void
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::StartNextLevelInBackground( void )
+{
+  const unsigned int level = this->m_CurrentLevel + 1;
+  if( !this->m_ComputeNextLevelInBackground || !this->m_ComputeOnlyForCurrentLevel
+    || level >= this->m_NumberOfLevels )
+  {
+    return;
+  }
+
+  // Disconnect the input from its pipeline, and allocate the output with the
+  // information that was generated for the level
+  typename InputImageType::Pointer input = InputImageType::New();
+  input->Graft( this->GetInput() );
+
+  OutputImagePointer output = OutputImageType::New();
+  output->CopyInformation( this->GetOutput( level ) );
+  output->SetRequestedRegion( this->GetOutput( level )->GetRequestedRegion() );
+  output->SetBufferedRegion( output->GetRequestedRegion() );
+  output->Allocate();
+
+  this->m_NextLevelIndex      = level;
+  this->m_NextLevelMTime      = this->GetMTime();
+  this->m_NextLevelInputMTime = this->GetInput()->GetMTime();
+  this->m_NextLevel           = std::async( std::launch::async,
+    &Self::GenerateLevelInBackground, this, level,
+    InputImageConstPointer( input.GetPointer() ), output );
+
+} // end StartNextLevelInBackground()
+
+
+/**
+ * ******************* GenerateLevelInBackground ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+typename GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >::OutputImagePointer
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::GenerateLevelInBackground( const unsigned int level,
+  InputImageConstPointer input, OutputImagePointer outputPtr )
+{
+  typename SmootherType::Pointer smoother;
+  typename ImageToImageFilterSameTypes::Pointer rescaleSameTypes;
+  typename ImageToImageFilterDifferentTypes::Pointer rescaleDifferentTypes;
+
+  // Smooth and shrink one dimension at a time, if possible, with a single
+  // work unit to leave the other threads to the registration
+  SigmaArrayType         sigmaArray;
+  RescaleFactorArrayType shrinkFactors;
+  this->GetSigma( level, sigmaArray );
+  this->GetShrinkFactors( level, shrinkFactors );
+  OutputImagePointer separableOutput
+    = this->template GenerateLevelBySeparableSmoothingAndShrinking< SmootherType >(
+    input, sigmaArray, shrinkFactors, outputPtr, 1 );
+  if( separableOutput.IsNotNull() )
+  {
+    return separableOutput;
+  }
+
+  // Setup the smoother and the shrinker or resampler, as in GenerateData()
+  const bool smootherIsUsed = this->SetupSmoother( level, smoother, input );
+  const int shrinkerOrResamplerIsUsed = this->SetupShrinkerOrResampler( level,
+    smoother, smootherIsUsed, input, outputPtr,
+    rescaleSameTypes, rescaleDifferentTypes );
+
+  // Leave the other threads to the registration
+  if( smootherIsUsed ) { smoother->SetNumberOfWorkUnits( 1 ); }
+  if( rescaleSameTypes ) { rescaleSameTypes->SetNumberOfWorkUnits( 1 ); }
+  if( rescaleDifferentTypes ) { rescaleDifferentTypes->SetNumberOfWorkUnits( 1 ); }
+
+  // Update the pipeline
+  if( shrinkerOrResamplerIsUsed == 0 && smootherIsUsed )
+  {
+    return UpdateDetached< SmootherType, OutputImageType >( smoother, outputPtr );
+  }
+  else if( shrinkerOrResamplerIsUsed == 1 )
+  {
+    return UpdateDetached< ImageToImageFilterSameTypes, OutputImageType >(
+      rescaleSameTypes, outputPtr );
+  }
+  else if( shrinkerOrResamplerIsUsed == 2 )
+  {
+    return UpdateDetached< ImageToImageFilterDifferentTypes, OutputImageType >(
+      rescaleDifferentTypes, outputPtr );
+  }
+
+  ShareOrCopy( input.GetPointer(), outputPtr.GetPointer() );
+  return outputPtr;
+
+} // end GenerateLevelInBackground()
+
+
+/**
+ * ******************* DiscardNextLevel ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+void
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::DiscardNextLevel( void )
+{
+  if( this->m_NextLevel.valid() )
+  {
+    /** An exception of the background thread concerns a level that is not
+     * used, so it is ignored.
+     */
+    try
+    {
+      this->m_NextLevel.get();
+    }
+    catch( ... )
+    {
+    }
+  }
+
+} // end DiscardNextLevel()
+
+
+/**
+ * ******************* GenerateLevelFromFinerLevel ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+bool
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::GenerateLevelFromFinerLevel( const unsigned int level,
+  const OutputImagePointer & outputPtr,
+  typename ImageToImageFilterSameTypes::Pointer & rescaleSameTypes )
+{
+  SigmaArrayType         sigmaArray;
+  SigmaArrayType         finerSigmaArray;
+  RescaleFactorArrayType shrinkFactors;
+  RescaleFactorArrayType finerShrinkFactors;
+  this->GetSigma( level, sigmaArray );
+  this->GetSigma( level + 1, finerSigmaArray );
+  this->GetShrinkFactors( level, shrinkFactors );
+  this->GetShrinkFactors( level + 1, finerShrinkFactors );
+
+  // The finer level is already smoothed and rescaled, so only the remainder
+  // is applied. Gaussian variances add up under convolution.
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    if( sigmaArray[ dim ] < finerSigmaArray[ dim ]
+      || shrinkFactors[ dim ] < finerShrinkFactors[ dim ] )
+    {
+      return false;
+    }
+
+    sigmaArray[ dim ] = std::sqrt( sigmaArray[ dim ] * sigmaArray[ dim ]
+      - finerSigmaArray[ dim ] * finerSigmaArray[ dim ] );
+    shrinkFactors[ dim ] /= finerShrinkFactors[ dim ];
+
+    if( this->GetUseShrinkImageFilter()
+      && shrinkFactors[ dim ] != std::floor( shrinkFactors[ dim ] ) )
+    {
+      return false;
+    }
+  }
+
+  // Disconnect the finer level from this filter, so that it can be the input
+  // of a pipeline that is executed from GenerateData()
+  typename OutputImageType::Pointer finer = OutputImageType::New();
+  finer->Graft( this->GetOutput( level + 1 ) );
+
+  // Smooth and shrink one dimension at a time, if possible
+  OutputImagePointer separableOutput
+    = this->template GenerateLevelBySeparableSmoothingAndShrinking< LevelSmootherType >(
+    finer, sigmaArray, shrinkFactors, outputPtr, 0 );
+  if( separableOutput.IsNotNull() )
+  {
+    this->GraftNthOutput( level, separableOutput );
+    return true;
+  }
+
+  // Setup the smoother
+  typename LevelSmootherType::Pointer smoother;
+  const bool smootherIsUsed = !this->AreSigmasAllZeros( sigmaArray );
+  if( smootherIsUsed )
+  {
+    smoother = LevelSmootherType::New();
+    smoother->SetInput( finer );
+    smoother->SetSigmaArray( sigmaArray );
+  }
+
+  // Setup the shrinker or resampler, and update the pipeline
+  if( !this->AreRescaleFactorsAllOnes( shrinkFactors ) )
+  {
+    typename ImageToImageFilterDifferentTypes::Pointer dummy;
+    this->DefineShrinkerOrResampler( true, shrinkFactors, outputPtr,
+      rescaleSameTypes, dummy );
+    if( smootherIsUsed )
+    {
+      rescaleSameTypes->SetInput( smoother->GetOutput() );
+    }
+    else
+    {
+      rescaleSameTypes->SetInput( finer );
+    }
+
+    UpdateAndGraft< Self, ImageToImageFilterSameTypes, OutputImageType >(
+      this, rescaleSameTypes, outputPtr, level );
+  }
+  else if( smootherIsUsed )
+  {
+    UpdateAndGraft< Self, LevelSmootherType, OutputImageType >(
+      this, smoother, outputPtr, level );
+  }
+  else
+  {
+    ShareOrCopy( finer.GetPointer(), outputPtr.GetPointer() );
+  }
+
+  return true;
+
+} // end GenerateLevelFromFinerLevel()
+
+
+/**
+ * ******************* GenerateLevelBySeparableSmoothingAndShrinking ***********************
+ */
+
+template< class TInputImage, class TOutputImage, class TPrecisionType >
+template< class TSmoother >
+typename GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >::OutputImagePointer
+GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionType >
+::GenerateLevelBySeparableSmoothingAndShrinking(
+  const typename TSmoother::InputImageType * input,
+  const SigmaArrayType & sigmaArray,
+  const RescaleFactorArrayType & shrinkFactors,
+  OutputImageType * outputPtr,
+  const ThreadIdType numberOfWorkUnits ) const
+{
+  typedef typename TSmoother::RealImageType              RealImageType;
+  typedef typename TSmoother::FirstGaussianFilterType    FirstGaussianFilterType;
+  typedef typename TSmoother::InternalGaussianFilterType InternalGaussianFilterType;
+  typedef ShrinkImageFilter< RealImageType, RealImageType > ShrinkerType;
+  typedef CastImageFilter< RealImageType, OutputImageType > CasterType;
+
+  if( !this->GetUseShrinkImageFilter() || this->AreRescaleFactorsAllOnes( shrinkFactors ) )
+  {
+    return nullptr;
+  }
+  for( unsigned int dim = 0; dim < ImageDimension; dim++ )
+  {
+    if( !( sigmaArray[ dim ] > 0.0 ) || shrinkFactors[ dim ] != std::floor( shrinkFactors[ dim ] ) )
+    {
+      return nullptr;
+    }
+  }
+
+  // The dimensions are smoothed in the order of the SmoothingRecursiveGaussianImageFilter,
+  // starting with the last one. The intermediate images are released when
+  // they have been used.
+  typename FirstGaussianFilterType::Pointer first = FirstGaussianFilterType::New();
+  first->SetInput( input );
+  first->SetDirection( ImageDimension - 1 );
+  first->SetSigma( sigmaArray[ ImageDimension - 1 ] );
+  first->InPlaceOff();
+  first->ReleaseDataFlagOn();
+  if( numberOfWorkUnits > 0 ) { first->SetNumberOfWorkUnits( numberOfWorkUnits ); }
+
+  std::vector< typename ImageSource< RealImageType >::Pointer > filters;
+  filters.push_back( first.GetPointer() );
+  for( unsigned int i = 0; i < ImageDimension; i++ )
+  {
+    const unsigned int dim = ( i + ImageDimension - 1 ) % ImageDimension;
+    if( i > 0 )
+    {
+      typename InternalGaussianFilterType::Pointer smoother = InternalGaussianFilterType::New();
+      smoother->SetInput( filters.back()->GetOutput() );
+      smoother->SetDirection( dim );
+      smoother->SetSigma( sigmaArray[ dim ] );
+      smoother->InPlaceOn();
+      smoother->ReleaseDataFlagOn();
+      if( numberOfWorkUnits > 0 ) { smoother->SetNumberOfWorkUnits( numberOfWorkUnits ); }
+      filters.push_back( smoother.GetPointer() );
+    }
+
+    if( shrinkFactors[ dim ] > 1.0 )
+    {
+      typename ShrinkerType::Pointer shrinker = ShrinkerType::New();
+      shrinker->SetInput( filters.back()->GetOutput() );
+      shrinker->SetShrinkFactor( dim, static_cast< unsigned int >( shrinkFactors[ dim ] ) );
+      shrinker->ReleaseDataFlagOn();
+      if( numberOfWorkUnits > 0 ) { shrinker->SetNumberOfWorkUnits( numberOfWorkUnits ); }
+      filters.push_back( shrinker.GetPointer() );
+    }
+  }
+
+  typename CasterType::Pointer caster = CasterType::New();
+  caster->SetInput( filters.back()->GetOutput() );
+  if( numberOfWorkUnits > 0 ) { caster->SetNumberOfWorkUnits( numberOfWorkUnits ); }
+
+  return UpdateDetached< CasterType, OutputImageType >( caster, outputPtr );
+
+} // end GenerateLevelBySeparableSmoothingAndShrinking()
+
+
 /**
  * ******************* SetupSmoother ***********************
  */
@@ -916,6 +1342,10 @@ GenericMultiResolutionPyramidImageFilter< TInputImage, TOutputImage, TPrecisionT
      << ( this->m_ComputeOnlyForCurrentLevel ? "true" : "false" ) << std::endl;
   os << indent << "SmoothingScheduleDefined: "
      << ( this->m_SmoothingScheduleDefined ? "true" : "false" ) << std::endl;
+  os << indent << "UseCascadedComputation: "
+     << ( this->m_UseCascadedComputation ? "true" : "false" ) << std::endl;
+  os << indent << "ComputeNextLevelInBackground: "
+     << ( this->m_ComputeNextLevelInBackground ? "true" : "false" ) << std::endl;
   os << indent << "Smoothing Schedule: ";
   if( this->m_SmoothingSchedule.size() == 0 )
   {
@@ -0,0 +1,137 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkHalfPrecision_h
+#define __itkHalfPrecision_h
+
+#include <cstdint>
+#include <cstring>
+
+namespace itk
+{
+
+/** \class HalfPrecision
+ *
+ * \brief Conversion between float and the 16-bit IEEE 754 half precision
+ * format, to store large images and coefficient arrays compactly.
+ *
+ * A half has 1 sign bit, 5 exponent bits and 10 mantissa bits, so it has a
+ * relative precision of 2^-11, and its largest finite value is 65504.
+ * Conversion to half rounds to the nearest value, ties to even. Values
+ * beyond the range become infinite, and small values become subnormal or
+ * zero. The conversions are done with integer operations, so they do not
+ * depend on the F16C instructions.
+ *
+ * \ingroup ITKCommon
+ */
+
+class HalfPrecision
+{
+public:
+
+  typedef std::uint16_t HalfType;
+
+  /** Convert a float to the nearest half. */
+  static HalfType FromFloat( const float value )
+  {
+    std::uint32_t bits;
+    std::memcpy( &bits, &value, sizeof( bits ) );
+    const std::uint32_t sign    = ( bits >> 16 ) & 0x8000u;
+    const std::uint32_t absBits = bits & 0x7fffffffu;
+
+    /** Infinity and NaN, for which a quiet NaN is returned. */
+    if( absBits >= 0x7f800000u )
+    {
+      return static_cast< HalfType >( sign | 0x7c00u | ( absBits > 0x7f800000u ? 0x0200u : 0u ) );
+    }
+
+    /** Values that round to 65536 or more overflow to infinity. */
+    if( absBits >= 0x477ff000u )
+    {
+      return static_cast< HalfType >( sign | 0x7c00u );
+    }
+
+    /** Values below 2^-14 become subnormal, or zero below 2^-25. */
+    if( absBits < 0x38800000u )
+    {
+      if( absBits <= 0x33000000u )
+      {
+        return static_cast< HalfType >( sign );
+      }
+      const std::uint32_t mantissa  = ( absBits & 0x007fffffu ) | 0x00800000u;
+      const unsigned int  shift     = 126u - ( absBits >> 23 );
+      const std::uint32_t remainder = mantissa & ( ( 1u << shift ) - 1u );
+      const std::uint32_t halfway   = 1u << ( shift - 1u );
+      std::uint32_t       half      = mantissa >> shift;
+      if( remainder > halfway || ( remainder == halfway && ( half & 1u ) ) )
+      {
+        ++half;
+      }
+      return static_cast< HalfType >( sign | half );
+    }
+
+    /** Normal values. A carry of the rounding into the exponent is correct. */
+    std::uint32_t       half      = ( absBits - 0x38000000u ) >> 13;
+    const std::uint32_t remainder = absBits & 0x1fffu;
+    if( remainder > 0x1000u || ( remainder == 0x1000u && ( half & 1u ) ) )
+    {
+      ++half;
+    }
+    return static_cast< HalfType >( sign | half );
+  }
+
+
+  /** Convert a half to a float, which is exact. */
+  static float ToFloat( const HalfType half )
+  {
+    const std::uint32_t sign     = static_cast< std::uint32_t >( half & 0x8000u ) << 16;
+    const std::uint32_t exponent = ( half >> 10 ) & 0x1fu;
+    const std::uint32_t mantissa = half & 0x03ffu;
+
+    std::uint32_t bits;
+    if( exponent == 0x1fu )
+    {
+      bits = sign | 0x7f800000u | ( mantissa << 13 );
+    }
+    else if( exponent != 0 )
+    {
+      bits = sign | ( ( exponent + 112u ) << 23 ) | ( mantissa << 13 );
+    }
+    else
+    {
+      /** Zero and the subnormals, which are mantissa * 2^-24. */
+      const float value = static_cast< float >( mantissa ) * 5.9604644775390625e-8f;
+      return sign ? -value : value;
+    }
+
+    float value;
+    std::memcpy( &value, &bits, sizeof( value ) );
+    return value;
+  }
+
+
+private:
+
+  HalfPrecision();                         // purposely not implemented
+  HalfPrecision( const HalfPrecision & );  // purposely not implemented
+  void operator=( const HalfPrecision & ); // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkHalfPrecision_h
@@ -35,6 +35,11 @@ namespace itk
  * if necessary. This is useful in some cases, to avoid the use of
  * a itk::CastImageFilter (to save memory for example).
  *
+ * A .nii.gz file is written uncompressed to a temporary .nii file first,
+ * which can be written in slabs, see SetNumberOfStreamDivisions(). It is
+ * then compressed by the ParallelGzipCompressor, with multiple threads,
+ * instead of by the single thread of the NIfTI writer.
+ *
  */
 template< class TInputImage >
 class ITKIOImageBase_HIDDEN ImageFileCastWriter : public ImageFileWriter< TInputImage >
@@ -70,6 +75,16 @@ public:
   /** Determine the default outputcomponentType */
   std::string GetDefaultOutputComponentType( void ) const;
 
+  /** Set/Get whether .nii.gz files are compressed with multiple threads.
+   * Default: true.
+   */
+  itkSetMacro( UseParallelCompression, bool );
+  itkGetConstMacro( UseParallelCompression, bool );
+  itkBooleanMacro( UseParallelCompression );
+
+  /** Write the image, and compress a .nii.gz file with multiple threads. */
+  void Write( void ) override;
+
 protected:
 
   ImageFileCastWriter();
@@ -102,6 +117,9 @@ protected:
 
     localInputImage->Graft( static_cast< const ScalarInputImageType * >(inputImage) );
 
+    /** When the image is written in slabs, only the current slab is buffered. */
+    localInputImage->SetLargestPossibleRegion( localInputImage->GetBufferedRegion() );
+
     caster->SetInput( localInputImage );
     caster->Update();
 
@@ -120,6 +138,7 @@ private:
   void operator=( const Self & );      // purposely not implemented
 
   std::string m_OutputComponentType;
+  bool        m_UseParallelCompression;
 };
 
 } // end namespace itk
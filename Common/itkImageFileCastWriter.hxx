@@ -27,6 +27,8 @@
 #include "itkVectorImage.h"
 #include "itkDefaultConvertPixelTraits.h"
 #include "itkMetaImageIO.h"
+#include "itkParallelGzipCompressor.h"
+#include <itksys/SystemTools.hxx>
 
 namespace itk
 {
@@ -36,8 +38,9 @@ template< class TInputImage >
 ImageFileCastWriter< TInputImage >
 ::ImageFileCastWriter()
 {
-  this->m_Caster              = 0;
-  this->m_OutputComponentType = this->GetDefaultOutputComponentType();
+  this->m_Caster                 = 0;
+  this->m_OutputComponentType    = this->GetDefaultOutputComponentType();
+  this->m_UseParallelCompression = true;
 }
 
 
@@ -70,6 +73,39 @@ ImageFileCastWriter< TInputImage >
 }
 
 
+//---------------------------------------------------------
+template< class TInputImage >
+void
+ImageFileCastWriter< TInputImage >
+::Write( void )
+{
+  const std::string fileName = this->GetFileName() ? this->GetFileName() : "";
+  if( !this->m_UseParallelCompression
+    || !itksys::SystemTools::StringEndsWith( fileName.c_str(), ".nii.gz" ) )
+  {
+    this->Superclass::Write();
+    return;
+  }
+
+  /** Write the uncompressed image to a temporary file, and compress it. */
+  const std::string temporaryFileName = fileName + ".tmp.nii";
+  this->SetFileName( temporaryFileName );
+  try
+  {
+    this->Superclass::Write();
+    ParallelGzipCompressor::CompressFile( temporaryFileName, fileName );
+  }
+  catch( ... )
+  {
+    this->SetFileName( fileName );
+    itksys::SystemTools::RemoveFile( temporaryFileName.c_str() );
+    throw;
+  }
+  this->SetFileName( fileName );
+  itksys::SystemTools::RemoveFile( temporaryFileName.c_str() );
+}
+
+
 //---------------------------------------------------------
 template< class TInputImage >
 void
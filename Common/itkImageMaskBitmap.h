@@ -0,0 +1,180 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageMaskBitmap_h
+#define __itkImageMaskBitmap_h
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkImageMaskSpatialObject.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ImageMaskBitmap
+ *
+ * \brief A compact copy of an image mask, for fast inside tests.
+ *
+ * IsInsideInWorldSpace() of an ImageMaskSpatialObject converts the point to
+ * a continuous index, checks the bounds and interpolates the mask image at
+ * every call. This class stores the mask with one bit per voxel, together
+ * with the matrix that maps a physical point to a continuous index, and with
+ * one flag per block of 8^Dimension voxels that tells whether the block
+ * contains any voxel inside the mask. A test within an empty block only reads
+ * that flag, and the bits of a block are close together in memory.
+ *
+ * The acceleration is only used when the mask is an ImageMaskSpatialObject
+ * of unsigned char without an object-to-world transform, which is how
+ * elastix creates its masks. For other masks, IsInsideInWorldSpace() simply
+ * calls the IsInsideInWorldSpace() of the mask.
+ *
+ * \ingroup ITKCommon
+ */
+
+template< unsigned int VDimension >
+class ImageMaskBitmap : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ImageMaskBitmap            Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ImageMaskBitmap, Object );
+
+  itkStaticConstMacro( Dimension, unsigned int, VDimension );
+
+  /** Typedefs. */
+  typedef SpatialObject< VDimension >                     MaskType;
+  typedef ImageMaskSpatialObject< VDimension >            ImageMaskSpatialObjectType;
+  typedef typename ImageMaskSpatialObjectType::ImageType  MaskImageType;
+  typedef typename MaskType::PointType                    PointType;
+  typedef typename MaskImageType::IndexType               IndexType;
+  typedef typename MaskImageType::RegionType              RegionType;
+
+  /** Set the mask. The bitmap is only recomputed when the mask, or its image,
+   * was modified since the previous call. Not thread-safe.
+   */
+  void SetMask( const MaskType * mask );
+
+  /** Get the mask. */
+  const MaskType * GetMask( void ) const
+  {
+    return this->m_Mask;
+  }
+
+
+  /** Whether the bitmap is used for the inside tests. */
+  bool GetIsAccelerated( void ) const
+  {
+    return this->m_IsAccelerated;
+  }
+
+
+  /** Test whether a point is inside the mask. Thread-safe. */
+  bool IsInsideInWorldSpace( const PointType & point ) const
+  {
+    if( !this->m_IsAccelerated )
+    {
+      return this->m_Mask->IsInsideInWorldSpace( point );
+    }
+
+    /** Round the continuous index half up to the nearest index, like the
+     * nearest neighbor interpolation of the ImageMaskSpatialObject.
+     */
+    IndexType index;
+    for( unsigned int i = 0; i < VDimension; ++i )
+    {
+      double cindex = this->m_Offset[ i ];
+      for( unsigned int j = 0; j < VDimension; ++j )
+      {
+        cindex += this->m_PointToIndexMatrix[ i ][ j ] * point[ j ];
+      }
+      index[ i ] = static_cast< IndexValueType >( std::floor( cindex + 0.5 ) );
+    }
+    return this->IsInsideAtIndex( index );
+  }
+
+
+  /** Test whether a voxel of the mask image is inside the mask. Thread-safe. */
+  bool IsInsideAtIndex( const IndexType & index ) const;
+
+  /** Get the number of voxels inside the mask. */
+  itkGetConstMacro( NumberOfInsideVoxels, SizeValueType );
+
+  /** Return a hash of the bitmap and of its map from physical points to
+   * voxels, so that equal hashes give equal inside tests. Returns 0 when the
+   * bitmap is not used, since the mask cannot be hashed then.
+   */
+  std::uint64_t ComputeHash( void ) const;
+
+protected:
+
+  ImageMaskBitmap();
+  ~ImageMaskBitmap() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  ImageMaskBitmap( const Self & );  // purposely not implemented
+  void operator=( const Self & );   // purposely not implemented
+
+  /** The logarithm of the block size along each dimension. */
+  static const unsigned int BlockSizeShift = 3;
+
+  /** Compute the bitmap of the mask. */
+  void ComputeBitmap( const ImageMaskSpatialObjectType * mask );
+
+  typename MaskType::ConstPointer m_Mask;
+  ModifiedTimeType                m_MaskMTime;
+  ModifiedTimeType                m_MaskImageMTime;
+  bool                            m_IsAccelerated;
+
+  /** The map from a physical point to a continuous index. */
+  double m_PointToIndexMatrix[ VDimension ][ VDimension ];
+  double m_Offset[ VDimension ];
+
+  /** The region of the mask image, and the strides of the blocks. */
+  IndexValueType m_RegionIndex[ VDimension ];
+  SizeValueType  m_RegionSize[ VDimension ];
+  SizeValueType  m_BlockStrides[ VDimension ];
+
+  /** One bit per voxel, ordered by block, and one flag per block. */
+  std::vector< std::uint64_t > m_Bits;
+  std::vector< std::uint8_t >  m_BlockIsNonEmpty;
+  SizeValueType                m_NumberOfInsideVoxels;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkImageMaskBitmap.hxx"
+#endif
+
+#endif // end #ifndef __itkImageMaskBitmap_h
@@ -0,0 +1,261 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkImageMaskBitmap_hxx
+#define __itkImageMaskBitmap_hxx
+
+#include "itkImageMaskBitmap.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkDataHash.h"
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< unsigned int VDimension >
+ImageMaskBitmap< VDimension >
+::ImageMaskBitmap()
+{
+  this->m_MaskMTime            = 0;
+  this->m_MaskImageMTime       = 0;
+  this->m_IsAccelerated        = false;
+  this->m_NumberOfInsideVoxels = 0;
+
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    for( unsigned int j = 0; j < VDimension; ++j )
+    {
+      this->m_PointToIndexMatrix[ i ][ j ] = 0.0;
+    }
+    this->m_Offset[ i ]       = 0.0;
+    this->m_RegionIndex[ i ]  = 0;
+    this->m_RegionSize[ i ]   = 0;
+    this->m_BlockStrides[ i ] = 0;
+  }
+
+} // end Constructor
+
+
+/**
+ * ******************* SetMask *******************
+ */
+
+template< unsigned int VDimension >
+void
+ImageMaskBitmap< VDimension >
+::SetMask( const MaskType * mask )
+{
+  const ImageMaskSpatialObjectType * imageMask
+    = dynamic_cast< const ImageMaskSpatialObjectType * >( mask );
+  const MaskImageType * maskImage = imageMask ? imageMask->GetImage() : nullptr;
+
+  /** Nothing to do if the mask did not change. */
+  if( this->m_Mask.GetPointer() == mask
+    && ( mask == nullptr || this->m_MaskMTime == mask->GetMTime() )
+    && ( maskImage == nullptr || this->m_MaskImageMTime == maskImage->GetMTime() ) )
+  {
+    return;
+  }
+
+  this->m_Mask           = mask;
+  this->m_MaskMTime      = mask ? mask->GetMTime() : 0;
+  this->m_MaskImageMTime = maskImage ? maskImage->GetMTime() : 0;
+  this->m_IsAccelerated  = false;
+  this->m_Bits.clear();
+  this->m_BlockIsNonEmpty.clear();
+  this->m_NumberOfInsideVoxels = 0;
+
+  /** Only accelerate image masks whose object space is the world space. */
+  if( maskImage == nullptr )
+  {
+    this->Modified();
+    return;
+  }
+  const typename MaskType::TransformType * objectToWorld = imageMask->GetObjectToWorldTransform();
+  if( objectToWorld != nullptr )
+  {
+    bool isIdentity = true;
+    for( unsigned int i = 0; i < VDimension; ++i )
+    {
+      isIdentity &= objectToWorld->GetOffset()[ i ] == 0.0;
+      for( unsigned int j = 0; j < VDimension; ++j )
+      {
+        isIdentity &= objectToWorld->GetMatrix()[ i ][ j ] == ( i == j ? 1.0 : 0.0 );
+      }
+    }
+    if( !isIdentity )
+    {
+      this->Modified();
+      return;
+    }
+  }
+
+  this->ComputeBitmap( imageMask );
+  this->m_IsAccelerated = true;
+  this->Modified();
+
+} // end SetMask()
+
+
+/**
+ * ******************* ComputeBitmap *******************
+ */
+
+template< unsigned int VDimension >
+void
+ImageMaskBitmap< VDimension >
+::ComputeBitmap( const ImageMaskSpatialObjectType * mask )
+{
+  const MaskImageType * maskImage = mask->GetImage();
+  const RegionType &    region    = maskImage->GetBufferedRegion();
+
+  /** Store the map from a physical point to a continuous index. */
+  const typename MaskImageType::DirectionType & pointToIndex = maskImage->GetPhysicalPointToIndexMatrix();
+  const typename MaskImageType::PointType &     origin       = maskImage->GetOrigin();
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    this->m_Offset[ i ] = 0.0;
+    for( unsigned int j = 0; j < VDimension; ++j )
+    {
+      this->m_PointToIndexMatrix[ i ][ j ] = pointToIndex[ i ][ j ];
+      this->m_Offset[ i ]                 -= pointToIndex[ i ][ j ] * origin[ j ];
+    }
+  }
+
+  /** Compute the number of blocks along each dimension. */
+  SizeValueType numberOfBlocks = 1;
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    this->m_RegionIndex[ i ]  = region.GetIndex( i );
+    this->m_RegionSize[ i ]   = region.GetSize( i );
+    this->m_BlockStrides[ i ] = numberOfBlocks;
+    numberOfBlocks           *= ( this->m_RegionSize[ i ] + ( 1u << BlockSizeShift ) - 1 ) >> BlockSizeShift;
+  }
+  const SizeValueType numberOfBits = numberOfBlocks << ( BlockSizeShift * VDimension );
+  this->m_Bits.assign( ( numberOfBits + 63 ) / 64, 0 );
+  this->m_BlockIsNonEmpty.assign( numberOfBlocks, 0 );
+
+  /** Set the bits of the voxels inside the mask. */
+  typedef ImageRegionConstIteratorWithIndex< MaskImageType > IteratorType;
+  for( IteratorType it( maskImage, region ); !it.IsAtEnd(); ++it )
+  {
+    if( it.Get() == NumericTraits< typename MaskImageType::PixelType >::ZeroValue() )
+    {
+      continue;
+    }
+
+    const IndexType index  = it.GetIndex();
+    SizeValueType   block  = 0;
+    SizeValueType   within = 0;
+    for( unsigned int i = 0; i < VDimension; ++i )
+    {
+      const SizeValueType r = static_cast< SizeValueType >( index[ i ] - this->m_RegionIndex[ i ] );
+      block  += ( r >> BlockSizeShift ) * this->m_BlockStrides[ i ];
+      within += ( r & ( ( 1u << BlockSizeShift ) - 1 ) ) << ( BlockSizeShift * i );
+    }
+    const SizeValueType bit = ( block << ( BlockSizeShift * VDimension ) ) + within;
+    this->m_Bits[ bit >> 6 ]         |= std::uint64_t( 1 ) << ( bit & 63 );
+    this->m_BlockIsNonEmpty[ block ]  = 1;
+    ++this->m_NumberOfInsideVoxels;
+  }
+
+} // end ComputeBitmap()
+
+
+/**
+ * ******************* IsInsideAtIndex *******************
+ */
+
+template< unsigned int VDimension >
+bool
+ImageMaskBitmap< VDimension >
+::IsInsideAtIndex( const IndexType & index ) const
+{
+  SizeValueType block  = 0;
+  SizeValueType within = 0;
+  for( unsigned int i = 0; i < VDimension; ++i )
+  {
+    const IndexValueType r = index[ i ] - this->m_RegionIndex[ i ];
+    if( r < 0 || static_cast< SizeValueType >( r ) >= this->m_RegionSize[ i ] )
+    {
+      return false;
+    }
+    block  += ( static_cast< SizeValueType >( r ) >> BlockSizeShift ) * this->m_BlockStrides[ i ];
+    within += ( static_cast< SizeValueType >( r ) & ( ( 1u << BlockSizeShift ) - 1 ) ) << ( BlockSizeShift * i );
+  }
+
+  /** Skip the bits of empty blocks. */
+  if( !this->m_BlockIsNonEmpty[ block ] )
+  {
+    return false;
+  }
+
+  const SizeValueType bit = ( block << ( BlockSizeShift * VDimension ) ) + within;
+  return ( this->m_Bits[ bit >> 6 ] >> ( bit & 63 ) ) & 1;
+
+} // end IsInsideAtIndex()
+
+
+/**
+ * ******************* ComputeHash *******************
+ */
+
+template< unsigned int VDimension >
+std::uint64_t
+ImageMaskBitmap< VDimension >
+::ComputeHash( void ) const
+{
+  if( !this->m_IsAccelerated )
+  {
+    return 0;
+  }
+
+  DataHash::HashType hash = DataHash::InitialValue;
+  hash = DataHash::Combine( hash, this->m_PointToIndexMatrix, sizeof( this->m_PointToIndexMatrix ) );
+  hash = DataHash::Combine( hash, this->m_Offset, sizeof( this->m_Offset ) );
+  hash = DataHash::Combine( hash, this->m_RegionIndex, sizeof( this->m_RegionIndex ) );
+  hash = DataHash::Combine( hash, this->m_RegionSize, sizeof( this->m_RegionSize ) );
+  hash = DataHash::Combine( hash, this->m_Bits.data(), this->m_Bits.size() * sizeof( std::uint64_t ) );
+  return hash == 0 ? 1 : hash;
+
+} // end ComputeHash()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< unsigned int VDimension >
+void
+ImageMaskBitmap< VDimension >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Mask: " << this->m_Mask.GetPointer() << std::endl;
+  os << indent << "IsAccelerated: " << this->m_IsAccelerated << std::endl;
+  os << indent << "NumberOfInsideVoxels: " << this->m_NumberOfInsideVoxels << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkImageMaskBitmap_hxx
@@ -0,0 +1,294 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkLBFGSHistory_cxx
+#define __itkLBFGSHistory_cxx
+
+#include "itkLBFGSHistory.h"
+#include "itkParallelVectorOperations.h"
+
+namespace itk
+{
+
+namespace
+{
+
+/** Copy s and y to the rows of a pair, and return y's. */
+template< class TStorage >
+double
+StorePair( const double * s, const double * y, TStorage * rowS, TStorage * rowY,
+  const SizeValueType size )
+{
+  return ParallelVectorOperations::ParallelizeReduction( size,
+    [s, y, rowS, rowY]( const SizeValueType begin, const SizeValueType end )
+    {
+      double sum = 0.0;
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        rowS[ j ] = static_cast< TStorage >( s[ j ] );
+        rowY[ j ] = static_cast< TStorage >( y[ j ] );
+        sum      += s[ j ] * y[ j ];
+      }
+      return sum;
+    } );
+
+} // end StorePair()
+
+
+/** q = q - alpha * x, and return z'q. */
+template< class TStorage >
+double
+AxpyInnerProduct( const double alpha, const TStorage * x, double * q,
+  const TStorage * z, const SizeValueType size )
+{
+  return ParallelVectorOperations::ParallelizeReduction( size,
+    [alpha, x, q, z]( const SizeValueType begin, const SizeValueType end )
+    {
+      double sum = 0.0;
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        q[ j ] += alpha * x[ j ];
+        sum    += z[ j ] * q[ j ];
+      }
+      return sum;
+    } );
+
+} // end AxpyInnerProduct()
+
+
+/** q = H0 * ( q + alpha * x ), and return x'q. */
+template< class TStorage >
+double
+AxpyMultiplyInnerProduct( const double alpha, const TStorage * x, double * q,
+  const double h0, const double * diagonal, const SizeValueType size )
+{
+  if( diagonal == nullptr )
+  {
+    return ParallelVectorOperations::ParallelizeReduction( size,
+      [alpha, x, q, h0]( const SizeValueType begin, const SizeValueType end )
+      {
+        double sum = 0.0;
+        for( SizeValueType j = begin; j < end; ++j )
+        {
+          q[ j ] = h0 * ( q[ j ] + alpha * x[ j ] );
+          sum   += x[ j ] * q[ j ];
+        }
+        return sum;
+      } );
+  }
+
+  return ParallelVectorOperations::ParallelizeReduction( size,
+    [alpha, x, q, h0, diagonal]( const SizeValueType begin, const SizeValueType end )
+    {
+      double sum = 0.0;
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        q[ j ] = h0 * diagonal[ j ] * ( q[ j ] + alpha * x[ j ] );
+        sum   += x[ j ] * q[ j ];
+      }
+      return sum;
+    } );
+
+} // end AxpyMultiplyInnerProduct()
+
+
+/** The two-loop recursion, for the rows given from the newest to the oldest. */
+template< class TStorage >
+void
+TwoLoopRecursion( const TStorage * S, const TStorage * Y, const std::vector< double > & rho,
+  const std::vector< unsigned int > & rows, const SizeValueType size,
+  const double * gradient, const double h0, const double * diagonal, double * q )
+{
+  const std::size_t numberOfPairs = rows.size();
+  if( numberOfPairs == 0 )
+  {
+    ParallelVectorOperations::ParallelizeRange( size,
+      [gradient, h0, diagonal, q]( const SizeValueType begin, const SizeValueType end )
+      {
+        for( SizeValueType j = begin; j < end; ++j )
+        {
+          q[ j ] = -h0 * ( diagonal ? diagonal[ j ] : 1.0 ) * gradient[ j ];
+        }
+      } );
+    return;
+  }
+
+  /** q = -g, and s'q for the newest pair. */
+  const TStorage * newestS = S + rows[ 0 ] * size;
+  double           sq      = ParallelVectorOperations::ParallelizeReduction( size,
+    [gradient, newestS, q]( const SizeValueType begin, const SizeValueType end )
+    {
+      double sum = 0.0;
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        q[ j ] = -gradient[ j ];
+        sum   += newestS[ j ] * q[ j ];
+      }
+      return sum;
+    } );
+
+  /** The first loop, from the newest to the oldest pair. Its last update
+   * is fused with the multiplication by H0 and the first inner product of
+   * the second loop.
+   */
+  std::vector< double > alpha( numberOfPairs );
+  double                yq = 0.0;
+  for( std::size_t k = 0; k < numberOfPairs; ++k )
+  {
+    alpha[ k ] = rho[ rows[ k ] ] * sq;
+    const TStorage * y = Y + rows[ k ] * size;
+    if( k + 1 < numberOfPairs )
+    {
+      sq = AxpyInnerProduct( -alpha[ k ], y, q, S + rows[ k + 1 ] * size, size );
+    }
+    else
+    {
+      yq = AxpyMultiplyInnerProduct( -alpha[ k ], y, q, h0, diagonal, size );
+    }
+  }
+
+  /** The second loop, from the oldest to the newest pair. */
+  for( std::size_t k = numberOfPairs; k-- > 0; )
+  {
+    const double     beta = rho[ rows[ k ] ] * yq;
+    const TStorage * s    = S + rows[ k ] * size;
+    if( k > 0 )
+    {
+      yq = AxpyInnerProduct( alpha[ k ] - beta, s, q, Y + rows[ k - 1 ] * size, size );
+    }
+    else
+    {
+      const double alpha_min_beta = alpha[ k ] - beta;
+      ParallelVectorOperations::ParallelizeRange( size,
+        [alpha_min_beta, s, q]( const SizeValueType begin, const SizeValueType end )
+        {
+          for( SizeValueType j = begin; j < end; ++j )
+          {
+            q[ j ] += alpha_min_beta * s[ j ];
+          }
+        } );
+    }
+  }
+
+} // end TwoLoopRecursion()
+
+
+} // end namespace
+
+/**
+ * ******************** Constructor ********************
+ */
+
+LBFGSHistory
+::LBFGSHistory()
+{
+  this->m_NumberOfParameters = 0;
+  this->m_UseSinglePrecision = false;
+
+} // end Constructor
+
+
+/**
+ * ******************** Initialize ********************
+ */
+
+void
+LBFGSHistory
+::Initialize( const unsigned int memory, const SizeValueType numberOfParameters,
+  const bool useSinglePrecision )
+{
+  this->m_NumberOfParameters = numberOfParameters;
+  this->m_UseSinglePrecision = useSinglePrecision;
+
+  /** Release the storage of the other precision. */
+  const SizeValueType size = memory * numberOfParameters;
+  std::vector< double >( useSinglePrecision ? 0 : size ).swap( this->m_DoubleS );
+  std::vector< double >( useSinglePrecision ? 0 : size ).swap( this->m_DoubleY );
+  std::vector< float >( useSinglePrecision ? size : 0 ).swap( this->m_FloatS );
+  std::vector< float >( useSinglePrecision ? size : 0 ).swap( this->m_FloatY );
+
+  this->m_Rho.assign( memory, 0.0 );
+  this->m_SquaredNormOfY.assign( memory, 0.0 );
+
+} // end Initialize()
+
+
+/**
+ * ******************** SetPair ********************
+ */
+
+void
+LBFGSHistory
+::SetPair( const unsigned int index, const double * s, const double * y )
+{
+  const SizeValueType size   = this->m_NumberOfParameters;
+  const SizeValueType offset = index * size;
+
+  double ys = 0.0;
+  if( this->m_UseSinglePrecision )
+  {
+    ys = StorePair( s, y, this->m_FloatS.data() + offset, this->m_FloatY.data() + offset, size );
+  }
+  else
+  {
+    ys = StorePair( s, y, this->m_DoubleS.data() + offset, this->m_DoubleY.data() + offset, size );
+  }
+
+  this->m_Rho[ index ]            = 1.0 / ys;
+  this->m_SquaredNormOfY[ index ] = ParallelVectorOperations::SquaredNorm( y, size );
+
+} // end SetPair()
+
+
+/**
+ * ******************** ComputeSearchDirection ********************
+ */
+
+void
+LBFGSHistory
+::ComputeSearchDirection( const double * gradient,
+  const double h0, const double * diagonal,
+  const unsigned int next, const unsigned int numberOfPairs,
+  double * searchDir ) const
+{
+  /** The rows of the pairs, from the newest to the oldest. */
+  const unsigned int          memory = this->GetMemory();
+  std::vector< unsigned int > rows;
+  unsigned int                row = next;
+  for( unsigned int i = 0; i < numberOfPairs; ++i )
+  {
+    row = ( row == 0 ? memory : row ) - 1;
+    rows.push_back( row );
+  }
+
+  if( this->m_UseSinglePrecision )
+  {
+    TwoLoopRecursion( this->m_FloatS.data(), this->m_FloatY.data(), this->m_Rho, rows,
+      this->m_NumberOfParameters, gradient, h0, diagonal, searchDir );
+  }
+  else
+  {
+    TwoLoopRecursion( this->m_DoubleS.data(), this->m_DoubleY.data(), this->m_Rho, rows,
+      this->m_NumberOfParameters, gradient, h0, diagonal, searchDir );
+  }
+
+} // end ComputeSearchDirection()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkLBFGSHistory_cxx
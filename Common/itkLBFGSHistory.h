@@ -0,0 +1,124 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkLBFGSHistory_h
+#define __itkLBFGSHistory_h
+
+#include "itkIntTypes.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class LBFGSHistory
+ *
+ * \brief The history of s = x_k - x_k-1 and y = g_k - g_k-1 pairs of the
+ * limited memory BFGS optimizers, and their two-loop recursion.
+ *
+ * The pairs are stored in two contiguous matrices, with one row for each
+ * pair. The optimizers use the rows as a ring buffer: they pass the index
+ * of the oldest pair to replace, and the index following the newest pair
+ * to compute a search direction.
+ *
+ * The two-loop recursion fuses the update of the search direction with the
+ * inner product of the next iteration, and the multiplication by H0 with the
+ * last update of the first loop. It therefore passes 2 * M + 1 times over
+ * its vectors instead of 4 * M + 2 times, for M pairs. The passes are split
+ * over the threads by the ParallelVectorOperations.
+ *
+ * Optionally the pairs are stored in single precision, which halves the
+ * memory of the history. The rho = 1 / ( y's ) and y'y of a pair are always
+ * computed in double precision from the original vectors, and the search
+ * direction is accumulated in double precision.
+ *
+ * \ingroup Optimizers
+ */
+
+class LBFGSHistory
+{
+public:
+
+  LBFGSHistory();
+
+  /** Allocate memory pairs of numberOfParameters, stored in single precision
+   * if useSinglePrecision is true.
+   */
+  void Initialize( const unsigned int memory, const SizeValueType numberOfParameters,
+    const bool useSinglePrecision );
+
+  unsigned int GetMemory( void ) const
+  {
+    return static_cast< unsigned int >( this->m_Rho.size() );
+  }
+
+
+  SizeValueType GetNumberOfParameters( void ) const
+  {
+    return this->m_NumberOfParameters;
+  }
+
+
+  bool GetUseSinglePrecision( void ) const
+  {
+    return this->m_UseSinglePrecision;
+  }
+
+
+  /** Store s and y in the given row, and compute their rho and y'y. */
+  void SetPair( const unsigned int index, const double * s, const double * y );
+
+  /** Get rho = 1 / ( y's ) of a pair. */
+  double GetRho( const unsigned int index ) const
+  {
+    return this->m_Rho[ index ];
+  }
+
+
+  /** Get y'y of a pair. */
+  double GetSquaredNormOfY( const unsigned int index ) const
+  {
+    return this->m_SquaredNormOfY[ index ];
+  }
+
+
+  /** Compute searchDir = -H g with the two-loop recursion, using the
+   * numberOfPairs pairs before the row next, in the ring buffer. The initial
+   * inverse Hessian H0 is the diagonal matrix h0 * diag( diagonal ), or h0 * I
+   * if diagonal is a null pointer.
+   */
+  void ComputeSearchDirection( const double * gradient,
+    const double h0, const double * diagonal,
+    const unsigned int next, const unsigned int numberOfPairs,
+    double * searchDir ) const;
+
+private:
+
+  SizeValueType         m_NumberOfParameters;
+  bool                  m_UseSinglePrecision;
+  std::vector< double > m_DoubleS;
+  std::vector< double > m_DoubleY;
+  std::vector< float >  m_FloatS;
+  std::vector< float >  m_FloatY;
+  std::vector< double > m_Rho;
+  std::vector< double > m_SquaredNormOfY;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkLBFGSHistory_h
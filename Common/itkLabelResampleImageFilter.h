@@ -0,0 +1,158 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkLabelResampleImageFilter_h
+#define itkLabelResampleImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkTransform.h"
+
+namespace itk
+{
+/** \class LabelResampleImageFilter
+ * \brief Resample a label image directly into an integer label image.
+ *
+ * The labels of the input are written to the output pixels without an
+ * intermediate floating point image, so that an unsigned char or unsigned
+ * short output is stored as such from resampling to writing. The input may
+ * have a floating point pixel type, as long as it holds integer labels.
+ *
+ * Two interpolations are supported:
+ * \li Nearest neighbor, which gives the same labels as a ResampleImageFilter
+ *     with a NearestNeighborInterpolateImageFunction.
+ * \li Majority vote (UseMajorityVote), the partial volume version of linear
+ *     interpolation. Each of the 2^D neighbours of the mapped point has its
+ *     linear interpolation weight, and the output is the label with the
+ *     largest sum of weights. The sums are computed for all neighbours at
+ *     once, branch free, in fixed size loops that the compiler vectorizes.
+ *
+ * Output voxels that map outside the input get the DefaultPixelValue.
+ *
+ * \ingroup GeometricTransforms
+ */
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType = double >
+class LabelResampleImageFilter :
+  public ImageToImageFilter< TInputImage, TOutputImage >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef LabelResampleImageFilter                        Self;
+  typedef ImageToImageFilter< TInputImage, TOutputImage > Superclass;
+  typedef SmartPointer< Self >                            Pointer;
+  typedef SmartPointer< const Self >                      ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( LabelResampleImageFilter, ImageToImageFilter );
+
+  /** Dimension of the images. */
+  itkStaticConstMacro( ImageDimension, unsigned int, TOutputImage::ImageDimension );
+
+  /** Image typedefs. */
+  typedef TInputImage                             InputImageType;
+  typedef TOutputImage                            OutputImageType;
+  typedef typename OutputImageType::PixelType     OutputPixelType;
+  typedef typename OutputImageType::RegionType    RegionType;
+  typedef typename OutputImageType::SizeType      SizeType;
+  typedef typename OutputImageType::IndexType     IndexType;
+  typedef typename OutputImageType::PointType     PointType;
+  typedef typename OutputImageType::SpacingType   SpacingType;
+  typedef typename OutputImageType::DirectionType DirectionType;
+
+  /** The transform typedefs. */
+  typedef Transform< TInterpolatorPrecisionType,
+    itkGetStaticConstMacro( ImageDimension ),
+    itkGetStaticConstMacro( ImageDimension ) > TransformType;
+  typedef typename TransformType::ConstPointer TransformConstPointer;
+
+  /** Set/Get the transform that maps the output points to the input points. */
+  itkSetConstObjectMacro( Transform, TransformType );
+  itkGetConstObjectMacro( Transform, TransformType );
+
+  /** Set/Get whether the majority vote of the linear neighbours is used,
+   * instead of the nearest neighbor. The default is false.
+   */
+  itkSetMacro( UseMajorityVote, bool );
+  itkGetConstMacro( UseMajorityVote, bool );
+  itkBooleanMacro( UseMajorityVote );
+
+  /** Set/Get the label of the output voxels that map outside the input. */
+  itkSetMacro( DefaultPixelValue, OutputPixelType );
+  itkGetConstMacro( DefaultPixelValue, OutputPixelType );
+
+  /** Set/Get the output grid. */
+  itkSetMacro( Size, SizeType );
+  itkGetConstReferenceMacro( Size, SizeType );
+  itkSetMacro( OutputStartIndex, IndexType );
+  itkGetConstReferenceMacro( OutputStartIndex, IndexType );
+  itkSetMacro( OutputSpacing, SpacingType );
+  itkGetConstReferenceMacro( OutputSpacing, SpacingType );
+  itkSetMacro( OutputOrigin, PointType );
+  itkGetConstReferenceMacro( OutputOrigin, PointType );
+  itkSetMacro( OutputDirection, DirectionType );
+  itkGetConstReferenceMacro( OutputDirection, DirectionType );
+
+protected:
+
+  LabelResampleImageFilter();
+  ~LabelResampleImageFilter() override {}
+
+  /** Set the output grid. */
+  void GenerateOutputInformation( void ) override;
+
+  /** Request the largest possible region of the input. */
+  void GenerateInputRequestedRegion( void ) override;
+
+  /** Check the transform. */
+  void BeforeThreadedGenerateData( void ) override;
+
+  /** Resample the labels in the region of the output. */
+  void DynamicThreadedGenerateData( const RegionType & outputRegionForThread ) override;
+
+  /** Print the settings. */
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  LabelResampleImageFilter( const Self & ); // purposely not implemented
+  void operator=( const Self & );           // purposely not implemented
+
+  /** The number of linear neighbours of a point. */
+  itkStaticConstMacro( NumberOfNeighbours, unsigned int, 1u << TOutputImage::ImageDimension );
+
+  TransformConstPointer m_Transform;
+  bool                  m_UseMajorityVote;
+  OutputPixelType       m_DefaultPixelValue;
+
+  SizeType      m_Size;
+  IndexType     m_OutputStartIndex;
+  SpacingType   m_OutputSpacing;
+  PointType     m_OutputOrigin;
+  DirectionType m_OutputDirection;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkLabelResampleImageFilter.hxx"
+#endif
+
+#endif // end #ifndef itkLabelResampleImageFilter_h
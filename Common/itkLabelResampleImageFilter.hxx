@@ -0,0 +1,253 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkLabelResampleImageFilter_hxx
+#define itkLabelResampleImageFilter_hxx
+
+#include "itkLabelResampleImageFilter.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkContinuousIndex.h"
+#include "itkMath.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType >
+LabelResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::LabelResampleImageFilter()
+{
+  this->m_UseMajorityVote   = false;
+  this->m_DefaultPixelValue = NumericTraits< OutputPixelType >::ZeroValue();
+
+  this->m_Size.Fill( 0 );
+  this->m_OutputStartIndex.Fill( 0 );
+  this->m_OutputSpacing.Fill( 1.0 );
+  this->m_OutputOrigin.Fill( 0.0 );
+  this->m_OutputDirection.SetIdentity();
+
+  this->DynamicMultiThreadingOn();
+
+} // end Constructor
+
+
+/**
+ * ******************* GenerateOutputInformation *******************
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType >
+void
+LabelResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::GenerateOutputInformation( void )
+{
+  /** The output does not take the information of the input. */
+  OutputImageType * output = this->GetOutput();
+  output->SetLargestPossibleRegion( RegionType( this->m_OutputStartIndex, this->m_Size ) );
+  output->SetSpacing( this->m_OutputSpacing );
+  output->SetOrigin( this->m_OutputOrigin );
+  output->SetDirection( this->m_OutputDirection );
+
+} // end GenerateOutputInformation()
+
+
+/**
+ * ******************* GenerateInputRequestedRegion *******************
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType >
+void
+LabelResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::GenerateInputRequestedRegion( void )
+{
+  /** Any output voxel may map anywhere into the input. */
+  if( this->GetInput() != nullptr )
+  {
+    const_cast< InputImageType * >( this->GetInput() )->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+} // end GenerateInputRequestedRegion()
+
+
+/**
+ * ******************* BeforeThreadedGenerateData *******************
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType >
+void
+LabelResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::BeforeThreadedGenerateData( void )
+{
+  if( this->m_Transform.IsNull() )
+  {
+    itkExceptionMacro( << "Transform not set." );
+  }
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ******************* DynamicThreadedGenerateData *******************
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType >
+void
+LabelResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::DynamicThreadedGenerateData( const RegionType & outputRegionForThread )
+{
+  typedef typename TransformType::InputPointType  InputPointType;
+  typedef typename TransformType::OutputPointType OutputPointType;
+  typedef ContinuousIndex< TInterpolatorPrecisionType,
+    itkGetStaticConstMacro( ImageDimension ) >    ContinuousIndexType;
+  typedef typename InputImageType::PixelType      InputPixelType;
+  const unsigned int numberOfNeighbours = NumberOfNeighbours;
+
+  const InputImageType *  input       = this->GetInput();
+  OutputImageType *       output      = this->GetOutput();
+  const TransformType *   transform   = this->m_Transform;
+  const InputPixelType *  inputBuffer = input->GetBufferPointer();
+  const OffsetValueType * offsetTable = input->GetOffsetTable();
+
+  /** The inside test of the interpolators, and the neighbour bounds. */
+  const typename InputImageType::RegionType inputRegion = input->GetBufferedRegion();
+  OffsetValueType                           firstIndex[ ImageDimension ];
+  OffsetValueType                           lastIndex[ ImageDimension ];
+  TInterpolatorPrecisionType                startContinuousIndex[ ImageDimension ];
+  TInterpolatorPrecisionType                endContinuousIndex[ ImageDimension ];
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    firstIndex[ d ]           = inputRegion.GetIndex( d );
+    lastIndex[ d ]            = firstIndex[ d ] + static_cast< OffsetValueType >( inputRegion.GetSize( d ) ) - 1;
+    startContinuousIndex[ d ] = firstIndex[ d ] - 0.5;
+    endContinuousIndex[ d ]   = lastIndex[ d ] + 0.5;
+  }
+
+  InputPointType      outputPoint;
+  ContinuousIndexType cindex;
+  OutputPixelType     labels[ NumberOfNeighbours ];
+  double              weights[ NumberOfNeighbours ];
+
+  for( ImageRegionIteratorWithIndex< OutputImageType > it( output, outputRegionForThread );
+    !it.IsAtEnd(); ++it )
+  {
+    output->TransformIndexToPhysicalPoint( it.GetIndex(), outputPoint );
+    const OutputPointType inputPoint = transform->TransformPoint( outputPoint );
+    input->TransformPhysicalPointToContinuousIndex( inputPoint, cindex );
+
+    bool inside = true;
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      inside &= cindex[ d ] >= startContinuousIndex[ d ] && cindex[ d ] < endContinuousIndex[ d ];
+    }
+    if( !inside )
+    {
+      it.Set( this->m_DefaultPixelValue );
+      continue;
+    }
+
+    if( !this->m_UseMajorityVote )
+    {
+      /** The nearest neighbor, rounded as by the NearestNeighborInterpolateImageFunction. */
+      OffsetValueType offset = 0;
+      for( unsigned int d = 0; d < ImageDimension; ++d )
+      {
+        offset += ( Math::RoundHalfIntegerUp< OffsetValueType >( cindex[ d ] ) - firstIndex[ d ] )
+          * offsetTable[ d ];
+      }
+      it.Set( static_cast< OutputPixelType >( inputBuffer[ offset ] ) );
+      continue;
+    }
+
+    /** The labels and linear weights of the neighbours, which are clamped to
+     * the image, as by the LinearInterpolateImageFunction.
+     */
+    OffsetValueType baseIndex[ ImageDimension ];
+    double          fraction[ ImageDimension ];
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      const TInterpolatorPrecisionType base = std::floor( cindex[ d ] );
+      baseIndex[ d ] = static_cast< OffsetValueType >( base );
+      fraction[ d ]  = static_cast< double >( cindex[ d ] - base );
+    }
+    for( unsigned int c = 0; c < numberOfNeighbours; ++c )
+    {
+      OffsetValueType offset = 0;
+      double          weight = 1.0;
+      for( unsigned int d = 0; d < ImageDimension; ++d )
+      {
+        const bool      upper = ( ( c >> d ) & 1u ) != 0;
+        OffsetValueType index = baseIndex[ d ] + ( upper ? 1 : 0 );
+        index   = std::min( std::max( index, firstIndex[ d ] ), lastIndex[ d ] );
+        offset += ( index - firstIndex[ d ] ) * offsetTable[ d ];
+        weight *= upper ? fraction[ d ] : 1.0 - fraction[ d ];
+      }
+      labels[ c ]  = static_cast< OutputPixelType >( inputBuffer[ offset ] );
+      weights[ c ] = weight;
+    }
+
+    /** The total weight of the label of each neighbour, without branches. */
+    unsigned int bestNeighbour = 0;
+    double       bestWeight    = -1.0;
+    for( unsigned int c = 0; c < numberOfNeighbours; ++c )
+    {
+      double labelWeight = 0.0;
+      for( unsigned int n = 0; n < numberOfNeighbours; ++n )
+      {
+        labelWeight += weights[ n ] * static_cast< double >( labels[ n ] == labels[ c ] );
+      }
+      const bool better = labelWeight > bestWeight;
+      bestNeighbour = better ? c : bestNeighbour;
+      bestWeight    = better ? labelWeight : bestWeight;
+    }
+    it.Set( labels[ bestNeighbour ] );
+  }
+
+} // end DynamicThreadedGenerateData()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType >
+void
+LabelResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Transform: " << this->m_Transform.GetPointer() << std::endl;
+  os << indent << "UseMajorityVote: " << this->m_UseMajorityVote << std::endl;
+  os << indent << "DefaultPixelValue: "
+     << static_cast< typename NumericTraits< OutputPixelType >::PrintType >( this->m_DefaultPixelValue ) << std::endl;
+  os << indent << "Size: " << this->m_Size << std::endl;
+  os << indent << "OutputStartIndex: " << this->m_OutputStartIndex << std::endl;
+  os << indent << "OutputSpacing: " << this->m_OutputSpacing << std::endl;
+  os << indent << "OutputOrigin: " << this->m_OutputOrigin << std::endl;
+  os << indent << "OutputDirection: " << this->m_OutputDirection << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef itkLabelResampleImageFilter_hxx
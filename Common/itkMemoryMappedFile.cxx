@@ -0,0 +1,152 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedFile_cxx
+#define __itkMemoryMappedFile_cxx
+
+#include "itkMemoryMappedFile.h"
+
+#if defined( _WIN32 )
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+/**
+ * ******************** Constructor ********************
+ */
+
+MemoryMappedFile
+::MemoryMappedFile()
+{
+  this->m_Data = nullptr;
+  this->m_Size = 0;
+
+} // end Constructor
+
+
+/**
+ * ******************** Destructor ********************
+ */
+
+MemoryMappedFile
+::~MemoryMappedFile()
+{
+  this->Close();
+
+} // end Destructor
+
+
+/**
+ * ******************** Open ********************
+ */
+
+bool
+MemoryMappedFile
+::Open( const std::string & fileName )
+{
+  this->Close();
+
+#if defined( _WIN32 )
+  HANDLE file = CreateFileA( fileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+  if( file == INVALID_HANDLE_VALUE )
+  {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if( !GetFileSizeEx( file, &size ) || size.QuadPart <= 0 )
+  {
+    CloseHandle( file );
+    return false;
+  }
+
+  /** The view keeps the mapping alive, so both handles can be closed. */
+  HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr );
+  CloseHandle( file );
+  if( mapping == nullptr )
+  {
+    return false;
+  }
+  void * data = MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 );
+  CloseHandle( mapping );
+  if( data == nullptr )
+  {
+    return false;
+  }
+  this->m_Size = static_cast< std::size_t >( size.QuadPart );
+#else
+  const int file = open( fileName.c_str(), O_RDONLY );
+  if( file < 0 )
+  {
+    return false;
+  }
+  struct stat status;
+  if( fstat( file, &status ) != 0 || status.st_size <= 0 )
+  {
+    close( file );
+    return false;
+  }
+
+  /** The mapping keeps the file alive, so it can be closed. */
+  void * data = mmap( nullptr, static_cast< std::size_t >( status.st_size ),
+    PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0 );
+  close( file );
+  if( data == MAP_FAILED )
+  {
+    return false;
+  }
+  this->m_Size = static_cast< std::size_t >( status.st_size );
+#endif
+
+  this->m_Data = static_cast< char * >( data );
+  return true;
+
+} // end Open()
+
+
+/**
+ * ******************** Close ********************
+ */
+
+void
+MemoryMappedFile
+::Close( void )
+{
+  if( this->m_Data != nullptr )
+  {
+#if defined( _WIN32 )
+    UnmapViewOfFile( this->m_Data );
+#else
+    munmap( this->m_Data, this->m_Size );
+#endif
+  }
+  this->m_Data = nullptr;
+  this->m_Size = 0;
+
+} // end Close()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMemoryMappedFile_cxx
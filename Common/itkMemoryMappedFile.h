@@ -0,0 +1,73 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedFile_h
+#define __itkMemoryMappedFile_h
+
+#include <cstddef>
+#include <string>
+
+namespace itk
+{
+
+/** \class MemoryMappedFile
+ *
+ * \brief Maps a file into memory, copy-on-write.
+ *
+ * The pages of the file are read from the page cache when they are first
+ * accessed, and are shared with other processes that map the same file. A
+ * page that is written to becomes private to this process, so the file is
+ * never modified. The mapping is removed by Close() and by the destructor.
+ *
+ * \ingroup ITKCommon
+ */
+
+class MemoryMappedFile
+{
+public:
+
+  MemoryMappedFile();
+  ~MemoryMappedFile();
+
+  /** Map the whole file. Returns false, and leaves the object closed, if the
+   * file could not be opened or mapped, or is empty.
+   */
+  bool Open( const std::string & fileName );
+
+  /** Remove the mapping. */
+  void Close( void );
+
+  /** Whether a file is mapped. */
+  bool IsOpen( void ) const { return this->m_Data != nullptr; }
+
+  /** The first byte of the mapped file, and its size in bytes. */
+  char * GetData( void ) const { return this->m_Data; }
+  std::size_t GetSize( void ) const { return this->m_Size; }
+
+private:
+
+  MemoryMappedFile( const MemoryMappedFile & ); // purposely not implemented
+  void operator=( const MemoryMappedFile & );   // purposely not implemented
+
+  char *      m_Data;
+  std::size_t m_Size;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMemoryMappedFile_h
@@ -0,0 +1,127 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedImageFileReader_h
+#define __itkMemoryMappedImageFileReader_h
+
+#include "itkImportImageContainer.h"
+#include "itkMemoryMappedFile.h"
+
+#include <string>
+
+namespace itk
+{
+
+/** \class MemoryMappedImportImageContainer
+ *
+ * \brief An ImportImageContainer whose elements are in a memory mapped file.
+ *
+ * The container does not manage the memory of the elements, but owns the
+ * MemoryMappedFile, which removes the mapping when the container is deleted.
+ *
+ * \ingroup ITKCommon
+ */
+
+template< typename TElementIdentifier, typename TElement >
+class MemoryMappedImportImageContainer :
+  public ImportImageContainer< TElementIdentifier, TElement >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef MemoryMappedImportImageContainer                     Self;
+  typedef ImportImageContainer< TElementIdentifier, TElement > Superclass;
+  typedef SmartPointer< Self >                                 Pointer;
+  typedef SmartPointer< const Self >                           ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( MemoryMappedImportImageContainer, ImportImageContainer );
+
+  /** Map the file, and import its numberOfElements elements that start at
+   * the byte offset. Returns false if the file could not be mapped, is too
+   * small, or the elements would not be aligned.
+   */
+  bool MapFile( const std::string & fileName, const std::size_t offset,
+    const TElementIdentifier numberOfElements );
+
+protected:
+
+  MemoryMappedImportImageContainer() {}
+  ~MemoryMappedImportImageContainer() override {}
+
+private:
+
+  MemoryMappedImportImageContainer( const Self & ); // purposely not implemented
+  void operator=( const Self & );                   // purposely not implemented
+
+  MemoryMappedFile m_File;
+
+};
+
+/** \class MemoryMappedImageFileReader
+ *
+ * \brief Reads an uncompressed MetaImage with a memory mapped pixel buffer.
+ *
+ * If the file is an uncompressed .mha, or a .mhd with a single data file,
+ * and the pixels are stored as the scalar PixelType of the image, in the
+ * byte order of the system, the pixel buffer of the image is the mapped data
+ * of the file. It is then read from the page cache only when it is accessed,
+ * and the pages are shared with other processes that read the same file.
+ * The mapping is copy-on-write, so the file is never modified.
+ *
+ * The pixel data has to be aligned for PixelType in the file, which is
+ * always the case for a .raw file, and depends on the length of the header
+ * for a .mha.
+ *
+ * \ingroup ITKCommon
+ */
+
+template< class TImage >
+class MemoryMappedImageFileReader
+{
+public:
+
+  /** Typedefs. */
+  typedef TImage                        ImageType;
+  typedef typename ImageType::Pointer   ImagePointer;
+  typedef typename ImageType::PixelType PixelType;
+  typedef MemoryMappedImportImageContainer<
+    SizeValueType, PixelType >          PixelContainerType;
+
+  /** Read the file with a memory mapped pixel buffer. Returns a null pointer
+   * if this is not possible, in which case the file has to be read normally.
+   */
+  static ImagePointer Read( const std::string & fileName );
+
+private:
+
+  MemoryMappedImageFileReader();                                      // purposely not implemented
+  MemoryMappedImageFileReader( const MemoryMappedImageFileReader & ); // purposely not implemented
+  void operator=( const MemoryMappedImageFileReader & );              // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkMemoryMappedImageFileReader.hxx"
+#endif
+
+#endif // end #ifndef __itkMemoryMappedImageFileReader_h
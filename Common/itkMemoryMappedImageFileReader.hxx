@@ -0,0 +1,183 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryMappedImageFileReader_hxx
+#define __itkMemoryMappedImageFileReader_hxx
+
+#include "itkMemoryMappedImageFileReader.h"
+#include "itkByteSwapper.h"
+#include "itkMetaImageIO.h"
+#include "itksys/SystemTools.hxx"
+
+namespace itk
+{
+
+/**
+ * ******************** MapFile ********************
+ */
+
+template< typename TElementIdentifier, typename TElement >
+bool
+MemoryMappedImportImageContainer< TElementIdentifier, TElement >
+::MapFile( const std::string & fileName, const std::size_t offset,
+  const TElementIdentifier numberOfElements )
+{
+  if( offset % alignof( TElement ) != 0 || !this->m_File.Open( fileName ) )
+  {
+    return false;
+  }
+
+  const std::size_t numberOfBytes
+    = static_cast< std::size_t >( numberOfElements ) * sizeof( TElement );
+  if( offset > this->m_File.GetSize() || numberOfBytes > this->m_File.GetSize() - offset )
+  {
+    this->m_File.Close();
+    return false;
+  }
+
+  /** The container does not manage the mapped memory. */
+  this->SetImportPointer( reinterpret_cast< TElement * >( this->m_File.GetData() + offset ),
+    numberOfElements, false );
+  return true;
+
+} // end MapFile()
+
+
+/**
+ * ******************** Read ********************
+ */
+
+template< class TImage >
+typename MemoryMappedImageFileReader< TImage >::ImagePointer
+MemoryMappedImageFileReader< TImage >
+::Read( const std::string & fileName )
+{
+  const unsigned int Dimension = ImageType::ImageDimension;
+
+  /** Read the header. Errors are left to the normal reader. */
+  MetaImageIO::Pointer imageIO = MetaImageIO::New();
+  if( !imageIO->CanReadFile( fileName.c_str() ) )
+  {
+    return nullptr;
+  }
+  try
+  {
+    imageIO->SetFileName( fileName );
+    imageIO->ReadImageInformation();
+  }
+  catch( ExceptionObject & )
+  {
+    return nullptr;
+  }
+
+  /** Check that the pixels are stored as they are in memory. */
+  const ImageIOBase::ByteOrder systemByteOrder = ByteSwapper< int >::SystemIsBigEndian()
+    ? ImageIOBase::BigEndian : ImageIOBase::LittleEndian;
+  MetaImage * metaImage = imageIO->GetMetaImagePointer();
+  if( metaImage->CompressedData()
+    || imageIO->GetNumberOfDimensions() != Dimension
+    || imageIO->GetNumberOfComponents() != 1
+    || imageIO->GetComponentType() != ImageIOBase::MapPixelType< PixelType >::CType
+    || ( sizeof( PixelType ) > 1 && imageIO->GetByteOrder() != systemByteOrder ) )
+  {
+    return nullptr;
+  }
+
+  /** Find the data file. A list of files, or a file name pattern, with one
+   * file per slice, is not supported.
+   */
+  const std::string elementDataFileName = metaImage->ElementDataFileName();
+  const bool        local = itksys::SystemTools::Strucmp( elementDataFileName.c_str(), "LOCAL" ) == 0;
+  if( !local && ( elementDataFileName.empty()
+    || itksys::SystemTools::Strucmp( elementDataFileName.substr( 0, 4 ).c_str(), "LIST" ) == 0
+    || elementDataFileName.find( '%' ) != std::string::npos ) )
+  {
+    return nullptr;
+  }
+  std::string dataFileName = fileName;
+  if( !local )
+  {
+    dataFileName = elementDataFileName;
+    if( !itksys::SystemTools::FileIsFullPath( dataFileName.c_str() ) )
+    {
+      const std::string path = itksys::SystemTools::GetFilenamePath( fileName );
+      if( !path.empty() )
+      {
+        dataFileName = path + "/" + dataFileName;
+      }
+    }
+  }
+
+  /** Set up the image. */
+  typename ImageType::SizeType      size;
+  typename ImageType::SpacingType   spacing;
+  typename ImageType::PointType     origin;
+  typename ImageType::DirectionType direction;
+  SizeValueType                     numberOfPixels = 1;
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    size[ i ]       = imageIO->GetDimensions( i );
+    spacing[ i ]    = imageIO->GetSpacing( i );
+    origin[ i ]     = imageIO->GetOrigin( i );
+    numberOfPixels *= size[ i ];
+    const std::vector< double > axis = imageIO->GetDirection( i );
+    for( unsigned int j = 0; j < Dimension; ++j )
+    {
+      direction[ j ][ i ] = axis[ j ];
+    }
+  }
+
+  /** The header of a .mha is followed by the data, at the end of the file,
+   * and so is the header of a raw file when its size is given as -1.
+   */
+  const std::size_t numberOfBytes
+    = static_cast< std::size_t >( numberOfPixels ) * sizeof( PixelType );
+  std::size_t offset = 0;
+  if( local || metaImage->HeaderSize() == -1 )
+  {
+    const unsigned long fileSize = itksys::SystemTools::FileLength( dataFileName );
+    if( fileSize < numberOfBytes )
+    {
+      return nullptr;
+    }
+    offset = fileSize - numberOfBytes;
+  }
+  else if( metaImage->HeaderSize() > 0 )
+  {
+    offset = static_cast< std::size_t >( metaImage->HeaderSize() );
+  }
+
+  typename PixelContainerType::Pointer pixelContainer = PixelContainerType::New();
+  if( !pixelContainer->MapFile( dataFileName, offset, numberOfPixels ) )
+  {
+    return nullptr;
+  }
+
+  ImagePointer image = ImageType::New();
+  image->SetRegions( size );
+  image->SetSpacing( spacing );
+  image->SetOrigin( origin );
+  image->SetDirection( direction );
+  image->SetPixelContainer( pixelContainer );
+  return image;
+
+} // end Read()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMemoryMappedImageFileReader_hxx
@@ -0,0 +1,81 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryPrefetch_h
+#define __itkMemoryPrefetch_h
+
+#if defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) )
+#include <xmmintrin.h>
+#endif
+
+namespace itk
+{
+
+/** \class MemoryPrefetch
+ *
+ * \brief Hints the processor to load a cache line that will be read soon.
+ *
+ * A prefetch does not change the results: it is a no-op on compilers
+ * without a prefetch intrinsic, and addresses outside the allocated memory
+ * do not fault. It pays off when the addresses are known well before they
+ * are read, as in a software pipelined loop that computes the addresses of
+ * a batch ahead of the batch that is read.
+ *
+ * \ingroup ITKCommon
+ */
+
+class MemoryPrefetch
+{
+public:
+
+  /** Prefetch the cache line of address into all levels of the cache. */
+  static void Read( const void * address )
+  {
+#if defined( __GNUC__ ) || defined( __clang__ )
+    __builtin_prefetch( address, 0, 3 );
+#elif defined( _MSC_VER ) && ( defined( _M_IX86 ) || defined( _M_X64 ) )
+    _mm_prefetch( static_cast< const char * >( address ), _MM_HINT_T0 );
+#else
+    (void)address;
+#endif
+  }
+
+
+  /** Prefetch the cache lines of the bytes [begin, end). */
+  static void ReadRange( const void * begin, const void * end )
+  {
+    const char * first = static_cast< const char * >( begin );
+    const char * last  = static_cast< const char * >( end );
+    for( const char * p = first; p < last; p += CacheLineSize )
+    {
+      Read( p );
+    }
+    if( first < last )
+    {
+      Read( last - 1 );
+    }
+  }
+
+
+  /** The cache line size assumed by ReadRange(). */
+  static const unsigned int CacheLineSize = 64;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMemoryPrefetch_h
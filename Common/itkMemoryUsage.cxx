@@ -0,0 +1,170 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryUsage_cxx
+#define __itkMemoryUsage_cxx
+
+#include "itkMemoryUsage.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+#if defined( _WIN32 )
+#include <windows.h>
+#include <psapi.h>
+#if defined( _MSC_VER )
+#pragma comment( lib, "psapi.lib" )
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+namespace itk
+{
+
+/**
+ * ****************** ParseSize *********************************
+ */
+
+bool
+MemoryUsage
+::ParseSize( const std::string & text, std::uint64_t & bytes )
+{
+  /** Read the number. */
+  const char * begin = text.c_str();
+  char *       end   = nullptr;
+  const double value = std::strtod( begin, &end );
+  if( end == begin || !( value >= 0.0 ) )
+  {
+    return false;
+  }
+
+  /** Read the unit, ignoring white space and case. */
+  std::string unit;
+  for( ; *end != '\0'; ++end )
+  {
+    if( !std::isspace( static_cast< unsigned char >( *end ) ) )
+    {
+      unit += static_cast< char >( std::toupper( static_cast< unsigned char >( *end ) ) );
+    }
+  }
+  if( unit.size() > 1 && unit.back() == 'B' )
+  {
+    unit.pop_back();
+  }
+
+  double factor = 1.0;
+  if( unit.empty() || unit == "B" )
+  {
+    factor = 1.0;
+  }
+  else if( unit == "K" )
+  {
+    factor = 1024.0;
+  }
+  else if( unit == "M" )
+  {
+    factor = 1024.0 * 1024.0;
+  }
+  else if( unit == "G" )
+  {
+    factor = 1024.0 * 1024.0 * 1024.0;
+  }
+  else if( unit == "T" )
+  {
+    factor = 1024.0 * 1024.0 * 1024.0 * 1024.0;
+  }
+  else
+  {
+    return false;
+  }
+
+  bytes = static_cast< std::uint64_t >( value * factor + 0.5 );
+  return true;
+
+} // end ParseSize()
+
+
+/**
+ * ****************** FormatSize *********************************
+ */
+
+std::string
+MemoryUsage
+::FormatSize( const std::uint64_t bytes )
+{
+  static const char * const units[] = { "B", "KB", "MB", "GB", "TB" };
+
+  double       value = static_cast< double >( bytes );
+  unsigned int unit  = 0;
+  while( value >= 1024.0 && unit < 4 )
+  {
+    value /= 1024.0;
+    ++unit;
+  }
+
+  std::ostringstream os;
+  if( unit == 0 )
+  {
+    os << bytes << " B";
+  }
+  else
+  {
+    os << std::fixed << std::setprecision( 2 ) << value << " " << units[ unit ];
+  }
+  return os.str();
+
+} // end FormatSize()
+
+
+/**
+ * ****************** GetPeakResidentMemory *********************************
+ */
+
+std::uint64_t
+MemoryUsage
+::GetPeakResidentMemory( void )
+{
+#if defined( _WIN32 )
+  PROCESS_MEMORY_COUNTERS counters;
+  if( GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+  {
+    return static_cast< std::uint64_t >( counters.PeakWorkingSetSize );
+  }
+  return 0;
+#else
+  struct rusage usage;
+  if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+  {
+    return 0;
+  }
+#if defined( __APPLE__ )
+  /** In bytes on macOS, and in kilobytes elsewhere. */
+  return static_cast< std::uint64_t >( usage.ru_maxrss );
+#else
+  return static_cast< std::uint64_t >( usage.ru_maxrss ) * 1024;
+#endif
+#endif
+
+} // end GetPeakResidentMemory()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMemoryUsage_cxx
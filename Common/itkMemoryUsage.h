@@ -0,0 +1,69 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMemoryUsage_h
+#define __itkMemoryUsage_h
+
+#include <cstdint>
+#include <string>
+
+namespace itk
+{
+
+/** \class MemoryUsage
+ *
+ * \brief Parses and formats memory sizes, and measures the peak memory usage
+ * of the process.
+ *
+ * Elastix uses this class for its memory budget, see MaximumMemoryUsage in
+ * ElastixTemplate. A size is written as a number with an optional unit, B,
+ * KB, MB, GB or TB, where KB is 1024 bytes, like "8GB" or "1.5 GB".
+ *
+ * \ingroup ITKCommon
+ */
+
+class MemoryUsage
+{
+public:
+
+  /** Parse a size like "8GB", "512 MB" or "1000000". The units are case
+   * insensitive and the B may be omitted, as in "8G". Returns false, and
+   * leaves the bytes unchanged, if the text is not a size.
+   */
+  static bool ParseSize( const std::string & text, std::uint64_t & bytes );
+
+  /** Format a number of bytes with the largest unit in which it is at least
+   * one, like "1.50 GB".
+   */
+  static std::string FormatSize( const std::uint64_t bytes );
+
+  /** Get the peak resident memory of the process, in bytes. Returns 0 when
+   * the platform does not report it.
+   */
+  static std::uint64_t GetPeakResidentMemory( void );
+
+private:
+
+  MemoryUsage();                         // purposely not implemented
+  MemoryUsage( const MemoryUsage & );    // purposely not implemented
+  void operator=( const MemoryUsage & ); // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMemoryUsage_h
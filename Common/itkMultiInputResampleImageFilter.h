@@ -0,0 +1,164 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMultiInputResampleImageFilter_h
+#define itkMultiInputResampleImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkInterpolateImageFunction.h"
+#include "itkTransform.h"
+
+#include <vector>
+
+namespace itk
+{
+/** \class MultiInputResampleImageFilter
+ * \brief Resample several images with one transform, which is evaluated
+ * once per output voxel.
+ *
+ * The filter has one output per input, all on the same output grid. For each
+ * output voxel, the point is mapped by the transform once, and each input is
+ * interpolated at the mapped point, with its own interpolator and default
+ * pixel value. Resampling N images of a deformable transform thus costs one
+ * transform evaluation per voxel instead of N, as with N ResampleImageFilters.
+ *
+ * The inputs may have different geometries (size, spacing, origin and
+ * direction); the interpolators work in the continuous indices of their own
+ * input. The whole output is generated at once, since the outputs are
+ * generated together.
+ *
+ * \ingroup GeometricTransforms
+ */
+template< class TImage, class TInterpolatorPrecisionType = double >
+class MultiInputResampleImageFilter :
+  public ImageToImageFilter< TImage, TImage >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef MultiInputResampleImageFilter        Self;
+  typedef ImageToImageFilter< TImage, TImage > Superclass;
+  typedef SmartPointer< Self >                 Pointer;
+  typedef SmartPointer< const Self >           ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( MultiInputResampleImageFilter, ImageToImageFilter );
+
+  /** Dimension of the images. */
+  itkStaticConstMacro( ImageDimension, unsigned int, TImage::ImageDimension );
+
+  /** Image typedefs. */
+  typedef TImage                            ImageType;
+  typedef typename ImageType::Pointer       ImagePointer;
+  typedef typename ImageType::PixelType     PixelType;
+  typedef typename ImageType::RegionType    RegionType;
+  typedef typename ImageType::SizeType      SizeType;
+  typedef typename ImageType::IndexType     IndexType;
+  typedef typename ImageType::PointType     PointType;
+  typedef typename ImageType::SpacingType   SpacingType;
+  typedef typename ImageType::DirectionType DirectionType;
+
+  /** The transform and interpolator typedefs. */
+  typedef Transform< TInterpolatorPrecisionType,
+    itkGetStaticConstMacro( ImageDimension ),
+    itkGetStaticConstMacro( ImageDimension ) >           TransformType;
+  typedef typename TransformType::ConstPointer           TransformConstPointer;
+  typedef InterpolateImageFunction<
+    ImageType, TInterpolatorPrecisionType >              InterpolatorType;
+  typedef typename InterpolatorType::Pointer             InterpolatorPointer;
+  typedef typename InterpolatorType::ContinuousIndexType ContinuousIndexType;
+
+  /** Set/Get the transform that maps the output points to the input points. */
+  itkSetConstObjectMacro( Transform, TransformType );
+  itkGetConstObjectMacro( Transform, TransformType );
+
+  /** Add an input image, with the interpolator that is used for it, and the
+   * value of the output voxels that map outside it. Returns the index of the
+   * input, which is also the index of its output.
+   */
+  unsigned int AddInputImage( const ImageType * image,
+    InterpolatorType * interpolator, const PixelType & defaultPixelValue );
+
+  /** Get the number of input images that were added. */
+  unsigned int GetNumberOfInputImages( void ) const
+  {
+    return static_cast< unsigned int >( this->m_Interpolators.size() );
+  }
+
+
+  /** Set/Get the output grid. */
+  itkSetMacro( Size, SizeType );
+  itkGetConstReferenceMacro( Size, SizeType );
+  itkSetMacro( OutputStartIndex, IndexType );
+  itkGetConstReferenceMacro( OutputStartIndex, IndexType );
+  itkSetMacro( OutputSpacing, SpacingType );
+  itkGetConstReferenceMacro( OutputSpacing, SpacingType );
+  itkSetMacro( OutputOrigin, PointType );
+  itkGetConstReferenceMacro( OutputOrigin, PointType );
+  itkSetMacro( OutputDirection, DirectionType );
+  itkGetConstReferenceMacro( OutputDirection, DirectionType );
+
+protected:
+
+  MultiInputResampleImageFilter();
+  ~MultiInputResampleImageFilter() override {}
+
+  /** Set the output grid of all outputs. */
+  void GenerateOutputInformation( void ) override;
+
+  /** Request the largest possible regions of all inputs. */
+  void GenerateInputRequestedRegion( void ) override;
+
+  /** Generate all outputs at once. */
+  void EnlargeOutputRequestedRegion( DataObject * output ) override;
+
+  /** Connect the interpolators to their inputs. */
+  void BeforeThreadedGenerateData( void ) override;
+
+  /** Resample all inputs in the region of the outputs. */
+  void DynamicThreadedGenerateData( const RegionType & outputRegionForThread ) override;
+
+  /** Print the settings. */
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  MultiInputResampleImageFilter( const Self & ); // purposely not implemented
+  void operator=( const Self & );                // purposely not implemented
+
+  TransformConstPointer              m_Transform;
+  std::vector< InterpolatorPointer > m_Interpolators;
+  std::vector< PixelType >           m_DefaultPixelValues;
+
+  SizeType      m_Size;
+  IndexType     m_OutputStartIndex;
+  SpacingType   m_OutputSpacing;
+  PointType     m_OutputOrigin;
+  DirectionType m_OutputDirection;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkMultiInputResampleImageFilter.hxx"
+#endif
+
+#endif // end #ifndef itkMultiInputResampleImageFilter_h
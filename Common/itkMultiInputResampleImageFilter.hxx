@@ -0,0 +1,240 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkMultiInputResampleImageFilter_hxx
+#define itkMultiInputResampleImageFilter_hxx
+
+#include "itkMultiInputResampleImageFilter.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+MultiInputResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::MultiInputResampleImageFilter()
+{
+  this->m_Size.Fill( 0 );
+  this->m_OutputStartIndex.Fill( 0 );
+  this->m_OutputSpacing.Fill( 1.0 );
+  this->m_OutputOrigin.Fill( 0.0 );
+  this->m_OutputDirection.SetIdentity();
+
+  this->SetNumberOfRequiredInputs( 0 );
+  this->DynamicMultiThreadingOn();
+
+} // end Constructor
+
+
+/**
+ * ******************* AddInputImage *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+unsigned int
+MultiInputResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::AddInputImage( const ImageType * image,
+  InterpolatorType * interpolator, const PixelType & defaultPixelValue )
+{
+  if( image == nullptr || interpolator == nullptr )
+  {
+    itkExceptionMacro( << "An input image and its interpolator are required." );
+  }
+
+  const unsigned int index = this->GetNumberOfInputImages();
+  this->m_Interpolators.push_back( interpolator );
+  this->m_DefaultPixelValues.push_back( defaultPixelValue );
+
+  this->SetNumberOfRequiredInputs( index + 1 );
+  this->SetNthInput( index, const_cast< ImageType * >( image ) );
+  this->SetNumberOfRequiredOutputs( index + 1 );
+  if( index > 0 )
+  {
+    this->SetNthOutput( index, this->MakeOutput( index ) );
+  }
+
+  this->Modified();
+  return index;
+
+} // end AddInputImage()
+
+
+/**
+ * ******************* GenerateOutputInformation *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+MultiInputResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::GenerateOutputInformation( void )
+{
+  /** The outputs do not take the information of the inputs. */
+  const RegionType region( this->m_OutputStartIndex, this->m_Size );
+  for( unsigned int i = 0; i < this->GetNumberOfInputImages(); ++i )
+  {
+    ImageType * output = this->GetOutput( i );
+    output->SetLargestPossibleRegion( region );
+    output->SetSpacing( this->m_OutputSpacing );
+    output->SetOrigin( this->m_OutputOrigin );
+    output->SetDirection( this->m_OutputDirection );
+  }
+
+} // end GenerateOutputInformation()
+
+
+/**
+ * ******************* GenerateInputRequestedRegion *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+MultiInputResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::GenerateInputRequestedRegion( void )
+{
+  /** Any output voxel may map anywhere into the inputs. */
+  for( unsigned int i = 0; i < this->GetNumberOfInputImages(); ++i )
+  {
+    const_cast< ImageType * >( this->GetInput( i ) )->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+} // end GenerateInputRequestedRegion()
+
+
+/**
+ * ******************* EnlargeOutputRequestedRegion *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+MultiInputResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::EnlargeOutputRequestedRegion( DataObject * itkNotUsed( output ) )
+{
+  for( unsigned int i = 0; i < this->GetNumberOfInputImages(); ++i )
+  {
+    this->GetOutput( i )->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+} // end EnlargeOutputRequestedRegion()
+
+
+/**
+ * ******************* BeforeThreadedGenerateData *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+MultiInputResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::BeforeThreadedGenerateData( void )
+{
+  if( this->m_Transform.IsNull() )
+  {
+    itkExceptionMacro( << "Transform not set." );
+  }
+
+  for( unsigned int i = 0; i < this->GetNumberOfInputImages(); ++i )
+  {
+    this->m_Interpolators[ i ]->SetInputImage( this->GetInput( i ) );
+  }
+
+} // end BeforeThreadedGenerateData()
+
+
+/**
+ * ******************* DynamicThreadedGenerateData *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+MultiInputResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::DynamicThreadedGenerateData( const RegionType & outputRegionForThread )
+{
+  typedef typename TransformType::InputPointType  InputPointType;
+  typedef typename TransformType::OutputPointType OutputPointType;
+
+  /** All outputs have the same buffered region, so that a voxel has the
+   * same offset in each of them.
+   */
+  const unsigned int               numberOfImages = this->GetNumberOfInputImages();
+  std::vector< const ImageType * > inputs( numberOfImages );
+  std::vector< PixelType * >       buffers( numberOfImages );
+  for( unsigned int i = 0; i < numberOfImages; ++i )
+  {
+    inputs[ i ]  = this->GetInput( i );
+    buffers[ i ] = this->GetOutput( i )->GetBufferPointer();
+  }
+  const ImageType *     output    = this->GetOutput( 0 );
+  const TransformType * transform = this->m_Transform;
+  InputPointType        outputPoint;
+  ContinuousIndexType   cindex;
+
+  for( ImageRegionConstIteratorWithIndex< ImageType > it( output, outputRegionForThread );
+    !it.IsAtEnd(); ++it )
+  {
+    /** Map the point once, for all inputs. */
+    const IndexType & index = it.GetIndex();
+    output->TransformIndexToPhysicalPoint( index, outputPoint );
+    const OutputPointType inputPoint = transform->TransformPoint( outputPoint );
+    const OffsetValueType offset     = output->ComputeOffset( index );
+
+    for( unsigned int i = 0; i < numberOfImages; ++i )
+    {
+      inputs[ i ]->TransformPhysicalPointToContinuousIndex( inputPoint, cindex );
+      const InterpolatorType * interpolator = this->m_Interpolators[ i ];
+      if( interpolator->IsInsideBuffer( cindex ) )
+      {
+        buffers[ i ][ offset ] = static_cast< PixelType >(
+          interpolator->EvaluateAtContinuousIndex( cindex ) );
+      }
+      else
+      {
+        buffers[ i ][ offset ] = this->m_DefaultPixelValues[ i ];
+      }
+    }
+  }
+
+} // end DynamicThreadedGenerateData()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+MultiInputResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Transform: " << this->m_Transform.GetPointer() << std::endl;
+  os << indent << "NumberOfInputImages: " << this->GetNumberOfInputImages() << std::endl;
+  os << indent << "Size: " << this->m_Size << std::endl;
+  os << indent << "OutputStartIndex: " << this->m_OutputStartIndex << std::endl;
+  os << indent << "OutputSpacing: " << this->m_OutputSpacing << std::endl;
+  os << indent << "OutputOrigin: " << this->m_OutputOrigin << std::endl;
+  os << indent << "OutputDirection: " << this->m_OutputDirection << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef itkMultiInputResampleImageFilter_hxx
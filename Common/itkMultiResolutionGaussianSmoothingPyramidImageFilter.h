@@ -116,6 +116,12 @@ namespace itk
  *
  * This filter uses multithreaded filters to perform the smoothing.
  *
+ * With ComputeOnlyForCurrentLevel, only the output of the current level is
+ * computed, and the outputs of the other levels are released when the
+ * current level changes. So at most one smoothed copy of the input is
+ * held, instead of NumberOfLevels copies. This is the same mode as in the
+ * GenericMultiResolutionPyramidImageFilter.
+ *
  * This filter supports streaming.
  *
  * \ingroup PyramidImageFilter Multithreaded Streamed
@@ -170,6 +176,20 @@ public:
    */
   void SetSchedule( const ScheduleType & schedule ) override;
 
+  /** Set the current multi-resolution level. The current level is clamped to
+   * the total number of levels.
+   */
+  virtual void SetCurrentLevel( unsigned int level );
+
+  /** Get the current multi-resolution level. */
+  itkGetConstReferenceMacro( CurrentLevel, unsigned int );
+
+  /** Set/Get whether only the output of the current level is computed. */
+  virtual void SetComputeOnlyForCurrentLevel( const bool _arg );
+
+  itkGetConstMacro( ComputeOnlyForCurrentLevel, bool );
+  itkBooleanMacro( ComputeOnlyForCurrentLevel );
+
   /** Set spacing etc. */
   void GenerateOutputInformation() override;
 
@@ -200,11 +220,24 @@ protected:
    * because it uses internally a filter that does this. */
   void EnlargeOutputRequestedRegion( DataObject * output ) override;
 
+  /** Release the output data of the other levels when the current level is
+   * used.
+   */
+  void ReleaseOutputs( void );
+
 private:
 
   MultiResolutionGaussianSmoothingPyramidImageFilter( const Self & ); // purposely not implemented
   void operator=( const Self & );                                     // purposely not implemented
 
+  /** Checks whether we have to compute the output of a level, based on
+   * m_ComputeOnlyForCurrentLevel and m_CurrentLevel.
+   */
+  bool ComputeForCurrentLevel( const unsigned int level ) const;
+
+  unsigned int m_CurrentLevel;
+  bool         m_ComputeOnlyForCurrentLevel;
+
 };
 
 } // namespace itk
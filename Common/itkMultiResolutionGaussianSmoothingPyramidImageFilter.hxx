@@ -53,7 +53,86 @@ namespace itk
 template< class TInputImage, class TOutputImage >
 MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
 ::MultiResolutionGaussianSmoothingPyramidImageFilter()
-{}
+{
+  this->m_CurrentLevel               = 0;
+  this->m_ComputeOnlyForCurrentLevel = false;
+}
+
+
+/*
+ * Set the current level
+ */
+template< class TInputImage, class TOutputImage >
+void
+MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
+::SetCurrentLevel( unsigned int level )
+{
+  itkDebugMacro( "setting CurrentLevel to " << level );
+  if( this->m_CurrentLevel != level )
+  {
+    // clamp value to be less then number of levels
+    this->m_CurrentLevel = level;
+    if( this->m_CurrentLevel >= this->m_NumberOfLevels )
+    {
+      this->m_CurrentLevel = this->m_NumberOfLevels - 1;
+    }
+    this->ReleaseOutputs();
+
+    /** Only set the modified flag for this filter if the output is computed per level. */
+    if( this->m_ComputeOnlyForCurrentLevel )
+    {
+      this->Modified();
+    }
+  }
+}
+
+
+/*
+ * Set whether only the current level is computed
+ */
+template< class TInputImage, class TOutputImage >
+void
+MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
+::SetComputeOnlyForCurrentLevel( const bool _arg )
+{
+  itkDebugMacro( "setting ComputeOnlyForCurrentLevel to " << _arg );
+  if( this->m_ComputeOnlyForCurrentLevel != _arg )
+  {
+    this->m_ComputeOnlyForCurrentLevel = _arg;
+    this->ReleaseOutputs();
+    this->Modified();
+  }
+}
+
+
+/*
+ * Release the outputs of the other levels
+ */
+template< class TInputImage, class TOutputImage >
+void
+MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
+::ReleaseOutputs( void )
+{
+  for( unsigned int level = 0; level < this->m_NumberOfLevels; level++ )
+  {
+    if( this->m_ComputeOnlyForCurrentLevel && level != this->m_CurrentLevel )
+    {
+      this->GetOutput( level )->Initialize();
+    }
+  }
+}
+
+
+/*
+ * Check whether the output of a level is computed
+ */
+template< class TInputImage, class TOutputImage >
+bool
+MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
+::ComputeForCurrentLevel( const unsigned int level ) const
+{
+  return !this->m_ComputeOnlyForCurrentLevel || level == this->m_CurrentLevel;
+}
 
 /*
  * Set the multi-resolution schedule
@@ -140,6 +219,10 @@ MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
 
   for( ilevel = 0; ilevel < this->m_NumberOfLevels; ilevel++ )
   {
+    if( !this->ComputeForCurrentLevel( ilevel ) )
+    {
+      continue;
+    }
 
     this->UpdateProgress( static_cast< float >( ilevel )
       / static_cast< float >( this->m_NumberOfLevels ) );
@@ -217,6 +300,11 @@ MultiResolutionGaussianSmoothingPyramidImageFilter< TInputImage, TOutputImage >
 ::PrintSelf( std::ostream & os, Indent indent ) const
 {
   Superclass::PrintSelf( os, indent );
+
+  os << indent << "CurrentLevel: "
+     << this->m_CurrentLevel << std::endl;
+  os << indent << "ComputeOnlyForCurrentLevel: "
+     << ( this->m_ComputeOnlyForCurrentLevel ? "true" : "false" ) << std::endl;
 }
 
 
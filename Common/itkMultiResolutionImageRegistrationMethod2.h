@@ -42,6 +42,7 @@
 #include "itkProcessObject.h"
 #include "itkAdvancedImageToImageMetric.h"
 #include "itkSingleValuedNonLinearOptimizer.h"
+#include "itkMultipleValuesCostFunctionInterface.h"
 #include "itkMultiResolutionPyramidImageFilter.h"
 #include "itkNumericTraits.h"
 #include "itkDataObjectDecorator.h"
@@ -88,6 +89,16 @@ namespace itk
  * opportunity for a user interface to change any of the components,
  * change component parameters, or stop the registration.
  *
+ * Optionally, candidates for the initial transform parameters are given,
+ * for example a grid of rotations and translations. In the first level, the
+ * cost function is evaluated at all candidates in one call of GetValues(),
+ * so a metric with a MultipleValuesCostFunctionInterface evaluates them
+ * concurrently on the same samples. If NumberOfMultiStartOptimizations is
+ * larger than one, that number of the best candidates is optimized in the
+ * first level, and the optimization continues from the best result.
+ * Otherwise it starts from the best candidate. The finer levels are
+ * registered as usual.
+ *
  * This class is templated over the fixed image type and the moving image
  * type.
  *
@@ -168,6 +179,18 @@ public:
   /** Method to stop the registration. */
   virtual void StopRegistration( void );
 
+  /** Resume the registration from a checkpoint. The levels up to and
+   * including lastFinishedLevel are not optimized again, and the given
+   * parameters are used as the result of lastFinishedLevel. The components
+   * still receive the iteration event of these levels, so that they set up
+   * the transform of the next level. A negative level runs all levels,
+   * which is the default.
+   */
+  virtual void SetResumeState( const long lastFinishedLevel,
+    const ParametersType & parameters );
+
+  itkGetConstMacro( ResumeLevel, long );
+
   /** Set/Get the Fixed image. */
   itkSetConstObjectMacro( FixedImage, FixedImageType );
   itkGetConstObjectMacro( FixedImage, FixedImageType );
@@ -228,6 +251,26 @@ public:
    */
   itkGetConstReferenceMacro( LastTransformParameters, ParametersType );
 
+  /** Type of a vector of transformation parameters. */
+  typedef MultipleValuesCostFunctionInterface::ParametersVectorType ParametersVectorType;
+
+  /** Set/Get the candidates for the initial transformation parameters of
+   * the first level. By default there are none. Candidates that do not have
+   * the number of parameters of the transform in the first level are ignored.
+   */
+  virtual void SetInitialTransformParametersCandidates( const ParametersVectorType & candidates );
+
+  itkGetConstReferenceMacro( InitialTransformParametersCandidates, ParametersVectorType );
+
+  /** Set/Get the number of the best candidates that are optimized in the
+   * first level. Default: 1, which only selects the best candidate.
+   */
+  itkSetMacro( NumberOfMultiStartOptimizations, unsigned int );
+  itkGetConstMacro( NumberOfMultiStartOptimizations, unsigned int );
+
+  /** Get the index of the candidate from which the first level continued. */
+  itkGetConstMacro( SelectedInitialTransformParametersCandidate, unsigned int );
+
   /** Returns the transform resulting from the registration process. */
   const TransformOutputType * GetOutput( void ) const;
 
@@ -266,6 +309,18 @@ protected:
   /** Compute the size of the fixed region for each level of the pyramid. */
   virtual void PreparePyramids( void );
 
+  /** Select the initial position of the optimizer from the candidates, see
+   * SetInitialTransformParametersCandidates(). Called after Initialize() in
+   * the first level.
+   */
+  virtual void SelectInitialTransformParametersCandidate( void );
+
+  /** Set the results of a level that was finished before the checkpoint,
+   * see SetResumeState(). Called instead of Initialize() and the
+   * optimization.
+   */
+  virtual void ResumeLevel( void );
+
   /** Set the current level to be processed. */
   itkSetMacro( CurrentLevel, unsigned long );
 
@@ -301,6 +356,13 @@ private:
   unsigned long m_NumberOfLevels;
   unsigned long m_CurrentLevel;
 
+  long           m_ResumeLevel;
+  ParametersType m_ResumeParameters;
+
+  ParametersVectorType m_InitialTransformParametersCandidates;
+  unsigned int         m_NumberOfMultiStartOptimizations;
+  unsigned int         m_SelectedInitialTransformParametersCandidate;
+
 };
 
 } // end namespace itk
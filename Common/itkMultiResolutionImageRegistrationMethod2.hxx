@@ -42,7 +42,10 @@
 #include "itkMultiResolutionImageRegistrationMethod2.h"
 #include "itkRecursiveMultiResolutionPyramidImageFilter.h"
 #include "itkContinuousIndex.h"
+#include "itkScaledSingleValuedNonLinearOptimizer.h"
 #include "vnl/vnl_math.h"
+#include <algorithm>
+#include <vector>
 
 namespace itk
 {
@@ -63,6 +66,9 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
   this->m_Metric       = 0; // has to be provided by the user.
   this->m_Optimizer    = 0; // has to be provided by the user.
 
+  this->m_NumberOfMultiStartOptimizations             = 1;
+  this->m_SelectedInitialTransformParametersCandidate = 0;
+
   // Use MultiResolutionPyramidImageFilter as the default
   // image pyramids.
   this->m_FixedImagePyramid  = FixedImagePyramidType::New();
@@ -70,6 +76,7 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
 
   this->m_NumberOfLevels = 1;
   this->m_CurrentLevel   = 0;
+  this->m_ResumeLevel    = -1;
 
   this->m_Stop = false;
 
@@ -318,6 +325,13 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
         break;
       }
 
+      // skip the levels that were finished before the checkpoint
+      if( static_cast< long >( this->m_CurrentLevel ) <= this->m_ResumeLevel )
+      {
+        this->ResumeLevel();
+        continue;
+      }
+
       try
       {
         // initialize the interconnects between components
@@ -332,6 +346,13 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
         throw err;
       }
 
+      // select the best initial parameters in the first level
+      if( this->m_CurrentLevel == 0 && this->m_ResumeLevel < 0
+        && !this->m_InitialTransformParametersCandidates.empty() )
+      {
+        this->SelectInitialTransformParametersCandidate();
+      }
+
       try
       {
         // do the optimization
@@ -363,6 +384,194 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
 } // end StartRegistration()
 
 
+/*
+ * SetResumeState
+ */
+template< typename TFixedImage, typename TMovingImage >
+void
+MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::SetResumeState( const long lastFinishedLevel, const ParametersType & parameters )
+{
+  this->m_ResumeLevel      = lastFinishedLevel < 0 ? -1 : lastFinishedLevel;
+  this->m_ResumeParameters = parameters;
+  this->Modified();
+
+} // end SetResumeState()
+
+
+/*
+ * ResumeLevel
+ */
+template< typename TFixedImage, typename TMovingImage >
+void
+MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::ResumeLevel( void )
+{
+  // The levels before the checkpoint keep the initial parameters, which the
+  // components may have upsampled for this level.
+  if( static_cast< long >( this->m_CurrentLevel ) < this->m_ResumeLevel )
+  {
+    this->m_LastTransformParameters = this->m_InitialTransformParametersOfNextLevel;
+  }
+  else
+  {
+    if( this->m_ResumeParameters.Size() != this->m_Transform->GetNumberOfParameters() )
+    {
+      itkExceptionMacro( << "The checkpoint of level " << this->m_CurrentLevel
+                         << " has " << this->m_ResumeParameters.Size()
+                         << " parameters, but the transform has "
+                         << this->m_Transform->GetNumberOfParameters() << "." );
+    }
+    this->m_LastTransformParameters = this->m_ResumeParameters;
+  }
+  this->m_Transform->SetParameters( this->m_LastTransformParameters );
+
+  // Connect the transform to the decorator, as Initialize() does.
+  TransformOutputType * transformOutput
+    = static_cast< TransformOutputType * >( this->ProcessObject::GetOutput( 0 ) );
+  transformOutput->Set( this->m_Transform.GetPointer() );
+
+  // setup the initial parameters for next level
+  if( this->m_CurrentLevel < this->m_NumberOfLevels - 1 )
+  {
+    this->m_InitialTransformParametersOfNextLevel
+      = this->m_LastTransformParameters;
+  }
+
+} // end ResumeLevel()
+
+
+/*
+ * SetInitialTransformParametersCandidates
+ */
+template< typename TFixedImage, typename TMovingImage >
+void
+MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::SetInitialTransformParametersCandidates( const ParametersVectorType & candidates )
+{
+  this->m_InitialTransformParametersCandidates = candidates;
+  this->Modified();
+
+} // end SetInitialTransformParametersCandidates()
+
+
+/*
+ * SelectInitialTransformParametersCandidate
+ */
+template< typename TFixedImage, typename TMovingImage >
+void
+MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
+::SelectInitialTransformParametersCandidate( void )
+{
+  typedef SingleValuedCostFunction::MeasureType                  MeasureType;
+  typedef MultipleValuesCostFunctionInterface::MeasureVectorType MeasureVectorType;
+
+  const ParametersVectorType & candidates = this->m_InitialTransformParametersCandidates;
+  const SingleValuedCostFunction * costFunction = this->m_Optimizer->GetCostFunction();
+  const MultipleValuesCostFunctionInterface * multipleValuesCostFunction
+    = dynamic_cast< const MultipleValuesCostFunctionInterface * >( costFunction );
+
+  /** Lower is better, also when the optimizer maximizes. */
+  const ScaledSingleValuedNonLinearOptimizer * scaledOptimizer
+    = dynamic_cast< const ScaledSingleValuedNonLinearOptimizer * >( this->m_Optimizer.GetPointer() );
+  const double sign = ( scaledOptimizer != nullptr && scaledOptimizer->GetMaximize() ) ? -1.0 : 1.0;
+  const MeasureType failedValue = NumericTraits< MeasureType >::max();
+
+  /** Ignore the candidates that do not fit the transform, for example those
+   * of a B-spline grid of another resolution.
+   */
+  const typename TransformType::NumberOfParametersType numberOfParameters
+    = this->m_Transform->GetNumberOfParameters();
+  std::vector< std::size_t > order;
+  for( std::size_t i = 0; i < candidates.size(); ++i )
+  {
+    if( candidates[ i ].GetSize() == numberOfParameters )
+    {
+      order.push_back( i );
+    }
+  }
+  if( order.empty() )
+  {
+    itkWarningMacro( << "None of the initial transform parameters candidates has "
+                     << numberOfParameters << " parameters; they are ignored." );
+    return;
+  }
+
+  /** Evaluate all candidates at once. If that fails, evaluate them one by one,
+   * so that a candidate that maps too many samples outside the moving image
+   * is ranked last.
+   */
+  MeasureVectorType values;
+  bool              evaluated = false;
+  if( multipleValuesCostFunction != nullptr && order.size() == candidates.size() )
+  {
+    try
+    {
+      multipleValuesCostFunction->GetValues( candidates, values );
+      evaluated = values.size() == candidates.size();
+    }
+    catch( ExceptionObject & )
+    {
+      evaluated = false;
+    }
+  }
+  if( !evaluated )
+  {
+    values.assign( candidates.size(), failedValue );
+    for( const std::size_t i : order )
+    {
+      try
+      {
+        values[ i ] = costFunction->GetValue( candidates[ i ] );
+      }
+      catch( ExceptionObject & )
+      {
+        values[ i ] = sign * failedValue;
+      }
+    }
+  }
+
+  std::stable_sort( order.begin(), order.end(),
+    [ &values, sign ]( const std::size_t a, const std::size_t b )
+    {
+      return sign * values[ a ] < sign * values[ b ];
+    } );
+
+  /** Optimize the best candidates, and continue from the best result. */
+  const std::size_t numberOfOptimizations = std::min< std::size_t >(
+    this->m_NumberOfMultiStartOptimizations, order.size() );
+  this->m_SelectedInitialTransformParametersCandidate = static_cast< unsigned int >( order[ 0 ] );
+  ParametersType bestPosition = candidates[ order[ 0 ] ];
+  if( numberOfOptimizations > 1 )
+  {
+    MeasureType bestValue = failedValue;
+    for( std::size_t k = 0; k < numberOfOptimizations && !this->m_Stop; ++k )
+    {
+      MeasureType value = failedValue;
+      this->m_Optimizer->SetInitialPosition( candidates[ order[ k ] ] );
+      try
+      {
+        this->m_Optimizer->StartOptimization();
+        value = sign * costFunction->GetValue( this->m_Optimizer->GetCurrentPosition() );
+      }
+      catch( ExceptionObject & )
+      {
+        continue;
+      }
+      if( value < bestValue )
+      {
+        bestValue    = value;
+        bestPosition = this->m_Optimizer->GetCurrentPosition();
+        this->m_SelectedInitialTransformParametersCandidate = static_cast< unsigned int >( order[ k ] );
+      }
+    }
+  }
+
+  this->m_Optimizer->SetInitialPosition( bestPosition );
+
+} // end SelectInitialTransformParametersCandidate()
+
+
 /*
  * PrintSelf
  */
@@ -385,6 +594,7 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
 
   os << indent << "NumberOfLevels: " << this->m_NumberOfLevels << std::endl;
   os << indent << "CurrentLevel: " << this->m_CurrentLevel << std::endl;
+  os << indent << "ResumeLevel: " << this->m_ResumeLevel << std::endl;
 
   os << indent << "InitialTransformParameters: "
      << this->m_InitialTransformParameters << std::endl;
@@ -392,6 +602,10 @@ MultiResolutionImageRegistrationMethod2< TFixedImage, TMovingImage >
      << this->m_InitialTransformParametersOfNextLevel << std::endl;
   os << indent << "LastTransformParameters: "
      << this->m_LastTransformParameters << std::endl;
+  os << indent << "NumberOfInitialTransformParametersCandidates: "
+     << this->m_InitialTransformParametersCandidates.size() << std::endl;
+  os << indent << "NumberOfMultiStartOptimizations: "
+     << this->m_NumberOfMultiStartOptimizations << std::endl;
   os << indent << "FixedImageRegion: "
      << this->m_FixedImageRegion << std::endl;
 
@@ -19,6 +19,9 @@
 #define __itkMultiResolutionShrinkPyramidImageFilter_h
 
 #include "itkMultiResolutionPyramidImageFilter.h"
+#include "itkPersistentThreadPool.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -31,6 +34,18 @@ namespace itk
  * No smoothing or any other operation is performed. This is useful for
  * example for registering binary images.
  *
+ * With UseBoxAveraging, each output pixel is instead the average of the
+ * input pixels in the box of the shrink factors around it, which avoids
+ * the aliasing of plain subsampling at a fraction of the cost of a
+ * Gaussian smoothing pyramid. The output grids are the same as those of
+ * the ShrinkImageFilter. The box is integrated over the input pixels, so
+ * a box that is not aligned with the input grid weighs the pixels at its
+ * ends by their overlap. The averaging is separable: it is applied to one
+ * dimension at a time, starting with the slowest varying one, so that the
+ * innermost loop runs over adjacent pixels of many lines, which the
+ * compiler vectorizes. The lines are divided over the threads of the
+ * PersistentThreadPool.
+ *
  * \sa ShrinkImageFilter
  *
  * \ingroup PyramidImageFilter Multithreaded Streamed
@@ -70,6 +85,19 @@ public:
   typedef typename Superclass::InputImagePointer      InputImagePointer;
   typedef typename Superclass::OutputImagePointer     OutputImagePointer;
   typedef typename Superclass::InputImageConstPointer InputImageConstPointer;
+  typedef typename InputImageType::PixelType          InputPixelType;
+  typedef typename OutputImageType::PixelType         OutputPixelType;
+
+  /** The type in which the averages are accumulated. */
+  typedef typename NumericTraits< OutputPixelType >::FloatType FloatType;
+
+  /** Set/Get whether the output pixels are the average of the box of input
+   * pixels of the shrink factors, instead of a single input pixel. The
+   * default is false.
+   */
+  itkSetMacro( UseBoxAveraging, bool );
+  itkGetConstMacro( UseBoxAveraging, bool );
+  itkBooleanMacro( UseBoxAveraging );
 
   /** Overwrite the Superclass implementation: no padding required. */
   void GenerateInputRequestedRegion( void ) override;
@@ -85,9 +113,11 @@ public:
 
 protected:
 
-  MultiResolutionShrinkPyramidImageFilter() {}
+  MultiResolutionShrinkPyramidImageFilter();
   ~MultiResolutionShrinkPyramidImageFilter() override {}
 
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
   /** Generate the output data. */
   void GenerateData( void ) override;
 
@@ -96,6 +126,59 @@ private:
   MultiResolutionShrinkPyramidImageFilter( const Self & ); // purposely not implemented
   void operator=( const Self & );                          // purposely not implemented
 
+  /** The averaging along one dimension. Output pixel r is the sum of the
+   * input pixels m_FirstTaps[ r ] + i, with the weights
+   * m_Weights[ r * m_NumberOfTaps + i ], for i < m_NumberOfTaps. The taps
+   * are relative to the start of the buffered region of the input. A
+   * dimension that is the identity is skipped.
+   */
+  struct AveragingType
+  {
+    SizeValueType                  m_InputSize;
+    SizeValueType                  m_OutputSize;
+    unsigned int                   m_NumberOfTaps;
+    bool                           m_IsIdentity;
+    std::vector< OffsetValueType > m_FirstTaps;
+    std::vector< FloatType >       m_Weights;
+  };
+
+  /** The data passed to the threads by AverageAlongDimension(). */
+  template< class TInputValue >
+  struct AveragingThreaderParameterType
+  {
+    const AveragingType * m_Averaging;
+    const TInputValue *   m_Input;
+    FloatType *           m_Output;
+    SizeValueType         m_Stride;
+    SizeValueType         m_NumberOfLines;
+    SizeValueType         m_LinesPerWorkUnit;
+  };
+
+  /** Compute the box averaging of a dimension, for the grids of the input
+   * and the output.
+   */
+  static void ComputeAveraging( const unsigned int dimension,
+    const unsigned int factor, const InputImageType * input,
+    const OutputImageType * output, AveragingType & averaging );
+
+  /** Fill the output with the box averages of the input. */
+  void GenerateBoxAveragedData( const unsigned int level,
+    const InputImageType * input, OutputImageType * output ) const;
+
+  /** Average all lines along a dimension, multi-threaded. A line starts at
+   * ( l / stride ) * stride * length + l % stride, for line l.
+   */
+  template< class TInputValue >
+  static void AverageAlongDimension( const AveragingType & averaging,
+    const TInputValue * input, FloatType * output,
+    const SizeValueType stride, const SizeValueType numberOfLines );
+
+  /** Average the lines of a work unit along a dimension. */
+  template< class TInputValue >
+  static ITK_THREAD_RETURN_TYPE AveragingThreaderCallback( void * arg );
+
+  bool m_UseBoxAveraging;
+
 };
 
 } // namespace itk
@@ -21,11 +21,28 @@
 #include "itkMultiResolutionShrinkPyramidImageFilter.h"
 
 #include "itkShrinkImageFilter.h"
+#include "itkContinuousIndex.h"
 #include "vnl/vnl_math.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace itk
 {
 
+/*
+ * Constructor
+ */
+template< class TInputImage, class TOutputImage >
+MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
+::MultiResolutionShrinkPyramidImageFilter()
+{
+  this->m_UseBoxAveraging = false;
+
+} // end Constructor
+
+
+
 /*
  * GenerateData
  */
@@ -46,17 +63,28 @@ MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
     this->UpdateProgress( static_cast< float >( ilevel )
       / static_cast< float >( this->m_NumberOfLevels ) );
 
-    // Allocate memory for each output
-    OutputImagePointer outputPtr = this->GetOutput( ilevel );
-    outputPtr->SetBufferedRegion( outputPtr->GetRequestedRegion() );
-    outputPtr->Allocate();
-
     // compute and set shrink factors
     for( unsigned int idim = 0; idim < ImageDimension; idim++ )
     {
       factors[ idim ] = this->m_Schedule[ ilevel ][ idim ];
     }
     shrinker->SetShrinkFactors( factors );
+
+    // Average the boxes of the shrink factors, on the grid of the shrinker
+    OutputImagePointer outputPtr = this->GetOutput( ilevel );
+    if( this->m_UseBoxAveraging )
+    {
+      shrinker->UpdateOutputInformation();
+      outputPtr->CopyInformation( shrinker->GetOutput() );
+      outputPtr->SetRegions( shrinker->GetOutput()->GetLargestPossibleRegion() );
+      outputPtr->Allocate();
+      this->GenerateBoxAveragedData( ilevel, this->GetInput(), outputPtr );
+      continue;
+    }
+
+    // Allocate memory for each output
+    outputPtr->SetBufferedRegion( outputPtr->GetRequestedRegion() );
+    outputPtr->Allocate();
     shrinker->GraftOutput( outputPtr );
 
     // force to always update in case shrink factors are the same
@@ -67,6 +95,239 @@ MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
 } // end GenerateData()
 
 
+/*
+ * ComputeAveraging
+ */
+template< class TInputImage, class TOutputImage >
+void
+MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
+::ComputeAveraging( const unsigned int dimension, const unsigned int factor,
+  const InputImageType * input, const OutputImageType * output,
+  AveragingType & averaging )
+{
+  const typename InputImageType::RegionType &  inputRegion  = input->GetBufferedRegion();
+  const typename OutputImageType::RegionType & outputRegion = output->GetBufferedRegion();
+
+  /** The center of the first output pixel, as a continuous index of the
+   * input, relative to the start of the buffered region. The centers of
+   * the next output pixels are the shrink factor further.
+   */
+  typename OutputImageType::PointType point;
+  output->TransformIndexToPhysicalPoint( outputRegion.GetIndex(), point );
+  ContinuousIndex< double, ImageDimension > firstCenter;
+  input->TransformPhysicalPointToContinuousIndex( point, firstCenter );
+  const double start = firstCenter[ dimension ] - inputRegion.GetIndex()[ dimension ];
+
+  averaging.m_InputSize    = inputRegion.GetSize()[ dimension ];
+  averaging.m_OutputSize   = outputRegion.GetSize()[ dimension ];
+  averaging.m_NumberOfTaps = static_cast< unsigned int >( std::min< SizeValueType >(
+    factor + 1, averaging.m_InputSize ) );
+  averaging.m_IsIdentity = factor == 1 && std::abs( start ) < 1e-6
+    && averaging.m_InputSize == averaging.m_OutputSize;
+
+  const unsigned int    numberOfTaps = averaging.m_NumberOfTaps;
+  const OffsetValueType inputSize    = static_cast< OffsetValueType >( averaging.m_InputSize );
+  averaging.m_FirstTaps.resize( averaging.m_OutputSize );
+  averaging.m_Weights.assign( averaging.m_OutputSize * numberOfTaps, 0.0 );
+  for( SizeValueType r = 0; r < averaging.m_OutputSize; ++r )
+  {
+    /** The box, and the first input pixel inside it, where input pixel i
+     * covers [ i - 0.5, i + 0.5 ).
+     */
+    const double          center = start + static_cast< double >( r * factor );
+    const double          lower  = center - 0.5 * factor;
+    const double          upper  = center + 0.5 * factor;
+    const OffsetValueType first  = static_cast< OffsetValueType >( std::floor( lower + 0.5 ) );
+    const OffsetValueType clampedFirst = std::max< OffsetValueType >( 0,
+      std::min< OffsetValueType >( first, inputSize - numberOfTaps ) );
+    averaging.m_FirstTaps[ r ] = clampedFirst;
+
+    /** Weigh the pixels by their overlap with the box. The pixels outside
+     * the input are left out, by normalizing the weights.
+     */
+    FloatType * weights = &averaging.m_Weights[ r * numberOfTaps ];
+    double      sum     = 0.0;
+    for( unsigned int t = 0; t < numberOfTaps; ++t )
+    {
+      const double pixel   = static_cast< double >( clampedFirst + t );
+      const double overlap = std::min( upper, pixel + 0.5 ) - std::max( lower, pixel - 0.5 );
+      if( overlap > 1e-6 )
+      {
+        weights[ t ] = static_cast< FloatType >( overlap );
+        sum         += overlap;
+      }
+    }
+    for( unsigned int t = 0; t < numberOfTaps && sum > 0.0; ++t )
+    {
+      weights[ t ] = static_cast< FloatType >( weights[ t ] / sum );
+    }
+  }
+
+} // end ComputeAveraging()
+
+
+/*
+ * GenerateBoxAveragedData
+ */
+template< class TInputImage, class TOutputImage >
+void
+MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
+::GenerateBoxAveragedData( const unsigned int level,
+  const InputImageType * input, OutputImageType * output ) const
+{
+  AveragingType averagings[ ImageDimension ];
+  SizeValueType sizes[ ImageDimension ];
+  SizeValueType numberOfValues = 1;
+  for( unsigned int idim = 0; idim < ImageDimension; idim++ )
+  {
+    ComputeAveraging( idim, this->m_Schedule[ level ][ idim ], input, output,
+      averagings[ idim ] );
+    sizes[ idim ]   = averagings[ idim ].m_InputSize;
+    numberOfValues *= sizes[ idim ];
+  }
+
+  /** Average along the slowest varying dimension first, into alternating
+   * buffers. The strides of the faster dimensions do not change.
+   */
+  const InputPixelType *   inputBuffer   = input->GetBufferPointer();
+  const FloatType *        data          = nullptr;
+  std::vector< FloatType > buffers[ 2 ];
+  unsigned int             currentBuffer = 0;
+  for( unsigned int idim = ImageDimension; idim-- > 0; )
+  {
+    const AveragingType & averaging = averagings[ idim ];
+    if( averaging.m_IsIdentity )
+    {
+      continue;
+    }
+
+    SizeValueType stride = 1;
+    for( unsigned int j = 0; j < idim; j++ )
+    {
+      stride *= sizes[ j ];
+    }
+    const SizeValueType numberOfLines = numberOfValues / sizes[ idim ];
+    numberOfValues = numberOfLines * averaging.m_OutputSize;
+    sizes[ idim ]  = averaging.m_OutputSize;
+
+    std::vector< FloatType > & buffer = buffers[ currentBuffer ];
+    buffer.resize( numberOfValues );
+    if( data == nullptr )
+    {
+      AverageAlongDimension( averaging, inputBuffer, buffer.data(), stride, numberOfLines );
+    }
+    else
+    {
+      AverageAlongDimension( averaging, data, buffer.data(), stride, numberOfLines );
+    }
+    data          = buffer.data();
+    currentBuffer = 1 - currentBuffer;
+  }
+
+  /** Copy the averages to the output. */
+  OutputPixelType * outputBuffer = output->GetBufferPointer();
+  for( SizeValueType i = 0; i < numberOfValues; ++i )
+  {
+    outputBuffer[ i ] = data == nullptr
+      ? static_cast< OutputPixelType >( inputBuffer[ i ] )
+      : static_cast< OutputPixelType >( data[ i ] );
+  }
+
+} // end GenerateBoxAveragedData()
+
+
+/*
+ * AverageAlongDimension
+ */
+template< class TInputImage, class TOutputImage >
+template< class TInputValue >
+void
+MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
+::AverageAlongDimension( const AveragingType & averaging,
+  const TInputValue * input, FloatType * output,
+  const SizeValueType stride, const SizeValueType numberOfLines )
+{
+  PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+  const SizeValueType numberOfWorkUnits = std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( pool->GetMaximumNumberOfThreads(), numberOfLines ) );
+
+  AveragingThreaderParameterType< TInputValue > temp;
+  temp.m_Averaging        = &averaging;
+  temp.m_Input            = input;
+  temp.m_Output           = output;
+  temp.m_Stride           = stride;
+  temp.m_NumberOfLines    = numberOfLines;
+  temp.m_LinesPerWorkUnit = ( numberOfLines + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+  pool->SingleMethodExecute( static_cast< ThreadIdType >( numberOfWorkUnits ),
+    AveragingThreaderCallback< TInputValue >, &temp );
+
+} // end AverageAlongDimension()
+
+
+/*
+ * AveragingThreaderCallback
+ */
+template< class TInputImage, class TOutputImage >
+template< class TInputValue >
+ITK_THREAD_RETURN_TYPE
+MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
+::AveragingThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const AveragingThreaderParameterType< TInputValue > * temp
+    = static_cast< AveragingThreaderParameterType< TInputValue > * >( infoStruct->UserData );
+
+  const AveragingType & averaging    = *temp->m_Averaging;
+  const SizeValueType   stride       = temp->m_Stride;
+  const unsigned int    numberOfTaps = averaging.m_NumberOfTaps;
+  const SizeValueType   inputLength  = averaging.m_InputSize;
+  const SizeValueType   outputLength = averaging.m_OutputSize;
+  const SizeValueType   begin        = std::min( infoStruct->WorkUnitID * temp->m_LinesPerWorkUnit,
+    temp->m_NumberOfLines );
+  const SizeValueType end = std::min( begin + temp->m_LinesPerWorkUnit, temp->m_NumberOfLines );
+
+  /** The lines with the same l / stride are adjacent in memory, so they are
+   * averaged together, with the innermost loop over the lines.
+   */
+  SizeValueType line = begin;
+  while( line < end )
+  {
+    const SizeValueType outer      = line / stride;
+    const SizeValueType firstInner = line % stride;
+    const SizeValueType lastInner  = std::min( stride, firstInner + ( end - line ) );
+    const TInputValue * input      = temp->m_Input + outer * stride * inputLength;
+    FloatType *         output     = temp->m_Output + outer * stride * outputLength;
+
+    for( SizeValueType r = 0; r < outputLength; ++r )
+    {
+      FloatType *       outputLine = output + r * stride;
+      const FloatType * weights    = &averaging.m_Weights[ r * numberOfTaps ];
+      std::fill( outputLine + firstInner, outputLine + lastInner, FloatType( 0 ) );
+      for( unsigned int t = 0; t < numberOfTaps; ++t )
+      {
+        const FloatType weight = weights[ t ];
+        if( weight == FloatType( 0 ) )
+        {
+          continue;
+        }
+        const TInputValue * inputLine
+          = input + ( averaging.m_FirstTaps[ r ] + t ) * stride;
+        for( SizeValueType inner = firstInner; inner < lastInner; ++inner )
+        {
+          outputLine[ inner ] += weight * static_cast< FloatType >( inputLine[ inner ] );
+        }
+      }
+    }
+
+    line += lastInner - firstInner;
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end AveragingThreaderCallback()
+
+
 /**
  * GenerateInputRequestedRegion
  */
@@ -80,6 +341,21 @@ MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
 }
 
 
+/**
+ * PrintSelf
+ */
+template< class TInputImage, class TOutputImage >
+void
+MultiResolutionShrinkPyramidImageFilter< TInputImage, TOutputImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "UseBoxAveraging: " << this->m_UseBoxAveraging << std::endl;
+
+} // end PrintSelf()
+
+
 } // namespace itk
 
 #endif
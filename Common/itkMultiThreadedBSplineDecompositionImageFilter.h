@@ -0,0 +1,172 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMultiThreadedBSplineDecompositionImageFilter_h
+#define __itkMultiThreadedBSplineDecompositionImageFilter_h
+
+#include "itkImageToImageFilter.h"
+
+namespace itk
+{
+/** \class MultiThreadedBSplineDecompositionImageFilter
+ * \brief Calculates the B-spline coefficients of an image, multi-threaded.
+ *
+ * This filter computes the same coefficients as the
+ * BSplineDecompositionImageFilter, and as the
+ * MultiOrderBSplineDecompositionImageFilter when the spline order differs
+ * per dimension, with the same mirror boundary conditions. The recursive
+ * causal and anti-causal filters are applied to all lines along one
+ * dimension at a time. The lines of a dimension are independent, so they are
+ * divided over the work units, splitting the image along one of the other
+ * dimensions.
+ *
+ * The lines are filtered in blocks of NumberOfLinesPerBlock adjacent lines,
+ * which are interleaved in a scratch buffer, so that the inner loop of the
+ * recursion runs over the lines of a block. This loop has a fixed length and
+ * no dependencies, so the compiler vectorizes it. Except for the first
+ * dimension, the lines of a block are adjacent in memory as well. A
+ * dimension with a spline order of 0 or 1 is skipped, as its coefficients
+ * equal the data.
+ *
+ * Limitations: Spline order must be between 0 and 5.
+ *              Can only process LargestPossibleRegion.
+ *
+ * \sa BSplineDecompositionImageFilter
+ * \sa MultiOrderBSplineDecompositionImageFilter
+ *
+ * \ingroup ImageFilters
+ * \ingroup MultiThreaded
+ * \ingroup CannotBeStreamed
+ */
+template< class TInputImage, class TOutputImage >
+class MultiThreadedBSplineDecompositionImageFilter :
+  public ImageToImageFilter< TInputImage, TOutputImage >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef MultiThreadedBSplineDecompositionImageFilter    Self;
+  typedef ImageToImageFilter< TInputImage, TOutputImage > Superclass;
+  typedef SmartPointer< Self >                            Pointer;
+  typedef SmartPointer< const Self >                      ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( MultiThreadedBSplineDecompositionImageFilter, ImageToImageFilter );
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Inherit input and output image types from Superclass. */
+  typedef typename Superclass::InputImageType        InputImageType;
+  typedef typename Superclass::InputImagePointer     InputImagePointer;
+  typedef typename Superclass::OutputImageType       OutputImageType;
+  typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
+  typedef typename InputImageType::PixelType         InputPixelType;
+  typedef typename OutputImageType::PixelType        OutputPixelType;
+  typedef typename OutputImageRegionType::SizeType   SizeType;
+  typedef typename OutputImageRegionType::IndexType  IndexType;
+
+  typedef typename NumericTraits< OutputPixelType >::RealType CoeffType;
+
+  /** Dimension underlying input image. */
+  itkStaticConstMacro( ImageDimension, unsigned int, TInputImage::ImageDimension );
+  itkStaticConstMacro( OutputImageDimension, unsigned int,
+    TOutputImage::ImageDimension );
+
+  /** The number of adjacent lines that are filtered together. */
+  itkStaticConstMacro( NumberOfLinesPerBlock, unsigned int, 8 );
+
+  /** Set the spline order of all dimensions, or of one dimension. Supports
+   * 0th - 5th order splines. The default is a 3rd order spline.
+   */
+  void SetSplineOrder( const unsigned int order );
+
+  void SetSplineOrder( const unsigned int dimension, const unsigned int order );
+
+  /** Get the spline order of a dimension. */
+  unsigned int GetSplineOrder( const unsigned int dimension ) const
+  {
+    return this->m_SplineOrder[ dimension ];
+  }
+
+
+#ifdef ITK_USE_CONCEPT_CHECKING
+  /** Begin concept checking */
+  itkConceptMacro( DimensionCheck,
+    ( Concept::SameDimension< ImageDimension, OutputImageDimension > ) );
+  itkConceptMacro( InputConvertibleToOutputCheck,
+    ( Concept::Convertible< InputPixelType, OutputPixelType > ) );
+  itkConceptMacro( DoubleConvertibleToOutputCheck,
+    ( Concept::Convertible< double, OutputPixelType > ) );
+  /** End concept checking */
+#endif
+
+protected:
+
+  MultiThreadedBSplineDecompositionImageFilter();
+  ~MultiThreadedBSplineDecompositionImageFilter() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Filter the lines of each dimension in turn, multi-threaded. */
+  void GenerateData( void ) override;
+
+  /** Filter the lines of the current dimension in a region. */
+  void ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+    ThreadIdType threadId ) override;
+
+  /** Split the region along a dimension other than the current one, so that
+   * every line is in one piece.
+   */
+  unsigned int SplitRequestedRegion( unsigned int i, unsigned int pieces,
+    OutputImageRegionType & splitRegion ) override;
+
+  /** This filter requires all of the input image. */
+  void GenerateInputRequestedRegion( void ) override;
+
+  /** This filter must produce all of its output at once. */
+  void EnlargeOutputRequestedRegion( DataObject * output ) override;
+
+private:
+
+  MultiThreadedBSplineDecompositionImageFilter( const Self & ); // purposely not implemented
+  void operator=( const Self & );                               // purposely not implemented
+
+  /** Determines the poles of a dimension given its spline order. */
+  void SetPoles( const unsigned int dimension );
+
+  /** Converts a block of interleaved lines of data to spline coefficients,
+   * for the poles of a dimension.
+   */
+  void DataToCoefficients1D( CoeffType * scratch, const SizeValueType length,
+    const unsigned int dimension ) const;
+
+  unsigned int m_SplineOrder[ ImageDimension ];
+  unsigned int m_NumberOfPoles[ ImageDimension ];
+  double       m_SplinePoles[ ImageDimension ][ 2 ];
+  double       m_Tolerance;
+  unsigned int m_CurrentDimension;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkMultiThreadedBSplineDecompositionImageFilter.hxx"
+#endif
+
+#endif // end #ifndef __itkMultiThreadedBSplineDecompositionImageFilter_h
@@ -0,0 +1,546 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMultiThreadedBSplineDecompositionImageFilter_hxx
+#define __itkMultiThreadedBSplineDecompositionImageFilter_hxx
+
+#include "itkMultiThreadedBSplineDecompositionImageFilter.h"
+#include "itkProgressReporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::MultiThreadedBSplineDecompositionImageFilter()
+{
+  this->m_Tolerance        = 1e-10; // as in the BSplineDecompositionImageFilter
+  this->m_CurrentDimension = 0;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    this->m_SplineOrder[ d ] = 3;
+    this->SetPoles( d );
+  }
+
+  /** Use the classic threading model, to have the work units split the
+   * region with SplitRequestedRegion().
+   */
+  this->DynamicMultiThreadingOff();
+
+} // end Constructor
+
+
+/**
+ * ******************* SetSplineOrder *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::SetSplineOrder( const unsigned int order )
+{
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    this->SetSplineOrder( d, order );
+  }
+
+} // end SetSplineOrder()
+
+
+/**
+ * ******************* SetSplineOrder *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::SetSplineOrder( const unsigned int dimension, const unsigned int order )
+{
+  if( order > 5 )
+  {
+    itkExceptionMacro( << "SplineOrder must be between 0 and 5. "
+                       << "Requested spline order has not been implemented yet." );
+  }
+  if( this->m_SplineOrder[ dimension ] != order )
+  {
+    this->m_SplineOrder[ dimension ] = order;
+    this->SetPoles( dimension );
+    this->Modified();
+  }
+
+} // end SetSplineOrder()
+
+
+/**
+ * ******************* SetPoles *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::SetPoles( const unsigned int dimension )
+{
+  /** See Unser, 1997. Part II, Table I for the pole values. */
+  double * poles = this->m_SplinePoles[ dimension ];
+  switch( this->m_SplineOrder[ dimension ] )
+  {
+    case 0:
+    case 1:
+      this->m_NumberOfPoles[ dimension ] = 0;
+      break;
+    case 2:
+      this->m_NumberOfPoles[ dimension ] = 1;
+      poles[ 0 ]                         = std::sqrt( 8.0 ) - 3.0;
+      break;
+    case 3:
+      this->m_NumberOfPoles[ dimension ] = 1;
+      poles[ 0 ]                         = std::sqrt( 3.0 ) - 2.0;
+      break;
+    case 4:
+      this->m_NumberOfPoles[ dimension ] = 2;
+      poles[ 0 ] = std::sqrt( 664.0 - std::sqrt( 438976.0 ) ) + std::sqrt( 304.0 ) - 19.0;
+      poles[ 1 ] = std::sqrt( 664.0 + std::sqrt( 438976.0 ) ) - std::sqrt( 304.0 ) - 19.0;
+      break;
+    case 5:
+      this->m_NumberOfPoles[ dimension ] = 2;
+      poles[ 0 ] = std::sqrt( 135.0 / 2.0 - std::sqrt( 17745.0 / 4.0 ) ) + std::sqrt( 105.0 / 4.0 )
+        - 13.0 / 2.0;
+      poles[ 1 ] = std::sqrt( 135.0 / 2.0 + std::sqrt( 17745.0 / 4.0 ) ) - std::sqrt( 105.0 / 4.0 )
+        - 13.0 / 2.0;
+      break;
+    default:
+      itkExceptionMacro( << "SplineOrder must be between 0 and 5. "
+                         << "Requested spline order has not been implemented yet." );
+  }
+
+} // end SetPoles()
+
+
+/**
+ * ******************* DataToCoefficients1D *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::DataToCoefficients1D( CoeffType * scratch, const SizeValueType length,
+  const unsigned int dimension ) const
+{
+  /** See Unser, 1993, Part II, Equation 2.5, or Unser, 1999, Box 2.
+   * The lines of the block are interleaved: element n of line b is at
+   * scratch[ n * B + b ]. All loops over b are independent.
+   */
+  const unsigned int B             = NumberOfLinesPerBlock;
+  const unsigned int numberOfPoles = this->m_NumberOfPoles[ dimension ];
+  const double *     poles         = this->m_SplinePoles[ dimension ];
+
+  /** Required by the mirror boundaries. */
+  if( length == 1 || numberOfPoles == 0 )
+  {
+    return;
+  }
+
+  /** Compute and apply the overall gain. */
+  double c0 = 1.0;
+  for( unsigned int k = 0; k < numberOfPoles; ++k )
+  {
+    c0 *= ( 1.0 - poles[ k ] ) * ( 1.0 - 1.0 / poles[ k ] );
+  }
+  for( SizeValueType i = 0; i < length * B; ++i )
+  {
+    scratch[ i ] *= c0;
+  }
+
+  CoeffType *       last       = scratch + ( length - 1 ) * B;
+  const CoeffType * secondLast = last - B;
+  CoeffType         sum[ NumberOfLinesPerBlock ];
+  for( unsigned int k = 0; k < numberOfPoles; ++k )
+  {
+    const double z = poles[ k ];
+
+    /** The initial causal coefficient, for mirror boundaries. */
+    SizeValueType horizon = length;
+    if( this->m_Tolerance > 0.0 )
+    {
+      horizon = static_cast< SizeValueType >(
+        std::ceil( std::log( this->m_Tolerance ) / std::log( std::fabs( z ) ) ) );
+    }
+    double zn = z;
+    if( horizon < length )
+    {
+      /** Accelerated loop. */
+      std::copy( scratch, scratch + B, sum );
+      for( SizeValueType n = 1; n < horizon; ++n )
+      {
+        for( unsigned int b = 0; b < B; ++b )
+        {
+          sum[ b ] += zn * scratch[ n * B + b ];
+        }
+        zn *= z;
+      }
+      std::copy( sum, sum + B, scratch );
+    }
+    else
+    {
+      /** Full loop. */
+      const double iz  = 1.0 / z;
+      double       z2n = std::pow( z, static_cast< double >( length - 1 ) );
+      for( unsigned int b = 0; b < B; ++b )
+      {
+        sum[ b ] = scratch[ b ] + z2n * last[ b ];
+      }
+      z2n *= z2n * iz;
+      for( SizeValueType n = 1; n + 1 < length; ++n )
+      {
+        for( unsigned int b = 0; b < B; ++b )
+        {
+          sum[ b ] += ( zn + z2n ) * scratch[ n * B + b ];
+        }
+        zn  *= z;
+        z2n *= iz;
+      }
+      for( unsigned int b = 0; b < B; ++b )
+      {
+        scratch[ b ] = sum[ b ] / ( 1.0 - zn * zn );
+      }
+    }
+
+    /** The causal recursion. */
+    for( SizeValueType n = 1; n < length; ++n )
+    {
+      for( unsigned int b = 0; b < B; ++b )
+      {
+        scratch[ n * B + b ] += z * scratch[ ( n - 1 ) * B + b ];
+      }
+    }
+
+    /** The initial anti-causal coefficient, for mirror boundaries.
+     * See also the erratum at http://bigwww.epfl.ch/publications/unser9902.html
+     */
+    for( unsigned int b = 0; b < B; ++b )
+    {
+      last[ b ] = ( z / ( z * z - 1.0 ) ) * ( z * secondLast[ b ] + last[ b ] );
+    }
+
+    /** The anti-causal recursion. */
+    for( SizeValueType n = length - 1; n > 0; --n )
+    {
+      for( unsigned int b = 0; b < B; ++b )
+      {
+        scratch[ ( n - 1 ) * B + b ] = z * ( scratch[ n * B + b ] - scratch[ ( n - 1 ) * B + b ] );
+      }
+    }
+  }
+
+} // end DataToCoefficients1D()
+
+
+/**
+ * ******************* GenerateData *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::GenerateData( void )
+{
+  /** Allocate the output. */
+  OutputImageType * output = this->GetOutput();
+  output->SetBufferedRegion( output->GetRequestedRegion() );
+  output->Allocate();
+
+  /** Set up the multi-threaded processing. */
+  typename Superclass::ThreadStruct str;
+  str.Filter = this;
+  this->GetMultiThreader()->SetNumberOfWorkUnits( this->GetNumberOfWorkUnits() );
+  this->GetMultiThreader()->SetSingleMethod( this->ThreaderCallback, &str );
+
+  /** Filter the lines of each dimension in turn. The first pass also copies
+   * the input to the output, so it is never skipped.
+   */
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    if( d == 0 || this->m_NumberOfPoles[ d ] > 0 )
+    {
+      this->m_CurrentDimension = d;
+      this->GetMultiThreader()->SingleMethodExecute();
+    }
+  }
+
+} // end GenerateData()
+
+
+/**
+ * ******************* ThreadedGenerateData *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread,
+  ThreadIdType threadId )
+{
+  const unsigned int B             = NumberOfLinesPerBlock;
+  const unsigned int lineDimension = this->m_CurrentDimension;
+
+  /** The lines of a block are adjacent along the block dimension. */
+  const unsigned int blockDimension
+    = ( lineDimension == 0 && ImageDimension > 1 ) ? 1 : 0;
+  const bool interleave = blockDimension != lineDimension;
+
+  const InputImageType * input  = this->GetInput();
+  OutputImageType *      output = this->GetOutput();
+
+  const SizeType &        regionSize        = outputRegionForThread.GetSize();
+  const IndexType &       regionIndex       = outputRegionForThread.GetIndex();
+  const IndexType &       outputStart       = output->GetBufferedRegion().GetIndex();
+  const IndexType &       inputStart        = input->GetBufferedRegion().GetIndex();
+  const OffsetValueType * outputOffsetTable = output->GetOffsetTable();
+  const OffsetValueType * inputOffsetTable  = input->GetOffsetTable();
+
+  /** The number of blocks of lines along each dimension. */
+  SizeType numberOfBlocks = regionSize;
+  numberOfBlocks[ lineDimension ] = 1;
+  if( interleave )
+  {
+    numberOfBlocks[ blockDimension ] = ( regionSize[ blockDimension ] + B - 1 ) / B;
+  }
+  SizeValueType totalNumberOfBlocks = 1;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    totalNumberOfBlocks *= numberOfBlocks[ d ];
+  }
+  if( totalNumberOfBlocks == 0 )
+  {
+    return;
+  }
+
+  const SizeValueType   length            = regionSize[ lineDimension ];
+  const OffsetValueType outputLineStride  = outputOffsetTable[ lineDimension ];
+  const OffsetValueType outputBlockStride = outputOffsetTable[ blockDimension ];
+  const OffsetValueType inputLineStride   = inputOffsetTable[ lineDimension ];
+  const OffsetValueType inputBlockStride  = inputOffsetTable[ blockDimension ];
+
+  const float progressPerDimension = 1.0f / ImageDimension;
+  ProgressReporter progress( this, threadId, totalNumberOfBlocks, 10,
+    lineDimension * progressPerDimension, progressPerDimension );
+
+  std::vector< CoeffType > scratch( length * B, NumericTraits< CoeffType >::ZeroValue() );
+  for( SizeValueType block = 0; block < totalNumberOfBlocks; ++block )
+  {
+    /** The index of the first point of the first line of the block. */
+    IndexType     index = regionIndex;
+    SizeValueType rest = block;
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      const OffsetValueType step = ( interleave && d == blockDimension ) ? B : 1;
+      index[ d ] += static_cast< OffsetValueType >( rest % numberOfBlocks[ d ] ) * step;
+      rest       /= numberOfBlocks[ d ];
+    }
+    unsigned int numberOfLines = 1;
+    if( interleave )
+    {
+      numberOfLines = static_cast< unsigned int >( std::min< OffsetValueType >( B,
+        regionIndex[ blockDimension ] + static_cast< OffsetValueType >( regionSize[ blockDimension ] )
+        - index[ blockDimension ] ) );
+    }
+
+    OffsetValueType outputOffset = 0;
+    OffsetValueType inputOffset  = 0;
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      outputOffset += ( index[ d ] - outputStart[ d ] ) * outputOffsetTable[ d ];
+      inputOffset  += ( index[ d ] - inputStart[ d ] ) * inputOffsetTable[ d ];
+    }
+    OutputPixelType * outputLines = output->GetBufferPointer() + outputOffset;
+
+    /** Copy the lines to the scratch buffer. The first pass reads the input,
+     * the others the coefficients of the previous passes.
+     */
+    if( lineDimension == 0 )
+    {
+      const InputPixelType * inputLines = input->GetBufferPointer() + inputOffset;
+      for( SizeValueType n = 0; n < length; ++n )
+      {
+        for( unsigned int b = 0; b < numberOfLines; ++b )
+        {
+          scratch[ n * B + b ] = static_cast< CoeffType >(
+            inputLines[ n * inputLineStride + b * inputBlockStride ] );
+        }
+      }
+    }
+    else
+    {
+      for( SizeValueType n = 0; n < length; ++n )
+      {
+        for( unsigned int b = 0; b < numberOfLines; ++b )
+        {
+          scratch[ n * B + b ] = static_cast< CoeffType >(
+            outputLines[ n * outputLineStride + b * outputBlockStride ] );
+        }
+      }
+    }
+
+    /** Clear the unused lines of a partial block. */
+    for( SizeValueType n = 0; n < length && numberOfLines < B; ++n )
+    {
+      std::fill( &scratch[ n * B + numberOfLines ], &scratch[ n * B ] + B,
+        NumericTraits< CoeffType >::ZeroValue() );
+    }
+
+    /** Filter the lines, and copy them back to the output. */
+    this->DataToCoefficients1D( scratch.data(), length, lineDimension );
+    for( SizeValueType n = 0; n < length; ++n )
+    {
+      for( unsigned int b = 0; b < numberOfLines; ++b )
+      {
+        outputLines[ n * outputLineStride + b * outputBlockStride ]
+          = static_cast< OutputPixelType >( scratch[ n * B + b ] );
+      }
+    }
+
+    progress.CompletedPixel();
+  }
+
+} // end ThreadedGenerateData()
+
+
+/**
+ * ******************* SplitRequestedRegion *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+unsigned int
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::SplitRequestedRegion( unsigned int i, unsigned int pieces,
+  OutputImageRegionType & splitRegion )
+{
+  const OutputImageType * output = this->GetOutput();
+  const SizeType & requestedRegionSize = output->GetRequestedRegion().GetSize();
+
+  /** Initialize the split region to the requested region. */
+  splitRegion = output->GetRequestedRegion();
+  IndexType splitIndex = splitRegion.GetIndex();
+  SizeType  splitSize  = splitRegion.GetSize();
+
+  /** Split along the outermost dimension, other than the current one. */
+  int splitAxis = static_cast< int >( ImageDimension ) - 1;
+  while( requestedRegionSize[ splitAxis ] == 1
+    || splitAxis == static_cast< int >( this->m_CurrentDimension ) )
+  {
+    --splitAxis;
+    if( splitAxis < 0 )
+    {
+      return 1;
+    }
+  }
+
+  /** Determine the actual number of pieces. */
+  const SizeValueType range           = requestedRegionSize[ splitAxis ];
+  const SizeValueType valuesPerThread = ( range + pieces - 1 ) / pieces;
+  const unsigned int  maxThreadIdUsed
+    = static_cast< unsigned int >( ( range + valuesPerThread - 1 ) / valuesPerThread ) - 1;
+
+  if( i < maxThreadIdUsed )
+  {
+    splitIndex[ splitAxis ] += i * valuesPerThread;
+    splitSize[ splitAxis ]   = valuesPerThread;
+  }
+  if( i == maxThreadIdUsed )
+  {
+    splitIndex[ splitAxis ] += i * valuesPerThread;
+    splitSize[ splitAxis ]  -= i * valuesPerThread;
+  }
+
+  splitRegion.SetIndex( splitIndex );
+  splitRegion.SetSize( splitSize );
+  return maxThreadIdUsed + 1;
+
+} // end SplitRequestedRegion()
+
+
+/**
+ * ******************* GenerateInputRequestedRegion *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::GenerateInputRequestedRegion( void )
+{
+  /** This filter requires all of the input image to be in the buffer. */
+  InputImagePointer input = const_cast< InputImageType * >( this->GetInput() );
+  if( input )
+  {
+    input->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+} // end GenerateInputRequestedRegion()
+
+
+/**
+ * ******************* EnlargeOutputRequestedRegion *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::EnlargeOutputRequestedRegion( DataObject * output )
+{
+  /** This filter requires all of the output image to be in the buffer. */
+  OutputImageType * image = dynamic_cast< OutputImageType * >( output );
+  if( image )
+  {
+    image->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+} // end EnlargeOutputRequestedRegion()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TInputImage, class TOutputImage >
+void
+MultiThreadedBSplineDecompositionImageFilter< TInputImage, TOutputImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "SplineOrder: ";
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    os << this->m_SplineOrder[ d ] << ( d + 1 < ImageDimension ? ", " : "" );
+  }
+  os << std::endl;
+  os << indent << "Tolerance: " << this->m_Tolerance << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkMultiThreadedBSplineDecompositionImageFilter_hxx
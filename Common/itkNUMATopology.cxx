@@ -0,0 +1,255 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkNUMATopology_cxx
+#define __itkNUMATopology_cxx
+
+#include "itkNUMATopology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#if defined( __linux__ )
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+
+namespace
+{
+
+/** A node of the machine: the number the kernel gives it, and its CPUs. */
+struct NodeType
+{
+  unsigned int                m_Id;
+  std::vector< unsigned int > m_CPUs;
+};
+
+/** Read the nodes that have CPUs, in the order of their numbers. */
+std::vector< NodeType >
+ReadNodes( void )
+{
+  std::vector< NodeType > nodes;
+#if defined( __linux__ )
+  const std::string directory = "/sys/devices/system/node";
+  DIR *             dir       = opendir( directory.c_str() );
+  if( dir != nullptr )
+  {
+    while( const struct dirent * entry = readdir( dir ) )
+    {
+      const std::string name = entry->d_name;
+      if( name.size() <= 4 || name.compare( 0, 4, "node" ) != 0
+        || name.find_first_not_of( "0123456789", 4 ) != std::string::npos )
+      {
+        continue;
+      }
+
+      std::ifstream file( ( directory + "/" + name + "/cpulist" ).c_str() );
+      std::string   cpuList;
+      NodeType      node;
+      node.m_Id = static_cast< unsigned int >( std::atoi( name.c_str() + 4 ) );
+      if( std::getline( file, cpuList )
+        && NUMATopology::ParseCPUList( cpuList, node.m_CPUs ) && !node.m_CPUs.empty() )
+      {
+        nodes.push_back( node );
+      }
+    }
+    closedir( dir );
+  }
+  std::sort( nodes.begin(), nodes.end(),
+    []( const NodeType & a, const NodeType & b ) { return a.m_Id < b.m_Id; } );
+#endif
+  return nodes;
+}
+
+/** The nodes are read once, the initialization of a local static is thread-safe. */
+const std::vector< NodeType > &
+GetNodes( void )
+{
+  static const std::vector< NodeType > nodes = ReadNodes();
+  return nodes;
+}
+
+} // end namespace
+
+
+/**
+ * ****************** GetNumberOfNodes *********************************
+ */
+
+unsigned int
+NUMATopology
+::GetNumberOfNodes( void )
+{
+  return std::max( static_cast< unsigned int >( GetNodes().size() ), 1u );
+
+} // end GetNumberOfNodes()
+
+
+/**
+ * ****************** GetCPUsOfNode *********************************
+ */
+
+std::vector< unsigned int >
+NUMATopology
+::GetCPUsOfNode( const unsigned int node )
+{
+  const std::vector< NodeType > & nodes = GetNodes();
+  return node < nodes.size() ? nodes[ node ].m_CPUs : std::vector< unsigned int >();
+
+} // end GetCPUsOfNode()
+
+
+/**
+ * ****************** BindCurrentThreadToNode *********************************
+ */
+
+bool
+NUMATopology
+::BindCurrentThreadToNode( const unsigned int node )
+{
+  const std::vector< NodeType > & nodes = GetNodes();
+  if( nodes.size() < 2 || node >= nodes.size() )
+  {
+    return false;
+  }
+
+#if defined( __linux__ )
+  cpu_set_t cpuSet;
+  CPU_ZERO( &cpuSet );
+  for( const unsigned int cpu : nodes[ node ].m_CPUs )
+  {
+    if( cpu < CPU_SETSIZE )
+    {
+      CPU_SET( cpu, &cpuSet );
+    }
+  }
+
+  /** On Linux, thread 0 is the calling thread. */
+  return sched_setaffinity( 0, sizeof( cpuSet ), &cpuSet ) == 0;
+#else
+  return false;
+#endif
+
+} // end BindCurrentThreadToNode()
+
+
+/**
+ * ****************** InterleaveMemory *********************************
+ */
+
+bool
+NUMATopology
+::InterleaveMemory( const void * buffer, const std::size_t size )
+{
+  const std::vector< NodeType > & nodes = GetNodes();
+  if( nodes.size() < 2 || buffer == nullptr )
+  {
+    return false;
+  }
+
+#if defined( __linux__ ) && defined( SYS_mbind )
+  /** The values of <linux/mempolicy.h>. */
+  const int          interleavePolicy = 3;       // MPOL_INTERLEAVE
+  const unsigned int moveFlag         = 1u << 1; // MPOL_MF_MOVE
+
+  /** Only whole pages can be placed. */
+  const std::size_t pageSize = static_cast< std::size_t >( sysconf( _SC_PAGESIZE ) );
+  const std::size_t begin    = ( reinterpret_cast< std::size_t >( buffer ) + pageSize - 1 ) / pageSize * pageSize;
+  const std::size_t end      = ( reinterpret_cast< std::size_t >( buffer ) + size ) / pageSize * pageSize;
+  if( end <= begin )
+  {
+    return false;
+  }
+
+  /** The mask of the nodes, one bit per node number. */
+  const std::size_t            bitsPerWord = 8 * sizeof( unsigned long );
+  std::vector< unsigned long > mask( nodes.back().m_Id / bitsPerWord + 1, 0 );
+  for( const NodeType & node : nodes )
+  {
+    mask[ node.m_Id / bitsPerWord ] |= 1ul << ( node.m_Id % bitsPerWord );
+  }
+
+  /** The kernel reads one bit less than the given number of nodes. */
+  return syscall( SYS_mbind, reinterpret_cast< void * >( begin ), end - begin,
+    interleavePolicy, mask.data(), mask.size() * bitsPerWord + 1, moveFlag ) == 0;
+#else
+  static_cast< void >( size );
+  return false;
+#endif
+
+} // end InterleaveMemory()
+
+
+/**
+ * ****************** ParseCPUList *********************************
+ */
+
+bool
+NUMATopology
+::ParseCPUList( const std::string & text, std::vector< unsigned int > & cpus )
+{
+  std::vector< unsigned int > result;
+  std::istringstream          input( text );
+  std::string                 range;
+  while( std::getline( input, range, ',' ) )
+  {
+    /** Remove white space, such as the end of the line. */
+    range.erase( std::remove_if( range.begin(), range.end(),
+      []( const char c ) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; } ), range.end() );
+    if( range.empty() )
+    {
+      continue;
+    }
+
+    const std::size_t dash      = range.find( '-' );
+    const std::string firstText = range.substr( 0, dash );
+    const std::string lastText  = dash == std::string::npos ? firstText : range.substr( dash + 1 );
+    if( firstText.empty() || lastText.empty()
+      || firstText.find_first_not_of( "0123456789" ) != std::string::npos
+      || lastText.find_first_not_of( "0123456789" ) != std::string::npos )
+    {
+      return false;
+    }
+
+    const unsigned int first = static_cast< unsigned int >( std::atoi( firstText.c_str() ) );
+    const unsigned int last  = static_cast< unsigned int >( std::atoi( lastText.c_str() ) );
+    if( last < first )
+    {
+      return false;
+    }
+    for( unsigned int cpu = first; cpu <= last; ++cpu )
+    {
+      result.push_back( cpu );
+    }
+  }
+
+  cpus.swap( result );
+  return true;
+
+} // end ParseCPUList()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkNUMATopology_cxx
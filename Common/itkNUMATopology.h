@@ -0,0 +1,81 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkNUMATopology_h
+#define __itkNUMATopology_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class NUMATopology
+ *
+ * \brief Describes the NUMA nodes of the machine, and places threads and
+ * memory on them.
+ *
+ * On a machine with several sockets each socket has its own memory, and a
+ * thread that reads memory of another socket is slower. The PersistentThreadPool
+ * uses this class to pin its threads to the nodes, and the metrics to spread
+ * the pages of the images over the nodes. The nodes are read from
+ * /sys/devices/system/node on Linux, so no NUMA library is needed. On other
+ * platforms the machine is reported as a single node, and the placement
+ * functions do nothing.
+ *
+ * \ingroup ITKCommon
+ */
+
+class NUMATopology
+{
+public:
+
+  /** Get the number of nodes that have CPUs, at least one. */
+  static unsigned int GetNumberOfNodes( void );
+
+  /** Get the CPUs of a node, empty if the node does not exist. */
+  static std::vector< unsigned int > GetCPUsOfNode( const unsigned int node );
+
+  /** Restrict the current thread to the CPUs of a node. Returns false if
+   * the thread could not be pinned, for example when there is one node.
+   */
+  static bool BindCurrentThreadToNode( const unsigned int node );
+
+  /** Spread the pages of the memory [buffer, buffer + size) round-robin over
+   * the nodes, moving the pages that were touched before. Only whole pages
+   * inside the memory are placed. Returns false if the memory is not placed,
+   * for example when there is one node.
+   */
+  static bool InterleaveMemory( const void * buffer, const std::size_t size );
+
+  /** Parse a list of CPUs in the format of the kernel, like "0-3,8,10-11".
+   * Returns false, and leaves the CPUs unchanged, if the text is not a list.
+   */
+  static bool ParseCPUList( const std::string & text, std::vector< unsigned int > & cpus );
+
+private:
+
+  NUMATopology();                         // purposely not implemented
+  NUMATopology( const NUMATopology & );   // purposely not implemented
+  void operator=( const NUMATopology & ); // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkNUMATopology_h
@@ -51,7 +51,10 @@ namespace itk
  * high precision output type and cast manually if this is a problem.
  *
  * This filter is threaded. Threading mechanism derived from
- * SignedMaurerDistanceMap extensions by Gaetan Lehman
+ * SignedMaurerDistanceMap extensions by Gaetan Lehman. The dimensions are
+ * processed one after the other, and the lines of a dimension are divided
+ * over the work units, by splitting the image along another dimension, so
+ * that every line is processed by one work unit.
  *
  * \author Richard Beare, Department of Medicine, Monash University,
  * Australia.  <Richard.Beare@med.monash.edu.au>
@@ -147,7 +150,11 @@ protected:
   /** Generate Data */
   void GenerateData( void ) override;
 
-  int SplitRequestedRegion( int i, int num, OutputImageRegionType & splitRegion );
+  /** Split the region along a dimension other than the current one, so that
+   * every line is in one piece.
+   */
+  unsigned int SplitRequestedRegion( unsigned int i, unsigned int num,
+    OutputImageRegionType & splitRegion ) override;
 
   void ThreadedGenerateData( const OutputImageRegionType & outputRegionForThread, ThreadIdType threadId ) override;
 
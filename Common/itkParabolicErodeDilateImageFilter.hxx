@@ -61,9 +61,9 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
 
 
 template< typename TInputImage, bool doDilate, typename TOutputImage >
-int
+unsigned int
 ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
-::SplitRequestedRegion( int i, int num, OutputImageRegionType & splitRegion )
+::SplitRequestedRegion( unsigned int i, unsigned int num, OutputImageRegionType & splitRegion )
 {
   // Get the output pointer
   OutputImageType * outputPtr = this->GetOutput();
@@ -94,8 +94,8 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
 
   // determine the actual number of pieces that will be generated
   typename TOutputImage::SizeType::SizeValueType range = requestedRegionSize[ splitAxis ];
-  int valuesPerThread = (int)::ceil( range / (double)num );
-  int maxThreadIdUsed = (int)::ceil( range / (double)valuesPerThread ) - 1;
+  const unsigned int valuesPerThread = (unsigned int)::ceil( range / (double)num );
+  const unsigned int maxThreadIdUsed = (unsigned int)::ceil( range / (double)valuesPerThread ) - 1;
 
   // Split the region
   if( i < maxThreadIdUsed )
@@ -218,7 +218,7 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
   }
   float progressPerDimension = 1.0 / ImageDimension;
 
-  ProgressReporter * progress = new ProgressReporter( this,
+  ProgressReporter progress( this,
     threadId,
     NumberOfRows[ m_CurrentDimension ],
     30,
@@ -233,11 +233,10 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
 
   typedef ImageRegion< TInputImage::ImageDimension > RegionType;
 
+  // The output is allocated by GenerateData(), as the work units share it
   typename TInputImage::ConstPointer inputImage( this->GetInput() );
   typename TOutputImage::Pointer     outputImage( this->GetOutput() );
 
-  outputImage->SetBufferedRegion( outputImage->GetRequestedRegion() );
-  outputImage->Allocate();
   RegionType region = outputRegionForThread;
 
   InputConstIteratorType  inputIterator(  inputImage,  region );
@@ -266,7 +265,7 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
 
       doOneDimension< InputConstIteratorType, OutputIteratorType,
       RealType, OutputPixelType, doDilate >( inputIterator, outputIterator,
-        *progress, LineLength, 0,
+        progress, LineLength, 0,
         this->m_MagnitudeSign,
         this->m_UseImageSpacing,
         this->m_Extreme,
@@ -301,7 +300,7 @@ ParabolicErodeDilateImageFilter< TInputImage, doDilate, TOutputImage >
 
       doOneDimension< OutputConstIteratorType, OutputIteratorType,
       RealType, OutputPixelType, doDilate >( inputIteratorStage2, outputIterator,
-        *progress, LineLength, m_CurrentDimension,
+        progress, LineLength, m_CurrentDimension,
         this->m_MagnitudeSign,
         this->m_UseImageSpacing,
         this->m_Extreme,
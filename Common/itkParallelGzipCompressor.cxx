@@ -0,0 +1,190 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelGzipCompressor_cxx
+#define __itkParallelGzipCompressor_cxx
+
+#include "itkParallelGzipCompressor.h"
+#include "itkMacro.h"
+#include "itk_zlib.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace itk
+{
+
+/**
+ * ******************** CompressFile ********************
+ */
+
+void
+ParallelGzipCompressor
+::CompressFile( const std::string & inputFileName,
+  const std::string & outputFileName, const int compressionLevel )
+{
+  std::ifstream input( inputFileName.c_str(), std::ios::in | std::ios::binary );
+  if( !input.is_open() )
+  {
+    itkGenericExceptionMacro( << "ERROR: could not open " << inputFileName << " for reading." );
+  }
+  std::ofstream output( outputFileName.c_str(), std::ios::out | std::ios::binary );
+  if( !output.is_open() )
+  {
+    itkGenericExceptionMacro( << "ERROR: could not open " << outputFileName << " for writing." );
+  }
+
+  /** The gzip header: deflate, no flags, no time stamp, unknown OS. */
+  const unsigned char header[ 10 ] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+  output.write( reinterpret_cast< const char * >( header ), sizeof( header ) );
+
+  const PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+  const ThreadIdType                  blocksPerBatch = std::max< ThreadIdType >( 1,
+    pool->GetMaximumNumberOfThreads() );
+
+  std::vector< std::vector< unsigned char > > inputBlocks( blocksPerBatch );
+  std::vector< std::vector< unsigned char > > outputBlocks( blocksPerBatch );
+  std::vector< unsigned long >                checksums( blocksPerBatch );
+
+  BlockThreaderParameterType temp;
+  temp.m_InputBlocks      = &inputBlocks;
+  temp.m_OutputBlocks     = &outputBlocks;
+  temp.m_Checksums        = &checksums;
+  temp.m_CompressionLevel = compressionLevel;
+  temp.m_LastBatch        = false;
+
+  unsigned long      checksum = crc32( 0L, Z_NULL, 0 );
+  unsigned long long fileSize = 0;
+  while( !temp.m_LastBatch )
+  {
+    /** Read a block per thread. An empty file gives a single empty block. */
+    ThreadIdType numberOfBlocks = 0;
+    while( numberOfBlocks < blocksPerBatch )
+    {
+      std::vector< unsigned char > & block = inputBlocks[ numberOfBlocks ];
+      block.resize( BlockSize );
+      input.read( reinterpret_cast< char * >( block.data() ), BlockSize );
+      block.resize( static_cast< std::size_t >( input.gcount() ) );
+      if( block.empty() && numberOfBlocks > 0 )
+      {
+        break;
+      }
+      ++numberOfBlocks;
+      if( input.peek() == std::ifstream::traits_type::eof() )
+      {
+        break;
+      }
+    }
+    if( input.bad() )
+    {
+      itkGenericExceptionMacro( << "ERROR: could not read " << inputFileName << "." );
+    }
+    temp.m_LastBatch = input.peek() == std::ifstream::traits_type::eof();
+    inputBlocks.resize( numberOfBlocks );
+    outputBlocks.resize( numberOfBlocks );
+    checksums.resize( numberOfBlocks );
+
+    pool->SingleMethodExecute( numberOfBlocks, BlockThreaderCallback, &temp );
+
+    /** Write the blocks in order, and combine their checksums. */
+    for( ThreadIdType i = 0; i < numberOfBlocks; ++i )
+    {
+      output.write( reinterpret_cast< const char * >( outputBlocks[ i ].data() ),
+        static_cast< std::streamsize >( outputBlocks[ i ].size() ) );
+      checksum = crc32_combine( checksum, checksums[ i ],
+        static_cast< z_off_t >( inputBlocks[ i ].size() ) );
+      fileSize += inputBlocks[ i ].size();
+    }
+    inputBlocks.resize( blocksPerBatch );
+    outputBlocks.resize( blocksPerBatch );
+    checksums.resize( blocksPerBatch );
+  }
+
+  /** The gzip trailer: the checksum and the size modulo 2^32, little endian. */
+  unsigned char trailer[ 8 ];
+  for( unsigned int i = 0; i < 4; ++i )
+  {
+    trailer[ i ]     = static_cast< unsigned char >( ( checksum >> ( 8 * i ) ) & 0xff );
+    trailer[ 4 + i ] = static_cast< unsigned char >( ( fileSize >> ( 8 * i ) ) & 0xff );
+  }
+  output.write( reinterpret_cast< const char * >( trailer ), sizeof( trailer ) );
+
+  if( !output )
+  {
+    itkGenericExceptionMacro( << "ERROR: could not write " << outputFileName << "." );
+  }
+
+} // end CompressFile()
+
+
+/**
+ * ******************** BlockThreaderCallback ********************
+ */
+
+ITK_THREAD_RETURN_TYPE
+ParallelGzipCompressor
+::BlockThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const BlockThreaderParameterType * temp
+    = static_cast< BlockThreaderParameterType * >( infoStruct->UserData );
+
+  const ThreadIdType                   blockNumber = infoStruct->WorkUnitID;
+  const std::vector< unsigned char > & inputBlock  = ( *temp->m_InputBlocks )[ blockNumber ];
+  std::vector< unsigned char > &       outputBlock = ( *temp->m_OutputBlocks )[ blockNumber ];
+  const bool                           lastBlock   = temp->m_LastBatch
+    && blockNumber + 1 == temp->m_InputBlocks->size();
+
+  /** A raw deflate stream, without the zlib header and trailer. */
+  z_stream stream;
+  stream.zalloc = Z_NULL;
+  stream.zfree  = Z_NULL;
+  stream.opaque = Z_NULL;
+  if( deflateInit2( &stream, temp->m_CompressionLevel, Z_DEFLATED, -MAX_WBITS, 8,
+    Z_DEFAULT_STRATEGY ) != Z_OK )
+  {
+    itkGenericExceptionMacro( << "ERROR: could not initialize zlib." );
+  }
+
+  /** The sync flush adds at most an empty stored block to the bound. */
+  outputBlock.resize( deflateBound( &stream, static_cast< uLong >( inputBlock.size() ) ) + 16 );
+  stream.next_in   = const_cast< Bytef * >( inputBlock.data() );
+  stream.avail_in  = static_cast< uInt >( inputBlock.size() );
+  stream.next_out  = outputBlock.data();
+  stream.avail_out = static_cast< uInt >( outputBlock.size() );
+
+  const int result = deflate( &stream, lastBlock ? Z_FINISH : Z_SYNC_FLUSH );
+  const bool success = lastBlock ? result == Z_STREAM_END
+    : ( result == Z_OK && stream.avail_in == 0 && stream.avail_out > 0 );
+  outputBlock.resize( stream.total_out );
+  deflateEnd( &stream );
+  if( !success )
+  {
+    itkGenericExceptionMacro( << "ERROR: zlib could not compress a block." );
+  }
+
+  ( *temp->m_Checksums )[ blockNumber ] = crc32( 0L, inputBlock.data(),
+    static_cast< uInt >( inputBlock.size() ) );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end BlockThreaderCallback()
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelGzipCompressor_cxx
@@ -0,0 +1,87 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelGzipCompressor_h
+#define __itkParallelGzipCompressor_h
+
+#include "itkIntTypes.h"
+#include "itkPersistentThreadPool.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ParallelGzipCompressor
+ *
+ * \brief Compresses a file to the gzip format with multiple threads.
+ *
+ * zlib compresses a stream with a single thread, which for large images
+ * takes longer than computing them. This class splits the file in blocks of
+ * BlockSize bytes, which are deflated independently by the threads of the
+ * PersistentThreadPool, and concatenates them in order. All blocks but the
+ * last end with a sync flush, so that they end at a byte boundary, and the
+ * checksums of the blocks are combined. The result is a single standard
+ * gzip member, which any gzip reader decompresses. Because the blocks do not
+ * share their history, the file is slightly larger than with a single
+ * stream.
+ *
+ * The file is read and written in batches of one block per thread, so the
+ * memory use does not depend on the size of the file.
+ *
+ * \ingroup ITKCommon
+ */
+
+class ParallelGzipCompressor
+{
+public:
+
+  /** The number of bytes of the blocks that are deflated independently. */
+  static const SizeValueType BlockSize = 1 << 20;
+
+  /** Compress the file inputFileName to the gzip file outputFileName, with
+   * the zlib compression level, from 0 to 9, or -1 for the default level.
+   * Throws an ExceptionObject on failure.
+   */
+  static void CompressFile( const std::string & inputFileName,
+    const std::string & outputFileName, const int compressionLevel = -1 );
+
+private:
+
+  ParallelGzipCompressor();                                 // purposely not implemented
+  ParallelGzipCompressor( const ParallelGzipCompressor & ); // purposely not implemented
+  void operator=( const ParallelGzipCompressor & );         // purposely not implemented
+
+  /** The blocks of a batch, shared by the work units. */
+  struct BlockThreaderParameterType
+  {
+    const std::vector< std::vector< unsigned char > > * m_InputBlocks;
+    std::vector< std::vector< unsigned char > > *       m_OutputBlocks;
+    std::vector< unsigned long > *                      m_Checksums;
+    int                                                 m_CompressionLevel;
+    bool                                                m_LastBatch;
+  };
+
+  /** Deflate the block of a work unit and compute its checksum. */
+  static ITK_THREAD_RETURN_TYPE BlockThreaderCallback( void * arg );
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelGzipCompressor_h
@@ -0,0 +1,200 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelRadixSort_cxx
+#define __itkParallelRadixSort_cxx
+
+#include "itkParallelRadixSort.h"
+#include "itkPersistentThreadPool.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace itk
+{
+
+namespace
+{
+
+/** The number of different values of a digit of one byte. */
+const unsigned int NumberOfBuckets = 256;
+
+/** The data passed to the threads by ParallelRadixSort::SortIndices(). */
+struct RadixSortThreaderParameterType
+{
+  /** The keys and indices of the current pass, and their destination. */
+  const std::uint64_t * m_SourceKeys;
+  const SizeValueType * m_SourceIndices;
+  std::uint64_t *       m_DestinationKeys;
+  SizeValueType *       m_DestinationIndices;
+
+  SizeValueType m_Size;
+  SizeValueType m_ChunkSize;
+  unsigned int  m_Shift;
+  bool          m_Scatter;
+
+  /** For each chunk and digit, the count of the keys or, when scattering,
+   * the next destination position.
+   */
+  std::vector< SizeValueType > m_Buckets;
+};
+
+
+/** Count the digits of the chunk of a work unit, or scatter the chunk. */
+ITK_THREAD_RETURN_TYPE
+RadixSortThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  RadixSortThreaderParameterType * temp
+    = static_cast< RadixSortThreaderParameterType * >( infoStruct->UserData );
+
+  const ThreadIdType  chunk   = infoStruct->WorkUnitID;
+  const SizeValueType begin   = std::min( chunk * temp->m_ChunkSize, temp->m_Size );
+  const SizeValueType end     = std::min( begin + temp->m_ChunkSize, temp->m_Size );
+  const unsigned int  shift   = temp->m_Shift;
+  SizeValueType *     buckets = &temp->m_Buckets[ chunk * NumberOfBuckets ];
+
+  if( !temp->m_Scatter )
+  {
+    for( SizeValueType i = begin; i < end; ++i )
+    {
+      ++buckets[ ( temp->m_SourceKeys[ i ] >> shift ) & 0xff ];
+    }
+  }
+  else
+  {
+    for( SizeValueType i = begin; i < end; ++i )
+    {
+      const std::uint64_t key         = temp->m_SourceKeys[ i ];
+      const SizeValueType destination = buckets[ ( key >> shift ) & 0xff ]++;
+      temp->m_DestinationKeys[ destination ]    = key;
+      temp->m_DestinationIndices[ destination ] = temp->m_SourceIndices[ i ];
+    }
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end RadixSortThreaderCallback()
+
+
+} // end namespace
+
+/**
+ * ******************** SortIndices ********************
+ */
+
+void
+ParallelRadixSort
+::SortIndices( const std::uint64_t * keys, const SizeValueType size,
+  const unsigned int numberOfKeyBits, SizeValueType * order )
+{
+  for( SizeValueType i = 0; i < size; ++i )
+  {
+    order[ i ] = i;
+  }
+  if( size <= 1 )
+  {
+    return;
+  }
+
+  /** Mask off the bits that are not compared. */
+  const std::uint64_t keyMask = numberOfKeyBits >= 64
+    ? ~std::uint64_t( 0 ) : ( std::uint64_t( 1 ) << numberOfKeyBits ) - 1;
+  std::vector< std::uint64_t > keysA( size );
+  std::vector< std::uint64_t > keysB( size );
+  std::vector< SizeValueType > indicesB( size );
+  for( SizeValueType i = 0; i < size; ++i )
+  {
+    keysA[ i ] = keys[ i ] & keyMask;
+  }
+
+  const ThreadIdType numberOfChunks = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( ( size + MinimumChunkSize - 1 ) / MinimumChunkSize,
+    PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() ) ) );
+
+  RadixSortThreaderParameterType temp;
+  temp.m_Size      = size;
+  temp.m_ChunkSize = ( size + numberOfChunks - 1 ) / numberOfChunks;
+
+  std::uint64_t * sourceKeys         = keysA.data();
+  SizeValueType * sourceIndices      = order;
+  std::uint64_t * destinationKeys    = keysB.data();
+  SizeValueType * destinationIndices = indicesB.data();
+
+  for( unsigned int shift = 0; shift < std::min( numberOfKeyBits, 64u ); shift += 8 )
+  {
+    temp.m_SourceKeys         = sourceKeys;
+    temp.m_SourceIndices      = sourceIndices;
+    temp.m_DestinationKeys    = destinationKeys;
+    temp.m_DestinationIndices = destinationIndices;
+    temp.m_Shift              = shift;
+
+    /** Count the digits of each chunk. */
+    temp.m_Scatter = false;
+    temp.m_Buckets.assign( numberOfChunks * NumberOfBuckets, 0 );
+    PersistentThreadPool::GetInstance()->SingleMethodExecute(
+      numberOfChunks, RadixSortThreaderCallback, &temp );
+
+    /** Compute where each chunk writes each digit: all smaller digits go
+     * first, and for equal digits the chunks go in order. Skip the pass
+     * when all keys have the same digit.
+     */
+    bool          allKeysHaveTheSameDigit = false;
+    SizeValueType position                = 0;
+    for( unsigned int digit = 0; digit < NumberOfBuckets; ++digit )
+    {
+      SizeValueType numberOfKeysWithDigit = 0;
+      for( ThreadIdType chunk = 0; chunk < numberOfChunks; ++chunk )
+      {
+        SizeValueType & bucket = temp.m_Buckets[ chunk * NumberOfBuckets + digit ];
+        const SizeValueType count = bucket;
+        bucket                 = position;
+        position              += count;
+        numberOfKeysWithDigit += count;
+      }
+      if( numberOfKeysWithDigit == size )
+      {
+        allKeysHaveTheSameDigit = true;
+      }
+    }
+    if( allKeysHaveTheSameDigit )
+    {
+      continue;
+    }
+
+    /** Scatter the keys and indices to their positions. */
+    temp.m_Scatter = true;
+    PersistentThreadPool::GetInstance()->SingleMethodExecute(
+      numberOfChunks, RadixSortThreaderCallback, &temp );
+
+    std::swap( sourceKeys, destinationKeys );
+    std::swap( sourceIndices, destinationIndices );
+  }
+
+  /** Copy the result to the output, if the last pass did not end there. */
+  if( sourceIndices != order )
+  {
+    std::copy( sourceIndices, sourceIndices + size, order );
+  }
+
+} // end SortIndices()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelRadixSort_cxx
@@ -0,0 +1,67 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelRadixSort_h
+#define __itkParallelRadixSort_h
+
+#include "itkIntTypes.h"
+
+#include <cstdint>
+
+namespace itk
+{
+
+/** \class ParallelRadixSort
+ *
+ * \brief Sorts integer keys with a multi-threaded least significant digit
+ * radix sort.
+ *
+ * The keys are sorted one byte at a time. For each byte, the threads of the
+ * PersistentThreadPool count the digits in their chunk of the keys, and then
+ * scatter their chunk to the positions that follow from the counts of all
+ * chunks. Each pass is stable, so equal keys keep their order, and the
+ * result does not depend on the number of threads. Bytes that are equal
+ * for all keys are skipped.
+ *
+ * \ingroup ITKCommon
+ */
+
+class ParallelRadixSort
+{
+public:
+
+  /** The minimum number of keys per chunk. */
+  static const SizeValueType MinimumChunkSize = 16384;
+
+  /** Fill order with the permutation that sorts the keys in ascending order:
+   * keys[ order[ 0 ] ] <= keys[ order[ 1 ] ] <= ... Only the lowest
+   * numberOfKeyBits bits of the keys are compared. The keys are not modified.
+   */
+  static void SortIndices( const std::uint64_t * keys, const SizeValueType size,
+    const unsigned int numberOfKeyBits, SizeValueType * order );
+
+private:
+
+  ParallelRadixSort();                            // purposely not implemented
+  ParallelRadixSort( const ParallelRadixSort & ); // purposely not implemented
+  void operator=( const ParallelRadixSort & );    // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelRadixSort_h
@@ -0,0 +1,337 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelSparseMatrixAssembler_cxx
+#define __itkParallelSparseMatrixAssembler_cxx
+
+#include "itkParallelSparseMatrixAssembler.h"
+#include "itkPersistentThreadPool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace itk
+{
+
+namespace
+{
+
+/** The data passed to the threads by ParallelSparseMatrixAssembler::ParallelizeRanges(). */
+struct RangeThreaderParameterType
+{
+  const std::function< void ( SizeValueType, SizeValueType ) > * m_Functor;
+  SizeValueType                                                  m_Size;
+  SizeValueType                                                  m_RangeSize;
+};
+
+
+/** Call the functor for the range of a work unit. */
+ITK_THREAD_RETURN_TYPE
+RangeThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const RangeThreaderParameterType * temp
+    = static_cast< RangeThreaderParameterType * >( infoStruct->UserData );
+
+  const SizeValueType begin = std::min(
+    static_cast< SizeValueType >( infoStruct->WorkUnitID ) * temp->m_RangeSize, temp->m_Size );
+  const SizeValueType end = std::min( begin + temp->m_RangeSize, temp->m_Size );
+  if( begin < end )
+  {
+    ( *temp->m_Functor )( begin, end );
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end RangeThreaderCallback()
+
+
+} // end namespace
+
+
+/**
+ * ******************** Constructor ********************
+ */
+
+ParallelSparseMatrixAssembler
+::ParallelSparseMatrixAssembler()
+{
+  this->m_Rows    = 0;
+  this->m_Columns = 0;
+
+} // end Constructor
+
+
+/**
+ * ******************** Initialize ********************
+ */
+
+void
+ParallelSparseMatrixAssembler
+::Initialize( const unsigned int rows, const unsigned int columns,
+  const ThreadIdType numberOfWorkUnits )
+{
+  this->m_Rows    = rows;
+  this->m_Columns = columns;
+
+  /** Release the memory of a previous assembly. */
+  std::vector< BufferType >( std::max< ThreadIdType >( numberOfWorkUnits, 1 ) ).swap( this->m_Buffers );
+
+} // end Initialize()
+
+
+/**
+ * ******************** AddEntry ********************
+ */
+
+void
+ParallelSparseMatrixAssembler
+::AddEntry( const ThreadIdType workUnit, const unsigned int row,
+  const unsigned int column, const double value )
+{
+  BufferType & buffer = this->m_Buffers[ workUnit ];
+  buffer.m_Keys.push_back( MakeKey( row, column ) );
+  buffer.m_Values.push_back( value );
+
+  /** Compact when the new triplets outnumber the compacted entries, which
+   * keeps the total cost of the compactions O( n log n ).
+   */
+  if( buffer.m_Keys.size() >= std::max< SizeValueType >(
+    MinimumBufferSize, buffer.m_CompactedKeys.size() ) )
+  {
+    Compact( buffer );
+  }
+
+} // end AddEntry()
+
+
+/**
+ * ******************** GetNumberOfStoredEntries ********************
+ */
+
+SizeValueType
+ParallelSparseMatrixAssembler
+::GetNumberOfStoredEntries( void ) const
+{
+  SizeValueType numberOfEntries = 0;
+  for( const BufferType & buffer : this->m_Buffers )
+  {
+    numberOfEntries += buffer.m_Keys.size() + buffer.m_CompactedKeys.size();
+  }
+  return numberOfEntries;
+
+} // end GetNumberOfStoredEntries()
+
+
+/**
+ * ******************** Compact ********************
+ */
+
+void
+ParallelSparseMatrixAssembler
+::Compact( BufferType & buffer )
+{
+  const SizeValueType size = buffer.m_Keys.size();
+  if( size == 0 )
+  {
+    return;
+  }
+
+  /** Sort the new triplets, keeping equal keys in the order in which they
+   * were added, so that their sum does not depend on the compaction moments.
+   */
+  std::vector< SizeValueType > order( size );
+  for( SizeValueType i = 0; i < size; ++i )
+  {
+    order[ i ] = i;
+  }
+  const std::vector< std::uint64_t > & keys = buffer.m_Keys;
+  std::stable_sort( order.begin(), order.end(),
+    [&keys]( const SizeValueType a, const SizeValueType b )
+    {
+      return keys[ a ] < keys[ b ];
+    } );
+
+  /** Merge them with the compacted entries, summing equal keys. */
+  const std::vector< std::uint64_t > & oldKeys   = buffer.m_CompactedKeys;
+  const std::vector< double > &        oldValues = buffer.m_CompactedValues;
+  std::vector< std::uint64_t >         newKeys;
+  std::vector< double >                newValues;
+  newKeys.reserve( oldKeys.size() + size );
+  newValues.reserve( oldKeys.size() + size );
+
+  SizeValueType oldIndex = 0;
+  SizeValueType index    = 0;
+  while( oldIndex < oldKeys.size() || index < size )
+  {
+    std::uint64_t key;
+    double        value;
+    if( index == size || ( oldIndex < oldKeys.size() && oldKeys[ oldIndex ] <= keys[ order[ index ] ] ) )
+    {
+      key   = oldKeys[ oldIndex ];
+      value = oldValues[ oldIndex ];
+      ++oldIndex;
+    }
+    else
+    {
+      key   = keys[ order[ index ] ];
+      value = buffer.m_Values[ order[ index ] ];
+      ++index;
+    }
+
+    if( !newKeys.empty() && newKeys.back() == key )
+    {
+      newValues.back() += value;
+    }
+    else
+    {
+      newKeys.push_back( key );
+      newValues.push_back( value );
+    }
+  }
+
+  newKeys.swap( buffer.m_CompactedKeys );
+  newValues.swap( buffer.m_CompactedValues );
+  buffer.m_Keys.clear();
+  buffer.m_Values.clear();
+
+} // end Compact()
+
+
+/**
+ * ******************** AssembleRows ********************
+ */
+
+void
+ParallelSparseMatrixAssembler
+::AssembleRows( SparseMatrixType & matrix )
+{
+  typedef SparseMatrixType::row    RowType;
+  typedef SparseMatrixType::pair_t ElementType;
+
+  const ThreadIdType numberOfThreads
+    = PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads();
+
+  /** Compact the remaining triplets of all work units. */
+  std::vector< BufferType > & buffers = this->m_Buffers;
+  ParallelizeRanges( buffers.size(), buffers.size(),
+    [&buffers]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType b = begin; b < end; ++b )
+      {
+        Compact( buffers[ b ] );
+      }
+    } );
+
+  matrix.set_size( this->m_Rows, this->m_Columns );
+
+  /** Merge the rows. The rows differ in size, so use more ranges than
+   * threads, to balance the load.
+   */
+  ParallelizeRanges( this->m_Rows, 4 * static_cast< SizeValueType >( numberOfThreads ),
+    [&buffers, &matrix]( const SizeValueType begin, const SizeValueType end )
+    {
+      /** The position of the current row in each buffer. */
+      std::vector< SizeValueType > positions( buffers.size() );
+      for( SizeValueType b = 0; b < buffers.size(); ++b )
+      {
+        const std::vector< std::uint64_t > & keys = buffers[ b ].m_CompactedKeys;
+        positions[ b ] = std::lower_bound( keys.begin(), keys.end(),
+          MakeKey( static_cast< unsigned int >( begin ), 0 ) ) - keys.begin();
+      }
+
+      std::vector< std::pair< unsigned int, double > > entries;
+      for( SizeValueType r = begin; r < end; ++r )
+      {
+        /** Gather the entries of this row, in the order of the work units. */
+        const std::uint64_t nextRowKey = static_cast< std::uint64_t >( r + 1 ) << 32;
+        entries.clear();
+        for( SizeValueType b = 0; b < buffers.size(); ++b )
+        {
+          const std::vector< std::uint64_t > & keys   = buffers[ b ].m_CompactedKeys;
+          const std::vector< double > &        values = buffers[ b ].m_CompactedValues;
+          SizeValueType &                      p      = positions[ b ];
+          for( ; p < keys.size() && keys[ p ] < nextRowKey; ++p )
+          {
+            entries.push_back( std::make_pair(
+              static_cast< unsigned int >( keys[ p ] & 0xFFFFFFFFu ), values[ p ] ) );
+          }
+        }
+
+        /** Sort by column and sum the duplicates. */
+        std::stable_sort( entries.begin(), entries.end(),
+          []( const std::pair< unsigned int, double > & a, const std::pair< unsigned int, double > & b )
+          {
+            return a.first < b.first;
+          } );
+
+        RowType & rowVector = matrix.get_row( static_cast< unsigned int >( r ) );
+        rowVector.reserve( entries.size() );
+        for( SizeValueType i = 0; i < entries.size(); ++i )
+        {
+          if( !rowVector.empty() && rowVector.back().first == entries[ i ].first )
+          {
+            rowVector.back().second += entries[ i ].second;
+          }
+          else
+          {
+            rowVector.push_back( ElementType( entries[ i ].first, entries[ i ].second ) );
+          }
+        }
+      }
+    } );
+
+  /** Release the memory of the buffers. */
+  std::vector< BufferType >( buffers.size() ).swap( buffers );
+
+} // end AssembleRows()
+
+
+/**
+ * ******************** ParallelizeRanges ********************
+ */
+
+void
+ParallelSparseMatrixAssembler
+::ParallelizeRanges( const SizeValueType size, const SizeValueType numberOfRanges,
+  const std::function< void ( SizeValueType, SizeValueType ) > & functor )
+{
+  const SizeValueType numberOfWorkUnits = std::min( numberOfRanges, size );
+  if( numberOfWorkUnits <= 1 )
+  {
+    if( size > 0 )
+    {
+      functor( 0, size );
+    }
+    return;
+  }
+
+  RangeThreaderParameterType temp;
+  temp.m_Functor   = &functor;
+  temp.m_Size      = size;
+  temp.m_RangeSize = ( size + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    static_cast< ThreadIdType >( numberOfWorkUnits ), RangeThreaderCallback, &temp );
+
+} // end ParallelizeRanges()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelSparseMatrixAssembler_cxx
@@ -0,0 +1,225 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelSparseMatrixAssembler_h
+#define __itkParallelSparseMatrixAssembler_h
+
+#include "itkIntTypes.h"
+#include "vnl/vnl_sparse_matrix.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ParallelSparseMatrixAssembler
+ *
+ * \brief Assembles a sparse matrix from entries that are added by several
+ * work units at the same time.
+ *
+ * Each work unit adds its (row, column, value) triplets to its own buffer,
+ * so no locking is needed. When the buffer of new triplets grows larger than
+ * the compacted entries of the work unit, the triplets are sorted, the
+ * duplicates are summed and the result is merged with the compacted entries.
+ * The memory thus stays proportional to the number of distinct entries,
+ * instead of to the number of added triplets.
+ *
+ * AssembleRows() merges the buffers of all work units into the rows of a
+ * vnl_sparse_matrix, with the threads of the PersistentThreadPool, each
+ * thread handling a range of rows. The duplicates are summed in the order
+ * of the work units, so the result only depends on which entries were added
+ * by which work unit, not on the scheduling of the threads.
+ *
+ * CopyRowsToCompressedArrays() converts the rows of a vnl_sparse_matrix to
+ * the compressed row format in parallel. For a symmetric matrix of which
+ * the upper triangle is stored, this is the compressed column format of the
+ * lower triangle, as used by CHOLMOD.
+ *
+ * \ingroup ITKCommon
+ */
+
+class ParallelSparseMatrixAssembler
+{
+public:
+
+  /** The type of the assembled matrix. */
+  typedef vnl_sparse_matrix< double > SparseMatrixType;
+
+  /** The minimum number of new triplets of a work unit before they are
+   * compacted.
+   */
+  static const SizeValueType MinimumBufferSize = 1 << 20;
+
+  ParallelSparseMatrixAssembler();
+
+  /** Clear the buffers and set the matrix size and the number of work units. */
+  void Initialize( const unsigned int rows, const unsigned int columns,
+    const ThreadIdType numberOfWorkUnits );
+
+  /** Get the number of work units set by Initialize(). */
+  ThreadIdType GetNumberOfWorkUnits( void ) const
+  {
+    return static_cast< ThreadIdType >( this->m_Buffers.size() );
+  }
+
+  /** Add value to the entry ( row, column ). Each work unit may only be
+   * used by a single thread at a time.
+   */
+  void AddEntry( const ThreadIdType workUnit, const unsigned int row,
+    const unsigned int column, const double value );
+
+  /** Add the upper triangle of values * values^T, scaled by weight, to the
+   * rows and columns given by indices. The indices should be sorted in
+   * ascending order. Products whose magnitude is below threshold are skipped.
+   */
+  template< class TIndices, class TValues >
+  void AddUpperTriangularOuterProduct( const ThreadIdType workUnit,
+    const TIndices & indices, const TValues & values, const SizeValueType size,
+    const double weight, const double threshold );
+
+  /** Return the number of entries that are stored, compacted or not. */
+  SizeValueType GetNumberOfStoredEntries( void ) const;
+
+  /** Replace the contents of matrix by the sum of the added entries, and
+   * clear the buffers.
+   */
+  void AssembleRows( SparseMatrixType & matrix );
+
+  /** Fill pointers[ 0 .. rows ], indices and values with the rows of matrix,
+   * in compressed row format. The arrays should have the sizes rows + 1 and
+   * the number of nonzero entries of matrix.
+   */
+  template< class TIndex >
+  static void CopyRowsToCompressedArrays( const SparseMatrixType & matrix,
+    TIndex * pointers, TIndex * indices, double * values );
+
+private:
+
+  ParallelSparseMatrixAssembler( const ParallelSparseMatrixAssembler & ); // purposely not implemented
+  void operator=( const ParallelSparseMatrixAssembler & );                // purposely not implemented
+
+  /** The entries of a work unit, with the row and column packed in a key. */
+  struct BufferType
+  {
+    /** The new triplets, in the order in which they were added. */
+    std::vector< std::uint64_t > m_Keys;
+    std::vector< double >        m_Values;
+
+    /** The compacted entries, sorted by key, without duplicates. */
+    std::vector< std::uint64_t > m_CompactedKeys;
+    std::vector< double >        m_CompactedValues;
+  };
+
+  /** Sort the new triplets of a buffer, sum the duplicates and merge them
+   * with its compacted entries.
+   */
+  static void Compact( BufferType & buffer );
+
+  /** Call functor( begin, end ) for contiguous ranges of [0, size), in
+   * parallel, using at most numberOfRanges ranges.
+   */
+  static void ParallelizeRanges( const SizeValueType size, const SizeValueType numberOfRanges,
+    const std::function< void ( SizeValueType, SizeValueType ) > & functor );
+
+  static std::uint64_t MakeKey( const unsigned int row, const unsigned int column )
+  {
+    return ( static_cast< std::uint64_t >( row ) << 32 ) | static_cast< std::uint64_t >( column );
+  }
+
+
+  unsigned int              m_Rows;
+  unsigned int              m_Columns;
+  std::vector< BufferType > m_Buffers;
+
+};
+
+
+/**
+ * ******************** AddUpperTriangularOuterProduct ********************
+ */
+
+template< class TIndices, class TValues >
+void
+ParallelSparseMatrixAssembler
+::AddUpperTriangularOuterProduct( const ThreadIdType workUnit,
+  const TIndices & indices, const TValues & values, const SizeValueType size,
+  const double weight, const double threshold )
+{
+  for( SizeValueType i = 0; i < size; ++i )
+  {
+    const unsigned int row      = static_cast< unsigned int >( indices[ i ] );
+    const double       valueRow = weight * values[ i ];
+    for( SizeValueType j = i; j < size; ++j )
+    {
+      const double value = valueRow * values[ j ];
+      if( ( value < threshold ) && ( value > -threshold ) )
+      {
+        continue;
+      }
+      this->AddEntry( workUnit, row, static_cast< unsigned int >( indices[ j ] ), value );
+    }
+  }
+
+} // end AddUpperTriangularOuterProduct()
+
+
+/**
+ * ******************** CopyRowsToCompressedArrays ********************
+ */
+
+template< class TIndex >
+void
+ParallelSparseMatrixAssembler
+::CopyRowsToCompressedArrays( const SparseMatrixType & matrix,
+  TIndex * pointers, TIndex * indices, double * values )
+{
+  typedef SparseMatrixType::row RowType;
+
+  /** The offsets of the rows follow from a prefix sum of their sizes. */
+  const unsigned int rows = matrix.rows();
+  pointers[ 0 ] = 0;
+  for( unsigned int r = 0; r < rows; ++r )
+  {
+    pointers[ r + 1 ] = pointers[ r ]
+      + static_cast< TIndex >( matrix.get_row( r ).size() );
+  }
+
+  /** Copy the rows in parallel, in about one range per 64k entries. */
+  const SizeValueType numberOfEntries = static_cast< SizeValueType >( pointers[ rows ] );
+  ParallelizeRanges( rows, numberOfEntries / 65536 + 1,
+    [&matrix, pointers, indices, values]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType r = begin; r < end; ++r )
+      {
+        const RowType & rowVector = matrix.get_row( static_cast< unsigned int >( r ) );
+        TIndex          position  = pointers[ r ];
+        for( typename RowType::const_iterator it = rowVector.begin(); it != rowVector.end(); ++it, ++position )
+        {
+          indices[ position ] = static_cast< TIndex >( it->first );
+          values[ position ]  = it->second;
+        }
+      }
+    } );
+
+} // end CopyRowsToCompressedArrays()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelSparseMatrixAssembler_h
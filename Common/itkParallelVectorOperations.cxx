@@ -0,0 +1,198 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelVectorOperations_cxx
+#define __itkParallelVectorOperations_cxx
+
+#include "itkParallelVectorOperations.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/**
+ * ******************** GetNumberOfChunks ********************
+ */
+
+ThreadIdType
+ParallelVectorOperations
+::GetNumberOfChunks( const SizeValueType size )
+{
+  const SizeValueType maximumNumberOfChunks
+    = ( size + MinimumChunkSize - 1 ) / MinimumChunkSize;
+  return static_cast< ThreadIdType >( std::max< SizeValueType >( 1, std::min< SizeValueType >(
+    maximumNumberOfChunks, PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() ) ) );
+
+} // end GetNumberOfChunks()
+
+
+/**
+ * ******************** Axpy ********************
+ */
+
+void
+ParallelVectorOperations
+::Axpy( const double alpha, const double * x, double * y,
+  const SizeValueType size )
+{
+  ParallelizeRange( size, [alpha, x, y]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        y[ j ] += alpha * x[ j ];
+      }
+    } );
+
+} // end Axpy()
+
+
+/**
+ * ******************** ScaledAdd ********************
+ */
+
+void
+ParallelVectorOperations
+::ScaledAdd( const double * x, const double alpha, const double * y,
+  double * z, const SizeValueType size )
+{
+  ParallelizeRange( size, [x, alpha, y, z]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        z[ j ] = x[ j ] + alpha * y[ j ];
+      }
+    } );
+
+} // end ScaledAdd()
+
+
+/**
+ * ******************** Scale ********************
+ */
+
+void
+ParallelVectorOperations
+::Scale( const double alpha, double * x, const SizeValueType size )
+{
+  ParallelizeRange( size, [alpha, x]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        x[ j ] *= alpha;
+      }
+    } );
+
+} // end Scale()
+
+
+/**
+ * ******************** PreconditionedScaledAdd ********************
+ */
+
+void
+ParallelVectorOperations
+::PreconditionedScaledAdd( const double * x, const double alpha,
+  const double * p, const double * g, double * d, double * z,
+  const SizeValueType size )
+{
+  ParallelizeRange( size, [x, alpha, p, g, d, z]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        d[ j ] = p[ j ] * g[ j ];
+        z[ j ] = x[ j ] + alpha * d[ j ];
+      }
+    } );
+
+} // end PreconditionedScaledAdd()
+
+
+/**
+ * ******************** AdaGradScaledAdd ********************
+ */
+
+void
+ParallelVectorOperations
+::AdaGradScaledAdd( const double * x, const double alpha,
+  const double * g, const double epsilon, double * s, double * d, double * z,
+  const SizeValueType size )
+{
+  ParallelizeRange( size, [x, alpha, g, epsilon, s, d, z]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        s[ j ] += g[ j ] * g[ j ];
+        d[ j ]  = g[ j ] / std::sqrt( s[ j ] + epsilon );
+        z[ j ]  = x[ j ] + alpha * d[ j ];
+      }
+    } );
+
+} // end AdaGradScaledAdd()
+
+
+/**
+ * ******************** InnerProduct ********************
+ */
+
+double
+ParallelVectorOperations
+::InnerProduct( const double * x, const double * y, const SizeValueType size )
+{
+  return ParallelizeReduction( size, [x, y]( const SizeValueType begin, const SizeValueType end )
+    {
+      double sum = 0.0;
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        sum += x[ j ] * y[ j ];
+      }
+      return sum;
+    } );
+
+} // end InnerProduct()
+
+
+/**
+ * ******************** SquaredNorm ********************
+ */
+
+double
+ParallelVectorOperations
+::SquaredNorm( const double * x, const SizeValueType size )
+{
+  return InnerProduct( x, x, size );
+
+} // end SquaredNorm()
+
+
+/**
+ * ******************** Norm ********************
+ */
+
+double
+ParallelVectorOperations
+::Norm( const double * x, const SizeValueType size )
+{
+  return std::sqrt( SquaredNorm( x, size ) );
+
+} // end Norm()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelVectorOperations_cxx
@@ -0,0 +1,237 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelVectorOperations_h
+#define __itkParallelVectorOperations_h
+
+#include "itkIntTypes.h"
+#include "itkPersistentThreadPool.h"
+#include "itkProfiler.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ParallelVectorOperations
+ *
+ * \brief Element-wise operations on the parameter vectors of the optimizers.
+ *
+ * The optimizers update vectors of up to 10^7 parameters every iteration.
+ * The functions of this class split such vectors in contiguous chunks that
+ * are processed by the threads of the PersistentThreadPool. The loop over a
+ * chunk is simple enough for the compiler to vectorize. Vectors that are too
+ * small to benefit from multi-threading are processed by the calling thread.
+ *
+ * The input and output arrays may be identical, but may not partially
+ * overlap. The reductions sum the partial results of the chunks in a fixed
+ * order, so their result does not depend on the scheduling of the threads.
+ *
+ * ParallelizeRange() and ParallelizeReduction() split a loop in the same
+ * chunks, so that other components can write fused kernels, which do more
+ * work per pass over their vectors.
+ *
+ * \ingroup Optimizers
+ */
+
+class ParallelVectorOperations
+{
+public:
+
+  /** The minimum number of elements per chunk. */
+  static const SizeValueType MinimumChunkSize = 16384;
+
+  /** y = y + alpha * x. */
+  static void Axpy( const double alpha, const double * x, double * y,
+    const SizeValueType size );
+
+  /** z = x + alpha * y. */
+  static void ScaledAdd( const double * x, const double alpha, const double * y,
+    double * z, const SizeValueType size );
+
+  /** x = alpha * x. */
+  static void Scale( const double alpha, double * x, const SizeValueType size );
+
+  /** d = p * g and z = x + alpha * d, with element-wise multiplication. */
+  static void PreconditionedScaledAdd( const double * x, const double alpha,
+    const double * p, const double * g, double * d, double * z,
+    const SizeValueType size );
+
+  /** The AdaGrad update: s = s + g * g, d = g / sqrt( s + epsilon ) and
+   * z = x + alpha * d, with element-wise operations.
+   */
+  static void AdaGradScaledAdd( const double * x, const double alpha,
+    const double * g, const double epsilon, double * s, double * d, double * z,
+    const SizeValueType size );
+
+  /** Return the inner product of x and y. */
+  static double InnerProduct( const double * x, const double * y,
+    const SizeValueType size );
+
+  /** Return the squared Euclidean norm of x. */
+  static double SquaredNorm( const double * x, const SizeValueType size );
+
+  /** Return the Euclidean norm of x. */
+  static double Norm( const double * x, const SizeValueType size );
+
+  /** Call functor( begin, end ) for the chunks of [0, size). */
+  template< class TFunctor >
+  static void ParallelizeRange( const SizeValueType size, const TFunctor & functor );
+
+  /** Return the sum of the values returned by functor( begin, end ) for the
+   * chunks of [0, size), summed in a fixed order.
+   */
+  template< class TFunctor >
+  static double ParallelizeReduction( const SizeValueType size, const TFunctor & functor );
+
+private:
+
+  ParallelVectorOperations();                                   // purposely not implemented
+  ParallelVectorOperations( const ParallelVectorOperations & ); // purposely not implemented
+  void operator=( const ParallelVectorOperations & );           // purposely not implemented
+
+  /** The data passed to the threads by ParallelizeChunks(). */
+  template< class TFunctor >
+  struct ChunkThreaderParameterType
+  {
+    const TFunctor * m_Functor;
+    SizeValueType    m_Size;
+    SizeValueType    m_ChunkSize;
+  };
+
+  /** Call functor( chunk, begin, end ) for the chunk of a work unit. */
+  template< class TFunctor >
+  static ITK_THREAD_RETURN_TYPE ChunkThreaderCallback( void * arg );
+
+  /** Return the number of chunks used for a vector of the given size. */
+  static ThreadIdType GetNumberOfChunks( const SizeValueType size );
+
+  /** Split [0, size) in numberOfChunks chunks and call functor( chunk, begin, end )
+   * for each of them, using the persistent thread pool.
+   */
+  template< class TFunctor >
+  static void ParallelizeChunks( const SizeValueType size, const ThreadIdType numberOfChunks,
+    const TFunctor & functor );
+
+};
+
+
+/**
+ * ******************** ChunkThreaderCallback ********************
+ */
+
+template< class TFunctor >
+ITK_THREAD_RETURN_TYPE
+ParallelVectorOperations
+::ChunkThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const ChunkThreaderParameterType< TFunctor > * temp
+    = static_cast< ChunkThreaderParameterType< TFunctor > * >( infoStruct->UserData );
+
+  const ThreadIdType  chunk = infoStruct->WorkUnitID;
+  const SizeValueType begin = std::min( chunk * temp->m_ChunkSize, temp->m_Size );
+  const SizeValueType end   = std::min( begin + temp->m_ChunkSize, temp->m_Size );
+  ( *temp->m_Functor )( chunk, begin, end );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end ChunkThreaderCallback()
+
+
+/**
+ * ******************** ParallelizeChunks ********************
+ */
+
+template< class TFunctor >
+void
+ParallelVectorOperations
+::ParallelizeChunks( const SizeValueType size, const ThreadIdType numberOfChunks,
+  const TFunctor & functor )
+{
+  Profiler::ScopedTimer timer( Profiler::OptimizerUpdate );
+
+  if( numberOfChunks <= 1 )
+  {
+    functor( 0, 0, size );
+    return;
+  }
+
+  /** Round the chunks up to a multiple of 8 to keep them aligned. */
+  ChunkThreaderParameterType< TFunctor > temp;
+  temp.m_Functor   = &functor;
+  temp.m_Size      = size;
+  temp.m_ChunkSize = ( ( size + numberOfChunks - 1 ) / numberOfChunks + 7 ) / 8 * 8;
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    numberOfChunks, ChunkThreaderCallback< TFunctor >, &temp );
+
+} // end ParallelizeChunks()
+
+
+/**
+ * ******************** ParallelizeReduction ********************
+ */
+
+template< class TFunctor >
+double
+ParallelVectorOperations
+::ParallelizeReduction( const SizeValueType size, const TFunctor & functor )
+{
+  const ThreadIdType    numberOfChunks = GetNumberOfChunks( size );
+  std::vector< double > partialSums( numberOfChunks, 0.0 );
+
+  ParallelizeChunks( size, numberOfChunks,
+    [&functor, &partialSums]( const ThreadIdType chunk, const SizeValueType begin, const SizeValueType end )
+    {
+      partialSums[ chunk ] = functor( begin, end );
+    } );
+
+  /** Sum in a fixed order, to be independent of the scheduling. */
+  double sum = 0.0;
+  for( const double partialSum : partialSums )
+  {
+    sum += partialSum;
+  }
+  return sum;
+
+} // end ParallelizeReduction()
+
+
+/**
+ * ******************** ParallelizeRange ********************
+ */
+
+template< class TFunctor >
+void
+ParallelVectorOperations
+::ParallelizeRange( const SizeValueType size, const TFunctor & functor )
+{
+  ParallelizeChunks( size, GetNumberOfChunks( size ),
+    [&functor]( const ThreadIdType, const SizeValueType begin, const SizeValueType end )
+    {
+      functor( begin, end );
+    } );
+
+} // end ParallelizeRange()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelVectorOperations_h
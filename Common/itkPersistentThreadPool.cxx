@@ -0,0 +1,523 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkPersistentThreadPool_cxx
+#define __itkPersistentThreadPool_cxx
+
+#include "itkPersistentThreadPool.h"
+#include "itkNUMATopology.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+namespace
+{
+
+/** Whether the current thread is executing a work unit of the pool. */
+thread_local bool insideWorkUnit = false;
+
+} // end namespace
+
+/**
+ * ****************** Constructor *********************************
+ */
+
+PersistentThreadPool
+::PersistentThreadPool()
+{
+  this->m_MaximumNumberOfThreads   = std::max( std::thread::hardware_concurrency(), 1u );
+  this->m_NUMAPlacement            = false;
+  this->m_NumberOfJobs             = 0;
+  this->m_NumberOfRequestedHelpers = 0;
+  this->m_Stop                     = false;
+
+} // end Constructor
+
+
+/**
+ * ****************** Destructor *********************************
+ */
+
+PersistentThreadPool
+::~PersistentThreadPool()
+{
+  this->StopThreads();
+
+} // end Destructor
+
+
+/**
+ * ****************** GetInstance *********************************
+ */
+
+PersistentThreadPool::Pointer
+PersistentThreadPool
+::GetInstance( void )
+{
+  /** The initialization of a local static is thread-safe. */
+  static const Pointer instance = []()
+    {
+      Pointer pool = new Self;
+      pool->UnRegister();
+      return pool;
+    }();
+  return instance;
+
+} // end GetInstance()
+
+
+/**
+ * ****************** SetMaximumNumberOfThreads *********************************
+ */
+
+void
+PersistentThreadPool
+::SetMaximumNumberOfThreads( ThreadIdType numberOfThreads )
+{
+  std::lock_guard< std::mutex > lock( this->m_ExecuteMutex );
+  numberOfThreads = std::max( numberOfThreads, ThreadIdType( 1 ) );
+  if( this->m_MaximumNumberOfThreads != numberOfThreads )
+  {
+    this->m_MaximumNumberOfThreads = numberOfThreads;
+    this->Modified();
+  }
+
+} // end SetMaximumNumberOfThreads()
+
+
+/**
+ * ****************** GetMaximumNumberOfThreads *********************************
+ */
+
+ThreadIdType
+PersistentThreadPool
+::GetMaximumNumberOfThreads( void ) const
+{
+  return this->m_MaximumNumberOfThreads;
+
+} // end GetMaximumNumberOfThreads()
+
+
+/**
+ * ****************** SetNUMAPlacement *********************************
+ */
+
+void
+PersistentThreadPool
+::SetNUMAPlacement( const bool placement )
+{
+  std::lock_guard< std::mutex > lock( this->m_ExecuteMutex );
+  if( this->m_NUMAPlacement != placement )
+  {
+    /** The threads are pinned when they start, so wait for the running calls
+     * before stopping them.
+     */
+    {
+      std::unique_lock< std::mutex > lock( this->m_Mutex );
+      this->m_FinishedCondition.wait( lock, [this]()
+        {
+          return this->m_Jobs.empty();
+        } );
+    }
+    this->StopThreads();
+    this->m_NUMAPlacement = placement;
+    this->Modified();
+  }
+
+} // end SetNUMAPlacement()
+
+
+/**
+ * ****************** GetNUMAPlacement *********************************
+ */
+
+bool
+PersistentThreadPool
+::GetNUMAPlacement( void ) const
+{
+  return this->m_NUMAPlacement;
+
+} // end GetNUMAPlacement()
+
+
+/**
+ * ****************** GetNUMANodeOfWorkUnit *********************************
+ */
+
+unsigned int
+PersistentThreadPool
+::GetNUMANodeOfWorkUnit( const ThreadIdType workUnit,
+  const ThreadIdType numberOfWorkUnits ) const
+{
+  if( !this->AssignsWorkUnitsToThreads( numberOfWorkUnits ) )
+  {
+    return 0;
+  }
+  return workUnit % NUMATopology::GetNumberOfNodes();
+
+} // end GetNUMANodeOfWorkUnit()
+
+
+/**
+ * ****************** AssignsWorkUnitsToThreads *********************************
+ */
+
+bool
+PersistentThreadPool
+::AssignsWorkUnitsToThreads( const ThreadIdType numberOfWorkUnits ) const
+{
+  return this->m_NUMAPlacement && NUMATopology::GetNumberOfNodes() > 1
+         && numberOfWorkUnits > 1 && numberOfWorkUnits <= this->m_MaximumNumberOfThreads;
+
+} // end AssignsWorkUnitsToThreads()
+
+
+/**
+ * ****************** SingleMethodExecute *********************************
+ */
+
+void
+PersistentThreadPool
+::SingleMethodExecute( const ThreadIdType numberOfWorkUnits,
+  ThreadFunctionType function, void * userData )
+{
+  if( numberOfWorkUnits == 0 )
+  {
+    return;
+  }
+
+  auto job = std::make_shared< JobType >();
+  job->m_Function                  = function;
+  job->m_UserData                  = userData;
+  job->m_NumberOfWorkUnits         = numberOfWorkUnits;
+  job->m_NextWorkUnit              = 0;
+  job->m_AssignedToThreads         = false;
+  job->m_NumberOfHelpers           = 0;
+  job->m_MaximumNumberOfHelpers    = 0;
+  job->m_NumberOfFinishedWorkUnits = 0;
+
+  /** Nested calls and calls that cannot be shared are executed serially. */
+  if( insideWorkUnit || numberOfWorkUnits == 1 || this->m_MaximumNumberOfThreads <= 1 )
+  {
+    this->ExecuteWorkUnits( *job, false, 0 );
+    if( job->m_Exception )
+    {
+      std::rethrow_exception( job->m_Exception );
+    }
+    return;
+  }
+
+  {
+    std::lock_guard< std::mutex > executeLock( this->m_ExecuteMutex );
+
+    /** The calling thread executes work units as well, unless they are
+     * assigned to the threads of the pool. Concurrent calls share the threads,
+     * so only a call that has the pool to itself assigns them.
+     */
+    ThreadIdType numberOfThreads = 0;
+    {
+      std::lock_guard< std::mutex > lock( this->m_Mutex );
+      job->m_AssignedToThreads = this->m_Jobs.empty()
+        && this->AssignsWorkUnitsToThreads( numberOfWorkUnits );
+      if( job->m_AssignedToThreads )
+      {
+        job->m_WorkUnitTaken.assign( numberOfWorkUnits, false );
+        job->m_MaximumNumberOfHelpers = numberOfWorkUnits;
+        numberOfThreads               = numberOfWorkUnits;
+      }
+      else
+      {
+        job->m_MaximumNumberOfHelpers
+          = std::min( numberOfWorkUnits, this->m_MaximumNumberOfThreads ) - 1;
+      }
+      this->m_NumberOfRequestedHelpers += job->m_MaximumNumberOfHelpers;
+      numberOfThreads = std::max( numberOfThreads,
+        std::min( this->m_NumberOfRequestedHelpers, this->m_MaximumNumberOfThreads - 1 ) );
+
+      this->m_Jobs.push_back( job );
+      this->m_NumberOfJobs = this->m_Jobs.size();
+    }
+    this->StartThreads( numberOfThreads );
+  }
+  this->m_JobCondition.notify_all();
+
+  this->ExecuteWorkUnits( *job, false, 0 );
+
+  {
+    std::unique_lock< std::mutex > lock( this->m_Mutex );
+    this->m_FinishedCondition.wait( lock, [&job]()
+      {
+        return job->m_NumberOfFinishedWorkUnits == job->m_NumberOfWorkUnits;
+      } );
+    this->m_Jobs.erase( std::find( this->m_Jobs.begin(), this->m_Jobs.end(), job ) );
+    this->m_NumberOfJobs              = this->m_Jobs.size();
+    this->m_NumberOfRequestedHelpers -= job->m_MaximumNumberOfHelpers;
+  }
+  this->m_FinishedCondition.notify_all();
+
+  if( job->m_Exception )
+  {
+    std::rethrow_exception( job->m_Exception );
+  }
+
+} // end SingleMethodExecute()
+
+
+/**
+ * ****************** ExecuteWorkUnits *********************************
+ */
+
+void
+PersistentThreadPool
+::ExecuteWorkUnits( JobType & job, const bool isPoolThread, const ThreadIdType threadIndex )
+{
+  const bool wasInsideWorkUnit = insideWorkUnit;
+  insideWorkUnit = true;
+
+  ThreadIdType numberOfFinishedWorkUnits = 0;
+  while( true )
+  {
+    ThreadIdType workUnit = threadIndex;
+    if( job.m_AssignedToThreads )
+    {
+      if( !isPoolThread || threadIndex >= job.m_NumberOfWorkUnits || numberOfFinishedWorkUnits > 0 )
+      {
+        break;
+      }
+    }
+    else
+    {
+      /** A helper moves to another call after a work unit, if that call has
+       * fewer helpers.
+       */
+      if( isPoolThread && numberOfFinishedWorkUnits > 0 && this->ShouldLeaveJob( job ) )
+      {
+        break;
+      }
+      workUnit = job.m_NextWorkUnit++;
+      if( workUnit >= job.m_NumberOfWorkUnits )
+      {
+        break;
+      }
+    }
+
+    WorkUnitInfo info = WorkUnitInfo();
+    info.WorkUnitID        = workUnit;
+    info.NumberOfWorkUnits = job.m_NumberOfWorkUnits;
+    info.UserData          = job.m_UserData;
+    info.ThreadFunction    = job.m_Function;
+
+    try
+    {
+      job.m_Function( &info );
+    }
+    catch( ... )
+    {
+      std::lock_guard< std::mutex > lock( this->m_Mutex );
+      if( !job.m_Exception )
+      {
+        job.m_Exception = std::current_exception();
+      }
+    }
+    ++numberOfFinishedWorkUnits;
+  }
+
+  insideWorkUnit = wasInsideWorkUnit;
+
+  bool finished = false;
+  {
+    std::lock_guard< std::mutex > lock( this->m_Mutex );
+    if( isPoolThread && !job.m_AssignedToThreads )
+    {
+      --job.m_NumberOfHelpers;
+    }
+    job.m_NumberOfFinishedWorkUnits += numberOfFinishedWorkUnits;
+    finished = numberOfFinishedWorkUnits > 0
+      && job.m_NumberOfFinishedWorkUnits == job.m_NumberOfWorkUnits;
+  }
+  if( finished )
+  {
+    this->m_FinishedCondition.notify_all();
+  }
+
+} // end ExecuteWorkUnits()
+
+
+/**
+ * ****************** ThreadExecute *********************************
+ */
+
+void
+PersistentThreadPool
+::ThreadExecute( const ThreadIdType threadIndex )
+{
+  if( this->m_NUMAPlacement )
+  {
+    NUMATopology::BindCurrentThreadToNode( threadIndex % NUMATopology::GetNumberOfNodes() );
+  }
+
+  while( true )
+  {
+    std::shared_ptr< JobType > job;
+    {
+      std::unique_lock< std::mutex > lock( this->m_Mutex );
+      while( !this->m_Stop && !( job = this->SelectJob( threadIndex ) ) )
+      {
+        this->m_JobCondition.wait( lock );
+      }
+      if( this->m_Stop )
+      {
+        return;
+      }
+    }
+    this->ExecuteWorkUnits( *job, true, threadIndex );
+  }
+
+} // end ThreadExecute()
+
+
+/**
+ * ****************** SelectJob *********************************
+ */
+
+std::shared_ptr< PersistentThreadPool::JobType >
+PersistentThreadPool
+::SelectJob( const ThreadIdType threadIndex )
+{
+  /** The work unit that is assigned to this thread goes first. */
+  std::shared_ptr< JobType > selected;
+  for( const std::shared_ptr< JobType > & job : this->m_Jobs )
+  {
+    if( job->m_AssignedToThreads )
+    {
+      if( threadIndex < job->m_NumberOfWorkUnits && !job->m_WorkUnitTaken[ threadIndex ] )
+      {
+        job->m_WorkUnitTaken[ threadIndex ] = true;
+        return job;
+      }
+    }
+    else if( job->m_NextWorkUnit < job->m_NumberOfWorkUnits
+      && job->m_NumberOfHelpers < job->m_MaximumNumberOfHelpers
+      && ( !selected || job->m_NumberOfHelpers < selected->m_NumberOfHelpers ) )
+    {
+      selected = job;
+    }
+  }
+
+  /** Otherwise help the call with the fewest helpers. */
+  if( selected )
+  {
+    ++selected->m_NumberOfHelpers;
+  }
+  return selected;
+
+} // end SelectJob()
+
+
+/**
+ * ****************** ShouldLeaveJob *********************************
+ */
+
+bool
+PersistentThreadPool
+::ShouldLeaveJob( const JobType & job )
+{
+  if( this->m_NumberOfJobs <= 1 )
+  {
+    return false;
+  }
+
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  for( const std::shared_ptr< JobType > & other : this->m_Jobs )
+  {
+    if( other.get() != &job && !other->m_AssignedToThreads
+      && other->m_NextWorkUnit < other->m_NumberOfWorkUnits
+      && other->m_NumberOfHelpers < other->m_MaximumNumberOfHelpers
+      && other->m_NumberOfHelpers + 1 < job.m_NumberOfHelpers )
+    {
+      return true;
+    }
+  }
+  return false;
+
+} // end ShouldLeaveJob()
+
+
+/**
+ * ****************** StartThreads *********************************
+ */
+
+void
+PersistentThreadPool
+::StartThreads( const ThreadIdType numberOfThreads )
+{
+  while( this->m_Threads.size() < numberOfThreads )
+  {
+    const ThreadIdType threadIndex = static_cast< ThreadIdType >( this->m_Threads.size() );
+    this->m_Threads.emplace_back( &Self::ThreadExecute, this, threadIndex );
+  }
+
+} // end StartThreads()
+
+
+/**
+ * ****************** StopThreads *********************************
+ */
+
+void
+PersistentThreadPool
+::StopThreads( void )
+{
+  {
+    std::lock_guard< std::mutex > lock( this->m_Mutex );
+    this->m_Stop = true;
+  }
+  this->m_JobCondition.notify_all();
+  for( std::thread & thread : this->m_Threads )
+  {
+    thread.join();
+  }
+  this->m_Threads.clear();
+
+  std::lock_guard< std::mutex > lock( this->m_Mutex );
+  this->m_Stop = false;
+
+} // end StopThreads()
+
+
+/**
+ * ****************** PrintSelf *********************************
+ */
+
+void
+PersistentThreadPool
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "MaximumNumberOfThreads: " << this->m_MaximumNumberOfThreads << std::endl;
+  os << indent << "NUMAPlacement: " << ( this->m_NUMAPlacement ? "true" : "false" ) << std::endl;
+  os << indent << "NumberOfStartedThreads: " << this->m_Threads.size() << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkPersistentThreadPool_cxx
@@ -0,0 +1,201 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkPersistentThreadPool_h
+#define __itkPersistentThreadPool_h
+
+#include "itkObject.h"
+#include "itkMultiThreaderBase.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace itk
+{
+
+/** \class PersistentThreadPool
+ *
+ * \brief A pool of threads that stay alive between calls, to execute the
+ * work units of a single method.
+ *
+ * The PlatformMultiThreader creates and joins its threads at every call of
+ * SingleMethodExecute(). The metrics, samplers and optimizers call it every
+ * iteration, and for small numbers of samples the creation of the threads
+ * costs as much as the work itself. This pool is shared by these components
+ * and keeps its threads waiting for the next call instead.
+ *
+ * The work units of a call are claimed one by one by the threads of the pool
+ * and the calling thread. When more work units than threads are used, the
+ * threads that finish early take over the remaining work units, which
+ * balances the load. The result of a work unit does not depend on the thread
+ * that executes it.
+ *
+ * The functions and the WorkUnitInfo passed to them are identical to those of
+ * the PlatformMultiThreader, so its callbacks can be used unchanged. A call
+ * from within a work unit executes its work units serially.
+ *
+ * Calls from several threads at once, for example of concurrent
+ * registrations, share the threads of the pool. A thread of the pool helps
+ * the call with the fewest helping threads, and moves to another call after
+ * a work unit if that call has at least two helpers fewer. A call is helped
+ * by at most one thread less than its number of work units, and than the
+ * maximum number of threads.
+ *
+ * With NUMA placement, thread i of the pool is pinned to the NUMA node
+ * i modulo the number of nodes, see NUMATopology. A call with at most as
+ * many work units as threads, made while no other call uses the pool, then
+ * executes work unit i on thread i, while the calling thread waits. A work
+ * unit is thus always executed on the same node, so the memory that it
+ * touches first stays local to its thread.
+ *
+ * \ingroup ITKCommon
+ */
+
+class PersistentThreadPool : public Object
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef PersistentThreadPool       Self;
+  typedef Object                     Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( PersistentThreadPool, Object );
+
+  /** Typedefs of the callbacks, identical to the ones of the multi-threaders. */
+  typedef MultiThreaderBase::WorkUnitInfo       WorkUnitInfo;
+  typedef MultiThreaderBase::ThreadFunctionType ThreadFunctionType;
+
+  /** Get the pool that is shared by all components. */
+  static Pointer GetInstance( void );
+
+  /** Set/Get the maximum number of threads used for a call, including the
+   * calling thread. The default is the number of hardware threads.
+   */
+  void SetMaximumNumberOfThreads( ThreadIdType numberOfThreads );
+
+  ThreadIdType GetMaximumNumberOfThreads( void ) const;
+
+  /** Set/Get whether the threads are pinned to the NUMA nodes, and the work
+   * units are assigned to the threads. The threads that were started before
+   * are restarted. The default is false.
+   */
+  void SetNUMAPlacement( const bool placement );
+
+  bool GetNUMAPlacement( void ) const;
+
+  /** Get the NUMA node on which a work unit of a call with numberOfWorkUnits
+   * work units is executed. Returns 0 if the node is not fixed, that is
+   * without NUMA placement, on a single node, or for more work units than
+   * threads. Nor is it fixed for a call made while another call uses the
+   * pool.
+   */
+  unsigned int GetNUMANodeOfWorkUnit( const ThreadIdType workUnit,
+    const ThreadIdType numberOfWorkUnits ) const;
+
+  /** Execute function( WorkUnitInfo * ) for the work units 0 to
+   * numberOfWorkUnits - 1, and wait until all of them are finished. The
+   * first exception thrown by a work unit is rethrown afterwards.
+   */
+  void SingleMethodExecute( const ThreadIdType numberOfWorkUnits,
+    ThreadFunctionType function, void * userData );
+
+protected:
+
+  PersistentThreadPool();
+  ~PersistentThreadPool() override;
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  PersistentThreadPool( const Self & ); // purposely not implemented
+  void operator=( const Self & );       // purposely not implemented
+
+  /** The state of one call of SingleMethodExecute(). */
+  struct JobType
+  {
+    ThreadFunctionType          m_Function;
+    void *                      m_UserData;
+    ThreadIdType                m_NumberOfWorkUnits;
+    std::atomic< ThreadIdType > m_NextWorkUnit;
+    bool                        m_AssignedToThreads;
+    std::vector< bool >         m_WorkUnitTaken;
+    ThreadIdType                m_NumberOfHelpers;
+    ThreadIdType                m_MaximumNumberOfHelpers;
+    ThreadIdType                m_NumberOfFinishedWorkUnits;
+    std::exception_ptr          m_Exception;
+  };
+
+  /** Claim and execute work units of the job until none are left. If the
+   * work units are assigned to the threads, execute only the work unit of the
+   * given thread of the pool instead, or none for the calling thread.
+   */
+  void ExecuteWorkUnits( JobType & job, const bool isPoolThread, const ThreadIdType threadIndex );
+
+  /** The loop of each thread of the pool. */
+  void ThreadExecute( const ThreadIdType threadIndex );
+
+  /** Select the job that the given thread of the pool helps next, or none.
+   * Must be called with m_Mutex locked.
+   */
+  std::shared_ptr< JobType > SelectJob( const ThreadIdType threadIndex );
+
+  /** Whether a thread of the pool that helps the job should help another
+   * job instead, which has at least two helpers fewer.
+   */
+  bool ShouldLeaveJob( const JobType & job );
+
+  /** Start threads until the pool has numberOfThreads threads. */
+  void StartThreads( const ThreadIdType numberOfThreads );
+
+  /** Stop and join all threads of the pool. */
+  void StopThreads( void );
+
+  /** Whether the work units of a call are assigned to the threads. */
+  bool AssignsWorkUnitsToThreads( const ThreadIdType numberOfWorkUnits ) const;
+
+  ThreadIdType               m_MaximumNumberOfThreads;
+  bool                       m_NUMAPlacement;
+  std::vector< std::thread > m_Threads;
+
+  /** Held while the threads are started or stopped. */
+  std::mutex m_ExecuteMutex;
+
+  /** The number of jobs in m_Jobs, to be read without locking m_Mutex. */
+  std::atomic< std::size_t > m_NumberOfJobs;
+
+  /** Protects the members below. */
+  std::mutex                                m_Mutex;
+  std::condition_variable                   m_JobCondition;
+  std::condition_variable                   m_FinishedCondition;
+  std::vector< std::shared_ptr< JobType > > m_Jobs;
+  ThreadIdType                              m_NumberOfRequestedHelpers;
+  bool                                      m_Stop;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkPersistentThreadPool_h
@@ -0,0 +1,195 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkPhiloxRandomGenerator_h
+#define __itkPhiloxRandomGenerator_h
+
+#include "itkIntTypes.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace itk
+{
+
+/** \class PhiloxRandomGenerator
+ *
+ * \brief The counter-based random number generator Philox4x32-10.
+ *
+ * The random numbers are a function of a key, a stream and the index of the
+ * number within the stream, instead of the state of a sequential generator.
+ * Any thread can therefore draw any element of any stream, and the numbers
+ * do not depend on the number of threads or on the order in which they are
+ * drawn. The key is typically drawn once from a seeded sequential
+ * generator, the stream identifies the iteration or the update, and the
+ * index the sample or parameter.
+ *
+ * This is the Philox4x32 generator with 10 rounds of J. K. Salmon et al.,
+ * "Parallel random numbers: as easy as 1, 2, 3", SC'11. Each counter yields
+ * two uniform or normal variates in double precision.
+ *
+ * \ingroup ITKCommon
+ */
+
+class PhiloxRandomGenerator
+{
+public:
+
+  typedef std::uint32_t WordType;
+  typedef std::uint64_t KeyType;
+
+  /** Compute the four output words of the 128-bit counter with the 64-bit key. */
+  static void Generate( const WordType counter[ 4 ], const WordType key[ 2 ], WordType output[ 4 ] )
+  {
+    WordType c0 = counter[ 0 ];
+    WordType c1 = counter[ 1 ];
+    WordType c2 = counter[ 2 ];
+    WordType c3 = counter[ 3 ];
+    WordType k0 = key[ 0 ];
+    WordType k1 = key[ 1 ];
+    for( unsigned int round = 0; round < 10; ++round )
+    {
+      const std::uint64_t product0 = static_cast< std::uint64_t >( 0xD2511F53u ) * c0;
+      const std::uint64_t product1 = static_cast< std::uint64_t >( 0xCD9E8D57u ) * c2;
+      c0  = static_cast< WordType >( product1 >> 32 ) ^ c1 ^ k0;
+      c2  = static_cast< WordType >( product0 >> 32 ) ^ c3 ^ k1;
+      c1  = static_cast< WordType >( product1 );
+      c3  = static_cast< WordType >( product0 );
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+    output[ 0 ] = c0;
+    output[ 1 ] = c1;
+    output[ 2 ] = c2;
+    output[ 3 ] = c3;
+  }
+
+
+  /** Compute the variates 2 i and 2 i + 1 of a stream, uniform in [0, 1). */
+  static void GetUniformVariates( const KeyType key, const std::uint64_t stream,
+    const std::uint64_t i, double uniforms[ 2 ] )
+  {
+    const WordType counter[ 4 ] = {
+      static_cast< WordType >( i ), static_cast< WordType >( i >> 32 ),
+      static_cast< WordType >( stream ), static_cast< WordType >( stream >> 32 )
+    };
+    const WordType keyWords[ 2 ] = {
+      static_cast< WordType >( key ), static_cast< WordType >( key >> 32 )
+    };
+    WordType output[ 4 ];
+    Generate( counter, keyWords, output );
+    uniforms[ 0 ] = ToUniform( output[ 0 ], output[ 1 ] );
+    uniforms[ 1 ] = ToUniform( output[ 2 ], output[ 3 ] );
+  }
+
+
+  /** Return the variate with the given index of a stream, uniform in [0, 1). */
+  static double GetUniformVariate( const KeyType key, const std::uint64_t stream,
+    const std::uint64_t index )
+  {
+    double uniforms[ 2 ];
+    GetUniformVariates( key, stream, index >> 1, uniforms );
+    return uniforms[ index & 1 ];
+  }
+
+
+  /** Compute the variates 2 i and 2 i + 1 of a stream, from the standard
+   * normal distribution, by the Box-Muller transform of the uniform variates.
+   */
+  static void GetNormalVariates( const KeyType key, const std::uint64_t stream,
+    const std::uint64_t i, double normals[ 2 ] )
+  {
+    double uniforms[ 2 ];
+    GetUniformVariates( key, stream, i, uniforms );
+    const double radius = std::sqrt( -2.0 * std::log( 1.0 - uniforms[ 0 ] ) );
+    const double angle  = 6.283185307179586476925 * uniforms[ 1 ];
+    normals[ 0 ] = radius * std::cos( angle );
+    normals[ 1 ] = radius * std::sin( angle );
+  }
+
+
+  /** Return the variate with the given index of a stream, from the standard
+   * normal distribution.
+   */
+  static double GetNormalVariate( const KeyType key, const std::uint64_t stream,
+    const std::uint64_t index )
+  {
+    double normals[ 2 ];
+    GetNormalVariates( key, stream, index >> 1, normals );
+    return normals[ index & 1 ];
+  }
+
+
+  /** Fill an array with the n uniform variates of a stream from firstIndex on. */
+  static void FillUniformVariates( const KeyType key, const std::uint64_t stream,
+    const std::uint64_t firstIndex, const SizeValueType n, double * uniforms )
+  {
+    SizeValueType k = 0;
+    if( n > 0 && ( firstIndex & 1 ) )
+    {
+      uniforms[ k++ ] = GetUniformVariate( key, stream, firstIndex );
+    }
+    for( ; k + 2 <= n; k += 2 )
+    {
+      GetUniformVariates( key, stream, ( firstIndex + k ) >> 1, uniforms + k );
+    }
+    if( k < n )
+    {
+      uniforms[ k ] = GetUniformVariate( key, stream, firstIndex + k );
+    }
+  }
+
+
+  /** Fill an array with the n normal variates of a stream from firstIndex on. */
+  static void FillNormalVariates( const KeyType key, const std::uint64_t stream,
+    const std::uint64_t firstIndex, const SizeValueType n, double * normals )
+  {
+    SizeValueType k = 0;
+    if( n > 0 && ( firstIndex & 1 ) )
+    {
+      normals[ k++ ] = GetNormalVariate( key, stream, firstIndex );
+    }
+    for( ; k + 2 <= n; k += 2 )
+    {
+      GetNormalVariates( key, stream, ( firstIndex + k ) >> 1, normals + k );
+    }
+    if( k < n )
+    {
+      normals[ k ] = GetNormalVariate( key, stream, firstIndex + k );
+    }
+  }
+
+
+private:
+
+  PhiloxRandomGenerator();                                 // purposely not implemented
+  PhiloxRandomGenerator( const PhiloxRandomGenerator & );  // purposely not implemented
+  void operator=( const PhiloxRandomGenerator & );         // purposely not implemented
+
+  /** Convert two words to a double in [0, 1) with 53 random bits. */
+  static double ToUniform( const WordType high, const WordType low )
+  {
+    const std::uint64_t bits = ( ( static_cast< std::uint64_t >( high ) << 32 ) | low ) >> 11;
+    return static_cast< double >( bits ) * ( 1.0 / 9007199254740992.0 );
+  }
+
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkPhiloxRandomGenerator_h
@@ -0,0 +1,94 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkPointKdTree_h
+#define __itkPointKdTree_h
+
+#include "itkIntTypes.h"
+#include "itkPoint.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class PointKdTree
+ *
+ * \brief A kd-tree for the closest point queries of the point set metrics.
+ *
+ * Build() stores a copy of the points, reordered such that each subtree is
+ * a contiguous range, with its splitting point in the middle. The splitting
+ * dimension of a range is the dimension in which its bounding box is largest.
+ * FindClosestPoint() returns the exact closest point.
+ *
+ * Contrary to the ANN library of the KNNGraphAlphaMutualInformation metric,
+ * which keeps its search state in global variables, the queries only read
+ * the tree, so that several threads may search the same tree simultaneously.
+ *
+ * \ingroup Metrics
+ */
+
+template< class TCoordRep, unsigned int VDimension >
+class PointKdTree
+{
+public:
+
+  typedef Point< TCoordRep, VDimension > PointType;
+  typedef std::vector< PointType >       PointContainerType;
+
+  PointKdTree() {}
+
+  /** Build the tree of the given points. */
+  void Build( const PointContainerType & points );
+
+  /** Get the number of points in the tree. */
+  SizeValueType GetNumberOfPoints( void ) const
+  {
+    return static_cast< SizeValueType >( this->m_Points.size() );
+  }
+
+
+  /** Return the index in the points given to Build() of the point closest to
+   * query, and its squared distance. The tree may not be empty.
+   */
+  SizeValueType FindClosestPoint( const PointType & query, double & squaredDistance ) const;
+
+private:
+
+  /** Split the range [begin, end) of m_Points and m_Indices recursively. */
+  void BuildRange( const SizeValueType begin, const SizeValueType end );
+
+  /** Search the range [begin, end) for a point closer than the best one. */
+  void SearchRange( const PointType & query, const SizeValueType begin,
+    const SizeValueType end, SizeValueType & best, double & bestSquaredDistance ) const;
+
+  /** The reordered points, their original indices, and the splitting
+   * dimension of the range of which they are the middle point.
+   */
+  PointContainerType           m_Points;
+  std::vector< SizeValueType > m_Indices;
+  std::vector< unsigned char > m_SplitDimensions;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkPointKdTree.hxx"
+#endif
+
+#endif // end #ifndef __itkPointKdTree_h
@@ -0,0 +1,185 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkPointKdTree_hxx
+#define __itkPointKdTree_hxx
+
+#include "itkPointKdTree.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace itk
+{
+
+/**
+ * ******************** Build ********************
+ */
+
+template< class TCoordRep, unsigned int VDimension >
+void
+PointKdTree< TCoordRep, VDimension >
+::Build( const PointContainerType & points )
+{
+  const SizeValueType numberOfPoints = static_cast< SizeValueType >( points.size() );
+
+  this->m_Indices.resize( numberOfPoints );
+  std::iota( this->m_Indices.begin(), this->m_Indices.end(), SizeValueType( 0 ) );
+  this->m_SplitDimensions.assign( numberOfPoints, 0 );
+  this->m_Points = points;
+
+  this->BuildRange( 0, numberOfPoints );
+
+  /** Reorder the points like their indices. */
+  for( SizeValueType i = 0; i < numberOfPoints; ++i )
+  {
+    this->m_Points[ i ] = points[ this->m_Indices[ i ] ];
+  }
+
+} // end Build()
+
+
+/**
+ * ******************** BuildRange ********************
+ */
+
+template< class TCoordRep, unsigned int VDimension >
+void
+PointKdTree< TCoordRep, VDimension >
+::BuildRange( const SizeValueType begin, const SizeValueType end )
+{
+  if( end - begin <= 1 )
+  {
+    return;
+  }
+
+  /** Split in the dimension in which the bounding box is largest. The points
+   * are still in their original order here, so they are read via m_Indices.
+   */
+  PointType lower = this->m_Points[ this->m_Indices[ begin ] ];
+  PointType upper = lower;
+  for( SizeValueType i = begin + 1; i < end; ++i )
+  {
+    const PointType & point = this->m_Points[ this->m_Indices[ i ] ];
+    for( unsigned int d = 0; d < VDimension; ++d )
+    {
+      lower[ d ] = std::min( lower[ d ], point[ d ] );
+      upper[ d ] = std::max( upper[ d ], point[ d ] );
+    }
+  }
+  unsigned int splitDimension = 0;
+  for( unsigned int d = 1; d < VDimension; ++d )
+  {
+    if( upper[ d ] - lower[ d ] > upper[ splitDimension ] - lower[ splitDimension ] )
+    {
+      splitDimension = d;
+    }
+  }
+
+  const SizeValueType middle = begin + ( end - begin ) / 2;
+  const PointContainerType & points = this->m_Points;
+  std::nth_element( this->m_Indices.begin() + begin, this->m_Indices.begin() + middle,
+    this->m_Indices.begin() + end,
+    [&points, splitDimension]( const SizeValueType i, const SizeValueType j )
+    {
+      return points[ i ][ splitDimension ] < points[ j ][ splitDimension ];
+    } );
+  this->m_SplitDimensions[ middle ] = static_cast< unsigned char >( splitDimension );
+
+  this->BuildRange( begin, middle );
+  this->BuildRange( middle + 1, end );
+
+} // end BuildRange()
+
+
+/**
+ * ******************** FindClosestPoint ********************
+ */
+
+template< class TCoordRep, unsigned int VDimension >
+SizeValueType
+PointKdTree< TCoordRep, VDimension >
+::FindClosestPoint( const PointType & query, double & squaredDistance ) const
+{
+  SizeValueType best = 0;
+  squaredDistance = std::numeric_limits< double >::max();
+  this->SearchRange( query, 0, this->GetNumberOfPoints(), best, squaredDistance );
+  return this->m_Indices[ best ];
+
+} // end FindClosestPoint()
+
+
+/**
+ * ******************** SearchRange ********************
+ */
+
+template< class TCoordRep, unsigned int VDimension >
+void
+PointKdTree< TCoordRep, VDimension >
+::SearchRange( const PointType & query, const SizeValueType begin,
+  const SizeValueType end, SizeValueType & best, double & bestSquaredDistance ) const
+{
+  if( begin >= end )
+  {
+    return;
+  }
+
+  const SizeValueType middle = begin + ( end - begin ) / 2;
+  const PointType &   point  = this->m_Points[ middle ];
+
+  double squaredDistance = 0.0;
+  for( unsigned int d = 0; d < VDimension; ++d )
+  {
+    const double diff = static_cast< double >( query[ d ] ) - static_cast< double >( point[ d ] );
+    squaredDistance += diff * diff;
+  }
+  if( squaredDistance < bestSquaredDistance )
+  {
+    bestSquaredDistance = squaredDistance;
+    best                = middle;
+  }
+
+  /** Search the side of the query first, and the other side only if the
+   * splitting plane is closer than the best point so far.
+   */
+  const unsigned int splitDimension = this->m_SplitDimensions[ middle ];
+  const double       planeDistance  = static_cast< double >( query[ splitDimension ] )
+    - static_cast< double >( point[ splitDimension ] );
+  if( planeDistance < 0.0 )
+  {
+    this->SearchRange( query, begin, middle, best, bestSquaredDistance );
+    if( planeDistance * planeDistance < bestSquaredDistance )
+    {
+      this->SearchRange( query, middle + 1, end, best, bestSquaredDistance );
+    }
+  }
+  else
+  {
+    this->SearchRange( query, middle + 1, end, best, bestSquaredDistance );
+    if( planeDistance * planeDistance < bestSquaredDistance )
+    {
+      this->SearchRange( query, begin, middle, best, bestSquaredDistance );
+    }
+  }
+
+} // end SearchRange()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkPointKdTree_hxx
@@ -0,0 +1,253 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkProfiler_cxx
+#define __itkProfiler_cxx
+
+#include "itkProfiler.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace itk
+{
+
+namespace
+{
+
+/** The counters of one thread. Only that thread writes them. */
+struct ThreadCountersType
+{
+  std::atomic< std::uint64_t > m_Nanoseconds[ Profiler::NumberOfCategories ];
+  std::atomic< std::uint64_t > m_Counts[ Profiler::NumberOfCategories ];
+
+  ThreadCountersType()
+  {
+    for( unsigned int i = 0; i < Profiler::NumberOfCategories; ++i )
+    {
+      this->m_Nanoseconds[ i ] = 0;
+      this->m_Counts[ i ]      = 0;
+    }
+  }
+};
+
+/** The counters of all threads that ever measured something. They are never
+ * deleted, so that the times of finished threads are kept.
+ */
+std::mutex                                           allThreadCountersMutex;
+std::vector< std::unique_ptr< ThreadCountersType > > allThreadCounters;
+
+ThreadCountersType &
+GetThreadCounters( void )
+{
+  thread_local ThreadCountersType * threadCounters = nullptr;
+  if( threadCounters == nullptr )
+  {
+    std::lock_guard< std::mutex > lock( allThreadCountersMutex );
+    allThreadCounters.emplace_back( new ThreadCountersType );
+    threadCounters = allThreadCounters.back().get();
+  }
+  return *threadCounters;
+
+} // end GetThreadCounters()
+
+
+} // end namespace
+
+std::atomic< bool > Profiler::m_Enabled( false );
+
+/**
+ * ****************** GetCategoryName *********************************
+ */
+
+const char *
+Profiler
+::GetCategoryName( const CategoryType category )
+{
+  switch( category )
+  {
+    case ImageSampler:
+      return "ImageSampler";
+    case Interpolator:
+      return "Interpolator";
+    case Transform:
+      return "Transform";
+    case TransformJacobian:
+      return "TransformJacobian";
+    case MetricReduction:
+      return "MetricReduction";
+    case OptimizerUpdate:
+      return "OptimizerUpdate";
+    case ExactMetricValue:
+      return "ExactMetricValue";
+    default:
+      return "Unknown";
+  }
+
+} // end GetCategoryName()
+
+
+/**
+ * ****************** SetEnabled *********************************
+ */
+
+void
+Profiler
+::SetEnabled( const bool enabled )
+{
+  m_Enabled.store( enabled, std::memory_order_relaxed );
+
+} // end SetEnabled()
+
+
+/**
+ * ****************** Add *********************************
+ */
+
+void
+Profiler
+::Add( const CategoryType category,
+  const std::uint64_t nanoseconds, const SizeValueType count )
+{
+  ThreadCountersType & counters = GetThreadCounters();
+  counters.m_Nanoseconds[ category ].fetch_add( nanoseconds, std::memory_order_relaxed );
+  counters.m_Counts[ category ].fetch_add( count, std::memory_order_relaxed );
+
+} // end Add()
+
+
+/**
+ * ****************** GetSeconds *********************************
+ */
+
+double
+Profiler
+::GetSeconds( const CategoryType category )
+{
+  std::lock_guard< std::mutex > lock( allThreadCountersMutex );
+  std::uint64_t nanoseconds = 0;
+  for( const auto & counters : allThreadCounters )
+  {
+    nanoseconds += counters->m_Nanoseconds[ category ].load( std::memory_order_relaxed );
+  }
+  return static_cast< double >( nanoseconds ) * 1e-9;
+
+} // end GetSeconds()
+
+
+/**
+ * ****************** GetCount *********************************
+ */
+
+SizeValueType
+Profiler
+::GetCount( const CategoryType category )
+{
+  std::lock_guard< std::mutex > lock( allThreadCountersMutex );
+  std::uint64_t count = 0;
+  for( const auto & counters : allThreadCounters )
+  {
+    count += counters->m_Counts[ category ].load( std::memory_order_relaxed );
+  }
+  return static_cast< SizeValueType >( count );
+
+} // end GetCount()
+
+
+/**
+ * ****************** Reset *********************************
+ */
+
+void
+Profiler
+::Reset( void )
+{
+  std::lock_guard< std::mutex > lock( allThreadCountersMutex );
+  for( const auto & counters : allThreadCounters )
+  {
+    for( unsigned int i = 0; i < NumberOfCategories; ++i )
+    {
+      counters->m_Nanoseconds[ i ].store( 0, std::memory_order_relaxed );
+      counters->m_Counts[ i ].store( 0, std::memory_order_relaxed );
+    }
+  }
+
+} // end Reset()
+
+
+/**
+ * ****************** WriteTable *********************************
+ */
+
+void
+Profiler
+::WriteTable( std::ostream & os, const double wallTimeSeconds )
+{
+  const std::ios::fmtflags flags     = os.flags();
+  const std::streamsize    precision = os.precision();
+
+  os << std::left << std::setw( 20 ) << "Category"
+     << std::right << std::setw( 14 ) << "Time[ms]"
+     << std::setw( 14 ) << "Count"
+     << std::setw( 12 ) << "%Wall" << "\n";
+  for( unsigned int i = 0; i < NumberOfCategories; ++i )
+  {
+    const CategoryType category = static_cast< CategoryType >( i );
+    const double       seconds  = GetSeconds( category );
+    const double       share    = wallTimeSeconds > 0.0 ? 100.0 * seconds / wallTimeSeconds : 0.0;
+    os << std::left << std::setw( 20 ) << GetCategoryName( category )
+       << std::right << std::fixed << std::setprecision( 1 )
+       << std::setw( 14 ) << seconds * 1000.0
+       << std::setw( 14 ) << GetCount( category )
+       << std::setw( 12 ) << share << "\n";
+  }
+  os << std::left << std::setw( 20 ) << "Wall"
+     << std::right << std::setw( 14 ) << wallTimeSeconds * 1000.0 << "\n";
+
+  os.flags( flags );
+  os.precision( precision );
+
+} // end WriteTable()
+
+
+/**
+ * ****************** WriteJSONMembers *********************************
+ */
+
+void
+Profiler
+::WriteJSONMembers( std::ostream & os, const std::string & indent )
+{
+  const std::streamsize precision = os.precision();
+  os << std::setprecision( 9 );
+  for( unsigned int i = 0; i < NumberOfCategories; ++i )
+  {
+    const CategoryType category = static_cast< CategoryType >( i );
+    os << indent << "\"" << GetCategoryName( category ) << "\": { \"seconds\": "
+       << GetSeconds( category ) << ", \"count\": " << GetCount( category ) << " }"
+       << ( i + 1 < NumberOfCategories ? ",\n" : "\n" );
+  }
+  os.precision( precision );
+
+} // end WriteJSONMembers()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkProfiler_cxx
@@ -0,0 +1,149 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkProfiler_h
+#define __itkProfiler_h
+
+#include "itkIntTypes.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace itk
+{
+
+/** \class Profiler
+ *
+ * \brief Accumulates the time spent in the hot paths of the registration.
+ *
+ * The components measure their hot paths with a ScopedTimer, which adds the
+ * elapsed time and a count to one of a fixed set of categories. When
+ * profiling is disabled, which is the default, a ScopedTimer only tests a
+ * flag. Each thread accumulates in its own counters, so that the threads do
+ * not contend when profiling is enabled.
+ *
+ * The times of the categories that are measured inside the threads are
+ * summed over the threads, so they may exceed the wall time. A measurement
+ * inside another one, such as the interpolations during the computation of
+ * the exact metric value, is counted in both categories.
+ *
+ * \ingroup ITKCommon
+ */
+
+class Profiler
+{
+public:
+
+  /** The measured categories. */
+  enum CategoryType {
+    ImageSampler = 0,
+    Interpolator,
+    Transform,
+    TransformJacobian,
+    MetricReduction,
+    OptimizerUpdate,
+    ExactMetricValue,
+    NumberOfCategories
+  };
+
+  /** Get the name of a category. */
+  static const char * GetCategoryName( const CategoryType category );
+
+  /** Enable or disable the profiling. */
+  static void SetEnabled( const bool enabled );
+
+  static bool GetEnabled( void )
+  {
+    return m_Enabled.load( std::memory_order_relaxed );
+  }
+
+
+  /** Add a time and a count to a category. */
+  static void Add( const CategoryType category,
+    const std::uint64_t nanoseconds, const SizeValueType count = 1 );
+
+  /** Get the accumulated time and count of a category, summed over the threads. */
+  static double GetSeconds( const CategoryType category );
+
+  static SizeValueType GetCount( const CategoryType category );
+
+  /** Set all times and counts to zero. Not to be called while measuring. */
+  static void Reset( void );
+
+  /** Write a table of the categories, with their share of the wall time. */
+  static void WriteTable( std::ostream & os, const double wallTimeSeconds );
+
+  /** Write the categories as the members of a JSON object, without braces. */
+  static void WriteJSONMembers( std::ostream & os, const std::string & indent );
+
+  /** Adds the time between its construction and destruction to a category,
+   * if the profiling was enabled at its construction.
+   */
+  class ScopedTimer
+  {
+public:
+
+    explicit ScopedTimer( const CategoryType category, const SizeValueType count = 1 ) :
+      m_Category( category ), m_Count( count ), m_Active( Profiler::GetEnabled() )
+    {
+      if( this->m_Active )
+      {
+        this->m_Start = ClockType::now();
+      }
+    }
+
+
+    ~ScopedTimer()
+    {
+      if( this->m_Active )
+      {
+        const auto elapsed = std::chrono::duration_cast< std::chrono::nanoseconds >(
+          ClockType::now() - this->m_Start );
+        Profiler::Add( this->m_Category, static_cast< std::uint64_t >( elapsed.count() ), this->m_Count );
+      }
+    }
+
+
+private:
+
+    typedef std::chrono::steady_clock ClockType;
+
+    ScopedTimer( const ScopedTimer & );    // purposely not implemented
+    void operator=( const ScopedTimer & ); // purposely not implemented
+
+    const CategoryType    m_Category;
+    const SizeValueType   m_Count;
+    const bool            m_Active;
+    ClockType::time_point m_Start;
+  };
+
+private:
+
+  Profiler();                         // purposely not implemented
+  Profiler( const Profiler & );       // purposely not implemented
+  void operator=( const Profiler & ); // purposely not implemented
+
+  static std::atomic< bool > m_Enabled;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkProfiler_h
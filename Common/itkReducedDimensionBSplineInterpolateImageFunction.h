@@ -44,7 +44,7 @@
 #include "itkInterpolateImageFunction.h"
 #include "vnl/vnl_matrix.h"
 
-#include "itkMultiOrderBSplineDecompositionImageFilter.h"
+#include "itkMultiThreadedBSplineDecompositionImageFilter.h"
 #include "itkConceptChecking.h"
 #include "itkCovariantVector.h"
 
@@ -70,9 +70,16 @@ namespace itk
  * And code obtained from bigwww.epfl.ch by Philippe Thevenaz.
  *
  * The B spline coefficients are calculated through the
- * MultiOrderBSplineDecompositionImageFilter to enable a zero-th order
+ * MultiThreadedBSplineDecompositionImageFilter to enable a zero-th order
  * for the last dimension.
  *
+ * For the spline orders 1, 2 and 3 the evaluation is specialized: the last
+ * index selects a slice, whose buffer offset is computed once, after which a
+ * (D-1)-dimensional B-spline is evaluated on that slice, with the weights
+ * and the buffer offsets of the support in fixed-size arrays on the stack.
+ * The value and the derivative can be computed together, with
+ * EvaluateValueAndDerivativeAtContinuousIndex().
+ *
  * Limitations:  Spline order must be between 0 and 5.
  *               Spline order must be set before setting the image.
  *               Requires same spline order for every dimension.
@@ -80,7 +87,7 @@ namespace itk
  *               Spline is determined in all dimensions, cannot selectively
  *                  pick dimension for calculating spline.
  *
- * \sa MultiOrderBSplineDecompositionImageFilter
+ * \sa MultiThreadedBSplineDecompositionImageFilter
  *
  * \ingroup ImageFunctions
  */
@@ -135,7 +142,7 @@ public:
     >                      CoefficientImageType;
 
   /** Define filter for calculating the BSpline coefficients */
-  typedef MultiOrderBSplineDecompositionImageFilter< TImageType, CoefficientImageType >
+  typedef MultiThreadedBSplineDecompositionImageFilter< TImageType, CoefficientImageType >
     CoefficientFilter;
 
   typedef typename CoefficientFilter::Pointer CoefficientFilterPointer;
@@ -167,6 +174,12 @@ public:
   CovariantVectorType EvaluateDerivativeAtContinuousIndex(
     const ContinuousIndexType & x ) const;
 
+  /** Method to compute both the value and the derivative. */
+  void EvaluateValueAndDerivativeAtContinuousIndex(
+    const ContinuousIndexType & x,
+    OutputType & value,
+    CovariantVectorType & deriv ) const;
+
   /** Get/Sets the Spline Order, supports 0th - 5th order splines. The default
    *  is a 3rd order spline. */
   void SetSplineOrder( unsigned int SplineOrder );
@@ -215,6 +228,21 @@ private:
     return SizeType::Filled(m_SplineOrder + 1);
   }
 
+  /** The number of points of the support in the first D-1 dimensions. */
+  static constexpr unsigned int GetSupportSize(
+    const unsigned int width, const unsigned int dimension )
+  {
+    return dimension == 0 ? 1 : width * GetSupportSize( width, dimension - 1 );
+  }
+
+
+  /** Evaluate the value, and the derivative if deriv is not null, for a
+   * spline order of 1, 2 or 3.
+   */
+  template< unsigned int VSplineOrder >
+  void EvaluateOptimized( const ContinuousIndexType & x,
+    OutputType & value, CovariantVectorType * deriv ) const;
+
   /** Determines the weights for interpolation of the value x */
   void SetInterpolationWeights( const ContinuousIndexType & x,
     const vnl_matrix< long > & EvaluateIndex,
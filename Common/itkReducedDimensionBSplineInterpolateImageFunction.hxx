@@ -149,6 +149,22 @@ ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoeffic
 ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
 ::EvaluateAtContinuousIndex( const ContinuousIndexType & x ) const
 {
+  OutputType value;
+  switch( m_SplineOrder )
+  {
+    case 1:
+      this->EvaluateOptimized< 1 >( x, value, nullptr );
+      return value;
+    case 2:
+      this->EvaluateOptimized< 2 >( x, value, nullptr );
+      return value;
+    case 3:
+      this->EvaluateOptimized< 3 >( x, value, nullptr );
+      return value;
+    default:
+      break;
+  }
+
   /** Allocate memory on the stack: */
   const unsigned int maxSplineOrder = 5;
   const unsigned int maxMatrixSize  = ( ImageDimension - 1 ) * ( maxSplineOrder + 1 );
@@ -201,6 +217,14 @@ ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoeffic
 ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
 ::EvaluateDerivativeAtContinuousIndex( const ContinuousIndexType & x ) const
 {
+  if( m_SplineOrder >= 1 && m_SplineOrder <= 3 )
+  {
+    OutputType          value;
+    CovariantVectorType deriv;
+    this->EvaluateValueAndDerivativeAtContinuousIndex( x, value, deriv );
+    return deriv;
+  }
+
   /** Allocate memory on the stack: */
   const unsigned int maxSplineOrder = 5;
   const unsigned int maxMatrixSize  = ( ImageDimension - 1 ) * ( maxSplineOrder + 1 );
@@ -270,6 +294,198 @@ ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoeffic
 }
 
 
+template< class TImageType, class TCoordRep, class TCoefficientType >
+void
+ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::EvaluateValueAndDerivativeAtContinuousIndex( const ContinuousIndexType & x,
+  OutputType & value, CovariantVectorType & deriv ) const
+{
+  switch( m_SplineOrder )
+  {
+    case 1:
+      return this->EvaluateOptimized< 1 >( x, value, &deriv );
+    case 2:
+      return this->EvaluateOptimized< 2 >( x, value, &deriv );
+    case 3:
+      return this->EvaluateOptimized< 3 >( x, value, &deriv );
+    default:
+      value = this->EvaluateAtContinuousIndex( x );
+      deriv = this->EvaluateDerivativeAtContinuousIndex( x );
+  }
+}
+
+
+template< class TImageType, class TCoordRep, class TCoefficientType >
+template< unsigned int VSplineOrder >
+void
+ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
+::EvaluateOptimized( const ContinuousIndexType & x,
+  OutputType & value, CovariantVectorType * deriv ) const
+{
+  const unsigned int ReducedDimension = ImageDimension - 1;
+  const unsigned int Width            = VSplineOrder + 1;
+  const unsigned int SupportSize      = GetSupportSize( Width, ReducedDimension );
+
+  const CoefficientDataType * buffer      = m_Coefficients->GetBufferPointer();
+  const OffsetValueType *     offsetTable = m_Coefficients->GetOffsetTable();
+  const IndexType &           bufferStart = m_Coefficients->GetBufferedRegion().GetIndex();
+
+  /** The last dimension is interpolated with nearest neighbour, so it only
+   * selects the slice.
+   */
+  const IndexValueType  sliceIndex  = vnl_math::rnd( x[ ReducedDimension ] );
+  const OffsetValueType sliceOffset
+    = ( sliceIndex - bufferStart[ ReducedDimension ] ) * offsetTable[ ReducedDimension ];
+
+  /** Compute the weights, the derivative weights and the buffer offsets of
+   * the support in each of the other dimensions, with the same support and
+   * mirror boundary conditions as DetermineRegionOfSupport() and
+   * ApplyMirrorBoundaryConditions().
+   */
+  double          weights[ ReducedDimension ][ Width ];
+  double          derivativeWeights[ ReducedDimension ][ Width ];
+  OffsetValueType offsets[ ReducedDimension ][ Width ];
+  for( unsigned int n = 0; n < ReducedDimension; n++ )
+  {
+    IndexValueType startIndex;
+    if( VSplineOrder == 1 )
+    {
+      startIndex = static_cast< IndexValueType >( std::floor( static_cast< float >( x[ n ] ) ) );
+      const double t = x[ n ] - static_cast< double >( startIndex );
+
+      weights[ n ][ 0 ]           = 1.0 - t;
+      weights[ n ][ 1 ]           = t;
+      derivativeWeights[ n ][ 0 ] = -1.0;
+      derivativeWeights[ n ][ 1 ] = 1.0;
+    }
+    else if( VSplineOrder == 2 )
+    {
+      startIndex = static_cast< IndexValueType >( std::floor( static_cast< float >( x[ n ] + 0.5 ) ) ) - 1;
+      const double t  = x[ n ] - static_cast< double >( startIndex + 1 );
+      const double tm = 0.5 - t;
+      const double tp = 0.5 + t;
+
+      weights[ n ][ 0 ]           = 0.5 * tm * tm;
+      weights[ n ][ 1 ]           = 0.75 - t * t;
+      weights[ n ][ 2 ]           = 0.5 * tp * tp;
+      derivativeWeights[ n ][ 0 ] = -tm;
+      derivativeWeights[ n ][ 1 ] = -2.0 * t;
+      derivativeWeights[ n ][ 2 ] = tp;
+    }
+    else
+    {
+      startIndex = static_cast< IndexValueType >( std::floor( static_cast< float >( x[ n ] ) ) ) - 1;
+      const double t  = x[ n ] - static_cast< double >( startIndex + 1 );
+      const double t2 = t * t;
+      const double tm = 1.0 - t;
+
+      weights[ n ][ 0 ]           = tm * tm * tm / 6.0;
+      weights[ n ][ 1 ]           = ( 4.0 - 6.0 * t2 + 3.0 * t2 * t ) / 6.0;
+      weights[ n ][ 2 ]           = ( 1.0 + 3.0 * t + 3.0 * t2 - 3.0 * t2 * t ) / 6.0;
+      weights[ n ][ 3 ]           = t2 * t / 6.0;
+      derivativeWeights[ n ][ 0 ] = -0.5 * tm * tm;
+      derivativeWeights[ n ][ 1 ] = 1.5 * t2 - 2.0 * t;
+      derivativeWeights[ n ][ 2 ] = 0.5 + t - 1.5 * t2;
+      derivativeWeights[ n ][ 3 ] = 0.5 * t2;
+    }
+
+    const IndexValueType dataLength  = static_cast< IndexValueType >( m_DataLength[ n ] );
+    const IndexValueType dataLength2 = 2 * dataLength - 2;
+    for( unsigned int k = 0; k < Width; k++ )
+    {
+      IndexValueType index = startIndex + static_cast< IndexValueType >( k );
+      if( dataLength == 1 )
+      {
+        index = 0;
+      }
+      else
+      {
+        index = ( index < 0 ) ? ( -index - dataLength2 * ( ( -index ) / dataLength2 ) )
+          : ( index - dataLength2 * ( index / dataLength2 ) );
+        if( dataLength <= index )
+        {
+          index = dataLength2 - index;
+        }
+      }
+      offsets[ n ][ k ] = ( index - bufferStart[ n ] ) * offsetTable[ n ];
+    }
+  }
+
+  /** Expand the offsets and the weights to the whole support, with the first
+   * dimension running fastest. Entry n of the derivative weights holds the
+   * products for the derivative in dimension n.
+   */
+  OffsetValueType supportOffsets[ SupportSize ];
+  double          supportWeights[ SupportSize ];
+  double          supportDerivativeWeights[ ReducedDimension ][ SupportSize ];
+  supportOffsets[ 0 ] = sliceOffset;
+  supportWeights[ 0 ] = 1.0;
+  for( unsigned int j = 0; j < ReducedDimension; j++ )
+  {
+    supportDerivativeWeights[ j ][ 0 ] = 1.0;
+  }
+  unsigned int numberOfPoints = 1;
+  for( unsigned int n = 0; n < ReducedDimension; n++ )
+  {
+    for( unsigned int k = Width; k-- > 0; )
+    {
+      for( unsigned int p = 0; p < numberOfPoints; p++ )
+      {
+        const unsigned int q = k * numberOfPoints + p;
+        supportOffsets[ q ] = supportOffsets[ p ] + offsets[ n ][ k ];
+        supportWeights[ q ] = supportWeights[ p ] * weights[ n ][ k ];
+        for( unsigned int j = 0; j < ReducedDimension; j++ )
+        {
+          supportDerivativeWeights[ j ][ q ] = supportDerivativeWeights[ j ][ p ]
+            * ( j == n ? derivativeWeights[ n ][ k ] : weights[ n ][ k ] );
+        }
+      }
+    }
+    numberOfPoints *= Width;
+  }
+
+  /** Perform the interpolation. */
+  double interpolated = 0.0;
+  for( unsigned int p = 0; p < SupportSize; p++ )
+  {
+    interpolated += supportWeights[ p ] * buffer[ supportOffsets[ p ] ];
+  }
+  value = static_cast< OutputType >( interpolated );
+
+  if( !deriv )
+  {
+    return;
+  }
+
+  /** Calculate the derivative, taking the spacing into account. There is no
+   * derivative in the last dimension.
+   */
+  const InputImageType * inputImage = this->GetInputImage();
+  const typename InputImageType::SpacingType & spacing = inputImage->GetSpacing();
+
+  CovariantVectorType derivativeValue;
+  derivativeValue[ ReducedDimension ] = static_cast< OutputType >( 0.0 );
+  for( unsigned int n = 0; n < ReducedDimension; n++ )
+  {
+    double derivative = 0.0;
+    for( unsigned int p = 0; p < SupportSize; p++ )
+    {
+      derivative += supportDerivativeWeights[ n ][ p ] * buffer[ supportOffsets[ p ] ];
+    }
+    derivativeValue[ n ] = static_cast< OutputType >( derivative / spacing[ n ] );
+  }
+
+  if( this->m_UseImageDirection )
+  {
+    inputImage->TransformLocalVectorToPhysicalVector( derivativeValue, *deriv );
+  }
+  else
+  {
+    *deriv = derivativeValue;
+  }
+}
+
+
 template< class TImageType, class TCoordRep, class TCoefficientType >
 void
 ReducedDimensionBSplineInterpolateImageFunction< TImageType, TCoordRep, TCoefficientType >
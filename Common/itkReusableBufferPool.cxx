@@ -0,0 +1,300 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkReusableBufferPool_cxx
+#define __itkReusableBufferPool_cxx
+
+#include "itkReusableBufferPool.h"
+#include "itkMemoryUsage.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+
+namespace itk
+{
+
+namespace
+{
+
+/** The cached blocks, by capacity. */
+std::mutex                                                  cacheMutex;
+std::multimap< std::size_t, ReusableBufferPool::BlockType > cachedBlocks;
+std::uint64_t                                               cachedBytes = 0;
+std::uint64_t                                               bytesInUse  = 0;
+
+/** The statistics since the last reset. */
+std::atomic< SizeValueType > numberOfReuses( 0 );
+std::atomic< SizeValueType > numberOfCacheHits( 0 );
+std::atomic< SizeValueType > numberOfAllocations( 0 );
+std::atomic< std::uint64_t > numberOfAllocatedBytes( 0 );
+
+} // end namespace
+
+/**
+ * ****************** Acquire *********************************
+ */
+
+ReusableBufferPool::BlockType
+ReusableBufferPool
+::Acquire( const std::size_t numberOfBytes )
+{
+  const std::size_t capacity
+    = ( numberOfBytes + Alignment - 1 ) / Alignment * Alignment;
+
+  /** Take the smallest cached block that fits, unless it is more than twice
+   * as large, which would keep too much memory in use.
+   */
+  {
+    std::lock_guard< std::mutex > lock( cacheMutex );
+    const auto it = cachedBlocks.lower_bound( capacity );
+    if( it != cachedBlocks.end() && it->first / 2 <= capacity )
+    {
+      const BlockType block = it->second;
+      cachedBlocks.erase( it );
+      cachedBytes -= block.m_Capacity;
+      bytesInUse  += block.m_Capacity;
+      numberOfCacheHits.fetch_add( 1, std::memory_order_relaxed );
+      return block;
+    }
+  }
+
+  /** Allocate a new block, with room to align its data. */
+  BlockType block;
+  block.m_Memory = std::malloc( capacity + Alignment );
+  if( block.m_Memory == nullptr )
+  {
+    throw std::bad_alloc();
+  }
+  const std::uintptr_t address = reinterpret_cast< std::uintptr_t >( block.m_Memory );
+  block.m_Data     = reinterpret_cast< void * >( ( address + Alignment - 1 ) / Alignment * Alignment );
+  block.m_Capacity = capacity;
+
+  numberOfAllocations.fetch_add( 1, std::memory_order_relaxed );
+  numberOfAllocatedBytes.fetch_add( capacity, std::memory_order_relaxed );
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  bytesInUse += capacity;
+  return block;
+
+} // end Acquire()
+
+
+/**
+ * ****************** Release *********************************
+ */
+
+void
+ReusableBufferPool
+::Release( const BlockType & block )
+{
+  if( block.m_Memory == nullptr )
+  {
+    return;
+  }
+
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  cachedBlocks.insert( std::make_pair( block.m_Capacity, block ) );
+  cachedBytes += block.m_Capacity;
+  bytesInUse  -= block.m_Capacity;
+
+} // end Release()
+
+
+/**
+ * ****************** CountReuse *********************************
+ */
+
+void
+ReusableBufferPool
+::CountReuse( void )
+{
+  numberOfReuses.fetch_add( 1, std::memory_order_relaxed );
+
+} // end CountReuse()
+
+
+/**
+ * ****************** ReleaseCachedBuffers *********************************
+ */
+
+void
+ReusableBufferPool
+::ReleaseCachedBuffers( void )
+{
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  for( const auto & cached : cachedBlocks )
+  {
+    std::free( cached.second.m_Memory );
+  }
+  cachedBlocks.clear();
+  cachedBytes = 0;
+
+} // end ReleaseCachedBuffers()
+
+
+/**
+ * ****************** GetNumberOfRequests *********************************
+ */
+
+SizeValueType
+ReusableBufferPool
+::GetNumberOfRequests( void )
+{
+  return GetNumberOfReuses() + GetNumberOfCacheHits() + GetNumberOfAllocations();
+
+} // end GetNumberOfRequests()
+
+
+/**
+ * ****************** GetNumberOfReuses *********************************
+ */
+
+SizeValueType
+ReusableBufferPool
+::GetNumberOfReuses( void )
+{
+  return numberOfReuses.load( std::memory_order_relaxed );
+
+} // end GetNumberOfReuses()
+
+
+/**
+ * ****************** GetNumberOfCacheHits *********************************
+ */
+
+SizeValueType
+ReusableBufferPool
+::GetNumberOfCacheHits( void )
+{
+  return numberOfCacheHits.load( std::memory_order_relaxed );
+
+} // end GetNumberOfCacheHits()
+
+
+/**
+ * ****************** GetNumberOfAllocations *********************************
+ */
+
+SizeValueType
+ReusableBufferPool
+::GetNumberOfAllocations( void )
+{
+  return numberOfAllocations.load( std::memory_order_relaxed );
+
+} // end GetNumberOfAllocations()
+
+
+/**
+ * ****************** GetNumberOfAllocatedBytes *********************************
+ */
+
+std::uint64_t
+ReusableBufferPool
+::GetNumberOfAllocatedBytes( void )
+{
+  return numberOfAllocatedBytes.load( std::memory_order_relaxed );
+
+} // end GetNumberOfAllocatedBytes()
+
+
+/**
+ * ****************** GetNumberOfBytesInUse *********************************
+ */
+
+std::uint64_t
+ReusableBufferPool
+::GetNumberOfBytesInUse( void )
+{
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  return bytesInUse;
+
+} // end GetNumberOfBytesInUse()
+
+
+/**
+ * ****************** GetNumberOfCachedBytes *********************************
+ */
+
+std::uint64_t
+ReusableBufferPool
+::GetNumberOfCachedBytes( void )
+{
+  std::lock_guard< std::mutex > lock( cacheMutex );
+  return cachedBytes;
+
+} // end GetNumberOfCachedBytes()
+
+
+/**
+ * ****************** ResetStatistics *********************************
+ */
+
+void
+ReusableBufferPool
+::ResetStatistics( void )
+{
+  numberOfReuses.store( 0, std::memory_order_relaxed );
+  numberOfCacheHits.store( 0, std::memory_order_relaxed );
+  numberOfAllocations.store( 0, std::memory_order_relaxed );
+  numberOfAllocatedBytes.store( 0, std::memory_order_relaxed );
+
+} // end ResetStatistics()
+
+
+/**
+ * ****************** WriteStatistics *********************************
+ */
+
+void
+ReusableBufferPool
+::WriteStatistics( std::ostream & os )
+{
+  os << "Buffers: " << GetNumberOfRequests() << " requests, "
+     << GetNumberOfReuses() << " kept, "
+     << GetNumberOfCacheHits() << " reused from the cache, "
+     << GetNumberOfAllocations() << " allocated ("
+     << MemoryUsage::FormatSize( GetNumberOfAllocatedBytes() ) << "); "
+     << MemoryUsage::FormatSize( GetNumberOfBytesInUse() ) << " in use, "
+     << MemoryUsage::FormatSize( GetNumberOfCachedBytes() ) << " cached.\n";
+
+} // end WriteStatistics()
+
+
+/**
+ * ****************** WriteJSONMembers *********************************
+ */
+
+void
+ReusableBufferPool
+::WriteJSONMembers( std::ostream & os, const std::string & indent )
+{
+  os << indent << "\"requests\": " << GetNumberOfRequests() << ",\n"
+     << indent << "\"kept\": " << GetNumberOfReuses() << ",\n"
+     << indent << "\"cacheHits\": " << GetNumberOfCacheHits() << ",\n"
+     << indent << "\"allocations\": " << GetNumberOfAllocations() << ",\n"
+     << indent << "\"allocatedBytes\": " << GetNumberOfAllocatedBytes() << ",\n"
+     << indent << "\"bytesInUse\": " << GetNumberOfBytesInUse() << ",\n"
+     << indent << "\"cachedBytes\": " << GetNumberOfCachedBytes() << "\n";
+
+} // end WriteJSONMembers()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkReusableBufferPool_cxx
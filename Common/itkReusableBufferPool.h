@@ -0,0 +1,193 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkReusableBufferPool_h
+#define __itkReusableBufferPool_h
+
+#include "itkIntTypes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace itk
+{
+
+/** \class ReusableBufferPool
+ *
+ * \brief Hands out aligned memory blocks and keeps the returned ones for
+ * reuse during the registration.
+ *
+ * The metrics and their threads allocate buffers whose sizes depend on the
+ * number of parameters, which is the same or larger in every resolution. A
+ * ReusableBuffer keeps its block as long as it is large enough, and only
+ * asks the pool for a larger one. The pool keeps the returned blocks, such
+ * as those of the components of a finished registration stage, and hands
+ * them out again for requests that they fit. This avoids freeing and
+ * faulting in the same memory again at every resolution transition.
+ *
+ * The cached blocks are kept until ReleaseCachedBuffers() is called, at the
+ * end of a sequence of registrations. The blocks are aligned to a cache
+ * line and are not initialized. All functions are thread safe.
+ *
+ * The statistics count the requests of the buffers since the last call of
+ * ResetStatistics(): those that fitted in the block of the buffer, those
+ * that were served from the cache, and those that allocated a new block.
+ *
+ * \ingroup ITKCommon
+ */
+
+class ReusableBufferPool
+{
+public:
+
+  /** The alignment of the blocks, in bytes. */
+  enum { Alignment = 64 };
+
+  /** A block of memory. The data is aligned within the allocated memory. */
+  struct BlockType
+  {
+    void *      m_Memory;
+    void *      m_Data;
+    std::size_t m_Capacity;
+
+    BlockType() : m_Memory( nullptr ), m_Data( nullptr ), m_Capacity( 0 ) {}
+  };
+
+  /** Get a block of at least the given number of bytes, from the cache if one
+   * fits, and newly allocated otherwise. Throws std::bad_alloc on failure.
+   */
+  static BlockType Acquire( const std::size_t numberOfBytes );
+
+  /** Return a block to the cache. Empty blocks are ignored. */
+  static void Release( const BlockType & block );
+
+  /** Count a request that fitted in the block that the buffer already had. */
+  static void CountReuse( void );
+
+  /** Free all cached blocks. The blocks in use are not affected. */
+  static void ReleaseCachedBuffers( void );
+
+  /** The statistics since the last reset. */
+  static SizeValueType GetNumberOfRequests( void );
+
+  static SizeValueType GetNumberOfReuses( void );
+
+  static SizeValueType GetNumberOfCacheHits( void );
+
+  static SizeValueType GetNumberOfAllocations( void );
+
+  static std::uint64_t GetNumberOfAllocatedBytes( void );
+
+  /** The current numbers of bytes of the blocks in use and in the cache. */
+  static std::uint64_t GetNumberOfBytesInUse( void );
+
+  static std::uint64_t GetNumberOfCachedBytes( void );
+
+  /** Set the counts of the requests to zero. */
+  static void ResetStatistics( void );
+
+  /** Write the statistics on one line. */
+  static void WriteStatistics( std::ostream & os );
+
+  /** Write the statistics as the members of a JSON object, without braces. */
+  static void WriteJSONMembers( std::ostream & os, const std::string & indent );
+
+private:
+
+  ReusableBufferPool();                             // purposely not implemented
+  ReusableBufferPool( const ReusableBufferPool & ); // purposely not implemented
+  void operator=( const ReusableBufferPool & );     // purposely not implemented
+
+};
+
+/** \class ReusableBuffer
+ *
+ * \brief A grow-only array of plain values, whose memory comes from the
+ * ReusableBufferPool.
+ *
+ * SetSize() keeps the block when it is large enough, and otherwise returns
+ * it to the pool and acquires a larger one. The values are not initialized,
+ * and are not kept when the buffer grows. The block is returned to the pool
+ * on destruction, or by Release().
+ *
+ * \ingroup ITKCommon
+ */
+
+template< class TValue >
+class ReusableBuffer
+{
+public:
+
+  typedef TValue ValueType;
+
+  ReusableBuffer() : m_Size( 0 ) {}
+  ~ReusableBuffer()
+  {
+    ReusableBufferPool::Release( this->m_Block );
+  }
+
+
+  /** Set the number of values, growing the block when needed. */
+  void SetSize( const SizeValueType size )
+  {
+    const std::size_t numberOfBytes = size * sizeof( TValue );
+    if( numberOfBytes <= this->m_Block.m_Capacity )
+    {
+      if( numberOfBytes > 0 )
+      {
+        ReusableBufferPool::CountReuse();
+      }
+    }
+    else
+    {
+      ReusableBufferPool::Release( this->m_Block );
+      this->m_Block = ReusableBufferPool::BlockType();
+      this->m_Block = ReusableBufferPool::Acquire( numberOfBytes );
+    }
+    this->m_Size = size;
+  }
+
+
+  /** Return the block to the pool and set the size to zero. */
+  void Release( void )
+  {
+    ReusableBufferPool::Release( this->m_Block );
+    this->m_Block = ReusableBufferPool::BlockType();
+    this->m_Size  = 0;
+  }
+
+
+  SizeValueType GetSize( void ) const { return this->m_Size; }
+  SizeValueType GetCapacity( void ) const { return this->m_Block.m_Capacity / sizeof( TValue ); }
+
+  TValue * GetBufferPointer( void ) { return static_cast< TValue * >( this->m_Block.m_Data ); }
+  const TValue * GetBufferPointer( void ) const { return static_cast< const TValue * >( this->m_Block.m_Data ); }
+
+private:
+
+  ReusableBuffer( const ReusableBuffer & ); // purposely not implemented
+  void operator=( const ReusableBuffer & ); // purposely not implemented
+
+  ReusableBufferPool::BlockType m_Block;
+  SizeValueType                 m_Size;
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkReusableBufferPool_h
@@ -94,6 +94,33 @@ ScaledSingleValuedNonLinearOptimizer
 } // end GetUseScales()
 
 
+/**
+ * ********************* SetActiveParameterIndices ******************************
+ */
+
+void
+ScaledSingleValuedNonLinearOptimizer
+::SetActiveParameterIndices( const ActiveParameterIndicesType & indices )
+{
+  this->m_ScaledCostFunction->SetActiveParameterIndices( indices );
+  this->Modified();
+
+} // end SetActiveParameterIndices()
+
+
+/**
+ * ********************* GetActiveParameterIndices ******************************
+ */
+
+const ScaledSingleValuedNonLinearOptimizer::ActiveParameterIndicesType &
+ScaledSingleValuedNonLinearOptimizer
+::GetActiveParameterIndices( void ) const
+{
+  return this->m_ScaledCostFunction->GetActiveParameterIndices();
+
+} // end GetActiveParameterIndices()
+
+
 /**
  * ********************* GetScaledValue *****************************
  */
@@ -107,6 +134,21 @@ ScaledSingleValuedNonLinearOptimizer
 } // end GetScaledValue()
 
 
+/**
+ * ********************* GetScaledValues *****************************
+ */
+
+void
+ScaledSingleValuedNonLinearOptimizer
+::GetScaledValues(
+  const ScaledCostFunctionType::ParametersVectorType & parameters,
+  ScaledCostFunctionType::MeasureVectorType & values ) const
+{
+  this->m_ScaledCostFunction->GetValues( parameters, values );
+
+} // end GetScaledValues()
+
+
 /**
  * ********************* GetScaledDerivative *****************************
  */
@@ -151,13 +193,12 @@ ScaledSingleValuedNonLinearOptimizer
   const ParametersType & scaledCurrentPosition
     = this->GetScaledCurrentPosition();
 
-  if( this->GetUseScales() )
+  if( this->GetUseScales() || this->m_ScaledCostFunction->GetUseActiveParameters() )
   {
-    /** Get the ScaledCurrentPosition and divide each
-     * element through its scale. */
-    this->m_UnscaledCurrentPosition = scaledCurrentPosition;
-    this->m_ScaledCostFunction
-      ->ConvertScaledToUnscaledParameters( this->m_UnscaledCurrentPosition );
+    /** Get the ScaledCurrentPosition, divide each element through
+     * its scale and insert the active parameters in the full vector. */
+    this->m_ScaledCostFunction->ComputeUnscaledParameters(
+      scaledCurrentPosition, this->m_UnscaledCurrentPosition );
 
     return this->m_UnscaledCurrentPosition;
   }
@@ -196,13 +237,19 @@ ScaledSingleValuedNonLinearOptimizer
 ::SetCurrentPosition( const ParametersType & param )
 {
   /** Multiply the argument by the scales and set it as the
-   * the ScaledCurrentPosition.
+   * the ScaledCurrentPosition. With active parameters, the full vector
+   * provides the values of the inactive parameters.
    */
-  if( this->GetUseScales() )
+  if( this->m_ScaledCostFunction->GetUseActiveParameters() )
+  {
+    this->m_ScaledCostFunction->SetFullParameters( param );
+  }
+
+  if( this->GetUseScales() || this->m_ScaledCostFunction->GetUseActiveParameters() )
   {
-    ParametersType scaledParameters = param;
+    ParametersType scaledParameters;
     this->m_ScaledCostFunction
-      ->ConvertUnscaledToScaledParameters( scaledParameters );
+      ->ComputeScaledParameters( param, scaledParameters );
     this->SetScaledCurrentPosition( scaledParameters );
   }
   else
@@ -56,6 +56,11 @@ namespace itk
  * - The ITK convention is to set the squared scales in the optimizer.
  * So, if you want a scaling s, you must call SetScales(\f$s.*s\f$) (where .*
  * symbolises the element-wise product of \f$s\f$ with \f$s\f$)
+ * - When active parameter indices are set, only those parameters are
+ * optimized: the ScaledCurrentPosition contains the active parameters only,
+ * whereas the CurrentPosition and the InitialPosition are full parameter
+ * vectors. The inactive parameters keep their initial values. Optimizers
+ * that support this override GetSupportsActiveParameters().
  *
  */
 
@@ -86,6 +91,8 @@ public:
   typedef NonLinearOptimizer::ScalesType  ScalesType;
   typedef ScaledSingleValuedCostFunction  ScaledCostFunctionType;
   typedef ScaledCostFunctionType::Pointer ScaledCostFunctionPointer;
+  typedef ScaledCostFunctionType::ActiveParameterIndicesType
+    ActiveParameterIndicesType;
 
   /** Configure the scaled cost function. This function
    * sets the current scales in the ScaledCostFunction.
@@ -114,6 +121,25 @@ public:
    */
   const ParametersType & GetCurrentPosition( void ) const override;
 
+  /** Restrict the optimization to the parameters with these indices, in
+   * strictly increasing order. An empty vector optimizes all parameters.
+   * Call this method before StartOptimization().
+   */
+  virtual void SetActiveParameterIndices( const ActiveParameterIndicesType & indices );
+
+  /** Get the indices of the optimized parameters. */
+  const ActiveParameterIndicesType & GetActiveParameterIndices( void ) const;
+
+  /** Whether the optimizer only uses the scaled cost function and the scaled
+   * position, so that it supports active parameter indices. Optimizers that
+   * size their internal variables by the number of transform parameters do
+   * not. The default is false.
+   */
+  virtual bool GetSupportsActiveParameters( void ) const
+  {
+    return false;
+  }
+
   /** Get a pointer to the scaled cost function. */
   itkGetConstObjectMacro( ScaledCostFunction, ScaledCostFunctionType );
 
@@ -145,7 +171,9 @@ protected:
 
   /** Set the scaled current position by entering the non-scaled
    * parameters. The method multiplies param by the scales and
-   * calls SetScaledCurrentPosition.
+   * calls SetScaledCurrentPosition. With active parameters, param is
+   * the full parameter vector, which also provides the values of the
+   * inactive parameters.
    *
    * Note: It is not possible (and needed) anymore to set m_CurrentPosition.
    * Optimizers that inherit from this class should optimize the scaled
@@ -162,6 +190,14 @@ protected:
   virtual MeasureType GetScaledValue(
     const ParametersType & parameters ) const;
 
+  /** Same procedure as in GetScaledValue, for several (scaled) parameter
+   * vectors. The cost function may evaluate them concurrently, see the
+   * MultipleValuesCostFunctionInterface.
+   */
+  virtual void GetScaledValues(
+    const ScaledCostFunctionType::ParametersVectorType & parameters,
+    ScaledCostFunctionType::MeasureVectorType & values ) const;
+
   /** Divide the (scaled) parameters by the scales, call the GetDerivative routine
    * of the unscaled cost function and divide the resulting derivative by
    * the scales.
@@ -0,0 +1,171 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkStackResampleImageFilter_h
+#define itkStackResampleImageFilter_h
+
+#include "itkImageToImageFilter.h"
+#include "itkStackTransform.h"
+
+namespace itk
+{
+/** \class StackResampleImageFilter
+ * \brief Resample a stack of images slice by slice, each with the sub
+ * transform of a StackTransform, with the slices in parallel.
+ *
+ * The last dimension of the images is the stack dimension. A StackTransform
+ * maps each point with the sub transform of its last coordinate, and keeps
+ * that coordinate. This filter therefore resamples each output slice from
+ * the input slice at the same last coordinate, with a D-dimensional
+ * B-spline interpolator of the given spline order and the sub transform of
+ * the slice directly. The result equals that of a ResampleImageFilter with
+ * a ReducedDimensionBSplineInterpolateImageFunction, without the
+ * (D+1)-dimensional interpolation with order 0 in the last dimension, and
+ * with one slice per thread.
+ *
+ * The slices of the input and output are wrapped without copying. The
+ * direction cosines must not mix the last dimension with the others, see
+ * IsStackDirection(). Output slices that have no input slice at their last
+ * coordinate get the DefaultPixelValue.
+ *
+ * \ingroup GeometricTransforms
+ */
+template< class TImage, class TInterpolatorPrecisionType = double >
+class StackResampleImageFilter :
+  public ImageToImageFilter< TImage, TImage >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef StackResampleImageFilter             Self;
+  typedef ImageToImageFilter< TImage, TImage > Superclass;
+  typedef SmartPointer< Self >                 Pointer;
+  typedef SmartPointer< const Self >           ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( StackResampleImageFilter, ImageToImageFilter );
+
+  /** Dimension of the images, and of their slices. */
+  itkStaticConstMacro( ImageDimension, unsigned int, TImage::ImageDimension );
+  itkStaticConstMacro( SliceDimension, unsigned int, TImage::ImageDimension - 1 );
+
+  /** Image typedefs. */
+  typedef TImage                            ImageType;
+  typedef typename ImageType::PixelType     PixelType;
+  typedef typename ImageType::RegionType    RegionType;
+  typedef typename ImageType::SizeType      SizeType;
+  typedef typename ImageType::IndexType     IndexType;
+  typedef typename ImageType::PointType     PointType;
+  typedef typename ImageType::SpacingType   SpacingType;
+  typedef typename ImageType::DirectionType DirectionType;
+  typedef Image< PixelType,
+    itkGetStaticConstMacro( SliceDimension ) > SliceImageType;
+
+  /** The transform typedefs. */
+  typedef StackTransform< TInterpolatorPrecisionType,
+    itkGetStaticConstMacro( ImageDimension ),
+    itkGetStaticConstMacro( ImageDimension ) > StackTransformType;
+  typedef typename StackTransformType::SubTransformType SubTransformType;
+
+  /** Set/Get the stack transform. */
+  itkSetObjectMacro( StackTransform, StackTransformType );
+  itkGetModifiableObjectMacro( StackTransform, StackTransformType );
+
+  /** Set/Get the spline order of the interpolation within the slices.
+   * The default is 3.
+   */
+  itkSetClampMacro( SplineOrder, unsigned int, 0, 5 );
+  itkGetConstMacro( SplineOrder, unsigned int );
+
+  /** Set/Get the value of the output voxels that map outside the input. */
+  itkSetMacro( DefaultPixelValue, PixelType );
+  itkGetConstMacro( DefaultPixelValue, PixelType );
+
+  /** Set/Get the output grid. */
+  itkSetMacro( Size, SizeType );
+  itkGetConstReferenceMacro( Size, SizeType );
+  itkSetMacro( OutputStartIndex, IndexType );
+  itkGetConstReferenceMacro( OutputStartIndex, IndexType );
+  itkSetMacro( OutputSpacing, SpacingType );
+  itkGetConstReferenceMacro( OutputSpacing, SpacingType );
+  itkSetMacro( OutputOrigin, PointType );
+  itkGetConstReferenceMacro( OutputOrigin, PointType );
+  itkSetMacro( OutputDirection, DirectionType );
+  itkGetConstReferenceMacro( OutputDirection, DirectionType );
+
+  /** Whether direction cosines keep the last dimension separate from the
+   * others, as required for the input and the output.
+   */
+  static bool IsStackDirection( const DirectionType & direction );
+
+protected:
+
+  StackResampleImageFilter();
+  ~StackResampleImageFilter() override {}
+
+  /** Set the output grid. */
+  void GenerateOutputInformation( void ) override;
+
+  /** Request the largest possible region of the input. */
+  void GenerateInputRequestedRegion( void ) override;
+
+  /** Generate the whole output at once. */
+  void EnlargeOutputRequestedRegion( DataObject * output ) override;
+
+  /** Resample the slices in parallel. */
+  void GenerateData( void ) override;
+
+  /** Print the settings. */
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+private:
+
+  StackResampleImageFilter( const Self & ); // purposely not implemented
+  void operator=( const Self & );           // purposely not implemented
+
+  /** Resample output slice t. */
+  void ResampleSlice( const SizeValueType t ) const;
+
+  /** Wrap slice k of an image, without copying. */
+  static typename SliceImageType::Pointer CreateSliceImage(
+    const ImageType * image, const SizeValueType k );
+
+  /** The callback that resamples the slices of a work unit. */
+  static ITK_THREAD_RETURN_TYPE SliceThreaderCallback( void * arg );
+
+  typename StackTransformType::Pointer m_StackTransform;
+  unsigned int                         m_SplineOrder;
+  PixelType                            m_DefaultPixelValue;
+
+  SizeType      m_Size;
+  IndexType     m_OutputStartIndex;
+  SpacingType   m_OutputSpacing;
+  PointType     m_OutputOrigin;
+  DirectionType m_OutputDirection;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkStackResampleImageFilter.hxx"
+#endif
+
+#endif // end #ifndef itkStackResampleImageFilter_h
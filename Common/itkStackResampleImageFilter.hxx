@@ -0,0 +1,326 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkStackResampleImageFilter_hxx
+#define itkStackResampleImageFilter_hxx
+
+#include "itkStackResampleImageFilter.h"
+#include "itkBSplineInterpolateImageFunction.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkImportImageContainer.h"
+#include "itkPersistentThreadPool.h"
+#include "itkMath.h"
+
+#include <algorithm>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::StackResampleImageFilter()
+{
+  this->m_SplineOrder       = 3;
+  this->m_DefaultPixelValue = NumericTraits< PixelType >::ZeroValue();
+
+  this->m_Size.Fill( 0 );
+  this->m_OutputStartIndex.Fill( 0 );
+  this->m_OutputSpacing.Fill( 1.0 );
+  this->m_OutputOrigin.Fill( 0.0 );
+  this->m_OutputDirection.SetIdentity();
+
+} // end Constructor
+
+
+/**
+ * ******************* IsStackDirection *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+bool
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::IsStackDirection( const DirectionType & direction )
+{
+  const unsigned int last = SliceDimension;
+  for( unsigned int d = 0; d < SliceDimension; ++d )
+  {
+    if( direction[ d ][ last ] != 0.0 || direction[ last ][ d ] != 0.0 )
+    {
+      return false;
+    }
+  }
+  return direction[ last ][ last ] == 1.0;
+
+} // end IsStackDirection()
+
+
+/**
+ * ******************* GenerateOutputInformation *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::GenerateOutputInformation( void )
+{
+  /** The output does not take the information of the input. */
+  ImageType * output = this->GetOutput();
+  output->SetLargestPossibleRegion( RegionType( this->m_OutputStartIndex, this->m_Size ) );
+  output->SetSpacing( this->m_OutputSpacing );
+  output->SetOrigin( this->m_OutputOrigin );
+  output->SetDirection( this->m_OutputDirection );
+
+} // end GenerateOutputInformation()
+
+
+/**
+ * ******************* GenerateInputRequestedRegion *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::GenerateInputRequestedRegion( void )
+{
+  if( this->GetInput() != nullptr )
+  {
+    const_cast< ImageType * >( this->GetInput() )->SetRequestedRegionToLargestPossibleRegion();
+  }
+
+} // end GenerateInputRequestedRegion()
+
+
+/**
+ * ******************* EnlargeOutputRequestedRegion *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::EnlargeOutputRequestedRegion( DataObject * output )
+{
+  output->SetRequestedRegionToLargestPossibleRegion();
+
+} // end EnlargeOutputRequestedRegion()
+
+
+/**
+ * ******************* CreateSliceImage *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+typename StackResampleImageFilter< TImage, TInterpolatorPrecisionType >::SliceImageType::Pointer
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::CreateSliceImage( const ImageType * image, const SizeValueType k )
+{
+  typedef ImportImageContainer< SizeValueType, PixelType > ContainerType;
+
+  const RegionType &                     region = image->GetBufferedRegion();
+  typename SliceImageType::RegionType    sliceRegion;
+  typename SliceImageType::SpacingType   sliceSpacing;
+  typename SliceImageType::PointType     sliceOrigin;
+  typename SliceImageType::DirectionType sliceDirection;
+  for( unsigned int d = 0; d < SliceDimension; ++d )
+  {
+    sliceRegion.SetIndex( d, region.GetIndex( d ) );
+    sliceRegion.SetSize( d, region.GetSize( d ) );
+    sliceSpacing[ d ] = image->GetSpacing()[ d ];
+    sliceOrigin[ d ]  = image->GetOrigin()[ d ];
+    for( unsigned int e = 0; e < SliceDimension; ++e )
+    {
+      sliceDirection[ d ][ e ] = image->GetDirection()[ d ][ e ];
+    }
+  }
+
+  /** The slices are contiguous in memory, since the last dimension is the
+   * slowest one.
+   */
+  const SizeValueType numberOfSliceVoxels = sliceRegion.GetNumberOfPixels();
+  typename ContainerType::Pointer container = ContainerType::New();
+  container->SetImportPointer( const_cast< PixelType * >(
+    image->GetBufferPointer() ) + k * numberOfSliceVoxels, numberOfSliceVoxels, false );
+
+  typename SliceImageType::Pointer slice = SliceImageType::New();
+  slice->SetRegions( sliceRegion );
+  slice->SetSpacing( sliceSpacing );
+  slice->SetOrigin( sliceOrigin );
+  slice->SetDirection( sliceDirection );
+  slice->SetPixelContainer( container );
+  return slice;
+
+} // end CreateSliceImage()
+
+
+/**
+ * ******************* ResampleSlice *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::ResampleSlice( const SizeValueType t ) const
+{
+  typedef BSplineInterpolateImageFunction< SliceImageType,
+    TInterpolatorPrecisionType, double >                 InterpolatorType;
+  typedef typename SubTransformType::InputPointType      SubInputPointType;
+  typedef typename SubTransformType::OutputPointType     SubOutputPointType;
+
+  const ImageType *                      input       = this->GetInput();
+  const ImageType *                      output      = this->GetOutput();
+  const unsigned int                     last        = SliceDimension;
+  const typename SliceImageType::Pointer outputSlice = CreateSliceImage( output, t );
+
+  /** The last coordinate of the output slice, which the transform keeps. */
+  const double z = output->GetOrigin()[ last ]
+    + ( output->GetBufferedRegion().GetIndex( last ) + static_cast< double >( t ) ) * output->GetSpacing()[ last ];
+
+  /** The input slice at that coordinate, as for the order 0 interpolation of
+   * the ReducedDimensionBSplineInterpolateImageFunction in the last dimension.
+   */
+  const RegionType & inputRegion = input->GetBufferedRegion();
+  const double       k           = ( z - input->GetOrigin()[ last ] ) / input->GetSpacing()[ last ]
+    - inputRegion.GetIndex( last );
+  if( !( k >= -0.5 && k < inputRegion.GetSize( last ) - 0.5 ) )
+  {
+    outputSlice->FillBuffer( this->m_DefaultPixelValue );
+    return;
+  }
+  const SizeValueType inputSliceIndex = std::min< SizeValueType >(
+    Math::RoundHalfIntegerUp< SizeValueType >( k ), inputRegion.GetSize( last ) - 1 );
+
+  /** The sub transform of the slice, as selected by the StackTransform. */
+  const unsigned int numberOfSubTransforms = this->m_StackTransform->GetNumberOfSubTransforms();
+  const unsigned int subTransformIndex     = std::min( numberOfSubTransforms - 1,
+    static_cast< unsigned int >( std::max( 0, vnl_math::rnd(
+      ( z - this->m_StackTransform->GetStackOrigin() ) / this->m_StackTransform->GetStackSpacing() ) ) ) );
+  const typename SubTransformType::Pointer subTransform
+    = this->m_StackTransform->GetSubTransform( subTransformIndex );
+
+  typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
+  interpolator->SetSplineOrder( this->m_SplineOrder );
+  interpolator->SetInputImage( CreateSliceImage( input, inputSliceIndex ) );
+
+  SubInputPointType outputPoint;
+  for( ImageRegionIteratorWithIndex< SliceImageType > it( outputSlice, outputSlice->GetBufferedRegion() );
+    !it.IsAtEnd(); ++it )
+  {
+    outputSlice->TransformIndexToPhysicalPoint( it.GetIndex(), outputPoint );
+    const SubOutputPointType inputPoint = subTransform->TransformPoint( outputPoint );
+    if( interpolator->IsInsideBuffer( inputPoint ) )
+    {
+      it.Set( static_cast< PixelType >( interpolator->Evaluate( inputPoint ) ) );
+    }
+    else
+    {
+      it.Set( this->m_DefaultPixelValue );
+    }
+  }
+
+} // end ResampleSlice()
+
+
+/**
+ * ******************* SliceThreaderCallback *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+ITK_THREAD_RETURN_TYPE
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::SliceThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const Self * self = static_cast< const Self * >( infoStruct->UserData );
+
+  /** The slices are dealt out in turn, since they take equally long. */
+  const SizeValueType numberOfSlices = self->GetOutput()->GetBufferedRegion().GetSize( SliceDimension );
+  for( SizeValueType t = infoStruct->WorkUnitID; t < numberOfSlices; t += infoStruct->NumberOfWorkUnits )
+  {
+    self->ResampleSlice( t );
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end SliceThreaderCallback()
+
+
+/**
+ * ******************* GenerateData *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::GenerateData( void )
+{
+  if( this->m_StackTransform.IsNull()
+    || this->m_StackTransform->GetNumberOfSubTransforms() == 0 )
+  {
+    itkExceptionMacro( << "The stack transform is not set, or has no sub transforms." );
+  }
+  if( !IsStackDirection( this->GetInput()->GetDirection() )
+    || !IsStackDirection( this->m_OutputDirection ) )
+  {
+    itkExceptionMacro( << "The direction cosines mix the stack dimension with the others." );
+  }
+
+  ImageType * output = this->GetOutput();
+  output->SetBufferedRegion( output->GetRequestedRegion() );
+  output->Allocate();
+
+  PersistentThreadPool::Pointer pool              = PersistentThreadPool::GetInstance();
+  const SizeValueType           numberOfSlices    = output->GetBufferedRegion().GetSize( SliceDimension );
+  const SizeValueType           numberOfWorkUnits = std::max< SizeValueType >( 1, std::min< SizeValueType >(
+    std::min< SizeValueType >( pool->GetMaximumNumberOfThreads(), this->GetNumberOfWorkUnits() ),
+    numberOfSlices ) );
+  pool->SingleMethodExecute( static_cast< ThreadIdType >( numberOfWorkUnits ),
+    SliceThreaderCallback, this );
+
+} // end GenerateData()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TImage, class TInterpolatorPrecisionType >
+void
+StackResampleImageFilter< TImage, TInterpolatorPrecisionType >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "StackTransform: " << this->m_StackTransform.GetPointer() << std::endl;
+  os << indent << "SplineOrder: " << this->m_SplineOrder << std::endl;
+  os << indent << "DefaultPixelValue: "
+     << static_cast< typename NumericTraits< PixelType >::PrintType >( this->m_DefaultPixelValue ) << std::endl;
+  os << indent << "Size: " << this->m_Size << std::endl;
+  os << indent << "OutputStartIndex: " << this->m_OutputStartIndex << std::endl;
+  os << indent << "OutputSpacing: " << this->m_OutputSpacing << std::endl;
+  os << indent << "OutputOrigin: " << this->m_OutputOrigin << std::endl;
+  os << indent << "OutputDirection: " << this->m_OutputDirection << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
+
+#endif // end #ifndef itkStackResampleImageFilter_hxx
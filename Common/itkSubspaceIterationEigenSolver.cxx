@@ -0,0 +1,307 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSubspaceIterationEigenSolver_cxx
+#define __itkSubspaceIterationEigenSolver_cxx
+
+#include "itkSubspaceIterationEigenSolver.h"
+
+#ifdef ELASTIX_USE_EIGEN
+#include <Eigen/Eigenvalues>
+#else
+#include "vnl/algo/vnl_symmetric_eigensystem.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/**
+ * ******************** Constructor ********************
+ */
+
+SubspaceIterationEigenSolver
+::SubspaceIterationEigenSolver()
+{
+  this->m_NumberOfEigenPairs        = 1;
+  this->m_UseSubspaceIteration      = true;
+  this->m_RelativeTolerance         = 1e-10;
+  this->m_MaximumNumberOfIterations = 20;
+  this->m_NumberOfIterations        = 0;
+  this->m_SubspaceIterationFailed   = false;
+
+} // end Constructor
+
+
+/**
+ * ******************** SetNumberOfEigenPairs ********************
+ */
+
+void
+SubspaceIterationEigenSolver
+::SetNumberOfEigenPairs( const unsigned int numberOfEigenPairs )
+{
+  if( this->m_NumberOfEigenPairs != numberOfEigenPairs )
+  {
+    this->m_NumberOfEigenPairs = numberOfEigenPairs;
+    this->Reset();
+  }
+
+} // end SetNumberOfEigenPairs()
+
+
+/**
+ * ******************** SetUseSubspaceIteration ********************
+ */
+
+void
+SubspaceIterationEigenSolver
+::SetUseSubspaceIteration( const bool useSubspaceIteration )
+{
+  if( this->m_UseSubspaceIteration != useSubspaceIteration )
+  {
+    this->m_UseSubspaceIteration = useSubspaceIteration;
+    this->Reset();
+  }
+
+} // end SetUseSubspaceIteration()
+
+
+/**
+ * ******************** Reset ********************
+ */
+
+void
+SubspaceIterationEigenSolver
+::Reset( void )
+{
+  this->m_Subspace.clear();
+  this->m_SubspaceIterationFailed = false;
+
+} // end Reset()
+
+
+/**
+ * ******************** Compute ********************
+ */
+
+void
+SubspaceIterationEigenSolver
+::Compute( const MatrixType & K )
+{
+  const unsigned int n = K.rows();
+  const unsigned int k = std::min( this->m_NumberOfEigenPairs, n );
+
+  /** A subspace larger than k speeds up the convergence of the k-th pair. */
+  const unsigned int p = std::min( n, 2 * k + 2 );
+
+  this->m_NumberOfIterations = 0;
+  if( !this->m_UseSubspaceIteration || this->m_SubspaceIterationFailed || 2 * p > n
+    || this->m_Subspace.rows() != n || this->m_Subspace.cols() != p )
+  {
+    this->ComputeFull( K, p );
+    return;
+  }
+
+  MatrixType Q( this->m_Subspace );
+  for( unsigned int iteration = 1; iteration <= this->m_MaximumNumberOfIterations; ++iteration )
+  {
+    if( !Orthonormalize( Q ) )
+    {
+      break;
+    }
+
+    /** The Rayleigh-Ritz projection of K on the subspace. */
+    const MatrixType KQ( K * Q );
+    MatrixType       H( Q.transpose() * KQ );
+    for( unsigned int i = 0; i < p; ++i )
+    {
+      for( unsigned int j = i + 1; j < p; ++j )
+      {
+        const double h = 0.5 * ( H( i, j ) + H( j, i ) );
+        H( i, j ) = h;
+        H( j, i ) = h;
+      }
+    }
+
+    VectorType theta;
+    MatrixType Y;
+    ComputeAll( H, theta, Y );
+    const MatrixType V( Q * Y );
+    const MatrixType KV( KQ * Y );
+
+    /** Test the residuals of the wanted eigenpairs. */
+    const double scale     = std::max( std::abs( theta[ 0 ] ), std::abs( theta[ p - 1 ] ) );
+    bool         converged = true;
+    for( unsigned int j = 0; j < k && converged; ++j )
+    {
+      double squaredResidual = 0.0;
+      for( unsigned int i = 0; i < n; ++i )
+      {
+        const double r = KV( i, j ) - theta[ j ] * V( i, j );
+        squaredResidual += r * r;
+      }
+      converged = std::sqrt( squaredResidual ) <= this->m_RelativeTolerance * scale;
+    }
+
+    this->m_Subspace = V;
+    if( converged )
+    {
+      this->m_NumberOfIterations = iteration;
+      this->m_EigenValues        = theta.extract( k );
+      this->m_EigenVectors       = V.extract( n, k );
+      return;
+    }
+
+    /** The next subspace is spanned by K times the Ritz vectors. */
+    Q = KV;
+  }
+
+  this->m_SubspaceIterationFailed = true;
+  this->ComputeFull( K, p );
+
+} // end Compute()
+
+
+/**
+ * ******************** ComputeFull ********************
+ */
+
+void
+SubspaceIterationEigenSolver
+::ComputeFull( const MatrixType & K, const unsigned int subspaceDimension )
+{
+  const unsigned int n = K.rows();
+  const unsigned int k = std::min( this->m_NumberOfEigenPairs, n );
+
+  VectorType eigenValues;
+  MatrixType eigenVectors;
+  ComputeAll( K, eigenValues, eigenVectors );
+
+  this->m_EigenValues  = eigenValues.extract( k );
+  this->m_EigenVectors = eigenVectors.extract( n, k );
+  if( this->m_UseSubspaceIteration )
+  {
+    this->m_Subspace = eigenVectors.extract( n, subspaceDimension );
+  }
+
+} // end ComputeFull()
+
+
+/**
+ * ******************** ComputeAll ********************
+ */
+
+void
+SubspaceIterationEigenSolver
+::ComputeAll( const MatrixType & K, VectorType & eigenValues,
+  MatrixType & eigenVectors )
+{
+  const unsigned int n = K.rows();
+  eigenValues.set_size( n );
+  eigenVectors.set_size( n, n );
+  if( n == 0 )
+  {
+    return;
+  }
+
+  /** Both solvers return the eigenvalues in ascending order. */
+#ifdef ELASTIX_USE_EIGEN
+  typedef Eigen::Matrix< double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor > EigenMatrixType;
+  const Eigen::Map< const EigenMatrixType >               map( K.data_block(), n, n );
+  const Eigen::SelfAdjointEigenSolver< Eigen::MatrixXd > eig( map );
+  for( unsigned int i = 0; i < n; ++i )
+  {
+    eigenValues[ i ] = eig.eigenvalues()[ n - 1 - i ];
+    for( unsigned int r = 0; r < n; ++r )
+    {
+      eigenVectors( r, i ) = eig.eigenvectors()( r, n - 1 - i );
+    }
+  }
+#else
+  const vnl_symmetric_eigensystem< double > eig( K );
+  for( unsigned int i = 0; i < n; ++i )
+  {
+    eigenValues[ i ] = eig.get_eigenvalue( n - 1 - i );
+    eigenVectors.set_column( i, eig.get_eigenvector( n - 1 - i ).normalize() );
+  }
+#endif
+
+} // end ComputeAll()
+
+
+/**
+ * ******************** Orthonormalize ********************
+ */
+
+bool
+SubspaceIterationEigenSolver
+::Orthonormalize( MatrixType & Q )
+{
+  const unsigned int n = Q.rows();
+  const unsigned int p = Q.cols();
+  for( unsigned int j = 0; j < p; ++j )
+  {
+    double originalNorm = 0.0;
+    for( unsigned int r = 0; r < n; ++r )
+    {
+      originalNorm += Q( r, j ) * Q( r, j );
+    }
+    originalNorm = std::sqrt( originalNorm );
+
+    /** Orthogonalize twice, which makes the result orthogonal to working precision. */
+    for( unsigned int pass = 0; pass < 2; ++pass )
+    {
+      for( unsigned int i = 0; i < j; ++i )
+      {
+        double dot = 0.0;
+        for( unsigned int r = 0; r < n; ++r )
+        {
+          dot += Q( r, i ) * Q( r, j );
+        }
+        for( unsigned int r = 0; r < n; ++r )
+        {
+          Q( r, j ) -= dot * Q( r, i );
+        }
+      }
+    }
+
+    double norm = 0.0;
+    for( unsigned int r = 0; r < n; ++r )
+    {
+      norm += Q( r, j ) * Q( r, j );
+    }
+    norm = std::sqrt( norm );
+    if( !( norm > 1e-12 * originalNorm ) )
+    {
+      return false;
+    }
+    for( unsigned int r = 0; r < n; ++r )
+    {
+      Q( r, j ) /= norm;
+    }
+  }
+  return true;
+
+} // end Orthonormalize()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkSubspaceIterationEigenSolver_cxx
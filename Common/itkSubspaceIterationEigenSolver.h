@@ -0,0 +1,179 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkSubspaceIterationEigenSolver_h
+#define __itkSubspaceIterationEigenSolver_h
+
+#include "vnl/vnl_matrix.h"
+#include "vnl/vnl_vector.h"
+
+namespace itk
+{
+
+/** \class SubspaceIterationEigenSolver
+ *
+ * \brief Computes the largest eigenvalues and their eigenvectors of a
+ * symmetric matrix, starting from the subspace of the previous call.
+ *
+ * The groupwise metrics compute the eigenvalues of a correlation matrix of
+ * the time points every iteration. This matrix changes little between the
+ * iterations of the optimizer, so the eigenvectors of the previous iteration
+ * are a good start for the next one. Compute() refines this subspace by
+ * subspace iteration with Rayleigh-Ritz projections. It needs a few products
+ * with the matrix instead of a full eigendecomposition. When it has no
+ * previous subspace, or when the subspace is too large compared to the
+ * matrix, it computes the full eigendecomposition instead.
+ *
+ * The convergence is slow when the wanted eigenvalues are close to the
+ * next ones. When the iteration does not converge, Compute() computes the
+ * full eigendecomposition, and keeps doing so until the next Reset(), so
+ * that such matrices do not cost the failed iterations every call.
+ *
+ * An eigenpair has converged when the norm of its residual K v - lambda v
+ * is at most the RelativeTolerance times the largest eigenvalue in absolute
+ * value.
+ *
+ * ComputeAll() computes all eigenvalues and eigenvectors. It uses Eigen
+ * when elastix is built with ELASTIX_USE_EIGEN, and vnl otherwise.
+ *
+ * \ingroup Metrics
+ */
+
+class SubspaceIterationEigenSolver
+{
+public:
+
+  typedef vnl_matrix< double > MatrixType;
+  typedef vnl_vector< double > VectorType;
+
+  SubspaceIterationEigenSolver();
+
+  /** Set/Get the number of eigenpairs to compute. The default is 1. */
+  void SetNumberOfEigenPairs( const unsigned int numberOfEigenPairs );
+
+  unsigned int GetNumberOfEigenPairs( void ) const
+  {
+    return this->m_NumberOfEigenPairs;
+  }
+
+
+  /** Set/Get whether to use the subspace iteration. If false, Compute()
+   * always computes the full eigendecomposition. The default is true.
+   */
+  void SetUseSubspaceIteration( const bool useSubspaceIteration );
+
+  bool GetUseSubspaceIteration( void ) const
+  {
+    return this->m_UseSubspaceIteration;
+  }
+
+
+  /** Set/Get the relative tolerance on the residuals. The default is 1e-10. */
+  void SetRelativeTolerance( const double tolerance )
+  {
+    this->m_RelativeTolerance = tolerance;
+  }
+
+
+  double GetRelativeTolerance( void ) const
+  {
+    return this->m_RelativeTolerance;
+  }
+
+
+  /** Set/Get the maximum number of iterations. The default is 20. */
+  void SetMaximumNumberOfIterations( const unsigned int maximumNumberOfIterations )
+  {
+    this->m_MaximumNumberOfIterations = maximumNumberOfIterations;
+  }
+
+
+  unsigned int GetMaximumNumberOfIterations( void ) const
+  {
+    return this->m_MaximumNumberOfIterations;
+  }
+
+
+  /** Forget the subspace of the previous calls, and whether the subspace
+   * iteration did not converge.
+   */
+  void Reset( void );
+
+  /** Compute the largest eigenvalues and eigenvectors of the symmetric
+   * matrix K.
+   */
+  void Compute( const MatrixType & K );
+
+  /** Get the eigenvalues of the last call of Compute(), in descending order. */
+  const VectorType & GetEigenValues( void ) const
+  {
+    return this->m_EigenValues;
+  }
+
+
+  /** Get the normalized eigenvectors of the last call of Compute(), as the
+   * columns of a matrix, in the order of the eigenvalues.
+   */
+  const MatrixType & GetEigenVectors( void ) const
+  {
+    return this->m_EigenVectors;
+  }
+
+
+  /** Get the number of subspace iterations of the last call of Compute().
+   * It is zero if the full eigendecomposition was computed.
+   */
+  unsigned int GetNumberOfIterations( void ) const
+  {
+    return this->m_NumberOfIterations;
+  }
+
+
+  /** Compute all eigenvalues of the symmetric matrix K, in descending order,
+   * and their normalized eigenvectors, as the columns of a matrix.
+   */
+  static void ComputeAll( const MatrixType & K, VectorType & eigenValues,
+    MatrixType & eigenVectors );
+
+private:
+
+  /** Compute the full eigendecomposition and keep the leading subspace. */
+  void ComputeFull( const MatrixType & K, const unsigned int subspaceDimension );
+
+  /** Orthonormalize the columns of Q by modified Gram-Schmidt. Return false
+   * if they are numerically dependent.
+   */
+  static bool Orthonormalize( MatrixType & Q );
+
+  unsigned int m_NumberOfEigenPairs;
+  bool         m_UseSubspaceIteration;
+  double       m_RelativeTolerance;
+  unsigned int m_MaximumNumberOfIterations;
+  unsigned int m_NumberOfIterations;
+  bool         m_SubspaceIterationFailed;
+
+  /** The orthonormal Ritz vectors of the last call, used as the start. */
+  MatrixType m_Subspace;
+
+  VectorType m_EigenValues;
+  MatrixType m_EigenVectors;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkSubspaceIterationEigenSolver_h
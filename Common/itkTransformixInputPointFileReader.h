@@ -22,6 +22,7 @@
 #include "itkMeshFileReaderBase.h"
 
 #include <fstream>
+#include <vector>
 
 namespace itk
 {
@@ -40,6 +41,13 @@ namespace itk
  *
  * The second word in the text file represents the number of points that
  * should be read.
+ *
+ * A file with the extension .bin holds the points in world coordinates,
+ * as raw little endian doubles, PointDimension per point. The number of
+ * points follows from the size of the file.
+ *
+ * Large files can be read in chunks with ReadPoints(), after
+ * UpdateOutputInformation(), without filling the output.
  **/
 
 template< class TOutputMesh >
@@ -63,6 +71,7 @@ public:
   typedef typename Superclass::DataObjectPointer DatabObjectPointer;
   typedef typename Superclass::OutputMeshType    OutputMeshType;
   typedef typename Superclass::OutputMeshPointer OutputMeshPointer;
+  typedef typename OutputMeshType::PointType     PointType;
 
   /** Get whether the read points are indices; actually we should store this as a kind
    * of meta data in the output, but i don't understand this concept yet...
@@ -87,6 +96,13 @@ public:
    */
   void GenerateOutputInformation( void ) override;
 
+  /** Read the next points of the file, at most maximumNumberOfPoints, into
+   * points, and return the number of points read. Zero is returned when all
+   * points have been read. Call UpdateOutputInformation() first.
+   */
+  unsigned long ReadPoints( std::vector< PointType > & points,
+    const unsigned long maximumNumberOfPoints );
+
 protected:
 
   TransformixInputPointFileReader();
@@ -96,7 +112,9 @@ protected:
   void GenerateData( void ) override;
 
   unsigned long m_NumberOfPoints;
+  unsigned long m_NumberOfPointsRead;
   bool          m_PointsAreIndices;
+  bool          m_PointsAreBinary;
 
   std::ifstream m_Reader;
 
@@ -20,6 +20,10 @@
 #define __itkTransformixInputPointFileReader_hxx
 
 #include "itkTransformixInputPointFileReader.h"
+#include "itkByteSwapper.h"
+#include <itksys/SystemTools.hxx>
+
+#include <algorithm>
 
 namespace itk
 {
@@ -32,8 +36,10 @@ template< class TOutputMesh >
 TransformixInputPointFileReader< TOutputMesh >
 ::TransformixInputPointFileReader()
 {
-  this->m_NumberOfPoints   = 0;
-  this->m_PointsAreIndices = false;
+  this->m_NumberOfPoints     = 0;
+  this->m_NumberOfPointsRead = 0;
+  this->m_PointsAreIndices   = false;
+  this->m_PointsAreBinary    = false;
 } // end constructor
 
 
@@ -69,6 +75,35 @@ TransformixInputPointFileReader< TOutputMesh >
   {
     this->m_Reader.close();
   }
+  this->m_NumberOfPointsRead = 0;
+  this->m_PointsAreBinary
+    = itksys::SystemTools::StringEndsWith( this->m_FileName.c_str(), ".bin" )
+    || itksys::SystemTools::StringEndsWith( this->m_FileName.c_str(), ".BIN" );
+
+  /** A binary file holds world coordinates only. */
+  if( this->m_PointsAreBinary )
+  {
+    this->m_Reader.open( this->m_FileName.c_str(), std::ios::in | std::ios::binary );
+    this->m_Reader.seekg( 0, std::ios::end );
+    const std::streamoff fileSize     = this->m_Reader.tellg();
+    const std::streamoff bytesPerPoint
+      = static_cast< std::streamoff >( OutputMeshType::PointDimension * sizeof( double ) );
+    this->m_Reader.seekg( 0, std::ios::beg );
+    if( !this->m_Reader || fileSize % bytesPerPoint != 0 )
+    {
+      std::ostringstream msg;
+      msg << "The size of the binary point file is not a multiple of "
+          << bytesPerPoint << " bytes."
+          << std::endl << "Filename: " << this->m_FileName
+          << std::endl;
+      MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
+      throw e;
+    }
+    this->m_PointsAreIndices = false;
+    this->m_NumberOfPoints   = static_cast< unsigned long >( fileSize / bytesPerPoint );
+    return;
+  }
+
   this->m_Reader.open( this->m_FileName.c_str() );
 
   /** Read the first entry */
@@ -111,64 +146,120 @@ TransformixInputPointFileReader< TOutputMesh >
 {
   typedef typename OutputMeshType::PointsContainer PointsContainerType;
   typedef typename PointsContainerType::Pointer    PointsContainerPointer;
-  typedef typename OutputMeshType::PointType       PointType;
-  const unsigned int dimension = OutputMeshType::PointDimension;
 
   OutputMeshPointer      output = this->GetOutput();
   PointsContainerPointer points = PointsContainerType::New();
 
   /** Read the file */
-  if( this->m_Reader.is_open() )
+  std::vector< PointType > chunk;
+  while( this->ReadPoints( chunk, 1UL << 16 ) > 0 )
+  {
+    for( const auto & point : chunk )
+    {
+      points->push_back( point );
+    }
+  }
+
+  /** set in output */
+  output->Initialize();
+  output->SetPoints( points );
+
+  /** Close the reader */
+  this->m_Reader.close();
+
+  /** This indicates that the current BufferedRegion is equal to the
+   * requested region. This action prevents useless re-executions of
+   * the pipeline.
+   * (I copied this from the BinaryMaskToNarrowBandPointSetFilter) */
+  output->SetBufferedRegion( output->GetRequestedRegion() );
+
+} // end GenerateData()
+
+
+/**
+ * ***************ReadPoints ***********
+ */
+
+template< class TOutputMesh >
+unsigned long
+TransformixInputPointFileReader< TOutputMesh >
+::ReadPoints( std::vector< PointType > & points,
+  const unsigned long maximumNumberOfPoints )
+{
+  const unsigned int dimension = OutputMeshType::PointDimension;
+
+  const unsigned long numberOfPoints = std::min( maximumNumberOfPoints,
+    this->m_NumberOfPoints - this->m_NumberOfPointsRead );
+  points.resize( numberOfPoints );
+  if( numberOfPoints == 0 )
   {
-    for( unsigned int i = 0; i < this->m_NumberOfPoints; ++i )
+    return 0;
+  }
+
+  if( !this->m_Reader.is_open() )
+  {
+    std::ostringstream msg;
+    msg << "The file has unexpectedly been closed. "
+        << std::endl << "Filename: " << this->m_FileName
+        << std::endl;
+    MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
+    throw e;
+  }
+
+  bool fileIsLargeEnough = true;
+  if( this->m_PointsAreBinary )
+  {
+    std::vector< double > values( numberOfPoints * dimension );
+    this->m_Reader.read( reinterpret_cast< char * >( values.data() ),
+      static_cast< std::streamsize >( values.size() * sizeof( double ) ) );
+    fileIsLargeEnough = !this->m_Reader.fail();
+    ByteSwapper< double >::SwapRangeFromSystemToLittleEndian( values.data(), values.size() );
+    for( unsigned long i = 0; i < numberOfPoints; ++i )
+    {
+      for( unsigned int j = 0; j < dimension; j++ )
+      {
+        points[ i ][ j ] = values[ i * dimension + j ];
+      }
+    }
+  }
+  else
+  {
+    for( unsigned long i = 0; i < numberOfPoints && fileIsLargeEnough; ++i )
     {
       // read point from textfile
-      PointType point;
       for( unsigned int j = 0; j < dimension; j++ )
       {
         if( !this->m_Reader.eof() )
         {
-          this->m_Reader >> point[ j ];
+          this->m_Reader >> points[ i ][ j ];
         }
         else
         {
-          std::ostringstream msg;
-          msg << "The file is not large enough. "
-              << std::endl << "Filename: " << this->m_FileName
-              << std::endl;
-          MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
-          throw e;
-          return;
+          fileIsLargeEnough = false;
+          break;
         }
       }
-      points->push_back( point );
     }
   }
-  else
+
+  if( !fileIsLargeEnough )
   {
     std::ostringstream msg;
-    msg << "The file has unexpectedly been closed. "
+    msg << "The file is not large enough. "
         << std::endl << "Filename: " << this->m_FileName
         << std::endl;
     MeshFileReaderException e( __FILE__, __LINE__, msg.str().c_str(), ITK_LOCATION );
     throw e;
-    return;
   }
 
-  /** set in output */
-  output->Initialize();
-  output->SetPoints( points );
-
-  /** Close the reader */
-  this->m_Reader.close();
-
-  /** This indicates that the current BufferedRegion is equal to the
-   * requested region. This action prevents useless re-executions of
-   * the pipeline.
-   * (I copied this from the BinaryMaskToNarrowBandPointSetFilter) */
-  output->SetBufferedRegion( output->GetRequestedRegion() );
+  this->m_NumberOfPointsRead += numberOfPoints;
+  if( this->m_NumberOfPointsRead == this->m_NumberOfPoints )
+  {
+    this->m_Reader.close();
+  }
+  return numberOfPoints;
 
-} // end GenerateData()
+} // end ReadPoints()
 
 
 } // end namespace itk
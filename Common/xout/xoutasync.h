@@ -0,0 +1,163 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __xoutasync_h
+#define __xoutasync_h
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xoutlibrary
+{
+using namespace std;
+
+/**
+ * \class xoutasyncbuf
+ * \brief A stream buffer that writes to a target stream in a background
+ * thread.
+ *
+ * Writing to the buffer only copies the characters. At every flush, the
+ * characters written since the previous flush are handed to a background
+ * thread, under a mutex, which writes them to the target and flushes it.
+ * The caller therefore does not wait for the file system, which for the
+ * many small flushes of the iteration info of elastix takes a considerable
+ * part of the run time. The characters arrive at the target unchanged and
+ * in order. Destroying the buffer, or calling Close(), writes the remaining
+ * characters and stops the thread.
+ *
+ * Like a file buffer, the buffer may be written by one thread at a time.
+ *
+ * \ingroup xout
+ */
+
+template< class charT, class traits = char_traits< charT > >
+class xoutasyncbuf : public basic_streambuf< charT, traits >
+{
+public:
+
+  /** Typedef's. */
+  typedef xoutasyncbuf                            Self;
+  typedef basic_streambuf< charT, traits >        Superclass;
+  typedef typename Superclass::char_type          char_type;
+  typedef typename Superclass::int_type           int_type;
+  typedef typename Superclass::traits_type        traits_type;
+  typedef basic_ostream< charT, traits >          ostream_type;
+  typedef basic_string< charT, traits >           string_type;
+
+  /** Constructor */
+  xoutasyncbuf();
+
+  /** Destructor */
+  ~xoutasyncbuf() override;
+
+  /** Start writing to target in the background thread. The target has to
+   * exist until Close() is called.
+   */
+  void Open( ostream_type * target );
+
+  /** Write the remaining characters to the target and stop the thread. */
+  void Close( void );
+
+protected:
+
+  /** Move the put area to the pending characters, and store c. */
+  int_type overflow( int_type c ) override;
+
+  /** Hand the pending characters to the background thread. */
+  int sync( void ) override;
+
+private:
+
+  xoutasyncbuf( const Self & ) = delete;
+  Self & operator=( const Self & ) = delete;
+
+  /** Append the put area to the pending characters. */
+  void MovePutArea( void );
+
+  /** The loop of the background thread. */
+  void WriterThread( void );
+
+  vector< char_type > m_PutArea;
+  string_type         m_Pending;
+  ostream_type *      m_Target;
+  thread              m_Thread;
+
+  /** Protects the members below. */
+  mutex                 m_Mutex;
+  condition_variable    m_Condition;
+  vector< string_type > m_Queue;
+  bool                  m_Stop;
+
+};
+
+
+/**
+ * \class xoutasyncofstream
+ * \brief An output file stream that writes in a background thread.
+ *
+ * The file is written by an xoutasyncbuf. It replaces an ofstream as the
+ * logfile output of xout.
+ *
+ * \ingroup xout
+ */
+
+template< class charT, class traits = char_traits< charT > >
+class xoutasyncofstream : public basic_ostream< charT, traits >
+{
+public:
+
+  /** Typedef's. */
+  typedef xoutasyncofstream               Self;
+  typedef basic_ostream< charT, traits >  Superclass;
+  typedef xoutasyncbuf< charT, traits >   buffer_type;
+  typedef basic_ofstream< charT, traits > file_type;
+
+  /** Constructor */
+  xoutasyncofstream();
+
+  /** Destructor */
+  ~xoutasyncofstream() override;
+
+  /** Open the file, and start the background thread if it could be opened. */
+  void open( const char * filename );
+
+  bool is_open( void ) const;
+
+  /** Write the remaining characters, stop the thread and close the file. */
+  void close( void );
+
+private:
+
+  xoutasyncofstream( const Self & ) = delete;
+  Self & operator=( const Self & ) = delete;
+
+  file_type   m_File;
+  buffer_type m_Buffer;
+
+};
+
+} // end namespace xoutlibrary
+
+#include "xoutasync.hxx"
+
+#endif // end #ifndef __xoutasync_h
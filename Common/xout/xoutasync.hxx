@@ -0,0 +1,264 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __xoutasync_hxx
+#define __xoutasync_hxx
+
+#include "xoutasync.h"
+
+namespace xoutlibrary
+{
+using namespace std;
+
+/**
+ * ************************ Constructor *************************
+ */
+
+template< class charT, class traits >
+xoutasyncbuf< charT, traits >::xoutasyncbuf() :
+  m_PutArea( 4096 ),
+  m_Target( 0 ),
+  m_Stop( false )
+{
+  this->setp( this->m_PutArea.data(), this->m_PutArea.data() + this->m_PutArea.size() );
+
+} // end Constructor
+
+
+/**
+ * ********************* Destructor *****************************
+ */
+
+template< class charT, class traits >
+xoutasyncbuf< charT, traits >::~xoutasyncbuf()
+{
+  this->Close();
+
+} // end Destructor
+
+
+/**
+ * ************************ Open ********************************
+ */
+
+template< class charT, class traits >
+void
+xoutasyncbuf< charT, traits >::Open( ostream_type * target )
+{
+  this->Close();
+
+  this->m_Target = target;
+  this->m_Stop   = false;
+  this->m_Thread = thread( &Self::WriterThread, this );
+
+} // end Open
+
+
+/**
+ * ************************ Close *******************************
+ */
+
+template< class charT, class traits >
+void
+xoutasyncbuf< charT, traits >::Close( void )
+{
+  if( !this->m_Thread.joinable() )
+  {
+    return;
+  }
+
+  this->sync();
+  {
+    lock_guard< mutex > lock( this->m_Mutex );
+    this->m_Stop = true;
+  }
+  this->m_Condition.notify_one();
+  this->m_Thread.join();
+  this->m_Target = 0;
+
+} // end Close
+
+
+/**
+ * ************************ overflow ****************************
+ */
+
+template< class charT, class traits >
+typename xoutasyncbuf< charT, traits >::int_type
+xoutasyncbuf< charT, traits >::overflow( int_type c )
+{
+  this->MovePutArea();
+  if( !traits_type::eq_int_type( c, traits_type::eof() ) )
+  {
+    this->m_Pending.push_back( traits_type::to_char_type( c ) );
+  }
+  return traits_type::not_eof( c );
+
+} // end overflow
+
+
+/**
+ * ************************ sync ********************************
+ */
+
+template< class charT, class traits >
+int
+xoutasyncbuf< charT, traits >::sync( void )
+{
+  this->MovePutArea();
+  if( this->m_Pending.empty() || !this->m_Thread.joinable() )
+  {
+    /** Nothing is written before Open(). */
+    this->m_Pending.clear();
+    return 0;
+  }
+
+  {
+    lock_guard< mutex > lock( this->m_Mutex );
+    this->m_Queue.push_back( string_type() );
+    this->m_Queue.back().swap( this->m_Pending );
+  }
+  this->m_Condition.notify_one();
+  return 0;
+
+} // end sync
+
+
+/**
+ * ************************ MovePutArea *************************
+ */
+
+template< class charT, class traits >
+void
+xoutasyncbuf< charT, traits >::MovePutArea( void )
+{
+  this->m_Pending.append( this->pbase(), this->pptr() );
+  this->setp( this->m_PutArea.data(), this->m_PutArea.data() + this->m_PutArea.size() );
+
+} // end MovePutArea
+
+
+/**
+ * ************************ WriterThread ************************
+ *
+ * Writes the queued strings in order, and flushes the target once per
+ * batch of strings.
+ */
+
+template< class charT, class traits >
+void
+xoutasyncbuf< charT, traits >::WriterThread( void )
+{
+  vector< string_type > batch;
+  bool                  stop = false;
+  while( !stop )
+  {
+    {
+      unique_lock< mutex > lock( this->m_Mutex );
+      this->m_Condition.wait( lock, [this] { return this->m_Stop || !this->m_Queue.empty(); } );
+      batch.swap( this->m_Queue );
+      stop = this->m_Stop;
+    }
+
+    for( typename vector< string_type >::const_iterator it = batch.begin();
+      it != batch.end(); ++it )
+    {
+      this->m_Target->write( it->data(), static_cast< streamsize >( it->size() ) );
+    }
+    this->m_Target->flush();
+    batch.clear();
+  }
+
+} // end WriterThread
+
+
+/**
+ * ************************ Constructor *************************
+ */
+
+template< class charT, class traits >
+xoutasyncofstream< charT, traits >::xoutasyncofstream() :
+  Superclass( 0 )
+{
+  this->init( &this->m_Buffer );
+
+} // end Constructor
+
+
+/**
+ * ********************* Destructor *****************************
+ */
+
+template< class charT, class traits >
+xoutasyncofstream< charT, traits >::~xoutasyncofstream()
+{
+  this->close();
+
+} // end Destructor
+
+
+/**
+ * ************************ open ********************************
+ */
+
+template< class charT, class traits >
+void
+xoutasyncofstream< charT, traits >::open( const char * filename )
+{
+  this->close();
+  this->m_File.open( filename );
+  if( this->m_File.is_open() )
+  {
+    this->m_Buffer.Open( &this->m_File );
+  }
+
+} // end open
+
+
+/**
+ * ************************ is_open *****************************
+ */
+
+template< class charT, class traits >
+bool
+xoutasyncofstream< charT, traits >::is_open( void ) const
+{
+  return this->m_File.is_open();
+
+} // end is_open
+
+
+/**
+ * ************************ close *******************************
+ */
+
+template< class charT, class traits >
+void
+xoutasyncofstream< charT, traits >::close( void )
+{
+  this->m_Buffer.Close();
+  if( this->m_File.is_open() )
+  {
+    this->m_File.close();
+  }
+
+} // end close
+
+
+} // end namespace xoutlibrary
+
+#endif // end #ifndef __xoutasync_hxx
@@ -60,6 +60,7 @@ public:
   typedef typename Superclass::XStreamMapEntryType    XStreamMapEntryType;
 
   typedef std::basic_ostringstream< charT, traits > InternalBufferType;
+  typedef std::basic_string< charT, traits >        StringType;
 
   /** Constructors */
   xoutcell();
@@ -70,6 +71,9 @@ public:
   /** Write the buffered cell data to the outputs. */
   void WriteBufferedData( void ) override;
 
+  /** Get the buffered cell data, without sending it to the outputs. */
+  virtual StringType GetBufferedData( void ) const;
+
 protected:
 
   InternalBufferType m_InternalBuffer;
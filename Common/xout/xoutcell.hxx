@@ -86,6 +86,19 @@ xoutcell< charT, traits >::WriteBufferedData( void )
 } // end WriteBufferedData
 
 
+/**
+ * ******************** GetBufferedData *************************
+ */
+
+template< class charT, class traits >
+typename xoutcell< charT, traits >::StringType
+xoutcell< charT, traits >::GetBufferedData( void ) const
+{
+  return this->m_InternalBuffer.str();
+
+} // end GetBufferedData
+
+
 } // end namespace xoutlibrary
 
 #endif // end #ifndef __xoutcell_hxx
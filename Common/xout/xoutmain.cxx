@@ -23,11 +23,12 @@
 namespace xoutlibrary
 {
 static xoutbase_type * local_xout = 0;
+static thread_local xoutbase_type * thread_xout = 0;
 
 xoutbase_type &
 get_xout( void )
 {
-  return *local_xout;
+  return thread_xout ? *thread_xout : *local_xout;
 }
 
 
@@ -37,8 +38,17 @@ set_xout( xoutbase_type * arg )
   local_xout = arg;
 }
 
+xoutbase_type *
+set_thread_xout( xoutbase_type * arg )
+{
+  xoutbase_type * previous = thread_xout;
+  thread_xout = arg;
+  return previous;
+}
+
+
 bool xout_valid() {
-  return local_xout != 0;
+  return thread_xout != 0 || local_xout != 0;
 }
 
 
@@ -23,6 +23,7 @@
 #include "xoutsimple.h"
 #include "xoutrow.h"
 #include "xoutcell.h"
+#include "xoutasync.h"
 
 /** Define a namespace alias. */
 namespace xl = xoutlibrary;
@@ -37,10 +38,17 @@ typedef xoutsimple< char > xoutsimple_type;
 typedef xoutrow< char >    xoutrow_type;
 typedef xoutcell< char >   xoutcell_type;
 
+typedef xoutasyncofstream< char > xoutasyncofstream_type;
+
 xoutbase_type & get_xout( void );
 
 void set_xout( xoutbase_type * arg );
 
+/** Set the xout of the calling thread only. get_xout() returns it instead
+ * of the one set by set_xout(), until it is set to null again. Returns the
+ * previous xout of the calling thread. */
+xoutbase_type * set_thread_xout( xoutbase_type * arg );
+
 bool xout_valid();
 
 } // end namespace xoutlibrary
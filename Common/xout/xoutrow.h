@@ -21,6 +21,8 @@
 #include "xoutbase.h"
 #include "xoutcell.h"
 #include <sstream>
+#include <vector>
+#include <vector>
 
 namespace xoutlibrary
 {
@@ -63,7 +65,8 @@ public:
   typedef typename Superclass::XStreamMapEntryType    XStreamMapEntryType;
 
   /** Extra typedefs */
-  typedef xoutcell< charT, traits > XOutCellType;
+  typedef xoutcell< charT, traits >         XOutCellType;
+  typedef typename XOutCellType::StringType StringType;
 
   /** Constructor */
   xoutrow();
@@ -82,6 +85,13 @@ public:
    */
   virtual void WriteHeaders( void );
 
+  /** Get the names of the target cells and their buffered data, in the
+   * order in which WriteBufferedData() writes them. The data of target
+   * cells that are not an xoutcell is empty. The cells are not emptied.
+   */
+  virtual void GetBufferedData( std::vector< StringType > & names,
+    std::vector< StringType > & data ) const;
+
   /** This method adds an xoutcell to the map of Targets. */
   int AddTargetCell( const char * name ) override;
 
@@ -90,6 +90,32 @@ xoutrow< charT, traits >
 } // end WriteBufferedData()
 
 
+/**
+ * ******************** GetBufferedData *************************
+ */
+
+template< class charT, class traits >
+void
+xoutrow< charT, traits >
+::GetBufferedData( std::vector< StringType > & names,
+  std::vector< StringType > & data ) const
+{
+  names.clear();
+  data.clear();
+  names.reserve( this->m_XTargetCells.size() );
+  data.reserve( this->m_XTargetCells.size() );
+
+  for( typename XStreamMapType::const_iterator xit = this->m_XTargetCells.begin();
+    xit != this->m_XTargetCells.end(); ++xit )
+  {
+    names.push_back( xit->first );
+    const XOutCellType * cell = dynamic_cast< const XOutCellType * >( xit->second );
+    data.push_back( cell != 0 ? cell->GetBufferedData() : StringType() );
+  }
+
+} // end GetBufferedData()
+
+
 /**
  * ******************** AddTargetCell ***************************
  */
@@ -61,10 +61,21 @@ namespace elastix
  *    at once, or per resolution. Latter saves memory.\n
  *    example: <tt>(ComputePyramidImagesPerResolution "true")</tt>\n
  *    Default false.
+ * \parameter ComputePyramidImagesInBackground: Flag to specify if the pyramid image of the next
+ *    resolution is computed on a background thread, during the current resolution. Only used if
+ *    ComputePyramidImagesPerResolution is true. The first resolution then starts after the coarsest
+ *    pyramid image is computed, instead of after all.\n
+ *    example: <tt>(ComputePyramidImagesInBackground "true")</tt>\n
+ *    Default false.
  * \parameter ImagePyramidUseShrinkImageFilter: Flag to specify if the ShrinkingImageFilter is used
  *    for rescaling the image, or the ResampleImageFilter. Skrinker is faster.\n
  *    example: <tt>(ImagePyramidUseShrinkImageFilter "true")</tt>\n
  *    Default false, so by default the resampler is used.
+ * \parameter ImagePyramidUseCascadedComputation: Flag to specify if each resolution level is computed
+ *    from the next finer level, instead of from the input image. This is faster, since the large
+ *    sigmas are applied at a coarse resolution. Not used if ComputePyramidImagesPerResolution is true.\n
+ *    example: <tt>(ImagePyramidUseCascadedComputation "true")</tt>\n
+ *    Default false.
  *
  * \ingroup ImagePyramids
  */
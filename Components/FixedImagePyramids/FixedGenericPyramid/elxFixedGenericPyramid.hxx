@@ -144,6 +144,12 @@ FixedGenericPyramid< TElastix >
     "ImagePyramidUseShrinkImageFilter", 0, false );
   this->SetUseShrinkImageFilter( useShrinkImageFilter );
 
+  /** Compute each level from the next finer level, or from the input. */
+  bool useCascadedComputation = false;
+  this->m_Configuration->ReadParameter( useCascadedComputation,
+    "ImagePyramidUseCascadedComputation", 0, false );
+  this->SetUseCascadedComputation( useCascadedComputation );
+
   /** Decide whether or not to compute the pyramid images only for the current
    * resolution. Setting the option to true saves memory, since only one level
    * of the pyramid gets allocated per resolution.
@@ -153,6 +159,14 @@ FixedGenericPyramid< TElastix >
     "ComputePyramidImagesPerResolution", 0, false );
   this->SetComputeOnlyForCurrentLevel( computeThisResolution );
 
+  /** Decide whether or not to compute the pyramid image of the next
+   * resolution in the background, during the current resolution.
+   */
+  bool computeInBackground = false;
+  this->m_Configuration->ReadParameter( computeInBackground,
+    "ComputePyramidImagesInBackground", 0, false );
+  this->SetComputeNextLevelInBackground( computeInBackground );
+
 } // end SetFixedSchedule()
 
 
@@ -22,6 +22,29 @@
 #include "elxFixedShrinkingPyramid.h"
 
 namespace elastix
-{} // end namespace elastix
+{
+
+/**
+ * ******************* SetFixedSchedule ***********************
+ */
+
+template< class TElastix >
+void
+FixedShrinkingPyramid< TElastix >
+::SetFixedSchedule( void )
+{
+  /** Read the schedule. */
+  this->Superclass2::SetFixedSchedule();
+
+  /** Decide whether or not to average the boxes of the shrink factors. */
+  bool useBoxAveraging = false;
+  this->m_Configuration->ReadParameter( useBoxAveraging,
+    "ImagePyramidUseBoxAveraging", 0, false );
+  this->SetUseBoxAveraging( useBoxAveraging );
+
+} // end SetFixedSchedule()
+
+
+} // end namespace elastix
 
 #endif //#ifndef __elxFixedShrinkingPyramid_hxx
@@ -22,6 +22,53 @@
 #include "elxFixedSmoothingPyramid.h"
 
 namespace elastix
-{} // end namespace elastix
+{
+
+/**
+ * ******************* SetFixedSchedule ***********************
+ */
+
+template< class TElastix >
+void
+FixedSmoothingPyramid< TElastix >
+::SetFixedSchedule( void )
+{
+  /** Read the schedule. */
+  this->Superclass2::SetFixedSchedule();
+
+  /** Decide whether or not to compute the pyramid images only for the current
+   * resolution. Setting the option to true saves memory, since only one level
+   * of the pyramid gets allocated per resolution.
+   */
+  bool computeThisResolution = false;
+  this->m_Configuration->ReadParameter( computeThisResolution,
+    "ComputePyramidImagesPerResolution", 0, false );
+  this->SetComputeOnlyForCurrentLevel( computeThisResolution );
+
+} // end SetFixedSchedule()
+
+
+/**
+ * ******************* BeforeEachResolution ***********************
+ */
+
+template< class TElastix >
+void
+FixedSmoothingPyramid< TElastix >
+::BeforeEachResolution( void )
+{
+  /** What is the current resolution level? */
+  const unsigned int level = this->m_Registration->GetAsITKBaseType()->GetCurrentLevel();
+
+  /** We let the pyramid filter know that we are in a next level.
+   * Depending on a flag only at this point the output of the current level is computed,
+   * or it was computed for all levels at once at initialization.
+   */
+  this->SetCurrentLevel( level );
+
+} // end BeforeEachResolution()
+
+
+} // end namespace elastix
 
 #endif //#ifndef __elxFixedSmoothingPyramid_hxx
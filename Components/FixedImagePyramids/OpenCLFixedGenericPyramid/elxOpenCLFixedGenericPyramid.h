@@ -34,6 +34,10 @@ namespace elastix
  * \parameter Pyramid: Enable the OpenCL pyramid as follows:\n
  *    <tt>(OpenCLFixedGenericImagePyramidUseOpenCL "true")</tt>
  *
+ * The input image is copied to the GPU once, and kept there as long as it is
+ * not modified. With ComputePyramidImagesPerResolution, only the current level
+ * is computed on the GPU and copied back to the host, once per resolution.
+ *
  * \author Denis P. Shamonin and Marius Staring. Division of Image Processing,
  * Department of Radiology, Leiden, The Netherlands
  *
@@ -132,6 +136,9 @@ private:
   void ReportToLog( void );
 
   GPUPyramidPointer                       m_GPUPyramid;
+  GPUInputImagePointer                    m_GPUInputImage;
+  const InputImageType *                  m_GPUInputImageSource;
+  itk::ModifiedTimeType                   m_GPUInputImageMTime;
   bool                                    m_GPUPyramidReady;
   bool                                    m_GPUPyramidCreated;
   bool                                    m_ContextCreated;
@@ -41,6 +41,11 @@ namespace elastix
  *    An integer downsampling factor must be specified for each dimension, for each resolution.\n
  *    example: <tt>(SampleGridSpacing 4 4 2 2)</tt>\n
  *    Default is 2 for each dimension for each resolution.
+ * \parameter SampleGridTileSize: The samples are emitted in tiles of this number of
+ *    grid points along each dimension, which improves the memory locality of the
+ *    metric computation. 0 gives the plain scan line order of the grid.\n
+ *    example: <tt>(SampleGridTileSize 4)</tt>\n
+ *    Default is 8. The parameter can be specified for each resolution.
  *
  * \ingroup ImageSamplers
  */
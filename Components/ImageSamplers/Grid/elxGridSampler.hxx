@@ -50,6 +50,12 @@ GridSampler< TElastix >
   }
   this->SetSampleGridSpacing( gridspacing );
 
+  /** Read the tile size, in grid points. */
+  unsigned int tileSize = 8;
+  this->GetConfiguration()->ReadParameter( tileSize,
+    "SampleGridTileSize", this->GetComponentLabel(), level, 0 );
+  this->SetTileSize( tileSize );
+
 } // end BeforeEachResolution()
 
 
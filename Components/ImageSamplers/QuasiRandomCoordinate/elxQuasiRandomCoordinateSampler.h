@@ -0,0 +1,140 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxQuasiRandomCoordinateSampler_h
+#define __elxQuasiRandomCoordinateSampler_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "itkImageQuasiRandomCoordinateSampler.h"
+
+namespace elastix
+{
+
+/**
+ * \class QuasiRandomCoordinateSampler
+ * \brief An image sampler based on the itk::ImageQuasiRandomCoordinateSampler.
+ *
+ * This image sampler samples 'NumberOfSamples' coordinates in the
+ * InputImageRegion, like the RandomCoordinate sampler, but uses a stratified
+ * or low-discrepancy sequence instead of independent uniform coordinates.
+ * The samples cover the image more evenly, which reduces the variance of the
+ * stochastic derivative, so that fewer samples are needed for the same
+ * accuracy. If a mask is given, only coordinates within the mask are used.
+ *
+ * This sampler is suitable to used in combination with the
+ * NewSamplesEveryIteration parameter (defined in the elx::OptimizerBase).
+ *
+ * The parameters used in this class are:
+ * \parameter ImageSampler: Select this image sampler as follows:\n
+ *    <tt>(ImageSampler "QuasiRandomCoordinate")</tt>
+ * \parameter NumberOfSpatialSamples: The number of image voxels used for computing the
+ *    metric value and its derivative in each iteration. Must be given for each resolution.\n
+ *    example: <tt>(NumberOfSpatialSamples 2048 2048 4000)</tt> \n
+ *    The default is 5000.
+ * \parameter QuasiRandomSequence: The sequence used to generate the coordinates,
+ *    "Halton" for a randomly shifted Halton sequence, or "JitteredGrid" for one
+ *    random coordinate in each cell of a grid of at least NumberOfSpatialSamples
+ *    cells.\n
+ *    example: <tt>(QuasiRandomSequence "JitteredGrid")</tt>\n
+ *    Default value: "Halton". The parameter can be specified for each resolution.
+ * \parameter FixedImageBSplineInterpolationOrder: The fixed image needs to be
+ *    interpolated at the sampled coordinates. This is done using a B-spline interpolator.
+ *    With this option you can specify the order of interpolation.\n
+ *    example: <tt>(FixedImageBSplineInterpolationOrder 0 0 1)</tt>\n
+ *    Default value: 1. The parameter can be specified for each resolution.
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TElastix >
+class QuasiRandomCoordinateSampler :
+  public
+  itk::ImageQuasiRandomCoordinateSampler<
+  typename elx::ImageSamplerBase< TElastix >::InputImageType >,
+  public
+  elx::ImageSamplerBase< TElastix >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef QuasiRandomCoordinateSampler Self;
+  typedef itk::ImageQuasiRandomCoordinateSampler<
+    typename elx::ImageSamplerBase< TElastix >::InputImageType >
+    Superclass1;
+  typedef elx::ImageSamplerBase< TElastix > Superclass2;
+  typedef itk::SmartPointer< Self >         Pointer;
+  typedef itk::SmartPointer< const Self >   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( QuasiRandomCoordinateSampler, ImageQuasiRandomCoordinateSampler );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific image sampler. \n
+   * example: <tt>(ImageSampler "QuasiRandomCoordinate")</tt>\n
+   */
+  elxClassNameMacro( "QuasiRandomCoordinate" );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass1::InputImageType          InputImageType;
+  typedef typename Superclass1::CoordRepType            CoordRepType;
+  typedef typename Superclass1::DefaultInterpolatorType DefaultInterpolatorType;
+
+  /** The input image dimension. */
+  itkStaticConstMacro( InputImageDimension, unsigned int, Superclass1::InputImageDimension );
+
+  /** Typedefs inherited from Elastix. */
+  typedef typename Superclass2::ElastixType          ElastixType;
+  typedef typename Superclass2::ElastixPointer       ElastixPointer;
+  typedef typename Superclass2::ConfigurationType    ConfigurationType;
+  typedef typename Superclass2::ConfigurationPointer ConfigurationPointer;
+  typedef typename Superclass2::RegistrationType     RegistrationType;
+  typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
+  typedef typename Superclass2::ITKBaseType          ITKBaseType;
+
+  /** Execute stuff before each resolution:
+   * \li Set the number of samples.
+   * \li Set the sequence.
+   * \li Set the fixed image interpolation order
+   */
+  void BeforeEachResolution( void ) override;
+
+protected:
+
+  /** The constructor. */
+  QuasiRandomCoordinateSampler() {}
+  /** The destructor. */
+  ~QuasiRandomCoordinateSampler() override {}
+
+private:
+
+  /** The private constructor. */
+  QuasiRandomCoordinateSampler( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );               // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "elxQuasiRandomCoordinateSampler.hxx"
+#endif
+
+#endif // end #ifndef __elxQuasiRandomCoordinateSampler_h
@@ -0,0 +1,88 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxQuasiRandomCoordinateSampler_hxx
+#define __elxQuasiRandomCoordinateSampler_hxx
+
+#include "elxQuasiRandomCoordinateSampler.h"
+#include "itkLinearInterpolateImageFunction.h"
+
+namespace elastix
+{
+
+/**
+ * ******************* BeforeEachResolution ******************
+ */
+
+template< class TElastix >
+void
+QuasiRandomCoordinateSampler< TElastix >
+::BeforeEachResolution( void )
+{
+  const unsigned int level
+    = this->m_Registration->GetAsITKBaseType()->GetCurrentLevel();
+
+  /** Set the NumberOfSpatialSamples. */
+  unsigned long numberOfSpatialSamples = 5000;
+  this->GetConfiguration()->ReadParameter( numberOfSpatialSamples,
+    "NumberOfSpatialSamples", this->GetComponentLabel(), level, 0 );
+  this->SetNumberOfSamples( numberOfSpatialSamples );
+
+  /** Set the sequence. */
+  std::string sequence = "Halton";
+  this->GetConfiguration()->ReadParameter( sequence,
+    "QuasiRandomSequence", this->GetComponentLabel(), level, 0 );
+  if( sequence == "Halton" )
+  {
+    this->SetSequence( Superclass1::Halton );
+  }
+  else if( sequence == "JitteredGrid" )
+  {
+    this->SetSequence( Superclass1::JitteredGrid );
+  }
+  else
+  {
+    itkExceptionMacro( << "ERROR: unknown QuasiRandomSequence \"" << sequence
+                       << "\". Choose \"Halton\" or \"JitteredGrid\"." );
+  }
+
+  /** Set up the fixed image interpolator and set the SplineOrder, default value = 1. */
+  unsigned int splineOrder = 1;
+  this->GetConfiguration()->ReadParameter( splineOrder,
+    "FixedImageBSplineInterpolationOrder", this->GetComponentLabel(), level, 0 );
+  if( splineOrder == 1 )
+  {
+    typedef itk::LinearInterpolateImageFunction<
+      InputImageType, CoordRepType >    LinearInterpolatorType;
+    typename LinearInterpolatorType::Pointer fixedImageLinearInterpolator
+      = LinearInterpolatorType::New();
+    this->SetInterpolator( fixedImageLinearInterpolator );
+  }
+  else
+  {
+    typename DefaultInterpolatorType::Pointer fixedImageBSplineInterpolator
+      = DefaultInterpolatorType::New();
+    fixedImageBSplineInterpolator->SetSplineOrder( splineOrder );
+    this->SetInterpolator( fixedImageBSplineInterpolator );
+  }
+
+} // end BeforeEachResolution()
+
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxQuasiRandomCoordinateSampler_hxx
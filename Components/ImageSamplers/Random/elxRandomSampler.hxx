@@ -42,6 +42,12 @@ RandomSampler< TElastix >
 
   this->SetNumberOfSamples( numberOfSpatialSamples );
 
+  /** Draw the random numbers by the counter-based generator or not. */
+  bool useCounterBasedRandomGenerator = false;
+  this->GetConfiguration()->ReadParameter( useCounterBasedRandomGenerator,
+    "UseCounterBasedRandomGenerator", this->GetComponentLabel(), level, 0 );
+  this->SetUseCounterBasedRandomGenerator( useCounterBasedRandomGenerator );
+
 } // end BeforeEachResolution
 
 
@@ -70,6 +70,20 @@ namespace elastix
  *    With this option you can specify the order of interpolation.\n
  *    example: <tt>(FixedImageBSplineInterpolationOrder 0 0 1)</tt>\n
  *    Default value: 1. The parameter can be specified for each resolution.
+ * \parameter SampleRefreshFraction: The fraction of the samples that is replaced
+ *    by new samples when NewSamplesEveryIteration is true. The other samples and
+ *    their fixed image values are reused from the previous iteration. Ignored when
+ *    UseRandomSampleRegion is true.\n
+ *    example: <tt>(SampleRefreshFraction 0.25)</tt>\n
+ *    Default value: 1.0, which selects all samples anew. The parameter can be
+ *    specified for each resolution.
+ * \parameter UseCounterBasedRandomGenerator: Whether the random numbers are drawn
+ *    by the counter-based Philox generator from the sample number, so that the
+ *    samples are generated in parallel and do not depend on the number of
+ *    threads. The samples differ from those of the default generator. Not
+ *    used with a mask.\n
+ *    example: <tt>(UseCounterBasedRandomGenerator "true")</tt>\n
+ *    Default value: "false". The parameter can be specified for each resolution.
  *
  * \ingroup ImageSamplers
  */
@@ -146,6 +160,7 @@ public:
    * \li Set the number of samples.
    * \li Set the fixed image interpolation order
    * \li Set the UseRandomSampleRegion flag and the SampleRegionSize
+   * \li Set the SampleRefreshFraction
    */
   void BeforeEachResolution( void ) override;
 
@@ -115,6 +115,23 @@ RandomCoordinateSampler< TElastix >
     }
   }
 
+  /** Set the fraction of the samples that is replaced each iteration. */
+  double sampleRefreshFraction = 1.0;
+  this->GetConfiguration()->ReadParameter( sampleRefreshFraction,
+    "SampleRefreshFraction", this->GetComponentLabel(), level, 0 );
+  if( sampleRefreshFraction <= 0.0 || sampleRefreshFraction > 1.0 )
+  {
+    itkExceptionMacro( << "ERROR: SampleRefreshFraction should be in the range (0, 1], "
+                       << "but is " << sampleRefreshFraction << "." );
+  }
+  this->SetSampleRefreshFraction( sampleRefreshFraction );
+
+  /** Draw the random numbers by the counter-based generator or not. */
+  bool useCounterBasedRandomGenerator = false;
+  this->GetConfiguration()->ReadParameter( useCounterBasedRandomGenerator,
+    "UseCounterBasedRandomGenerator", this->GetComponentLabel(), level, 0 );
+  this->SetUseCounterBasedRandomGenerator( useCounterBasedRandomGenerator );
+
 } // end BeforeEachResolution()
 
 
@@ -0,0 +1,143 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxRandomSamplerOverlap_h
+#define __elxRandomSamplerOverlap_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "itkImageRandomSamplerOverlap.h"
+
+namespace elastix
+{
+
+/**
+ * \class RandomSamplerOverlap
+ * \brief An image sampler based on the itk::ImageRandomSamplerOverlap.
+ *
+ * This image sampler randomly samples 'NumberOfSamples' voxels of the part of
+ * the InputImageRegion that maps into the moving image and its mask. This
+ * part is found on every update on a coarse lattice of cells, at the current
+ * transform. Voxels may be selected multiple times.
+ *
+ * This is useful when a large part of the fixed image maps outside the
+ * moving image, which otherwise wastes many samples, or results in the error
+ * that too many samples map outside the moving image buffer. The sampler is
+ * meant to be used in combination with the NewSamplesEveryIteration parameter
+ * (defined in the elx::OptimizerBase).
+ *
+ * The parameters used in this class are:
+ * \parameter ImageSampler: Select this image sampler as follows:\n
+ *    <tt>(ImageSampler "RandomOverlap")</tt>
+ * \parameter NumberOfSpatialSamples: The number of image voxels used for computing the
+ *    metric value and its derivative in each iteration. Must be given for each resolution.\n
+ *    example: <tt>(NumberOfSpatialSamples 2048 2048 4000)</tt> \n
+ *    The default is 5000.
+ * \parameter OverlapLatticeSize: The number of cells of the lattice in each dimension,
+ *    on which the overlap with the moving image is determined.\n
+ *    example: <tt>(OverlapLatticeSize 16 16 32)</tt> \n
+ *    The default is 16. The parameter can be specified for each resolution.
+ *
+ * \ingroup ImageSamplers
+ */
+
+template< class TElastix >
+class RandomSamplerOverlap :
+  public
+  itk::ImageRandomSamplerOverlap<
+  typename elx::ImageSamplerBase< TElastix >::InputImageType >,
+  public
+  elx::ImageSamplerBase< TElastix >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef RandomSamplerOverlap Self;
+  typedef itk::ImageRandomSamplerOverlap<
+    typename elx::ImageSamplerBase< TElastix >::InputImageType >
+    Superclass1;
+  typedef elx::ImageSamplerBase< TElastix > Superclass2;
+  typedef itk::SmartPointer< Self >         Pointer;
+  typedef itk::SmartPointer< const Self >   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( RandomSamplerOverlap, itk::ImageRandomSamplerOverlap );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific image sampler. \n
+   * example: <tt>(ImageSampler "RandomOverlap")</tt>\n
+   */
+  elxClassNameMacro( "RandomOverlap" );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass1::DataObjectPointer            DataObjectPointer;
+  typedef typename Superclass1::OutputVectorContainerType    OutputVectorContainerType;
+  typedef typename Superclass1::OutputVectorContainerPointer OutputVectorContainerPointer;
+  typedef typename Superclass1::InputImageType               InputImageType;
+  typedef typename Superclass1::InputImagePointer            InputImagePointer;
+  typedef typename Superclass1::InputImageConstPointer       InputImageConstPointer;
+  typedef typename Superclass1::InputImageRegionType         InputImageRegionType;
+  typedef typename Superclass1::InputImagePixelType          InputImagePixelType;
+  typedef typename Superclass1::ImageSampleType              ImageSampleType;
+  typedef typename Superclass1::ImageSampleContainerType     ImageSampleContainerType;
+  typedef typename Superclass1::MaskType                     MaskType;
+  typedef typename Superclass1::InputImageIndexType          InputImageIndexType;
+  typedef typename Superclass1::InputImagePointType          InputImagePointType;
+
+  /** The input image dimension. */
+  itkStaticConstMacro( InputImageDimension, unsigned int, Superclass1::InputImageDimension );
+
+  /** Typedefs inherited from Elastix. */
+  typedef typename Superclass2::ElastixType          ElastixType;
+  typedef typename Superclass2::ElastixPointer       ElastixPointer;
+  typedef typename Superclass2::ConfigurationType    ConfigurationType;
+  typedef typename Superclass2::ConfigurationPointer ConfigurationPointer;
+  typedef typename Superclass2::RegistrationType     RegistrationType;
+  typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
+  typedef typename Superclass2::ITKBaseType          ITKBaseType;
+
+  /** Execute stuff before each resolution:
+   * \li Set the number of samples.
+   * \li Set the size of the lattice.
+   */
+  void BeforeEachResolution( void ) override;
+
+protected:
+
+  /** The constructor. */
+  RandomSamplerOverlap() {}
+  /** The destructor. */
+  ~RandomSamplerOverlap() override {}
+
+private:
+
+  /** The private constructor. */
+  RandomSamplerOverlap( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );       // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "elxRandomSamplerOverlap.hxx"
+#endif
+
+#endif // end #ifndef __elxRandomSamplerOverlap_h
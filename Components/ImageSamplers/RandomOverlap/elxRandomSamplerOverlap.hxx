@@ -0,0 +1,57 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxRandomSamplerOverlap_hxx
+#define __elxRandomSamplerOverlap_hxx
+
+#include "elxRandomSamplerOverlap.h"
+
+namespace elastix
+{
+
+/**
+* ******************* BeforeEachResolution ******************
+*/
+
+template< class TElastix >
+void
+RandomSamplerOverlap< TElastix >
+::BeforeEachResolution( void )
+{
+  const unsigned int level
+    = ( this->m_Registration->GetAsITKBaseType() )->GetCurrentLevel();
+
+  /** Set the NumberOfSpatialSamples. */
+  unsigned long numberOfSpatialSamples = 5000;
+  this->GetConfiguration()->ReadParameter( numberOfSpatialSamples,
+    "NumberOfSpatialSamples", this->GetComponentLabel(), level, 0 );
+
+  this->SetNumberOfSamples( numberOfSpatialSamples );
+
+  /** Set the size of the lattice on which the overlap is determined. */
+  unsigned int latticeSize = 16;
+  this->GetConfiguration()->ReadParameter( latticeSize,
+    "OverlapLatticeSize", this->GetComponentLabel(), level, 0 );
+
+  this->SetLatticeSize( latticeSize );
+
+} // end BeforeEachResolution
+
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxRandomSamplerOverlap_hxx
@@ -46,6 +46,12 @@ namespace elastix
  *    metric value and its derivative in each iteration. Must be given for each resolution.\n
  *    example: <tt>(NumberOfSpatialSamples 2048 2048 4000)</tt> \n
  *    The default is 5000.
+ * \parameter UseCounterBasedRandomGenerator: Whether the random numbers are drawn
+ *    by the counter-based Philox generator from the sample number, so that the
+ *    samples are generated in parallel and do not depend on the number of
+ *    threads. The samples differ from those of the default generator.\n
+ *    example: <tt>(UseCounterBasedRandomGenerator "true")</tt>\n
+ *    Default value: "false". The parameter can be specified for each resolution.
  *
  * \ingroup ImageSamplers
  */
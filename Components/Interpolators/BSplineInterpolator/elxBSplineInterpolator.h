@@ -19,17 +19,19 @@
 #define __elxBSplineInterpolator_h
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
-#include "itkBSplineInterpolateImageFunction.h"
+#include "itkAdvancedBSplineInterpolateImageFunction.h"
 
 namespace elastix
 {
 
 /**
  * \class BSplineInterpolator
- * \brief An interpolator based on the itkBSplineInterpolateImageFunction.
+ * \brief An interpolator based on the itk::AdvancedBSplineInterpolateImageFunction.
  *
  * This interpolator interpolates images with an underlying B-spline
- * polynomial.
+ * polynomial. The value and the derivative, which the metrics need at every
+ * sample, are computed together by a kernel specialized for the spline
+ * orders 1, 2 and 3.
  *
  * NB: BSplineInterpolation with order 1 is slower than using a LinearInterpolator,
  * but it determines the derivative slightly more accurate at grid points. That's
@@ -42,6 +44,28 @@ namespace elastix
  *    example: <tt>(BSplineInterpolationOrder 3 2 3)</tt> \n
  *    The default order is 1. The parameter can be specified for each resolution.\n
  *    If only given for one resolution, that value is used for the other resolutions as well.
+ * \parameter MovingImageMemoryLayout: the layout of the copy of the B-spline coefficients
+ *    that the value and derivative kernels read. "Bricked" stores cubes of coefficients
+ *    contiguously, which improves the cache locality for large 3D images, at the cost of
+ *    the memory of a second coefficient image. \n
+ *    example: <tt>(MovingImageMemoryLayout "Bricked")</tt> \n
+ *    Choose from "Default" and "Bricked". The default is "Default". The parameter can be
+ *    specified for each resolution.
+ * \parameter MovingImageBrickSize: the number of coefficients along each side of a brick. \n
+ *    example: <tt>(MovingImageBrickSize 16)</tt> \n
+ *    The default is 8. The parameter can be specified for each resolution.
+ * \parameter MovingImageCoefficientPrecision: the precision of the copy of the B-spline
+ *    coefficients that the value and derivative kernels read. "Half" stores them in 16 bits,
+ *    which reduces the memory traffic, at a relative precision of about 0.05%. \n
+ *    example: <tt>(MovingImageCoefficientPrecision "Half")</tt> \n
+ *    Choose from "Default" and "Half". The default is "Default". The parameter can be
+ *    specified for each resolution.
+ * \parameter UseBSplineCoefficientCache: whether the B-spline coefficients of the moving
+ *    image are shared with the other B-spline interpolators with this parameter, like the
+ *    FinalBSplineInterpolator. The coefficients of the last resolution, which is usually the
+ *    original moving image, are then computed only once. \n
+ *    example: <tt>(UseBSplineCoefficientCache "true")</tt> \n
+ *    The default is "false". The parameter can be specified for each resolution.
  *
  * \ingroup Interpolators
  */
@@ -49,7 +73,7 @@ namespace elastix
 template< class TElastix >
 class BSplineInterpolator :
   public
-  itk::BSplineInterpolateImageFunction<
+  itk::AdvancedBSplineInterpolateImageFunction<
   typename InterpolatorBase< TElastix >::InputImageType,
   typename InterpolatorBase< TElastix >::CoordRepType,
   double >,        //CoefficientType
@@ -60,7 +84,7 @@ public:
 
   /** Standard ITK-stuff. */
   typedef BSplineInterpolator Self;
-  typedef itk::BSplineInterpolateImageFunction<
+  typedef itk::AdvancedBSplineInterpolateImageFunction<
     typename InterpolatorBase< TElastix >::InputImageType,
     typename InterpolatorBase< TElastix >::CoordRepType,
     double >                                  Superclass1;
@@ -72,7 +96,7 @@ public:
   itkNewMacro( Self );
 
   /** Run-time type information (and related methods). */
-  itkTypeMacro( BSplineInterpolator, itk::BSplineInterpolateImageFunction );
+  itkTypeMacro( BSplineInterpolator, itk::AdvancedBSplineInterpolateImageFunction );
 
   /** Name of this class.
    * Use this name in the parameter file to select this specific interpolator. \n
@@ -107,6 +131,9 @@ public:
 
   /** Execute stuff before each new pyramid resolution:
    * \li Set the spline order.
+   * \li Set the memory layout of the coefficients.
+   * \li Set the precision of the coefficients.
+   * \li Set whether the coefficients are cached.
    */
   void BeforeEachResolution( void ) override;
 
@@ -55,6 +55,38 @@ BSplineInterpolator< TElastix >
   /** Set the splineOrder. */
   this->SetSplineOrder( splineOrder );
 
+  /** Read the memory layout of the coefficients, and the brick size. */
+  std::string memoryLayout = "Default";
+  this->GetConfiguration()->ReadParameter( memoryLayout,
+    "MovingImageMemoryLayout", this->GetComponentLabel(), level, 0 );
+  if( memoryLayout != "Default" && memoryLayout != "Bricked" )
+  {
+    itkExceptionMacro( << "ERROR: the MovingImageMemoryLayout should be "
+                       << "\"Default\" or \"Bricked\", not \"" << memoryLayout << "\"." );
+  }
+  unsigned int brickSize = 8;
+  this->GetConfiguration()->ReadParameter( brickSize,
+    "MovingImageBrickSize", this->GetComponentLabel(), level, 0 );
+  this->SetBrickSize( brickSize );
+  this->SetUseBrickedCoefficients( memoryLayout == "Bricked" );
+
+  /** Read the precision of the copy of the coefficients. */
+  std::string precision = "Default";
+  this->GetConfiguration()->ReadParameter( precision,
+    "MovingImageCoefficientPrecision", this->GetComponentLabel(), level, 0 );
+  if( precision != "Default" && precision != "Half" )
+  {
+    itkExceptionMacro( << "ERROR: the MovingImageCoefficientPrecision should be "
+                       << "\"Default\" or \"Half\", not \"" << precision << "\"." );
+  }
+  this->SetUseHalfPrecisionCoefficients( precision == "Half" );
+
+  /** Read whether the coefficients are shared with other interpolators. */
+  bool useCoefficientCache = false;
+  this->GetConfiguration()->ReadParameter( useCoefficientCache,
+    "UseBSplineCoefficientCache", this->GetComponentLabel(), level, 0 );
+  this->SetUseCoefficientCache( useCoefficientCache );
+
 } // end BeforeEachResolution()
 
 
@@ -36,6 +36,12 @@ namespace elastix
  * The parameters used in this class are:
  * \parameter Interpolator: Select this interpolator as follows:\n
  *    <tt>(Interpolator "LinearInterpolator")</tt>
+ * \parameter LinearInterpolatorUseGradientImage: whether the derivative of the moving image is
+ *    a linear interpolation of its central difference gradient image, instead of the
+ *    derivative of the linear interpolant. The gradient image is computed once per
+ *    resolution, and costs the memory of one float image per dimension. \n
+ *    example: <tt>(LinearInterpolatorUseGradientImage "true")</tt> \n
+ *    The default is "false". The parameter can be specified for each resolution.
  *
  * \ingroup Interpolators
  */
@@ -90,6 +96,11 @@ public:
   typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
   typedef typename Superclass2::ITKBaseType          ITKBaseType;
 
+  /** Execute stuff before each new pipeline resolution:
+   * \li Set whether the gradient image is used.
+   */
+  void BeforeEachResolution( void ) override;
+
 protected:
 
   /** The constructor. */
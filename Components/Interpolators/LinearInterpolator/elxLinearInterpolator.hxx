@@ -24,7 +24,27 @@
 namespace elastix
 {
 
-/** Nothing */
+/**
+ * ***************** BeforeEachResolution ***********************
+ */
+
+template< class TElastix >
+void
+LinearInterpolator< TElastix >
+::BeforeEachResolution( void )
+{
+  /** Get the current resolution level. */
+  unsigned int level
+    = ( this->m_Registration->GetAsITKBaseType() )->GetCurrentLevel();
+
+  /** Read whether the derivative interpolates a gradient image. */
+  bool useGradientImage = false;
+  this->GetConfiguration()->ReadParameter( useGradientImage,
+    "LinearInterpolatorUseGradientImage", this->GetComponentLabel(), level, 0 );
+  this->SetUseGradientImage( useGradientImage );
+
+} // end BeforeEachResolution()
+
 
 } // end namespace elastix
 
@@ -20,6 +20,8 @@
 
 #include "itkAdvancedImageToImageMetric.h"
 
+#include <cmath>
+
 namespace itk
 {
 
@@ -130,6 +132,8 @@ public:
     MovingImageType::ImageDimension );
 
   /** Get the value for single valued optimizers. */
+  virtual MeasureType GetValueSingleThreaded( const TransformParametersType & parameters ) const;
+
   MeasureType GetValue( const TransformParametersType & parameters ) const override;
 
   /** Get the derivatives of the match measure. */
@@ -145,7 +149,10 @@ public:
     const TransformParametersType & parameters,
     MeasureType & Value, DerivativeType & Derivative ) const override;
 
-  /** Computes the moving gradient image dM/dx. */
+  /** Computes the moving gradient image dM/dx. The moving pixels are
+   * classified once as foreground or background, after which the gradient
+   * is the difference of the classes of the neighbours. Multi-threaded.
+   */
   void ComputeGradient( void ) override;
 
   /** This method allows the user to set the foreground value. The default value is 1.0. */
@@ -207,12 +214,29 @@ protected:
     DerivativeType & sum1,
     DerivativeType & sum2 ) const;
 
+  /** Return whether a fixed or moving image value is foreground. */
+  inline bool IsForeground( const RealType & value ) const
+  {
+    if( this->m_UseForegroundValue )
+    {
+      return std::abs( value - this->m_ForegroundValue ) < this->m_Epsilon;
+    }
+    return value > this->m_Epsilon;
+  }
+
+
   /** Initialize some multi-threading related parameters.
    * Overrides function in AdvancedImageToImageMetric, because
    * here we use other parameters.
    */
   void InitializeThreadingParameters( void ) const override;
 
+  /** Get value for each thread. */
+  inline void ThreadedGetValue( ThreadIdType threadID ) override;
+
+  /** Gather the values from all threads. */
+  inline void AfterThreadedGetValue( MeasureType & value ) const override;
+
   /** Get value and derivatives for each thread. */
   inline void ThreadedGetValueAndDerivative( ThreadIdType threadID ) override;
 
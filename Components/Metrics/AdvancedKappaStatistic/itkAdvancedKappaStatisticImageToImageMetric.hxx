@@ -19,7 +19,9 @@
 #define _itkAdvancedKappaStatisticImageToImageMetric_hxx
 
 #include "itkAdvancedKappaStatisticImageToImageMetric.h"
+#include <algorithm>
 #include <cmath> // For abs.
+#include <vector>
 
 namespace itk
 {
@@ -36,6 +38,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   this->SetUseImageSampler( true );
   this->SetUseFixedImageLimiter( false );
   this->SetUseMovingImageLimiter( false );
+  this->SetSupportsConcurrentEvaluation( true );
 
   this->m_UseForegroundValue = true; // for backwards compatibility
   this->m_ForegroundValue    = 1.0;
@@ -70,6 +73,16 @@ void
 AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 ::InitializeThreadingParameters( void ) const
 {
+  /** Call superclass implementation, which also sizes the scratch memory. */
+  Superclass::InitializeThreadingParameters();
+
+  /** This class accumulates its own derivative terms, so release the derivatives of the superclass. */
+  for( ThreadIdType i = 0; i < Self::GetNumberOfReductionChunks(); ++i )
+  {
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.SetSize( 0 );
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_DerivativeBuffer.Release();
+  }
+
   /** Resize and initialize the threading related parameters.
    * The SetSize() functions do not resize the data when this is not
    * needed, which saves valuable re-allocation time.
@@ -77,7 +90,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
    * which has performance benefits for larger vector sizes.
    */
 
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Only resize the array of structs when needed. */
   if( this->m_KappaGetValueAndDerivativePerThreadVariablesSize != numberOfThreads)
@@ -126,13 +139,13 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* GetValue *******************
+ * ******************* GetValueSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 typename AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
 AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
-::GetValue( const TransformParametersType & parameters ) const
+::GetValueSingleThreaded( const TransformParametersType & parameters ) const
 {
   itkDebugMacro( "GetValue( " << parameters << " ) " );
 
@@ -177,7 +190,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside moving mask. */
     if( sampleOk )
@@ -204,22 +217,11 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
         = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
 
       /** Update the intermediate values. */
-      if( this->m_UseForegroundValue )
-      {
-        const RealType diffFixed  = std::abs( fixedImageValue - this->m_ForegroundValue );
-        const RealType diffMoving = std::abs( movingImageValue - this->m_ForegroundValue );
-        if( diffFixed < this->m_Epsilon ) { fixedForegroundArea++; }
-        if( diffMoving < this->m_Epsilon ) { movingForegroundArea++; }
-        if( diffFixed < this->m_Epsilon
-          && diffMoving < this->m_Epsilon ) { intersection++; }
-      }
-      else
-      {
-        if( fixedImageValue  > this->m_Epsilon ) { fixedForegroundArea++; }
-        if( movingImageValue > this->m_Epsilon ) { movingForegroundArea++; }
-        if( fixedImageValue  > this->m_Epsilon
-          && movingImageValue > this->m_Epsilon ) { intersection++; }
-      }
+      const bool fixedForeground  = this->IsForeground( fixedImageValue );
+      const bool movingForeground = this->IsForeground( movingImageValue );
+      fixedForegroundArea  += fixedForeground;
+      movingForegroundArea += movingForeground;
+      intersection         += fixedForeground && movingForeground;
 
     } // end if samplOk
 
@@ -241,12 +243,177 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   }
   if( !this->m_Complement ) { measure = 1.0 - measure; }
 
-  /** Return the mean squares measure value. */
+  /** Return the kappa measure value. */
   return measure;
 
+} // end GetValueSingleThreaded()
+
+
+/**
+ * ******************* GetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
+::GetValue( const TransformParametersType & parameters ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueSingleThreaded( parameters );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * Because of these calls GetValue itself is not thread-safe,
+   * so cannot be called multiple times simultaneously.
+   * This is however needed in the CombinationImageToImageMetric.
+   * In that case, you need to:
+   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
+   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before calling GetValue
+   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
+   * - Now you can call GetValue multi-threaded.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueThreaderCallback();
+
+  /** Gather the metric values from all threads. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->AfterThreadedGetValue( value );
+
+  return value;
+
 } // end GetValue()
 
 
+/**
+ * ******************* ThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetValue( ThreadIdType threadId )
+{
+  /** Get the number of samples. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create variables to store intermediate results, to circumvent false sharing. */
+  std::size_t   fixedForegroundArea   = 0;
+  std::size_t   movingForegroundArea  = 0;
+  std::size_t   intersection          = 0;
+  unsigned long numberOfPixelsCounted = 0;
+
+  /** The samples are processed per block: the points of a block are
+   * transformed with one call of the batch TransformPoints(), and their
+   * moving image values are interpolated together.
+   */
+  const unsigned int   batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType  fixedPoints[ batchSize ];
+  RealType             fixedImageValues[ batchSize ];
+  MovingImagePointType mappedPoints[ batchSize ];
+  bool                 samplesOk[ batchSize ];
+  RealType             movingImageValues[ batchSize ];
+
+  /** Loop over the fixed image samples to calculate the kappa statistic. */
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
+  {
+    const unsigned int blockSize = static_cast< unsigned int >(
+      std::min< unsigned long >( pos_end - blockBegin, batchSize ) );
+
+    /** Read the fixed image samples, transform them, check if they are
+     * inside the moving mask, and compute the moving image values.
+     */
+    this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints, movingImageValues, 0, samplesOk, blockSize );
+
+    /** Do the actual calculation of the metric value. */
+    for( unsigned int i = 0; i < blockSize; ++i )
+    {
+      if( !samplesOk[ i ] )
+      {
+        continue;
+      }
+      numberOfPixelsCounted++;
+
+      /** Update the intermediate values. */
+      const bool fixedForeground  = this->IsForeground( fixedImageValues[ i ] );
+      const bool movingForeground = this->IsForeground( movingImageValues[ i ] );
+      fixedForegroundArea  += fixedForeground;
+      movingForegroundArea += movingForeground;
+      intersection         += fixedForeground && movingForeground;
+
+    } // end for loop over the samples of the block
+
+  } // end for loop over the image sample container
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_AreaSum               = fixedForegroundArea + movingForegroundArea;
+  this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_AreaIntersection      = intersection;
+
+} // end ThreadedGetValue()
+
+
+/**
+ * ******************* AfterThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetValue( MeasureType & value ) const
+{
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
+
+  /** Accumulate the number of pixels and the areas, in a fixed order. */
+  this->m_NumberOfPixelsCounted = 0;
+  SizeValueType areaSum      = 0;
+  SizeValueType intersection = 0;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted += this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted;
+    areaSum                       += this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_AreaSum;
+    intersection                  += this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_AreaIntersection;
+
+    /** Reset these variables for the next iteration. */
+    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
+    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_AreaSum               = 0;
+    this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_AreaIntersection      = 0;
+  }
+
+  /** Check if enough samples were valid. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  this->CheckNumberOfSamples(
+    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+
+  /** Compute the final metric value, like GetValueSingleThreaded(). */
+  value = NumericTraits< MeasureType >::Zero;
+  if( areaSum > 0 )
+  {
+    value = 1.0 - 2.0 * static_cast< MeasureType >( intersection )
+      / static_cast< MeasureType >( areaSum );
+  }
+  if( !this->m_Complement ) { value = 1.0 - value; }
+
+} // end AfterThreadedGetValue()
+
+
 /**
  * ******************* GetDerivative *******************
  */
@@ -333,7 +500,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside moving mask. */
     if( sampleOk )
@@ -361,7 +528,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
         = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
 
       /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateSampleTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the inner products (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
@@ -463,10 +630,10 @@ void
 AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedGetValueAndDerivative( ThreadIdType threadId )
 {
-  /** Initialize array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
-  const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  NonZeroJacobianIndicesType   nzji  = NonZeroJacobianIndicesType( nnzji );
-  DerivativeType               imageJacobian( nzji.size() );
+  /** Get the pre-allocated arrays that store dM(x)/dmu, and the sparse Jacobian + indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji          = arena.sa_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = arena.sa_ImageJacobian;
 
   /** Get handles to the pre-allocated derivatives for the current thread.
    * The initialization is performed at the beginning of each resolution in
@@ -476,14 +643,13 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   DerivativeType & vecSum1 = this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeSum1;
   DerivativeType & vecSum2 = this->m_KappaGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeSum2;
 
-  /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
+  /** Get the number of samples. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
 
   /** Get the samples for this thread. */
   const unsigned long nrOfSamplesPerThreads
     = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( Self::GetNumberOfWorkUnits() ) ) );
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
 
   unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
   unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
@@ -491,75 +657,56 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
 
   /** Some variables. */
-  RealType             movingImageValue;
-  MovingImagePointType mappedPoint;
-  std::size_t          fixedForegroundArea   = 0; // or unsigned long
-  std::size_t          movingForegroundArea  = 0;
-  std::size_t          intersection          = 0;
-  unsigned long        numberOfPixelsCounted = 0;
-
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
-  fbegin                                                 += (int)pos_begin;
-  fend                                                   += (int)pos_end;
+  std::size_t   fixedForegroundArea   = 0; // or unsigned long
+  std::size_t   movingForegroundArea  = 0;
+  std::size_t   intersection          = 0;
+  unsigned long numberOfPixelsCounted = 0;
+
+  /** The samples are processed per block, see ThreadedGetValue(). */
+  const unsigned int        batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType       fixedPoints[ batchSize ];
+  RealType                  fixedImageValues[ batchSize ];
+  MovingImagePointType      mappedPoints[ batchSize ];
+  bool                      samplesOk[ batchSize ];
+  RealType                  movingImageValues[ batchSize ];
+  MovingImageDerivativeType movingImageDerivatives[ batchSize ];
 
   /** Loop over the fixed image to calculate the kappa statistic. */
-  for( fiter = fbegin; fiter != fend; ++fiter )
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
   {
-    /** Read fixed coordinates. */
-    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    const unsigned int blockSize = static_cast< unsigned int >(
+      std::min< unsigned long >( pos_end - blockBegin, batchSize ) );
 
-    /** Check if point is inside moving mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
-
-    /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
-     * the point is inside the moving image buffer.
+    /** Read the fixed image samples, transform them, check if they are
+     * inside the moving mask, and compute the moving image values M(T(x))
+     * and derivatives dM/dx.
      */
-    MovingImageDerivativeType movingImageDerivative;
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
-    }
+    this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+      movingImageValues, movingImageDerivatives, samplesOk, blockSize );
 
     /** Do the actual calculation of the metric value. */
-    if( sampleOk )
+    for( unsigned int i = 0; i < blockSize; ++i )
     {
+      if( !samplesOk[ i ] )
+      {
+        continue;
+      }
       numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue
-        = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
-
-#if 0
-      /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
-
-      /** Compute the inner products (dM/dx)^T (dT/dmu). */
-      this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
-#else
       /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
-#endif
+      this->EvaluateSampleJacobianWithImageGradientProduct( blockBegin + i,
+        fixedPoints[ i ], movingImageDerivatives[ i ], imageJacobian, nzji );
 
       /** Compute this pixel's contribution to the measure and derivatives. */
       this->UpdateValueAndDerivativeTerms(
-        fixedImageValue, movingImageValue,
+        fixedImageValues[ i ], movingImageValues[ i ],
         fixedForegroundArea, movingForegroundArea, intersection,
         imageJacobian, nzji,
         vecSum1, vecSum2 );
 
-    } // end if sampleOk
+    } // end for loop over the samples of the block
 
   } // end for loop over the image sample container
 
@@ -581,7 +728,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 ::AfterThreadedGetValueAndDerivative(
   MeasureType & value, DerivativeType & derivative ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted
@@ -614,19 +761,25 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     this->m_KappaGetValueAndDerivativePerThreadVariables[ i ].st_AreaIntersection = zero;
   }
 
-  if( areaSum == 0 ) { return; }
-
-  /** Compute the final metric value. */
-  value = 1.0 - 2.0 * intersection / areaSum;
+  /** Compute the final metric value. Without foreground the value and the
+   * derivative are zero, but the derivative sums must still be reset below.
+   */
+  value = zero;
+  MeasureType tmp1 = zero;
+  MeasureType tmp2 = zero;
+  if( areaSum > zero )
+  {
+    value = 1.0 - 2.0 * intersection / areaSum;
+
+    /** Some intermediate values to calculate the derivative. */
+    MeasureType direction = -1.0;
+    if( !this->m_Complement ) { direction = 1.0; }
+    const MeasureType areaSumSquare = direction * areaSum * areaSum;
+    tmp1 = direction / areaSum;
+    tmp2 = 2.0 * intersection / areaSumSquare;
+  }
   if( !this->m_Complement ) { value = 1.0 - value; }
 
-  /** Some intermediate values to calculate the derivative. */
-  MeasureType direction = -1.0;
-  if( !this->m_Complement ) { direction = 1.0; }
-  const MeasureType areaSumSquare = direction * areaSum * areaSum;
-  const MeasureType tmp1          = direction / areaSum;
-  const MeasureType tmp2          = 2.0 * intersection / areaSumSquare;
-
   /** Accumulate intermediate values and calculate derivative. */
   if( !this->m_UseMultiThread ) // single-threaded
   {
@@ -648,8 +801,7 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
     temp->st_Coefficient2      = tmp2;
     temp->st_DerivativePointer = derivative.begin();
 
-    this->m_Threader->SetSingleMethod( AccumulateDerivativesThreaderCallback, temp );
-    this->m_Threader->SingleMethodExecute();
+    this->LaunchThreaderCallback( AccumulateDerivativesThreaderCallback, temp );
 
     delete temp;
   }
@@ -722,23 +874,11 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
   DerivativeType & sum2 ) const
 {
   /** Update the intermediate values. */
-  bool usableFixedSample = false;
-  if( this->m_UseForegroundValue )
-  {
-    const RealType diffFixed  = std::abs( fixedImageValue - this->m_ForegroundValue );
-    const RealType diffMoving = std::abs( movingImageValue - this->m_ForegroundValue );
-    if( diffFixed < this->m_Epsilon ) { fixedForegroundArea++; usableFixedSample = true; }
-    if( diffMoving < this->m_Epsilon ) { movingForegroundArea++; }
-    if( diffFixed < this->m_Epsilon
-      && diffMoving < this->m_Epsilon ) { intersection++; }
-  }
-  else
-  {
-    if( fixedImageValue  > this->m_Epsilon ) { fixedForegroundArea++; usableFixedSample = true; }
-    if( movingImageValue > this->m_Epsilon ) { movingForegroundArea++; }
-    if( fixedImageValue  > this->m_Epsilon
-      && movingImageValue > this->m_Epsilon ) { intersection++; }
-  }
+  const bool usableFixedSample = this->IsForeground( fixedImageValue );
+  const bool movingForeground  = this->IsForeground( movingImageValue );
+  fixedForegroundArea  += usableFixedSample;
+  movingForegroundArea += movingForeground;
+  intersection         += usableFixedSample && movingForeground;
 
   /** Calculate the contributions to the derivatives with respect to each parameter. */
   if( nzji.size() == this->GetNumberOfParameters() )
@@ -787,77 +927,96 @@ AdvancedKappaStatisticImageToImageMetric< TFixedImage, TMovingImage >
 ::ComputeGradient( void )
 {
   /** Typedefs. */
-  typedef itk::ImageRegionIteratorWithIndex< GradientImageType >    GradientIteratorType;
-  typedef itk::ImageRegionConstIteratorWithIndex< MovingImageType > MovingIteratorType;
+  typedef typename MovingImageType::PixelType   MovingImagePixelType;
+  typedef typename GradientImageType::PixelType GradientPixelType;
 
   /** Create a temporary moving gradient image. */
   typename GradientImageType::Pointer tempGradientImage = GradientImageType::New();
   tempGradientImage->SetRegions( this->m_MovingImage->GetBufferedRegion().GetSize() );
   tempGradientImage->Allocate();
 
-  /** Create and reset iterators. */
-  GradientIteratorType git( tempGradientImage, tempGradientImage->GetBufferedRegion() );
-  MovingIteratorType   mit( this->m_MovingImage, this->m_MovingImage->GetBufferedRegion() );
-  git.GoToBegin();
-  mit.GoToBegin();
-
-  /** Some temporary variables. */
-  typename MovingImageType::IndexType minusIndex, plusIndex, currIndex;
-  typename GradientImageType::PixelType tempGradPixel;
-  typename MovingImageType::SizeType movingSize
+  const typename MovingImageType::SizeType movingSize
     = this->m_MovingImage->GetBufferedRegion().GetSize();
-  typename MovingImageType::IndexType movingIndex
-    = this->m_MovingImage->GetBufferedRegion().GetIndex();
-
-  /** Loop over the images. */
-  while( !mit.IsAtEnd() )
+  const SizeValueType          numberOfPixels = this->m_MovingImage->GetBufferedRegion().GetNumberOfPixels();
+  const MovingImagePixelType * movingBuffer   = this->m_MovingImage->GetBufferPointer();
+  GradientPixelType *          gradientBuffer = tempGradientImage->GetBufferPointer();
+
+  /** The strides of the dimensions in the buffers. */
+  OffsetValueType strides[ MovingImageDimension ];
+  strides[ 0 ] = 1;
+  for( unsigned int i = 1; i < MovingImageDimension; ++i )
   {
-    /** Get the current index. */
-    currIndex  = mit.GetIndex();
-    minusIndex = currIndex; plusIndex = currIndex;
-    for( unsigned int i = 0; i < MovingImageDimension; i++ )
+    strides[ i ] = strides[ i - 1 ] * movingSize[ i - 1 ];
+  }
+
+  /** Process the lines along the first dimension in disjoint chunks. */
+  const SizeValueType lineLength    = movingSize[ 0 ];
+  const SizeValueType numberOfLines = numberOfPixels / lineLength;
+  const SizeValueType numberOfChunks
+    = std::min< SizeValueType >( numberOfLines, Self::GetNumberOfWorkUnits() );
+  const SizeValueType linesPerChunk
+    = ( numberOfLines + numberOfChunks - 1 ) / numberOfChunks;
+
+  /** Classify each moving pixel once, in a compact buffer. As before, the
+   * gradient compares with the foreground value, regardless of
+   * UseForegroundValue.
+   */
+  std::vector< unsigned char > foreground( numberOfPixels );
+  unsigned char *              foregroundBuffer = foreground.data();
+  const RealType               foregroundValue  = this->m_ForegroundValue;
+  const RealType               epsilon          = this->m_Epsilon;
+  this->ProcessSlices( static_cast< unsigned int >( numberOfChunks ), true,
+    [ = ]( const unsigned int chunk )
     {
-      /** Check for being on the edge of the moving image. */
-      if( currIndex[ i ] == movingIndex[ i ]
-        || currIndex[ i ] == static_cast< int >( movingIndex[ i ] + movingSize[ i ] - 1 ) )
+      const SizeValueType begin = std::min( chunk * linesPerChunk, numberOfLines ) * lineLength;
+      const SizeValueType end   = std::min( ( chunk + 1 ) * linesPerChunk, numberOfLines ) * lineLength;
+      for( SizeValueType p = begin; p < end; ++p )
       {
-        tempGradPixel[ i ] = 0.0;
+        const RealType value = static_cast< RealType >( movingBuffer[ p ] );
+        foregroundBuffer[ p ] = std::abs( value - foregroundValue ) < epsilon;
       }
-      else
+    } );
+
+  /** The gradient in a dimension is +1 when only the next pixel is
+   * foreground, -1 when only the previous pixel is, and zero otherwise,
+   * in particular at the edges of the image.
+   */
+  this->ProcessSlices( static_cast< unsigned int >( numberOfChunks ), true,
+    [ = ]( const unsigned int chunk )
+    {
+      const SizeValueType lineBegin = std::min( chunk * linesPerChunk, numberOfLines );
+      const SizeValueType lineEnd   = std::min( lineBegin + linesPerChunk, numberOfLines );
+      for( SizeValueType line = lineBegin; line < lineEnd; ++line )
       {
-        /** Get the left, center and right values. */
-        minusIndex[ i ] = currIndex[ i ] - 1;
-        plusIndex[ i ]  = currIndex[ i ] + 1;
-        const RealType minusVal  = static_cast< RealType >( this->m_MovingImage->GetPixel( minusIndex ) );
-        const RealType plusVal   = static_cast< RealType >( this->m_MovingImage->GetPixel( plusIndex ) );
-        const RealType minusDiff = std::abs( minusVal - this->m_ForegroundValue );
-        const RealType plusDiff  = std::abs(  plusVal - this->m_ForegroundValue );
-
-        /** Calculate the gradient. */
-        if( minusDiff >= this->m_Epsilon && plusDiff < this->m_Epsilon )
-        {
-          tempGradPixel[ i ] = 1.0;
-        }
-        else if( minusDiff < this->m_Epsilon && plusDiff >= this->m_Epsilon )
+        /** Determine whether the line lies on an edge in the other dimensions. */
+        bool          onEdge[ MovingImageDimension ];
+        SizeValueType remainder = line;
+        onEdge[ 0 ] = false;
+        for( unsigned int i = 1; i < MovingImageDimension; ++i )
         {
-          tempGradPixel[ i ] = -1.0;
+          const SizeValueType index = remainder % movingSize[ i ];
+          remainder /= movingSize[ i ];
+          onEdge[ i ] = index == 0 || index + 1 == movingSize[ i ];
         }
-        else
+
+        const SizeValueType lineOffset = line * lineLength;
+        for( SizeValueType x = 0; x < lineLength; ++x )
         {
-          tempGradPixel[ i ] = 0.0;
+          const SizeValueType   p        = lineOffset + x;
+          const unsigned char * current  = foregroundBuffer + p;
+          GradientPixelType &   gradient = gradientBuffer[ p ];
+
+          gradient[ 0 ] = ( x == 0 || x + 1 == lineLength ) ? 0.0
+            : static_cast< RealType >( current[ 1 ] ) - static_cast< RealType >( current[ -1 ] );
+          for( unsigned int i = 1; i < MovingImageDimension; ++i )
+          {
+            gradient[ i ] = onEdge[ i ] ? 0.0
+              : static_cast< RealType >( current[ strides[ i ] ] )
+              - static_cast< RealType >( current[ -strides[ i ] ] );
+          }
         }
       }
-
-      /** Reset indices. */
-      minusIndex = currIndex; plusIndex = currIndex;
-
-    } // end for loop
-
-    /** Set the gradient value and increase iterators. */
-    git.Set( tempGradPixel );
-    ++git; ++mit;
-
-  } // end while loop
+    } );
 
   this->m_GradientImage = tempGradientImage;
 
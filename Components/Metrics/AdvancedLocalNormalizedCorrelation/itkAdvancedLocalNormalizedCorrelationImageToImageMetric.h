@@ -0,0 +1,300 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkAdvancedLocalNormalizedCorrelationImageToImageMetric_h
+#define __itkAdvancedLocalNormalizedCorrelationImageToImageMetric_h
+
+#include "itkAdvancedImageToImageMetric.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class AdvancedLocalNormalizedCorrelationImageToImageMetric
+ * \brief Computes the local normalized correlation between two images,
+ * based on AdvancedImageToImageMetric.
+ *
+ * This metric computes the normalized correlation in a box window around
+ * each sample, and averages the squared local correlations over the samples:
+ *
+ * LNCC = - 1/N sum_x sfm(x)^2 / ( sff(x) smm(x) ),
+ *
+ * with sff(x), smm(x) and sfm(x) the sums of the products of the fixed and
+ * moving image values, minus their local means, over the window around x.
+ * Contrary to the global normalized correlation, it is insensitive to a slow
+ * variation of the intensity over the image, such as the bias field of MR
+ * images.
+ *
+ * The window statistics are computed on the voxel grid of the fixed image
+ * region, with box sums by running sums along each dimension, so that the
+ * cost per voxel does not depend on the window size. Each sample uses the
+ * window of its nearest voxel. Every iteration, the moving image is resampled
+ * at the voxels in the windows of the samples, and the box sums of the fixed
+ * and moving image values, their squares and their products are computed
+ * over the voxels that map inside the moving image (mask). Only these valid
+ * voxels count in the local means and sums; the windows of invalid voxels do
+ * not contribute. The box sums visit all voxels of the fixed image region, so
+ * this metric is meant for samplers that take a large part of the voxels,
+ * such as the Full or Grid sampler. It stores about ten values per voxel of
+ * the fixed image region.
+ *
+ * A moving image value contributes to the windows of all samples whose window
+ * contains its voxel. The derivative takes all these windows into account: the
+ * derivative weights of the windows are box summed back onto their voxels, so
+ * that the derivative costs one transform Jacobian per voxel in a window,
+ * whatever the window size.
+ *
+ * \ingroup RegistrationMetrics
+ * \ingroup Metrics
+ */
+
+template< class TFixedImage, class TMovingImage >
+class AdvancedLocalNormalizedCorrelationImageToImageMetric :
+  public AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef AdvancedLocalNormalizedCorrelationImageToImageMetric Self;
+  typedef AdvancedImageToImageMetric<
+    TFixedImage, TMovingImage >                   Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( AdvancedLocalNormalizedCorrelationImageToImageMetric, AdvancedImageToImageMetric );
+
+  /** Typedefs from the superclass. */
+  typedef typename
+    Superclass::CoordinateRepresentationType CoordinateRepresentationType;
+  typedef typename Superclass::MovingImageType            MovingImageType;
+  typedef typename Superclass::MovingImagePixelType       MovingImagePixelType;
+  typedef typename Superclass::MovingImageConstPointer    MovingImageConstPointer;
+  typedef typename Superclass::FixedImageType             FixedImageType;
+  typedef typename Superclass::FixedImageConstPointer     FixedImageConstPointer;
+  typedef typename Superclass::FixedImageRegionType       FixedImageRegionType;
+  typedef typename Superclass::TransformType              TransformType;
+  typedef typename Superclass::TransformPointer           TransformPointer;
+  typedef typename Superclass::InputPointType             InputPointType;
+  typedef typename Superclass::OutputPointType            OutputPointType;
+  typedef typename Superclass::TransformParametersType    TransformParametersType;
+  typedef typename Superclass::TransformJacobianType      TransformJacobianType;
+  typedef typename Superclass::NumberOfParametersType     NumberOfParametersType;
+  typedef typename Superclass::InterpolatorType           InterpolatorType;
+  typedef typename Superclass::InterpolatorPointer        InterpolatorPointer;
+  typedef typename Superclass::RealType                   RealType;
+  typedef typename Superclass::GradientPixelType          GradientPixelType;
+  typedef typename Superclass::GradientImageType          GradientImageType;
+  typedef typename Superclass::GradientImagePointer       GradientImagePointer;
+  typedef typename Superclass::GradientImageFilterType    GradientImageFilterType;
+  typedef typename Superclass::GradientImageFilterPointer GradientImageFilterPointer;
+  typedef typename Superclass::FixedImageMaskType         FixedImageMaskType;
+  typedef typename Superclass::FixedImageMaskPointer      FixedImageMaskPointer;
+  typedef typename Superclass::MovingImageMaskType        MovingImageMaskType;
+  typedef typename Superclass::MovingImageMaskPointer     MovingImageMaskPointer;
+  typedef typename Superclass::MeasureType                MeasureType;
+  typedef typename Superclass::DerivativeType             DerivativeType;
+  typedef typename Superclass::DerivativeValueType        DerivativeValueType;
+  typedef typename Superclass::ParametersType             ParametersType;
+  typedef typename Superclass::FixedImagePixelType        FixedImagePixelType;
+  typedef typename Superclass::MovingImageRegionType      MovingImageRegionType;
+  typedef typename Superclass::ImageSamplerType           ImageSamplerType;
+  typedef typename Superclass::ImageSamplerPointer        ImageSamplerPointer;
+  typedef typename Superclass::ImageSampleContainerType   ImageSampleContainerType;
+  typedef typename
+    Superclass::ImageSampleContainerPointer ImageSampleContainerPointer;
+  typedef typename Superclass::FixedImageLimiterType  FixedImageLimiterType;
+  typedef typename Superclass::MovingImageLimiterType MovingImageLimiterType;
+  typedef typename
+    Superclass::FixedImageLimiterOutputType FixedImageLimiterOutputType;
+  typedef typename
+    Superclass::MovingImageLimiterOutputType MovingImageLimiterOutputType;
+  typedef typename
+    Superclass::MovingImageDerivativeScalesType MovingImageDerivativeScalesType;
+  typedef typename Superclass::ThreaderType   ThreaderType;
+  typedef typename Superclass::ThreadInfoType ThreadInfoType;
+
+  /** The fixed image dimension. */
+  itkStaticConstMacro( FixedImageDimension, unsigned int,
+    FixedImageType::ImageDimension );
+
+  /** The moving image dimension. */
+  itkStaticConstMacro( MovingImageDimension, unsigned int,
+    MovingImageType::ImageDimension );
+
+  /** The radius of the window, in voxels of the fixed image. */
+  typedef typename FixedImageType::SizeType RadiusType;
+
+  /** Get the value for single valued optimizers. */
+  virtual MeasureType GetValueSingleThreaded( const TransformParametersType & parameters ) const;
+
+  MeasureType GetValue( const TransformParametersType & parameters ) const override;
+
+  /** Get the derivatives of the match measure. */
+  void GetDerivative( const TransformParametersType & parameters,
+    DerivativeType & derivative ) const override;
+
+  /** Get value and derivative. */
+  void GetValueAndDerivativeSingleThreaded( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const;
+
+  void GetValueAndDerivative( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const override;
+
+  /** Initialize the Metric by making sure that all the components
+   *  are present and plugged together correctly.
+   * \li Call the superclass' implementation
+   * \li Compute the local statistics of the fixed image.
+   */
+  void Initialize( void ) override;
+
+  /** Set/Get the radius of the window, in voxels. The default is 2 in each
+   * dimension, which gives a window of 5 voxels wide. Set it before Initialize().
+   */
+  itkSetMacro( Radius, RadiusType );
+  itkGetConstReferenceMacro( Radius, RadiusType );
+
+  /** Set the same radius in each dimension. */
+  virtual void SetRadius( const unsigned int radius );
+
+protected:
+
+  AdvancedLocalNormalizedCorrelationImageToImageMetric();
+  ~AdvancedLocalNormalizedCorrelationImageToImageMetric() override{}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Protected Typedefs ******************/
+
+  /** Typedefs inherited from superclass */
+  typedef typename Superclass::FixedImageIndexType            FixedImageIndexType;
+  typedef typename Superclass::FixedImageIndexValueType       FixedImageIndexValueType;
+  typedef typename Superclass::MovingImageIndexType           MovingImageIndexType;
+  typedef typename Superclass::FixedImagePointType            FixedImagePointType;
+  typedef typename Superclass::MovingImagePointType           MovingImagePointType;
+  typedef typename Superclass::MovingImageContinuousIndexType MovingImageContinuousIndexType;
+  typedef typename Superclass::BSplineInterpolatorType        BSplineInterpolatorType;
+  typedef typename Superclass::MovingImageDerivativeType      MovingImageDerivativeType;
+  typedef typename Superclass::NonZeroJacobianIndicesType     NonZeroJacobianIndicesType;
+
+  /** Find the voxels of the samples, resample the moving image in their
+   * windows and compute the box sums of the local statistics, at the current
+   * transform parameters. Called by GetValue() and GetValueAndDerivative().
+   */
+  void ComputeMovingImageStatistics( void ) const;
+
+  /** Compute the derivative of the summed local correlations of the samples
+   * with respect to the moving image value of each voxel. Called by
+   * GetValueAndDerivative() after ComputeMovingImageStatistics().
+   */
+  void ComputeVoxelDerivativeWeights( void ) const;
+
+  /** Compute the local correlation of the window around the voxel at an
+   * offset in the fixed image region. Returns false if this voxel did not map
+   * inside the moving image (mask). If derivativeWeights is not null, its
+   * four values are set to the weights a, a * fixedMean, b and b * movingMean
+   * of the derivative with respect to the moving image values of the window.
+   */
+  bool EvaluateLocalCorrelation( const SizeValueType offset,
+    RealType & localCorrelation, RealType * derivativeWeights ) const;
+
+  /** Add the local correlations of the samples begin to end to measure. */
+  void SumLocalCorrelations( const SizeValueType begin, const SizeValueType end,
+    SizeValueType & numberOfPixelsCounted, MeasureType & measure ) const;
+
+  /** Add the derivative contributions of the voxels begin to end to the
+   * derivative, or store them for sparse accumulation by the thread threadId
+   * if derivative is null.
+   */
+  void AccumulateVoxelDerivatives( const SizeValueType begin, const SizeValueType end,
+    NonZeroJacobianIndicesType & nzji, DerivativeType & imageJacobian,
+    const ThreadIdType threadId, DerivativeType * derivative ) const;
+
+  /** Get value for each thread. */
+  inline void ThreadedGetValue( ThreadIdType threadID ) override;
+
+  /** Gather the values from all threads. */
+  inline void AfterThreadedGetValue( MeasureType & value ) const override;
+
+  /** Get value and derivatives for each thread. */
+  inline void ThreadedGetValueAndDerivative( ThreadIdType threadID ) override;
+
+  /** Gather the values and derivatives from all threads. */
+  inline void AfterThreadedGetValueAndDerivative(
+    MeasureType & value, DerivativeType & derivative ) const override;
+
+private:
+
+  AdvancedLocalNormalizedCorrelationImageToImageMetric( const Self & ); // purposely not implemented
+  void operator=( const Self & );                                       // purposely not implemented
+
+  /** Replace the numberOfChannels interleaved values of each voxel of the
+   * fixed image region by their sums over the window around the voxel.
+   */
+  void ComputeBoxSums( std::vector< RealType > & buffer, const unsigned int numberOfChannels ) const;
+
+  /** Call function( begin, end ) for the chunks of [0, size), in parallel. */
+  template< class TFunction >
+  void ProcessChunks( const SizeValueType size, const TFunction & function ) const;
+
+  /** Get the index of the voxel at an offset in the fixed image region. */
+  FixedImageIndexType ComputeIndex( SizeValueType offset ) const;
+
+  /** Get the offset of the voxel nearest to a point. Returns false if this
+   * voxel is outside the fixed image region.
+   */
+  bool ComputeVoxelOffset( const FixedImagePointType & fixedPoint, SizeValueType & offset ) const;
+
+  RadiusType           m_Radius;
+  FixedImageRegionType m_StatisticsRegion;
+
+  /** The fixed image value of each voxel. */
+  std::vector< RealType > m_FixedVoxelValues;
+
+  /** The voxel of each sample, and the number of samples of each voxel. */
+  mutable std::vector< SizeValueType > m_SampleVoxelOffsets;
+  mutable std::vector< unsigned int >  m_VoxelSampleCounts;
+
+  /** The moving image value of each voxel, and whether it mapped inside the
+   * moving image (mask).
+   */
+  mutable std::vector< RealType >      m_MovingVoxelValues;
+  mutable std::vector< unsigned char > m_MovingVoxelIsValid;
+
+  /** The box sums of 1, F, F * F, M, M * M and F * M over the valid voxels,
+   * interleaved per voxel.
+   */
+  mutable std::vector< RealType > m_LocalSums;
+
+  /** The derivative of the summed local correlations with respect to the
+   * moving image value of each voxel.
+   */
+  mutable std::vector< RealType > m_VoxelDerivativeWeights;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkAdvancedLocalNormalizedCorrelationImageToImageMetric.hxx"
+#endif
+
+#endif // end #ifndef __itkAdvancedLocalNormalizedCorrelationImageToImageMetric_h
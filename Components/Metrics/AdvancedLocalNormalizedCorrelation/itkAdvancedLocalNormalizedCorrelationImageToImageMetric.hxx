@@ -0,0 +1,938 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef _itkAdvancedLocalNormalizedCorrelationImageToImageMetric_hxx
+#define _itkAdvancedLocalNormalizedCorrelationImageToImageMetric_hxx
+
+#include "itkAdvancedLocalNormalizedCorrelationImageToImageMetric.h"
+#include "itkImageRegionConstIterator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::AdvancedLocalNormalizedCorrelationImageToImageMetric()
+{
+  this->SetUseImageSampler( true );
+  this->SetUseFixedImageLimiter( false );
+  this->SetUseMovingImageLimiter( false );
+
+  this->m_Radius.Fill( 2 );
+
+} // end Constructor
+
+
+/**
+ * ******************* SetRadius *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::SetRadius( const unsigned int radius )
+{
+  RadiusType radiusInAllDimensions;
+  radiusInAllDimensions.Fill( radius );
+  this->SetRadius( radiusInAllDimensions );
+
+} // end SetRadius()
+
+
+
+
+/**
+ * ********************* Initialize ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::Initialize( void )
+{
+  /** Initialize transform, interpolator, etc. */
+  Superclass::Initialize();
+
+  /** The statistics are computed on the voxels of the fixed image region. */
+  this->m_StatisticsRegion = this->GetFixedImageRegion();
+  const SizeValueType numberOfVoxels = this->m_StatisticsRegion.GetNumberOfPixels();
+
+  /** Store the fixed image values of the voxels, which do not change. The
+   * local statistics of the fixed image depend on which voxels map inside
+   * the moving image, so they are computed every iteration.
+   */
+  this->m_FixedVoxelValues.resize( numberOfVoxels );
+  ImageRegionConstIterator< FixedImageType > it( this->GetFixedImage(), this->m_StatisticsRegion );
+  for( SizeValueType offset = 0; !it.IsAtEnd(); ++it, ++offset )
+  {
+    this->m_FixedVoxelValues[ offset ] = static_cast< RealType >( it.Get() );
+  }
+
+} // end Initialize()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "Radius: " << this->m_Radius << std::endl;
+  os << indent << "StatisticsRegion: " << this->m_StatisticsRegion << std::endl;
+
+} // end PrintSelf()
+
+
+/**
+ * ******************* ProcessChunks *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TFunction >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ProcessChunks( const SizeValueType size, const TFunction & function ) const
+{
+  const SizeValueType numberOfChunks = std::min< SizeValueType >( size, Self::GetNumberOfWorkUnits() );
+  if( numberOfChunks == 0 )
+  {
+    return;
+  }
+  const SizeValueType chunkSize = ( size + numberOfChunks - 1 ) / numberOfChunks;
+
+  /** The chunks write to disjoint parts of the statistics. */
+  this->ProcessSlices( static_cast< unsigned int >( numberOfChunks ), true,
+    [size, chunkSize, &function]( const unsigned int chunk )
+    {
+      const SizeValueType begin = std::min< SizeValueType >( chunk * chunkSize, size );
+      const SizeValueType end   = std::min< SizeValueType >( begin + chunkSize, size );
+      function( begin, end );
+    } );
+
+} // end ProcessChunks()
+
+
+/**
+ * ******************* ComputeIndex *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >::FixedImageIndexType
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeIndex( SizeValueType offset ) const
+{
+  const typename FixedImageRegionType::IndexType & start = this->m_StatisticsRegion.GetIndex();
+  const typename FixedImageRegionType::SizeType &  size  = this->m_StatisticsRegion.GetSize();
+
+  FixedImageIndexType index;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    index[ d ] = start[ d ] + static_cast< FixedImageIndexValueType >( offset % size[ d ] );
+    offset    /= size[ d ];
+  }
+  return index;
+
+} // end ComputeIndex()
+
+
+/**
+ * ******************* ComputeVoxelOffset *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeVoxelOffset( const FixedImagePointType & fixedPoint, SizeValueType & offset ) const
+{
+  /** Find the voxel nearest to the point. */
+  FixedImageIndexType index;
+  this->GetFixedImage()->TransformPhysicalPointToIndex( fixedPoint, index );
+  if( !this->m_StatisticsRegion.IsInside( index ) )
+  {
+    return false;
+  }
+
+  const typename FixedImageRegionType::IndexType & start = this->m_StatisticsRegion.GetIndex();
+  const typename FixedImageRegionType::SizeType &  size  = this->m_StatisticsRegion.GetSize();
+  SizeValueType stride = 1;
+  offset = 0;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    offset += static_cast< SizeValueType >( index[ d ] - start[ d ] ) * stride;
+    stride *= size[ d ];
+  }
+  return true;
+
+} // end ComputeVoxelOffset()
+
+
+/**
+ * ******************* ComputeBoxSums *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeBoxSums( std::vector< RealType > & buffer, const unsigned int numberOfChannels ) const
+{
+  const typename FixedImageRegionType::SizeType & size = this->m_StatisticsRegion.GetSize();
+  const SizeValueType numberOfVoxels = this->m_StatisticsRegion.GetNumberOfPixels();
+  const SizeValueType C              = numberOfChannels;
+
+  /** The box sum is separable: sum along the lines of each dimension in turn. */
+  SizeValueType stride = 1;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    const SizeValueType length = size[ d ];
+    const SizeValueType radius = this->m_Radius[ d ];
+    if( radius > 0 && length > 1 )
+    {
+      /** Each line is summed with its prefix sums, so the cost does not depend on the radius. */
+      RealType * data = buffer.data();
+      this->ProcessChunks( numberOfVoxels / length,
+        [data, C, stride, length, radius]( const SizeValueType begin, const SizeValueType end )
+        {
+          std::vector< RealType > prefixSums( ( length + 1 ) * C, 0.0 );
+          for( SizeValueType line = begin; line < end; ++line )
+          {
+            RealType * lineData = data + ( ( line / stride ) * stride * length + line % stride ) * C;
+
+            for( SizeValueType i = 0; i < length; ++i )
+            {
+              for( SizeValueType c = 0; c < C; ++c )
+              {
+                prefixSums[ ( i + 1 ) * C + c ] = prefixSums[ i * C + c ] + lineData[ i * stride * C + c ];
+              }
+            }
+
+            for( SizeValueType i = 0; i < length; ++i )
+            {
+              const SizeValueType first = ( i > radius ) ? i - radius : 0;
+              const SizeValueType last  = std::min( i + radius + 1, length );
+              for( SizeValueType c = 0; c < C; ++c )
+              {
+                lineData[ i * stride * C + c ] = prefixSums[ last * C + c ] - prefixSums[ first * C + c ];
+              }
+            }
+          }
+        } );
+    }
+    stride *= length;
+  }
+
+} // end ComputeBoxSums()
+
+
+/**
+ * ******************* ComputeMovingImageStatistics *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeMovingImageStatistics( void ) const
+{
+  const SizeValueType numberOfVoxels  = this->m_StatisticsRegion.GetNumberOfPixels();
+  const SizeValueType lineLength      = this->m_StatisticsRegion.GetSize()[ 0 ];
+  const SizeValueType numberOfSamples = this->GetNumberOfFixedImageSamples();
+
+  /** Find the voxel nearest to each sample. Samples outside the fixed image
+   * region get the offset numberOfVoxels.
+   */
+  this->m_SampleVoxelOffsets.resize( numberOfSamples );
+  this->ProcessChunks( numberOfSamples,
+    [this, numberOfVoxels]( const SizeValueType begin, const SizeValueType end )
+    {
+      const unsigned int  batchSize = Superclass::MovingImageBatchSize;
+      FixedImagePointType fixedPoints[ batchSize ];
+      RealType            fixedImageValues[ batchSize ];
+
+      for( SizeValueType blockBegin = begin; blockBegin < end; blockBegin += batchSize )
+      {
+        const SizeValueType blockSize = std::min< SizeValueType >( end - blockBegin, batchSize );
+        this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+        for( SizeValueType i = 0; i < blockSize; ++i )
+        {
+          SizeValueType offset = 0;
+          this->m_SampleVoxelOffsets[ blockBegin + i ]
+            = this->ComputeVoxelOffset( fixedPoints[ i ], offset ) ? offset : numberOfVoxels;
+        }
+      }
+    } );
+
+  /** Count the samples per voxel. */
+  this->m_VoxelSampleCounts.assign( numberOfVoxels, 0 );
+  for( SizeValueType s = 0; s < numberOfSamples; ++s )
+  {
+    if( this->m_SampleVoxelOffsets[ s ] < numberOfVoxels )
+    {
+      ++this->m_VoxelSampleCounts[ this->m_SampleVoxelOffsets[ s ] ];
+    }
+  }
+
+  /** Only the voxels in the window of a sample are resampled. The box sums
+   * of the sample counts tell which voxels these are.
+   */
+  std::vector< RealType > windowSampleCounts(
+    this->m_VoxelSampleCounts.begin(), this->m_VoxelSampleCounts.end() );
+  this->ComputeBoxSums( windowSampleCounts, 1 );
+
+  /** Resample the moving image at these voxels, per line of the first
+   * dimension, in batches, so that the transform can map the points of a
+   * batch at once. All other voxels are invalid.
+   */
+  this->m_MovingVoxelValues.resize( numberOfVoxels );
+  this->m_MovingVoxelIsValid.resize( numberOfVoxels );
+  this->m_LocalSums.resize( 6 * numberOfVoxels );
+  this->ProcessChunks( numberOfVoxels / lineLength,
+    [this, lineLength, &windowSampleCounts]( const SizeValueType begin, const SizeValueType end )
+    {
+      const FixedImageType * fixedImage = this->GetFixedImage();
+      const unsigned int     batchSize  = Superclass::MovingImageBatchSize;
+      FixedImagePointType    fixedPoints[ batchSize ];
+      MovingImagePointType   mappedPoints[ batchSize ];
+      RealType               movingImageValues[ batchSize ];
+      bool                   samplesOk[ batchSize ];
+      SizeValueType          offsets[ batchSize ];
+
+      for( SizeValueType line = begin; line < end; ++line )
+      {
+        const SizeValueType lineBegin = line * lineLength;
+        std::fill_n( this->m_MovingVoxelValues.begin() + lineBegin, lineLength, 0.0 );
+        std::fill_n( this->m_MovingVoxelIsValid.begin() + lineBegin, lineLength, 0 );
+
+        FixedImageIndexType index = this->ComputeIndex( lineBegin );
+        const FixedImageIndexValueType lineStart = index[ 0 ];
+        for( SizeValueType i = 0; i < lineLength; )
+        {
+          /** Collect the next batch of voxels of the line in a window. */
+          unsigned int blockSize = 0;
+          for( ; i < lineLength && blockSize < batchSize; ++i )
+          {
+            if( windowSampleCounts[ lineBegin + i ] > 0.5 )
+            {
+              index[ 0 ] = lineStart + static_cast< FixedImageIndexValueType >( i );
+              fixedImage->TransformIndexToPhysicalPoint( index, fixedPoints[ blockSize ] );
+              offsets[ blockSize ] = lineBegin + i;
+              ++blockSize;
+            }
+          }
+
+          /** Transform the points, check if they are inside the B-spline
+           * support region and the moving mask, and compute the moving image
+           * values of the points inside the moving image buffer.
+           */
+          this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize );
+          this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+            movingImageValues, 0, samplesOk, blockSize );
+
+          for( unsigned int k = 0; k < blockSize; ++k )
+          {
+            if( samplesOk[ k ] )
+            {
+              this->m_MovingVoxelValues[ offsets[ k ] ]  = movingImageValues[ k ];
+              this->m_MovingVoxelIsValid[ offsets[ k ] ] = 1;
+            }
+          }
+        }
+
+        /** Each valid voxel contributes 1, F, F * F, M, M * M and F * M. */
+        for( SizeValueType offset = lineBegin; offset < lineBegin + lineLength; ++offset )
+        {
+          const RealType valid            = this->m_MovingVoxelIsValid[ offset ] ? 1.0 : 0.0;
+          const RealType fixedImageValue  = valid * this->m_FixedVoxelValues[ offset ];
+          const RealType movingImageValue = this->m_MovingVoxelValues[ offset ];
+          RealType *     sums             = &this->m_LocalSums[ 6 * offset ];
+          sums[ 0 ] = valid;
+          sums[ 1 ] = fixedImageValue;
+          sums[ 2 ] = fixedImageValue * fixedImageValue;
+          sums[ 3 ] = movingImageValue;
+          sums[ 4 ] = movingImageValue * movingImageValue;
+          sums[ 5 ] = fixedImageValue * movingImageValue;
+        }
+      }
+    } );
+
+  /** Sum these over the windows. */
+  this->ComputeBoxSums( this->m_LocalSums, 6 );
+
+} // end ComputeMovingImageStatistics()
+
+
+/**
+ * ******************* EvaluateLocalCorrelation *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+bool
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::EvaluateLocalCorrelation( const SizeValueType offset,
+  RealType & localCorrelation, RealType * derivativeWeights ) const
+{
+  if( !this->m_MovingVoxelIsValid[ offset ] )
+  {
+    return false;
+  }
+
+  /** The local statistics of the valid voxels of the window, which include
+   * the voxel itself.
+   */
+  const RealType * sums       = &this->m_LocalSums[ 6 * offset ];
+  const RealType   n          = sums[ 0 ];
+  const RealType   fixedMean  = sums[ 1 ] / n;
+  const RealType   movingMean = sums[ 3 ] / n;
+  const RealType   sff        = std::max< RealType >( sums[ 2 ] - sums[ 1 ] * fixedMean, 0.0 );
+  const RealType   smm        = std::max< RealType >( sums[ 4 ] - sums[ 3 ] * movingMean, 0.0 );
+  const RealType   sfm        = sums[ 5 ] - fixedMean * sums[ 3 ];
+
+  /** A flat window does not contribute. */
+  localCorrelation = 0.0;
+  if( derivativeWeights )
+  {
+    std::fill_n( derivativeWeights, 4, 0.0 );
+  }
+  const RealType denominator = sff * smm;
+  if( denominator < 1e-14 )
+  {
+    return true;
+  }
+
+  /** The derivative of the local correlation with respect to the moving image
+   * value of a valid voxel y of the window is
+   *   a ( F(y) - fixedMean ) - b ( M(y) - movingMean ),
+   * with a = 2 sfm / ( sff smm ) and b = a sfm / smm.
+   */
+  localCorrelation = sfm * sfm / denominator;
+  if( derivativeWeights )
+  {
+    const RealType a = 2.0 * sfm / denominator;
+    const RealType b = a * sfm / smm;
+    derivativeWeights[ 0 ] = a;
+    derivativeWeights[ 1 ] = a * fixedMean;
+    derivativeWeights[ 2 ] = b;
+    derivativeWeights[ 3 ] = b * movingMean;
+  }
+  return true;
+
+} // end EvaluateLocalCorrelation()
+
+
+/**
+ * ******************* ComputeVoxelDerivativeWeights *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeVoxelDerivativeWeights( void ) const
+{
+  const SizeValueType numberOfVoxels = this->m_StatisticsRegion.GetNumberOfPixels();
+
+  /** For each voxel x with samples, store the weights a, a * fixedMean, b and
+   * b * movingMean of EvaluateLocalCorrelation(), times the number of samples.
+   */
+  std::vector< RealType > weights( 4 * numberOfVoxels );
+  this->ProcessChunks( numberOfVoxels,
+    [this, &weights]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType offset = begin; offset < end; ++offset )
+      {
+        RealType *         voxelWeights = &weights[ 4 * offset ];
+        const unsigned int count        = this->m_VoxelSampleCounts[ offset ];
+        RealType           localCorrelation;
+        std::fill_n( voxelWeights, 4, 0.0 );
+        if( count > 0 && this->EvaluateLocalCorrelation( offset, localCorrelation, voxelWeights ) )
+        {
+          for( unsigned int c = 0; c < 4; ++c )
+          {
+            voxelWeights[ c ] *= static_cast< RealType >( count );
+          }
+        }
+      }
+    } );
+
+  /** A voxel y lies in the windows of the voxels x in its own window, so the
+   * box sums of the weights give the sums over these x. The derivative of the
+   * summed local correlations with respect to M(y) is then
+   *   F(y) sum_x a - sum_x a fixedMean - M(y) sum_x b + sum_x b movingMean.
+   */
+  this->ComputeBoxSums( weights, 4 );
+  this->m_VoxelDerivativeWeights.resize( numberOfVoxels );
+  this->ProcessChunks( numberOfVoxels,
+    [this, &weights]( const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType offset = begin; offset < end; ++offset )
+      {
+        const RealType * sums = &weights[ 4 * offset ];
+        this->m_VoxelDerivativeWeights[ offset ] = this->m_MovingVoxelIsValid[ offset ]
+          ? this->m_FixedVoxelValues[ offset ] * sums[ 0 ] - sums[ 1 ]
+          - this->m_MovingVoxelValues[ offset ] * sums[ 2 ] + sums[ 3 ]
+          : 0.0;
+      }
+    } );
+
+} // end ComputeVoxelDerivativeWeights()
+
+
+/**
+ * ******************* SumLocalCorrelations *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::SumLocalCorrelations( const SizeValueType begin, const SizeValueType end,
+  SizeValueType & numberOfPixelsCounted, MeasureType & measure ) const
+{
+  const SizeValueType numberOfVoxels = this->m_MovingVoxelIsValid.size();
+  for( SizeValueType s = begin; s < end; ++s )
+  {
+    const SizeValueType offset = this->m_SampleVoxelOffsets[ s ];
+    RealType            localCorrelation;
+    if( offset < numberOfVoxels && this->EvaluateLocalCorrelation( offset, localCorrelation, 0 ) )
+    {
+      numberOfPixelsCounted++;
+      measure -= localCorrelation;
+    }
+  }
+
+} // end SumLocalCorrelations()
+
+
+/**
+ * ******************* AccumulateVoxelDerivatives *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::AccumulateVoxelDerivatives( const SizeValueType begin, const SizeValueType end,
+  NonZeroJacobianIndicesType & nzji, DerivativeType & imageJacobian,
+  const ThreadIdType threadId, DerivativeType * derivative ) const
+{
+  const FixedImageType *    fixedImage = this->GetFixedImage();
+  const unsigned int        batchSize  = Superclass::MovingImageBatchSize;
+  FixedImagePointType       fixedPoints[ batchSize ];
+  MovingImagePointType      mappedPoints[ batchSize ];
+  RealType                  movingImageValues[ batchSize ];
+  MovingImageDerivativeType movingImageDerivatives[ batchSize ];
+  bool                      samplesOk[ batchSize ];
+  RealType                  voxelWeights[ batchSize ];
+
+  for( SizeValueType offset = begin; offset < end; )
+  {
+    /** Collect the next batch of voxels that contribute to the derivative. */
+    unsigned int blockSize = 0;
+    for( ; offset < end && blockSize < batchSize; ++offset )
+    {
+      const RealType voxelWeight = this->m_VoxelDerivativeWeights[ offset ];
+      if( voxelWeight != 0.0 )
+      {
+        fixedImage->TransformIndexToPhysicalPoint( this->ComputeIndex( offset ), fixedPoints[ blockSize ] );
+        voxelWeights[ blockSize ] = voxelWeight;
+        ++blockSize;
+      }
+    }
+
+    /** Compute the moving image derivatives dM/dx at the mapped voxels. */
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+      movingImageValues, movingImageDerivatives, samplesOk, blockSize );
+
+    for( unsigned int k = 0; k < blockSize; ++k )
+    {
+      if( !samplesOk[ k ] )
+      {
+        continue;
+      }
+
+      /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
+      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+        fixedPoints[ k ], movingImageDerivatives[ k ], imageJacobian, nzji );
+
+      if( derivative )
+      {
+        for( unsigned int i = 0; i < nzji.size(); ++i )
+        {
+          ( *derivative )[ nzji[ i ] ] -= voxelWeights[ k ] * imageJacobian[ i ];
+        }
+      }
+      else
+      {
+        this->AddSparseDerivativeTerms( threadId, imageJacobian, nzji, -voxelWeights[ k ] );
+      }
+    }
+  }
+
+} // end AccumulateVoxelDerivatives()
+
+
+/**
+ * ******************* GetValueSingleThreaded *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueSingleThreaded( const TransformParametersType & parameters ) const
+{
+  itkDebugMacro( "GetValue( " << parameters << " ) " );
+
+  /** Initialize some variables. */
+  this->m_NumberOfPixelsCounted = 0;
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Compute the local statistics of the moving image. */
+  this->ComputeMovingImageStatistics();
+
+  /** Sum the local correlations of the samples. */
+  const SizeValueType numberOfSamples = this->m_SampleVoxelOffsets.size();
+  SizeValueType       numberOfPixelsCounted = 0;
+  this->SumLocalCorrelations( 0, numberOfSamples, numberOfPixelsCounted, measure );
+  this->m_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
+
+  /** Average over the samples. */
+  return measure / static_cast< MeasureType >( this->m_NumberOfPixelsCounted );
+
+} // end GetValueSingleThreaded()
+
+
+/**
+ * ******************* GetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValue( const TransformParametersType & parameters ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueSingleThreaded( parameters );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Compute the local statistics of the moving image. */
+  this->ComputeMovingImageStatistics();
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueThreaderCallback();
+
+  /** Gather the metric values from all threads. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->AfterThreadedGetValue( value );
+
+  return value;
+
+} // end GetValue()
+
+
+/**
+ * ******************* ThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetValue( ThreadIdType threadId )
+{
+  /** Get the samples for this thread. */
+  const unsigned long sampleContainerSize = this->m_SampleVoxelOffsets.size();
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  SizeValueType numberOfPixelsCounted = 0;
+  MeasureType   measure               = NumericTraits< MeasureType >::Zero;
+
+  /** Sum the local correlations of the samples of this thread. */
+  this->SumLocalCorrelations( pos_begin, pos_end, numberOfPixelsCounted, measure );
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
+
+} // end ThreadedGetValue()
+
+
+/**
+ * ******************* AfterThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetValue( MeasureType & value ) const
+{
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
+
+  /** Accumulate the number of pixels. */
+  this->m_NumberOfPixelsCounted = this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
+  for( ThreadIdType i = 1; i < numberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
+  }
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples( this->m_SampleVoxelOffsets.size(), this->m_NumberOfPixelsCounted );
+
+  /** Accumulate values. */
+  value = NumericTraits< MeasureType >::Zero;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    value += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value = NumericTraits< MeasureType >::Zero;
+  }
+  value /= static_cast< MeasureType >( this->m_NumberOfPixelsCounted );
+
+} // end AfterThreadedGetValue()
+
+
+/**
+ * ******************* GetDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::GetDerivative(
+  const TransformParametersType & parameters,
+  DerivativeType & derivative ) const
+{
+  /** When the derivative is calculated, all information for calculating
+   * the metric value is available. It does not cost anything to calculate
+   * the metric value now. Therefore, we have chosen to only implement the
+   * GetValueAndDerivative(), supplying it with a dummy value variable.
+   */
+  MeasureType dummyvalue = NumericTraits< MeasureType >::Zero;
+  this->GetValueAndDerivative( parameters, dummyvalue, derivative );
+
+} // end GetDerivative()
+
+
+/**
+ * ******************* GetValueAndDerivativeSingleThreaded *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivativeSingleThreaded(
+  const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  itkDebugMacro( "GetValueAndDerivative( " << parameters << " ) " );
+
+  /** Initialize some variables. */
+  this->m_NumberOfPixelsCounted = 0;
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  derivative = DerivativeType( this->GetNumberOfParameters() );
+  derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+
+  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
+  NonZeroJacobianIndicesType nzji(
+    this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+  DerivativeType imageJacobian( nzji.size() );
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Compute the local statistics of the moving image, and the derivative of
+   * the summed local correlations with respect to each moving image value.
+   */
+  this->ComputeMovingImageStatistics();
+  this->ComputeVoxelDerivativeWeights();
+
+  /** Sum the local correlations of the samples. */
+  const SizeValueType numberOfSamples = this->m_SampleVoxelOffsets.size();
+  SizeValueType       numberOfPixelsCounted = 0;
+  this->SumLocalCorrelations( 0, numberOfSamples, numberOfPixelsCounted, measure );
+  this->m_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
+
+  /** Add the derivatives of the moving image values of all voxels. */
+  this->AccumulateVoxelDerivatives( 0, this->m_VoxelDerivativeWeights.size(),
+    nzji, imageJacobian, 0, &derivative );
+
+  /** Average over the samples. */
+  const double normal_sum = 1.0 / static_cast< double >( this->m_NumberOfPixelsCounted );
+  value       = measure * normal_sum;
+  derivative *= normal_sum;
+
+} // end GetValueAndDerivativeSingleThreaded()
+
+
+/**
+ * ******************* GetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivative(
+  const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueAndDerivativeSingleThreaded(
+      parameters, value, derivative );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Compute the local statistics of the moving image, and the derivative of
+   * the summed local correlations with respect to each moving image value.
+   */
+  this->ComputeMovingImageStatistics();
+  this->ComputeVoxelDerivativeWeights();
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueAndDerivativeThreaderCallback();
+
+  /** Gather the metric values and derivatives from all threads. */
+  this->AfterThreadedGetValueAndDerivative( value, derivative );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ******************* ThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetValueAndDerivative( ThreadIdType threadId )
+{
+  /** Get the pre-allocated arrays that store dM(x)/dmu, and the sparse Jacobian + indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji          = arena.sa_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = arena.sa_ImageJacobian;
+
+  /** Get a handle to the pre-allocated derivative for the current thread. */
+  DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
+
+  /** Get the samples and the voxels for this thread. */
+  const ThreadIdType  numberOfThreads     = Self::GetNumberOfReductionChunks();
+  const unsigned long sampleContainerSize = this->m_SampleVoxelOffsets.size();
+  const unsigned long numberOfVoxels      = this->m_VoxelDerivativeWeights.size();
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( numberOfThreads ) ) );
+  const unsigned long nrOfVoxelsPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( numberOfVoxels )
+    / static_cast< double >( numberOfThreads ) ) );
+
+  const unsigned long pos_begin   = std::min( nrOfSamplesPerThreads * threadId, sampleContainerSize );
+  const unsigned long pos_end     = std::min( nrOfSamplesPerThreads * ( threadId + 1 ), sampleContainerSize );
+  const unsigned long voxel_begin = std::min( nrOfVoxelsPerThreads * threadId, numberOfVoxels );
+  const unsigned long voxel_end   = std::min( nrOfVoxelsPerThreads * ( threadId + 1 ), numberOfVoxels );
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  SizeValueType numberOfPixelsCounted = 0;
+  MeasureType   measure               = NumericTraits< MeasureType >::Zero;
+
+  /** Sum the local correlations of the samples of this thread. */
+  this->SumLocalCorrelations( pos_begin, pos_end, numberOfPixelsCounted, measure );
+
+  /** Add the derivatives of the moving image values of the voxels of this thread. */
+  this->AccumulateVoxelDerivatives( voxel_begin, voxel_end, nzji, imageJacobian, threadId,
+    this->m_UseSparseDerivativeAccumulation ? 0 : &derivative );
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
+
+} // end ThreadedGetValueAndDerivative()
+
+
+/**
+ * ******************* AfterThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedLocalNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetValueAndDerivative(
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  /** Gather the number of pixels and the value. */
+  this->AfterThreadedGetValue( value );
+
+  /** Accumulate and normalize the derivatives with the threads. */
+  this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
+  this->m_ThreaderMetricParameters.st_NormalizationFactor
+    = static_cast< DerivativeValueType >( this->m_NumberOfPixelsCounted );
+
+  this->LaunchThreaderCallback( this->AccumulateDerivativesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+
+} // end AfterThreadedGetValueAndDerivative()
+
+
+} // end namespace itk
+
+#endif // end #ifndef _itkAdvancedLocalNormalizedCorrelationImageToImageMetric_hxx
@@ -78,6 +78,23 @@ namespace elastix
  *    example: <tt>(MovingLimitRangeRatio 0.001 0.01 0.01)</tt> \n
  *    The default value is 0.01. Can be given for each resolution, or for
  *    all resolutions at once.
+ * \parameter PDFAccumulationMode: How the joint histogram is accumulated
+ *    multi-threadedly. "ThreadPrivate" lets every thread fill its own joint
+ *    histogram, which are summed afterwards. "Sharded" lets every thread fill
+ *    a disjoint band of bins of a single shared histogram, which saves memory
+ *    and the serial merge step for large numbers of threads. Both modes give
+ *    the same results. Can be given for each resolution, or for all
+ *    resolutions at once. \n
+ *    example: <tt>(PDFAccumulationMode "Sharded")</tt> \n
+ *    The default is "ThreadPrivate".
+ * \parameter UseFixedParzenWindowCache: Whether to compute the fixed Parzen
+ *    window of every sample only once for as long as the samples do not
+ *    change, for example with a "Full" or "Grid" sampler, or with
+ *    NewSamplesEveryIteration set to "false". The joint histogram and the
+ *    derivative of the fast and low memory version use the cache. Can be
+ *    given for each resolution, or for all resolutions at once. \n
+ *    example: <tt>(UseFixedParzenWindowCache "true")</tt> \n
+ *    The default is false.
  * \parameter FiniteDifferenceDerivative: Experimental feature, do not use.
  * \parameter UseFastAndLowMemoryVersion: Switch between a version of
  *    mutual information that explicitely computes the derivatives of the
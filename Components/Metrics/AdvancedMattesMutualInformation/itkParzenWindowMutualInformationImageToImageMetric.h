@@ -170,6 +170,7 @@ protected:
   /** Typedefs inherited from superclass */
   typedef typename Superclass::FixedImageIndexType                 FixedImageIndexType;
   typedef typename Superclass::FixedImageIndexValueType            FixedImageIndexValueType;
+  typedef typename Superclass::OffsetValueType                     OffsetValueType;
   typedef typename Superclass::MovingImageIndexType                MovingImageIndexType;
   typedef typename Superclass::FixedImagePointType                 FixedImagePointType;
   typedef typename Superclass::MovingImagePointType                MovingImagePointType;
@@ -276,10 +277,13 @@ private:
 
   void ComputeDerivativeLowMemory( DerivativeType & derivative ) const;
 
-  /** Helper function to update the derivative for the low memory variant. */
+  /** Helper function to update the derivative for the low memory variant.
+   * The sample index is used to read the fixed Parzen window from the cache.
+   */
   void UpdateDerivativeLowMemory(
     const RealType & fixedImageValue,
     const RealType & movingImageValue,
+    const SizeValueType sampleIndex,
     const DerivativeType & imageJacobian,
     const NonZeroJacobianIndicesType & nzji,
     DerivativeType & derivative ) const;
@@ -329,7 +329,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     MovingImagePointType        mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if the point is inside the moving mask. */
     if( sampleOk )
@@ -358,7 +358,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
         ->Evaluate( movingImageValue, movingImageDerivative );
 
       /** Get the transform Jacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateSampleTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the inner product (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
@@ -384,7 +384,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 
       /** Compute this sample's contribution to the joint distributions. */
       this->UpdateDerivativeLowMemory(
-        fixedImageValue, movingImageValue, imageJacobian, nzji, derivative );
+        fixedImageValue, movingImageValue, fiter.Index(), imageJacobian, nzji, derivative );
 
     } // end sampleOk
   } // end loop over sample container
@@ -443,10 +443,10 @@ void
 ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedComputeDerivativeLowMemory( ThreadIdType threadId )
 {
-  /** Initialize array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
-  const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  NonZeroJacobianIndicesType   nzji  = NonZeroJacobianIndicesType( nnzji );
-  DerivativeType               imageJacobian( nzji.size() );
+  /** Get the pre-allocated arrays that store dM(x)/dmu, and the sparse Jacobian + indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji          = arena.sa_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = arena.sa_ImageJacobian;
 
   /** Get a handle to the pre-allocated derivative for the current thread.
    * The initialization is performed at the beginning of each resolution in
@@ -456,10 +456,10 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
 
   /** Declare and allocate arrays for Jacobian preconditioning. */
-  DerivativeType jacobianPreconditioner, preconditioningDivisor;
+  DerivativeType & jacobianPreconditioner = arena.sa_ImageJacobian2;
+  DerivativeType   preconditioningDivisor;
   if( this->GetUseJacobianPreconditioning() )
   {
-    jacobianPreconditioner = DerivativeType( nzji.size() );
     preconditioningDivisor = DerivativeType( this->GetNumberOfParameters() );
     preconditioningDivisor.Fill( 0.0 );
   }
@@ -471,51 +471,62 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   /** Get the samples for this thread. */
   const unsigned long nrOfSamplesPerThreads
     = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( Self::GetNumberOfWorkUnits() ) ) );
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
 
   unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
   unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
   pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
   pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
-  fbegin                                                 += (int)pos_begin;
-  fend                                                   += (int)pos_end;
+  /** The moving image values and derivatives are evaluated per block of
+   * samples, so that the interpolation method is chosen once per block.
+   */
+  const unsigned int        batchSize = Superclass::MovingImageBatchSize;
+  MovingImagePointType      mappedPoints[ batchSize ];
+  RealType                  movingImageValues[ batchSize ];
+  MovingImageDerivativeType movingImageDerivatives[ batchSize ];
+  bool                      samplesOk[ batchSize ];
 
   /** Loop over sample container and compute contribution of each sample to pdfs. */
-  for( fiter = fbegin; fiter != fend; ++fiter )
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
   {
-    /** Read fixed coordinates and create some variables. */
-    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImageDerivativeType   movingImageDerivative;
-    MovingImagePointType        mappedPoint;
+    const unsigned int blockSize = ( pos_end - blockBegin < batchSize )
+      ? static_cast< unsigned int >( pos_end - blockBegin ) : batchSize;
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-
-    /** Check if the point is inside the moving mask. */
-    if( sampleOk )
+    /** Transform the points and check if they are inside the B-spline
+     * support region and inside the moving mask.
+     */
+    for( unsigned int i = 0; i < blockSize; ++i )
     {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
+      const FixedImagePointType & fixedPoint
+        = sampleContainer->ElementAt( blockBegin + i ).m_ImageCoordinates;
+      samplesOk[ i ] = this->TransformSamplePoint( blockBegin + i, fixedPoint, mappedPoints[ i ] );
+      if( samplesOk[ i ] )
+      {
+        samplesOk[ i ] = this->IsInsideMovingMask( mappedPoints[ i ] );
+      }
     }
 
-    /** Compute the moving image value, its derivative, and check
-     * if the point is inside the moving image buffer.
+    /** Compute the moving image values, their derivatives, and check
+     * if the points are inside the moving image buffer.
      */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
-    }
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+      movingImageValues, movingImageDerivatives, samplesOk, blockSize );
 
-    if( sampleOk )
+    for( unsigned int i = 0; i < blockSize; ++i )
     {
+      if( !samplesOk[ i ] )
+      {
+        continue;
+      }
+
       /** Get the fixed image value. */
-      RealType fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
+      const unsigned long         pos                   = blockBegin + i;
+      const FixedImagePointType & fixedPoint            = sampleContainer->ElementAt( pos ).m_ImageCoordinates;
+      MovingImageDerivativeType & movingImageDerivative = movingImageDerivatives[ i ];
+      RealType                    movingImageValue      = movingImageValues[ i ];
+      RealType                    fixedImageValue
+        = static_cast< RealType >( sampleContainer->ElementAt( pos ).m_ImageValue );
 
       /** Make sure the values fall within the histogram range. */
       fixedImageValue  = this->GetFixedImageLimiter()->Evaluate( fixedImageValue );
@@ -531,21 +542,21 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 #else
       /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+      this->EvaluateSampleJacobianWithImageGradientProduct( pos,
         fixedPoint, movingImageDerivative, imageJacobian, nzji );
 #endif
 
       /** If desired, apply the technique introduced by Tustison. */
-      TransformJacobianType jacobian;
       if( this->GetUseJacobianPreconditioning() )
       {
-        this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+        TransformJacobianType & jacobian = arena.sa_TransformJacobian;
+        this->EvaluateSampleTransformJacobian( pos, fixedPoint, jacobian, nzji );
 
         this->ComputeJacobianPreconditioner( jacobian, nzji,
           jacobianPreconditioner, preconditioningDivisor );
         DerivativeValueType * imjacit   = imageJacobian.begin();
         DerivativeValueType * jacprecit = jacobianPreconditioner.begin();
-        for( unsigned int i = 0; i < nzji.size(); ++i )
+        for( unsigned int j = 0; j < nzji.size(); ++j )
         {
           while( imjacit != imageJacobian.end() )
           {
@@ -558,10 +569,10 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 
       /** Compute this sample's contribution to the joint distributions. */
       this->UpdateDerivativeLowMemory(
-        fixedImageValue, movingImageValue, imageJacobian, nzji,
+        fixedImageValue, movingImageValue, pos, imageJacobian, nzji,
         derivative );
 
-    } // end sampleOk
+    } // end loop over the samples of the block
   } // end loop over sample container
 
   /** If desired, apply the technique introduced by Tustison. */
@@ -594,7 +605,7 @@ void
 ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 ::AfterThreadedComputeDerivativeLowMemory( DerivativeType & derivative ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate derivatives. */
   // compute single-threadedly
@@ -630,9 +641,8 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
     this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
     this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0;
 
-    this->m_Threader->SetSingleMethod( this->AccumulateDerivativesThreaderCallback,
+    this->LaunchThreaderCallback( this->AccumulateDerivativesThreaderCallback,
       const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-    this->m_Threader->SingleMethodExecute();
   }
 
 } // end AfterThreadedComputeDerivativeLowMemory()
@@ -669,14 +679,11 @@ void
 ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 ::LaunchComputeDerivativeLowMemoryThreaderCallback( void ) const
 {
-  /** Setup threader. */
-  this->m_Threader->SetSingleMethod( this->ComputeDerivativeLowMemoryThreaderCallback,
+  /** Launch. */
+  this->LaunchThreaderCallback( this->ComputeDerivativeLowMemoryThreaderCallback,
     const_cast< void * >( static_cast< const void * >(
       &this->m_ParzenWindowMutualInformationThreaderParameters ) ) );
 
-  /** Launch. */
-  this->m_Threader->SingleMethodExecute();
-
 } // end LaunchComputeDerivativeLowMemoryThreaderCallback()
 
 
@@ -767,6 +774,7 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 ::UpdateDerivativeLowMemory(
   const RealType & fixedImageValue,
   const RealType & movingImageValue,
+  const SizeValueType sampleIndex,
   const DerivativeType & imageJacobian,
   const NonZeroJacobianIndicesType & nzji,
   DerivativeType & derivative ) const
@@ -786,24 +794,19 @@ ParzenWindowMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   /** Determine the affected region. */
 
   /** Determine Parzen window arguments (see eq. 6 of Mattes paper [2]). */
-  const double fixedImageParzenWindowTerm
-    = fixedImageValue / this->m_FixedImageBinSize - this->m_FixedImageNormalizedMin;
   const double movingImageParzenWindowTerm
     = movingImageValue / this->m_MovingImageBinSize - this->m_MovingImageNormalizedMin;
 
   /** The lowest bin numbers affected by this pixel: */
-  const int fixedParzenWindowIndex
-    = static_cast< int >( std::floor(
-    fixedImageParzenWindowTerm + this->m_FixedParzenTermToIndexOffset ) );
   const int movingParzenWindowIndex
     = static_cast< int >( std::floor(
     movingImageParzenWindowTerm + this->m_MovingParzenTermToIndexOffset ) );
 
-  /** Compute the fixed Parzen values. */
+  /** Get the lowest fixed bin number and the fixed Parzen values. */
+  OffsetValueType          fixedParzenWindowIndex;
   ParzenValueContainerType fixedParzenValues( this->m_JointPDFWindow.GetSize()[ 1 ] );
-  this->EvaluateParzenValues(
-    fixedImageParzenWindowTerm, fixedParzenWindowIndex,
-    this->m_FixedKernel, fixedParzenValues );
+  this->EvaluateFixedParzenWindow( fixedImageValue, sampleIndex,
+    fixedParzenWindowIndex, fixedParzenValues );
 
   /** Compute the derivatives of the moving Parzen window. */
   ParzenValueContainerType derivativeMovingParzenValues( this->m_JointPDFWindow.GetSize()[ 0 ] );
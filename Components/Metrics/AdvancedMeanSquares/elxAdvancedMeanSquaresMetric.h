@@ -36,6 +36,27 @@ namespace elastix
  *    where range represents the maximum gray value range of the images.\n
  *    <tt>(UseNormalization "true")</tt>\n
  *    The default value is false.
+ * \parameter UseSparseDerivativeAccumulation: Bool to accumulate the derivative
+ *    sparsely over the threads, instead of using a full-length derivative per thread.
+ *    This saves memory and time for transforms with sparse Jacobians, such as the
+ *    B-spline with a fine grid. Can be given for each resolution.\n
+ *    <tt>(UseSparseDerivativeAccumulation "true")</tt>\n
+ *    The default value is false.
+ * \parameter MetricComputationPrecision: The precision in which the threads accumulate
+ *    the derivative contributions of the samples, "double" or "float". With "float" the
+ *    contributions are added to a single precision copy of the derivative, which is added
+ *    to the double precision derivative every few hundred samples. The value and the sum
+ *    over the threads stay in double precision. Ignored with UseSparseDerivativeAccumulation.
+ *    Can be given for each resolution.\n
+ *    <tt>(MetricComputationPrecision "float")</tt>\n
+ *    The default value is "double".
+ * \parameter MovingImagePrefetchDepth: The number of blocks of 64 samples that the threads
+ *    transform ahead of the interpolation, prefetching the moving image data of these
+ *    samples, from 0 to 4. With 0 the loop over the samples is not pipelined. The results
+ *    do not depend on it. It helps for B-spline and linear interpolators, when the moving
+ *    image or its coefficients do not fit in the cache. Can be given for each resolution.\n
+ *    <tt>(MovingImagePrefetchDepth 2)</tt>\n
+ *    The default value is 0.
  *
  * \ingroup Metrics
  *
@@ -82,6 +82,29 @@ AdvancedMeanSquaresMetric< TElastix >
     "SelfHessianNoiseRange", this->GetComponentLabel(), level, 0 );
   this->SetSelfHessianNoiseRange( selfHessianNoiseRange );
 
+  /** Select sparse accumulation of the derivative over the threads. */
+  bool useSparseDerivativeAccumulation = false;
+  this->GetConfiguration()->ReadParameter( useSparseDerivativeAccumulation,
+    "UseSparseDerivativeAccumulation", this->GetComponentLabel(), level, 0 );
+  this->SetUseSparseDerivativeAccumulation( useSparseDerivativeAccumulation );
+
+  /** Select the precision of the accumulation of the derivative in the threads. */
+  std::string metricComputationPrecision = "double";
+  this->GetConfiguration()->ReadParameter( metricComputationPrecision,
+    "MetricComputationPrecision", this->GetComponentLabel(), level, 0 );
+  if( metricComputationPrecision != "double" && metricComputationPrecision != "float" )
+  {
+    xl::xout[ "warning" ] << "WARNING: MetricComputationPrecision \"" << metricComputationPrecision
+                          << "\" is not supported, using \"double\"." << std::endl;
+  }
+  this->SetUseSinglePrecisionDerivativeAccumulation( metricComputationPrecision == "float" );
+
+  /** Set the number of sample blocks transformed ahead of the interpolation. */
+  unsigned int movingImagePrefetchDepth = 0;
+  this->GetConfiguration()->ReadParameter( movingImagePrefetchDepth,
+    "MovingImagePrefetchDepth", this->GetComponentLabel(), level, 0 );
+  this->SetMovingImagePrefetchDepth( movingImagePrefetchDepth );
+
   /** Select the use of an OpenMP implementation for GetValueAndDerivative. */
   std::string useOpenMP = this->m_Configuration->GetCommandLineArgument( "-useOpenMP_SSD" );
   if( useOpenMP == "true" )
@@ -23,6 +23,7 @@
 #include "itkSmoothingRecursiveGaussianImageFilter.h"   // needed for SelfHessian
 #include "itkImageGridSampler.h"                        // needed for SelfHessian
 #include "itkNearestNeighborInterpolateImageFunction.h" // needed for SelfHessian
+#include "itkParallelSparseMatrixAssembler.h"           // needed for SelfHessian
 
 namespace itk
 {
@@ -47,6 +48,9 @@ namespace itk
  * \li Image derivatives are computed using either the B-spline interpolator's implementation
  * or by nearest neighbor interpolation of a precomputed central difference image.
  * \li A minimum number of samples that should map within the moving image (mask) can be specified.
+ * \li GetValueAndDerivative() skips the samples of the FrozenSampleFunction.
+ * \li GetValue() and GetValueAndDerivative() reduce their sums and derivative
+ * with the RawStateReductionFunction.
  *
  * \ingroup RegistrationMetrics
  * \ingroup Metrics
@@ -103,6 +107,9 @@ public:
   typedef typename Superclass::DerivativeType             DerivativeType;
   typedef typename Superclass::DerivativeValueType        DerivativeValueType;
   typedef typename Superclass::ParametersType             ParametersType;
+  typedef typename Superclass::ParametersVectorType       ParametersVectorType;
+  typedef typename Superclass::MeasureVectorType          MeasureVectorType;
+  typedef typename Superclass::DerivativeVectorType       DerivativeVectorType;
   typedef typename Superclass::FixedImagePixelType        FixedImagePixelType;
   typedef typename Superclass::MovingImageRegionType      MovingImageRegionType;
   typedef typename Superclass::ImageSamplerType           ImageSamplerType;
@@ -208,6 +215,8 @@ protected:
   typedef typename Superclass::CentralDifferenceGradientFilterType CentralDifferenceGradientFilterType;
   typedef typename Superclass::MovingImageDerivativeType           MovingImageDerivativeType;
   typedef typename Superclass::NonZeroJacobianIndicesType          NonZeroJacobianIndicesType;
+  typedef typename Superclass::AdvancedTransformType               AdvancedTransformType;
+  typedef typename Superclass::AdvancedTransformPointer            AdvancedTransformPointer;
 
   /** Protected typedefs for SelfHessian */
   typedef SmoothingRecursiveGaussianImageFilter<
@@ -220,22 +229,57 @@ protected:
 
   double m_NormalizationFactor;
 
-  /** Compute a pixel's contribution to the measure and derivatives;
+  /** The threads of ThreadedGetValueAndDerivative() skip the samples before
+   * this one, which a subclass evaluates elsewhere, for example on a GPU.
+   * Zero by default.
+   */
+  mutable SizeValueType m_FirstThreadedSample;
+
+  /** Reduce the sum of the squared differences, the number of pixels counted
+   * and the number of samples with the RawStateReductionFunction, before
+   * they are normalized. Does nothing if that function is not set.
+   */
+  void ReduceRawValueState( MeasureType & measure, SizeValueType & numberOfSamples ) const;
+
+  /** Compute a pixel's contribution to the measure and derivatives,
+   * multiplied by the importance weight of the sample;
    * Called by GetValueAndDerivative(). */
   void UpdateValueAndDerivativeTerms(
     const RealType fixedImageValue,
     const RealType movingImageValue,
+    const RealType weight,
     const DerivativeType & imageJacobian,
     const NonZeroJacobianIndicesType & nzji,
     MeasureType & measure,
     DerivativeType & deriv ) const;
 
-  /** Compute a pixel's contribution to the SelfHessian;
-   * Called by GetSelfHessian(). */
+  /** Compute a pixel's contribution to the SelfHessian, and add it to the
+   * buffer of the work unit in the assembler;
+   * Called by ThreadedGetSelfHessian(). */
   void UpdateSelfHessianTerms(
     const DerivativeType & imageJacobian,
     const NonZeroJacobianIndicesType & nzji,
-    HessianType & H ) const;
+    const ThreadIdType workUnit,
+    ParallelSparseMatrixAssembler & assembler ) const;
+
+  /** The data passed to the threads by GetSelfHessian(). */
+  struct SelfHessianThreaderParameterType
+  {
+    const Self *                       m_Metric;
+    const ImageSampleContainerType *   m_SampleContainer;
+    const FixedImageInterpolatorType * m_FixedInterpolator;
+    const std::vector< double > *      m_Noise;
+    ParallelSparseMatrixAssembler *    m_Assembler;
+    ThreadIdType                       m_NumberOfWorkUnits;
+    std::vector< SizeValueType >       m_NumberOfPixelsCounted;
+  };
+
+  /** Launch ThreadedGetSelfHessian() on the persistent thread pool. */
+  static ITK_THREAD_RETURN_TYPE SelfHessianThreaderCallback( void * arg );
+
+  /** Add the contributions of the samples of a work unit to the SelfHessian. */
+  void ThreadedGetSelfHessian( const ThreadIdType workUnit,
+    SelfHessianThreaderParameterType & temp ) const;
 
   /** Get value for each thread. */
   inline void ThreadedGetValue( ThreadIdType threadID ) override;
@@ -250,6 +294,26 @@ protected:
   inline void AfterThreadedGetValueAndDerivative(
     MeasureType & value, DerivativeType & derivative ) const override;
 
+  /** Compute the value like GetValueSingleThreaded(), with the given transform. */
+  void GetValueWithTransform( const AdvancedTransformType * transform,
+    MeasureType & value, SizeValueType & numberOfPixelsCounted ) const override;
+
+  /** Compute the value and derivative like GetValueAndDerivativeSingleThreaded(),
+   * with the given transform.
+   */
+  void GetValueAndDerivativeWithTransform( const AdvancedTransformType * transform,
+    MeasureType & value, DerivativeType & derivative,
+    SizeValueType & numberOfPixelsCounted ) const override;
+
+  /** Compute the value and derivative of the given samples like
+   * GetValueAndDerivativeWithTransform(), with the shared transform, for the
+   * parallel mini-batches of the optimizer.
+   */
+  void GetValueAndSparseDerivativeOfSamples(
+    const SizeValueType * sampleIds, const SizeValueType numberOfSampleIds,
+    MeasureType & value, DerivativeType & derivative,
+    NonZeroJacobianIndicesType & indices ) const override;
+
 private:
 
   AdvancedMeanSquaresImageToImageMetric( const Self & ); // purposely not implemented
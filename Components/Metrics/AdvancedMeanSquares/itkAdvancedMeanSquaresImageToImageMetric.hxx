@@ -22,6 +22,7 @@
 #include "vnl/algo/vnl_matrix_update.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "itkComputeImageExtremaFilter.h"
+#include <algorithm>
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -39,11 +40,20 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::AdvancedMeanSquaresImageToImageMetric()
 {
   this->SetUseImageSampler( true );
+  this->SetUseImageSampleWeights( true );
   this->SetUseFixedImageLimiter( false );
   this->SetUseMovingImageLimiter( false );
+  this->SetSupportsGetValueWithTransform( true );
+  this->SetSupportsGetValueAndDerivativeWithTransform( true );
+  this->SetSupportsConcurrentEvaluation( true );
+  this->SetUseImplicitImageSamples( true );
+  this->SetSupportsParallelMiniBatches( true );
+  this->SetSupportsFrozenSamples( true );
+  this->SetSupportsRawStateReduction( true );
 
   this->m_UseNormalization    = false;
   this->m_NormalizationFactor = 1.0;
+  this->m_FirstThreadedSample = 0;
 
   /** SelfHessian related variables, experimental feature. */
   this->m_SelfHessianSmoothingSigma     = 1.0;
@@ -201,8 +211,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
-  /** Get a handle to the sample container. */
+  /** Get a handle to the sample container and the importance weights, if any. */
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  const double *              sampleWeights   = this->GetImageSampleWeights();
 
   /** Create iterator over the sample container. */
   typename ImageSampleContainerType::ConstIterator fiter;
@@ -218,7 +229,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     MovingImagePointType        mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -239,20 +250,24 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     {
       this->m_NumberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
+      /** Get the fixed image value and the weight of the sample. */
       const RealType & fixedImageValue = static_cast< double >( ( *fiter ).Value().m_ImageValue );
+      const RealType   weight          = sampleWeights ? sampleWeights[ fiter.Index() ] : 1.0;
 
       /** The difference squared. */
       const RealType diff = movingImageValue - fixedImageValue;
-      measure += diff * diff;
+      measure += weight * diff * diff;
 
     } // end if sampleOk
 
   } // end for loop over the image sample container
 
+  /** Reduce the sums over the parts of the samples, if distributed. */
+  SizeValueType numberOfSamples = sampleContainer->Size();
+  this->ReduceRawValueState( measure, numberOfSamples );
+
   /** Check if enough samples were valid. */
-  this->CheckNumberOfSamples(
-    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
 
   /** Update measure value. */
   double normal_sum = 0.0;
@@ -278,8 +293,10 @@ typename AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >::Mea
 AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::GetValue( const TransformParametersType & parameters ) const
 {
-  /** Option for now to still use the single threaded code. */
-  if( !this->m_UseMultiThread )
+  /** Option for now to still use the single threaded code. The implicit
+   * samples are only read by the threaded code.
+   */
+  if( !this->m_UseMultiThread && this->GetImplicitImageSamples() == nullptr )
   {
     return this->GetValueSingleThreaded( parameters );
   }
@@ -310,6 +327,210 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 } // end GetValue()
 
 
+/**
+ * ******************* GetValueWithTransform *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueWithTransform( const AdvancedTransformType * transform,
+  MeasureType & value, SizeValueType & numberOfPixelsCounted ) const
+{
+  /** Get the number of samples and the importance weights, if any. */
+  const SizeValueType numberOfSamples = this->GetNumberOfFixedImageSamples();
+  const double *      sampleWeights   = this->GetImageSampleWeights();
+
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  numberOfPixelsCounted = 0;
+
+  /** Loop over the fixed image samples, as in GetValueSingleThreaded(). */
+  for( SizeValueType pos = 0; pos < numberOfSamples; ++pos )
+  {
+    FixedImagePointType fixedPoint;
+    RealType            fixedImageValue;
+    RealType            movingImageValue;
+    this->GetFixedImageSamples( pos, 1, &fixedPoint, &fixedImageValue );
+
+    const MovingImagePointType mappedPoint = transform->TransformPoint( fixedPoint );
+
+    bool sampleOk = this->IsInsideMovingMask( mappedPoint );
+    if( sampleOk )
+    {
+      sampleOk = this->EvaluateMovingImageValueAndDerivative(
+        mappedPoint, movingImageValue, 0 );
+    }
+
+    if( sampleOk )
+    {
+      numberOfPixelsCounted++;
+
+      const RealType weight = sampleWeights ? sampleWeights[ pos ] : 1.0;
+
+      const RealType diff = movingImageValue - fixedImageValue;
+      measure += weight * diff * diff;
+    }
+  }
+
+  /** Update measure value. */
+  double normal_sum = 0.0;
+  if( numberOfPixelsCounted > 0 )
+  {
+    normal_sum = this->m_NormalizationFactor
+      / static_cast< double >( numberOfPixelsCounted );
+  }
+  value = measure * normal_sum;
+
+} // end GetValueWithTransform()
+
+
+/**
+ * ******************* GetValueAndDerivativeWithTransform *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivativeWithTransform( const AdvancedTransformType * transform,
+  MeasureType & value, DerivativeType & derivative,
+  SizeValueType & numberOfPixelsCounted ) const
+{
+  /** Get the number of samples and the importance weights, if any. */
+  const SizeValueType numberOfSamples = this->GetNumberOfFixedImageSamples();
+  const double *      sampleWeights   = this->GetImageSampleWeights();
+
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  numberOfPixelsCounted = 0;
+  derivative = DerivativeType( this->GetNumberOfParameters() );
+  derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+
+  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
+  NonZeroJacobianIndicesType nzji( transform->GetNumberOfNonZeroJacobianIndices() );
+  DerivativeType             imageJacobian( nzji.size() );
+
+  /** Loop over the fixed image samples, as in GetValueAndDerivativeSingleThreaded(). */
+  for( SizeValueType pos = 0; pos < numberOfSamples; ++pos )
+  {
+    FixedImagePointType       fixedPoint;
+    RealType                  fixedImageValue;
+    RealType                  movingImageValue;
+    MovingImageDerivativeType movingImageDerivative;
+    this->GetFixedImageSamples( pos, 1, &fixedPoint, &fixedImageValue );
+
+    const MovingImagePointType mappedPoint = transform->TransformPoint( fixedPoint );
+
+    bool sampleOk = this->IsInsideMovingMask( mappedPoint );
+    if( sampleOk )
+    {
+      sampleOk = this->EvaluateMovingImageValueAndDerivative(
+        mappedPoint, movingImageValue, &movingImageDerivative );
+    }
+
+    if( sampleOk )
+    {
+      numberOfPixelsCounted++;
+
+      transform->EvaluateJacobianWithImageGradientProduct(
+        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+
+      this->UpdateValueAndDerivativeTerms(
+        fixedImageValue, movingImageValue,
+        sampleWeights ? sampleWeights[ pos ] : 1.0,
+        imageJacobian, nzji, measure, derivative );
+    }
+  }
+
+  /** Compute the measure value and derivative. */
+  double normal_sum = 0.0;
+  if( numberOfPixelsCounted > 0 )
+  {
+    normal_sum = this->m_NormalizationFactor
+      / static_cast< double >( numberOfPixelsCounted );
+  }
+  value       = measure * normal_sum;
+  derivative *= normal_sum;
+
+} // end GetValueAndDerivativeWithTransform()
+
+
+/**
+ * ************** GetValueAndSparseDerivativeOfSamples ****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndSparseDerivativeOfSamples(
+  const SizeValueType * sampleIds, const SizeValueType numberOfSampleIds,
+  MeasureType & value, DerivativeType & derivative,
+  NonZeroJacobianIndicesType & indices ) const
+{
+  /** The transform is read while the optimizer updates its parameters. */
+  const AdvancedTransformType * transform     = this->m_AdvancedTransform.GetPointer();
+  const double *                sampleWeights = this->GetImageSampleWeights();
+
+  MeasureType   measure               = NumericTraits< MeasureType >::Zero;
+  SizeValueType numberOfPixelsCounted = 0;
+  indices.clear();
+
+  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
+  NonZeroJacobianIndicesType nzji( transform->GetNumberOfNonZeroJacobianIndices() );
+  DerivativeType             imageJacobian( nzji.size() );
+
+  /** Loop over the given samples, as in GetValueAndDerivativeWithTransform(). */
+  for( SizeValueType i = 0; i < numberOfSampleIds; ++i )
+  {
+    const SizeValueType       pos = sampleIds[ i ];
+    FixedImagePointType       fixedPoint;
+    RealType                  fixedImageValue;
+    RealType                  movingImageValue;
+    MovingImageDerivativeType movingImageDerivative;
+    this->GetFixedImageSamples( pos, 1, &fixedPoint, &fixedImageValue );
+
+    const MovingImagePointType mappedPoint = transform->TransformPoint( fixedPoint );
+
+    bool sampleOk = this->IsInsideMovingMask( mappedPoint );
+    if( sampleOk )
+    {
+      sampleOk = this->EvaluateMovingImageValueAndDerivative(
+        mappedPoint, movingImageValue, &movingImageDerivative );
+    }
+
+    if( sampleOk )
+    {
+      numberOfPixelsCounted++;
+
+      transform->EvaluateJacobianWithImageGradientProduct(
+        fixedPoint, movingImageDerivative, imageJacobian, nzji );
+
+      this->UpdateValueAndDerivativeTerms(
+        fixedImageValue, movingImageValue,
+        sampleWeights ? sampleWeights[ pos ] : 1.0,
+        imageJacobian, nzji, measure, derivative );
+      indices.insert( indices.end(), nzji.begin(), nzji.end() );
+    }
+  }
+
+  /** The samples share most of their parameters. */
+  std::sort( indices.begin(), indices.end() );
+  indices.erase( std::unique( indices.begin(), indices.end() ), indices.end() );
+
+  /** Normalize the measure value and the nonzero derivatives. */
+  double normal_sum = 0.0;
+  if( numberOfPixelsCounted > 0 )
+  {
+    normal_sum = this->m_NormalizationFactor
+      / static_cast< double >( numberOfPixelsCounted );
+  }
+  value = measure * normal_sum;
+  for( const unsigned long index : indices )
+  {
+    derivative[ index ] *= normal_sum;
+  }
+
+} // end GetValueAndSparseDerivativeOfSamples()
+
+
 /**
  * ******************* ThreadedGetValue *******************
  */
@@ -319,71 +540,72 @@ void
 AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedGetValue( ThreadIdType threadId )
 {
-  /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
+  /** Get the number of samples and the importance weights, if any. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
+  const double *      sampleWeights       = this->GetImageSampleWeights();
 
   /** Get the samples for this thread. */
   const unsigned long nrOfSamplesPerThreads
     = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( Self::GetNumberOfWorkUnits() ) ) );
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
 
   unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
   unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
   pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
   pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator threader_fiter;
-  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
-
-  threader_fbegin += (int)pos_begin;
-  threader_fend   += (int)pos_end;
-
   /** Create variables to store intermediate results. circumvent false sharing */
   unsigned long numberOfPixelsCounted = 0;
   MeasureType   measure               = NumericTraits< MeasureType >::Zero;
 
+  /** The moving image values are evaluated per block of samples, without
+   * derivatives, so that the interpolator can evaluate a block at once.
+   */
+  const unsigned int   batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType  fixedPoints[ batchSize ];
+  RealType             fixedImageValues[ batchSize ];
+  MovingImagePointType mappedPoints[ batchSize ];
+  RealType             movingImageValues[ batchSize ];
+  bool                 samplesOk[ batchSize ];
+
   /** Loop over the fixed image to calculate the mean squares. */
-  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImagePointType        mappedPoint;
+    const unsigned int blockSize = ( pos_end - blockBegin < batchSize )
+      ? static_cast< unsigned int >( pos_end - blockBegin ) : batchSize;
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    /** Get the fixed image points and values of the block. */
+    this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
 
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint ); // thread-safe?
-    }
+    /** Transform the points and check if they are inside the B-spline
+     * support region and inside the mask.
+     */
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
 
-    /** Compute the moving image value M(T(x)) and check if
-     * the point is inside the moving image buffer.
+    /** Compute the moving image values M(T(x)) and check if the points are
+     * inside the moving image buffer.
      */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, 0 );
-    }
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+      movingImageValues, 0, samplesOk, blockSize );
 
-    if( sampleOk )
+    for( unsigned int i = 0; i < blockSize; ++i )
     {
+      if( !samplesOk[ i ] )
+      {
+        continue;
+      }
       numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue
-        = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
+      /** Get the fixed image value and the weight of the sample. */
+      const unsigned long pos             = blockBegin + i;
+      const RealType      fixedImageValue = fixedImageValues[ i ];
+      const RealType      weight          = sampleWeights ? sampleWeights[ pos ] : 1.0;
 
       /** The difference squared. */
-      const RealType diff = movingImageValue - fixedImageValue;
-      measure += diff * diff;
+      const RealType diff = movingImageValues[ i ] - fixedImageValue;
+      measure += weight * diff * diff;
 
-    } // end if sampleOk
+    } // end for loop over the block
 
   } // end for loop over the image sample container
 
@@ -403,7 +625,7 @@ void
 AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::AfterThreadedGetValue( MeasureType & value ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted = this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
@@ -415,15 +637,6 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
   }
 
-  /** Check if enough samples were valid. */
-  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
-  this->CheckNumberOfSamples(
-    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
-
-  /** The normalization factor. */
-  DerivativeValueType normal_sum = this->m_NormalizationFactor
-    / static_cast< DerivativeValueType >( this->m_NumberOfPixelsCounted );
-
   /** Accumulate values. */
   value = NumericTraits< MeasureType >::Zero;
   for( ThreadIdType i = 0; i < numberOfThreads; ++i )
@@ -433,11 +646,51 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     /** Reset this variable for the next iteration. */
     this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value = NumericTraits< MeasureType >::Zero;
   }
+
+  /** Reduce the sums over the parts of the samples, if distributed. */
+  SizeValueType numberOfSamples = this->GetNumberOfFixedImageSamples();
+  this->ReduceRawValueState( value, numberOfSamples );
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
+
+  /** The normalization factor. */
+  DerivativeValueType normal_sum = this->m_NormalizationFactor
+    / static_cast< DerivativeValueType >( this->m_NumberOfPixelsCounted );
   value *= normal_sum;
 
 } // end AfterThreadedGetValue()
 
 
+/**
+ * ******************* ReduceRawValueState *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::ReduceRawValueState( MeasureType & measure, SizeValueType & numberOfSamples ) const
+{
+  if( !this->GetRawStateReductionFunction() )
+  {
+    return;
+  }
+
+  /** The counts are exact in double precision up to 2^53. */
+  DerivativeValueType rawState[ 3 ] = {
+    static_cast< DerivativeValueType >( measure ),
+    static_cast< DerivativeValueType >( this->m_NumberOfPixelsCounted ),
+    static_cast< DerivativeValueType >( numberOfSamples )
+  };
+  this->ReduceRawState( rawState, 3 );
+
+  measure                       = static_cast< MeasureType >( rawState[ 0 ] );
+  this->m_NumberOfPixelsCounted = static_cast< SizeValueType >( rawState[ 1 ] );
+  numberOfSamples               = static_cast< SizeValueType >( rawState[ 2 ] );
+
+} // end ReduceRawValueState()
+
+
 /**
  * ******************* GetDerivative *******************
  */
@@ -500,8 +753,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
-  /** Get a handle to the sample container. */
+  /** Get a handle to the sample container and the importance weights, if any. */
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  const double *              sampleWeights   = this->GetImageSampleWeights();
 
   /** Create iterator over the sample container. */
   typename ImageSampleContainerType::ConstIterator fiter;
@@ -517,8 +771,15 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     MovingImagePointType        mappedPoint;
     MovingImageDerivativeType   movingImageDerivative;
 
+    /** A frozen sample is skipped, but counted as valid. */
+    if( this->m_FrozenSampleFunction && this->m_FrozenSampleFunction( fixedPoint ) )
+    {
+      this->m_NumberOfPixelsCounted++;
+      continue;
+    }
+
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -552,7 +813,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 #else
       /** Compute the inner product of the transform Jacobian and the moving image gradient. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+      this->EvaluateSampleJacobianWithImageGradientProduct( fiter.Index(),
         fixedPoint, movingImageDerivative,
         imageJacobian, nzji );
 #endif
@@ -560,6 +821,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
       /** Compute this pixel's contribution to the measure and derivatives. */
       this->UpdateValueAndDerivativeTerms(
         fixedImageValue, movingImageValue,
+        sampleWeights ? sampleWeights[ fiter.Index() ] : 1.0,
         imageJacobian, nzji,
         measure, derivative );
 
@@ -567,9 +829,12 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 
   } // end for loop over the image sample container
 
+  /** Reduce the sums over the parts of the samples, if distributed. */
+  SizeValueType numberOfSamples = sampleContainer->Size();
+  this->ReduceRawValueState( measure, numberOfSamples );
+
   /** Check if enough samples were valid. */
-  this->CheckNumberOfSamples(
-    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
 
   /** Compute the measure value and derivative. */
   double normal_sum = 0.0;
@@ -580,6 +845,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   }
   measure    *= normal_sum;
   derivative *= normal_sum;
+  this->ReduceRawState( derivative.data_block(), derivative.GetSize() );
 
   /** The return value. */
   value = measure;
@@ -598,8 +864,10 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   const TransformParametersType & parameters,
   MeasureType & value, DerivativeType & derivative ) const
 {
-  /** Option for now to still use the single threaded code. */
-  if( !this->m_UseMultiThread )
+  /** Option for now to still use the single threaded code. The implicit
+   * samples are only read by the threaded code.
+   */
+  if( !this->m_UseMultiThread && this->GetImplicitImageSamples() == nullptr )
   {
     return this->GetValueAndDerivativeSingleThreaded(
       parameters, value, derivative );
@@ -638,10 +906,10 @@ void
 AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedGetValueAndDerivative( ThreadIdType threadId )
 {
-  /** Initialize array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
-  const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  NonZeroJacobianIndicesType   nzji  = NonZeroJacobianIndicesType( nnzji );
-  DerivativeType               imageJacobian( nnzji );
+  /** Get the pre-allocated arrays that store dM(x)/dmu, and the sparse Jacobian + indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji          = arena.sa_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = arena.sa_ImageJacobian;
 
   /** Get a handle to the pre-allocated derivative for the current thread.
    * The initialization is performed at the beginning of each resolution in
@@ -650,93 +918,141 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
    */
   DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
 
-  /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
+  /** Get the number of samples and the importance weights, if any. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
+  const double *      sampleWeights       = this->GetImageSampleWeights();
 
-  /** Get the samples for this thread. */
+  /** Get the samples for this thread, from the first threaded sample on. */
+  const unsigned long firstSample = std::min< unsigned long >(
+    this->m_FirstThreadedSample, sampleContainerSize );
   const unsigned long nrOfSamplesPerThreads
-    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( Self::GetNumberOfWorkUnits() ) ) );
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize - firstSample )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
 
-  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
-  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  unsigned long pos_begin = firstSample + nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = firstSample + nrOfSamplesPerThreads * ( threadId + 1 );
   pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
   pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator threader_fiter;
-  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
-
-  threader_fbegin += (int)pos_begin;
-  threader_fend   += (int)pos_end;
-
   /** Create variables to store intermediate results. circumvent false sharing */
   unsigned long numberOfPixelsCounted = 0;
+  unsigned long numberOfFrozenSamples = 0;
   MeasureType   measure               = NumericTraits< MeasureType >::Zero;
 
-  /** Loop over the fixed image to calculate the mean squares. */
-  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  /** The moving image values and derivatives are evaluated per block of
+   * samples, so that the interpolation method is chosen once per block. The
+   * loop is software pipelined: a block is transformed, and its moving image
+   * data prefetched, MovingImagePrefetchDepth blocks before it is
+   * interpolated, so that the interpolation of the earlier blocks hides the
+   * memory latency. The blocks in flight are kept in a ring of stages.
+   */
+  const unsigned int batchSize             = Superclass::MovingImageBatchSize;
+  const unsigned int maximumNumberOfStages = Superclass::MaximumMovingImagePrefetchDepth + 1;
+  const unsigned int depth                 = this->GetMovingImagePrefetchDepth();
+  const unsigned int numberOfStages        = depth + 1;
+
+  FixedImagePointType       fixedPoints[ maximumNumberOfStages ][ batchSize ];
+  RealType                  fixedImageValues[ maximumNumberOfStages ][ batchSize ];
+  MovingImagePointType      mappedPoints[ maximumNumberOfStages ][ batchSize ];
+  bool                      samplesOk[ maximumNumberOfStages ][ batchSize ];
+  RealType                  movingImageValues[ batchSize ];
+  MovingImageDerivativeType movingImageDerivatives[ batchSize ];
+
+  /** Loop over the fixed image to calculate the mean squares. Iteration b
+   * transforms block b and interpolates block b - depth.
+   */
+  const unsigned long numberOfBlocks = ( pos_end - pos_begin + batchSize - 1 ) / batchSize;
+  for( unsigned long block = 0; block < numberOfBlocks + depth; ++block )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImagePointType        mappedPoint;
-    MovingImageDerivativeType   movingImageDerivative;
-
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-
-    /** Check if point is inside mask. */
-    if( sampleOk )
+    if( block < numberOfBlocks )
     {
-      sampleOk = this->IsInsideMovingMask( mappedPoint ); // thread-safe?
+      const unsigned int  stage      = block % numberOfStages;
+      const unsigned long blockBegin = pos_begin + block * batchSize;
+      const unsigned int  blockSize  = static_cast< unsigned int >(
+        std::min< unsigned long >( pos_end - blockBegin, batchSize ) );
+
+      /** Get the fixed image points and values of the block, transform the
+       * points that are not frozen, check if they are inside the mask, and
+       * prefetch.
+       */
+      this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints[ stage ], fixedImageValues[ stage ] );
+      numberOfFrozenSamples += this->TransformUnfrozenMovingImageBatch( fixedPoints[ stage ],
+        mappedPoints[ stage ], samplesOk[ stage ], blockSize, blockBegin );
     }
-
-    /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
-     * the point is inside the moving image buffer.
-     */
-    if( sampleOk )
+    if( block < depth )
     {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
+      continue;
     }
 
-    if( sampleOk )
+    const unsigned long current    = block - depth;
+    const unsigned int  stage      = current % numberOfStages;
+    const unsigned long blockBegin = pos_begin + current * batchSize;
+    const unsigned int  blockSize  = static_cast< unsigned int >(
+      std::min< unsigned long >( pos_end - blockBegin, batchSize ) );
+
+    /** Compute the moving image values M(T(x)) and derivatives dM/dx and
+     * check if the points are inside the moving image buffer.
+     */
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints[ stage ],
+      movingImageValues, movingImageDerivatives, samplesOk[ stage ], blockSize );
+
+    for( unsigned int i = 0; i < blockSize; ++i )
     {
+      if( !samplesOk[ stage ][ i ] )
+      {
+        continue;
+      }
       numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue
-        = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
+      /** Get the fixed image value and the weight of the sample. */
+      const unsigned long         pos             = blockBegin + i;
+      const FixedImagePointType & fixedPoint      = fixedPoints[ stage ][ i ];
+      const RealType              fixedImageValue = fixedImageValues[ stage ][ i ];
+      const RealType movingImageValue = movingImageValues[ i ];
+      const RealType weight           = sampleWeights ? sampleWeights[ pos ] : 1.0;
 
-#if 0
-      /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
-
-      /** Compute the inner products (dM/dx)^T (dT/dmu). */
-      this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
-#else
       /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
-#endif
+      this->EvaluateSampleJacobianWithImageGradientProduct( pos,
+        fixedPoint, movingImageDerivatives[ i ], imageJacobian, nzji );
 
       /** Compute this pixel's contribution to the measure and derivatives. */
-      this->UpdateValueAndDerivativeTerms(
-        fixedImageValue, movingImageValue,
-        imageJacobian, nzji,
-        measure, derivative );
+      if( this->m_UseSparseDerivativeAccumulation )
+      {
+        const RealType diff = movingImageValue - fixedImageValue;
+        measure += weight * diff * diff;
+        this->AddSparseDerivativeTerms( threadId, imageJacobian, nzji, weight * diff * 2.0 );
+      }
+      else if( this->m_UseSinglePrecisionDerivativeAccumulation )
+      {
+        const RealType diff = movingImageValue - fixedImageValue;
+        measure += weight * diff * diff;
+        this->AddSinglePrecisionDerivativeTerms( threadId, imageJacobian, nzji, weight * diff * 2.0 );
+      }
+      else
+      {
+        this->UpdateValueAndDerivativeTerms(
+          fixedImageValue, movingImageValue, weight,
+          imageJacobian, nzji,
+          measure, derivative );
+      }
 
-    } // end if sampleOk
+    } // end for loop over the samples of the block
 
   } // end for loop over the image sample container
 
-  /** Only update these variables at the end to prevent unnecessary "false sharing". */
-  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
-  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
+  /** Add the remaining single precision contributions to the derivative. */
+  if( this->m_UseSinglePrecisionDerivativeAccumulation && !this->m_UseSparseDerivativeAccumulation )
+  {
+    this->FlushSinglePrecisionDerivative( threadId );
+  }
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing".
+   * The frozen samples are counted as valid, so that they keep their share of
+   * the normalization.
+   */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted
+    = numberOfPixelsCounted + numberOfFrozenSamples;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value = measure;
 
 } // end ThreadedGetValueAndDerivative()
 
@@ -751,7 +1067,7 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::AfterThreadedGetValueAndDerivative(
   MeasureType & value, DerivativeType & derivative ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted = this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
@@ -763,15 +1079,6 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
   }
 
-  /** Check if enough samples were valid. */
-  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
-  this->CheckNumberOfSamples(
-    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
-
-  /** The normalization factor. */
-  DerivativeValueType normal_sum = this->m_NormalizationFactor
-    / static_cast< DerivativeValueType >( this->m_NumberOfPixelsCounted );
-
   /** Accumulate values. */
   value = NumericTraits< MeasureType >::Zero;
   for( ThreadIdType i = 0; i < numberOfThreads; ++i )
@@ -781,6 +1088,17 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     /** Reset this variable for the next iteration. */
     this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value = NumericTraits< MeasureType >::Zero;
   }
+
+  /** Reduce the sums over the parts of the samples, if distributed. */
+  SizeValueType numberOfSamples = this->GetNumberOfFixedImageSamples();
+  this->ReduceRawValueState( value, numberOfSamples );
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
+
+  /** The normalization factor. */
+  DerivativeValueType normal_sum = this->m_NormalizationFactor
+    / static_cast< DerivativeValueType >( this->m_NumberOfPixelsCounted );
   value *= normal_sum;
 
   /** Accumulate derivatives. */
@@ -799,9 +1117,8 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
     this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
     this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0 / normal_sum;
 
-    this->m_Threader->SetSingleMethod( this->AccumulateDerivativesThreaderCallback,
+    this->LaunchThreaderCallback( this->AccumulateDerivativesThreaderCallback,
       const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-    this->m_Threader->SingleMethodExecute();
   }
 #ifdef ELASTIX_USE_OPENMP
   // compute multi-threadedly with openmp
@@ -822,6 +1139,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   }
 #endif
 
+  /** Reduce the derivative, which is scaled by the reduced normalization. */
+  this->ReduceRawState( derivative.data_block(), derivative.GetSize() );
+
 } // end AfterThreadedGetValueAndDerivative()
 
 
@@ -835,18 +1155,19 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::UpdateValueAndDerivativeTerms(
   const RealType fixedImageValue,
   const RealType movingImageValue,
+  const RealType weight,
   const DerivativeType & imageJacobian,
   const NonZeroJacobianIndicesType & nzji,
   MeasureType & measure,
   DerivativeType & deriv ) const
 {
-  /** The difference squared. */
+  /** The weighted difference squared. */
   const RealType diff     = movingImageValue - fixedImageValue;
   const RealType diffdiff = diff * diff;
-  measure += diffdiff;
+  measure += weight * diffdiff;
 
   /** Calculate the contributions to the derivatives with respect to each parameter. */
-  const RealType diff_2 = diff * 2.0;
+  const RealType diff_2 = weight * diff * 2.0;
   if( nzji.size() == this->GetNumberOfParameters() )
   {
     /** Loop over all Jacobians. */
@@ -888,20 +1209,9 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   RandomGeneratorType::Pointer randomGenerator = RandomGeneratorType::GetInstance();
   randomGenerator->Initialize();
 
-  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
-  NonZeroJacobianIndicesType nzji(
-  this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
-  DerivativeType        imageJacobian( nzji.size() );
-  TransformJacobianType jacobian;
-
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
-  /** Prepare Hessian */
-  H.set_size( this->GetNumberOfParameters(),
-    this->GetNumberOfParameters() );
-  //H.Fill(0.0); // done by set_size if sparse matrix
-
   /** Smooth fixed image */
   typename SmootherType::Pointer smoother = SmootherType::New();
   smoother->SetInput( this->GetFixedImage() );
@@ -935,17 +1245,130 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
   /** Update the imageSampler and get a handle to the sample container. */
   sampler->Update();
   ImageSampleContainerPointer sampleContainer = sampler->GetOutput();
+  const SizeValueType         sampleContainerSize = sampleContainer->Size();
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
+  /** Draw the noise that is added to the fixed image derivative of each
+   * sample beforehand, so that it does not depend on the threads.
+   */
+  std::vector< double > noise( sampleContainerSize * FixedImageDimension );
+  for( std::vector< double >::iterator it = noise.begin(); it != noise.end(); ++it )
+  {
+    *it = randomGenerator->GetVariateWithClosedRange(
+      this->m_SelfHessianNoiseRange ) - this->m_SelfHessianNoiseRange / 2.0;
+  }
 
-  /** Loop over the fixed image to calculate the mean squares. */
-  for( fiter = fbegin; fiter != fend; ++fiter )
+  /** Each work unit adds the contributions of a contiguous range of samples
+   * to its own buffer in the assembler.
+   */
+  const ThreadIdType numberOfWorkUnits
+    = this->m_UseMultiThread ? Self::GetNumberOfReductionChunks() : 1;
+  ParallelSparseMatrixAssembler assembler;
+  assembler.Initialize( this->GetNumberOfParameters(),
+    this->GetNumberOfParameters(), numberOfWorkUnits );
+
+  SelfHessianThreaderParameterType temp;
+  temp.m_Metric            = this;
+  temp.m_SampleContainer   = sampleContainer.GetPointer();
+  temp.m_FixedInterpolator = fixedInterpolator.GetPointer();
+  temp.m_Noise             = &noise;
+  temp.m_Assembler         = &assembler;
+  temp.m_NumberOfWorkUnits = numberOfWorkUnits;
+  temp.m_NumberOfPixelsCounted.assign( numberOfWorkUnits, 0 );
+
+  if( numberOfWorkUnits > 1 )
+  {
+    PersistentThreadPool::GetInstance()->SingleMethodExecute(
+      numberOfWorkUnits, Self::SelfHessianThreaderCallback, &temp );
+  }
+  else
+  {
+    this->ThreadedGetSelfHessian( 0, temp );
+  }
+
+  for( ThreadIdType i = 0; i < numberOfWorkUnits; ++i )
+  {
+    this->m_NumberOfPixelsCounted += temp.m_NumberOfPixelsCounted[ i ];
+  }
+
+  /** Merge the buffers of the work units into the rows of H. */
+  assembler.AssembleRows( H );
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples(
+    sampleContainerSize, this->m_NumberOfPixelsCounted );
+
+  /** Compute the measure value and derivative. */
+  if( this->m_NumberOfPixelsCounted > 0 )
+  {
+    const double normal_sum = 2.0 * this->m_NormalizationFactor
+      / static_cast< double >( this->m_NumberOfPixelsCounted );
+    for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
+    {
+      H.scale_row( i, normal_sum );
+    }
+  }
+  else
+  {
+    //H.fill_diagonal(1.0);
+    for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
+    {
+      H( i, i ) = 1.0;
+    }
+  }
+
+} // end GetSelfHessian()
+
+
+/**
+ * *************** SelfHessianThreaderCallback ***************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::SelfHessianThreaderCallback( void * arg )
+{
+  ThreadInfoType *                   infoStruct = static_cast< ThreadInfoType * >( arg );
+  SelfHessianThreaderParameterType * temp
+    = static_cast< SelfHessianThreaderParameterType * >( infoStruct->UserData );
+
+  temp->m_Metric->ThreadedGetSelfHessian( infoStruct->WorkUnitID, *temp );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end SelfHessianThreaderCallback()
+
+
+/**
+ * *************** ThreadedGetSelfHessian ***************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetSelfHessian( const ThreadIdType workUnit,
+  SelfHessianThreaderParameterType & temp ) const
+{
+  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
+  NonZeroJacobianIndicesType nzji(
+  this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+  DerivativeType        imageJacobian( nzji.size() );
+  TransformJacobianType jacobian;
+
+  /** Get the samples for this work unit. */
+  const SizeValueType sampleContainerSize   = temp.m_SampleContainer->Size();
+  const SizeValueType nrOfSamplesPerThreads
+    = ( sampleContainerSize + temp.m_NumberOfWorkUnits - 1 ) / temp.m_NumberOfWorkUnits;
+  const SizeValueType pos_begin = std::min( nrOfSamplesPerThreads * workUnit, sampleContainerSize );
+  const SizeValueType pos_end   = std::min( pos_begin + nrOfSamplesPerThreads, sampleContainerSize );
+
+  SizeValueType numberOfPixelsCounted = 0;
+
+  /** Loop over the fixed image samples of this work unit. */
+  for( SizeValueType i = pos_begin; i < pos_end; ++i )
   {
     /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+    const FixedImagePointType & fixedPoint = temp.m_SampleContainer->ElementAt( i ).m_ImageCoordinates;
     MovingImagePointType        mappedPoint;
     MovingImageDerivativeType   movingImageDerivative;
 
@@ -970,18 +1393,17 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 
     if( sampleOk )
     {
-      this->m_NumberOfPixelsCounted++;
+      numberOfPixelsCounted++;
 
       /** Use the derivative of the fixed image for the self Hessian!
        * \todo: we can do this more efficient without the interpolation,
        * without the sampler, and with a precomputed gradient image,
        * but is this the bottleneck?
        */
-      movingImageDerivative = fixedInterpolator->EvaluateDerivative( fixedPoint );
+      movingImageDerivative = temp.m_FixedInterpolator->EvaluateDerivative( fixedPoint );
       for( unsigned int d = 0; d < FixedImageDimension; ++d )
       {
-        movingImageDerivative[ d ] += randomGenerator->GetVariateWithClosedRange(
-          this->m_SelfHessianNoiseRange ) - this->m_SelfHessianNoiseRange / 2.0;
+        movingImageDerivative[ d ] += ( *temp.m_Noise )[ i * FixedImageDimension + d ];
       }
 
       /** Get the TransformJacobian dT/dmu. */
@@ -992,36 +1414,15 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
         jacobian, movingImageDerivative, imageJacobian );
 
       /** Compute this pixel's contribution to the SelfHessian. */
-      this->UpdateSelfHessianTerms( imageJacobian, nzji, H );
+      this->UpdateSelfHessianTerms( imageJacobian, nzji, workUnit, *temp.m_Assembler );
 
     } // end if sampleOk
 
   } // end for loop over the image sample container
 
-  /** Check if enough samples were valid. */
-  this->CheckNumberOfSamples(
-    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+  temp.m_NumberOfPixelsCounted[ workUnit ] = numberOfPixelsCounted;
 
-  /** Compute the measure value and derivative. */
-  if( this->m_NumberOfPixelsCounted > 0 )
-  {
-    const double normal_sum = 2.0 * this->m_NormalizationFactor
-      / static_cast< double >( this->m_NumberOfPixelsCounted );
-    for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
-    {
-      H.scale_row( i, normal_sum );
-    }
-  }
-  else
-  {
-    //H.fill_diagonal(1.0);
-    for( unsigned int i = 0; i < this->GetNumberOfParameters(); ++i )
-    {
-      H( i, i ) = 1.0;
-    }
-  }
-
-} // end GetSelfHessian()
+} // end ThreadedGetSelfHessian()
 
 
 /**
@@ -1034,64 +1435,15 @@ AdvancedMeanSquaresImageToImageMetric< TFixedImage, TMovingImage >
 ::UpdateSelfHessianTerms(
   const DerivativeType & imageJacobian,
   const NonZeroJacobianIndicesType & nzji,
-  HessianType & H ) const
+  const ThreadIdType workUnit,
+  ParallelSparseMatrixAssembler & assembler ) const
 {
-  typedef typename HessianType::row    RowType;
-  typedef typename RowType::iterator   RowIteratorType;
-  typedef typename HessianType::pair_t ElementType;
-
-  // does not work for sparse matrix. \todo: distinguish between sparse and nonsparse
-  ///** Do rank-1 update of H */
-  //if ( nzji.size() == this->GetNumberOfParameters() )
-  //{
-  //  /** Loop over all Jacobians. */
-  //  vnl_matrix_update( H, imageJacobian, imageJacobian );
-  //}
-  //else
-  //{
   /** Only pick the nonzero Jacobians.
-  * Save only upper triangular part of the matrix */
-  const unsigned int imjacsize = imageJacobian.GetSize();
-  for( unsigned int i = 0; i < imjacsize; ++i )
-  {
-    const unsigned int row      = nzji[ i ];
-    const double       imjacrow = imageJacobian[ i ];
-
-    RowType &       rowVector = H.get_row( row );
-    RowIteratorType rowIt     = rowVector.begin();
-
-    for( unsigned int j = i; j < imjacsize; ++j )
-    {
-      const unsigned int col = nzji[ j ];
-      const double       val = imjacrow * imageJacobian[ j ];
-      if( ( val < 1e-14 ) && ( val > -1e-14 ) )
-      {
-        continue;
-      }
-
-      /** The following implements:
-       * H(row,col) += imjacrow * imageJacobian[ j ];
-       * But more efficient.
-       */
-
-      /** Go to next element */
-      for(; ( rowIt != rowVector.end() ) && ( ( *rowIt ).first < col ); ++rowIt )
-      {}
-
-      if( ( rowIt == rowVector.end() ) || ( ( *rowIt ).first != col ) )
-      {
-        /** Add new column to the row and set iterator to that column. */
-        rowIt = rowVector.insert( rowIt, ElementType( col, val ) );
-      }
-      else
-      {
-        /** Add to existing value */
-        ( *rowIt ).second += val;
-      }
-    }
-  }
-
-  //} // end else
+   * Save only upper triangular part of the matrix.
+   * The assembler sums the duplicate entries when merging the rows.
+   */
+  assembler.AddUpperTriangularOuterProduct( workUnit, nzji, imageJacobian,
+    imageJacobian.GetSize(), 1.0, 1e-14 );
 
 } // end UpdateSelfHessianTerms()
 
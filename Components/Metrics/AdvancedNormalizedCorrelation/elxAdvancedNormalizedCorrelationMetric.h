@@ -35,6 +35,18 @@ namespace elastix
  *    sample values in the cross correlation formula. This typically results in narrower
  *    valleys in the cost function. Default value is true. Can be defined for each resolution\n
  *    example: <tt>(SubtractMean "false")</tt>
+ * \parameter UseFusedDerivativeAccumulation: Bool to compute the sums of the metric
+ *    in a value-only pass first, so that the derivative needs a single accumulated
+ *    vector per thread instead of three. This saves memory and time for transforms
+ *    with many parameters. Can be given for each resolution.\n
+ *    <tt>(UseFusedDerivativeAccumulation "true")</tt>\n
+ *    The default value is false.
+ * \parameter UseSparseDerivativeAccumulation: Bool to accumulate the derivative
+ *    sparsely over the threads, instead of using a full-length derivative per thread.
+ *    Only used in combination with UseFusedDerivativeAccumulation.
+ *    Can be given for each resolution.\n
+ *    <tt>(UseSparseDerivativeAccumulation "true")</tt>\n
+ *    The default value is false.
  *
  * \ingroup Metrics
  *
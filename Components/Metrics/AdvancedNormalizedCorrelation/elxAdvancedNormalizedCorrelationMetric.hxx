@@ -43,6 +43,18 @@ AdvancedNormalizedCorrelationMetric< TElastix >
     this->GetComponentLabel(), level, 0 );
   this->SetSubtractMean( subtractMean );
 
+  /** Get and set UseFusedDerivativeAccumulation. Default false. */
+  bool useFusedDerivativeAccumulation = false;
+  this->GetConfiguration()->ReadParameter( useFusedDerivativeAccumulation,
+    "UseFusedDerivativeAccumulation", this->GetComponentLabel(), level, 0 );
+  this->SetUseFusedDerivativeAccumulation( useFusedDerivativeAccumulation );
+
+  /** Get and set UseSparseDerivativeAccumulation. Default false. */
+  bool useSparseDerivativeAccumulation = false;
+  this->GetConfiguration()->ReadParameter( useSparseDerivativeAccumulation,
+    "UseSparseDerivativeAccumulation", this->GetComponentLabel(), level, 0 );
+  this->SetUseSparseDerivativeAccumulation( useSparseDerivativeAccumulation && useFusedDerivativeAccumulation );
+
 } // end BeforeEachResolution()
 
 
@@ -189,6 +189,18 @@ public:
   itkGetConstReferenceMacro( SubtractMean, bool );
   itkBooleanMacro( SubtractMean );
 
+  /** Set/Get whether the multi-threaded GetValueAndDerivative() first computes
+   * the sums of the NC in a value-only pass over the samples. With these sums,
+   * the derivative of a sample is a single weighted Jacobian term, so that each
+   * thread accumulates one derivative vector instead of three, and the sparse
+   * derivative accumulation can be used. This saves memory and merge time for
+   * transforms with many parameters, at the cost of a second interpolation of
+   * the moving image per sample. Default value is false.
+   */
+  itkSetMacro( UseFusedDerivativeAccumulation, bool );
+  itkGetConstReferenceMacro( UseFusedDerivativeAccumulation, bool );
+  itkBooleanMacro( UseFusedDerivativeAccumulation );
+
 protected:
 
   AdvancedNormalizedCorrelationImageToImageMetric();
@@ -228,6 +240,15 @@ protected:
    */
   void InitializeThreadingParameters( void ) const override;
 
+  /** Get the value single-threaded. */
+  MeasureType GetValueSingleThreaded( const TransformParametersType & parameters ) const;
+
+  /** Get the sums of the NC for each thread. */
+  inline void ThreadedGetValue( ThreadIdType threadID ) override;
+
+  /** Gather the sums from all threads and compute the value. */
+  inline void AfterThreadedGetValue( MeasureType & value ) const override;
+
   /** Get value and derivatives for each thread. */
   inline void ThreadedGetValueAndDerivative( ThreadIdType threadID ) override;
 
@@ -244,6 +265,12 @@ private:
   void operator=( const Self & );                                  // purposely not implemented
 
   mutable bool m_SubtractMean;
+  bool         m_UseFusedDerivativeAccumulation;
+
+  /** Accumulate the single weighted Jacobian term of each sample of a thread,
+   * using the sums computed by ThreadedGetValue().
+   */
+  void ThreadedGetFusedDerivative( ThreadIdType threadID );
 
   typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
 
@@ -280,6 +307,15 @@ private:
   mutable AlignedCorrelationGetValueAndDerivativePerThreadStruct * m_CorrelationGetValueAndDerivativePerThreadVariables;
   mutable ThreadIdType                                             m_CorrelationGetValueAndDerivativePerThreadVariablesSize;
 
+  /** The terms of the NC, computed by AfterThreadedGetValue(): the means of
+   * the fixed and moving values (zero without SubtractMean), sfm / smm, and
+   * the denominator -sqrt( sff * smm ).
+   */
+  mutable AccumulateType m_FixedMean;
+  mutable AccumulateType m_MovingMean;
+  mutable AccumulateType m_CorrelationRatio;
+  mutable RealType       m_Denominator;
+
 };
 
 } // end namespace itk
@@ -19,6 +19,7 @@
 #define _itkAdvancedNormalizedCorrelationImageToImageMetric_hxx
 
 #include "itkAdvancedNormalizedCorrelationImageToImageMetric.h"
+#include <algorithm>
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -35,11 +36,17 @@ template< class TFixedImage, class TMovingImage >
 AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 ::AdvancedNormalizedCorrelationImageToImageMetric()
 {
-  this->m_SubtractMean = false;
+  this->m_SubtractMean                   = false;
+  this->m_UseFusedDerivativeAccumulation = false;
+  this->m_FixedMean                      = NumericTraits< AccumulateType >::Zero;
+  this->m_MovingMean                     = NumericTraits< AccumulateType >::Zero;
+  this->m_CorrelationRatio               = NumericTraits< AccumulateType >::Zero;
+  this->m_Denominator                    = NumericTraits< RealType >::Zero;
 
   this->SetUseImageSampler( true );
   this->SetUseFixedImageLimiter( false );
   this->SetUseMovingImageLimiter( false );
+  this->SetSupportsConcurrentEvaluation( true );
 
   // Multi-threading structs
   this->m_CorrelationGetValueAndDerivativePerThreadVariables     = nullptr;
@@ -69,7 +76,10 @@ void
 AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 ::InitializeThreadingParameters( void ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  /** Call superclass implementation, which also sizes the scratch memory. */
+  Superclass::InitializeThreadingParameters();
+
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Resize and initialize the threading related parameters.
    * The SetSize() functions do not resize the data when this is not
@@ -98,12 +108,27 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sfm                   = zero1;
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sf                    = zero1;
     this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sm                    = zero1;
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF.SetSize( this->GetNumberOfParameters() );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM.SetSize( this->GetNumberOfParameters() );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential.SetSize( this->GetNumberOfParameters() );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF.Fill( zero2 );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM.Fill( zero2 );
-    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential.Fill( zero2 );
+
+    /** The fused accumulation uses the single derivative of the superclass,
+     * the default accumulation uses the three derivative terms of this class.
+     */
+    if( this->m_UseFusedDerivativeAccumulation )
+    {
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF.SetSize( 0 );
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM.SetSize( 0 );
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential.SetSize( 0 );
+    }
+    else
+    {
+      this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Derivative.SetSize( 0 );
+      this->m_GetValueAndDerivativePerThreadVariables[ i ].st_DerivativeBuffer.Release();
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF.SetSize( this->GetNumberOfParameters() );
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM.SetSize( this->GetNumberOfParameters() );
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential.SetSize( this->GetNumberOfParameters() );
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeF.Fill( zero2 );
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_DerivativeM.Fill( zero2 );
+      this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Differential.Fill( zero2 );
+    }
   }
 
 } // end InitializeThreadingParameters()
@@ -120,6 +145,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 {
   Superclass::PrintSelf( os, indent );
   os << indent << "SubtractMean: " << this->m_SubtractMean << std::endl;
+  os << indent << "UseFusedDerivativeAccumulation: " << this->m_UseFusedDerivativeAccumulation << std::endl;
 
 } // end PrintSelf()
 
@@ -177,13 +203,13 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* GetValue *******************
+ * ******************* GetValueSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 typename AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
 AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
-::GetValue( const TransformParametersType & parameters ) const
+::GetValueSingleThreaded( const TransformParametersType & parameters ) const
 {
   itkDebugMacro( "GetValue( " << parameters << " ) " );
 
@@ -230,7 +256,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     MovingImagePointType        mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -299,6 +325,208 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 } // end GetValue()
 
 
+/**
+ * ******************* GetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValue( const TransformParametersType & parameters ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueSingleThreaded( parameters );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueThreaderCallback();
+
+  /** Gather the sums from all threads. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->AfterThreadedGetValue( value );
+
+  return value;
+
+} // end GetValue()
+
+
+/**
+ * ******************* ThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetValue( ThreadIdType threadId )
+{
+  /** Get the number of samples. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create variables to store intermediate results. */
+  AccumulateType sff                   = NumericTraits< AccumulateType >::Zero;
+  AccumulateType smm                   = NumericTraits< AccumulateType >::Zero;
+  AccumulateType sfm                   = NumericTraits< AccumulateType >::Zero;
+  AccumulateType sf                    = NumericTraits< AccumulateType >::Zero;
+  AccumulateType sm                    = NumericTraits< AccumulateType >::Zero;
+  unsigned long  numberOfPixelsCounted = 0;
+
+  /** The samples are processed per block: the points of a block are
+   * transformed with one call of the batch TransformPoints(), and their
+   * moving image values are interpolated together.
+   */
+  const unsigned int   batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType  fixedPoints[ batchSize ];
+  RealType             fixedImageValues[ batchSize ];
+  MovingImagePointType mappedPoints[ batchSize ];
+  bool                 samplesOk[ batchSize ];
+  RealType             movingImageValues[ batchSize ];
+
+  /** Loop over the fixed image samples to calculate the sums. */
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
+  {
+    const unsigned int blockSize = static_cast< unsigned int >(
+      std::min< unsigned long >( pos_end - blockBegin, batchSize ) );
+
+    /** Read the fixed image samples, transform them, check if they are
+     * inside the moving mask, and compute the moving image values.
+     */
+    this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints, movingImageValues, 0, samplesOk, blockSize );
+
+    for( unsigned int i = 0; i < blockSize; ++i )
+    {
+      if( !samplesOk[ i ] )
+      {
+        continue;
+      }
+      numberOfPixelsCounted++;
+
+      const RealType fixedImageValue  = fixedImageValues[ i ];
+      const RealType movingImageValue = movingImageValues[ i ];
+
+      /** Update some sums needed to calculate NC. */
+      sff += fixedImageValue  * fixedImageValue;
+      smm += movingImageValue * movingImageValue;
+      sfm += fixedImageValue  * movingImageValue;
+      sf  += fixedImageValue;  // Only needed when m_SubtractMean == true
+      sm  += movingImageValue; // Only needed when m_SubtractMean == true
+
+    } // end for loop over the samples of the block
+
+  } // end for loop over the image sample container
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sff                   = sff;
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Smm                   = smm;
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sfm                   = sfm;
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sf                    = sf;
+  this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Sm                    = sm;
+
+} // end ThreadedGetValue()
+
+
+/**
+ * ******************* AfterThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetValue( MeasureType & value ) const
+{
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
+
+  /** Accumulate the number of pixels. */
+  this->m_NumberOfPixelsCounted
+    = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
+  for( ThreadIdType i = 1; i < numberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted
+      += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted;
+
+    /** Reset this variable for the next iteration. */
+    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
+  }
+
+  /** Check if enough samples were valid. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  this->CheckNumberOfSamples(
+    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+
+  /** Accumulate values. */
+  const AccumulateType zero = NumericTraits< AccumulateType >::Zero;
+  AccumulateType       sff  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Sff;
+  AccumulateType       smm  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Smm;
+  AccumulateType       sfm  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Sfm;
+  AccumulateType       sf   = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Sf;
+  AccumulateType       sm   = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ 0 ].st_Sm;
+  for( ThreadIdType i = 1; i < numberOfThreads; ++i )
+  {
+    sff += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sff;
+    smm += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Smm;
+    sfm += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sfm;
+    sf  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sf;
+    sm  += this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sm;
+
+    /** Reset these variables for the next iteration. */
+    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sff = zero;
+    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Smm = zero;
+    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sfm = zero;
+    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sf  = zero;
+    this->m_CorrelationGetValueAndDerivativePerThreadVariables[ i ].st_Sm  = zero;
+  }
+
+  /** If SubtractMean, then subtract things from sff, smm and sfm. */
+  const RealType N = static_cast< RealType >( this->m_NumberOfPixelsCounted );
+  this->m_FixedMean  = zero;
+  this->m_MovingMean = zero;
+  if( this->m_SubtractMean )
+  {
+    sff -= ( sf * sf / N );
+    smm -= ( sm * sm / N );
+    sfm -= ( sf * sm / N );
+    this->m_FixedMean  = sf / N;
+    this->m_MovingMean = sm / N;
+  }
+
+  /** The denominator of the value and the derivative. */
+  this->m_Denominator = -1.0 * std::sqrt( sff * smm );
+
+  /** Check for sufficiently large denominator. */
+  if( this->m_Denominator > -1e-14 )
+  {
+    this->m_CorrelationRatio = zero;
+    value                    = NumericTraits< MeasureType >::Zero;
+    return;
+  }
+
+  /** Calculate the metric value. */
+  this->m_CorrelationRatio = sfm / smm;
+  value                    = sfm / this->m_Denominator;
+
+} // end AfterThreadedGetValue()
+
+
 /**
  * ******************* GetDerivative *******************
  */
@@ -390,7 +618,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
     MovingImageDerivativeType   movingImageDerivative;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -415,7 +643,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
       const RealType & fixedImageValue = static_cast< RealType >( ( *fiter ).Value().m_ImageValue );
 
       /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateSampleTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the innerproducts (dM/dx)^T (dT/dmu) and (dMask/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
@@ -513,6 +741,20 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
+  /** With the fused accumulation, first compute the sums in a value-only pass. */
+  if( this->m_UseFusedDerivativeAccumulation )
+  {
+    this->LaunchGetValueThreaderCallback();
+    this->AfterThreadedGetValue( value );
+
+    /** Without a valid denominator the derivative is zero. */
+    if( this->m_Denominator > -1e-14 )
+    {
+      derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+      return;
+    }
+  }
+
   /** launch multithreading metric */
   this->LaunchGetValueAndDerivativeThreaderCallback();
 
@@ -531,10 +773,16 @@ void
 AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 ::ThreadedGetValueAndDerivative( ThreadIdType threadId )
 {
-  /** Initialize array that stores dM(x)/dmu, and the sparse Jacobian + indices. */
-  const NumberOfParametersType nnzji = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  NonZeroJacobianIndicesType   nzji  = NonZeroJacobianIndicesType( nnzji );
-  DerivativeType               imageJacobian( nzji.size() );
+  if( this->m_UseFusedDerivativeAccumulation )
+  {
+    this->ThreadedGetFusedDerivative( threadId );
+    return;
+  }
+
+  /** Get the pre-allocated arrays that store dM(x)/dmu, and the sparse Jacobian + indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji          = arena.sa_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = arena.sa_ImageJacobian;
 
   /** Get handles to the pre-allocated derivatives for the current thread.
    * The initialization is performed at the beginning of each resolution in
@@ -545,28 +793,19 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   DerivativeType & derivativeM  = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_DerivativeM;
   DerivativeType & differential = this->m_CorrelationGetValueAndDerivativePerThreadVariables[ threadId ].st_Differential;
 
-  /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
-  const unsigned long         sampleContainerSize = sampleContainer->Size();
+  /** Get the number of samples. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
 
   /** Get the samples for this thread. */
   const unsigned long nrOfSamplesPerThreads
     = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( Self::GetNumberOfWorkUnits() ) ) );
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
 
   unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
   unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
   pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
   pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator threader_fiter;
-  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator threader_fend   = sampleContainer->Begin();
-
-  threader_fbegin += (int)pos_begin;
-  threader_fend   += (int)pos_end;
-
   /** Create variables to store intermediate results. */
   AccumulateType sff                   = NumericTraits< AccumulateType >::Zero;
   AccumulateType smm                   = NumericTraits< AccumulateType >::Zero;
@@ -575,53 +814,44 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   AccumulateType sm                    = NumericTraits< AccumulateType >::Zero;
   unsigned long  numberOfPixelsCounted = 0;
 
+  /** The samples are processed per block, see ThreadedGetValue(). */
+  const unsigned int        batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType       fixedPoints[ batchSize ];
+  RealType                  fixedImageValues[ batchSize ];
+  MovingImagePointType      mappedPoints[ batchSize ];
+  bool                      samplesOk[ batchSize ];
+  RealType                  movingImageValues[ batchSize ];
+  MovingImageDerivativeType movingImageDerivatives[ batchSize ];
+
   /** Loop over the fixed image to calculate the mean squares. */
-  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
-    RealType                    movingImageValue;
-    MovingImagePointType        mappedPoint;
-    MovingImageDerivativeType   movingImageDerivative;
-
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    const unsigned int blockSize = static_cast< unsigned int >(
+      std::min< unsigned long >( pos_end - blockBegin, batchSize ) );
 
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
-
-    /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
-     * the point is inside the moving image buffer.
+    /** Read the fixed image samples, transform them, check if they are
+     * inside the moving mask, and compute the moving image values M(T(x))
+     * and derivatives dM/dx.
      */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
-    }
+    this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+      movingImageValues, movingImageDerivatives, samplesOk, blockSize );
 
-    if( sampleOk )
+    for( unsigned int b = 0; b < blockSize; ++b )
     {
+      if( !samplesOk[ b ] )
+      {
+        continue;
+      }
       numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue
-        = static_cast< RealType >( ( *threader_fiter ).Value().m_ImageValue );
-
-#if 0
-      /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      const RealType fixedImageValue  = fixedImageValues[ b ];
+      const RealType movingImageValue = movingImageValues[ b ];
 
-      /** Compute the inner products (dM/dx)^T (dT/dmu). */
-      this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
-#else
       /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
-      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
-        fixedPoint, movingImageDerivative, imageJacobian, nzji );
-#endif
+      this->EvaluateSampleJacobianWithImageGradientProduct( blockBegin + b,
+        fixedPoints[ b ], movingImageDerivatives[ b ], imageJacobian, nzji );
 
       /** Update some sums needed to calculate the value of NC. */
       sff += fixedImageValue  * fixedImageValue;
@@ -635,7 +865,7 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
         fixedImageValue, movingImageValue, imageJacobian, nzji,
         derivativeF, derivativeM, differential );
 
-    } // end if sampleOk
+    } // end for loop over the samples of the block
 
   } // end for loop over the image sample container
 
@@ -650,6 +880,105 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 } // end ThreadedGetValueAndDerivative()
 
 
+/**
+ * ******************* ThreadedGetFusedDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetFusedDerivative( ThreadIdType threadId )
+{
+  /** Get the pre-allocated arrays that store dM(x)/dmu, and the sparse Jacobian + indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji          = arena.sa_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = arena.sa_ImageJacobian;
+
+  /** Get a handle to the pre-allocated derivative for the current thread. */
+  DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
+
+  /** Get the number of samples. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** The terms of the NC of the value-only pass. */
+  const AccumulateType fixedMean        = this->m_FixedMean;
+  const AccumulateType movingMean       = this->m_MovingMean;
+  const AccumulateType correlationRatio = this->m_CorrelationRatio;
+
+  /** The samples are processed per block, see ThreadedGetValue(). */
+  const unsigned int        batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType       fixedPoints[ batchSize ];
+  RealType                  fixedImageValues[ batchSize ];
+  MovingImagePointType      mappedPoints[ batchSize ];
+  bool                      samplesOk[ batchSize ];
+  RealType                  movingImageValues[ batchSize ];
+  MovingImageDerivativeType movingImageDerivatives[ batchSize ];
+
+  /** Loop over the fixed image samples to calculate the derivative. */
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
+  {
+    const unsigned int blockSize = static_cast< unsigned int >(
+      std::min< unsigned long >( pos_end - blockBegin, batchSize ) );
+
+    /** Read the fixed image samples, transform them, check if they are
+     * inside the moving mask, and compute the moving image values M(T(x))
+     * and derivatives dM/dx.
+     */
+    this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+      movingImageValues, movingImageDerivatives, samplesOk, blockSize );
+
+    for( unsigned int b = 0; b < blockSize; ++b )
+    {
+      if( !samplesOk[ b ] )
+      {
+        continue;
+      }
+
+      const RealType fixedImageValue  = fixedImageValues[ b ];
+      const RealType movingImageValue = movingImageValues[ b ];
+
+      /** Compute the inner product of the transform Jacobian dT/dmu and the moving image gradient dM/dx. */
+      this->EvaluateSampleJacobianWithImageGradientProduct( blockBegin + b,
+        fixedPoints[ b ], movingImageDerivatives[ b ], imageJacobian, nzji );
+
+      /** The derivative of the numerator of the NC, minus sfm / smm times the
+       * derivative of smm, is the sum over the samples of this weight times
+       * the differential.
+       */
+      const DerivativeValueType weight = ( fixedImageValue - fixedMean )
+        - correlationRatio * ( movingImageValue - movingMean );
+
+      if( this->m_UseSparseDerivativeAccumulation )
+      {
+        this->AddSparseDerivativeTerms( threadId, imageJacobian, nzji, weight );
+      }
+      else
+      {
+        for( unsigned int i = 0; i < nzji.size(); ++i )
+        {
+          derivative[ nzji[ i ] ] += weight * imageJacobian[ i ];
+        }
+      }
+
+    } // end for loop over the samples of the block
+
+  } // end for loop over the image sample container
+
+} // end ThreadedGetFusedDerivative()
+
+
 /**
  * ******************* AfterThreadedGetValueAndDerivative *******************
  */
@@ -660,7 +989,20 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
 ::AfterThreadedGetValueAndDerivative(
   MeasureType & value, DerivativeType & derivative ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  /** With the fused accumulation, the value is already known, and the
+   * derivatives of the threads only need to be summed and normalized.
+   */
+  if( this->m_UseFusedDerivativeAccumulation )
+  {
+    this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
+    this->m_ThreaderMetricParameters.st_NormalizationFactor = this->m_Denominator;
+
+    this->LaunchThreaderCallback( Superclass::AccumulateDerivativesThreaderCallback,
+      const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+    return;
+  }
+
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted
@@ -762,19 +1104,16 @@ AdvancedNormalizedCorrelationImageToImageMetric< TFixedImage, TMovingImage >
   }
   else if( true ) // force !this->m_UseOpenMP ) // multi-threaded using ITK threads
   {
-    MultiThreaderAccumulateDerivativeType * temp = new MultiThreaderAccumulateDerivativeType;
-
-    temp->st_Metric              = const_cast< Self * >( this );
-    temp->st_sf_N                = sf / N;
-    temp->st_sm_N                = sm / N;
-    temp->st_sfm_smm             = sfm / smm;
-    temp->st_InvertedDenominator = 1.0 / denom;
-    temp->st_DerivativePointer   = derivative.begin();
+    MultiThreaderAccumulateDerivativeType temp;
 
-    this->m_Threader->SetSingleMethod( AccumulateDerivativesThreaderCallback, temp );
-    this->m_Threader->SingleMethodExecute();
+    temp.st_Metric              = const_cast< Self * >( this );
+    temp.st_sf_N                = sf / N;
+    temp.st_sm_N                = sm / N;
+    temp.st_sfm_smm             = sfm / smm;
+    temp.st_InvertedDenominator = 1.0 / denom;
+    temp.st_DerivativePointer   = derivative.begin();
 
-    delete temp;
+    this->LaunchThreaderCallback( AccumulateDerivativesThreaderCallback, &temp );
   }
 #ifdef ELASTIX_USE_OPENMP
   // compute multi-threadedly with openmp
@@ -39,6 +39,11 @@ namespace elastix
  * The parameters used in this class are:
  * \parameter Metric: Select this metric as follows:\n
  *    <tt>(Metric "TransformBendingEnergyPenalty")</tt>
+ * \parameter UseAnalyticBendingEnergy: Whether the bending energy of a third order
+ *    B-spline transform is computed exactly from its coefficients, instead of from
+ *    the spatial Hessians at the samples. Can be given for each resolution.\n
+ *    example: <tt>(UseAnalyticBendingEnergy "true")</tt>\n
+ *    The default is "false".
  *
  * \ingroup Metrics
  *
@@ -62,6 +62,12 @@ TransformBendingEnergyPenalty< TElastix >
     "NumberOfSamplesForSelfHessian", this->GetComponentLabel(), level, 0 );
   this->SetNumberOfSamplesForSelfHessian( numberOfSamplesForSelfHessian );
 
+  /** Compute the bending energy of a B-spline from its coefficients, or not. */
+  bool useAnalyticBendingEnergy = false;
+  this->GetConfiguration()->ReadParameter( useAnalyticBendingEnergy,
+    "UseAnalyticBendingEnergy", this->GetComponentLabel(), level, 0 );
+  this->SetUseAnalyticBendingEnergy( useAnalyticBendingEnergy );
+
 } // end BeforeEachResolution()
 
 
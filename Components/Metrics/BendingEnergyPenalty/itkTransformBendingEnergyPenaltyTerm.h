@@ -34,6 +34,17 @@ namespace itk
  * [1]. For rigid and affine transformation this energy is always
  * zero.
  *
+ * By default the energy is estimated from the spatial Hessians at the
+ * samples. For a third order B-spline transform, the energy is a quadratic
+ * form in the coefficients, which UseAnalyticBendingEnergy computes exactly,
+ * from the coefficient images. The squared second derivatives are then
+ * integrated over the support of the B-spline, and divided by the volume of
+ * the fixed image region. The integrals of products of shifted B-splines are
+ * 7-tap kernels, so the value and the derivative are computed by separable
+ * convolution of the coefficients, at a cost proportional to the number of
+ * parameters, and without the image sampler. Other transforms, and B-splines
+ * composed with an initial transform, still use the samples.
+ *
  *
  * [1]: D. Rueckert, L. I. Sonoda, C. Hayes, D. L. G. Hill,
  *      M. O. Leach, and D. J. Hawkes, "Nonrigid registration
@@ -129,8 +140,16 @@ public:
   itkStaticConstMacro( FixedImageDimension, unsigned int, FixedImageType::ImageDimension );
 
   /** Get the penalty term value. */
+  virtual MeasureType GetValueSingleThreaded( const ParametersType & parameters ) const;
+
   MeasureType GetValue( const ParametersType & parameters ) const override;
 
+  /** Get the value for each thread. */
+  inline void ThreadedGetValue( ThreadIdType threadID ) override;
+
+  /** Gather the values from all threads. */
+  inline void AfterThreadedGetValue( MeasureType & value ) const override;
+
   /** Get the penalty term derivative. */
   void GetDerivative( const ParametersType & parameters,
     DerivativeType & derivative ) const override;
@@ -160,6 +179,13 @@ public:
   itkSetMacro( NumberOfSamplesForSelfHessian, unsigned int );
   itkGetConstMacro( NumberOfSamplesForSelfHessian, unsigned int );
 
+  /** Set/Get whether the bending energy of a B-spline transform is computed
+   * analytically from its coefficients. Default: false.
+   */
+  itkSetMacro( UseAnalyticBendingEnergy, bool );
+  itkGetConstMacro( UseAnalyticBendingEnergy, bool );
+  itkBooleanMacro( UseAnalyticBendingEnergy );
+
 protected:
 
   /** Typedefs for indices and points. */
@@ -187,7 +213,21 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );                    // purposely not implemented
 
+  /** Compute the value, and the derivative if it is not null, analytically.
+   * Return false if the transform does not support it.
+   */
+  bool ComputeAnalyticBendingEnergy( const ParametersType & parameters,
+    MeasureType & value, DerivativeType * derivative ) const;
+
+  /** Correlate the lines of an image along a dimension with a symmetric
+   * 7-tap kernel, given by its taps 0 to 3, with zeros outside the image.
+   */
+  static void CorrelateWithBendingEnergyKernel( const double * input, double * output,
+    const typename BSplineOrder3TransformType::SizeType & size,
+    const unsigned int dimension, const double * kernel, const double scale );
+
   unsigned int m_NumberOfSamplesForSelfHessian;
+  bool         m_UseAnalyticBendingEnergy;
 
 };
 
@@ -20,6 +20,10 @@
 
 #include "itkTransformBendingEnergyPenaltyTerm.h"
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
 #endif
@@ -41,18 +45,19 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
   this->SetUseImageSampler( true );
 
   this->m_NumberOfSamplesForSelfHessian = 100000;
+  this->m_UseAnalyticBendingEnergy       = false;
 
 } // end Constructor
 
 
 /**
- * ****************** GetValue *******************************
+ * ****************** GetValueSingleThreaded *******************************
  */
 
 template< class TFixedImage, class TScalarType >
 typename TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >::MeasureType
 TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
-::GetValue( const ParametersType & parameters ) const
+::GetValueSingleThreaded( const ParametersType & parameters ) const
 {
   /** Initialize some variables. */
   this->m_NumberOfPixelsCounted = 0;
@@ -134,9 +139,182 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
   /** Return the value. */
   return static_cast< MeasureType >( measure );
 
+} // end GetValueSingleThreaded()
+
+
+/**
+ * ****************** GetValue *******************************
+ */
+
+template< class TFixedImage, class TScalarType >
+typename TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >::MeasureType
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::GetValue( const ParametersType & parameters ) const
+{
+  /** Compute the exact value from the coefficients, if possible. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  if( this->m_UseAnalyticBendingEnergy
+    && this->ComputeAnalyticBendingEnergy( parameters, value, nullptr ) )
+  {
+    return value;
+  }
+
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueSingleThreaded( parameters );
+  }
+
+  /** Check if the SpatialHessian is nonzero. */
+  this->m_NumberOfPixelsCounted = 0;
+  if( !this->m_AdvancedTransform->GetHasNonZeroSpatialHessian() )
+  {
+    return NumericTraits< MeasureType >::Zero;
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * Because of these calls GetValue itself is not thread-safe,
+   * so cannot be called multiple times simultaneously.
+   * This is however needed in the CombinationImageToImageMetric.
+   * In that case, you need to:
+   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
+   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before calling GetValue
+   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
+   * - Now you can call GetValue multi-threaded.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueThreaderCallback();
+
+  /** Gather the metric values from all threads. */
+  this->AfterThreadedGetValue( value );
+
+  return value;
+
 } // end GetValue()
 
 
+/**
+ * ******************* ThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::ThreadedGetValue( ThreadIdType threadId )
+{
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
+  const unsigned long         sampleContainerSize = sampleContainer->Size();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Create iterator over the sample container. */
+  typename ImageSampleContainerType::ConstIterator fiter;
+  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
+  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->Begin();
+  fbegin                                                 += (int)pos_begin;
+  fend                                                   += (int)pos_end;
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  unsigned long      numberOfPixelsCounted = 0;
+  MeasureType        measure               = NumericTraits< MeasureType >::Zero;
+  SpatialHessianType spatialHessian;
+
+  /** Loop over the fixed image samples to calculate the penalty term. */
+  for( fiter = fbegin; fiter != fend; ++fiter )
+  {
+    /** Read fixed coordinates and initialize some variables. */
+    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
+    MovingImagePointType        mappedPoint;
+
+    /** Transform point and check if it is inside the B-spline support region. */
+    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+
+    /** Check if point is inside mask. */
+    if( sampleOk )
+    {
+      sampleOk = this->IsInsideMovingMask( mappedPoint );
+    }
+
+    if( sampleOk )
+    {
+      numberOfPixelsCounted++;
+
+      /** Get the spatial Hessian of the transformation at the current point.
+       * This is needed to compute the bending energy.
+       */
+      this->m_AdvancedTransform->GetSpatialHessian( fixedPoint, spatialHessian );
+
+      /** Compute the contribution of this point. */
+      for( unsigned int k = 0; k < FixedImageDimension; ++k )
+      {
+        measure += vnl_math::sqr(
+          spatialHessian[ k ].GetVnlMatrix().frobenius_norm() );
+      }
+
+    } // end if sampleOk
+
+  } // end for loop over the image sample container
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
+
+} // end ThreadedGetValue()
+
+
+/**
+ * ******************* AfterThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::AfterThreadedGetValue( MeasureType & value ) const
+{
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
+
+  /** Accumulate the number of pixels. */
+  this->m_NumberOfPixelsCounted = 0;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
+  }
+
+  /** Check if enough samples were valid. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  this->CheckNumberOfSamples(
+    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+
+  /** Accumulate and normalize values. */
+  value = NumericTraits< MeasureType >::Zero;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    value += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value = NumericTraits< MeasureType >::Zero;
+  }
+  value /= static_cast< RealType >( this->m_NumberOfPixelsCounted );
+
+} // end AfterThreadedGetValue()
+
+
 /**
  * ******************* GetDerivative *******************
  */
@@ -368,6 +546,13 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
   const ParametersType & parameters,
   MeasureType & value, DerivativeType & derivative ) const
 {
+  /** Compute the exact value and derivative from the coefficients, if possible. */
+  if( this->m_UseAnalyticBendingEnergy
+    && this->ComputeAnalyticBendingEnergy( parameters, value, &derivative ) )
+  {
+    return;
+  }
+
   /** Option for now to still use the single threaded code. */
   if( !this->m_UseMultiThread )
   {
@@ -408,14 +593,13 @@ void
 TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
 ::ThreadedGetValueAndDerivative( ThreadIdType threadId )
 {
-  /** Create and initialize some variables. */
-  SpatialHessianType           spatialHessian;
-  JacobianOfSpatialHessianType jacobianOfSpatialHessian;
-  NonZeroJacobianIndicesType   nonZeroJacobianIndices;
-  const NumberOfParametersType numberOfNonZeroJacobianIndices
-    = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
-  jacobianOfSpatialHessian.resize( numberOfNonZeroJacobianIndices );
-  nonZeroJacobianIndices.resize( numberOfNonZeroJacobianIndices );
+  /** Create and initialize some variables. The sparse Jacobians are taken
+   * from the scratch memory of this thread, which is sized once per resolution.
+   */
+  SpatialHessianType                       spatialHessian;
+  typename Superclass::ScratchArenaStruct & arena                    = this->GetScratchArena( threadId );
+  JacobianOfSpatialHessianType &           jacobianOfSpatialHessian = arena.sa_JacobianOfSpatialHessian;
+  NonZeroJacobianIndicesType &             nonZeroJacobianIndices   = arena.sa_NonZeroJacobianIndices;
 
   /** Check if the SpatialHessian is nonzero. */
   if( !this->m_AdvancedTransform->GetHasNonZeroSpatialHessian()
@@ -443,7 +627,7 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
   /** Get the samples for this thread. */
   const unsigned long nrOfSamplesPerThreads
     = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( Self::GetNumberOfWorkUnits() ) ) );
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
 
   unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
   unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
@@ -592,7 +776,7 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
 ::AfterThreadedGetValueAndDerivative(
   MeasureType & value, DerivativeType & derivative ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted = 0;
@@ -640,9 +824,8 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
     this->m_ThreaderMetricParameters.st_NormalizationFactor
       = static_cast< DerivativeValueType >( this->m_NumberOfPixelsCounted );
 
-    this->m_Threader->SetSingleMethod( this->AccumulateDerivativesThreaderCallback,
+    this->LaunchThreaderCallback( this->AccumulateDerivativesThreaderCallback,
       const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
-    this->m_Threader->SingleMethodExecute();
   }
 #ifdef ELASTIX_USE_OPENMP
   // compute multi-threadedly with openmp
@@ -668,6 +851,186 @@ TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
 } // end AfterThreadedGetValueAndDerivative()
 
 
+/**
+ * ******************* ComputeAnalyticBendingEnergy *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+bool
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::ComputeAnalyticBendingEnergy( const ParametersType & parameters,
+  MeasureType & value, DerivativeType * derivative ) const
+{
+  /** The integrals K_d( delta ) = int beta^(d)( u ) beta^(d)( u - delta ) du
+   * of the derivatives of order d of shifted cubic B-splines, for the shifts
+   * delta = 0, 1, 2, 3. They are (-1)^d times the derivatives of order 2d
+   * of the B-spline of order 7 at the integers.
+   */
+  static const double kernels[ 3 ][ 4 ] = {
+    { 2416.0 / 5040.0, 1191.0 / 5040.0, 120.0 / 5040.0, 1.0 / 5040.0 },
+    { 2.0 / 3.0, -1.0 / 8.0, -1.0 / 5.0, -1.0 / 120.0 },
+    { 8.0 / 3.0, -3.0 / 2.0, 0.0, 1.0 / 6.0 }
+  };
+
+  /** Only third order B-splines, possibly added to an initial transform. */
+  BSplineOrder3TransformPointer bspline;
+  if( !this->CheckForBSplineTransform2( bspline ) || bspline.IsNull() )
+  {
+    return false;
+  }
+  const CombinationTransformType * combination
+    = dynamic_cast< const CombinationTransformType * >( this->m_AdvancedTransform.GetPointer() );
+  if( combination && combination->GetUseComposition() && combination->GetInitialTransform() )
+  {
+    return false;
+  }
+
+  /** The parameters are the coefficient images, one after the other. */
+  const typename BSplineOrder3TransformType::SizeType size
+    = bspline->GetGridRegion().GetSize();
+  const typename BSplineOrder3TransformType::SpacingType spacing
+    = bspline->GetGridSpacing();
+  const SizeValueType numberOfGridPoints = bspline->GetGridRegion().GetNumberOfPixels();
+  if( numberOfGridPoints == 0
+    || parameters.GetSize() != FixedImageDimension * numberOfGridPoints )
+  {
+    return false;
+  }
+
+  /** Normalize by the volume of the fixed image region, such that the value
+   * is comparable to the mean over the samples.
+   */
+  double volume = static_cast< double >( this->GetFixedImageRegion().GetNumberOfPixels() );
+  for( unsigned int m = 0; m < FixedImageDimension; ++m )
+  {
+    volume *= this->GetFixedImage()->GetSpacing()[ m ];
+  }
+
+  if( derivative )
+  {
+    derivative->SetSize( parameters.GetSize() );
+  }
+
+  /** Each component of the displacement only contributes to its own
+   * coefficients, so the components are processed in parallel.
+   */
+  std::vector< double > componentValues( FixedImageDimension, 0.0 );
+  this->ProcessSlices( FixedImageDimension, true,
+    [ & ]( const unsigned int k )
+    {
+      const double * alpha = parameters.data_block() + k * numberOfGridPoints;
+      double *       grad  = derivative ? derivative->data_block() + k * numberOfGridPoints : nullptr;
+      if( grad )
+      {
+        std::fill( grad, grad + numberOfGridPoints, 0.0 );
+      }
+
+      std::vector< double > buffer1( numberOfGridPoints );
+      std::vector< double > buffer2( numberOfGridPoints );
+
+      /** Loop over the second derivatives d^2 / dx_i dx_j with i <= j. The
+       * mixed derivatives occur twice in the squared Frobenius norm.
+       */
+      for( unsigned int i = 0; i < FixedImageDimension; ++i )
+      {
+        for( unsigned int j = i; j < FixedImageDimension; ++j )
+        {
+          /** Apply the symmetric matrix of this term to the coefficients. */
+          const double * source = alpha;
+          double *       target = nullptr;
+          for( unsigned int m = 0; m < FixedImageDimension; ++m )
+          {
+            const unsigned int order = ( m == i ? 1 : 0 ) + ( m == j ? 1 : 0 );
+            target = ( m % 2 == 0 ) ? &buffer1[ 0 ] : &buffer2[ 0 ];
+            Self::CorrelateWithBendingEnergyKernel( source, target, size, m,
+              kernels[ order ], std::pow( spacing[ m ], 1.0 - 2.0 * order ) );
+            source = target;
+          }
+
+          const double multiplicity = ( i == j ) ? 1.0 : 2.0;
+          double       term         = 0.0;
+          for( SizeValueType n = 0; n < numberOfGridPoints; ++n )
+          {
+            term += alpha[ n ] * target[ n ];
+          }
+          componentValues[ k ] += multiplicity * term;
+
+          if( grad )
+          {
+            const double factor = 2.0 * multiplicity / volume;
+            for( SizeValueType n = 0; n < numberOfGridPoints; ++n )
+            {
+              grad[ n ] += factor * target[ n ];
+            }
+          }
+        }
+      }
+    } );
+
+  /** Sum the components in a fixed order. */
+  double measure = 0.0;
+  for( unsigned int k = 0; k < FixedImageDimension; ++k )
+  {
+    measure += componentValues[ k ];
+  }
+  value = static_cast< MeasureType >( measure / volume );
+
+  this->m_NumberOfPixelsCounted = numberOfGridPoints;
+  return true;
+
+} // end ComputeAnalyticBendingEnergy()
+
+
+/**
+ * ******************* CorrelateWithBendingEnergyKernel *******************
+ */
+
+template< class TFixedImage, class TScalarType >
+void
+TransformBendingEnergyPenaltyTerm< TFixedImage, TScalarType >
+::CorrelateWithBendingEnergyKernel( const double * input, double * output,
+  const typename BSplineOrder3TransformType::SizeType & size,
+  const unsigned int dimension, const double * kernel, const double scale )
+{
+  SizeValueType numberOfPixels = 1;
+  SizeValueType stride         = 1;
+  for( unsigned int m = 0; m < FixedImageDimension; ++m )
+  {
+    numberOfPixels *= size[ m ];
+    if( m < dimension )
+    {
+      stride *= size[ m ];
+    }
+  }
+  const long          length        = static_cast< long >( size[ dimension ] );
+  const SizeValueType numberOfLines = numberOfPixels / size[ dimension ];
+
+  for( SizeValueType line = 0; line < numberOfLines; ++line )
+  {
+    const SizeValueType base = ( line % stride ) + ( line / stride ) * stride * length;
+    const double *      in   = input + base;
+    double *            out  = output + base;
+    for( long x = 0; x < length; ++x )
+    {
+      double sum = kernel[ 0 ] * in[ x * stride ];
+      for( long delta = 1; delta <= 3; ++delta )
+      {
+        if( x - delta >= 0 )
+        {
+          sum += kernel[ delta ] * in[ ( x - delta ) * stride ];
+        }
+        if( x + delta < length )
+        {
+          sum += kernel[ delta ] * in[ ( x + delta ) * stride ];
+        }
+      }
+      out[ x * stride ] = scale * sum;
+    }
+  }
+
+} // end CorrelateWithBendingEnergyKernel()
+
+
 /**
  * ******************* GetSelfHessian *******************
  */
@@ -31,6 +31,15 @@ namespace elastix
  * The parameters used in this class are:
  * \parameter Metric: Select this metric as follows:\n
  *    <tt>(Metric "CorrespondingPointsEuclideanDistanceMetric")</tt>
+ * \parameter UseClosestPoints: Whether each transformed fixed point is compared to
+ *    the closest moving point, instead of the corresponding one. The point sets then
+ *    need not have the same number of points.\n
+ *    example: <tt>(UseClosestPoints "true")</tt>\n
+ *    The default is "false".
+ * \parameter UseMultiThreadingForMetrics: Whether the points are processed in
+ *    parallel. Can be given for each resolution.\n
+ *    example: <tt>(UseMultiThreadingForMetrics "false")</tt>\n
+ *    The default is "true".
  *
  * \ingroup Metrics
  *
@@ -134,6 +143,12 @@ public:
    */
   void BeforeRegistration( void ) override;
 
+  /**
+   * Do some things before each resolution:
+   * \li Set whether the points are processed in parallel.
+   */
+  void BeforeEachResolution( void ) override;
+
   /** Function to read the corresponding points. */
   unsigned int ReadLandmarks(
   const std::string & landmarkFileName,
@@ -123,8 +123,14 @@ CorrespondingPointsEuclideanDistanceMetric< TElastix >
     movingName, movingPointSet, movingImage );
   this->SetMovingPointSet( movingPointSet );
 
+  /** Compare to the closest points, or to the corresponding ones. */
+  bool useClosestPoints = false;
+  this->GetConfiguration()->ReadParameter( useClosestPoints,
+    "UseClosestPoints", this->GetComponentLabel(), 0, 0 );
+  this->SetUseClosestPoints( useClosestPoints );
+
   /** Check. */
-  if( nrOfFixedPoints != nrOfMovingPoints )
+  if( !useClosestPoints && nrOfFixedPoints != nrOfMovingPoints )
   {
     itkExceptionMacro( << "ERROR: the number of points in the fixed pointset ("
                        << nrOfFixedPoints << ") does not match that of the moving pointset ("
@@ -134,6 +140,28 @@ CorrespondingPointsEuclideanDistanceMetric< TElastix >
 } // end BeforeRegistration()
 
 
+/**
+ * ***************** BeforeEachResolution ***********************
+ */
+
+template< class TElastix >
+void
+CorrespondingPointsEuclideanDistanceMetric< TElastix >
+::BeforeEachResolution( void )
+{
+  /** Get the current resolution level. */
+  unsigned int level
+    = ( this->m_Registration->GetAsITKBaseType() )->GetCurrentLevel();
+
+  /** Should the metric use multi-threading? */
+  bool useMultiThreading = true;
+  this->GetConfiguration()->ReadParameter( useMultiThreading,
+    "UseMultiThreadingForMetrics", this->GetComponentLabel(), level, 0 );
+  this->SetUseMultiThread( useMultiThreading );
+
+} // end BeforeEachResolution()
+
+
 /**
  * ***************** ReadLandmarks ***********************
  */
@@ -22,6 +22,9 @@
 #include "itkPoint.h"
 #include "itkPointSet.h"
 #include "itkImage.h"
+#include "itkPointKdTree.h"
+
+#include <vector>
 
 namespace itk
 {
@@ -29,7 +32,16 @@ namespace itk
 /** \class CorrespondingPointsEuclideanDistancePointMetric
  * \brief Computes the Euclidean distance between a moving point-set
  *  and a fixed point-set.
- *  Correspondence is needed.
+ *  Correspondence is needed, unless UseClosestPoints is on.
+ *
+ * With UseClosestPoints, each transformed fixed point is compared to the
+ * closest moving point, as in the iterative closest point algorithm. The
+ * closest points are found in a kd-tree of the moving points, which is built
+ * in Initialize(). The fixed and moving point sets may then have different
+ * sizes.
+ *
+ * When UseMultiThread is on, the points are processed in parallel chunks.
+ * The contributions of the chunks are summed in a fixed order.
  *
  *
  * \ingroup RegistrationMetrics
@@ -79,6 +91,20 @@ public:
 
   typedef typename Superclass::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
 
+  /** The kd-tree of the moving points. */
+  typedef PointKdTree< CoordRepType,
+    itkGetStaticConstMacro( MovingPointSetDimension ) > KdTreeType;
+
+  /** Initialize the metric, and build the kd-tree when needed. */
+  void Initialize( void ) override;
+
+  /** Set/Get whether each fixed point is compared to the closest moving point,
+   * instead of the corresponding one. Default: false.
+   */
+  itkSetMacro( UseClosestPoints, bool );
+  itkGetConstMacro( UseClosestPoints, bool );
+  itkBooleanMacro( UseClosestPoints );
+
   /**  Get the value for single valued optimizers. */
   MeasureType GetValue( const TransformParametersType & parameters ) const override;
 
@@ -100,6 +126,17 @@ private:
   CorrespondingPointsEuclideanDistancePointMetric( const Self & ); // purposely not implemented
   void operator=( const Self & );                                  // purposely not implemented
 
+  /** Compute the value, and the derivative if it is not null, for the
+   * current transform parameters.
+   */
+  void ComputeValueAndDerivative( MeasureType & value, DerivativeType * derivative ) const;
+
+  bool       m_UseClosestPoints;
+  KdTreeType m_MovingPointsKdTree;
+
+  /** The derivatives of the chunks of points, kept between the calls. */
+  mutable std::vector< DerivativeType > m_ChunkDerivatives;
+
 };
 
 } // end namespace itk
@@ -20,6 +20,8 @@
 
 #include "itkCorrespondingPointsEuclideanDistancePointMetric.h"
 
+#include <limits>
+
 namespace itk
 {
 
@@ -30,81 +32,65 @@ namespace itk
 template< class TFixedPointSet, class TMovingPointSet >
 CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >
 ::CorrespondingPointsEuclideanDistancePointMetric()
-{} // end Constructor
+{
+  this->m_UseClosestPoints = false;
+
+} // end Constructor
+
 
 /**
- * ******************* GetValue *******************
+ * ******************* Initialize *******************
  */
 
 template< class TFixedPointSet, class TMovingPointSet >
-typename CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >::MeasureType
+void
 CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >
-::GetValue( const TransformParametersType & parameters ) const
+::Initialize( void )
 {
-  /** Sanity checks. */
-  FixedPointSetConstPointer fixedPointSet = this->GetFixedPointSet();
-  if( !fixedPointSet )
-  {
-    itkExceptionMacro( << "Fixed point set has not been assigned" );
-  }
+  /** Call the superclass' implementation. */
+  this->Superclass::Initialize();
 
-  MovingPointSetConstPointer movingPointSet = this->GetMovingPointSet();
-  if( !movingPointSet )
-  {
-    itkExceptionMacro( << "Moving point set has not been assigned" );
-  }
-
-  /** Initialize some variables. */
-  this->m_NumberOfPointsCounted = 0;
-  MeasureType     measure = NumericTraits< MeasureType >::Zero;
-  InputPointType  movingPoint;
-  OutputPointType fixedPoint, mappedPoint;
-
-  /** Make sure the transform parameters are up to date. */
-  this->SetTransformParameters( parameters );
-
-  /** Create iterators. */
-  PointIterator pointItFixed  = fixedPointSet->GetPoints()->Begin();
-  PointIterator pointItMoving = movingPointSet->GetPoints()->Begin();
-  PointIterator pointEnd      = fixedPointSet->GetPoints()->End();
-
-  /** Loop over the corresponding points. */
-  while( pointItFixed != pointEnd )
+  /** Build the kd-tree of the moving points. The moving points do not
+   * change during the registration, so this is done only here.
+   */
+  if( this->m_UseClosestPoints )
   {
-    /** Get the current corresponding points. */
-    fixedPoint  = pointItFixed.Value();
-    movingPoint = pointItMoving.Value();
-
-    /** Transform point and check if it is inside the B-spline support region. */
-    //bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-    mappedPoint = this->m_Transform->TransformPoint( fixedPoint );
-
-    /** Check if point is inside mask. */
-    bool sampleOk = true;
-    if( sampleOk )
+    const MovingPointSetConstPointer movingPointSet = this->GetMovingPointSet();
+    if( movingPointSet->GetNumberOfPoints() == 0 )
     {
-      //sampleOk = this->IsInsideMovingMask( mappedPoint );
-      if( this->m_MovingImageMask.IsNotNull() )
-      {
-        sampleOk = this->m_MovingImageMask->IsInsideInWorldSpace( mappedPoint );
-      }
+      itkExceptionMacro( << "The moving point set is empty" );
     }
 
-    if( sampleOk )
+    typename KdTreeType::PointContainerType movingPoints;
+    movingPoints.reserve( movingPointSet->GetNumberOfPoints() );
+    PointIterator pointItMoving = movingPointSet->GetPoints()->Begin();
+    PointIterator pointEnd      = movingPointSet->GetPoints()->End();
+    for(; pointItMoving != pointEnd; ++pointItMoving )
     {
-      this->m_NumberOfPointsCounted++;
+      movingPoints.push_back( pointItMoving.Value() );
+    }
+    this->m_MovingPointsKdTree.Build( movingPoints );
+  }
 
-      VnlVectorType diffPoint = ( movingPoint - mappedPoint ).GetVnlVector();
-      measure += diffPoint.magnitude();
+} // end Initialize()
 
-    } // end if sampleOk
 
-    ++pointItFixed;
-    ++pointItMoving;
+/**
+ * ******************* GetValue *******************
+ */
 
-  } // end loop over all corresponding points
+template< class TFixedPointSet, class TMovingPointSet >
+typename CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >::MeasureType
+CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >
+::GetValue( const TransformParametersType & parameters ) const
+{
+  /** Make sure the transform parameters are up to date. */
+  this->SetTransformParameters( parameters );
 
-  return measure / this->m_NumberOfPointsCounted;
+  /** Compute the value only. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->ComputeValueAndDerivative( value, nullptr );
+  return value;
 
 } // end GetValue()
 
@@ -140,31 +126,6 @@ CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet
 ::GetValueAndDerivative( const TransformParametersType & parameters,
   MeasureType & value, DerivativeType & derivative ) const
 {
-  /** Sanity checks. */
-  FixedPointSetConstPointer fixedPointSet = this->GetFixedPointSet();
-  if( !fixedPointSet )
-  {
-    itkExceptionMacro( << "Fixed point set has not been assigned" );
-  }
-
-  MovingPointSetConstPointer movingPointSet = this->GetMovingPointSet();
-  if( !movingPointSet )
-  {
-    itkExceptionMacro( << "Moving point set has not been assigned" );
-  }
-
-  /** Initialize some variables */
-  this->m_NumberOfPointsCounted = 0;
-  MeasureType measure = NumericTraits< MeasureType >::Zero;
-  derivative = DerivativeType( this->GetNumberOfParameters() );
-  derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
-  NonZeroJacobianIndicesType nzji(
-  this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
-  TransformJacobianType jacobian;
-
-  InputPointType  movingPoint;
-  OutputPointType fixedPoint, mappedPoint;
-
   /** Call non-thread-safe stuff, such as:
    *   this->SetTransformParameters( parameters );
    *   this->GetImageSampler()->Update();
@@ -180,86 +141,183 @@ CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
 
-  /** Create iterators. */
-  PointIterator pointItFixed  = fixedPointSet->GetPoints()->Begin();
-  PointIterator pointItMoving = movingPointSet->GetPoints()->Begin();
-  PointIterator pointEnd      = fixedPointSet->GetPoints()->End();
+  /** Compute the value and the derivative. */
+  this->ComputeValueAndDerivative( value, &derivative );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ******************* ComputeValueAndDerivative *******************
+ */
 
-  /** Loop over the corresponding points. */
-  while( pointItFixed != pointEnd )
+template< class TFixedPointSet, class TMovingPointSet >
+void
+CorrespondingPointsEuclideanDistancePointMetric< TFixedPointSet, TMovingPointSet >
+::ComputeValueAndDerivative( MeasureType & value, DerivativeType * derivative ) const
+{
+  /** Sanity checks. */
+  FixedPointSetConstPointer fixedPointSet = this->GetFixedPointSet();
+  if( !fixedPointSet )
   {
-    /** Get the current corresponding points. */
-    fixedPoint  = pointItFixed.Value();
-    movingPoint = pointItMoving.Value();
+    itkExceptionMacro( << "Fixed point set has not been assigned" );
+  }
+
+  MovingPointSetConstPointer movingPointSet = this->GetMovingPointSet();
+  if( !movingPointSet )
+  {
+    itkExceptionMacro( << "Moving point set has not been assigned" );
+  }
+
+  if( this->m_UseClosestPoints
+    && this->m_MovingPointsKdTree.GetNumberOfPoints() != movingPointSet->GetNumberOfPoints() )
+  {
+    itkExceptionMacro( << "The kd-tree of the moving points is not up to date. Call Initialize()" );
+  }
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    //bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-    mappedPoint = this->m_Transform->TransformPoint( fixedPoint );
+  /** Split the points in chunks, each with its own results. */
+  const SizeValueType numberOfPoints     = fixedPointSet->GetNumberOfPoints();
+  const ThreadIdType  numberOfChunks     = this->GetNumberOfPointChunks( numberOfPoints );
+  const unsigned int  numberOfParameters = this->GetNumberOfParameters();
 
-    /** Check if point is inside mask. */
-    bool sampleOk = true;
-    if( sampleOk )
+  std::vector< MeasureType >   chunkMeasures( numberOfChunks, NumericTraits< MeasureType >::Zero );
+  std::vector< SizeValueType > chunkNumberOfPointsCounted( numberOfChunks, 0 );
+  if( derivative )
+  {
+    this->m_ChunkDerivatives.resize( numberOfChunks );
+    for( ThreadIdType i = 0; i < numberOfChunks; ++i )
     {
-      //sampleOk = this->IsInsideMovingMask( mappedPoint );
-      if( this->m_MovingImageMask.IsNotNull() )
-      {
-        sampleOk = this->m_MovingImageMask->IsInsideInWorldSpace( mappedPoint );
-      }
+      this->m_ChunkDerivatives[ i ].SetSize( numberOfParameters );
     }
+  }
 
-    if( sampleOk )
+  this->ProcessPointChunks( numberOfPoints,
+    [ this, derivative, &fixedPointSet, &movingPointSet, &chunkMeasures, &chunkNumberOfPointsCounted ](
+    const ThreadIdType chunk, const SizeValueType begin, const SizeValueType end )
     {
-      this->m_NumberOfPointsCounted++;
+      /** Initialize some variables. */
+      MeasureType      measure               = NumericTraits< MeasureType >::Zero;
+      SizeValueType    numberOfPointsCounted = 0;
+      DerivativeType * chunkDerivative       = derivative ? &this->m_ChunkDerivatives[ chunk ] : nullptr;
+      if( chunkDerivative )
+      {
+        chunkDerivative->Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+      }
 
-      /** Get the TransformJacobian dT/dmu. */
-      //this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
-      this->m_Transform->GetJacobian( fixedPoint, jacobian, nzji );
+      NonZeroJacobianIndicesType nzji(
+        this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
+      TransformJacobianType jacobian;
 
-      VnlVectorType diffPoint = ( movingPoint - mappedPoint ).GetVnlVector();
-      MeasureType   distance  = diffPoint.magnitude();
-      measure += distance;
+      /** The points containers of the default mesh traits are vectors, so
+       * that ElementAt() takes constant time.
+       */
+      const typename FixedPointSetType::PointsContainer *  fixedPoints  = fixedPointSet->GetPoints();
+      const typename MovingPointSetType::PointsContainer * movingPoints = movingPointSet->GetPoints();
 
-      /** Calculate the contributions to the derivatives with respect to each parameter. */
-      if( distance > std::numeric_limits< MeasureType >::epsilon() )
+      /** Loop over the points of this chunk. */
+      for( SizeValueType i = begin; i < end; ++i )
       {
-        VnlVectorType diff_2 = diffPoint / distance;
-        if( nzji.size() == this->GetNumberOfParameters() )
+        /** Get the current fixed point, and transform it. */
+        const OutputPointType fixedPoint  = fixedPoints->ElementAt( i );
+        const OutputPointType mappedPoint = this->m_Transform->TransformPoint( fixedPoint );
+
+        /** Check if point is inside mask. */
+        bool sampleOk = true;
+        if( this->m_MovingImageMask.IsNotNull() )
         {
-          /** Loop over all Jacobians. */
-          derivative -= diff_2 * jacobian;
+          sampleOk = this->m_MovingImageMask->IsInsideInWorldSpace( mappedPoint );
+        }
+        if( !sampleOk )
+        {
+          continue;
+        }
+
+        /** Get the corresponding or the closest moving point. */
+        InputPointType movingPoint;
+        if( this->m_UseClosestPoints )
+        {
+          double squaredDistance = 0.0;
+          movingPoint = movingPoints->ElementAt(
+            this->m_MovingPointsKdTree.FindClosestPoint( mappedPoint, squaredDistance ) );
         }
         else
         {
-          /** Only pick the nonzero Jacobians. */
-          for( unsigned int i = 0; i < nzji.size(); ++i )
+          movingPoint = movingPoints->ElementAt( i );
+        }
+
+        numberOfPointsCounted++;
+
+        VnlVectorType diffPoint = ( movingPoint - mappedPoint ).GetVnlVector();
+        MeasureType   distance  = diffPoint.magnitude();
+        measure += distance;
+
+        /** Calculate the contributions to the derivatives with respect to each parameter.
+         * The closest point is locally constant, so it does not contribute.
+         */
+        if( chunkDerivative && distance > std::numeric_limits< MeasureType >::epsilon() )
+        {
+          /** Get the TransformJacobian dT/dmu. */
+          this->m_Transform->GetJacobian( fixedPoint, jacobian, nzji );
+
+          VnlVectorType diff_2 = diffPoint / distance;
+          if( nzji.size() == this->GetNumberOfParameters() )
           {
-            const unsigned int index  = nzji[ i ];
-            VnlVectorType      column = jacobian.get_column( i );
-            derivative[ index ] -= dot_product( diff_2, column );
+            /** Loop over all Jacobians. */
+            *chunkDerivative -= diff_2 * jacobian;
           }
-        }
-      } // end if distance != 0
+          else
+          {
+            /** Only pick the nonzero Jacobians. */
+            for( unsigned int j = 0; j < nzji.size(); ++j )
+            {
+              const unsigned int  index = nzji[ j ];
+              DerivativeValueType sum   = NumericTraits< DerivativeValueType >::ZeroValue();
+              for( unsigned int d = 0; d < diff_2.size(); ++d )
+              {
+                sum += diff_2[ d ] * jacobian[ d ][ j ];
+              }
+              ( *chunkDerivative )[ index ] -= sum;
+            }
+          }
+        } // end if distance != 0
 
-    } // end if sampleOk
+      } // end loop over the points of this chunk
 
-    ++pointItFixed;
-    ++pointItMoving;
+      /** Only update these variables at the end to prevent "false sharing". */
+      chunkMeasures[ chunk ]              = measure;
+      chunkNumberOfPointsCounted[ chunk ] = numberOfPointsCounted;
+    } );
 
-  } // end loop over all corresponding points
+  /** Sum the results of the chunks in a fixed order. */
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  this->m_NumberOfPointsCounted = 0;
+  for( ThreadIdType i = 0; i < numberOfChunks; ++i )
+  {
+    measure                       += chunkMeasures[ i ];
+    this->m_NumberOfPointsCounted += chunkNumberOfPointsCounted[ i ];
+  }
 
-  /** Check if enough samples were valid. */
-//   this->CheckNumberOfSamples(
-//     fixedPointSet->GetNumberOfPoints(), this->m_NumberOfPointsCounted );
+  if( derivative )
+  {
+    *derivative = this->m_ChunkDerivatives[ 0 ];
+    for( ThreadIdType i = 1; i < numberOfChunks; ++i )
+    {
+      *derivative += this->m_ChunkDerivatives[ i ];
+    }
+  }
 
   /** Copy the measure to value. */
   value = measure;
   if( this->m_NumberOfPointsCounted > 0 )
   {
-    derivative /= this->m_NumberOfPointsCounted;
-    value       = measure / this->m_NumberOfPointsCounted;
+    if( derivative )
+    {
+      *derivative /= this->m_NumberOfPointsCounted;
+    }
+    value = measure / this->m_NumberOfPointsCounted;
   }
 
-} // end GetValueAndDerivative()
+} // end ComputeValueAndDerivative()
 
 
 } // end namespace itk
@@ -33,6 +33,8 @@
 #include "itkImageRegionIterator.h"
 #include "itkMultiResolutionPyramidImageFilter.h"
 
+#include <vector>
+
 namespace itk
 {
 /**
@@ -63,6 +65,13 @@ namespace itk
  *  resolutions.
  *  - In the publication above, the grid spacing was set as [4, 4, 1].
  *
+ * Initialize() stores the pairs of neighboring penalty grid points of the
+ * same rigid region as a graph in compressed sparse row format, together
+ * with the B-spline weights of each point. GetValue() and
+ * GetValueAndDerivative() only visit this graph. Its rows are split in
+ * chunks, which are processed in parallel when multi-threading is enabled.
+ * The derivatives of the chunks are summed in a fixed order.
+ *
  * \author Jihun Kim, University of Michigan, Ann Arbor
  * \author Martha M. Matuszak, University of Michigan, Ann Arbor
  * \author Kazuhiro Saitou, University of Michigan, Ann Arbor
@@ -213,6 +222,16 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );                        // purposely not implemented
 
+  /** The minimum number of graph rows per chunk. */
+  static const SizeValueType MinimumRowChunkSize = 256;
+
+  /** Return the number of chunks in which the rows of the graph are split. */
+  unsigned int GetNumberOfRowChunks( void ) const;
+
+  /** Compute the value, and the derivative if it is not null. */
+  void ComputeValueAndDerivative( const ParametersType & parameters,
+    MeasureType & value, DerivativeType * derivative ) const;
+
   /** Member variables. */
   BSplineTransformPointer m_BSplineTransform;
 
@@ -225,6 +244,27 @@ private:
 
   unsigned int m_NumberOfRigidGrids;
 
+  /** The graph of the penalty grid points that have a neighbor of the same
+   * rigid region. Row i holds the neighbors of point i at the positions
+   * m_NeighborOffsets[ i ] to m_NeighborOffsets[ i + 1 ] - 1 of
+   * m_NeighborIndices, and their squared distances to point i.
+   */
+  std::vector< InputPointType > m_RigidPoints;
+  std::vector< double >         m_RigidPointWeights;
+  std::vector< SizeValueType >  m_NeighborOffsets;
+  std::vector< unsigned int >   m_NeighborIndices;
+  std::vector< double >         m_NeighborSquaredDistances;
+
+  /** The parameter indices and B-spline weights of the control points in the
+   * support of each point of the graph.
+   */
+  unsigned int                  m_NumberOfSupportPoints;
+  std::vector< SizeValueType >  m_SupportParameterIndices;
+  std::vector< double >         m_SupportWeights;
+
+  mutable std::vector< OutputPointType > m_TransformedRigidPoints;
+  mutable std::vector< DerivativeType >  m_ChunkDerivatives;
+
 };
 
 // end class DistancePreservingRigidityPenaltyTerm
@@ -23,6 +23,9 @@
 #include "itkZeroFluxNeumannBoundaryCondition.h"
 #include "itkImageRegionIterator.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace itk
 {
 
@@ -44,7 +47,8 @@ DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
   this->m_SampledSegmentedImage = 0;
 
   /** Number of the penalty grid points, which belong to rigid regions */
-  this->m_NumberOfRigidGrids = 0;
+  this->m_NumberOfRigidGrids    = 0;
+  this->m_NumberOfSupportPoints = 0;
 
   /** We don't use an image sampler for this advanced metric. */
   this->SetUseImageSampler( false );
@@ -120,154 +124,224 @@ DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
   this->m_PenaltyGridImage->SetDirection( sampledSegmentedImageDirection );
   this->m_PenaltyGridImage->Update();
 
-  /** compute number of knots in rigid regions */
+  /** Get the label of each penalty grid point, and count the points in the
+   * rigid regions.
+   */
   this->m_NumberOfRigidGrids = 0;
 
-  typedef itk::ImageRegionIterator< PenaltyGridImageType > PenaltyGridIteratorType;
-  PenaltyGridIteratorType ki( this->m_PenaltyGridImage, this->m_PenaltyGridImage->GetBufferedRegion() );
-
-  typename PenaltyGridImageType::IndexType penaltyGridIndex;
-  typename PenaltyGridImageType::PointType penaltyGridPoint;
-
-  //typedef itk::LinearInterpolateImageFunction< SegmentedImageType, double > SegmentedImageInterpolatorType;
   typedef itk::NearestNeighborInterpolateImageFunction< SegmentedImageType, double > SegmentedImageInterpolatorType;
   typename SegmentedImageInterpolatorType::Pointer segmentedImageInterpolator = SegmentedImageInterpolatorType::New();
 
   segmentedImageInterpolator->SetInputImage( this->m_SampledSegmentedImage );
 
-  unsigned int PixelValue;
+  const PenaltyGridImageRegionType penaltyGridImageRegion = this->m_PenaltyGridImage->GetBufferedRegion();
+  const SizeValueType              numberOfGridPoints     = penaltyGridImageRegion.GetNumberOfPixels();
 
-  ki.GoToBegin();
+  typedef itk::ImageRegionConstIteratorWithIndex< PenaltyGridImageType > PenaltyGridIteratorType;
+  PenaltyGridIteratorType pgi( this->m_PenaltyGridImage, penaltyGridImageRegion );
 
-  while( !ki.IsAtEnd() )
-  {
-    penaltyGridIndex = ki.GetIndex();
+  typename PenaltyGridImageType::IndexType penaltyGridIndex;
+  typename PenaltyGridImageType::PointType penaltyGridPoint;
 
+  std::vector< unsigned int > labels( numberOfGridPoints, 0 );
+  for( pgi.GoToBegin(); !pgi.IsAtEnd(); ++pgi )
+  {
+    penaltyGridIndex = pgi.GetIndex();
     this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( penaltyGridIndex, penaltyGridPoint );
 
-    PixelValue =  static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( penaltyGridPoint ) );
-
-    if( PixelValue > 0 )
+    const unsigned int pixelValue = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( penaltyGridPoint ) );
+    labels[ this->m_PenaltyGridImage->ComputeOffset( penaltyGridIndex ) ] = pixelValue;
+    if( pixelValue > 0 )
     {
       this->m_NumberOfRigidGrids++;
     }
-    ++ki;
   }
-} // end Initialize()
-
-
-/**
- * *********************** GetValue *****************************
- */
-
-template< class TFixedImage, class TScalarType >
-typename DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >::MeasureType
-DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
-::GetValue( const ParametersType & parameters ) const
-{
-  /** Set output values to zero. */
-  this->m_RigidityPenaltyTermValue = NumericTraits< MeasureType >::Zero;
-
-  //this->SetTransformParameters( parameters );
-  this->m_BSplineTransform->SetParameters( parameters );
-
-  /** distance-preserving penalty computation */
-  MeasureType penaltyTerm       = 0.0;
-  MeasureType penaltyTermBuffer = 0.0;
-
-  MeasureType dx = 0.0;
-  MeasureType dX = 0.0;
-
-  typedef itk::ImageRegionConstIteratorWithIndex< PenaltyGridImageType > PenaltyGridIteratorType;
-  PenaltyGridImageRegionType penaltyGridImageRegion = this->m_PenaltyGridImage->GetBufferedRegion();
-
-  PenaltyGridIteratorType pgi( this->m_PenaltyGridImage, penaltyGridImageRegion );
-
-  typename PenaltyGridImageType::IndexType penaltyGridIndex, neighborPenaltyGridIndex;
-  typename PenaltyGridImageType::PointType penaltyGridPoint, neighborPenaltyGridPoint, xn, xf;
-
-  typedef itk::ConstNeighborhoodIterator< PenaltyGridImageType > NeighborhoodIteratorType;
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType ni( radius, this->m_PenaltyGridImage, penaltyGridImageRegion );
-  unsigned int             numberOfNeighborhood = ni.Size();
-
-  unsigned int numberOfRigidGridsNeighbor;
-
-  // interpolation of segmented image
-  typedef itk::NearestNeighborInterpolateImageFunction< SegmentedImageType, double > SegmentedImageInterpolatorType;
-  typename SegmentedImageInterpolatorType::Pointer segmentedImageInterpolator = SegmentedImageInterpolatorType::New();
-
-  segmentedImageInterpolator->SetInputImage( this->m_SampledSegmentedImage );
 
-  unsigned int pixelValue, pixelValueNeighbor;
+  /** The offsets of the neighbors in a neighborhood of radius 1. */
+  typedef typename PenaltyGridImageType::OffsetType PenaltyGridOffsetType;
+  std::vector< PenaltyGridOffsetType > neighborOffsets;
+  unsigned int                         numberOfNeighborhood = 1;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    numberOfNeighborhood *= 3;
+  }
+  for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
+  {
+    PenaltyGridOffsetType offset;
+    unsigned int          remainder = kk;
+    bool                  isCenter  = true;
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      offset[ d ] = static_cast< OffsetValueType >( remainder % 3 ) - 1;
+      remainder  /= 3;
+      isCenter    = isCenter && offset[ d ] == 0;
+    }
+    if( !isCenter )
+    {
+      neighborOffsets.push_back( offset );
+    }
+  }
 
-  /** Penalty term computation */
-  if( MovingImageDimension == 3 )
+  /** Return the label of the neighbor of a grid point, or 0 outside the grid. */
+  auto neighborLabel = [ this, &labels, &penaltyGridImageRegion ](
+    const typename PenaltyGridImageType::IndexType & neighborIndex )
+    {
+      if( !penaltyGridImageRegion.IsInside( neighborIndex ) )
+      {
+        return 0u;
+      }
+      return labels[ this->m_PenaltyGridImage->ComputeOffset( neighborIndex ) ];
+    };
+
+  /** A point of a rigid region is in the graph when at least one of its
+   * neighbors is in the same region. Its neighbors are then also in the
+   * graph, so that the graph is symmetric. Each point gets the weight of its
+   * terms in the penalty term, in which the number of neighbors includes the
+   * point itself.
+   */
+  this->m_RigidPoints.clear();
+  this->m_RigidPointWeights.clear();
+  std::vector< SizeValueType > rigidPointOffsets;
+  std::vector< int >           vertexOfGridPoint( numberOfGridPoints, -1 );
+  for( pgi.GoToBegin(); !pgi.IsAtEnd(); ++pgi )
   {
-    for( pgi.GoToBegin(), ni.GoToBegin(); !pgi.IsAtEnd(); ++pgi, ++ni )
+    penaltyGridIndex = pgi.GetIndex();
+    const SizeValueType gridOffset = this->m_PenaltyGridImage->ComputeOffset( penaltyGridIndex );
+    const unsigned int  pixelValue = labels[ gridOffset ];
+    if( pixelValue == 0 || pixelValue >= 6 )
     {
-      penaltyGridIndex = pgi.GetIndex();
+      continue;
+    }
+
+    unsigned int numberOfRigidGridsNeighbor = 1;
+    for( const PenaltyGridOffsetType & offset : neighborOffsets )
+    {
+      if( neighborLabel( penaltyGridIndex + offset ) == pixelValue )
+      {
+        numberOfRigidGridsNeighbor++;
+      }
+    }
 
+    if( numberOfRigidGridsNeighbor > 1 )
+    {
+      vertexOfGridPoint[ gridOffset ] = static_cast< int >( this->m_RigidPoints.size() );
       this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( penaltyGridIndex, penaltyGridPoint );
+      this->m_RigidPoints.push_back( penaltyGridPoint );
+      this->m_RigidPointWeights.push_back(
+        1.0 / numberOfRigidGridsNeighbor / this->m_NumberOfRigidGrids );
+      rigidPointOffsets.push_back( gridOffset );
+    }
+  }
 
-      ni.SetLocation( penaltyGridIndex );
+  /** Fill the rows of the graph. */
+  const SizeValueType numberOfRigidPoints = this->m_RigidPoints.size();
+  this->m_NeighborOffsets.assign( 1, 0 );
+  this->m_NeighborIndices.clear();
+  this->m_NeighborSquaredDistances.clear();
+  for( SizeValueType i = 0; i < numberOfRigidPoints; ++i )
+  {
+    penaltyGridIndex = this->m_PenaltyGridImage->ComputeIndex( rigidPointOffsets[ i ] );
+    const unsigned int pixelValue = labels[ rigidPointOffsets[ i ] ];
+    for( const PenaltyGridOffsetType & offset : neighborOffsets )
+    {
+      const typename PenaltyGridImageType::IndexType neighborIndex = penaltyGridIndex + offset;
+      if( neighborLabel( neighborIndex ) == pixelValue )
+      {
+        const unsigned int j = static_cast< unsigned int >(
+          vertexOfGridPoint[ this->m_PenaltyGridImage->ComputeOffset( neighborIndex ) ] );
+        this->m_NeighborIndices.push_back( j );
+        this->m_NeighborSquaredDistances.push_back(
+          this->m_RigidPoints[ i ].SquaredEuclideanDistanceTo( this->m_RigidPoints[ j ] ) );
+      }
+    }
+    this->m_NeighborOffsets.push_back( this->m_NeighborIndices.size() );
+  }
 
-      pixelValue = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( penaltyGridPoint ) );
+  /** Store the B-spline weights of the control points in the support of each
+   * point of the graph. Control points outside the grid get weight 0.
+   */
+  typedef itk::BSplineKernelFunction< 3 > BSplineKernelFunctionType;
+  BSplineKernelFunctionType::Pointer bSplineKernel = BSplineKernelFunctionType::New();
 
-      if( pixelValue > 0 && pixelValue < 6 )
-      {
-        numberOfRigidGridsNeighbor = 0;
+  typedef itk::ContinuousIndex< double, ImageDimension > ContinuousIndexType;
+  const BSplineKnotImageRegionType bSplineKnotImageRegion = this->m_BSplineKnotImage->GetBufferedRegion();
 
-        for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
-        {
-          neighborPenaltyGridIndex = ni.GetIndex( kk );
+  this->m_NumberOfSupportPoints = 1;
+  for( unsigned int d = 0; d < ImageDimension; ++d )
+  {
+    this->m_NumberOfSupportPoints *= 4;
+  }
+  this->m_SupportParameterIndices.assign( numberOfRigidPoints * this->m_NumberOfSupportPoints, 0 );
+  this->m_SupportWeights.assign( numberOfRigidPoints * this->m_NumberOfSupportPoints, 0.0 );
 
-          this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( neighborPenaltyGridIndex, neighborPenaltyGridPoint );
+  for( SizeValueType i = 0; i < numberOfRigidPoints; ++i )
+  {
+    ContinuousIndexType tindex;
+    this->m_BSplineKnotImage->TransformPhysicalPointToContinuousIndex( this->m_RigidPoints[ i ], tindex );
 
-          pixelValueNeighbor = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( neighborPenaltyGridPoint ) );
+    typename BSplineKnotImageType::IndexType startIndex;
+    for( unsigned int d = 0; d < ImageDimension; ++d )
+    {
+      startIndex[ d ] = static_cast< IndexValueType >( std::floor( tindex[ d ] ) ) - 1;
+    }
 
-          if( pixelValue == pixelValueNeighbor )
-          {
-            numberOfRigidGridsNeighbor++;
-          }
-        }
+    for( unsigned int k = 0; k < this->m_NumberOfSupportPoints; ++k )
+    {
+      typename BSplineKnotImageType::IndexType supportIndex;
+      unsigned int                             remainder = k;
+      double                                   weight    = 1.0;
+      for( unsigned int d = 0; d < ImageDimension; ++d )
+      {
+        supportIndex[ d ] = startIndex[ d ] + static_cast< IndexValueType >( remainder % 4 );
+        remainder        /= 4;
+        weight           *= bSplineKernel->Evaluate( tindex[ d ] - supportIndex[ d ] );
+      }
+      if( bSplineKnotImageRegion.IsInside( supportIndex ) )
+      {
+        const SizeValueType position = i * this->m_NumberOfSupportPoints + k;
+        this->m_SupportParameterIndices[ position ] = this->m_BSplineKnotImage->ComputeOffset( supportIndex );
+        this->m_SupportWeights[ position ]          = weight;
+      }
+    }
+  }
 
-        if( numberOfRigidGridsNeighbor > 1 )
-        {
-          for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
-          {
-            neighborPenaltyGridIndex = ni.GetIndex( kk );
+} // end Initialize()
 
-            this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( neighborPenaltyGridIndex, neighborPenaltyGridPoint );
 
-            pixelValueNeighbor = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( neighborPenaltyGridPoint ) );
+/**
+ * *********************** GetNumberOfRowChunks *****************************
+ */
 
-            if( pixelValue == pixelValueNeighbor )
-            {
-              xn = this->m_Transform->TransformPoint( neighborPenaltyGridPoint );
-              xf = this->m_Transform->TransformPoint( penaltyGridPoint );
+template< class TFixedImage, class TScalarType >
+unsigned int
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::GetNumberOfRowChunks( void ) const
+{
+  if( !this->m_UseMultiThread )
+  {
+    return 1;
+  }
 
-              dX = ( neighborPenaltyGridPoint[ 0 ] - penaltyGridPoint[ 0 ] ) * ( neighborPenaltyGridPoint[ 0 ] - penaltyGridPoint[ 0 ] )
-                + ( neighborPenaltyGridPoint[ 1 ] - penaltyGridPoint[ 1 ] ) * ( neighborPenaltyGridPoint[ 1 ] - penaltyGridPoint[ 1 ] )
-                + ( neighborPenaltyGridPoint[ 2 ] - penaltyGridPoint[ 2 ] ) * ( neighborPenaltyGridPoint[ 2 ] - penaltyGridPoint[ 2 ] );
+  const SizeValueType maximumNumberOfChunks
+    = ( this->m_RigidPoints.size() + MinimumRowChunkSize - 1 ) / MinimumRowChunkSize;
+  return static_cast< unsigned int >( std::max< SizeValueType >( 1, std::min< SizeValueType >(
+    maximumNumberOfChunks, PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() ) ) );
 
-              dx = ( xn[ 0 ] - xf[ 0 ] ) * ( xn[ 0 ] - xf[ 0 ] )
-                + ( xn[ 1 ] - xf[ 1 ] ) * ( xn[ 1 ] - xf[ 1 ] )
-                + ( xn[ 2 ] - xf[ 2 ] ) * ( xn[ 2 ] - xf[ 2 ] );
+} // end GetNumberOfRowChunks()
 
-              penaltyTermBuffer = ( dx - dX ) * ( dx - dX );
 
-              penaltyTerm += penaltyTermBuffer / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
-            }
-          } // end for
-        } // end if
-      }     // end if
-    }       // end for
-  }         // end if ( dimension = 3 )
+/**
+ * *********************** GetValue *****************************
+ */
 
-  /** Return the rigidity penalty term value. */
-  return penaltyTerm;
+template< class TFixedImage, class TScalarType >
+typename DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >::MeasureType
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::GetValue( const ParametersType & parameters ) const
+{
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->ComputeValueAndDerivative( parameters, value, nullptr );
+  return value;
 
 } // end GetValue()
 
@@ -297,198 +371,141 @@ DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
 ::GetValueAndDerivative( const ParametersType & parameters,
   MeasureType & value, DerivativeType & derivative ) const
 {
-  /** Set output values to zero. */
-  value                            = NumericTraits< MeasureType >::Zero;
-  this->m_RigidityPenaltyTermValue = NumericTraits< MeasureType >::Zero;
-
-  /** Set output values to zero. */
-  derivative = DerivativeType( this->GetNumberOfParameters() );
-  derivative.Fill( NumericTraits< MeasureType >::ZeroValue() );
-
-  this->m_BSplineTransform->SetParameters( parameters );
-
-  /** Distance-preserving penalty */
-  MeasureType penaltyTermBuffer   = 0.0;
-  MeasureType derivativeTermTemp1 = 0.0, derivativeTermTemp2 = 0.0, derivativeTermTemp3 = 0.0;
-
-  unsigned int par1, par2;
-
-  MeasureType dX = 0.0;
-  MeasureType dx = 0.0;
-
-  typename PenaltyGridImageType::IndexType penaltyGridIndex, neighborPenaltyGridIndex;
-  typename PenaltyGridImageType::PointType penaltyGridPoint, neighborPenaltyGridPoint, xn, xf;
-
-  typedef itk::BSplineKernelFunction< 3 > BSplineKernelFunctionType;
-  BSplineKernelFunctionType::Pointer bSplineKernel = BSplineKernelFunctionType::New();
-
-  typedef itk::BSplineInterpolationWeightFunction< double, ImageDimension, 3 > WeightsFunctionType;
-  typedef typename WeightsFunctionType::ContinuousIndexType                    ContinuousIndexType;
-  typedef double                                                               ContinuousIndexValueType;
-
-  ContinuousIndexType      tindex;
-  ContinuousIndexValueType tx, ty, tz;
-
-  ContinuousIndexValueType m, n, p, neighbor_m, neighbor_n, neighbor_p;
-
-  typedef itk::ImageRegionConstIteratorWithIndex< PenaltyGridImageType > PenaltyGridIteratorType;
-  PenaltyGridImageRegionType penaltyGridImageRegion = this->m_PenaltyGridImage->GetBufferedRegion();
-  PenaltyGridIteratorType    pgi( this->m_PenaltyGridImage, penaltyGridImageRegion );
+  this->ComputeValueAndDerivative( parameters, value, &derivative );
 
-  // neighborhood iterator
-  typedef itk::ConstNeighborhoodIterator< PenaltyGridImageType > NeighborhoodIteratorType;
-  typename NeighborhoodIteratorType::RadiusType radius;
-  radius.Fill( 1 );
-  NeighborhoodIteratorType ni( radius, this->m_PenaltyGridImage, penaltyGridImageRegion );
-  unsigned int             numberOfNeighborhood = ni.Size();
-
-  ContinuousIndexType      tindex_neighbor, ntindex_start, ntindex_neighbor_start;
-  ContinuousIndexValueType tx_neighbor, ty_neighbor, tz_neighbor;
-
-  typename BSplineKnotImageType::SizeType bSplineKnotImageSize = this->m_BSplineKnotImage->GetBufferedRegion().GetSize();
+} // end GetValueAndDerivative()
 
-  MeasureType du_dC, du_dC_neighbor;
 
-  unsigned int numberOfRigidGridsNeighbor;
+/**
+ * *********************** ComputeValueAndDerivative ****************
+ */
 
-  const unsigned int parametersDimension            = this->GetNumberOfParameters();
-  unsigned int       numberOfParametersPerDimension = parametersDimension / ImageDimension;
+template< class TFixedImage, class TScalarType >
+void
+DistancePreservingRigidityPenaltyTerm< TFixedImage, TScalarType >
+::ComputeValueAndDerivative( const ParametersType & parameters,
+  MeasureType & value, DerivativeType * derivative ) const
+{
+  /** Set output values to zero. */
+  value                            = NumericTraits< MeasureType >::Zero;
+  this->m_RigidityPenaltyTermValue = NumericTraits< MeasureType >::Zero;
 
-  // interpolation of segmented image
-  typedef itk::NearestNeighborInterpolateImageFunction< SegmentedImageType, double > SegmentedImageInterpolatorType;
-  typename SegmentedImageInterpolatorType::Pointer segmentedImageInterpolator = SegmentedImageInterpolatorType::New();
+  this->m_BSplineTransform->SetParameters( parameters );
 
-  segmentedImageInterpolator->SetInputImage( this->m_SampledSegmentedImage );
+  const SizeValueType numberOfRigidPoints = this->m_RigidPoints.size();
+  const unsigned int  numberOfChunks      = this->GetNumberOfRowChunks();
+  const SizeValueType chunkSize           = ( numberOfRigidPoints + numberOfChunks - 1 ) / numberOfChunks;
+  const unsigned int  parametersDimension = this->GetNumberOfParameters();
+  const unsigned int  numberOfParametersPerDimension = parametersDimension / ImageDimension;
 
-  unsigned int pixelValue, pixelValueNeighbor;
+  /** Transform each point of the graph once. */
+  this->m_TransformedRigidPoints.resize( numberOfRigidPoints );
+  this->ProcessSlices( numberOfChunks, true,
+    [ this, numberOfRigidPoints, chunkSize ]( const unsigned int chunk )
+    {
+      const SizeValueType begin = std::min( chunk * chunkSize, numberOfRigidPoints );
+      const SizeValueType end   = std::min( begin + chunkSize, numberOfRigidPoints );
+      for( SizeValueType i = begin; i < end; ++i )
+      {
+        this->m_TransformedRigidPoints[ i ] = this->m_Transform->TransformPoint( this->m_RigidPoints[ i ] );
+      }
+    } );
 
-  if( MovingImageDimension == 3 )
+  if( derivative )
   {
-    for( pgi.GoToBegin(), ni.GoToBegin(); !pgi.IsAtEnd(); ++pgi, ++ni )
+    this->m_ChunkDerivatives.resize( numberOfChunks );
+    for( unsigned int chunk = 0; chunk < numberOfChunks; ++chunk )
     {
-      penaltyGridIndex = pgi.GetIndex();
-
-      this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( penaltyGridIndex, penaltyGridPoint );
+      this->m_ChunkDerivatives[ chunk ].SetSize( parametersDimension );
+    }
+  }
 
-      pixelValue = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( penaltyGridPoint ) );
+  /** Each row gives the terms of a point, and the derivative of all terms
+   * with respect to the position of that point. With e_ij = dx_ij - dX_ij,
+   * the squared distances after and before the transformation, and w_i the
+   * weight of point i, this derivative is
+   *   -4 sum_j ( w_i + w_j ) e_ij ( x_j - x_i ),
+   * because the graph contains both the term of i and that of j.
+   */
+  std::vector< MeasureType > chunkValues( numberOfChunks, NumericTraits< MeasureType >::Zero );
+  this->ProcessSlices( numberOfChunks, true,
+    [ this, derivative, numberOfRigidPoints, chunkSize, numberOfParametersPerDimension, &chunkValues ](
+    const unsigned int chunk )
+    {
+      const SizeValueType begin = std::min( chunk * chunkSize, numberOfRigidPoints );
+      const SizeValueType end   = std::min( begin + chunkSize, numberOfRigidPoints );
 
-      ni.SetLocation( penaltyGridIndex );
+      DerivativeType * chunkDerivative = derivative ? &this->m_ChunkDerivatives[ chunk ] : nullptr;
+      if( chunkDerivative )
+      {
+        chunkDerivative->Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+      }
 
-      /** Penalty term calculation */
-      if( pixelValue > 0 && pixelValue < 6 )
+      MeasureType chunkValue = NumericTraits< MeasureType >::Zero;
+      for( SizeValueType i = begin; i < end; ++i )
       {
-        numberOfRigidGridsNeighbor = 0;
+        const OutputPointType & xi = this->m_TransformedRigidPoints[ i ];
+        const double            wi = this->m_RigidPointWeights[ i ];
+
+        double gradient[ ImageDimension ];
+        std::fill( gradient, gradient + ImageDimension, 0.0 );
 
-        for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
+        for( SizeValueType e = this->m_NeighborOffsets[ i ]; e < this->m_NeighborOffsets[ i + 1 ]; ++e )
         {
-          neighborPenaltyGridIndex = ni.GetIndex( kk );
+          const unsigned int      j  = this->m_NeighborIndices[ e ];
+          const OutputPointType & xj = this->m_TransformedRigidPoints[ j ];
 
-          this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( neighborPenaltyGridIndex, neighborPenaltyGridPoint );
+          double diff[ ImageDimension ];
+          double dx = 0.0;
+          for( unsigned int d = 0; d < ImageDimension; ++d )
+          {
+            diff[ d ] = xj[ d ] - xi[ d ];
+            dx       += diff[ d ] * diff[ d ];
+          }
+          const double error = dx - this->m_NeighborSquaredDistances[ e ];
 
-          pixelValueNeighbor = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( neighborPenaltyGridPoint ) );
+          chunkValue += wi * error * error;
 
-          if( pixelValue == pixelValueNeighbor )
+          const double factor = -4.0 * ( wi + this->m_RigidPointWeights[ j ] ) * error;
+          for( unsigned int d = 0; d < ImageDimension; ++d )
           {
-            numberOfRigidGridsNeighbor++;
+            gradient[ d ] += factor * diff[ d ];
           }
         }
 
-        if( numberOfRigidGridsNeighbor > 1 )
+        /** Distribute the derivative over the control points in the support. */
+        if( chunkDerivative )
         {
-          for( unsigned int kk = 0; kk < numberOfNeighborhood; ++kk )
+          const SizeValueType supportBegin = i * this->m_NumberOfSupportPoints;
+          for( unsigned int k = 0; k < this->m_NumberOfSupportPoints; ++k )
           {
-            neighborPenaltyGridIndex = ni.GetIndex( kk );
-
-            this->m_PenaltyGridImage->TransformIndexToPhysicalPoint( neighborPenaltyGridIndex, neighborPenaltyGridPoint );
-
-            pixelValueNeighbor = static_cast< unsigned int >( segmentedImageInterpolator->Evaluate( neighborPenaltyGridPoint ) );
-
-            if( pixelValue == pixelValueNeighbor )
+            const SizeValueType par    = this->m_SupportParameterIndices[ supportBegin + k ];
+            const double        weight = this->m_SupportWeights[ supportBegin + k ];
+            for( unsigned int d = 0; d < ImageDimension; ++d )
             {
-              xn = this->m_Transform->TransformPoint( neighborPenaltyGridPoint );
-              xf = this->m_Transform->TransformPoint( penaltyGridPoint );
-
-              dX = ( neighborPenaltyGridPoint[ 0 ] - penaltyGridPoint[ 0 ] ) * ( neighborPenaltyGridPoint[ 0 ] - penaltyGridPoint[ 0 ] )
-                + ( neighborPenaltyGridPoint[ 1 ] - penaltyGridPoint[ 1 ] ) * ( neighborPenaltyGridPoint[ 1 ] - penaltyGridPoint[ 1 ] )
-                + ( neighborPenaltyGridPoint[ 2 ] - penaltyGridPoint[ 2 ] ) * ( neighborPenaltyGridPoint[ 2 ] - penaltyGridPoint[ 2 ] );
-
-              dx = ( xn[ 0 ] - xf[ 0 ] ) * ( xn[ 0 ] - xf[ 0 ] )
-                + ( xn[ 1 ] - xf[ 1 ] ) * ( xn[ 1 ] - xf[ 1 ] )
-                + ( xn[ 2 ] - xf[ 2 ] ) * ( xn[ 2 ] - xf[ 2 ] );
-
-              penaltyTermBuffer = ( dx - dX ) * ( dx - dX );
-
-              value += penaltyTermBuffer / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
-
-              // find neighboring B-Spline control points
-              this->m_BSplineKnotImage->TransformPhysicalPointToContinuousIndex( penaltyGridPoint, tindex );
-              this->m_BSplineKnotImage->TransformPhysicalPointToContinuousIndex( neighborPenaltyGridPoint, tindex_neighbor );
-
-              tx = tindex[ 0 ];
-              ty = tindex[ 1 ];
-              tz = tindex[ 2 ];
-
-              tx_neighbor = tindex_neighbor[ 0 ];
-              ty_neighbor = tindex_neighbor[ 1 ];
-              tz_neighbor = tindex_neighbor[ 2 ];
-
-              for( unsigned dd = 0; dd < ImageDimension; dd++ )
-              {
-                ntindex_start[ dd ]          = static_cast< ContinuousIndexValueType >( floor( tindex[ dd ] ) ) - 1.0;
-                ntindex_neighbor_start[ dd ] = static_cast< ContinuousIndexValueType >( floor( tindex_neighbor[ dd ] ) ) - 1.0;
-              }
-
-              derivativeTermTemp1 = 4 * ( dx - dX ) * ( xn[ 0 ] - xf[ 0 ] ) / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
-              derivativeTermTemp2 = 4 * ( dx - dX ) * ( xn[ 1 ] - xf[ 1 ] ) / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
-              derivativeTermTemp3 = 4 * ( dx - dX ) * ( xn[ 2 ] - xf[ 2 ] ) / numberOfRigidGridsNeighbor / ( this->m_NumberOfRigidGrids );
-
-              for( unsigned int kk = 0; kk < 4; ++kk )
-              {
-                p          = ntindex_start[ 2 ] + kk;
-                neighbor_p = ntindex_neighbor_start[ 2 ] + kk;
-
-                for( unsigned int jj = 0; jj < 4; ++jj )
-                {
-                  n          = ntindex_start[ 1 ] + jj;
-                  neighbor_n = ntindex_neighbor_start[ 1 ] + jj;
-
-                  for( unsigned int ii = 0; ii < 4; ++ii )
-                  {
-                    m          = ntindex_start[ 0 ] + ii;
-                    neighbor_m = ntindex_neighbor_start[ 0 ] + ii;
-
-                    // neighborhood of (i',j',k')
-                    du_dC_neighbor = ( bSplineKernel->Evaluate( tx_neighbor - neighbor_m ) ) * ( bSplineKernel->Evaluate( ty_neighbor - neighbor_n ) )
-                      * ( bSplineKernel->Evaluate( tz_neighbor - neighbor_p ) );
-
-                    par1 = static_cast< unsigned int >( neighbor_m ) + bSplineKnotImageSize[ 0 ] * static_cast< unsigned int >( neighbor_n )
-                      + bSplineKnotImageSize[ 0 ] * bSplineKnotImageSize[ 1 ] * static_cast< unsigned int >( neighbor_p );
-
-                    derivative[ par1 ]                                      += derivativeTermTemp1 * du_dC_neighbor;
-                    derivative[ par1 + numberOfParametersPerDimension ]     += derivativeTermTemp2 * du_dC_neighbor;
-                    derivative[ par1 + 2 * numberOfParametersPerDimension ] += derivativeTermTemp3 * du_dC_neighbor;
-
-                    // neighborhood of (i,j,k)
-                    du_dC = ( bSplineKernel->Evaluate( tx - m ) ) * ( bSplineKernel->Evaluate( ty - n ) )
-                      * ( bSplineKernel->Evaluate( tz - p ) );
-
-                    par2 = static_cast< unsigned int >( m ) + bSplineKnotImageSize[ 0 ] * static_cast< unsigned int >( n )
-                      + bSplineKnotImageSize[ 0 ] * bSplineKnotImageSize[ 1 ] * static_cast< unsigned int >( p );
-
-                    derivative[ par2 ]                                      -= derivativeTermTemp1 * du_dC;
-                    derivative[ par2 + numberOfParametersPerDimension ]     -= derivativeTermTemp2 * du_dC;
-                    derivative[ par2 + 2 * numberOfParametersPerDimension ] -= derivativeTermTemp3 * du_dC;
-                  }
-                }
-              }
+              ( *chunkDerivative )[ par + d * numberOfParametersPerDimension ] += gradient[ d ] * weight;
             }
-          } // end for
-        } // end if
+          }
+        }
       }
-    } // end for
-  } // end if ( dimension = 3 )
+      chunkValues[ chunk ] = chunkValue;
+    } );
 
-} // end GetValueAndDerivative()
+  /** Sum the chunks in a fixed order. */
+  for( unsigned int chunk = 0; chunk < numberOfChunks; ++chunk )
+  {
+    value += chunkValues[ chunk ];
+  }
+  if( derivative )
+  {
+    *derivative = this->m_ChunkDerivatives[ 0 ];
+    for( unsigned int chunk = 1; chunk < numberOfChunks; ++chunk )
+    {
+      *derivative += this->m_ChunkDerivatives[ chunk ];
+    }
+  }
+
+} // end ComputeValueAndDerivative()
 
 
 /**
@@ -56,7 +56,12 @@ enum ANNerr {ANNwarn = 0, ANNabort = 1};
 //----------------------------------------------------------------------
 
 extern int		ANNmaxPtsVisited;	// maximum number of pts visited
-extern int		ANNptsVisited;		// number of pts visited in search
+// elastix: the search globals of ANN, such as the query point and the
+// sets of closest points, are thread_local. Each thread then has its own
+// search state, so that multiple threads can search the same tree, as
+// BinaryTreeSearchBase::BatchSearch() does. The other search globals refer
+// to this note.
+extern thread_local int		ANNptsVisited;		// number of pts visited in search
 
 //----------------------------------------------------------------------
 //	Global function declarations
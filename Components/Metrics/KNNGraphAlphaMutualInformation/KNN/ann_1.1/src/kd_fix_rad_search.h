@@ -39,6 +39,7 @@
 //		procedures.
 //----------------------------------------------------------------------
 
-extern ANNpoint			ANNkdFRQ;			// query point (static copy)
+// elastix: thread_local search state, see ANNx.h.
+extern thread_local ANNpoint			ANNkdFRQ;			// query point (static copy)
 
 #endif
@@ -72,13 +72,14 @@
 //		These are given below.
 //----------------------------------------------------------------------
 
-double			ANNprEps;				// the error bound
-int				ANNprDim;				// dimension of space
-ANNpoint		ANNprQ;					// query point
-double			ANNprMaxErr;			// max tolerable squared error
-ANNpointArray	ANNprPts;				// the points
-ANNpr_queue		*ANNprBoxPQ;			// priority queue for boxes
-ANNmin_k		*ANNprPointMK;			// set of k closest points
+// elastix: thread_local search state, see ANNx.h.
+thread_local double			ANNprEps;				// the error bound
+thread_local int				ANNprDim;				// dimension of space
+thread_local ANNpoint		ANNprQ;					// query point
+thread_local double			ANNprMaxErr;			// max tolerable squared error
+thread_local ANNpointArray	ANNprPts;				// the points
+thread_local ANNpr_queue		*ANNprBoxPQ;			// priority queue for boxes
+thread_local ANNmin_k		*ANNprPointMK;			// set of k closest points
 
 //----------------------------------------------------------------------
 //	annkPriSearch - priority search for k nearest neighbors
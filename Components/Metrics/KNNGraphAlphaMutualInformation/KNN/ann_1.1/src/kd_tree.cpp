@@ -33,6 +33,8 @@
 #include "kd_util.h"					// kd-tree utilities
 #include <ANN/ANNperf.h>				// performance evaluation
 
+#include <future>						// elastix: parallel construction
+
 //----------------------------------------------------------------------
 //	Global data
 //
@@ -357,6 +359,72 @@ ANNkd_ptr rkd_tree(				// recursive construction of kd-tree
 	}
 } 
 
+//----------------------------------------------------------------------
+//	rkd_tree_parallel - parallel construction of a kd-tree (elastix)
+//
+//		As rkd_tree, but the two subtrees of a node are built
+//		concurrently, by at most maxThreads threads in total. The
+//		subtrees cover disjoint parts of pidx and get their own copy
+//		of the bounding box, so they do not share any data that is
+//		modified. The resulting tree is identical to the one of
+//		rkd_tree. Small subtrees are built by rkd_tree, because the
+//		start of a thread would cost more than it saves.
+//----------------------------------------------------------------------
+
+int ANNmaxBuildThreads = 1;				// max. threads to build a tree
+
+const int ANN_MIN_PARALLEL_BUILD_PTS = 8192;	// min. pts to build in parallel
+
+void annMaxBuildThreads(int maxThreads)	// set max. threads to build a tree
+{
+	ANNmaxBuildThreads = (maxThreads < 1 ? 1 : maxThreads);
+}
+
+static ANNkd_ptr rkd_tree_parallel(		// parallel construction of kd-tree
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in subtree
+	int					n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for current node
+	ANNkd_splitter		splitter,		// splitting routine
+	int					maxThreads)		// max. threads for this subtree
+{
+	if (maxThreads <= 1 || n <= bsp || n < ANN_MIN_PARALLEL_BUILD_PTS) {
+		return rkd_tree(pa, pidx, n, dim, bsp, bnd_box, splitter);
+	}
+
+	int cd;								// cutting dimension
+	ANNcoord cv;						// cutting value
+	int n_lo;							// number on low side of cut
+
+										// invoke splitting procedure
+	(*splitter)(pa, pidx, bnd_box, n, dim, cd, cv, n_lo);
+
+	ANNcoord lv = bnd_box.lo[cd];		// bounds for cutting dimension
+	ANNcoord hv = bnd_box.hi[cd];
+
+	ANNorthRect lo_box(dim, bnd_box);	// bounds for left subtree
+	lo_box.hi[cd] = cv;
+	ANNorthRect hi_box(dim, bnd_box);	// bounds for right subtree
+	hi_box.lo[cd] = cv;
+
+	const int lo_threads = maxThreads / 2;
+	const int hi_threads = maxThreads - lo_threads;
+
+										// build left subtree in new thread
+	std::future<ANNkd_ptr> lo = std::async(std::launch::async,
+		[=, &lo_box]() {
+			return rkd_tree_parallel(pa, pidx, n_lo, dim, bsp,
+				lo_box, splitter, lo_threads);
+		});
+										// build right subtree in this thread
+	ANNkd_ptr hi = rkd_tree_parallel(pa, pidx + n_lo, n - n_lo, dim, bsp,
+		hi_box, splitter, hi_threads);
+
+	return new ANNkd_split(cd, cv, lv, hv, lo.get(), hi);
+}
+
 //----------------------------------------------------------------------
 // kd-tree constructor
 //		This is the main constructor for kd-trees given a set of points.
@@ -384,20 +452,25 @@ ANNkd_tree::ANNkd_tree(					// construct from point array
 
 	switch (split) {					// build by rule
 	case ANN_KD_STD:					// standard kd-splitting rule
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, kd_split);
+		root = rkd_tree_parallel(pa, pidx, n, dd, bs, bnd_box, kd_split,
+			ANNmaxBuildThreads);
 		break;
 	case ANN_KD_MIDPT:					// midpoint split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, midpt_split);
+		root = rkd_tree_parallel(pa, pidx, n, dd, bs, bnd_box, midpt_split,
+			ANNmaxBuildThreads);
 		break;
 	case ANN_KD_FAIR:					// fair split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, fair_split);
+		root = rkd_tree_parallel(pa, pidx, n, dd, bs, bnd_box, fair_split,
+			ANNmaxBuildThreads);
 		break;
 	case ANN_KD_SUGGEST:				// best (in our opinion)
 	case ANN_KD_SL_MIDPT:				// sliding midpoint split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, sl_midpt_split);
+		root = rkd_tree_parallel(pa, pidx, n, dd, bs, bnd_box, sl_midpt_split,
+			ANNmaxBuildThreads);
 		break;
 	case ANN_KD_SL_FAIR:				// sliding fair split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, sl_fair_split);
+		root = rkd_tree_parallel(pa, pidx, n, dd, bs, bnd_box, sl_fair_split,
+			ANNmaxBuildThreads);
 		break;
 	default:
 		annError("Illegal splitting method", ANNabort);
@@ -33,10 +33,13 @@ unsigned int ANNBinaryTreeCreator::m_NumberOfANNBinaryTrees = 0;
 ANNBinaryTreeCreator::ANNkDTreeType *
 ANNBinaryTreeCreator::CreateANNkDTree(
   ANNPointArrayType pa, int n, int d, int bs,
-  ANNSplitRuleType split )
+  ANNSplitRuleType split, int maxThreads )
 {
   IncreaseReferenceCount();
-  return new ANNkd_tree( pa, n, d, bs, split );
+  annMaxBuildThreads( maxThreads );
+  ANNkDTreeType * tree = new ANNkd_tree( pa, n, d, bs, split );
+  annMaxBuildThreads( 1 );
+  return tree;
 } // end CreateANNkDTree
 
 
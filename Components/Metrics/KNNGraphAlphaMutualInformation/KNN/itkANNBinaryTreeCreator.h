@@ -67,9 +67,9 @@ public:
    * this class with static creating functions.
    */
 
-  /** Static function to create an ANN kDTree. */
+  /** Static function to create an ANN kDTree, with at most maxThreads threads. */
   static ANNkDTreeType * CreateANNkDTree( ANNPointArrayType pa, int n, int d, int bs = 1,
-    ANNSplitRuleType split = ANN_KD_SUGGEST );
+    ANNSplitRuleType split = ANN_KD_SUGGEST, int maxThreads = 1 );
 
   /** Static function to create an ANN bdTree. */
   static ANNbdTreeType * CreateANNbdTree( ANNPointArrayType pa, int n, int d, int bs = 1,
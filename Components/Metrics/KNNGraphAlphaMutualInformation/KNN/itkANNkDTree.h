@@ -72,6 +72,13 @@ public:
 
   std::string GetSplittingRule( void );
 
+  /** Set and get the maximum number of threads that generate the tree. The
+   * default, 0, means the maximum number of threads of the PersistentThreadPool.
+   * The generated tree does not depend on the number of threads.
+   */
+  itkSetMacro( MaximumNumberOfThreads, ThreadIdType );
+  itkGetConstMacro( MaximumNumberOfThreads, ThreadIdType );
+
   /** Set the maximum number of points that are to be visited. */
   //void SetMaximumNumberOfPointsToVisit( unsigned int num )
   //{
@@ -103,6 +110,7 @@ protected:
   ANNkDTreeType *   m_ANNTree;
   SplittingRuleType m_SplittingRule;
   BucketSizeType    m_BucketSize;
+  ThreadIdType      m_MaximumNumberOfThreads;
 
 private:
 
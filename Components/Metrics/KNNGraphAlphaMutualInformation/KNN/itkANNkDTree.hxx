@@ -20,6 +20,7 @@
 
 #include "itkANNkDTree.h"
 #include "itkANNBinaryTreeCreator.h"
+#include "itkPersistentThreadPool.h"
 
 namespace itk
 {
@@ -36,6 +37,8 @@ ANNkDTree< TListSample >
   this->m_SplittingRule = ANN_KD_SL_MIDPT;
   this->m_BucketSize    = 1;
 
+  this->m_MaximumNumberOfThreads = 0;
+
 } // end Constructor()
 
 
@@ -134,10 +137,16 @@ ANNkDTree< TListSample >
   int nop = static_cast< int >( this->GetActualNumberOfDataPoints() );
   int bcs = static_cast< int >( this->m_BucketSize );
 
+  int maxThreads = static_cast< int >( this->m_MaximumNumberOfThreads );
+  if( maxThreads == 0 )
+  {
+    maxThreads = static_cast< int >( PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() );
+  }
+
   ANNBinaryTreeCreator::DeleteANNkDTree( this->m_ANNTree );
 
   this->m_ANNTree = ANNBinaryTreeCreator::CreateANNkDTree(
-    this->GetSample()->GetInternalContainer(), nop, dim, bcs, this->m_SplittingRule );
+    this->GetSample()->GetInternalContainer(), nop, dim, bcs, this->m_SplittingRule, maxThreads );
 
 } // end GenerateTree()
 
@@ -156,6 +165,7 @@ ANNkDTree< TListSample >
   os << indent << "ANNTree: " << this->m_ANNTree << std::endl;
   os << indent << "SplittingRule: " << this->m_SplittingRule << std::endl;
   os << indent << "BucketSize: " << this->m_BucketSize << std::endl;
+  os << indent << "MaximumNumberOfThreads: " << this->m_MaximumNumberOfThreads << std::endl;
 
 } // end PrintSelf()
 
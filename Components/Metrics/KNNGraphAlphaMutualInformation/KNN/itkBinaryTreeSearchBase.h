@@ -23,6 +23,8 @@
 
 #include "itkBinaryTreeBase.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -58,6 +60,10 @@ public:
   typedef Array< int >    IndexArrayType;
   typedef Array< double > DistanceArrayType;
 
+  /** Typedef's for the results of a batch of query points. */
+  typedef std::vector< IndexArrayType >    IndexArrayContainerType;
+  typedef std::vector< DistanceArrayType > DistanceArrayContainerType;
+
   /** Set and get the binary tree. */
   virtual void SetBinaryTree( BinaryTreeType * tree );
 
@@ -67,10 +73,24 @@ public:
   itkSetMacro( KNearestNeighbors, unsigned int );
   itkGetConstMacro( KNearestNeighbors, unsigned int );
 
-  /** Search the nearest neighbours of a query point qp. */
+  /** Search the nearest neighbours of a query point qp. Implementations
+   * should not modify the searcher or the tree, so that BatchSearch() can
+   * call this function from multiple threads.
+   */
   virtual void Search( const MeasurementVectorType & qp, IndexArrayType & ind,
     DistanceArrayType & dists ) = 0;
 
+  /** Search the nearest neighbours of the first numberOfQueryPoints
+   * measurement vectors of querySample. The results of query point i are
+   * stored in indices[ i ] and dists[ i ]. If multiThreaded is true, the query
+   * points are divided over the threads of the PersistentThreadPool. The
+   * results do not depend on the number of threads.
+   */
+  virtual void BatchSearch( const ListSampleType * querySample,
+    const SizeValueType numberOfQueryPoints,
+    IndexArrayContainerType & indices, DistanceArrayContainerType & dists,
+    const bool multiThreaded );
+
 protected:
 
   BinaryTreeSearchBase();
@@ -83,6 +103,20 @@ protected:
 
 private:
 
+  /** The data passed to the threads by BatchSearch(). */
+  struct BatchSearchThreaderParameterType
+  {
+    Self *                       m_Searcher;
+    const ListSampleType *       m_QuerySample;
+    SizeValueType                m_NumberOfQueryPoints;
+    ThreadIdType                 m_NumberOfWorkUnits;
+    IndexArrayContainerType *    m_Indices;
+    DistanceArrayContainerType * m_Distances;
+  };
+
+  /** Search the neighbours of the query points of a work unit. */
+  static ITK_THREAD_RETURN_TYPE BatchSearchThreaderCallback( void * arg );
+
   BinaryTreeSearchBase( const Self & );   // purposely not implemented
   void operator=( const Self & );         // purposely not implemented
 
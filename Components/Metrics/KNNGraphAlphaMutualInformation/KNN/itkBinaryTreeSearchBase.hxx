@@ -19,6 +19,9 @@
 #define __itkBinaryTreeSearchBase_hxx
 
 #include "itkBinaryTreeSearchBase.h"
+#include "itkPersistentThreadPool.h"
+
+#include <algorithm>
 
 namespace itk
 {
@@ -78,6 +81,78 @@ const typename BinaryTreeSearchBase< TBinaryTree >::BinaryTreeType
   return this->m_BinaryTree.GetPointer();
 } // end GetBinaryTree
 
+
+/**
+ * ************************ BatchSearch *************************
+ */
+
+template< class TBinaryTree >
+void
+BinaryTreeSearchBase< TBinaryTree >
+::BatchSearch( const ListSampleType * querySample,
+  const SizeValueType numberOfQueryPoints,
+  IndexArrayContainerType & indices, DistanceArrayContainerType & dists,
+  const bool multiThreaded )
+{
+  indices.resize( numberOfQueryPoints );
+  dists.resize( numberOfQueryPoints );
+
+  BatchSearchThreaderParameterType temp;
+  temp.m_Searcher            = this;
+  temp.m_QuerySample         = querySample;
+  temp.m_NumberOfQueryPoints = numberOfQueryPoints;
+  temp.m_Indices             = &indices;
+  temp.m_Distances           = &dists;
+
+  /** The searches of the query points are independent and do not modify
+   * the tree, so the threads can share it. The ANN search state is local
+   * to each thread.
+   */
+  temp.m_NumberOfWorkUnits = 1;
+  if( multiThreaded )
+  {
+    temp.m_NumberOfWorkUnits = static_cast< ThreadIdType >( std::max< SizeValueType >( 1,
+      std::min< SizeValueType >( numberOfQueryPoints,
+      PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads() ) ) );
+  }
+
+  PersistentThreadPool::GetInstance()->SingleMethodExecute(
+    temp.m_NumberOfWorkUnits, BatchSearchThreaderCallback, &temp );
+
+} // end BatchSearch()
+
+
+/**
+ * ************************ BatchSearchThreaderCallback *************************
+ */
+
+template< class TBinaryTree >
+ITK_THREAD_RETURN_TYPE
+BinaryTreeSearchBase< TBinaryTree >
+::BatchSearchThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const BatchSearchThreaderParameterType * temp
+    = static_cast< BatchSearchThreaderParameterType * >( infoStruct->UserData );
+
+  /** Get the query points of this work unit. */
+  const SizeValueType workUnit = infoStruct->WorkUnitID;
+  const SizeValueType begin    = temp->m_NumberOfQueryPoints * workUnit / temp->m_NumberOfWorkUnits;
+  const SizeValueType end      = temp->m_NumberOfQueryPoints * ( workUnit + 1 ) / temp->m_NumberOfWorkUnits;
+
+  MeasurementVectorType qp;
+  for( SizeValueType i = begin; i < end; ++i )
+  {
+    temp->m_QuerySample->GetMeasurementVector( i, qp );
+    temp->m_Searcher->Search( qp, ( *temp->m_Indices )[ i ], ( *temp->m_Distances )[ i ] );
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end BatchSearchThreaderCallback()
+
+
 } // end namespace itk
 
 #endif // end #ifndef __itkBinaryTreeSearchBase_hxx
@@ -67,9 +67,30 @@ namespace elastix
  *    This option is only appropiate for FixedRadius search. \n
  *    <tt>(SquaredSearchRadius 32.0 8.0 8.0)</tt> \n
  *    The default is 0.0 for all resolutions, which means no radius.
+ * \parameter MultiThreadedKNNSearch: search the nearest neighbours of the samples with
+ *    multiple threads. The result does not depend on this setting. \n
+ *    <tt>(MultiThreadedKNNSearch "true" "false")</tt> \n
+ *    The default is "true" for all resolutions.
+ * \parameter MaximumNumberOfSamplesForBruteForceSearch: search the nearest neighbours by
+ *    brute force, without generating the trees, when at most this number of samples is used.
+ *    For small numbers of samples the generation of the trees costs more than it saves.
+ *    Not used with the Priority search, which requires a kd tree. \n
+ *    <tt>(MaximumNumberOfSamplesForBruteForceSearch 1000 1000 0)</tt> \n
+ *    The default is 0 for all resolutions, which means the trees are always generated.
  * \parameter AvoidDivisionBy: a small number to avoid division by zero in the implentation. \n
  *    <tt>(AvoidDivisionBy 0.000000001)</tt> \n
  *    The default is 1e-5.
+ * \parameter UseInterleavedMovingImageCoefficients: interpolate all moving feature images
+ *    at once, from a copy of their B-spline coefficients that is interleaved per voxel.
+ *    This saves time for many feature images with the same geometry, at the expense of
+ *    memory for one double per voxel per image. \n
+ *    <tt>(UseInterleavedMovingImageCoefficients "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseFixedFeatureImageCache: interpolate the fixed feature images once per set
+ *    of samples, instead of every iteration. This saves time with a full or grid sampler, or
+ *    with NewSamplesEveryIteration set to "false". \n
+ *    <tt>(UseFixedFeatureImageCache "true")</tt> \n
+ *    The default is "false".
  *
  * \warning Note that we assume the FixedFeatureImageType to have the same
  * pixeltype as the FixedImageType
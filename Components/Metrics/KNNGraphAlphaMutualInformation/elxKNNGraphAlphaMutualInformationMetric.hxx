@@ -65,6 +65,18 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
   this->m_Configuration->ReadParameter( smallNumber, "AvoidDivisionBy", 0, true );
   this->SetAvoidDivisionBy( smallNumber );
 
+  /** Get whether the feature images are interpolated at once. */
+  bool useInterleavedCoefficients = false;
+  this->m_Configuration->ReadParameter( useInterleavedCoefficients,
+    "UseInterleavedMovingImageCoefficients", 0, true );
+  this->SetUseInterleavedMovingImageCoefficients( useInterleavedCoefficients );
+
+  /** Get whether the fixed feature image values of the samples are cached. */
+  bool useFixedFeatureImageCache = false;
+  this->m_Configuration->ReadParameter( useFixedFeatureImageCache,
+    "UseFixedFeatureImageCache", 0, true );
+  this->SetUseFixedFeatureImageCache( useFixedFeatureImageCache );
+
 } // end BeforeRegistration()
 
 
@@ -237,6 +249,17 @@ KNNGraphAlphaMutualInformationMetric< TElastix >
                        << treeSearchType << "\" implemented." );
   }
 
+  /** Get the settings of the search. */
+  bool multiThreadedSearch = true;
+  this->m_Configuration->ReadParameter( multiThreadedSearch,
+    "MultiThreadedKNNSearch", this->GetComponentLabel(), level, 0 );
+  this->SetUseMultiThreadedSearch( multiThreadedSearch );
+
+  itk::SizeValueType maximumNumberOfSamplesForBruteForceSearch = 0;
+  this->m_Configuration->ReadParameter( maximumNumberOfSamplesForBruteForceSearch,
+    "MaximumNumberOfSamplesForBruteForceSearch", this->GetComponentLabel(), level, 0 );
+  this->SetMaximumNumberOfSamplesForBruteForceSearch( maximumNumberOfSamplesForBruteForceSearch );
+
 } // end BeforeEachResolution()
 
 
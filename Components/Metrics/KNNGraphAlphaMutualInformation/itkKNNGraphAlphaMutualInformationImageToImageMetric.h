@@ -40,6 +40,8 @@
 /** Include for the spatial derivatives. */
 #include "itkArray2D.h"
 
+#include <vector>
+
 namespace itk
 {
 /**
@@ -67,6 +69,13 @@ namespace itk
  * IEEE Transactions on Medical Imaging, vol. 28, no. 9, pp. 1412 - 1421,
  * September 2009.
  *
+ * The nearest neighbours of all samples are searched before the metric
+ * value is computed. The searches are independent, so they are distributed
+ * over the threads of the PersistentThreadPool, unless
+ * UseMultiThreadedSearch is false. For small numbers of samples the
+ * generation of the trees may cost more than the search. In that case the
+ * trees can be skipped, by searching the neighbours by brute force.
+ *
  * \ingroup RegistrationMetrics
  */
 
@@ -247,6 +256,22 @@ public:
   /** Avoid division by a small number. */
   itkGetConstReferenceMacro( AvoidDivisionBy, double );
 
+  /** Search the nearest neighbours of the samples with multiple threads.
+   * The result does not depend on this setting. Default: true.
+   */
+  itkSetMacro( UseMultiThreadedSearch, bool );
+  itkGetConstMacro( UseMultiThreadedSearch, bool );
+  itkBooleanMacro( UseMultiThreadedSearch );
+
+  /** Search the nearest neighbours by brute force, without generating the
+   * trees, if at most this number of samples is used. The brute force search
+   * is exact, so it may give different neighbours than a search with an
+   * error bound. It is not used with the priority tree search, which
+   * requires a kd tree. Default: 0, i.e. the trees are always generated.
+   */
+  itkSetMacro( MaximumNumberOfSamplesForBruteForceSearch, SizeValueType );
+  itkGetConstMacro( MaximumNumberOfSamplesForBruteForceSearch, SizeValueType );
+
 protected:
 
   /** Constructor. */
@@ -270,6 +295,14 @@ protected:
   double m_Alpha;
   double m_AvoidDivisionBy;
 
+  bool          m_UseMultiThreadedSearch;
+  SizeValueType m_MaximumNumberOfSamplesForBruteForceSearch;
+
+  /** The trees that replace the trees above for small numbers of samples. */
+  BinaryKNNTreePointer m_BruteForceTreeFixed;
+  BinaryKNNTreePointer m_BruteForceTreeMoving;
+  BinaryKNNTreePointer m_BruteForceTreeJoint;
+
 private:
 
   KNNGraphAlphaMutualInformationImageToImageMetric( const Self & ); // purposely not implemented
@@ -286,6 +319,31 @@ private:
   typedef Array2D< double >                         SpatialDerivativeType;
   typedef std::vector< SpatialDerivativeType >      SpatialDerivativeContainerType;
 
+  /** The k nearest neighbours of all samples in one of the trees. */
+  struct NeighborsType
+  {
+    typename BinaryKNNTreeSearchType::IndexArrayContainerType    m_Indices;
+    typename BinaryKNNTreeSearchType::DistanceArrayContainerType m_Distances;
+  };
+
+  /** Generate the fixed, moving and joint trees from the list samples, or
+   * the brute force trees for small numbers of samples, and connect them to
+   * the searchers.
+   */
+  void GenerateTreesAndConnectSearchers(
+    const ListSamplePointer & listSampleFixed,
+    const ListSamplePointer & listSampleMoving,
+    const ListSamplePointer & listSampleJoint ) const;
+
+  /** Search the k nearest neighbours of all samples in the three trees. */
+  void SearchNearestNeighbors(
+    const ListSamplePointer & listSampleFixed,
+    const ListSamplePointer & listSampleMoving,
+    const ListSamplePointer & listSampleJoint,
+    NeighborsType & neighborsFixed,
+    NeighborsType & neighborsMoving,
+    NeighborsType & neighborsJoint ) const;
+
   /** This function takes the fixed image samples from the ImageSampler
    * and puts them in the listSampleFixed, together with the fixed feature
    * image samples. Also the corresponding moving image values and moving
@@ -20,6 +20,8 @@
 
 #include "itkKNNGraphAlphaMutualInformationImageToImageMetric.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
@@ -44,6 +46,13 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   this->m_BinaryKNNTreeSearcherMoving = 0;
   this->m_BinaryKNNTreeSearcherJoint  = 0;
 
+  this->m_UseMultiThreadedSearch                    = true;
+  this->m_MaximumNumberOfSamplesForBruteForceSearch = 0;
+
+  this->m_BruteForceTreeFixed  = ANNBruteForceTreeType::New();
+  this->m_BruteForceTreeMoving = ANNBruteForceTreeType::New();
+  this->m_BruteForceTreeJoint  = ANNBruteForceTreeType::New();
+
 } // end Constructor()
 
 
@@ -336,25 +345,13 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * and connect them to the searchers.
    */
 
-  /** Generate the tree for the fixed image samples. */
-  this->m_BinaryKNNTreeFixed->SetSample( listSampleFixed );
-  this->m_BinaryKNNTreeFixed->GenerateTree();
+  this->GenerateTreesAndConnectSearchers(
+    listSampleFixed, listSampleMoving, listSampleJoint );
 
-  /** Generate the tree for the moving image samples. */
-  this->m_BinaryKNNTreeMoving->SetSample( listSampleMoving );
-  this->m_BinaryKNNTreeMoving->GenerateTree();
-
-  /** Generate the tree for the joint image samples. */
-  this->m_BinaryKNNTreeJoint->SetSample( listSampleJoint );
-  this->m_BinaryKNNTreeJoint->GenerateTree();
-
-  /** Initialize tree searchers. */
-  this->m_BinaryKNNTreeSearcherFixed
-  ->SetBinaryTree( this->m_BinaryKNNTreeFixed );
-  this->m_BinaryKNNTreeSearcherMoving
-  ->SetBinaryTree( this->m_BinaryKNNTreeMoving );
-  this->m_BinaryKNNTreeSearcherJoint
-  ->SetBinaryTree( this->m_BinaryKNNTreeJoint );
+  /** Search the k nearest neighbours of all query points, i.e. all samples. */
+  NeighborsType neighborsFixed, neighborsMoving, neighborsJoint;
+  this->SearchNearestNeighbors( listSampleFixed, listSampleMoving, listSampleJoint,
+    neighborsFixed, neighborsMoving, neighborsJoint );
 
   /**
    * *************** Estimate the \alpha MI ******************
@@ -391,9 +388,6 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 
   /** Temporary variables. */
   typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
-  MeasurementVectorType z_F, z_M, z_J;
-  IndexArrayType        indices_F, indices_M, indices_J;
-  DistanceArrayType     distances_F, distances_M, distances_J;
 
   MeasureType    H, G;
   AccumulateType sumG = NumericTraits< AccumulateType >::Zero;
@@ -410,15 +404,10 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   /** Loop over all query points, i.e. all samples. */
   for( unsigned long i = 0; i < this->m_NumberOfPixelsCounted; i++ )
   {
-    /** Get the i-th query point. */
-    listSampleFixed->GetMeasurementVector(  i, z_F );
-    listSampleMoving->GetMeasurementVector( i, z_M );
-    listSampleJoint->GetMeasurementVector(  i, z_J );
-
-    /** Search for the K nearest neighbours of the current query point. */
-    this->m_BinaryKNNTreeSearcherFixed->Search(  z_F, indices_F, distances_F );
-    this->m_BinaryKNNTreeSearcherMoving->Search( z_M, indices_M, distances_M );
-    this->m_BinaryKNNTreeSearcherJoint->Search(  z_J, indices_J, distances_J );
+    /** Get the distances to the K nearest neighbours of the current query point. */
+    const DistanceArrayType & distances_F = neighborsFixed.m_Distances[ i ];
+    const DistanceArrayType & distances_M = neighborsMoving.m_Distances[ i ];
+    const DistanceArrayType & distances_J = neighborsJoint.m_Distances[ i ];
 
     /** Add the distances between the points to get the total graph length.
      * The outcommented implementation calculates: sum J/sqrt(F*M)
@@ -561,25 +550,13 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
    * and connect them to the searchers.
    */
 
-  /** Generate the tree for the fixed image samples. */
-  this->m_BinaryKNNTreeFixed->SetSample( listSampleFixed );
-  this->m_BinaryKNNTreeFixed->GenerateTree();
-
-  /** Generate the tree for the moving image samples. */
-  this->m_BinaryKNNTreeMoving->SetSample( listSampleMoving );
-  this->m_BinaryKNNTreeMoving->GenerateTree();
-
-  /** Generate the tree for the joint image samples. */
-  this->m_BinaryKNNTreeJoint->SetSample( listSampleJoint );
-  this->m_BinaryKNNTreeJoint->GenerateTree();
+  this->GenerateTreesAndConnectSearchers(
+    listSampleFixed, listSampleMoving, listSampleJoint );
 
-  /** Initialize tree searchers. */
-  this->m_BinaryKNNTreeSearcherFixed
-  ->SetBinaryTree( this->m_BinaryKNNTreeFixed );
-  this->m_BinaryKNNTreeSearcherMoving
-  ->SetBinaryTree( this->m_BinaryKNNTreeMoving );
-  this->m_BinaryKNNTreeSearcherJoint
-  ->SetBinaryTree( this->m_BinaryKNNTreeJoint );
+  /** Search the k nearest neighbours of all query points, i.e. all samples. */
+  NeighborsType neighborsFixed, neighborsMoving, neighborsJoint;
+  this->SearchNearestNeighbors( listSampleFixed, listSampleMoving, listSampleJoint,
+    neighborsFixed, neighborsMoving, neighborsJoint );
 
   /**
    * *************** Estimate the \alpha MI and its derivatives ******************
@@ -616,9 +593,7 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 
   /** Temporary variables. */
   typedef typename NumericTraits< MeasureType >::AccumulateType AccumulateType;
-  MeasurementVectorType z_F, z_M, z_J, z_M_ip, z_J_ip, diff_M, diff_J;
-  IndexArrayType        indices_F,   indices_M,   indices_J;
-  DistanceArrayType     distances_F, distances_M, distances_J;
+  MeasurementVectorType z_M, z_M_ip, z_J_ip, diff_M, diff_J;
   MeasureType           distance_F,  distance_M,  distance_J;
 
   MeasureType    H, G, Gpow;
@@ -641,15 +616,13 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   /** Loop over all query points, i.e. all samples. */
   for( unsigned long i = 0; i < this->m_NumberOfPixelsCounted; i++ )
   {
-    /** Get the i-th query point. */
-    listSampleFixed->GetMeasurementVector(  i, z_F );
+    /** Get the i-th query point and its k nearest neighbours. */
     listSampleMoving->GetMeasurementVector( i, z_M );
-    listSampleJoint->GetMeasurementVector(  i, z_J );
-
-    /** Search for the k nearest neighbours of the current query point. */
-    this->m_BinaryKNNTreeSearcherFixed->Search(  z_F, indices_F, distances_F );
-    this->m_BinaryKNNTreeSearcherMoving->Search( z_M, indices_M, distances_M );
-    this->m_BinaryKNNTreeSearcherJoint->Search(  z_J, indices_J, distances_J );
+    const IndexArrayType &    indices_M   = neighborsMoving.m_Indices[ i ];
+    const IndexArrayType &    indices_J   = neighborsJoint.m_Indices[ i ];
+    const DistanceArrayType & distances_F = neighborsFixed.m_Distances[ i ];
+    const DistanceArrayType & distances_M = neighborsMoving.m_Distances[ i ];
+    const DistanceArrayType & distances_J = neighborsJoint.m_Distances[ i ];
 
     /** Variables to compute the measure and its derivative. */
     AccumulateType Gamma_F = NumericTraits< AccumulateType >::Zero;
@@ -737,6 +710,80 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
 } // end GetValueAndDerivative()
 
 
+/**
+ * ************************ GenerateTreesAndConnectSearchers *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GenerateTreesAndConnectSearchers(
+  const ListSamplePointer & listSampleFixed,
+  const ListSamplePointer & listSampleMoving,
+  const ListSamplePointer & listSampleJoint ) const
+{
+  /** For small numbers of samples, skip the generation of the trees. The
+   * priority search requires a kd tree, so it always uses the trees.
+   */
+  const bool useBruteForce
+    = this->m_NumberOfPixelsCounted <= this->m_MaximumNumberOfSamplesForBruteForceSearch
+    && dynamic_cast< ANNPriorityTreeSearchType * >(
+    this->m_BinaryKNNTreeSearcherFixed.GetPointer() ) == nullptr;
+
+  BinaryKNNTreeType * treeFixed = useBruteForce
+    ? this->m_BruteForceTreeFixed.GetPointer() : this->m_BinaryKNNTreeFixed.GetPointer();
+  BinaryKNNTreeType * treeMoving = useBruteForce
+    ? this->m_BruteForceTreeMoving.GetPointer() : this->m_BinaryKNNTreeMoving.GetPointer();
+  BinaryKNNTreeType * treeJoint = useBruteForce
+    ? this->m_BruteForceTreeJoint.GetPointer() : this->m_BinaryKNNTreeJoint.GetPointer();
+
+  /** Generate the tree for the fixed image samples. */
+  treeFixed->SetSample( listSampleFixed );
+  treeFixed->GenerateTree();
+
+  /** Generate the tree for the moving image samples. */
+  treeMoving->SetSample( listSampleMoving );
+  treeMoving->GenerateTree();
+
+  /** Generate the tree for the joint image samples. */
+  treeJoint->SetSample( listSampleJoint );
+  treeJoint->GenerateTree();
+
+  /** Initialize tree searchers. */
+  this->m_BinaryKNNTreeSearcherFixed->SetBinaryTree( treeFixed );
+  this->m_BinaryKNNTreeSearcherMoving->SetBinaryTree( treeMoving );
+  this->m_BinaryKNNTreeSearcherJoint->SetBinaryTree( treeJoint );
+
+} // end GenerateTreesAndConnectSearchers()
+
+
+/**
+ * ************************ SearchNearestNeighbors *************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::SearchNearestNeighbors(
+  const ListSamplePointer & listSampleFixed,
+  const ListSamplePointer & listSampleMoving,
+  const ListSamplePointer & listSampleJoint,
+  NeighborsType & neighborsFixed,
+  NeighborsType & neighborsMoving,
+  NeighborsType & neighborsJoint ) const
+{
+  /** The searches in one tree are divided over the threads. */
+  const SizeValueType numberOfSamples = this->m_NumberOfPixelsCounted;
+  this->m_BinaryKNNTreeSearcherFixed->BatchSearch( listSampleFixed.GetPointer(), numberOfSamples,
+    neighborsFixed.m_Indices, neighborsFixed.m_Distances, this->m_UseMultiThreadedSearch );
+  this->m_BinaryKNNTreeSearcherMoving->BatchSearch( listSampleMoving.GetPointer(), numberOfSamples,
+    neighborsMoving.m_Indices, neighborsMoving.m_Distances, this->m_UseMultiThreadedSearch );
+  this->m_BinaryKNNTreeSearcherJoint->BatchSearch( listSampleJoint.GetPointer(), numberOfSamples,
+    neighborsJoint.m_Indices, neighborsJoint.m_Distances, this->m_UseMultiThreadedSearch );
+
+} // end SearchNearestNeighbors()
+
+
 /**
  * ************************ ComputeListSampleValuesAndDerivativePlusJacobian *************************
  */
@@ -763,11 +810,6 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   ImageSampleContainerPointer sampleContainer      = this->GetImageSampler()->GetOutput();
   const unsigned long         nrOfRequestedSamples = sampleContainer->Size();
 
-  /** Create an iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
-
   /** Get the size of the feature vectors. */
   const unsigned int fixedSize  = this->GetNumberOfFixedImages();
   const unsigned int movingSize = this->GetNumberOfMovingImages();
@@ -781,140 +823,179 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   listSampleJoint->SetMeasurementVectorSize( jointSize );
   listSampleJoint->Resize( nrOfRequestedSamples );
 
-  /** Potential speedup: it avoids re-allocations. I noticed performance
-   * gains when nrOfRequestedSamples is about 10000 or higher.
-   */
-  jacobianContainer.reserve( nrOfRequestedSamples );
-  jacobianIndicesContainer.reserve( nrOfRequestedSamples );
-  spatialDerivativesContainer.reserve( nrOfRequestedSamples );
-
-  /** Create variables to store intermediate results. */
-  RealType                   movingImageValue;
-  MovingImagePointType       mappedPoint;
-  double                     fixedFeatureValue  = 0.0;
-  double                     movingFeatureValue = 0.0;
-  NonZeroJacobianIndicesType nzji(
-  this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
-  TransformJacobianType jacobian;
-
-  /** Loop over the fixed image samples to calculate the list samples. */
-  unsigned int ii = 0;
-  for( fiter = fbegin; fiter != fend; ++fiter )
-  {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-
-    /** Check if point is inside all moving masks. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
-
-    /** Compute the moving image value M(T(x)) and possibly the
-     * derivative dM/dx and check if the point is inside all
-     * moving images buffers.
-     */
-    MovingImageDerivativeType movingImageDerivative;
-    if( sampleOk )
-    {
-      if( doDerivative )
-      {
-        sampleOk = this->EvaluateMovingImageValueAndDerivative(
-          mappedPoint, movingImageValue, &movingImageDerivative );
-      }
-      else
-      {
-        sampleOk = this->EvaluateMovingImageValueAndDerivative(
-          mappedPoint, movingImageValue, 0 );
-      }
-    }
+  /** Interpolate the fixed feature images, if they are not cached yet. */
+  this->UpdateFixedFeatureImageCache();
 
-    /** This is a valid sample: in this if-statement the actual
-     * addition to the list samples is done.
-     */
-    if( sampleOk )
+  /** Map the samples and evaluate the first moving image in one threaded
+   * sweep, in a chunk of samples per work unit, to find the valid samples.
+   */
+  std::vector< MovingImagePointType >      mappedPoints( nrOfRequestedSamples );
+  std::vector< RealType >                  movingImageValues( nrOfRequestedSamples );
+  std::vector< MovingImageDerivativeType > movingImageDerivatives( doDerivative ? nrOfRequestedSamples : 0 );
+  std::vector< unsigned char >             sampleOkVector( nrOfRequestedSamples, 0 );
+  const unsigned int                       numberOfChunks = Self::GetNumberOfReductionChunks();
+  const SizeValueType                      chunkSize = ( nrOfRequestedSamples + numberOfChunks - 1 ) / numberOfChunks;
+  this->ProcessSlices( numberOfChunks, true,
+    [this, &sampleContainer, nrOfRequestedSamples, chunkSize, doDerivative, &mappedPoints,
+    &movingImageValues, &movingImageDerivatives, &sampleOkVector]( const unsigned int chunk )
     {
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue = static_cast< RealType >(
-        ( *fiter ).Value().m_ImageValue );
-
-      /** Add the samples to the ListSampleCarrays. */
-      listSampleFixed->SetMeasurement(  this->m_NumberOfPixelsCounted, 0,
-        fixedImageValue );
-      listSampleMoving->SetMeasurement( this->m_NumberOfPixelsCounted, 0,
-        movingImageValue );
-      listSampleJoint->SetMeasurement(  this->m_NumberOfPixelsCounted, 0,
-        fixedImageValue );
-      listSampleJoint->SetMeasurement(  this->m_NumberOfPixelsCounted,
-        this->GetNumberOfFixedImages(), movingImageValue );
-
-      /** Get and set the values of the fixed feature images. */
-      for( unsigned int j = 1; j < this->GetNumberOfFixedImages(); j++ )
-      {
-        fixedFeatureValue = this->m_FixedImageInterpolatorVector[ j ]
-          ->Evaluate( fixedPoint );
-        listSampleFixed->SetMeasurement(
-          this->m_NumberOfPixelsCounted, j, fixedFeatureValue );
-        listSampleJoint->SetMeasurement(
-          this->m_NumberOfPixelsCounted, j, fixedFeatureValue );
-      }
+      const SizeValueType chunkBegin = std::min< SizeValueType >( chunk * chunkSize, nrOfRequestedSamples );
+      const SizeValueType chunkEnd   = std::min< SizeValueType >( chunkBegin + chunkSize, nrOfRequestedSamples );
 
-      /** Get and set the values of the moving feature images. */
-      for( unsigned int j = 1; j < this->GetNumberOfMovingImages(); j++ )
-      {
-        movingFeatureValue = this->m_InterpolatorVector[ j ]
-          ->Evaluate( mappedPoint );
-        listSampleMoving->SetMeasurement(
-          this->m_NumberOfPixelsCounted,
-          j,
-          movingFeatureValue );
-        listSampleJoint->SetMeasurement(
-          this->m_NumberOfPixelsCounted,
-          j + this->GetNumberOfFixedImages(),
-          movingFeatureValue );
-      }
-
-      /** Compute additional stuff for the computation of the derivative, if necessary.
-       * - the Jacobian of the transform: dT/dmu(x_i).
-       * - the spatial derivative of all moving feature images: dz_q^m/dx(T(x_i)).
+      /** The points are transformed per block, with one call of the batch
+       * TransformPoints(). The moving images are evaluated per sample, since
+       * all of them are needed.
        */
-      if( doDerivative )
+      const unsigned int  batchSize = Superclass::MovingImageBatchSize;
+      FixedImagePointType fixedPoints[ batchSize ];
+      bool                blockOk[ batchSize ];
+      for( SizeValueType blockBegin = chunkBegin; blockBegin < chunkEnd; blockBegin += batchSize )
       {
-        /** Get the TransformJacobian dT/dmu. */
-        this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
-        jacobianContainer.push_back( jacobian );
-        jacobianIndicesContainer.push_back( nzji );
-
-        /** Get the spatial derivative of the moving image. */
-        SpatialDerivativeType spatialDerivatives(
-        this->GetNumberOfMovingImages(),
-        this->FixedImageDimension );
-        spatialDerivatives.set_row( 0, movingImageDerivative.GetDataPointer() );
-
-        /** Get the spatial derivatives of the moving feature images. */
-        SpatialDerivativeType movingFeatureImageDerivatives(
-        this->GetNumberOfMovingImages() - 1,
-        this->FixedImageDimension );
-        this->EvaluateMovingFeatureImageDerivatives(
-          mappedPoint, movingFeatureImageDerivatives );
-        spatialDerivatives.update( movingFeatureImageDerivatives, 1, 0 );
-
-        /** Put the spatial derivatives of this sample into the container. */
-        spatialDerivativesContainer.push_back( spatialDerivatives );
+        const unsigned int blockSize = static_cast< unsigned int >(
+          std::min< SizeValueType >( chunkEnd - blockBegin, batchSize ) );
+
+        /** Transform the points and check if they are inside all moving masks. */
+        for( unsigned int b = 0; b < blockSize; ++b )
+        {
+          fixedPoints[ b ] = sampleContainer->ElementAt( blockBegin + b ).m_ImageCoordinates;
+        }
+        this->TransformMovingImageBatch( fixedPoints, &mappedPoints[ blockBegin ], blockOk, blockSize, blockBegin );
+
+        for( unsigned int b = 0; b < blockSize; ++b )
+        {
+          /** Compute the moving image value M(T(x)) and possibly the
+           * derivative dM/dx and check if the point is inside all
+           * moving images buffers.
+           */
+          const SizeValueType i        = blockBegin + b;
+          bool                sampleOk = blockOk[ b ];
+          if( sampleOk )
+          {
+            sampleOk = this->EvaluateMovingImageValueAndDerivative( mappedPoints[ i ],
+              movingImageValues[ i ], doDerivative ? &movingImageDerivatives[ i ] : 0 );
+          }
+          sampleOkVector[ i ] = sampleOk;
+        }
+      }
+    } );
 
-      } // end if doDerivative
+  /** Give the valid samples their position in the list samples. */
+  std::vector< SizeValueType > listSampleIndices( nrOfRequestedSamples );
+  for( SizeValueType i = 0; i < nrOfRequestedSamples; ++i )
+  {
+    listSampleIndices[ i ] = this->m_NumberOfPixelsCounted;
+    this->m_NumberOfPixelsCounted += sampleOkVector[ i ];
+  }
+  const SizeValueType numberOfValidSamples = this->m_NumberOfPixelsCounted;
 
-      /** Update the NumberOfPixelsCounted. */
-      this->m_NumberOfPixelsCounted++;
+  if( doDerivative )
+  {
+    jacobianContainer.resize( numberOfValidSamples );
+    jacobianIndicesContainer.assign( numberOfValidSamples, NonZeroJacobianIndicesType(
+      this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() ) );
+    spatialDerivativesContainer.assign( numberOfValidSamples, SpatialDerivativeType(
+      movingSize, this->FixedImageDimension ) );
+  }
 
-      ii++;
+  /** Fill the list samples with all fixed and moving feature values in a
+   * second threaded sweep. Every valid sample is written at its own position,
+   * so the result is the same as that of a sequential loop.
+   */
+  const bool gatherMovingImages = this->GetUseInterleavedMovingImageCoefficients();
+  this->ProcessSlices( numberOfChunks, true,
+    [this, &sampleContainer, nrOfRequestedSamples, chunkSize, doDerivative, gatherMovingImages,
+    fixedSize, movingSize, &mappedPoints, &movingImageValues, &movingImageDerivatives,
+    &sampleOkVector, &listSampleIndices, &listSampleFixed, &listSampleMoving, &listSampleJoint,
+    &jacobianContainer, &jacobianIndicesContainer, &spatialDerivativesContainer]( const unsigned int chunk )
+    {
+      const SizeValueType chunkBegin = std::min< SizeValueType >( chunk * chunkSize, nrOfRequestedSamples );
+      const SizeValueType chunkEnd   = std::min< SizeValueType >( chunkBegin + chunkSize, nrOfRequestedSamples );
 
-    } // end if sampleOk
+      /** The values and derivatives of all moving images, if they are gathered at once. */
+      std::vector< RealType >                  featureValues( movingSize );
+      std::vector< MovingImageDerivativeType > featureDerivatives( movingSize );
+      SpatialDerivativeType                    movingFeatureImageDerivatives(
+        movingSize - 1, this->FixedImageDimension );
 
-  } // end for loop over the image sample container
+      for( SizeValueType i = chunkBegin; i < chunkEnd; ++i )
+      {
+        if( !sampleOkVector[ i ] )
+        {
+          continue;
+        }
+        const SizeValueType          index       = listSampleIndices[ i ];
+        const FixedImagePointType &  fixedPoint  = sampleContainer->ElementAt( i ).m_ImageCoordinates;
+        const MovingImagePointType & mappedPoint = mappedPoints[ i ];
+
+        /** Add the image values to the ListSampleCarrays. */
+        const RealType fixedImageValue = static_cast< RealType >(
+          sampleContainer->ElementAt( i ).m_ImageValue );
+        listSampleFixed->SetMeasurement(  index, 0, fixedImageValue );
+        listSampleMoving->SetMeasurement( index, 0, movingImageValues[ i ] );
+        listSampleJoint->SetMeasurement(  index, 0, fixedImageValue );
+        listSampleJoint->SetMeasurement(  index, fixedSize, movingImageValues[ i ] );
+
+        /** Get and set the values of the fixed feature images. */
+        const double * cachedFixedFeatureValues = this->GetCachedFixedFeatureImageValues( i );
+        for( unsigned int j = 1; j < fixedSize; j++ )
+        {
+          const double fixedFeatureValue = cachedFixedFeatureValues
+            ? cachedFixedFeatureValues[ j - 1 ]
+            : this->m_FixedImageInterpolatorVector[ j ]->Evaluate( fixedPoint );
+          listSampleFixed->SetMeasurement( index, j, fixedFeatureValue );
+          listSampleJoint->SetMeasurement( index, j, fixedFeatureValue );
+        }
+
+        /** Evaluate the moving feature images, and their derivatives, at once. */
+        if( gatherMovingImages )
+        {
+          this->EvaluateMovingImageValuesAndDerivatives( mappedPoint, featureValues.data(),
+            doDerivative ? featureDerivatives.data() : nullptr );
+        }
+
+        /** Get and set the values of the moving feature images. */
+        for( unsigned int j = 1; j < movingSize; j++ )
+        {
+          const double movingFeatureValue = gatherMovingImages ? featureValues[ j ]
+            : this->m_InterpolatorVector[ j ]->Evaluate( mappedPoint );
+          listSampleMoving->SetMeasurement( index, j, movingFeatureValue );
+          listSampleJoint->SetMeasurement( index, j + fixedSize, movingFeatureValue );
+        }
+
+        /** Compute additional stuff for the computation of the derivative, if necessary.
+         * - the Jacobian of the transform: dT/dmu(x_i).
+         * - the spatial derivative of all moving feature images: dz_q^m/dx(T(x_i)).
+         */
+        if( doDerivative )
+        {
+          /** Get the TransformJacobian dT/dmu. */
+          this->EvaluateTransformJacobian( fixedPoint,
+            jacobianContainer[ index ], jacobianIndicesContainer[ index ] );
+
+          /** Get the spatial derivative of the moving image. */
+          SpatialDerivativeType & spatialDerivatives = spatialDerivativesContainer[ index ];
+          spatialDerivatives.set_row( 0, movingImageDerivatives[ i ].GetDataPointer() );
+
+          /** Get the spatial derivatives of the moving feature images. */
+          if( gatherMovingImages )
+          {
+            for( unsigned int j = 1; j < movingSize; j++ )
+            {
+              spatialDerivatives.set_row( j, featureDerivatives[ j ].GetDataPointer() );
+            }
+          }
+          else if( movingSize > 1 )
+          {
+            this->EvaluateMovingFeatureImageDerivatives(
+              mappedPoint, movingFeatureImageDerivatives );
+            spatialDerivatives.update( movingFeatureImageDerivatives, 1, 0 );
+          }
+
+        } // end if doDerivative
+
+      } // end for loop over the samples of this chunk
+
+    } );
 
   /** The listSamples are of size sampleContainer->Size(). However, not all of
    * those points made it to the respective list samples. Therefore, we set
@@ -1104,6 +1185,11 @@ KNNGraphAlphaMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
   os << indent << "BinaryKNNTreeSearcherJoint: "
      << this->m_BinaryKNNTreeSearcherJoint.GetPointer() << std::endl;
 
+  os << indent << "UseMultiThreadedSearch: "
+     << ( this->m_UseMultiThreadedSearch ? "true" : "false" ) << std::endl;
+  os << indent << "MaximumNumberOfSamplesForBruteForceSearch: "
+     << this->m_MaximumNumberOfSamplesForBruteForceSearch << std::endl;
+
 } // end PrintSelf()
 
 
@@ -46,6 +46,10 @@ namespace elastix
  *    <tt>(WriteResultMeshAfterEachIteration "True")</tt>
  * \parameter
  *    <tt>(WriteResultMeshAfterEachResolution "True")</tt>
+ * \parameter UseMultiThreadingForMetrics: Whether the faces and points are
+ *    processed in parallel. Can be given for each resolution.\n
+ *    example: <tt>(UseMultiThreadingForMetrics "false")</tt>\n
+ *    The default is "true".
  * The command-line options for input meshes is: -fmesh<[A-Z]><MetricNumber>.
  * \ingroup RegistrationMetrics
  */
@@ -162,6 +166,8 @@ public:
 
   void BeforeRegistration( void ) override;
 
+  void BeforeEachResolution( void ) override;
+
   void AfterEachIteration( void ) override;
 
   void AfterEachResolution( void ) override;
@@ -172,6 +172,28 @@ MissingStructurePenalty< TElastix >
 } // end BeforeRegistration()
 
 
+/**
+ * ***************** BeforeEachResolution ***********************
+ */
+
+template< class TElastix >
+void
+MissingStructurePenalty< TElastix >
+::BeforeEachResolution( void )
+{
+  /** Get the current resolution level. */
+  unsigned int level
+    = ( this->m_Registration->GetAsITKBaseType() )->GetCurrentLevel();
+
+  /** Should the metric use multi-threading? */
+  bool useMultiThreading = true;
+  this->GetConfiguration()->ReadParameter( useMultiThreading,
+    "UseMultiThreadingForMetrics", this->GetComponentLabel(), level, 0 );
+  this->SetUseMultiThread( useMultiThreading );
+
+} // end BeforeEachResolution()
+
+
 /**
  * ***************** AfterEachIteration ***********************
  */
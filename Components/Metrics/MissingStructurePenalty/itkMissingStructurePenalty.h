@@ -26,6 +26,8 @@
 #include "itkVectorContainer.h"
 #include "vnl_adjugate_fixed.h"
 
+#include <vector>
+
 namespace itk
 {
 
@@ -38,6 +40,13 @@ namespace itk
  * M.A. Viergever and J.P.W. Pluim "Registration of structurally dissimilar \n
  * images in MRI-based brachytherapy ", Phys. Med. Biol. 59 (2014) 4033-4045.\n
  * http://stacks.iop.org/0031-9155/59/4033
+ *
+ * Initialize() stores the faces of each mesh as one array of point indices
+ * per corner, and for each point the faces it belongs to. An evaluation
+ * transforms the points, sums the volumes of the faces, and gathers the
+ * derivative of each point from its faces, each in parallel over chunks of
+ * points or faces. The derivatives of the chunks are summed in a fixed order.
+ *
  * \ingroup RegistrationMetrics
  */
 template< class TFixedPointSet, class TMovingPointSet >
@@ -175,6 +184,32 @@ private:
 
   void SubVector( const VectorType & fullVector, SubVectorType & subVector, const unsigned int leaveOutIndex ) const;
 
+  /** The faces of a mesh. m_Corners[ c ][ f ] is the index of corner c of
+   * face f. The faces of point i are the entries m_PointFaceOffsets[ i ] to
+   * m_PointFaceOffsets[ i + 1 ] - 1 of m_PointFaces and m_PointCorners,
+   * which hold the face and the corner of the point in that face.
+   */
+  struct MeshFacesType
+  {
+    std::vector< std::vector< SizeValueType > > m_Corners;
+    std::vector< SizeValueType >                m_PointFaceOffsets;
+    std::vector< SizeValueType >                m_PointFaces;
+    std::vector< unsigned char >                m_PointCorners;
+  };
+
+  /** Return the signed volume of a face, with its corners relative to the
+   * centroid of the mesh, except in 4D.
+   */
+  float ComputeSignedVolume( const MeshPointsContainerType * mappedPoints,
+    const MeshFacesType & faces, const SizeValueType face,
+    const MeshPointType & centroid, VectorType * corners ) const;
+
+  /** Compute the value, and the derivative if it is not null. */
+  void ComputeValueAndDerivative( MeasureType & value, DerivativeType * derivative ) const;
+
+  std::vector< MeshFacesType >          m_MeshFaces;
+  mutable std::vector< DerivativeType > m_ChunkDerivatives;
+
   MissingVolumeMeshPenalty( const Self & ); // purposely not implemented
   void operator=( const Self & );           // purposely not implemented
 
@@ -20,6 +20,7 @@
 
 #include "itkMissingStructurePenalty.h"
 #include <cmath>
+#include <algorithm>
 
 namespace itk
 {
@@ -93,6 +94,55 @@ MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
     this->m_MappedMeshContainer->SetElement( meshId, mappedMesh );
 
   }
+
+  /** Store the corners of the faces of each mesh, and the faces of each point. */
+  this->m_MeshFaces.resize( numberOfMeshes );
+  for( FixedMeshContainerElementIdentifier meshId = 0; meshId < numberOfMeshes; ++meshId )
+  {
+    FixedMeshConstPointer fixedMesh      = this->m_FixedMeshContainer->ElementAt( meshId );
+    const SizeValueType   numberOfPoints = fixedMesh->GetPoints()->Size();
+    const SizeValueType   numberOfFaces  = fixedMesh->GetNumberOfCells();
+    MeshFacesType &       faces          = this->m_MeshFaces[ meshId ];
+
+    faces.m_Corners.assign( FixedPointSetDimension, std::vector< SizeValueType >( numberOfFaces ) );
+    typename FixedMeshType::CellsContainerConstIterator cellIt = fixedMesh->GetCells()->Begin();
+    for( SizeValueType face = 0; face < numberOfFaces; ++face, ++cellIt )
+    {
+      typename CellInterfaceType::PointIdConstIterator pointId = cellIt->Value()->PointIdsBegin();
+      for( unsigned int corner = 0; corner < FixedPointSetDimension; ++corner, ++pointId )
+      {
+        faces.m_Corners[ corner ][ face ] = *pointId;
+      }
+    }
+
+    /** Count the faces of each point, and fill the lists in face order. */
+    faces.m_PointFaceOffsets.assign( numberOfPoints + 1, 0 );
+    for( unsigned int corner = 0; corner < FixedPointSetDimension; ++corner )
+    {
+      for( SizeValueType face = 0; face < numberOfFaces; ++face )
+      {
+        ++faces.m_PointFaceOffsets[ faces.m_Corners[ corner ][ face ] + 1 ];
+      }
+    }
+    for( SizeValueType i = 0; i < numberOfPoints; ++i )
+    {
+      faces.m_PointFaceOffsets[ i + 1 ] += faces.m_PointFaceOffsets[ i ];
+    }
+
+    faces.m_PointFaces.resize( faces.m_PointFaceOffsets[ numberOfPoints ] );
+    faces.m_PointCorners.resize( faces.m_PointFaceOffsets[ numberOfPoints ] );
+    std::vector< SizeValueType > positions( faces.m_PointFaceOffsets.begin(), faces.m_PointFaceOffsets.end() - 1 );
+    for( SizeValueType face = 0; face < numberOfFaces; ++face )
+    {
+      for( unsigned int corner = 0; corner < FixedPointSetDimension; ++corner )
+      {
+        const SizeValueType position = positions[ faces.m_Corners[ corner ][ face ] ]++;
+        faces.m_PointFaces[ position ]   = face;
+        faces.m_PointCorners[ position ] = static_cast< unsigned char >( corner );
+      }
+    }
+  }
+
 } // end Initialize()
 
 
@@ -115,14 +165,10 @@ MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
   /** Initialize some variables */
   MeasureType value = NumericTraits< MeasureType >::Zero;
 
-  //OutputPointType fixedPoint;
-  /** Get the current corresponding points. */
-
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
-  DerivativeType dummyDerivative;
-  this->GetValueAndDerivative( parameters, value, dummyDerivative );
+  this->ComputeValueAndDerivative( value, nullptr );
 
   return value;
 
@@ -167,178 +213,232 @@ MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
     itkExceptionMacro( << "FixedMeshContainer mesh has not been assigned" );
   }
 
-  /** Initialize some variables */
-  value = NumericTraits< MeasureType >::Zero;
-
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
-  derivative = DerivativeType( this->GetNumberOfParameters() );
-  derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  this->ComputeValueAndDerivative( value, &derivative );
 
-  NonZeroJacobianIndicesType nzji( this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
-  TransformJacobianType      jacobian;
-
-  const FixedMeshContainerElementIdentifier numberOfMeshes = this->m_FixedMeshContainer->Size();
-
-  typedef typename FixedMeshType::PointType FixedMeshPointType;
+} // end GetValueAndDerivative()
 
-  FixedMeshPointType zeroPoint = typename FixedMeshPointType::Point();
-  zeroPoint.Fill( 0.0 );
 
-  typename MeshPointsContainerType::Pointer pointCentroids = FixedMeshType::PointsContainer::New();
-  pointCentroids->resize( numberOfMeshes, typename FixedMeshPointType::Point( zeroPoint ) );
+/**
+ * ******************* ComputeSignedVolume *******************
+ */
 
-  for( FixedMeshContainerElementIdentifier meshId = 0; meshId < numberOfMeshes; ++meshId ) // loop over all meshes in container
+template< class TFixedPointSet, class TMovingPointSet >
+float
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::ComputeSignedVolume( const MeshPointsContainerType * mappedPoints,
+  const MeshFacesType & faces, const SizeValueType face,
+  const MeshPointType & centroid, VectorType * corners ) const
+{
+  for( unsigned int corner = 0; corner < FixedPointSetDimension; ++corner )
   {
-    const FixedMeshConstPointer           fixedMesh      = fixedMeshContainer->ElementAt( meshId );
-    const MeshPointsContainerConstPointer fixedPoints    = fixedMesh->GetPoints();
-    const unsigned int                    numberOfPoints = fixedPoints->Size();
+    const MeshPointType & point = mappedPoints->ElementAt( faces.m_Corners[ corner ][ face ] );
+    corners[ corner ] = FixedPointSetDimension == 4
+      ? point.GetVectorFromOrigin() : point - centroid;
+  }
 
-    const FixedMeshPointer           mappedMesh   = this->m_MappedMeshContainer->ElementAt( meshId );
-    const MeshPointsContainerPointer mappedPoints = mappedMesh->GetPoints();
+  switch( static_cast< unsigned int >( FixedPointSetDimension ) )
+  {
+    case 2:
+      return vnl_determinant( corners[ 0 ].GetDataPointer(), corners[ 1 ].GetDataPointer() );
+    case 3:
+      return vnl_determinant( corners[ 0 ].GetDataPointer(), corners[ 1 ].GetDataPointer(),
+        corners[ 2 ].GetDataPointer() );
+    case 4:
+      return vnl_determinant( corners[ 0 ].GetDataPointer(), corners[ 1 ].GetDataPointer(),
+        corners[ 2 ].GetDataPointer(), corners[ 3 ].GetDataPointer() );
+    default:
+      std::cout << "no dimensions higher than 4"  << std::endl;
+      return 0.0;
+  }
 
-    typename FixedMeshType::PointType &              pointCentroid = pointCentroids->ElementAt( meshId );
-    typedef typename FixedMeshType::PointsContainer FixedMeshPointsContainerType;
-    typename FixedMeshType::PointsContainer::Pointer derivPoints = FixedMeshPointsContainerType::New();
+} // end ComputeSignedVolume()
 
-    derivPoints->resize( numberOfPoints, typename FixedMeshPointType::Point( zeroPoint ) );
 
-    MeshPointsContainerConstIteratorType fixedPointIt  = fixedPoints->Begin();
-    MeshPointsContainerIteratorType      mappedPointIt = mappedPoints->Begin();
-    MeshPointsContainerConstIteratorType fixedPointEnd = fixedPoints->End();
+/**
+ * ******************* ComputeValueAndDerivative *******************
+ */
 
-    for(; fixedPointIt != fixedPointEnd; ++fixedPointIt, ++mappedPointIt )
-    {
-      const OutputPointType mappedPoint = this->m_Transform->TransformPoint( fixedPointIt->Value() );
-      mappedPointIt.Value()         = mappedPoint;
-      pointCentroid.GetVnlVector() += mappedPoint.GetVnlVector();
-    }
-    pointCentroid.GetVnlVector() /= numberOfPoints;
+template< class TFixedPointSet, class TMovingPointSet >
+void
+MissingVolumeMeshPenalty< TFixedPointSet, TMovingPointSet >
+::ComputeValueAndDerivative( MeasureType & value, DerivativeType * derivative ) const
+{
+  /** Initialize some variables */
+  value = NumericTraits< MeasureType >::Zero;
 
-    typename FixedMeshType::CellsContainerConstIterator cellBegin = fixedMesh->GetCells()->Begin();
-    typename FixedMeshType::CellsContainerConstIterator cellEnd   = fixedMesh->GetCells()->End();
+  const unsigned int numberOfParameters = this->GetNumberOfParameters();
+  if( derivative )
+  {
+    *derivative = DerivativeType( numberOfParameters );
+    derivative->Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  }
 
-    typename CellInterfaceType::PointIdIterator beginpointer;
-    float sumSignedVolume = 0.0;
-    float sumAbsVolume    = 0.0;
+  const float eps = 0.00001;
 
-    const float eps = 0.00001;
+  const FixedMeshContainerElementIdentifier numberOfMeshes = this->m_FixedMeshContainer->Size();
+  for( FixedMeshContainerElementIdentifier meshId = 0; meshId < numberOfMeshes; ++meshId ) // loop over all meshes in container
+  {
+    const FixedMeshConstPointer           fixedMesh      = this->m_FixedMeshContainer->ElementAt( meshId );
+    const MeshPointsContainerConstPointer fixedPoints    = fixedMesh->GetPoints();
+    const SizeValueType                   numberOfPoints = fixedPoints->Size();
+    const MeshPointsContainerPointer      mappedPoints   = this->m_MappedMeshContainer->ElementAt( meshId )->GetPoints();
+    const MeshFacesType &                 faces          = this->m_MeshFaces[ meshId ];
+    const SizeValueType                   numberOfFaces  = faces.m_Corners[ 0 ].size();
+
+    /** Transform the points, and sum them per chunk for the centroid. */
+    const ThreadIdType        numberOfPointChunks = this->GetNumberOfPointChunks( numberOfPoints );
+    std::vector< VectorType > chunkSums( numberOfPointChunks );
+    this->ProcessPointChunks( numberOfPoints,
+      [ this, &fixedPoints, &mappedPoints, &chunkSums ](
+      const ThreadIdType chunk, const SizeValueType begin, const SizeValueType end )
+      {
+        VectorType sum;
+        sum.Fill( 0.0 );
+        for( SizeValueType i = begin; i < end; ++i )
+        {
+          const OutputPointType mappedPoint = this->m_Transform->TransformPoint( fixedPoints->ElementAt( i ) );
+          mappedPoints->ElementAt( i ) = mappedPoint;
+          sum                         += mappedPoint.GetVectorFromOrigin();
+        }
+        chunkSums[ chunk ] = sum;
+      } );
 
-    for(; cellBegin != cellEnd; ++cellBegin )
+    MeshPointType pointCentroid;
+    pointCentroid.Fill( 0.0 );
+    for( ThreadIdType chunk = 0; chunk < numberOfPointChunks; ++chunk )
+    {
+      pointCentroid += chunkSums[ chunk ];
+    }
+    for( unsigned int d = 0; d < FixedPointSetDimension; ++d )
     {
-      beginpointer = cellBegin->Value()->PointIdsBegin();
-      float signedVolume;  // = vnl_determinant(fullMatrix.GetVnlMatrix());
+      pointCentroid[ d ] /= numberOfPoints;
+    }
 
-      //const VectorType::const_pointer p1,p2,p3,p4;
-      switch( static_cast< unsigned int >( FixedPointSetDimension ) )
+    /** Sum the absolute volumes of the faces per chunk. */
+    std::vector< double > chunkVolumes( this->GetNumberOfPointChunks( numberOfFaces ), 0.0 );
+    this->ProcessPointChunks( numberOfFaces,
+      [ this, &mappedPoints, &faces, &pointCentroid, &chunkVolumes ](
+      const ThreadIdType chunk, const SizeValueType begin, const SizeValueType end )
       {
-        case 2:
+        VectorType corners[ 4 ];
+        double     sumAbsVolume = 0.0;
+        for( SizeValueType face = begin; face < end; ++face )
         {
-          const FixedMeshPointIdentifier p1Id = *beginpointer;
-          ++beginpointer;
-          const VectorType               p1   = mappedPoints->GetElement( p1Id ) - pointCentroid;
-          const FixedMeshPointIdentifier p2Id = *beginpointer;
-          ++beginpointer;
-          const VectorType p2 = mappedPoints->GetElement( p2Id ) - pointCentroid;
+          sumAbsVolume += std::abs( this->ComputeSignedVolume(
+            mappedPoints.GetPointer(), faces, face, pointCentroid, corners ) );
+        }
+        chunkVolumes[ chunk ] = sumAbsVolume;
+      } );
 
-          signedVolume = vnl_determinant( p1.GetDataPointer(), p2.GetDataPointer() );
+    for( const double sumAbsVolume : chunkVolumes )
+    {
+      value += sumAbsVolume;
+    }
 
-          const int sign = ( signedVolume > eps ) - ( signedVolume < -eps );
-          if( sign != 0 )
-          {
-            derivPoints->at( p1Id )[ 0 ] += sign * p2[ 1 ];
-            derivPoints->at( p1Id )[ 1 ] -= sign * p2[ 0 ];
-            derivPoints->at( p2Id )[ 0 ] -= sign * p1[ 1 ];
-            derivPoints->at( p2Id )[ 1 ] += sign * p1[ 0 ];
-          }
+    if( !derivative )
+    {
+      continue;
+    }
 
-        }
-        break;
-        case 3:
-        {
-          const FixedMeshPointIdentifier p1Id = *beginpointer;
-          ++beginpointer;
-          const VectorType               p1   = mappedPoints->GetElement( p1Id ) - pointCentroid;
-          const FixedMeshPointIdentifier p2Id = *beginpointer;
-          ++beginpointer;
-          const VectorType               p2   = mappedPoints->GetElement( p2Id ) - pointCentroid;
-          const FixedMeshPointIdentifier p3Id = *beginpointer;
-          ++beginpointer;
-          const VectorType p3 = mappedPoints->GetElement( p3Id ) - pointCentroid;
+    this->m_ChunkDerivatives.resize( numberOfPointChunks );
+    for( ThreadIdType chunk = 0; chunk < numberOfPointChunks; ++chunk )
+    {
+      this->m_ChunkDerivatives[ chunk ].SetSize( numberOfParameters );
+    }
 
-          signedVolume = vnl_determinant( p1.GetDataPointer(), p2.GetDataPointer(), p3.GetDataPointer() );
+    /** Gather the derivative of the volume with respect to each point from
+     * its faces, and multiply it with the TransformJacobian dT/dmu. The
+     * centroid is treated as a constant.
+     */
+    this->ProcessPointChunks( numberOfPoints,
+      [ this, eps, &fixedPoints, &mappedPoints, &faces, &pointCentroid ](
+      const ThreadIdType chunk, const SizeValueType begin, const SizeValueType end )
+      {
+        DerivativeType & chunkDerivative = this->m_ChunkDerivatives[ chunk ];
+        chunkDerivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
 
-          const int sign = ( ( signedVolume > eps ) - ( signedVolume < -eps ) );
+        NonZeroJacobianIndicesType nzji( this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
+        TransformJacobianType      jacobian;
+        VectorType                 corners[ 4 ];
 
-          if( sign != 0 )
-          {
-            derivPoints->at( p1Id )[ 0 ] += sign * ( p2[ 1 ] * p3[ 2 ] - p2[ 2 ] * p3[ 1 ] );
-            derivPoints->at( p1Id )[ 1 ] += sign * ( p2[ 2 ] * p3[ 0 ] - p2[ 0 ] * p3[ 2 ] );
-            derivPoints->at( p1Id )[ 2 ] += sign * ( p2[ 0 ] * p3[ 1 ] - p2[ 1 ] * p3[ 0 ] );
-
-            derivPoints->at( p2Id )[ 0 ] += sign * ( p1[ 2 ] * p3[ 1 ] - p1[ 1 ] * p3[ 2 ] );
-            derivPoints->at( p2Id )[ 1 ] += sign * ( p1[ 0 ] * p3[ 2 ] - p1[ 2 ] * p3[ 0 ] );
-            derivPoints->at( p2Id )[ 2 ] += sign * ( p1[ 1 ] * p3[ 0 ] - p1[ 0 ] * p3[ 1 ] );
+        for( SizeValueType i = begin; i < end; ++i )
+        {
+          double derivPoint[ FixedPointSetDimension ];
+          std::fill( derivPoint, derivPoint + FixedPointSetDimension, 0.0 );
+          bool nonZero = false;
 
-            derivPoints->at( p3Id )[ 0 ] += sign * ( p1[ 1 ] * p2[ 2 ] - p1[ 2 ] * p2[ 1 ] );
-            derivPoints->at( p3Id )[ 1 ] += sign * ( p1[ 2 ] * p2[ 0 ] - p1[ 0 ] * p2[ 2 ] );
-            derivPoints->at( p3Id )[ 2 ] += sign * ( p1[ 0 ] * p2[ 1 ] - p1[ 1 ] * p2[ 0 ] );
+          for( SizeValueType e = faces.m_PointFaceOffsets[ i ]; e < faces.m_PointFaceOffsets[ i + 1 ]; ++e )
+          {
+            const float signedVolume = this->ComputeSignedVolume(
+              mappedPoints.GetPointer(), faces, faces.m_PointFaces[ e ], pointCentroid, corners );
+            const int sign = ( signedVolume > eps ) - ( signedVolume < -eps );
+            if( sign == 0 )
+            {
+              continue;
+            }
+
+            const unsigned int corner = faces.m_PointCorners[ e ];
+            switch( static_cast< unsigned int >( FixedPointSetDimension ) )
+            {
+              case 2:
+              {
+                /** The determinant is linear in each corner. */
+                const VectorType & other = corners[ 1 - corner ];
+                const int          s     = corner == 0 ? sign : -sign;
+                derivPoint[ 0 ] += s * other[ 1 ];
+                derivPoint[ 1 ] -= s * other[ 0 ];
+                nonZero          = true;
+              }
+              break;
+              case 3:
+              {
+                /** The derivative with respect to a corner is the cross
+                 * product of the next two corners.
+                 */
+                const VectorType & p2 = corners[ ( corner + 1 ) % 3 ];
+                const VectorType & p3 = corners[ ( corner + 2 ) % 3 ];
+                derivPoint[ 0 ] += sign * ( p2[ 1 ] * p3[ 2 ] - p2[ 2 ] * p3[ 1 ] );
+                derivPoint[ 1 ] += sign * ( p2[ 2 ] * p3[ 0 ] - p2[ 0 ] * p3[ 2 ] );
+                derivPoint[ 2 ] += sign * ( p2[ 0 ] * p3[ 1 ] - p2[ 1 ] * p3[ 0 ] );
+                nonZero          = true;
+              }
+              break;
+              default:
+                break;
+            }
+          }
 
+          if( !nonZero )
+          {
+            continue;
           }
-        }
 
-        break;
-        case 4:
-        {
-          const VectorConstPointer p1 = mappedPoints->GetElement( *beginpointer++ ).GetDataPointer();
-          const VectorConstPointer p2 = mappedPoints->GetElement( *beginpointer++ ).GetDataPointer();
-          const VectorConstPointer p3 = mappedPoints->GetElement( *beginpointer++ ).GetDataPointer();
-          const VectorConstPointer p4 = mappedPoints->GetElement( *beginpointer++ ).GetDataPointer();
-          signedVolume = vnl_determinant( p1, p2, p3, p4 );
+          /** Only pick the nonzero Jacobians. */
+          this->m_Transform->GetJacobian( fixedPoints->ElementAt( i ), jacobian, nzji );
+          for( unsigned int j = 0; j < nzji.size(); ++j )
+          {
+            double sum = 0.0;
+            for( unsigned int d = 0; d < FixedPointSetDimension; ++d )
+            {
+              sum += derivPoint[ d ] * jacobian( d, j );
+            }
+            chunkDerivative[ nzji[ j ] ] += sum;
+          }
         }
-        break;
-        default:
-          std::cout << "no dimensions higher than 4"  << std::endl;
-      }
-
-      sumSignedVolume +=  signedVolume;
-      sumAbsVolume    += std::abs( signedVolume );
-    }
+      } );
 
-    /** Create iterators. */
-    fixedPointIt = fixedPoints->Begin();
-    unsigned int pointIndex;
-    /** Loop over points. */
-    for( pointIndex = 0; fixedPointIt != fixedPointEnd; ++fixedPointIt, ++pointIndex )
+    /** Sum the chunks in a fixed order. */
+    for( ThreadIdType chunk = 0; chunk < numberOfPointChunks; ++chunk )
     {
-      /** Get the TransformJacobian dT/dmu. */
-      this->m_Transform->GetJacobian( fixedPointIt.Value(), jacobian, nzji );
-      if( nzji.size() == this->GetNumberOfParameters() )
-      {
-        /** Loop over all Jacobians. */
-        derivative += derivPoints->at( pointIndex ).GetVnlVector() * jacobian; //* sumAbsVolumeEps;
-      }
-      else
-      {
-        /** Only pick the nonzero Jacobians. */
-        for( unsigned int i = 0; i < nzji.size(); ++i )
-        {
-          const unsigned int index  = nzji[ i ];
-          VnlVectorType      column = jacobian.get_column( i );
-          derivative[ index ] += dot_product( derivPoints->at( pointIndex ).GetVnlVector(), column ); // *sumAbsVolumeEps;
-        }
-      }
-
-    } // end loop over all corresponding points
-
-    /** Check if enough samples were valid. */
-
-    /** Copy the measure to value. */
-    value += sumAbsVolume;
+      *derivative += this->m_ChunkDerivatives[ chunk ];
+    }
 
   } // end loop over all meshes in container
-} // end GetValueAndDerivative()
+
+} // end ComputeValueAndDerivative()
 
 
 /**
@@ -19,54 +19,68 @@
 #define __elxMutualInformationHistogramMetric_H__
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
-#include "itkMutualInformationHistogramImageToImageMetric.h"
+#include "elxAdvancedMattesMutualInformationMetric.h"
 
 namespace elastix
 {
 
 /**
  * \class MutualInformationHistogramMetric
- * \brief A metric based on the itk::MutualInformationHistogramImageToImageMetric.
+ * \brief A mutual information metric that bins the samples in a joint histogram.
  *
- * This metric is not yet fully supported. But with a little effort it is!
+ * This metric used to wrap the itk::MutualInformationHistogramImageToImageMetric,
+ * which visits all voxels of the fixed image and uses finite differences for
+ * the derivative. It is now an AdvancedMattesMutualInformationMetric with
+ * zero-order Parzen windows by default, which amounts to plain binning of the
+ * samples, while the derivative follows analytically from the first-order
+ * derivative of the moving kernel. It therefore supports the ImageSampler
+ * framework, multithreading and the low-memory derivative for B-spline
+ * transforms, and parameter files that select this metric keep working.
  *
- * \warning: this metric is not very well tested in elastix.
- * \warning: this metric is not based on the AdvancedImageToImageMetric so
- * does not support the ImageSampler framework and might be very slow in
- * combination with B-spline transform.
+ * \warning: the value is computed on the samples of the ImageSampler, not on
+ * all voxels of the fixed image as before. Use the Full sampler to get the
+ * old behaviour.
  *
  * The parameters used in this class are:
  * \parameter Metric: Select this metric as follows:\n
  *    <tt>(Metric "MutualInformationHistogram")</tt>
+ * \parameter FixedKernelBSplineOrder: The B-spline order of the Parzen
+ *    window of the fixed image. Can be given for each resolution.\n
+ *    <tt>(FixedKernelBSplineOrder 0 1 1)</tt>\n
+ *    The default value is 0 (binning).
+ * \parameter MovingKernelBSplineOrder: The B-spline order of the Parzen
+ *    window of the moving image. Can be given for each resolution.\n
+ *    <tt>(MovingKernelBSplineOrder 0 3 3)</tt>\n
+ *    The default value is 0 (binning).
  *
+ * The other parameters, such as NumberOfHistogramBins and
+ * UseFastAndLowMemoryVersion, are those of the
+ * AdvancedMattesMutualInformationMetric.
+ *
+ * \sa AdvancedMattesMutualInformationMetric
  * \ingroup Metrics
  */
 
 template< class TElastix >
 class MutualInformationHistogramMetric :
-  public
-  itk::MutualInformationHistogramImageToImageMetric<
-  typename MetricBase< TElastix >::FixedImageType,
-  typename MetricBase< TElastix >::MovingImageType >,
-  public MetricBase< TElastix >
+  public AdvancedMattesMutualInformationMetric< TElastix >
 {
 public:
 
   /** Standard ITK-stuff. */
-  typedef MutualInformationHistogramMetric Self;
-  typedef itk::MutualInformationHistogramImageToImageMetric<
-    typename MetricBase< TElastix >::FixedImageType,
-    typename MetricBase< TElastix >::MovingImageType >    Superclass1;
-  typedef MetricBase< TElastix >          Superclass2;
-  typedef itk::SmartPointer< Self >       Pointer;
-  typedef itk::SmartPointer< const Self > ConstPointer;
+  typedef MutualInformationHistogramMetric                                        Self;
+  typedef AdvancedMattesMutualInformationMetric< TElastix >                       Superclass;
+  typedef typename AdvancedMattesMutualInformationMetric< TElastix >::Superclass1 Superclass1;
+  typedef typename AdvancedMattesMutualInformationMetric< TElastix >::Superclass2 Superclass2;
+  typedef itk::SmartPointer< Self >                                               Pointer;
+  typedef itk::SmartPointer< const Self >                                         ConstPointer;
 
   /** Method for creation through the object factory. */
   itkNewMacro( Self );
 
   /** Run-time type information (and related methods). */
   itkTypeMacro( MutualInformationHistogramMetric,
-    itk::MutualInformationHistogramImageToImageMetric );
+    AdvancedMattesMutualInformationMetric );
 
   /** Name of this class.
    * Use this name in the parameter file to select this specific metric. \n
@@ -75,46 +89,18 @@ public:
   elxClassNameMacro( "MutualInformationHistogram" );
 
   /** Typedefs inherited from the superclass. */
-  typedef typename Superclass1::TransformType           TransformType;
-  typedef typename Superclass1::TransformPointer        TransformPointer;
-  typedef typename Superclass1::TransformJacobianType   TransformJacobianType;
-  typedef typename Superclass1::InterpolatorType        InterpolatorType;
-  typedef typename Superclass1::MeasureType             MeasureType;
-  typedef typename Superclass1::DerivativeType          DerivativeType;
-  typedef typename Superclass1::ParametersType          ParametersType;
-  typedef typename Superclass1::FixedImageType          FixedImageType;
-  typedef typename Superclass1::MovingImageType         MovingImageType;
-  typedef typename Superclass1::FixedImageConstPointer  FixedImageConstPointer;
-  typedef typename Superclass1::MovingImageConstPointer MovingImageCosntPointer;
-  typedef typename Superclass1::ScalesType              ScalesType;
-
-  /** The moving image dimension. */
-  itkStaticConstMacro( MovingImageDimension, unsigned int,
-    MovingImageType::ImageDimension );
-
-  /** Typedef's inherited from Elastix. */
-  typedef typename Superclass2::ElastixType          ElastixType;
-  typedef typename Superclass2::ElastixPointer       ElastixPointer;
-  typedef typename Superclass2::ConfigurationType    ConfigurationType;
-  typedef typename Superclass2::ConfigurationPointer ConfigurationPointer;
-  typedef typename Superclass2::RegistrationType     RegistrationType;
-  typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
-  typedef typename Superclass2::ITKBaseType          ITKBaseType;
-
-  /** Execute stuff before the actual registration:
-   * \li Nothing yet: still to be implemented.
-   */
-  void BeforeRegistration( void ) override;
+  typedef typename Superclass::FixedImageType  FixedImageType;
+  typedef typename Superclass::MovingImageType MovingImageType;
 
-  /** Execute stuff before each new pyramid resolution:
-   * \li Nothing yet: still to be implemented.
+  /** Sets up a timer to measure the initialization time and calls the
+   * Superclass' implementation.
    */
-  void BeforeEachResolution( void ) override;
+  void Initialize( void ) override;
 
-  /** Sets up a timer to measure the initialization time and
-   * calls the Superclass' implementation.
+  /** Calls the Superclass' implementation, and reads the kernel orders
+   * with the binning defaults of this metric.
    */
-  void Initialize( void ) override;
+  void BeforeEachResolution( void ) override;
 
 protected:
 
@@ -126,9 +112,9 @@ protected:
 private:
 
   /** The private constructor. */
-  MutualInformationHistogramMetric( const Self & );   // purposely not implemented
+  MutualInformationHistogramMetric( const Self & ); // purposely not implemented
   /** The private copy constructor. */
-  void operator=( const Self & );                     // purposely not implemented
+  void operator=( const Self & );                   // purposely not implemented
 
 };
 
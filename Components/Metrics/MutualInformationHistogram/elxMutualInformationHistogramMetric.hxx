@@ -53,21 +53,6 @@ MutualInformationHistogramMetric< TElastix >
 } // end Initialize()
 
 
-/**
- * ******************* BeforeRegistration ***********************
- */
-
-template< class TElastix >
-void
-MutualInformationHistogramMetric< TElastix >
-::BeforeRegistration( void )
-{
-  /** This exception can be removed once this class is fully implemented. */
-  itkExceptionMacro( << "ERROR: This class is not yet fully implemented." );
-
-} // end BeforeRegistration()
-
-
 /**
  * ***************** BeforeEachResolution ***********************
  */
@@ -77,32 +62,25 @@ void
 MutualInformationHistogramMetric< TElastix >
 ::BeforeEachResolution( void )
 {
-  /** \todo adapt SecondOrderRegularisationMetric.
-   * Set alpha, which balances the similarity and deformation energy
-   * E_total = (1-alpha)*E_sim + alpha*E_def.
-   * metric->SetAlpha( config.GetAlpha(level) );
-   */
+  /** Read the parameters of the Parzen window mutual information. */
+  this->Superclass::BeforeEachResolution();
+
+  /** Get the current resolution level. */
+  const unsigned int level
+    = ( this->m_Registration->GetAsITKBaseType() )->GetCurrentLevel();
 
-  const unsigned int nrOfParameters = this->m_Elastix->GetElxTransformBase()
-    ->GetAsITKBaseType()->GetNumberOfParameters();
-  ScalesType derivativeStepLengthScales( nrOfParameters );
-  derivativeStepLengthScales.Fill( 1.0 );
-
-  /** Read the parameters from the ParameterFile.*
-  this->m_Configuration->ReadParameter( histogramSize, "HistogramSize", 0 );
-  this->m_Configuration->ReadParameter( paddingValue, "PaddingValue", 0 );
-  this->m_Configuration->ReadParameter( derivativeStepLength, "DerivativeStepLength", 0 );
-  this->m_Configuration->ReadParameter( derivativeStepLengthScales, "DerivativeStepLengthScales", 0 );
-  this->m_Configuration->ReadParameter( upperBoundIncreaseFactor, "UpperBoundIncreaseFactor", 0 );
-  this->m_Configuration->ReadParameter( usePaddingValue, "UsePaddingValue", 0 );
-  */
-  /** Set them.*/
-  //this->SetHistogramSize( ?? );
-  //this->SetPaddingValue( ?? );
-  //this->SetDerivativeStepLength( ?? );
-  this->SetDerivativeStepLengthScales( derivativeStepLengthScales );
-  //this->SetUpperBoundIncreaseFactor( ?? );
-  //this->SetUsePaddingValue( ?? );
+  /** Bin the samples by default, instead of using cubic Parzen windows
+   * for the moving image. The derivative is then computed with the
+   * first-order derivative kernel.
+   */
+  unsigned int fixedKernelBSplineOrder  = 0;
+  unsigned int movingKernelBSplineOrder = 0;
+  this->GetConfiguration()->ReadParameter( fixedKernelBSplineOrder,
+    "FixedKernelBSplineOrder", this->GetComponentLabel(), level, 0 );
+  this->GetConfiguration()->ReadParameter( movingKernelBSplineOrder,
+    "MovingKernelBSplineOrder", this->GetComponentLabel(), level, 0 );
+  this->SetFixedKernelBSplineOrder( fixedKernelBSplineOrder );
+  this->SetMovingKernelBSplineOrder( movingKernelBSplineOrder );
 
 } // end BeforeEachResolution()
 
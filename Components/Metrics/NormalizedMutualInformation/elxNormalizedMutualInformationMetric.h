@@ -64,6 +64,17 @@ namespace elastix
  *    useful if you use high order B-spline interpolator for the moving image.\n
  *    example: <tt>(MovingLimitRangeRatio 0.001 0.01 0.01)</tt> \n
  *    The default value is 0.01. Can be given for each resolution, or for all resolutions at once.
+ * \parameter PDFAccumulationMode: Either "ThreadPrivate" (one joint histogram per thread) or "Sharded"
+ *    (one shared joint histogram, of which each thread fills a band of fixed image bins).
+ *    Can be given for each resolution, or for all resolutions at once. \n
+ *    example: <tt>(PDFAccumulationMode "Sharded")</tt> \n
+ *    The default value is "ThreadPrivate".
+ * \parameter UseFixedParzenWindowCache: Whether to compute the fixed Parzen window of every sample
+ *    only once for as long as the samples do not change, for example with a "Full" or "Grid" sampler,
+ *    or with NewSamplesEveryIteration set to "false". Used for the multi-threaded joint histogram.
+ *    Can be given for each resolution, or for all resolutions at once. \n
+ *    example: <tt>(UseFixedParzenWindowCache "true")</tt> \n
+ *    The default value is false.
  *
  * \sa ParzenWindowNormalizedMutualInformationImageToImageMetric
  * \ingroup Metrics
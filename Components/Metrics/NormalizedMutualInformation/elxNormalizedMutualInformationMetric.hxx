@@ -102,6 +102,23 @@ NormalizedMutualInformationMetric< TElastix >
   this->SetFixedKernelBSplineOrder( fixedKernelBSplineOrder );
   this->SetMovingKernelBSplineOrder( movingKernelBSplineOrder );
 
+  /** Set the joint histogram accumulation mode. */
+  std::string pdfAccumulationMode = "ThreadPrivate";
+  this->GetConfiguration()->ReadParameter( pdfAccumulationMode,
+    "PDFAccumulationMode", this->GetComponentLabel(), level, 0 );
+  if( pdfAccumulationMode != "ThreadPrivate" && pdfAccumulationMode != "Sharded" )
+  {
+    xl::xout[ "warning" ] << "WARNING: PDFAccumulationMode \"" << pdfAccumulationMode
+                          << "\" is not supported, using \"ThreadPrivate\"." << std::endl;
+  }
+  this->SetUseShardedPDFAccumulation( pdfAccumulationMode == "Sharded" );
+
+  /** Set whether the fixed Parzen windows of the samples are cached. */
+  bool useFixedParzenWindowCache = false;
+  this->GetConfiguration()->ReadParameter( useFixedParzenWindowCache,
+    "UseFixedParzenWindowCache", this->GetComponentLabel(), level, 0 );
+  this->SetUseFixedParzenWindowCache( useFixedParzenWindowCache );
+
 } // end BeforeEachResolution()
 
 
@@ -0,0 +1,185 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxOpenCLAdvancedMeanSquaresMetric_h
+#define __elxOpenCLAdvancedMeanSquaresMetric_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "elxAdvancedMeanSquaresMetric.h"
+#include "itkGPUAdvancedMeanSquaresImageToImageMetric.h"
+
+namespace elastix
+{
+
+/**
+ * \class OpenCLAdvancedMeanSquaresMetric
+ * \brief An AdvancedMeanSquaresMetric that computes the value and derivative
+ * with OpenCL.
+ *
+ * GetValueAndDerivative() is computed on the GPU by the
+ * itk::GPUAdvancedMeanSquaresImageToImageMetric, for a B-spline transform
+ * without an initial transform, a 3D moving image that is interpolated
+ * linearly, no moving mask, no limiters, no moving image derivative scales
+ * and no sample weights. Otherwise, and if the OpenCL context has not been
+ * created or the computation fails, the CPU implementation of the
+ * AdvancedMeanSquaresMetric is used. The device works in single precision,
+ * so the results equal those of the CPU up to rounding.
+ *
+ * The moving image is copied to the GPU once per resolution, and the samples
+ * whenever the sampler produces new ones.
+ *
+ * In the hybrid mode the GPU evaluates a fraction of the samples, while the
+ * CPU threads evaluate the others. The sums of both are then normalized
+ * together. After each iteration the fraction is moved halfway towards the
+ * fraction at which both would take equally long, according to the measured
+ * numbers of samples per second of both, within [0.05, 0.95].
+ *
+ * The parameters used in this class are:
+ * \parameter Metric: Select this metric as follows:\n
+ *    <tt>(Metric "OpenCLAdvancedMeanSquares")</tt>
+ * \parameter OpenCLAdvancedMeanSquaresUseOpenCL: Enable the OpenCL computation.
+ *    Can be given for each resolution.\n
+ *    <tt>(OpenCLAdvancedMeanSquaresUseOpenCL "true")</tt>\n
+ *    The default value is true.
+ * \parameter OpenCLAdvancedMeanSquaresHybrid: Evaluate the samples on the
+ *    GPU and on the CPU threads simultaneously. Can be given for each
+ *    resolution.\n
+ *    <tt>(OpenCLAdvancedMeanSquaresHybrid "true")</tt>\n
+ *    The default value is false.
+ * \parameter OpenCLAdvancedMeanSquaresGPUFraction: The fraction of the
+ *    samples that the GPU evaluates in the first iteration of the hybrid
+ *    mode. Can be given for each resolution.\n
+ *    <tt>(OpenCLAdvancedMeanSquaresGPUFraction 0.8)</tt>\n
+ *    The default value is 0.5.
+ *
+ * The other parameters are those of the AdvancedMeanSquaresMetric.
+ *
+ * \sa AdvancedMeanSquaresMetric
+ * \ingroup Metrics
+ */
+
+template< class TElastix >
+class OpenCLAdvancedMeanSquaresMetric :
+  public AdvancedMeanSquaresMetric< TElastix >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef OpenCLAdvancedMeanSquaresMetric                             Self;
+  typedef AdvancedMeanSquaresMetric< TElastix >                       Superclass;
+  typedef typename AdvancedMeanSquaresMetric< TElastix >::Superclass1 Superclass1;
+  typedef typename AdvancedMeanSquaresMetric< TElastix >::Superclass2 Superclass2;
+  typedef itk::SmartPointer< Self >                                   Pointer;
+  typedef itk::SmartPointer< const Self >                             ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( OpenCLAdvancedMeanSquaresMetric, AdvancedMeanSquaresMetric );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific metric. \n
+   * example: <tt>(Metric "OpenCLAdvancedMeanSquares")</tt>\n
+   */
+  elxClassNameMacro( "OpenCLAdvancedMeanSquares" );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass::FixedImageType           FixedImageType;
+  typedef typename Superclass::MovingImageType          MovingImageType;
+  typedef typename Superclass::MeasureType              MeasureType;
+  typedef typename Superclass::DerivativeType           DerivativeType;
+  typedef typename Superclass::TransformParametersType  TransformParametersType;
+  typedef typename Superclass::ImageSampleContainerType ImageSampleContainerType;
+  typedef typename
+    Superclass::ImageSampleContainerPointer ImageSampleContainerPointer;
+
+  /** The GPU implementation. */
+  typedef itk::GPUAdvancedMeanSquaresImageToImageMetric<
+    FixedImageType, MovingImageType >                 GPUMetricType;
+  typedef typename GPUMetricType::Pointer GPUMetricPointer;
+
+  /** Calls the Superclass' implementation, and reads whether OpenCL is used
+   * in this resolution.
+   */
+  void BeforeEachResolution( void ) override;
+
+  /** Compute the value and derivative on the GPU, if it supports the
+   * configuration, and on the CPU otherwise.
+   */
+  void GetValueAndDerivative( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const override;
+
+protected:
+
+  /** The constructor. */
+  OpenCLAdvancedMeanSquaresMetric();
+  /** The destructor. */
+  ~OpenCLAdvancedMeanSquaresMetric() override {}
+
+private:
+
+  /** The private constructor. */
+  OpenCLAdvancedMeanSquaresMetric( const Self & ); // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );                  // purposely not implemented
+
+  /** Check whether the GPU supports the current configuration. */
+  bool IsSupportedByGPU( void ) const;
+
+  /** Set the parameters, update the samples, and copy the moving image,
+   * the samples and the B-spline grid to the GPU when they have changed.
+   */
+  void PrepareGPUMetric( const TransformParametersType & parameters ) const;
+
+  /** Compute the sum of the squared differences and its derivative on the
+   * GPU, and set the number of pixels counted.
+   */
+  void ComputeSumsWithOpenCL( const TransformParametersType & parameters,
+    double & measure, DerivativeType & derivative ) const;
+
+  /** Compute the value and derivative with the GPU and the CPU threads
+   * together, and adapt the fraction of the samples of the GPU.
+   */
+  void ComputeValueAndDerivativeHybrid( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const;
+
+  /** Helper method to report switching to CPU mode. */
+  void SwitchingToCPUAndReport( const bool configError ) const;
+
+  /** Helper method to report to elastix log. */
+  void ReportToLog( void ) const;
+
+  mutable GPUMetricPointer        m_GPUMetric;
+  mutable const MovingImageType * m_GPUMovingImageSource;
+  mutable itk::ModifiedTimeType   m_GPUMovingImageMTime;
+  mutable itk::ModifiedTimeType   m_GPUSamplesMTime;
+  mutable bool                    m_GPUMetricReady;
+  mutable bool                    m_ReportedToLog;
+  mutable double                  m_GPUFraction;
+  bool                            m_ContextCreated;
+  bool                            m_UseOpenCL;
+  bool                            m_UseHybrid;
+};
+
+} // end namespace elastix
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "elxOpenCLAdvancedMeanSquaresMetric.hxx"
+#endif
+
+#endif // end #ifndef __elxOpenCLAdvancedMeanSquaresMetric_h
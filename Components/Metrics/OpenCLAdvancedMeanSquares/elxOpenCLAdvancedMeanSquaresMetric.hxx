@@ -0,0 +1,482 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxOpenCLAdvancedMeanSquaresMetric_hxx
+#define __elxOpenCLAdvancedMeanSquaresMetric_hxx
+
+#include "elxOpenCLAdvancedMeanSquaresMetric.h"
+
+// GPU includes
+#include "itkOpenCLContext.h"
+#include "itkOpenCLLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+
+namespace elastix
+{
+
+/**
+ * ******************* Constructor ***********************
+ */
+
+template< class TElastix >
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::OpenCLAdvancedMeanSquaresMetric() :
+  m_GPUMovingImageSource( nullptr ),
+  m_GPUMovingImageMTime( 0 ),
+  m_GPUSamplesMTime( 0 ),
+  m_GPUMetricReady( true ),
+  m_ReportedToLog( false ),
+  m_GPUFraction( 0.5 ),
+  m_ContextCreated( false ),
+  m_UseOpenCL( true ),
+  m_UseHybrid( false )
+{
+  // The OpenCL implementation supports 3D images only.
+  if( Superclass1::MovingImageDimension != 3 )
+  {
+    this->m_GPUMetricReady = false;
+    return;
+  }
+
+  // Check if the OpenCL context has been created.
+  itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+  this->m_ContextCreated = context->IsCreated();
+  if( this->m_ContextCreated )
+  {
+    try
+    {
+      this->m_GPUMetric = GPUMetricType::New();
+    }
+    catch( itk::OpenCLCompileError & e )
+    {
+      itk::OpenCLLogger::Pointer logger = itk::OpenCLLogger::GetInstance();
+      logger->Write( itk::LoggerBase::CRITICAL, e.GetDescription() );
+      this->SwitchingToCPUAndReport( true );
+    }
+    catch( itk::ExceptionObject & e )
+    {
+      xl::xout[ "error" ] << "ERROR: Exception during GPU mean squares metric creation: " << e << std::endl;
+      this->SwitchingToCPUAndReport( true );
+    }
+  }
+  else
+  {
+    this->SwitchingToCPUAndReport( false );
+  }
+} // end Constructor
+
+
+/**
+ * ***************** BeforeEachResolution ***********************
+ */
+
+template< class TElastix >
+void
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::BeforeEachResolution( void )
+{
+  this->Superclass::BeforeEachResolution();
+
+  /** Get the current resolution level. */
+  unsigned int level
+    = ( this->m_Registration->GetAsITKBaseType() )->GetCurrentLevel();
+
+  /** Are we using a OpenCL enabled GPU for the metric? */
+  this->m_UseOpenCL = true;
+  this->GetConfiguration()->ReadParameter( this->m_UseOpenCL,
+    "OpenCLAdvancedMeanSquaresUseOpenCL", this->GetComponentLabel(), level, 0 );
+
+  /** Are the samples split between the GPU and the CPU? */
+  this->m_UseHybrid = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseHybrid,
+    "OpenCLAdvancedMeanSquaresHybrid", this->GetComponentLabel(), level, 0 );
+  this->m_GPUFraction = 0.5;
+  this->GetConfiguration()->ReadParameter( this->m_GPUFraction,
+    "OpenCLAdvancedMeanSquaresGPUFraction", this->GetComponentLabel(), level, 0 );
+  this->m_GPUFraction = std::min( 1.0, std::max( 0.0, this->m_GPUFraction ) );
+
+  /** The moving image and the samples are copied again. */
+  this->m_GPUMovingImageSource = nullptr;
+  this->m_GPUSamplesMTime      = 0;
+  this->m_ReportedToLog        = false;
+
+} // end BeforeEachResolution()
+
+
+/**
+ * ******************* IsSupportedByGPU ***********************
+ */
+
+template< class TElastix >
+bool
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::IsSupportedByGPU( void ) const
+{
+  typedef typename Superclass1::CombinationTransformType   CombinationTransformType;
+  typedef typename Superclass1::BSplineOrder1TransformType BSplineOrder1TransformType;
+  typedef typename Superclass1::BSplineOrder2TransformType BSplineOrder2TransformType;
+  typedef typename Superclass1::BSplineOrder3TransformType BSplineOrder3TransformType;
+
+  /** A B-spline transform, possibly as the only transform of a combination. */
+  const typename Superclass1::AdvancedTransformType * transform = this->m_AdvancedTransform.GetPointer();
+  const CombinationTransformType * comboTransform
+    = dynamic_cast< const CombinationTransformType * >( transform );
+  if( comboTransform )
+  {
+    if( comboTransform->GetInitialTransform() != nullptr )
+    {
+      return false;
+    }
+    transform = dynamic_cast< const typename Superclass1::AdvancedTransformType * >(
+      comboTransform->GetCurrentTransform() );
+  }
+  if( dynamic_cast< const BSplineOrder1TransformType * >( transform ) == nullptr
+    && dynamic_cast< const BSplineOrder2TransformType * >( transform ) == nullptr
+    && dynamic_cast< const BSplineOrder3TransformType * >( transform ) == nullptr )
+  {
+    return false;
+  }
+
+  /** A linear interpolator, or a first order B-spline interpolator. */
+  bool interpolatorIsLinear = false;
+  if( this->m_InterpolatorIsLinear )
+  {
+    interpolatorIsLinear = !this->m_LinearInterpolator->GetUseGradientImage();
+  }
+  else if( this->m_InterpolatorIsBSpline )
+  {
+    interpolatorIsLinear = this->m_BSplineInterpolator->GetSplineOrder() == 1;
+  }
+
+  return interpolatorIsLinear
+         && !this->GetComputeGradient()
+         && this->GetMovingImageMask() == nullptr
+         && !this->GetUseFixedImageLimiter()
+         && !this->GetUseMovingImageLimiter()
+         && !this->GetUseMovingImageDerivativeScales()
+         && this->GetImageSampleWeights() == nullptr;
+
+} // end IsSupportedByGPU()
+
+
+/**
+ * ******************* GetValueAndDerivative ***********************
+ */
+
+template< class TElastix >
+void
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::GetValueAndDerivative( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  if( !this->m_ContextCreated || !this->m_UseOpenCL
+    || !this->m_GPUMetricReady || !this->IsSupportedByGPU() )
+  {
+    // Switch to CPU version
+    Superclass1::GetValueAndDerivative( parameters, value, derivative );
+    return;
+  }
+
+  /** The hybrid mode needs the threaded CPU implementation. */
+  const bool useHybrid = this->m_UseHybrid && this->m_UseMultiThread;
+
+  double measure             = 0.0;
+  bool   computedUsingOpenCL = true;
+  try
+  {
+    if( useHybrid )
+    {
+      this->ComputeValueAndDerivativeHybrid( parameters, value, derivative );
+    }
+    else
+    {
+      this->ComputeSumsWithOpenCL( parameters, measure, derivative );
+    }
+  }
+  catch( itk::OpenCLCompileError & e )
+  {
+    // First log then report OpenCL compile error
+    itk::OpenCLLogger::Pointer logger = itk::OpenCLLogger::GetInstance();
+    logger->Write( itk::LoggerBase::CRITICAL, e.GetDescription() );
+
+    xl::xout[ "error" ] << "ERROR: OpenCL program has not been compiled"
+                        << " during the GPU mean squares metric calculation." << std::endl
+                        << "  Please check the '" << logger->GetLogFileName()
+                        << "' in output directory." << std::endl;
+    computedUsingOpenCL = false;
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    xl::xout[ "error" ] << "ERROR: Exception during the GPU mean squares metric calculation: " << e << std::endl;
+    computedUsingOpenCL = false;
+  }
+
+  if( !computedUsingOpenCL )
+  {
+    this->SwitchingToCPUAndReport( true );
+    Superclass1::GetValueAndDerivative( parameters, value, derivative );
+    return;
+  }
+  this->ReportToLog();
+  if( useHybrid )
+  {
+    return;
+  }
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples(
+    this->GetNumberOfFixedImageSamples(), this->m_NumberOfPixelsCounted );
+
+  /** Compute the measure value and derivative. */
+  double normal_sum = 0.0;
+  if( this->m_NumberOfPixelsCounted > 0 )
+  {
+    normal_sum = this->m_NormalizationFactor
+      / static_cast< double >( this->m_NumberOfPixelsCounted );
+  }
+  value       = measure * normal_sum;
+  derivative *= normal_sum;
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ******************* PrepareGPUMetric ***********************
+ */
+
+template< class TElastix >
+void
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::PrepareGPUMetric( const TransformParametersType & parameters ) const
+{
+  typedef typename Superclass1::CombinationTransformType CombinationTransformType;
+  typedef itk::AdvancedBSplineDeformableTransformBase<
+    typename Superclass1::ScalarType, Superclass1::FixedImageDimension > BSplineTransformBaseType;
+
+  /** Set the parameters and update the samples, see
+   * Superclass1::GetValueAndDerivative().
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+
+  /** Copy the moving image once per resolution. */
+  const MovingImageType * movingImage = this->GetMovingImage();
+  if( this->m_GPUMovingImageSource != movingImage
+    || this->m_GPUMovingImageMTime != movingImage->GetMTime() )
+  {
+    this->m_GPUMetric->SetMovingImage( movingImage );
+    this->m_GPUMovingImageSource = movingImage;
+    this->m_GPUMovingImageMTime  = movingImage->GetMTime();
+  }
+
+  /** Copy the samples when the sampler produced new ones. They are read in
+   * the order of the CPU threads, also when the sampler describes them
+   * implicitly.
+   */
+  if( this->m_GPUSamplesMTime != sampleContainer->GetUpdateMTime() )
+  {
+    typedef typename Superclass1::FixedImagePointType FixedImagePointType;
+    typedef typename Superclass1::RealType            RealType;
+    const unsigned int  batchSize       = Superclass1::MovingImageBatchSize;
+    const SizeValueType numberOfSamples = this->GetNumberOfFixedImageSamples();
+    std::vector< FixedImagePointType > points( numberOfSamples );
+    std::vector< float >               values( numberOfSamples );
+    RealType                           batchValues[ batchSize ];
+    for( SizeValueType begin = 0; begin < numberOfSamples; begin += batchSize )
+    {
+      const SizeValueType n = std::min< SizeValueType >( batchSize, numberOfSamples - begin );
+      this->GetFixedImageSamples( begin, n, &points[ begin ], batchValues );
+      for( SizeValueType i = 0; i < n; ++i )
+      {
+        values[ begin + i ] = static_cast< float >( batchValues[ i ] );
+      }
+    }
+    this->m_GPUMetric->SetFixedSamples( points, values );
+    this->m_GPUSamplesMTime = sampleContainer->GetUpdateMTime();
+  }
+
+  /** The grid of the B-spline transform, which changes per resolution. */
+  const CombinationTransformType * comboTransform
+    = dynamic_cast< const CombinationTransformType * >( this->m_AdvancedTransform.GetPointer() );
+  const BSplineTransformBaseType * bsplineTransform = comboTransform
+    ? dynamic_cast< const BSplineTransformBaseType * >( comboTransform->GetCurrentTransform() )
+    : dynamic_cast< const BSplineTransformBaseType * >( this->m_AdvancedTransform.GetPointer() );
+  unsigned int splineOrder = 3;
+  if( dynamic_cast< const typename Superclass1::BSplineOrder1TransformType * >( bsplineTransform ) )
+  {
+    splineOrder = 1;
+  }
+  else if( dynamic_cast< const typename Superclass1::BSplineOrder2TransformType * >( bsplineTransform ) )
+  {
+    splineOrder = 2;
+  }
+  this->m_GPUMetric->SetGrid( bsplineTransform->GetCoefficientImages()[ 0 ].GetPointer(), splineOrder );
+
+} // end PrepareGPUMetric()
+
+
+/**
+ * ******************* ComputeSumsWithOpenCL ***********************
+ */
+
+template< class TElastix >
+void
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::ComputeSumsWithOpenCL( const TransformParametersType & parameters,
+  double & measure, DerivativeType & derivative ) const
+{
+  this->PrepareGPUMetric( parameters );
+
+  /** Compute the sums on the GPU. */
+  SizeValueType numberOfPixelsCounted = 0;
+  this->m_GPUMetric->GetValueAndDerivative( parameters, measure, derivative, numberOfPixelsCounted );
+  this->m_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+} // end ComputeSumsWithOpenCL()
+
+
+/**
+ * ******************* ComputeValueAndDerivativeHybrid ***********************
+ */
+
+template< class TElastix >
+void
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::ComputeValueAndDerivativeHybrid( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  typedef std::chrono::steady_clock ClockType;
+
+  this->PrepareGPUMetric( parameters );
+
+  /** The GPU evaluates the first samples, the CPU threads the others. */
+  const SizeValueType numberOfSamples    = this->GetNumberOfFixedImageSamples();
+  const SizeValueType numberOfGPUSamples = std::min< SizeValueType >( numberOfSamples,
+    static_cast< SizeValueType >( this->m_GPUFraction * numberOfSamples + 0.5 ) );
+
+  /** The GPU is driven by another thread, while this one runs the CPU threads. */
+  double         gpuMeasure               = 0.0;
+  DerivativeType gpuDerivative;
+  SizeValueType  gpuNumberOfPixelsCounted = 0;
+  double         gpuSeconds               = 0.0;
+  std::future< void > gpuResult = std::async( std::launch::async, [ & ]()
+    {
+      const ClockType::time_point start = ClockType::now();
+      this->m_GPUMetric->GetValueAndDerivative( parameters, gpuMeasure,
+        gpuDerivative, gpuNumberOfPixelsCounted, numberOfGPUSamples );
+      gpuSeconds = std::chrono::duration< double >( ClockType::now() - start ).count();
+    } );
+
+  const ClockType::time_point cpuStart = ClockType::now();
+  this->m_FirstThreadedSample = numberOfGPUSamples;
+  this->LaunchGetValueAndDerivativeThreaderCallback();
+  this->m_FirstThreadedSample = 0;
+  const double cpuSeconds = std::chrono::duration< double >( ClockType::now() - cpuStart ).count();
+
+  try
+  {
+    gpuResult.get();
+  }
+  catch( ... )
+  {
+    /** Clear the sums of the threads, before the CPU takes over. */
+    this->InitializeThreadingParameters();
+    throw;
+  }
+
+  /** Add the sums of the GPU to those of the first thread, so that they are
+   * checked and normalized with the number of pixels counted by both.
+   */
+  this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_Value                 += gpuMeasure;
+  this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted += gpuNumberOfPixelsCounted;
+  this->AfterThreadedGetValueAndDerivative( value, derivative );
+  const double normal_sum = this->m_NormalizationFactor
+    / static_cast< double >( this->m_NumberOfPixelsCounted );
+  derivative += gpuDerivative * normal_sum;
+
+  /** Move the fraction of the GPU halfway to the one that balances the
+   * measured throughputs of both.
+   */
+  if( numberOfGPUSamples > 0 && numberOfGPUSamples < numberOfSamples
+    && gpuSeconds > 0.0 && cpuSeconds > 0.0 )
+  {
+    const double gpuRate  = static_cast< double >( numberOfGPUSamples ) / gpuSeconds;
+    const double cpuRate  = static_cast< double >( numberOfSamples - numberOfGPUSamples ) / cpuSeconds;
+    const double balanced = gpuRate / ( gpuRate + cpuRate );
+    this->m_GPUFraction = std::min( 0.95, std::max( 0.05, 0.5 * ( this->m_GPUFraction + balanced ) ) );
+  }
+
+} // end ComputeValueAndDerivativeHybrid()
+
+
+/**
+ * ************************* SwitchingToCPUAndReport ************************
+ */
+
+template< class TElastix >
+void
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::SwitchingToCPUAndReport( const bool configError ) const
+{
+  if( !configError )
+  {
+    xl::xout[ "warning" ] << "WARNING: The OpenCL context could not be created.\n";
+    xl::xout[ "warning" ] << "  The OpenCLAdvancedMeanSquares is switching back to CPU mode." << std::endl;
+  }
+  else
+  {
+    xl::xout[ "warning" ] << "WARNING: Unable to configure the GPU.\n";
+    xl::xout[ "warning" ] << "  The OpenCLAdvancedMeanSquares is switching back to CPU mode." << std::endl;
+  }
+  this->m_GPUMetricReady = false;
+
+} // end SwitchingToCPUAndReport()
+
+
+/**
+ * ************************* ReportToLog ************************************
+ */
+
+template< class TElastix >
+void
+OpenCLAdvancedMeanSquaresMetric< TElastix >
+::ReportToLog( void ) const
+{
+  if( this->m_ReportedToLog )
+  {
+    return;
+  }
+  itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+  itk::OpenCLDevice           device  = context->GetDefaultDevice();
+  elxout << "  Mean squares metric is computed by "
+         <<  device.GetName() << " from " << device.GetVendor();
+  if( this->m_UseHybrid && this->m_UseMultiThread )
+  {
+    elxout << ", together with the CPU threads";
+  }
+  elxout << "." << std::endl;
+  this->m_ReportedToLog = true;
+
+} // end ReportToLog()
+
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxOpenCLAdvancedMeanSquaresMetric_hxx
@@ -54,6 +54,11 @@ namespace elastix
  *    image, without using a fixed image. Possible values are "true" or "false".
  * \parameter NumEigenValues: number of eigenvalues used in the metric: sum(e) - e, where sum(e)
  *  is the sum of all eigenvalues and e is the sum of the first highest NumEigenValues eigenvalues.
+ * \parameter UseSubspaceIteration: compute the highest NumEigenValues eigenvalues by subspace
+ *    iteration, starting from the eigenvectors of the previous iteration, instead of by a full
+ *    eigendecomposition. Possible values are "true" or "false". Can be specified for each resolution.\n
+ *    example: <tt>(UseSubspaceIteration "true")</tt> \n
+ *    The default is true.
  *
  * \ingroup RegistrationMetrics
  * \ingroup Metrics
@@ -61,6 +61,12 @@ PCAMetric< TElastix >
     this->GetComponentLabel(), level, 0 );
   this->SetNumEigenValues( NumEigenValues );
 
+  /** Get and set if the eigenvalues are computed by warm-started subspace iteration. */
+  bool useSubspaceIteration = true;
+  this->GetConfiguration()->ReadParameter( useSubspaceIteration,
+    "UseSubspaceIteration", this->GetComponentLabel(), level, 0 );
+  this->SetUseSubspaceIteration( useSubspaceIteration );
+
   /** Get and set if we want to subtract the mean from the derivative. */
   bool subtractMean = false;
   this->GetConfiguration()->ReadParameter( subtractMean,
@@ -20,12 +20,12 @@
 
 #include "itkPCAMetric.h"
 
+#include "itkDenseLinearAlgebra.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "vnl/algo/vnl_matrix_update.h"
 #include "itkImage.h"
 #include "vnl/algo/vnl_svd.h"
 #include "vnl/vnl_trace.h"
-#include "vnl/algo/vnl_symmetric_eigensystem.h"
 #include <numeric>
 #include <fstream>
 
@@ -323,16 +323,16 @@ PCAMetric< TFixedImage, TMovingImage >
     }
   }
 
-  /** Transpose of the matrix with mean subtracted */
-  MatrixType Atmm( Amm.transpose() );
-
   /** Compute covariancematrix C */
-  MatrixType C( Atmm * Amm );
+  MatrixType C;
+  DenseLinearAlgebra::TransposeMultiply( Amm, Amm, C );
   C /= static_cast< RealType >( RealType( N ) - 1.0 );
 
-  vnl_symmetric_eigensystem< RealType > eigc( C );
+  vnl_vector< RealType > eigenValuesC;
+  MatrixType             eigenVectorsC;
+  DenseLinearAlgebra::SymmetricEigensystem( C, eigenValuesC, eigenVectorsC );
 
-  RealType varNoise = 0.9999999 * eigc.get_eigenvalue( 0 );
+  RealType varNoise = 0.9999999 * eigenValuesC( 0 );
 
   if( !this->m_DeNoise )
   {
@@ -365,7 +365,9 @@ PCAMetric< TFixedImage, TMovingImage >
   MatrixType K( S * C * S );
 
   /** Compute first eigenvalue and eigenvector of K */
-  vnl_symmetric_eigensystem< RealType > eig( K );
+  vnl_vector< RealType > eigenValuesK;
+  MatrixType             eigenVectorsK;
+  DenseLinearAlgebra::SymmetricEigensystem( K, eigenValuesK, eigenVectorsK );
 
   /** Compute sum of all eigenvalues = trace( K ) */
 //    RealType trace = itk::NumericTraits< RealType >::Zero;
@@ -380,7 +382,7 @@ PCAMetric< TFixedImage, TMovingImage >
   RealType sumEigenValuesUsed = itk::NumericTraits< RealType >::Zero;
   for( unsigned int i = 1; i < L + 1; i++ )
   {
-    sumEigenValuesUsed += eig.get_eigenvalue( G - i );
+    sumEigenValuesUsed += eigenValuesK( G - i );
   }
 
   //    measure = trace - sumEigenValuesUsed;
@@ -576,12 +578,15 @@ PCAMetric< TFixedImage, TMovingImage >
   MatrixType Atmm( Amm.transpose() );
 
   /** Compute covariancematrix C */
-  MatrixType C( Atmm * Amm );
+  MatrixType C;
+  DenseLinearAlgebra::TransposeMultiply( Amm, Amm, C );
   C /= static_cast< RealType >( RealType( N ) - 1.0 );
 
-  vnl_symmetric_eigensystem< RealType > eigc( C );
-  vnl_vector< RealType >                v_G      = eigc.get_eigenvector( 0 );
-  RealType                              varNoise = 0.9999999 * eigc.get_eigenvalue( 0 );
+  vnl_vector< RealType > eigenValuesC;
+  MatrixType             eigenVectorsC;
+  DenseLinearAlgebra::SymmetricEigensystem( C, eigenValuesC, eigenVectorsC );
+  vnl_vector< RealType > v_G      = eigenVectorsC.get_column( 0 );
+  RealType               varNoise = 0.9999999 * eigenValuesC( 0 );
   if( !this->m_DeNoise )
   {
     varNoise = this->m_VarNoise;
@@ -612,7 +617,9 @@ PCAMetric< TFixedImage, TMovingImage >
   MatrixType K( S * C * S );
 
   /** Compute first eigenvalue and eigenvector of K */
-  vnl_symmetric_eigensystem< RealType > eig( K );
+  vnl_vector< RealType > eigenValuesK;
+  MatrixType             eigenVectorsK;
+  DenseLinearAlgebra::SymmetricEigensystem( K, eigenValuesK, eigenVectorsK );
 
   //    /** Compute sum of all eigenvalues = trace( K ) */
   //    RealType trace = itk::NumericTraits< RealType >::Zero;
@@ -626,13 +633,13 @@ PCAMetric< TFixedImage, TMovingImage >
   RealType sumEigenValuesUsed = itk::NumericTraits< RealType >::Zero;
   for( unsigned int i = 1; i < L + 1; i++ )
   {
-    sumEigenValuesUsed += eig.get_eigenvalue( G - i );
+    sumEigenValuesUsed += eigenValuesK( G - i );
   }
 
   MatrixType eigenVectorMatrix( G, L );
   for( unsigned int i = 1; i < L + 1; i++ )
   {
-    eigenVectorMatrix.set_column( i - 1, ( eig.get_eigenvector( G - i ) ).normalize() );
+    eigenVectorMatrix.set_column( i - 1, ( eigenVectorsK.get_column( G - i ) ).normalize() );
   }
 
   MatrixType eigenVectorMatrixTranspose( eigenVectorMatrix.transpose() );
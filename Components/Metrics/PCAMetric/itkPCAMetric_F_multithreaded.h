@@ -24,6 +24,7 @@
 #include "itkImageRandomCoordinateSampler.h"
 #include "itkNearestNeighborInterpolateImageFunction.h"
 #include "itkExtractImageFilter.h"
+#include "itkSubspaceIterationEigenSolver.h"
 
 namespace itk
 {
@@ -55,6 +56,13 @@ public:
   itkSetMacro( TransformIsStackTransform, bool );
   itkSetMacro( NumEigenValues, unsigned int );
 
+  /** Set/Get whether the eigenvalues are computed by subspace iteration,
+   * starting from the eigenvectors of the previous iteration, instead of by a
+   * full eigendecomposition. The default is true.
+   */
+  itkSetMacro( UseSubspaceIteration, bool );
+  itkGetConstMacro( UseSubspaceIteration, bool );
+
   /** Typedefs from the superclass. */
   typedef typename
     Superclass::CoordinateRepresentationType              CoordinateRepresentationType;
@@ -235,6 +243,10 @@ private:
   /** Integer to indicate how many eigenvalues you want to use in the metric */
   unsigned int m_NumEigenValues;
 
+  /** Computes the largest eigenvalues, starting from the previous eigenvectors. */
+  bool                                 m_UseSubspaceIteration;
+  mutable SubspaceIterationEigenSolver m_EigenSolver;
+
   /** Matrices, needed for derivative calculation */
   mutable std::vector< unsigned int > m_PixelStartIndex;
   mutable MatrixType                  m_Atmm;
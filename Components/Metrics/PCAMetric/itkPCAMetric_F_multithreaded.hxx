@@ -20,14 +20,15 @@
 
 #include "itkPCAMetric_F_multithreaded.h"
 
+#include "itkDenseLinearAlgebra.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "vnl/algo/vnl_matrix_update.h"
 #include "itkImage.h"
 #include "vnl/algo/vnl_svd.h"
 #include "vnl/vnl_trace.h"
-#include "vnl/algo/vnl_symmetric_eigensystem.h"
 #include <numeric>
 #include <fstream>
+#include <memory>
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -44,7 +45,8 @@ PCAMetric< TFixedImage, TMovingImage >
 ::PCAMetric() :
   m_SubtractMean( false ),
   m_TransformIsStackTransform( false ),
-  m_NumEigenValues( 6 )
+  m_NumEigenValues( 6 ),
+  m_UseSubspaceIteration( true )
 {
   this->SetUseImageSampler( true );
   this->SetUseFixedImageLimiter( false );
@@ -92,6 +94,11 @@ PCAMetric< TFixedImage, TMovingImage >
     std::cerr << "ERROR: Number of eigenvalues is larger than number of images. Maximum number of eigenvalues equals: "
               << this->m_G << std::endl;
   }
+
+  /** The eigenvectors of the previous resolution are no good start. */
+  this->m_EigenSolver.SetNumberOfEigenPairs( this->m_NumEigenValues );
+  this->m_EigenSolver.SetUseSubspaceIteration( this->m_UseSubspaceIteration );
+  this->m_EigenSolver.Reset();
 } // end Initializes
 
 
@@ -106,6 +113,8 @@ PCAMetric< TFixedImage, TMovingImage >
 {
   Superclass::PrintSelf( os, indent );
 
+  os << indent << "UseSubspaceIteration: " << ( this->m_UseSubspaceIteration ? "true" : "false" ) << std::endl;
+
 } // end PrintSelf
 
 
@@ -118,7 +127,7 @@ void
 PCAMetric< TFixedImage, TMovingImage >
 ::InitializeThreadingParameters( void ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Resize and initialize the threading related parameters.
  * The SetSize() functions do not resize the data when this is not
@@ -213,75 +222,87 @@ PCAMetric< TFixedImage, TMovingImage >
   /** Update the imageSampler and get a handle to the sample container. */
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
-
   /** The rows of the ImageSampleMatrix contain the samples of the images of the stack */
   const unsigned int numberOfSamples = sampleContainer->Size();
   MatrixType         datablock( numberOfSamples, this->m_G );
 
-  /** Initialize dummy loop variable */
-  unsigned int pixelIndex = 0;
-
   /** Initialize image sample matrix . */
   datablock.fill( itk::NumericTraits< RealType >::Zero );
 
-  for( fiter = fbegin; fiter != fend; ++fiter )
-  {
-    /** Read fixed coordinates. */
-    FixedImagePointType fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-
-    /** Transform sampled point to voxel coordinates. */
-    FixedImageContinuousIndexType voxelCoord;
-    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
-
-    unsigned int numSamplesOk = 0;
-
-    /** Loop over t */
-    for( unsigned int d = 0; d < this->m_G; ++d )
+  /** Fill the rows of the samples in chunks, one chunk per work unit. Each
+   * chunk only writes the rows of its own samples, and flags whether all
+   * images of the stack were valid at that sample.
+   */
+  const unsigned int  numberOfChunks = Self::GetNumberOfReductionChunks();
+  const unsigned long chunkSize      = ( numberOfSamples + numberOfChunks - 1 ) / numberOfChunks;
+  std::vector< char > sampleIsValid( numberOfSamples, 0 );
+  this->ProcessSlices( numberOfChunks, true,
+    [this, &sampleContainer, &datablock, &sampleIsValid, numberOfSamples, chunkSize](
+    const unsigned int chunk )
     {
-      /** Initialize some variables. */
-      RealType             movingImageValue;
-      MovingImagePointType mappedPoint;
+      /** The points of the images of the stack at a sample. */
+      std::vector< FixedImagePointType >  fixedPoints( this->m_G );
+      std::vector< MovingImagePointType > mappedPoints( this->m_G );
+      std::vector< RealType >             movingImageValues( this->m_G );
+      std::unique_ptr< bool[] >           samplesOk( new bool[ this->m_G ] );
+
+      const unsigned long chunkBegin = std::min( chunk * chunkSize, static_cast< unsigned long >( numberOfSamples ) );
+      const unsigned long chunkEnd   = std::min( chunkBegin + chunkSize, static_cast< unsigned long >( numberOfSamples ) );
+      for( unsigned long pixelIndex = chunkBegin; pixelIndex < chunkEnd; ++pixelIndex )
+      {
+        /** Read fixed coordinates. */
+        const FixedImagePointType & fixedPoint = sampleContainer->ElementAt( pixelIndex ).m_ImageCoordinates;
 
-      /** Set fixed point's last dimension to lastDimPosition. */
-      voxelCoord[ this->m_LastDimIndex ] = d;
+        /** Transform sampled point to voxel coordinates. */
+        FixedImageContinuousIndexType voxelCoord;
+        this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
 
-      /** Transform sampled point back to world coordinates. */
-      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
+        /** Set fixed point's last dimension to each t, and transform the
+         * points back to world coordinates.
+         */
+        for( unsigned int d = 0; d < this->m_G; ++d )
+        {
+          voxelCoord[ this->m_LastDimIndex ] = d;
+          this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d ] );
+        }
 
-      /** Transform point and check if it is inside the B-spline support region. */
-      bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+        /** Transform the points of all t in one batch, check if they are
+         * inside the moving mask, and compute the moving image values.
+         */
+        this->TransformMovingImageBatch( fixedPoints.data(), mappedPoints.data(), samplesOk.get(), this->m_G );
+        this->EvaluateMovingImageValuesAndDerivatives( mappedPoints.data(),
+          movingImageValues.data(), 0, samplesOk.get(), this->m_G );
 
-      /** Check if point is inside mask. */
-      if( sampleOk )
-      {
-        sampleOk = this->IsInsideMovingMask( mappedPoint );
-      }
+        /** Loop over t */
+        unsigned int numSamplesOk = 0;
+        for( unsigned int d = 0; d < this->m_G; ++d )
+        {
+          if( samplesOk[ d ] )
+          {
+            numSamplesOk++;
+            datablock( pixelIndex, d ) = movingImageValues[ d ];
+          }
 
-      if( sampleOk )
-      {
-        sampleOk = this->EvaluateMovingImageValueAndDerivative(
-          mappedPoint, movingImageValue, 0 );
-      }
+        } /** end loop over t */
 
-      if( sampleOk )
-      {
-        numSamplesOk++;
-        datablock( pixelIndex, d ) = movingImageValue;
+        sampleIsValid[ pixelIndex ] = ( numSamplesOk == this->m_G );
       }
+    } );
 
-    } /** end loop over t */
-
-    if( numSamplesOk == this->m_G )
+  /** Move the rows of the valid samples to the top, in the order of the
+   * samples, so that the result does not depend on the number of threads.
+   */
+  for( unsigned int i = 0; i < numberOfSamples; ++i )
+  {
+    if( sampleIsValid[ i ] )
     {
-      pixelIndex++;
+      if( i != this->m_NumberOfPixelsCounted )
+      {
+        datablock.set_row( this->m_NumberOfPixelsCounted, datablock.get_row( i ) );
+      }
       this->m_NumberOfPixelsCounted++;
     }
-
-  } /** end first loop over image sample container */
+  }
 
   /** Check if enough samples were valid. */
   this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
@@ -311,7 +332,8 @@ PCAMetric< TFixedImage, TMovingImage >
   }
 
   /** Compute covariance matrix C */
-  MatrixType C( Amm.transpose() * Amm );
+  MatrixType C;
+  DenseLinearAlgebra::TransposeMultiply( Amm, Amm, C );
   C /= static_cast< RealType >( RealType( this->m_NumberOfPixelsCounted ) - 1.0 );
 
   vnl_diag_matrix< RealType > S( this->m_G );
@@ -324,13 +346,13 @@ PCAMetric< TFixedImage, TMovingImage >
   /** Compute correlation matrix K */
   MatrixType K( S * C * S );
 
-  /** Compute first eigenvalue and eigenvector of K */
-  vnl_symmetric_eigensystem< RealType > eig( K );
+  /** Compute the largest eigenvalues of K */
+  this->m_EigenSolver.Compute( K );
 
   RealType sumEigenValuesUsed = itk::NumericTraits< RealType >::Zero;
-  for( unsigned int i = 1; i < this->m_NumEigenValues + 1; i++ )
+  for( unsigned int i = 0; i < this->m_NumEigenValues; i++ )
   {
-    sumEigenValuesUsed += eig.get_eigenvalue( this->m_G - i );
+    sumEigenValuesUsed += this->m_EigenSolver.GetEigenValues()[ i ];
   }
 
   measure = this->m_G - sumEigenValuesUsed;
@@ -499,7 +521,8 @@ PCAMetric< TFixedImage, TMovingImage >
 
   /** Compute covariance matrix C */
   MatrixType Atmm = Amm.transpose();
-  MatrixType C( Atmm * Amm );
+  MatrixType C;
+  DenseLinearAlgebra::TransposeMultiply( Amm, Amm, C );
   C /= static_cast< RealType >( RealType( this->m_NumberOfPixelsCounted ) - 1.0 );
 
   vnl_diag_matrix< RealType > S( this->m_G );
@@ -511,20 +534,16 @@ PCAMetric< TFixedImage, TMovingImage >
 
   MatrixType K( S * C * S );
 
-  /** Compute first eigenvalue and eigenvector of K */
-  vnl_symmetric_eigensystem< RealType > eig( K );
+  /** Compute the largest eigenvalues and eigenvectors of K */
+  this->m_EigenSolver.Compute( K );
 
   RealType sumEigenValuesUsed = itk::NumericTraits< RealType >::Zero;
-  for( unsigned int i = 1; i < this->m_NumEigenValues + 1; i++ )
+  for( unsigned int i = 0; i < this->m_NumEigenValues; i++ )
   {
-    sumEigenValuesUsed += eig.get_eigenvalue( this->m_G - i );
+    sumEigenValuesUsed += this->m_EigenSolver.GetEigenValues()[ i ];
   }
 
-  MatrixType eigenVectorMatrix( this->m_G, this->m_NumEigenValues );
-  for( unsigned int i = 1; i < this->m_NumEigenValues + 1; i++ )
-  {
-    eigenVectorMatrix.set_column( i - 1, ( eig.get_eigenvector( this->m_G - i ) ).normalize() );
-  }
+  const MatrixType & eigenVectorMatrix = this->m_EigenSolver.GetEigenVectors();
 
   MatrixType eigenVectorMatrixTranspose( eigenVectorMatrix.transpose() );
 
@@ -747,7 +766,7 @@ PCAMetric< TFixedImage, TMovingImage >
   /** Get the samples for this thread. */
   const unsigned long nrOfSamplesPerThreads
     = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
-    / static_cast< double >( Self::GetNumberOfWorkUnits() ) ) );
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
   unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
   unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
   pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
@@ -763,50 +782,46 @@ PCAMetric< TFixedImage, TMovingImage >
   std::vector< FixedImagePointType > SamplesOK;
   MatrixType                         datablock( nrOfSamplesPerThreads, this->m_G );
 
+  /** The points of the images of the stack at a sample. */
+  std::vector< FixedImagePointType >  fixedPoints( this->m_G );
+  std::vector< MovingImagePointType > mappedPoints( this->m_G );
+  std::vector< RealType >             movingImageValues( this->m_G );
+  std::unique_ptr< bool[] >           samplesOk( new bool[ this->m_G ] );
+
   unsigned int pixelIndex = 0;
   for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
   {
     /** Read fixed coordinates. */
-    FixedImagePointType fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
+    const FixedImagePointType & fixedPoint = ( *threader_fiter ).Value().m_ImageCoordinates;
 
     /** Transform sampled point to voxel coordinates. */
     FixedImageContinuousIndexType voxelCoord;
     this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
 
-    unsigned int numSamplesOk = 0;
-
-    /** Loop over t */
+    /** Set fixed point's last dimension to each t, and transform the
+     * points back to world coordinates.
+     */
     for( unsigned int d = 0; d < this->m_G; ++d )
     {
-      /** Initialize some variables. */
-      RealType             movingImageValue;
-      MovingImagePointType mappedPoint;
-
-      /** Set fixed point's last dimension to lastDimPosition. */
       voxelCoord[ this->m_LastDimIndex ] = d;
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d ] );
+    }
 
-      /** Transform sampled point back to world coordinates. */
-      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
-
-      /** Transform point and check if it is inside the B-spline support region. */
-      bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-      /** Check if point is inside mask. */
-      if( sampleOk )
-      {
-        sampleOk = this->IsInsideMovingMask( mappedPoint );
-      }
-
-      if( sampleOk )
-
-      {
-        sampleOk = this->EvaluateMovingImageValueAndDerivative(
-          mappedPoint, movingImageValue, 0 );
-      }
+    /** Transform the points of all t in one batch, check if they are
+     * inside the moving mask, and compute the moving image values.
+     */
+    this->TransformMovingImageBatch( fixedPoints.data(), mappedPoints.data(), samplesOk.get(), this->m_G );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints.data(),
+      movingImageValues.data(), 0, samplesOk.get(), this->m_G );
 
-      if( sampleOk )
+    /** Loop over t */
+    unsigned int numSamplesOk = 0;
+    for( unsigned int d = 0; d < this->m_G; ++d )
+    {
+      if( samplesOk[ d ] )
       {
         numSamplesOk++;
-        datablock( pixelIndex, d ) = movingImageValue;
+        datablock( pixelIndex, d ) = movingImageValues[ d ];
       } // end if sampleOk
 
     } // end loop over t
@@ -835,7 +850,7 @@ void
 PCAMetric< TFixedImage, TMovingImage >
 ::AfterThreadedGetSamples( MeasureType & value ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted = this->m_PCAMetricGetSamplesPerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
@@ -883,7 +898,8 @@ PCAMetric< TFixedImage, TMovingImage >
 
   /** Compute covariancematrix C */
   this->m_Atmm = Amm.transpose();
-  MatrixType C( this->m_Atmm * Amm );
+  MatrixType C;
+  DenseLinearAlgebra::TransposeMultiply( Amm, Amm, C );
   C /= static_cast< RealType >( RealType( this->m_NumberOfPixelsCounted ) - 1.0 );
 
   vnl_diag_matrix< RealType > S( this->m_G );
@@ -895,17 +911,17 @@ PCAMetric< TFixedImage, TMovingImage >
 
   MatrixType K( S * C * S );
 
-  /** Compute first eigenvalue and eigenvector of K */
-  vnl_symmetric_eigensystem< RealType > eig( K );
+  /** Compute the largest eigenvalues and eigenvectors of K */
+  this->m_EigenSolver.Compute( K );
 
-  RealType   sumEigenValuesUsed = itk::NumericTraits< RealType >::Zero;
-  MatrixType eigenVectorMatrix( this->m_G, this->m_NumEigenValues );
-  for( unsigned int i = 1; i < this->m_NumEigenValues + 1; i++ )
+  RealType sumEigenValuesUsed = itk::NumericTraits< RealType >::Zero;
+  for( unsigned int i = 0; i < this->m_NumEigenValues; i++ )
   {
-    sumEigenValuesUsed += eig.get_eigenvalue( this->m_G - i );
-    eigenVectorMatrix.set_column( i - 1, ( eig.get_eigenvector( this->m_G - i ) ).normalize() );
+    sumEigenValuesUsed += this->m_EigenSolver.GetEigenValues()[ i ];
   }
 
+  const MatrixType & eigenVectorMatrix = this->m_EigenSolver.GetEigenVectors();
+
   value = this->m_G - sumEigenValuesUsed;
 
   MatrixType eigenVectorMatrixTranspose( eigenVectorMatrix.transpose() );
@@ -962,7 +978,7 @@ PCAMetric< TFixedImage, TMovingImage >
   /** Setup local threader. */
   // \todo: is a global threader better performance-wise? check
   typename ThreaderType::Pointer local_threader = ThreaderType::New();
-  local_threader->SetNumberOfWorkUnits( Self::GetNumberOfWorkUnits() );
+  local_threader->SetNumberOfWorkUnits( Self::GetNumberOfReductionChunks() );
   local_threader->SetSingleMethod( this->GetSamplesThreaderCallback,
     const_cast< void * >( static_cast< const void * >(
       &this->m_PCAMetricThreaderParameters ) ) );
@@ -987,9 +1003,11 @@ PCAMetric< TFixedImage, TMovingImage >
   derivative.Fill( 0.0 );
 
   /** Initialize some variables. */
-  RealType                  movingImageValue;
-  MovingImagePointType      mappedPoint;
-  MovingImageDerivativeType movingImageDerivative;
+  std::vector< FixedImagePointType >       fixedPoints( this->m_G );
+  std::vector< MovingImagePointType >      mappedPoints( this->m_G );
+  std::vector< RealType >                  movingImageValues( this->m_G );
+  std::vector< MovingImageDerivativeType > movingImageDerivatives( this->m_G );
+  std::unique_ptr< bool[] >                samplesOk( new bool[ this->m_G ] );
 
   TransformJacobianType      jacobian;
   DerivativeType             imageJacobian( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
@@ -1002,30 +1020,36 @@ PCAMetric< TFixedImage, TMovingImage >
     ++pixelIndex )
   {
     /** Read fixed coordinates. */
-    FixedImagePointType fixedPoint = this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_ApprovedSamples[ dummyindex ];
+    const FixedImagePointType & fixedPoint = this->m_PCAMetricGetSamplesPerThreadVariables[ threadId ].st_ApprovedSamples[ dummyindex ];
 
     /** Transform sampled point to voxel coordinates. */
     FixedImageContinuousIndexType voxelCoord;
     this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
 
+    /** Set fixed point's last dimension to each t, and transform the
+     * points back to world coordinates.
+     */
     for( unsigned int d = 0; d < this->m_G; ++d )
     {
-      /** Set fixed point's last dimension to lastDimPosition. */
       voxelCoord[ this->m_LastDimIndex ] = d;
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d ] );
+    }
 
-      /** Transform sampled point back to world coordinates. */
-      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
-      this->TransformPoint( fixedPoint, mappedPoint );
-
-      this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
+    /** Transform the points of all t in one batch, and compute the moving
+     * image values and derivatives. The approved samples are valid for all t.
+     */
+    this->TransformMovingImageBatch( fixedPoints.data(), mappedPoints.data(), samplesOk.get(), this->m_G );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints.data(),
+      movingImageValues.data(), movingImageDerivatives.data(), samplesOk.get(), this->m_G );
 
+    for( unsigned int d = 0; d < this->m_G; ++d )
+    {
       /** Get the TransformJacobian dT/dmu */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzjis );
+      this->EvaluateTransformJacobian( fixedPoints[ d ], jacobian, nzjis );
 
       /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
+        jacobian, movingImageDerivatives[ d ], imageJacobian );
 
       /** build metric derivative components */
       for( unsigned int p = 0; p < nzjis.size(); ++p )
@@ -1057,7 +1081,7 @@ PCAMetric< TFixedImage, TMovingImage >
 ::AfterThreadedComputeDerivative(
   DerivativeType & derivative ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   derivative = this->m_PCAMetricGetSamplesPerThreadVariables[ 0 ].st_Derivative;
   for( ThreadIdType i = 1; i < numberOfThreads; ++i )
@@ -1172,7 +1196,7 @@ PCAMetric< TFixedImage, TMovingImage >
   /** Setup local threader. */
   // \todo: is a global threader better performance-wise? check
   typename ThreaderType::Pointer local_threader = ThreaderType::New();
-  local_threader->SetNumberOfWorkUnits( Self::GetNumberOfWorkUnits() );
+  local_threader->SetNumberOfWorkUnits( Self::GetNumberOfReductionChunks() );
   local_threader->SetSingleMethod( this->ComputeDerivativeThreaderCallback,
     const_cast< void * >( static_cast< const void * >(
       &this->m_PCAMetricThreaderParameters ) ) );
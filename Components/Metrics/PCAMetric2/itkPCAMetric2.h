@@ -165,6 +165,15 @@ private:
   /** Sample n random numbers from 0..m and add them to the vector. */
   void SampleRandom( const int n, const int m, std::vector< int > & numbers ) const;
 
+  /** Evaluate the moving image at all samples and time points, in parallel
+   * tiles of samples and time points. The first m_NumberOfPixelsCounted rows
+   * of datablock get the values of the samples that are valid at all time
+   * points, in the order of the samples, and samplesOK, if given, their
+   * fixed image coordinates.
+   */
+  void EvaluateSampleMatrix( vnl_matrix< RealType > & datablock,
+    std::vector< FixedImagePointType > * samplesOK ) const;
+
   /** Variables to control random sampling in last dimension. */
   unsigned int m_NumAdditionalSamplesFixed;
   unsigned int m_ReducedDimensionIndex;
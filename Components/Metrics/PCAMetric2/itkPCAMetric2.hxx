@@ -25,9 +25,11 @@
 #include "itkImage.h"
 #include "vnl/algo/vnl_svd.h"
 #include "vnl/vnl_trace.h"
-#include "vnl/algo/vnl_symmetric_eigensystem.h"
+#include "itkSubspaceIterationEigenSolver.h"
+#include <algorithm>
 #include <numeric>
 #include <fstream>
+#include <memory>
 
 namespace itk
 {
@@ -146,6 +148,108 @@ PCAMetric2< TFixedImage, TMovingImage >
 } // end EvaluateTransformJacobianInnerProduct()
 
 
+/**
+ * ******************* EvaluateSampleMatrix *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+PCAMetric2< TFixedImage, TMovingImage >
+::EvaluateSampleMatrix( vnl_matrix< RealType > & datablock,
+  std::vector< FixedImagePointType > * samplesOK ) const
+{
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  const unsigned int          numberOfSamples = sampleContainer->Size();
+
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  /** Evaluate the moving image at all samples and time points, in tiles of
+   * samples and time points, so that also few samples of many time points
+   * use all threads. Each tile fills its own entries of the sample matrix.
+   */
+  datablock.set_size( numberOfSamples, G );
+  datablock.fill( itk::NumericTraits< RealType >::Zero );
+  std::vector< unsigned char > valid( static_cast< std::size_t >( numberOfSamples ) * G, 0 );
+  this->ProcessSampleAndPositionTiles( numberOfSamples, G,
+    [ this, &sampleContainer, &datablock, &valid, lastDim, G ]( const unsigned long sampleBegin,
+    const unsigned long sampleEnd, const unsigned int positionBegin, const unsigned int positionEnd )
+    {
+      /** The points of the time points of the tile at a sample. */
+      const unsigned int                  numberOfPositions = positionEnd - positionBegin;
+      std::vector< FixedImagePointType >  fixedPoints( numberOfPositions );
+      std::vector< MovingImagePointType > mappedPoints( numberOfPositions );
+      std::vector< RealType >             movingImageValues( numberOfPositions );
+      std::unique_ptr< bool[] >           samplesOk( new bool[ numberOfPositions ] );
+
+      for( unsigned long sampleIndex = sampleBegin; sampleIndex < sampleEnd; ++sampleIndex )
+      {
+        /** Read fixed coordinates. */
+        const FixedImagePointType & fixedPoint = sampleContainer->ElementAt( sampleIndex ).m_ImageCoordinates;
+
+        /** Transform sampled point to voxel coordinates. */
+        FixedImageContinuousIndexType voxelCoord;
+        this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
+
+        /** Set fixed point's last dimension to each t of the tile, and
+         * transform the points back to world coordinates.
+         */
+        for( unsigned int d = positionBegin; d < positionEnd; ++d )
+        {
+          voxelCoord[ lastDim ] = d;
+          this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d - positionBegin ] );
+        }
+
+        /** Transform the points in one batch, check if they are inside the
+         * moving mask, and compute the moving image values.
+         */
+        this->TransformMovingImageBatch( fixedPoints.data(), mappedPoints.data(), samplesOk.get(), numberOfPositions );
+        this->EvaluateMovingImageValuesAndDerivatives( mappedPoints.data(),
+          movingImageValues.data(), 0, samplesOk.get(), numberOfPositions );
+
+        /** Loop over t */
+        for( unsigned int d = positionBegin; d < positionEnd; ++d )
+        {
+          if( samplesOk[ d - positionBegin ] )
+          {
+            datablock( sampleIndex, d )  = movingImageValues[ d - positionBegin ];
+            valid[ sampleIndex * G + d ] = 1;
+          }
+
+        } /** end loop over t */
+      }
+    } );
+
+  /** Move the rows of the samples that are valid at all time points to the
+   * top, in the order of the samples.
+   */
+  this->m_NumberOfPixelsCounted = 0;
+  unsigned int pixelIndex = 0;
+  for( unsigned int sampleIndex = 0; sampleIndex < numberOfSamples; ++sampleIndex )
+  {
+    const unsigned char * first = valid.data() + static_cast< std::size_t >( sampleIndex ) * G;
+    if( std::find( first, first + G, 0 ) != first + G )
+    {
+      continue;
+    }
+
+    if( pixelIndex != sampleIndex )
+    {
+      datablock.set_row( pixelIndex, datablock.get_row( sampleIndex ) );
+    }
+    if( samplesOK )
+    {
+      samplesOK->push_back( sampleContainer->ElementAt( sampleIndex ).m_ImageCoordinates );
+    }
+    pixelIndex++;
+    this->m_NumberOfPixelsCounted++;
+  }
+
+} // end EvaluateSampleMatrix()
+
+
 /**
  * ******************* GetValue *******************
  */
@@ -181,11 +285,6 @@ PCAMetric2< TFixedImage, TMovingImage >
   this->GetImageSampler()->Update();
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
-
   /** Retrieve slowest varying dimension and its size. */
   const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
   const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
@@ -194,77 +293,8 @@ PCAMetric2< TFixedImage, TMovingImage >
 
   /** The rows of the ImageSampleMatrix contain the samples of the images of the stack */
   const unsigned int numberOfSamples = sampleContainer->Size();
-  MatrixType         datablock( numberOfSamples, G );
-
-  /** Vector containing last dimension positions to use: initialize on all positions when random sampling turned off. */
-  std::vector< int > lastDimPositions;
-
-  /** Determine random last dimension positions if needed. */
-  for( unsigned int i = 0; i < G; ++i )
-  {
-    lastDimPositions.push_back( i );
-  }
-
-  /** Initialize dummy loop variable */
-  unsigned int pixelIndex = 0;
-
-  /** Initialize image sample matrix . */
-  datablock.fill( itk::NumericTraits< RealType >::Zero );
-
-  for( fiter = fbegin; fiter != fend; ++fiter )
-  {
-    /** Read fixed coordinates. */
-    FixedImagePointType fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-
-    /** Transform sampled point to voxel coordinates. */
-    FixedImageContinuousIndexType voxelCoord;
-    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
-
-    unsigned int numSamplesOk = 0;
-
-    /** Loop over t */
-    for( unsigned int d = 0; d < G; ++d )
-    {
-      /** Initialize some variables. */
-      RealType             movingImageValue;
-      MovingImagePointType mappedPoint;
-
-      /** Set fixed point's last dimension to lastDimPosition. */
-      voxelCoord[ lastDim ] = lastDimPositions[ d ];
-
-      /** Transform sampled point back to world coordinates. */
-      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
-
-      /** Transform point and check if it is inside the B-spline support region. */
-      bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-
-      /** Check if point is inside mask. */
-      if( sampleOk )
-      {
-        sampleOk = this->IsInsideMovingMask( mappedPoint );
-      }
-
-      if( sampleOk )
-      {
-        sampleOk = this->EvaluateMovingImageValueAndDerivative(
-          mappedPoint, movingImageValue, 0 );
-      }
-
-      if( sampleOk )
-      {
-        numSamplesOk++;
-        datablock( pixelIndex, d ) = movingImageValue;
-      }
-
-    } /** end loop over t */
-
-    if( numSamplesOk == G )
-    {
-      pixelIndex++;
-      this->m_NumberOfPixelsCounted++;
-    }
-
-  } /** end first loop over image sample container */
+  MatrixType         datablock;
+  this->EvaluateSampleMatrix( datablock, 0 );
 
   /** Check if enough samples were valid. */
   this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
@@ -308,26 +338,26 @@ PCAMetric2< TFixedImage, TMovingImage >
   /** Compute correlation matrix K */
   MatrixType K( S * C * S );
 
-  /** Compute first eigenvalue and eigenvector of K */
-  vnl_symmetric_eigensystem< RealType > eig( K );
+  /** Compute all eigenvalues of K. The metric weighs all of them, so a
+   * partial eigensolver does not apply.
+   */
+  SubspaceIterationEigenSolver::VectorType eigenValues;
+  SubspaceIterationEigenSolver::MatrixType eigenVectors;
+  SubspaceIterationEigenSolver::ComputeAll( K, eigenValues, eigenVectors );
 
   // The measure is the sum of weighted eigenvalues of the correlation matrix.
   // measure = sum_{i=1}^G i*lambda_i
 
-  // Note that the system does NOT crash when you violate the number of possible
-  // eigenvalues, i.e. when K is of size 30x30, eigenvalues > 30 also exist and have
-  // a value.
-
-  // The eigenvalues of vnl_symmetric_eigensystem are in ascending order, meaning that
-  // when K is of size 30x30, eigenvalue 29 is the highest, and eigenvalue 0 is the lowest.
+  // The eigenvalues of ComputeAll() are in descending order, meaning that
+  // when K is of size 30x30, eigenvalue 0 is the highest, and eigenvalue 29 is the lowest.
   // We want the low eigenvalue to get the highest weight and the highest eigenvalue to get
   // the lowest weight, i.e. for K of size 30x30:
-  // eigenvalue 29 has a weight of 1 and eigenvalue 0 has a weight of 30
+  // eigenvalue 0 has a weight of 1 and eigenvalue 29 has a weight of 30
 
   RealType sumWeightedEigenValues = itk::NumericTraits< RealType >::Zero;
   for( unsigned int i = 0; i < G; i++ )
   {
-    sumWeightedEigenValues += ( i + 1 ) * eig.get_eigenvalue( G - i - 1 );
+    sumWeightedEigenValues += ( i + 1 ) * eigenValues[ i ];
   }
 
   measure = sumWeightedEigenValues;
@@ -388,11 +418,6 @@ PCAMetric2< TFixedImage, TMovingImage >
   this->GetImageSampler()->Update();
   ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator fiter;
-  typename ImageSampleContainerType::ConstIterator fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator fend   = sampleContainer->End();
-
   /** Retrieve slowest varying dimension and its size. */
   const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
   const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
@@ -400,83 +425,20 @@ PCAMetric2< TFixedImage, TMovingImage >
   typedef vnl_matrix< RealType >            MatrixType;
   typedef vnl_matrix< DerivativeValueType > DerivativeMatrixType;
 
+  /** The rows of the ImageSampleMatrix contain the samples of the images of
+   * the stack that are valid at all positions.
+   */
   std::vector< FixedImagePointType > SamplesOK;
+  MatrixType                         datablock;
+  this->EvaluateSampleMatrix( datablock, &SamplesOK );
 
-  /** The rows of the ImageSampleMatrix contain the samples of the images of the stack */
-  const unsigned int numberOfSamples = sampleContainer->Size();
-  MatrixType         datablock( numberOfSamples, G );
-
-  /** Initialize dummy loop variables */
-  unsigned int pixelIndex = 0;
-
-  /** Initialize image sample matrix . */
-  datablock.fill( itk::NumericTraits< RealType >::Zero );
-
-  /** Determine random last dimension positions if needed. */
-  /** Vector containing last dimension positions to use: initialize on all positions when random sampling turned off. */
-  /** Vector containing last dimension positions to use: initialize on all positions when random sampling turned off. */
+  /** Vector containing last dimension positions to use. */
   std::vector< int > lastDimPositions;
-
   for( unsigned int i = 0; i < G; ++i )
   {
     lastDimPositions.push_back( i );
   }
 
-  for( fiter = fbegin; fiter != fend; ++fiter )
-  {
-    /** Read fixed coordinates. */
-    FixedImagePointType fixedPoint = ( *fiter ).Value().m_ImageCoordinates;
-
-    /** Transform sampled point to voxel coordinates. */
-    FixedImageContinuousIndexType voxelCoord;
-    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
-
-    unsigned int numSamplesOk = 0;
-
-    /** Loop over t */
-    for( unsigned int d = 0; d < G; ++d )
-    {
-      /** Initialize some variables. */
-      RealType             movingImageValue;
-      MovingImagePointType mappedPoint;
-
-      /** Set fixed point's last dimension to lastDimPosition. */
-      voxelCoord[ lastDim ] = lastDimPositions[ d ];
-
-      /** Transform sampled point back to world coordinates. */
-      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
-
-      /** Transform point and check if it is inside the B-spline support region. */
-      bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-
-      /** Check if point is inside mask. */
-      if( sampleOk )
-      {
-        sampleOk = this->IsInsideMovingMask( mappedPoint );
-      }
-
-      if( sampleOk )
-
-      {
-        sampleOk = this->EvaluateMovingImageValueAndDerivative(
-          mappedPoint, movingImageValue, 0 );
-      }
-
-      if( sampleOk )
-      {
-        numSamplesOk++;
-        datablock( pixelIndex, d ) = movingImageValue;
-      } // end if sampleOk
-
-    } // end loop over gradient images
-    if( numSamplesOk == G )
-    {
-      SamplesOK.push_back( fixedPoint );
-      pixelIndex++;
-      this->m_NumberOfPixelsCounted++;
-    }
-  }
-
   /** Check if enough samples were valid. */
   this->CheckNumberOfSamples( sampleContainer->Size(), this->m_NumberOfPixelsCounted );
   unsigned int N = this->m_NumberOfPixelsCounted;
@@ -521,35 +483,22 @@ PCAMetric2< TFixedImage, TMovingImage >
   /** Compute correlation matrix K */
   MatrixType K( S * C * S );
 
-  /** Compute first eigenvalue and eigenvector of K */
-  vnl_symmetric_eigensystem< RealType > eig( K );
+  /** Compute all eigenvalues and eigenvectors of K, in descending order */
+  SubspaceIterationEigenSolver::VectorType eigenValues;
+  MatrixType                               eigenVectorMatrix;
+  SubspaceIterationEigenSolver::ComputeAll( K, eigenValues, eigenVectorMatrix );
 
   RealType sumWeightedEigenValues = itk::NumericTraits< RealType >::Zero;
   for( unsigned int i = 0; i < G; i++ )
   {
-    sumWeightedEigenValues += ( i + 1 ) * eig.get_eigenvalue( G - i - 1 );
-  }
-
-  MatrixType eigenVectorMatrix( G, G );
-  for( unsigned int i = 0; i < G; i++ )
-  {
-    eigenVectorMatrix.set_column( i, ( eig.get_eigenvector( G - i - 1 ) ).normalize() );
+    sumWeightedEigenValues += ( i + 1 ) * eigenValues[ i ];
   }
 
   MatrixType eigenVectorMatrixTranspose( eigenVectorMatrix.transpose() );
 
-  /** Create variables to store intermediate results in. */
-  TransformJacobianType                     jacobian;
-  DerivativeType                            dMTdmu;
-  DerivativeType                            imageJacobian( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
-  std::vector< NonZeroJacobianIndicesType > nzjis( G, NonZeroJacobianIndicesType() );
-
   /** Sub components of metric derivative */
   vnl_diag_matrix< DerivativeValueType > dSdmu_part1( G );
 
-  unsigned int startSamplesOK;
-  startSamplesOK = 0;
-
   for( unsigned int d = 0; d < G; d++ )
   {
     double S_sqr = S( d, d ) * S( d, d );
@@ -562,60 +511,83 @@ PCAMetric2< TFixedImage, TMovingImage >
   DerivativeMatrixType Sv( S * eigenVectorMatrix );
   DerivativeMatrixType vdSdmu_part1( eigenVectorMatrixTranspose * dSdmu_part1 );
 
-  /** Second loop over fixed image samples. */
-  for( pixelIndex = 0; pixelIndex < SamplesOK.size(); ++pixelIndex )
+  /** Transform the valid samples to voxel coordinates. */
+  std::vector< FixedImageContinuousIndexType > voxelCoordsOK( SamplesOK.size() );
+  for( unsigned int pixelIndex = 0; pixelIndex < SamplesOK.size(); ++pixelIndex )
   {
-    /** Read fixed coordinates. */
-    FixedImagePointType fixedPoint = SamplesOK[ startSamplesOK ];
-    startSamplesOK++;
-
-    /** Transform sampled point to voxel coordinates. */
-    FixedImageContinuousIndexType voxelCoord;
-    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
-
-    const unsigned int G = lastDimPositions.size();
+    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex(
+      SamplesOK[ pixelIndex ], voxelCoordsOK[ pixelIndex ] );
+  }
 
-    for( unsigned int d = 0; d < G; ++d )
+  /** Second loop over fixed image samples, per last dimension position. For
+   * a stack transform, the samples of a position only affect the parameters
+   * of its sub transform, so the positions are processed in parallel.
+   */
+  this->ProcessSlices( G, this->m_TransformIsStackTransform,
+    [ this, &voxelCoordsOK, &lastDimPositions, &vSAtmm, &CSv, &Sv, &vdSdmu_part1, &Atmm,
+    &derivative, lastDim, G ]( const unsigned int d )
     {
-      /** Initialize some variables. */
-      RealType                  movingImageValue;
-      MovingImagePointType      mappedPoint;
-      MovingImageDerivativeType movingImageDerivative;
-
-      /** Set fixed point's last dimension to lastDimPosition. */
-      voxelCoord[ lastDim ] = lastDimPositions[ d ];
-
-      /** Transform sampled point back to world coordinates. */
-      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
-      this->TransformPoint( fixedPoint, mappedPoint );
-
-      this->EvaluateMovingImageValueAndDerivative(
-        mappedPoint, movingImageValue, &movingImageDerivative );
-
-      /** Get the TransformJacobian dT/dmu */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzjis[ d ] );
-
-      /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
-      this->EvaluateTransformJacobianInnerProduct(
-        jacobian, movingImageDerivative, imageJacobian );
-
-      /** Store values. */
-      dMTdmu = imageJacobian;
-
-      /** build metric derivative components */
-      for( unsigned int p = 0; p < nzjis[ d ].size(); ++p )
+      DerivativeType             imageJacobian( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+      NonZeroJacobianIndicesType nzji;
+
+      /** The samples are transformed and interpolated per block. */
+      const unsigned int        batchSize = Superclass::MovingImageBatchSize;
+      FixedImagePointType       fixedPoints[ batchSize ];
+      MovingImagePointType      mappedPoints[ batchSize ];
+      bool                      samplesOk[ batchSize ];
+      RealType                  movingImageValues[ batchSize ];
+      MovingImageDerivativeType movingImageDerivatives[ batchSize ];
+
+      const unsigned int numberOfSamplesOK = voxelCoordsOK.size();
+      for( unsigned int blockBegin = 0; blockBegin < numberOfSamplesOK; blockBegin += batchSize )
       {
-        for( unsigned int z = 0; z < G; z++ )
-        {
-          derivative[ nzjis[ d ][ p ] ] += z * ( vSAtmm[ z ][ pixelIndex ] * dMTdmu[ p ] * Sv[ d ][ z ]
-            + vdSdmu_part1[ z ][ d ] * Atmm[ d ][ pixelIndex ] * dMTdmu[ p ] * CSv[ d ][ z ] );
-        } //end loop over eigenvalues
+        const unsigned int blockSize = std::min( numberOfSamplesOK - blockBegin, batchSize );
 
-      } //end loop over non-zero jacobian indices
+        /** Set fixed point's last dimension to lastDimPosition, and
+         * transform the sampled points back to world coordinates.
+         */
+        for( unsigned int i = 0; i < blockSize; ++i )
+        {
+          FixedImageContinuousIndexType voxelCoord = voxelCoordsOK[ blockBegin + i ];
+          voxelCoord[ lastDim ] = lastDimPositions[ d ];
+          this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ i ] );
+        }
 
-    } //end loop over last dimension
+        /** Transform the points of the block in one batch, and compute the
+         * moving image values and derivatives. The samples are valid at all
+         * positions.
+         */
+        this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize );
+        this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+          movingImageValues, movingImageDerivatives, samplesOk, blockSize );
 
-  } // end second for loop over sample container
+        for( unsigned int i = 0; i < blockSize; ++i )
+        {
+          const unsigned int pixelIndex = blockBegin + i;
+
+          /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
+          this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+            fixedPoints[ i ], movingImageDerivatives[ i ], imageJacobian, nzji );
+
+          /** The weight of dM/dmu in the metric derivative, which does not
+           * depend on the parameter.
+           */
+          DerivativeValueType weight = NumericTraits< DerivativeValueType >::ZeroValue();
+          for( unsigned int z = 0; z < G; z++ )
+          {
+            weight += z * ( vSAtmm[ z ][ pixelIndex ] * Sv[ d ][ z ]
+              + vdSdmu_part1[ z ][ d ] * Atmm[ d ][ pixelIndex ] * CSv[ d ][ z ] );
+          } //end loop over eigenvalues
+
+          /** build metric derivative components */
+          for( unsigned int p = 0; p < nzji.size(); ++p )
+          {
+            derivative[ nzji[ p ] ] += weight * imageJacobian[ p ];
+          } //end loop over non-zero jacobian indices
+
+        } // end loop over the samples of the block
+      } // end loop over sample container
+    } );
 
   derivative *= ( 2.0 / ( DerivativeValueType( N ) - 1.0 ) ); //normalize
   measure     = sumWeightedEigenValues;
@@ -28,6 +28,11 @@ namespace elastix
  * \class PatternIntensityMetric
  * \brief An metric based on the itk::PatternIntensityImageToImageMetric.
  *
+ * The parameters used in this class are:
+ * \parameter UseImageSampler: compute the pattern intensity at the samples of the
+ *    ImageSampler, instead of at all pixels of the fixed image. \n
+ *    <tt>(UseImageSampler "true")</tt> \n
+ *    The default is "false".
  *
  * \ingroup Metrics
  *
@@ -132,6 +137,12 @@ public:
    */
   void Initialize( void ) override;
 
+  /** Execute stuff before anything else is done:
+   * \li Set whether the image sampler is used. This must be known before the
+   * registration connects the image sampler.
+   */
+  int BeforeAll( void ) override;
+
   /**
    * Do some things before each resolution:
    * \li Set CheckNumberOfSamples setting
@@ -43,6 +43,25 @@ PatternIntensityMetric< TElastix >
 } // end Initialize()
 
 
+/**
+ * ***************** BeforeAll ***********************
+ */
+
+template< class TElastix >
+int
+PatternIntensityMetric< TElastix >
+::BeforeAll( void )
+{
+  bool useImageSampler = false;
+  this->GetConfiguration()->ReadParameter( useImageSampler,
+    "UseImageSampler", this->GetComponentLabel(), 0, 0, true );
+  this->SetUseImageSampler( useImageSampler );
+
+  return 0;
+
+} // end BeforeAll()
+
+
 /**
  * ***************** BeforeRegistration ***********************
  */
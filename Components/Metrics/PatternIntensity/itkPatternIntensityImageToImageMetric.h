@@ -23,20 +23,28 @@
 #include "itkPoint.h"
 #include "itkCastImageFilter.h"
 #include "itkResampleImageFilter.h"
-#include "itkMultiplyImageFilter.h"
-#include "itkSubtractImageFilter.h"
 #include "itkOptimizer.h"
 #include "itkRescaleIntensityImageFilter.h"
 #include "itkAdvancedCombinationTransform.h"
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
 
+#include <vector>
+
 namespace itk
 {
 
 /** \class PatternIntensityImageToImageMetric
  * \brief Computes similarity between two objects to be registered
  *
+ * The pattern intensity is summed over the neighborhoods of the pixels of
+ * the difference of the fixed image and the scaled projection of the moving
+ * image. The difference is computed on the fly from both images, so changing
+ * the normalization factor does not recompute the projection. The pixels
+ * are split over the threads.
  *
+ * With UseImageSampler, the pattern intensities of the difference and of the
+ * fixed image are computed at the pixels of the samples of the image sampler,
+ * instead of at all pixels of the fixed image.
  *
  * \ingroup RegistrationMetrics
  */
@@ -128,17 +136,7 @@ public:
   typedef itk::RescaleIntensityImageFilter<
     TransformedMovingImageType, TransformedMovingImageType > RescaleIntensityImageFilterType;
   typedef typename RescaleIntensityImageFilterType::Pointer RescaleIntensityImageFilterPointer;
-
-  typedef itk::SubtractImageFilter<
-    FixedImageType,
-    TransformedMovingImageType,
-    TransformedMovingImageType >        DifferenceImageFilterType;
-  typedef typename DifferenceImageFilterType::Pointer DifferenceImageFilterPointer;
-  typedef itk::MultiplyImageFilter<
-    TransformedMovingImageType,
-    TransformedMovingImageType,
-    TransformedMovingImageType >         MultiplyImageFilterType;
-  typedef typename MultiplyImageFilterType::Pointer MultiplyImageFilterPointer;
+  typedef typename FixedImageType::IndexType                FixedImageIndexType;
 
   /** The moving image dimension. */
   itkStaticConstMacro( MovingImageDimension, unsigned int,
@@ -174,36 +172,62 @@ public:
   itkSetMacro( OptimizeNormalizationFactor, bool );
   itkGetConstReferenceMacro( OptimizeNormalizationFactor, bool );
 
+  /** Set whether to compute the pattern intensity at the pixels of the
+   * samples of the image sampler, instead of at all pixels of the fixed
+   * image. Samples of which the neighborhood is not inside the fixed image
+   * are skipped. This option should be set before the image sampler is
+   * connected; Default: false.
+   */
+  itkSetMacro( UseImageSampler, bool );
+
 protected:
 
   PatternIntensityImageToImageMetric();
   ~PatternIntensityImageToImageMetric() override {}
   void PrintSelf( std::ostream & os, Indent indent ) const override;
 
+  /** Set the transform parameters, update the image sampler, and compute
+   * the projection of the moving image.
+   */
+  void UpdateTransformedMovingImage( const TransformParametersType & parameters ) const;
+
   /** Compute the pattern intensity fixed image*/
   MeasureType ComputePIFixed( void ) const;
 
-  /** Compute the pattern intensity difference image. */
-  MeasureType ComputePIDiff( const TransformParametersType & parameters, float scalingfactor ) const;
+  /** Compute the pattern intensity of the difference of the fixed image and
+   * the projection of the moving image, scaled by scalingfactor.
+   */
+  MeasureType ComputePIDiff( const float scalingfactor ) const;
 
 private:
 
   PatternIntensityImageToImageMetric( const Self & ); // purposely not implemented
   void operator=( const Self & );                     // purposely not implemented
 
-  TransformMovingImageFilterPointer  m_TransformMovingImageFilter;
-  DifferenceImageFilterPointer       m_DifferenceImageFilter;
-  RescaleIntensityImageFilterPointer m_RescaleImageFilter;
-  MultiplyImageFilterPointer         m_MultiplyImageFilter;
-  double                             m_NoiseConstant;
-  unsigned int                       m_NeighborhoodRadius;
-  double                             m_DerivativeDelta;
-  double                             m_NormalizationFactor;
-  double                             m_Rescalingfactor;
-  bool                               m_OptimizeNormalizationFactor;
-  ScalesType                         m_Scales;
-  MeasureType                        m_FixedMeasure;
-  CombinationTransformPointer        m_CombinationTransform;
+  /** Store the pixels at which the pattern intensity is computed: the
+   * pixels of the current samples if UseImageSampler is true, or else all
+   * pixels of the fixed image inside the fixed mask.
+   */
+  void ComputePatternIntensityIndices( void ) const;
+
+  /** Sum the pattern intensity of the image given by valueAt( index ) over
+   * the neighborhoods of the stored pixels, in a chunk of pixels per work unit.
+   */
+  template< class TValueFunction >
+  MeasureType AccumulatePatternIntensity( const TValueFunction & valueAt ) const;
+
+  TransformMovingImageFilterPointer          m_TransformMovingImageFilter;
+  RescaleIntensityImageFilterPointer         m_RescaleImageFilter;
+  mutable std::vector< FixedImageIndexType > m_PatternIntensityIndices;
+  double                                     m_NoiseConstant;
+  unsigned int                               m_NeighborhoodRadius;
+  double                                     m_DerivativeDelta;
+  double                                     m_NormalizationFactor;
+  double                                     m_Rescalingfactor;
+  bool                                       m_OptimizeNormalizationFactor;
+  ScalesType                                 m_Scales;
+  MeasureType                                m_FixedMeasure;
+  CombinationTransformPointer                m_CombinationTransform;
 
 };
 
@@ -22,6 +22,7 @@
 #include "itkImageRegionConstIteratorWithIndex.h"
 #include "itkNumericTraits.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <iomanip>
@@ -49,8 +50,6 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
   this->m_TransformMovingImageFilter  = TransformMovingImageFilterType::New();
   this->m_CombinationTransform        = CombinationTransformType::New();
   this->m_RescaleImageFilter          = RescaleIntensityImageFilterType::New();
-  this->m_DifferenceImageFilter       = DifferenceImageFilterType::New();
-  this->m_MultiplyImageFilter         = MultiplyImageFilterType::New();
 
 } // end Constructor
 
@@ -96,14 +95,15 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
   //this->InitializeLimiters();
 
   this->m_NormalizationFactor = this->m_FixedImageTrueMax / this->m_MovingImageTrueMax;
-  this->m_MultiplyImageFilter->SetInput(
-    this->m_TransformMovingImageFilter->GetOutput() );
-  this->m_MultiplyImageFilter->SetConstant(
-    this->m_NormalizationFactor );
-  this->m_DifferenceImageFilter->SetInput1( this->m_FixedImage );
-  this->m_DifferenceImageFilter->SetInput2( this->m_MultiplyImageFilter->GetOutput() );
-  this->m_DifferenceImageFilter->UpdateLargestPossibleRegion();
-  this->m_FixedMeasure = this->ComputePIFixed();
+
+  /** Without the image sampler, the pixels and the fixed pattern intensity
+   * do not change during the registration.
+   */
+  if( !this->GetUseImageSampler() )
+  {
+    this->ComputePatternIntensityIndices();
+    this->m_FixedMeasure = this->ComputePIFixed();
+  }
 
   /* to rescale the similarity measure between 0-1;*/
   MeasureType tmpmeasure = this->GetValue( this->m_Transform->GetParameters() );
@@ -127,111 +127,139 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
 {
   Superclass::PrintSelf( os, indent );
   os << indent << "DerivativeDelta: " << this->m_DerivativeDelta << std::endl;
+  os << indent << "NumberOfPatternIntensityPixels: " << this->m_PatternIntensityIndices.size() << std::endl;
 
 } // end PrintSelf()
 
 
 /**
- * ********************* ComputePIFixed ******************************
+ * ********************* ComputePatternIntensityIndices ******************************
  */
 
 template< class TFixedImage, class TMovingImage >
-typename PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+void
 PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
-::ComputePIFixed() const
+::ComputePatternIntensityIndices( void ) const
 {
-  MeasureType measure = NumericTraits< MeasureType >::Zero;
-  MeasureType diff    = NumericTraits< MeasureType >::Zero;
-
+  /** The pixels of which the neighborhood is inside the fixed image. */
   typename FixedImageType::SizeType iterationSize
     = this->m_FixedImage->GetLargestPossibleRegion().GetSize();
-  typename FixedImageType::IndexType iterationStartIndex, currentIndex, neighborIndex;
-  typename FixedImageType::SizeType neighborIterationSize;
-  typename FixedImageType::PointType point;
-
-  iterationSize.Fill( 1 ); neighborIterationSize.Fill( 1 ); iterationStartIndex.Fill( 0 );
+  FixedImageIndexType iterationStartIndex;
+  iterationStartIndex.Fill( 0 );
   for( unsigned int i = 0; i < 2; ++i ) // Only 2D
   {
-    iterationSize[ i ]        -= static_cast< int >( 2 * this->m_NeighborhoodRadius );
-    iterationStartIndex[ i ]   = static_cast< int >( this->m_NeighborhoodRadius );
-    neighborIterationSize[ i ] = static_cast< int >( 2 * this->m_NeighborhoodRadius ) + 1;
+    iterationSize[ i ]      -= static_cast< int >( 2 * this->m_NeighborhoodRadius );
+    iterationStartIndex[ i ] = static_cast< int >( this->m_NeighborhoodRadius );
   }
 
-  typename FixedImageType::RegionType iterationRegion, neighboriterationRegion;
+  typename FixedImageType::RegionType iterationRegion;
   iterationRegion.SetIndex( iterationStartIndex );
   iterationRegion.SetSize( iterationSize );
 
-  typedef  itk::ImageRegionConstIteratorWithIndex< FixedImageType > FixedImageTypeIteratorType;
-
-  FixedImageTypeIteratorType fixedImageIt( this->m_FixedImage, iterationRegion );
-  fixedImageIt.GoToBegin();
-
-  neighboriterationRegion.SetSize( neighborIterationSize );
-
-  bool sampleOK = false;
-
-  if( this->m_FixedImageMask.IsNull() )
+  this->m_PatternIntensityIndices.clear();
+  if( this->GetUseImageSampler() )
   {
-    sampleOK = true;
+    /** The fixed mask is taken into account by the image sampler. */
+    const ImageSampleContainerType * sampleContainer = this->GetImageSampler()->GetOutput();
+    this->m_PatternIntensityIndices.reserve( sampleContainer->Size() );
+    for( SizeValueType i = 0; i < sampleContainer->Size(); ++i )
+    {
+      FixedImageIndexType index;
+      if( this->m_FixedImage->TransformPhysicalPointToIndex(
+        sampleContainer->ElementAt( i ).m_ImageCoordinates, index )
+        && iterationRegion.IsInside( index ) )
+      {
+        this->m_PatternIntensityIndices.push_back( index );
+      }
+    }
+    return;
   }
 
-  while( !fixedImageIt.IsAtEnd() )
+  typedef itk::ImageRegionConstIteratorWithIndex< FixedImageType > FixedImageTypeIteratorType;
+  FixedImageTypeIteratorType fixedImageIt( this->m_FixedImage, iterationRegion );
+  typename FixedImageType::PointType point;
+  for( fixedImageIt.GoToBegin(); !fixedImageIt.IsAtEnd(); ++fixedImageIt )
   {
-    /** Get current index */
-    currentIndex = fixedImageIt.GetIndex();
-    this->m_FixedImage->TransformIndexToPhysicalPoint( currentIndex, point );
-
     /** if fixedMask is given */
+    const FixedImageIndexType & currentIndex = fixedImageIt.GetIndex();
     if( !this->m_FixedImageMask.IsNull() )
     {
-      if( this->m_FixedImageMask->IsInsideInWorldSpace( point ) )
-      {
-        sampleOK = true;
-      }
-      else
+      this->m_FixedImage->TransformIndexToPhysicalPoint( currentIndex, point );
+      if( !this->m_FixedImageMask->IsInsideInWorldSpace( point ) )
       {
-        sampleOK = false;
+        continue;
       }
     }
+    this->m_PatternIntensityIndices.push_back( currentIndex );
+  }
 
-    if( sampleOK )
-    {
-      /** setup the neighborhood iterator */
-      neighborIndex.Fill( 0 );
-      for( unsigned int i = 0; i < 2; ++i ) // 2D only
-      {
-        neighborIndex[ i ] = currentIndex[ i ] - this->m_NeighborhoodRadius;
-      }
-
-      neighboriterationRegion.SetIndex( neighborIndex );
-      FixedImageTypeIteratorType neighborIt( this->m_FixedImage, neighboriterationRegion );
-      neighborIt.GoToBegin();
+} // end ComputePatternIntensityIndices()
 
-      while( !neighborIt.IsAtEnd() )
-      {
-        diff     = fixedImageIt.Value() - neighborIt.Value();
-        measure += ( this->m_NoiseConstant ) / ( this->m_NoiseConstant + ( diff * diff ) );
-        ++neighborIt;
-      } // end while neighborIt
 
-    } // end if sampleOK
+/**
+ * ********************* AccumulatePatternIntensity ******************************
+ */
 
-    ++fixedImageIt;
-  } //end while fixedImageIt
+template< class TFixedImage, class TMovingImage >
+template< class TValueFunction >
+typename PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
+::AccumulatePatternIntensity( const TValueFunction & valueAt ) const
+{
+  const SizeValueType numberOfPixels = this->m_PatternIntensityIndices.size();
+  const unsigned int  numberOfChunks = Self::GetNumberOfReductionChunks();
+  const SizeValueType chunkSize      = ( numberOfPixels + numberOfChunks - 1 ) / numberOfChunks;
+  const int           radius         = static_cast< int >( this->m_NeighborhoodRadius );
+  const MeasureType   noiseConstant  = this->m_NoiseConstant;
+
+  std::vector< MeasureType > partialMeasures( numberOfChunks, NumericTraits< MeasureType >::Zero );
+  this->ProcessSlices( numberOfChunks, true,
+    [this, &valueAt, &partialMeasures, numberOfPixels, chunkSize, radius, noiseConstant](
+    const unsigned int chunk )
+    {
+      const SizeValueType chunkBegin = std::min( chunk * chunkSize, numberOfPixels );
+      const SizeValueType chunkEnd   = std::min( chunkBegin + chunkSize, numberOfPixels );
+      MeasureType         measure    = NumericTraits< MeasureType >::Zero;
+      for( SizeValueType i = chunkBegin; i < chunkEnd; ++i )
+      {
+        const FixedImageIndexType & currentIndex = this->m_PatternIntensityIndices[ i ];
+        const MeasureType           currentValue = valueAt( currentIndex );
+
+        /** Loop over the 2D neighborhood. */
+        FixedImageIndexType neighborIndex = currentIndex;
+        for( int y = -radius; y <= radius; ++y )
+        {
+          neighborIndex[ 1 ] = currentIndex[ 1 ] + y;
+          for( int x = -radius; x <= radius; ++x )
+          {
+            neighborIndex[ 0 ] = currentIndex[ 0 ] + x;
+            const MeasureType diff = currentValue - valueAt( neighborIndex );
+            measure += noiseConstant / ( noiseConstant + ( diff * diff ) );
+          }
+        }
+      }
+      partialMeasures[ chunk ] = measure;
+    } );
 
+  /** Sum in a fixed order, to be independent of the scheduling. */
+  MeasureType measure = NumericTraits< MeasureType >::Zero;
+  for( unsigned int chunk = 0; chunk < numberOfChunks; ++chunk )
+  {
+    measure += partialMeasures[ chunk ];
+  }
   return measure;
 
-} // end ComputePIFixed()
+} // end AccumulatePatternIntensity()
 
 
 /**
- * ********************* ComputePIDiff ******************************
+ * ********************* UpdateTransformedMovingImage ******************************
  */
 
 template< class TFixedImage, class TMovingImage >
-typename PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+void
 PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
-::ComputePIDiff( const TransformParametersType & parameters, float scalingfactor ) const
+::UpdateTransformedMovingImage( const TransformParametersType & parameters ) const
 {
   /** Call non-thread-safe stuff, such as:
    *   this->SetTransformParameters( parameters );
@@ -247,92 +275,54 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
    * - Now you can call GetValueAndDerivative multi-threaded.
    */
   this->BeforeThreadedGetValueAndDerivative( parameters );
-  //this->SetTransformParameters( parameters );
 
   this->m_TransformMovingImageFilter->Modified();
-  this->m_MultiplyImageFilter->SetConstant( scalingfactor );
-  this->m_DifferenceImageFilter->UpdateLargestPossibleRegion();
-  MeasureType measure = NumericTraits< MeasureType >::Zero;
-  MeasureType diff    = NumericTraits< MeasureType >::Zero;
-
-  typename FixedImageType::SizeType iterationSize
-    = this->m_FixedImage->GetLargestPossibleRegion().GetSize();
-  typename FixedImageType::IndexType iterationStartIndex, currentIndex, neighborIndex;
-  typename FixedImageType::SizeType neighborIterationSize;
-  typename FixedImageType::PointType point;
-
-  iterationSize.Fill( 1 ); neighborIterationSize.Fill( 1 ); iterationStartIndex.Fill( 0 );
-  for( unsigned int i = 0; i < 2; ++i ) // Only 2D
-  {
-    iterationSize[ i ]        -= static_cast< int >( 2 * this->m_NeighborhoodRadius );
-    iterationStartIndex[ i ]   = static_cast< int >( this->m_NeighborhoodRadius );
-    neighborIterationSize[ i ] = static_cast< int >( 2 * this->m_NeighborhoodRadius + 1 );
-  }
-
-  typename FixedImageType::RegionType iterationRegion, neighboriterationRegion;
-  iterationRegion.SetIndex( iterationStartIndex );
-  iterationRegion.SetSize( iterationSize );
-
-  typedef itk::ImageRegionConstIteratorWithIndex< TransformedMovingImageType >
-    DifferenceImageIteratorType;
-  DifferenceImageIteratorType differenceImageIt(
-  this->m_DifferenceImageFilter->GetOutput(), iterationRegion );
-  differenceImageIt.GoToBegin();
+  this->m_TransformMovingImageFilter->UpdateLargestPossibleRegion();
 
-  neighboriterationRegion.SetSize( neighborIterationSize );
+} // end UpdateTransformedMovingImage()
 
-  bool sampleOK = false;
-  if( this->m_FixedImageMask.IsNull() )
-  {
-    sampleOK = true;
-  }
 
-  while( !differenceImageIt.IsAtEnd() )
-  {
-    /** Get current index */
-    currentIndex = differenceImageIt.GetIndex();
-    this->m_FixedImage->TransformIndexToPhysicalPoint( currentIndex, point );
-
-    /** if fixedMask is given */
-    if( !this->m_FixedImageMask.IsNull() )
-    {
-      if( this->m_FixedImageMask->IsInsideInWorldSpace( point ) )
-      {
-        sampleOK = true;
-      }
-      else
-      {
-        sampleOK = false;
-      }
-    }
+/**
+ * ********************* ComputePIFixed ******************************
+ */
 
-    if( sampleOK )
+template< class TFixedImage, class TMovingImage >
+typename PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePIFixed() const
+{
+  const FixedImageType * fixedImage = this->m_FixedImage;
+  return this->AccumulatePatternIntensity(
+    [fixedImage]( const FixedImageIndexType & index )
     {
-      /** setup the neighborhood iterator */
-      neighborIndex.Fill( 0 );
-      for( unsigned int i = 0; i < 2; ++i ) // 2D only
-      {
-        neighborIndex[ i ] = currentIndex[ i ] - this->m_NeighborhoodRadius;
-      }
-
-      neighboriterationRegion.SetIndex( neighborIndex );
-      DifferenceImageIteratorType neighborIt(
-      this->m_DifferenceImageFilter->GetOutput(), neighboriterationRegion );
-      neighborIt.GoToBegin();
+      return static_cast< MeasureType >( fixedImage->GetPixel( index ) );
+    } );
 
-      while( !neighborIt.IsAtEnd() )
-      {
-        diff     = differenceImageIt.Value() - neighborIt.Value();
-        measure += this->m_NoiseConstant / ( this->m_NoiseConstant + ( diff * diff ) );
-        ++neighborIt;
-      } // end while neighborIt
+} // end ComputePIFixed()
 
-    } // end if sampleOK
 
-    ++differenceImageIt;
-  } // end while differenceImageIt
+/**
+ * ********************* ComputePIDiff ******************************
+ */
 
-  return measure;
+template< class TFixedImage, class TMovingImage >
+typename PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
+::ComputePIDiff( const float scalingfactor ) const
+{
+  /** The difference of the fixed image and the scaled projection, in the
+   * pixel type of the fixed image.
+   */
+  const FixedImageType *             fixedImage  = this->m_FixedImage;
+  const TransformedMovingImageType * movingImage = this->m_TransformMovingImageFilter->GetOutput();
+  return this->AccumulatePatternIntensity(
+    [fixedImage, movingImage, scalingfactor]( const FixedImageIndexType & index )
+    {
+      const FixedImagePixelType scaledMovingValue
+        = static_cast< FixedImagePixelType >( movingImage->GetPixel( index ) * scalingfactor );
+      return static_cast< MeasureType >( static_cast< FixedImagePixelType >(
+        fixedImage->GetPixel( index ) - scaledMovingValue ) );
+    } );
 
 } // end ComputePIDiff()
 
@@ -346,24 +336,19 @@ typename PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >::Measur
 PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
 ::GetValue( const TransformParametersType & parameters ) const
 {
-  /** Call non-thread-safe stuff, such as:
-   *   this->SetTransformParameters( parameters );
-   *   this->GetImageSampler()->Update();
-   * Because of these calls GetValueAndDerivative itself is not thread-safe,
-   * so cannot be called multiple times simultaneously.
-   * This is however needed in the CombinationImageToImageMetric.
-   * In that case, you need to:
-   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
-   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
-   *   calling GetValueAndDerivative
-   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
-   * - Now you can call GetValueAndDerivative multi-threaded.
+  /** Compute the projection of the moving image once for all scaling factors. */
+  this->UpdateTransformedMovingImage( parameters );
+
+  /** With the image sampler, the fixed pattern intensity is computed at the
+   * current samples.
    */
-  this->BeforeThreadedGetValueAndDerivative( parameters );
-  //this->SetTransformParameters( parameters );
+  MeasureType fixedMeasure = this->m_FixedMeasure;
+  if( this->GetUseImageSampler() )
+  {
+    this->ComputePatternIntensityIndices();
+    fixedMeasure = this->ComputePIFixed();
+  }
 
-  this->m_TransformMovingImageFilter->Modified();
-  this->m_DifferenceImageFilter->UpdateLargestPossibleRegion();
   MeasureType measure        = 1e10;
   MeasureType currentMeasure = 1e10;
 
@@ -376,8 +361,8 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
 
     while( tmpfactor <=  this->m_NormalizationFactor * 1.0 )
     {
-      measure    = this->ComputePIDiff( parameters, tmpfactor );
-      tmpMeasure = ( measure - this->m_FixedMeasure ) / -this->m_Rescalingfactor;
+      measure    = this->ComputePIDiff( tmpfactor );
+      tmpMeasure = ( measure - fixedMeasure ) / -this->m_Rescalingfactor;
 
       if( tmpMeasure < currentMeasure )
       {
@@ -390,8 +375,8 @@ PatternIntensityImageToImageMetric< TFixedImage, TMovingImage >
   }
   else
   {
-    measure        = this->ComputePIDiff( parameters, this->m_NormalizationFactor );
-    currentMeasure = -( measure - this->m_FixedMeasure ) / this->m_Rescalingfactor;
+    measure        = this->ComputePIDiff( this->m_NormalizationFactor );
+    currentMeasure = -( measure - fixedMeasure ) / this->m_Rescalingfactor;
   }
 
   return currentMeasure;
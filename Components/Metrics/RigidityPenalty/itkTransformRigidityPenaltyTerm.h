@@ -322,7 +322,10 @@ private:
   void CreateNDOperator( NeighborhoodType & F, const std::string & whichF,
     const CoefficientImageSpacingType & spacing ) const;
 
-  /** Private function used for the filtering. It performs 1D separable filtering. */
+  /** Private function used for the filtering. It performs 1D separable filtering.
+   * The 3-tap operators are applied directly to the image buffer, one pass
+   * per dimension, with the lines of a pass distributed over the threads.
+   */
   CoefficientImagePointer FilterSeparable( const CoefficientImageType *,
     const std::vector< NeighborhoodType > & Operators ) const;
 
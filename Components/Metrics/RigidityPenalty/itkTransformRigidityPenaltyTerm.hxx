@@ -22,6 +22,8 @@
 
 #include "itkZeroFluxNeumannBoundaryCondition.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
@@ -2392,26 +2394,78 @@ TransformRigidityPenaltyTerm< TFixedImage, TScalarType >
   const CoefficientImageType * image,
   const std::vector< NeighborhoodType > & Operators ) const
 {
-  /** Create filters, supply them with boundary conditions and operators. */
-  std::vector< typename NOIFType::Pointer > filters( ImageDimension );
+  typedef typename CoefficientImageType::PixelType CoefficientPixelType;
+
+  /** Create the output image, with the geometry of the input image. */
+  CoefficientImagePointer output = CoefficientImageType::New();
+  output->CopyInformation( image );
+  output->SetRegions( image->GetBufferedRegion() );
+  output->Allocate();
+
+  const typename CoefficientImageType::SizeType size
+    = image->GetBufferedRegion().GetSize();
+  const SizeValueType numberOfPixels
+    = image->GetBufferedRegion().GetNumberOfPixels();
+
+  /** The passes alternate between the output and a temporary buffer,
+   * such that the last pass writes to the output.
+   */
+  std::vector< CoefficientPixelType > buffer( ImageDimension > 1 ? numberOfPixels : 0 );
+  const CoefficientPixelType * source = image->GetBufferPointer();
+
+  SizeValueType stride = 1;
   for( unsigned int i = 0; i < ImageDimension; i++ )
   {
-    filters[ i ] = NOIFType::New();
-    filters[ i ]->SetOperator( Operators[ i ] );
-  }
+    CoefficientPixelType * target = ( ( ImageDimension - 1 - i ) % 2 == 0 )
+      ? output->GetBufferPointer() : &buffer[ 0 ];
 
-  /** Set up the mini-pipline. */
-  filters[ 0 ]->SetInput( image );
-  for( unsigned int i = 1; i < ImageDimension; i++ )
-  {
-    filters[ i ]->SetInput( filters[ i - 1 ]->GetOutput() );
-  }
+    /** The operators are 1D, with radius 1 along dimension i. Their
+     * element 1 is the center, and the boundaries are zero flux Neumann,
+     * as in the NeighborhoodOperatorImageFilter.
+     */
+    const ScalarType op0 = Operators[ i ][ 0 ];
+    const ScalarType op1 = Operators[ i ][ 1 ];
+    const ScalarType op2 = Operators[ i ][ 2 ];
 
-  /** Execute the mini-pipeline. */
-  filters[ ImageDimension - 1 ]->Update();
+    const SizeValueType length        = size[ i ];
+    const SizeValueType numberOfLines = numberOfPixels / length;
+
+    /** Filter the lines along dimension i in chunks, which are disjoint. */
+    const SizeValueType numberOfChunks
+      = std::min< SizeValueType >( numberOfLines, Self::GetNumberOfWorkUnits() );
+    const SizeValueType linesPerChunk
+      = ( numberOfLines + numberOfChunks - 1 ) / numberOfChunks;
+
+    this->ProcessSlices( static_cast< unsigned int >( numberOfChunks ), true,
+      [ = ]( const unsigned int chunk )
+      {
+        const SizeValueType lineBegin = std::min( chunk * linesPerChunk, numberOfLines );
+        const SizeValueType lineEnd   = std::min( lineBegin + linesPerChunk, numberOfLines );
+        for( SizeValueType line = lineBegin; line < lineEnd; ++line )
+        {
+          const SizeValueType          base = ( line % stride ) + ( line / stride ) * stride * length;
+          const CoefficientPixelType * in   = source + base;
+          CoefficientPixelType *       out  = target + base;
+          for( SizeValueType x = 0; x < length; ++x )
+          {
+            const SizeValueType previous = ( x > 0 ) ? x - 1 : x;
+            const SizeValueType next     = ( x + 1 < length ) ? x + 1 : x;
+
+            ScalarType sum = NumericTraits< ScalarType >::Zero;
+            sum += op0 * in[ previous * stride ];
+            sum += op1 * in[ x * stride ];
+            sum += op2 * in[ next * stride ];
+            out[ x * stride ] = static_cast< CoefficientPixelType >( sum );
+          }
+        }
+      } );
+
+    source  = target;
+    stride *= length;
+  }
 
   /** Return the filtered image. */
-  return filters[ ImageDimension - 1 ]->GetOutput();
+  return output;
 
 } // end FilterSeparable()
 
@@ -43,6 +43,10 @@ using namespace itk;
  * \parameter BaseVariance: The width ($\sigma_0^2$) of the non-informative prior.
  *   Can be defined for each resolution\n
  *    example: <tt>(BaseVariance 1000.0)</tt>
+ * \parameter UseMultiThreadingForMetrics: Whether the points are processed in
+ *    parallel. Can be given for each resolution.\n
+ *    example: <tt>(UseMultiThreadingForMetrics "false")</tt>\n
+ *    The default is "true".
  *
  * \author F.F. Berendsen, Image Sciences Institute, UMC Utrecht, The Netherlands
  * \note This work was funded by the projects Care4Me and Mediate.
@@ -275,6 +275,12 @@ StatisticalShapePenalty< TElastix >
     "CutOffSharpness", this->GetComponentLabel(), level, 0 );
   this->SetCutOffSharpness( cutOffSharpness );
 
+  /** Should the metric use multi-threading? */
+  bool useMultiThreading = true;
+  this->GetConfiguration()->ReadParameter( useMultiThreading,
+    "UseMultiThreadingForMetrics", this->GetComponentLabel(), level, 0 );
+  this->SetUseMultiThread( useMultiThreading );
+
 } // end BeforeEachResolution()
 
 
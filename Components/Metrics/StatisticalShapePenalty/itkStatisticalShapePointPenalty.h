@@ -35,6 +35,7 @@
 #include <vnl/algo/vnl_svd_economy.h>
 
 #include <string>
+#include <vector>
 
 namespace itk
 {
@@ -42,6 +43,14 @@ namespace itk
  * \brief Computes the Mahalanobis distance between the transformed shape and a mean shape.
  *  A model mean and covariance are required.
  *
+ * The points are transformed in parallel. The derivative is computed from
+ * the gradient of the value with respect to the proposal vector. This
+ * gradient is propagated back through the alignment and the size
+ * normalization to a gradient per point, which is multiplied with the
+ * Jacobians of the points in parallel. The transposed eigenvectors are
+ * cached by Initialize(), so that the projections on the shape model read
+ * contiguous rows.
+ *
  * \author F.F. Berendsen, Image Sciences Institute, UMC Utrecht, The Netherlands
  * \note This work was funded by the projects Care4Me and Mediate.
  * \note If you use the StatisticalShapePenalty anywhere we would appreciate if you cite the following article:\n
@@ -96,10 +105,7 @@ public:
   typedef typename OutputPointType::CoordRepType CoordRepType;
   typedef vnl_vector< CoordRepType >             VnlVectorType;
   typedef vnl_matrix< CoordRepType >             VnlMatrixType;
-  //typedef itk::Array<VnlVectorType *> ProposalDerivativeType;
-  typedef typename std::vector< VnlVectorType * > ProposalDerivativeType;
-  //typedef typename vnl_vector<VnlVectorType *> ProposalDerivativeType; //Cannot be linked
-  typedef vnl_svd_economy< CoordRepType > PCACovarianceType;
+  typedef vnl_svd_economy< CoordRepType >        PCACovarianceType;
 
   /** Initialization. */
   void Initialize( void ) override;
@@ -183,30 +189,35 @@ private:
   StatisticalShapePointPenalty( const Self & );  // purposely not implemented
   void operator=( const Self & );                // purposely not implemented
 
-  void FillProposalVector( const OutputPointType & fixedPoint,
-    const unsigned int vertexindex ) const;
-
-  void FillProposalDerivative( const OutputPointType & fixedPoint,
-    const unsigned int vertexindex ) const;
+  /** Transform the points and fill the proposal vector, aligned and
+   * normalized if m_NormalizedShapeModel.
+   */
+  void FillProposalVector( const unsigned int shapeLength ) const;
 
   void UpdateCentroidAndAlignProposalVector(
     const unsigned int shapeLength ) const;
 
-  void UpdateCentroidAndAlignProposalDerivative(
-    const unsigned int shapeLength ) const;
-
   void UpdateL2( const unsigned int shapeLength ) const;
 
   void NormalizeProposalVector( const unsigned int shapeLength ) const;
 
-  void UpdateL2AndNormalizeProposalDerivative( const unsigned int shapeLength ) const;
+  /** Compute the value from m_ProposalVector. It leaves the difference with
+   * the mean and its projections on the eigenvectors in the scratch vectors.
+   */
+  void CalculateValue( MeasureType & value ) const;
+
+  /** Compute m_ProposalGradient, the derivative of the value, before the
+   * cut-off, with respect to the proposal vector.
+   */
+  void CalculateProposalGradient( const MeasureType & value ) const;
 
-  void CalculateValue( MeasureType & value, VnlVectorType & differenceVector,
-    VnlVectorType & centerrotated, VnlVectorType & eigrot ) const;
+  /** Propagate m_ProposalGradient back to m_PointGradients, the derivative
+   * of the value with respect to the transformed points.
+   */
+  void CalculatePointGradients( const unsigned int shapeLength ) const;
 
-  void CalculateDerivative( DerivativeType & derivative, const MeasureType & value,
-    const VnlVectorType & differenceVector, const VnlVectorType & centerrotated,
-    const VnlVectorType & eigrot, const unsigned int shapeLength ) const;
+  /** Multiply m_PointGradients with the Jacobians of the points. */
+  void CalculateDerivative( DerivativeType & derivative ) const;
 
   void CalculateCutOffValue( MeasureType & value ) const;
 
@@ -236,15 +247,28 @@ private:
 
   VnlVectorType * m_EigenValuesRegularized;
 
-  mutable ProposalDerivativeType * m_ProposalDerivative;
-  unsigned int                     m_ProposalLength;
-  bool                             m_NormalizedShapeModel;
-  int                              m_ShapeModelCalculation;
-  double                           m_ShrinkageIntensity;
-  double                           m_BaseVariance;
-  double                           m_BaseStd;
-  mutable VnlVectorType            m_ProposalVector;
-  mutable VnlVectorType            m_MeanValues;
+  unsigned int          m_ProposalLength;
+  bool                  m_NormalizedShapeModel;
+  int                   m_ShapeModelCalculation;
+  double                m_ShrinkageIntensity;
+  double                m_BaseVariance;
+  double                m_BaseStd;
+  mutable VnlVectorType m_ProposalVector;
+  mutable VnlVectorType m_MeanValues;
+
+  /** The eigenvectors as rows, and the scales of the proposal elements of
+   * ShapeModelCalculation 2, set by Initialize().
+   */
+  VnlMatrixType m_EigenVectorsTransposed;
+  VnlVectorType m_ProposalScales;
+
+  /** Scratch vectors, allocated once and reused by every evaluation. */
+  mutable VnlVectorType                 m_DifferenceVector;
+  mutable VnlVectorType                 m_CenterRotated;
+  mutable VnlVectorType                 m_EigRot;
+  mutable VnlVectorType                 m_ProposalGradient;
+  mutable VnlVectorType                 m_PointGradients;
+  mutable std::vector< DerivativeType > m_ChunkDerivatives;
 
   double m_CutOffValue;
   double m_CutOffSharpness;
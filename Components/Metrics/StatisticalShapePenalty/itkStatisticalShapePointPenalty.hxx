@@ -19,6 +19,8 @@
 #define __itkStatisticalShapePointPenalty_hxx
 
 #include "itkStatisticalShapePointPenalty.h"
+#include "itkDenseLinearAlgebra.h"
+#include <algorithm>
 #include <cmath>
 
 namespace itk
@@ -35,7 +37,6 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   this->m_EigenVectors            = nullptr;
   this->m_EigenValues             = nullptr;
   this->m_EigenValuesRegularized  = nullptr;
-  this->m_ProposalDerivative      = nullptr;
   this->m_InverseCovarianceMatrix = nullptr;
 
   this->m_ShrinkageIntensityNeedsUpdate = true;
@@ -78,11 +79,6 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
     delete this->m_EigenValuesRegularized;
     this->m_EigenValuesRegularized = nullptr;
   }
-  if( this->m_ProposalDerivative != nullptr )
-  {
-    delete this->m_ProposalDerivative;
-    this->m_ProposalDerivative = nullptr;
-  }
   if( this->m_InverseCovarianceMatrix != nullptr )
   {
     delete this->m_InverseCovarianceMatrix;
@@ -177,7 +173,8 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
          * invertible Covariance Matrix. For a Moore-Penrose pseudo inverse use
          * ShrinkageIntensity=0 and ShapeModelCalculation=1 or 2.
          */
-        this->m_InverseCovarianceMatrix = new vnl_matrix< double >( vnl_svd_inverse( regularizedCovariance ) );
+        this->m_InverseCovarianceMatrix = new vnl_matrix< double >();
+        DenseLinearAlgebra::PseudoInverse( regularizedCovariance, 0.0, *this->m_InverseCovarianceMatrix );
       }
       this->m_EigenValuesRegularized = nullptr;
       break;
@@ -189,9 +186,11 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
         itkExceptionMacro( << "ShapeModelCalculation option 1 is only implemented for NormalizedShapeModel = false" );
       }
 
-      PCACovarianceType pcaCovariance( *this->m_CovarianceMatrix );
-      typename VnlVectorType::iterator lambdaIt  = pcaCovariance.lambdas().begin();
-      typename VnlVectorType::iterator lambdaEnd = pcaCovariance.lambdas().end();
+      VnlVectorType lambdas;
+      VnlMatrixType V;
+      DenseLinearAlgebra::SingularValueDecomposition( *this->m_CovarianceMatrix, lambdas, V );
+      typename VnlVectorType::iterator lambdaIt  = lambdas.begin();
+      typename VnlVectorType::iterator lambdaEnd = lambdas.end();
       unsigned int nonZeroLength = 0;
       for(; lambdaIt != lambdaEnd && ( *lambdaIt ) > 1e-14; ++lambdaIt, ++nonZeroLength )
       {}
@@ -199,13 +198,13 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
       {
         delete this->m_EigenValues;
       }
-      this->m_EigenValues = new VnlVectorType( pcaCovariance.lambdas().extract( nonZeroLength ) );
+      this->m_EigenValues = new VnlVectorType( lambdas.extract( nonZeroLength ) );
 
       if( this->m_EigenVectors != nullptr )
       {
         delete this->m_EigenVectors;
       }
-      this->m_EigenVectors = new VnlMatrixType( pcaCovariance.V().get_n_columns( 0, nonZeroLength ) );
+      this->m_EigenVectors = new VnlMatrixType( V.get_n_columns( 0, nonZeroLength ) );
 
       if( this->m_EigenValuesRegularized == nullptr )
       {
@@ -281,9 +280,11 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
         scaledCovariance.scale_row( shapeLength + 2, 1.0 / this->m_CentroidZStd );
         scaledCovariance.scale_row( shapeLength + 3, 1.0 / this->m_SizeStd );
 
-        PCACovarianceType pcaCovariance( scaledCovariance );
-        typename VnlVectorType::iterator lambdaIt  = pcaCovariance.lambdas().begin();
-        typename VnlVectorType::iterator lambdaEnd = pcaCovariance.lambdas().end();
+        VnlVectorType lambdas;
+        VnlMatrixType V;
+        DenseLinearAlgebra::SingularValueDecomposition( scaledCovariance, lambdas, V );
+        typename VnlVectorType::iterator lambdaIt  = lambdas.begin();
+        typename VnlVectorType::iterator lambdaEnd = lambdas.end();
         unsigned int nonZeroLength = 0;
         for(; lambdaIt != lambdaEnd && ( *lambdaIt ) > 1e-14; ++lambdaIt, ++nonZeroLength )
         {}
@@ -292,13 +293,13 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
         {
           delete this->m_EigenValues;
         }
-        this->m_EigenValues = new VnlVectorType( pcaCovariance.lambdas().extract( nonZeroLength ) );
+        this->m_EigenValues = new VnlVectorType( lambdas.extract( nonZeroLength ) );
 
         if( this->m_EigenVectors != nullptr )
         {
           delete this->m_EigenVectors;
         }
-        this->m_EigenVectors = new VnlMatrixType( pcaCovariance.V().get_n_columns( 0, nonZeroLength ) );
+        this->m_EigenVectors = new VnlMatrixType( V.get_n_columns( 0, nonZeroLength ) );
       }
       if( this->m_ShrinkageIntensityNeedsUpdate || pcaNeedsUpdate )
       {
@@ -344,6 +345,34 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
       this->m_EigenValuesRegularized  = nullptr;
   }
 
+  /** Cache the eigenvectors as rows, so that the projections on them, and
+   * their linear combinations, read contiguous memory.
+   */
+  if( this->m_ShapeModelCalculation == 1 || this->m_ShapeModelCalculation == 2 )
+  {
+    this->m_EigenVectorsTransposed = this->m_EigenVectors->transpose();
+    this->m_CenterRotated.set_size( this->m_EigenVectors->cols() );
+    this->m_EigRot.set_size( this->m_EigenVectors->cols() );
+  }
+  if( this->m_ShapeModelCalculation == 2 )
+  {
+    this->m_ProposalScales.set_size( this->m_ProposalLength );
+    for( unsigned int index = 0; index < shapeLength; ++index )
+    {
+      this->m_ProposalScales[ index ] = 1.0 / this->m_BaseStd;
+    }
+    this->m_ProposalScales[ shapeLength     ] = 1.0 / this->m_CentroidXStd;
+    this->m_ProposalScales[ shapeLength + 1 ] = 1.0 / this->m_CentroidYStd;
+    this->m_ProposalScales[ shapeLength + 2 ] = 1.0 / this->m_CentroidZStd;
+    this->m_ProposalScales[ shapeLength + 3 ] = 1.0 / this->m_SizeStd;
+  }
+
+  /** Allocate the scratch vectors of the evaluations. */
+  this->m_ProposalVector.set_size( this->m_ProposalLength );
+  this->m_DifferenceVector.set_size( this->m_ProposalLength );
+  this->m_ProposalGradient.set_size( this->m_ProposalLength );
+  this->m_PointGradients.set_size( shapeLength );
+
 } // end Initialize()
 
 
@@ -364,62 +393,21 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   }
 
   /** Initialize some variables */
-  //this->m_NumberOfPointsCounted = 0;
   MeasureType value = NumericTraits< MeasureType >::Zero;
 
-  //InputPointType movingPoint;
-  OutputPointType fixedPoint;
-
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
   const unsigned int shapeLength = Self::FixedPointSetDimension
     * ( fixedPointSet->GetNumberOfPoints() );
-  this->m_ProposalVector.set_size( this->m_ProposalLength );
 
   /** Part 1:
    * - Copy point positions in proposal vector
+   * - Align and normalize the proposal vector
    */
+  this->FillProposalVector( shapeLength );
 
-  /** Create iterators. */
-  PointIterator pointItFixed = fixedPointSet->GetPoints()->Begin();
-  PointIterator pointEnd     = fixedPointSet->GetPoints()->End();
-
-  unsigned int vertexindex = 0;
-  /** Loop over the corresponding points. */
-  while( pointItFixed != pointEnd )
-  {
-    fixedPoint = pointItFixed.Value();
-    this->FillProposalVector( fixedPoint, vertexindex );
-
-    this->m_NumberOfPointsCounted++;
-    ++pointItFixed;
-    vertexindex += Self::FixedPointSetDimension;
-  } // end loop over all corresponding points
-
-  if( this->m_NormalizedShapeModel )
-  {
-    /** Part 2:
-     * - Calculate shape centroid
-     * - put centroid values in proposal
-     * - update proposal vector with aligned shape
-     */
-    this->UpdateCentroidAndAlignProposalVector( shapeLength );
-
-    /** Part 3:
-     * - Calculate l2-norm from aligned shapes
-     * - put l2-norm value in proposal vector
-     * - update proposal vector with size normalized shape
-     */
-    this->UpdateL2( shapeLength );
-    this->NormalizeProposalVector( shapeLength );
-  }
-
-  VnlVectorType differenceVector;
-  VnlVectorType centerrotated;
-  VnlVectorType eigrot;
-
-  this->CalculateValue( value, differenceVector, centerrotated, eigrot );
+  this->CalculateValue( value );
 
   return value;
 
@@ -465,97 +453,35 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
   }
 
   /** Initialize some variables */
-  //this->m_NumberOfPointsCounted = 0;
   value      = NumericTraits< MeasureType >::Zero;
   derivative = DerivativeType( this->GetNumberOfParameters() );
   derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
 
-  //InputPointType movingPoint;
-  OutputPointType fixedPoint;
-
   /** Make sure the transform parameters are up to date. */
   this->SetTransformParameters( parameters );
 
   const unsigned int shapeLength = Self::FixedPointSetDimension
     * fixedPointSet->GetNumberOfPoints();
 
-  this->m_ProposalVector.set_size( this->m_ProposalLength );
-  this->m_ProposalDerivative = new ProposalDerivativeType( this->GetNumberOfParameters(), nullptr );
-
   /** Part 1:
    * - Copy point positions in proposal vector
-   * - Copy point derivatives in proposal derivative vector
+   * - Align and normalize the proposal vector
    */
+  this->FillProposalVector( shapeLength );
 
-  /** Create iterators. */
-  PointIterator pointItFixed = fixedPointSet->GetPoints()->Begin();
-  PointIterator pointEnd     = fixedPointSet->GetPoints()->End();
-
-  unsigned int vertexindex = 0;
-  /** Loop over the corresponding points. */
-  while( pointItFixed != pointEnd )
-  {
-    fixedPoint = pointItFixed.Value();
-    this->FillProposalVector( fixedPoint, vertexindex );
-    this->FillProposalDerivative( fixedPoint, vertexindex );
-
-    this->m_NumberOfPointsCounted++;
-    ++pointItFixed;
-    vertexindex += Self::FixedPointSetDimension;
-  } // end loop over all corresponding points
-
-  if( this->m_NormalizedShapeModel )
-  {
-    /** Part 2:
-     * - Calculate shape centroid
-     * - put centroid values in proposal
-     * - update proposal vector with aligned shape
-     * - Calculate centroid derivatives and update proposal derivative vectors
-     * - put centroid derivatives values in proposal derivatives
-     * - update proposal derivatives
-     */
-    this->UpdateCentroidAndAlignProposalVector( shapeLength );
-    this->UpdateCentroidAndAlignProposalDerivative( shapeLength );
-
-    /** Part 3:
-     * - Calculate l2-norm from aligned shapes
-     * - put l2-norm value in proposal vector
-     * - update proposal vector with size normalized shape
-     * - Calculate l2-norm derivatice from updated proposal vector
-     * - put l2-norm derivative value in proposal derivative vectors
-     * - update proposal derivatives
-     */
-    this->UpdateL2( shapeLength );
-    this->UpdateL2AndNormalizeProposalDerivative( shapeLength );
-    this->NormalizeProposalVector( shapeLength );
-
-  } // end if(m_NormalizedShapeModel)
-
-  // TODO this declaration instantiates a zero sized vector, but it will be reassigned anyways.
-  VnlVectorType differenceVector;
-  VnlVectorType centerrotated;
-  VnlVectorType eigrot;
-
-  this->CalculateValue( value, differenceVector, centerrotated, eigrot );
+  this->CalculateValue( value );
 
+  /** Part 2:
+   * - Calculate the derivative with respect to the proposal vector
+   * - Propagate it back to the points
+   * - Multiply with the Jacobians of the points
+   */
   if( value != 0.0 )
   {
-    this->CalculateDerivative( derivative, value, differenceVector, centerrotated, eigrot, shapeLength );
-  }
-  else
-  {
-    typename ProposalDerivativeType::iterator proposalDerivativeIt  = this->m_ProposalDerivative->begin();
-    typename ProposalDerivativeType::iterator proposalDerivativeEnd = this->m_ProposalDerivative->end();
-    for(; proposalDerivativeIt != proposalDerivativeEnd; ++proposalDerivativeIt )
-    {
-      if( *proposalDerivativeIt != nullptr )
-      {
-        delete ( *proposalDerivativeIt );
-      }
-    }
+    this->CalculateProposalGradient( value );
+    this->CalculatePointGradients( shapeLength );
+    this->CalculateDerivative( derivative );
   }
-  delete this->m_ProposalDerivative;
-  this->m_ProposalDerivative = nullptr;
 
   this->CalculateCutOffValue( value );
 
@@ -569,66 +495,37 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::FillProposalVector( const OutputPointType & fixedPoint,
-  const unsigned int vertexindex ) const
+::FillProposalVector( const unsigned int shapeLength ) const
 {
-  OutputPointType mappedPoint;
-  /** Get the current corresponding points. */
-  mappedPoint = this->m_Transform->TransformPoint( fixedPoint );
+  const typename FixedPointSetType::PointsContainer * fixedPoints
+    = this->GetFixedPointSet()->GetPoints();
+  const SizeValueType numberOfPoints = fixedPoints->Size();
+  this->m_NumberOfPointsCounted = numberOfPoints;
 
   /** Copy n-D coordinates into big Shape vector. Aligning the centroids is done later. */
-  for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
-  {
-    this->m_ProposalVector[ vertexindex + d ] = mappedPoint[ d ];
-  }
-} // end FillProposalVector()
-
-
-/**
- * ******************* FillProposalDerivative *******************
- */
-
-template< class TFixedPointSet, class TMovingPointSet >
-void
-StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::FillProposalDerivative( const OutputPointType & fixedPoint,
-  const unsigned int vertexindex ) const
-{
-  /**
-   * A (column) vector is constructed for each mu, only if that mu affects the shape penalty.
-   * I.e. if there is at least one point of the mesh with non-zero derivatives,
-   * a full column vector is instantiated (which can contain zeros for many other points)
-   *
-   * m_ProposalDerivative is a container with either full shape-vector-sized derivative vectors or NULL-s. Example:
-   *
-   * mu1: [ [ dx1/dmu1 , dy1/dmu1 , dz1/dmu1 ] , [ 0 , 0 , 0 ] , [ dx3/dmu1 , dy3/dmu1 , dz3/dmu1 ] , [...] ]^T
-   * mu2: Null
-   * mu3: [ [ 0 , 0 , 0 ] , [ dx2/dmu3 , dy2/dmu3 , dz2/dmu3 ] , [ dx3/dmu3 , dy3/dmu3 , dz3/dmu3 ] , [...] ]^T
-   *
-   */
-
-  NonZeroJacobianIndicesType nzji(
-  this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
-
-  /** Get the TransformJacobian dT/dmu. */
-  TransformJacobianType jacobian;
-  this->m_Transform->GetJacobian( fixedPoint, jacobian, nzji );
-
-  for( unsigned int i = 0; i < nzji.size(); ++i )
-  {
-    const unsigned int mu = nzji[ i ];
-    if( ( *this->m_ProposalDerivative )[ mu ] == nullptr )
+  this->m_ProposalVector.set_size( this->m_ProposalLength );
+  this->ProcessPointChunks( numberOfPoints,
+    [ this, fixedPoints ]( const ThreadIdType, const SizeValueType begin, const SizeValueType end )
     {
-      /** Create the big column vector if it does not yet exist for this mu*/
-      ( *this->m_ProposalDerivative )[ mu ] = new VnlVectorType( this->m_ProposalLength, 0.0 );
-      // memory will be freed in CalculateDerivative()
-    }
+      for( SizeValueType i = begin; i < end; ++i )
+      {
+        const OutputPointType mappedPoint = this->m_Transform->TransformPoint( fixedPoints->ElementAt( i ) );
+        for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
+        {
+          this->m_ProposalVector[ i * Self::FixedPointSetDimension + d ] = mappedPoint[ d ];
+        }
+      }
+    } );
 
-    /** The column vector exists for this mu, so copy the jacobians for this point into the big vector. */
-    for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
-    {
-      ( *( *this->m_ProposalDerivative )[ mu ] )[ vertexindex + d ] = jacobian.get_column( i )[ d ];
-    }
+  if( this->m_NormalizedShapeModel )
+  {
+    /** Calculate the shape centroid, put it in the proposal, and align the
+     * shape. Then put the l2-norm of the aligned shape in the proposal and
+     * normalize the size of the shape.
+     */
+    this->UpdateCentroidAndAlignProposalVector( shapeLength );
+    this->UpdateL2( shapeLength );
+    this->NormalizeProposalVector( shapeLength );
   }
 
 } // end FillProposalVector()
@@ -670,44 +567,6 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 } // end UpdateCentroidAndAlignProposalVector()
 
 
-/**
- * ******************* UpdateCentroidAndAlignProposalDerivative *******************
- */
-
-template< class TFixedPointSet, class TMovingPointSet >
-void
-StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::UpdateCentroidAndAlignProposalDerivative( const unsigned int shapeLength ) const
-{
-  typename ProposalDerivativeType::iterator proposalDerivativeIt  = m_ProposalDerivative->begin();
-  typename ProposalDerivativeType::iterator proposalDerivativeEnd = m_ProposalDerivative->end();
-  while( proposalDerivativeIt != proposalDerivativeEnd )
-  {
-    if( *proposalDerivativeIt != nullptr )
-    {
-      for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
-      {
-        double & centroid_dDerivative = ( **proposalDerivativeIt )[ shapeLength + d ];
-        centroid_dDerivative = 0; // initialize accumulators to zero
-
-        for( unsigned int index = 0; index < shapeLength; index += Self::FixedPointSetDimension )
-        {
-          centroid_dDerivative += ( **proposalDerivativeIt )[ index + d ]; // sum all x derivatives
-        }
-
-        centroid_dDerivative /= this->GetFixedPointSet()->GetNumberOfPoints(); // divide sum to get average
-
-        for( unsigned int index = 0; index < shapeLength; index += Self::FixedPointSetDimension )
-        {
-          ( **proposalDerivativeIt )[ index + d ] -= centroid_dDerivative; // subtract average
-        }
-      }
-    }
-    ++proposalDerivativeIt;
-  }
-} // end UpdateCentroidAndAlignProposalDerivative()
-
-
 /**
  * ******************* UpdateL2 *******************
  */
@@ -753,214 +612,293 @@ StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
 
 
 /**
- * ******************* UpdateL2AndNormalizeProposalDerivative *******************
+ * ******************* CalculateValue *******************
  */
 
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::UpdateL2AndNormalizeProposalDerivative( const unsigned int shapeLength ) const
+::CalculateValue( MeasureType & value ) const
 {
-  double & l2norm = this->m_ProposalVector[ shapeLength + Self::FixedPointSetDimension ];
-
-  typename ProposalDerivativeType::iterator proposalDerivativeIt  = this->m_ProposalDerivative->begin();
-  typename ProposalDerivativeType::iterator proposalDerivativeEnd = this->m_ProposalDerivative->end();
+  const unsigned int proposalLength = this->m_ProposalLength;
+  double *           diff           = this->m_DifferenceVector.data_block();
+  for( unsigned int index = 0; index < proposalLength; ++index )
+  {
+    diff[ index ] = this->m_ProposalVector[ index ] - ( *this->m_MeanVector )[ index ];
+  }
 
-  while( proposalDerivativeIt != proposalDerivativeEnd )
+  switch( this->m_ShapeModelCalculation )
   {
-    if( *proposalDerivativeIt != nullptr )
+    case 0: // full covariance
     {
-      double & l2normDerivative = ( **proposalDerivativeIt )[ shapeLength + Self::FixedPointSetDimension ];
-      l2normDerivative = 0; // initialize to zero
-      // loop over all shape coordinates of the aligned shape
-      for( unsigned int index = 0; index < shapeLength; index++ )
+      /** Compute w = Sigma^-T * diff, with chunks of its elements in
+       * parallel, and keep it in m_ProposalGradient.
+       */
+      const VnlMatrixType & inverseCovariance = *this->m_InverseCovarianceMatrix;
+      double *              w                 = this->m_ProposalGradient.data_block();
+      this->ProcessPointChunks( proposalLength,
+        [ proposalLength, diff, w, &inverseCovariance ](
+        const ThreadIdType, const SizeValueType begin, const SizeValueType end )
+        {
+          std::fill( w + begin, w + end, 0.0 );
+          for( unsigned int row = 0; row < proposalLength; ++row )
+          {
+            const double   diffRow = diff[ row ];
+            const double * matrix  = inverseCovariance[ row ];
+            for( SizeValueType column = begin; column < end; ++column )
+            {
+              w[ column ] += diffRow * matrix[ column ];
+            }
+          }
+        } );
+
+      /** innerproduct diff^T * Sigma^-1 * diff */
+      value = sqrt( dot_product( this->m_DifferenceVector, this->m_ProposalGradient ) );
+      break;
+    }
+    case 1: // decomposed covariance (uniform regularization)
+    case 2: // decomposed scaled covariance (element specific regularization)
+    {
+      /** Evaluate with the eigenvalues and eigenvectors of the scaled covariance matrix. */
+      if( this->m_ShapeModelCalculation == 2 )
       {
-        l2normDerivative += this->m_ProposalVector[ index ] * ( **proposalDerivativeIt )[ index ];
+        for( unsigned int index = 0; index < proposalLength; ++index )
+        {
+          diff[ index ] *= this->m_ProposalScales[ index ];
+        }
       }
-      l2normDerivative /= ( l2norm * sqrt( (double)( this->GetFixedPointSet()->GetNumberOfPoints() ) ) );
 
-      // loop over all shape coordinates of the aligned shape
-      for( unsigned int index = 0; index < shapeLength; index++ )
+      /** centerrotated = diff^T * V and eigrot = diff^T * V * Lambda^-1 */
+      const unsigned int numberOfEigenVectors = this->m_EigenVectorsTransposed.rows();
+      this->ProcessPointChunks( numberOfEigenVectors,
+        [ this, proposalLength, diff ]( const ThreadIdType, const SizeValueType begin, const SizeValueType end )
+        {
+          for( SizeValueType k = begin; k < end; ++k )
+          {
+            const double * eigenVector = this->m_EigenVectorsTransposed[ k ];
+            double         projection  = 0.0;
+            for( unsigned int index = 0; index < proposalLength; ++index )
+            {
+              projection += diff[ index ] * eigenVector[ index ];
+            }
+            this->m_CenterRotated[ k ] = projection;
+            this->m_EigRot[ k ]        = projection / ( *this->m_EigenValuesRegularized )[ k ];
+          }
+        } );
+
+      /** innerproduct diff^T * V * Lambda^-1 * V^T * diff, plus diff^T * diff
+       * divided by Beta * sigma_0^2, or by Beta for the scaled covariance.
+       */
+      value = dot_product( this->m_EigRot, this->m_CenterRotated );
+      if( this->m_ShrinkageIntensity != 0 )
       {
-        // update normalized shape derivatives
-        ( **proposalDerivativeIt )[ index ] = ( **proposalDerivativeIt )[ index ]
-          / l2norm - this->m_ProposalVector[ index ] * l2normDerivative / ( l2norm * l2norm );
+        const double divisor = this->m_ShapeModelCalculation == 1
+          ? this->m_ShrinkageIntensity * this->m_BaseVariance
+          : this->m_ShrinkageIntensity;
+        value += this->m_DifferenceVector.squared_magnitude() / divisor;
       }
+      value = sqrt( value );
+      break;
     }
-    ++proposalDerivativeIt;
+    default:
+      break;
   }
 
-} //end UpdateL2AndNormalizeProposalDerivative()
+} //end CalculateValue()
 
 
 /**
- * ******************* CalculateValue *******************
+ * ******************* CalculateProposalGradient *******************
  */
 
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::CalculateValue( MeasureType & value,
-  VnlVectorType & differenceVector,
-  VnlVectorType & centerrotated,
-  VnlVectorType & eigrot ) const
+::CalculateProposalGradient( const MeasureType & value ) const
 {
-  differenceVector = this->m_ProposalVector - *m_MeanVector;
+  /** The factor of the cut-off applies to all elements. */
+  typename DerivativeType::element_type factor = 1.0 / value;
+  this->CalculateCutOffDerivative( factor, value );
+
+  const unsigned int proposalLength = this->m_ProposalLength;
+  double *           gradient       = this->m_ProposalGradient.data_block();
 
   switch( this->m_ShapeModelCalculation )
   {
     case 0: // full covariance
     {
-      value = sqrt( bracket( differenceVector, *this->m_InverseCovarianceMatrix, differenceVector ) );
-      break;
-    }
-    case 1: // decomposed covariance (uniform regularization)
-    {
-      centerrotated = differenceVector * ( *m_EigenVectors );                       /** diff^T * V */
-      eigrot        = element_quotient( centerrotated, *m_EigenValuesRegularized ); /** diff^T * V * Lambda^-1 */
-      if( this->m_ShrinkageIntensity != 0 )
-      {
-        /** innerproduct diff^T * V * Lambda^-1 * V^T * diff  +  1/(sigma_0*Beta)* diff^T*diff*/
-        value = sqrt( dot_product( eigrot, centerrotated )
-          + dot_product( differenceVector, differenceVector )
-          / ( this->m_ShrinkageIntensity * this->m_BaseVariance ) );
-      }
-      else
+      /** d/dP diff^T * Sigma^-1 * diff / value, with w = Sigma^-T * diff
+       * computed by CalculateValue().
+       */
+      for( unsigned int index = 0; index < proposalLength; ++index )
       {
-        /** innerproduct diff^T * V * Lambda^-1 * V^T * diff*/
-        value = sqrt( dot_product( eigrot, centerrotated ) );
+        gradient[ index ] *= factor;
       }
       break;
     }
+    case 1: // decomposed covariance (uniform regularization)
     case 2: // decomposed scaled covariance (element specific regularization)
     {
-      const unsigned int shapeLength = this->m_ProposalLength - Self::FixedPointSetDimension - 1;
-      typename VnlVectorType::iterator diffElementIt = differenceVector.begin();
-      for( unsigned int diffElementIndex = 0; diffElementIndex < shapeLength; ++diffElementIndex, ++diffElementIt )
-      {
-        *diffElementIt /= this->m_BaseStd;
-      }
-      differenceVector[ shapeLength     ] /= this->m_CentroidXStd;
-      differenceVector[ shapeLength + 1 ] /= this->m_CentroidYStd;
-      differenceVector[ shapeLength + 2 ] /= this->m_CentroidZStd;
-      differenceVector[ shapeLength + 3 ] /= this->m_SizeStd;
-
-      centerrotated = differenceVector * ( *this->m_EigenVectors );                       /** diff^T * V */
-      eigrot        = element_quotient( centerrotated, *this->m_EigenValuesRegularized ); /** diff^T * V * Lambda^-1 */
+      /** ( V * Lambda^-1 * V^T * diff + diff / ( Beta * sigma_0^2 ) ) / value,
+       * with the elements scaled like the proposal for the scaled covariance.
+       */
+      double diffWeight = 0.0;
       if( this->m_ShrinkageIntensity != 0 )
       {
-        /** innerproduct diff^T * ~V * I * ~V^T * diff  +  1/(Beta)* diff^T*diff*/
-        value = sqrt( dot_product( eigrot, centerrotated )
-          + differenceVector.squared_magnitude() / this->m_ShrinkageIntensity );
-      }
-      else
-      {
-        /** innerproduct diff^T * V * I * V^T * diff*/
-        value = sqrt( dot_product( eigrot, centerrotated ) );
+        diffWeight = this->m_ShapeModelCalculation == 1
+          ? 1.0 / ( this->m_ShrinkageIntensity * this->m_BaseVariance )
+          : 1.0 / this->m_ShrinkageIntensity;
       }
 
+      const unsigned int numberOfEigenVectors = this->m_EigenVectorsTransposed.rows();
+      const double *     diff                 = this->m_DifferenceVector.data_block();
+      this->ProcessPointChunks( proposalLength,
+        [ this, numberOfEigenVectors, diff, diffWeight, factor, gradient ](
+        const ThreadIdType, const SizeValueType begin, const SizeValueType end )
+        {
+          for( SizeValueType index = begin; index < end; ++index )
+          {
+            gradient[ index ] = diffWeight * diff[ index ];
+          }
+          for( unsigned int k = 0; k < numberOfEigenVectors; ++k )
+          {
+            const double   eigrot      = this->m_EigRot[ k ];
+            const double * eigenVector = this->m_EigenVectorsTransposed[ k ];
+            for( SizeValueType index = begin; index < end; ++index )
+            {
+              gradient[ index ] += eigrot * eigenVector[ index ];
+            }
+          }
+          for( SizeValueType index = begin; index < end; ++index )
+          {
+            gradient[ index ] *= factor;
+            if( this->m_ShapeModelCalculation == 2 )
+            {
+              gradient[ index ] *= this->m_ProposalScales[ index ];
+            }
+          }
+        } );
       break;
     }
     default:
-      break;
+      this->m_ProposalGradient.fill( 0.0 );
   }
 
-} //end CalculateValue()
+} // end CalculateProposalGradient()
 
 
 /**
- * ******************* CalculateDerivative *******************
+ * ******************* CalculatePointGradients *******************
  */
 
 template< class TFixedPointSet, class TMovingPointSet >
 void
 StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
-::CalculateDerivative( DerivativeType & derivative,
-  const MeasureType & value,
-  const VnlVectorType & differenceVector,
-  const VnlVectorType & centerrotated,
-  const VnlVectorType & eigrot,
-  const unsigned int shapeLength ) const
+::CalculatePointGradients( const unsigned int shapeLength ) const
 {
-  typename ProposalDerivativeType::iterator proposalDerivativeIt  = this->m_ProposalDerivative->begin();
-  typename ProposalDerivativeType::iterator proposalDerivativeEnd = this->m_ProposalDerivative->end();
+  const double * gradient = this->m_ProposalGradient.data_block();
+  double *       h        = this->m_PointGradients.data_block();
+
+  if( !this->m_NormalizedShapeModel )
+  {
+    std::copy( gradient, gradient + shapeLength, h );
+    return;
+  }
 
-  typename DerivativeType::iterator derivativeIt = derivative.begin();
+  /** The proposal consists of the normalized shape n = a / l, the centroid c
+   * and the l2-norm l of the aligned shape a = y - c. The derivative of the
+   * proposal with respect to the points y is taken as
+   *   dc = mean( dy ), da = dy - dc, dl = a^T da / ( l sqrt( N ) ),
+   *   dn = da / l - a dl / l^2.
+   * The gradient of the proposal is propagated back through these steps,
+   * with a = n l.
+   */
+  const double numberOfPoints = static_cast< double >( this->GetFixedPointSet()->GetNumberOfPoints() );
+  const double l2norm         = this->m_ProposalVector[ shapeLength + Self::FixedPointSetDimension ];
+  const double l2normGradient = gradient[ shapeLength + Self::FixedPointSetDimension ];
+  const double sqrtN          = std::sqrt( numberOfPoints );
 
-  for(; proposalDerivativeIt != proposalDerivativeEnd; ++proposalDerivativeIt, ++derivativeIt )
+  double normalizedInnerProduct = 0.0;
+  for( unsigned int index = 0; index < shapeLength; ++index )
   {
-    if( *proposalDerivativeIt != nullptr )
+    normalizedInnerProduct += gradient[ index ] * this->m_ProposalVector[ index ];
+  }
+  const double beta = l2normGradient - normalizedInnerProduct / l2norm;
+
+  double sums[ Self::FixedPointSetDimension ];
+  std::fill( sums, sums + Self::FixedPointSetDimension, 0.0 );
+  for( unsigned int index = 0; index < shapeLength; ++index )
+  {
+    h[ index ] = gradient[ index ] / l2norm + beta * this->m_ProposalVector[ index ] / sqrtN;
+    sums[ index % Self::FixedPointSetDimension ] += h[ index ];
+  }
+
+  for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
+  {
+    const double correction = ( gradient[ shapeLength + d ] - sums[ d ] ) / numberOfPoints;
+    for( unsigned int index = d; index < shapeLength; index += Self::FixedPointSetDimension )
     {
-      switch( this->m_ShapeModelCalculation )
+      h[ index ] += correction;
+    }
+  }
+
+} // end CalculatePointGradients()
+
+
+/**
+ * ******************* CalculateDerivative *******************
+ */
+
+template< class TFixedPointSet, class TMovingPointSet >
+void
+StatisticalShapePointPenalty< TFixedPointSet, TMovingPointSet >
+::CalculateDerivative( DerivativeType & derivative ) const
+{
+  const typename FixedPointSetType::PointsContainer * fixedPoints
+    = this->GetFixedPointSet()->GetPoints();
+  const SizeValueType numberOfPoints     = fixedPoints->Size();
+  const ThreadIdType  numberOfChunks     = this->GetNumberOfPointChunks( numberOfPoints );
+  const unsigned int  numberOfParameters = this->GetNumberOfParameters();
+
+  this->m_ChunkDerivatives.resize( numberOfChunks );
+  for( ThreadIdType i = 0; i < numberOfChunks; ++i )
+  {
+    this->m_ChunkDerivatives[ i ].SetSize( numberOfParameters );
+  }
+
+  /** Sum the gradient of each point times its Jacobian dT/dmu. */
+  this->ProcessPointChunks( numberOfPoints,
+    [ this, fixedPoints ]( const ThreadIdType chunk, const SizeValueType begin, const SizeValueType end )
+    {
+      DerivativeType & chunkDerivative = this->m_ChunkDerivatives[ chunk ];
+      chunkDerivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+
+      NonZeroJacobianIndicesType nzji(
+        this->m_Transform->GetNumberOfNonZeroJacobianIndices() );
+      TransformJacobianType jacobian;
+
+      for( SizeValueType i = begin; i < end; ++i )
       {
-        case 0: // full covariance
-        {
-          /**innerproduct diff^T * Sigma^-1 * d/dmu (diff), where iterated over mu-s*/
-          *derivativeIt = bracket( differenceVector, *m_InverseCovarianceMatrix, ( **proposalDerivativeIt ) ) / value;
-          this->CalculateCutOffDerivative( *derivativeIt, value );
-          break;
-        }
-        case 1: // decomposed covariance (uniform regularization)
-        {
-          if( this->m_ShrinkageIntensity != 0 )
-          {
-            /** Innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu(diff)
-             * + 1/(Beta*sigma_0^2)*diff^T* d/dmu(diff), where iterated over mu-s
-             */
-            *derivativeIt = ( dot_product( eigrot, this->m_EigenVectors->transpose() * ( **proposalDerivativeIt ) )
-              + dot_product( differenceVector, **proposalDerivativeIt )
-              / ( this->m_ShrinkageIntensity * this->m_BaseVariance ) ) / value;
-            this->CalculateCutOffDerivative( *derivativeIt, value );
-          }
-          else //m_ShrinkageIntensity==0
-          {
-            /**innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu (diff), where iterated over mu-s*/
-            *derivativeIt = ( dot_product( eigrot, this->m_EigenVectors->transpose()
-              * ( **proposalDerivativeIt ) ) ) / value;
-            this->CalculateCutOffDerivative( *derivativeIt, value );
-          }
-          break;
-        }
-        case 2: // decomposed scaled covariance (element specific regularization)
+        this->m_Transform->GetJacobian( fixedPoints->ElementAt( i ), jacobian, nzji );
+
+        const double * h = this->m_PointGradients.data_block() + i * Self::FixedPointSetDimension;
+        for( unsigned int j = 0; j < nzji.size(); ++j )
         {
-          // first scale proposalDerivatives with their sigma's in order to evaluate
-          // with the EigenValues and EigenVectors of the scaled CovarianceMatrix
-          typename VnlVectorType::iterator propDerivElementIt = ( *proposalDerivativeIt )->begin();
-          for( unsigned int propDerivElementIndex = 0; propDerivElementIndex < shapeLength;
-            ++propDerivElementIndex, ++propDerivElementIt )
+          double sum = 0.0;
+          for( unsigned int d = 0; d < Self::FixedPointSetDimension; ++d )
           {
-            ( *propDerivElementIt ) /= this->m_BaseStd;
+            sum += h[ d ] * jacobian( d, j );
           }
-          ( **proposalDerivativeIt )[ shapeLength     ] /= this->m_CentroidXStd;
-          ( **proposalDerivativeIt )[ shapeLength + 1 ] /= this->m_CentroidYStd;
-          ( **proposalDerivativeIt )[ shapeLength + 2 ] /= this->m_CentroidZStd;
-          ( **proposalDerivativeIt )[ shapeLength + 3 ] /= this->m_SizeStd;
-          if( this->m_ShrinkageIntensity != 0 )
-          {
-            /** innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu(diff)
-             * + 1/(Beta*sigma_0^2)*diff^T* d/dmu(diff), where iterated over mu-s
-             */
-            *derivativeIt = ( dot_product( eigrot, this->m_EigenVectors->transpose() * ( **proposalDerivativeIt ) )
-              + dot_product( differenceVector, **proposalDerivativeIt )
-              / this->m_ShrinkageIntensity ) / value;
-            this->CalculateCutOffDerivative( *derivativeIt, value );
-          }
-          else //m_ShrinkageIntensity==0
-          {
-            /**innerproduct diff^T * V * Lambda^-1 * V^T * d/dmu (diff), where iterated over mu-s*/
-            *derivativeIt = ( dot_product( eigrot, this->m_EigenVectors->transpose()
-              * ( **proposalDerivativeIt ) ) ) / value;
-            this->CalculateCutOffDerivative( *derivativeIt, value );
-          }
-          break;
+          chunkDerivative[ nzji[ j ] ] += sum;
         }
-        default:
-        {}
-
-          delete ( *proposalDerivativeIt );
-          // nzjacs++;
       }
-    }
+    } );
+
+  /** Sum the chunks in a fixed order. */
+  derivative = this->m_ChunkDerivatives[ 0 ];
+  for( ThreadIdType i = 1; i < numberOfChunks; ++i )
+  {
+    derivative += this->m_ChunkDerivatives[ i ];
   }
 
 } // end CalculateDerivative()
@@ -76,6 +76,12 @@ SumOfPairwiseCorrelationCoefficientsMetric< TElastix >
     this->GetComponentLabel(), 0, 0 );
   this->SetReducedDimensionIndex( reducedDimensionIndex );
 
+  /** Select sparse accumulation of the derivative over the threads. */
+  bool useSparseDerivativeAccumulation = false;
+  this->GetConfiguration()->ReadParameter( useSparseDerivativeAccumulation,
+    "UseSparseDerivativeAccumulation", this->GetComponentLabel(), level, 0 );
+  this->SetUseSparseDerivativeAccumulation( useSparseDerivativeAccumulation );
+
   /** Set moving image derivative scales. */
   this->SetUseMovingImageDerivativeScales( false );
   MovingImageDerivativeScalesType movingImageDerivativeScales;
@@ -24,6 +24,8 @@
 #include "itkImageRandomCoordinateSampler.h"
 #include "itkNearestNeighborInterpolateImageFunction.h"
 #include "itkExtractImageFilter.h"
+#include "vnl/vnl_matrix.h"
+#include "vnl/vnl_vector.h"
 
 using namespace std;
 
@@ -149,6 +151,7 @@ protected:
   typedef typename Superclass::CentralDifferenceGradientFilterType CentralDifferenceGradientFilterType;
   typedef typename Superclass::MovingImageDerivativeType           MovingImageDerivativeType;
   typedef typename Superclass::NonZeroJacobianIndicesType          NonZeroJacobianIndicesType;
+  typedef typename Superclass::DerivativeValueType                 DerivativeValueType;
 
   /** Computes the innerproduct of transform Jacobian with moving image gradient.
    * The results are stored in imageJacobian, which is supposed
@@ -158,6 +161,24 @@ protected:
     const MovingImageDerivativeType & movingImageDerivative,
     DerivativeType & imageJacobian ) const override;
 
+  /** Get value and derivatives single-threaded. */
+  MeasureType GetValueSingleThreaded( const TransformParametersType & parameters ) const;
+
+  void GetValueAndDerivativeSingleThreaded( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const;
+
+  /** Compute the correlation matrix of the valid samples, and the value. */
+  inline void AfterThreadedGetValue( MeasureType & value ) const override;
+
+  /** Compute the derivative contributions of the valid samples of one thread. */
+  inline void ThreadedGetValueAndDerivative( ThreadIdType threadID ) override;
+
+  /** Gather the derivatives of all threads. The value is computed by
+   * AfterThreadedGetValue().
+   */
+  inline void AfterThreadedGetValueAndDerivative(
+    MeasureType & value, DerivativeType & derivative ) const override;
+
 private:
 
   SumOfPairwiseCorrelationCoefficientsMetric( const Self & ); // purposely not implemented
@@ -166,6 +187,28 @@ private:
   /** Sample n random numbers from 0..m and add them to the vector. */
   void SampleRandom( const int n, const int m, std::vector< int > & numbers ) const;
 
+  /** Size the arrays of the sample values for the current sample container. */
+  void InitializeSampleValues( void ) const;
+
+  /** Evaluate the moving image at all samples and time points, in tiles of
+   * samples and time points on the persistent thread pool, so that also few
+   * samples of many time points use all threads. Marks the valid samples.
+   */
+  void EvaluateSampleValues( void ) const;
+
+  /** Add the derivative contributions of the valid samples at time point d.
+   * For a stack transform, they only affect the parameters of sub transform d.
+   */
+  void AddTimePointDerivative( const unsigned int d, DerivativeType & derivative ) const;
+
+  /** The factor of the summed derivative contributions in the derivative. */
+  DerivativeValueType GetDerivativeNormalization( void ) const;
+
+  /** Subtract the mean over the last dimension from the derivative elements. */
+  void SubtractMeanFromDerivative( DerivativeType & derivative ) const;
+
+  typedef vnl_matrix< RealType > MatrixType;
+
   /** Variables to control random sampling in last dimension. */
   unsigned int m_NumAdditionalSamplesFixed;
   unsigned int m_ReducedDimensionIndex;
@@ -179,6 +222,26 @@ private:
   /** Bool to indicate if the transform used is a stacktransform. Set by elx files. */
   bool m_TransformIsStackTransform;
 
+  /** The intermediate results of the multi-threaded computation. The moving
+   * image values of all samples at all time points, whether each of these is
+   * valid, whether a sample is valid at all time points, and the indices of
+   * the valid samples.
+   */
+  mutable MatrixType                   m_SampleValues;
+  mutable std::vector< unsigned char > m_SampleValueIsValid;
+  mutable std::vector< unsigned char > m_SampleIsValid;
+  mutable std::vector< unsigned long > m_ValidSampleIndices;
+
+  /** The zero-mean values of the valid samples, the inverse standard
+   * deviations of the time points, and the correlation matrix.
+   */
+  mutable MatrixType             m_ZeroMeanSampleValues;
+  mutable vnl_vector< RealType > m_InverseStandardDeviations;
+  mutable MatrixType             m_CorrelationMatrix;
+
+  /** The factor of dM/dmu of each time point and valid sample in the derivative. */
+  mutable MatrixType m_DerivativeCoefficients;
+
 };
 
 } // end namespace itk
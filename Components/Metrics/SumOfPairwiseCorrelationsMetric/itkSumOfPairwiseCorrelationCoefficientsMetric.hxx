@@ -23,6 +23,9 @@
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "vnl/algo/vnl_matrix_update.h"
 #include "itkImage.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <numeric>
 
 namespace itk
@@ -106,6 +109,87 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
 } // end SampleRandom()
 
 
+/**
+ * ******************* SubtractMeanFromDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::SubtractMeanFromDerivative( DerivativeType & derivative ) const
+{
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  if( !this->m_TransformIsStackTransform )
+  {
+    /** Update derivative per dimension.
+     * Parameters are ordered xxxxxxx yyyyyyy zzzzzzz ttttttt and
+     * per dimension xyz.
+     */
+    const unsigned int lastDimGridSize = this->m_GridSize[ lastDim ];
+    const unsigned int numParametersPerDimension
+      = this->GetNumberOfParameters() / this->GetMovingImage()->GetImageDimension();
+    const unsigned int numControlPointsPerDimension = numParametersPerDimension / lastDimGridSize;
+    DerivativeType     mean( numControlPointsPerDimension );
+    for( unsigned int d = 0; d < this->GetMovingImage()->GetImageDimension(); ++d )
+    {
+      /** Compute mean per dimension. */
+      mean.Fill( 0.0 );
+      const unsigned int starti = numParametersPerDimension * d;
+      for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
+      {
+        const unsigned int index = i % numControlPointsPerDimension;
+        mean[ index ] += derivative[ i ];
+      }
+      mean /= static_cast< double >( lastDimGridSize );
+
+      /** Update derivative for every control point per dimension. */
+      for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
+      {
+        const unsigned int index = i % numControlPointsPerDimension;
+        derivative[ i ] -= mean[ index ];
+      }
+    }
+  }
+  else
+  {
+    /** Update derivative per dimension.
+     * Parameters are ordered x0x0x0y0y0y0z0z0z0x1x1x1y1y1y1z1z1z1 with
+     * the number the time point index.
+     */
+    const unsigned int numParametersPerLastDimension = this->GetNumberOfParameters() / G;
+    DerivativeType     mean( numParametersPerLastDimension );
+    mean.Fill( 0.0 );
+
+    /** Compute mean per control point. */
+    for( unsigned int t = 0; t < G; ++t )
+    {
+      const unsigned int startc = numParametersPerLastDimension * t;
+      for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+      {
+        const unsigned int index = c % numParametersPerLastDimension;
+        mean[ index ] += derivative[ c ];
+      }
+    }
+    mean /= static_cast< double >( G );
+
+    /** Update derivative per control point. */
+    for( unsigned int t = 0; t < G; ++t )
+    {
+      const unsigned int startc = numParametersPerLastDimension * t;
+      for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+      {
+        const unsigned int index = c % numParametersPerLastDimension;
+        derivative[ c ] -= mean[ index ];
+      }
+    }
+  }
+
+} // end SubtractMeanFromDerivative()
+
+
 /**
  * *************** EvaluateTransformJacobianInnerProduct ****************
  */
@@ -139,13 +223,13 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* GetValue *******************
+ * ******************* GetValueSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 typename SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >::MeasureType
 SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
-::GetValue( const TransformParametersType & parameters ) const
+::GetValueSingleThreaded( const TransformParametersType & parameters ) const
 {
   itkDebugMacro( "GetValue( " << parameters << " ) " );
 
@@ -169,8 +253,6 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
   const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
   const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
 
-  typedef vnl_matrix< RealType > MatrixType;
-
   /** The rows of the ImageSampleMatrix contain the samples of the images of the stack */
   unsigned int NumberOfSamples = sampleContainer->Size();
   MatrixType   datablock( NumberOfSamples, G );
@@ -284,9 +366,236 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
   /** Return the measure value. */
   return measure;
 
+} // end GetValueSingleThreaded()
+
+
+/**
+ * ******************* InitializeSampleValues *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::InitializeSampleValues( void ) const
+{
+  /** The threads fill a row per sample, so the arrays are sized beforehand. */
+  const unsigned int  lastDim         = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int  G               = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+  const unsigned long numberOfSamples = this->GetImageSampler()->GetOutput()->Size();
+
+  this->m_SampleValues.set_size( numberOfSamples, G );
+  this->m_SampleIsValid.resize( numberOfSamples );
+
+} // end InitializeSampleValues()
+
+
+/**
+ * ******************* GetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >::MeasureType
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::GetValue( const TransformParametersType & parameters ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueSingleThreaded( parameters );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+  this->InitializeSampleValues();
+
+  /** Evaluate the moving image at all samples and time points. */
+  this->EvaluateSampleValues();
+
+  /** Compute the correlation matrix of the valid samples. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->AfterThreadedGetValue( value );
+
+  return value;
+
 } // end GetValue()
 
 
+/**
+ * ******************* EvaluateSampleValues *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::EvaluateSampleValues( void ) const
+{
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  const unsigned long         numberOfSamples = sampleContainer->Size();
+
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  /** Each tile fills its own part of the rows of the samples, and marks
+   * which of its entries are valid.
+   */
+  this->m_SampleValueIsValid.assign( numberOfSamples * G, 0 );
+  this->ProcessSampleAndPositionTiles( numberOfSamples, G,
+    [ this, &sampleContainer, lastDim, G ]( const unsigned long sampleBegin,
+    const unsigned long sampleEnd, const unsigned int positionBegin, const unsigned int positionEnd )
+    {
+      /** The points of the time points of this tile at a sample. */
+      const unsigned int                  numberOfPositions = positionEnd - positionBegin;
+      std::vector< FixedImagePointType >  fixedPoints( numberOfPositions );
+      std::vector< MovingImagePointType > mappedPoints( numberOfPositions );
+      std::vector< RealType >             movingImageValues( numberOfPositions );
+      std::unique_ptr< bool[] >           samplesOk( new bool[ numberOfPositions ] );
+
+      for( unsigned long sampleIndex = sampleBegin; sampleIndex < sampleEnd; ++sampleIndex )
+      {
+        /** Read fixed coordinates. */
+        const FixedImagePointType & fixedPoint = sampleContainer->ElementAt( sampleIndex ).m_ImageCoordinates;
+
+        /** Transform sampled point to voxel coordinates. */
+        FixedImageContinuousIndexType voxelCoord;
+        this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
+
+        /** Set fixed point's last dimension to each time point of this
+         * tile, and transform the points back to world coordinates.
+         */
+        for( unsigned int d = positionBegin; d < positionEnd; ++d )
+        {
+          voxelCoord[ lastDim ] = d;
+          this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d - positionBegin ] );
+        }
+
+        /** Transform the points in one batch, check if they are inside the
+         * moving mask, and compute the moving image values.
+         */
+        this->TransformMovingImageBatch( fixedPoints.data(), mappedPoints.data(), samplesOk.get(), numberOfPositions );
+        this->EvaluateMovingImageValuesAndDerivatives( mappedPoints.data(),
+          movingImageValues.data(), 0, samplesOk.get(), numberOfPositions );
+
+        /** Loop over the time points of this tile. */
+        for( unsigned int d = positionBegin; d < positionEnd; ++d )
+        {
+          if( samplesOk[ d - positionBegin ] )
+          {
+            this->m_SampleValues( sampleIndex, d )            = movingImageValues[ d - positionBegin ];
+            this->m_SampleValueIsValid[ sampleIndex * G + d ] = 1;
+          }
+
+        } /** end loop over t */
+      } /** end loop over the samples of this tile */
+    } );
+
+  /** A sample is valid if it is valid at all time points. */
+  unsigned long numberOfPixelsCounted = 0;
+  for( unsigned long sampleIndex = 0; sampleIndex < numberOfSamples; ++sampleIndex )
+  {
+    const unsigned char * valid = this->m_SampleValueIsValid.data() + sampleIndex * G;
+    this->m_SampleIsValid[ sampleIndex ] = std::all_of( valid, valid + G,
+      []( const unsigned char v ) { return v != 0; } );
+    numberOfPixelsCounted += this->m_SampleIsValid[ sampleIndex ];
+  }
+
+  /** AfterThreadedGetValue() adds the counts of the threads. */
+  this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+
+} // end EvaluateSampleValues()
+
+
+/**
+ * ******************* AfterThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetValue( MeasureType & value ) const
+{
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
+
+  /** Accumulate the number of pixels. */
+  this->m_NumberOfPixelsCounted = this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
+  for( ThreadIdType i = 1; i < numberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
+  }
+
+  /** Check if enough samples were valid. */
+  const unsigned long numberOfSamples = this->m_SampleIsValid.size();
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
+  const unsigned int N = this->m_NumberOfPixelsCounted;
+  const unsigned int G = this->m_SampleValues.cols();
+
+  /** Collect the valid samples in the order of the sample container, which
+   * makes the result independent of the number of threads.
+   */
+  this->m_ValidSampleIndices.clear();
+  for( unsigned long i = 0; i < numberOfSamples; ++i )
+  {
+    if( this->m_SampleIsValid[ i ] )
+    {
+      this->m_ValidSampleIndices.push_back( i );
+    }
+  }
+
+  /** Calculate mean of from columns */
+  vnl_vector< RealType > mean( G );
+  mean.fill( NumericTraits< RealType >::Zero );
+  for( unsigned int i = 0; i < N; i++ )
+  {
+    for( unsigned int j = 0; j < G; j++ )
+    {
+      mean( j ) += this->m_SampleValues( this->m_ValidSampleIndices[ i ], j );
+    }
+  }
+  mean /= RealType( N );
+
+  MatrixType & Amm = this->m_ZeroMeanSampleValues;
+  Amm.set_size( N, G );
+  for( unsigned int i = 0; i < N; i++ )
+  {
+    for( unsigned int j = 0; j < G; j++ )
+    {
+      Amm( i, j ) = this->m_SampleValues( this->m_ValidSampleIndices[ i ], j ) - mean( j );
+    }
+  }
+
+  MatrixType C( Amm.transpose() * Amm );
+  C /= static_cast< RealType >( RealType( N ) - 1.0 );
+
+  vnl_vector< RealType > & S = this->m_InverseStandardDeviations;
+  S.set_size( G );
+  for( unsigned int j = 0; j < G; j++ )
+  {
+    S( j ) = 1.0 / sqrt( C( j, j ) );
+  }
+
+  /** K = S * C * S, with S diagonal. */
+  MatrixType & K = this->m_CorrelationMatrix;
+  K.set_size( G, G );
+  for( unsigned int i = 0; i < G; i++ )
+  {
+    for( unsigned int j = 0; j < G; j++ )
+    {
+      K( i, j ) = S( i ) * C( i, j ) * S( j );
+    }
+  }
+
+  value = 1.0 - ( K.fro_norm() / RealType( G ) );
+
+} // end AfterThreadedGetValue()
+
+
 /**
  * ******************* GetDerivative *******************
  */
@@ -310,21 +619,17 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* GetValueAndDerivative *******************
+ * ******************* GetValueAndDerivativeSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
-::GetValueAndDerivative( const TransformParametersType & parameters,
+::GetValueAndDerivativeSingleThreaded( const TransformParametersType & parameters,
   MeasureType & value, DerivativeType & derivative ) const
 {
   itkDebugMacro( "GetValueAndDerivative( " << parameters << " ) " );
 
-  /** Define derivative and Jacobian types. */
-  typedef typename DerivativeType::ValueType DerivativeValueType;
-  //typedef typename TransformJacobianType::ValueType TransformJacobianValueType;
-
   /** Initialize some variables */
   const unsigned int P = this->GetNumberOfParameters();
   this->m_NumberOfPixelsCounted = 0;
@@ -348,7 +653,6 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
   const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
   const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
 
-  typedef vnl_matrix< RealType >            MatrixType;
   typedef vnl_matrix< DerivativeValueType > DerivativeMatrixType;
 
   std::vector< FixedImagePointType > SamplesOK;
@@ -543,76 +847,324 @@ SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
   /** Subtract mean from derivative elements. */
   if( this->m_SubtractMean )
   {
-    if( !this->m_TransformIsStackTransform )
+    this->SubtractMeanFromDerivative( derivative );
+  }
+
+  /** Return the measure value. */
+  value = measure;
+
+} // end GetValueAndDerivativeSingleThreaded()
+
+
+/**
+ * ******************* GetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivative( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueAndDerivativeSingleThreaded(
+      parameters, value, derivative );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+  this->InitializeSampleValues();
+
+  /** First pass: evaluate the moving image at all samples and time points,
+   * and compute the correlation matrix of the valid samples.
+   */
+  this->EvaluateSampleValues();
+  this->AfterThreadedGetValue( value );
+
+  /** Compute the factors of dM/dmu in the derivative. The derivative of the
+   * Frobenius norm of K = S C S consists of a term through the covariances C,
+   * and a term through the inverse standard deviations S.
+   */
+  const unsigned int             N   = this->m_NumberOfPixelsCounted;
+  const MatrixType &             Amm = this->m_ZeroMeanSampleValues;
+  const MatrixType &             K   = this->m_CorrelationMatrix;
+  const vnl_vector< RealType > & S   = this->m_InverseStandardDeviations;
+  const unsigned int             G   = K.rows();
+
+  MatrixType Zscore( Amm );
+  for( unsigned int i = 0; i < N; i++ )
+  {
+    for( unsigned int d = 0; d < G; d++ )
+    {
+      Zscore( i, d ) *= S( d );
+    }
+  }
+  const MatrixType KAtZscore( K * Zscore.transpose() );
+
+  this->m_DerivativeCoefficients.set_size( G, N );
+  for( unsigned int d = 0; d < G; d++ )
+  {
+    /** The diagonal element d of K * Zscore^T * Amm. */
+    DerivativeValueType KAtZscoreAmm = 0.0;
+    for( unsigned int i = 0; i < N; i++ )
+    {
+      KAtZscoreAmm += KAtZscore( d, i ) * Amm( i, d );
+    }
+    const DerivativeValueType dSdmu_part1 = -S( d ) * S( d ) * S( d )
+      / ( DerivativeValueType( N ) - 1.0 );
+
+    for( unsigned int i = 0; i < N; i++ )
     {
-      /** Update derivative per dimension.
-       * Parameters are ordered xxxxxxx yyyyyyy zzzzzzz ttttttt and
-       * per dimension xyz.
-       */
-      const unsigned int lastDimGridSize = this->m_GridSize[ lastDim ];
-      const unsigned int numParametersPerDimension
-        = this->GetNumberOfParameters() / this->GetMovingImage()->GetImageDimension();
-      const unsigned int numControlPointsPerDimension = numParametersPerDimension / lastDimGridSize;
-      DerivativeType     mean( numControlPointsPerDimension );
-      for( unsigned int d = 0; d < this->GetMovingImage()->GetImageDimension(); ++d )
+      this->m_DerivativeCoefficients( d, i ) = KAtZscore( d, i ) * S( d )
+        + dSdmu_part1 * Amm( i, d ) * KAtZscoreAmm;
+    }
+  }
+
+  /** Second pass: add the derivative contributions of the valid samples.
+   * For a stack transform, the time points only affect the parameters of
+   * their own sub transforms, so they are processed in parallel, and write
+   * directly to the derivative.
+   */
+  if( this->m_TransformIsStackTransform )
+  {
+    derivative = DerivativeType( this->GetNumberOfParameters() );
+    derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+    this->ProcessSlices( G, true,
+      [ this, &derivative ]( const unsigned int d )
       {
-        /** Compute mean per dimension. */
-        mean.Fill( 0.0 );
-        const unsigned int starti = numParametersPerDimension * d;
-        for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
-        {
-          const unsigned int index = i % numControlPointsPerDimension;
-          mean[ index ] += derivative[ i ];
-        }
-        mean /= static_cast< double >( lastDimGridSize );
+        this->AddTimePointDerivative( d, derivative );
+      } );
 
-        /** Update derivative for every control point per dimension. */
-        for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
-        {
-          const unsigned int index = i % numControlPointsPerDimension;
-          derivative[ i ] -= mean[ index ];
-        }
-      }
+    derivative *= this->GetDerivativeNormalization();
+
+    /** Subtract mean from derivative elements. */
+    if( this->m_SubtractMean )
+    {
+      this->SubtractMeanFromDerivative( derivative );
+    }
+    return;
+  }
+
+  this->LaunchGetValueAndDerivativeThreaderCallback();
+
+  /** Gather the derivatives from all threads. */
+  this->AfterThreadedGetValueAndDerivative( value, derivative );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ******************* AddTimePointDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::AddTimePointDerivative( const unsigned int d, DerivativeType & derivative ) const
+{
+  DerivativeType             imageJacobian( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+  NonZeroJacobianIndicesType nzji;
+
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  const unsigned int          lastDim         = this->GetFixedImage()->GetImageDimension() - 1;
+
+  /** The valid samples are transformed and interpolated per block. */
+  const unsigned int        batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType       fixedPoints[ batchSize ];
+  MovingImagePointType      mappedPoints[ batchSize ];
+  bool                      samplesOk[ batchSize ];
+  RealType                  movingImageValues[ batchSize ];
+  MovingImageDerivativeType movingImageDerivatives[ batchSize ];
+
+  const unsigned long numberOfValidSamples = this->m_ValidSampleIndices.size();
+  for( unsigned long blockBegin = 0; blockBegin < numberOfValidSamples; blockBegin += batchSize )
+  {
+    const unsigned int blockSize = static_cast< unsigned int >(
+      std::min< unsigned long >( numberOfValidSamples - blockBegin, batchSize ) );
+
+    /** Read fixed coordinates, at this time point. */
+    for( unsigned int i = 0; i < blockSize; ++i )
+    {
+      const FixedImagePointType & fixedPoint
+        = sampleContainer->ElementAt( this->m_ValidSampleIndices[ blockBegin + i ] ).m_ImageCoordinates;
+      FixedImageContinuousIndexType voxelCoord;
+      this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
+      voxelCoord[ lastDim ] = d;
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ i ] );
     }
-    else
+
+    /** Transform the points of the block in one batch, and compute the
+     * moving image values and derivatives. The valid samples are valid at
+     * all time points.
+     */
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+      movingImageValues, movingImageDerivatives, samplesOk, blockSize );
+
+    for( unsigned int i = 0; i < blockSize; ++i )
     {
-      /** Update derivative per dimension.
-       * Parameters are ordered x0x0x0y0y0y0z0z0z0x1x1x1y1y1y1z1z1z1 with
-       * the number the time point index.
-       */
-      const unsigned int numParametersPerLastDimension = this->GetNumberOfParameters() / G;
-      DerivativeType     mean( numParametersPerLastDimension );
-      mean.Fill( 0.0 );
+      /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
+      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+        fixedPoints[ i ], movingImageDerivatives[ i ], imageJacobian, nzji );
 
-      /** Compute mean per control point. */
-      for( unsigned int t = 0; t < G; ++t )
+      /** Add this sample's contribution to the derivative. */
+      const DerivativeValueType factor = this->m_DerivativeCoefficients( d, blockBegin + i );
+      for( unsigned int p = 0; p < nzji.size(); ++p )
       {
-        const unsigned int startc = numParametersPerLastDimension * t;
-        for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
-        {
-          const unsigned int index = c % numParametersPerLastDimension;
-          mean[ index ] += derivative[ c ];
-        }
+        derivative[ nzji[ p ] ] += factor * imageJacobian[ p ];
       }
-      mean /= static_cast< double >( G );
+    }
+  }
+
+} // end AddTimePointDerivative()
+
+
+/**
+ * ******************* GetDerivativeNormalization *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >::DerivativeValueType
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::GetDerivativeNormalization( void ) const
+{
+  const unsigned int N = this->m_NumberOfPixelsCounted;
+  const unsigned int G = this->m_CorrelationMatrix.rows();
+  return -static_cast< DerivativeValueType >( 2.0 )
+         / ( ( static_cast< DerivativeValueType >( N ) - 1.0 )
+         * ( this->m_CorrelationMatrix.fro_norm() * RealType( G ) ) );
+
+} // end GetDerivativeNormalization()
+
+
+/**
+ * ******************* ThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::ThreadedGetValueAndDerivative( ThreadIdType threadId )
+{
+  /** Get the pre-allocated arrays that store dM(x)/dmu, and the sparse Jacobian indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji          = arena.sa_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = arena.sa_ImageJacobian;
+
+  /** Get a handle to the pre-allocated derivative for the current thread. */
+  DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
+
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+
+  /** Get the valid samples for this thread. */
+  const unsigned long numberOfValidSamples = this->m_ValidSampleIndices.size();
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( numberOfValidSamples )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > numberOfValidSamples ) ? numberOfValidSamples : pos_begin;
+  pos_end   = ( pos_end > numberOfValidSamples ) ? numberOfValidSamples : pos_end;
 
-      /** Update derivative per control point. */
-      for( unsigned int t = 0; t < G; ++t )
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int G       = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  /** The points of all time points at a sample. */
+  std::vector< FixedImagePointType >       fixedPoints( G );
+  std::vector< MovingImagePointType >      mappedPoints( G );
+  std::vector< RealType >                  movingImageValues( G );
+  std::vector< MovingImageDerivativeType > movingImageDerivatives( G );
+  std::unique_ptr< bool[] >                samplesOk( new bool[ G ] );
+
+  for( unsigned long pixelIndex = pos_begin; pixelIndex < pos_end; ++pixelIndex )
+  {
+    /** Read fixed coordinates. */
+    const FixedImagePointType & fixedPoint
+      = sampleContainer->ElementAt( this->m_ValidSampleIndices[ pixelIndex ] ).m_ImageCoordinates;
+
+    /** Transform sampled point to voxel coordinates. */
+    FixedImageContinuousIndexType voxelCoord;
+    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
+
+    /** Set fixed point's last dimension to each time point, and transform
+     * the points back to world coordinates.
+     */
+    for( unsigned int d = 0; d < G; ++d )
+    {
+      voxelCoord[ lastDim ] = d;
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d ] );
+    }
+
+    /** Transform the points of all time points in one batch, and compute the
+     * moving image values and derivatives. The valid samples are valid at
+     * all time points.
+     */
+    this->TransformMovingImageBatch( fixedPoints.data(), mappedPoints.data(), samplesOk.get(), G );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints.data(),
+      movingImageValues.data(), movingImageDerivatives.data(), samplesOk.get(), G );
+
+    for( unsigned int d = 0; d < G; ++d )
+    {
+      /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
+      this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+        fixedPoints[ d ], movingImageDerivatives[ d ], imageJacobian, nzji );
+
+      /** Add this time point's contribution to the derivative. */
+      const DerivativeValueType factor = this->m_DerivativeCoefficients( d, pixelIndex );
+      if( this->m_UseSparseDerivativeAccumulation )
+      {
+        this->AddSparseDerivativeTerms( threadId, imageJacobian, nzji, factor );
+      }
+      else
       {
-        const unsigned int startc = numParametersPerLastDimension * t;
-        for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+        for( unsigned int p = 0; p < nzji.size(); ++p )
         {
-          const unsigned int index = c % numParametersPerLastDimension;
-          derivative[ c ] -= mean[ index ];
+          derivative[ nzji[ p ] ] += factor * imageJacobian[ p ];
         }
       }
-    }
-  }
 
-  /** Return the measure value. */
-  value = measure;
+    } // end loop over t
 
-} // end GetValueAndDerivative()
+  } // end loop over the valid samples of this thread
+
+} // end ThreadedGetValueAndDerivative()
+
+
+/**
+ * ******************* AfterThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+SumOfPairwiseCorrelationCoefficientsMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetValueAndDerivative(
+  MeasureType & itkNotUsed( value ), DerivativeType & derivative ) const
+{
+  /** The normalization factor. */
+  const DerivativeValueType normal_sum = this->GetDerivativeNormalization();
+
+  /** Accumulate the derivatives of the threads. */
+  this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
+  this->m_ThreaderMetricParameters.st_NormalizationFactor = 1.0 / normal_sum;
+
+  this->LaunchThreaderCallback( this->AccumulateDerivativesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+
+  /** Subtract mean from derivative elements. */
+  if( this->m_SubtractMean )
+  {
+    this->SubtractMeanFromDerivative( derivative );
+  }
+
+} // end AfterThreadedGetValueAndDerivative()
 
 
 } // end namespace itk
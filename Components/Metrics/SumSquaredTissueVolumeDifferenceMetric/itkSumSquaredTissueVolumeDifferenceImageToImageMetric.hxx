@@ -20,6 +20,7 @@
 
 #include "itkSumSquaredTissueVolumeDifferenceImageToImageMetric.h"
 #include "vnl/algo/vnl_matrix_update.h"
+#include <algorithm>
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -99,7 +100,7 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage,TMovingImage>
     MovingImagePointType mappedPoint;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -211,59 +212,54 @@ void SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage,TMovingImage
   /** Matrix to store the spatial Jacobian, dT/dx. */
   SpatialJacobianType spatialJac;
 
-  /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
-  const unsigned long sampleContainerSize = sampleContainer->Size();
+  /** Get the number of samples. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
 
   /** Get the samples for this thread. */
   const unsigned long nSamplesPerThread
     = static_cast<unsigned long>( std::ceil( static_cast<double>( sampleContainerSize )
-    / static_cast<double>( Self::GetNumberOfWorkUnits() ) ) );
+    / static_cast<double>( Self::GetNumberOfReductionChunks() ) ) );
 
   unsigned long pos_begin = nSamplesPerThread * threadId;
   unsigned long pos_end = nSamplesPerThread * (threadId + 1);
   pos_begin = (pos_begin > sampleContainerSize) ? sampleContainerSize : pos_begin;
   pos_end = (pos_end > sampleContainerSize) ? sampleContainerSize : pos_end;
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator threader_fiter;
-  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator threader_fend = sampleContainer->Begin();
-
-  threader_fbegin += (int)pos_begin;
-  threader_fend += (int)pos_end;
+  /** The samples are processed per block: the points of a block are
+   * transformed with one call of the batch TransformPoints(), and their
+   * moving image values are interpolated together.
+   */
+  const unsigned int batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType fixedPoints[batchSize];
+  RealType fixedImageValues[batchSize];
+  MovingImagePointType mappedPoints[batchSize];
+  bool samplesOk[batchSize];
+  RealType movingImageValues[batchSize];
 
   /** Loop over the fixed image to calculate the mean squares. */
-  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = (*threader_fiter).Value().m_ImageCoordinates;
-    RealType movingImageValue;
-    MovingImagePointType mappedPoint;
-
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    const unsigned int blockSize = static_cast<unsigned int>(
+      std::min<unsigned long>( pos_end - blockBegin, batchSize ) );
 
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
-
-    /** Compute the moving image value M(T(x)) and check if
-    * the point is inside the moving image buffer.
-    */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative( mappedPoint, movingImageValue, 0 );
-    }
+    /** Read the fixed image samples, transform them, check if they are
+     * inside the moving mask, and compute the moving image values M(T(x)).
+     */
+    this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints, movingImageValues, 0, samplesOk, blockSize );
 
-    if( sampleOk )
+    for( unsigned int i = 0; i < blockSize; ++i )
     {
+      if( !samplesOk[i] )
+      {
+        continue;
+      }
       numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue = static_cast<RealType>( (*threader_fiter).Value().m_ImageValue );
+      const FixedImagePointType & fixedPoint = fixedPoints[i];
+      const RealType fixedImageValue = fixedImageValues[i];
+      const RealType movingImageValue = movingImageValues[i];
 
       /** Get the SpatialJacobian dT/dx. */
       this->m_AdvancedTransform->GetSpatialJacobian( fixedPoint, spatialJac );
@@ -276,7 +272,7 @@ void SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage,TMovingImage
         / ( this->m_TissueValue - this->m_AirValue );
       measure += diff * diff;
 
-    } // end if sampleOk
+    } // end for loop over the samples of the block
 
   } // end for loop over the image sample container
 
@@ -295,7 +291,7 @@ template <class TFixedImage, class TMovingImage>
 void SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage,TMovingImage>
 ::AfterThreadedGetValue( MeasureType & value ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted = this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
@@ -403,7 +399,7 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
     MovingImageDerivativeType movingImageDerivative;
 
     /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+    bool sampleOk = this->TransformSamplePoint( fiter.Index(), fixedPoint, mappedPoint );
 
     /** Check if point is inside mask. */
     if( sampleOk )
@@ -427,13 +423,16 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
       const RealType & fixedImageValue = static_cast<RealType>( (*fiter).Value().m_ImageValue );
 
       /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateSampleTransformJacobian( fiter.Index(), fixedPoint, jacobian, nzji );
 
       /** Compute the inner products (dM/dx)^T (dT/dmu). */
       this->EvaluateTransformJacobianInnerProduct( jacobian, movingImageDerivative, imageJacobian );
 
-      /** Get the SpatialJacobian dT/dx. */
-      this->m_AdvancedTransform->GetSpatialJacobian( fixedPoint, spatialJac );
+      /** Get the SpatialJacobian dT/dx and the JacobianOfSpatialJacobian in
+       * one call, so that the transform computes its weights only once.
+       */
+      this->m_AdvancedTransform->GetJacobianOfSpatialJacobian(
+        fixedPoint, spatialJac, jacobianOfSpatialJacobian, nzji );
 
       /** Compute the determinant of the Transform Jacobian |dT/dx|. */
       const RealType detjac = static_cast<RealType>( vnl_det( spatialJac.GetVnlMatrix() ) );
@@ -441,9 +440,6 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
       /** Compute the inverse spatialJacobian. */
       inverseSpatialJacobian = spatialJac.GetInverse();
 
-      /** Compute the JacobianOfSpatialJacobian. */
-      this->m_AdvancedTransform->GetJacobianOfSpatialJacobian( fixedPoint, jacobianOfSpatialJacobian, nzji );
-
       /** Compute the dot product of the inverse spatialJacobian and JacobianOfSpatialJacobian
       * to support calculation of the JacobianOfSpatialJacobianDeterminant. */
       this->EvaluateJacobianOfSpatialJacobianDeterminantInnerProduct(
@@ -524,10 +520,11 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
   MeasureType measure = NumericTraits<MeasureType> ::Zero;
   DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[threadId].st_Derivative;
 
-  /** Array that stores dM(x)/dmu, and the sparse jacobian+indices. */
-  NonZeroJacobianIndicesType nzji( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
-  DerivativeType imageJacobian( nzji.size() );
-  TransformJacobianType jacobian;
+  /** Pre-allocated arrays that store dM(x)/dmu, and the sparse jacobian+indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji = arena.sa_NonZeroJacobianIndices;
+  DerivativeType & imageJacobian = arena.sa_ImageJacobian;
+  TransformJacobianType & jacobian = arena.sa_TransformJacobian;
 
   /** Matrix to store the spatial Jacobian, dT/dx. */
   SpatialJacobianType spatialJac;
@@ -536,72 +533,70 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
   SpatialJacobianType inverseSpatialJacobian;
 
   /** Array that stores JacobianOfSpatialJacobian, d(dT/dx)/dmu */
-  JacobianOfSpatialJacobianType jacobianOfSpatialJacobian;
+  JacobianOfSpatialJacobianType & jacobianOfSpatialJacobian = arena.sa_JacobianOfSpatialJacobian;
 
-  DerivativeType jacobianOfSpatialJacobianDeterminant( nzji.size() );
+  DerivativeType & jacobianOfSpatialJacobianDeterminant = arena.sa_ImageJacobian2;
 
-  /** Get a handle to the sample container. */
-  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
-  const unsigned long sampleContainerSize = sampleContainer->Size();
+  /** Get the number of samples. */
+  const unsigned long sampleContainerSize = this->GetNumberOfFixedImageSamples();
 
   /** Get the samples for this thread. */
   const unsigned long nSamplesPerThread
     = static_cast<unsigned long>(std::ceil(static_cast<double>( sampleContainerSize )
-      / static_cast<double>( Self::GetNumberOfWorkUnits() ) ) );
+      / static_cast<double>( Self::GetNumberOfReductionChunks() ) ) );
 
   unsigned long pos_begin = nSamplesPerThread * threadId;
   unsigned long pos_end = nSamplesPerThread * (threadId + 1);
   pos_begin = (pos_begin > sampleContainerSize) ? sampleContainerSize : pos_begin;
   pos_end = (pos_end > sampleContainerSize) ? sampleContainerSize : pos_end;
 
-  /** Create iterator over the sample container. */
-  typename ImageSampleContainerType::ConstIterator threader_fiter;
-  typename ImageSampleContainerType::ConstIterator threader_fbegin = sampleContainer->Begin();
-  typename ImageSampleContainerType::ConstIterator threader_fend = sampleContainer->Begin();
-  threader_fbegin += (int)pos_begin;
-  threader_fend += (int)pos_end;
+  /** The samples are processed per block, see ThreadedGetValue(). */
+  const unsigned int batchSize = Superclass::MovingImageBatchSize;
+  FixedImagePointType fixedPoints[batchSize];
+  RealType fixedImageValues[batchSize];
+  MovingImagePointType mappedPoints[batchSize];
+  bool samplesOk[batchSize];
+  RealType movingImageValues[batchSize];
+  MovingImageDerivativeType movingImageDerivatives[batchSize];
 
   /** Loop over the fixed image to calculate the mean squares. */
-  for( threader_fiter = threader_fbegin; threader_fiter != threader_fend; ++threader_fiter )
+  for( unsigned long blockBegin = pos_begin; blockBegin < pos_end; blockBegin += batchSize )
   {
-    /** Read fixed coordinates and initialize some variables. */
-    const FixedImagePointType & fixedPoint = (*threader_fiter).Value().m_ImageCoordinates;
-    RealType movingImageValue;
-    MovingImagePointType mappedPoint;
-    MovingImageDerivativeType movingImageDerivative;
+    const unsigned int blockSize = static_cast<unsigned int>(
+      std::min<unsigned long>( pos_end - blockBegin, batchSize ) );
 
-    /** Transform point and check if it is inside the B-spline support region. */
-    bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
-
-    /** Check if point is inside mask. */
-    if( sampleOk )
-    {
-      sampleOk = this->IsInsideMovingMask( mappedPoint );
-    }
-
-    /** Compute the moving image value M(T(x)) and derivative dM/dx and check if
-    * the point is inside the moving image buffer.
-    */
-    if( sampleOk )
-    {
-      sampleOk = this->EvaluateMovingImageValueAndDerivative( mappedPoint, movingImageValue, &movingImageDerivative );
-    }
+    /** Read the fixed image samples, transform them, check if they are
+     * inside the moving mask, and compute the moving image values M(T(x))
+     * and derivatives dM/dx.
+     */
+    this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+    this->TransformMovingImageBatch( fixedPoints, mappedPoints, samplesOk, blockSize, blockBegin );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+      movingImageValues, movingImageDerivatives, samplesOk, blockSize );
 
-    if( sampleOk )
+    for( unsigned int i = 0; i < blockSize; ++i )
     {
+      if( !samplesOk[i] )
+      {
+        continue;
+      }
       numberOfPixelsCounted++;
 
-      /** Get the fixed image value. */
-      const RealType & fixedImageValue = static_cast<RealType>( (*threader_fiter).Value().m_ImageValue );
+      const FixedImagePointType & fixedPoint = fixedPoints[i];
+      const RealType fixedImageValue = fixedImageValues[i];
+      const RealType movingImageValue = movingImageValues[i];
 
       /** Get the TransformJacobian dT/dmu. */
-      this->EvaluateTransformJacobian( fixedPoint, jacobian, nzji );
+      this->EvaluateSampleTransformJacobian( blockBegin + i, fixedPoint, jacobian, nzji );
 
       /** Compute the inner products (dM/dx)^T (dT/dmu). */
-      this->EvaluateTransformJacobianInnerProduct( jacobian, movingImageDerivative, imageJacobian );
+      this->EvaluateTransformJacobianInnerProduct( jacobian, movingImageDerivatives[i], imageJacobian );
 
-      /** Get the SpatialJacobian dT/dx. */
-      this->m_AdvancedTransform->GetSpatialJacobian( fixedPoint, spatialJac );
+      /** Get the SpatialJacobian dT/dx and the JacobianOfSpatialJacobian in
+       * one call, so that the transform computes its weights only once.
+       */
+      this->m_AdvancedTransform->GetJacobianOfSpatialJacobian(
+        fixedPoint, spatialJac, jacobianOfSpatialJacobian, nzji );
 
       /** Compute the determinant of the Transform Jacobian |dT/dx|. */
       const RealType detjac = static_cast<RealType>( vnl_det( spatialJac.GetVnlMatrix() ) );
@@ -609,9 +604,6 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
       /** Compute the inverse spatialJacobian. */
       inverseSpatialJacobian = spatialJac.GetInverse();
 
-      /** Compute the JacobianOfSpatialJacobian. */
-      this->m_AdvancedTransform->GetJacobianOfSpatialJacobian( fixedPoint, jacobianOfSpatialJacobian, nzji );
-
       /** Compute the dot product of the inverse spatialJacobian and JacobianOfSpatialJacobian
        * to support calculation of the JacobianOfSpatialJacobianDeterminant.
        */
@@ -629,9 +621,9 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
         measure,
         derivative );
 
-    } // end if sampleOk
+    } // end for loop over the samples of the block
 
-  }
+  } // end for loop over the image sample container
 
   /** Only update these variables at the end to prevent unnecessary "false sharing". */
   this->m_GetValueAndDerivativePerThreadVariables[threadId].st_NumberOfPixelsCounted = numberOfPixelsCounted;
@@ -650,7 +642,7 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
   MeasureType & value,
   DerivativeType & derivative ) const
 {
-  const ThreadIdType numberOfThreads = Self::GetNumberOfWorkUnits();
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
 
   /** Accumulate the number of pixels. */
   this->m_NumberOfPixelsCounted = this->m_GetValueAndDerivativePerThreadVariables[0].st_NumberOfPixelsCounted;
@@ -697,9 +689,8 @@ SumSquaredTissueVolumeDifferenceImageToImageMetric<TFixedImage, TMovingImage>
     this->m_ThreaderMetricParameters.st_NormalizationFactor =
       static_cast<DerivativeValueType>(this->m_NumberOfPixelsCounted);
 
-    this->m_Threader->SetSingleMethod(this->AccumulateDerivativesThreaderCallback,
+    this->LaunchThreaderCallback(this->AccumulateDerivativesThreaderCallback,
       const_cast<void *>(static_cast<const void *>(&this->m_ThreaderMetricParameters)));
-    this->m_Threader->SingleMethodExecute();
   }
 
 #ifdef ELASTIX_USE_OPENMP
@@ -58,6 +58,13 @@ namespace elastix
  * \parameter SubtractMean: subtract the over time computed mean parameter value from
  *    each parameter. This should be used when registration is performed directly on the moving
  *    image, without using a fixed image. Possible values are "true" or "false".
+ * \parameter UseSparseDerivativeAccumulation: Bool to accumulate the derivative
+ *    sparsely over the threads, instead of using a full-length derivative per thread.
+ *    This saves memory and time for transforms with sparse Jacobians, such as the
+ *    B-spline with a fine grid. Used when the metric is multi-threaded. Can be given
+ *    for each resolution.\n
+ *    <tt>(UseSparseDerivativeAccumulation "true")</tt>\n
+ *    The default value is false.
  *
  * \ingroup RegistrationMetrics
  * \ingroup Metrics
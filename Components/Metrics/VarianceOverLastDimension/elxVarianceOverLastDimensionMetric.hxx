@@ -125,6 +125,12 @@ VarianceOverLastDimensionMetric< TElastix >
     this->GetComponentLabel(), 0, 0 );
   this->SetReducedDimensionIndex( reducedDimensionIndex );
 
+  /** Select sparse accumulation of the derivative over the threads. */
+  bool useSparseDerivativeAccumulation = false;
+  this->GetConfiguration()->ReadParameter( useSparseDerivativeAccumulation,
+    "UseSparseDerivativeAccumulation", this->GetComponentLabel(), level, 0 );
+  this->SetUseSparseDerivativeAccumulation( useSparseDerivativeAccumulation );
+
   /** Check if this transform is a B-spline transform. */
   CombinationTransformType * testPtr1
     = dynamic_cast< CombinationTransformType * >( this->GetElastix()->GetElxTransformBase() );
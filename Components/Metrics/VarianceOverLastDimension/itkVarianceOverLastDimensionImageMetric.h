@@ -173,6 +173,17 @@ protected:
   typedef typename Superclass::CentralDifferenceGradientFilterType CentralDifferenceGradientFilterType;
   typedef typename Superclass::MovingImageDerivativeType           MovingImageDerivativeType;
   typedef typename Superclass::NonZeroJacobianIndicesType          NonZeroJacobianIndicesType;
+  typedef typename Superclass::DerivativeValueType                 DerivativeValueType;
+
+  /** A term of the derivative: the weight times the inner product of the
+   * moving image gradient at T(x) with the transform Jacobian at x.
+   */
+  struct DerivativeTermType
+  {
+    FixedImagePointType       m_FixedPoint;
+    MovingImageDerivativeType m_MovingImageDerivative;
+    double                    m_Weight;
+  };
 
   /** Computes the innerproduct of transform Jacobian with moving image gradient.
    * The results are stored in imageJacobian, which is supposed
@@ -182,6 +193,25 @@ protected:
     const MovingImageDerivativeType & movingImageDerivative,
     DerivativeType & imageJacobian ) const override;
 
+  /** Get value and derivatives single-threaded. */
+  MeasureType GetValueSingleThreaded( const TransformParametersType & parameters ) const;
+
+  void GetValueAndDerivativeSingleThreaded( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const;
+
+  /** Compute the variances of the samples of one thread. */
+  inline void ThreadedGetValue( ThreadIdType threadID ) override;
+
+  /** Gather the values of all threads. */
+  inline void AfterThreadedGetValue( MeasureType & value ) const override;
+
+  /** Compute the variances and their derivatives of the samples of one thread. */
+  inline void ThreadedGetValueAndDerivative( ThreadIdType threadID ) override;
+
+  /** Gather the values and derivatives of all threads. */
+  inline void AfterThreadedGetValueAndDerivative(
+    MeasureType & value, DerivativeType & derivative ) const override;
+
 private:
 
   VarianceOverLastDimensionImageMetric( const Self & ); // purposely not implemented
@@ -190,6 +220,29 @@ private:
   /** Sample n random numbers from 0..m and add them to the vector. */
   void SampleRandom( const int n, const int m, std::vector< int > & numbers ) const;
 
+  /** Get the last dimension positions used for all samples, as a flat array
+   * with GetNumberOfLastDimensionPositions() positions per sample. The random
+   * positions are drawn serially in the order of the samples, before the
+   * threads start, because the random generator is shared.
+   */
+  void InitializeLastDimensionPositions( const unsigned long numberOfSamples ) const;
+
+  /** Get the number of last dimension positions per sample. */
+  unsigned int GetNumberOfLastDimensionPositions( void ) const;
+
+  /** Add the derivative terms of one last dimension position to the derivative. */
+  void AddDerivativeTerms( const std::vector< DerivativeTermType > & terms,
+    DerivativeType & derivative ) const;
+
+  /** Compute the value and derivative for a stack transform. The moving
+   * image is evaluated in tiles of samples and positions, and the terms of
+   * each position are added to its own block of the derivative in parallel.
+   */
+  void GetValueAndDerivativeOfStack( MeasureType & value, DerivativeType & derivative ) const;
+
+  /** Subtract the mean over the last dimension from the derivative elements. */
+  void SubtractMeanFromDerivative( DerivativeType & derivative ) const;
+
   /** Variables to control random sampling in last dimension. */
   bool         m_SampleLastDimensionRandomly;
   unsigned int m_NumSamplesLastDimension;
@@ -208,6 +261,9 @@ private:
   /** Bool to indicate if the transform used is a stacktransform. Set by elx files. */
   bool m_TransformIsStackTransform;
 
+  /** The last dimension positions of the samples, shared by the threads. */
+  mutable std::vector< int > m_LastDimensionPositions;
+
 };
 
 } // end namespace itk
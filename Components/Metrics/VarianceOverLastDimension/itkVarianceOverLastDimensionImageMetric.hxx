@@ -21,6 +21,9 @@
 #include "itkVarianceOverLastDimensionImageMetric.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "vnl/algo/vnl_matrix_update.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <numeric>
 
 namespace itk
@@ -160,6 +163,143 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
 } // end SampleRandom()
 
 
+/**
+ * ******************* GetNumberOfLastDimensionPositions *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+unsigned int
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::GetNumberOfLastDimensionPositions( void ) const
+{
+  if( this->m_SampleLastDimensionRandomly )
+  {
+    return this->m_NumSamplesLastDimension + this->m_NumAdditionalSamplesFixed;
+  }
+
+  const unsigned int lastDim = this->GetFixedImage()->GetImageDimension() - 1;
+  return this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+} // end GetNumberOfLastDimensionPositions()
+
+
+/**
+ * ******************* InitializeLastDimensionPositions *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::InitializeLastDimensionPositions( const unsigned long numberOfSamples ) const
+{
+  const unsigned int lastDim     = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int lastDimSize = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  /** Without random sampling all samples use all positions, so one row suffices. */
+  if( !this->m_SampleLastDimensionRandomly )
+  {
+    this->m_LastDimensionPositions.resize( lastDimSize );
+    for( unsigned int i = 0; i < lastDimSize; ++i )
+    {
+      this->m_LastDimensionPositions[ i ] = i;
+    }
+    return;
+  }
+
+  /** Draw the positions in the same order as the single-threaded code. */
+  const unsigned int numberOfPositions = this->GetNumberOfLastDimensionPositions();
+  this->m_LastDimensionPositions.resize( numberOfSamples * numberOfPositions );
+  std::vector< int > positions;
+  for( unsigned long i = 0; i < numberOfSamples; ++i )
+  {
+    this->SampleRandom( this->m_NumSamplesLastDimension, lastDimSize, positions );
+    std::copy( positions.begin(), positions.end(),
+      this->m_LastDimensionPositions.begin() + i * numberOfPositions );
+  }
+
+} // end InitializeLastDimensionPositions()
+
+
+/**
+ * ******************* SubtractMeanFromDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::SubtractMeanFromDerivative( DerivativeType & derivative ) const
+{
+  /** Retrieve slowest varying dimension and its size. */
+  const unsigned int lastDim     = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int lastDimSize = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+
+  if( !this->m_TransformIsStackTransform )
+  {
+    /** Update derivative per dimension.
+    * Parameters are ordered xxxxxxx yyyyyyy zzzzzzz ttttttt and
+    * per dimension xyz.
+    */
+    const unsigned int lastDimGridSize              = this->m_GridSize[ lastDim ];
+    const unsigned int numParametersPerDimension    = this->GetNumberOfParameters() / this->GetMovingImage()->GetImageDimension();
+    const unsigned int numControlPointsPerDimension = numParametersPerDimension / lastDimGridSize;
+    DerivativeType     mean( numControlPointsPerDimension );
+    for( unsigned int d = 0; d < this->GetMovingImage()->GetImageDimension(); ++d )
+    {
+      /** Compute mean per dimension. */
+      mean.Fill( 0.0 );
+      const unsigned int starti = numParametersPerDimension * d;
+      for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
+      {
+        const unsigned int index = i % numControlPointsPerDimension;
+        mean[ index ] += derivative[ i ];
+      }
+      mean /= static_cast< double >( lastDimGridSize );
+
+      /** Update derivative for every control point per dimension. */
+      for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
+      {
+        const unsigned int index = i % numControlPointsPerDimension;
+        derivative[ i ] -= mean[ index ];
+      }
+    }
+  }
+  else
+  {
+    /** Update derivative per dimension.
+    * Parameters are ordered x0x0x0y0y0y0z0z0z0x1x1x1y1y1y1z1z1z1 with
+    * the number the time point index.
+    */
+    const unsigned int numParametersPerLastDimension = this->GetNumberOfParameters() / lastDimSize;
+    DerivativeType     mean( numParametersPerLastDimension );
+    mean.Fill( 0.0 );
+
+    /** Compute mean per control point. */
+    for( unsigned int t = 0; t < lastDimSize; ++t )
+    {
+      const unsigned int startc = numParametersPerLastDimension * t;
+      for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+      {
+        const unsigned int index = c % numParametersPerLastDimension;
+        mean[ index ] += derivative[ c ];
+      }
+    }
+    mean /= static_cast< double >( lastDimSize );
+
+    /** Update derivative per control point. */
+    for( unsigned int t = 0; t < lastDimSize; ++t )
+    {
+      const unsigned int startc = numParametersPerLastDimension * t;
+      for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+      {
+        const unsigned int index = c % numParametersPerLastDimension;
+        derivative[ c ] -= mean[ index ];
+      }
+    }
+  }
+
+} // end SubtractMeanFromDerivative()
+
+
 /**
  * *************** EvaluateTransformJacobianInnerProduct ****************
  */
@@ -193,13 +333,13 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* GetValue *******************
+ * ******************* GetValueSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 typename VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >::MeasureType
 VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
-::GetValue( const TransformParametersType & parameters ) const
+::GetValueSingleThreaded( const TransformParametersType & parameters ) const
 {
   itkDebugMacro( "GetValue( " << parameters << " ) " );
 
@@ -330,9 +470,193 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
   /** Return the mean squares measure value. */
   return measure;
 
+} // end GetValueSingleThreaded()
+
+
+/**
+ * ******************* GetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >::MeasureType
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::GetValue( const TransformParametersType & parameters ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueSingleThreaded( parameters );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * Because of these calls GetValue itself is not thread-safe,
+   * so cannot be called multiple times simultaneously.
+   * This is however needed in the CombinationImageToImageMetric.
+   * In that case, you need to:
+   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
+   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before calling GetValue
+   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
+   * - Now you can call GetValue multi-threaded.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Draw the random last dimension positions, which is not thread-safe. */
+  this->InitializeLastDimensionPositions( this->GetImageSampler()->GetOutput()->Size() );
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueThreaderCallback();
+
+  /** Gather the metric values from all threads. */
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->AfterThreadedGetValue( value );
+
+  return value;
+
 } // end GetValue()
 
 
+/**
+ * ******************* ThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetValue( ThreadIdType threadId )
+{
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
+  const unsigned long         sampleContainerSize = sampleContainer->Size();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Retrieve slowest varying dimension and the positions per sample. */
+  const unsigned int lastDim                 = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int realNumLastDimPositions = this->GetNumberOfLastDimensionPositions();
+  const unsigned int positionsStride         = this->m_SampleLastDimensionRandomly ? realNumLastDimPositions : 0;
+
+  /** Variables to store the points and values of the positions of a sample. */
+  std::vector< FixedImagePointType >  fixedPoints( realNumLastDimPositions );
+  std::vector< MovingImagePointType > mappedPoints( realNumLastDimPositions );
+  std::vector< RealType >             MT( realNumLastDimPositions );
+  std::unique_ptr< bool[] >           MTOk( new bool[ realNumLastDimPositions ] );
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  unsigned long numberOfPixelsCounted = 0;
+  MeasureType   measure               = NumericTraits< MeasureType >::Zero;
+
+  /** Loop over the fixed image samples to calculate the variance over time for every sample position. */
+  for( unsigned long sampleIndex = pos_begin; sampleIndex < pos_end; ++sampleIndex )
+  {
+    /** Read fixed coordinates. */
+    const FixedImagePointType & fixedPoint = sampleContainer->ElementAt( sampleIndex ).m_ImageCoordinates;
+    const int *                 lastDimPositions
+      = this->m_LastDimensionPositions.data() + sampleIndex * positionsStride;
+
+    /** Transform sampled point to voxel coordinates. */
+    FixedImageContinuousIndexType voxelCoord;
+    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
+
+    /** Set the last dimension of the point to each of the positions, and
+     * transform the points back to world coordinates.
+     */
+    for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
+    {
+      voxelCoord[ lastDim ] = lastDimPositions[ d ];
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d ] );
+    }
+
+    /** Transform the points of all positions in one batch, check if they are
+     * inside the moving mask, and compute the moving image values.
+     */
+    this->TransformMovingImageBatch( fixedPoints.data(), mappedPoints.data(), MTOk.get(), realNumLastDimPositions );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints.data(), MT.data(), 0, MTOk.get(), realNumLastDimPositions );
+
+    /** Loop over the slowest varying dimension. */
+    float        sumValues        = 0.0;
+    float        sumValuesSquared = 0.0;
+    unsigned int numSamplesOk     = 0;
+    for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
+    {
+      if( MTOk[ d ] )
+      {
+        numSamplesOk++;
+        sumValues        += MT[ d ];
+        sumValuesSquared += MT[ d ] * MT[ d ];
+      } // end if sampleOk
+    } // end for loop over last dimension
+
+    if( numSamplesOk > 0 )
+    {
+      numberOfPixelsCounted++;
+
+      /** Add this variance to the variance sum. */
+      const float expectedValue        = sumValues / static_cast< float >( numSamplesOk );
+      const float expectedSquaredValue = sumValuesSquared / static_cast< float >( numSamplesOk );
+      measure += expectedSquaredValue - expectedValue * expectedValue;
+    }
+
+  } // end for loop over the image sample container
+
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
+
+} // end ThreadedGetValue()
+
+
+/**
+ * ******************* AfterThreadedGetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetValue( MeasureType & value ) const
+{
+  const ThreadIdType numberOfThreads = Self::GetNumberOfReductionChunks();
+
+  /** Accumulate the number of pixels. */
+  this->m_NumberOfPixelsCounted = this->m_GetValueAndDerivativePerThreadVariables[ 0 ].st_NumberOfPixelsCounted;
+  for( ThreadIdType i = 1; i < numberOfThreads; ++i )
+  {
+    this->m_NumberOfPixelsCounted += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_NumberOfPixelsCounted = 0;
+  }
+
+  /** Check if enough samples were valid. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  this->CheckNumberOfSamples(
+    sampleContainer->Size(), this->m_NumberOfPixelsCounted );
+
+  /** Accumulate values. */
+  value = NumericTraits< MeasureType >::Zero;
+  for( ThreadIdType i = 0; i < numberOfThreads; ++i )
+  {
+    value += this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value;
+
+    /** Reset this variable for the next iteration. */
+    this->m_GetValueAndDerivativePerThreadVariables[ i ].st_Value = NumericTraits< MeasureType >::Zero;
+  }
+
+  /** Compute average over variances and normalize with initial variance. */
+  value /= static_cast< float >( this->m_NumberOfPixelsCounted * this->m_InitialVariance );
+
+} // end AfterThreadedGetValue()
+
+
 /**
  * ******************* GetDerivative *******************
  */
@@ -355,20 +679,17 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
 
 
 /**
- * ******************* GetValueAndDerivative *******************
+ * ******************* GetValueAndDerivativeSingleThreaded *******************
  */
 
 template< class TFixedImage, class TMovingImage >
 void
 VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
-::GetValueAndDerivative( const TransformParametersType & parameters,
+::GetValueAndDerivativeSingleThreaded( const TransformParametersType & parameters,
   MeasureType & value, DerivativeType & derivative ) const
 {
   itkDebugMacro( "GetValueAndDerivative( " << parameters << " ) " );
 
-  /** Define derivative and Jacobian types. */
-  typedef typename DerivativeType::ValueType DerivativeValueType;
-
   /** Initialize some variables */
   this->m_NumberOfPixelsCounted = 0;
   MeasureType measure = NumericTraits< MeasureType >::Zero;
@@ -415,22 +736,22 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
     }
   }
 
-  /** Create variables to store intermediate results in. */
-  TransformJacobianType jacobian;
-  DerivativeType        imageJacobian( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
-
   /** Get real last dim samples. */
   const unsigned int realNumLastDimPositions
     = this->m_SampleLastDimensionRandomly
     ? this->m_NumSamplesLastDimension + this->m_NumAdditionalSamplesFixed
     : lastDimSize;
 
-  /** Variable to store and nzjis. */
-  std::vector< NonZeroJacobianIndicesType > nzjis(
-  realNumLastDimPositions, NonZeroJacobianIndicesType() );
+  /** The derivative terms of the valid samples, grouped per last dimension
+   * position. They are accumulated after the loop over the samples.
+   */
+  std::vector< std::vector< DerivativeTermType > > derivativeTerms( lastDimSize );
 
-  std::vector< RealType >       MT( realNumLastDimPositions );
-  std::vector< DerivativeType > dMTdmu( realNumLastDimPositions );
+  /** Variables to store the values, gradients and points of a sample. */
+  std::vector< RealType >                  MT( realNumLastDimPositions );
+  std::vector< MovingImageDerivativeType > dMTdx( realNumLastDimPositions );
+  std::vector< FixedImagePointType >       fixedPoints( realNumLastDimPositions );
+  std::vector< bool >                      MTOk( realNumLastDimPositions );
 
   /** Loop over the fixed image samples to calculate the variance over time for every sample position. */
   for( fiter = fbegin; fiter != fend; ++fiter )
@@ -444,9 +765,6 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
       this->SampleRandom( this->m_NumSamplesLastDimension, lastDimSize, lastDimPositions );
     }
 
-    /** Initialize MT vector. */
-    std::fill( MT.begin(), MT.end(), itk::NumericTraits< RealType >::ZeroValue() );
-
     /** Transform sampled point to voxel coordinates. */
     FixedImageContinuousIndexType voxelCoord;
     this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
@@ -456,7 +774,7 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
     float        sumValuesSquared = 0.0;
     unsigned int numSamplesOk     = 0;
 
-    /** First loop over t: compute M(T(x,t)), dM(T(x,t))/dmu, nzji and store. */
+    /** First loop over t: compute M(T(x,t)) and dM(T(x,t))/dx and store. */
     for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
     {
       /** Initialize some variables. */
@@ -485,6 +803,7 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
           mappedPoint, movingImageValue, &movingImageDerivative );
       }
 
+      MTOk[ d ] = sampleOk;
       if( sampleOk )
       {
         /** Update value terms **/
@@ -492,22 +811,10 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
         sumValues        += movingImageValue;
         sumValuesSquared += movingImageValue * movingImageValue;
 
-        /** Get the TransformJacobian dT/dmu. */
-        this->EvaluateTransformJacobian( fixedPoint, jacobian, nzjis[ d ] );
-
-        /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
-        this->EvaluateTransformJacobianInnerProduct(
-          jacobian, movingImageDerivative, imageJacobian );
-
         /** Store values. */
-        MT[ d ]     = movingImageValue;
-        dMTdmu[ d ] = imageJacobian;
-      }
-      else
-      {
-        dMTdmu[ d ] = DerivativeType( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
-        dMTdmu[ d ].Fill( itk::NumericTraits< DerivativeValueType >::ZeroValue() );
-        nzjis[ d ] = NonZeroJacobianIndicesType( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices(), 0 );
+        MT[ d ]          = movingImageValue;
+        dMTdx[ d ]       = movingImageDerivative;
+        fixedPoints[ d ] = fixedPoint;
       } // end if sampleOk
     }
 
@@ -521,19 +828,35 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
       const float expectedSquaredValue = sumValuesSquared / static_cast< float >( numSamplesOk );
       measure += expectedSquaredValue - expectedValue * expectedValue;
 
-      /** Second loop over t: update derivative. */
+      /** Second loop over t: store the derivative terms
+       * 2 ( M(T(x,t)) - E ) / n * dM/dx^T dT/dmu.
+       */
       for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
       {
-        for( unsigned int j = 0; j < nzjis[ d ].size(); ++j )
+        if( MTOk[ d ] )
         {
-          derivative[ nzjis[ d ][ j ] ] += ( 2.0 * ( MT[ d ] - expectedValue ) * dMTdmu[ d ][ j ] )
+          DerivativeTermType term;
+          term.m_FixedPoint            = fixedPoints[ d ];
+          term.m_MovingImageDerivative = dMTdx[ d ];
+          term.m_Weight                = ( 2.0 * ( MT[ d ] - expectedValue ) )
             / static_cast< float >( numSamplesOk );
+          derivativeTerms[ lastDimPositions[ d ] ].push_back( term );
         }
       }
 
     }
   } // end for loop over the image sample container
 
+  /** Accumulate the derivative terms per last dimension position. For a stack
+   * transform, the terms of a position only affect the parameters of its sub
+   * transform, so the positions are processed in parallel.
+   */
+  this->ProcessSlices( lastDimSize, this->m_TransformIsStackTransform,
+    [ this, &derivativeTerms, &derivative ]( const unsigned int slice )
+    {
+      this->AddDerivativeTerms( derivativeTerms[ slice ], derivative );
+    } );
+
   /** Check if enough samples were valid. */
   this->CheckNumberOfSamples(
     sampleContainer->Size(), this->m_NumberOfPixelsCounted );
@@ -545,75 +868,426 @@ VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
   /** Subtract mean from derivative elements. */
   if( this->m_SubtractMean )
   {
-    if( !this->m_TransformIsStackTransform )
+    this->SubtractMeanFromDerivative( derivative );
+  }
+
+  /** Return the measure value. */
+  value = measure;
+
+} // end GetValueAndDerivativeSingleThreaded()
+
+
+/**
+ * ******************* AddDerivativeTerms *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::AddDerivativeTerms( const std::vector< DerivativeTermType > & terms,
+  DerivativeType & derivative ) const
+{
+  DerivativeType             imageJacobian( this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices() );
+  NonZeroJacobianIndicesType nzji;
+  for( const DerivativeTermType & term : terms )
+  {
+    /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
+    this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+      term.m_FixedPoint, term.m_MovingImageDerivative, imageJacobian, nzji );
+    for( unsigned int j = 0; j < nzji.size(); ++j )
     {
-      /** Update derivative per dimension.
-      * Parameters are ordered xxxxxxx yyyyyyy zzzzzzz ttttttt and
-      * per dimension xyz.
-      */
-      const unsigned int lastDimGridSize              = this->m_GridSize[ lastDim ];
-      const unsigned int numParametersPerDimension    = this->GetNumberOfParameters() / this->GetMovingImage()->GetImageDimension();
-      const unsigned int numControlPointsPerDimension = numParametersPerDimension / lastDimGridSize;
-      DerivativeType     mean( numControlPointsPerDimension );
-      for( unsigned int d = 0; d < this->GetMovingImage()->GetImageDimension(); ++d )
+      derivative[ nzji[ j ] ] += term.m_Weight * imageJacobian[ j ];
+    }
+  }
+
+} // end AddDerivativeTerms()
+
+
+/**
+ * ******************* GetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivative( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  /** Option for now to still use the single threaded code. */
+  if( !this->m_UseMultiThread )
+  {
+    return this->GetValueAndDerivativeSingleThreaded(
+      parameters, value, derivative );
+  }
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * Because of these calls GetValueAndDerivative itself is not thread-safe,
+   * so cannot be called multiple times simultaneously.
+   * This is however needed in the CombinationImageToImageMetric.
+   * In that case, you need to:
+   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
+   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
+   *   calling GetValueAndDerivative
+   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
+   * - Now you can call GetValueAndDerivative multi-threaded.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Draw the random last dimension positions, which is not thread-safe. */
+  this->InitializeLastDimensionPositions( this->GetImageSampler()->GetOutput()->Size() );
+
+  /** For a stack transform, split over the samples and the positions. */
+  if( this->m_TransformIsStackTransform )
+  {
+    return this->GetValueAndDerivativeOfStack( value, derivative );
+  }
+
+  /** Launch multi-threading metric */
+  this->LaunchGetValueAndDerivativeThreaderCallback();
+
+  /** Gather the metric values and derivatives from all threads. */
+  this->AfterThreadedGetValueAndDerivative( value, derivative );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ******************* GetValueAndDerivativeOfStack *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivativeOfStack( MeasureType & value, DerivativeType & derivative ) const
+{
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer = this->GetImageSampler()->GetOutput();
+  const unsigned long         numberOfSamples = sampleContainer->Size();
+
+  /** Retrieve slowest varying dimension and the positions per sample. */
+  const unsigned int lastDim                 = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int lastDimSize             = this->GetFixedImage()->GetLargestPossibleRegion().GetSize( lastDim );
+  const unsigned int realNumLastDimPositions = this->GetNumberOfLastDimensionPositions();
+  const unsigned int positionsStride         = this->m_SampleLastDimensionRandomly ? realNumLastDimPositions : 0;
+
+  /** The values, gradients and points of all samples at all positions. */
+  const unsigned long                      numberOfEntries = numberOfSamples * realNumLastDimPositions;
+  std::vector< RealType >                  MT( numberOfEntries );
+  std::vector< MovingImageDerivativeType > dMTdx( numberOfEntries );
+  std::vector< FixedImagePointType >       fixedPoints( numberOfEntries );
+  std::vector< unsigned char >             MTOk( numberOfEntries, 0 );
+
+  /** First phase: compute M(T(x,t)) and dM(T(x,t))/dx in tiles of samples
+   * and positions, so that also few samples of many positions use all threads.
+   */
+  this->ProcessSampleAndPositionTiles( numberOfSamples, realNumLastDimPositions,
+    [ &, this ]( const unsigned long sampleBegin, const unsigned long sampleEnd,
+    const unsigned int positionBegin, const unsigned int positionEnd )
+    {
+      for( unsigned long sampleIndex = sampleBegin; sampleIndex < sampleEnd; ++sampleIndex )
       {
-        /** Compute mean per dimension. */
-        mean.Fill( 0.0 );
-        const unsigned int starti = numParametersPerDimension * d;
-        for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
-        {
-          const unsigned int index = i % numControlPointsPerDimension;
-          mean[ index ] += derivative[ i ];
-        }
-        mean /= static_cast< double >( lastDimGridSize );
+        /** Read fixed coordinates. */
+        FixedImagePointType fixedPoint = sampleContainer->ElementAt( sampleIndex ).m_ImageCoordinates;
+        const int *         lastDimPositions
+          = this->m_LastDimensionPositions.data() + sampleIndex * positionsStride;
+
+        /** Transform sampled point to voxel coordinates. */
+        FixedImageContinuousIndexType voxelCoord;
+        this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
 
-        /** Update derivative for every control point per dimension. */
-        for( unsigned int i = starti; i < starti + numParametersPerDimension; ++i )
+        for( unsigned int d = positionBegin; d < positionEnd; ++d )
         {
-          const unsigned int index = i % numControlPointsPerDimension;
-          derivative[ i ] -= mean[ index ];
+          /** Initialize some variables. */
+          RealType                  movingImageValue;
+          MovingImagePointType      mappedPoint;
+          MovingImageDerivativeType movingImageDerivative;
+
+          /** Set fixed point's last dimension to lastDimPosition. */
+          voxelCoord[ lastDim ] = lastDimPositions[ d ];
+          /** Transform sampled point back to world coordinates. */
+          this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoint );
+          /** Transform point and check if it is inside the B-spline support region. */
+          bool sampleOk = this->TransformPoint( fixedPoint, mappedPoint );
+
+          /** Check if point is inside mask. */
+          if( sampleOk )
+          {
+            sampleOk = this->IsInsideMovingMask( mappedPoint );
+          }
+
+          /** Compute the moving image value and check if the point is
+           * inside the moving image buffer. */
+          if( sampleOk )
+          {
+            sampleOk = this->EvaluateMovingImageValueAndDerivative(
+              mappedPoint, movingImageValue, &movingImageDerivative );
+          }
+
+          if( sampleOk )
+          {
+            const unsigned long entry = sampleIndex * realNumLastDimPositions + d;
+            MTOk[ entry ]        = 1;
+            MT[ entry ]          = movingImageValue;
+            dMTdx[ entry ]       = movingImageDerivative;
+            fixedPoints[ entry ] = fixedPoint;
+          }
         }
       }
+    } );
+
+  /** Compute the variances, in the order of the samples, and group the
+   * derivative terms 2 ( M(T(x,t)) - E ) / n * dM/dx^T dT/dmu per position.
+   */
+  this->m_NumberOfPixelsCounted = 0;
+  MeasureType                                      measure = NumericTraits< MeasureType >::Zero;
+  std::vector< std::vector< DerivativeTermType > > derivativeTerms( lastDimSize );
+  for( unsigned long sampleIndex = 0; sampleIndex < numberOfSamples; ++sampleIndex )
+  {
+    const unsigned long first = sampleIndex * realNumLastDimPositions;
+    const int *         lastDimPositions
+      = this->m_LastDimensionPositions.data() + sampleIndex * positionsStride;
+
+    float        sumValues        = 0.0;
+    float        sumValuesSquared = 0.0;
+    unsigned int numSamplesOk     = 0;
+    for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
+    {
+      if( MTOk[ first + d ] )
+      {
+        numSamplesOk++;
+        sumValues        += MT[ first + d ];
+        sumValuesSquared += MT[ first + d ] * MT[ first + d ];
+      }
     }
-    else
+
+    if( numSamplesOk == 0 )
     {
-      /** Update derivative per dimension.
-      * Parameters are ordered x0x0x0y0y0y0z0z0z0x1x1x1y1y1y1z1z1z1 with
-      * the number the time point index.
-      */
-      const unsigned int numParametersPerLastDimension = this->GetNumberOfParameters() / lastDimSize;
-      DerivativeType     mean( numParametersPerLastDimension );
-      mean.Fill( 0.0 );
+      continue;
+    }
+    this->m_NumberOfPixelsCounted++;
 
-      /** Compute mean per control point. */
-      for( unsigned int t = 0; t < lastDimSize; ++t )
+    /** Compute average intensity value. */
+    const float expectedValue = sumValues / static_cast< float >( numSamplesOk );
+    /** Add this variance to the variance sum. */
+    const float expectedSquaredValue = sumValuesSquared / static_cast< float >( numSamplesOk );
+    measure += expectedSquaredValue - expectedValue * expectedValue;
+
+    for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
+    {
+      if( MTOk[ first + d ] )
       {
-        const unsigned int startc = numParametersPerLastDimension * t;
-        for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
-        {
-          const unsigned int index = c % numParametersPerLastDimension;
-          mean[ index ] += derivative[ c ];
-        }
+        DerivativeTermType term;
+        term.m_FixedPoint            = fixedPoints[ first + d ];
+        term.m_MovingImageDerivative = dMTdx[ first + d ];
+        term.m_Weight                = ( 2.0 * ( MT[ first + d ] - expectedValue ) )
+          / static_cast< float >( numSamplesOk );
+        derivativeTerms[ lastDimPositions[ d ] ].push_back( term );
       }
-      mean /= static_cast< double >( lastDimSize );
+    }
+  }
+
+  /** Check if enough samples were valid. */
+  this->CheckNumberOfSamples( numberOfSamples, this->m_NumberOfPixelsCounted );
+
+  /** Second phase: the terms of a position only affect the parameters of its
+   * sub transform, so the positions write their own blocks of the derivative
+   * in parallel, without per-thread derivatives.
+   */
+  derivative = DerivativeType( this->GetNumberOfParameters() );
+  derivative.Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  this->ProcessSlices( lastDimSize, true,
+    [ this, &derivativeTerms, &derivative ]( const unsigned int slice )
+    {
+      this->AddDerivativeTerms( derivativeTerms[ slice ], derivative );
+    } );
+
+  /** Compute average over variances and normalize with initial variance. */
+  value       = measure / static_cast< float >( this->m_NumberOfPixelsCounted * this->m_InitialVariance );
+  derivative /= static_cast< float >( this->m_NumberOfPixelsCounted * this->m_InitialVariance );
+
+  /** Subtract mean from derivative elements. */
+  if( this->m_SubtractMean )
+  {
+    this->SubtractMeanFromDerivative( derivative );
+  }
+
+} // end GetValueAndDerivativeOfStack()
+
+
+/**
+ * ******************* ThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::ThreadedGetValueAndDerivative( ThreadIdType threadId )
+{
+  /** Get the pre-allocated arrays that store dM(x)/dmu, and the sparse Jacobian indices. */
+  typename Superclass::ScratchArenaStruct & arena = this->GetScratchArena( threadId );
+  NonZeroJacobianIndicesType & nzji          = arena.sa_NonZeroJacobianIndices;
+  DerivativeType &             imageJacobian = arena.sa_ImageJacobian;
+
+  /** Get a handle to the pre-allocated derivative for the current thread.
+   * The initialization is performed at the beginning of each resolution in
+   * InitializeThreadingParameters(), and at the end of each iteration in
+   * the accumulate functions.
+   */
+  DerivativeType & derivative = this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Derivative;
+
+  /** Get a handle to the sample container. */
+  ImageSampleContainerPointer sampleContainer     = this->GetImageSampler()->GetOutput();
+  const unsigned long         sampleContainerSize = sampleContainer->Size();
+
+  /** Get the samples for this thread. */
+  const unsigned long nrOfSamplesPerThreads
+    = static_cast< unsigned long >( std::ceil( static_cast< double >( sampleContainerSize )
+    / static_cast< double >( Self::GetNumberOfReductionChunks() ) ) );
+
+  unsigned long pos_begin = nrOfSamplesPerThreads * threadId;
+  unsigned long pos_end   = nrOfSamplesPerThreads * ( threadId + 1 );
+  pos_begin = ( pos_begin > sampleContainerSize ) ? sampleContainerSize : pos_begin;
+  pos_end   = ( pos_end > sampleContainerSize ) ? sampleContainerSize : pos_end;
+
+  /** Retrieve slowest varying dimension and the positions per sample. */
+  const unsigned int lastDim                 = this->GetFixedImage()->GetImageDimension() - 1;
+  const unsigned int realNumLastDimPositions = this->GetNumberOfLastDimensionPositions();
+  const unsigned int positionsStride         = this->m_SampleLastDimensionRandomly ? realNumLastDimPositions : 0;
+
+  /** Variables to store the values, gradients and points of a sample. */
+  std::vector< RealType >                  MT( realNumLastDimPositions );
+  std::vector< MovingImageDerivativeType > dMTdx( realNumLastDimPositions );
+  std::vector< FixedImagePointType >       fixedPoints( realNumLastDimPositions );
+  std::vector< MovingImagePointType >      mappedPoints( realNumLastDimPositions );
+  std::unique_ptr< bool[] >                MTOk( new bool[ realNumLastDimPositions ] );
+
+  /** Create variables to store intermediate results. circumvent false sharing */
+  unsigned long numberOfPixelsCounted = 0;
+  MeasureType   measure               = NumericTraits< MeasureType >::Zero;
+
+  /** Loop over the fixed image samples to calculate the variance over time for every sample position. */
+  for( unsigned long sampleIndex = pos_begin; sampleIndex < pos_end; ++sampleIndex )
+  {
+    /** Read fixed coordinates. */
+    const FixedImagePointType & fixedPoint = sampleContainer->ElementAt( sampleIndex ).m_ImageCoordinates;
+    const int *                 lastDimPositions
+      = this->m_LastDimensionPositions.data() + sampleIndex * positionsStride;
+
+    /** Transform sampled point to voxel coordinates. */
+    FixedImageContinuousIndexType voxelCoord;
+    this->GetFixedImage()->TransformPhysicalPointToContinuousIndex( fixedPoint, voxelCoord );
+
+    /** Set the last dimension of the point to each of the positions, and
+     * transform the points back to world coordinates.
+     */
+    for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
+    {
+      voxelCoord[ lastDim ] = lastDimPositions[ d ];
+      this->GetFixedImage()->TransformContinuousIndexToPhysicalPoint( voxelCoord, fixedPoints[ d ] );
+    }
+
+    /** First loop over t: compute M(T(x,t)) and dM(T(x,t))/dx of all
+     * positions in one batch, and store.
+     */
+    this->TransformMovingImageBatch( fixedPoints.data(), mappedPoints.data(), MTOk.get(), realNumLastDimPositions );
+    this->EvaluateMovingImageValuesAndDerivatives( mappedPoints.data(),
+      MT.data(), dMTdx.data(), MTOk.get(), realNumLastDimPositions );
 
-      /** Update derivative per control point. */
-      for( unsigned int t = 0; t < lastDimSize; ++t )
+    /** Loop over the slowest varying dimension. */
+    float        sumValues        = 0.0;
+    float        sumValuesSquared = 0.0;
+    unsigned int numSamplesOk     = 0;
+    for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
+    {
+      if( MTOk[ d ] )
       {
-        const unsigned int startc = numParametersPerLastDimension * t;
-        for( unsigned int c = startc; c < startc + numParametersPerLastDimension; ++c )
+        /** Update value terms **/
+        numSamplesOk++;
+        sumValues        += MT[ d ];
+        sumValuesSquared += MT[ d ] * MT[ d ];
+      } // end if sampleOk
+    }
+
+    if( numSamplesOk > 0 )
+    {
+      numberOfPixelsCounted++;
+
+      /** Compute average intensity value. */
+      const float expectedValue = sumValues / static_cast< float >( numSamplesOk );
+      /** Add this variance to the variance sum. */
+      const float expectedSquaredValue = sumValuesSquared / static_cast< float >( numSamplesOk );
+      measure += expectedSquaredValue - expectedValue * expectedValue;
+
+      /** Second loop over t: add the derivative terms
+       * 2 ( M(T(x,t)) - E ) / n * dM/dx^T dT/dmu.
+       */
+      for( unsigned int d = 0; d < realNumLastDimPositions; ++d )
+      {
+        if( !MTOk[ d ] )
+        {
+          continue;
+        }
+
+        /** Compute the innerproduct (dM/dx)^T (dT/dmu). */
+        this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+          fixedPoints[ d ], dMTdx[ d ], imageJacobian, nzji );
+
+        const DerivativeValueType weight = ( 2.0 * ( MT[ d ] - expectedValue ) )
+          / static_cast< float >( numSamplesOk );
+        if( this->m_UseSparseDerivativeAccumulation )
         {
-          const unsigned int index = c % numParametersPerLastDimension;
-          derivative[ c ] -= mean[ index ];
+          this->AddSparseDerivativeTerms( threadId, imageJacobian, nzji, weight );
+        }
+        else
+        {
+          for( unsigned int j = 0; j < nzji.size(); ++j )
+          {
+            derivative[ nzji[ j ] ] += weight * imageJacobian[ j ];
+          }
         }
       }
     }
-  }
+  } // end for loop over the image sample container
 
-  /** Return the measure value. */
-  value = measure;
+  /** Only update these variables at the end to prevent unnecessary "false sharing". */
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_NumberOfPixelsCounted = numberOfPixelsCounted;
+  this->m_GetValueAndDerivativePerThreadVariables[ threadId ].st_Value                 = measure;
 
-} // end GetValueAndDerivative()
+} // end ThreadedGetValueAndDerivative()
+
+
+/**
+ * ******************* AfterThreadedGetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+VarianceOverLastDimensionImageMetric< TFixedImage, TMovingImage >
+::AfterThreadedGetValueAndDerivative(
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  /** Accumulate the number of pixels and the values, and normalize. */
+  this->AfterThreadedGetValue( value );
+
+  /** Accumulate the derivatives of the threads, with the same normalization
+   * as the value: the number of samples times the initial variance.
+   */
+  this->m_ThreaderMetricParameters.st_DerivativePointer   = derivative.begin();
+  this->m_ThreaderMetricParameters.st_NormalizationFactor
+    = static_cast< float >( this->m_NumberOfPixelsCounted * this->m_InitialVariance );
+
+  this->LaunchThreaderCallback( this->AccumulateDerivativesThreaderCallback,
+    const_cast< void * >( static_cast< const void * >( &this->m_ThreaderMetricParameters ) ) );
+
+  /** Subtract mean from derivative elements. */
+  if( this->m_SubtractMean )
+  {
+    this->SubtractMeanFromDerivative( derivative );
+  }
+
+} // end AfterThreadedGetValueAndDerivative()
 
 
 } // end namespace itk
@@ -19,30 +19,27 @@
 #define __elxViolaWellsMutualInformationMetric_H__
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
-#include "itkMutualInformationImageToImageMetric.h"
+#include "itkViolaWellsMutualInformationImageToImageMetric.h"
 
 namespace elastix
 {
 
 /**
  * \class ViolaWellsMutualInformationMetric
- * \brief A metric based on the itk::MutualInformationImageToImageMetric.
+ * \brief A metric based on the itk::ViolaWellsMutualInformationImageToImageMetric.
+ *
+ * The mutual information is estimated from two sets of samples, which are
+ * the first and the second half of the samples of the ImageSampler. The
+ * metric returns minus the mutual information, so it is minimized.
  *
  * \warning: this metric is not very well tested in elastix.
- * \warning: this metric is not based on the AdvancedImageToImageMetric so
- * does not support the ImageSampler framework and might be very slow in
- * combination with B-spline transform.
- * \warning: this metric uses stochastic sampling of the images. Do not use
+ * \warning: this metric is meant for stochastic sampling of the images. Do not use
  * a quasi-Newton optimizer or a conjugate gradient. The StandardGradientDescent
  * is a better choice.
  *
  * The parameters used in this class are:
  * \parameter Metric: Select this metric as follows:\n
  *    <tt>(Metric "ViolaWellsMutualInformation")</tt>
- * \parameter NumberOfSpatialSamples: for each resolution the number of samples
- *    used to calculate this metrics value and its derivative. \n
- *    example: <tt>(NumberOfSpatialSamples 5000 5000 10000)</tt> \n
- *    The default is 10000 for each resolution.
  * \parameter FixedImageStandardDeviation: for each resolution the standard
  *    deviation of the fixed image. \n
  *    example: <tt>(FixedImageStandardDeviation 1.3 1.9 1.0)</tt> \n
@@ -51,15 +48,23 @@ namespace elastix
  *    deviation of the moving image. \n
  *    example: <tt>(MovingImageStandardDeviation 1.3 1.9 1.0)</tt> \n
  *    The default is 0.4 for each resolution.
+ * \parameter KernelTruncationRadius: for each resolution the number of standard
+ *    deviations beyond which the Gaussian contributions of the samples are neglected.
+ *    Zero or less evaluates all pairs of samples. \n
+ *    example: <tt>(KernelTruncationRadius 6.0 6.0 8.0)</tt> \n
+ *    The default is 6.0 for each resolution.
+ *
+ * The number of samples is set with the parameters of the ImageSampler, e.g.
+ * NumberOfSpatialSamples for the Random sampler.
  *
- * \sa MutualInformationImageToImageMetric
+ * \sa ViolaWellsMutualInformationImageToImageMetric
  * \ingroup Metrics
  */
 
 template< class TElastix >
 class ViolaWellsMutualInformationMetric :
   public
-  itk::MutualInformationImageToImageMetric<
+  itk::ViolaWellsMutualInformationImageToImageMetric<
   typename MetricBase< TElastix >::FixedImageType,
   typename MetricBase< TElastix >::MovingImageType >,
   public MetricBase< TElastix >
@@ -68,7 +73,7 @@ public:
 
   /** Standard ITK-stuff. */
   typedef ViolaWellsMutualInformationMetric Self;
-  typedef itk::MutualInformationImageToImageMetric<
+  typedef itk::ViolaWellsMutualInformationImageToImageMetric<
     typename MetricBase< TElastix >::FixedImageType,
     typename MetricBase< TElastix >::MovingImageType >    Superclass1;
   typedef MetricBase< TElastix >          Superclass2;
@@ -80,7 +85,7 @@ public:
 
   /** Run-time type information (and related methods). */
   itkTypeMacro( ViolaWellsMutualInformationMetric,
-    itk::MutualInformationImageToImageMetric );
+    itk::ViolaWellsMutualInformationImageToImageMetric );
 
   /** Name of this class.
    * Use this name in the parameter file to select this specific metric. \n
@@ -89,22 +94,17 @@ public:
   elxClassNameMacro( "ViolaWellsMutualInformation" );
 
   /** Typedefs inherited from the superclass. */
-  typedef typename Superclass1::TransformType            TransformType;
-  typedef typename Superclass1::TransformPointer         TransformPointer;
-  typedef typename Superclass1::TransformJacobianType    TransformJacobianType;
-  typedef typename Superclass1::InterpolatorType         InterpolatorType;
-  typedef typename Superclass1::MeasureType              MeasureType;
-  typedef typename Superclass1::DerivativeType           DerivativeType;
-  typedef typename Superclass1::ParametersType           ParametersType;
-  typedef typename Superclass1::FixedImageType           FixedImageType;
-  typedef typename Superclass1::MovingImageType          MovingImageType;
-  typedef typename Superclass1::FixedImageConstPointer   FixedImageConstPointer;
-  typedef typename Superclass1::MovingImageConstPointer  MovingImageCosntPointer;
-  typedef typename Superclass1::FixedImageIndexType      FixedImageIndexType;
-  typedef typename Superclass1::FixedImageIndexValueType FixedImageIndexValueType;
-  typedef typename Superclass1::MovingImageIndexType     MovingImageIndexType;
-  typedef typename Superclass1::FixedImagePointType      FixedImagePointType;
-  typedef typename Superclass1::MovingImagePointType     MovingImagePointType;
+  typedef typename Superclass1::TransformType           TransformType;
+  typedef typename Superclass1::TransformPointer        TransformPointer;
+  typedef typename Superclass1::TransformJacobianType   TransformJacobianType;
+  typedef typename Superclass1::InterpolatorType        InterpolatorType;
+  typedef typename Superclass1::MeasureType             MeasureType;
+  typedef typename Superclass1::DerivativeType          DerivativeType;
+  typedef typename Superclass1::ParametersType          ParametersType;
+  typedef typename Superclass1::FixedImageType          FixedImageType;
+  typedef typename Superclass1::MovingImageType         MovingImageType;
+  typedef typename Superclass1::FixedImageConstPointer  FixedImageConstPointer;
+  typedef typename Superclass1::MovingImageConstPointer MovingImageConstPointer;
 
   /** The moving image dimension. */
   itkStaticConstMacro( MovingImageDimension, unsigned int,
@@ -120,9 +120,9 @@ public:
   typedef typename Superclass2::ITKBaseType          ITKBaseType;
 
   /** Execute stuff before each new pyramid resolution:
-   * \li Set the number of spatial samples.
    * \li Set the standard deviation of the fixed image.
    * \li Set the standard deviation of the moving image.
+   * \li Set the kernel truncation radius.
    */
   void BeforeEachResolution( void ) override;
 
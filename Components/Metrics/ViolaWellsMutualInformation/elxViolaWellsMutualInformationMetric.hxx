@@ -65,9 +65,6 @@ ViolaWellsMutualInformationMetric< TElastix >
   unsigned int level
     = ( this->m_Registration->GetAsITKBaseType() )->GetCurrentLevel();
 
-  /** Set the number of histogram bins and spatial samples. */
-  unsigned int numberOfSpatialSamples = 10000;
-
   /** Set the intensity standard deviation of the fixed
    * and moving images. This defines the kernel bandwidth
    * used in the joint probability distribution calculation.
@@ -79,18 +76,21 @@ ViolaWellsMutualInformationMetric< TElastix >
   double movingImageStandardDeviation = 0.4;
   /** \todo calculate them??? */
 
+  /** The number of standard deviations beyond which the Gaussians are neglected. */
+  double kernelTruncationRadius = 6.0;
+
   /** Read the parameters from the ParameterFile. */
-  this->m_Configuration->ReadParameter( numberOfSpatialSamples,
-    "NumberOfSpatialSamples", this->GetComponentLabel(), level, 0 );
   this->m_Configuration->ReadParameter( fixedImageStandardDeviation,
     "FixedImageStandardDeviation", this->GetComponentLabel(), level, 0 );
   this->m_Configuration->ReadParameter( movingImageStandardDeviation,
     "MovingImageStandardDeviation", this->GetComponentLabel(), level, 0 );
+  this->m_Configuration->ReadParameter( kernelTruncationRadius,
+    "KernelTruncationRadius", this->GetComponentLabel(), level, 0 );
 
   /** Set them. */
-  this->SetNumberOfSpatialSamples( numberOfSpatialSamples );
   this->SetFixedImageStandardDeviation( fixedImageStandardDeviation );
   this->SetMovingImageStandardDeviation( movingImageStandardDeviation );
+  this->SetKernelTruncationRadius( kernelTruncationRadius );
 
 } // end BeforeEachResolution()
 
@@ -0,0 +1,224 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkViolaWellsMutualInformationImageToImageMetric_h
+#define __itkViolaWellsMutualInformationImageToImageMetric_h
+
+#include "itkAdvancedImageToImageMetric.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class ViolaWellsMutualInformationImageToImageMetric
+ * \brief Computes the mutual information of Viola and Wells, based on the
+ * AdvancedImageToImageMetric.
+ *
+ * The marginal and joint densities of the fixed and moving image values are
+ * estimated with Gaussian Parzen windows on a sample set A. The entropies are
+ * the averages of the logarithms of these densities over an independent
+ * sample set B [1]. The first half of the samples of the image sampler is set
+ * A, and the second half is set B. A random sampler thus draws two independent
+ * sets, and new sets every iteration if NewSamplesEveryIteration is true.
+ *
+ * Contrary to itk::MutualInformationImageToImageMetric, this metric returns
+ * minus the mutual information, so that it is minimized, like the other
+ * elastix metrics. It uses the ImageSampler framework, the moving image
+ * derivatives of the B-spline interpolator and the sparse Jacobians of the
+ * advanced transforms.
+ *
+ * The N_A x N_B kernel evaluations are split over the threads in chunks of
+ * samples of set B. The samples of set A are sorted on their moving image
+ * value, so that for a sample of set B only the samples of set A
+ * within KernelTruncationRadius standard deviations are visited, in a
+ * contiguous block. The Gaussians of the other samples are negligible.
+ *
+ * [1] P. Viola and W.M. Wells III, "Alignment by Maximization of Mutual
+ *     Information", International Journal of Computer Vision,
+ *     24(2):137-154, 1997.
+ *
+ * \ingroup RegistrationMetrics
+ * \ingroup Metrics
+ */
+
+template< class TFixedImage, class TMovingImage >
+class ViolaWellsMutualInformationImageToImageMetric :
+  public AdvancedImageToImageMetric< TFixedImage, TMovingImage >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef ViolaWellsMutualInformationImageToImageMetric Self;
+  typedef AdvancedImageToImageMetric<
+    TFixedImage, TMovingImage >                         Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ViolaWellsMutualInformationImageToImageMetric, AdvancedImageToImageMetric );
+
+  /** Typedefs from the superclass. */
+  typedef typename
+    Superclass::CoordinateRepresentationType CoordinateRepresentationType;
+  typedef typename Superclass::MovingImageType            MovingImageType;
+  typedef typename Superclass::MovingImagePixelType       MovingImagePixelType;
+  typedef typename Superclass::MovingImageConstPointer    MovingImageConstPointer;
+  typedef typename Superclass::FixedImageType             FixedImageType;
+  typedef typename Superclass::FixedImageConstPointer     FixedImageConstPointer;
+  typedef typename Superclass::FixedImageRegionType       FixedImageRegionType;
+  typedef typename Superclass::TransformType              TransformType;
+  typedef typename Superclass::TransformPointer           TransformPointer;
+  typedef typename Superclass::InputPointType             InputPointType;
+  typedef typename Superclass::OutputPointType            OutputPointType;
+  typedef typename Superclass::TransformParametersType    TransformParametersType;
+  typedef typename Superclass::TransformJacobianType      TransformJacobianType;
+  typedef typename Superclass::InterpolatorType           InterpolatorType;
+  typedef typename Superclass::InterpolatorPointer        InterpolatorPointer;
+  typedef typename Superclass::RealType                   RealType;
+  typedef typename Superclass::GradientPixelType          GradientPixelType;
+  typedef typename Superclass::GradientImageType          GradientImageType;
+  typedef typename Superclass::GradientImagePointer       GradientImagePointer;
+  typedef typename Superclass::GradientImageFilterType    GradientImageFilterType;
+  typedef typename Superclass::GradientImageFilterPointer GradientImageFilterPointer;
+  typedef typename Superclass::FixedImageMaskType         FixedImageMaskType;
+  typedef typename Superclass::FixedImageMaskPointer      FixedImageMaskPointer;
+  typedef typename Superclass::MovingImageMaskType        MovingImageMaskType;
+  typedef typename Superclass::MovingImageMaskPointer     MovingImageMaskPointer;
+  typedef typename Superclass::MeasureType                MeasureType;
+  typedef typename Superclass::DerivativeType             DerivativeType;
+  typedef typename Superclass::DerivativeValueType        DerivativeValueType;
+  typedef typename Superclass::ParametersType             ParametersType;
+  typedef typename Superclass::FixedImagePixelType        FixedImagePixelType;
+  typedef typename Superclass::MovingImageRegionType      MovingImageRegionType;
+  typedef typename Superclass::ImageSamplerType           ImageSamplerType;
+  typedef typename Superclass::ImageSamplerPointer        ImageSamplerPointer;
+  typedef typename Superclass::ImageSampleContainerType   ImageSampleContainerType;
+  typedef typename
+    Superclass::ImageSampleContainerPointer ImageSampleContainerPointer;
+  typedef typename Superclass::FixedImageLimiterType  FixedImageLimiterType;
+  typedef typename Superclass::MovingImageLimiterType MovingImageLimiterType;
+  typedef typename
+    Superclass::FixedImageLimiterOutputType FixedImageLimiterOutputType;
+  typedef typename
+    Superclass::MovingImageLimiterOutputType MovingImageLimiterOutputType;
+  typedef typename
+    Superclass::MovingImageDerivativeScalesType MovingImageDerivativeScalesType;
+
+  /** The fixed image dimension. */
+  itkStaticConstMacro( FixedImageDimension, unsigned int,
+    FixedImageType::ImageDimension );
+
+  /** The moving image dimension. */
+  itkStaticConstMacro( MovingImageDimension, unsigned int,
+    MovingImageType::ImageDimension );
+
+  /** Get the value for single valued optimizers. */
+  MeasureType GetValue( const TransformParametersType & parameters ) const override;
+
+  /** Get the derivatives of the match measure. */
+  void GetDerivative( const TransformParametersType & parameters,
+    DerivativeType & derivative ) const override;
+
+  /** Get the value and derivatives for single valued optimizers. */
+  void GetValueAndDerivative( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const override;
+
+  /** Initialize the Metric by making sure that all the components
+   *  are present and plugged together correctly.
+   * \li Call the superclass' implementation
+   * \li Check the standard deviations.
+   */
+  void Initialize( void ) override;
+
+  /** Set/Get the standard deviation of the Parzen window of the fixed image
+   * values. The default is 0.4, which works well for image intensities
+   * normalized to a mean of 0 and a standard deviation of 1.
+   */
+  itkSetMacro( FixedImageStandardDeviation, double );
+  itkGetConstMacro( FixedImageStandardDeviation, double );
+
+  /** Set/Get the standard deviation of the Parzen window of the moving image
+   * values. The default is 0.4.
+   */
+  itkSetMacro( MovingImageStandardDeviation, double );
+  itkGetConstMacro( MovingImageStandardDeviation, double );
+
+  /** Set/Get the probability that is added to the densities, to avoid the
+   * logarithm of zero. The default is 0.0001.
+   */
+  itkSetMacro( MinProbability, double );
+  itkGetConstMacro( MinProbability, double );
+
+  /** Set/Get the number of standard deviations beyond which the Gaussian
+   * contributions of the samples are neglected. At 6 standard deviations a
+   * contribution is about 6e-9, well below the MinProbability. A value of
+   * zero or less evaluates all N_A x N_B pairs. The default is 6.
+   */
+  itkSetMacro( KernelTruncationRadius, double );
+  itkGetConstMacro( KernelTruncationRadius, double );
+
+protected:
+
+  ViolaWellsMutualInformationImageToImageMetric();
+  ~ViolaWellsMutualInformationImageToImageMetric() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** Protected Typedefs ******************/
+
+  /** Typedefs inherited from superclass */
+  typedef typename Superclass::FixedImagePointType        FixedImagePointType;
+  typedef typename Superclass::MovingImagePointType       MovingImagePointType;
+  typedef typename Superclass::MovingImageDerivativeType  MovingImageDerivativeType;
+  typedef typename Superclass::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+
+  /** Compute the value, and the derivative if it is not null. Called by
+   * GetValue(), GetDerivative() and GetValueAndDerivative().
+   */
+  void ComputeValueAndDerivative( const TransformParametersType & parameters,
+    MeasureType & value, DerivativeType * derivative ) const;
+
+private:
+
+  ViolaWellsMutualInformationImageToImageMetric( const Self & ); // purposely not implemented
+  void operator=( const Self & );                                // purposely not implemented
+
+  /** Get the range [begin, end) of the sorted values within the truncation
+   * radius of the given value, for the given standard deviation.
+   */
+  void GetKernelWindow( const std::vector< double > & sortedValues,
+    const double value, const double standardDeviation,
+    SizeValueType & begin, SizeValueType & end ) const;
+
+  double m_FixedImageStandardDeviation;
+  double m_MovingImageStandardDeviation;
+  double m_MinProbability;
+  double m_KernelTruncationRadius;
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkViolaWellsMutualInformationImageToImageMetric.hxx"
+#endif
+
+#endif // end #ifndef __itkViolaWellsMutualInformationImageToImageMetric_h
@@ -0,0 +1,459 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkViolaWellsMutualInformationImageToImageMetric_hxx
+#define __itkViolaWellsMutualInformationImageToImageMetric_hxx
+
+#include "itkViolaWellsMutualInformationImageToImageMetric.h"
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace itk
+{
+
+/**
+ * ******************* Constructor *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ViolaWellsMutualInformationImageToImageMetric()
+{
+  this->SetUseImageSampler( true );
+
+  this->m_FixedImageStandardDeviation  = 0.4;
+  this->m_MovingImageStandardDeviation = 0.4;
+  this->m_MinProbability               = 0.0001;
+  this->m_KernelTruncationRadius       = 6.0;
+
+} // end Constructor()
+
+
+/**
+ * ******************* Initialize *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::Initialize( void )
+{
+  /** Initialize transform, interpolator, etc. */
+  Superclass::Initialize();
+
+  if( !( this->m_FixedImageStandardDeviation > 0.0 )
+    || !( this->m_MovingImageStandardDeviation > 0.0 ) )
+  {
+    itkExceptionMacro( << "The fixed and moving image standard deviations must be positive." );
+  }
+  if( !( this->m_MinProbability > 0.0 ) )
+  {
+    itkExceptionMacro( << "The MinProbability must be positive." );
+  }
+
+} // end Initialize()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+  os << indent << "FixedImageStandardDeviation: " << this->m_FixedImageStandardDeviation << std::endl;
+  os << indent << "MovingImageStandardDeviation: " << this->m_MovingImageStandardDeviation << std::endl;
+  os << indent << "MinProbability: " << this->m_MinProbability << std::endl;
+  os << indent << "KernelTruncationRadius: " << this->m_KernelTruncationRadius << std::endl;
+
+} // end PrintSelf()
+
+
+/**
+ * ******************* GetValue *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+typename ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >::MeasureType
+ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValue( const TransformParametersType & parameters ) const
+{
+  MeasureType value = NumericTraits< MeasureType >::Zero;
+  this->ComputeValueAndDerivative( parameters, value, nullptr );
+  return value;
+
+} // end GetValue()
+
+
+/**
+ * ******************* GetDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GetDerivative( const TransformParametersType & parameters,
+  DerivativeType & derivative ) const
+{
+  /** When the derivative is calculated, all information for calculating
+   * the metric value is available. It does not cost anything to calculate
+   * the metric value now. Therefore, we have chosen to only implement the
+   * GetValueAndDerivative(), supplying it with a dummy value variable.
+   */
+  MeasureType dummyvalue = NumericTraits< MeasureType >::Zero;
+  this->ComputeValueAndDerivative( parameters, dummyvalue, &derivative );
+
+} // end GetDerivative()
+
+
+/**
+ * ******************* GetValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValueAndDerivative( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType & derivative ) const
+{
+  this->ComputeValueAndDerivative( parameters, value, &derivative );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ******************* GetKernelWindow *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::GetKernelWindow( const std::vector< double > & sortedValues,
+  const double value, const double standardDeviation,
+  SizeValueType & begin, SizeValueType & end ) const
+{
+  if( !( this->m_KernelTruncationRadius > 0.0 ) )
+  {
+    begin = 0;
+    end   = sortedValues.size();
+    return;
+  }
+
+  const double radius = this->m_KernelTruncationRadius * standardDeviation;
+  begin = std::lower_bound( sortedValues.begin(), sortedValues.end(), value - radius )
+    - sortedValues.begin();
+  end = std::upper_bound( sortedValues.begin() + begin, sortedValues.end(), value + radius )
+    - sortedValues.begin();
+
+} // end GetKernelWindow()
+
+
+/**
+ * ******************* ComputeValueAndDerivative *******************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ViolaWellsMutualInformationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeValueAndDerivative( const TransformParametersType & parameters,
+  MeasureType & value, DerivativeType * derivative ) const
+{
+  itkDebugMacro( "ComputeValueAndDerivative( " << parameters << " ) " );
+
+  const bool doDerivative = derivative != nullptr;
+
+  /** Call non-thread-safe stuff, such as:
+   *   this->SetTransformParameters( parameters );
+   *   this->GetImageSampler()->Update();
+   * Because of these calls GetValueAndDerivative itself is not thread-safe,
+   * so cannot be called multiple times simultaneously.
+   * This is however needed in the CombinationImageToImageMetric.
+   * In that case, you need to:
+   * - switch the use of this function to on, using m_UseMetricSingleThreaded = true
+   * - call BeforeThreadedGetValueAndDerivative once (single-threaded) before
+   *   calling GetValueAndDerivative
+   * - switch the use of this function to off, using m_UseMetricSingleThreaded = false
+   * - Now you can call GetValueAndDerivative multi-threaded.
+   */
+  this->BeforeThreadedGetValueAndDerivative( parameters );
+
+  /** Get a handle to the sample container. */
+  const ImageSampleContainerType * sampleContainer  = this->GetImageSampler()->GetOutput();
+  const SizeValueType              numberOfSamples  = sampleContainer->Size();
+  const SizeValueType              numberOfSamplesA = numberOfSamples / 2;
+  const SizeValueType              numberOfJacobianIndices
+    = this->m_AdvancedTransform->GetNumberOfNonZeroJacobianIndices();
+
+  /** Map the samples, and compute their moving image values and the inner
+   * products of the moving image gradient and the transform Jacobian, in a
+   * chunk of samples per work unit.
+   */
+  std::vector< double >                     fixedValues( numberOfSamples );
+  std::vector< double >                     movingValues( numberOfSamples );
+  std::vector< unsigned char >              sampleOk( numberOfSamples, 0 );
+  std::vector< double >                     imageJacobians( doDerivative ? numberOfSamples * numberOfJacobianIndices : 0 );
+  std::vector< NonZeroJacobianIndicesType > nzjis( doDerivative ? numberOfSamples : 0,
+    NonZeroJacobianIndicesType( numberOfJacobianIndices ) );
+  const unsigned int  numberOfChunks  = Self::GetNumberOfReductionChunks();
+  const SizeValueType sampleChunkSize = ( numberOfSamples + numberOfChunks - 1 ) / numberOfChunks;
+  this->ProcessSlices( numberOfChunks, true, [&]( const unsigned int chunk )
+    {
+      const SizeValueType chunkBegin = std::min( chunk * sampleChunkSize, numberOfSamples );
+      const SizeValueType chunkEnd   = std::min( chunkBegin + sampleChunkSize, numberOfSamples );
+      DerivativeType      imageJacobian( numberOfJacobianIndices );
+
+      /** The samples are transformed and interpolated per block. */
+      const unsigned int        batchSize = Superclass::MovingImageBatchSize;
+      FixedImagePointType       fixedPoints[ batchSize ];
+      RealType                  fixedImageValues[ batchSize ];
+      MovingImagePointType      mappedPoints[ batchSize ];
+      bool                      blockOk[ batchSize ];
+      RealType                  movingImageValues[ batchSize ];
+      MovingImageDerivativeType movingImageDerivatives[ batchSize ];
+
+      for( SizeValueType blockBegin = chunkBegin; blockBegin < chunkEnd; blockBegin += batchSize )
+      {
+        const unsigned int blockSize = static_cast< unsigned int >(
+          std::min< SizeValueType >( chunkEnd - blockBegin, batchSize ) );
+
+        /** Transform the points, check if they are inside the mask, and
+         * compute the moving image values M(T(x)) and derivatives dM/dx and
+         * check if the points are inside the moving image buffer.
+         */
+        this->GetFixedImageSamples( blockBegin, blockSize, fixedPoints, fixedImageValues );
+        this->TransformMovingImageBatch( fixedPoints, mappedPoints, blockOk, blockSize, blockBegin );
+        this->EvaluateMovingImageValuesAndDerivatives( mappedPoints,
+          movingImageValues, doDerivative ? movingImageDerivatives : 0, blockOk, blockSize );
+
+        for( unsigned int b = 0; b < blockSize; ++b )
+        {
+          if( !blockOk[ b ] )
+          {
+            continue;
+          }
+
+          const SizeValueType i = blockBegin + b;
+          sampleOk[ i ]     = 1;
+          fixedValues[ i ]  = static_cast< double >( fixedImageValues[ b ] );
+          movingValues[ i ] = static_cast< double >( movingImageValues[ b ] );
+          if( doDerivative )
+          {
+            /** Compute the inner product of the transform Jacobian and the moving image gradient. */
+            this->m_AdvancedTransform->EvaluateJacobianWithImageGradientProduct(
+              fixedPoints[ b ], movingImageDerivatives[ b ], imageJacobian, nzjis[ i ] );
+            std::copy( imageJacobian.begin(), imageJacobian.end(),
+              imageJacobians.begin() + i * numberOfJacobianIndices );
+          }
+        }
+      }
+    } );
+
+  /** Collect the valid samples of both sets, and sort set A on the moving
+   * image values. The fixed image values of set A are also sorted
+   * separately, for the fixed marginal density.
+   */
+  std::vector< SizeValueType > samplesA;
+  std::vector< SizeValueType > samplesB;
+  for( SizeValueType i = 0; i < numberOfSamples; ++i )
+  {
+    if( sampleOk[ i ] )
+    {
+      ( i < numberOfSamplesA ? samplesA : samplesB ).push_back( i );
+    }
+  }
+  this->CheckNumberOfSamples( numberOfSamples, samplesA.size() + samplesB.size() );
+  if( samplesA.empty() || samplesB.empty() )
+  {
+    itkExceptionMacro( << "Both halves of the samples should contain valid samples." );
+  }
+
+  std::sort( samplesA.begin(), samplesA.end(),
+    [&movingValues]( const SizeValueType i, const SizeValueType j )
+    {
+      return movingValues[ i ] < movingValues[ j ];
+    } );
+  const SizeValueType   numberOfValidA = samplesA.size();
+  const SizeValueType   numberOfValidB = samplesB.size();
+  std::vector< double > sortedMovingA( numberOfValidA );
+  std::vector< double > fixedA( numberOfValidA );
+  for( SizeValueType k = 0; k < numberOfValidA; ++k )
+  {
+    sortedMovingA[ k ] = movingValues[ samplesA[ k ] ];
+    fixedA[ k ]        = fixedValues[ samplesA[ k ] ];
+  }
+  std::vector< double > sortedFixedA( fixedA );
+  std::sort( sortedFixedA.begin(), sortedFixedA.end() );
+
+  /** Evaluate the Parzen windows in a chunk of samples of set B per work
+   * unit. Each chunk sums its own logarithms and derivative weights of the
+   * samples of set A, which are added in a fixed order afterwards.
+   */
+  const double          fixedFactor    = 1.0 / this->m_FixedImageStandardDeviation;
+  const double          movingFactor   = 1.0 / this->m_MovingImageStandardDeviation;
+  const double          gaussianFactor = 1.0 / std::sqrt( 2.0 * vnl_math::pi );
+  const double          minProbability = this->m_MinProbability;
+  const SizeValueType   setBChunkSize  = ( numberOfValidB + numberOfChunks - 1 ) / numberOfChunks;
+  std::vector< double > logSums( 3 * numberOfChunks, 0.0 );
+  std::vector< double > weightsB( doDerivative ? numberOfValidB : 0 );
+  std::vector< double > chunkWeightsA( doDerivative ? numberOfChunks * numberOfValidA : 0 );
+  this->ProcessSlices( numberOfChunks, true, [&]( const unsigned int chunk )
+    {
+      const SizeValueType   chunkBegin = std::min( chunk * setBChunkSize, numberOfValidB );
+      const SizeValueType   chunkEnd   = std::min( chunkBegin + setBChunkSize, numberOfValidB );
+      double *              weightsA   = doDerivative ? &chunkWeightsA[ chunk * numberOfValidA ] : nullptr;
+      std::vector< double > movingKernels( numberOfValidA );
+      std::vector< double > jointKernels( numberOfValidA );
+      double                logSumFixed  = 0.0;
+      double                logSumMoving = 0.0;
+      double                logSumJoint  = 0.0;
+      for( SizeValueType j = chunkBegin; j < chunkEnd; ++j )
+      {
+        const double fixedValueB  = fixedValues[ samplesB[ j ] ];
+        const double movingValueB = movingValues[ samplesB[ j ] ];
+
+        /** The fixed marginal density. */
+        SizeValueType begin = 0;
+        SizeValueType end   = 0;
+        this->GetKernelWindow( sortedFixedA, fixedValueB,
+          this->m_FixedImageStandardDeviation, begin, end );
+        double sumFixed = 0.0;
+        for( SizeValueType k = begin; k < end; ++k )
+        {
+          const double u = ( fixedValueB - sortedFixedA[ k ] ) * fixedFactor;
+          sumFixed += std::exp( -0.5 * u * u );
+        }
+        sumFixed = minProbability + gaussianFactor * sumFixed;
+
+        /** The moving marginal and joint densities. The joint Gaussian is
+         * negligible wherever the moving Gaussian is.
+         */
+        this->GetKernelWindow( sortedMovingA, movingValueB,
+          this->m_MovingImageStandardDeviation, begin, end );
+        const SizeValueType windowSize = end - begin;
+        const double *      movingA    = &sortedMovingA[ begin ];
+        const double *      fixedW     = &fixedA[ begin ];
+        double              sumMoving  = 0.0;
+        double              sumJoint   = 0.0;
+        for( SizeValueType k = 0; k < windowSize; ++k )
+        {
+          const double uf = ( fixedValueB - fixedW[ k ] ) * fixedFactor;
+          const double um = ( movingValueB - movingA[ k ] ) * movingFactor;
+          const double km = gaussianFactor * std::exp( -0.5 * um * um );
+          const double kj = gaussianFactor * std::exp( -0.5 * uf * uf ) * km;
+          movingKernels[ k ] = km;
+          jointKernels[ k ]  = kj;
+          sumMoving         += km;
+          sumJoint          += kj;
+        }
+        sumMoving += minProbability;
+        sumJoint  += minProbability;
+
+        logSumFixed  -= std::log( sumFixed );
+        logSumMoving -= std::log( sumMoving );
+        logSumJoint  -= std::log( sumJoint );
+
+        /** The derivative weights of the pairs of samples. */
+        if( doDerivative )
+        {
+          const double invSumMoving = 1.0 / sumMoving;
+          const double invSumJoint  = 1.0 / sumJoint;
+          double       totalWeight  = 0.0;
+          for( SizeValueType k = 0; k < windowSize; ++k )
+          {
+            const double weight = ( movingKernels[ k ] * invSumMoving - jointKernels[ k ] * invSumJoint )
+              * ( movingValueB - movingA[ k ] );
+            totalWeight           += weight;
+            weightsA[ begin + k ] += weight;
+          }
+          weightsB[ j ] = totalWeight;
+        }
+      }
+      logSums[ 3 * chunk ]     = logSumFixed;
+      logSums[ 3 * chunk + 1 ] = logSumMoving;
+      logSums[ 3 * chunk + 2 ] = logSumJoint;
+    } );
+
+  /** Sum the chunks in a fixed order, to be independent of the scheduling. */
+  double logSumFixed  = 0.0;
+  double logSumMoving = 0.0;
+  double logSumJoint  = 0.0;
+  for( unsigned int chunk = 0; chunk < numberOfChunks; ++chunk )
+  {
+    logSumFixed  += logSums[ 3 * chunk ];
+    logSumMoving += logSums[ 3 * chunk + 1 ];
+    logSumJoint  += logSums[ 3 * chunk + 2 ];
+  }
+
+  const double nB        = static_cast< double >( numberOfValidB );
+  const double threshold = -0.5 * nB * std::log( this->m_MinProbability );
+  if( logSumMoving > threshold || logSumFixed > threshold || logSumJoint > threshold )
+  {
+    itkExceptionMacro( << "Standard deviation is too small" );
+  }
+
+  /** The mutual information, with minus sign to be minimized. */
+  const double mutualInformation = ( logSumFixed + logSumMoving - logSumJoint ) / nB
+    + std::log( static_cast< double >( numberOfValidA ) );
+  value = static_cast< MeasureType >( -mutualInformation );
+
+  if( !doDerivative )
+  {
+    return;
+  }
+
+  /** The derivative of the mutual information is the sum over the pairs (a, b)
+   * of weight( a, b ) * ( dM_b/dmu - dM_a/dmu ), divided by nB sigma_M^2.
+   * Accumulate the sums of the weights of each sample of set A and B.
+   */
+  std::vector< double > weightsA( numberOfValidA, 0.0 );
+  for( unsigned int chunk = 0; chunk < numberOfChunks; ++chunk )
+  {
+    const double * chunkWeights = &chunkWeightsA[ chunk * numberOfValidA ];
+    for( SizeValueType k = 0; k < numberOfValidA; ++k )
+    {
+      weightsA[ k ] += chunkWeights[ k ];
+    }
+  }
+
+  derivative->SetSize( this->GetNumberOfParameters() );
+  derivative->Fill( NumericTraits< DerivativeValueType >::ZeroValue() );
+  const double scale = -1.0 / ( nB * this->m_MovingImageStandardDeviation
+    * this->m_MovingImageStandardDeviation );
+  for( SizeValueType s = 0; s < numberOfValidA + numberOfValidB; ++s )
+  {
+    const SizeValueType i = s < numberOfValidA ? samplesA[ s ] : samplesB[ s - numberOfValidA ];
+    const double        coefficient = s < numberOfValidA
+      ? -scale * weightsA[ s ] : scale * weightsB[ s - numberOfValidA ];
+    const double *                     imageJacobian = &imageJacobians[ i * numberOfJacobianIndices ];
+    const NonZeroJacobianIndicesType & nzji          = nzjis[ i ];
+    for( SizeValueType k = 0; k < numberOfJacobianIndices; ++k )
+    {
+      ( *derivative )[ nzji[ k ] ] += coefficient * imageJacobian[ k ];
+    }
+  }
+
+} // end ComputeValueAndDerivative()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkViolaWellsMutualInformationImageToImageMetric_hxx
@@ -31,6 +31,11 @@ namespace elastix
  * The parameters used in this class are:
  * \parameter FixedImagePyramid: Select this pyramid as follows:\n
  *    <tt>(MovingImagePyramid "MovingShrinkingImagePyramid")</tt>
+ * \parameter ImagePyramidUseBoxAveraging: Flag to specify if each pixel of a resolution level
+ *    is the average of the box of pixels of the shrink factors, instead of a single pixel.
+ *    This avoids aliasing, at a fraction of the cost of the smoothing pyramids.\n
+ *    example: <tt>(ImagePyramidUseBoxAveraging "true")</tt>\n
+ *    Default false.
  *
  * \ingroup ImagePyramids
  */
@@ -87,6 +92,11 @@ public:
   typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
   typedef typename Superclass2::ITKBaseType          ITKBaseType;
 
+  /** Method for setting the schedule. Override from MovingImagePyramidBase,
+   * to read whether the pixels are averaged.
+   */
+  void SetMovingSchedule( void ) override;
+
 protected:
 
   /** The constructor. */
@@ -22,6 +22,29 @@
 #include "elxMovingShrinkingPyramid.h"
 
 namespace elastix
-{} // end namespace elastix
+{
+
+/**
+ * ******************* SetMovingSchedule ***********************
+ */
+
+template< class TElastix >
+void
+MovingShrinkingPyramid< TElastix >
+::SetMovingSchedule( void )
+{
+  /** Read the schedule. */
+  this->Superclass2::SetMovingSchedule();
+
+  /** Decide whether or not to average the boxes of the shrink factors. */
+  bool useBoxAveraging = false;
+  this->m_Configuration->ReadParameter( useBoxAveraging,
+    "ImagePyramidUseBoxAveraging", 0, false );
+  this->SetUseBoxAveraging( useBoxAveraging );
+
+} // end SetMovingSchedule()
+
+
+} // end namespace elastix
 
 #endif //#ifndef __elxMovingShrinkingPyramid_hxx
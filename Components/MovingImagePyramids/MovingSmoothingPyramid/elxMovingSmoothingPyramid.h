@@ -31,6 +31,10 @@ namespace elastix
  * The parameters used in this class are:
  * \parameter MovingImagePyramid: Select this pyramid as follows:\n
  *    <tt>(MovingImagePyramid "MovingSmoothingImagePyramid")</tt>
+ * \parameter ComputePyramidImagesPerResolution: Flag to specify if all resolution levels are computed
+ *    at once, or per resolution. Latter saves memory.\n
+ *    example: <tt>(ComputePyramidImagesPerResolution "true")</tt>\n
+ *    Default false.
  *
  * \ingroup ImagePyramids
  */
@@ -86,6 +90,14 @@ public:
   typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
   typedef typename Superclass2::ITKBaseType          ITKBaseType;
 
+  /** Method for setting the schedule. Override from MovingImagePyramidBase,
+   * to read whether the pyramid images are computed per resolution.
+   */
+  void SetMovingSchedule( void ) override;
+
+  /** Update the current resolution level. */
+  void BeforeEachResolution( void ) override;
+
 protected:
 
   /** The constructor. */
@@ -46,7 +46,9 @@ OpenCLMovingGenericPyramid< TElastix >
   m_GPUPyramidReady( true ),
   m_GPUPyramidCreated( true ),
   m_ContextCreated( false ),
-  m_UseOpenCL( true )
+  m_UseOpenCL( true ),
+  m_GPUInputImageSource( nullptr ),
+  m_GPUInputImageMTime( 0 )
 {
   // Based on the Insight Journal paper:
   // http://insight-journal.org/browse/publication/884
@@ -92,20 +94,28 @@ void
 OpenCLMovingGenericPyramid< TElastix >
 ::BeforeGenerateData( void )
 {
-  // Local GPU input image
-  GPUInputImagePointer gpuInputImage;
-
-  if( this->m_GPUPyramidReady )
+  // Create the GPU input image, unless the input did not change since it was
+  // copied to the GPU. This happens once per resolution when the pyramid
+  // images are computed per resolution.
+  const bool gpuInputImageIsValid = this->m_GPUInputImage.IsNotNull()
+    && this->m_GPUInputImageSource == this->GetInput()
+    && this->m_GPUInputImageMTime == this->GetInput()->GetMTime();
+
+  if( this->m_GPUPyramidReady && !gpuInputImageIsValid )
   {
     // Create GPU input image
     try
     {
-      gpuInputImage = GPUInputImageType::New();
+      GPUInputImagePointer gpuInputImage = GPUInputImageType::New();
       gpuInputImage->GraftITKImage( this->GetInput() );
       gpuInputImage->AllocateGPU();
       gpuInputImage->GetGPUDataManager()->SetCPUBufferLock( true );
       gpuInputImage->GetGPUDataManager()->SetGPUDirtyFlag( true );
       gpuInputImage->GetGPUDataManager()->UpdateGPUBuffer();
+
+      this->m_GPUInputImage       = gpuInputImage;
+      this->m_GPUInputImageSource = this->GetInput();
+      this->m_GPUInputImageMTime  = this->GetInput()->GetMTime();
     }
     catch( itk::ExceptionObject & e )
     {
@@ -122,13 +132,15 @@ OpenCLMovingGenericPyramid< TElastix >
     this->m_GPUPyramid->SetSmoothingSchedule( this->GetSmoothingSchedule() );
     this->m_GPUPyramid->SetUseShrinkImageFilter( this->GetUseShrinkImageFilter() );
     this->m_GPUPyramid->SetComputeOnlyForCurrentLevel( this->GetComputeOnlyForCurrentLevel() );
+    this->m_GPUPyramid->SetCurrentLevel( this->GetCurrentLevel() );
+    this->m_GPUPyramid->SetUseCascadedComputation( this->GetUseCascadedComputation() );
   }
 
   if( this->m_GPUPyramidReady )
   {
     try
     {
-      this->m_GPUPyramid->SetInput( gpuInputImage );
+      this->m_GPUPyramid->SetInput( this->m_GPUInputImage );
     }
     catch( itk::ExceptionObject & e )
     {
@@ -201,9 +213,14 @@ OpenCLMovingGenericPyramid< TElastix >
 
   if( computedUsingOpenCL )
   {
-    // Graft output
-    for( int i=0 ; i < this->GetNumberOfLevels() ; i++ ){
-      this->GraftNthOutput( i, this->m_GPUPyramid->GetOutput( i ) );
+    // Graft output. This copies the data to the host, so only the computed
+    // levels are grafted.
+    for( unsigned int i = 0; i < this->GetNumberOfLevels(); ++i )
+    {
+      if( !this->GetComputeOnlyForCurrentLevel() || i == this->GetCurrentLevel() )
+      {
+        this->GraftNthOutput( i, this->m_GPUPyramid->GetOutput( i ) );
+      }
     }
 
     // Report OpenCL device to the log
@@ -324,6 +324,12 @@ AdaGrad< TElastix >
     xl::xout[ "iteration" ][ "4b:||SearchDirection||" ] << this->GetSearchDirection().magnitude();
   }
 
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), this->GetGradient().magnitude() ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new spatial samples for the computation of the metric. */
   if( this->GetNewSamplesEveryIteration() )
   {
@@ -373,6 +379,8 @@ AdaGrad< TElastix >
       break;
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition. */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
@@ -467,12 +475,9 @@ AdaGrad< TElastix >
   const double eta = 1e-14;
   const double lamda2 = lamda * this->m_NoiseFactor;
 //  const double lamda2 = 0.01;
-  for( unsigned int j = 0; j < spaceDimension; ++j )
-  {
-    this->m_PreconditionVector[ j ] += this->m_Gradient[ j ] * this->m_Gradient[ j ];
-    searchDirection[ j ] = this->m_Gradient[ j ] / ( std::sqrt( this->m_PreconditionVector[ j ] + eta ) );
-    newPosition[ j ] = currentPosition[ j ] - lamda2 * searchDirection[ j ];
-  }
+  itk::ParallelVectorOperations::AdaGradScaledAdd( currentPosition.data_block(), -lamda2,
+    this->m_Gradient.data_block(), eta, this->m_PreconditionVector.data_block(),
+    searchDirection.data_block(), newPosition.data_block(), spaceDimension );
 
   this->Superclass1::UpdateCurrentTime();
   this->InvokeEvent( itk::IterationEvent() );
@@ -560,7 +565,7 @@ AdaGrad< TElastix >
   unsigned int P = static_cast< unsigned int >(
     this->GetRegistration()->GetAsITKBaseType()->GetTransform()->GetNumberOfParameters() );
 
-  this->m_SearchDirection = ParametersType( P );
+  this->m_SearchDirection.SetSize( P );
   this->m_SearchDirection.Fill( 0.0 );// if the print out is not needed, this could be removed. YQ
   /** Get the current resolution level. */
   unsigned int level = static_cast< unsigned int >(
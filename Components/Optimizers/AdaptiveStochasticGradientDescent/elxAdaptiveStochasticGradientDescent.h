@@ -25,6 +25,8 @@
 #include "itkComputeDisplacementDistribution.h" // For FASGD step size
 #include "elxProgressCommand.h"
 #include "itkAdvancedTransform.h"
+#include "itkAdvancedCombinationTransform.h"
+#include "itkAdvancedBSplineDeformableTransformBase.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 
 
@@ -182,6 +184,48 @@ namespace elastix
  *   The parameter can be specified for each resolution, or for all resolutions at once.\n
  *   example: <tt>(NoiseCompensation "true")</tt>\n
  *   Default/recommended: true.
+ * \parameter PipelineSampling: Selects whether the image samplers of the metrics select
+ *   the samples of the next iteration on a background thread, while the gradient of the
+ *   current iteration is computed and applied. Only used when NewSamplesEveryIteration is
+ *   true. The samples are reproducible, but differ from the ones selected without pipelining.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(PipelineSampling "true")</tt>\n
+ *   Default: false.
+ * \parameter BlockFreezingThreshold: Freeze tiles of B-spline control points whose gradient,
+ *   averaged over the iterations, is smaller than this fraction of the mean over all tiles.
+ *   The coefficients of a frozen tile are not updated. Only used with a B-spline transform.
+ *   A single metric that supports it, such as AdvancedMeanSquares, skips the samples whose
+ *   B-spline support lies in frozen tiles, except in the iterations that recheck the tiles.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(BlockFreezingThreshold 0.05)</tt>\n
+ *   Default: 0, which disables the freezing.
+ * \parameter BlockFreezingBlockSize: The number of control points of a tile in each dimension.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(BlockFreezingBlockSize 4)</tt>\n
+ *   Default: 4.
+ * \parameter BlockFreezingRecheckInterval: The number of iterations after which all tiles
+ *   are evaluated again, so that a tile that was frozen too early resumes. No tile is frozen
+ *   during the first interval.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(BlockFreezingRecheckInterval 50)</tt>\n
+ *   Default: 50.
+ * \parameter ParallelMiniBatches: Experimental: in each iteration, every thread draws its
+ *   own mini-batch from the samples of the image sampler, and the sparse steps of the
+ *   B-spline coefficients of all mini-batches are added at the end of the iteration, in a
+ *   fixed order, so that the result does not depend on the threads. This replaces the step
+ *   with the gradient of all samples. Only used with a B-spline transform and a single
+ *   metric that supports it, such as AdvancedMeanSquares. The image sampler is
+ *   updated once, so choose a sampler that provides many samples, such as the Full or Grid
+ *   sampler. The iteration info is not printed, and the block freezing is not applied.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(ParallelMiniBatches "true")</tt>\n
+ *   Default: false.
+ * \parameter MiniBatchSize: The number of samples of a parallel mini-batch. An iteration
+ *   evaluates one mini-batch per thread, so that about NumberOfSpatialSamples divided by the
+ *   number of threads gives steps like those without mini-batches.
+ *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+ *   example: <tt>(MiniBatchSize 500)</tt>\n
+ *   Default: 1000.
  *
  * \todo: this class contains a lot of functional code, which actually does not belong here.
  *
@@ -229,6 +273,7 @@ public:
   typedef typename Superclass2::RegistrationType     RegistrationType;
   typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
   typedef typename Superclass2::ITKBaseType          ITKBaseType;
+  typedef typename Superclass2::ParameterMapType     ParameterMapType;
   typedef itk::SizeValueType                         SizeValueType;
 
   /** Typedef for the ParametersType. */
@@ -247,6 +292,13 @@ public:
 
   void AfterRegistration( void ) override;
 
+  /** Add the step size settings of all resolutions, SP_a, SP_A, SP_alpha,
+   * SigmoidMax, SigmoidMin and SigmoidScale, to the transform parameter map,
+   * so that the next registration of a sequence can reuse the estimated
+   * values instead of estimating them again.
+   */
+  void CreateTransformParametersMap( ParameterMapType * paramsMap ) const override;
+
   /** Check if any scales are set, and set the UseScales flag on or off;
    * after that call the superclass' implementation.
    */
@@ -402,6 +454,37 @@ protected:
    */
   virtual void AddRandomPerturbation( ParametersType & parameters, double sigma );
 
+  /** Enable or disable the pipelined sampling of the image samplers of all
+   * metrics. Disabling it discards the samples that are prefetched.
+   */
+  virtual void SetPipelineSamplingOfImageSamplers( const bool pipelineSampling );
+
+  /** Set the tiles of BlockSize^D control points as parameter blocks, or no
+   * blocks if the transform is not a B-spline transform.
+   */
+  virtual void SetBSplineParameterBlocks( const unsigned int blockSize );
+
+  /** Let the parallel mini-batches use the metric, and return true, if the
+   * transform is a B-spline transform and the metric supports them.
+   */
+  virtual bool SetParallelMiniBatchFunctions( void );
+
+  /** Let the metric skip the samples whose B-spline support lies in frozen
+   * tiles, if the tiles are used, the B-spline transform is applied to the
+   * fixed image points, and the single metric supports it.
+   */
+  virtual void SetFrozenSampleFunctionOfMetric( void );
+
+  /** Call the superclass' implementation, and update the frozen supports if
+   * the frozen tiles have changed.
+   */
+  void FreezeConvergedBlocks( void ) override;
+
+  /** Whether the B-spline support of a fixed image point lies in frozen tiles,
+   * and the gradient of these tiles is not used in the current iteration.
+   */
+  virtual bool IsFrozenSample( const FixedImagePointType & point ) const;
+
 private:
 
   AdaptiveStochasticGradientDescent( const Self & );  // purposely not implemented
@@ -425,6 +508,21 @@ private:
   bool m_UseNoiseCompensation;
   bool m_OriginalButSigmoidToDefault;
 
+  /** Whether the samples of the next iteration are selected in the background. */
+  bool m_PipelineSampling;
+
+  /** Variables for skipping the samples in frozen tiles: whether the B-spline
+   * support that starts at each control point lies in frozen tiles, the
+   * frozen tiles it was computed for, and the geometry of the grid.
+   */
+  std::vector< bool >                                             m_FrozenSupports;
+  typename Superclass1::FrozenBlocksType                          m_FrozenBlocksOfSupports;
+  FixedImagePointType                                             m_GridOrigin;
+  itk::Matrix< double, FixedImageDimension, FixedImageDimension > m_PointToGridIndexMatrix;
+  FixedImageIndexType                                             m_GridIndex;
+  typename FixedImageRegionType::SizeType                         m_GridSize;
+  unsigned int                                                    m_SupportSize;
+
 };
 
 } // end namespace elastix
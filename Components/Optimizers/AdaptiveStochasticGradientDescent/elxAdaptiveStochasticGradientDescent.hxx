@@ -59,6 +59,8 @@ AdaptiveStochasticGradientDescent< TElastix >
 
   this->m_UseNoiseCompensation        = true;
   this->m_OriginalButSigmoidToDefault = false;
+  this->m_PipelineSampling            = false;
+  this->m_SupportSize                 = 0;
 
 } // Constructor
 
@@ -170,6 +172,37 @@ AdaptiveStochasticGradientDescent< TElastix >
   this->GetConfiguration()->ReadParameter( this->m_UseConstantStep,
     "UseConstantStep", this->GetComponentLabel(), level, 0 );
 
+  /** Set whether the samples are selected in the background; default: false. */
+  this->m_PipelineSampling = false;
+  this->GetConfiguration()->ReadParameter( this->m_PipelineSampling,
+    "PipelineSampling", this->GetComponentLabel(), level, 0 );
+
+  /** Set the freezing of converged tiles of control points; default: off. */
+  double blockFreezingThreshold = 0.0;
+  this->GetConfiguration()->ReadParameter( blockFreezingThreshold,
+    "BlockFreezingThreshold", this->GetComponentLabel(), level, 0 );
+  this->SetBlockFreezingThreshold( blockFreezingThreshold );
+  SizeValueType blockFreezingRecheckInterval = 50;
+  this->GetConfiguration()->ReadParameter( blockFreezingRecheckInterval,
+    "BlockFreezingRecheckInterval", this->GetComponentLabel(), level, 0 );
+  this->SetBlockFreezingRecheckInterval( blockFreezingRecheckInterval );
+  unsigned int blockFreezingBlockSize = 4;
+  this->GetConfiguration()->ReadParameter( blockFreezingBlockSize,
+    "BlockFreezingBlockSize", this->GetComponentLabel(), level, 0 );
+  this->SetBSplineParameterBlocks(
+    blockFreezingThreshold > 0.0 ? std::max( blockFreezingBlockSize, 1u ) : 0 );
+
+  /** Set the experimental parallel mini-batches; default: off. */
+  bool useParallelMiniBatches = false;
+  this->GetConfiguration()->ReadParameter( useParallelMiniBatches,
+    "ParallelMiniBatches", this->GetComponentLabel(), level, 0 );
+  SizeValueType miniBatchSize = 1000;
+  this->GetConfiguration()->ReadParameter( miniBatchSize,
+    "MiniBatchSize", this->GetComponentLabel(), level, 0 );
+  this->SetMiniBatchSize( miniBatchSize );
+  this->SetUseParallelMiniBatches( useParallelMiniBatches && this->SetParallelMiniBatchFunctions() );
+  this->SetFrozenSampleFunctionOfMetric();
+
   if( this->m_AutomaticParameterEstimation )
   {
     /** Read user setting. */
@@ -298,6 +331,12 @@ AdaptiveStochasticGradientDescent< TElastix >
     xl::xout[ "iteration" ][ "4:||Gradient||" ] << this->GetGradient().magnitude();
   }
 
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), this->GetGradient().magnitude() ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new spatial samples for the computation of the metric. */
   if( this->GetNewSamplesEveryIteration() )
   {
@@ -347,8 +386,20 @@ AdaptiveStochasticGradientDescent< TElastix >
       break;
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition. */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
+  if( !this->GetParameterBlocks().empty() )
+  {
+    elxout << "Number of frozen tiles of control points: "
+           << this->GetNumberOfFrozenBlocks() << std::endl;
+  }
+  if( this->GetUseParallelMiniBatches() )
+  {
+    elxout << "The parameters were updated with parallel mini-batches of "
+           << this->GetMiniBatchSize() << " samples." << std::endl;
+  }
 
   /** Store the used parameters, for later printing to screen. */
   SettingsType settings;
@@ -395,6 +446,45 @@ AdaptiveStochasticGradientDescent< TElastix >
 } // end AfterRegistration()
 
 
+/**
+ * ***************** CreateTransformParametersMap ***********************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::CreateTransformParametersMap( ParameterMapType * paramsMap ) const
+{
+  std::ostringstream         tmpStream;
+  std::vector< std::string > a, A, alpha, fmax, fmin, omega;
+
+  tmpStream << std::setprecision( 17 );
+  const auto toString = [ &tmpStream ]( const double value )
+  {
+    tmpStream.str( "" ); tmpStream << value;
+    return tmpStream.str();
+  };
+
+  for( const SettingsType & settings : this->m_SettingsVector )
+  {
+    a.push_back( toString( settings.a ) );
+    A.push_back( toString( settings.A ) );
+    alpha.push_back( toString( settings.alpha ) );
+    fmax.push_back( toString( settings.fmax ) );
+    fmin.push_back( toString( settings.fmin ) );
+    omega.push_back( toString( settings.omega ) );
+  }
+
+  paramsMap->insert( make_pair( "SP_a", a ) );
+  paramsMap->insert( make_pair( "SP_A", A ) );
+  paramsMap->insert( make_pair( "SP_alpha", alpha ) );
+  paramsMap->insert( make_pair( "SigmoidMax", fmax ) );
+  paramsMap->insert( make_pair( "SigmoidMin", fmin ) );
+  paramsMap->insert( make_pair( "SigmoidScale", omega ) );
+
+} // end CreateTransformParametersMap()
+
+
 /**
  * ****************** StartOptimization *************************
  */
@@ -447,11 +537,63 @@ AdaptiveStochasticGradientDescent< TElastix >
     this->m_AutomaticParameterEstimationDone = true;
   }
 
-  this->Superclass1::ResumeOptimization();
+  /** The samples are only prefetched during the iterations, so that the
+   * samplers are not used in the background when their settings change.
+   */
+  const bool pipelineSampling = this->m_PipelineSampling
+    && this->GetNewSamplesEveryIteration();
+  if( pipelineSampling )
+  {
+    this->SetPipelineSamplingOfImageSamplers( true );
+  }
+
+  try
+  {
+    this->Superclass1::ResumeOptimization();
+  }
+  catch( ... )
+  {
+    if( pipelineSampling )
+    {
+      this->SetPipelineSamplingOfImageSamplers( false );
+    }
+    throw;
+  }
+
+  if( pipelineSampling )
+  {
+    this->SetPipelineSamplingOfImageSamplers( false );
+  }
 
 } // end ResumeOptimization()
 
 
+/**
+ * ****************** SetPipelineSamplingOfImageSamplers *************************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::SetPipelineSamplingOfImageSamplers( const bool pipelineSampling )
+{
+  for( unsigned int i = 0; i < this->GetElastix()->GetNumberOfMetrics(); ++i )
+  {
+    ImageSamplerBaseType * sampler
+      = this->GetElastix()->GetElxMetricBase( i )->GetAdvancedMetricImageSampler();
+    if( sampler )
+    {
+      sampler->SetPipelineSampling( pipelineSampling );
+      if( !pipelineSampling )
+      {
+        sampler->DiscardPrefetchedSamples();
+      }
+    }
+  }
+
+} // end SetPipelineSamplingOfImageSamplers()
+
+
 /**
  * ****************** MetricErrorResponse *************************
  */
@@ -1097,6 +1239,310 @@ AdaptiveStochasticGradientDescent< TElastix >
 } // end CheckForAdvancedTransform()
 
 
+/**
+ * ****************** SetBSplineParameterBlocks **********************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::SetBSplineParameterBlocks( const unsigned int blockSize )
+{
+  typedef itk::AdvancedCombinationTransform<
+    CoordinateRepresentationType, FixedImageDimension >   CombinationTransformType;
+  typedef itk::AdvancedBSplineDeformableTransformBase<
+    CoordinateRepresentationType, FixedImageDimension >   BSplineTransformBaseType;
+  typedef typename BSplineTransformBaseType::SizeType     GridSizeType;
+  typedef typename Superclass1::ParameterBlocksType       ParameterBlocksType;
+
+  ParameterBlocksType blocks;
+  if( blockSize == 0 )
+  {
+    this->SetParameterBlocks( blocks );
+    return;
+  }
+
+  const TransformType * transform = this->GetRegistration()
+    ->GetAsITKBaseType()->GetModifiableTransform();
+  const CombinationTransformType * comboTransform
+    = dynamic_cast< const CombinationTransformType * >( transform );
+  const BSplineTransformBaseType * bsplineTransform = comboTransform
+    ? dynamic_cast< const BSplineTransformBaseType * >( comboTransform->GetCurrentTransform() )
+    : dynamic_cast< const BSplineTransformBaseType * >( transform );
+  if( bsplineTransform == nullptr )
+  {
+    xl::xout[ "warning" ]
+      << "WARNING: BlockFreezingThreshold is ignored, because the transform is not a B-spline."
+      << std::endl;
+    this->SetParameterBlocks( blocks );
+    return;
+  }
+
+  /** The parameters are stored per dimension, each as a coefficient image,
+   * so a control point has the same block in every dimension.
+   */
+  const GridSizeType gridSize = bsplineTransform->GetGridRegion().GetSize();
+  GridSizeType       blocksPerDimension;
+  SizeValueType      numberOfControlPoints = 1;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    blocksPerDimension[ d ] = ( gridSize[ d ] + blockSize - 1 ) / blockSize;
+    numberOfControlPoints  *= gridSize[ d ];
+  }
+
+  blocks.resize( bsplineTransform->GetNumberOfParameters() );
+  for( SizeValueType p = 0; p < numberOfControlPoints; ++p )
+  {
+    SizeValueType remainder = p;
+    SizeValueType block     = 0;
+    SizeValueType stride    = 1;
+    for( unsigned int d = 0; d < FixedImageDimension; ++d )
+    {
+      block     += ( ( remainder % gridSize[ d ] ) / blockSize ) * stride;
+      remainder /= gridSize[ d ];
+      stride    *= blocksPerDimension[ d ];
+    }
+    for( SizeValueType i = p; i < blocks.size(); i += numberOfControlPoints )
+    {
+      blocks[ i ] = static_cast< unsigned int >( block );
+    }
+  }
+  this->SetParameterBlocks( blocks );
+
+} // end SetBSplineParameterBlocks()
+
+
+/**
+ * ****************** SetParallelMiniBatchFunctions **********************
+ */
+
+template< class TElastix >
+bool
+AdaptiveStochasticGradientDescent< TElastix >
+::SetParallelMiniBatchFunctions( void )
+{
+  typedef itk::AdvancedCombinationTransform<
+    CoordinateRepresentationType, FixedImageDimension >   CombinationTransformType;
+  typedef itk::AdvancedBSplineDeformableTransformBase<
+    CoordinateRepresentationType, FixedImageDimension >   BSplineTransformBaseType;
+  typedef typename ElastixType::MetricBaseType::AdvancedMetricType MetricType;
+  typedef typename Superclass1::NonZeroIndicesType                 NonZeroIndicesType;
+
+  /** Only the coefficients of a B-spline transform refer to the parameters
+   * that the optimizer updates.
+   */
+  const TransformType * transform = this->GetRegistration()
+    ->GetAsITKBaseType()->GetModifiableTransform();
+  const CombinationTransformType * comboTransform
+    = dynamic_cast< const CombinationTransformType * >( transform );
+  const BSplineTransformBaseType * bsplineTransform = comboTransform
+    ? dynamic_cast< const BSplineTransformBaseType * >( comboTransform->GetCurrentTransform() )
+    : dynamic_cast< const BSplineTransformBaseType * >( transform );
+
+  const MetricType * metric = this->GetElastix()->GetNumberOfMetrics() == 1
+    ? dynamic_cast< const MetricType * >( this->GetElastix()->GetElxMetricBase()->GetAsITKBaseType() )
+    : nullptr;
+
+  if( bsplineTransform == nullptr || metric == nullptr || !metric->GetSupportsParallelMiniBatches() )
+  {
+    xl::xout[ "warning" ]
+      << "WARNING: ParallelMiniBatches is ignored, because it requires a B-spline transform "
+      << "and a single metric that supports it." << std::endl;
+    return false;
+  }
+
+  this->SetMiniBatchInitializeFunction( [ metric ]( const ParametersType & parameters )
+  {
+    return metric->BeforeParallelMiniBatches( parameters );
+  } );
+  this->SetMiniBatchGradientFunction( [ metric ](
+    const SizeValueType * sampleIds, const SizeValueType numberOfSampleIds,
+    MeasureType & value, DerivativeType & derivative, NonZeroIndicesType & indices )
+  {
+    metric->GetValueAndSparseDerivativeOfSamples( sampleIds, numberOfSampleIds, value, derivative, indices );
+  } );
+  return true;
+
+} // end SetParallelMiniBatchFunctions()
+
+
+/**
+ * ****************** SetFrozenSampleFunctionOfMetric **********************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::SetFrozenSampleFunctionOfMetric( void )
+{
+  typedef itk::AdvancedCombinationTransform<
+    CoordinateRepresentationType, FixedImageDimension >   CombinationTransformType;
+  typedef itk::AdvancedBSplineDeformableTransformBase<
+    CoordinateRepresentationType, FixedImageDimension >   BSplineTransformBaseType;
+  typedef typename ElastixType::MetricBaseType::AdvancedMetricType MetricType;
+
+  this->m_FrozenSupports.clear();
+  this->m_FrozenBlocksOfSupports.clear();
+  this->m_SupportSize = 0;
+
+  MetricType * metric = this->GetElastix()->GetNumberOfMetrics() == 1
+    ? dynamic_cast< MetricType * >( this->GetElastix()->GetElxMetricBase()->GetAsITKBaseType() )
+    : nullptr;
+  if( metric == nullptr )
+  {
+    return;
+  }
+  metric->SetFrozenSampleFunction( typename MetricType::FrozenSampleFunctionType() );
+  if( this->GetParameterBlocks().empty() || !metric->GetSupportsFrozenSamples() )
+  {
+    return;
+  }
+
+  /** The support of a sample is only known if the B-spline transform is
+   * evaluated at the fixed image point, so not after an initial transform.
+   */
+  const TransformType * transform = this->GetRegistration()
+    ->GetAsITKBaseType()->GetModifiableTransform();
+  const CombinationTransformType * comboTransform
+    = dynamic_cast< const CombinationTransformType * >( transform );
+  const BSplineTransformBaseType * bsplineTransform = comboTransform
+    ? dynamic_cast< const BSplineTransformBaseType * >( comboTransform->GetCurrentTransform() )
+    : dynamic_cast< const BSplineTransformBaseType * >( transform );
+  if( bsplineTransform == nullptr || ( comboTransform != nullptr
+    && comboTransform->GetInitialTransform() != nullptr && comboTransform->GetUseComposition() ) )
+  {
+    return;
+  }
+
+  /** Store the conversion of a point to a continuous index of the grid, as
+   * in TransformPointToContinuousGridIndex() of the transform.
+   */
+  itk::Matrix< double, FixedImageDimension, FixedImageDimension > gridIndexToPoint;
+  for( unsigned int i = 0; i < FixedImageDimension; ++i )
+  {
+    for( unsigned int j = 0; j < FixedImageDimension; ++j )
+    {
+      gridIndexToPoint[ i ][ j ] = bsplineTransform->GetGridDirection()[ i ][ j ]
+        * bsplineTransform->GetGridSpacing()[ j ];
+    }
+  }
+  this->m_PointToGridIndexMatrix = gridIndexToPoint.GetInverse();
+  this->m_GridOrigin             = bsplineTransform->GetGridOrigin();
+  this->m_GridIndex              = bsplineTransform->GetGridRegion().GetIndex();
+  this->m_GridSize               = bsplineTransform->GetGridRegion().GetSize();
+
+  /** The support has SupportSize^D control points, each with D parameters. */
+  const double numberOfSupportPoints = static_cast< double >(
+    bsplineTransform->GetNumberOfNonZeroJacobianIndices() / FixedImageDimension );
+  this->m_SupportSize = static_cast< unsigned int >( itk::Math::Round< int >(
+    std::pow( numberOfSupportPoints, 1.0 / static_cast< double >( FixedImageDimension ) ) ) );
+
+  metric->SetFrozenSampleFunction( [ this ]( const FixedImagePointType & point )
+  {
+    return this->IsFrozenSample( point );
+  } );
+
+} // end SetFrozenSampleFunctionOfMetric()
+
+
+/**
+ * ****************** FreezeConvergedBlocks **********************
+ */
+
+template< class TElastix >
+void
+AdaptiveStochasticGradientDescent< TElastix >
+::FreezeConvergedBlocks( void )
+{
+  this->Superclass1::FreezeConvergedBlocks();
+
+  if( this->m_SupportSize == 0 || this->GetFrozenBlocks() == this->m_FrozenBlocksOfSupports )
+  {
+    return;
+  }
+  this->m_FrozenBlocksOfSupports = this->GetFrozenBlocks();
+
+  /** A control point is frozen if its tile is. The blocks of the parameters
+   * of the first dimension are those of the control points.
+   */
+  const typename Superclass1::ParameterBlocksType & blocks = this->GetParameterBlocks();
+  SizeValueType numberOfControlPoints = 1;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    numberOfControlPoints *= this->m_GridSize[ d ];
+  }
+  std::vector< bool > frozen( numberOfControlPoints );
+  for( SizeValueType p = 0; p < numberOfControlPoints; ++p )
+  {
+    frozen[ p ] = this->m_FrozenBlocksOfSupports[ blocks[ p ] ];
+  }
+
+  /** A support is frozen if all its control points are. Erode the frozen
+   * control points with the support, one dimension at a time.
+   */
+  SizeValueType stride = 1;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    std::vector< bool > eroded( numberOfControlPoints, false );
+    for( SizeValueType p = 0; p < numberOfControlPoints; ++p )
+    {
+      const SizeValueType position = ( p / stride ) % this->m_GridSize[ d ];
+      if( position + this->m_SupportSize > this->m_GridSize[ d ] )
+      {
+        continue;
+      }
+      bool supportFrozen = true;
+      for( unsigned int k = 0; k < this->m_SupportSize && supportFrozen; ++k )
+      {
+        supportFrozen = frozen[ p + k * stride ];
+      }
+      eroded[ p ] = supportFrozen;
+    }
+    frozen.swap( eroded );
+    stride *= this->m_GridSize[ d ];
+  }
+  this->m_FrozenSupports.swap( frozen );
+
+} // end FreezeConvergedBlocks()
+
+
+/**
+ * ****************** IsFrozenSample **********************
+ */
+
+template< class TElastix >
+bool
+AdaptiveStochasticGradientDescent< TElastix >
+::IsFrozenSample( const FixedImagePointType & point ) const
+{
+  if( this->m_FrozenSupports.empty() || !this->CanSkipFrozenBlocks() )
+  {
+    return false;
+  }
+
+  /** Find the first control point of the support, as ComputeStartIndex() of
+   * the B-spline weights does, and look up whether the support is frozen.
+   */
+  const itk::Vector< double, FixedImageDimension > cindex
+    = this->m_PointToGridIndexMatrix * ( point - this->m_GridOrigin );
+  SizeValueType controlPoint = 0;
+  SizeValueType stride       = 1;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    const long start = static_cast< long >( std::floor( cindex[ d ]
+      - ( this->m_SupportSize - 2.0 ) / 2.0 ) ) - this->m_GridIndex[ d ];
+    if( start < 0 || static_cast< SizeValueType >( start ) + this->m_SupportSize > this->m_GridSize[ d ] )
+    {
+      return false;
+    }
+    controlPoint += static_cast< SizeValueType >( start ) * stride;
+    stride       *= this->m_GridSize[ d ];
+  }
+  return this->m_FrozenSupports[ controlPoint ];
+
+} // end IsFrozenSample()
+
+
 /**
  * *************** GetScaledDerivativeWithExceptionHandling ***************
  */
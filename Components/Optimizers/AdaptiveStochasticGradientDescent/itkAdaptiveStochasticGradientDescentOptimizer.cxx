@@ -20,10 +20,35 @@
 
 #include "vnl/vnl_math.h"
 #include "itkSigmoidImageFilter.h"
+#include "itkParallelVectorOperations.h"
+#include "itkPersistentThreadPool.h"
+#include "itkPhiloxRandomGenerator.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include <algorithm>
+#include <cmath>
 
 namespace itk
 {
 
+namespace
+{
+
+/** Call the functor for a work unit of the parallel mini-batches. */
+ITK_THREAD_RETURN_TYPE
+MiniBatchThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const std::function< void ( ThreadIdType ) > * functor
+    = static_cast< std::function< void ( ThreadIdType ) > * >( infoStruct->UserData );
+  ( *functor )( infoStruct->WorkUnitID );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end MiniBatchThreaderCallback()
+
+} // end namespace
+
 /**
  * ************************* Constructor ************************
  */
@@ -36,9 +61,414 @@ AdaptiveStochasticGradientDescentOptimizer
   this->m_SigmoidMin           = -0.8;
   this->m_SigmoidScale         = 1e-8;
 
+  this->m_BlockFreezingThreshold       = 0.0;
+  this->m_BlockFreezingRecheckInterval = 50;
+  this->m_NumberOfFrozenBlocks         = 0;
+
+  this->m_UseParallelMiniBatches     = false;
+  this->m_MiniBatchSize              = 1000;
+  this->m_NumberOfMiniBatchWorkUnits = 0;
+
 } // end Constructor
 
 
+/**
+ * ************************* SetParameterBlocks ************************
+ */
+
+void
+AdaptiveStochasticGradientDescentOptimizer
+::SetParameterBlocks( const ParameterBlocksType & blocks )
+{
+  this->m_ParameterBlocks = blocks;
+
+  /** Count the parameters of each block. */
+  unsigned int numberOfBlocks = 0;
+  for( const unsigned int block : blocks )
+  {
+    numberOfBlocks = std::max( numberOfBlocks, block + 1 );
+  }
+  this->m_NumberOfParametersPerBlock.assign( numberOfBlocks, 0 );
+  for( const unsigned int block : blocks )
+  {
+    ++this->m_NumberOfParametersPerBlock[ block ];
+  }
+
+  /** The blocks of a previous resolution are not frozen anymore. */
+  this->m_AveragedBlockGradients.assign( numberOfBlocks, 0.0 );
+  this->m_FrozenBlocks.assign( numberOfBlocks, false );
+  this->m_NumberOfFrozenBlocks = 0;
+  this->Modified();
+
+} // end SetParameterBlocks()
+
+
+/**
+ * ************************* CanSkipFrozenBlocks ************************
+ */
+
+bool
+AdaptiveStochasticGradientDescentOptimizer
+::CanSkipFrozenBlocks( void ) const
+{
+  if( this->m_NumberOfFrozenBlocks == 0 || this->m_BlockFreezingThreshold <= 0.0
+    || this->m_UseParallelMiniBatches )
+  {
+    return false;
+  }
+
+  /** The gradient of a recheck is used for all blocks, see FreezeConvergedBlocks(). */
+  const SizeValueType interval = std::max< SizeValueType >( this->m_BlockFreezingRecheckInterval, 1 );
+  return this->GetCurrentIteration() % interval != 0;
+
+} // end CanSkipFrozenBlocks()
+
+
+/**
+ * ******************* SetMiniBatchInitializeFunction ******************
+ */
+
+void
+AdaptiveStochasticGradientDescentOptimizer
+::SetMiniBatchInitializeFunction( const MiniBatchInitializeFunctionType & function )
+{
+  this->m_MiniBatchInitializeFunction = function;
+  this->Modified();
+
+} // end SetMiniBatchInitializeFunction()
+
+
+/**
+ * ******************* SetMiniBatchGradientFunction ******************
+ */
+
+void
+AdaptiveStochasticGradientDescentOptimizer
+::SetMiniBatchGradientFunction( const MiniBatchGradientFunctionType & function )
+{
+  this->m_MiniBatchGradientFunction = function;
+  this->Modified();
+
+} // end SetMiniBatchGradientFunction()
+
+
+/**
+ * ************************* StartOptimization ************************
+ */
+
+void
+AdaptiveStochasticGradientDescentOptimizer
+::StartOptimization( void )
+{
+  const std::size_t numberOfBlocks = this->m_NumberOfParametersPerBlock.size();
+  this->m_AveragedBlockGradients.assign( numberOfBlocks, 0.0 );
+  this->m_FrozenBlocks.assign( numberOfBlocks, false );
+  this->m_NumberOfFrozenBlocks = 0;
+
+  this->Superclass::StartOptimization();
+
+} // end StartOptimization()
+
+
+/**
+ * ************************* AdvanceOneStep ************************
+ */
+
+void
+AdaptiveStochasticGradientDescentOptimizer
+::AdvanceOneStep( void )
+{
+  if( this->m_BlockFreezingThreshold > 0.0 && !this->m_ParameterBlocks.empty() )
+  {
+    this->FreezeConvergedBlocks();
+  }
+
+  this->Superclass::AdvanceOneStep();
+
+} // end AdvanceOneStep()
+
+
+/**
+ * ************************* ResumeOptimization ************************
+ */
+
+void
+AdaptiveStochasticGradientDescentOptimizer
+::ResumeOptimization( void )
+{
+  if( this->m_UseParallelMiniBatches )
+  {
+    this->ResumeParallelMiniBatchOptimization();
+  }
+  else
+  {
+    this->Superclass::ResumeOptimization();
+  }
+
+} // end ResumeOptimization()
+
+
+/**
+ * ******************** ResumeParallelMiniBatchOptimization ********************
+ */
+
+void
+AdaptiveStochasticGradientDescentOptimizer
+::ResumeParallelMiniBatchOptimization( void )
+{
+  if( !this->m_MiniBatchInitializeFunction || !this->m_MiniBatchGradientFunction )
+  {
+    itkExceptionMacro( << "The parallel mini-batches need an initialize and a gradient function." );
+  }
+  if( this->GetScaledCostFunction()->GetUseActiveParameters() )
+  {
+    itkExceptionMacro( << "The parallel mini-batches do not support active parameters." );
+  }
+
+  this->m_Stop = false;
+  this->InvokeEvent( StartEvent() );
+
+  /** The updates are applied to the unscaled parameters, which the gradient
+   * function keeps referring to. A step of -a g / s in the scaled parameters
+   * changes an unscaled parameter by -a g / s^2, with s^2 the user scale.
+   */
+  this->m_MiniBatchPosition = this->GetCurrentPosition();
+  ParametersType &   position           = this->m_MiniBatchPosition;
+  const unsigned int numberOfParameters = position.GetSize();
+  std::vector< double > inverseScales( numberOfParameters, 1.0 );
+  if( this->GetUseScales() )
+  {
+    const ScalesType & scales = this->GetScales();
+    for( unsigned int j = 0; j < numberOfParameters; ++j )
+    {
+      inverseScales[ j ] = 1.0 / scales[ j ];
+    }
+  }
+  const double sign = this->GetMaximize() ? -1.0 : 1.0;
+
+  SizeValueType numberOfSamples = 0;
+  try
+  {
+    numberOfSamples = this->m_MiniBatchInitializeFunction( position );
+    if( numberOfSamples == 0 )
+    {
+      itkExceptionMacro( << "The parallel mini-batches need at least one sample." );
+    }
+  }
+  catch( ExceptionObject & err )
+  {
+    this->MetricErrorResponse( err );
+  }
+
+  ThreadIdType numberOfWorkUnits = this->m_NumberOfMiniBatchWorkUnits;
+  if( numberOfWorkUnits == 0 )
+  {
+    numberOfWorkUnits = PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads();
+  }
+  numberOfWorkUnits = std::max< ThreadIdType >( numberOfWorkUnits, 1 );
+  const SizeValueType batchSize = std::max< SizeValueType >( this->m_MiniBatchSize, 1 );
+
+  /** A mini-batch only depends on the key and its number, so that it does
+   * not depend on the thread that evaluates it.
+   */
+  typedef Statistics::MersenneTwisterRandomVariateGenerator GeneratorType;
+  GeneratorType::Pointer               generator = GeneratorType::GetInstance();
+  const PhiloxRandomGenerator::KeyType high      = generator->GetIntegerVariate();
+  const PhiloxRandomGenerator::KeyType low       = generator->GetIntegerVariate();
+  const PhiloxRandomGenerator::KeyType key       = ( high << 32 ) | low;
+
+  /** A mini-batch advances the time by E_0 divided by the number of work units. */
+  const SizeValueType firstMiniBatch   = this->m_CurrentIteration * numberOfWorkUnits;
+  const double        initialTime      = this->m_CurrentTime;
+  const double        timePerMiniBatch = ( this->GetSigmoidMax() + this->GetSigmoidMin() ) / 2.0
+    / static_cast< double >( numberOfWorkUnits );
+
+  /** The buffers of the work units. A work unit stores its step only at the
+   * nonzero indices of its derivative, so that the parameters are only read
+   * during an iteration. The gradient function needs a full-length
+   * derivative, which the work unit clears at these indices afterwards.
+   */
+  std::vector< std::vector< SizeValueType > > sampleIds( numberOfWorkUnits,
+    std::vector< SizeValueType >( batchSize ) );
+  std::vector< std::vector< double > > uniforms( numberOfWorkUnits, std::vector< double >( batchSize ) );
+  std::vector< DerivativeType >        derivatives( numberOfWorkUnits, DerivativeType( numberOfParameters ) );
+  std::vector< std::vector< double > > steps( numberOfWorkUnits );
+  std::vector< NonZeroIndicesType >    indices( numberOfWorkUnits );
+  std::vector< double >                values( numberOfWorkUnits, 0.0 );
+  for( ThreadIdType w = 0; w < numberOfWorkUnits; ++w )
+  {
+    derivatives[ w ].Fill( 0.0 );
+  }
+
+  SizeValueType                          iteration = this->m_CurrentIteration;
+  std::function< void ( ThreadIdType ) > workUnitFunction
+    = [ & ]( const ThreadIdType workUnit )
+  {
+    const SizeValueType miniBatch = iteration * numberOfWorkUnits + workUnit;
+    PhiloxRandomGenerator::FillUniformVariates( key, miniBatch, 0, batchSize, uniforms[ workUnit ].data() );
+    for( SizeValueType i = 0; i < batchSize; ++i )
+    {
+      sampleIds[ workUnit ][ i ] = std::min( static_cast< SizeValueType >(
+        uniforms[ workUnit ][ i ] * static_cast< double >( numberOfSamples ) ), numberOfSamples - 1 );
+    }
+
+    DerivativeType &     derivative = derivatives[ workUnit ];
+    NonZeroIndicesType & nzji       = indices[ workUnit ];
+    MeasureType          value      = 0.0;
+    this->m_MiniBatchGradientFunction( sampleIds[ workUnit ].data(), batchSize, value, derivative, nzji );
+    values[ workUnit ] = sign * value;
+
+    /** Store the sparse step, and clear the derivative. */
+    const double time = this->m_UseConstantStep ? 0.0
+      : initialTime + timePerMiniBatch * static_cast< double >( miniBatch - firstMiniBatch );
+    const double            gain = sign * this->Compute_a( time ) / static_cast< double >( numberOfWorkUnits );
+    std::vector< double > & step = steps[ workUnit ];
+    step.resize( nzji.size() );
+    for( std::size_t k = 0; k < nzji.size(); ++k )
+    {
+      const unsigned long j = nzji[ k ];
+      step[ k ]       = -gain * derivative[ j ] * inverseScales[ j ];
+      derivative[ j ] = 0.0;
+    }
+  };
+
+  /** An iteration evaluates one mini-batch per work unit. The end of the
+   * pool's SingleMethodExecute() is the barrier, after which the steps are
+   * added to the parameters in the order of the work units. The result
+   * therefore does not depend on the scheduling of the work units.
+   */
+  for( ; iteration < this->m_NumberOfIterations; ++iteration )
+  {
+    try
+    {
+      PersistentThreadPool::GetInstance()->SingleMethodExecute(
+        numberOfWorkUnits, MiniBatchThreaderCallback, &workUnitFunction );
+    }
+    catch( ExceptionObject & err )
+    {
+      this->SetCurrentPosition( position );
+      this->MetricErrorResponse( err );
+    }
+
+    for( ThreadIdType w = 0; w < numberOfWorkUnits; ++w )
+    {
+      const NonZeroIndicesType &    nzji = indices[ w ];
+      const std::vector< double > & step = steps[ w ];
+      for( std::size_t k = 0; k < nzji.size(); ++k )
+      {
+        position[ nzji[ k ] ] += step[ k ];
+      }
+    }
+  }
+
+  /** Report the state after the last mini-batches. */
+  this->SetCurrentPosition( position );
+  this->m_CurrentTime  += timePerMiniBatch * static_cast< double >( iteration * numberOfWorkUnits - firstMiniBatch );
+  this->m_LearningRate  = this->Compute_a( this->m_UseConstantStep ? 0.0 : this->m_CurrentTime );
+  this->m_Value         = 0.0;
+  for( const double value : values )
+  {
+    this->m_Value += value / static_cast< double >( numberOfWorkUnits );
+  }
+  this->m_Gradient         = DerivativeType( numberOfParameters );
+  this->m_Gradient.Fill( 0.0 );
+  this->m_CurrentIteration = this->m_NumberOfIterations;
+  this->m_StopCondition    = MaximumNumberOfIterations;
+  this->StopOptimization();
+
+} // end ResumeParallelMiniBatchOptimization()
+
+
+/**
+ * ************************* FreezeConvergedBlocks ************************
+ */
+
+void
+AdaptiveStochasticGradientDescentOptimizer
+::FreezeConvergedBlocks( void )
+{
+  const ParameterBlocksType & blocks = this->m_ParameterBlocks;
+  if( blocks.size() != this->m_Gradient.GetSize() )
+  {
+    itkExceptionMacro( << "The number of parameter blocks (" << blocks.size()
+                       << ") does not match the number of parameters ("
+                       << this->m_Gradient.GetSize() << ")." );
+  }
+
+  /** Sum the squared gradient of each block. */
+  const std::size_t     numberOfBlocks = this->m_NumberOfParametersPerBlock.size();
+  std::vector< double > squaredGradients( numberOfBlocks, 0.0 );
+  for( std::size_t j = 0; j < blocks.size(); ++j )
+  {
+    squaredGradients[ blocks[ j ] ] += this->m_Gradient[ j ] * this->m_Gradient[ j ];
+  }
+
+  /** Update the averaged block gradients. At a recheck, the average of a
+   * frozen block restarts from its current gradient.
+   */
+  const SizeValueType interval  = std::max< SizeValueType >( this->m_BlockFreezingRecheckInterval, 1 );
+  const SizeValueType iteration = this->GetCurrentIteration();
+  const bool          recheck   = iteration % interval == 0;
+  const double        decay     = 0.9;
+  double              meanBlockGradient = 0.0;
+  for( std::size_t b = 0; b < numberOfBlocks; ++b )
+  {
+    if( this->m_NumberOfParametersPerBlock[ b ] == 0 )
+    {
+      continue;
+    }
+    const double rms = std::sqrt( squaredGradients[ b ]
+      / static_cast< double >( this->m_NumberOfParametersPerBlock[ b ] ) );
+    if( iteration == 0 || ( recheck && this->m_FrozenBlocks[ b ] ) )
+    {
+      this->m_AveragedBlockGradients[ b ] = rms;
+    }
+    else if( !this->m_FrozenBlocks[ b ] )
+    {
+      this->m_AveragedBlockGradients[ b ]
+        = decay * this->m_AveragedBlockGradients[ b ] + ( 1.0 - decay ) * rms;
+    }
+    meanBlockGradient += this->m_AveragedBlockGradients[ b ];
+  }
+  meanBlockGradient /= static_cast< double >( numberOfBlocks );
+
+  /** Decide which blocks are frozen. A block stays frozen until the next
+   * recheck, and none is frozen during the first interval.
+   */
+  const double threshold = this->m_BlockFreezingThreshold * meanBlockGradient;
+  this->m_NumberOfFrozenBlocks = 0;
+  for( std::size_t b = 0; b < numberOfBlocks; ++b )
+  {
+    if( iteration < interval )
+    {
+      this->m_FrozenBlocks[ b ] = false;
+    }
+    else if( recheck || !this->m_FrozenBlocks[ b ] )
+    {
+      this->m_FrozenBlocks[ b ] = this->m_NumberOfParametersPerBlock[ b ] > 0
+        && this->m_AveragedBlockGradients[ b ] < threshold;
+    }
+    if( this->m_FrozenBlocks[ b ] )
+    {
+      ++this->m_NumberOfFrozenBlocks;
+    }
+  }
+
+  /** Drop the updates of the frozen blocks. */
+  if( this->m_NumberOfFrozenBlocks > 0 )
+  {
+    for( std::size_t j = 0; j < blocks.size(); ++j )
+    {
+      if( this->m_FrozenBlocks[ blocks[ j ] ] )
+      {
+        this->m_Gradient[ j ] = 0.0;
+      }
+    }
+  }
+
+} // end FreezeConvergedBlocks()
+
+
 /**
  * ************************** UpdateCurrentTime ********************
  */
@@ -65,8 +495,9 @@ AdaptiveStochasticGradientDescentOptimizer
       sigmoid.SetBeta( beta );
 
       /** Formula (2) in Cruz */
-      const double inprod = inner_product(
-        this->m_PreviousGradient, this->GetGradient() );
+      const double inprod = ParallelVectorOperations::InnerProduct(
+        this->m_PreviousGradient.data_block(), this->GetGradient().data_block(),
+        this->GetGradient().GetSize() );
       this->m_CurrentTime += sigmoid( -inprod );
       this->m_CurrentTime  = std::max( 0.0, this->m_CurrentTime );
     }
@@ -20,6 +20,8 @@
 #define __itkAdaptiveStochasticGradientDescentOptimizer_h
 
 #include "../StandardGradientDescent/itkStandardGradientDescentOptimizer.h"
+#include <functional>
+#include <vector>
 
 namespace itk
 {
@@ -65,6 +67,33 @@ namespace itk
 * \c NewSamplesEveryIteration to \c "true" to achieve this effect.
 * For more information on this strategy, you may have a look at:
 *
+* Optionally, the parameters are divided into blocks, for example tiles of
+* B-spline control points, of which the converged ones are frozen. The root
+* mean square of the gradient of each block is averaged over the iterations.
+* Blocks whose average falls below BlockFreezingThreshold times the mean over
+* all blocks are not updated anymore. Every BlockFreezingRecheckInterval
+* iterations all blocks are evaluated again, so that a block that was frozen
+* too early resumes. In the other iterations the gradient of the frozen
+* blocks is not used, so the cost function may skip its computation, see
+* CanSkipFrozenBlocks().
+*
+* Experimentally, the iterations can use parallel mini-batches. Each work
+* unit then draws its own mini-batch of samples per iteration, and computes
+* the sparse derivative of these samples with the MiniBatchGradientFunction,
+* without a full-length reduction of the derivative. All mini-batches of an
+* iteration are evaluated at the same parameters, and the sparse steps of the
+* work units are added to the parameters at the end of the iteration, in the
+* order of the work units, so that the result does not depend on the
+* scheduling. This is a deterministic, synchronous mode: the work units wait
+* for each other at every iteration, unlike the lock-free updates of
+* Hogwild! (F. Niu et al., NIPS 2011). A mini-batch advances the time by E_0
+* divided by the number of work units, with
+* \f$E_0 = (sigmoid_{max} + sigmoid_{min})/2\f$ as without adaptive step
+* sizes, and takes that fraction of the gain. A mini-batch of the
+* NumberOfSpatialSamples divided by the number of work units then gives steps
+* like those of the optimizer without mini-batches. No iteration events are
+* invoked in this mode.
+*
 * \sa AdaptiveStochasticGradientDescent, StandardGradientDescentOptimizer
 * \ingroup Optimizers
 */
@@ -98,6 +127,26 @@ public:
   typedef Superclass::ScaledCostFunctionPointer ScaledCostFunctionPointer;
   typedef Superclass::StopConditionType         StopConditionType;
 
+  /** The block of each parameter, for the block freezing. */
+  typedef std::vector< unsigned int > ParameterBlocksType;
+
+  /** Whether each block is frozen. */
+  typedef std::vector< bool > FrozenBlocksType;
+
+  /** The indices of the nonzero entries of a sparse derivative. */
+  typedef std::vector< unsigned long > NonZeroIndicesType;
+
+  /** The function that sets the parameters that the mini-batch gradient
+   * function keeps referring to, and returns the number of samples. */
+  typedef std::function< SizeValueType ( const ParametersType & ) > MiniBatchInitializeFunctionType;
+
+  /** The function that computes the value and the sparse derivative of the
+   * samples with the given indices at the current parameters. The derivative
+   * is zero on entry, and nonzero only at the returned indices; it is called
+   * concurrently by the work units. */
+  typedef std::function< void ( const SizeValueType *, const SizeValueType,
+    MeasureType &, DerivativeType &, NonZeroIndicesType & ) > MiniBatchGradientFunctionType;
+
   /** Set/Get whether the adaptive step size mechanism is desired. Default: true */
   itkSetMacro( UseAdaptiveStepSizes, bool );
   itkGetConstMacro( UseAdaptiveStepSizes, bool );
@@ -117,6 +166,61 @@ public:
   itkSetMacro( SigmoidScale, double );
   itkGetConstMacro( SigmoidScale, double );
 
+  /** Set/Get the block of each parameter. An empty vector, the default,
+   * disables the block freezing. */
+  virtual void SetParameterBlocks( const ParameterBlocksType & blocks );
+  itkGetConstReferenceMacro( ParameterBlocks, ParameterBlocksType );
+
+  /** Set/Get the fraction of the mean block gradient below which a block is
+   * frozen. Default: 0, which disables the block freezing. */
+  itkSetMacro( BlockFreezingThreshold, double );
+  itkGetConstMacro( BlockFreezingThreshold, double );
+
+  /** Set/Get the number of iterations after which all blocks are evaluated
+   * again. No block is frozen in the first interval. Default: 50. */
+  itkSetMacro( BlockFreezingRecheckInterval, SizeValueType );
+  itkGetConstMacro( BlockFreezingRecheckInterval, SizeValueType );
+
+  /** Get the number of blocks that are currently frozen. */
+  itkGetConstMacro( NumberOfFrozenBlocks, SizeValueType );
+
+  /** Get whether each block is currently frozen. */
+  itkGetConstReferenceMacro( FrozenBlocks, FrozenBlocksType );
+
+  /** Whether the gradient of the frozen blocks is not used in the current
+   * iteration, so that the cost function may skip its computation. This is
+   * the case if blocks are frozen and the iteration is not a recheck. */
+  virtual bool CanSkipFrozenBlocks( void ) const;
+
+  /** Set/Get whether the iterations use parallel mini-batches, see the class
+   * description. The block freezing is not applied then. Default: false. */
+  itkSetMacro( UseParallelMiniBatches, bool );
+  itkGetConstMacro( UseParallelMiniBatches, bool );
+
+  /** Set/Get the number of samples of a mini-batch. Default: 1000. */
+  itkSetMacro( MiniBatchSize, SizeValueType );
+  itkGetConstMacro( MiniBatchSize, SizeValueType );
+
+  /** Set/Get the number of mini-batches per iteration. Default: 0,
+   * which uses the maximum number of threads of the PersistentThreadPool. */
+  itkSetMacro( NumberOfMiniBatchWorkUnits, ThreadIdType );
+  itkGetConstMacro( NumberOfMiniBatchWorkUnits, ThreadIdType );
+
+  /** Set the functions that the mini-batches use instead of the cost function. */
+  virtual void SetMiniBatchInitializeFunction( const MiniBatchInitializeFunctionType & function );
+  virtual void SetMiniBatchGradientFunction( const MiniBatchGradientFunctionType & function );
+
+  /** Reset the block freezing and call the superclass' implementation. */
+  void StartOptimization( void ) override;
+
+  /** Drop the gradient of the frozen blocks, if the block freezing is used,
+   * and call the superclass' implementation. */
+  void AdvanceOneStep( void ) override;
+
+  /** Perform the iterations with parallel mini-batches, if asked for, and
+   * call the superclass' implementation otherwise. */
+  void ResumeOptimization( void ) override;
+
 protected:
 
   AdaptiveStochasticGradientDescentOptimizer();
@@ -131,6 +235,13 @@ protected:
   */
   void UpdateCurrentTime( void ) override;
 
+  /** Update the averaged block gradients, determine the frozen blocks and
+   * set their gradient to zero. */
+  virtual void FreezeConvergedBlocks( void );
+
+  /** Perform the iterations with parallel mini-batches. */
+  virtual void ResumeParallelMiniBatchOptimization( void );
+
   /** The PreviousGradient, necessary for the CruzAcceleration */
   DerivativeType m_PreviousGradient;
 
@@ -145,6 +256,23 @@ private:
   double m_SigmoidMin;
   double m_SigmoidScale;
 
+  /** Variables for the block freezing. */
+  ParameterBlocksType          m_ParameterBlocks;
+  double                       m_BlockFreezingThreshold;
+  SizeValueType                m_BlockFreezingRecheckInterval;
+  SizeValueType                m_NumberOfFrozenBlocks;
+  std::vector< double >        m_AveragedBlockGradients;
+  FrozenBlocksType             m_FrozenBlocks;
+  std::vector< SizeValueType > m_NumberOfParametersPerBlock;
+
+  /** Variables for the parallel mini-batches. */
+  bool                            m_UseParallelMiniBatches;
+  SizeValueType                   m_MiniBatchSize;
+  ThreadIdType                    m_NumberOfMiniBatchWorkUnits;
+  MiniBatchInitializeFunctionType m_MiniBatchInitializeFunction;
+  MiniBatchGradientFunctionType   m_MiniBatchGradientFunction;
+  ParametersType                  m_MiniBatchPosition;
+
 };
 
 } // end namespace itk
@@ -30,6 +30,8 @@
 #include "itkImageRandomSampler.h"
 #include "itkLineSearchOptimizer.h"
 #include "itkMoreThuenteLineSearchOptimizer.h"
+#include "itkParallelVectorOperations.h"
+#include "itkLBFGSHistory.h"
 
 
 namespace elastix
@@ -92,6 +94,10 @@ namespace elastix
  *   example: <tt>(MaximumStepLength 1.0)</tt>\n
  *   Default: mean voxel spacing of fixed and moving image. This seems to work well in general.
  *   This parameter only has influence when AutomaticParameterEstimation is used.
+ * \parameter LBFGSSinglePrecisionHistory: Whether to store the s and y vectors of the
+ *   LBFGSMemory in single precision, which halves the memory they use.\n
+ *   example: <tt>(LBFGSSinglePrecisionHistory "true")</tt>\n
+ *   Default value: "false".
  *
  * \todo: this class contains a lot of functional code, which actually does not belong here.
  *
@@ -289,8 +295,6 @@ protected:
 
   /** For L-BFGS usage. */
   typedef itk::Array< double >               RhoType;
-  typedef std::vector< ParametersType >      SType;
-  typedef std::vector< DerivativeType >      YType;
   typedef itk::Array< double >               DiagonalMatrixType;
 
   AdaptiveStochasticLBFGS();
@@ -358,8 +362,7 @@ protected:
    */
   virtual void AddRandomPerturbation( ParametersType & parameters, double sigma );
 
-  /** Store s = x_k - x_k-1 and y = g_k - g_k-1 in m_S and m_Y,
-   * and store 1/(ys) in m_Rho. */
+  /** Store s = x_k - x_k-1 and y = g_k - g_k-1 in m_History. */
   virtual void StoreCurrentPoint(
     const ParametersType & step,
     const DerivativeType & grad_dif );
@@ -392,11 +395,9 @@ protected:
   unsigned int                  m_PreviousT;
   unsigned int                  m_Bound;
 
-  RhoType m_Rho;
-  SType   m_S;
-  YType   m_Y;
-  RhoType m_HessianFillValue;
-  double  m_WindowScale;
+  itk::LBFGSHistory m_History;
+  RhoType           m_HessianFillValue;
+  double            m_WindowScale;
 
 private:
 
@@ -427,6 +428,7 @@ private:
   bool          m_AutomaticParameterEstimationDone;
 
   SizeValueType m_OutsideIterations;
+  bool          m_UseSinglePrecisionHistory;
 
   /** Private variables for band size estimation of covariance matrix. */
   SizeValueType m_MaxBandCovSize;
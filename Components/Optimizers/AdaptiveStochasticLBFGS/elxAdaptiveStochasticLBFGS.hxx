@@ -72,6 +72,7 @@ AdaptiveStochasticLBFGS<TElastix>
 
   this->m_LBFGSMemory = 10;
   this->m_OutsideIterations = 10;
+  this->m_UseSinglePrecisionHistory = false;
 
   this->m_CurrentT  = 0;
   this->m_PreviousT = 0;
@@ -139,6 +140,12 @@ void AdaptiveStochasticLBFGS<TElastix>
     "LBFGSMemory", this->GetComponentLabel(), level, 0 );
   this->m_LBFGSMemory = memory;
 
+  /** Set the LBFGSSinglePrecisionHistory. */
+  bool useSinglePrecisionHistory = false;
+  this->GetConfiguration()->ReadParameter( useSinglePrecisionHistory,
+    "LBFGSSinglePrecisionHistory", this->GetComponentLabel(), level, 0 );
+  this->m_UseSinglePrecisionHistory = useSinglePrecisionHistory;
+
   /** Set the updateFrequenceL. */
   SizeValueType updateFrequenceL = 5;
   this->GetConfiguration()->ReadParameter( updateFrequenceL,
@@ -379,9 +386,16 @@ AdaptiveStochasticLBFGS<TElastix>
   xl::xout["iteration"]["2:Metric"]          << this->GetValue();
   xl::xout["iteration"]["3a:Time"]           << this->GetCurrentTime();
   xl::xout["iteration"]["3b:StepSize"]       << this->GetLearningRate();
-  xl::xout["iteration"]["4a:||Gradient||"]   << this->GetGradient().magnitude();
+  const double gradientMagnitude = this->GetGradient().magnitude();
+  xl::xout["iteration"]["4a:||Gradient||"]   << gradientMagnitude;
   xl::xout["iteration"]["4b:||SearchDir||"]  << this->m_SearchDir.magnitude();
 
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), gradientMagnitude ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new spatial samples for the computation of the metric. */
   if( this->GetNewSamplesEveryIteration() )
   {
@@ -439,6 +453,8 @@ AdaptiveStochasticLBFGS<TElastix>
     break;
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition. */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
   this->m_CurrentTime = 0.0;
@@ -526,14 +542,14 @@ AdaptiveStochasticLBFGS<TElastix>
   /** Get the number of parameters; checks also if a cost function has been set at all.
    * if not: an exception is thrown.
    */
-  this->GetScaledCostFunction()->GetNumberOfParameters();
+  const unsigned int numberOfParameters
+    = this->GetScaledCostFunction()->GetNumberOfParameters();
 
-  /** Resize Rho, S and Y. */
-  this->m_Rho.SetSize( this->m_LBFGSMemory );
+  /** Allocate the history of s and y. */
+  this->m_History.Initialize( this->m_LBFGSMemory, numberOfParameters,
+    this->m_UseSinglePrecisionHistory );
   this->m_HessianFillValue.SetSize( this->m_LBFGSMemory );
   this->m_HessianFillValue.fill( 0.0 );
-  this->m_S.resize( this->m_LBFGSMemory );
-  this->m_Y.resize( this->m_LBFGSMemory );
 
   /** Initialize the scaledCostFunction with the currently set scales */
   this->InitializeScales();
@@ -604,10 +620,8 @@ AdaptiveStochasticLBFGS<TElastix>
 
   /** Update the new position. */
   const double learningRate = this->GetLearningRate();
-  for( unsigned int j = 0; j < spaceDimension; ++j )
-  {
-    newPosition[ j ] = currentPosition[ j ] - learningRate * this->m_Gradient[ j ];
-  }
+  itk::ParallelVectorOperations::ScaledAdd( currentPosition.data_block(), -learningRate,
+    this->m_Gradient.data_block(), newPosition.data_block(), spaceDimension );
 
   this->InvokeEvent( itk::IterationEvent() );
 
@@ -1643,11 +1657,9 @@ AdaptiveStochasticLBFGS<TElastix>
 {
   itkDebugMacro( "StoreCurrentPoint" );
 
-//   const double rho = 1.0 / inner_product( step, grad_dif ) ; // 1/ys
-//   const double  ys = 1.0 / rho;
-  const double  ys = inner_product( step, grad_dif ) ; // 1/ys;
-  const double rho = 1.0 / ys;
-  const double  yy = grad_dif.squared_magnitude();
+  this->m_History.SetPair( this->m_CurrentT, step.data_block(), grad_dif.data_block() );
+  const double ys = 1.0 / this->m_History.GetRho( this->m_CurrentT );
+  const double yy = this->m_History.GetSquaredNormOfY( this->m_CurrentT );
 
   double fill_value = ys / yy;
   if( fill_value < 0.0 )
@@ -1657,15 +1669,12 @@ AdaptiveStochasticLBFGS<TElastix>
     this->StopOptimization();
   }
 
-  this->m_S[ this->m_CurrentT ]   = step;     // expensive copy
-  this->m_Y[ this->m_CurrentT ]   = grad_dif; // expensive copy
-  this->m_Rho[ this->m_CurrentT ] = rho;
   this->m_HessianFillValue[ this->m_CurrentT ] = fill_value;
 
 
   elxout << "parameter difference s: " << step.magnitude() << std::endl;
   elxout << "gradient difference y: " << grad_dif.magnitude() << std::endl;
-  elxout << "rho: " << this->m_Rho[ this->m_CurrentT ] << std::endl;
+  elxout << "rho: " << this->m_History.GetRho( this->m_CurrentT ) << std::endl;
   elxout << "New H0: " << fill_value << std::endl;
 
 } // end StoreCurrentPoint()
@@ -1714,80 +1723,19 @@ AdaptiveStochasticLBFGS<TElastix>
 {
   itkDebugMacro( "ComputeSearchDirection" );
 
-  /** Assumes m_Rho, m_S, and m_Y are up-to-date at m_PreviousPoint */
-  typedef itk::Array< double > AlphaType;
-  AlphaType alpha( this->m_LBFGSMemory );
-
+  /** Assumes m_History is up-to-date at m_PreviousT */
   const unsigned int numberOfParameters = gradient.GetSize();
 
-#if 0
-  /** this step can be emitted when s y did not change. */
-  /** refine it later. */
-  // omitting probably won't save a lot of time, only a fill over the diagonal
-  DiagonalMatrixType H0;
-  this->ComputeDiagonalMatrix( H0 );
-#else
-  // We can simply only return the fill_value and completely skip the diagonal matrix construction
+  // Only the fill_value is needed, so the diagonal matrix is not constructed.
   double fill_value = 1.0;
   if( this->m_Bound > 0 )
   {
     fill_value = this->m_HessianFillValue[ this->m_PreviousT ];
   }
-#endif
-
-  // The following line constructs a new negated vector which is then
-  // copied to searchDir. The construction and copying can be avoided
-  // as searchDir is already allocated.
-  //searchDir = -gradient;
-  for( unsigned int j = 0; j < numberOfParameters; ++j )
-  {
-    searchDir[ j ] = -gradient[ j ];
-  }
 
-  int cp = static_cast< int >( this->m_CurrentT );
-
-  for( unsigned int i = 0; i < this->m_Bound; ++i )
-  {
-    --cp;
-    if( cp == -1 )
-    {
-      cp = this->m_LBFGSMemory - 1;
-    }
-    const double sq = inner_product( this->m_S[ cp ], searchDir );
-    alpha[ cp ] = this->m_Rho[ cp ] * sq;
-    const double &         alpha_cp = alpha[ cp ];
-    const DerivativeType & y        = this->m_Y[ cp ];
-    for( unsigned int j = 0; j < numberOfParameters; ++j )
-    {
-      searchDir[ j ] -= alpha_cp * y[ j ];
-    }
-  }
-
-  for( unsigned int j = 0; j < numberOfParameters; ++j )
-  {
-#if 0
-    searchDir[ j ] *= H0[ j ];
-#else
-    searchDir[ j ] *= fill_value;
-#endif
-  }
-
-  for( unsigned int i = 0; i < this->m_Bound; ++i )
-  {
-    const double           yr             = inner_product( this->m_Y[ cp ], searchDir );
-    const double           beta           = this->m_Rho[ cp ] * yr;
-    const double           alpha_min_beta = alpha[ cp ] - beta;
-    const ParametersType & s              = this->m_S[ cp ];
-    for( unsigned int j = 0; j < numberOfParameters; ++j )
-    {
-      searchDir[ j ] += alpha_min_beta * s[ j ];
-    }
-    ++cp;
-    if( static_cast< unsigned int >( cp ) == this->m_LBFGSMemory )
-    {
-      cp = 0;
-    }
-  }
+  searchDir.SetSize( numberOfParameters );
+  this->m_History.ComputeSearchDirection( gradient.data_block(),
+    fill_value, nullptr, this->m_CurrentT, this->m_Bound, searchDir.data_block() );
 
   /** Normalize if no information about previous steps is available yet */
   if( this->m_Bound == 0 )
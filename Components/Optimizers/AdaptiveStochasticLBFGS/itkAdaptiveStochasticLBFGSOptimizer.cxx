@@ -22,6 +22,7 @@
 
 #include "vnl/vnl_math.h"
 #include "itkSigmoidImageFilter.h"
+#include "itkParallelVectorOperations.h"
 
 namespace itk
 {
@@ -68,7 +69,8 @@ AdaptiveStochasticLBFGSOptimizer
     if( this->GetCurrentIteration() > 0 )
     {
       /** Formula (2) in Cruz: <g_k, g_{k-1}>. */
-      const double inprod = inner_product( this->m_PreviousGradient, this->GetGradient() );
+      const double inprod = ParallelVectorOperations::InnerProduct( this->m_PreviousGradient.data_block(),
+        this->GetGradient().data_block(), this->GetGradient().GetSize() );
       this->m_CurrentTime += sigmoid( -inprod );
       this->m_CurrentTime = std::max( 0.0, this->m_CurrentTime );
     }
@@ -84,7 +86,8 @@ AdaptiveStochasticLBFGSOptimizer
       const DerivativeType & searchDir = this->GetSearchDir();
       //const double inprod = inner_product( this->m_PreviousSearchDir,  searchDir );
       /** test <g_k, d_k>, only using the information of current gradient and search direction. */
-      const double inprod = inner_product( this->GetGradient(),  searchDir );
+      const double inprod = ParallelVectorOperations::InnerProduct( this->GetGradient().data_block(),
+        searchDir.data_block(), searchDir.GetSize() );
       this->m_CurrentTime += sigmoid( -inprod );
       this->m_CurrentTime = std::max( 0.0, this->m_CurrentTime );
     }
@@ -28,6 +28,7 @@
 #include "itkComputeDisplacementDistribution.h"
 #include "itkPlatformMultiThreader.h"
 #include "itkImageRandomSampler.h"
+#include "itkParallelVectorOperations.h"
 namespace elastix
 {
  /**
@@ -182,6 +183,22 @@ namespace elastix
   *   The parameter can be specified for each resolution, or for all resolutions at once.\n
   *   example: <tt>(NoiseCompensation "true")</tt>\n
   *   Default/recommended: true.
+  * \parameter UseNoiseFactor: Multiply the difference of the inner loop gradients by the
+  *   estimated noise factor.
+  *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+  *   example: <tt>(UseNoiseFactor "true")</tt>\n
+  *   Default: true.
+  * \parameter UseSinglePrecisionSnapshot: Store the snapshot gradient of the outer loop
+  *   in single precision, which halves its memory and the memory traffic of the inner loop.
+  *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+  *   example: <tt>(UseSinglePrecisionSnapshot "true")</tt>\n
+  *   Default: false.
+  * \parameter UseMetricSamplerForSnapshot: Compute the snapshot gradient with the image
+  *   sampler of the metric, for example a "Full" sampler, instead of with NumberOfSpatialSamples
+  *   random samples. The metric computes it with all its threads.
+  *   The parameter can be specified for each resolution, or for all resolutions at once.\n
+  *   example: <tt>(UseMetricSamplerForSnapshot "true")</tt>\n
+  *   Default: false.
   *
   * \todo: this class contains a lot of functional code, which actually does not belong here.
   *
@@ -429,6 +446,11 @@ protected:
   DerivativeType                m_ExactGradient;
   DerivativeType                m_MeanGradient;
 
+  /** The snapshot gradient, instead of m_MeanGradient, when it is stored
+   * in single precision.
+   */
+  std::vector< float >          m_SinglePrecisionMeanGradient;
+
   double                        m_NoiseFactor;
 
 private:
@@ -449,6 +471,19 @@ private:
   /** The threaded implementation of AdvanceOneStep(). */
   inline void ThreadedAdvanceOneStep( ThreadIdType threadId, ParametersType & newPosition );
 
+  /** Compute the variance reduced gradient and take a step in one pass over
+   * the parameters. On input m_Gradient holds the gradient at the snapshot
+   * position, on output the variance reduced gradient.
+   */
+  void AdvanceOneVarianceReducedStep( const DerivativeType & currentGradient );
+
+  /** The pass of AdvanceOneVarianceReducedStep(), for a snapshot gradient
+   * in double or single precision.
+   */
+  template< class TSnapshotValue >
+  void FusedVarianceReducedUpdate( const TSnapshotValue * meanGradient,
+    const DerivativeType & currentGradient );
+
   bool    m_AutomaticParameterEstimation;
   double  m_MaximumStepLength;
 
@@ -470,6 +505,8 @@ private:
   bool m_UseNoiseCompensation;
   bool m_OriginalButSigmoidToDefault;
   bool m_UseNoiseFactor;
+  bool m_UseSinglePrecisionSnapshot;
+  bool m_UseMetricSamplerForSnapshot;
 
 }; // end class AdaptiveStochasticVarianceReducedGradient
 
@@ -79,6 +79,9 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
 
   this->m_UseNoiseCompensation = true;
   this->m_OriginalButSigmoidToDefault = false;
+  this->m_UseNoiseFactor = true;
+  this->m_UseSinglePrecisionSnapshot = false;
+  this->m_UseMetricSamplerForSnapshot = false;
 
   //this->m_LearningRate = 1.0;
 } // Constructor
@@ -150,6 +153,19 @@ void AdaptiveStochasticVarianceReducedGradient<TElastix>
     "NumberOfSpatialSamples", this->GetComponentLabel(), level, 0 );
   this->m_NumberOfSpatialSamples = numberOfSpatialSamples;
 
+  /** Set whether the inner loop gradient difference is multiplied by the noise factor. */
+  this->m_UseNoiseFactor = true;
+  this->GetConfiguration()->ReadParameter( this->m_UseNoiseFactor,
+    "UseNoiseFactor", this->GetComponentLabel(), level, 0 );
+
+  /** Set how the snapshot gradient is computed and stored. */
+  this->m_UseSinglePrecisionSnapshot = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseSinglePrecisionSnapshot,
+    "UseSinglePrecisionSnapshot", this->GetComponentLabel(), level, 0 );
+  this->m_UseMetricSamplerForSnapshot = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseMetricSamplerForSnapshot,
+    "UseMetricSamplerForSnapshot", this->GetComponentLabel(), level, 0 );
+
   /** Set the gain parameter A. */
   double A = 20.0;
   this->GetConfiguration()->ReadParameter( A,
@@ -326,6 +342,12 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
     xl::xout["iteration"]["4:||Gradient||"] << this->GetGradient().magnitude();
   }
 
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), this->GetGradient().magnitude() ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new spatial samples for the computation of the metric. */
   if ( this->GetNewSamplesEveryIteration() )
   {
@@ -371,6 +393,8 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
     break;
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition. */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
   this->m_CurrentTime = 0.0;
@@ -487,13 +511,75 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
 
   /** Update the new position. */
   const double learningRate = this->GetLearningRate();
-  for( unsigned int j = 0; j < spaceDimension; ++j )
+  itk::ParallelVectorOperations::ScaledAdd( currentPosition.data_block(), -learningRate,
+    this->m_Gradient.data_block(), newPosition.data_block(), spaceDimension );
+
+  this->InvokeEvent( itk::IterationEvent() );
+}
+
+
+/**
+ * ********************** AdvanceOneVarianceReducedStep **********************
+ */
+
+template <class TElastix>
+void
+AdaptiveStochasticVarianceReducedGradient<TElastix>
+::AdvanceOneVarianceReducedStep( const DerivativeType & currentGradient )
+{
+  itkDebugMacro( "AdvanceOneVarianceReducedStep" );
+
+  if( this->m_UseSinglePrecisionSnapshot )
   {
-    newPosition[j] = currentPosition[j] - learningRate * this->m_Gradient[j];
+    this->FusedVarianceReducedUpdate( this->m_SinglePrecisionMeanGradient.data(), currentGradient );
+  }
+  else
+  {
+    this->FusedVarianceReducedUpdate( this->m_MeanGradient.data_block(), currentGradient );
   }
 
   this->InvokeEvent( itk::IterationEvent() );
-}
+
+} // end AdvanceOneVarianceReducedStep()
+
+
+/**
+ * ********************** FusedVarianceReducedUpdate **********************
+ */
+
+template <class TElastix>
+template <class TSnapshotValue>
+void
+AdaptiveStochasticVarianceReducedGradient<TElastix>
+::FusedVarianceReducedUpdate( const TSnapshotValue * meanGradient,
+  const DerivativeType & currentGradient )
+{
+  const SizeValueType spaceDimension
+    = this->GetScaledCostFunction()->GetNumberOfParameters();
+
+  /** g = noiseFactor * ( g(mu) - g(mu_snapshot) ) + g_mean(mu_snapshot),
+   * and mu = mu - a * g, where m_Gradient holds g(mu_snapshot) on input.
+   */
+  const double   noiseFactor  = this->m_UseNoiseFactor ? this->m_NoiseFactor : 1.0;
+  const double   learningRate = this->GetLearningRate();
+  const double * current      = currentGradient.data_block();
+  double *       gradient     = this->m_Gradient.data_block();
+  double *       position     = this->m_ScaledCurrentPosition.data_block();
+
+  itk::ParallelVectorOperations::ParallelizeRange( spaceDimension,
+    [noiseFactor, learningRate, meanGradient, current, gradient, position](
+      const SizeValueType begin, const SizeValueType end )
+    {
+      for( SizeValueType j = begin; j < end; ++j )
+      {
+        const double g = noiseFactor * ( current[ j ] - gradient[ j ] )
+          + static_cast< double >( meanGradient[ j ] );
+        gradient[ j ]  = g;
+        position[ j ] -= learningRate * g;
+      }
+    } );
+
+} // end FusedVarianceReducedUpdate()
 
 
 /**
@@ -536,14 +622,23 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
   SizeValueType spaceDimension
     = this->GetScaledCostFunction()->GetNumberOfParameters();
 
+  /** The gradient at the snapshot position is computed in m_Gradient, which
+   * is then overwritten by the variance reduced gradient, so that no extra
+   * full-length vector is needed for it.
+   */
   this->m_Gradient = DerivativeType( spaceDimension );   // check this
-  this->m_MeanGradient = DerivativeType( spaceDimension) ;
+  this->m_MeanGradient = this->m_UseSinglePrecisionSnapshot
+    ? DerivativeType() : DerivativeType( spaceDimension );
   DerivativeType localCurrentGradient( spaceDimension );
-  DerivativeType localPreviousGradient( spaceDimension );
 
   const unsigned int M = this->GetElastix()->GetNumberOfMetrics();
 
-  std::vector< ImageRandomSamplerBasePointer >  samplerVec( M );
+  /** The samplers of the metrics, as configured by the user. */
+  std::vector< ImageSamplerBasePointer >        samplerVec( M );
+  for( unsigned int m = 0; m < M; ++m )
+  {
+    samplerVec[ m ] = this->GetElastix()->GetElxMetricBase( m )->GetAdvancedMetricImageSampler();
+  }
   std::vector< ImageRandomSamplerPointer >      randomSamplerVec( M );
   std::vector< ImageRandomSamplerPointer >      subRandomSamplerVec( M );
   std::vector< ImageRadomSampleContainerPointer > randomSampleContainer( M );
@@ -571,10 +666,12 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
 
     for( unsigned int m = 0; m < M; ++m )
     {
-     ImageSamplerBasePointer sampler =
-       this->GetElastix()->GetElxMetricBase(m)->GetAdvancedMetricImageSampler();
-     samplerVec[ m ] =
-       dynamic_cast< ImageRandomSamplerBaseType * >( sampler.GetPointer() );
+      if( this->m_UseMetricSamplerForSnapshot )
+      {
+        this->GetElastix()->GetElxMetricBase( m )
+          ->SetAdvancedMetricImageSampler( samplerVec[ m ] );
+        continue;
+      }
 
       randomSamplerVec[ m ] = ImageRandomSamplerType::New();
       randomSamplerVec[ m ]->SetInput( samplerVec[ m ]->GetInput() );
@@ -598,7 +695,25 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
     this->GetRegistration()->GetAsITKBaseType()->GetModifiableMetric()->SetNumberOfWorkUnits(
       this->GetRegistration()->GetAsITKBaseType()->GetMetric()->GetThreader()->GetGlobalDefaultNumberOfThreads()
       );
-    this->GetScaledDerivativeWithExceptionHandling( previousPosition, this->m_MeanGradient );
+    if( this->m_UseSinglePrecisionSnapshot )
+    {
+      this->GetScaledDerivativeWithExceptionHandling( previousPosition, localCurrentGradient );
+      this->m_SinglePrecisionMeanGradient.resize( spaceDimension );
+      const double * source      = localCurrentGradient.data_block();
+      float *        destination = this->m_SinglePrecisionMeanGradient.data();
+      itk::ParallelVectorOperations::ParallelizeRange( spaceDimension,
+        [source, destination]( const SizeValueType begin, const SizeValueType end )
+        {
+          for( SizeValueType j = begin; j < end; ++j )
+          {
+            destination[ j ] = static_cast< float >( source[ j ] );
+          }
+        } );
+    }
+    else
+    {
+      this->GetScaledDerivativeWithExceptionHandling( previousPosition, this->m_MeanGradient );
+    }
     //this->GetScaledValueAndDerivative( this->GetScaledCurrentPosition() ,this->m_Value, this->m_PreviousGradient );
     timeCollector.Stop( "g1" );
 
@@ -613,11 +728,6 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
     //
     for( unsigned int m = 0; m < M; ++m )
     {
-      ImageSamplerBasePointer sampler =
-        this->GetElastix()->GetElxMetricBase(m)->GetAdvancedMetricImageSampler();
-      samplerVec[ m ] =
-        dynamic_cast< ImageRandomSamplerBaseType * >( sampler.GetPointer() );
-
       subRandomSamplerVec[ m ] = ImageRandomSamplerType::New();
 //       subRandomSamplerVec[ m ]->SetInput( randomSamplerVec[ m ] ->GetInput());
 //       subRandomSamplerVec[ m ]->SetInputImageRegion( randomSamplerVec[ m ]->
@@ -651,41 +761,14 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
 
       this->SelectNewSamples();
       timeCollector.Start( "g23" );
-      this->GetScaledDerivativeWithExceptionHandling( previousPosition, localPreviousGradient );
+      this->GetScaledDerivativeWithExceptionHandling( previousPosition, this->m_Gradient );
       this->GetScaledValueAndDerivative( this->GetScaledCurrentPosition(), this->m_Value, localCurrentGradient );
       timeCollector.Stop( "g23" );
 
-      timeCollector.Start( "gvr" );
-      //this->m_Gradient = localCurrentGradient - localPreviousGradient + this->m_PreviousGradient;
-      this->m_UseNoiseFactor = true;
-      this->GetConfiguration()->ReadParameter( this->m_UseNoiseFactor,
-        "UseNoiseFactor", this->GetComponentLabel(), 0, 0 );
-
-      if ( this->m_UseNoiseFactor )
-      {
-//         for( unsigned int j = 0; j < spaceDimension; ++j )
-//         {
-//           this->m_Gradient[j] = this->m_NoiseFactor * (localCurrentGradient[j] - localPreviousGradient[j]) + this->m_PreviousGradient[j];
-//         }
-        for( unsigned int j = 0; j < spaceDimension; ++j )
-        {
-          this->m_Gradient[j] = this->m_NoiseFactor * (localCurrentGradient[j] - localPreviousGradient[j]) + this->m_MeanGradient[j];
-        }
-      }
-      else
-      {
-        for( unsigned int j = 0; j < spaceDimension; ++j )
-        {
-          this->m_Gradient[j] = (localCurrentGradient[j] - localPreviousGradient[j]) + this->m_MeanGradient[j];
-          //this->m_Gradient[j] = this->m_PreviousGradient[j];
-        }
-      }
-
-      timeCollector.Stop( "gvr" );
-
+      /** Compute the variance reduced gradient and take the step in one pass. */
       timeCollector.Start( "step" );
       this->SetLearningRate( this->Superclass1::Compute_a( this->Superclass1::GetCurrentTime() ) );
-      this->AdvanceOneStep();
+      this->AdvanceOneVarianceReducedStep( localCurrentGradient );
       timeCollector.Stop( "step" );
 
       this->Superclass1::UpdateCurrentTime();
@@ -715,6 +798,13 @@ AdaptiveStochasticVarianceReducedGradient<TElastix>
     }
   }//end while
 
+  /** Give the metrics back their own samplers. */
+  for( unsigned int m = 0; m < M; ++m )
+  {
+    this->GetElastix()->GetElxMetricBase( m )
+      ->SetAdvancedMetricImageSampler( samplerVec[ m ] );
+  }
+
   timeCollector.Report( std::cout );
 
 } // end ResumeOptimization()
@@ -22,6 +22,7 @@
 
 #include "vnl/vnl_math.h"
 #include "itkSigmoidImageFilter.h"
+#include "itkParallelVectorOperations.h"
 
 namespace itk
 {
@@ -68,8 +69,9 @@ void AdaptiveStochasticVarianceReducedGradientOptimizer
       sigmoid.SetBeta( beta );
 
       ///** Formula (2) in Cruz */
-      const double inprod = inner_product(
-        this->m_PreviousGradient, this->GetGradient() );
+      const double inprod = ParallelVectorOperations::InnerProduct(
+        this->m_PreviousGradient.data_block(), this->GetGradient().data_block(),
+        this->GetGradient().GetSize() );
       this->m_CurrentTime += sigmoid( -inprod );
       this->m_CurrentTime = std::max( 0.0, this->m_CurrentTime );
     }
@@ -20,6 +20,7 @@
 
 #include "itkScaledSingleValuedNonLinearOptimizer.h"
 #include "itkPlatformMultiThreader.h"
+#include "itkPersistentThreadPool.h"
 
 namespace itk
 {
@@ -107,6 +107,12 @@ namespace elastix
  *    reported back in the elastix.log file. This parameter can be specified for each resolution. \n
  *    example: <tt>(UpdateBDPeriod 0 0 50)</tt> \n
  *    Default: 0 (so, automatically determined).
+ * \parameter UseCounterBasedRandomGenerator: draw the search directions with a counter-based
+ *    random generator, keyed by the Mersenne Twister at the start of each resolution, so that
+ *    they do not depend on the order in which they are drawn. This parameter can be specified
+ *    for each resolution. \n
+ *    example: <tt>(UseCounterBasedRandomGenerator "true")</tt> \n
+ *    Default: "false".
  *
  * \ingroup Optimizers
  */
@@ -160,6 +166,15 @@ public:
    * after that call the superclass' implementation */
   void StartOptimization( void ) override;
 
+  /** This optimizer supports restricting the optimization to a set of
+   * active parameters, see the UseActiveSetOfControlPoints parameter of the
+   * BSplineTransform.
+   */
+  bool GetSupportsActiveParameters( void ) const override
+  {
+    return true;
+  }
+
   /** Methods to set parameters and print output at different stages
    * in the registration process.*/
   void BeforeRegistration( void ) override;
@@ -184,6 +184,12 @@ CMAEvolutionStrategy< TElastix >
     "UpdateBDPeriod", this->GetComponentLabel(), level, 0 );
   this->SetUpdateBDPeriod( updateBDPeriod );
 
+  /** Set UseCounterBasedRandomGenerator */
+  bool useCounterBasedRandomGenerator = false;
+  this->m_Configuration->ReadParameter( useCounterBasedRandomGenerator,
+    "UseCounterBasedRandomGenerator", this->GetComponentLabel(), level, 0 );
+  this->SetUseCounterBasedRandomGenerator( useCounterBasedRandomGenerator );
+
   /** Set PositionToleranceMin */
   double positionToleranceMin = 1e-8;
   this->m_Configuration->ReadParameter( positionToleranceMin,
@@ -230,6 +236,12 @@ CMAEvolutionStrategy< TElastix >
   xout[ "iteration" ][ "5b:MaximumD" ] << this->GetCurrentMaximumD();
   xout[ "iteration" ][ "5c:MinimumD" ] << this->GetCurrentMinimumD();
 
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetCurrentValue() ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new samples if desired. These
    * will be used in the next iteration */
   if( this->GetNewSamplesEveryIteration() )
@@ -292,6 +304,8 @@ CMAEvolutionStrategy< TElastix >
       break;
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
@@ -20,6 +20,8 @@
 #define __itkCMAEvolutionStrategyOptimizer_cxx
 
 #include "itkCMAEvolutionStrategyOptimizer.h"
+#include "itkParallelVectorOperations.h"
+#include "itkPersistentThreadPool.h"
 #include "itkSymmetricEigenAnalysis.h"
 #include "vnl/vnl_math.h"
 #include <algorithm>
@@ -77,6 +79,10 @@ CMAEvolutionStrategyOptimizer::CMAEvolutionStrategyOptimizer()
   this->m_PositionToleranceMax       = 1e8;
   this->m_ValueTolerance             = 1e-12;
 
+  this->m_UseCounterBasedRandomGenerator = false;
+  this->m_CounterBasedRandomKey          = 0;
+  this->m_NumberOfDrawnSearchDirs        = 0;
+
 } // end constructor
 
 
@@ -125,6 +131,7 @@ CMAEvolutionStrategyOptimizer::PrintSelf( std::ostream & os, Indent indent ) con
   os << indent << "m_PositionToleranceMin: " << this->m_PositionToleranceMin << std::endl;
   os << indent << "m_PositionToleranceMax: " << this->m_PositionToleranceMax << std::endl;
   os << indent << "m_ValueTolerance: " << this->m_ValueTolerance << std::endl;
+  os << indent << "m_UseCounterBasedRandomGenerator: " << this->m_UseCounterBasedRandomGenerator << std::endl;
 
   os << indent << "m_RecombinationWeights: " << this->m_RecombinationWeights << std::endl;
   os << indent << "m_C: " << this->m_C << std::endl;
@@ -448,6 +455,15 @@ CMAEvolutionStrategyOptimizer::InitializeProgressVariables( void )
   this->m_CurrentMaximumD = 1.0;
   this->m_CurrentMinimumD = 1.0;
 
+  /** The key of the counter-based random generator */
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    const PhiloxRandomGenerator::KeyType high = this->m_RandomGenerator->GetIntegerVariate();
+    const PhiloxRandomGenerator::KeyType low  = this->m_RandomGenerator->GetIntegerVariate();
+    this->m_CounterBasedRandomKey = ( high << 32 ) | low;
+  }
+  this->m_NumberOfDrawnSearchDirs = 0;
+
 } // end InitializeProgressVariables
 
 
@@ -512,29 +528,35 @@ CMAEvolutionStrategyOptimizer::GenerateOffspring( void )
   /** Clear the old values */
   this->m_CostFunctionValues.clear();
 
-  /** Fill the m_NormalizedSearchDirs and SearchDirs */
-  unsigned int lam       = 0;
-  unsigned int nrOfFails = 0;
-  while( lam < lambda )
+  /** Fill the m_NormalizedSearchDirs, in the order of the members */
+  for( unsigned int lam = 0; lam < lambda; ++lam )
   {
-    /** draw from distribution N(0,I) */
-    for( unsigned int par = 0; par < N; ++par )
-    {
-      this->m_NormalizedSearchDirs[ lam ][ par ]
-        = this->m_RandomGenerator->GetNormalVariate();
-    }
-    /** Make like it was drawn from N(0,C) */
-    if( this->GetUseCovarianceMatrixAdaptation() )
-    {
-      this->m_SearchDirs[ lam ] = this->m_B * ( this->m_D * this->m_NormalizedSearchDirs[ lam ] );
-    }
-    else
+    this->DrawNormalizedSearchDir( lam );
+  }
+
+  /** Fill the m_SearchDirs. The members are independent, so the products
+   * with B and D, which cost O(N^2) each, are computed in parallel when N
+   * is large enough to benefit from it. */
+  if( static_cast< SizeValueType >( N ) * N < ParallelVectorOperations::MinimumChunkSize )
+  {
+    for( unsigned int lam = 0; lam < lambda; ++lam )
     {
-      this->m_SearchDirs[ lam ] = this->m_NormalizedSearchDirs[ lam ];
+      this->ComputeSearchDir( lam );
     }
-    /** Make like it was drawn from N( 0, sigma^2 C ) */
-    this->m_SearchDirs[ lam ] *= this->m_CurrentSigma;
+  }
+  else
+  {
+    PersistentThreadPool::GetInstance()->SingleMethodExecute(
+      lambda, Self::ComputeSearchDirsThreaderCallback, this );
+  }
 
+  /** Compute the cost function values. The cost function sets the parameters
+   * of the transform, so the members cannot be evaluated concurrently; each
+   * evaluation is multi-threaded over the samples instead. */
+  unsigned int lam       = 0;
+  unsigned int nrOfFails = 0;
+  while( lam < lambda )
+  {
     /** Compute the cost function */
     MeasureType costFunctionValue = 0.0;
     /** x_lam = m + d_lam */
@@ -550,6 +572,8 @@ CMAEvolutionStrategyOptimizer::GenerateOffspring( void )
       /** try another parameter vector if we haven't tried that for 10 times already */
       if( nrOfFails <= 10 )
       {
+        this->DrawNormalizedSearchDir( lam );
+        this->ComputeSearchDir( lam );
         continue;
       }
       else
@@ -573,6 +597,75 @@ CMAEvolutionStrategyOptimizer::GenerateOffspring( void )
 } // end GenerateOffspring
 
 
+/**
+ * ****************** DrawNormalizedSearchDir *********************
+ */
+
+void
+CMAEvolutionStrategyOptimizer::DrawNormalizedSearchDir( const unsigned int lam )
+{
+  /** draw from distribution N(0,I) */
+  const unsigned int N = this->m_NormalizedSearchDirs[ lam ].GetSize();
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    /** Number the directions by a running count rather than by lam, since
+     * a direction that gave an invalid cost function value is redrawn. */
+    PhiloxRandomGenerator::FillNormalVariates( this->m_CounterBasedRandomKey,
+      this->m_NumberOfDrawnSearchDirs, 0, N,
+      this->m_NormalizedSearchDirs[ lam ].data_block() );
+    ++this->m_NumberOfDrawnSearchDirs;
+    return;
+  }
+
+  for( unsigned int par = 0; par < N; ++par )
+  {
+    this->m_NormalizedSearchDirs[ lam ][ par ]
+      = this->m_RandomGenerator->GetNormalVariate();
+  }
+
+} // end DrawNormalizedSearchDir
+
+
+/**
+ * ****************** ComputeSearchDir *********************
+ */
+
+void
+CMAEvolutionStrategyOptimizer::ComputeSearchDir( const unsigned int lam )
+{
+  /** Make like it was drawn from N(0,C) */
+  if( this->GetUseCovarianceMatrixAdaptation() )
+  {
+    this->m_SearchDirs[ lam ] = this->m_B * ( this->m_D * this->m_NormalizedSearchDirs[ lam ] );
+  }
+  else
+  {
+    this->m_SearchDirs[ lam ] = this->m_NormalizedSearchDirs[ lam ];
+  }
+  /** Make like it was drawn from N( 0, sigma^2 C ) */
+  this->m_SearchDirs[ lam ] *= this->m_CurrentSigma;
+
+} // end ComputeSearchDir
+
+
+/**
+ * ****************** ComputeSearchDirsThreaderCallback *********************
+ */
+
+ITK_THREAD_RETURN_TYPE
+CMAEvolutionStrategyOptimizer::ComputeSearchDirsThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  Self * self = static_cast< Self * >( infoStruct->UserData );
+
+  self->ComputeSearchDir( infoStruct->WorkUnitID );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end ComputeSearchDirsThreaderCallback
+
+
 /**
  * ****************** SortCostFunctionValues *********************
  */
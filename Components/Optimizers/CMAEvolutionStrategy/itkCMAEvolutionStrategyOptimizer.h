@@ -27,6 +27,8 @@
 #include "itkArray.h"
 #include "itkArray2D.h"
 #include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkPhiloxRandomGenerator.h"
+#include "itkMultiThreaderBase.h"
 #include "vnl/vnl_diag_matrix.h"
 
 namespace itk
@@ -172,6 +174,15 @@ public:
   itkSetClampMacro( SigmaDecayAlpha, double, 0.0, 1.0 );
   itkGetConstMacro( SigmaDecayAlpha, double );
 
+  /** Setting: draw the search directions with the counter-based
+   * PhiloxRandomGenerator instead of the Mersenne Twister. Every search
+   * direction is then a function of a key, drawn from the Mersenne Twister
+   * at the start of the optimization, and the number of directions drawn
+   * before it, so it does not depend on the order in which it is drawn.
+   * Default: false */
+  itkSetMacro( UseCounterBasedRandomGenerator, bool );
+  itkGetConstMacro( UseCounterBasedRandomGenerator, bool );
+
   /** Setting: whether the covariance matrix adaptation scheme should be used.
    * Default: true. If false: CovMatrix = Identity.
    * This parameter may be changed by the optimiser, if it sees that the
@@ -236,6 +247,11 @@ protected:
   /** The random number generator used to generate the offspring. */
   RandomGeneratorType::Pointer m_RandomGenerator;
 
+  /** The key and the number of search directions drawn, used when the
+   * counter-based random generator is selected. */
+  PhiloxRandomGenerator::KeyType m_CounterBasedRandomKey;
+  unsigned long                  m_NumberOfDrawnSearchDirs;
+
   /** The value of the cost function at the current position */
   MeasureType m_CurrentValue;
 
@@ -355,9 +371,18 @@ protected:
   virtual void InitializeBCD( void );
 
   /** GenerateOffspring: Fill m_SearchDirs, m_NormalizedSearchDirs,
-   * and m_CostFunctionValues */
+   * and m_CostFunctionValues. The search directions of the whole population
+   * are computed in parallel; the cost function values are computed one
+   * after the other, since the cost function is not reentrant. */
   virtual void GenerateOffspring( void );
 
+  /** Draw m_NormalizedSearchDirs[ lam ] from N(0,I) */
+  virtual void DrawNormalizedSearchDir( const unsigned int lam );
+
+  /** Compute m_SearchDirs[ lam ] from m_NormalizedSearchDirs[ lam ], such
+   * that it is like drawn from N( 0, sigma^2 C ) */
+  virtual void ComputeSearchDir( const unsigned int lam );
+
   /** Sort the m_CostFunctionValues vector and update m_MeasureHistory */
   virtual void SortCostFunctionValues( void );
 
@@ -410,6 +435,9 @@ private:
   CMAEvolutionStrategyOptimizer( const Self & ); // purposely not implemented
   void operator=( const Self & );                // purposely not implemented
 
+  /** Compute the search direction of the population member of a work unit. */
+  static ITK_THREAD_RETURN_TYPE ComputeSearchDirsThreaderCallback( void * arg );
+
   /** Settings that are only inspected/changed by the associated get/set member functions. */
   unsigned long m_MaximumNumberOfIterations;
   bool          m_UseDecayingSigma;
@@ -422,6 +450,7 @@ private:
   double        m_PositionToleranceMax;
   double        m_PositionToleranceMin;
   double        m_ValueTolerance;
+  bool          m_UseCounterBasedRandomGenerator;
 
 };
 
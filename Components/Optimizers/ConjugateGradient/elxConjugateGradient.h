@@ -63,6 +63,13 @@ namespace elastix
  *    itk::MoreThuenteLineSearchOptimizer tries to satisfy.\n
  *    example: <tt>(LineSearchGradientTolerance 0.9 0.9 0.9)</tt> \n
  *    Default value: 0.9.\n
+ * \parameter LineSearchNumberOfConcurrentStepLengths: The number of step lengths
+ *    that the itk::MoreThuenteLineSearchOptimizer evaluates concurrently in each
+ *    line search iteration. Values of 2 to 4 save line search iterations, but only
+ *    pay off for metrics that compute several values and derivatives concurrently,
+ *    such as the AdvancedMeanSquares.\n
+ *    example: <tt>(LineSearchNumberOfConcurrentStepLengths 3 3 3)</tt> \n
+ *    Default value: 1, which evaluates one step length at a time.\n
  * \parameter ValueTolerance: Stopping criterion. See the documentation of the
  *    itk::GenericConjugateGradientOptimizer for more information.\n
  *    example: <tt>(ValueTolerance 0.001 0.0001 0.000001)</tt> \n
@@ -142,6 +149,15 @@ public:
    * after that call the superclass' implementation */
   void StartOptimization( void ) override;
 
+  /** This optimizer supports restricting the optimization to a set of
+   * active parameters, see the UseActiveSetOfControlPoints parameter of the
+   * BSplineTransform.
+   */
+  bool GetSupportsActiveParameters( void ) const override
+  {
+    return true;
+  }
+
   /** Methods to set parameters and print output at different stages
    * in the registration process.*/
   void BeforeRegistration( void ) override;
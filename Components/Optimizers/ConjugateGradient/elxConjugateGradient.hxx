@@ -261,6 +261,12 @@ ConjugateGradient< TElastix >
     "LineSearchGradientTolerance", this->GetComponentLabel(), level, 0 );
   this->m_LineOptimizer->SetGradientTolerance( lineSearchGradientTolerance );
 
+  /** Set the LineSearchNumberOfConcurrentStepLengths */
+  unsigned int lineSearchNumberOfConcurrentStepLengths = 1;
+  this->m_Configuration->ReadParameter( lineSearchNumberOfConcurrentStepLengths,
+    "LineSearchNumberOfConcurrentStepLengths", this->GetComponentLabel(), level, 0 );
+  this->m_LineOptimizer->SetNumberOfConcurrentStepLengths( lineSearchNumberOfConcurrentStepLengths );
+
   /** Set the GradientMagnitudeTolerance */
   double gradientMagnitudeTolerance = 0.000001;
   this->m_Configuration->ReadParameter( gradientMagnitudeTolerance,
@@ -378,6 +384,13 @@ ConjugateGradient< TElastix >
 
   if( !( this->GetInLineSearch() ) )
   {
+    /** Stop after a main iteration if one of the convergence criteria is met. */
+    if( this->TestConvergenceCriteria( this->GetCurrentValue(),
+      this->GetCurrentGradient().magnitude() ) )
+    {
+      this->StopOptimization();
+    }
+
     /** Set the initial step length estimate for the next line search
      * to the result of the last iteration */
     this->m_LineOptimizer->SetInitialStepLengthEstimate(
@@ -467,6 +480,8 @@ ConjugateGradient< TElastix >
     }
   } // end else
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
@@ -177,6 +177,13 @@ ConjugateGradientFRPR< TElastix >
   {
     xl::xout[ "iteration" ][ "3:StepLength" ] << this->GetCurrentStepLength();
     xl::xout[ "iteration" ][ "4a:||Gradient||" ] << this->GetCurrentDerivativeMagnitude();
+
+    /** Stop after a main iteration if one of the convergence criteria is met. */
+    if( this->TestConvergenceCriteria( this->GetValue(),
+      this->GetCurrentDerivativeMagnitude() ) )
+    {
+      this->StopOptimization();
+    }
   }
   else
   {
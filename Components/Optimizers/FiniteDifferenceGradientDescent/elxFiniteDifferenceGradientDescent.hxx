@@ -137,6 +137,16 @@ FiniteDifferenceGradientDescent< TElastix >
   xl::xout[ "iteration" ][ "3:Gain a_k" ] << this->GetLearningRate();
   xl::xout[ "iteration" ][ "4:||Gradient||" ] << this->GetGradientMagnitude();
 
+  /** Stop if one of the convergence criteria is met. The metric value
+   * is only known if it is shown.
+   */
+  const double value = this->m_ShowMetricValues
+    ? this->GetValue() : std::numeric_limits< double >::quiet_NaN();
+  if( this->TestConvergenceCriteria( value, this->GetGradientMagnitude() ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new spatial samples for the computation of the metric
    * \todo You may also choose to select new samples after evaluation
    * of the metric value */
@@ -179,6 +189,9 @@ FiniteDifferenceGradientDescent< TElastix >
       break;
 
   }
+
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
 
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
@@ -23,6 +23,9 @@
 #include "itkCommand.h"
 #include "itkEventObject.h"
 #include "itkMacro.h"
+#include "itkPersistentThreadPool.h"
+
+#include <algorithm>
 
 #include "math.h"
 #include "vnl/vnl_math.h"
@@ -127,8 +130,15 @@ FiniteDifferenceGradientDescentOptimizer
   unsigned int spaceDimension = 1;
 
   ParametersType param;
-  double         valueplus;
-  double         valuemin;
+
+  /** The perturbed parameter vectors of a batch of parameters, which the
+   * cost function may evaluate concurrently. A batch is limited to a few
+   * parameters per thread, to bound the memory of the parameter vectors.
+   */
+  ScaledCostFunctionType::ParametersVectorType perturbedParameters;
+  ScaledCostFunctionType::MeasureVectorType    perturbedValues;
+  const unsigned int                           numberOfParametersPerBatch
+    = PersistentThreadPool::GetInstance()->GetMaximumNumberOfThreads();
 
   InvokeEvent( StartEvent() );
   while( !this->m_Stop )
@@ -168,20 +178,29 @@ FiniteDifferenceGradientDescentOptimizer
     /** Calculate the derivative; this may take a while... */
     try
     {
-      for( unsigned int j = 0; j < spaceDimension; j++ )
+      for( unsigned int jbegin = 0; jbegin < spaceDimension; jbegin += numberOfParametersPerBatch )
       {
-        param[ j ] += ck;
-        valueplus   = this->GetScaledValue( param );
-        param[ j ] -= 2.0 * ck;
-        valuemin    = this->GetScaledValue( param );
-        param[ j ] += ck;
-
-        const double gradient = ( valueplus - valuemin ) / ( 2.0 * ck );
-        this->m_Gradient[ j ] = gradient;
-
-        sumOfSquaredGradients += ( gradient * gradient );
-
-      }   // for j = 0 .. spaceDimension
+        const unsigned int jend = std::min( jbegin + numberOfParametersPerBatch, spaceDimension );
+        perturbedParameters.assign( 2 * ( jend - jbegin ), param );
+        for( unsigned int j = jbegin; j < jend; j++ )
+        {
+          perturbedParameters[ 2 * ( j - jbegin ) ][ j ]     += ck;
+          perturbedParameters[ 2 * ( j - jbegin ) + 1 ][ j ] -= ck;
+        }
+        this->GetScaledValues( perturbedParameters, perturbedValues );
+
+        for( unsigned int j = jbegin; j < jend; j++ )
+        {
+          const double valueplus = perturbedValues[ 2 * ( j - jbegin ) ];
+          const double valuemin  = perturbedValues[ 2 * ( j - jbegin ) + 1 ];
+
+          const double gradient = ( valueplus - valuemin ) / ( 2.0 * ck );
+          this->m_Gradient[ j ] = gradient;
+
+          sumOfSquaredGradients += ( gradient * gradient );
+        }
+
+      }   // for jbegin = 0 .. spaceDimension
     }
     catch( ExceptionObject & err )
     {
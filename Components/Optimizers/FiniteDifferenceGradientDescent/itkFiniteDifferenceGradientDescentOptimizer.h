@@ -45,6 +45,10 @@ namespace itk
  *
  * \f[ c(k) =  c / (k + 1)^{\gamma}. \f]
  *
+ * The perturbed parameter vectors of a batch of parameters are passed to the
+ * cost function in one call of GetScaledValues(), so that a cost function that
+ * supports it can evaluate them concurrently.
+ *
  * Note the similarities to the SimultaneousPerturbation optimizer and
  * the StandardGradientDescent optimizer.
  *
@@ -20,6 +20,7 @@
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
 #include "itkFullSearchOptimizer.h"
+#include <fstream>
 #include <map>
 
 #include "itkNDImageBase.h"
@@ -37,7 +38,9 @@ namespace elastix
  * The results are written to the output-directory as an image
  * OptimizationSurface.\<elastixlevel\>.R\<resolution\>.mhd",
  * which is an N-dimensional float image, where N is the
- * dimension of the search space.
+ * dimension of the search space. In the mhd format the values are
+ * streamed to disk while searching, so that the image is not held in
+ * memory. Points that are not evaluated get the value NaN.
  *
  * The parameters used in this class are:
  * \parameter Optimizer: Select this optimizer as follows:\n
@@ -48,6 +51,16 @@ namespace elastix
  *   This varies the second transform parameter in the range [-4.0 3.0] with steps of 1.0
  *   and the third parameter in the range [-1.0 1.0] with steps of 0.5. The names are used
  *   as column headers in the screen output.
+ * \parameter NumberOfCoarseToFineLevels: The number of levels L of the coarse-to-fine search.
+ *   The search starts with every 2^L-th point in each dimension, and halves the step at each
+ *   following level, only around the best point so far. 0 means that all points are evaluated.
+ *   Can be given for each resolution.\n
+ *   example: <tt>(NumberOfCoarseToFineLevels 2)</tt> \n
+ *   Default: 0.
+ * \parameter WriteOptimizationSurfaceEachResolution: Whether the optimization surface is
+ *   written to disk. The surface is only computed when it is written.\n
+ *   example: <tt>(WriteOptimizationSurfaceEachResolution "true")</tt> \n
+ *   Default: false.
  *
  * \ingroup Optimizers
  * \sa FullSearchOptimizer
@@ -138,6 +151,20 @@ protected:
 
   DimensionNameMapType m_SearchSpaceDimensionNames;
 
+  /** The optimization surface, streamed to disk in the mhd format. */
+  bool          m_WriteOptimizationSurface;
+  bool          m_StreamOptimizationSurface;
+  std::string   m_OptimizationSurfaceFileName;
+  std::ofstream m_OptimizationSurfaceStream;
+
+  /** Write the header of the streamed optimization surface, and fill its raw
+   * data file with NaN.
+   */
+  virtual void CreateOptimizationSurfaceStream( void );
+
+  /** Write the current value at the current index to the raw data file. */
+  virtual void StreamCurrentValue( void );
+
   /** Checks if an error generated while reading the search space
    * ranges from the parameter file is a real error. Prints some
    * error message if so.
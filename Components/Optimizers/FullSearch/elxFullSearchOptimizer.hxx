@@ -19,9 +19,13 @@
 #define __elxFullSearchOptimizer_hxx
 
 #include "elxFullSearchOptimizer.h"
+#include "itkByteSwapper.h"
+#include <algorithm>
 #include <iomanip>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <vector>
 #include "vnl/vnl_math.h"
 
 namespace elastix
@@ -35,7 +39,9 @@ template< class TElastix >
 FullSearch< TElastix >
 ::FullSearch()
 {
-  this->m_OptimizationSurface = 0;
+  this->m_OptimizationSurface       = 0;
+  this->m_WriteOptimizationSurface  = false;
+  this->m_StreamOptimizationSurface = false;
 
 } // end Constructor
 
@@ -168,17 +174,16 @@ FullSearch< TElastix >
     /** The number of dimensions. */
     nrOfSearchSpaceDimensions = this->GetNumberOfSearchSpaceDimensions();
 
-    /** Create the image that will store the results of the full search. */
-    this->m_OptimizationSurface
-      = NDImageType::NewNDImage( nrOfSearchSpaceDimensions );
-    this->m_OptimizationSurface->CreateNewImage();
-    /** \todo don't do this if more than max allowable dimensions. */
+    /** Set the number of coarse-to-fine levels. */
+    unsigned int numberOfCoarseToFineLevels = 0;
+    this->GetConfiguration()->ReadParameter( numberOfCoarseToFineLevels,
+      "NumberOfCoarseToFineLevels", this->GetComponentLabel(), level, 0 );
+    this->SetNumberOfCoarseToFineLevels( numberOfCoarseToFineLevels );
 
-    /** Set the correct size and allocate memory. */
-    this->m_OptimizationSurface->SetRegions(
-      this->GetSearchSpaceSize() );
-    this->m_OptimizationSurface->Allocate();
-    /** \todo try/catch block around Allocate? */
+    /** The optimization surface is only computed when it is written. */
+    this->m_WriteOptimizationSurface = false;
+    this->GetConfiguration()->ReadParameter( this->m_WriteOptimizationSurface,
+      "WriteOptimizationSurfaceEachResolution", 0, false );
 
     /** Set the name of this image on disk. */
     std::string resultImageFormat = "mhd";
@@ -191,12 +196,52 @@ FullSearch< TElastix >
       << this->GetConfiguration()->GetElastixLevel()
       << ".R" << level
       << "." << resultImageFormat;
-    this->m_OptimizationSurface->SetOutputFileName( makeString.str().c_str() );
+    this->m_OptimizationSurfaceFileName = makeString.str();
+
+    /** In the mhd format the surface is streamed to disk, other formats
+     * need the image in memory.
+     */
+    this->m_OptimizationSurface       = 0;
+    this->m_StreamOptimizationSurface = this->m_WriteOptimizationSurface
+      && resultImageFormat == "mhd";
+    if( this->m_StreamOptimizationSurface )
+    {
+      this->CreateOptimizationSurfaceStream();
+    }
+    else if( this->m_WriteOptimizationSurface )
+    {
+      /** Create the image that will store the results of the full search. */
+      this->m_OptimizationSurface
+        = NDImageType::NewNDImage( nrOfSearchSpaceDimensions );
+      this->m_OptimizationSurface->CreateNewImage();
+      /** \todo don't do this if more than max allowable dimensions. */
+
+      /** Set the correct size and allocate memory. */
+      this->m_OptimizationSurface->SetRegions(
+        this->GetSearchSpaceSize() );
+      this->m_OptimizationSurface->Allocate();
+      this->m_OptimizationSurface->FillBuffer(
+        std::numeric_limits< float >::quiet_NaN() );
+      /** \todo try/catch block around Allocate? */
+
+      this->m_OptimizationSurface->SetOutputFileName(
+        this->m_OptimizationSurfaceFileName.c_str() );
+    }
 
-    elxout
-      << "Total number of iterations needed in this resolution: "
-      << this->GetNumberOfIterations()
-      << "." << std::endl;
+    if( numberOfCoarseToFineLevels > 0 )
+    {
+      elxout
+        << "Maximum number of iterations in this resolution: "
+        << this->GetNumberOfIterations()
+        << "." << std::endl;
+    }
+    else
+    {
+      elxout
+        << "Total number of iterations needed in this resolution: "
+        << this->GetNumberOfIterations()
+        << "." << std::endl;
+    }
 
   }
   else
@@ -220,8 +265,15 @@ FullSearch< TElastix >
   /** Print some information. */
   xl::xout[ "iteration" ][ "2:Metric" ] << this->GetValue();
 
-  this->m_OptimizationSurface->SetPixel(
-    this->GetCurrentIndexInSearchSpace(), this->GetValue() );
+  if( this->m_StreamOptimizationSurface )
+  {
+    this->StreamCurrentValue();
+  }
+  else if( this->m_OptimizationSurface )
+  {
+    this->m_OptimizationSurface->SetPixel(
+      this->GetCurrentIndexInSearchSpace(), this->GetValue() );
+  }
 
   SearchSpacePointType currentPoint = this->GetCurrentPointInSearchSpace();
   unsigned int         nrOfSSDims   = currentPoint.GetSize();
@@ -258,6 +310,10 @@ FullSearch< TElastix >
       stopcondition = "Error in metric";
       break;
 
+    case CoarseToFineSearchFinished:
+      stopcondition = "The coarse-to-fine search has finished";
+      break;
+
     default:
       stopcondition = "Unknown";
       break;
@@ -267,10 +323,27 @@ FullSearch< TElastix >
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
   /** Write the optimization surface to disk */
-  bool writeSurfaceEachResolution = false;
-  this->GetConfiguration()->ReadParameter( writeSurfaceEachResolution,
-      "WriteOptimizationSurfaceEachResolution", 0, false );
-  if( writeSurfaceEachResolution )
+  if( this->m_StreamOptimizationSurface )
+  {
+    this->m_OptimizationSurfaceStream.close();
+    if( this->m_OptimizationSurfaceStream.fail() )
+    {
+      xl::xout[ "error" ]
+        << "ERROR: Saving "
+        << this->m_OptimizationSurfaceFileName
+        << " failed."
+        << std::endl;
+      // do not throw an error, since we would like to go on.
+    }
+    else
+    {
+      elxout
+        << "\nThe scanned optimization surface is saved as: "
+        << this->m_OptimizationSurfaceFileName
+        << std::endl;
+    }
+  }
+  else if( this->m_OptimizationSurface )
   {
     try
     {
@@ -351,6 +424,105 @@ FullSearch< TElastix >
 } // end AfterRegistration()
 
 
+/**
+ * ************ CreateOptimizationSurfaceStream *****************
+ */
+
+template< class TElastix >
+void
+FullSearch< TElastix >
+::CreateOptimizationSurfaceStream( void )
+{
+  const SearchSpaceSizeType & searchSpaceSize = this->GetSearchSpaceSize();
+  const unsigned int          nrOfSSDims      = searchSpaceSize.GetSize();
+
+  /** The raw data file is stored next to the header, which ends with ".mhd". */
+  const std::string rawFileName = this->m_OptimizationSurfaceFileName.substr(
+    0, this->m_OptimizationSurfaceFileName.size() - 4 ) + ".raw";
+
+  /** Write the header, with unit spacing and zero origin, like the NDImage. */
+  std::ofstream header( this->m_OptimizationSurfaceFileName.c_str() );
+  header << "ObjectType = Image\n"
+         << "NDims = " << nrOfSSDims << "\n"
+         << "BinaryData = True\n"
+         << "BinaryDataByteOrderMSB = "
+         << ( itk::ByteSwapper< float >::SystemIsBigEndian() ? "True" : "False" ) << "\n"
+         << "CompressedData = False\n"
+         << "DimSize =";
+  for( unsigned int dim = 0; dim < nrOfSSDims; dim++ )
+  {
+    header << " " << searchSpaceSize[ dim ];
+  }
+  header << "\nElementSpacing =";
+  for( unsigned int dim = 0; dim < nrOfSSDims; dim++ )
+  {
+    header << " 1";
+  }
+  header << "\nOffset =";
+  for( unsigned int dim = 0; dim < nrOfSSDims; dim++ )
+  {
+    header << " 0";
+  }
+  header << "\nElementType = MET_FLOAT\n"
+         << "ElementDataFile = " << itksys::SystemTools::GetFilenameName( rawFileName ) << "\n";
+  header.close();
+
+  /** Fill the raw data with NaN, in chunks, for the points that are not evaluated. */
+  itk::SizeValueType numberOfPoints = this->GetNumberOfIterations();
+  this->m_OptimizationSurfaceStream.open( rawFileName.c_str(),
+    std::ios::out | std::ios::binary | std::ios::trunc );
+  const std::vector< float > chunk( std::min< itk::SizeValueType >( numberOfPoints, 65536 ),
+    std::numeric_limits< float >::quiet_NaN() );
+  while( numberOfPoints > 0 && this->m_OptimizationSurfaceStream )
+  {
+    const itk::SizeValueType chunkSize = std::min< itk::SizeValueType >( numberOfPoints, chunk.size() );
+    this->m_OptimizationSurfaceStream.write(
+      reinterpret_cast< const char * >( chunk.data() ), chunkSize * sizeof( float ) );
+    numberOfPoints -= chunkSize;
+  }
+
+  if( header.fail() || this->m_OptimizationSurfaceStream.fail() )
+  {
+    xl::xout[ "error" ]
+      << "ERROR: Creating "
+      << this->m_OptimizationSurfaceFileName
+      << " failed. The optimization surface is not saved."
+      << std::endl;
+    this->m_OptimizationSurfaceStream.close();
+    this->m_StreamOptimizationSurface = false;
+  }
+
+} // end CreateOptimizationSurfaceStream()
+
+
+/**
+ * ******************* StreamCurrentValue ***********************
+ */
+
+template< class TElastix >
+void
+FullSearch< TElastix >
+::StreamCurrentValue( void )
+{
+  /** The offset in the raw data, with the first dimension running fastest. */
+  const SearchSpaceIndexType & index           = this->GetCurrentIndexInSearchSpace();
+  const SearchSpaceSizeType &  searchSpaceSize = this->GetSearchSpaceSize();
+  itk::SizeValueType           linearIndex     = 0;
+  itk::SizeValueType           offset          = 1;
+  for( unsigned int dim = 0; dim < index.GetSize(); dim++ )
+  {
+    linearIndex += static_cast< itk::SizeValueType >( index[ dim ] ) * offset;
+    offset      *= searchSpaceSize[ dim ];
+  }
+
+  const float value = static_cast< float >( this->GetValue() );
+  this->m_OptimizationSurfaceStream.seekp( linearIndex * sizeof( float ) );
+  this->m_OptimizationSurfaceStream.write(
+    reinterpret_cast< const char * >( &value ), sizeof( float ) );
+
+} // end StreamCurrentValue()
+
+
 /**
  * ************ CheckSearchSpaceRangeDefinition *****************
  */
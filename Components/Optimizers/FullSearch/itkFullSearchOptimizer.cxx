@@ -25,6 +25,8 @@
 #include "itkMacro.h"
 #include "itkNumericTraits.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
@@ -45,6 +47,7 @@ FullSearchOptimizer
   m_NumberOfSearchSpaceDimensions = 0;
   m_SearchSpace                   = 0;
   m_LastSearchSpaceChanges        = 0;
+  m_NumberOfCoarseToFineLevels    = 0;
 
 }   //end constructor
 
@@ -98,39 +101,22 @@ FullSearchOptimizer
   m_Stop = false;
 
   InvokeEvent( StartEvent() );
-  while( !m_Stop )
-  {
 
-    try
-    {
-      m_Value = m_CostFunction->GetValue( this->GetCurrentPosition() );
-    }
-    catch( ExceptionObject & err )
-    {
-      // An exception has occurred.
-      // Terminate immediately.
-      m_StopCondition = MetricError;
-      StopOptimization();
+  if( m_NumberOfCoarseToFineLevels > 0 )
+  {
+    this->CoarseToFineSearch();
+    return;
+  }
 
-      // Pass exception to caller
-      throw err;
-    }
+  while( !m_Stop )
+  {
+    this->EvaluateCurrentPosition();
 
     if( m_Stop )
     {
       break;
     }
 
-    /** Check if the value is a minimum or maximum */
-    if( ( m_Value < m_BestValue )  ^  m_Maximize )         // ^ = xor, yields true if only one of the expressions is true
-    {
-      m_BestValue              = m_Value;
-      m_BestPointInSearchSpace = m_CurrentPointInSearchSpace;
-      m_BestIndexInSearchSpace = m_CurrentIndexInSearchSpace;
-    }
-
-    this->InvokeEvent( IterationEvent() );
-
     /** Prepare for next step */
     m_CurrentIteration++;
 
@@ -149,6 +135,159 @@ FullSearchOptimizer
 }   //end function ResumeOptimization
 
 
+/**
+ * ******************** EvaluateCurrentPosition ******************
+ */
+void
+FullSearchOptimizer
+::EvaluateCurrentPosition( void )
+{
+  try
+  {
+    m_Value = m_CostFunction->GetValue( this->GetCurrentPosition() );
+  }
+  catch( ExceptionObject & err )
+  {
+    // An exception has occurred.
+    // Terminate immediately.
+    m_StopCondition = MetricError;
+    StopOptimization();
+
+    // Pass exception to caller
+    throw err;
+  }
+
+  if( m_Stop )
+  {
+    return;
+  }
+
+  /** Check if the value is a minimum or maximum */
+  if( ( m_Value < m_BestValue )  ^  m_Maximize )         // ^ = xor, yields true if only one of the expressions is true
+  {
+    m_BestValue              = m_Value;
+    m_BestPointInSearchSpace = m_CurrentPointInSearchSpace;
+    m_BestIndexInSearchSpace = m_CurrentIndexInSearchSpace;
+  }
+
+  this->InvokeEvent( IterationEvent() );
+
+} // end function EvaluateCurrentPosition
+
+
+/**
+ * ******************** CoarseToFineSearch ***********************
+ */
+void
+FullSearchOptimizer
+::CoarseToFineSearch( void )
+{
+  const unsigned int          searchSpaceDimension = this->GetNumberOfSearchSpaceDimensions();
+  const SearchSpaceSizeType & searchSpaceSize      = this->GetSearchSpaceSize();
+
+  VisitedIndicesType   visited;
+  CandidateIndicesType candidates( searchSpaceDimension );
+
+  /** The coarsest level: every stride-th index in each dimension. */
+  const unsigned int numberOfLevels = std::min( m_NumberOfCoarseToFineLevels, 30u );
+  IndexValueType     stride         = static_cast< IndexValueType >( 1 ) << numberOfLevels;
+  for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+  {
+    const IndexValueType size = static_cast< IndexValueType >( searchSpaceSize[ ssdim ] );
+    for( IndexValueType index = 0; index < size; index += stride )
+    {
+      candidates[ ssdim ].push_back( index );
+    }
+  }
+  this->EvaluateCandidates( candidates, visited );
+
+  /** The finer levels: half the stride, within one coarse stride of the best point. */
+  while( stride > 1 && !m_Stop )
+  {
+    const IndexValueType coarseStride = stride;
+    stride /= 2;
+    for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+    {
+      const IndexValueType size = static_cast< IndexValueType >( searchSpaceSize[ ssdim ] );
+      const IndexValueType best = m_BestIndexInSearchSpace[ ssdim ];
+      candidates[ ssdim ].clear();
+      for( IndexValueType index = best - coarseStride; index <= best + coarseStride; index += stride )
+      {
+        if( index >= 0 && index < size )
+        {
+          candidates[ ssdim ].push_back( index );
+        }
+      }
+    }
+    this->EvaluateCandidates( candidates, visited );
+  }
+
+  if( !m_Stop )
+  {
+    m_StopCondition = CoarseToFineSearchFinished;
+    StopOptimization();
+  }
+
+} // end function CoarseToFineSearch
+
+
+/**
+ * ******************** EvaluateCandidates ***********************
+ */
+void
+FullSearchOptimizer
+::EvaluateCandidates( const CandidateIndicesType & candidates,
+  VisitedIndicesType & visited )
+{
+  const unsigned int          searchSpaceDimension = this->GetNumberOfSearchSpaceDimensions();
+  const SearchSpaceSizeType & searchSpaceSize      = this->GetSearchSpaceSize();
+
+  for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+  {
+    if( candidates[ ssdim ].empty() )
+    {
+      return;
+    }
+  }
+
+  /** Loop over all combinations, with the first dimension running fastest. */
+  std::vector< std::size_t > position( searchSpaceDimension, 0 );
+  bool                       finished = false;
+  while( !finished && !m_Stop )
+  {
+    SizeValueType linearIndex = 0;
+    SizeValueType offset      = 1;
+    for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+    {
+      m_CurrentIndexInSearchSpace[ ssdim ] = candidates[ ssdim ][ position[ ssdim ] ];
+      linearIndex += static_cast< SizeValueType >( m_CurrentIndexInSearchSpace[ ssdim ] ) * offset;
+      offset      *= searchSpaceSize[ ssdim ];
+    }
+
+    if( visited.insert( linearIndex ).second )
+    {
+      m_CurrentPointInSearchSpace = this->IndexToPoint( m_CurrentIndexInSearchSpace );
+      this->SetCurrentPosition( this->PointToPosition( m_CurrentPointInSearchSpace ) );
+      this->EvaluateCurrentPosition();
+      m_CurrentIteration++;
+    }
+
+    /** Go to the next combination. */
+    finished = true;
+    for( unsigned int ssdim = 0; ssdim < searchSpaceDimension; ssdim++ )
+    {
+      if( ++position[ ssdim ] < candidates[ ssdim ].size() )
+      {
+        finished = false;
+        break;
+      }
+      position[ ssdim ] = 0;
+    }
+  }
+
+} // end function EvaluateCandidates
+
+
 /**
  * ************************** Stop optimization ******************
  */
@@ -25,6 +25,9 @@
 #include "itkArray.h"
 #include "itkFixedArray.h"
 
+#include <unordered_set>
+#include <vector>
+
 namespace itk
 {
 
@@ -35,6 +38,13 @@ namespace itk
  * Optimizer that scans a subspace of the parameter space
  * and searches for the best parameters.
  *
+ * By default all points of the search space are evaluated. With
+ * NumberOfCoarseToFineLevels L > 0, only every 2^L-th point in each
+ * dimension is evaluated first. Each following level halves the step, and
+ * only evaluates the points within one coarse step of the best point so far.
+ * This is much cheaper for search spaces of many dimensions, but may miss
+ * an optimum that is narrower than the coarse step.
+ *
  * \todo This optimizer has similar functionality as the recently added
  * itkExhaustiveOptimizer. See if we can replace it by that optimizer,
  * or inherit from it.
@@ -62,7 +72,8 @@ public:
   /** Codes of stopping conditions */
   typedef enum {
     FullRangeSearched,
-    MetricError
+    MetricError,
+    CoarseToFineSearchFinished
   } StopConditionType;
 
   /* Typedefs inherited from superclass */
@@ -171,6 +182,12 @@ public:
   /** Convert an index to a point */
   virtual SearchSpacePointType IndexToPoint( const SearchSpaceIndexType & index );
 
+  /** Set/Get the number of coarse-to-fine levels. 0 means that the full
+   * search space is evaluated. Default: 0.
+   */
+  itkSetMacro( NumberOfCoarseToFineLevels, unsigned int );
+  itkGetConstMacro( NumberOfCoarseToFineLevels, unsigned int );
+
   /** Get the current iteration number. */
   itkGetConstMacro( CurrentIteration, unsigned long );
 
@@ -215,12 +232,33 @@ protected:
   unsigned long m_LastSearchSpaceChanges;
   virtual void ProcessSearchSpaceChanges( void );
 
+  /** Compute the value at the current position, and update the best value. */
+  virtual void EvaluateCurrentPosition( void );
+
+  /** Evaluate the coarsest level, and refine around the best point. */
+  virtual void CoarseToFineSearch( void );
+
+  /** For each search space dimension, the indices to be evaluated. */
+  typedef std::vector< std::vector< IndexValueType > > CandidateIndicesType;
+
+  /** The linear indices of the evaluated points, with the first dimension
+   * running fastest.
+   */
+  typedef std::unordered_set< SizeValueType > VisitedIndicesType;
+
+  /** Evaluate all combinations of the candidate indices that were not
+   * visited before.
+   */
+  virtual void EvaluateCandidates( const CandidateIndicesType & candidates,
+    VisitedIndicesType & visited );
+
 private:
 
   FullSearchOptimizer( const Self & ); // purposely not implemented
   void operator=( const Self & );      // purposely not implemented
 
   unsigned long m_CurrentIteration;
+  unsigned int  m_NumberOfCoarseToFineLevels;
 
 };
 
@@ -19,7 +19,7 @@
 #define __elxPowell_h
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
-#include "itkPowellOptimizer.h"
+#include "itkParallelPowellOptimizer.h"
 
 namespace elastix
 {
@@ -28,19 +28,32 @@ namespace elastix
  * \class Powell
  * \brief An optimizer based on Powell...
  *
- * This optimizer is a wrap around the itk::PowellOptimizer.
+ * This optimizer is a wrap around the itk::ParallelPowellOptimizer, which is an
+ * itk::PowellOptimizer that can run its line searches concurrently.
  * This wrap-around class takes care of setting parameters, and printing progress
  * information.
  * For detailed information about the optimisation method, please read the
  * documentation of the itkPowellOptimizer (in the ITK-manual).
- * \sa ImprovedPowellOptimizer
+ *
+ * The parameters used in this class are:
+ * \parameter Optimizer: Select this optimizer as follows:\n
+ *    <tt>(Optimizer "Powell")</tt>
+ * \parameter UseConcurrentLineSearches: Search along all axes from the same
+ *    position at the same time, and combine the steps by conjugate directions,
+ *    see the itk::ParallelPowellOptimizer. The metric then evaluates the trial
+ *    points of all line searches concurrently. Can be given for each resolution.\n
+ *    example: <tt>(UseConcurrentLineSearches "true")</tt>\n
+ *    The default value is false, which runs the line searches of the
+ *    itk::PowellOptimizer one after the other.
+ *
+ * \sa ImprovedPowellOptimizer, ParallelPowellOptimizer
  * \ingroup Optimizers
  */
 
 template< class TElastix >
 class Powell :
   public
-  itk::PowellOptimizer,
+  itk::ParallelPowellOptimizer,
   public
   OptimizerBase< TElastix >
 {
@@ -48,7 +61,7 @@ public:
 
   /** Standard ITK.*/
   typedef Powell                          Self;
-  typedef PowellOptimizer                 Superclass1;
+  typedef ParallelPowellOptimizer         Superclass1;
   typedef OptimizerBase< TElastix >       Superclass2;
   typedef itk::SmartPointer< Self >       Pointer;
   typedef itk::SmartPointer< const Self > ConstPointer;
@@ -57,7 +70,7 @@ public:
   itkNewMacro( Self );
 
   /** Run-time type information (and related methods). */
-  itkTypeMacro( Powell, PowellOptimizer );
+  itkTypeMacro( Powell, ParallelPowellOptimizer );
 
   /** Name of this class.
    * Use this name in the parameter file to select this specific optimizer. \n
@@ -85,6 +85,12 @@ Powell< TElastix >
     "MaximumNumberOfIterations", this->GetComponentLabel(), level, 0 );
   this->SetMaximumIteration( maximumNumberOfIterations );
 
+  /** Set whether the line searches run concurrently. */
+  bool useConcurrentLineSearches = false;
+  this->m_Configuration->ReadParameter( useConcurrentLineSearches,
+    "UseConcurrentLineSearches", this->GetComponentLabel(), level, 0 );
+  this->SetUseConcurrentLineSearches( useConcurrentLineSearches );
+
 } // end BeforeEachResolution
 
 
@@ -100,6 +106,13 @@ Powell< TElastix >
   /** Print some information */
   xl::xout[ "iteration" ][ "2:Metric" ] << this->GetValue();
   xl::xout[ "iteration" ][ "3:StepSize" ] << this->GetStepLength();
+
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue() ) )
+  {
+    this->StopOptimization();
+  }
+
 } // end AfterEachIteration
 
 
@@ -116,10 +129,16 @@ Powell< TElastix >
    * enum   StopConditionType {   GradientMagnitudeTolerance = 1, StepTooSmall,
    * ImageNotAvailable, CostFunctionError, MaximumNumberOfIterations
    */
-  std::string stopcondition = this->GetStopConditionDescription();
+  const std::string stopcondition
+    = this->GetStopConditionDescriptionWithConvergence( this->GetStopConditionDescription() );
 
   /** Print the stopping condition */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
+  if( this->GetUsedConcurrentLineSearches() )
+  {
+    elxout << "The line searches ran concurrently, with "
+           << this->GetNumberOfFunctionEvaluations() << " function evaluations." << std::endl;
+  }
 
 } // end AfterEachResolution
 
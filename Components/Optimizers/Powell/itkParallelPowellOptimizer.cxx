@@ -0,0 +1,495 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkParallelPowellOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace itk
+{
+
+/**
+ * The factor by which the bracket grows, and the golden section ratio.
+ */
+static const double ParallelPowellBracketGrowth  = 1.618034;
+static const double ParallelPowellGoldenFraction = 0.381966;
+
+/**
+ * ******************* Constructor *******************
+ */
+
+ParallelPowellOptimizer
+::ParallelPowellOptimizer()
+{
+  this->m_NumberOfFunctionEvaluations = 0;
+  this->m_StopRequested               = false;
+  this->m_UseConcurrentLineSearches   = false;
+  this->m_UsedConcurrentLineSearches  = false;
+
+} // end Constructor
+
+
+/**
+ * ******************* StartOptimization *******************
+ */
+
+void
+ParallelPowellOptimizer
+::StartOptimization( void )
+{
+  const MultipleValuesCostFunctionInterface * costFunction
+    = dynamic_cast< const MultipleValuesCostFunctionInterface * >( this->GetCostFunction() );
+
+  this->m_UsedConcurrentLineSearches = this->m_UseConcurrentLineSearches
+    && costFunction != nullptr && this->GetInitialPosition().GetSize() > 1;
+  this->m_ConcurrentStopConditionDescription = "";
+
+  if( !this->m_UsedConcurrentLineSearches )
+  {
+    this->Superclass::StartOptimization();
+    return;
+  }
+
+  this->OptimizeConcurrently();
+
+} // end StartOptimization()
+
+
+/**
+ * ******************* StopOptimization *******************
+ */
+
+void
+ParallelPowellOptimizer
+::StopOptimization( void )
+{
+  this->m_StopRequested = true;
+  this->Superclass::StopOptimization();
+
+} // end StopOptimization()
+
+
+/**
+ * ******************* OptimizeConcurrently *******************
+ */
+
+void
+ParallelPowellOptimizer
+::OptimizeConcurrently( void )
+{
+  this->m_NumberOfFunctionEvaluations = 0;
+  this->m_StopRequested               = false;
+  this->InvokeEvent( StartEvent() );
+
+  ParametersType     position  = this->GetInitialPosition();
+  const unsigned int n         = position.GetSize();
+  const ScalesType & scales    = this->GetScales();
+  const bool         useScales = scales.GetSize() == n;
+  const double       sign      = this->GetMaximize() ? -1.0 : 1.0;
+
+  /** The line searches run along the axes of the scaled parameter space. */
+  DirectionsType axes( n, ParametersType( n ) );
+  for( unsigned int i = 0; i < n; ++i )
+  {
+    axes[ i ].Fill( 0.0 );
+    axes[ i ][ i ] = useScales ? 1.0 / scales[ i ] : 1.0;
+  }
+
+  std::vector< ParametersType > positions( 1, position );
+  std::vector< MeasureType >    values;
+  this->EvaluatePositions( positions, values );
+  MeasureType value = values[ 0 ];
+  this->SetCurrentPosition( position );
+  this->SetCurrentCost( sign * value );
+
+  std::vector< double >      steps;
+  std::vector< MeasureType > stepValues;
+  std::vector< double >      conjugateStep;
+  std::vector< MeasureType > conjugateValue;
+  ParametersType             direction( n );
+  ParametersType             newPosition( n );
+  double                     previousDecrease = 0.0;
+  unsigned int               sinceRestart     = 0;
+  unsigned int               iteration        = 0;
+  direction.Fill( 0.0 );
+
+  for( ; iteration < static_cast< unsigned int >( this->GetMaximumIteration() ); ++iteration )
+  {
+    if( this->m_StopRequested )
+    {
+      this->m_ConcurrentStopConditionDescription
+        = std::string( this->GetNameOfClass() ) + ": StopOptimization() called";
+      break;
+    }
+
+    /** Search along all axes from the current position. */
+    this->ConcurrentLineSearches( position, value, axes,
+      this->GetStepLength(), steps, stepValues );
+    const unsigned int best = static_cast< unsigned int >(
+      std::min_element( stepValues.begin(), stepValues.end() ) - stepValues.begin() );
+
+    /** For a quadratic function, the sum of the steps equals the gradient
+     * step preconditioned by the diagonal of the Hessian, and twice the sum of
+     * the decreases equals its inner product with the gradient. That gives
+     * the conjugate direction of Fletcher-Reeves, restarted every n iterations.
+     */
+    double decrease = 0.0;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+      decrease += value - stepValues[ i ];
+    }
+    const double beta = ( sinceRestart > 0 && previousDecrease > 0.0 )
+      ? decrease / previousDecrease : 0.0;
+    for( unsigned int j = 0; j < n; ++j )
+    {
+      direction[ j ] *= beta;
+    }
+    for( unsigned int i = 0; i < n; ++i )
+    {
+      direction[ i ] += steps[ i ] * axes[ i ][ i ];
+    }
+    previousDecrease = decrease;
+    sinceRestart     = ( sinceRestart + 1 ) % n;
+
+    bool useConjugate = false;
+    if( direction.two_norm() > 0.0 )
+    {
+      this->ConcurrentLineSearches( position, value, DirectionsType( 1, direction ),
+        1.0, conjugateStep, conjugateValue );
+      useConjugate = conjugateValue[ 0 ] < stepValues[ best ];
+    }
+
+    /** Move to the best position found. If the conjugate direction did not
+     * give it, the next iteration starts anew with the preconditioned step.
+     */
+    const MeasureType previousValue = value;
+    MeasureType       newValue      = stepValues[ best ];
+    newPosition = position;
+    if( useConjugate )
+    {
+      newValue = conjugateValue[ 0 ];
+      for( unsigned int j = 0; j < n; ++j )
+      {
+        newPosition[ j ] += conjugateStep[ 0 ] * direction[ j ];
+      }
+    }
+    else
+    {
+      newPosition[ best ] += steps[ best ] * axes[ best ][ best ];
+      sinceRestart = 0;
+    }
+    if( newValue < value )
+    {
+      position = newPosition;
+      value    = newValue;
+    }
+
+    this->SetCurrentPosition( position );
+    this->SetCurrentCost( sign * value );
+    this->InvokeEvent( IterationEvent() );
+
+    if( 2.0 * std::abs( previousValue - value )
+      <= this->GetValueTolerance() * ( std::abs( previousValue ) + std::abs( value ) ) )
+    {
+      std::ostringstream description;
+      description << this->GetNameOfClass() << ": Cost function values at the current parameter ("
+                  << sign * value << ") and at the local extrema (" << sign * previousValue
+                  << ") are within Value Tolerance (" << this->GetValueTolerance() << ")";
+      this->m_ConcurrentStopConditionDescription = description.str();
+      break;
+    }
+  }
+
+  if( this->m_ConcurrentStopConditionDescription.empty() )
+  {
+    std::ostringstream description;
+    description << this->GetNameOfClass() << ": Maximum number of iterations exceeded. "
+                << "Number of iterations is " << this->GetMaximumIteration();
+    this->m_ConcurrentStopConditionDescription = description.str();
+  }
+
+  this->InvokeEvent( EndEvent() );
+
+} // end OptimizeConcurrently()
+
+
+/**
+ * ******************* ConcurrentLineSearches *******************
+ */
+
+void
+ParallelPowellOptimizer
+::ConcurrentLineSearches( const ParametersType & origin,
+  const MeasureType originValue, const DirectionsType & directions,
+  const double initialStep, std::vector< double > & steps,
+  std::vector< MeasureType > & values )
+{
+  const std::size_t              numberOfDirections = directions.size();
+  std::vector< LineSearchState > states( numberOfDirections );
+  for( LineSearchState & state : states )
+  {
+    state.m_Phase          = LineSearchState::FirstStep;
+    state.m_A              = 0.0;
+    state.m_B              = 0.0;
+    state.m_C              = 0.0;
+    state.m_X              = initialStep;
+    state.m_ValueA         = originValue;
+    state.m_ValueB         = originValue;
+    state.m_NumberOfTrials = 0;
+  }
+
+  /** Each round evaluates the trial points of the unfinished searches. */
+  std::vector< std::size_t >    active;
+  std::vector< ParametersType > positions;
+  std::vector< MeasureType >    trialValues;
+  while( true )
+  {
+    active.clear();
+    positions.clear();
+    for( std::size_t i = 0; i < numberOfDirections; ++i )
+    {
+      if( states[ i ].m_Phase != LineSearchState::Finished )
+      {
+        ParametersType position = origin;
+        for( unsigned int j = 0; j < position.GetSize(); ++j )
+        {
+          position[ j ] += states[ i ].m_X * directions[ i ][ j ];
+        }
+        active.push_back( i );
+        positions.push_back( position );
+      }
+    }
+    if( active.empty() )
+    {
+      break;
+    }
+
+    this->EvaluatePositions( positions, trialValues );
+    for( std::size_t k = 0; k < active.size(); ++k )
+    {
+      this->UpdateLineSearch( states[ active[ k ] ], trialValues[ k ] );
+    }
+  }
+
+  steps.resize( numberOfDirections );
+  values.resize( numberOfDirections );
+  for( std::size_t i = 0; i < numberOfDirections; ++i )
+  {
+    steps[ i ]  = states[ i ].m_B;
+    values[ i ] = states[ i ].m_ValueB;
+  }
+
+} // end ConcurrentLineSearches()
+
+
+/**
+ * ******************* UpdateLineSearch *******************
+ */
+
+void
+ParallelPowellOptimizer
+::UpdateLineSearch( LineSearchState & state, const MeasureType value ) const
+{
+  ++state.m_NumberOfTrials;
+
+  switch( state.m_Phase )
+  {
+    case LineSearchState::FirstStep:
+      /** Go downhill from a to b. */
+      state.m_B      = state.m_X;
+      state.m_ValueB = value;
+      if( state.m_ValueB > state.m_ValueA )
+      {
+        std::swap( state.m_A, state.m_B );
+        std::swap( state.m_ValueA, state.m_ValueB );
+      }
+      state.m_X     = state.m_B + ParallelPowellBracketGrowth * ( state.m_B - state.m_A );
+      state.m_Phase = LineSearchState::Bracketing;
+      break;
+
+    case LineSearchState::Bracketing:
+      if( value < state.m_ValueB )
+      {
+        state.m_A      = state.m_B;
+        state.m_ValueA = state.m_ValueB;
+        state.m_B      = state.m_X;
+        state.m_ValueB = value;
+        state.m_X      = state.m_B + ParallelPowellBracketGrowth * ( state.m_B - state.m_A );
+      }
+      else
+      {
+        /** The minimum lies between a and x; order the bracket. */
+        state.m_C     = std::max( state.m_A, state.m_X );
+        state.m_A     = std::min( state.m_A, state.m_X );
+        state.m_Phase = LineSearchState::GoldenSection;
+      }
+      break;
+
+    case LineSearchState::GoldenSection:
+      if( value < state.m_ValueB )
+      {
+        if( state.m_X > state.m_B )
+        {
+          state.m_A = state.m_B;
+        }
+        else
+        {
+          state.m_C = state.m_B;
+        }
+        state.m_B      = state.m_X;
+        state.m_ValueB = value;
+      }
+      else
+      {
+        if( state.m_X > state.m_B )
+        {
+          state.m_C = state.m_X;
+        }
+        else
+        {
+          state.m_A = state.m_X;
+        }
+      }
+      break;
+
+    case LineSearchState::Finished:
+      return;
+  }
+
+  /** The next trial point divides the larger part of the bracket. */
+  if( state.m_Phase == LineSearchState::GoldenSection )
+  {
+    if( 0.5 * ( state.m_C - state.m_A ) < this->GetStepTolerance() )
+    {
+      state.m_Phase = LineSearchState::Finished;
+    }
+    else if( state.m_C - state.m_B > state.m_B - state.m_A )
+    {
+      state.m_X = state.m_B + ParallelPowellGoldenFraction * ( state.m_C - state.m_B );
+    }
+    else
+    {
+      state.m_X = state.m_B - ParallelPowellGoldenFraction * ( state.m_B - state.m_A );
+    }
+  }
+  if( state.m_NumberOfTrials >= static_cast< unsigned int >( this->GetMaximumLineIteration() ) )
+  {
+    state.m_Phase = LineSearchState::Finished;
+  }
+
+} // end UpdateLineSearch()
+
+
+/**
+ * ******************* EvaluatePositions *******************
+ */
+
+void
+ParallelPowellOptimizer
+::EvaluatePositions( const std::vector< ParametersType > & positions,
+  std::vector< MeasureType > & values )
+{
+  const MultipleValuesCostFunctionInterface * costFunction
+    = dynamic_cast< const MultipleValuesCostFunctionInterface * >( this->GetCostFunction() );
+
+  this->m_NumberOfFunctionEvaluations += static_cast< unsigned int >( positions.size() );
+  bool evaluated = false;
+  if( costFunction != nullptr && positions.size() > 1 )
+  {
+    try
+    {
+      costFunction->GetValues( positions, values );
+      evaluated = true;
+    }
+    catch( ExceptionObject & )
+    {
+      /** One of the positions may be invalid; evaluate them one by one. */
+      if( !this->GetCatchGetValueException() )
+      {
+        throw;
+      }
+    }
+  }
+
+  if( !evaluated )
+  {
+    values.resize( positions.size() );
+    for( std::size_t i = 0; i < positions.size(); ++i )
+    {
+      try
+      {
+        values[ i ] = this->GetCostFunction()->GetValue( positions[ i ] );
+      }
+      catch( ExceptionObject & )
+      {
+        if( !this->GetCatchGetValueException() )
+        {
+          throw;
+        }
+        values[ i ] = this->GetMetricWorstPossibleValue();
+      }
+    }
+  }
+
+  if( this->GetMaximize() )
+  {
+    for( MeasureType & value : values )
+    {
+      value = -value;
+    }
+  }
+
+} // end EvaluatePositions()
+
+
+/**
+ * ******************* GetStopConditionDescription *******************
+ */
+
+const std::string
+ParallelPowellOptimizer
+::GetStopConditionDescription( void ) const
+{
+  if( this->m_UsedConcurrentLineSearches )
+  {
+    return this->m_ConcurrentStopConditionDescription;
+  }
+  return this->Superclass::GetStopConditionDescription();
+
+} // end GetStopConditionDescription()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+void
+ParallelPowellOptimizer
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "UseConcurrentLineSearches: " << this->m_UseConcurrentLineSearches << std::endl;
+  os << indent << "UsedConcurrentLineSearches: " << this->m_UsedConcurrentLineSearches << std::endl;
+  os << indent << "NumberOfFunctionEvaluations: " << this->m_NumberOfFunctionEvaluations << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
@@ -0,0 +1,177 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkParallelPowellOptimizer_h
+#define __itkParallelPowellOptimizer_h
+
+#include "itkPowellOptimizer.h"
+#include "itkMultipleValuesCostFunctionInterface.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/**
+ * \class ParallelPowellOptimizer
+ * \brief A PowellOptimizer that searches along all directions at the same time.
+ *
+ * The PowellOptimizer minimizes along its N directions one after the other,
+ * and evaluates the cost function at one point at a time. If
+ * UseConcurrentLineSearches is set and the cost function implements the
+ * MultipleValuesCostFunctionInterface, each iteration of this class instead
+ * runs the N line searches along the axes of the scaled parameter space from
+ * the same position, in lock step: every round evaluates the next trial point
+ * of all unfinished line searches in one call of GetValues(). Each line search
+ * brackets the minimum, starting with the StepLength, and then narrows the
+ * bracket by golden section, until it is smaller than twice the StepTolerance,
+ * or until MaximumLineIteration points have been tried.
+ *
+ * Line searches from the same position are independent only along conjugate
+ * directions, so the steps are not simply added. For a quadratic function,
+ * their sum is the gradient step preconditioned by the diagonal of the
+ * Hessian, and twice the sum of the decreases is its inner product with the
+ * gradient. These give the conjugate direction of Fletcher-Reeves, along which
+ * one more line search is done; like Powell's method, this minimizes a
+ * quadratic function in N iterations. The conjugation restarts every N
+ * iterations, and whenever the best step along a single axis is better than
+ * the one along the conjugate direction, which is then taken instead. The
+ * optimization stops as the PowellOptimizer does, when the relative decrease
+ * of the value in one iteration is smaller than the ValueTolerance, or after
+ * MaximumIteration iterations.
+ *
+ * The iterations differ from those of the PowellOptimizer, and need about
+ * N + 1 times the evaluations of one line search, but their rounds of
+ * concurrent evaluations are as many as for two line searches. Otherwise,
+ * which is the default, StartOptimization() of the PowellOptimizer is called.
+ *
+ * \ingroup Numerics Optimizers
+ */
+
+class ParallelPowellOptimizer :
+  public PowellOptimizer
+{
+public:
+
+  /** Standard ITK.*/
+  typedef ParallelPowellOptimizer    Self;
+  typedef PowellOptimizer            Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ParallelPowellOptimizer, PowellOptimizer );
+
+  /** Typedefs inherited from the superclass. */
+  typedef Superclass::ParametersType   ParametersType;
+  typedef Superclass::MeasureType      MeasureType;
+  typedef Superclass::ScalesType       ScalesType;
+  typedef Superclass::CostFunctionType CostFunctionType;
+
+  /** Start the optimization. */
+  void StartOptimization( void ) override;
+
+  /** Stop the optimization, also if the line searches run concurrently. */
+  void StopOptimization( void );
+
+  /** Setting: run the line searches along the directions concurrently.
+   * Default: false.
+   */
+  itkSetMacro( UseConcurrentLineSearches, bool );
+  itkGetConstMacro( UseConcurrentLineSearches, bool );
+  itkBooleanMacro( UseConcurrentLineSearches );
+
+  /** Whether the last optimization ran the line searches concurrently. */
+  itkGetConstMacro( UsedConcurrentLineSearches, bool );
+
+  /** The number of function evaluations of the last concurrent optimization. */
+  itkGetConstMacro( NumberOfFunctionEvaluations, unsigned int );
+
+  /** Get the reason for termination. */
+  const std::string GetStopConditionDescription( void ) const override;
+
+protected:
+
+  ParallelPowellOptimizer();
+  ~ParallelPowellOptimizer() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** The state of a line search along one direction. The points a, b and c
+   * are positions on the line; b is the best point found. In the bracketing
+   * phase a and b are known, and c is tried. In the golden section phase the
+   * minimum lies between a and c, and x is tried.
+   */
+  struct LineSearchState
+  {
+    enum PhaseType { FirstStep, Bracketing, GoldenSection, Finished };
+
+    PhaseType    m_Phase;
+    double       m_A;
+    double       m_B;
+    double       m_C;
+    double       m_X;
+    MeasureType  m_ValueA;
+    MeasureType  m_ValueB;
+    unsigned int m_NumberOfTrials;
+  };
+
+  typedef std::vector< ParametersType > DirectionsType;
+
+  /** Minimize concurrently along the directions, starting at the origin with
+   * the given value. The steps along the directions and the values there are
+   * returned.
+   */
+  void ConcurrentLineSearches( const ParametersType & origin,
+    const MeasureType originValue, const DirectionsType & directions,
+    const double initialStep, std::vector< double > & steps,
+    std::vector< MeasureType > & values );
+
+  /** Compute the values at the given positions, concurrently if possible.
+   * The values are negated if the cost function is maximized.
+   */
+  void EvaluatePositions( const std::vector< ParametersType > & positions,
+    std::vector< MeasureType > & values );
+
+private:
+
+  ParallelPowellOptimizer( const Self & ); // purposely not implemented
+  void operator=( const Self & );          // purposely not implemented
+
+  /** Update the line search with the value at its trial point, and compute
+   * the next trial point.
+   */
+  void UpdateLineSearch( LineSearchState & state, const MeasureType value ) const;
+
+  /** Run the iterations with concurrent line searches. */
+  void OptimizeConcurrently( void );
+
+  unsigned int m_NumberOfFunctionEvaluations;
+  std::string  m_ConcurrentStopConditionDescription;
+  bool         m_StopRequested;
+  bool         m_UseConcurrentLineSearches;
+  bool         m_UsedConcurrentLineSearches;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkParallelPowellOptimizer_h
@@ -63,6 +63,17 @@ namespace elastix
  *   SP_alpha can be defined for each resolution. \n
  *   example: <tt>(SP_alpha 0.602 0.602 0.602)</tt> \n
  *   The default/recommended value is 0.602.
+ * \parameter PreconditionerMethod: The factorization of the self Hessian that is used
+ *   as preconditioner: "Cholesky", "IncompleteCholesky" (without fill-in) or "Jacobi"
+ *   (only the diagonal). When a factorization fails, the next one in this list is used. \n
+ *   Can be defined for each resolution. \n
+ *   example: <tt>(PreconditionerMethod "Cholesky" "Cholesky" "IncompleteCholesky")</tt> \n
+ *   The default value is "Cholesky".
+ * \parameter MaximumNumberOfParametersForCholesky: Problems with more parameters use
+ *   the incomplete Cholesky factorization instead of the complete one, which may need
+ *   too much memory. Can be defined for each resolution. \n
+ *   example: <tt>(MaximumNumberOfParametersForCholesky 200000)</tt> \n
+ *   The default value is 0, meaning no maximum.
  *
  * \sa StochasticPreconditionedGradientOptimizer
  * \ingroup Optimizers
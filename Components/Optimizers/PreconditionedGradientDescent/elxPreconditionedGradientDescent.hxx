@@ -132,6 +132,34 @@ PreconditionedGradientDescent<TElastix>
     "MinimumGradientElementMagnitude", this->GetComponentLabel(), level, 0 );
   this->SetMinimumGradientElementMagnitude( minimumGradientElementMagnitude );
 
+  /** Set the factorization of the precondition matrix. */
+  std::string preconditionerMethod = "Cholesky";
+  this->GetConfiguration()->ReadParameter( preconditionerMethod,
+    "PreconditionerMethod", this->GetComponentLabel(), level, 0 );
+  if( preconditionerMethod == "Cholesky" )
+  {
+    this->SetPreconditionerMethod( Superclass1::Cholesky );
+  }
+  else if( preconditionerMethod == "IncompleteCholesky" )
+  {
+    this->SetPreconditionerMethod( Superclass1::IncompleteCholesky );
+  }
+  else if( preconditionerMethod == "Jacobi" )
+  {
+    this->SetPreconditionerMethod( Superclass1::Jacobi );
+  }
+  else
+  {
+    itkExceptionMacro( << "ERROR: the PreconditionerMethod \"" << preconditionerMethod
+      << "\" is not supported. Choose Cholesky, IncompleteCholesky or Jacobi." );
+  }
+
+  /** Set the maximum number of parameters of the complete factorization. */
+  unsigned long maximumNumberOfParametersForCholesky = 0;
+  this->GetConfiguration()->ReadParameter( maximumNumberOfParametersForCholesky,
+    "MaximumNumberOfParametersForCholesky", this->GetComponentLabel(), level, 0 );
+  this->SetMaximumNumberOfParametersForCholesky( maximumNumberOfParametersForCholesky );
+
   /** Set whether automatic gain estimation is required; default: true. */
   this->m_AutomaticParameterEstimation = true;
   this->GetConfiguration()->ReadParameter( this->m_AutomaticParameterEstimation,
@@ -223,9 +251,16 @@ PreconditionedGradientDescent<TElastix>
   xl::xout["iteration"]["2:Metric"]   << this->GetValue();
   xl::xout["iteration"]["3a:Time"] << this->GetCurrentTime();
   xl::xout["iteration"]["3b:StepSize"] << this->GetLearningRate();
-  xl::xout["iteration"]["4a:||Gradient||"] << this->GetGradient().magnitude();
+  const double gradientMagnitude = this->GetGradient().magnitude();
+  xl::xout["iteration"]["4a:||Gradient||"] << gradientMagnitude;
   xl::xout["iteration"]["4b:||SearchDir||"] << this->GetSearchDirection().magnitude();
 
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), gradientMagnitude ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new spatial samples for the computation of the metric. */
   if( this->GetNewSamplesEveryIteration() )
   {
@@ -265,6 +300,8 @@ PreconditionedGradientDescent<TElastix>
     break;
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
@@ -433,14 +470,26 @@ PreconditionedGradientDescent<TElastix>
     << std::endl;
 
   timer.Start();
-  elxout << "Computing Cholesky decomposition of SelfHessian." << std::endl;
+  elxout << "Computing the factorization of SelfHessian." << std::endl;
   this->SetPreconditionMatrix( H );
+
+  const char * const methodNames[] = { "Cholesky", "IncompleteCholesky", "Jacobi" };
+  elxout << "Preconditioner: " << methodNames[ this->GetUsedPreconditionerMethod() ];
+  if( this->GetUsedPreconditionerMethod() != this->GetPreconditionerMethod() )
+  {
+    elxout << " (instead of " << methodNames[ this->GetPreconditionerMethod() ] << ")";
+  }
+  if( this->GetReusedSymbolicFactorization() )
+  {
+    elxout << ", reusing the symbolic analysis";
+  }
+  elxout << std::endl;
   elxout << "Sparsity: " << this->GetSparsity() << std::endl;
   elxout << "Largest eigenvalue: " << this->GetLargestEigenValue() << std::endl;
   elxout << "Condition number: " << this->GetConditionNumber() << std::endl;
   timer.Stop();
 
-  elxout << "Computing Cholesky decomposition took: "
+  elxout << "Computing the factorization took: "
     << this->ConvertSecondsToDHMS( timer.GetMean(), 6 )
     << std::endl;
 
@@ -665,7 +714,7 @@ PreconditionedGradientDescent<TElastix>
     }
   }
   this->GetScaledDerivativeWithExceptionHandling( mu0, gradient );
-  this->CholmodSolve( gradient, searchDirection );
+  this->PreconditionedSolve( gradient, searchDirection );
   exactgg += inner_product( gradient, searchDirection ); // gPg
   sigma1 = exactgg / Pd;
   elxout << "sigma1 " << sigma1 << " exactgg: " << exactgg << std::endl;
@@ -720,7 +769,7 @@ PreconditionedGradientDescent<TElastix>
       this->GetScaledDerivativeWithExceptionHandling( perturbedMu0, gradient );
 
       /** Compute g'Pg */
-      this->CholmodSolve( gradient, searchDirection );
+      this->PreconditionedSolve( gradient, searchDirection );
       approxgg += inner_product( gradient, searchDirection ); // gPg
 
       elxout << "approxgg: " << approxgg << std::endl;
@@ -859,8 +908,8 @@ PreconditionedGradientDescent<TElastix>
   }
 
   /** Compute (\mu - \mu0) = Permutation' L^{-T} (\nu - \nu0) */
-  this->CholmodSolve( tempParameters, tempParameters2, CHOLMOD_Lt );
-  this->CholmodSolve( tempParameters2, perturbedParameters, CHOLMOD_Pt );
+  this->PreconditionedSolve( tempParameters, tempParameters2, CHOLMOD_Lt );
+  this->PreconditionedSolve( tempParameters2, perturbedParameters, CHOLMOD_Pt );
 
   /** Add initial parameters */
   perturbedParameters += initialParameters;
@@ -21,6 +21,7 @@
 #include "itkAdaptiveStochasticPreconditionedGradientDescentOptimizer.h"
 
 #include "vnl/vnl_math.h"
+#include "itkParallelVectorOperations.h"
 
 namespace itk
 {
@@ -64,8 +65,9 @@ AdaptiveStochasticPreconditionedGradientDescentOptimizer
       sigmoid.SetBeta( beta );
 
       /** Formula (2) in Cruz */
-      const double inprod = inner_product(
-        this->m_PreviousSearchDirection, this->GetGradient() );
+      const double inprod = ParallelVectorOperations::InnerProduct(
+        this->m_PreviousSearchDirection.data_block(), this->GetGradient().data_block(),
+        this->GetGradient().GetSize() );
       this->m_CurrentTime += sigmoid(-inprod);
       this->m_CurrentTime = vnl_math_max( 0.0, this->m_CurrentTime );
     }
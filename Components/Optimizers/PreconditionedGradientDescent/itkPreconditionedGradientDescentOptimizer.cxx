@@ -23,10 +23,14 @@
 #include "itkCommand.h"
 #include "itkEventObject.h"
 #include "itkMacro.h"
+#include "itkParallelSparseMatrixAssembler.h"
 #include "vnl/vnl_math.h"
 #include "vnl/vnl_vector.h"
 #include "vnl/algo/vnl_sparse_symmetric_eigensystem.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace itk
 {
 /** Error handler for cholmod */
@@ -59,6 +63,10 @@ PreconditionedGradientDescentOptimizer
   this->m_LargestEigenValue = 1.0;
   this->m_Sparsity = 1.0;
   this->m_ConditionNumber = 1.0;
+  this->m_PreconditionerMethod = Cholesky;
+  this->m_UsedPreconditionerMethod = Cholesky;
+  this->m_MaximumNumberOfParametersForCholesky = 0;
+  this->m_ReusedSymbolicFactorization = false;
 
   /** Prepare cholmod */
   this->m_CholmodCommon = new cholmod_common;
@@ -130,6 +138,10 @@ PreconditionedGradientDescentOptimizer
   os << indent << "Value: " << this->m_Value << std::endl;
   os << indent << "StopCondition: " << this->m_StopCondition << std::endl;
   os << indent << "Gradient: " << this->m_Gradient << std::endl;
+  os << indent << "PreconditionerMethod: " << this->m_PreconditionerMethod << std::endl;
+  os << indent << "UsedPreconditionerMethod: " << this->m_UsedPreconditionerMethod << std::endl;
+  os << indent << "MaximumNumberOfParametersForCholesky: "
+     << this->m_MaximumNumberOfParametersForCholesky << std::endl;
 
 } // end PrintSelf()
 
@@ -268,7 +280,7 @@ PreconditionedGradientDescentOptimizer
   DerivativeType & searchDirection = this->m_SearchDirection;
 
   /** Compute the search direction */
-  this->CholmodSolve( this->m_Gradient, searchDirection );
+  this->PreconditionedSolve( this->m_Gradient, searchDirection );
 
   /** Compute the new position */
   ParametersType newPosition( spaceDimension );
@@ -361,9 +373,105 @@ PreconditionedGradientDescentOptimizer
     searchDirection[ static_cast<unsigned int>(*xRow) ] = (*xVal);
   }
 
+  /** Release memory */
+  cholmod_free_sparse( &x, this->m_CholmodCommon );
+
 } // end CholmodSolve()
 
 
+/**
+ * ************ PreconditionedSolve ****************************
+ */
+
+void
+PreconditionedGradientDescentOptimizer
+::PreconditionedSolve( const DerivativeType & gradient,
+  DerivativeType & searchDirection, int solveType )
+{
+  itkDebugMacro("PreconditionedSolve");
+
+  if( this->m_UsedPreconditionerMethod == Cholesky )
+  {
+    this->CholmodSolve( gradient, searchDirection, solveType );
+    return;
+  }
+
+  const bool forward  = solveType == CHOLMOD_A || solveType == CHOLMOD_LDLt
+    || solveType == CHOLMOD_L || solveType == CHOLMOD_LD;
+  const bool backward = solveType == CHOLMOD_A || solveType == CHOLMOD_LDLt
+    || solveType == CHOLMOD_Lt || solveType == CHOLMOD_DLt;
+
+  /** The factors are not permuted, and things like CHOLMOD_P are the identity. */
+  searchDirection = gradient;
+  const size_t spaceDimension = searchDirection.GetSize();
+
+  if( this->m_UsedPreconditionerMethod == Jacobi )
+  {
+    if( this->m_JacobiDiagonal.size() != spaceDimension )
+    {
+      return;
+    }
+
+    /** H = D^{1/2} D^{1/2}, so both the forward and backward solve divide
+     * by the square root of the diagonal.
+     */
+    if( forward && backward )
+    {
+      for( size_t j = 0; j < spaceDimension; ++j )
+      {
+        searchDirection[ j ] /= this->m_JacobiDiagonal[ j ];
+      }
+    }
+    else if( forward || backward )
+    {
+      for( size_t j = 0; j < spaceDimension; ++j )
+      {
+        searchDirection[ j ] /= std::sqrt( this->m_JacobiDiagonal[ j ] );
+      }
+    }
+    return;
+  }
+
+  /** Incomplete Cholesky: H ~ R' R, with R upper triangular. */
+  const std::vector< CInt > &   pointers = this->m_IncompleteCholeskyRowPointers;
+  const std::vector< CInt > &   indices  = this->m_IncompleteCholeskyColumnIndices;
+  const std::vector< double > & values   = this->m_IncompleteCholeskyValues;
+  if( pointers.size() != spaceDimension + 1 )
+  {
+    return;
+  }
+
+  /** Solve R' y = g, by columns of R'. */
+  if( forward )
+  {
+    for( size_t k = 0; k < spaceDimension; ++k )
+    {
+      const double yk = searchDirection[ k ] / values[ pointers[ k ] ];
+      searchDirection[ k ] = yk;
+      for( CInt q = pointers[ k ] + 1; q < pointers[ k + 1 ]; ++q )
+      {
+        searchDirection[ indices[ q ] ] -= values[ q ] * yk;
+      }
+    }
+  }
+
+  /** Solve R x = y, by rows of R. */
+  if( backward )
+  {
+    for( size_t k = spaceDimension; k-- > 0; )
+    {
+      double sum = searchDirection[ k ];
+      for( CInt q = pointers[ k ] + 1; q < pointers[ k + 1 ]; ++q )
+      {
+        sum -= values[ q ] * searchDirection[ indices[ q ] ];
+      }
+      searchDirection[ k ] = sum / values[ pointers[ k ] ];
+    }
+  }
+
+} // end PreconditionedSolve()
+
+
 /**
  * ************ SetPreconditionMatrix ****************************
  */
@@ -377,8 +485,6 @@ PreconditionedGradientDescentOptimizer
    */
   itkDebugMacro("SetPreconditionMatrix");
 
-  typedef PreconditionType::row             RowType;
-  typedef RowType::const_iterator           RowIteratorType;
   typedef vnl_vector<PreconditionValueType> DiagonalType;
 
   const size_t spaceDimension = static_cast<size_t>( precondition.cols() );
@@ -455,33 +561,14 @@ PreconditionedGradientDescentOptimizer
     spaceDimension, spaceDimension, nnz, sorted, packed,
     stype, CHOLMOD_REAL, this->m_CholmodCommon );
 
-  /** size nnz */
-  CInt * cRow = reinterpret_cast<CInt *>( cPrecondition->i );
-  double * cVal = reinterpret_cast<double *>( cPrecondition->x );
-  /** size spaceDimension+1 */
+  /** Copy the rows of the input matrix in parallel. */
   CInt * cCol = reinterpret_cast<CInt *>( cPrecondition->p );
-
-  /** Loop over rows of input matrix */
-  const CInt * cRowBegin = cRow;
-  for( unsigned int r = 0; r < spaceDimension; ++r )
-  {
-    RowType & rowVector = precondition.get_row( r );
-    (*cCol) = static_cast<int>( cRow - cRowBegin );
-    ++cCol;
-
-    /** Iterate over each row */
-    for( RowIteratorType rowIt = rowVector.begin(); rowIt != rowVector.end(); ++rowIt )
-    {
-      (*cRow) = rowIt->first;
-      (*cVal) = rowIt->second;
-      ++cRow;
-      ++cVal;
-    }
-  }
-  (*cCol) = static_cast<int>(cRow - cRowBegin);
+  ParallelSparseMatrixAssembler::CopyRowsToCompressedArrays( precondition, cCol,
+    reinterpret_cast<CInt *>( cPrecondition->i ),
+    reinterpret_cast<double *>( cPrecondition->x ) );
 
   /** Sanity check */
-  if( static_cast<size_t>(*cCol) != nnz )
+  if( static_cast<size_t>( cCol[ spaceDimension ] ) != nnz )
   {
     /** Release memory */
     cholmod_free_sparse( &cPrecondition, this->m_CholmodCommon );
@@ -491,18 +578,63 @@ PreconditionedGradientDescentOptimizer
   /** Destroy precondition input, to save memory */
   precondition.set_size( 0, 0 );
 
-  /** Prepare for factorization */
-  this->m_CholmodFactor = cholmod_analyze( cPrecondition, this->m_CholmodCommon );
+  /** Large problems skip the complete factorization. */
+  PreconditionerMethodType method = this->m_PreconditionerMethod;
+  if( method == Cholesky && this->m_MaximumNumberOfParametersForCholesky > 0
+    && spaceDimension > this->m_MaximumNumberOfParametersForCholesky )
+  {
+    method = IncompleteCholesky;
+  }
 
-  /** Factorize cPrediction + diagonalWeight * largestEig * Identity */
-  double beta[2];
-  beta[0] = 0.0; // this->GetDiagonalWeight() * largestEig; but we already did that above
-  beta[1] = 0.0; // this is for potential imaginary part of complex number.
-  cholmod_factorize_p( cPrecondition, beta, nullptr, 0,
-    this->m_CholmodFactor, this->m_CholmodCommon );
+  /** Release the factors of a previous call that are not used anymore. */
+  std::vector< CInt >().swap( this->m_IncompleteCholeskyRowPointers );
+  std::vector< CInt >().swap( this->m_IncompleteCholeskyColumnIndices );
+  std::vector< double >().swap( this->m_IncompleteCholeskyValues );
+  std::vector< double >().swap( this->m_JacobiDiagonal );
+  this->m_ReusedSymbolicFactorization = false;
 
-  /** Store condition number of user */
-  this->m_ConditionNumber = cholmod_rcond( this->m_CholmodFactor, this->m_CholmodCommon );
+  /** Factorize, and fall back to the cheaper methods when this fails. */
+  if( method == Cholesky && !this->ComputeCholeskyFactorization( cPrecondition ) )
+  {
+    method = IncompleteCholesky;
+  }
+  if( method != Cholesky && this->m_CholmodFactor )
+  {
+    cholmod_free_factor( &this->m_CholmodFactor, this->m_CholmodCommon );
+    this->m_CholmodFactor = 0;
+    std::vector< CInt >().swap( this->m_AnalyzedColumnPointers );
+    std::vector< CInt >().swap( this->m_AnalyzedRowIndices );
+  }
+  if( method == IncompleteCholesky && !this->ComputeIncompleteCholeskyFactorization( cPrecondition ) )
+  {
+    method = Jacobi;
+  }
+  if( method == Jacobi )
+  {
+    this->ComputeJacobiPreconditioner( cPrecondition );
+  }
+  this->m_UsedPreconditionerMethod = method;
+
+  /** Store condition number of user. Like cholmod_rcond, estimate it from
+   * the diagonal of the factor.
+   */
+  if( method == Cholesky )
+  {
+    this->m_ConditionNumber = cholmod_rcond( this->m_CholmodFactor, this->m_CholmodCommon );
+  }
+  else
+  {
+    double minDiag = 0.0;
+    double maxDiag = 0.0;
+    for( size_t r = 0; r < spaceDimension; ++r )
+    {
+      const double diag = method == Jacobi ? std::sqrt( this->m_JacobiDiagonal[ r ] )
+        : this->m_IncompleteCholeskyValues[ this->m_IncompleteCholeskyRowPointers[ r ] ];
+      minDiag = r == 0 ? diag : std::min( minDiag, diag );
+      maxDiag = r == 0 ? diag : std::max( maxDiag, diag );
+    }
+    this->m_ConditionNumber = maxDiag > 0.0 ? ( minDiag / maxDiag ) * ( minDiag / maxDiag ) : 0.0;
+  }
 
   /** Release memory */
   cholmod_free_sparse( &cPrecondition, this->m_CholmodCommon );
@@ -521,6 +653,164 @@ PreconditionedGradientDescentOptimizer
 } // end SetPreconditionMatrix()
 
 
+/**
+ * ************ ComputeCholeskyFactorization ****************************
+ */
+
+bool
+PreconditionedGradientDescentOptimizer
+::ComputeCholeskyFactorization( cholmod_sparse * cPrecondition )
+{
+  const size_t spaceDimension = cPrecondition->ncol;
+  const CInt * cCol = reinterpret_cast<const CInt *>( cPrecondition->p );
+  const CInt * cRow = reinterpret_cast<const CInt *>( cPrecondition->i );
+  const size_t nnz  = static_cast<size_t>( cCol[ spaceDimension ] );
+
+  /** The symbolic analysis, which computes the fill-reducing ordering, only
+   * depends on the sparsity pattern, so reuse it if that did not change.
+   */
+  this->m_ReusedSymbolicFactorization = this->m_CholmodFactor
+    && this->m_AnalyzedColumnPointers.size() == spaceDimension + 1
+    && this->m_AnalyzedRowIndices.size() == nnz
+    && std::equal( cCol, cCol + spaceDimension + 1, this->m_AnalyzedColumnPointers.begin() )
+    && std::equal( cRow, cRow + nnz, this->m_AnalyzedRowIndices.begin() );
+
+  if( !this->m_ReusedSymbolicFactorization )
+  {
+    if( this->m_CholmodFactor )
+    {
+      cholmod_free_factor( &this->m_CholmodFactor, this->m_CholmodCommon );
+      this->m_CholmodFactor = 0;
+    }
+
+    /** Prepare for factorization */
+    this->m_CholmodFactor = cholmod_analyze( cPrecondition, this->m_CholmodCommon );
+    this->m_AnalyzedColumnPointers.assign( cCol, cCol + spaceDimension + 1 );
+    this->m_AnalyzedRowIndices.assign( cRow, cRow + nnz );
+  }
+
+  /** Factorize cPrediction + diagonalWeight * largestEig * Identity */
+  double beta[2];
+  beta[0] = 0.0; // this->GetDiagonalWeight() * largestEig; but we already did that above
+  beta[1] = 0.0; // this is for potential imaginary part of complex number.
+  cholmod_factorize_p( cPrecondition, beta, nullptr, 0,
+    this->m_CholmodFactor, this->m_CholmodCommon );
+
+  /** The factorization stops at the first column that is not positive definite. */
+  return this->m_CholmodFactor
+    && this->m_CholmodCommon->status != CHOLMOD_NOT_POSDEF
+    && this->m_CholmodFactor->minor == this->m_CholmodFactor->n;
+
+} // end ComputeCholeskyFactorization()
+
+
+/**
+ * ************ ComputeIncompleteCholeskyFactorization ****************************
+ */
+
+bool
+PreconditionedGradientDescentOptimizer
+::ComputeIncompleteCholeskyFactorization( const cholmod_sparse * cPrecondition )
+{
+  /** The lower triangle by columns equals the upper triangle R by rows,
+   * with the diagonal element first in each row.
+   */
+  const size_t spaceDimension = cPrecondition->ncol;
+  const CInt * cCol = reinterpret_cast<const CInt *>( cPrecondition->p );
+  const CInt * cRow = reinterpret_cast<const CInt *>( cPrecondition->i );
+  const double * cVal = reinterpret_cast<const double *>( cPrecondition->x );
+  const size_t nnz  = static_cast<size_t>( cCol[ spaceDimension ] );
+
+  std::vector< CInt > &   pointers = this->m_IncompleteCholeskyRowPointers;
+  std::vector< CInt > &   indices  = this->m_IncompleteCholeskyColumnIndices;
+  std::vector< double > & values   = this->m_IncompleteCholeskyValues;
+  pointers.assign( cCol, cCol + spaceDimension + 1 );
+  indices.assign( cRow, cRow + nnz );
+  values.assign( cVal, cVal + nnz );
+
+  /** Right-looking IC(0): H(j,l) -= R(k,j) R(k,l) for k < j <= l, only for
+   * the entries (j,l) in the sparsity pattern of H.
+   */
+  for( size_t k = 0; k < spaceDimension; ++k )
+  {
+    const CInt begin = pointers[ k ];
+    const CInt end   = pointers[ k + 1 ];
+    if( begin == end || static_cast<size_t>( indices[ begin ] ) != k
+      || !( values[ begin ] > 0.0 ) )
+    {
+      std::vector< CInt >().swap( pointers );
+      std::vector< CInt >().swap( indices );
+      std::vector< double >().swap( values );
+      return false;
+    }
+
+    const double diag = std::sqrt( values[ begin ] );
+    values[ begin ] = diag;
+    for( CInt q = begin + 1; q < end; ++q )
+    {
+      values[ q ] /= diag;
+    }
+
+    for( CInt q = begin + 1; q < end; ++q )
+    {
+      const CInt   j   = indices[ q ];
+      const double rkj = values[ q ];
+
+      /** Merge row j with the part of row k from column j on. */
+      CInt s = pointers[ j ];
+      CInt t = q;
+      while( s < pointers[ j + 1 ] && t < end )
+      {
+        if( indices[ s ] < indices[ t ] )
+        {
+          ++s;
+        }
+        else if( indices[ s ] > indices[ t ] )
+        {
+          ++t;
+        }
+        else
+        {
+          values[ s ] -= rkj * values[ t ];
+          ++s;
+          ++t;
+        }
+      }
+    }
+  }
+
+  return true;
+
+} // end ComputeIncompleteCholeskyFactorization()
+
+
+/**
+ * ************ ComputeJacobiPreconditioner ****************************
+ */
+
+void
+PreconditionedGradientDescentOptimizer
+::ComputeJacobiPreconditioner( const cholmod_sparse * cPrecondition )
+{
+  const size_t spaceDimension = cPrecondition->ncol;
+  const CInt * cCol = reinterpret_cast<const CInt *>( cPrecondition->p );
+  const CInt * cRow = reinterpret_cast<const CInt *>( cPrecondition->i );
+  const double * cVal = reinterpret_cast<const double *>( cPrecondition->x );
+
+  /** Use the identity for rows without a positive diagonal element. */
+  this->m_JacobiDiagonal.assign( spaceDimension, 1.0 );
+  for( size_t r = 0; r < spaceDimension; ++r )
+  {
+    if( cCol[ r ] < cCol[ r + 1 ] && static_cast<size_t>( cRow[ cCol[ r ] ] ) == r
+      && cVal[ cCol[ r ] ] > 0.0 )
+    {
+      this->m_JacobiDiagonal[ r ] = cVal[ cCol[ r ] ];
+    }
+  }
+
+} // end ComputeJacobiPreconditioner()
+
+
 } // end namespace itk
 
 #endif
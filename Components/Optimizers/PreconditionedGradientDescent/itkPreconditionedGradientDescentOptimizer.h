@@ -23,6 +23,8 @@
 #include "vnl/vnl_sparse_matrix.h"
 #include "cholmod.h"
 
+#include <vector>
+
 namespace itk
 {
 /** \class PreconditionedGradientDescentOptimizer
@@ -47,6 +49,14 @@ namespace itk
  * The difference of this class with the itk::GradientDescentOptimizer
  * is that it's based on the ScaledSingleValuedNonLinearOptimizer
  *
+ * The preconditioner is the inverse of the matrix set by SetPreconditionMatrix().
+ * By default its Cholesky factorization is computed with CHOLMOD. The
+ * symbolic analysis is reused when the sparsity pattern of the matrix equals
+ * that of the previous call. For problems with more parameters than
+ * MaximumNumberOfParametersForCholesky, or when the factorization fails, an
+ * incomplete Cholesky factorization without fill-in is used instead, and when
+ * that breaks down, the diagonal (Jacobi) preconditioner.
+ *
  * \sa ScaledSingleValuedNonLinearOptimizer
  *
  * \ingroup Numerics Optimizers
@@ -93,6 +103,16 @@ public:
     MetricError,
     MinimumStepSize } StopConditionType;
 
+  /** The factorizations of the precondition matrix:
+   * Cholesky: the complete sparse Cholesky factorization, by CHOLMOD.
+   * IncompleteCholesky: the incomplete Cholesky factorization without fill-in.
+   * Jacobi: only the diagonal of the precondition matrix.
+   */
+  typedef enum {
+    Cholesky,
+    IncompleteCholesky,
+    Jacobi } PreconditionerMethodType;
+
   /** Advance one step following the gradient direction. */
   virtual void AdvanceOneStep( void );
 
@@ -162,6 +182,27 @@ public:
   itkSetMacro( DiagonalWeight, double );
   itkGetConstMacro( DiagonalWeight, double );
 
+  /** The requested factorization of the precondition matrix; default Cholesky. */
+  itkSetMacro( PreconditionerMethod, PreconditionerMethodType );
+  itkGetConstMacro( PreconditionerMethod, PreconditionerMethodType );
+
+  /** The maximum number of parameters for which the complete Cholesky
+   * factorization is computed. Larger problems use the incomplete Cholesky
+   * factorization. Default 0, meaning no maximum.
+   */
+  itkSetMacro( MaximumNumberOfParametersForCholesky, SizeValueType );
+  itkGetConstMacro( MaximumNumberOfParametersForCholesky, SizeValueType );
+
+  /** Get the factorization that is actually used, after the fallbacks;
+   * only valid after calling SetPreconditionMatrix.
+   */
+  itkGetConstMacro( UsedPreconditionerMethod, PreconditionerMethodType );
+
+  /** Get whether the symbolic analysis of the previous Cholesky factorization
+   * was reused; only valid after calling SetPreconditionMatrix.
+   */
+  itkGetConstMacro( ReusedSymbolicFactorization, bool );
+
   /** Threshold for elements of cost function derivative; default 1e-10 */
   itkSetMacro( MinimumGradientElementMagnitude, double );
   itkGetConstMacro( MinimumGradientElementMagnitude, double );
@@ -209,6 +250,14 @@ protected:
   virtual void CholmodSolve( const DerivativeType & gradient,
     DerivativeType & searchDirection, int solveType = CHOLMOD_A );
 
+  /** Solve Hx = g with the factorization that is used, see CholmodSolve().
+   * The incomplete Cholesky and Jacobi preconditioners are not permuted, so
+   * for them CHOLMOD_P and CHOLMOD_Pt copy the input. The Jacobi
+   * preconditioner uses the square root of the diagonal as factor.
+   */
+  virtual void PreconditionedSolve( const DerivativeType & gradient,
+    DerivativeType & searchDirection, int solveType = CHOLMOD_A );
+
 private:
   PreconditionedGradientDescentOptimizer(const Self&); // purposely not implemented
   void operator=(const Self&); // purposely not implemented
@@ -222,6 +271,38 @@ private:
   double                        m_DiagonalWeight;
   double                        m_MinimumGradientElementMagnitude;
 
+  PreconditionerMethodType      m_PreconditionerMethod;
+  PreconditionerMethodType      m_UsedPreconditionerMethod;
+  SizeValueType                 m_MaximumNumberOfParametersForCholesky;
+  bool                          m_ReusedSymbolicFactorization;
+
+  /** The sparsity pattern of the last matrix that was analyzed by CHOLMOD. */
+  std::vector< CInt >           m_AnalyzedColumnPointers;
+  std::vector< CInt >           m_AnalyzedRowIndices;
+
+  /** The incomplete Cholesky factor R, with H ~ R' R, in compressed row format,
+   * with the diagonal element first in each row.
+   */
+  std::vector< CInt >           m_IncompleteCholeskyRowPointers;
+  std::vector< CInt >           m_IncompleteCholeskyColumnIndices;
+  std::vector< double >         m_IncompleteCholeskyValues;
+
+  /** The diagonal of the precondition matrix, for the Jacobi preconditioner. */
+  std::vector< double >         m_JacobiDiagonal;
+
+  /** Compute the Cholesky factorization of the matrix in cholmod format.
+   * Returns false if the matrix is not positive definite.
+   */
+  bool ComputeCholeskyFactorization( cholmod_sparse * cPrecondition );
+
+  /** Compute the incomplete Cholesky factorization of the matrix in cholmod
+   * format. Returns false on a breakdown.
+   */
+  bool ComputeIncompleteCholeskyFactorization( const cholmod_sparse * cPrecondition );
+
+  /** Store the diagonal of the matrix in cholmod format. */
+  void ComputeJacobiPreconditioner( const cholmod_sparse * cPrecondition );
+
 };
 
 } // end namespace itk
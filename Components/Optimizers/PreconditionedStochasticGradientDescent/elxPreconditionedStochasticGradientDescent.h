@@ -29,6 +29,7 @@
 #include "itkMersenneTwisterRandomVariateGenerator.h"
 #include "itkAdvancedBSplineDeformableTransformBase.h"
 #include "itkImageRandomSampler.h"
+#include "itkParallelVectorOperations.h"
 
 
 namespace elastix
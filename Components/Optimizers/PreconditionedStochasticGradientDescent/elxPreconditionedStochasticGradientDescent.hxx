@@ -328,6 +328,12 @@ PreconditionedStochasticGradientDescent< TElastix >
     xl::xout[ "iteration" ][ "4b:||SearchDirection||" ] << this->GetSearchDirection().magnitude();
   }
 
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), this->GetGradient().magnitude() ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new spatial samples for the computation of the metric. */
   if( this->GetNewSamplesEveryIteration() )
   {
@@ -377,6 +383,8 @@ PreconditionedStochasticGradientDescent< TElastix >
       break;
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition. */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
@@ -469,11 +477,9 @@ PreconditionedStochasticGradientDescent< TElastix >
 
   /** Update the new position. */
   const double lamda2 = lamda * this->m_NoiseFactor;
-  for( unsigned int j = 0; j < spaceDimension; ++j )
-  {
-    searchDirection[ j ] = this->m_PreconditionVector[ j ] * this->m_Gradient[ j ];
-    newPosition[ j ] = currentPosition[ j ] - lamda2 * searchDirection[ j ];
-  }
+  itk::ParallelVectorOperations::PreconditionedScaledAdd( currentPosition.data_block(), -lamda2,
+    this->m_PreconditionVector.data_block(), this->m_Gradient.data_block(),
+    searchDirection.data_block(), newPosition.data_block(), spaceDimension );
 
   this->Superclass1::UpdateCurrentTime();
   this->InvokeEvent( itk::IterationEvent() );
@@ -561,7 +567,7 @@ PreconditionedStochasticGradientDescent< TElastix >
   unsigned int P = static_cast< unsigned int >(
     this->GetRegistration()->GetAsITKBaseType()->GetTransform()->GetNumberOfParameters() );
 
-  this->m_SearchDirection = ParametersType( P );
+  this->m_SearchDirection.SetSize( P );
   this->m_SearchDirection.Fill( 0.0 );// if the print out is not needed, this could be removed. YQ
   /** Get the current resolution level. */
   unsigned int level = static_cast< unsigned int >(
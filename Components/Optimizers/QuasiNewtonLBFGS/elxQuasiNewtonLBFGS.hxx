@@ -260,6 +260,12 @@ QuasiNewtonLBFGS< TElastix >
     "LineSearchGradientTolerance", this->GetComponentLabel(), level, 0 );
   this->m_LineOptimizer->SetGradientTolerance( lineSearchGradientTolerance );
 
+  /** Set the LineSearchNumberOfConcurrentStepLengths */
+  unsigned int lineSearchNumberOfConcurrentStepLengths = 1;
+  this->m_Configuration->ReadParameter( lineSearchNumberOfConcurrentStepLengths,
+    "LineSearchNumberOfConcurrentStepLengths", this->GetComponentLabel(), level, 0 );
+  this->m_LineOptimizer->SetNumberOfConcurrentStepLengths( lineSearchNumberOfConcurrentStepLengths );
+
   /** Set the GradientMagnitudeTolerance */
   double gradientMagnitudeTolerance = 0.000001;
   this->m_Configuration->ReadParameter( gradientMagnitudeTolerance,
@@ -272,6 +278,12 @@ QuasiNewtonLBFGS< TElastix >
     "LBFGSUpdateAccuracy", this->GetComponentLabel(), level, 0 );
   this->SetMemory( LBFGSUpdateAccuracy );
 
+  /** Set the LBFGSSinglePrecisionHistory */
+  bool useSinglePrecisionHistory = false;
+  this->m_Configuration->ReadParameter( useSinglePrecisionHistory,
+    "LBFGSSinglePrecisionHistory", this->GetComponentLabel(), level, 0 );
+  this->SetUseSinglePrecisionHistory( useSinglePrecisionHistory );
+
   /** Check whether to stop optimisation if Wolfe conditions are not satisfied. */
   this->m_StopIfWolfeNotSatisfied = true;
   std::string stopIfWolfeNotSatisfied = "true";
@@ -368,6 +380,13 @@ QuasiNewtonLBFGS< TElastix >
 
   if( !( this->GetInLineSearch() ) )
   {
+    /** Stop after a main iteration if one of the convergence criteria is met. */
+    if( this->TestConvergenceCriteria( this->GetCurrentValue(),
+      this->GetCurrentGradient().magnitude() ) )
+    {
+      this->StopOptimization();
+    }
+
     /** If new samples: compute a new gradient and value. These
      * will be used in the computation of a new search direction */
     if( this->GetNewSamplesEveryIteration() )
@@ -453,6 +472,8 @@ QuasiNewtonLBFGS< TElastix >
     }
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
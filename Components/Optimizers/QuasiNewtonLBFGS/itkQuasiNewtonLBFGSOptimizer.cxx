@@ -48,6 +48,7 @@ QuasiNewtonLBFGSOptimizer::QuasiNewtonLBFGSOptimizer()
   this->m_GradientMagnitudeTolerance = 1e-5;
   this->m_LineSearchOptimizer        = 0;
   this->m_Memory                     = 5;
+  this->m_UseSinglePrecisionHistory  = false;
 
 } // end constructor
 
@@ -80,10 +81,9 @@ QuasiNewtonLBFGSOptimizer::StartOptimization()
   this->m_CurrentGradient.SetSize( numberOfParameters );
   this->m_CurrentGradient.Fill( 0.0 );
 
-  /** Resize Rho, Alpha, S and Y. */
-  this->m_Rho.SetSize( this->GetMemory() );
-  this->m_S.resize( this->GetMemory() );
-  this->m_Y.resize( this->GetMemory() );
+  /** Allocate the history of s and y. */
+  this->m_History.Initialize( this->GetMemory(), numberOfParameters,
+    this->GetUseSinglePrecisionHistory() );
 
   /** Initialize the scaledCostFunction with the currently set scales */
   this->InitializeScales();
@@ -168,7 +168,7 @@ QuasiNewtonLBFGSOptimizer::ResumeOptimization()
       break;
     }
 
-    /** Store s (in m_S), y (in m_Y), and ys (in m_Rho). These are used to
+    /** Store s and y in m_History. These are used to
      * compute the search direction in the next iterations */
     if( this->GetMemory() > 0 )
     {
@@ -244,9 +244,8 @@ QuasiNewtonLBFGSOptimizer::ComputeDiagonalMatrix( DiagonalMatrixType & diag_H0 )
 
   if( this->m_Bound > 0 )
   {
-    const DerivativeType & y  = this->m_Y[ this->m_PreviousPoint ];
-    const double           ys = 1.0 / this->m_Rho[ this->m_PreviousPoint ];
-    const double           yy = y.squared_magnitude();
+    const double ys = 1.0 / this->m_History.GetRho( this->m_PreviousPoint );
+    const double yy = this->m_History.GetSquaredNormOfY( this->m_PreviousPoint );
     fill_value = ys / yy;
     if( fill_value <= 0. )
     {
@@ -271,57 +270,13 @@ QuasiNewtonLBFGSOptimizer::ComputeSearchDirection(
 {
   itkDebugMacro( "ComputeSearchDirection" );
 
-  /** Assumes m_Rho, m_S, and m_Y are up-to-date at m_PreviousPoint */
-
-  typedef Array< double > AlphaType;
-  AlphaType alpha( this->GetMemory() );
-
-  const unsigned int numberOfParameters = gradient.GetSize();
+  /** Assumes m_History is up-to-date at m_PreviousPoint */
   DiagonalMatrixType H0;
   this->ComputeDiagonalMatrix( H0 );
 
-  searchDir = -gradient;
-
-  int cp = static_cast< int >( this->m_Point );
-
-  for( unsigned int i = 0; i < this->m_Bound; ++i )
-  {
-    --cp;
-    if( cp == -1 )
-    {
-      cp = this->GetMemory() - 1;
-    }
-    const double sq = inner_product( this->m_S[ cp ], searchDir );
-    alpha[ cp ] = this->m_Rho[ cp ] * sq;
-    const double &         alpha_cp = alpha[ cp ];
-    const DerivativeType & y        = this->m_Y[ cp ];
-    for( unsigned int j = 0; j < numberOfParameters; ++j )
-    {
-      searchDir[ j ] -= alpha_cp * y[ j ];
-    }
-  }
-
-  for( unsigned int j = 0; j < numberOfParameters; ++j )
-  {
-    searchDir[ j ] *= H0[ j ];
-  }
-
-  for( unsigned int i = 0; i < this->m_Bound; ++i )
-  {
-    const double           yr             = inner_product( this->m_Y[ cp ], searchDir );
-    const double           beta           = this->m_Rho[ cp ] * yr;
-    const double           alpha_min_beta = alpha[ cp ] - beta;
-    const ParametersType & s              = this->m_S[ cp ];
-    for( unsigned int j = 0; j < numberOfParameters; ++j )
-    {
-      searchDir[ j ] += alpha_min_beta * s[ j ];
-    }
-    ++cp;
-    if( static_cast< unsigned int >( cp ) == this->GetMemory() )
-    {
-      cp = 0;
-    }
-  }
+  searchDir.SetSize( gradient.GetSize() );
+  this->m_History.ComputeSearchDirection( gradient.data_block(),
+    1.0, H0.data_block(), this->m_Point, this->m_Bound, searchDir.data_block() );
 
   /** Normalize if no information about previous steps is available yet */
   if( this->m_Bound == 0 )
@@ -407,9 +362,7 @@ QuasiNewtonLBFGSOptimizer::StoreCurrentPoint(
 {
   itkDebugMacro( "StoreCurrentPoint" );
 
-  this->m_S[ this->m_Point ]   = step;                                  // s
-  this->m_Y[ this->m_Point ]   = grad_dif;                              // y
-  this->m_Rho[ this->m_Point ] = 1.0 / inner_product( step, grad_dif ); // 1/ys
+  this->m_History.SetPair( this->m_Point, step.data_block(), grad_dif.data_block() );
 
 } // end StoreCurrentPoint
 
@@ -21,7 +21,7 @@
 
 #include "itkScaledSingleValuedNonLinearOptimizer.h"
 #include "itkLineSearchOptimizer.h"
-#include <vector>
+#include "itkLBFGSHistory.h"
 
 namespace itk
 {
@@ -74,11 +74,8 @@ public:
   typedef Superclass::MeasureType            MeasureType;
   typedef Superclass::ScalesType             ScalesType;
 
-  typedef Array< double >               RhoType;
-  typedef std::vector< ParametersType > SType;
-  typedef std::vector< DerivativeType > YType;
-  typedef Array< double >               DiagonalMatrixType;
-  typedef LineSearchOptimizer           LineSearchOptimizerType;
+  typedef Array< double >     DiagonalMatrixType;
+  typedef LineSearchOptimizer LineSearchOptimizerType;
 
   typedef LineSearchOptimizerType::Pointer LineSearchOptimizerPointer;
 
@@ -129,6 +126,11 @@ public:
   itkSetMacro( Memory, unsigned int );
   itkGetConstMacro( Memory, unsigned int );
 
+  /** Setting: store the s and y vectors of the memory in single precision,
+   * which halves the memory they use. False by default. */
+  itkSetMacro( UseSinglePrecisionHistory, bool );
+  itkGetConstMacro( UseSinglePrecisionHistory, bool );
+
 protected:
 
   QuasiNewtonLBFGSOptimizer();
@@ -147,9 +149,8 @@ protected:
   /** Is true when the LineSearchOptimizer has been started. */
   bool m_InLineSearch;
 
-  RhoType m_Rho;
-  SType   m_S;
-  YType   m_Y;
+  /** The s and y vectors, and their 1/(ys). */
+  LBFGSHistory m_History;
 
   unsigned int m_Point;
   unsigned int m_PreviousPoint;
@@ -184,8 +185,7 @@ protected:
     MeasureType & f,
     DerivativeType & g );
 
-  /** Store s = x_k - x_k-1 and y = g_k - g_k-1 in m_S and m_Y,
-   * and store 1/(ys) in m_Rho. */
+  /** Store s = x_k - x_k-1 and y = g_k - g_k-1 in m_History. */
   virtual void StoreCurrentPoint(
     const ParametersType & step,
     const DerivativeType & grad_dif );
@@ -205,6 +205,7 @@ private:
   double                     m_GradientMagnitudeTolerance;
   LineSearchOptimizerPointer m_LineSearchOptimizer;
   unsigned int               m_Memory;
+  bool                       m_UseSinglePrecisionHistory;
 
 };
 
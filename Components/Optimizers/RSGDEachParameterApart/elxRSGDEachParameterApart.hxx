@@ -114,6 +114,12 @@ RSGDEachParameterApart< TElastix >
   xl::xout[ "iteration" ][ "3:StepSize" ] << this->GetCurrentStepLength();
   xl::xout[ "iteration" ][ "4:||Gradient||" ] << this->GetGradientMagnitude();
 
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), this->GetGradientMagnitude() ) )
+  {
+    this->StopOptimization();
+  }
+
 } // end AfterEachIteration
 
 
@@ -165,6 +171,9 @@ RSGDEachParameterApart< TElastix >
       break;
 
   }
+
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
 
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
@@ -109,7 +109,15 @@ RegularStepGradientDescent< TElastix >
   /** Print some information */
   xl::xout[ "iteration" ][ "2:Metric" ] << this->GetValue();
   xl::xout[ "iteration" ][ "3:StepSize" ] << this->GetCurrentStepLength();
-  xl::xout[ "iteration" ][ "4:||Gradient||" ] << this->GetGradient().magnitude();
+  const double gradientMagnitude = this->GetGradient().magnitude();
+  xl::xout[ "iteration" ][ "4:||Gradient||" ] << gradientMagnitude;
+
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), gradientMagnitude ) )
+  {
+    this->StopOptimization();
+  }
+
 } // end AfterEachIteration
 
 
@@ -157,6 +165,9 @@ RegularStepGradientDescent< TElastix >
       break;
 
   }
+
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
 
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
@@ -19,7 +19,7 @@
 #define __elxSimplex_h
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
-#include "itkAmoebaOptimizer.h"
+#include "itkConcurrentAmoebaOptimizer.h"
 
 namespace elastix
 {
@@ -28,19 +28,31 @@ namespace elastix
  * \class Simplex
  * \brief An optimizer based on Simplex...
  *
- * This optimizer is a wrap around the itk::AmoebaOptimizer.
+ * This optimizer is a wrap around the itk::ConcurrentAmoebaOptimizer, which is
+ * an itk::AmoebaOptimizer that can evaluate several vertices concurrently.
  * This wrap-around class takes care of setting parameters, and printing progress
  * information.
  * For detailed information about the optimisation method, please read the
  * documentation of the itkAmoebaOptimizer (in the ITK-manual).
- * \sa ImprovedSimplexOptimizer
+ *
+ * The parameters used in this class are:
+ * \parameter Optimizer: Select this optimizer as follows:\n
+ *    <tt>(Optimizer "Simplex")</tt>
+ * \parameter UseConcurrentVertexEvaluation: Evaluate the vertices of the
+ *    initial simplex and of the shrink steps concurrently, see the
+ *    itk::ConcurrentAmoebaOptimizer. Can be given for each resolution.\n
+ *    example: <tt>(UseConcurrentVertexEvaluation "true")</tt>\n
+ *    The default value is false, which runs the vnl_amoeba of the
+ *    itk::AmoebaOptimizer.
+ *
+ * \sa ImprovedSimplexOptimizer, ConcurrentAmoebaOptimizer
  * \ingroup Optimizers
  */
 
 template< class TElastix >
 class Simplex :
   public
-  itk::AmoebaOptimizer,
+  itk::ConcurrentAmoebaOptimizer,
   public
   OptimizerBase< TElastix >
 {
@@ -48,7 +60,7 @@ public:
 
   /** Standard ITK.*/
   typedef Simplex                         Self;
-  typedef AmoebaOptimizer                 Superclass1;
+  typedef ConcurrentAmoebaOptimizer       Superclass1;
   typedef OptimizerBase< TElastix >       Superclass2;
   typedef itk::SmartPointer< Self >       Pointer;
   typedef itk::SmartPointer< const Self > ConstPointer;
@@ -57,7 +69,7 @@ public:
   itkNewMacro( Self );
 
   /** Run-time type information (and related methods). */
-  itkTypeMacro( Simplex, AmoebaOptimizer );
+  itkTypeMacro( Simplex, ConcurrentAmoebaOptimizer );
 
   /** Name of this class.
    * Use this name in the parameter file to select this specific optimizer. \n
@@ -97,6 +97,12 @@ Simplex< TElastix >
     this->SetInitialSimplexDelta( initialsimplexdelta );
   }
 
+  /** Set whether the vertices are evaluated concurrently. */
+  bool useConcurrentVertexEvaluation = false;
+  this->m_Configuration->ReadParameter( useConcurrentVertexEvaluation,
+    "UseConcurrentVertexEvaluation", this->GetComponentLabel(), level, 0 );
+  this->SetUseConcurrentEvaluation( useConcurrentVertexEvaluation );
+
 } // end BeforeEachResolution()
 
 
@@ -110,7 +116,7 @@ Simplex< TElastix >
 ::AfterEachIteration( void )
 {
   /** Print some information */
-  xl::xout[ "iteration" ][ "2:Metric" ] << this->GetCachedValue();
+  xl::xout[ "iteration" ][ "2:Metric" ] << this->GetCurrentValue();
   //xl::xout["iteration"]["3:StepSize"] << this->GetStepLength();
 
 } // end AfterEachIteration()
@@ -133,6 +139,11 @@ Simplex< TElastix >
 
   /** Print the stopping condition */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
+  if( this->GetUsedConcurrentEvaluation() )
+  {
+    elxout << "The vertices were evaluated concurrently, with "
+           << this->GetNumberOfFunctionEvaluations() << " function evaluations." << std::endl;
+  }
 
 } // end AfterEachResolution()
 
@@ -148,7 +159,7 @@ Simplex< TElastix >
 {
   /** Print the best metric value */
   //double bestValue = this->GetValue();
-  double bestValue = this->GetCachedValue();
+  double bestValue = this->GetCurrentValue();
   elxout << std::endl << "Final metric value  = " << bestValue  << std::endl;
 
 } // end AfterRegistration()
@@ -0,0 +1,414 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkConcurrentAmoebaOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+namespace itk
+{
+
+/**
+ * The relative size of the automatic initial simplex, and its size for the
+ * parameters that are zero, as in vnl_amoeba.
+ */
+static const double ConcurrentAmoebaRelativeDiameter = 0.05;
+static const double ConcurrentAmoebaZeroTermDelta    = 0.00025;
+
+/**
+ * ******************* Constructor *******************
+ */
+
+ConcurrentAmoebaOptimizer
+::ConcurrentAmoebaOptimizer()
+{
+  this->m_NumberOfFunctionEvaluations = 0;
+  this->m_CurrentValue                = NumericTraits< MeasureType >::max();
+  this->m_UseConcurrentEvaluation     = false;
+  this->m_UsedConcurrentEvaluation    = false;
+
+} // end Constructor
+
+
+/**
+ * ******************* SetCostFunction *******************
+ */
+
+void
+ConcurrentAmoebaOptimizer
+::SetCostFunction( CostFunctionType * costFunction )
+{
+  this->m_ConcurrentCostFunction = costFunction;
+  this->Superclass::SetCostFunction( costFunction );
+
+} // end SetCostFunction()
+
+
+/**
+ * ******************* StartOptimization *******************
+ */
+
+void
+ConcurrentAmoebaOptimizer
+::StartOptimization( void )
+{
+  const MultipleValuesCostFunctionInterface * costFunction
+    = dynamic_cast< const MultipleValuesCostFunctionInterface * >(
+    this->m_ConcurrentCostFunction.GetPointer() );
+
+  this->m_UsedConcurrentEvaluation = this->m_UseConcurrentEvaluation
+    && costFunction != nullptr && this->GetInitialPosition().GetSize() > 0;
+  this->m_ConcurrentStopConditionDescription = "";
+
+  if( !this->m_UsedConcurrentEvaluation )
+  {
+    this->Superclass::StartOptimization();
+    return;
+  }
+
+  this->OptimizeConcurrently();
+
+} // end StartOptimization()
+
+
+/**
+ * ******************* OptimizeConcurrently *******************
+ */
+
+void
+ConcurrentAmoebaOptimizer
+::OptimizeConcurrently( void )
+{
+  this->m_NumberOfFunctionEvaluations = 0;
+  this->InvokeEvent( StartEvent() );
+
+  const ParametersType & initialPosition = this->GetInitialPosition();
+  const unsigned int     n               = initialPosition.GetSize();
+  const ScalesType &     scales          = this->GetScales();
+  const bool             useScales       = scales.GetSize() == n;
+
+  /** Build the initial simplex in the scaled parameter space. */
+  std::vector< VertexType > simplex( n + 1, VertexType( n ) );
+  for( unsigned int j = 0; j < n; ++j )
+  {
+    simplex[ 0 ][ j ] = initialPosition[ j ] * ( useScales ? scales[ j ] : 1.0 );
+  }
+  const ParametersType & delta = this->GetInitialSimplexDelta();
+  for( unsigned int j = 0; j < n; ++j )
+  {
+    VertexType & vertex = simplex[ j + 1 ];
+    vertex = simplex[ 0 ];
+    if( this->GetAutomaticInitialSimplex() || delta.GetSize() != n )
+    {
+      if( std::abs( vertex[ j ] ) > ConcurrentAmoebaZeroTermDelta )
+      {
+        vertex[ j ] *= 1.0 + ConcurrentAmoebaRelativeDiameter;
+      }
+      else
+      {
+        vertex[ j ] = ConcurrentAmoebaZeroTermDelta;
+      }
+    }
+    else
+    {
+      vertex[ j ] += delta[ j ] * ( useScales ? scales[ j ] : 1.0 );
+    }
+  }
+
+  /** All vertices of the initial simplex are evaluated in one call. */
+  std::vector< MeasureType > values;
+  this->EvaluateVertices( simplex, values );
+
+  const double       parametersTolerance        = this->GetParametersConvergenceTolerance();
+  const double       functionTolerance          = this->GetFunctionConvergenceTolerance();
+  const unsigned int maximumNumberOfEvaluations = this->GetMaximumNumberOfIterations();
+
+  std::vector< unsigned int > order( n + 1 );
+  std::vector< VertexType >   sortedSimplex( n + 1 );
+  std::vector< MeasureType >  sortedValues( n + 1 );
+  VertexType                  centroid( n );
+  VertexType                  reflected( n );
+  VertexType                  trial( n );
+  ParametersType              position;
+  unsigned int                numberOfIterations = 0;
+
+  while( true )
+  {
+    /** Sort the vertices by increasing value; the best one comes first. */
+    std::iota( order.begin(), order.end(), 0u );
+    std::stable_sort( order.begin(), order.end(),
+      [ &values ]( const unsigned int a, const unsigned int b ) { return values[ a ] < values[ b ]; } );
+    for( unsigned int i = 0; i <= n; ++i )
+    {
+      sortedSimplex[ i ].swap( simplex[ order[ i ] ] );
+      sortedValues[ i ] = values[ order[ i ] ];
+    }
+    simplex.swap( sortedSimplex );
+    values.swap( sortedValues );
+
+    this->m_CurrentValue = values[ 0 ];
+    this->ConvertVertexToParameters( simplex[ 0 ], position );
+    this->SetCurrentPosition( position );
+    if( numberOfIterations > 0 )
+    {
+      this->InvokeEvent( IterationEvent() );
+    }
+
+    /** Test the convergence criteria of vnl_amoeba. */
+    double diameter = 0.0;
+    for( unsigned int i = 1; i <= n; ++i )
+    {
+      for( unsigned int j = 0; j < n; ++j )
+      {
+        diameter = std::max( diameter, std::abs( simplex[ i ][ j ] - simplex[ 0 ][ j ] ) );
+      }
+    }
+    if( diameter < parametersTolerance && values[ n ] - values[ 0 ] < functionTolerance )
+    {
+      std::ostringstream description;
+      description << this->GetNameOfClass() << ": Both parameters convergence tolerance ("
+                  << parametersTolerance << ") and function convergence tolerance ("
+                  << functionTolerance << ") have been met in "
+                  << this->m_NumberOfFunctionEvaluations << " function evaluations";
+      this->m_ConcurrentStopConditionDescription = description.str();
+      break;
+    }
+    if( this->m_NumberOfFunctionEvaluations >= maximumNumberOfEvaluations )
+    {
+      std::ostringstream description;
+      description << this->GetNameOfClass() << ": Maximum number of iterations exceeded. "
+                  << "Number of function evaluations is " << this->m_NumberOfFunctionEvaluations;
+      this->m_ConcurrentStopConditionDescription = description.str();
+      break;
+    }
+
+    /** The centroid of all vertices but the worst. */
+    const VertexType & worst = simplex[ n ];
+    std::fill( centroid.begin(), centroid.end(), 0.0 );
+    for( unsigned int i = 0; i < n; ++i )
+    {
+      for( unsigned int j = 0; j < n; ++j )
+      {
+        centroid[ j ] += simplex[ i ][ j ];
+      }
+    }
+    for( unsigned int j = 0; j < n; ++j )
+    {
+      centroid[ j ] /= static_cast< double >( n );
+      reflected[ j ] = 2.0 * centroid[ j ] - worst[ j ];
+    }
+    const MeasureType reflectedValue = this->EvaluateVertex( reflected );
+
+    if( reflectedValue < values[ 0 ] )
+    {
+      /** Try to expand. */
+      for( unsigned int j = 0; j < n; ++j )
+      {
+        trial[ j ] = 3.0 * centroid[ j ] - 2.0 * worst[ j ];
+      }
+      const MeasureType expandedValue = this->EvaluateVertex( trial );
+      if( expandedValue < reflectedValue )
+      {
+        simplex[ n ] = trial;
+        values[ n ]  = expandedValue;
+      }
+      else
+      {
+        simplex[ n ] = reflected;
+        values[ n ]  = reflectedValue;
+      }
+    }
+    else if( reflectedValue < values[ n - 1 ] )
+    {
+      simplex[ n ] = reflected;
+      values[ n ]  = reflectedValue;
+    }
+    else
+    {
+      /** Contract outside the simplex if the reflection is better than the
+       * worst vertex, and inside otherwise.
+       */
+      const bool        outside = reflectedValue < values[ n ];
+      const VertexType & from   = outside ? reflected : worst;
+      for( unsigned int j = 0; j < n; ++j )
+      {
+        trial[ j ] = 0.5 * ( centroid[ j ] + from[ j ] );
+      }
+      const MeasureType contractedValue = this->EvaluateVertex( trial );
+      if( contractedValue < std::min( reflectedValue, values[ n ] ) )
+      {
+        simplex[ n ] = trial;
+        values[ n ]  = contractedValue;
+      }
+      else
+      {
+        /** Shrink towards the best vertex; the new vertices are evaluated in
+         * one call.
+         */
+        std::vector< VertexType > shrunk( simplex.begin() + 1, simplex.end() );
+        for( VertexType & vertex : shrunk )
+        {
+          for( unsigned int j = 0; j < n; ++j )
+          {
+            vertex[ j ] = 0.5 * ( simplex[ 0 ][ j ] + vertex[ j ] );
+          }
+        }
+        std::vector< MeasureType > shrunkValues;
+        this->EvaluateVertices( shrunk, shrunkValues );
+        for( unsigned int i = 1; i <= n; ++i )
+        {
+          simplex[ i ].swap( shrunk[ i - 1 ] );
+          values[ i ] = shrunkValues[ i - 1 ];
+        }
+      }
+    }
+
+    ++numberOfIterations;
+  }
+
+  this->InvokeEvent( EndEvent() );
+
+} // end OptimizeConcurrently()
+
+
+/**
+ * ******************* EvaluateVertices *******************
+ */
+
+void
+ConcurrentAmoebaOptimizer
+::EvaluateVertices( const std::vector< VertexType > & vertices,
+  std::vector< MeasureType > & values ) const
+{
+  MultipleValuesCostFunctionInterface::ParametersVectorType parameters( vertices.size() );
+  for( std::size_t i = 0; i < vertices.size(); ++i )
+  {
+    this->ConvertVertexToParameters( vertices[ i ], parameters[ i ] );
+  }
+
+  const MultipleValuesCostFunctionInterface * costFunction
+    = dynamic_cast< const MultipleValuesCostFunctionInterface * >(
+    this->m_ConcurrentCostFunction.GetPointer() );
+  if( costFunction != nullptr && parameters.size() > 1 )
+  {
+    costFunction->GetValues( parameters, values );
+  }
+  else
+  {
+    values.resize( parameters.size() );
+    for( std::size_t i = 0; i < parameters.size(); ++i )
+    {
+      values[ i ] = this->m_ConcurrentCostFunction->GetValue( parameters[ i ] );
+    }
+  }
+  this->m_NumberOfFunctionEvaluations += static_cast< unsigned int >( parameters.size() );
+
+} // end EvaluateVertices()
+
+
+/**
+ * ******************* EvaluateVertex *******************
+ */
+
+ConcurrentAmoebaOptimizer::MeasureType
+ConcurrentAmoebaOptimizer
+::EvaluateVertex( const VertexType & vertex ) const
+{
+  ParametersType parameters;
+  this->ConvertVertexToParameters( vertex, parameters );
+  ++this->m_NumberOfFunctionEvaluations;
+  return this->m_ConcurrentCostFunction->GetValue( parameters );
+
+} // end EvaluateVertex()
+
+
+/**
+ * ******************* ConvertVertexToParameters *******************
+ */
+
+void
+ConcurrentAmoebaOptimizer
+::ConvertVertexToParameters( const VertexType & vertex,
+  ParametersType & parameters ) const
+{
+  const ScalesType & scales    = this->GetScales();
+  const bool         useScales = scales.GetSize() == vertex.size();
+
+  parameters.SetSize( static_cast< unsigned int >( vertex.size() ) );
+  for( unsigned int j = 0; j < vertex.size(); ++j )
+  {
+    parameters[ j ] = useScales ? vertex[ j ] / scales[ j ] : vertex[ j ];
+  }
+
+} // end ConvertVertexToParameters()
+
+
+/**
+ * ******************* GetCurrentValue *******************
+ */
+
+ConcurrentAmoebaOptimizer::MeasureType
+ConcurrentAmoebaOptimizer
+::GetCurrentValue( void ) const
+{
+  if( this->m_UsedConcurrentEvaluation )
+  {
+    return this->m_CurrentValue;
+  }
+  return this->GetCachedValue();
+
+} // end GetCurrentValue()
+
+
+/**
+ * ******************* GetStopConditionDescription *******************
+ */
+
+const std::string
+ConcurrentAmoebaOptimizer
+::GetStopConditionDescription( void ) const
+{
+  if( this->m_UsedConcurrentEvaluation )
+  {
+    return this->m_ConcurrentStopConditionDescription;
+  }
+  return this->Superclass::GetStopConditionDescription();
+
+} // end GetStopConditionDescription()
+
+
+/**
+ * ******************* PrintSelf *******************
+ */
+
+void
+ConcurrentAmoebaOptimizer
+::PrintSelf( std::ostream & os, Indent indent ) const
+{
+  Superclass::PrintSelf( os, indent );
+
+  os << indent << "UseConcurrentEvaluation: " << this->m_UseConcurrentEvaluation << std::endl;
+  os << indent << "UsedConcurrentEvaluation: " << this->m_UsedConcurrentEvaluation << std::endl;
+  os << indent << "NumberOfFunctionEvaluations: " << this->m_NumberOfFunctionEvaluations << std::endl;
+
+} // end PrintSelf()
+
+
+} // end namespace itk
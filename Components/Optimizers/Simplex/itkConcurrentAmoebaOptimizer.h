@@ -0,0 +1,149 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkConcurrentAmoebaOptimizer_h
+#define __itkConcurrentAmoebaOptimizer_h
+
+#include "itkAmoebaOptimizer.h"
+#include "itkMultipleValuesCostFunctionInterface.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/**
+ * \class ConcurrentAmoebaOptimizer
+ * \brief An AmoebaOptimizer that evaluates the simplex vertices concurrently.
+ *
+ * The AmoebaOptimizer runs the Nelder-Mead method of vnl_amoeba, which
+ * evaluates the cost function at one vertex at a time. The initial simplex
+ * and the shrink steps need the values at N new vertices, for N parameters,
+ * which do not depend on each other. If UseConcurrentEvaluation is set and
+ * the cost function implements the MultipleValuesCostFunctionInterface, this
+ * class runs its own Nelder-Mead iterations instead, and computes these values
+ * in one call of GetValues(). The reflection, expansion and contraction steps
+ * are evaluated one by one, as before.
+ *
+ * The method follows vnl_amoeba: the simplex is built in the scaled parameter
+ * space, either relative to the initial position (AutomaticInitialSimplex) or
+ * with the InitialSimplexDelta, and the optimization stops when both the
+ * simplex diameter is smaller than the ParametersConvergenceTolerance and the
+ * range of the values is smaller than the FunctionConvergenceTolerance, or
+ * when the MaximumNumberOfIterations function evaluations have been done.
+ * The IterationEvent is invoked after each Nelder-Mead iteration, and not
+ * after each function evaluation. OptimizeWithRestarts is not supported in
+ * this mode.
+ *
+ * Otherwise, which is the default, StartOptimization() of the AmoebaOptimizer
+ * is called.
+ *
+ * \ingroup Numerics Optimizers
+ */
+
+class ConcurrentAmoebaOptimizer :
+  public AmoebaOptimizer
+{
+public:
+
+  /** Standard ITK.*/
+  typedef ConcurrentAmoebaOptimizer  Self;
+  typedef AmoebaOptimizer            Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ConcurrentAmoebaOptimizer, AmoebaOptimizer );
+
+  /** Typedefs inherited from the superclass. */
+  typedef Superclass::ParametersType   ParametersType;
+  typedef Superclass::MeasureType      MeasureType;
+  typedef Superclass::ScalesType       ScalesType;
+  typedef Superclass::CostFunctionType CostFunctionType;
+
+  /** Store the cost function, and pass it to the superclass. */
+  void SetCostFunction( CostFunctionType * costFunction ) override;
+
+  /** Start the optimization. */
+  void StartOptimization( void ) override;
+
+  /** Setting: evaluate the vertices of the initial simplex and of the shrink
+   * steps concurrently. Default: false.
+   */
+  itkSetMacro( UseConcurrentEvaluation, bool );
+  itkGetConstMacro( UseConcurrentEvaluation, bool );
+  itkBooleanMacro( UseConcurrentEvaluation );
+
+  /** Whether the last optimization evaluated the vertices concurrently. */
+  itkGetConstMacro( UsedConcurrentEvaluation, bool );
+
+  /** The value at the best vertex, or the cached value of the superclass
+   * if the vertices were not evaluated concurrently.
+   */
+  MeasureType GetCurrentValue( void ) const;
+
+  /** The number of function evaluations of the last optimization. */
+  itkGetConstMacro( NumberOfFunctionEvaluations, unsigned int );
+
+  /** Get the reason for termination. */
+  const std::string GetStopConditionDescription( void ) const override;
+
+protected:
+
+  ConcurrentAmoebaOptimizer();
+  ~ConcurrentAmoebaOptimizer() override {}
+
+  void PrintSelf( std::ostream & os, Indent indent ) const override;
+
+  /** A vertex of the simplex, in the scaled parameter space. */
+  typedef std::vector< double > VertexType;
+
+  /** Compute the values at the given vertices, concurrently if possible. */
+  void EvaluateVertices( const std::vector< VertexType > & vertices,
+    std::vector< MeasureType > & values ) const;
+
+  /** Compute the value at one vertex. */
+  MeasureType EvaluateVertex( const VertexType & vertex ) const;
+
+private:
+
+  ConcurrentAmoebaOptimizer( const Self & ); // purposely not implemented
+  void operator=( const Self & );            // purposely not implemented
+
+  /** Convert a vertex to the parameters of the cost function. */
+  void ConvertVertexToParameters( const VertexType & vertex,
+    ParametersType & parameters ) const;
+
+  /** Run the Nelder-Mead iterations with concurrent vertex evaluation. */
+  void OptimizeConcurrently( void );
+
+  SingleValuedCostFunction::ConstPointer m_ConcurrentCostFunction;
+  mutable unsigned int                   m_NumberOfFunctionEvaluations;
+  MeasureType                            m_CurrentValue;
+  std::string                            m_ConcurrentStopConditionDescription;
+  bool                                   m_UseConcurrentEvaluation;
+  bool                                   m_UsedConcurrentEvaluation;
+
+};
+
+} // end namespace itk
+
+#endif // end #ifndef __itkConcurrentAmoebaOptimizer_h
@@ -20,6 +20,8 @@
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
 #include "itkSPSAOptimizer.h"
+#include "itkMultipleValuesCostFunctionInterface.h"
+#include "itkPhiloxRandomGenerator.h"
 
 namespace elastix
 {
@@ -32,6 +34,10 @@ namespace elastix
  *
  * This optimizer supports the NewSamplesEveryIteration parameter.
  *
+ * The cost function is evaluated at the perturbed parameters of all perturbations
+ * in one call of GetValues(), if it implements the MultipleValuesCostFunctionInterface,
+ * so that these evaluations may be done concurrently.
+ *
  * The parameters used in this class are:
  * \parameter Optimizer: Select this optimizer as follows:\n
  *    <tt>(Optimizer "SimultaneousPerturbation")</tt>
@@ -74,6 +80,12 @@ namespace elastix
  *   This flag can NOT be defined for each resolution. \n
  *   example: <tt>(ShowMetricValues "true" )</tt> \n
  *   Default value: "false". Note that turning this flag on increases computation time.
+ * \parameter UseCounterBasedRandomGenerator: Draw the perturbations with a counter-based
+ *   random generator, keyed by the Mersenne Twister at the start of each resolution,
+ *   so that every perturbation is determined by its number in the resolution. \n
+ *   This parameter can be defined for each resolution. \n
+ *   example: <tt>(UseCounterBasedRandomGenerator "true")</tt> \n
+ *   Default value: "false".
  *
  *
  * \ingroup Optimizers
@@ -123,6 +135,7 @@ public:
 
   /** Typedef for the ParametersType. */
   typedef typename Superclass1::ParametersType ParametersType;
+  typedef typename Superclass1::DerivativeType DerivativeType;
 
   /** Methods that take care of setting parameters and printing progress information.*/
   void BeforeRegistration( void ) override;
@@ -148,6 +161,22 @@ protected:
 
   bool m_ShowMetricValues;
 
+  /** Compute the gradient estimate like the SPSAOptimizer does, but pass the
+   * perturbed parameters of all perturbations to the cost function at once.
+   */
+  void ComputeGradient( const ParametersType & parameters,
+    DerivativeType & gradient ) override;
+
+  /** Generate the perturbation with the counter-based random generator if
+   * selected, and like the SPSAOptimizer otherwise.
+   */
+  void GenerateDelta( const unsigned int spaceDimension ) override;
+
+  /** Settings of the counter-based random generator. */
+  bool                                m_UseCounterBasedRandomGenerator;
+  itk::PhiloxRandomGenerator::KeyType m_CounterBasedRandomKey;
+  unsigned long                       m_NumberOfGeneratedDeltas;
+
 private:
 
   SimultaneousPerturbation( const Self & );     // purposely not implemented
@@ -22,6 +22,7 @@
 #include "elxSimultaneousPerturbation.h"
 #include <iomanip>
 #include <string>
+#include <vector>
 #include "vnl/vnl_math.h"
 
 namespace elastix
@@ -35,7 +36,10 @@ template< class TElastix >
 SimultaneousPerturbation< TElastix >
 ::SimultaneousPerturbation()
 {
-  this->m_ShowMetricValues = false;
+  this->m_ShowMetricValues               = false;
+  this->m_UseCounterBasedRandomGenerator = false;
+  this->m_CounterBasedRandomKey          = 0;
+  this->m_NumberOfGeneratedDeltas        = 0;
 } // end Constructor
 
 
@@ -119,6 +123,20 @@ SimultaneousPerturbation< TElastix >
   /** Ignore the build-in stop criterion; it's quite ad hoc. */
   this->SetTolerance( 0.0 );
 
+  /** Set the counter-based random generator, with a new key per resolution. */
+  this->m_UseCounterBasedRandomGenerator = false;
+  this->m_Configuration->ReadParameter( this->m_UseCounterBasedRandomGenerator,
+    "UseCounterBasedRandomGenerator", this->GetComponentLabel(), level, 0 );
+  if( this->m_UseCounterBasedRandomGenerator )
+  {
+    typedef itk::Statistics::MersenneTwisterRandomVariateGenerator GeneratorType;
+    GeneratorType::Pointer generator = GeneratorType::GetInstance();
+    const itk::PhiloxRandomGenerator::KeyType high = generator->GetIntegerVariate();
+    const itk::PhiloxRandomGenerator::KeyType low  = generator->GetIntegerVariate();
+    this->m_CounterBasedRandomKey = ( high << 32 ) | low;
+  }
+  this->m_NumberOfGeneratedDeltas = 0;
+
 } // end BeforeEachResolution
 
 
@@ -145,6 +163,16 @@ SimultaneousPerturbation< TElastix >
   xl::xout[ "iteration" ][ "3:Gain a_k" ] << this->GetLearningRate();
   xl::xout[ "iteration" ][ "4:||Gradient||" ] << this->GetGradientMagnitude();
 
+  /** Stop if one of the convergence criteria is met. The metric value
+   * is only known if it is shown.
+   */
+  const double value = this->m_ShowMetricValues
+    ? this->GetValue() : std::numeric_limits< double >::quiet_NaN();
+  if( this->TestConvergenceCriteria( value, this->GetGradientMagnitude() ) )
+  {
+    this->StopOptimization();
+  }
+
   /** Select new spatial samples for the computation of the metric
    * \todo You may also choose to select new samples upon every evaluation
    * of the metric value
@@ -189,6 +217,9 @@ SimultaneousPerturbation< TElastix >
       break;
 
   }
+
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
 
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
@@ -251,6 +282,114 @@ SimultaneousPerturbation< TElastix >
 } // end SetInitialPosition
 
 
+/**
+ * ******************* ComputeGradient ***********************
+ */
+
+template< class TElastix >
+void
+SimultaneousPerturbation< TElastix >
+::ComputeGradient( const ParametersType & parameters, DerivativeType & gradient )
+{
+  const unsigned int  spaceDimension        = parameters.GetSize();
+  const unsigned long numberOfPerturbations = this->GetNumberOfPerturbations();
+  const double        ck                    = this->Compute_c( this->m_CurrentIteration );
+
+  typedef itk::MultipleValuesCostFunctionInterface CostFunctionInterfaceType;
+
+  /** Draw the perturbations in the same order as the SPSAOptimizer. */
+  std::vector< DerivativeType >                   deltas( numberOfPerturbations );
+  CostFunctionInterfaceType::ParametersVectorType perturbedParameters(
+    2 * numberOfPerturbations, ParametersType( spaceDimension ) );
+  for( unsigned long perturbation = 0; perturbation < numberOfPerturbations; ++perturbation )
+  {
+    this->GenerateDelta( spaceDimension );
+    deltas[ perturbation ] = this->m_Delta;
+
+    ParametersType & thetaplus = perturbedParameters[ 2 * perturbation ];
+    ParametersType & thetamin  = perturbedParameters[ 2 * perturbation + 1 ];
+    for( unsigned int j = 0; j < spaceDimension; ++j )
+    {
+      thetaplus[ j ] = parameters[ j ] + ck * this->m_Delta[ j ];
+      thetamin[ j ]  = parameters[ j ] - ck * this->m_Delta[ j ];
+    }
+  }
+
+  /** Evaluate all perturbed parameters, concurrently if possible. */
+  CostFunctionInterfaceType::MeasureVectorType values;
+  const CostFunctionInterfaceType *            costFunction
+    = dynamic_cast< const CostFunctionInterfaceType * >( this->GetCostFunction() );
+  if( costFunction != nullptr )
+  {
+    costFunction->GetValues( perturbedParameters, values );
+  }
+  else
+  {
+    values.resize( perturbedParameters.size() );
+    for( std::size_t i = 0; i < perturbedParameters.size(); ++i )
+    {
+      values[ i ] = this->GetCostFunction()->GetValue( perturbedParameters[ i ] );
+    }
+  }
+
+  /** Average the gradient estimates of the perturbations. */
+  gradient.SetSize( spaceDimension );
+  gradient.Fill( 0.0 );
+  for( unsigned long perturbation = 0; perturbation < numberOfPerturbations; ++perturbation )
+  {
+    const double valuediff
+      = ( values[ 2 * perturbation ] - values[ 2 * perturbation + 1 ] ) / ( 2.0 * ck );
+    const DerivativeType & delta = deltas[ perturbation ];
+    for( unsigned int j = 0; j < spaceDimension; ++j )
+    {
+      gradient[ j ] += valuediff / delta[ j ];
+    }
+  }
+  for( unsigned int j = 0; j < spaceDimension; ++j )
+  {
+    gradient[ j ] /= static_cast< double >( numberOfPerturbations );
+  }
+
+} // end ComputeGradient()
+
+
+/**
+ * ******************* GenerateDelta ***********************
+ */
+
+template< class TElastix >
+void
+SimultaneousPerturbation< TElastix >
+::GenerateDelta( const unsigned int spaceDimension )
+{
+  if( !this->m_UseCounterBasedRandomGenerator )
+  {
+    this->Superclass1::GenerateDelta( spaceDimension );
+    return;
+  }
+
+  const ScalesType & scales = this->GetScales();
+  if( scales.size() != spaceDimension )
+  {
+    itkExceptionMacro( << "The size of Scales is " << scales.size()
+                       << ", but the NumberOfParameters is " << spaceDimension << "." );
+  }
+
+  /** Randomly -1 or 1 per parameter, divided by the scales as the
+   * SPSAOptimizer does. The stream is the number of the perturbation.
+   */
+  this->m_Delta = DerivativeType( spaceDimension );
+  const unsigned long stream = this->m_NumberOfGeneratedDeltas++;
+  for( unsigned int j = 0; j < spaceDimension; ++j )
+  {
+    const double u = itk::PhiloxRandomGenerator::GetUniformVariate(
+      this->m_CounterBasedRandomKey, stream, j );
+    this->m_Delta[ j ] = ( u < 0.5 ? -1.0 : 1.0 ) / scales[ j ];
+  }
+
+} // end GenerateDelta()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxSimultaneousPerturbation_hxx
@@ -125,6 +125,15 @@ public:
   * after that call the superclass' implementation */
   void StartOptimization( void ) override;
 
+  /** This optimizer supports restricting the optimization to a set of
+   * active parameters, see the UseActiveSetOfControlPoints parameter of the
+   * BSplineTransform.
+   */
+  bool GetSupportsActiveParameters( void ) const override
+  {
+    return true;
+  }
+
   /** Stop optimisation and pass on exception. */
   void MetricErrorResponse( itk::ExceptionObject & err ) override;
 
@@ -123,7 +123,14 @@ StandardGradientDescent< TElastix >
   /** Print some information */
   xl::xout[ "iteration" ][ "2:Metric" ] << this->GetValue();
   xl::xout[ "iteration" ][ "3:StepSize" ] << this->GetLearningRate();
-  xl::xout[ "iteration" ][ "4:||Gradient||" ] << this->GetGradient().magnitude();
+  const double gradientMagnitude = this->GetGradient().magnitude();
+  xl::xout[ "iteration" ][ "4:||Gradient||" ] << gradientMagnitude;
+
+  /** Stop if one of the convergence criteria is met. */
+  if( this->TestConvergenceCriteria( this->GetValue(), gradientMagnitude ) )
+  {
+    this->StopOptimization();
+  }
 
   /** Select new spatial samples for the computation of the metric */
   if( this->GetNewSamplesEveryIteration() )
@@ -164,6 +171,8 @@ StandardGradientDescent< TElastix >
 
   }
 
+  stopcondition = this->GetStopConditionDescriptionWithConvergence( stopcondition );
+
   /** Print the stopping condition */
   elxout << "Stopping condition: " << stopcondition << "." << std::endl;
 
@@ -116,7 +116,8 @@ GradientDescentOptimizer2
 
   const unsigned int spaceDimension
                    = this->GetScaledCostFunction()->GetNumberOfParameters();
-  this->m_Gradient = DerivativeType( spaceDimension );   // check this
+  /** Only reallocate the gradient when the number of parameters changed. */
+  this->m_Gradient.SetSize( spaceDimension );
 
   while( !this->m_Stop )
   {
@@ -20,6 +20,7 @@
 #include "itkCommand.h"
 #include "itkEventObject.h"
 #include "itkMacro.h"
+#include "itkParallelVectorOperations.h"
 
 #ifdef ELASTIX_USE_OPENMP
 #include <omp.h>
@@ -130,7 +131,8 @@ StochasticGradientDescentOptimizer
 
   const unsigned int spaceDimension
     = this->GetScaledCostFunction()->GetNumberOfParameters();
-  this->m_Gradient = DerivativeType( spaceDimension ); // check this
+  /** Only reallocate the gradient when the number of parameters changed. */
+  this->m_Gradient.SetSize( spaceDimension );
 
   DerivativeType   currentPositionGradient;
   DerivativeType   previousPositionGradient;
@@ -234,11 +236,9 @@ StochasticGradientDescentOptimizer
     /** Get a reference to the current position. */
     const ParametersType & currentPosition = this->GetScaledCurrentPosition();
 
-    /** Update the new position. */
-    for( unsigned int j = 0; j < spaceDimension; j++ )
-    {
-      newPosition[ j ] = currentPosition[ j ] - this->m_LearningRate * this->m_Gradient[ j ];
-    }
+    /** Update the new position. Large vectors are updated multi-threadedly. */
+    ParallelVectorOperations::ScaledAdd( currentPosition.data_block(), -this->m_LearningRate,
+      this->m_Gradient.data_block(), newPosition.data_block(), spaceDimension );
   }
 #ifdef ELASTIX_USE_OPENMP
   else if( this->m_UseOpenMP && !this->m_UseEigen )
@@ -307,17 +307,16 @@ StochasticGradientDescentOptimizer
   else
   {
     /** Fill the threader parameter struct with information. */
-    MultiThreaderParameterType * temp = new  MultiThreaderParameterType;
-    temp->t_NewPosition = &newPosition;
-    temp->t_Optimizer = this;
-
-    /** Call multi-threaded AdvanceOneStep(). */
-    ThreaderType::Pointer local_threader = ThreaderType::New();
-    local_threader->SetNumberOfWorkUnits( this->m_Threader->GetNumberOfWorkUnits() );
-    local_threader->SetSingleMethod( AdvanceOneStepThreaderCallback, (void *)( temp ) );
-    local_threader->SingleMethodExecute();
-
-    delete temp;
+    MultiThreaderParameterType temp;
+    temp.t_NewPosition = &newPosition;
+    temp.t_Optimizer = this;
+
+    /** Call multi-threaded AdvanceOneStep() on the persistent thread pool,
+     * to avoid creating new threads at every iteration.
+     */
+    PersistentThreadPool::GetInstance()->SingleMethodExecute(
+      this->m_Threader->GetNumberOfWorkUnits(),
+      AdvanceOneStepThreaderCallback, static_cast< void * >( &temp ) );
   }
 
   this->InvokeEvent( IterationEvent() );
@@ -88,6 +88,20 @@ namespace elastix
  *    example: <tt>(Metric0Use "false" "true")</tt> \n
  *    example: <tt>(Metric1Use "true" "false")</tt> \n
  *    The default is "true".
+ * \parameter UseSharedTransformEvaluation: Whether metrics that use the same
+ *    image sampler and transform map the samples, and compute the sparse
+ *    transform Jacobians, only once per iteration, in each resolution. This
+ *    saves computation time when several metrics share the sampler of metric 0,
+ *    at the expense of memory for the mapped points and Jacobians. \n
+ *    example: <tt>(UseSharedTransformEvaluation "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseConcurrentMetricEvaluation: Whether the metrics that support
+ *    it, such as AdvancedMattesMutualInformation, AdvancedNormalizedCorrelation,
+ *    AdvancedMeanSquares and AdvancedKappaStatistic, are evaluated at the same
+ *    time, each by one thread, in each resolution. This is faster when there are
+ *    many metrics, for example one per channel, compared to the number of threads. \n
+ *    example: <tt>(UseConcurrentMetricEvaluation "true")</tt> \n
+ *    The default is "false".
  *
  * \ingroup Registrations
  */
@@ -197,6 +197,18 @@ MultiMetricMultiResolutionRegistration< TElastix >
   this->GetConfiguration()->ReadParameter( useRelativeWeights, "UseRelativeWeights", 0 );
   this->GetCombinationMetric()->SetUseRelativeWeights( useRelativeWeights );
 
+  /** Set the sharing of the transform evaluations between metrics. */
+  bool useSharedTransformEvaluation = false;
+  this->GetConfiguration()->ReadParameter( useSharedTransformEvaluation,
+    "UseSharedTransformEvaluation", "", level, 0 );
+  this->GetCombinationMetric()->SetUseSharedTransformEvaluation( useSharedTransformEvaluation );
+
+  /** Set the concurrent evaluation of the metrics. */
+  bool useConcurrentMetricEvaluation = false;
+  this->GetConfiguration()->ReadParameter( useConcurrentMetricEvaluation,
+    "UseConcurrentMetricEvaluation", "", level, 0 );
+  this->GetCombinationMetric()->SetUseConcurrentMetricEvaluation( useConcurrentMetricEvaluation );
+
   /** Set the metric weights. The default metric weight is 1.0 / nrOfMetrics. */
   if( !useRelativeWeights )
   {
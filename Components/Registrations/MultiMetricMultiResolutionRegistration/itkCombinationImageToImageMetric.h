@@ -112,6 +112,8 @@ public:
   typedef typename Superclass::DerivativeType             DerivativeType;
   typedef typename Superclass::DerivativeValueType        DerivativeValueType;
   typedef typename Superclass::ParametersType             ParametersType;
+  typedef typename Superclass::ParametersVectorType       ParametersVectorType;
+  typedef typename Superclass::MeasureVectorType          MeasureVectorType;
 
   /** Some typedefs for computing the SelfHessian */
   typedef typename Superclass::HessianValueType HessianValueType;
@@ -213,6 +215,28 @@ public:
   /** Get if this metric is used. */
   bool GetUseMetric( const unsigned int pos ) const;
 
+  /** Select whether image metrics that use the same image sampler and
+   * transform share the evaluation of the transform at the samples in
+   * GetValueAndDerivative(). The first metric of such a group then maps the
+   * samples, and computes their sparse Jacobians, once for all of them; see
+   * AdvancedImageToImageMetric::ComputeSharedTransformEvaluation(). Default: false.
+   */
+  itkSetMacro( UseSharedTransformEvaluation, bool );
+  itkGetConstMacro( UseSharedTransformEvaluation, bool );
+  itkBooleanMacro( UseSharedTransformEvaluation );
+
+  /** Select whether GetValueAndDerivative() evaluates the image metrics that
+   * support it concurrently, see
+   * AdvancedImageToImageMetric::SetSupportsConcurrentEvaluation(). Each of
+   * these metrics is then evaluated by one thread of the PersistentThreadPool,
+   * instead of all threads evaluating the metrics one after the other. This
+   * pays off for many metrics, such as in multi-channel registration, which
+   * otherwise wait for all threads at the end of every metric. Default: false.
+   */
+  itkSetMacro( UseConcurrentMetricEvaluation, bool );
+  itkGetConstMacro( UseConcurrentMetricEvaluation, bool );
+  itkBooleanMacro( UseConcurrentMetricEvaluation );
+
   /** Get the last computed value for metric i. */
   MeasureType GetMetricValue( unsigned int pos ) const;
 
@@ -379,6 +403,13 @@ public:
   /** The GetValue()-method. */
   MeasureType GetValue( const ParametersType & parameters ) const override;
 
+  /** The GetValues()-method. Each sub metric computes its values at all
+   * parameter vectors in one call, see the MultipleValuesCostFunctionInterface.
+   * The stored metric values are the ones at the last parameter vector.
+   */
+  void GetValues( const ParametersVectorType & parameters,
+    MeasureVectorType & values ) const override;
+
   /** The GetDerivative()-method. */
   void GetDerivative(
     const ParametersType & parameters,
@@ -412,6 +443,8 @@ protected:
   std::vector< double >                          m_MetricWeights;
   std::vector< double >                          m_MetricRelativeWeights;
   bool                                           m_UseRelativeWeights;
+  bool                                           m_UseSharedTransformEvaluation;
+  bool                                           m_UseConcurrentMetricEvaluation;
   std::vector< bool >                            m_UseMetric;
   mutable std::vector< MeasureType >             m_MetricValues;
   mutable std::vector< DerivativeType >          m_MetricDerivatives;
@@ -438,6 +471,29 @@ private:
    */
   double GetFinalMetricWeight( unsigned int pos ) const;
 
+  /** Let the groups of image metrics with the same image sampler and
+   * transform share a transform evaluation at the current samples.
+   */
+  void ShareTransformEvaluations( const bool computeJacobians ) const;
+
+  /** Remove the shared transform evaluations from the image metrics. */
+  void RemoveSharedTransformEvaluations( void ) const;
+
+  /** Compute the value and derivative of metric i, and its computation time. */
+  void ComputeMetricValueAndDerivative( const unsigned int i,
+    const ParametersType & parameters ) const;
+
+  /** The data passed to the threads that evaluate the metrics concurrently. */
+  struct ConcurrentMetricsThreaderParameterType
+  {
+    const Self *                        m_Metric;
+    const ParametersType *              m_Parameters;
+    const std::vector< unsigned int > * m_MetricIndices;
+  };
+
+  /** Compute the value and derivative of one metric per work unit. */
+  static ITK_THREAD_RETURN_TYPE ConcurrentMetricsThreaderCallback( void * arg );
+
 };
 
 } // end namespace itk
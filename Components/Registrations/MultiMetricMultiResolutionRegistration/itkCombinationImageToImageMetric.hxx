@@ -21,6 +21,10 @@
 #include "itkCombinationImageToImageMetric.h"
 #include "itkTimeProbe.h"
 #include "itkMath.h"
+#include "itkParallelVectorOperations.h"
+#include "itkPersistentThreadPool.h"
+
+#include <algorithm>
 
 /** Macros to reduce some copy-paste work.
  * These macros provide the implementation of
@@ -162,7 +166,9 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
 ::CombinationImageToImageMetric()
 {
   this->m_NumberOfMetrics    = 0;
-  this->m_UseRelativeWeights = false;
+  this->m_UseRelativeWeights            = false;
+  this->m_UseSharedTransformEvaluation  = false;
+  this->m_UseConcurrentMetricEvaluation = false;
   this->ComputeGradientOff();
 
 } // end Constructor
@@ -182,6 +188,10 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
 
   /** Add debugging information. */
   os << "NumberOfMetrics: " << this->m_NumberOfMetrics << std::endl;
+  os << "UseSharedTransformEvaluation: "
+     << ( this->m_UseSharedTransformEvaluation ? "true\n" : "false\n" );
+  os << "UseConcurrentMetricEvaluation: "
+     << ( this->m_UseConcurrentMetricEvaluation ? "true\n" : "false\n" );
   for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
   {
     os << "Metric " << i << ":\n";
@@ -757,6 +767,72 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
 } // end GetValue()
 
 
+/**
+ * ********************* GetValues ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::GetValues( const ParametersVectorType & parameters,
+  MeasureVectorType & values ) const
+{
+  /** Compute the values of all metrics at all parameter vectors. */
+  std::vector< MeasureVectorType > metricValues( this->m_NumberOfMetrics );
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    /** Time the computation per metric. */
+    itk::TimeProbe timer;
+    timer.Start();
+
+    const MultipleValuesCostFunctionInterface * metric
+      = dynamic_cast< const MultipleValuesCostFunctionInterface * >( this->m_Metrics[ i ].GetPointer() );
+    if( metric != nullptr )
+    {
+      metric->GetValues( parameters, metricValues[ i ] );
+    }
+    else
+    {
+      metricValues[ i ].resize( parameters.size() );
+      for( std::size_t k = 0; k < parameters.size(); ++k )
+      {
+        metricValues[ i ][ k ] = this->m_Metrics[ i ]->GetValue( parameters[ k ] );
+      }
+    }
+    timer.Stop();
+
+    /** The time per parameter vector. */
+    this->m_MetricComputationTime[ i ] = parameters.empty() ? 0.0
+      : timer.GetMean() * 1000.0 / static_cast< double >( parameters.size() );
+  }
+
+  /** Combine the metric values of each parameter vector, like GetValue(). */
+  values.assign( parameters.size(), NumericTraits< MeasureType >::Zero );
+  for( std::size_t k = 0; k < parameters.size(); ++k )
+  {
+    for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+    {
+      this->m_MetricValues[ i ] = metricValues[ i ][ k ];
+      if( this->m_UseMetric[ i ] )
+      {
+        if( !this->m_UseRelativeWeights )
+        {
+          values[ k ] += this->m_MetricWeights[ i ] * this->m_MetricValues[ i ];
+        }
+        else if( this->m_MetricValues[ i ] > 1e-10 )
+        {
+          const double weight = this->m_MetricRelativeWeights[ i ]
+            * this->m_MetricValues[ 0 ]
+            / this->m_MetricValues[ i ];
+          values[ k ] += weight * this->m_MetricValues[ i ];
+        }
+      }
+    }
+  }
+
+} // end GetValues()
+
+
 /**
  * ********************* GetDerivative ****************************
  */
@@ -831,9 +907,6 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   MeasureType & value,
   DerivativeType & derivative ) const
 {
-  /** Declare timer. */
-  itk::TimeProbe timer;
-
   /** This function must be called before the multi-threaded code.
    * It calls all the non thread-safe stuff.
    */
@@ -858,59 +931,234 @@ CombinationImageToImageMetric< TFixedImage, TMovingImage >
   /** Initialize some threading related parameters. */
   this->InitializeThreadingParameters();
 
-  /** Compute all metric values and derivatives. */
-  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  /** The samples and the transform parameters are fixed from here on. */
+  if( this->m_UseSharedTransformEvaluation )
   {
-    /** Compute ... */
-    timer.Reset();
-    timer.Start();
-    this->m_Metrics[ i ]->GetValueAndDerivative( parameters,
-      this->m_MetricValues[ i ], this->m_MetricDerivatives[ i ] );
-    timer.Stop();
+    this->ShareTransformEvaluations( true );
+  }
 
-    /** Store computation time. */
-    this->m_MetricComputationTime[ i ] = timer.GetMean() * 1000.0;
+  /** Compute all metric values and derivatives. The shared evaluations are
+   * removed afterwards, also if a metric throws an exception.
+   */
+  try
+  {
+    /** The metrics that support it are evaluated concurrently, one per thread. */
+    std::vector< unsigned int > concurrentMetrics;
+    std::vector< bool >         evaluateConcurrently( this->m_NumberOfMetrics, false );
+    if( this->m_UseConcurrentMetricEvaluation )
+    {
+      for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+      {
+        const ImageMetricType * metric = dynamic_cast< const ImageMetricType * >( this->GetMetric( i ) );
+        if( metric && metric->GetSupportsConcurrentEvaluation() )
+        {
+          concurrentMetrics.push_back( i );
+        }
+      }
+    }
+    if( concurrentMetrics.size() > 1 )
+    {
+      for( const unsigned int i : concurrentMetrics )
+      {
+        evaluateConcurrently[ i ] = true;
+      }
+
+      ConcurrentMetricsThreaderParameterType temp;
+      temp.m_Metric        = this;
+      temp.m_Parameters    = &parameters;
+      temp.m_MetricIndices = &concurrentMetrics;
+      PersistentThreadPool::GetInstance()->SingleMethodExecute(
+        static_cast< ThreadIdType >( concurrentMetrics.size() ),
+        Self::ConcurrentMetricsThreaderCallback, &temp );
+    }
+
+    /** The other metrics use all threads. */
+    for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+    {
+      if( !evaluateConcurrently[ i ] )
+      {
+        this->ComputeMetricValueAndDerivative( i, parameters );
+      }
+    }
+  }
+  catch( ... )
+  {
+    if( this->m_UseSharedTransformEvaluation )
+    {
+      this->RemoveSharedTransformEvaluations();
+    }
+    throw;
+  }
+
+  if( this->m_UseSharedTransformEvaluation )
+  {
+    this->RemoveSharedTransformEvaluations();
   }
 
   /** Compute the derivative magnitude. */
   for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
   {
-    this->m_MetricDerivativesMagnitude[ i ] = this->m_MetricDerivatives[ i ].magnitude();
+    this->m_MetricDerivativesMagnitude[ i ] = ParallelVectorOperations::Norm(
+      this->m_MetricDerivatives[ i ].data_block(), this->m_MetricDerivatives[ i ].GetSize() );
   }
 
   /** Combine the metric values. */
   value = NumericTraits< MeasureType >::Zero;
+  std::vector< double >         weights;
+  std::vector< const double * > metricDerivatives;
   for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
   {
     if( this->m_UseMetric[ i ] )
     {
       const double weight = this->GetFinalMetricWeight( i );
       value += weight * this->m_MetricValues[ i ];
+      weights.push_back( weight );
+      metricDerivatives.push_back( this->m_MetricDerivatives[ i ].data_block() );
     }
   }
 
-  /** Combine the metric derivatives. First, the first derivative. */
-  if( this->m_UseMetric[ 0 ] )
+  /** Combine the metric derivatives, in one parallel pass over all of them,
+   * in the order of the metrics.
+   */
+  const SizeValueType numberOfParameters = this->m_MetricDerivatives[ 0 ].GetSize();
+  if( derivative.GetSize() != numberOfParameters )
   {
-    const double weight = this->GetFinalMetricWeight( 0 );
-    derivative = weight * this->m_MetricDerivatives[ 0 ];
+    derivative.SetSize( numberOfParameters );
   }
-  else
+  double * derivativeData = derivative.data_block();
+  ParallelVectorOperations::ParallelizeRange( numberOfParameters,
+    [&weights, &metricDerivatives, derivativeData]( const SizeValueType begin, const SizeValueType end )
+    {
+      std::fill( derivativeData + begin, derivativeData + end, 0.0 );
+      for( std::size_t k = 0; k < weights.size(); ++k )
+      {
+        const double   weight           = weights[ k ];
+        const double * metricDerivative = metricDerivatives[ k ];
+        for( SizeValueType j = begin; j < end; ++j )
+        {
+          derivativeData[ j ] += weight * metricDerivative[ j ];
+        }
+      }
+    } );
+
+} // end GetValueAndDerivative()
+
+
+/**
+ * ********************* ComputeMetricValueAndDerivative ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::ComputeMetricValueAndDerivative( const unsigned int i,
+  const ParametersType & parameters ) const
+{
+  /** Compute ... */
+  itk::TimeProbe timer;
+  timer.Start();
+  this->m_Metrics[ i ]->GetValueAndDerivative( parameters,
+    this->m_MetricValues[ i ], this->m_MetricDerivatives[ i ] );
+  timer.Stop();
+
+  /** Store computation time. */
+  this->m_MetricComputationTime[ i ] = timer.GetMean() * 1000.0;
+
+} // end ComputeMetricValueAndDerivative()
+
+
+/**
+ * ********************* ConcurrentMetricsThreaderCallback ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+ITK_THREAD_RETURN_TYPE
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::ConcurrentMetricsThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const ConcurrentMetricsThreaderParameterType * temp
+    = static_cast< ConcurrentMetricsThreaderParameterType * >( infoStruct->UserData );
+
+  /** The threaded code of the metric runs serially within the work unit. */
+  temp->m_Metric->ComputeMetricValueAndDerivative(
+    ( *temp->m_MetricIndices )[ infoStruct->WorkUnitID ], *temp->m_Parameters );
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end ConcurrentMetricsThreaderCallback()
+
+
+/**
+ * ********************* ShareTransformEvaluations ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::ShareTransformEvaluations( const bool computeJacobians ) const
+{
+  /** Collect the image metrics that use an image sampler. */
+  std::vector< ImageMetricType * > metrics( this->m_NumberOfMetrics, nullptr );
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
   {
-    derivative.Fill( 0 );
+    ImageMetricType * metric = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+    if( metric && metric->GetUseImageSampler() && metric->GetImageSampler() )
+    {
+      metrics[ i ] = metric;
+    }
   }
 
-  /** Then the remaining derivatives. */
-  for( unsigned int i = 1; i < this->m_NumberOfMetrics; i++ )
+  /** The first metric of a group evaluates the transform for the others. */
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
   {
-    if( this->m_UseMetric[ i ] )
+    if( metrics[ i ] == nullptr )
     {
-      const double weight = this->GetFinalMetricWeight( i );
-      derivative += weight * this->m_MetricDerivatives[ i ];
+      continue;
+    }
+
+    typename ImageMetricType::SharedTransformEvaluationConstPointer evaluation;
+    for( unsigned int j = i + 1; j < this->m_NumberOfMetrics; j++ )
+    {
+      if( metrics[ j ] == nullptr
+        || metrics[ j ]->GetImageSampler() != metrics[ i ]->GetImageSampler()
+        || metrics[ j ]->GetTransform() != metrics[ i ]->GetTransform() )
+      {
+        continue;
+      }
+      if( !evaluation )
+      {
+        evaluation = metrics[ i ]->ComputeSharedTransformEvaluation( computeJacobians );
+        metrics[ i ]->SetSharedTransformEvaluation( evaluation );
+      }
+      metrics[ j ]->SetSharedTransformEvaluation( evaluation );
+      metrics[ j ] = nullptr;
     }
   }
 
-} // end GetValueAndDerivative()
+} // end ShareTransformEvaluations()
+
+
+/**
+ * ********************* RemoveSharedTransformEvaluations ****************************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+CombinationImageToImageMetric< TFixedImage, TMovingImage >
+::RemoveSharedTransformEvaluations( void ) const
+{
+  for( unsigned int i = 0; i < this->m_NumberOfMetrics; i++ )
+  {
+    ImageMetricType * metric = dynamic_cast< ImageMetricType * >( this->GetMetric( i ) );
+    if( metric )
+    {
+      metric->SetSharedTransformEvaluation( nullptr );
+    }
+  }
+
+} // end RemoveSharedTransformEvaluations()
 
 
 /**
@@ -38,6 +38,9 @@ namespace elastix
  *    example: <tt>(NumberOfResolutions 4)</tt> \n
  *    The default is 3.
  *
+ * The images can be cropped to the fixed mask with the parameters CropFixedImageToMask
+ * and CropMovingImage of the RegistrationBase.
+ *
  * \ingroup Registrations
  */
 
@@ -75,8 +75,15 @@ MultiResolutionRegistration< TElastix >
     throw excp;
   }
 
+  /** Crop the images to the fixed mask, if requested. */
+  FixedImageConstPointer  fixedImage  = this->GetElastix()->GetFixedImage();
+  MovingImageConstPointer movingImage = this->GetElastix()->GetMovingImage();
+  this->CropImagesToFixedMask( fixedImage, movingImage );
+  this->SetFixedImage( fixedImage );
+  this->SetMovingImage( movingImage );
+
   /** Set the fixedImageRegion. */
-  this->SetFixedImageRegion( this->GetElastix()->GetFixedImage()->GetBufferedRegion() );
+  this->SetFixedImageRegion( fixedImage->GetBufferedRegion() );
 
 } // end BeforeRegistration()
 
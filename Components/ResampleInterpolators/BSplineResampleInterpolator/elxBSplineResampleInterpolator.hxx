@@ -44,6 +44,12 @@ BSplineResampleInterpolator< TElastix >
   /** Set the splineOrder in the superclass. */
   this->SetSplineOrder( splineOrder );
 
+  /** Read whether the coefficients are shared with the registration interpolator. */
+  bool useCoefficientCache = false;
+  this->m_Configuration->ReadParameter( useCoefficientCache,
+    "UseBSplineCoefficientCache", 0 );
+  this->SetUseCoefficientCache( useCoefficientCache );
+
 } // end BeforeRegistration()
 
 
@@ -19,7 +19,7 @@
 #define __elxBSplineResampleInterpolatorFloat_h
 
 #include "elxIncludes.h" // include first to avoid MSVS warning
-#include "itkBSplineInterpolateImageFunction.h"
+#include "itkAdvancedBSplineInterpolateImageFunction.h"
 
 namespace elastix
 {
@@ -39,6 +39,11 @@ namespace elastix
 *    the deformed moving image; possible values: (0-5) \n
 *    example: <tt>(FinalBSplineInterpolationOrder 3 ) </tt> \n
 *    Default: 3.
+* \parameter UseBSplineCoefficientCache: whether the B-spline coefficients of the moving
+*    image are shared with the registration interpolator, so that the coefficients of
+*    the last resolution are not computed again. \n
+*    example: <tt>(UseBSplineCoefficientCache "true")</tt> \n
+*    Default: "false".
 *
 * The transform parameters necessary for transformix, additionally defined by this class, are:
 * \transformparameter FinalBSplineInterpolationOrder: the order of the B-spline used to resample
@@ -53,7 +58,7 @@ namespace elastix
 template< class TElastix >
 class BSplineResampleInterpolatorFloat :
   public
-  itk::BSplineInterpolateImageFunction<
+  itk::AdvancedBSplineInterpolateImageFunction<
   typename ResampleInterpolatorBase< TElastix >::InputImageType,
   typename ResampleInterpolatorBase< TElastix >::CoordRepType,
   float >,   //CoefficientType
@@ -63,7 +68,7 @@ public:
 
   /** Standard ITK-stuff. */
   typedef BSplineResampleInterpolatorFloat Self;
-  typedef itk::BSplineInterpolateImageFunction<
+  typedef itk::AdvancedBSplineInterpolateImageFunction<
     typename ResampleInterpolatorBase< TElastix >::InputImageType,
     typename ResampleInterpolatorBase< TElastix >::CoordRepType,
     float >                                     Superclass1;
@@ -75,7 +80,7 @@ public:
   itkNewMacro( Self );
 
   /** Run-time type information (and related methods). */
-  itkTypeMacro( BSplineResampleInterpolatorFloat, BSplineInterpolateImageFunction );
+  itkTypeMacro( BSplineResampleInterpolatorFloat, AdvancedBSplineInterpolateImageFunction );
 
   /** Name of this class.
   * Use this name in the parameter file to select this specific resample interpolator. \n
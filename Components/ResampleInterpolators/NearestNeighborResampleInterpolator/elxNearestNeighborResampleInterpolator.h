@@ -33,6 +33,9 @@ namespace elastix
 * this resample interpolator if memory burden is an issue and nearest neighbor interpolation
 * is sufficient.
 *
+* For label images, the LabelResampling parameter of the resampler is faster,
+* since it resamples directly into an unsigned char or unsigned short image.
+*
 * The parameters used in this class are:
 * \parameter ResampleInterpolator: Select this resample interpolator as follows:\n
 *   <tt>(ResampleInterpolator "FinalNearestNeighborInterpolator")</tt>
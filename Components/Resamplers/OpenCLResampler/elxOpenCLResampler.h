@@ -36,6 +36,36 @@ namespace elastix
  *    <tt>(Resampler "OpenCLResampler")</tt>
  * \parameter Resampler: Enable the OpenCL resampler as follows:\n
  *    <tt>(OpenCLResamplerUseOpenCL "true")</tt>
+ * \parameter OpenCLResamplerUseAsynchronousTransfer: Copy each split of the
+ *    output to the host while the next split is computed, see
+ *    itk::GPUResampleImageFilter::SetUseAsynchronousTransfer().\n
+ *    <tt>(OpenCLResamplerUseAsynchronousTransfer "true")</tt>\n
+ *    The default value is true.
+ * \parameter OpenCLResamplerNumberOfSlabs: The number of slabs along the
+ *    slowest dimension in which the output is resampled. For each slab only
+ *    the part of the input image that the slab maps to is copied to the
+ *    device. With 0 the number of slabs is chosen such that a slab fits in
+ *    the memory of the device, and 1 resamples the whole output at once.
+ *    A slab that does not fit is halved.\n
+ *    <tt>(OpenCLResamplerNumberOfSlabs 0)</tt>\n
+ *    The default value is 0.
+ * \parameter OpenCLResamplerEvaluateTransformOnHost: For a transform that
+ *    has no OpenCL implementation, such as the DeformationFieldTransform,
+ *    the SplineKernelTransform, the stack transforms or the
+ *    RecursiveBSplineTransform, map the output points on the host and
+ *    interpolate on the GPU, see
+ *    itk::GPUResampleImageFilter::SetHostTransform(). If false, the
+ *    resampler switches to the CPU for such a transform.\n
+ *    <tt>(OpenCLResamplerEvaluateTransformOnHost "true")</tt>\n
+ *    The default value is true.
+ * \parameter OpenCLResamplerSplitAcrossDevices: For a context with several
+ *    devices, see the -gpu command line option, place the slabs of the
+ *    output on the devices in turn, with at least one slab per device.
+ *    Otherwise the whole resampling is placed on the next device. The slabs
+ *    are resampled one after the other, so this spreads the memory of the
+ *    resampling over the devices.\n
+ *    <tt>(OpenCLResamplerSplitAcrossDevices "false")</tt>\n
+ *    The default value is false.
  *
  * \author Denis P. Shamonin and Marius Staring. Division of Image Processing,
  * Department of Radiology, Leiden, The Netherlands
@@ -85,10 +115,13 @@ public:
 
   typedef typename Superclass1::InputImageType InputImageType;
   typedef typename InputImageType::PixelType   InputImagePixelType;
+  typedef typename InputImageType::RegionType  InputImageRegionType;
 
   typedef typename Superclass1::OutputImageType OutputImageType;
   typedef typename OutputImageType::PixelType   OutputImagePixelType;
   typedef typename OutputImageType::RegionType  OutputImageRegionType;
+  typedef typename Superclass1::IndexType       IndexType;
+  typedef itk::SizeValueType                    SizeValueType;
 
   /** GPU Typedefs for GPU image and GPU resampler. */
   typedef itk::GPUImage< InputImagePixelType, InputImageType::ImageDimension >
@@ -126,12 +159,18 @@ protected:
   /** The destructor. */
   virtual ~OpenCLResampler() {}
 
-  /** This method performs all configuration for GPU resampler. */
-  void BeforeGenerateData( void );
+  /** This method performs all configuration for GPU resampler, to resample
+   * the \a outputRegion of the output from the \a input image. */
+  void BeforeGenerateData( const InputImageType * input,
+    const OutputImageRegionType & outputRegion );
 
   /** Executes GPU resampler. */
   virtual void GenerateData( void );
 
+  /** Executes GPU resampler for slabs of the output, each with only the
+   * part of the input image that it needs. */
+  void GenerateDataInSlabs( const unsigned int numberOfSlabs );
+
   /** Transform copier */
   typedef typename ResamplerBase< TElastix >::CoordRepType InterpolatorPrecisionType;
   typedef typename itk::AdvancedCombinationTransform< InterpolatorPrecisionType, OutputImageType::ImageDimension >
@@ -166,6 +205,21 @@ private:
   /** Helper method to report to elastix log. */
   void ReportToLog( void );
 
+  /** Make the queue of the next device of the OpenCL context the active
+   * command queue, if the context has several devices. */
+  void SelectNextDevice( void );
+
+  /** Get the number of slabs in which the output is resampled. */
+  unsigned int ComputeNumberOfSlabs( void ) const;
+
+  /** Check if an input and an output with the given numbers of pixels fit
+   * in the memory of the device. */
+  bool FitsOnDevice( const double inputPixels, const double outputPixels ) const;
+
+  /** Compute the region of the input image that a slab of the output maps
+   * to, from the points of a grid on the slab, padded with a margin. */
+  InputImageRegionType ComputeSlabInputRegion( const OutputImageRegionType & slab ) const;
+
   TransformCopierPointer   m_TransformCopier;
   InterpolateCopierPointer m_InterpolatorCopier;
   GPUResamplerPointer      m_GPUResampler;
@@ -173,6 +227,10 @@ private:
   bool                     m_GPUResamplerCreated;
   bool                     m_ContextCreated;
   bool                     m_UseOpenCL;
+  bool                     m_UseAsynchronousTransfer;
+  bool                     m_EvaluateTransformOnHost;
+  bool                     m_SplitAcrossDevices;
+  unsigned int             m_NumberOfSlabs;
 };
 
 // end class OpenCLResampler
@@ -20,6 +20,14 @@
 
 #include "elxOpenCLResampler.h"
 #include "itkOpenCLLogger.h"
+#include "itkImageAlgorithm.h"
+#include "itkImageRegionSplitterSlowDimension.h"
+#include "itkMath.h"
+#include "itkRegionOfInterestImageFilter.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
 
 namespace elastix
 {
@@ -71,8 +79,12 @@ elastix::OpenCLResampler< TElastix >
     this->SwitchingToCPUAndReport( false );
   }
 
-  this->m_UseOpenCL    = true;
-  this->m_ShowProgress = false;
+  this->m_UseOpenCL               = true;
+  this->m_UseAsynchronousTransfer = true;
+  this->m_EvaluateTransformOnHost = true;
+  this->m_SplitAcrossDevices      = false;
+  this->m_NumberOfSlabs           = 0;
+  this->m_ShowProgress            = false;
 
 } // end Constructor
 
@@ -126,7 +138,8 @@ OpenCLResampler< TElastix >
 template< class TElastix >
 void
 OpenCLResampler< TElastix >
-::BeforeGenerateData( void )
+::BeforeGenerateData( const InputImageType * input,
+  const OutputImageRegionType & outputRegion )
 {
   // Set it to true, if something goes wrong during configuration, it will be false
   this->m_GPUResamplerReady = true;
@@ -136,7 +149,9 @@ OpenCLResampler< TElastix >
   GPUExplicitInterpolatorPointer gpuInterpolator;
   GPUInputImagePointer           gpuInputImage;
 
-  // Perform transform copy
+  // Perform transform copy. A transform without a GPU copy is evaluated on
+  // the host, if allowed.
+  bool hostTransform = false;
   try
   {
     this->m_TransformCopier->Update();
@@ -144,8 +159,18 @@ OpenCLResampler< TElastix >
   }
   catch( itk::ExceptionObject & e )
   {
-    xl::xout[ "error" ] << "ERROR: Exception during making GPU copy of the transform: " << e << std::endl;
-    this->SwitchingToCPUAndReport( true );
+    if( this->m_EvaluateTransformOnHost )
+    {
+      xl::xout[ "warning" ] << "WARNING: The transform is not supported on the GPU.\n";
+      xl::xout[ "warning" ] << "  The OpenCLResampler evaluates it on the host"
+                            << " and interpolates on the GPU." << std::endl;
+      hostTransform = true;
+    }
+    else
+    {
+      xl::xout[ "error" ] << "ERROR: Exception during making GPU copy of the transform: " << e << std::endl;
+      this->SwitchingToCPUAndReport( true );
+    }
   }
 
   if( this->m_GPUResamplerReady )
@@ -169,7 +194,7 @@ OpenCLResampler< TElastix >
     try
     {
       gpuInputImage = GPUInputImageType::New();
-      gpuInputImage->GraftITKImage( this->GetInput() );
+      gpuInputImage->GraftITKImage( input );
       gpuInputImage->AllocateGPU();
       gpuInputImage->GetGPUDataManager()->SetCPUBufferLock( true );
       gpuInputImage->GetGPUDataManager()->SetGPUDirtyFlag( true );
@@ -184,13 +209,25 @@ OpenCLResampler< TElastix >
 
   if( this->m_GPUResamplerReady )
   {
-    // Set the m_GPUResampler properties the same way as Superclass1
-    this->m_GPUResampler->SetSize( this->GetSize() );
+    // Set the m_GPUResampler properties the same way as Superclass1.
+    // A part of the output is resampled with the same start index, and
+    // the origin is shifted to the start of the part.
+    const IndexType startIndex = this->GetOutputStartIndex();
+    IndexType       shift;
+    for( unsigned int i = 0; i < OutputImageType::ImageDimension; ++i )
+    {
+      shift[ i ] = outputRegion.GetIndex( i ) - startIndex[ i ];
+    }
+    typename OutputImageType::PointType origin;
+    this->GetOutput()->TransformIndexToPhysicalPoint( shift, origin );
+
+    this->m_GPUResampler->SetSize( outputRegion.GetSize() );
     this->m_GPUResampler->SetDefaultPixelValue( this->GetDefaultPixelValue() );
     this->m_GPUResampler->SetOutputSpacing( this->GetOutputSpacing() );
-    this->m_GPUResampler->SetOutputOrigin( this->GetOutputOrigin() );
+    this->m_GPUResampler->SetOutputOrigin( origin );
     this->m_GPUResampler->SetOutputDirection( this->GetOutputDirection() );
-    this->m_GPUResampler->SetOutputStartIndex( this->GetOutputStartIndex() );
+    this->m_GPUResampler->SetOutputStartIndex( startIndex );
+    this->m_GPUResampler->SetUseAsynchronousTransfer( this->m_UseAsynchronousTransfer );
   }
 
   if( this->m_GPUResamplerReady )
@@ -198,7 +235,15 @@ OpenCLResampler< TElastix >
     try
     {
       this->m_GPUResampler->SetInput( gpuInputImage );
-      this->m_GPUResampler->SetTransform( gpuTransform );
+      if( hostTransform )
+      {
+        this->m_GPUResampler->SetHostTransform( this->GetTransform() );
+      }
+      else
+      {
+        this->m_GPUResampler->SetHostTransform( nullptr );
+        this->m_GPUResampler->SetTransform( gpuTransform );
+      }
       this->m_GPUResampler->SetInterpolator( gpuInterpolator );
     }
     catch( itk::OpenCLCompileError & e )
@@ -239,8 +284,34 @@ OpenCLResampler< TElastix >
     return;
   }
 
+  // Place the resampling on the next device, unless its slabs are placed
+  // on the devices in turn
+  const itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+  const bool                        splitAcrossDevices
+    = this->m_SplitAcrossDevices && context->GetDevices().size() > 1;
+  if( !splitAcrossDevices )
+  {
+    this->SelectNextDevice();
+  }
+
+  // Resample the output in slabs if it does not fit on the device at once
+  unsigned int numberOfSlabs = this->ComputeNumberOfSlabs();
+  if( splitAcrossDevices )
+  {
+    numberOfSlabs = std::max( numberOfSlabs,
+      static_cast< unsigned int >( context->GetDevices().size() ) );
+  }
+  if( numberOfSlabs > 1 )
+  {
+    this->GenerateDataInSlabs( numberOfSlabs );
+    return;
+  }
+
   // First execute BeforeGenerateData to configure GPU resampler
-  this->BeforeGenerateData();
+  OutputImageRegionType outputRegion;
+  outputRegion.SetIndex( this->GetOutputStartIndex() );
+  outputRegion.SetSize( this->GetSize() );
+  this->BeforeGenerateData( this->GetInput(), outputRegion );
   if( !this->m_GPUResamplerReady )
   {
     Superclass1::GenerateData();
@@ -262,6 +333,251 @@ OpenCLResampler< TElastix >
 } // end GenerateData()
 
 
+/**
+ * ******************* GenerateDataInSlabs ***********************
+ */
+
+template< class TElastix >
+void
+OpenCLResampler< TElastix >
+::GenerateDataInSlabs( const unsigned int numberOfSlabs )
+{
+  // Allocate memory
+  this->AllocateOutputs();
+  OutputImageType *           output       = this->GetOutput();
+  const OutputImageRegionType outputRegion = output->GetLargestPossibleRegion();
+
+  // Split the output along the slowest dimension
+  typedef itk::ImageRegionSplitterSlowDimension RegionSplitterType;
+  RegionSplitterType::Pointer splitter = RegionSplitterType::New();
+  const unsigned int          numberOfSplits
+    = splitter->GetNumberOfSplits( outputRegion, numberOfSlabs );
+
+  std::deque< OutputImageRegionType > slabs;
+  for( unsigned int i = 0; i < numberOfSplits; ++i )
+  {
+    OutputImageRegionType slab = outputRegion;
+    splitter->GetSplit( i, numberOfSplits, slab );
+    slabs.push_back( slab );
+  }
+
+  elxout << "  Resampling the output in " << numberOfSplits
+         << " slabs on the OpenCL device." << std::endl;
+
+  const unsigned int slowestDimension = OutputImageType::ImageDimension - 1;
+  while( !slabs.empty() )
+  {
+    const OutputImageRegionType slab = slabs.front();
+    slabs.pop_front();
+
+    // Place the slab on the next device
+    if( this->m_SplitAcrossDevices )
+    {
+      this->SelectNextDevice();
+    }
+
+    // Halve a slab of which the input region does not fit on the device
+    const InputImageRegionType inputRegion = this->ComputeSlabInputRegion( slab );
+    if( slab.GetSize( slowestDimension ) > 1
+      && !this->FitsOnDevice( inputRegion.GetNumberOfPixels(), slab.GetNumberOfPixels() ) )
+    {
+      OutputImageRegionType first  = slab;
+      OutputImageRegionType second = slab;
+      first.SetSize( slowestDimension, slab.GetSize( slowestDimension ) / 2 );
+      second.SetIndex( slowestDimension, slab.GetIndex( slowestDimension ) + first.GetSize( slowestDimension ) );
+      second.SetSize( slowestDimension, slab.GetSize( slowestDimension ) - first.GetSize( slowestDimension ) );
+      slabs.push_front( second );
+      slabs.push_front( first );
+      continue;
+    }
+
+    // Crop the input image to the region that the slab needs
+    typedef itk::RegionOfInterestImageFilter< InputImageType, InputImageType > CropFilterType;
+    typename CropFilterType::Pointer cropFilter = CropFilterType::New();
+    cropFilter->SetInput( this->GetInput() );
+    cropFilter->SetRegionOfInterest( inputRegion );
+    cropFilter->Update();
+
+    // Configure the GPU resampler for the slab
+    this->BeforeGenerateData( cropFilter->GetOutput(), slab );
+    if( !this->m_GPUResamplerReady )
+    {
+      Superclass1::GenerateData();
+      return;
+    }
+
+    // Perform GPU resampler execution, and copy the slab to the output
+    this->m_GPUResampler->Update();
+    const GPUOutputImageType * gpuOutput = this->m_GPUResampler->GetOutput();
+    itk::ImageAlgorithm::Copy( gpuOutput, output,
+      gpuOutput->GetLargestPossibleRegion(), slab );
+  }
+
+  // Report OpenCL device to the log
+  this->ReportToLog();
+} // end GenerateDataInSlabs()
+
+
+/**
+ * ******************* ComputeNumberOfSlabs ***********************
+ */
+
+template< class TElastix >
+unsigned int
+OpenCLResampler< TElastix >
+::ComputeNumberOfSlabs( void ) const
+{
+  if( this->m_NumberOfSlabs > 0 )
+  {
+    return this->m_NumberOfSlabs;
+  }
+
+  const double       inputPixels  = this->GetInput()->GetLargestPossibleRegion().GetNumberOfPixels();
+  const double       outputPixels = this->GetOutput()->GetLargestPossibleRegion().GetNumberOfPixels();
+  const unsigned int maximumNumberOfSlabs
+    = this->GetSize()[ OutputImageType::ImageDimension - 1 ];
+
+  // Assume that the input region of a slab scales with the slab
+  unsigned int numberOfSlabs = 1;
+  while( numberOfSlabs < maximumNumberOfSlabs
+    && !this->FitsOnDevice( inputPixels / numberOfSlabs, outputPixels / numberOfSlabs ) )
+  {
+    numberOfSlabs *= 2;
+  }
+  return std::min( numberOfSlabs, maximumNumberOfSlabs );
+} // end ComputeNumberOfSlabs()
+
+
+/**
+ * ******************* FitsOnDevice ***********************
+ */
+
+template< class TElastix >
+bool
+OpenCLResampler< TElastix >
+::FitsOnDevice( const double inputPixels, const double outputPixels ) const
+{
+  const itk::OpenCLDevice device
+    = itk::OpenCLContext::GetInstance()->GetActiveDevice();
+  const double globalMemorySize  = static_cast< double >( device.GetGlobalMemorySize() );
+  const double maximumAllocation = static_cast< double >( device.GetMaximumAllocationSize() );
+
+  // The input image, the coefficients of a B-spline interpolator, the output
+  // image and the deformation field of a split of the GPU resampler.
+  const double inputBytes       = inputPixels * sizeof( InputImagePixelType );
+  const double coefficientBytes = inputPixels * sizeof( float );
+  const double outputBytes      = outputPixels * sizeof( OutputImagePixelType );
+  const double deformationBytes = outputPixels * OutputImageType::ImageDimension * sizeof( float )
+    / std::max( this->m_GPUResampler->GetRequestedNumberOfSplits(), 1u );
+
+  // Leave a quarter of the memory for the transform and the driver
+  return inputBytes <= maximumAllocation
+         && coefficientBytes <= maximumAllocation
+         && outputBytes <= maximumAllocation
+         && inputBytes + coefficientBytes + outputBytes + deformationBytes <= 0.75 * globalMemorySize;
+} // end FitsOnDevice()
+
+
+/**
+ * ******************* ComputeSlabInputRegion ***********************
+ */
+
+template< class TElastix >
+typename OpenCLResampler< TElastix >::InputImageRegionType
+OpenCLResampler< TElastix >
+::ComputeSlabInputRegion( const OutputImageRegionType & slab ) const
+{
+  const unsigned int Dimension = InputImageType::ImageDimension;
+  typedef typename TransformType::ScalarType            ScalarType;
+  typedef itk::ContinuousIndex< ScalarType, Dimension > ContinuousIndexType;
+  typedef typename InputImageRegionType::IndexValueType IndexValueType;
+
+  // The distance in voxels between the points that are mapped, and the
+  // margin of the bounding box of the mapped points, which covers the
+  // support of the interpolator and the deformation between the points.
+  const SizeValueType  sampleStep = 8;
+  const IndexValueType margin     = 16;
+
+  const InputImageType *  input     = this->GetInput();
+  const OutputImageType * output    = this->GetOutput();
+  const TransformType *   transform = this->GetTransform();
+
+  // Number of points along each dimension, including the last index
+  typename OutputImageRegionType::SizeType numberOfPoints;
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    numberOfPoints[ i ] = ( slab.GetSize( i ) + sampleStep - 2 ) / sampleStep + 1;
+  }
+
+  ContinuousIndexType minimum, maximum;
+  minimum.Fill( std::numeric_limits< ScalarType >::max() );
+  maximum.Fill( -std::numeric_limits< ScalarType >::max() );
+
+  IndexType point; point.Fill( 0 );
+  bool      done = false;
+  while( !done )
+  {
+    IndexType index;
+    for( unsigned int i = 0; i < Dimension; ++i )
+    {
+      index[ i ] = slab.GetIndex( i ) + std::min< SizeValueType >(
+        point[ i ] * sampleStep, slab.GetSize( i ) - 1 );
+    }
+
+    // Map the point to a continuous index of the input image
+    typename OutputImageType::PointType outputPoint;
+    output->TransformIndexToPhysicalPoint( index, outputPoint );
+    typename TransformType::InputPointType fixedPoint;
+    for( unsigned int i = 0; i < Dimension; ++i )
+    {
+      fixedPoint[ i ] = outputPoint[ i ];
+    }
+    const typename TransformType::OutputPointType movingPoint
+      = transform->TransformPoint( fixedPoint );
+    ContinuousIndexType cindex;
+    input->TransformPhysicalPointToContinuousIndex( movingPoint, cindex );
+
+    for( unsigned int i = 0; i < Dimension; ++i )
+    {
+      minimum[ i ] = std::min( minimum[ i ], cindex[ i ] );
+      maximum[ i ] = std::max( maximum[ i ], cindex[ i ] );
+    }
+
+    // Next point
+    unsigned int i = 0;
+    for(; i < Dimension; ++i )
+    {
+      if( static_cast< SizeValueType >( ++point[ i ] ) < numberOfPoints[ i ] )
+      {
+        break;
+      }
+      point[ i ] = 0;
+    }
+    done = ( i == Dimension );
+  }
+
+  // The padded bounding box, inside the input image
+  const InputImageRegionType largestRegion = input->GetLargestPossibleRegion();
+  InputImageRegionType       region;
+  for( unsigned int i = 0; i < Dimension; ++i )
+  {
+    const IndexValueType lower = itk::Math::Floor< IndexValueType >( minimum[ i ] ) - margin;
+    const IndexValueType upper = itk::Math::Ceil< IndexValueType >( maximum[ i ] ) + margin;
+    region.SetIndex( i, lower );
+    region.SetSize( i, static_cast< SizeValueType >( upper - lower + 1 ) );
+  }
+
+  // If the slab maps outside the input, the output is the default value,
+  // which a single voxel of the input gives as well.
+  if( !region.Crop( largestRegion ) )
+  {
+    region.SetIndex( largestRegion.GetIndex() );
+    region.SetSize( InputImageRegionType::SizeType::Filled( 1 ) );
+  }
+  return region;
+} // end ComputeSlabInputRegion()
+
+
 /**
  * ******************* BeforeRegistration ***********************
  */
@@ -275,6 +591,26 @@ OpenCLResampler< TElastix >
   this->m_UseOpenCL = true;
   this->m_Configuration->ReadParameter( this->m_UseOpenCL, "OpenCLResamplerUseOpenCL", 0, false );
 
+  // Resample in slabs?
+  this->m_NumberOfSlabs = 0;
+  this->m_Configuration->ReadParameter( this->m_NumberOfSlabs,
+    "OpenCLResamplerNumberOfSlabs", 0, false );
+
+  // Are the splits of the output copied back asynchronously?
+  this->m_UseAsynchronousTransfer = true;
+  this->m_Configuration->ReadParameter( this->m_UseAsynchronousTransfer,
+    "OpenCLResamplerUseAsynchronousTransfer", 0, false );
+
+  // Are transforms without a GPU implementation evaluated on the host?
+  this->m_EvaluateTransformOnHost = true;
+  this->m_Configuration->ReadParameter( this->m_EvaluateTransformOnHost,
+    "OpenCLResamplerEvaluateTransformOnHost", 0, false );
+
+  // Are the slabs placed on the devices in turn?
+  this->m_SplitAcrossDevices = false;
+  this->m_Configuration->ReadParameter( this->m_SplitAcrossDevices,
+    "OpenCLResamplerSplitAcrossDevices", 0, false );
+
 } // end BeforeRegistration()
 
 
@@ -294,6 +630,22 @@ OpenCLResampler< TElastix >
   this->m_UseOpenCL = true;
   this->m_Configuration->ReadParameter( this->m_UseOpenCL, "OpenCLResamplerUseOpenCL", 0 );
 
+  this->m_NumberOfSlabs = 0;
+  this->m_Configuration->ReadParameter( this->m_NumberOfSlabs,
+    "OpenCLResamplerNumberOfSlabs", 0, false );
+
+  this->m_UseAsynchronousTransfer = true;
+  this->m_Configuration->ReadParameter( this->m_UseAsynchronousTransfer,
+    "OpenCLResamplerUseAsynchronousTransfer", 0, false );
+
+  this->m_EvaluateTransformOnHost = true;
+  this->m_Configuration->ReadParameter( this->m_EvaluateTransformOnHost,
+    "OpenCLResamplerEvaluateTransformOnHost", 0, false );
+
+  this->m_SplitAcrossDevices = false;
+  this->m_Configuration->ReadParameter( this->m_SplitAcrossDevices,
+    "OpenCLResamplerSplitAcrossDevices", 0, false );
+
 } // end ReadFromFile()
 
 
@@ -317,6 +669,28 @@ OpenCLResampler< TElastix >
   if( this->m_UseOpenCL ) { useOpenCL = "true"; }
   xout[ "transpar" ] << "(OpenCLResamplerUseOpenCL \"" << useOpenCL << "\")" << std::endl;
 
+  // Write OpenCLResamplerUseAsynchronousTransfer.
+  std::string useAsynchronousTransfer = "false";
+  if( this->m_UseAsynchronousTransfer ) { useAsynchronousTransfer = "true"; }
+  xout[ "transpar" ] << "(OpenCLResamplerUseAsynchronousTransfer \""
+                     << useAsynchronousTransfer << "\")" << std::endl;
+
+  // Write OpenCLResamplerEvaluateTransformOnHost.
+  std::string evaluateTransformOnHost = "false";
+  if( this->m_EvaluateTransformOnHost ) { evaluateTransformOnHost = "true"; }
+  xout[ "transpar" ] << "(OpenCLResamplerEvaluateTransformOnHost \""
+                     << evaluateTransformOnHost << "\")" << std::endl;
+
+  // Write OpenCLResamplerSplitAcrossDevices.
+  std::string splitAcrossDevices = "false";
+  if( this->m_SplitAcrossDevices ) { splitAcrossDevices = "true"; }
+  xout[ "transpar" ] << "(OpenCLResamplerSplitAcrossDevices \""
+                     << splitAcrossDevices << "\")" << std::endl;
+
+  // Write OpenCLResamplerNumberOfSlabs.
+  xout[ "transpar" ] << "(OpenCLResamplerNumberOfSlabs "
+                     << this->m_NumberOfSlabs << ")" << std::endl;
+
 } // end WriteToFile()
 
 
@@ -354,12 +728,29 @@ OpenCLResampler< TElastix >
 ::ReportToLog( void )
 {
   itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
-  itk::OpenCLDevice           device  = context->GetDefaultDevice();
+  itk::OpenCLDevice           device  = context->GetActiveDevice();
   elxout << "  Applying final transform was performed by "
          <<  device.GetName() << " from " << device.GetVendor() << "." << std::endl;
 } // end ReportToLog()
 
 
+/**
+ * ************************* SelectNextDevice ************************************
+ */
+
+template< class TElastix >
+void
+OpenCLResampler< TElastix >
+::SelectNextDevice( void )
+{
+  itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+  if( context->GetDevices().size() > 1 )
+  {
+    context->SetCommandQueue( context->GetDefaultCommandQueue( context->GetNextDevice() ) );
+  }
+} // end SelectNextDevice()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxOpenCLResampler_hxx
@@ -0,0 +1,119 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxScanlineResampler_h
+#define __elxScanlineResampler_h
+
+#include "elxIncludes.h" // include first to avoid MSVS warning
+#include "itkScanlineResampleImageFilter.h"
+
+namespace elastix
+{
+
+/**
+ * \class ScanlineResampler
+ * \brief A resampler based on the itk::ScanlineResampleImageFilter.
+ *
+ * This resampler transforms the output image one scanline at a time, which
+ * is faster than the DefaultResampler for B-spline transforms without an
+ * initial transform. The result is the same as that of the DefaultResampler.
+ * For linear transforms, it only requests the part of the input image that
+ * maps into the region that is resampled, which, with (NumberOfStreamDivisions),
+ * bounds the input that each streamed slab needs.
+ *
+ * The parameters used in this class are:
+ * \parameter Resampler: Select this resampler as follows:\n
+ *    <tt>(Resampler "ScanlineResampler")</tt>
+ *
+ * \ingroup Resamplers
+ */
+
+template< class TElastix >
+class ScanlineResampler :
+  public itk::ScanlineResampleImageFilter<
+  typename ResamplerBase< TElastix >::InputImageType,
+  typename ResamplerBase< TElastix >::OutputImageType,
+  typename ResamplerBase< TElastix >::CoordRepType >,
+  public ResamplerBase< TElastix >
+{
+public:
+
+  /** Standard ITK-stuff. */
+  typedef ScanlineResampler Self;
+  typedef itk::ScanlineResampleImageFilter<
+    typename ResamplerBase< TElastix >::InputImageType,
+    typename ResamplerBase< TElastix >::OutputImageType,
+    typename ResamplerBase< TElastix >::CoordRepType > Superclass1;
+  typedef ResamplerBase< TElastix >       Superclass2;
+  typedef itk::SmartPointer< Self >       Pointer;
+  typedef itk::SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ScanlineResampler, ScanlineResampleImageFilter );
+
+  /** Name of this class.
+   * Use this name in the parameter file to select this specific resampler. \n
+   * example: <tt>(Resampler "ScanlineResampler")</tt>\n
+   */
+  elxClassNameMacro( "ScanlineResampler" );
+
+  /** Typedef's inherited from the superclass. */
+  typedef typename Superclass1::InputImageType        InputImageType;
+  typedef typename Superclass1::OutputImageType       OutputImageType;
+  typedef typename Superclass1::OutputImageRegionType OutputImageRegionType;
+  typedef typename Superclass1::InterpolatorType      InterpolatorType;
+  typedef typename Superclass1::PixelType             PixelType;
+  typedef typename Superclass1::IndexType             IndexType;
+  typedef typename Superclass1::PointType             PointType;
+
+  /** Typedef's from the ResamplerBase. */
+  typedef typename Superclass2::ElastixType          ElastixType;
+  typedef typename Superclass2::ElastixPointer       ElastixPointer;
+  typedef typename Superclass2::ConfigurationType    ConfigurationType;
+  typedef typename Superclass2::ConfigurationPointer ConfigurationPointer;
+  typedef typename Superclass2::RegistrationType     RegistrationType;
+  typedef typename Superclass2::RegistrationPointer  RegistrationPointer;
+  typedef typename Superclass2::ITKBaseType          ITKBaseType;
+
+  /* Nothing to add. In the baseclass already everything is done what should be done. */
+
+protected:
+
+  /** The constructor. */
+  ScanlineResampler() {}
+  /** The destructor. */
+  ~ScanlineResampler() override {}
+
+private:
+
+  /** The private constructor. */
+  ScanlineResampler( const Self & );  // purposely not implemented
+  /** The private copy constructor. */
+  void operator=( const Self & );     // purposely not implemented
+
+};
+
+} // end namespace elastix
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "elxScanlineResampler.hxx"
+#endif
+
+#endif // end #ifndef __elxScanlineResampler_h
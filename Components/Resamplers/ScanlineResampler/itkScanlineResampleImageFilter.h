@@ -0,0 +1,122 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkScanlineResampleImageFilter_h
+#define __itkScanlineResampleImageFilter_h
+
+#include "itkResampleImageFilter.h"
+#include "itkAdvancedTransform.h"
+
+namespace itk
+{
+
+/** \class ScanlineResampleImageFilter
+ *
+ * \brief A ResampleImageFilter that transforms the output image one scanline
+ * at a time.
+ *
+ * For nonlinear transforms the ResampleImageFilter transforms every output
+ * voxel separately. This filter passes each scanline of the output region to
+ * AdvancedTransform::TransformScanline() instead, so that a transform can
+ * share the work between the voxels of a scanline. The B-spline transform
+ * for example evaluates its weights along the other axes only once per
+ * scanline. The threads still process separate slabs of the output image.
+ *
+ * Transforms that are not an AdvancedTransform, and linear transforms, are
+ * resampled by the ResampleImageFilter itself.
+ *
+ * For a linear transform, a linear or nearest neighbor interpolator and no
+ * extrapolator, only the bounding box of the transformed output requested
+ * region is requested from the input. When the output is streamed in slabs
+ * and the input comes from a reader that supports streaming, each slab then
+ * only reads the part of the input that it needs.
+ *
+ * \ingroup GeometricTransforms
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType = double >
+class ScanlineResampleImageFilter :
+  public ResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef ScanlineResampleImageFilter Self;
+  typedef ResampleImageFilter<
+    TInputImage, TOutputImage, TInterpolatorPrecisionType > Superclass;
+  typedef SmartPointer< Self >       Pointer;
+  typedef SmartPointer< const Self > ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ScanlineResampleImageFilter, ResampleImageFilter );
+
+  /** Dimension of the images. */
+  itkStaticConstMacro( ImageDimension, unsigned int, TOutputImage::ImageDimension );
+
+  /** Typedefs inherited from the superclass. */
+  typedef typename Superclass::InputImageType        InputImageType;
+  typedef typename Superclass::OutputImageType       OutputImageType;
+  typedef typename Superclass::OutputImageRegionType OutputImageRegionType;
+  typedef typename Superclass::InterpolatorType      InterpolatorType;
+  typedef typename Superclass::ExtrapolatorType      ExtrapolatorType;
+  typedef typename Superclass::PixelType             PixelType;
+  typedef typename Superclass::ComponentType         ComponentType;
+  typedef typename Superclass::IndexType             IndexType;
+  typedef typename Superclass::PointType             PointType;
+  typedef typename Superclass::TransformType         TransformType;
+  typedef typename InputImageType::RegionType        InputImageRegionType;
+
+  /** The transform type that supports TransformScanline(). */
+  typedef AdvancedTransform< TInterpolatorPrecisionType,
+    itkGetStaticConstMacro( ImageDimension ),
+    itkGetStaticConstMacro( ImageDimension ) >      AdvancedTransformType;
+  typedef typename AdvancedTransformType::InputPointType  InputPointType;
+  typedef typename AdvancedTransformType::InputVectorType InputVectorType;
+  typedef typename AdvancedTransformType::OutputPointType OutputPointType;
+
+protected:
+
+  ScanlineResampleImageFilter() {}
+  ~ScanlineResampleImageFilter() override {}
+
+  /** Request only the part of the input that maps into the output requested
+   * region, if that part can be determined exactly. Otherwise the whole input
+   * is requested, as by the ResampleImageFilter.
+   */
+  void GenerateInputRequestedRegion( void ) override;
+
+  /** Resample the output region one scanline at a time. */
+  void NonlinearThreadedGenerateData(
+    const OutputImageRegionType & outputRegionForThread ) override;
+
+private:
+
+  ScanlineResampleImageFilter( const Self & ); // purposely not implemented
+  void operator=( const Self & );              // purposely not implemented
+
+};
+
+} // end namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkScanlineResampleImageFilter.hxx"
+#endif
+
+#endif // end #ifndef __itkScanlineResampleImageFilter_h
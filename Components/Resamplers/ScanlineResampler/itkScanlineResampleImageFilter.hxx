@@ -0,0 +1,212 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkScanlineResampleImageFilter_hxx
+#define __itkScanlineResampleImageFilter_hxx
+
+#include "itkScanlineResampleImageFilter.h"
+#include "itkImageScanlineIterator.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkNearestNeighborInterpolateImageFunction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace itk
+{
+
+/**
+ * ******************* GenerateInputRequestedRegion *******************
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType >
+void
+ScanlineResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::GenerateInputRequestedRegion( void )
+{
+  /** Request the largest possible region. */
+  Superclass::GenerateInputRequestedRegion();
+
+  InputImageType *        inputPtr  = const_cast< InputImageType * >( this->GetInput() );
+  const OutputImageType * outputPtr = this->GetOutput();
+  const TransformType *   transform = this->GetTransform();
+  if( inputPtr == nullptr || outputPtr == nullptr || transform == nullptr ) { return; }
+
+  /** The image of a box under a linear transform is the convex hull of the
+   * images of its corners. Interpolators with a larger support than one voxel,
+   * and extrapolators, depend on the whole buffered region.
+   */
+  typedef LinearInterpolateImageFunction<
+    InputImageType, TInterpolatorPrecisionType >          LinearInterpolatorType;
+  typedef NearestNeighborInterpolateImageFunction<
+    InputImageType, TInterpolatorPrecisionType >          NearestNeighborInterpolatorType;
+  const InterpolatorType * interpolator = this->GetInterpolator();
+  if( transform->GetTransformCategory() != TransformType::Linear
+    || this->GetExtrapolator() != nullptr
+    || ( dynamic_cast< const LinearInterpolatorType * >( interpolator ) == nullptr
+    && dynamic_cast< const NearestNeighborInterpolatorType * >( interpolator ) == nullptr ) )
+  {
+    return;
+  }
+
+  const OutputImageRegionType & outputRegion = outputPtr->GetRequestedRegion();
+  if( outputRegion.GetNumberOfPixels() == 0 ) { return; }
+
+  /** The bounding box of the transformed corners, in input voxels. */
+  double minIndex[ ImageDimension ];
+  double maxIndex[ ImageDimension ];
+  for( unsigned int j = 0; j < ImageDimension; j++ )
+  {
+    minIndex[ j ] = NumericTraits< double >::max();
+    maxIndex[ j ] = NumericTraits< double >::NonpositiveMin();
+  }
+  typename InterpolatorType::ContinuousIndexType inputIndex;
+  for( unsigned int c = 0; c < ( 1u << ImageDimension ); c++ )
+  {
+    IndexType corner = outputRegion.GetIndex();
+    for( unsigned int j = 0; j < ImageDimension; j++ )
+    {
+      if( c & ( 1u << j ) )
+      {
+        corner[ j ] += static_cast< IndexValueType >( outputRegion.GetSize( j ) ) - 1;
+      }
+    }
+    PointType point;
+    outputPtr->TransformIndexToPhysicalPoint( corner, point );
+    inputPtr->TransformPhysicalPointToContinuousIndex(
+      transform->TransformPoint( point ), inputIndex );
+    for( unsigned int j = 0; j < ImageDimension; j++ )
+    {
+      minIndex[ j ] = std::min( minIndex[ j ], static_cast< double >( inputIndex[ j ] ) );
+      maxIndex[ j ] = std::max( maxIndex[ j ], static_cast< double >( inputIndex[ j ] ) );
+    }
+  }
+
+  /** Add one voxel for the interpolator, and one for rounding, and crop the
+   * box to the input. If it does not overlap the input, all output voxels get
+   * the default value, and a single voxel of the input suffices.
+   */
+  const InputImageRegionType & largestRegion = inputPtr->GetLargestPossibleRegion();
+  InputImageRegionType         inputRegion   = largestRegion;
+  bool                         overlaps      = true;
+  for( unsigned int j = 0; j < ImageDimension; j++ )
+  {
+    const double lo    = static_cast< double >( largestRegion.GetIndex( j ) );
+    const double hi    = lo + static_cast< double >( largestRegion.GetSize( j ) ) - 1.0;
+    const double first = std::max( std::floor( minIndex[ j ] ) - 1.0, lo );
+    const double last  = std::min( std::ceil( maxIndex[ j ] ) + 1.0, hi );
+    if( !( first <= last ) )
+    {
+      overlaps = false;
+      break;
+    }
+    inputRegion.SetIndex( j, static_cast< IndexValueType >( first ) );
+    inputRegion.SetSize( j, static_cast< SizeValueType >( last - first + 1.0 ) );
+  }
+  if( !overlaps )
+  {
+    inputRegion = largestRegion;
+    inputRegion.SetSize( InputImageRegionType::SizeType::Filled( 1 ) );
+  }
+  inputPtr->SetRequestedRegion( inputRegion );
+
+} // end GenerateInputRequestedRegion()
+
+
+/**
+ * ******************* NonlinearThreadedGenerateData *******************
+ */
+
+template< class TInputImage, class TOutputImage, class TInterpolatorPrecisionType >
+void
+ScanlineResampleImageFilter< TInputImage, TOutputImage, TInterpolatorPrecisionType >
+::NonlinearThreadedGenerateData( const OutputImageRegionType & outputRegionForThread )
+{
+  const AdvancedTransformType * transform
+    = dynamic_cast< const AdvancedTransformType * >( this->GetTransform() );
+  if( transform == nullptr )
+  {
+    Superclass::NonlinearThreadedGenerateData( outputRegionForThread );
+    return;
+  }
+
+  OutputImageType *      outputPtr    = this->GetOutput();
+  const InputImageType * inputPtr     = this->GetInput();
+  InterpolatorType *     interpolator = this->GetInterpolator();
+  ExtrapolatorType *     extrapolator = this->GetExtrapolator();
+
+  const ComponentType minValue = NumericTraits< ComponentType >::NonpositiveMin();
+  const ComponentType maxValue = NumericTraits< ComponentType >::max();
+  const PixelType     defaultValue = this->GetDefaultPixelValue();
+
+  /** The physical step between two voxels of a scanline. */
+  IndexType index = outputRegionForThread.GetIndex();
+  PointType startPoint;
+  PointType nextPoint;
+  outputPtr->TransformIndexToPhysicalPoint( index, startPoint );
+  ++index[ 0 ];
+  outputPtr->TransformIndexToPhysicalPoint( index, nextPoint );
+  InputVectorType step;
+  for( unsigned int j = 0; j < ImageDimension; j++ )
+  {
+    step[ j ] = nextPoint[ j ] - startPoint[ j ];
+  }
+
+  const SizeValueType            lineLength = outputRegionForThread.GetSize( 0 );
+  std::vector< OutputPointType > transformedPoints( lineLength );
+  InputPointType                 lineStart;
+  typename InterpolatorType::ContinuousIndexType inputIndex;
+
+  ImageScanlineIterator< OutputImageType > it( outputPtr, outputRegionForThread );
+  while( !it.IsAtEnd() )
+  {
+    outputPtr->TransformIndexToPhysicalPoint( it.GetIndex(), startPoint );
+    for( unsigned int j = 0; j < ImageDimension; j++ )
+    {
+      lineStart[ j ] = startPoint[ j ];
+    }
+    transform->TransformScanline( lineStart, step, transformedPoints.data(), lineLength );
+
+    for( SizeValueType i = 0; i < lineLength; ++i )
+    {
+      inputPtr->TransformPhysicalPointToContinuousIndex( transformedPoints[ i ], inputIndex );
+      if( interpolator->IsInsideBuffer( inputIndex ) )
+      {
+        it.Set( this->CastPixelWithBoundsChecking(
+          interpolator->EvaluateAtContinuousIndex( inputIndex ), minValue, maxValue ) );
+      }
+      else if( extrapolator != nullptr )
+      {
+        it.Set( this->CastPixelWithBoundsChecking(
+          extrapolator->EvaluateAtContinuousIndex( inputIndex ), minValue, maxValue ) );
+      }
+      else
+      {
+        it.Set( defaultValue );
+      }
+      ++it;
+    }
+    it.NextLine();
+  }
+
+} // end NonlinearThreadedGenerateData()
+
+
+} // end namespace itk
+
+#endif // end #ifndef __itkScanlineResampleImageFilter_hxx
@@ -62,6 +62,20 @@ namespace elastix
  *    transform. Should be one of {GeometricalCenter, CenterOfGravity, Origins, GeometryTop}.\n
  *    example: <tt>(AutomaticTransformInitializationMethod "CenterOfGravity")</tt> \n
  *    By default "GeometricalCenter" is assumed.\n
+ * \parameter NumberOfSamplesForCenteredTransformInitialization: the number of
+ *    samples on a regular grid from which the CenterOfGravity is computed.
+ *    If 0, all voxels are used; they are summed over scanlines by all threads.\n
+ *    example: <tt>(NumberOfSamplesForCenteredTransformInitialization 0)</tt> \n
+ *    The default is 10000.\n
+ * \parameter CenterOfGravityUsesLowerThreshold: whether the CenterOfGravity is
+ *    computed from the voxels with a value of at least the
+ *    LowerThresholdForCenterGravity, each with weight 1.\n
+ *    example: <tt>(CenterOfGravityUsesLowerThreshold "true")</tt> \n
+ *    The default is "false", which weights the voxels by their value.\n
+ * \parameter LowerThresholdForCenterGravity: the lower threshold used if
+ *    CenterOfGravityUsesLowerThreshold is true.\n
+ *    example: <tt>(LowerThresholdForCenterGravity 100)</tt> \n
+ *    The default is 500.\n
  *
  * The transform parameters necessary for transformix, additionally defined by this class, are:
  * \transformparameter CenterOfRotation: stores the center of rotation as an index. \n
@@ -69,6 +69,37 @@ namespace elastix
  *   The default is zero for all resolutions. A value of 4 will avoid all deformations
  *   at the edge of the image. Make sure that 2*PassiveEdgeWidth < ControlPointGridSize
  *   in each dimension.
+ * \parameter UseBSplineWeightTables: whether the 1D B-spline weights of the voxels of the
+ *   fixed image are precomputed at the start of each resolution. The transform then looks
+ *   them up for points on the voxel lattice, such as the samples of the Full and Grid
+ *   samplers, instead of evaluating the B-spline kernel. Other points are not affected.
+ *   This requires that the grid direction equals the fixed image direction.
+ *   Can be specified for each resolution. \n
+ *   example: <tt>(UseBSplineWeightTables "true")</tt> \n
+ *   The default is "false".
+ * \parameter UseCompactBSplineCoefficients: whether the B-spline coefficients are also stored
+ *   interleaved in single precision, with the coefficients of a control point next to each
+ *   other. TransformPoint() then reads them with one cache line per control point, which
+ *   speeds up the transformation of points for fine grids. The parameters, the Jacobian and
+ *   the metric derivatives remain double precision. Can be specified for each resolution. \n
+ *   example: <tt>(UseCompactBSplineCoefficients "true")</tt> \n
+ *   The default is "false".
+ * \parameter UseDyadicGridRefinement: whether the B-spline coefficients of the next
+ *   resolution are computed by B-spline subdivision when the grid spacing halves, or stays
+ *   the same, and the new grid points lie on the refined grid. This is faster and represents
+ *   the deformation exactly, whereas the default method resamples it with mirrored
+ *   coefficients at the border, so the results differ near the border. Otherwise the default
+ *   method is used. Not used with UseCyclicTransform. Can be specified for each resolution. \n
+ *   example: <tt>(UseDyadicGridRefinement "true")</tt> \n
+ *   The default is "false".
+ * \parameter UseActiveSetOfControlPoints: whether only the control points whose support
+ *   overlaps the fixed mask are optimized. The optimizer then works with fewer parameters,
+ *   and the other coefficients keep their values, so the transform parameter file still
+ *   contains the full grid. Requires a fixed mask and one of the optimizers
+ *   StandardGradientDescent, QuasiNewtonLBFGS, ConjugateGradient or CMAEvolutionStrategy;
+ *   otherwise it is ignored with a warning. Can be specified for each resolution. \n
+ *   example: <tt>(UseActiveSetOfControlPoints "true")</tt> \n
+ *   The default is "false".
  * \parameter UseCyclicTransform: use the cyclic version of the B-spline transform which
  *   ensures that the B-spline polynomials wrap around in the slowest varying dimension.
  *   This is useful for dynamic imaging data in which the motion is assumed to be cyclic,
@@ -286,6 +317,11 @@ public:
   /** Set the scales of the edge B-spline coefficients to zero. */
   virtual void SetOptimizerScales( const unsigned int edgeWidth );
 
+  /** Restrict the optimizer to the B-spline coefficients of the control points
+   * that affect the fixed mask, or let it optimize all coefficients.
+   */
+  virtual void SetOptimizerActiveParameters( const bool useActiveSet );
+
 protected:
 
   /** The constructor. */
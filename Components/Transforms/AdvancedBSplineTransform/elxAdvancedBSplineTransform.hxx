@@ -21,6 +21,8 @@
 #include "elxAdvancedBSplineTransform.h"
 
 #include "itkImageRegionExclusionConstIteratorWithIndex.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkScaledSingleValuedNonLinearOptimizer.h"
 #include "vnl/vnl_math.h"
 
 
@@ -211,6 +213,41 @@ AdvancedBSplineTransform< TElastix >
     "PassiveEdgeWidth", this->GetComponentLabel(), level, 0, false );
   this->SetOptimizerScales( passiveEdgeWidth );
 
+  /** Optimize only the control points that affect the fixed mask, or all. */
+  bool useActiveSet = false;
+  this->GetConfiguration()->ReadParameter( useActiveSet,
+    "UseActiveSetOfControlPoints", this->GetComponentLabel(), level, 0, false );
+  this->SetOptimizerActiveParameters( useActiveSet );
+
+  /** Store a compact copy of the B-spline coefficients, or not. */
+  bool useCompactCoefficients = false;
+  this->GetConfiguration()->ReadParameter( useCompactCoefficients,
+    "UseCompactBSplineCoefficients", this->GetComponentLabel(), level, 0, false );
+  this->m_BSplineTransform->SetUseCompactCoefficients( useCompactCoefficients );
+
+  /** Precompute the B-spline weights of the fixed image voxels, or not. */
+  bool useWeightTables = false;
+  this->GetConfiguration()->ReadParameter( useWeightTables,
+    "UseBSplineWeightTables", this->GetComponentLabel(), level, 0, false );
+  if( useWeightTables )
+  {
+    const FixedImageType * fixedImage = this->GetElastix()
+      ->GetElxFixedImagePyramidBase()->GetAsITKBaseType()->GetOutput( level );
+    this->m_BSplineTransform->PrecomputeWeightTables( fixedImage->GetOrigin(),
+      fixedImage->GetSpacing(), fixedImage->GetDirection(), fixedImage->GetBufferedRegion() );
+    if( !this->m_BSplineTransform->GetHasWeightTables() )
+    {
+      xl::xout[ "warning" ]
+        << "WARNING: UseBSplineWeightTables is ignored, because the B-spline grid\n"
+        << "is not aligned with the axes of the fixed image."
+        << std::endl;
+    }
+  }
+  else
+  {
+    this->m_BSplineTransform->RemoveWeightTables();
+  }
+
 } // end BeforeEachResolution()
 
 
@@ -446,6 +483,14 @@ AdvancedBSplineTransform< TElastix >
   ParametersType latestParameters
     = this->m_Registration->GetAsITKBaseType()->GetLastTransformParameters();
 
+  /** Compute the upsampled parameters by B-spline subdivision, if the
+   * spacing halves. This is not supported for the cyclic transform.
+   */
+  bool useDyadicGridRefinement = false;
+  this->GetConfiguration()->ReadParameter( useDyadicGridRefinement,
+    "UseDyadicGridRefinement", this->GetComponentLabel(), level, 0 );
+  this->m_GridUpsampler->SetUseDyadicRefinement( useDyadicGridRefinement && !this->m_Cyclic );
+
   /** Setup the GridUpsampler. */
   this->m_GridUpsampler->SetCurrentGridOrigin( currentGridOrigin );
   this->m_GridUpsampler->SetCurrentGridSpacing( currentGridSpacing );
@@ -833,6 +878,103 @@ AdvancedBSplineTransform< TElastix >
 } // end SetOptimizerScales()
 
 
+/**
+ * ******************* SetOptimizerActiveParameters ***********************
+ */
+
+template< class TElastix >
+void
+AdvancedBSplineTransform< TElastix >
+::SetOptimizerActiveParameters( const bool useActiveSet )
+{
+  /** Some typedefs. */
+  typedef typename ElastixType::FixedMaskType                          FixedMaskType;
+  typedef itk::ImageRegionConstIteratorWithIndex< FixedMaskType >      MaskIteratorType;
+  typedef itk::ScaledSingleValuedNonLinearOptimizer                    ScaledOptimizerType;
+  typedef ScaledOptimizerType::ActiveParameterIndicesType              ActiveParameterIndicesType;
+  typedef typename Superclass1::NonZeroJacobianIndicesType             NonZeroJacobianIndicesType;
+
+  ScaledOptimizerType * optimizer = dynamic_cast< ScaledOptimizerType * >(
+    this->m_Registration->GetAsITKBaseType()->GetModifiableOptimizer() );
+  const FixedMaskType * fixedMask = this->GetElastix()->GetFixedMask();
+
+  /** Without an active set all parameters are optimized. */
+  ActiveParameterIndicesType activeIndices;
+  if( !useActiveSet || fixedMask == nullptr
+    || optimizer == nullptr || !optimizer->GetSupportsActiveParameters() )
+  {
+    if( useActiveSet )
+    {
+      xl::xout[ "warning" ]
+        << "WARNING: UseActiveSetOfControlPoints is ignored, because it requires
+"
+        << "a fixed mask and an optimizer that supports active parameters."
+        << std::endl;
+    }
+    if( optimizer != nullptr )
+    {
+      optimizer->SetActiveParameterIndices( activeIndices );
+    }
+    return;
+  }
+
+  /** Mark the parameters of the control points that have a nonzero Jacobian
+   * at a voxel inside the fixed mask. The mask given by the user is a
+   * superset of the eroded masks used by the metric. Neighbouring voxels
+   * mostly share the support region, which is then skipped.
+   */
+  const NumberOfParametersType numberOfParameters = this->GetNumberOfParameters();
+  std::vector< bool >          isActive( numberOfParameters, false );
+  JacobianType                 jacobian;
+  NonZeroJacobianIndicesType   nzji;
+  NumberOfParametersType       previousFirstIndex = numberOfParameters;
+
+  MaskIteratorType mIt( fixedMask, fixedMask->GetBufferedRegion() );
+  for( mIt.GoToBegin(); !mIt.IsAtEnd(); ++mIt )
+  {
+    if( mIt.Get() == 0 )
+    {
+      continue;
+    }
+
+    InputPointType point;
+    fixedMask->TransformIndexToPhysicalPoint( mIt.GetIndex(), point );
+    jacobian.Fill( 0.0 );
+    this->GetJacobian( point, jacobian, nzji );
+
+    /** A zero Jacobian means the point is outside the valid grid region. */
+    if( jacobian.frobenius_norm() == 0.0 || nzji.empty()
+      || nzji[ 0 ] == previousFirstIndex )
+    {
+      continue;
+    }
+    previousFirstIndex = nzji[ 0 ];
+    for( const NumberOfParametersType index : nzji )
+    {
+      isActive[ index ] = true;
+    }
+  }
+
+  for( NumberOfParametersType i = 0; i < numberOfParameters; ++i )
+  {
+    if( isActive[ i ] )
+    {
+      activeIndices.push_back( i );
+    }
+  }
+
+  /** If the mask does not overlap the valid grid region, the empty set
+   * optimizes all parameters.
+   */
+  optimizer->SetActiveParameterIndices( activeIndices );
+
+  elxout << "  Optimizing " << activeIndices.size() << " of "
+         << numberOfParameters << " B-spline parameters, "
+         << "whose control points affect the fixed mask." << std::endl;
+
+} // end SetOptimizerActiveParameters()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxAdvancedBSplineTransform_hxx
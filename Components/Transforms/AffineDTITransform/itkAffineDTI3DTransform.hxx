@@ -284,6 +284,26 @@ AffineDTI3DTransform< TScalarType >
 }
 
 
+// Compute the inner product of the Jacobian with the moving image gradient
+template< class TScalarType >
+void
+AffineDTI3DTransform< TScalarType >
+::EvaluateJacobianWithImageGradientProduct( const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  /** Compute the products with dR/dmu * (p-c) */
+  this->EvaluateJacobianOfSpatialJacobianWithImageGradientProduct(
+    p, movingImageGradient, 0, 9, imageJacobian );
+
+  // the products for the translation part
+  this->EvaluateTranslationWithImageGradientProduct( movingImageGradient, 9, imageJacobian );
+
+  nzji = this->m_NonZeroJacobianIndices;
+}
+
+
 // Precompute Jacobian of Spatial Jacobian
 template< class TScalarType >
 void
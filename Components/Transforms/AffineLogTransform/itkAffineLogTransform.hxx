@@ -18,9 +18,9 @@
 #ifndef __itkAffineLogTransform_hxx
 #define __itkAffineLogTransform_hxx
 
-#include "vnl/vnl_matrix_exp.h"
 #include "itkMath.h"
 #include "itkAffineLogTransform.h"
+#include "itkDenseLinearAlgebra.h"
 
 namespace itk
 {
@@ -87,7 +87,9 @@ AffineLogTransform< TScalarType, Dimension >
     }
   }
 
-  exponentMatrix = vnl_matrix_exp( this->m_MatrixLogDomain.GetVnlMatrix() );
+  vnl_matrix< ScalarType > exponential;
+  DenseLinearAlgebra::MatrixExponential( this->m_MatrixLogDomain.GetVnlMatrix().as_matrix(), exponential );
+  exponentMatrix = exponential;
 
   this->PrecomputeJacobianOfSpatialJacobian();
 
@@ -185,6 +187,28 @@ AffineLogTransform< TScalarType, Dimension >::GetJacobian( const InputPointType
 }
 
 
+// Compute the inner product of the Jacobian with the moving image gradient
+template< class TScalarType, unsigned int Dimension >
+void
+AffineLogTransform< TScalarType, Dimension >::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  const unsigned int d = Dimension;
+
+  this->EvaluateJacobianOfSpatialJacobianWithImageGradientProduct(
+    p, movingImageGradient, 0, d * d, imageJacobian );
+
+  // the products for the translation part
+  this->EvaluateTranslationWithImageGradientProduct( movingImageGradient, d * d, imageJacobian );
+
+  nzji = this->m_NonZeroJacobianIndices;
+
+}
+
+
 // Precompute Jacobian of Spatial Jacobian
 template< class TScalarType, unsigned int Dimension >
 void
@@ -241,7 +265,7 @@ AffineLogTransform< TScalarType, Dimension >
           A_bar( k, l ) = dA( k, ( l - d ) );
         }
       }
-      B_bar = vnl_matrix_exp( A_bar );
+      DenseLinearAlgebra::MatrixExponential( A_bar, B_bar );
       for( unsigned int k = 0; k < d; k++ )
       {
         for( unsigned int l = d; l < 2 * d; l++ )
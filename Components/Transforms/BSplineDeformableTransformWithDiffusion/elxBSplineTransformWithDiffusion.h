@@ -50,7 +50,8 @@ namespace elastix
  * diffusion/filtering of the deformation field.
  *
  * Every n iterations the deformation field is diffused using the
- * VectorMeanDiffusionImageFilter. The total transformation of a point
+ * VectorMeanDiffusionImageFilter. The deformation field is computed, and
+ * diffused, by multiple threads, in buffers that are allocated once. The total transformation of a point
  * is determined by adding the B-spline deformation to the
  * deformation field arrow. Filtering of the deformation field is based
  * on some 'stiffness coefficient' image.
@@ -411,6 +412,18 @@ private:
    */
   BSplineTransformPointer m_BSplineTransform;
 
+  /** The data passed to the threads by DiffuseDeformationField(). */
+  struct DeformationFieldThreaderParameterType
+  {
+    const Self *      m_Transform;
+    VectorImageType * m_DeformationField;
+    unsigned long     m_NumberOfSlices;
+    unsigned long     m_SlicesPerWorkUnit;
+  };
+
+  /** Compute the deformation field in the slabs of a work unit. */
+  static itk::ITK_THREAD_RETURN_TYPE DeformationFieldThreaderCallback( void * arg );
+
 };
 
 } // end namespace elastix
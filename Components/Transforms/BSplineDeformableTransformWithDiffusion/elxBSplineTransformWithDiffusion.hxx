@@ -24,6 +24,8 @@
 #include "itkBSplineResampleImageFunction.h"
 #include "itkBSplineDecompositionImageFilter.h"
 
+#include "itkImageRegionIteratorWithIndex.h"
+#include <algorithm>
 #include <cmath>
 
 namespace elastix
@@ -1138,43 +1140,21 @@ BSplineTransformWithDiffusion< TElastix >
 
   /** ------------- 1: Create deformationField. ------------- */
 
-  /** First, create a dummyImage with the right region info, so
-   * that the TransformIndexToPhysicalPoint-functions will be right.
+  /** Calculate the TransformPoint of all voxels of the image, in slabs
+   * along the last dimension, which are divided over the threads.
    */
-  typename DummyImageType::Pointer dummyImage = DummyImageType::New();
-  dummyImage->SetRegions( this->m_DeformationRegion );
-  dummyImage->SetOrigin( this->m_DeformationOrigin );
-  dummyImage->SetSpacing( this->m_DeformationSpacing );
-
-  /** Setup an iterator over dummyImage and outputImage. */
-  DummyIteratorType       iter( dummyImage, this->m_DeformationRegion );
-  VectorImageIteratorType iterout( this->m_DeformationField, this->m_DeformationRegion );
-
-  /** Declare stuff. */
-  InputPointType  inputPoint;
-  OutputPointType outputPoint;
-  VectorType      diff_point;
-  IndexType       inputIndex;
-
-  /** Calculate the TransformPoint of all voxels of the image. */
-  iter.GoToBegin();
-  iterout.GoToBegin();
-  while( !iter.IsAtEnd() )
-  {
-    inputIndex = iter.GetIndex();
-    /** Transform the points to physical space. */
-    dummyImage->TransformIndexToPhysicalPoint( inputIndex, inputPoint );
-    /** Call TransformPoint. */
-    outputPoint = this->TransformPoint( inputPoint );
-    /** Calculate the difference. */
-    for( unsigned int i = 0; i < this->FixedImageDimension; i++ )
-    {
-      diff_point[ i ] = outputPoint[ i ] - inputPoint[ i ];
-    }
-    iterout.Set( diff_point );
-    ++iter;
-    ++iterout;
-  }
+  itk::PersistentThreadPool::Pointer pool              = itk::PersistentThreadPool::GetInstance();
+  const unsigned long                numberOfSlices    = this->m_DeformationRegion.GetSize( SpaceDimension - 1 );
+  const unsigned long                numberOfWorkUnits = std::max< unsigned long >( 1,
+    std::min< unsigned long >( pool->GetMaximumNumberOfThreads(), numberOfSlices ) );
+
+  DeformationFieldThreaderParameterType temp;
+  temp.m_Transform         = this;
+  temp.m_DeformationField  = this->m_DeformationField;
+  temp.m_NumberOfSlices    = numberOfSlices;
+  temp.m_SlicesPerWorkUnit = ( numberOfSlices + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+  pool->SingleMethodExecute( static_cast< itk::ThreadIdType >( numberOfWorkUnits ),
+    Self::DeformationFieldThreaderCallback, &temp );
 
   /** ------------- 2: Update the intermediary deformationFieldTransform. ------------- */
 
@@ -1444,6 +1424,63 @@ BSplineTransformWithDiffusion< TElastix >
 } // end DiffuseDeformationField()
 
 
+/**
+ * *************** DeformationFieldThreaderCallback *************
+ */
+
+template< class TElastix >
+itk::ITK_THREAD_RETURN_TYPE
+BSplineTransformWithDiffusion< TElastix >
+::DeformationFieldThreaderCallback( void * arg )
+{
+  const itk::PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< itk::PersistentThreadPool::WorkUnitInfo * >( arg );
+  const DeformationFieldThreaderParameterType * temp
+    = static_cast< DeformationFieldThreaderParameterType * >( infoStruct->UserData );
+
+  const unsigned long begin = std::min( infoStruct->WorkUnitID * temp->m_SlicesPerWorkUnit,
+    temp->m_NumberOfSlices );
+  const unsigned long end = std::min( begin + temp->m_SlicesPerWorkUnit, temp->m_NumberOfSlices );
+  if( begin == end )
+  {
+    return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+  }
+
+  /** The slab of this work unit. */
+  const Self * transform = temp->m_Transform;
+  RegionType   region    = transform->m_DeformationRegion;
+  region.SetIndex( SpaceDimension - 1,
+    region.GetIndex( SpaceDimension - 1 ) + static_cast< itk::IndexValueType >( begin ) );
+  region.SetSize( SpaceDimension - 1, end - begin );
+
+  /** Declare stuff. */
+  InputPointType  inputPoint;
+  OutputPointType outputPoint;
+  VectorType      diff_point;
+
+  /** The deformation field has the region info of the deformation, so
+   * that the TransformIndexToPhysicalPoint-functions will be right.
+   */
+  typedef itk::ImageRegionIteratorWithIndex< VectorImageType > IteratorType;
+  for( IteratorType iterout( temp->m_DeformationField, region ); !iterout.IsAtEnd(); ++iterout )
+  {
+    /** Transform the points to physical space. */
+    temp->m_DeformationField->TransformIndexToPhysicalPoint( iterout.GetIndex(), inputPoint );
+    /** Call TransformPoint. */
+    outputPoint = transform->TransformPoint( inputPoint );
+    /** Calculate the difference. */
+    for( unsigned int i = 0; i < SpaceDimension; i++ )
+    {
+      diff_point[ i ] = outputPoint[ i ] - inputPoint[ i ];
+    }
+    iterout.Set( diff_point );
+  }
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end DeformationFieldThreaderCallback()
+
+
 /**
  * ******************* TransformPoint ******************
  */
@@ -25,6 +25,7 @@
 #include "itkNumericTraits.h"
 
 #include "itkRescaleIntensityImageFilter.h"
+#include "itkPersistentThreadPool.h"
 
 namespace itk
 {
@@ -37,6 +38,12 @@ namespace itk
  *
  * A mean filter is one of the family of linear filters.
  *
+ * Only the voxels where the stiffness coefficient c(x) is nonzero change, so
+ * the iterations are restricted to their bounding box. Each iteration is
+ * divided over the threads of the PersistentThreadPool, and the iterations
+ * alternate between the output and a temporary image, which is kept between
+ * updates of the filter.
+ *
  * \sa Image
  * \sa Neighborhood
  * \sa NeighborhoodOperator
@@ -80,6 +87,7 @@ public:
   typedef typename InputImageType::RegionType InputImageRegionType;
   typedef typename InputImageType::SizeType   InputSizeType;
   typedef typename InputImageType::IndexType  IndexType;
+  typedef typename IndexType::IndexValueType  IndexValueType;
   typedef Vector< double,
     itkGetStaticConstMacro( InputImageDimension ) > VectorRealType;
   typedef Image< double,
@@ -127,16 +135,11 @@ protected:
 
   void PrintSelf( std::ostream & os, Indent indent ) const override;
 
-  /** MeanImageFilter can be implemented as a multithreaded filter.
-   * Therefore, this implementation provides a ThreadedGenerateData()
-   * routine which is called for each processing thread. The output
-   * image data is allocated automatically by the superclass prior to
-   * calling ThreadedGenerateData().  ThreadedGenerateData can only
-   * write to the portion of the output image specified by the
-   * parameter "outputRegionForThread"
+  /** Performs the iterations of the diffusion. Each iteration is divided
+   * over the threads by DiffusionThreaderCallback(), which can only write to
+   * its slab of the bounding box of the nonzero c(x).
    *
-   * \sa ImageToImageFilter::ThreadedGenerateData(),
-   *     ImageToImageFilter::GenerateData().
+   * \sa ImageToImageFilter::GenerateData().
    */
   void GenerateData( void ) override;
 
@@ -150,14 +153,34 @@ private:
   unsigned int  m_NumberOfIterations;
 
   /** Declare member images. */
-  GrayValueImagePointer m_GrayValueImage;
-  DoubleImagePointer    m_Cx;
+  GrayValueImagePointer            m_GrayValueImage;
+  DoubleImagePointer               m_Cx;
+  typename InputImageType::Pointer m_TemporaryImage;
 
   RescaleImageFilterPointer m_RescaleFilter;
 
   /** For calculating a feature image from the input m_GrayValueImage. */
   void FilterGrayValueImage( void );
 
+  /** Compute the bounding box of the voxels with a nonzero c(x). Returns
+   * false if there are none.
+   */
+  bool ComputeDiffusionBoundingBox( InputImageRegionType & boundingBox ) const;
+
+  /** The data passed to the threads by GenerateData(). */
+  struct DiffusionThreaderParameterType
+  {
+    const Self *           m_Filter;
+    const InputImageType * m_Source;
+    InputImageType *       m_Destination;
+    InputImageRegionType   m_Region;
+    SizeValueType          m_NumberOfSlices;
+    SizeValueType          m_SlicesPerWorkUnit;
+  };
+
+  /** Do one iteration of the diffusion on the slabs of a work unit. */
+  static ITK_THREAD_RETURN_TYPE DiffusionThreaderCallback( void * arg );
+
 };
 
 } // end namespace itk
@@ -21,11 +21,12 @@
 
 #include "itkVectorMeanDiffusionImageFilter.h"
 
-#include "itkNeighborhoodIterator.h"
+#include "itkConstNeighborhoodIterator.h"
 #include "itkImageRegionIterator.h"
 #include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
 #include "itkZeroFluxNeumannBoundaryCondition.h"
-#include "itkProgressReporter.h"
+#include <algorithm>
 
 namespace itk
 {
@@ -44,6 +45,7 @@ VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
   this->m_RescaleFilter  = 0;
   this->m_GrayValueImage = 0;
   this->m_Cx             = 0;
+  this->m_TemporaryImage = 0;
 
 } // end Constructor
 
@@ -115,31 +117,14 @@ void
 VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
 ::GenerateData( void )
 {
-  // \todo to avoid all the copying we can create a vector of
-  // outputs of size this->GetNumberOfIterations(). The last
-  // output should point to this->GetOutput(). In order to avoid
-  // a big memory footprint, at some iteration k, memory of the
-  // former iteration should be released: output[ k - 1 ] = 0,
-  // and memory of the current iteration should only now be created:
-  // output[ k ] = InputImageType::New(); ...; output[ k ]->Allocate().
-  // Only for the last iteration: output[ k ]( this->GetOutput() ).
-
   /** Create feature image. */
   this->FilterGrayValueImage();
 
-  /** Declare things. */
-  unsigned int                                        i, j;
-  ZeroFluxNeumannBoundaryCondition< InputImageType >  nbc;
-  ZeroFluxNeumannBoundaryCondition< DoubleImageType > nbc2;
-  NeighborhoodIterator< InputImageType >              nit;
-  NeighborhoodIterator< DoubleImageType >             nit2;
-  VectorRealType                                      sum;
-
   /** Allocate output. */
   typename InputImageType::ConstPointer input( this->GetInput() );
   typename InputImageType::Pointer      output( this->GetOutput() );
-  typename InputImageType::Pointer outputtmp = InputImageType::New();
-  output->SetRegions( input->GetLargestPossibleRegion() );
+  const InputImageRegionType            region = input->GetLargestPossibleRegion();
+  output->SetRegions( region );
 
   try
   {
@@ -155,35 +140,9 @@ VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
     throw excp;
   }
 
-  /** Allocate a temporary output image. */
-  outputtmp->SetSpacing( input->GetSpacing() );
-  outputtmp->SetOrigin( input->GetOrigin() );
-  outputtmp->SetRegions( input->GetLargestPossibleRegion() );
-
-  try
-  {
-    outputtmp->Allocate();
-  }
-  catch( itk::ExceptionObject & excp )
-  {
-    /** Add information to the exception and throw again. */
-    excp.SetLocation( "VectorMeanDiffusionImageFilter - GenerateData()" );
-    std::string err_str = excp.GetDescription();
-    err_str += "\nError occurred while allocating a temporary copy.\n";
-    excp.SetDescription( err_str );
-    throw excp;
-  }
-
-  // support progress methods/callbacks
-  //ProgressReporter progress( this, threadId, outputRegionForThread.GetNumberOfPixels() );
-
   /** Copy input to output. */
-  ImageRegionConstIterator< InputImageType > in_it(
-  input, input->GetLargestPossibleRegion() );
-  ImageRegionIterator< InputImageType > out_it(
-  output, input->GetLargestPossibleRegion() );
-  in_it.GoToBegin();
-  out_it.GoToBegin();
+  ImageRegionConstIterator< InputImageType > in_it( input, region );
+  ImageRegionIterator< InputImageType >      out_it( output, region );
   while( !in_it.IsAtEnd() )
   {
     out_it.Set( in_it.Get() );
@@ -191,115 +150,222 @@ VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
     ++out_it;
   }
 
-  /** Setup neighborhood iterator for the output deformation image. */
-  nit = NeighborhoodIterator< InputImageType >(
-    this->m_Radius, output, output->GetLargestPossibleRegion() );
-  unsigned int neighborhoodSize = nit.Size();
-  nit.OverrideBoundaryCondition( &nbc );
+  /** Only the voxels with c(x) > 0 change, so the iterations are restricted
+   * to their bounding box. The voxels outside it keep the input value.
+   */
+  InputImageRegionType boundingBox;
+  if( this->GetNumberOfIterations() == 0
+    || !this->ComputeDiffusionBoundingBox( boundingBox ) )
+  {
+    return;
+  }
 
-  /** Setup neighborhood iterator for the "stiffness coefficient" image. */
-  nit2 = NeighborhoodIterator< DoubleImageType >(
-    this->m_Radius, this->m_Cx, this->m_Cx->GetLargestPossibleRegion() );
-  nit2.OverrideBoundaryCondition( &nbc2 );
+  /** Allocate the temporary image, which is kept for the next call, and
+   * also copy the input to it. The iterations alternate between the output
+   * and the temporary image, ending in the output.
+   */
+  if( this->m_TemporaryImage.IsNull()
+    || this->m_TemporaryImage->GetBufferedRegion() != region )
+  {
+    this->m_TemporaryImage = InputImageType::New();
+    this->m_TemporaryImage->SetRegions( region );
+    try
+    {
+      this->m_TemporaryImage->Allocate();
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      /** Add information to the exception and throw again. */
+      excp.SetLocation( "VectorMeanDiffusionImageFilter - GenerateData()" );
+      std::string err_str = excp.GetDescription();
+      err_str += "\nError occurred while allocating a temporary copy.\n";
+      excp.SetDescription( err_str );
+      throw excp;
+    }
+  }
+  this->m_TemporaryImage->CopyInformation( input );
+  std::copy( output->GetBufferPointer(),
+    output->GetBufferPointer() + region.GetNumberOfPixels(),
+    this->m_TemporaryImage->GetBufferPointer() );
 
-  /** Setup iterator over outputtmp. */
-  ImageRegionIterator< InputImageType > oit(
-  outputtmp, input->GetLargestPossibleRegion() );
+  InputImageType * buffers[ 2 ] = { output.GetPointer(), this->m_TemporaryImage.GetPointer() };
+  unsigned int     source       = ( this->GetNumberOfIterations() % 2 == 0 ) ? 0 : 1;
+
+  /** The iterations are divided over the threads by slabs along the last
+   * dimension of the bounding box.
+   */
+  PersistentThreadPool::Pointer pool              = PersistentThreadPool::GetInstance();
+  const SizeValueType           numberOfSlices    = boundingBox.GetSize( InputImageDimension - 1 );
+  const SizeValueType           numberOfWorkUnits = std::max< SizeValueType >( 1,
+    std::min< SizeValueType >( pool->GetMaximumNumberOfThreads(), numberOfSlices ) );
 
-  /** Initialize c and ci. */
-  double c  = 0.0;
-  double ci = 0.0;
+  DiffusionThreaderParameterType temp;
+  temp.m_Filter            = this;
+  temp.m_Region            = boundingBox;
+  temp.m_NumberOfSlices    = numberOfSlices;
+  temp.m_SlicesPerWorkUnit = ( numberOfSlices + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
 
   /** Loop over the number of iterations. */
-  for( unsigned int k = 0; k < this->GetNumberOfIterations(); k++ )
+  for( unsigned int k = 0; k < this->GetNumberOfIterations(); ++k )
   {
-    /** Reset the iterators. */
-    nit.GoToBegin();
-    nit2.GoToBegin();
-    oit.GoToBegin();
+    temp.m_Source      = buffers[ source ];
+    temp.m_Destination = buffers[ 1 - source ];
+    pool->SingleMethodExecute( static_cast< ThreadIdType >( numberOfWorkUnits ),
+      DiffusionThreaderCallback, &temp );
+    source = 1 - source;
+  }
+
+} // end GenerateData()
+
+
+/**
+ * ***************** ComputeDiffusionBoundingBox ****************
+ */
+
+template< class TInputImage, class TGrayValueImage >
+bool
+VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
+::ComputeDiffusionBoundingBox( InputImageRegionType & boundingBox ) const
+{
+  const InputImageRegionType region = this->m_Cx->GetLargestPossibleRegion();
+  IndexType                  lower  = region.GetUpperIndex();
+  IndexType                  upper  = region.GetIndex();
+  bool                       found  = false;
 
-    /** The actual work. */
-    while( !nit.IsAtEnd() )
+  for( ImageRegionConstIteratorWithIndex< DoubleImageType > it( this->m_Cx, region );
+    !it.IsAtEnd(); ++it )
+  {
+    if( it.Get() < 0.000001 )
     {
-      /** Speed up: do not filter locations where c(x) = 0. */
-      if( nit2.GetCenterPixel() < 0.000001 )
-      {
-        /** Just copy input to output. */
-        oit.Set( nit.GetCenterPixel() );
-      }
-      else
-      {
-        /** Initialize the sum to 0. */
-        for( j = 0; j < InputImageDimension; j++ )
-        {
-          sum[ j ] = NumericTraits< double >::Zero;
-        }
+      continue;
+    }
+    const IndexType & index = it.GetIndex();
+    for( unsigned int i = 0; i < InputImageDimension; ++i )
+    {
+      lower[ i ] = std::min( lower[ i ], index[ i ] );
+      upper[ i ] = std::max( upper[ i ], index[ i ] );
+    }
+    found = true;
+  }
 
-        /** Initialize sumc. */
-        double sumc = 0.0;
+  if( found )
+  {
+    boundingBox.SetIndex( lower );
+    boundingBox.SetUpperIndex( upper );
+  }
+  return found;
 
-        /** Calculate the weighted mean over the neighborhood.
-         * mean = SUthis->m_i{ ci * x_i } / SUthis->m_i{ ci }
-         */
-        for( i = 0; i < neighborhoodSize; ++i )
-        {
-          /** Get current pixel in this neighborhood. */
-          InputPixelType pix = nit.GetPixel( i );
-
-          /** Get ci-value on current index. */
-          ci = nit2.GetPixel( i );
-
-          /** Calculate SUthis->m_i{ ci } and SUthis->m_i{ ci * x_i }. */
-          sumc += ci;
-          for( j = 0; j < InputImageDimension; j++ )
-          {
-            sum[ j ] += ci * static_cast< double >( pix[ j ] );
-          }
-        }
+} // end ComputeDiffusionBoundingBox()
 
-        /** Get the mean value by dividing by sumc. */
-        InputPixelType mean;
-        for( j = 0; j < InputImageDimension; j++ )
-        {
-          if( sumc < 0.00001 ) { mean[ j ] = 0.0; }
-          else { mean[ j ] = static_cast< ValueType >( sum[ j ] / sumc ); }
-        }
 
-        /** Get c. */
-        c = nit2.GetCenterPixel();
+/**
+ * ****************** DiffusionThreaderCallback *****************
+ */
 
-        /** Set 'y = (1 - c) * x + c * mean' to the temporary output. */
-        InputPixelType value = nit.GetCenterPixel() * ( 1.0 - c ) + mean * c;
+template< class TInputImage, class TGrayValueImage >
+ITK_THREAD_RETURN_TYPE
+VectorMeanDiffusionImageFilter< TInputImage, TGrayValueImage >
+::DiffusionThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const DiffusionThreaderParameterType * temp
+    = static_cast< DiffusionThreaderParameterType * >( infoStruct->UserData );
+
+  const SizeValueType begin = std::min( infoStruct->WorkUnitID * temp->m_SlicesPerWorkUnit,
+    temp->m_NumberOfSlices );
+  const SizeValueType end = std::min( begin + temp->m_SlicesPerWorkUnit, temp->m_NumberOfSlices );
+  if( begin == end )
+  {
+    return ITK_THREAD_RETURN_DEFAULT_VALUE;
+  }
 
-        /** Set it. */
-        oit.Set( value );
+  /** The slab of this work unit. */
+  InputImageRegionType region = temp->m_Region;
+  region.SetIndex( InputImageDimension - 1,
+    region.GetIndex( InputImageDimension - 1 ) + static_cast< IndexValueType >( begin ) );
+  region.SetSize( InputImageDimension - 1, end - begin );
 
-      } // end if c < 0.000001
+  /** Declare things. */
+  const Self *                                        filter = temp->m_Filter;
+  ZeroFluxNeumannBoundaryCondition< InputImageType >  nbc;
+  ZeroFluxNeumannBoundaryCondition< DoubleImageType > nbc2;
+  VectorRealType                                      sum;
+
+  /** Setup neighborhood iterator for the deformation image. */
+  ConstNeighborhoodIterator< InputImageType > nit(
+    filter->m_Radius, temp->m_Source, region );
+  const unsigned int neighborhoodSize = nit.Size();
+  nit.OverrideBoundaryCondition( &nbc );
 
-      /** Increase all iterators. */
-      ++nit;
-      ++nit2;
-      ++oit;
-      //progress.CompletedPixel();
+  /** Setup neighborhood iterator for the "stiffness coefficient" image. */
+  ConstNeighborhoodIterator< DoubleImageType > nit2(
+    filter->m_Radius, filter->m_Cx, region );
+  nit2.OverrideBoundaryCondition( &nbc2 );
 
-    } // end while
+  /** Setup iterator over the destination. */
+  ImageRegionIterator< InputImageType > oit( temp->m_Destination, region );
 
-    /** Copy outputtmp to output. */
-    if( this->GetNumberOfIterations() > 0 )
+  /** The actual work. */
+  while( !nit.IsAtEnd() )
+  {
+    /** Speed up: do not filter locations where c(x) = 0. */
+    const double c = nit2.GetCenterPixel();
+    if( c < 0.000001 )
+    {
+      /** Just copy input to output. */
+      oit.Set( nit.GetCenterPixel() );
+    }
+    else
     {
-      out_it.GoToBegin();
-      oit.GoToBegin();
-      while( !out_it.IsAtEnd() )
+      /** Initialize the sum to 0. */
+      sum.Fill( NumericTraits< double >::Zero );
+
+      /** Initialize sumc. */
+      double sumc = 0.0;
+
+      /** Calculate the weighted mean over the neighborhood.
+       * mean = SUM_i{ ci * x_i } / SUM_i{ ci }
+       */
+      for( unsigned int i = 0; i < neighborhoodSize; ++i )
+      {
+        /** Get current pixel in this neighborhood. */
+        const InputPixelType pix = nit.GetPixel( i );
+
+        /** Get ci-value on current index. */
+        const double ci = nit2.GetPixel( i );
+
+        /** Calculate SUM_i{ ci } and SUM_i{ ci * x_i }. */
+        sumc += ci;
+        for( unsigned int j = 0; j < InputImageDimension; ++j )
+        {
+          sum[ j ] += ci * static_cast< double >( pix[ j ] );
+        }
+      }
+
+      /** Get the mean value by dividing by sumc. */
+      InputPixelType mean;
+      for( unsigned int j = 0; j < InputImageDimension; ++j )
       {
-        out_it.Set( oit.Get() );
-        ++out_it;
-        ++oit;
+        if( sumc < 0.00001 ) { mean[ j ] = 0.0; }
+        else { mean[ j ] = static_cast< ValueType >( sum[ j ] / sumc ); }
       }
-    } // end if GetNumberOfIterations() > 0
 
-  } // end for NumberOfIterations
+      /** Set 'y = (1 - c) * x + c * mean' to the destination. */
+      oit.Set( nit.GetCenterPixel() * ( 1.0 - c ) + mean * c );
 
-} // end GenerateData()
+    } // end if c < 0.000001
+
+    /** Increase all iterators. */
+    ++nit;
+    ++nit2;
+    ++oit;
+
+  } // end while
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end DiffusionThreaderCallback()
 
 
 /**
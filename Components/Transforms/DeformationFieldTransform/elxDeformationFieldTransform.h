@@ -43,6 +43,10 @@ namespace elastix
  * \transformparameter DeformationFieldInterpolationOrder: The interpolation order used for interpolating the deformation field:\n
  *    example: <tt>(DeformationFieldInterpolationOrder 0)</tt>\n
  *    The default value is 0. Choose from the allowed values 0 or 1.
+ *    With order 1 the deformation field is interpolated directly from its
+ *    buffer, see the DeformationFieldInterpolatingTransform.
+ *
+ * The deformation field is stored with float components.
  *
  *
  * \sa DeformationFieldInterpolatingTransform
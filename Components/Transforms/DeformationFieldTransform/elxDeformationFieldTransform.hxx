@@ -198,11 +198,11 @@ DeformationFieldTransform< TElastix >
     GetDeformationFieldInterpolator()->GetNameOfClass();
 
   unsigned int interpolationOrder = 0;
-  if( interpolatorName == "NearestNeighborInterpolateImageFunction" )
+  if( interpolatorName == "VectorNearestNeighborInterpolateImageFunction" )
   {
     interpolationOrder = 0;
   }
-  else if( interpolatorName == "LinearInterpolateImageFunction" )
+  else if( interpolatorName == "VectorLinearInterpolateImageFunction" )
   {
     interpolationOrder = 1;
   }
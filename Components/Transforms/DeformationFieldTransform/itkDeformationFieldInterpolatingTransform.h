@@ -24,6 +24,7 @@
 #include "itkImage.h"
 #include "itkVectorInterpolateImageFunction.h"
 #include "itkVectorNearestNeighborInterpolateImageFunction.h"
+#include "itkVectorLinearInterpolateImageFunction.h"
 
 namespace itk
 {
@@ -36,6 +37,14 @@ namespace itk
 * is not implemented. DO NOT USE IT FOR REGISTRATION.
 * You may set your own interpolator!
 *
+* When the interpolator is a VectorLinearInterpolateImageFunction,
+* TransformPoint() does not call it, but interpolates the buffer of the
+* deformation field directly, with the map from a physical point to a
+* continuous index computed once in SetDeformationField(). The result equals
+* that of the interpolator up to rounding. Set the deformation field again when its geometry
+* or buffer has changed. Use TComponentType = float to halve the memory of the
+* deformation field.
+*
 * \ingroup Transforms
 */
 
@@ -98,6 +107,8 @@ public:
   typedef typename DeformationFieldInterpolatorType::Pointer DeformationFieldInterpolatorPointer;
   typedef VectorNearestNeighborInterpolateImageFunction<
     DeformationFieldType, ScalarType >                DefaultDeformationFieldInterpolatorType;
+  typedef VectorLinearInterpolateImageFunction<
+    DeformationFieldType, ScalarType >                LinearDeformationFieldInterpolatorType;
 
   /** Set the transformation parameters is not supported.
    * Use SetDeformationField() instead
@@ -171,6 +182,11 @@ public:
 
   itkGetModifiableObjectMacro( DeformationFieldInterpolator, DeformationFieldInterpolatorType );
 
+  /** Whether TransformPoint() interpolates the deformation field linearly by
+   * itself, instead of calling the interpolator.
+   */
+  itkGetConstMacro( UseFastLinearInterpolation, bool );
+
   bool IsLinear( void ) const override { return false; }
 
   /** Must be provided. */
@@ -252,6 +268,31 @@ private:
   DeformationFieldInterpolatingTransform( const Self & ); // purposely not implemented
   void operator=( const Self & );                         // purposely not implemented
 
+  /** Check whether the interpolator is linear, and if so, store the map from
+   * a physical point to a continuous index and the layout of the buffer.
+   */
+  void UpdateFastLinearInterpolation( void );
+
+  /** Interpolate the deformation field linearly at a point, in the same way
+   * as the VectorLinearInterpolateImageFunction. Returns false if the point
+   * is outside the buffer.
+   */
+  bool EvaluateLinearAtPoint( const InputPointType & point,
+    OutputVectorType & displacement ) const;
+
+  typedef typename DeformationFieldType::IndexValueType  IndexValueType;
+  typedef typename DeformationFieldType::OffsetValueType OffsetValueType;
+
+  bool                               m_UseFastLinearInterpolation;
+  const DeformationFieldVectorType * m_BufferPointer;
+  ScalarType                         m_PointToIndexMatrix[ NDimensions ][ NDimensions ];
+  ScalarType                         m_Origin[ NDimensions ];
+  ScalarType                         m_StartContinuousIndex[ NDimensions ];
+  ScalarType                         m_EndContinuousIndex[ NDimensions ];
+  IndexValueType                     m_StartIndex[ NDimensions ];
+  IndexValueType                     m_EndIndex[ NDimensions ];
+  OffsetValueType                    m_OffsetTable[ NDimensions ];
+
 };
 
 }  // namespace itk
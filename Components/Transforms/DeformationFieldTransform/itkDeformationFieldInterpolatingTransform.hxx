@@ -19,6 +19,8 @@
 #define _itkDeformationFieldInterpolatingTransform_hxx
 
 #include "itkDeformationFieldInterpolatingTransform.h"
+#include <algorithm>
+#include <cmath>
 
 namespace itk
 {
@@ -28,8 +30,10 @@ template< class TScalarType, unsigned int NDimensions, class TComponentType >
 DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >::DeformationFieldInterpolatingTransform() :
   Superclass( OutputSpaceDimension )
 {
-  this->m_DeformationField     = 0;
-  this->m_ZeroDeformationField = DeformationFieldType::New();
+  this->m_DeformationField           = 0;
+  this->m_UseFastLinearInterpolation = false;
+  this->m_BufferPointer              = 0;
+  this->m_ZeroDeformationField       = DeformationFieldType::New();
   typename DeformationFieldType::SizeType dummySize;
   dummySize.Fill( 0 );
   this->m_ZeroDeformationField->SetRegions( dummySize );
@@ -51,6 +55,16 @@ OutputPointType
 DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >
 ::TransformPoint( const InputPointType & point ) const
 {
+  if( this->m_UseFastLinearInterpolation )
+  {
+    OutputVectorType displacement;
+    if( !this->EvaluateLinearAtPoint( point, displacement ) )
+    {
+      return point;
+    }
+    return point + displacement;
+  }
+
   InputContinuousIndexType cindex;
   this->m_DeformationFieldInterpolator->ConvertPointToContinuousIndex(
     point, cindex );
@@ -74,6 +88,125 @@ DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentTyp
 }
 
 
+// Interpolate the deformation field linearly at a point
+template< class TScalarType, unsigned int NDimensions, class TComponentType >
+bool
+DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >
+::EvaluateLinearAtPoint( const InputPointType & point, OutputVectorType & displacement ) const
+{
+  /** Compute the continuous index, and check that it is inside the buffer. */
+  OffsetValueType upperOffset[ NDimensions ];
+  ScalarType      distance[ NDimensions ];
+  OffsetValueType baseOffset = 0;
+  for( unsigned int i = 0; i < NDimensions; ++i )
+  {
+    ScalarType cindex = 0.0;
+    for( unsigned int j = 0; j < NDimensions; ++j )
+    {
+      cindex += this->m_PointToIndexMatrix[ i ][ j ] * ( point[ j ] - this->m_Origin[ j ] );
+    }
+    if( !( cindex >= this->m_StartContinuousIndex[ i ] && cindex < this->m_EndContinuousIndex[ i ] ) )
+    {
+      return false;
+    }
+
+    /** Neighbours outside the buffer are replaced by the nearest voxel on
+     * its border, as in the VectorLinearInterpolateImageFunction.
+     */
+    const IndexValueType lower = static_cast< IndexValueType >( std::floor( cindex ) );
+    distance[ i ] = cindex - static_cast< ScalarType >( lower );
+    const IndexValueType first  = std::max( lower, this->m_StartIndex[ i ] );
+    const IndexValueType second = std::min( lower + 1, this->m_EndIndex[ i ] );
+    baseOffset      += ( first - this->m_StartIndex[ i ] ) * this->m_OffsetTable[ i ];
+    upperOffset[ i ] = ( second - first ) * this->m_OffsetTable[ i ];
+  }
+
+  /** Sum the 2^N neighbours, weighted by their overlap. The components are
+   * accumulated together, so that the inner loop is vectorized.
+   */
+  const DeformationFieldVectorType * base = this->m_BufferPointer + baseOffset;
+  ScalarType                         sum[ OutputSpaceDimension ];
+  std::fill_n( sum, static_cast< unsigned int >( OutputSpaceDimension ), ScalarType( 0 ) );
+  const unsigned int numberOfNeighbours = 1u << NDimensions;
+  for( unsigned int n = 0; n < numberOfNeighbours; ++n )
+  {
+    ScalarType      weight = 1.0;
+    OffsetValueType offset = 0;
+    for( unsigned int i = 0; i < NDimensions; ++i )
+    {
+      if( n & ( 1u << i ) )
+      {
+        weight *= distance[ i ];
+        offset += upperOffset[ i ];
+      }
+      else
+      {
+        weight *= 1.0 - distance[ i ];
+      }
+    }
+
+    const DeformationFieldVectorType & value = base[ offset ];
+    for( unsigned int k = 0; k < OutputSpaceDimension; ++k )
+    {
+      sum[ k ] += weight * static_cast< ScalarType >( value[ k ] );
+    }
+  }
+
+  for( unsigned int k = 0; k < OutputSpaceDimension; ++k )
+  {
+    displacement[ k ] = sum[ k ];
+  }
+  return true;
+
+} // end EvaluateLinearAtPoint()
+
+
+// Store what is needed to interpolate the deformation field linearly
+template< class TScalarType, unsigned int NDimensions, class TComponentType >
+void
+DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentType >
+::UpdateFastLinearInterpolation( void )
+{
+  this->m_UseFastLinearInterpolation
+    = this->m_DeformationField.IsNotNull()
+    && dynamic_cast< LinearDeformationFieldInterpolatorType * >(
+    this->m_DeformationFieldInterpolator.GetPointer() ) != 0;
+  if( !this->m_UseFastLinearInterpolation )
+  {
+    return;
+  }
+
+  const DeformationFieldType * field = this->m_DeformationField;
+  const typename DeformationFieldType::RegionType & region = field->GetBufferedRegion();
+  if( region.GetNumberOfPixels() == 0 )
+  {
+    this->m_UseFastLinearInterpolation = false;
+    return;
+  }
+
+  /** Store the map from a physical point to a continuous index. */
+  const typename DeformationFieldType::DirectionType & pointToIndex = field->GetPhysicalPointToIndexMatrix();
+  const OffsetValueType *                              offsetTable  = field->GetOffsetTable();
+  for( unsigned int i = 0; i < NDimensions; ++i )
+  {
+    this->m_Origin[ i ] = field->GetOrigin()[ i ];
+    for( unsigned int j = 0; j < NDimensions; ++j )
+    {
+      this->m_PointToIndexMatrix[ i ][ j ] = pointToIndex[ i ][ j ];
+    }
+
+    /** The buffer, with the bounds of ImageFunction::IsInsideBuffer(). */
+    this->m_StartIndex[ i ]           = region.GetIndex( i );
+    this->m_EndIndex[ i ]             = region.GetIndex( i ) + static_cast< IndexValueType >( region.GetSize( i ) ) - 1;
+    this->m_StartContinuousIndex[ i ] = static_cast< ScalarType >( this->m_StartIndex[ i ] - 0.5 );
+    this->m_EndContinuousIndex[ i ]   = static_cast< ScalarType >( this->m_EndIndex[ i ] + 0.5 );
+    this->m_OffsetTable[ i ]          = offsetTable[ i ];
+  }
+  this->m_BufferPointer = field->GetBufferPointer();
+
+} // end UpdateFastLinearInterpolation()
+
+
 // Set the deformation field
 template< class TScalarType, unsigned int NDimensions, class TComponentType >
 void
@@ -91,6 +224,7 @@ DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentTyp
     this->m_DeformationFieldInterpolator->SetInputImage(
       this->m_DeformationField );
   }
+  this->UpdateFastLinearInterpolation();
 }
 
 
@@ -111,6 +245,7 @@ DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentTyp
     this->m_DeformationFieldInterpolator->SetInputImage(
       this->m_DeformationField );
   }
+  this->UpdateFastLinearInterpolation();
 }
 
 
@@ -124,6 +259,7 @@ DeformationFieldInterpolatingTransform< TScalarType, NDimensions,  TComponentTyp
   os << indent << "DeformationField: " << this->m_DeformationField << std::endl;
   os << indent << "ZeroDeformationField: " << this->m_ZeroDeformationField << std::endl;
   os << indent << "DeformationFieldInterpolator: " << this->m_DeformationFieldInterpolator << std::endl;
+  os << indent << "UseFastLinearInterpolation: " << this->m_UseFastLinearInterpolation << std::endl;
 }
 
 
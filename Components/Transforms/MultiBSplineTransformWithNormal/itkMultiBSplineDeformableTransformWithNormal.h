@@ -75,6 +75,8 @@ public:
   typedef typename Superclass::OutputVectorType       OutputVectorType;
   typedef typename Superclass::InputVnlVectorType     InputVnlVectorType;
   typedef typename Superclass::OutputVnlVectorType    OutputVnlVectorType;
+  typedef typename Superclass::DerivativeType         DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
   typedef typename Superclass::InputCovariantVectorType
     InputCovariantVectorType;
   typedef typename Superclass::OutputCovariantVectorType
@@ -355,6 +357,16 @@ public:
   /** Transform points by a BSpline deformable transformation. */
   OutputPointType TransformPoint( const InputPointType & point ) const override;
 
+  /** Transform a batch of points. The label of each point is looked up
+   * once, and the points are sorted by label, so that the normal transform
+   * and each label transform are evaluated by their own TransformPoints()
+   * on one contiguous batch.
+   */
+  void TransformPoints(
+    const InputPointType * inputPoints,
+    OutputPointType * outputPoints,
+    const SizeValueType n ) const override;
+
   /** Compute the Jacobian matrix of the transformation at one point. */
   //virtual const JacobianType & GetJacobian( const InputPointType & point ) const;
 
@@ -364,6 +376,28 @@ public:
     JacobianType & j,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, from the products of the normal and label transforms.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
+  /** Compute the products of the Jacobian with the moving image gradient
+   * for a batch of points, sorted by label as in TransformPoints(). The
+   * products of the normal and label transforms are computed by their
+   * EvaluateJacobianWithImageGradientProductBatch(), and are then combined
+   * per point with the local bases.
+   */
+  void EvaluateJacobianWithImageGradientProductBatch(
+    const InputPointType * ipps,
+    const MovingImageGradientType * movingImageGradients,
+    DerivativeType * imageJacobians,
+    NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+    const SizeValueType n ) const override;
+
   /** Compute the spatial Jacobian of the transformation. */
   void GetSpatialJacobian(
     const InputPointType & ipp,
@@ -501,6 +535,14 @@ private:
 
   void PointToLabel( const InputPointType & p, int & l ) const;
 
+  /** Look up the labels of a batch of points, and sort the points with a
+   * nonzero label by label. On return, the points of label l are
+   * order[ first[ l - 1 ] ], ..., order[ first[ l ] - 1 ], for l >= 1.
+   */
+  void SortPointsByLabel( const InputPointType * points, const SizeValueType n,
+    std::vector< int > & labels, std::vector< SizeValueType > & order,
+    std::vector< SizeValueType > & first ) const;
+
 };
 
 } // end namespace itk
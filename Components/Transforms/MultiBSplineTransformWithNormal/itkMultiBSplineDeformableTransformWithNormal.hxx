@@ -688,6 +688,113 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
 }
 
 
+/**
+ * ********************* SortPointsByLabel ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrder >
+::SortPointsByLabel( const InputPointType * points, const SizeValueType n,
+  std::vector< int > & labels, std::vector< SizeValueType > & order,
+  std::vector< SizeValueType > & first ) const
+{
+  /** Count the points per label, with a counting sort. */
+  labels.resize( n );
+  first.assign( this->m_NbLabels + 1, 0 );
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    this->PointToLabel( points[ i ], labels[ i ] );
+    if( labels[ i ] != 0 )
+    {
+      ++first[ labels[ i ] ];
+    }
+  }
+  for( unsigned int l = 1; l <= this->m_NbLabels; ++l )
+  {
+    first[ l ] += first[ l - 1 ];
+  }
+
+  /** Fill the buckets from the back, so that each bucket keeps the
+   * order of its points, and first[ l ] ends up at its begin.
+   */
+  order.resize( first[ this->m_NbLabels ] );
+  for( SizeValueType i = n; i > 0; --i )
+  {
+    const int l = labels[ i - 1 ];
+    if( l != 0 )
+    {
+      order[ --first[ l ] ] = i - 1;
+    }
+  }
+
+  /** Shift, such that the points of label l are at [ first[ l - 1 ], first[ l ] ). */
+  for( unsigned int l = 0; l < this->m_NbLabels; ++l )
+  {
+    first[ l ] = first[ l + 1 ];
+  }
+  first[ this->m_NbLabels ] = order.size();
+
+} // end SortPointsByLabel()
+
+
+/**
+ * ********************* TransformPoints ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrder >
+::TransformPoints(
+  const InputPointType * inputPoints,
+  OutputPointType * outputPoints,
+  const SizeValueType n ) const
+{
+  std::vector< int >           labels;
+  std::vector< SizeValueType > order;
+  std::vector< SizeValueType > first;
+  this->SortPointsByLabel( inputPoints, n, labels, order, first );
+
+  /** Gather the points with a label, in the sorted order. */
+  const SizeValueType           numberOfLabelledPoints = order.size();
+  std::vector< InputPointType > sortedPoints( numberOfLabelledPoints );
+  for( SizeValueType k = 0; k < numberOfLabelledPoints; ++k )
+  {
+    sortedPoints[ k ] = inputPoints[ order[ k ] ];
+  }
+
+  /** The normal transform applies to all of them, and each label transform
+   * to its own bucket.
+   */
+  std::vector< OutputPointType > normalPoints( numberOfLabelledPoints );
+  std::vector< OutputPointType > labelPoints( numberOfLabelledPoints );
+  this->m_Trans[ 0 ]->TransformPoints( sortedPoints.data(), normalPoints.data(), numberOfLabelledPoints );
+  for( unsigned int l = 1; l <= this->m_NbLabels; ++l )
+  {
+    const SizeValueType begin = first[ l - 1 ];
+    if( first[ l ] > begin )
+    {
+      this->m_Trans[ l ]->TransformPoints( sortedPoints.data() + begin,
+        labelPoints.data() + begin, first[ l ] - begin );
+    }
+  }
+
+  /** Combine them as in TransformPoint(), and scatter them back. */
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    if( labels[ i ] == 0 )
+    {
+      outputPoints[ i ] = inputPoints[ i ];
+    }
+  }
+  for( SizeValueType k = 0; k < numberOfLabelledPoints; ++k )
+  {
+    outputPoints[ order[ k ] ] = normalPoints[ k ] + ( labelPoints[ k ] - sortedPoints[ k ] );
+  }
+
+} // end TransformPoints()
+
+
 //template<class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder>
 //const typename MultiBSplineDeformableTransformWithNormal<TScalarType, NDimensions, VSplineOrder>::JacobianType&
 //MultiBSplineDeformableTransformWithNormal<TScalarType, NDimensions, VSplineOrder>
@@ -816,6 +923,282 @@ MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrde
 } // end GetJacobian()
 
 
+/**
+ * ********************* EvaluateJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrder >
+::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & ipp,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  if( this->GetNumberOfParameters() == 0 )
+  {
+    nonZeroJacobianIndices.resize( 0 );
+    return;
+  }
+
+  // Can only compute Jacobian if parameters are set via
+  // SetParameters or SetParametersByValue
+  if( this->m_InputParametersPointer == nullptr )
+  {
+    itkExceptionMacro( << "Cannot compute Jacobian: parameters not set" );
+  }
+
+  int lidx = 0;
+  PointToLabel( ipp, lidx );
+
+  typename TransformType::ContinuousIndexType cindex;
+  if( lidx != 0 )
+  {
+    m_Trans[ lidx ]->TransformPointToContinuousGridIndex( ipp, cindex );
+  }
+
+  // NOTE: if the support region does not lie totally within the grid
+  // we assume zero displacement and zero Jacobian
+  if( lidx == 0 || !m_Trans[ lidx ]->InsideValidRegion( cindex ) )
+  {
+    // Return some dummy
+    imageJacobian.Fill( 0.0 );
+    nonZeroJacobianIndices.resize( this->GetNumberOfNonZeroJacobianIndices() );
+    for( unsigned int i = 0; i < this->GetNumberOfNonZeroJacobianIndices(); ++i )
+    {
+      nonZeroJacobianIndices[ i ] = i;
+    }
+    return;
+  }
+
+  // The Jacobians of the sub transforms only have the weights on the
+  // diagonal blocks, so their products with the gradient are g_j * w_i
+  // at i + j * nweights. The product of the normal transform is computed
+  // in place; nzji should be the same so keep only one.
+  DerivativeType labelImageJacobian( imageJacobian.GetSize() );
+  m_Trans[ 0 ]->EvaluateJacobianWithImageGradientProduct(
+    ipp, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+  m_Trans[ lidx ]->EvaluateJacobianWithImageGradientProduct(
+    ipp, movingImageGradient, labelImageJacobian, nonZeroJacobianIndices );
+
+  typedef typename ImageBaseType::PixelContainer BaseContainer;
+  const BaseContainer & bases = *m_LocalBases->GetPixelContainer();
+
+  const unsigned nweights = this->GetNumberOfWeights();
+  for( unsigned i = 0; i < nweights; ++i )
+  {
+    double nprod[ SpaceDimension ];
+    double lprod[ SpaceDimension ];
+    for( unsigned j = 0; j < SpaceDimension; ++j )
+    {
+      nprod[ j ] = imageJacobian[ i + j * nweights ];
+      lprod[ j ] = labelImageJacobian[ i + j * nweights ];
+    }
+
+    VectorType tmp = bases[ nonZeroJacobianIndices[ i ] ][ 0 ];
+    double     sum = 0.0;
+    for( unsigned j = 0; j < SpaceDimension; ++j )
+    {
+      sum += tmp[ j ] * nprod[ j ];
+    }
+    imageJacobian[ i ] = sum;
+
+    for( unsigned d = 1; d < SpaceDimension; ++d )
+    {
+      tmp = bases[ nonZeroJacobianIndices[ i ] ][ d ];
+      sum = 0.0;
+      for( unsigned j = 0; j < SpaceDimension; ++j )
+      {
+        sum += tmp[ j ] * lprod[ j ];
+      }
+      imageJacobian[ i + d * nweights ] = sum;
+    }
+  }
+
+  // move non zero indices to match label positions
+  if( lidx > 1 )
+  {
+    unsigned to_add = ( lidx - 1 ) * m_Trans[ 0 ]->GetNumberOfParametersPerDimension() * ( SpaceDimension - 1 );
+    for( unsigned i = 0; i < nweights; ++i )
+    {
+      for( unsigned d = 1; d < SpaceDimension; ++d )
+      {
+        nonZeroJacobianIndices[ d * nweights + i ] += to_add;
+      }
+    }
+  }
+} // end EvaluateJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* EvaluateJacobianWithImageGradientProductBatch ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
+void
+MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrder >
+::EvaluateJacobianWithImageGradientProductBatch(
+  const InputPointType * ipps,
+  const MovingImageGradientType * movingImageGradients,
+  DerivativeType * imageJacobians,
+  NonZeroJacobianIndicesType * nonZeroJacobianIndices,
+  const SizeValueType n ) const
+{
+  if( this->GetNumberOfParameters() == 0 )
+  {
+    for( SizeValueType i = 0; i < n; ++i )
+    {
+      nonZeroJacobianIndices[ i ].resize( 0 );
+    }
+    return;
+  }
+
+  // Can only compute Jacobian if parameters are set via
+  // SetParameters or SetParametersByValue
+  if( this->m_InputParametersPointer == nullptr )
+  {
+    itkExceptionMacro( << "Cannot compute Jacobian: parameters not set" );
+  }
+
+  std::vector< int >           labels;
+  std::vector< SizeValueType > order;
+  std::vector< SizeValueType > first;
+  this->SortPointsByLabel( ipps, n, labels, order, first );
+
+  /** All transforms share the grid, so whether the support region lies
+   * within the grid is the same for all labels. Points outside it have a
+   * label, but are treated like the points without a label.
+   */
+  std::vector< char > valid( n, 0 );
+  for( SizeValueType k = 0; k < order.size(); ++k )
+  {
+    typename TransformType::ContinuousIndexType cindex;
+    this->m_Trans[ 0 ]->TransformPointToContinuousGridIndex( ipps[ order[ k ] ], cindex );
+    valid[ order[ k ] ] = this->m_Trans[ 0 ]->InsideValidRegion( cindex );
+  }
+
+  // NOTE: if the support region does not lie totally within the grid
+  // we assume zero displacement and zero Jacobian
+  for( SizeValueType i = 0; i < n; ++i )
+  {
+    if( !valid[ i ] )
+    {
+      // Return some dummy
+      imageJacobians[ i ].Fill( 0.0 );
+      nonZeroJacobianIndices[ i ].resize( this->GetNumberOfNonZeroJacobianIndices() );
+      for( unsigned int j = 0; j < this->GetNumberOfNonZeroJacobianIndices(); ++j )
+      {
+        nonZeroJacobianIndices[ i ][ j ] = j;
+      }
+    }
+  }
+
+  /** Gather the valid points per label, in the sorted order. */
+  std::vector< SizeValueType > sortedIndices;
+  std::vector< SizeValueType > sortedFirst( this->m_NbLabels + 1, 0 );
+  sortedIndices.reserve( order.size() );
+  for( unsigned int l = 1; l <= this->m_NbLabels; ++l )
+  {
+    for( SizeValueType k = first[ l - 1 ]; k < first[ l ]; ++k )
+    {
+      if( valid[ order[ k ] ] )
+      {
+        sortedIndices.push_back( order[ k ] );
+      }
+    }
+    sortedFirst[ l ] = sortedIndices.size();
+  }
+
+  const SizeValueType                       m     = sortedIndices.size();
+  const unsigned int                        nnzji = this->GetNumberOfNonZeroJacobianIndices();
+  std::vector< InputPointType >             sortedPoints( m );
+  std::vector< MovingImageGradientType >    sortedGradients( m );
+  std::vector< DerivativeType >             normalProducts( m, DerivativeType( nnzji ) );
+  std::vector< DerivativeType >             labelProducts( m, DerivativeType( nnzji ) );
+  std::vector< NonZeroJacobianIndicesType > sortedIndicesOfJacobian( m );
+  std::vector< NonZeroJacobianIndicesType > labelIndicesOfJacobian( m );
+  for( SizeValueType k = 0; k < m; ++k )
+  {
+    sortedPoints[ k ]    = ipps[ sortedIndices[ k ] ];
+    sortedGradients[ k ] = movingImageGradients[ sortedIndices[ k ] ];
+  }
+
+  /** The normal transform over all valid points, each label transform over
+   * its bucket; nzji should be the same so keep only one.
+   */
+  if( m > 0 )
+  {
+    this->m_Trans[ 0 ]->EvaluateJacobianWithImageGradientProductBatch( sortedPoints.data(),
+      sortedGradients.data(), normalProducts.data(), sortedIndicesOfJacobian.data(), m );
+  }
+  for( unsigned int l = 1; l <= this->m_NbLabels; ++l )
+  {
+    const SizeValueType begin = sortedFirst[ l - 1 ];
+    if( sortedFirst[ l ] > begin )
+    {
+      this->m_Trans[ l ]->EvaluateJacobianWithImageGradientProductBatch( sortedPoints.data() + begin,
+        sortedGradients.data() + begin, labelProducts.data() + begin,
+        labelIndicesOfJacobian.data() + begin, sortedFirst[ l ] - begin );
+    }
+  }
+
+  /** Combine the products with the local bases, as in
+   * EvaluateJacobianWithImageGradientProduct().
+   */
+  typedef typename ImageBaseType::PixelContainer BaseContainer;
+  const BaseContainer & bases    = *m_LocalBases->GetPixelContainer();
+  const unsigned        nweights = this->GetNumberOfWeights();
+  const unsigned        perLabel = this->m_Trans[ 0 ]->GetNumberOfParametersPerDimension() * ( SpaceDimension - 1 );
+  for( SizeValueType k = 0; k < m; ++k )
+  {
+    const SizeValueType                i       = sortedIndices[ k ];
+    const DerivativeType &             nprod   = normalProducts[ k ];
+    const DerivativeType &             lprod   = labelProducts[ k ];
+    DerivativeType &                   product = imageJacobians[ i ];
+    NonZeroJacobianIndicesType &       indices = nonZeroJacobianIndices[ i ];
+    const NonZeroJacobianIndicesType & nzji    = sortedIndicesOfJacobian[ k ];
+    indices = nzji;
+
+    for( unsigned w = 0; w < nweights; ++w )
+    {
+      VectorType tmp = bases[ nzji[ w ] ][ 0 ];
+      double     sum = 0.0;
+      for( unsigned j = 0; j < SpaceDimension; ++j )
+      {
+        sum += tmp[ j ] * nprod[ w + j * nweights ];
+      }
+      product[ w ] = sum;
+
+      for( unsigned d = 1; d < SpaceDimension; ++d )
+      {
+        tmp = bases[ nzji[ w ] ][ d ];
+        sum = 0.0;
+        for( unsigned j = 0; j < SpaceDimension; ++j )
+        {
+          sum += tmp[ j ] * lprod[ w + j * nweights ];
+        }
+        product[ w + d * nweights ] = sum;
+      }
+    }
+
+    // move non zero indices to match label positions
+    if( labels[ i ] > 1 )
+    {
+      const unsigned to_add = ( labels[ i ] - 1 ) * perLabel;
+      for( unsigned w = 0; w < nweights; ++w )
+      {
+        for( unsigned d = 1; d < SpaceDimension; ++d )
+        {
+          indices[ d * nweights + w ] += to_add;
+        }
+      }
+    }
+  }
+
+} // end EvaluateJacobianWithImageGradientProductBatch()
+
+
 template< class TScalarType, unsigned int NDimensions, unsigned int VSplineOrder >
 void
 MultiBSplineDeformableTransformWithNormal< TScalarType, NDimensions, VSplineOrder >
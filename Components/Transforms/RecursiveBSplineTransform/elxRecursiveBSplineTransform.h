@@ -69,6 +69,21 @@ namespace elastix
  *   The default is zero for all resolutions. A value of 4 will avoid all deformations
  *   at the edge of the image. Make sure that 2*PassiveEdgeWidth < ControlPointGridSize
  *   in each dimension.
+ * \parameter UseCompactBSplineCoefficients: whether the B-spline coefficients are also stored
+ *   interleaved in single precision, with the coefficients of a control point next to each
+ *   other. TransformPoint() then reads them with one cache line per control point, which
+ *   speeds up the transformation of points for fine grids. The parameters, the Jacobian and
+ *   the metric derivatives remain double precision. Can be specified for each resolution. \n
+ *   example: <tt>(UseCompactBSplineCoefficients "true")</tt> \n
+ *   The default is "false".
+ * \parameter UseDyadicGridRefinement: whether the B-spline coefficients of the next
+ *   resolution are computed by B-spline subdivision when the grid spacing halves, or stays
+ *   the same, and the new grid points lie on the refined grid. This is faster and represents
+ *   the deformation exactly, whereas the default method resamples it with mirrored
+ *   coefficients at the border, so the results differ near the border. Otherwise the default
+ *   method is used. Not used with UseCyclicTransform. Can be specified for each resolution. \n
+ *   example: <tt>(UseDyadicGridRefinement "true")</tt> \n
+ *   The default is "false".
  * \parameter UseCyclicTransform: use the cyclic version of the B-spline transform which
  *   ensures that the B-spline polynomials wrap around in the slowest varying dimension.
  *   This is useful for dynamic imaging data in which the motion is assumed to be cyclic,
@@ -210,6 +210,12 @@ RecursiveBSplineTransform< TElastix >
     "PassiveEdgeWidth", this->GetComponentLabel(), level, 0, false );
   this->SetOptimizerScales( passiveEdgeWidth );
 
+  /** Store a compact copy of the B-spline coefficients, or not. */
+  bool useCompactCoefficients = false;
+  this->GetConfiguration()->ReadParameter( useCompactCoefficients,
+    "UseCompactBSplineCoefficients", this->GetComponentLabel(), level, 0, false );
+  this->m_BSplineTransform->SetUseCompactCoefficients( useCompactCoefficients );
+
 } // end BeforeEachResolution()
 
 
@@ -448,6 +454,14 @@ RecursiveBSplineTransform< TElastix >
   ParametersType latestParameters
     = this->m_Registration->GetAsITKBaseType()->GetLastTransformParameters();
 
+  /** Compute the upsampled parameters by B-spline subdivision, if the
+   * spacing halves. This is not supported for the cyclic transform.
+   */
+  bool useDyadicGridRefinement = false;
+  this->GetConfiguration()->ReadParameter( useDyadicGridRefinement,
+    "UseDyadicGridRefinement", this->GetComponentLabel(), level, 0 );
+  this->m_GridUpsampler->SetUseDyadicRefinement( useDyadicGridRefinement && !this->m_Cyclic );
+
   /** Setup the GridUpsampler. */
   this->m_GridUpsampler->SetCurrentGridOrigin( currentGridOrigin );
   this->m_GridUpsampler->SetCurrentGridSpacing( currentGridSpacing );
@@ -70,6 +70,13 @@ namespace elastix
  * Default: 0.3. You cannot specify this parameter for each resolution differently.\n
  * Valid values are withing -1.0 and 0.5. 0.5 means incompressible.
  * Negative values are a bit odd, but possible. See Wikipedia on PoissonRatio.
+ * \parameter TPSMatrixInversionMethod: The method to solve the spline system,
+ * one of {SVD, QR, CG}. CG solves the system iteratively without building it,
+ * which is much faster for large numbers of landmarks, but it cannot compute
+ * the Jacobian. The registration therefore uses QR instead of CG, and CG is
+ * only written to the transform parameter file, for transformix.\n
+ *   example: <tt>(TPSMatrixInversionMethod "CG")</tt>\n
+ * Default: SVD.
  *
  * \commandlinearg -fp: a file specifying a set of points that will serve
  * as fixed image landmarks.\n
@@ -104,6 +111,11 @@ namespace elastix
  *   example: <tt>(SplinePoissonRatio 0.3 )</tt>\n
  * Valid values are withing -1.0 and 0.5. 0.5 means incompressible.
  * Negative values are a bit odd, but possible. See Wikipedia on PoissonRatio.
+ * \transformparameter TPSMatrixInversionMethod: The method to solve the
+ * spline system, one of {SVD, QR, CG}. See the parameter above. CG is only
+ * possible for the ThinPlateSpline and the VolumeSpline kernels.\n
+ *   example: <tt>(TPSMatrixInversionMethod "CG")</tt>\n
+ * Default: SVD.
  * \transformparameter FixedImageLandmarks: The landmark positions in the
  * fixed image, in world coordinates. Positions written as x1 y1 [z1] x2 y2 [z2] etc.\n
  *   example: <tt>(FixedImageLandmarks 10.0 11.0 12.0 4.0 4.0 4.0 6.0 6.0 6.0 )</tt>
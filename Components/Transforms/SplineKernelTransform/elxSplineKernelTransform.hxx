@@ -195,10 +195,18 @@ SplineKernelTransform< TElastix >
     this->m_KernelTransform->SetPoissonRatio( poissonRatio );
   }
 
-  /** Set the matrix inversion method (one of {SVD, QR}). */
+  /** Set the matrix inversion method (one of {SVD, QR, CG}). The
+   * registration needs the Jacobian, which the CG method does not provide.
+   */
   std::string matrixInversionMethod = "SVD";
   this->GetConfiguration()->ReadParameter(
     matrixInversionMethod, "TPSMatrixInversionMethod", 0, true );
+  if( matrixInversionMethod == "CG" )
+  {
+    elxout << "NOTE: the registration uses the QR matrix inversion method "
+           << "instead of CG, which is\n  only used when applying the transform." << std::endl;
+    matrixInversionMethod = "QR";
+  }
   this->m_KernelTransform->SetMatrixInversionMethod( matrixInversionMethod );
 
   /** Load fixed image (source) landmark positions. */
@@ -432,6 +440,14 @@ SplineKernelTransform< TElastix >
     poissonRatio, "SplinePoissonRatio", this->GetComponentLabel(), 0, -1 );
   this->m_KernelTransform->SetPoissonRatio( poissonRatio );
 
+  /** Set the matrix inversion method before the landmarks, which
+   * trigger the inversion.
+   */
+  std::string matrixInversionMethod = "SVD";
+  this->GetConfiguration()->ReadParameter(
+    matrixInversionMethod, "TPSMatrixInversionMethod", 0, false );
+  this->m_KernelTransform->SetMatrixInversionMethod( matrixInversionMethod );
+
   /** Read number of parameters. */
   unsigned int numberOfParameters = 0;
   this->GetConfiguration()->ReadParameter(
@@ -493,6 +509,15 @@ SplineKernelTransform< TElastix >
   xl::xout[ "transpar" ] << "(SplineRelaxationFactor "
                          << this->m_KernelTransform->GetStiffness() << ")" << std::endl;
 
+  /** Write the matrix inversion method, as given in the configuration,
+   * because the registration replaces CG by QR.
+   */
+  std::string matrixInversionMethod = this->m_KernelTransform->GetMatrixInversionMethod();
+  this->m_Configuration->ReadParameter(
+    matrixInversionMethod, "TPSMatrixInversionMethod", 0, false );
+  xl::xout[ "transpar" ] << "(TPSMatrixInversionMethod ""
+                         << matrixInversionMethod << "")" << std::endl;
+
   /** Write the fixed image landmarks. */
   const ParametersType & fixedParams = this->m_KernelTransform->GetFixedParameters();
   xl::xout[ "transpar" ] << "(FixedImageLandmarks ";
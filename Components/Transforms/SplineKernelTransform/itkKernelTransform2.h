@@ -39,15 +39,15 @@ PURPOSE.  See the above copyright notices for more information.
 #include "itkVector.h"
 #include "itkMatrix.h"
 #include "itkPointSet.h"
+#include "itkMultiThreaderBase.h"
 #include <deque>
+#include <vector>
 #include <math.h>
 #include "vnl/vnl_matrix_fixed.h"
 #include "vnl/vnl_matrix.h"
 #include "vnl/vnl_vector.h"
 #include "vnl/vnl_vector_fixed.h"
 #include "vnl/vnl_sample.h"
-#include "vnl/algo/vnl_svd.h"
-#include "vnl/algo/vnl_qr.h"
 
 namespace itk
 {
@@ -86,6 +86,8 @@ namespace itk
  * - Support for matrix inversion by QR decomposition, instead of SVD.
  *   QR is much faster. Used in SetParameters() and SetFixedParameters().
  * - Much faster Jacobian computation for some of the derived kernel transforms.
+ * - Iterative solution of the system by conjugate gradients, for large
+ *   numbers of landmarks.
  *
  * \ingroup Transforms
  *
@@ -128,6 +130,8 @@ public:
   typedef typename Superclass::OutputCovariantVectorType OutputCovariantVectorType;
   typedef typename Superclass::InputVnlVectorType        InputVnlVectorType;
   typedef typename Superclass::OutputVnlVectorType       OutputVnlVectorType;
+  typedef typename Superclass::DerivativeType            DerivativeType;
+  typedef typename Superclass::MovingImageGradientType   MovingImageGradientType;
 
   /** AdvancedTransform typedefs. */
   typedef typename Superclass
@@ -223,6 +227,15 @@ public:
     JacobianType &,
     NonZeroJacobianIndicesType & ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override;
+
   /** Set the Transformation Parameters to be an identity transform. */
   virtual void SetIdentity( void );
 
@@ -292,10 +305,21 @@ public:
   }
 
 
-  /** Matrix inversion by SVD or QR decomposition. */
+  /** Matrix inversion by SVD or QR decomposition, or the iterative solution
+   * of the system by conjugate gradients ("CG"). The CG method does not
+   * store the L matrix, so it also works for many thousands of landmarks. It
+   * is only possible for the kernels with a diagonal G, such as the thin
+   * plate and volume splines, and it does not compute the inverse of L that
+   * is needed for the Jacobian. It is therefore meant for transforms that
+   * are applied, not for registration.
+   */
   itkSetMacro( MatrixInversionMethod, std::string );
   itkGetConstReferenceMacro( MatrixInversionMethod, std::string );
 
+  /** The relative residual at which the CG method stops. Default: 1e-10. */
+  itkSetMacro( IterativeSolverTolerance, double );
+  itkGetConstMacro( IterativeSolverTolerance, double );
+
   /** Must be provided. */
   void GetSpatialJacobian(
     const InputPointType & ipp, SpatialJacobianType & sj ) const override
@@ -441,6 +465,21 @@ protected:
    */
   void ReorganizeW( void );
 
+  /** Compute D, A and B by conjugate gradients, without computing L. For a
+   * kernel with a diagonal G, the system separates into one system per
+   * dimension, with the same scalar kernel matrix. The part of D orthogonal
+   * to the affine part is solved by CG, after which A and B follow from a
+   * small least squares problem.
+   */
+  void ComputeWMatrixByConjugateGradient( void );
+
+  /** Compute y = K x for the scalar kernel matrix K of the given points,
+   * where x and y have one column per dimension. K is not stored, but
+   * evaluated by the threads of the PersistentThreadPool.
+   */
+  void MultiplyByScalarKernelMatrix( const std::vector< InputPointType > & points,
+    const vnl_matrix< TScalarType > & x, vnl_matrix< TScalarType > & y ) const;
+
   /** Stiffness parameter. */
   double m_Stiffness;
 
@@ -496,17 +535,14 @@ protected:
   /** Has the L matrix decomposition been computed? */
   bool m_LMatrixDecompositionComputed;
 
-  /** Decompositions, needed for the L matrix.
-   * These decompositions are cached for performance reasons during registration.
+  /** The (pseudo-)inverse of the L matrix, from its SVD or QR decomposition.
+   * It is cached for performance reasons during registration.
    * During registration, in every iteration SetParameters() is called, which in
    * turn calls ComputeWMatrix(). The L matrix is not changed however, and therefore
-   * it is not needed to redo the decomposition.
+   * it is not needed to redo the decomposition: W is the product of this
+   * matrix and Y, which costs no more than a solve with the decomposition.
    */
-  typedef vnl_svd< ScalarType > SVDDecompositionType;
-  typedef vnl_qr< ScalarType >  QRDecompositionType;
-
-  SVDDecompositionType * m_LMatrixDecompositionSVD;
-  QRDecompositionType *  m_LMatrixDecompositionQR;
+  vnl_matrix< ScalarType > m_LMatrixDecompositionInverse;
 
   /** Identity matrix. */
   IMatrixType m_I;
@@ -532,6 +568,23 @@ private:
   /** Using SVD or QR decomposition. */
   std::string m_MatrixInversionMethod;
 
+  /** The stopping criterion of the CG method. */
+  double m_IterativeSolverTolerance;
+
+  /** The data passed to the threads by MultiplyByScalarKernelMatrix(). */
+  struct KernelMatrixThreaderParameterType
+  {
+    const Self *                      m_Transform;
+    const InputPointType *            m_Points;
+    const vnl_matrix< TScalarType > * m_X;
+    vnl_matrix< TScalarType > *       m_Y;
+    unsigned long                     m_NumberOfPoints;
+    unsigned long                     m_RowsPerWorkUnit;
+  };
+
+  /** Compute the rows of K x of one work unit. */
+  static ITK_THREAD_RETURN_TYPE KernelMatrixThreaderCallback( void * arg );
+
 };
 
 } // end namespace itk
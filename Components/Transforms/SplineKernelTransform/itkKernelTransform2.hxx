@@ -35,6 +35,11 @@ PURPOSE.  See the above copyright notices for more information.
 #define _itkKernelTransform2_hxx
 
 #include "itkKernelTransform2.h"
+#include "itkDenseLinearAlgebra.h"
+#include "itkPersistentThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
 
 namespace itk
 {
@@ -62,13 +67,11 @@ KernelTransform2< TScalarType, NDimensions >
   this->m_LInverseComputed             = false;
   this->m_LMatrixDecompositionComputed = false;
 
-  this->m_LMatrixDecompositionSVD = 0;
-  this->m_LMatrixDecompositionQR  = 0;
-
   this->m_Stiffness    = 0.0;
   this->m_PoissonRatio = 0.3;
 
   this->m_MatrixInversionMethod   = "SVD";
+  this->m_IterativeSolverTolerance = 1e-10;
   this->m_FastComputationPossible = false;
 
   this->m_HasNonZeroSpatialHessian           = true;
@@ -84,11 +87,7 @@ KernelTransform2< TScalarType, NDimensions >
 template< class TScalarType, unsigned int NDimensions >
 KernelTransform2< TScalarType, NDimensions >
 ::~KernelTransform2()
-{
-  delete m_LMatrixDecompositionSVD;
-  delete m_LMatrixDecompositionQR;
-
-} // end destructor
+{} // end destructor
 
 
 /**
@@ -251,6 +250,13 @@ void
 KernelTransform2< TScalarType, NDimensions >
 ::ComputeWMatrix( void )
 {
+  /** The CG method does not need the L matrix. */
+  if( this->m_MatrixInversionMethod == "CG" )
+  {
+    this->ComputeWMatrixByConjugateGradient();
+    return;
+  }
+
   /** Compute L and Y. */
   if( !this->m_LMatrixComputed )
   {
@@ -263,37 +269,25 @@ KernelTransform2< TScalarType, NDimensions >
   {
     if( !this->m_LMatrixDecompositionComputed )
     {
-      if( this->m_LMatrixDecompositionSVD != 0 )
-      {
-        delete this->m_LMatrixDecompositionSVD;
-      }
-      this->m_LMatrixDecompositionSVD      = new SVDDecompositionType( this->m_LMatrix, 1e-8 );
+      DenseLinearAlgebra::PseudoInverse( this->m_LMatrix, 1e-8, this->m_LMatrixDecompositionInverse );
       this->m_LMatrixDecompositionComputed = true;
     }
-    this->m_WMatrix = this->m_LMatrixDecompositionSVD->solve( this->m_YMatrix );
-    //vnl_svd<TScalarType> svd( this->m_LMatrix, 1e-8 );
-    //this->m_WMatrix = svd.solve( this->m_YMatrix );
   }
   else if( this->m_MatrixInversionMethod == "QR" )
   {
     if( !this->m_LMatrixDecompositionComputed )
     {
-      if( this->m_LMatrixDecompositionQR != 0 )
-      {
-        delete this->m_LMatrixDecompositionQR;
-      }
-      this->m_LMatrixDecompositionQR       = new QRDecompositionType( this->m_LMatrix );
+      DenseLinearAlgebra::QRInverse( this->m_LMatrix, this->m_LMatrixDecompositionInverse );
       this->m_LMatrixDecompositionComputed = true;
     }
-    this->m_WMatrix = this->m_LMatrixDecompositionQR->solve( this->m_YMatrix );
-//     vnl_qr<TScalarType> qr( this->m_LMatrix );
-//     this->m_WMatrix = qr.solve( this->m_YMatrix );
   }
   else
   {
     itkExceptionMacro( << "ERROR: invalid matrix inversion method ("
                        << this->m_MatrixInversionMethod << ")" );
   }
+  DenseLinearAlgebra::Multiply( this->m_LMatrixDecompositionInverse,
+    this->m_YMatrix, this->m_WMatrix );
 
   /** Reorganize W. */
   this->ReorganizeW();
@@ -311,6 +305,14 @@ void
 KernelTransform2< TScalarType, NDimensions >
 ::ComputeLInverse( void )
 {
+  /** The CG method is meant to avoid the L matrix and its inverse. */
+  if( this->m_MatrixInversionMethod == "CG" )
+  {
+    this->m_LMatrixInverse.clear();
+    this->m_LInverseComputed = false;
+    return;
+  }
+
   if( !this->m_LMatrixComputed )
   {
     this->ComputeL();
@@ -318,13 +320,12 @@ KernelTransform2< TScalarType, NDimensions >
 
   if( this->m_MatrixInversionMethod == "SVD" )
   {
-    //this->m_LMatrixInverse = vnl_matrix_inverse<TScalarType>( this->m_LMatrix );
-    this->m_LMatrixInverse   = vnl_svd< TScalarType >( this->m_LMatrix ).inverse();
+    DenseLinearAlgebra::PseudoInverse( this->m_LMatrix, 0.0, this->m_LMatrixInverse );
     this->m_LInverseComputed = true;
   }
   else if( this->m_MatrixInversionMethod == "QR" )
   {
-    this->m_LMatrixInverse   = vnl_qr< TScalarType >( this->m_LMatrix ).inverse();
+    DenseLinearAlgebra::QRInverse( this->m_LMatrix, this->m_LMatrixInverse );
     this->m_LInverseComputed = true;
   }
   else
@@ -527,6 +528,237 @@ KernelTransform2< TScalarType, NDimensions >
 } // end ReorganizeW()
 
 
+/**
+ * ******************* ComputeWMatrixByConjugateGradient *******************
+ *
+ * For a kernel with G = g I the system separates per dimension e into
+ *   K c_e + P [ a_e ; b_e ] = d_e, and P^T c_e = 0,
+ * with the N x N scalar kernel matrix K, the N x (D+1) matrix P with rows
+ * [ p_i^T 1 ], and the displacements d_e. With the projection Q on the
+ * null space of P^T, c_e solves Q K Q c_e = Q d_e. Q K Q is definite on
+ * that space for the thin plate and volume splines, so CG applies, with
+ * the same K for all dimensions. The affine part then follows from
+ * P [ a_e ; b_e ] = d_e - K c_e.
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+KernelTransform2< TScalarType, NDimensions >
+::ComputeWMatrixByConjugateGradient( void )
+{
+  if( !this->m_FastComputationPossible )
+  {
+    itkExceptionMacro( << "ERROR: the CG matrix inversion method is only "
+                       << "possible for kernels with a diagonal G matrix" );
+  }
+
+  this->ComputeD();
+
+  const unsigned long numberOfLandmarks = this->m_SourceLandmarks->GetNumberOfPoints();
+  const unsigned int  affineSize        = NDimensions + 1;
+
+  /** Copy the landmarks and the displacements to contiguous arrays. */
+  std::vector< InputPointType > points( numberOfLandmarks );
+  vnl_matrix< TScalarType >     displacements( numberOfLandmarks, NDimensions );
+  vnl_matrix< TScalarType >     P( numberOfLandmarks, affineSize );
+  typename VectorSetType::ConstIterator displacement = this->m_Displacements->Begin();
+  PointsIterator sp = this->m_SourceLandmarks->GetPoints()->Begin();
+  for( unsigned long i = 0; i < numberOfLandmarks; ++i )
+  {
+    points[ i ] = sp->Value();
+    for( unsigned int dim = 0; dim < NDimensions; dim++ )
+    {
+      P( i, dim )             = points[ i ][ dim ];
+      displacements( i, dim ) = displacement.Value()[ dim ];
+    }
+    P( i, NDimensions ) = 1.0;
+    ++sp;
+    ++displacement;
+  }
+
+  /** The pseudo-inverse of P, for the projection and the affine part. */
+  vnl_matrix< TScalarType > PtP;
+  vnl_matrix< TScalarType > pseudoInversePtP;
+  vnl_matrix< TScalarType > pseudoInverseP;
+  DenseLinearAlgebra::TransposeMultiply( P, P, PtP );
+  DenseLinearAlgebra::PseudoInverse( PtP, 0.0, pseudoInversePtP );
+  pseudoInverseP = pseudoInversePtP * P.transpose();
+
+  /** Project the columns of x on the null space of P^T. */
+  auto project = [&P, &pseudoInverseP]( vnl_matrix< TScalarType > & x )
+    {
+      x -= P * ( pseudoInverseP * x );
+    };
+
+  /** Conjugate gradients, with a separate step for each dimension. */
+  vnl_matrix< TScalarType > c( numberOfLandmarks, NDimensions, 0.0 );
+  vnl_matrix< TScalarType > r = displacements;
+  project( r );
+  vnl_matrix< TScalarType > p = r;
+  vnl_matrix< TScalarType > q( numberOfLandmarks, NDimensions );
+
+  double rr[ NDimensions ];
+  double threshold[ NDimensions ];
+  bool   converged[ NDimensions ];
+  bool   allConverged = true;
+  for( unsigned int dim = 0; dim < NDimensions; dim++ )
+  {
+    rr[ dim ]        = r.get_column( dim ).squared_magnitude();
+    threshold[ dim ] = rr[ dim ] * this->m_IterativeSolverTolerance * this->m_IterativeSolverTolerance;
+    converged[ dim ] = rr[ dim ] == 0.0;
+    allConverged    &= converged[ dim ];
+  }
+
+  const unsigned long maximumNumberOfIterations = 2 * numberOfLandmarks + 10;
+  for( unsigned long iteration = 0; iteration < maximumNumberOfIterations && !allConverged; ++iteration )
+  {
+    this->MultiplyByScalarKernelMatrix( points, p, q );
+    project( q );
+
+    allConverged = true;
+    for( unsigned int dim = 0; dim < NDimensions; dim++ )
+    {
+      if( converged[ dim ] )
+      {
+        continue;
+      }
+
+      double pq = 0.0;
+      for( unsigned long i = 0; i < numberOfLandmarks; ++i )
+      {
+        pq += p( i, dim ) * q( i, dim );
+      }
+      if( pq == 0.0 )
+      {
+        converged[ dim ] = true;
+        continue;
+      }
+
+      const double alpha = rr[ dim ] / pq;
+      double       rrNew = 0.0;
+      for( unsigned long i = 0; i < numberOfLandmarks; ++i )
+      {
+        c( i, dim ) += alpha * p( i, dim );
+        r( i, dim ) -= alpha * q( i, dim );
+        rrNew       += r( i, dim ) * r( i, dim );
+      }
+
+      const double beta = rrNew / rr[ dim ];
+      rr[ dim ] = rrNew;
+      for( unsigned long i = 0; i < numberOfLandmarks; ++i )
+      {
+        p( i, dim ) = r( i, dim ) + beta * p( i, dim );
+      }
+      converged[ dim ] = rrNew <= threshold[ dim ];
+      allConverged    &= converged[ dim ];
+    }
+  }
+
+  if( !allConverged )
+  {
+    itkExceptionMacro( << "ERROR: the CG method did not converge in "
+                       << maximumNumberOfIterations << " iterations" );
+  }
+
+  /** The affine part follows from the residual of the deformation part. */
+  vnl_matrix< TScalarType > Kc( numberOfLandmarks, NDimensions );
+  this->MultiplyByScalarKernelMatrix( points, c, Kc );
+  const vnl_matrix< TScalarType > affine = pseudoInverseP * ( displacements - Kc );
+
+  this->m_DMatrix = c.transpose();
+  for( unsigned int i = 0; i < NDimensions; i++ )
+  {
+    for( unsigned int j = 0; j < NDimensions; j++ )
+    {
+      this->m_AMatrix( i, j ) = affine( j, i );
+    }
+    this->m_BVector( i ) = affine( NDimensions, i );
+  }
+  this->m_WMatrixComputed = true;
+
+} // end ComputeWMatrixByConjugateGradient()
+
+
+/**
+ * ******************* MultiplyByScalarKernelMatrix *******************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+KernelTransform2< TScalarType, NDimensions >
+::MultiplyByScalarKernelMatrix( const std::vector< InputPointType > & points,
+  const vnl_matrix< TScalarType > & x, vnl_matrix< TScalarType > & y ) const
+{
+  const PersistentThreadPool::Pointer pool = PersistentThreadPool::GetInstance();
+  const unsigned long numberOfPoints = points.size();
+  const ThreadIdType  numberOfWorkUnits = static_cast< ThreadIdType >( std::max< unsigned long >( 1,
+    std::min< unsigned long >( pool->GetMaximumNumberOfThreads(), numberOfPoints / 64 ) ) );
+
+  KernelMatrixThreaderParameterType temp;
+  temp.m_Transform       = this;
+  temp.m_Points          = points.data();
+  temp.m_X               = &x;
+  temp.m_Y               = &y;
+  temp.m_NumberOfPoints  = numberOfPoints;
+  temp.m_RowsPerWorkUnit = ( numberOfPoints + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+
+  pool->SingleMethodExecute( numberOfWorkUnits, Self::KernelMatrixThreaderCallback, &temp );
+
+} // end MultiplyByScalarKernelMatrix()
+
+
+/**
+ * ******************* KernelMatrixThreaderCallback *******************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+ITK_THREAD_RETURN_TYPE
+KernelTransform2< TScalarType, NDimensions >
+::KernelMatrixThreaderCallback( void * arg )
+{
+  const PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< PersistentThreadPool::WorkUnitInfo * >( arg );
+  const KernelMatrixThreaderParameterType * temp
+    = static_cast< KernelMatrixThreaderParameterType * >( infoStruct->UserData );
+
+  const unsigned long begin = std::min( infoStruct->WorkUnitID * temp->m_RowsPerWorkUnit, temp->m_NumberOfPoints );
+  const unsigned long end   = std::min( begin + temp->m_RowsPerWorkUnit, temp->m_NumberOfPoints );
+
+  const vnl_matrix< TScalarType > & x = *temp->m_X;
+  vnl_matrix< TScalarType > &       y = *temp->m_Y;
+  GMatrixType                       G;
+  for( unsigned long i = begin; i < end; ++i )
+  {
+    /** The diagonal of K holds the stiffness, see ComputeReflexiveG(). */
+    double sum[ NDimensions ];
+    for( unsigned int dim = 0; dim < NDimensions; dim++ )
+    {
+      sum[ dim ] = temp->m_Transform->m_Stiffness * x( i, dim );
+    }
+    for( unsigned long j = 0; j < temp->m_NumberOfPoints; ++j )
+    {
+      if( j == i )
+      {
+        continue;
+      }
+      temp->m_Transform->ComputeG( temp->m_Points[ i ] - temp->m_Points[ j ], G );
+      const double g = G( 0, 0 );
+      for( unsigned int dim = 0; dim < NDimensions; dim++ )
+      {
+        sum[ dim ] += g * x( j, dim );
+      }
+    }
+    for( unsigned int dim = 0; dim < NDimensions; dim++ )
+    {
+      y( i, dim ) = sum[ dim ];
+    }
+  }
+
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end KernelMatrixThreaderCallback()
+
+
 /**
  * ******************* TransformPoint *******************
  */
@@ -754,6 +986,12 @@ KernelTransform2< TScalarType, NDimensions >
 ::GetJacobian( const InputPointType & p, JacobianType & jac,
   NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
 {
+  if( this->m_MatrixInversionMethod == "CG" )
+  {
+    itkExceptionMacro( << "ERROR: the Jacobian needs the inverse of the L matrix, "
+                       << "which is not computed by the CG method" );
+  }
+
   const unsigned long numberOfLandmarks = this->m_SourceLandmarks->GetNumberOfPoints();
   jac.SetSize( NDimensions, numberOfLandmarks * NDimensions );
   jac.Fill( 0.0 );
@@ -888,6 +1126,100 @@ KernelTransform2< TScalarType, NDimensions >
 } // end GetJacobian()
 
 
+/**
+ * ********************* EvaluateJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+KernelTransform2< TScalarType, NDimensions >
+::EvaluateJacobianWithImageGradientProduct( const InputPointType & p,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  // Each entry of g^T J is an inner product of a column of Linv with a
+  // vector c, that is built from g, G and p, so the products are
+  // accumulated row by row of Linv. See GetJacobian() for the notation.
+  if( this->m_MatrixInversionMethod == "CG" )
+  {
+    itkExceptionMacro( << "ERROR: the Jacobian needs the inverse of the L matrix, "
+                       << "which is not computed by the CG method" );
+  }
+
+  const unsigned long numberOfLandmarks = this->m_SourceLandmarks->GetNumberOfPoints();
+  const unsigned long numberOfColumns   = numberOfLandmarks * NDimensions;
+  imageJacobian.Fill( 0.0 );
+  GMatrixType    Gmatrix;
+  PointsIterator sp = this->m_SourceLandmarks->GetPoints()->Begin();
+
+  // Deformation part of the transform:
+  if( !this->m_FastComputationPossible )
+  {
+    for( unsigned int lnd = 0; lnd < numberOfLandmarks; lnd++ )
+    {
+      this->ComputeG( p - sp->Value(), Gmatrix );
+      for( unsigned int dim = 0; dim < NDimensions; dim++ )
+      {
+        // c = G g
+        ScalarType c = 0.0;
+        for( unsigned int odim = 0; odim < NDimensions; odim++ )
+        {
+          c += Gmatrix( dim, odim ) * movingImageGradient[ odim ];
+        }
+        const unsigned long row = lnd * NDimensions + dim;
+        for( unsigned long lidx = 0; lidx < numberOfColumns; lidx++ )
+        {
+          imageJacobian[ lidx ] += c * this->m_LMatrixInverse[ row ][ lidx ];
+        }
+      }
+      ++sp;
+    }
+  }
+  else
+  {
+    // Properties A and B: G = G(0,0) * I_d, and the blocks of Linv are
+    // multiples of I_d, so only the first row of each block is accessed.
+    for( unsigned int lnd = 0; lnd < numberOfLandmarks; lnd++ )
+    {
+      this->ComputeG( p - sp->Value(), Gmatrix );
+      const ScalarType    g   = Gmatrix( 0, 0 );
+      const unsigned long row = lnd * NDimensions;
+      for( unsigned long lidx = 0; lidx < numberOfLandmarks; lidx++ )
+      {
+        const unsigned long lIdx  = lidx * NDimensions;
+        const ScalarType    glinv = g * this->m_LMatrixInverse[ row ][ lIdx ];
+        for( unsigned int dim = 0; dim < NDimensions; dim++ )
+        {
+          imageJacobian[ lIdx + dim ] += glinv * movingImageGradient[ dim ];
+        }
+      }
+      ++sp;
+    }
+  }
+
+  // Affine part of the transform:
+  for( unsigned int odim = 0; odim < NDimensions; odim++ )
+  {
+    const ScalarType    gradient = movingImageGradient[ odim ];
+    const unsigned long index    = ( numberOfLandmarks + NDimensions ) * NDimensions + odim;
+    for( unsigned long lidx = 0; lidx < numberOfColumns; lidx++ )
+    {
+      ScalarType tmp = this->m_LMatrixInverse[ index ][ lidx ];
+      for( unsigned int dim = 0; dim < NDimensions; dim++ )
+      {
+        const unsigned long indtmp = ( numberOfLandmarks + dim ) * NDimensions + odim;
+        tmp += p[ dim ] * this->m_LMatrixInverse[ indtmp ][ lidx ];
+      }
+      imageJacobian[ lidx ] += gradient * tmp;
+    }
+  }
+
+  nonZeroJacobianIndices = this->m_NonZeroJacobianIndices;
+
+} // end EvaluateJacobianWithImageGradientProduct()
+
+
 /**
  * ******************* PrintSelf *******************
  */
@@ -923,6 +1255,8 @@ KernelTransform2< TScalarType, NDimensions >
      << this->m_PoissonRatio << std::endl;
   os << indent << "MatrixInversionMethod: "
      << this->m_MatrixInversionMethod << std::endl;
+  os << indent << "IterativeSolverTolerance: "
+     << this->m_IterativeSolverTolerance << std::endl;
 
   /** Just print the sizes of these matrices, not their contents. */
   os << indent << "LMatrix: " << this->m_LMatrix.rows()
@@ -235,6 +235,27 @@ AdvancedTranslationTransform< TScalarType, NDimensions >
 } // end GetJacobian()
 
 
+/**
+ * ********************* EvaluateJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NDimensions >
+void
+AdvancedTranslationTransform< TScalarType, NDimensions >
+::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & itkNotUsed( p ),
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const
+{
+  for( unsigned int dim = 0; dim < SpaceDimension; ++dim )
+  {
+    imageJacobian[ dim ] = movingImageGradient[ dim ];
+  }
+  nonZeroJacobianIndices = this->m_NonZeroJacobianIndices;
+} // end EvaluateJacobianWithImageGradientProduct()
+
+
 /**
  * ********************* GetSpatialJacobian ****************************
  */
@@ -65,6 +65,10 @@ namespace elastix
  *    example: <tt>(Scales 1.0 1.0 10.0) </tt> \n
  *    Default: 1 for each parameter. See also AutomaticScalesEstimation, which is more convenient.
  *
+ * With <tt>(UseTransformPointCache "true")</tt> the metric caches the
+ * outputs of the subtransforms at its samples, so that each iteration
+ * only combines them with the new weights.
+ *
  * The transform parameters necessary for transformix, additionally defined by this class, are:
  * \transformparameter NormalizeCombinationWeights: use the normalized expression
  * \f$T(x) = \sum_i w_i T_i(x) / \sum_i w_i \f$.\n
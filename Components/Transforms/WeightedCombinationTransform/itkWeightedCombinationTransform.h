@@ -19,6 +19,7 @@
 #define __itkWeightedCombinationTransform_h
 
 #include "itkAdvancedTransform.h"
+#include <unordered_map>
 
 namespace itk
 {
@@ -35,6 +36,12 @@ namespace itk
  * the transformation is as follows:
  * \f[T(x) = \sum_i w_i T_i(x) / \sum_i w_i\f]
  *
+ * The sub-transforms do not depend on the weights, so their outputs may be
+ * cached at a set of points by CachePoints(), such as the fixed image
+ * samples. The evaluations at these points then only combine the cached
+ * \f$T_i(x)\f$. Sub-transforms with zero weight are skipped in
+ * TransformPoint().
+ *
  * \ingroup Transforms
  *
  */
@@ -87,6 +94,8 @@ public:
   typedef typename Superclass::SpatialHessianType SpatialHessianType;
   typedef typename Superclass
     ::JacobianOfSpatialHessianType JacobianOfSpatialHessianType;
+  typedef typename Superclass::DerivativeType          DerivativeType;
+  typedef typename Superclass::MovingImageGradientType MovingImageGradientType;
 
   /** New typedefs in this class: */
   typedef Transform< TScalarType,
@@ -134,6 +143,15 @@ public:
     JacobianType & jac,
     NonZeroJacobianIndicesType & nzji ) const override;
 
+  /** Compute the inner product of the Jacobian with the moving image
+   * gradient, without constructing the Jacobian.
+   */
+  void EvaluateJacobianWithImageGradientProduct(
+    const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient,
+    DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nzji ) const override;
+
   /** Set the parameters. Computes the sum of weights (which is
    * the normalization term). And checks if the number of parameters
    * is correct */
@@ -170,10 +188,28 @@ public:
   virtual void SetTransformContainer( const TransformContainerType & transformContainer )
   {
     this->m_TransformContainer = transformContainer;
+    this->RemovePointCache();
     this->Modified();
   }
 
 
+  /** Cache T_i(x) of all sub-transforms at the given points. The
+   * sub-transforms are assumed constant: the cache is removed by
+   * SetTransformContainer(), but not when a sub-transform itself is
+   * modified. Not thread-safe.
+   */
+  void CachePoints( const InputPointType * points, const SizeValueType n ) override;
+
+  /** Remove the cached sub-transform outputs. */
+  void RemovePointCache( void ) override;
+
+  /** Get the number of points in the cache. */
+  SizeValueType GetNumberOfCachedPoints( void ) const override
+  {
+    return this->m_PointCacheIndices.size();
+  }
+
+
   /** Return the vector of sub-transforms by const reference.
    * So, if you want to add a sub-transform, you should do something
    * like this:
@@ -249,6 +285,46 @@ protected:
   /** Precomputed nonzero Jacobian indices (simply all params) */
   NonZeroJacobianIndicesType m_NonZeroJacobianIndices;
 
+  /** Hash the bit patterns of the coordinates of a point. */
+  struct PointHashType
+  {
+    std::size_t operator()( const InputPointType & point ) const
+    {
+      std::size_t hash = 0;
+      for( unsigned int i = 0; i < NInputDimensions; ++i )
+      {
+        hash = hash * 31 + std::hash< ScalarType >()( point[ i ] );
+      }
+      return hash;
+    }
+
+
+  };
+
+  typedef std::unordered_map< InputPointType, SizeValueType, PointHashType > PointCacheIndicesType;
+
+  /** Return the cached T_i(x) of all sub-transforms at a point, or a null
+   * pointer if the point is not cached.
+   */
+  inline const OutputPointType * FindInPointCache( const InputPointType & point ) const
+  {
+    if( this->m_PointCacheIndices.empty() )
+    {
+      return nullptr;
+    }
+    const typename PointCacheIndicesType::const_iterator it
+      = this->m_PointCacheIndices.find( point );
+    return it != this->m_PointCacheIndices.end()
+      ? &this->m_PointCache[ it->second * this->m_TransformContainer.size() ] : nullptr;
+  }
+
+
+  /** The position of each cached point in m_PointCache, which holds T_i(x)
+   * of all sub-transforms for each cached point.
+   */
+  PointCacheIndicesType          m_PointCacheIndices;
+  std::vector< OutputPointType > m_PointCache;
+
 private:
 
   WeightedCombinationTransform( const Self & ); // purposely not implemented
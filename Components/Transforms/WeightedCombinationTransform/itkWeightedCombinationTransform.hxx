@@ -89,15 +89,20 @@ WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
   OutputPointType opp;
   opp.Fill( 0.0 );
   OutputPointType                tempopp;
-  const TransformContainerType & tc    = this->m_TransformContainer;
-  const unsigned int             N     = tc.size();
-  const ParametersType &         param = this->m_Parameters;
+  const TransformContainerType & tc     = this->m_TransformContainer;
+  const unsigned int             N      = tc.size();
+  const ParametersType &         param  = this->m_Parameters;
+  const OutputPointType *        cached = this->FindInPointCache( ipp );
 
-  /** Calculate sum_i w_i T_i(x) */
+  /** Calculate sum_i w_i T_i(x), skipping the zero weights. */
   for( unsigned int i = 0; i < N; ++i )
   {
-    tempopp = tc[ i ]->TransformPoint( ipp );
     const double w = param[ i ];
+    if( w == 0.0 )
+    {
+      continue;
+    }
+    tempopp = cached ? cached[ i ] : tc[ i ]->TransformPoint( ipp );
     for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
     {
       opp[ d ] += w * tempopp[ d ];
@@ -139,9 +144,10 @@ WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
   NonZeroJacobianIndicesType & nzji ) const
 {
   OutputPointType                tempopp;
-  const TransformContainerType & tc    = this->m_TransformContainer;
-  const unsigned int             N     = tc.size();
-  const ParametersType &         param = this->m_Parameters;
+  const TransformContainerType & tc     = this->m_TransformContainer;
+  const unsigned int             N      = tc.size();
+  const ParametersType &         param  = this->m_Parameters;
+  const OutputPointType *        cached = this->FindInPointCache( ipp );
   jac.SetSize( OutputSpaceDimension, N );
 
   /** This transform has only nonzero jacobians. */
@@ -154,7 +160,7 @@ WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
     opp.Fill( 0.0 );
     for( unsigned int i = 0; i < N; ++i )
     {
-      tempopp = tc[ i ]->TransformPoint( ipp );
+      tempopp = cached ? cached[ i ] : tc[ i ]->TransformPoint( ipp );
       const double w = param[ i ];
       for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
       {
@@ -179,7 +185,7 @@ WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
     /** dT/dmu_i = T_i(x) - x */
     for( unsigned int i = 0; i < N; ++i )
     {
-      tempopp = tc[ i ]->TransformPoint( ipp );
+      tempopp = cached ? cached[ i ] : tc[ i ]->TransformPoint( ipp );
       for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
       {
         jac( d, i ) = tempopp[ d ] - ipp[ d ];
@@ -191,6 +197,121 @@ WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
 } // end GetJacobian()
 
 
+/**
+ * ********************* EvaluateJacobianWithImageGradientProduct ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::EvaluateJacobianWithImageGradientProduct(
+  const InputPointType & ipp,
+  const MovingImageGradientType & movingImageGradient,
+  DerivativeType & imageJacobian,
+  NonZeroJacobianIndicesType & nzji ) const
+{
+  const TransformContainerType & tc     = this->m_TransformContainer;
+  const unsigned int             N      = tc.size();
+  const ParametersType &         param  = this->m_Parameters;
+  const OutputPointType *        cached = this->FindInPointCache( ipp );
+
+  /** This transform has only nonzero jacobians. */
+  nzji = this->m_NonZeroJacobianIndices;
+
+  /** Store g^T T_i(x) for all sub transforms. */
+  for( unsigned int i = 0; i < N; ++i )
+  {
+    const OutputPointType tempopp = cached ? cached[ i ] : tc[ i ]->TransformPoint( ipp );
+    double                product = 0.0;
+    for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
+    {
+      product += movingImageGradient[ d ] * tempopp[ d ];
+    }
+    imageJacobian[ i ] = product;
+  }
+
+  if( this->m_NormalizeWeights )
+  {
+    /** g^T dT/dmu_i = ( g^T T_i(x) - g^T T(x) ) / ( \sum_i w_i ) */
+    double oppProduct = 0.0;
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      oppProduct += param[ i ] * imageJacobian[ i ];
+    }
+    oppProduct /= this->m_SumOfWeights;
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      imageJacobian[ i ] = ( imageJacobian[ i ] - oppProduct ) / this->m_SumOfWeights;
+    }
+  }
+  else
+  {
+    /** g^T dT/dmu_i = g^T T_i(x) - g^T x */
+    double ippProduct = 0.0;
+    for( unsigned int d = 0; d < OutputSpaceDimension; ++d )
+    {
+      ippProduct += movingImageGradient[ d ] * ipp[ d ];
+    }
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      imageJacobian[ i ] -= ippProduct;
+    }
+  }
+
+} // end EvaluateJacobianWithImageGradientProduct()
+
+
+/**
+ * ********************* CachePoints ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::CachePoints( const InputPointType * points, const SizeValueType n )
+{
+  this->RemovePointCache();
+  const TransformContainerType & tc = this->m_TransformContainer;
+  const unsigned int             N  = tc.size();
+  if( N == 0 )
+  {
+    return;
+  }
+
+  this->m_PointCacheIndices.reserve( n );
+  this->m_PointCache.reserve( n * N );
+  for( SizeValueType j = 0; j < n; ++j )
+  {
+    /** Points that occur more than once are stored once. */
+    const SizeValueType index = this->m_PointCacheIndices.size();
+    if( !this->m_PointCacheIndices.insert( std::make_pair( points[ j ], index ) ).second )
+    {
+      continue;
+    }
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      this->m_PointCache.push_back( tc[ i ]->TransformPoint( points[ j ] ) );
+    }
+  }
+
+} // end CachePoints()
+
+
+/**
+ * ********************* RemovePointCache ****************************
+ */
+
+template< class TScalarType, unsigned int NInputDimensions, unsigned int NOutputDimensions >
+void
+WeightedCombinationTransform< TScalarType, NInputDimensions, NOutputDimensions >
+::RemovePointCache( void )
+{
+  PointCacheIndicesType().swap( this->m_PointCacheIndices );
+  std::vector< OutputPointType >().swap( this->m_PointCache );
+
+} // end RemovePointCache()
+
+
 } // end namespace itk
 
 #endif
@@ -36,6 +36,54 @@ namespace elastix
  *
  * This class contains all the common functionality for ImageSamplers.
  *
+ * The parameters used in this class are:
+ * \parameter SortSamplesInMortonOrder: Whether the samples are sorted in
+ *    Morton order (Z-order), so that consecutive samples are close in space.
+ *    This improves the memory locality of the interpolation in the metrics,
+ *    without changing the set of samples. Can be given for each resolution. \n
+ *    example: <tt>(SortSamplesInMortonOrder "true")</tt> \n
+ *    Default: "false".
+ * \parameter UseSampleCache: Whether the full and grid samplers reuse the
+ *    samples of an earlier registration to the same fixed image, mask and
+ *    sampler parameters, in the same process or, with SampleCacheDirectory,
+ *    in an earlier process. Can be given for each resolution. \n
+ *    example: <tt>(UseSampleCache "true")</tt> \n
+ *    Default: "false".
+ * \parameter SampleCacheDirectory: An existing directory where the cached
+ *    samples are stored for later elastix processes. \n
+ *    example: <tt>(SampleCacheDirectory "/tmp/samples")</tt> \n
+ *    Default: "", which keeps the samples in memory only.
+ * \parameter UseImplicitSamples: Whether the full and grid samplers describe
+ *    their samples by rows of voxels, instead of storing the coordinates and
+ *    the value of each sample. The metric then computes them while it loops
+ *    over the samples, which saves memory for large images. Only supported by
+ *    the AdvancedMeanSquares metric; the samples are not sorted in Morton
+ *    order nor cached. Can be given for each resolution. \n
+ *    example: <tt>(UseImplicitSamples "true")</tt> \n
+ *    Default: "false".
+ * \parameter SampleCountSchedule: How the number of samples develops during
+ *    the iterations of a resolution, for samplers that select new samples
+ *    every iteration. Choose one of {Constant, Geometric}. With "Geometric",
+ *    iteration k uses \f$ \min( N, N f g^k ) \f$ samples, with N the number
+ *    of samples that is given to the sampler, such as NumberOfSpatialSamples,
+ *    f the InitialSampleCountFraction and g the SampleCountGrowthFactor. The
+ *    early, noisy iterations of the stochastic optimizers then use fewer
+ *    samples than the ones near convergence. The first iteration, and the
+ *    automatic parameter estimation of the optimizers, use N samples.
+ *    Can be given for each resolution. \n
+ *    example: <tt>(SampleCountSchedule "Geometric")</tt> \n
+ *    Default: "Constant".
+ * \parameter InitialSampleCountFraction: The fraction f of the number of
+ *    samples that the geometric schedule starts with. Can be given for each
+ *    resolution. \n
+ *    example: <tt>(InitialSampleCountFraction 0.1)</tt> \n
+ *    Default: 0.1.
+ * \parameter SampleCountGrowthFactor: The factor g by which the geometric
+ *    schedule increases the number of samples every iteration. Can be given
+ *    for each resolution. \n
+ *    example: <tt>(SampleCountGrowthFactor 1.02)</tt> \n
+ *    Default: 1.02.
+ *
  * \ingroup ImageSamplers
  * \ingroup ComponentBaseClasses
  */
@@ -86,10 +134,21 @@ public:
    */
   void BeforeEachResolutionBase( void ) override;
 
+  /** Execute stuff after each iteration:
+   * \li Set the number of samples of the next iteration, according to the
+   * SampleCountSchedule.
+   */
+  void AfterEachIterationBase( void ) override;
+
+  /** Execute stuff after each resolution:
+   * \li Restore the number of samples that was changed by the schedule.
+   */
+  void AfterEachResolutionBase( void ) override;
+
 protected:
 
   /** The constructor. */
-  ImageSamplerBase() {}
+  ImageSamplerBase();
   /** The destructor. */
   ~ImageSamplerBase() override {}
 
@@ -100,6 +159,16 @@ private:
   /** The private copy constructor. */
   void operator=( const Self & );     // purposely not implemented
 
+  /** The settings of the sample count schedule of the current resolution. */
+  bool   m_UseGeometricSampleCountSchedule;
+  double m_InitialSampleCountFraction;
+  double m_SampleCountGrowthFactor;
+
+  /** The number of samples given to the sampler, or 0 before the schedule
+   * takes over in the current resolution.
+   */
+  unsigned long m_TargetNumberOfSamples;
+
 };
 
 } // end namespace elastix
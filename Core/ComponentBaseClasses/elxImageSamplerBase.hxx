@@ -21,9 +21,28 @@
 
 #include "elxImageSamplerBase.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace elastix
 {
 
+/**
+ * ******************* Constructor ******************
+ */
+
+template< class TElastix >
+ImageSamplerBase< TElastix >
+::ImageSamplerBase()
+{
+  this->m_UseGeometricSampleCountSchedule = false;
+  this->m_InitialSampleCountFraction      = 0.1;
+  this->m_SampleCountGrowthFactor         = 1.02;
+  this->m_TargetNumberOfSamples           = 0;
+
+} // end Constructor
+
+
 /**
  * ******************* BeforeEachResolutionBase ******************
  */
@@ -56,6 +75,72 @@ ImageSamplerBase< TElastix >
     }
   }
 
+  /** Read the sample count schedule. It only applies to samplers that
+   * select new samples every iteration.
+   */
+  std::string sampleCountSchedule = "Constant";
+  this->m_Configuration->ReadParameter( sampleCountSchedule,
+    "SampleCountSchedule", "", level, 0, true );
+  this->m_UseGeometricSampleCountSchedule = false;
+  this->m_TargetNumberOfSamples           = 0;
+  if( sampleCountSchedule == "Geometric" )
+  {
+    if( newSamples && this->GetAsITKBaseType()->SelectingNewSamplesOnUpdateSupported() )
+    {
+      this->m_UseGeometricSampleCountSchedule = true;
+    }
+    else
+    {
+      xl::xout[ "warning" ]
+        << "WARNING: The SampleCountSchedule \"Geometric\" is ignored,\n"
+        << "because the ImageSampler does not select new samples every iteration."
+        << std::endl;
+    }
+  }
+  else if( sampleCountSchedule != "Constant" )
+  {
+    itkExceptionMacro( << "ERROR: The SampleCountSchedule \"" << sampleCountSchedule
+                       << "\" is not supported. Choose one of {Constant, Geometric}." );
+  }
+
+  this->m_InitialSampleCountFraction = 0.1;
+  this->m_Configuration->ReadParameter( this->m_InitialSampleCountFraction,
+    "InitialSampleCountFraction", "", level, 0, true );
+  this->m_SampleCountGrowthFactor = 1.02;
+  this->m_Configuration->ReadParameter( this->m_SampleCountGrowthFactor,
+    "SampleCountGrowthFactor", "", level, 0, true );
+  if( this->m_UseGeometricSampleCountSchedule
+    && ( this->m_InitialSampleCountFraction <= 0.0 || this->m_SampleCountGrowthFactor < 1.0 ) )
+  {
+    itkExceptionMacro( << "ERROR: The InitialSampleCountFraction should be larger than 0, "
+                       << "and the SampleCountGrowthFactor should be at least 1." );
+  }
+
+  /** Sort the samples in Morton order or not. */
+  bool sortInMortonOrder = false;
+  this->m_Configuration->ReadParameter( sortInMortonOrder,
+    "SortSamplesInMortonOrder", "", level, 0, true );
+  this->GetAsITKBaseType()->SetUseMortonOrder( sortInMortonOrder );
+
+  /** Reuse the samples of earlier registrations or not. */
+  bool useSampleCache = false;
+  this->m_Configuration->ReadParameter( useSampleCache,
+    "UseSampleCache", "", level, 0, true );
+  this->GetAsITKBaseType()->SetUseSampleCache( useSampleCache );
+  if( useSampleCache )
+  {
+    std::string sampleCacheDirectory = "";
+    this->m_Configuration->ReadParameter( sampleCacheDirectory,
+      "SampleCacheDirectory", "", 0, 0, true );
+    itk::ImageSampleCache< InputImageType >::GetInstance()->SetDirectory( sampleCacheDirectory );
+  }
+
+  /** Describe the samples implicitly or not. */
+  bool useImplicitSamples = false;
+  this->m_Configuration->ReadParameter( useImplicitSamples,
+    "UseImplicitSamples", "", level, 0, true );
+  this->GetAsITKBaseType()->SetUseImplicitOutput( useImplicitSamples );
+
   /** Temporary?: Use the multi-threaded version or not. */
   std::string useMultiThread = this->m_Configuration->GetCommandLineArgument( "-mts" ); // mts: multi-threaded samplers
   if( useMultiThread == "true" )
@@ -67,6 +152,62 @@ ImageSamplerBase< TElastix >
 } // end BeforeEachResolutionBase()
 
 
+/**
+ * ******************* AfterEachIterationBase ******************
+ */
+
+template< class TElastix >
+void
+ImageSamplerBase< TElastix >
+::AfterEachIterationBase( void )
+{
+  if( !this->m_UseGeometricSampleCountSchedule )
+  {
+    return;
+  }
+
+  /** The number of samples is set by the sampler in BeforeEachResolution(),
+   * after BeforeEachResolutionBase(), so it is only known here.
+   */
+  ITKBaseType * sampler = this->GetAsITKBaseType();
+  if( this->m_TargetNumberOfSamples == 0 )
+  {
+    this->m_TargetNumberOfSamples = sampler->GetNumberOfSamples();
+  }
+
+  /** The iteration counter is still the one of the finished iteration. */
+  const double nextIteration = this->m_Elastix->GetIterationCounter() + 1.0;
+  const double fraction      = std::min( 1.0, this->m_InitialSampleCountFraction
+    * std::pow( this->m_SampleCountGrowthFactor, nextIteration ) );
+  const unsigned long numberOfSamples = std::max( 1ul, static_cast< unsigned long >(
+    std::ceil( fraction * this->m_TargetNumberOfSamples ) ) );
+
+  if( numberOfSamples != sampler->GetNumberOfSamples() )
+  {
+    sampler->SetNumberOfSamples( numberOfSamples );
+  }
+
+} // end AfterEachIterationBase()
+
+
+/**
+ * ******************* AfterEachResolutionBase ******************
+ */
+
+template< class TElastix >
+void
+ImageSamplerBase< TElastix >
+::AfterEachResolutionBase( void )
+{
+  if( this->m_TargetNumberOfSamples != 0 )
+  {
+    this->GetAsITKBaseType()->SetNumberOfSamples( this->m_TargetNumberOfSamples );
+    this->m_TargetNumberOfSamples = 0;
+  }
+
+} // end AfterEachResolutionBase()
+
+
 } // end namespace elastix
 
 #endif //#ifndef __elxImageSamplerBase_hxx
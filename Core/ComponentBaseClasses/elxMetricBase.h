@@ -25,6 +25,7 @@
 #include "itkAdvancedImageToImageMetric.h"
 #include "itkImageGridSampler.h"
 #include "itkPointSet.h"
+#include "itkProfiler.h"
 
 namespace elastix
 {
@@ -63,6 +64,45 @@ namespace elastix
  *    CheckNumberOfSamples. \n
  *    example: <tt>(RequiredRatioOfValidSamples 0.1)</tt> \n
  *    The default is 0.25.
+ * \parameter UseInitialTransformCache: Whether the metric evaluates the initial
+ *    transform, with which the current transform is composed, only once at the
+ *    samples instead of every iteration. This pays off for a non-linear initial
+ *    transform and samples that are reused over the iterations, such as those of
+ *    the Full and Grid samplers, or NewSamplesEveryIteration "false". Can be given
+ *    for each resolution. \n
+ *    example: <tt>(UseInitialTransformCache "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseTransformPointCache: Whether the metric lets the current
+ *    transform cache its work at the samples, if it supports this, once for
+ *    each new sample set. The WeightedCombinationTransform caches the outputs
+ *    of its fixed sub-transforms. Can be given for each resolution. \n
+ *    example: <tt>(UseTransformPointCache "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseFusedKernels: Whether the metric evaluates an Euler, affine or
+ *    cubic B-spline transform without initial transform, and a linear or B-spline
+ *    interpolator, by non-virtual calls that are inlined in the loops over the
+ *    samples. Other transforms and interpolators take the generic path. Can be
+ *    given for each resolution. \n
+ *    example: <tt>(UseFusedKernels "true")</tt> \n
+ *    The default is "false".
+ * \parameter UseDeterministicReduction: Whether the multi-threaded metric splits
+ *    the samples in a fixed number of chunks and sums their results in a fixed
+ *    order, so that the value and derivative are bit-identical for any number
+ *    of threads. Can be given for each resolution. \n
+ *    example: <tt>(UseDeterministicReduction "true")</tt> \n
+ *    The default is "false".
+ * \parameter DeterministicReductionNumberOfChunks: The number of chunks of the
+ *    deterministic reduction. Runs are only identical with the same number of
+ *    chunks. Can be given for each resolution. \n
+ *    example: <tt>(DeterministicReductionNumberOfChunks 64)</tt> \n
+ *    The default is 64.
+ * \parameter NumberOfThreads: The number of threads of the multi-threaded metric,
+ *    or "auto" to select it in each resolution from the number of samples and
+ *    parameters, and by timing the first iterations for a few candidates, up to
+ *    the number of threads of the -threads command line argument. The selected
+ *    number is reported after each resolution. Can be given for each resolution. \n
+ *    example: <tt>(NumberOfThreads "auto" "auto" 16)</tt> \n
+ *    The default is the number of threads of the -threads command line argument.
  *
  * \ingroup Metrics
  * \ingroup ComponentBaseClasses
@@ -155,6 +195,11 @@ public:
    */
   void AfterEachIterationBase( void ) override;
 
+  /** Execute stuff after each resolution:
+   * \li Report the number of threads selected with (NumberOfThreads "auto").
+   */
+  void AfterEachResolutionBase( void ) override;
+
   /** Force the metric to base its computation on a new subset of image samples.
    * Not every metric may have implemented this.
    */
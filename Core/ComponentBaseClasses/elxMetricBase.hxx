@@ -164,6 +164,24 @@ MetricBase< TElastix >
       thisAsAdvanced->SetScaleGradientWithRespectToMovingImageOrientation( wrtMoving );
     }
 
+    /** Should the metric cache the initial transform at the samples? */
+    bool useInitialTransformCache = false;
+    this->GetConfiguration()->ReadParameter( useInitialTransformCache,
+      "UseInitialTransformCache", this->GetComponentLabel(), level, 0, false );
+    thisAsAdvanced->SetUseInitialTransformCache( useInitialTransformCache );
+
+    /** Should the current transform cache its work at the samples? */
+    bool useTransformPointCache = false;
+    this->GetConfiguration()->ReadParameter( useTransformPointCache,
+      "UseTransformPointCache", this->GetComponentLabel(), level, 0, false );
+    thisAsAdvanced->SetUseTransformPointCache( useTransformPointCache );
+
+    /** Should the metric use the fused kernels for the hot configurations? */
+    bool useFusedKernels = false;
+    this->GetConfiguration()->ReadParameter( useFusedKernels,
+      "UseFusedKernels", this->GetComponentLabel(), level, 0, false );
+    thisAsAdvanced->SetUseFusedKernels( useFusedKernels );
+
     /** Should the metric use multi-threading? */
     bool useMultiThreading = true;
     this->GetConfiguration()->ReadParameter( useMultiThreading,
@@ -178,8 +196,33 @@ MetricBase< TElastix >
         const unsigned int nrOfThreads = atoi( tmp.c_str() );
         thisAsAdvanced->SetNumberOfWorkUnits( nrOfThreads );
       }
+
+      /** The number of threads per resolution, or automatic. */
+      std::string numberOfThreads = "";
+      this->GetConfiguration()->ReadParameter( numberOfThreads,
+        "NumberOfThreads", this->GetComponentLabel(), level, 0, false );
+      thisAsAdvanced->SetAutomaticNumberOfWorkUnits( numberOfThreads == "auto" );
+      if( !numberOfThreads.empty() && numberOfThreads != "auto" )
+      {
+        const int nrOfThreads = atoi( numberOfThreads.c_str() );
+        if( nrOfThreads > 0 )
+        {
+          thisAsAdvanced->SetNumberOfWorkUnits( nrOfThreads );
+        }
+      }
     }
 
+    /** Should the metric reduce the results of the threads deterministically? */
+    bool useDeterministicReduction = false;
+    this->GetConfiguration()->ReadParameter( useDeterministicReduction,
+      "UseDeterministicReduction", this->GetComponentLabel(), level, 0, false );
+    thisAsAdvanced->SetUseDeterministicReduction( useDeterministicReduction );
+
+    unsigned int numberOfChunks = 64;
+    this->GetConfiguration()->ReadParameter( numberOfChunks,
+      "DeterministicReductionNumberOfChunks", this->GetComponentLabel(), level, 0, false );
+    thisAsAdvanced->SetDeterministicReductionNumberOfChunks( numberOfChunks );
+
   } // end advanced metric
 
 } // end BeforeEachResolutionBase()
@@ -204,6 +247,7 @@ MetricBase< TElastix >
   if( this->m_ShowExactMetricValue
     && ( this->m_Elastix->GetIterationCounter() % this->m_ExactMetricEachXNumberOfIterations == 0 ) )
   {
+    itk::Profiler::ScopedTimer timer( itk::Profiler::ExactMetricValue );
     this->m_CurrentExactMetricValue = this->GetExactValue(
       this->GetElastix()->GetElxOptimizerBase()
       ->GetAsITKBaseType()->GetCurrentPosition() );
@@ -215,6 +259,38 @@ MetricBase< TElastix >
 } // end AfterEachIterationBase()
 
 
+/**
+ * ******************* AfterEachResolutionBase ******************
+ */
+
+template< class TElastix >
+void
+MetricBase< TElastix >
+::AfterEachResolutionBase( void )
+{
+  const AdvancedMetricType * thisAsAdvanced
+    = dynamic_cast< const AdvancedMetricType * >( this );
+  if( thisAsAdvanced == nullptr || !thisAsAdvanced->GetAutomaticNumberOfWorkUnits()
+    || thisAsAdvanced->GetWorkUnitsCalibration().empty() )
+  {
+    return;
+  }
+
+  /** Report the timed candidates and the selected number of threads. */
+  elxout << "Seconds per iteration of the metric for the number of threads:";
+  for( const auto & candidate : thisAsAdvanced->GetWorkUnitsCalibration() )
+  {
+    if( candidate.second < itk::NumericTraits< double >::max() )
+    {
+      elxout << " " << candidate.first << ": " << candidate.second;
+    }
+  }
+  elxout << "\nSelected number of threads of the metric: "
+         << thisAsAdvanced->GetNumberOfWorkUnits() << std::endl;
+
+} // end AfterEachResolutionBase()
+
+
 /**
  * ********************* SelectNewSamples ************************
  */
@@ -25,6 +25,9 @@
 #include "elxBaseComponentSE.h"
 #include "itkOptimizer.h"
 
+#include <deque>
+#include <string>
+
 namespace elastix
 {
 
@@ -44,6 +47,26 @@ namespace elastix
  *    Choose one from {"true", "false"} for every resolution.\n
  *    example: <tt>(NewSamplesEveryIteration "true" "true" "true")</tt> \n
  *    Default is "false" for every resolution.\n
+ * \parameter ConvergenceWindowSize: the number of iterations over which the
+ *    convergence criteria below are evaluated. No criterion is tested before the
+ *    window is filled, so this is also the minimum number of iterations.\n
+ *    example: <tt>(ConvergenceWindowSize 20 20 10)</tt> \n
+ *    Default value: 10, for every resolution. The minimum is 2.\n
+ * \parameter ConvergenceRelativeMetricChange: stop when the mean metric value of the
+ *    newer half of the window differs less than this fraction from the mean of the older
+ *    half, relative to the mean of the whole window. Averaging over the halves makes the
+ *    criterion robust to the noise of the stochastic optimizers.\n
+ *    example: <tt>(ConvergenceRelativeMetricChange 1e-4 1e-4 1e-5)</tt> \n
+ *    Default value: 0, which disables the criterion, for every resolution.\n
+ * \parameter ConvergenceGradientMagnitude: stop when the mean magnitude of the gradient
+ *    over the window is smaller than this value. Ignored by the optimizers that do not
+ *    compute a gradient.\n
+ *    example: <tt>(ConvergenceGradientMagnitude 1e-6 1e-6 1e-6)</tt> \n
+ *    Default value: 0, which disables the criterion, for every resolution.\n
+ * \parameter ConvergenceParameterChange: stop when the mean Euclidean norm of the change
+ *    of the transform parameters per iteration, over the window, is smaller than this value.\n
+ *    example: <tt>(ConvergenceParameterChange 1e-3 1e-3 1e-4)</tt> \n
+ *    Default value: 0, which disables the criterion, for every resolution.\n
  *
  * \ingroup Optimizers
  * \ingroup ComponentBaseClasses
@@ -75,6 +98,9 @@ public:
   /** Typedef needed for the SetCurrentPositionPublic function. */
   typedef typename ITKBaseType::ParametersType ParametersType;
 
+  /** Typedef for the transform parameter map. */
+  typedef typename ElastixType::ParameterMapType ParameterMapType;
+
   /** Cast to ITKBaseType. */
   virtual ITKBaseType * GetAsITKBaseType( void )
   {
@@ -94,6 +120,7 @@ public:
 
   /** Execute stuff before each new pyramid resolution:
    * \li Find out if new samples are used every new iteration in this resolution.
+   * \li Read and reset the convergence criteria.
    */
   void BeforeEachResolutionBase() override;
 
@@ -108,6 +135,20 @@ public:
   virtual void SetSinusScales( double amplitude, double frequency,
     unsigned long numberOfParameters );
 
+  /** Check whether one of the convergence criteria was met in this resolution. */
+  virtual bool GetConvergenceCriterionMet( void ) const;
+
+  /** Get a description of the convergence criterion that was met, for the
+   * stopping condition that is printed after each resolution.
+   */
+  virtual const std::string & GetConvergenceStopConditionDescription( void ) const;
+
+  /** Add the settings of the optimizer of which the next registration of a
+   * sequence may start, to the transform parameter map that the library
+   * returns. By default nothing is added.
+   */
+  virtual void CreateTransformParametersMap( ParameterMapType * ) const {}
+
 protected:
 
   /** The constructor. */
@@ -123,6 +164,26 @@ protected:
   /** Check whether the user asked to select new samples every iteration. */
   virtual bool GetNewSamplesEveryIteration( void ) const;
 
+  /** Add the current iteration to the window of the convergence criteria and
+   * return true if one of them is met, in which case the optimizer should stop.
+   * The optimizers call this function after each iteration, and after each
+   * main iteration if they do line searches. A NaN value or gradient magnitude,
+   * for example of a metric value that was not computed, is not added to the
+   * window. Returns false immediately if no criterion is enabled.
+   */
+  virtual bool TestConvergenceCriteria( const double value,
+    const double gradientMagnitude );
+
+  /** The same, for the optimizers that do not compute a gradient. */
+  bool TestConvergenceCriteria( const double value );
+
+  /** Return the stopping condition that is printed after each resolution: the
+   * description of the convergence criterion that was met, which overrules
+   * the given stopping condition of the optimizer, or else the given one.
+   */
+  std::string GetStopConditionDescriptionWithConvergence(
+    const std::string & stopcondition ) const;
+
 private:
 
   /** The private constructor. */
@@ -135,6 +196,20 @@ private:
    */
   bool m_NewSamplesEveryIteration;
 
+  /** The settings of the convergence criteria; a threshold of zero disables a criterion. */
+  unsigned int m_ConvergenceWindowSize;
+  double       m_ConvergenceRelativeMetricChange;
+  double       m_ConvergenceGradientMagnitude;
+  double       m_ConvergenceParameterChange;
+
+  /** The windows of the last iterations, and the position of the previous one. */
+  std::deque< double > m_ConvergenceMetricValues;
+  std::deque< double > m_ConvergenceGradientMagnitudes;
+  std::deque< double > m_ConvergenceParameterChanges;
+  ParametersType       m_ConvergencePreviousPosition;
+
+  std::string m_ConvergenceStopConditionDescription;
+
 };
 
 } // end namespace elastix
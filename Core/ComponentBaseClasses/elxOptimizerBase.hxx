@@ -21,8 +21,14 @@
 #include "elxOptimizerBase.h"
 
 #include "itkSingleValuedNonLinearOptimizer.h"
+#include "itkParallelVectorOperations.h"
 #include "itk_zlib.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
 namespace elastix
 {
 
@@ -36,6 +42,11 @@ OptimizerBase< TElastix >
 {
   this->m_NewSamplesEveryIteration = false;
 
+  this->m_ConvergenceWindowSize           = 10;
+  this->m_ConvergenceRelativeMetricChange = 0.0;
+  this->m_ConvergenceGradientMagnitude    = 0.0;
+  this->m_ConvergenceParameterChange      = 0.0;
+
 } // end Constructor
 
 
@@ -79,6 +90,31 @@ OptimizerBase< TElastix >
   this->GetConfiguration()->ReadParameter( this->m_NewSamplesEveryIteration,
     "NewSamplesEveryIteration", this->GetComponentLabel(), level, 0 );
 
+  /** Read the convergence criteria, which are disabled by default. */
+  this->m_ConvergenceWindowSize = 10;
+  this->GetConfiguration()->ReadParameter( this->m_ConvergenceWindowSize,
+    "ConvergenceWindowSize", this->GetComponentLabel(), level, 0 );
+  this->m_ConvergenceWindowSize = std::max( this->m_ConvergenceWindowSize, 2u );
+
+  this->m_ConvergenceRelativeMetricChange = 0.0;
+  this->GetConfiguration()->ReadParameter( this->m_ConvergenceRelativeMetricChange,
+    "ConvergenceRelativeMetricChange", this->GetComponentLabel(), level, 0 );
+
+  this->m_ConvergenceGradientMagnitude = 0.0;
+  this->GetConfiguration()->ReadParameter( this->m_ConvergenceGradientMagnitude,
+    "ConvergenceGradientMagnitude", this->GetComponentLabel(), level, 0 );
+
+  this->m_ConvergenceParameterChange = 0.0;
+  this->GetConfiguration()->ReadParameter( this->m_ConvergenceParameterChange,
+    "ConvergenceParameterChange", this->GetComponentLabel(), level, 0 );
+
+  /** Start with empty windows. */
+  this->m_ConvergenceMetricValues.clear();
+  this->m_ConvergenceGradientMagnitudes.clear();
+  this->m_ConvergenceParameterChanges.clear();
+  this->m_ConvergencePreviousPosition.SetSize( 0 );
+  this->m_ConvergenceStopConditionDescription.clear();
+
 } // end BeforeEachResolutionBase()
 
 
@@ -151,6 +187,207 @@ OptimizerBase< TElastix >
 } // end GetNewSamplesEveryIteration()
 
 
+/**
+ * ****************** TestConvergenceCriteria ********************
+ */
+
+template< class TElastix >
+bool
+OptimizerBase< TElastix >
+::TestConvergenceCriteria( const double value, const double gradientMagnitude )
+{
+  const bool useMetric    = this->m_ConvergenceRelativeMetricChange > 0.0;
+  const bool useGradient  = this->m_ConvergenceGradientMagnitude > 0.0;
+  const bool useParameter = this->m_ConvergenceParameterChange > 0.0;
+  if( !useMetric && !useGradient && !useParameter )
+  {
+    return false;
+  }
+  if( this->GetConvergenceCriterionMet() )
+  {
+    return true;
+  }
+
+  const std::size_t windowSize = this->m_ConvergenceWindowSize;
+
+  /** Add the current iteration to the windows. */
+  if( useMetric && !std::isnan( value ) )
+  {
+    this->m_ConvergenceMetricValues.push_back( value );
+    if( this->m_ConvergenceMetricValues.size() > windowSize )
+    {
+      this->m_ConvergenceMetricValues.pop_front();
+    }
+  }
+  if( useGradient && !std::isnan( gradientMagnitude ) )
+  {
+    this->m_ConvergenceGradientMagnitudes.push_back( gradientMagnitude );
+    if( this->m_ConvergenceGradientMagnitudes.size() > windowSize )
+    {
+      this->m_ConvergenceGradientMagnitudes.pop_front();
+    }
+  }
+  if( useParameter )
+  {
+    const ParametersType & position = this->GetAsITKBaseType()->GetCurrentPosition();
+    const itk::SizeValueType numberOfParameters = position.GetSize();
+    if( this->m_ConvergencePreviousPosition.GetSize() == numberOfParameters )
+    {
+      /** Compute the change and store the current position in one pass. */
+      const double * current  = position.data_block();
+      double *       previous = this->m_ConvergencePreviousPosition.data_block();
+      const double   squaredChange = itk::ParallelVectorOperations::ParallelizeReduction(
+        numberOfParameters, [current, previous]( const itk::SizeValueType begin, const itk::SizeValueType end )
+        {
+          double sum = 0.0;
+          for( itk::SizeValueType j = begin; j < end; ++j )
+          {
+            const double difference = current[ j ] - previous[ j ];
+            sum          += difference * difference;
+            previous[ j ] = current[ j ];
+          }
+          return sum;
+        } );
+
+      this->m_ConvergenceParameterChanges.push_back( std::sqrt( squaredChange ) );
+      if( this->m_ConvergenceParameterChanges.size() > windowSize )
+      {
+        this->m_ConvergenceParameterChanges.pop_front();
+      }
+    }
+    else
+    {
+      this->m_ConvergencePreviousPosition = position;
+    }
+  }
+
+  /** Test the criteria of which the window is filled. */
+  std::ostringstream description;
+  if( useMetric && this->m_ConvergenceMetricValues.size() == windowSize )
+  {
+    /** Compare the means of the older and the newer half of the window. */
+    const std::size_t olderSize = windowSize / 2;
+    double            olderSum  = 0.0;
+    double            newerSum  = 0.0;
+    for( std::size_t i = 0; i < windowSize; ++i )
+    {
+      ( i < olderSize ? olderSum : newerSum ) += this->m_ConvergenceMetricValues[ i ];
+    }
+    const double olderMean = olderSum / static_cast< double >( olderSize );
+    const double newerMean = newerSum / static_cast< double >( windowSize - olderSize );
+    const double mean      = ( olderSum + newerSum ) / static_cast< double >( windowSize );
+    const double relativeChange = std::abs( newerMean - olderMean )
+      / std::max( std::abs( mean ), std::numeric_limits< double >::min() );
+
+    if( relativeChange < this->m_ConvergenceRelativeMetricChange )
+    {
+      description << "The relative change of the metric value over " << windowSize
+                  << " iterations (" << relativeChange << ") is smaller than "
+                  << this->m_ConvergenceRelativeMetricChange;
+    }
+  }
+  if( description.str().empty() && useGradient
+    && this->m_ConvergenceGradientMagnitudes.size() == windowSize )
+  {
+    double sum = 0.0;
+    for( const double magnitude : this->m_ConvergenceGradientMagnitudes )
+    {
+      sum += magnitude;
+    }
+    const double meanMagnitude = sum / static_cast< double >( windowSize );
+
+    if( meanMagnitude < this->m_ConvergenceGradientMagnitude )
+    {
+      description << "The mean gradient magnitude over " << windowSize
+                  << " iterations (" << meanMagnitude << ") is smaller than "
+                  << this->m_ConvergenceGradientMagnitude;
+    }
+  }
+  if( description.str().empty() && useParameter
+    && this->m_ConvergenceParameterChanges.size() == windowSize )
+  {
+    double sum = 0.0;
+    for( const double change : this->m_ConvergenceParameterChanges )
+    {
+      sum += change;
+    }
+    const double meanChange = sum / static_cast< double >( windowSize );
+
+    if( meanChange < this->m_ConvergenceParameterChange )
+    {
+      description << "The mean change of the parameters over " << windowSize
+                  << " iterations (" << meanChange << ") is smaller than "
+                  << this->m_ConvergenceParameterChange;
+    }
+  }
+
+  this->m_ConvergenceStopConditionDescription = description.str();
+  return this->GetConvergenceCriterionMet();
+
+} // end TestConvergenceCriteria()
+
+
+/**
+ * ****************** TestConvergenceCriteria ********************
+ */
+
+template< class TElastix >
+bool
+OptimizerBase< TElastix >
+::TestConvergenceCriteria( const double value )
+{
+  return this->TestConvergenceCriteria( value,
+    std::numeric_limits< double >::quiet_NaN() );
+
+} // end TestConvergenceCriteria()
+
+
+/**
+ * ****************** GetConvergenceCriterionMet ********************
+ */
+
+template< class TElastix >
+bool
+OptimizerBase< TElastix >
+::GetConvergenceCriterionMet( void ) const
+{
+  return !this->m_ConvergenceStopConditionDescription.empty();
+
+} // end GetConvergenceCriterionMet()
+
+
+/**
+ * ****************** GetConvergenceStopConditionDescription ********************
+ */
+
+template< class TElastix >
+const std::string &
+OptimizerBase< TElastix >
+::GetConvergenceStopConditionDescription( void ) const
+{
+  return this->m_ConvergenceStopConditionDescription;
+
+} // end GetConvergenceStopConditionDescription()
+
+
+/**
+ * ****************** GetStopConditionDescriptionWithConvergence ********************
+ */
+
+template< class TElastix >
+std::string
+OptimizerBase< TElastix >
+::GetStopConditionDescriptionWithConvergence( const std::string & stopcondition ) const
+{
+  if( this->GetConvergenceCriterionMet() )
+  {
+    return this->GetConvergenceStopConditionDescription();
+  }
+  return stopcondition;
+
+} // end GetStopConditionDescriptionWithConvergence()
+
+
 /**
  * ****************** SetSinusScales ********************
  */
@@ -66,6 +66,47 @@ namespace elastix
  *    from one resolution level to another. Choose from {"true", "false"} \n
  *    example: <tt>(ErodeMovingMask2 "true" "false")</tt>
  *    This setting overrules ErodeMask and ErodeMovingMask.\n
+ * \parameter CropFixedImageToMask: a flag to crop the fixed image, and thereby the fixed
+ *    pyramid and the sampler region, to the bounding box of the fixed mask. The physical
+ *    coordinates of the voxels do not change.\n
+ *    example: <tt>(CropFixedImageToMask "true")</tt>\n
+ *    Default: "false".
+ * \parameter CropFixedImageMargin: the number of voxels by which the bounding box of the
+ *    fixed mask is dilated, which should cover the smoothing of the pyramid.\n
+ *    example: <tt>(CropFixedImageMargin 32)</tt>\n
+ *    Default: 16.
+ * \parameter CropMovingImage: a flag to crop the moving image to the bounding box of the
+ *    cropped fixed image, mapped by the initial transform. Only used with CropFixedImageToMask.\n
+ *    example: <tt>(CropMovingImage "true")</tt>\n
+ *    Default: "false".
+ * \parameter CropMovingImageMargin: the margin in mm by which this bounding box is dilated,
+ *    which should cover the displacements found by the registration.\n
+ *    example: <tt>(CropMovingImageMargin 50.0)</tt>\n
+ *    Default: 20.0.
+ * \parameter MultiStartRotationAngles: the rotations in radians of the initial transform that
+ *    are tried in the first resolution, about the center of rotation. In 3D all combinations
+ *    of these angles about the x, y and z axis are tried. Requires a rigid, similarity or
+ *    affine transform in 2D or 3D.\n
+ *    example: <tt>(MultiStartRotationAngles -0.5 0.0 0.5)</tt>\n
+ *    Default: none, which only tries the initial rotation, if MultiStartTranslations is given.
+ * \parameter MultiStartTranslations: the translations in mm of the initial transform that are
+ *    tried in the first resolution, in all combinations along each axis, and combined with the
+ *    rotations. The cost function is evaluated at all candidates at once, on the same samples,
+ *    and the registration starts from the best one.\n
+ *    example: <tt>(MultiStartTranslations -20.0 0.0 20.0)</tt>\n
+ *    Default: none, which only tries the initial translation, if MultiStartRotationAngles is given.
+ * \parameter MultiStartNumberOfOptimizations: the number of the best candidates that are
+ *    optimized in the first resolution, after which the optimization continues from the best
+ *    result. With 1 the first resolution starts from the best candidate.\n
+ *    example: <tt>(MultiStartNumberOfOptimizations 3)</tt>\n
+ *    Default: 1.
+ * \parameter WarmStartTransformParameters: the transform parameters from which the first
+ *    resolution starts, for example the result of the previous frame of a sequence, see
+ *    ELASTIX::RegisterImageSequence(). When multi-start candidates are given, they compete
+ *    with this one. Ignored when the number of values differs from the number of parameters
+ *    of the transform in the first resolution.\n
+ *    example: <tt>(WarmStartTransformParameters 0.01 -0.02 0.0 1.5 -3.2 0.4)</tt>\n
+ *    Default: none, which starts from the initial transform parameters.
  *
  * \ingroup Registrations
  * \ingroup ComponentBaseClasses
@@ -210,6 +251,36 @@ protected:
     const MovingMaskImageType * maskImage, bool useMaskErosion,
     const MovingImagePyramidType * pyramid, unsigned int level ) const;
 
+  /** Crop the fixed image to the dilated bounding box of the fixed mask, and
+   * the moving image to the region that the cropped fixed image reaches under
+   * the initial transform, if requested by CropFixedImageToMask and
+   * CropMovingImage. The images are replaced by the cropped images, which
+   * keep the physical coordinates of their voxels.
+   *
+   * This function is used by the registration components
+   */
+  void CropImagesToFixedMask(
+    typename FixedImageType::ConstPointer & fixedImage,
+    typename MovingImageType::ConstPointer & movingImage ) const;
+
+  /** Set the candidates for the initial transform parameters in the first
+   * resolution, see MultiStartRotationAngles, MultiStartTranslations and
+   * WarmStartTransformParameters.
+   */
+  void BeforeEachResolutionBase( void ) override;
+
+protected:
+
+  /** Compute the candidates for the initial transform parameters, from the
+   * MultiStartRotationAngles and MultiStartTranslations.
+   */
+  virtual void SetMultiStartCandidates( void );
+
+  /** Add the WarmStartTransformParameters to the candidates for the initial
+   * transform parameters.
+   */
+  virtual void AddWarmStartCandidate( void );
+
 private:
 
   /** The private constructor. */
@@ -20,6 +20,15 @@
 
 #include "elxRegistrationBase.h"
 
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkAdvancedCombinationTransform.h"
+#include "itkAdvancedMatrixOffsetTransformBase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace elastix
 {
 
@@ -126,6 +135,9 @@ RegistrationBase< TElastix >
   erosion->SetIsMovingMask( false );
   erosion->SetResolutionLevel( level );
 
+  /** Share the eroded masks with other registrations of the same mask. */
+  erosion->SetUseCache( true );
+
   /** Set output of the erosion to fixedImageMaskAsImage. */
   FixedMaskImagePointer erodedFixedMaskAsImage = erosion->GetOutput();
 
@@ -188,6 +200,9 @@ RegistrationBase< TElastix >
   erosion->SetIsMovingMask( true );
   erosion->SetResolutionLevel( level );
 
+  /** Share the eroded masks with other registrations of the same mask. */
+  erosion->SetUseCache( true );
+
   /** Set output of the erosion to movingImageMaskAsImage. */
   MovingMaskImagePointer erodedMovingMaskAsImage = erosion->GetOutput();
 
@@ -217,6 +232,394 @@ RegistrationBase< TElastix >
 } // end GenerateMovingMaskSpatialObject()
 
 
+/**
+ * ******************* CropImagesToFixedMask **********************
+ */
+
+template< class TElastix >
+void
+RegistrationBase< TElastix >
+::CropImagesToFixedMask(
+  typename FixedImageType::ConstPointer & fixedImage,
+  typename MovingImageType::ConstPointer & movingImage ) const
+{
+  const FixedMaskImageType * fixedMask = this->GetElastix()->GetFixedMask();
+  bool cropFixedImageToMask = false;
+  this->GetConfiguration()->ReadParameter( cropFixedImageToMask, "CropFixedImageToMask", 0 );
+  if( !cropFixedImageToMask || fixedMask == nullptr )
+  {
+    return;
+  }
+  unsigned int fixedMargin = 16;
+  this->GetConfiguration()->ReadParameter( fixedMargin, "CropFixedImageMargin", 0 );
+
+  typedef typename FixedImageType::IndexType                   FixedIndexType;
+  typedef typename FixedImageType::PointType                   FixedPointType;
+  typedef typename FixedImageType::RegionType                  FixedRegionType;
+  typedef typename MovingImageType::RegionType                 MovingRegionType;
+  typedef itk::ContinuousIndex< double, FixedImageDimension >  FixedContinuousIndexType;
+  typedef itk::ContinuousIndex< double, MovingImageDimension > MovingContinuousIndexType;
+
+  /** Find the bounding box of the voxels inside the mask. */
+  FixedIndexType minIndex;
+  FixedIndexType maxIndex;
+  minIndex.Fill( itk::NumericTraits< itk::IndexValueType >::max() );
+  maxIndex.Fill( itk::NumericTraits< itk::IndexValueType >::NonpositiveMin() );
+  bool foundMaskVoxel = false;
+  itk::ImageRegionConstIteratorWithIndex< FixedMaskImageType > it(
+    fixedMask, fixedMask->GetBufferedRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    if( it.Get() != itk::NumericTraits< MaskPixelType >::ZeroValue() )
+    {
+      const FixedIndexType & index = it.GetIndex();
+      for( unsigned int d = 0; d < FixedImageDimension; ++d )
+      {
+        minIndex[ d ] = std::min( minIndex[ d ], index[ d ] );
+        maxIndex[ d ] = std::max( maxIndex[ d ], index[ d ] );
+      }
+      foundMaskVoxel = true;
+    }
+  }
+  if( !foundMaskVoxel )
+  {
+    xl::xout[ "warning" ] << "WARNING: the fixed mask is empty, so the images are not cropped." << std::endl;
+    return;
+  }
+
+  /** Map the corners of the bounding box to the fixed image, and dilate. */
+  FixedContinuousIndexType lower;
+  FixedContinuousIndexType upper;
+  lower.Fill( std::numeric_limits< double >::max() );
+  upper.Fill( -std::numeric_limits< double >::max() );
+  for( unsigned int corner = 0; corner < ( 1u << FixedImageDimension ); ++corner )
+  {
+    FixedContinuousIndexType maskCorner;
+    for( unsigned int d = 0; d < FixedImageDimension; ++d )
+    {
+      maskCorner[ d ] = ( corner & ( 1u << d ) ) ? maxIndex[ d ] + 0.5 : minIndex[ d ] - 0.5;
+    }
+    FixedPointType           point;
+    FixedContinuousIndexType fixedCorner;
+    fixedMask->TransformContinuousIndexToPhysicalPoint( maskCorner, point );
+    fixedImage->TransformPhysicalPointToContinuousIndex( point, fixedCorner );
+    for( unsigned int d = 0; d < FixedImageDimension; ++d )
+    {
+      lower[ d ] = std::min( lower[ d ], fixedCorner[ d ] );
+      upper[ d ] = std::max( upper[ d ], fixedCorner[ d ] );
+    }
+  }
+  FixedRegionType fixedRegion;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    const itk::IndexValueType first
+      = static_cast< itk::IndexValueType >( std::floor( lower[ d ] + 0.5 ) ) - fixedMargin;
+    const itk::IndexValueType last
+      = static_cast< itk::IndexValueType >( std::ceil( upper[ d ] - 0.5 ) ) + fixedMargin;
+    fixedRegion.SetIndex( d, first );
+    fixedRegion.SetSize( d, static_cast< itk::SizeValueType >(
+      std::max< itk::IndexValueType >( last - first + 1, 1 ) ) );
+  }
+
+  /** Crop the fixed image. The filter adapts the origin to the region. */
+  const itk::SizeValueType numberOfFixedVoxels = fixedImage->GetBufferedRegion().GetNumberOfPixels();
+  if( fixedRegion.Crop( fixedImage->GetBufferedRegion() )
+    && fixedRegion != fixedImage->GetBufferedRegion() )
+  {
+    typedef itk::RegionOfInterestImageFilter< FixedImageType, FixedImageType > FixedCropFilterType;
+    typename FixedCropFilterType::Pointer cropFilter = FixedCropFilterType::New();
+    cropFilter->SetInput( fixedImage );
+    cropFilter->SetRegionOfInterest( fixedRegion );
+    cropFilter->Update();
+    fixedImage = cropFilter->GetOutput();
+
+    elxout << "The fixed image is cropped to the bounding box of the mask: from "
+           << numberOfFixedVoxels << " to " << fixedRegion.GetNumberOfPixels()
+           << " voxels." << std::endl;
+  }
+
+  /** Crop the moving image to the region reached from the fixed image. */
+  bool cropMovingImage = false;
+  this->GetConfiguration()->ReadParameter( cropMovingImage, "CropMovingImage", 0 );
+  if( !cropMovingImage )
+  {
+    return;
+  }
+  double movingMargin = 20.0;
+  this->GetConfiguration()->ReadParameter( movingMargin, "CropMovingImageMargin", 0 );
+
+  typedef typename ElastixType::TransformBaseType::InitialTransformType InitialTransformType;
+  const InitialTransformType * initialTransform
+    = this->GetElastix()->GetElxTransformBase()->GetInitialTransform();
+
+  MovingContinuousIndexType movingLower;
+  MovingContinuousIndexType movingUpper;
+  movingLower.Fill( std::numeric_limits< double >::max() );
+  movingUpper.Fill( -std::numeric_limits< double >::max() );
+  const FixedRegionType & croppedRegion = fixedImage->GetBufferedRegion();
+  for( unsigned int corner = 0; corner < ( 1u << FixedImageDimension ); ++corner )
+  {
+    FixedContinuousIndexType fixedCorner;
+    for( unsigned int d = 0; d < FixedImageDimension; ++d )
+    {
+      fixedCorner[ d ] = ( corner & ( 1u << d ) )
+        ? croppedRegion.GetIndex()[ d ] + croppedRegion.GetSize()[ d ] - 0.5
+        : croppedRegion.GetIndex()[ d ] - 0.5;
+    }
+    FixedPointType point;
+    fixedImage->TransformContinuousIndexToPhysicalPoint( fixedCorner, point );
+    typename MovingImageType::PointType mappedPoint;
+    if( initialTransform != nullptr )
+    {
+      mappedPoint = initialTransform->TransformPoint( point );
+    }
+    else
+    {
+      mappedPoint.CastFrom( point );
+    }
+    MovingContinuousIndexType movingCorner;
+    movingImage->TransformPhysicalPointToContinuousIndex( mappedPoint, movingCorner );
+    for( unsigned int d = 0; d < MovingImageDimension; ++d )
+    {
+      movingLower[ d ] = std::min( movingLower[ d ], movingCorner[ d ] );
+      movingUpper[ d ] = std::max( movingUpper[ d ], movingCorner[ d ] );
+    }
+  }
+  MovingRegionType movingRegion;
+  for( unsigned int d = 0; d < MovingImageDimension; ++d )
+  {
+    const itk::IndexValueType margin = static_cast< itk::IndexValueType >(
+      std::ceil( movingMargin / movingImage->GetSpacing()[ d ] ) );
+    const itk::IndexValueType first
+      = static_cast< itk::IndexValueType >( std::floor( movingLower[ d ] + 0.5 ) ) - margin;
+    const itk::IndexValueType last
+      = static_cast< itk::IndexValueType >( std::ceil( movingUpper[ d ] - 0.5 ) ) + margin;
+    movingRegion.SetIndex( d, first );
+    movingRegion.SetSize( d, static_cast< itk::SizeValueType >(
+      std::max< itk::IndexValueType >( last - first + 1, 1 ) ) );
+  }
+
+  /** Crop the moving image, unless the fixed image does not reach it at all. */
+  if( !movingRegion.Crop( movingImage->GetBufferedRegion() ) )
+  {
+    xl::xout[ "warning" ] << "WARNING: the cropped fixed image does not reach the moving image, "
+                          << "so the moving image is not cropped." << std::endl;
+    return;
+  }
+  if( movingRegion != movingImage->GetBufferedRegion() )
+  {
+    const itk::SizeValueType numberOfMovingVoxels = movingImage->GetBufferedRegion().GetNumberOfPixels();
+    typedef itk::RegionOfInterestImageFilter< MovingImageType, MovingImageType > MovingCropFilterType;
+    typename MovingCropFilterType::Pointer cropFilter = MovingCropFilterType::New();
+    cropFilter->SetInput( movingImage );
+    cropFilter->SetRegionOfInterest( movingRegion );
+    cropFilter->Update();
+    movingImage = cropFilter->GetOutput();
+
+    elxout << "The moving image is cropped to the region reached by the fixed image: from "
+           << numberOfMovingVoxels << " to " << movingRegion.GetNumberOfPixels()
+           << " voxels." << std::endl;
+  }
+
+} // end CropImagesToFixedMask()
+
+
+/**
+ * ******************* BeforeEachResolutionBase ******************
+ */
+
+template< class TElastix >
+void
+RegistrationBase< TElastix >
+::BeforeEachResolutionBase( void )
+{
+  if( this->GetAsITKBaseType()->GetCurrentLevel() == 0 )
+  {
+    this->SetMultiStartCandidates();
+    this->AddWarmStartCandidate();
+  }
+
+} // end BeforeEachResolutionBase()
+
+
+/**
+ * ******************* SetMultiStartCandidates ******************
+ */
+
+template< class TElastix >
+void
+RegistrationBase< TElastix >
+::SetMultiStartCandidates( void )
+{
+  typedef typename ITKBaseType::TransformType            TransformType;
+  typedef typename TransformType::ScalarType             ScalarType;
+  typedef typename ITKBaseType::ParametersType           ParametersType;
+  typedef typename ITKBaseType::ParametersVectorType     ParametersVectorType;
+  typedef itk::AdvancedCombinationTransform<
+    ScalarType, FixedImageDimension >                    CombinationTransformType;
+  typedef itk::AdvancedMatrixOffsetTransformBase<
+    ScalarType, FixedImageDimension, FixedImageDimension > MatrixOffsetTransformType;
+  typedef typename MatrixOffsetTransformType::MatrixType       MatrixType;
+  typedef typename MatrixOffsetTransformType::OutputVectorType VectorType;
+  typedef typename MatrixOffsetTransformType::OutputPointType  PointType;
+
+  ITKBaseType *        registration = this->GetAsITKBaseType();
+  ParametersVectorType candidates;
+
+  /** Read the rotations and translations to try. */
+  const std::size_t numberOfAngles = this->GetConfiguration()
+    ->CountNumberOfParameterEntries( "MultiStartRotationAngles" );
+  const std::size_t numberOfTranslations = this->GetConfiguration()
+    ->CountNumberOfParameterEntries( "MultiStartTranslations" );
+  if( numberOfAngles == 0 && numberOfTranslations == 0 )
+  {
+    registration->SetInitialTransformParametersCandidates( candidates );
+    return;
+  }
+  std::vector< double > angles( std::max< std::size_t >( numberOfAngles, 1 ), 0.0 );
+  std::vector< double > translations( std::max< std::size_t >( numberOfTranslations, 1 ), 0.0 );
+  for( std::size_t i = 0; i < numberOfAngles; ++i )
+  {
+    this->GetConfiguration()->ReadParameter( angles[ i ], "MultiStartRotationAngles", i );
+  }
+  for( std::size_t i = 0; i < numberOfTranslations; ++i )
+  {
+    this->GetConfiguration()->ReadParameter( translations[ i ], "MultiStartTranslations", i );
+  }
+  unsigned int numberOfOptimizations = 1;
+  this->GetConfiguration()->ReadParameter( numberOfOptimizations, "MultiStartNumberOfOptimizations", 0 );
+  registration->SetNumberOfMultiStartOptimizations( std::max( numberOfOptimizations, 1u ) );
+
+  CombinationTransformType * comboTransform
+    = dynamic_cast< CombinationTransformType * >( registration->GetModifiableTransform() );
+  MatrixOffsetTransformType * transform = comboTransform
+    ? dynamic_cast< MatrixOffsetTransformType * >( comboTransform->GetModifiableCurrentTransform() )
+    : nullptr;
+  const unsigned int numberOfRotationAxes
+    = FixedImageDimension == 2 ? 1 : ( FixedImageDimension == 3 ? 3 : 0 );
+  if( transform == nullptr || ( numberOfAngles > 0 && numberOfRotationAxes == 0 ) )
+  {
+    xl::xout[ "warning" ]
+      << "WARNING: MultiStartRotationAngles and MultiStartTranslations are ignored, because\n"
+      << "they require a rigid, similarity or affine transform of a 2D or 3D image."
+      << std::endl;
+    registration->SetInitialTransformParametersCandidates( candidates );
+    return;
+  }
+
+  /** Each candidate rotates the initial transform about its center of
+   * rotation, and translates it: T(x) = R ( T0(x) - T0(c) ) + T0(c) + t.
+   */
+  const ParametersType initialParameters = registration->GetInitialTransformParametersOfNextLevel();
+  transform->SetParameters( initialParameters );
+  const MatrixType matrix0 = transform->GetMatrix();
+  const VectorType offset0 = transform->GetOffset();
+  const PointType  pivot   = transform->TransformPoint( transform->GetCenter() );
+
+  std::size_t numberOfRotations = 1;
+  for( unsigned int a = 0; a < numberOfRotationAxes; ++a )
+  {
+    numberOfRotations *= angles.size();
+  }
+  std::size_t numberOfShifts = 1;
+  for( unsigned int d = 0; d < FixedImageDimension; ++d )
+  {
+    numberOfShifts *= translations.size();
+  }
+
+  for( std::size_t r = 0; r < numberOfRotations; ++r )
+  {
+    /** Compose R = Rz Ry Rx in 3D. */
+    MatrixType  rotation;
+    rotation.SetIdentity();
+    std::size_t remainder = r;
+    for( unsigned int a = 0; a < numberOfRotationAxes; ++a )
+    {
+      const double angle = angles[ remainder % angles.size() ];
+      remainder /= angles.size();
+      const unsigned int i = numberOfRotationAxes == 1 ? 0 : ( a + 1 ) % 3;
+      const unsigned int j = numberOfRotationAxes == 1 ? 1 : ( a + 2 ) % 3;
+      MatrixType axisRotation;
+      axisRotation.SetIdentity();
+      axisRotation[ i ][ i ] = std::cos( angle );
+      axisRotation[ i ][ j ] = -std::sin( angle );
+      axisRotation[ j ][ i ] = std::sin( angle );
+      axisRotation[ j ][ j ] = std::cos( angle );
+      rotation = axisRotation * rotation;
+    }
+
+    for( std::size_t s = 0; s < numberOfShifts; ++s )
+    {
+      VectorType shift;
+      remainder = s;
+      for( unsigned int d = 0; d < FixedImageDimension; ++d )
+      {
+        shift[ d ] = translations[ remainder % translations.size() ];
+        remainder /= translations.size();
+      }
+
+      VectorType pivotVector;
+      for( unsigned int d = 0; d < FixedImageDimension; ++d )
+      {
+        pivotVector[ d ] = pivot[ d ];
+      }
+      transform->SetMatrix( rotation * matrix0 );
+      transform->SetOffset( rotation * ( offset0 - pivotVector ) + pivotVector + shift );
+      candidates.push_back( transform->GetParameters() );
+    }
+  }
+
+  transform->SetParameters( initialParameters );
+  registration->SetInitialTransformParametersCandidates( candidates );
+
+  elxout << "Trying " << candidates.size()
+         << " initial transforms in the first resolution." << std::endl;
+
+} // end SetMultiStartCandidates()
+
+
+/**
+ * ******************* AddWarmStartCandidate ******************
+ */
+
+template< class TElastix >
+void
+RegistrationBase< TElastix >
+::AddWarmStartCandidate( void )
+{
+  typedef typename ITKBaseType::ParametersType       ParametersType;
+  typedef typename ITKBaseType::ParametersVectorType ParametersVectorType;
+
+  const std::size_t numberOfValues = this->GetConfiguration()
+    ->CountNumberOfParameterEntries( "WarmStartTransformParameters" );
+  if( numberOfValues == 0 )
+  {
+    return;
+  }
+
+  std::vector< double > values;
+  if( !this->GetConfiguration()->ReadParameter( values, "WarmStartTransformParameters",
+    0, static_cast< unsigned int >( numberOfValues - 1 ), true ) )
+  {
+    return;
+  }
+
+  ParametersType warmStart( static_cast< unsigned int >( numberOfValues ) );
+  for( std::size_t i = 0; i < numberOfValues; ++i )
+  {
+    warmStart[ i ] = values[ i ];
+  }
+
+  ITKBaseType *        registration = this->GetAsITKBaseType();
+  ParametersVectorType candidates   = registration->GetInitialTransformParametersCandidates();
+  candidates.push_back( warmStart );
+  registration->SetInitialTransformParametersCandidates( candidates );
+
+  elxout << "Using the WarmStartTransformParameters as initial transform of the first resolution." << std::endl;
+
+} // end AddWarmStartCandidate()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxRegistrationBase_hxx
@@ -23,8 +23,11 @@
 
 #include "elxBaseComponentSE.h"
 #include "itkResampleImageFilter.h"
+#include "itkAdvancedMatrixOffsetTransformBase.h"
 #include "elxProgressCommand.h"
 
+#include <vector>
+
 namespace elastix
 {
 /**
@@ -63,7 +66,52 @@ namespace elastix
  * \parameter CompressResultImage: parameter to set if (lossless) compression
  *    of the written image is desired.\n
  *    example: <tt>(CompressResultImage "true")</tt> \n
+ *    The default is "false". A ResultImageFormat "nii.gz" is always
+ *    compressed, with multiple threads.
+ * \parameter NumberOfStreamDivisions: The number of slabs in which the result image
+ *    is resampled and written. With more than one slab, each slab is written
+ *    after it is resampled, without holding the result image in memory, if the
+ *    ResultImageFormat supports streamed writing, like "mhd", "nii" and "nii.gz".\n
+ *    example: <tt>(NumberOfStreamDivisions 16)</tt> \n
+ *    The default is 1.
+ * \parameter LabelResampling: resample the moving image as a label image,
+ *    directly into the ResultImagePixelType, which should be "unsigned char"
+ *    or "unsigned short". Choose from "false", "nearest", which gives the
+ *    labels of nearest neighbor interpolation, and "majority", which gives
+ *    the label with the largest sum of linear interpolation weights among
+ *    the neighbours. The ResampleInterpolator is then not used, and no
+ *    intermediate image of the moving image pixel type is made.\n
+ *    example: <tt>(LabelResampling "majority")</tt> \n
+ *    The default is "false".
+ * \parameter ParallelStackResampling: resample the result image slice by
+ *    slice, with the slices in parallel, when the transform is a stack
+ *    transform (such as the BSplineStackTransform, EulerStackTransform or
+ *    AffineLogStackTransform) without initial transform, and the
+ *    ResampleInterpolator is the FinalReducedDimensionBSplineInterpolator.
+ *    Each slice is resampled with its sub transform and a B-spline
+ *    interpolator of the slice dimension, which gives the same result.\n
+ *    example: <tt>(ParallelStackResampling "false")</tt> \n
+ *    The default is "true".
+ * \parameter AsynchronousResultImageWriting: resample and write the result
+ *    image of every parameter file but the last in a background thread,
+ *    while the registration with the next parameter file runs. The last
+ *    registration waits for these images to be written after it has written
+ *    its own result image.\n
+ *    example: <tt>(AsynchronousResultImageWriting "true")</tt> \n
  *    The default is "false".
+ * \parameter AsynchronousResultImageWritingNumberOfThreads: the number of
+ *    threads with which a result image is resampled in the background. The
+ *    image is compressed by the background thread itself.\n
+ *    example: <tt>(AsynchronousResultImageWritingNumberOfThreads 2)</tt> \n
+ *    The default is 1.
+ *
+ * In transformix, additional input images can be given with "-in1", "-in2",
+ * etc. They are resampled along with the "-in" image, in a single pass in
+ * which the transform is evaluated once per output voxel. Each additional
+ * input has its own interpolator, given by "-interp1", etc. as "nearest",
+ * "linear" (the default), "bspline" or "bspline<order>", and its own output
+ * pixel type, given by "-pt1", etc. (by default the ResultImagePixelType).
+ * They are written to "result.1.<ResultImageFormat>", etc.
  *
  * \ingroup Resamplers
  * \ingroup ComponentBaseClasses
@@ -110,12 +158,31 @@ public:
   typedef typename ITKBaseType::OriginPointType  OriginPointType;
   typedef typename ITKBaseType::PixelType        OutputPixelType;
 
+  /** Typedef of the single affine transform that replaces a linear chain. */
+  typedef itk::AdvancedMatrixOffsetTransformBase< CoordRepType,
+    OutputImageType::ImageDimension, InputImageType::ImageDimension > LinearTransformType;
+  typedef typename LinearTransformType::Pointer                       LinearTransformPointer;
+
   /** Typedef that is used in the elastix dll version. */
   typedef typename ElastixType::ParameterMapType ParameterMapType;
 
   /** Typedef for the ProgressCommand. */
   typedef elx::ProgressCommand ProgressCommandType;
 
+  /** An input image that is resampled along with the input of the resampler,
+   * with the name of its interpolator ("nearest", "linear", "bspline" or
+   * "bspline<order>"), its output pixel type (empty for the
+   * ResultImagePixelType) and the name of its result file.
+   */
+  struct AdditionalInputType
+  {
+    typename InputImageType::ConstPointer Image;
+    std::string                           Interpolator;
+    std::string                           PixelType;
+    std::string                           FileName;
+  };
+  typedef std::vector< AdditionalInputType > AdditionalInputContainerType;
+
   /** Get the ImageDimension. */
   itkStaticConstMacro( ImageDimension, unsigned int,
     OutputImageType::ImageDimension );
@@ -174,9 +241,19 @@ public:
   /** Function to perform resample and write the result output image to a file. */
   virtual void ResampleAndWriteResultImage( const char * filename, const bool & showProgress = true );
 
-  /** Function to write the result output image to a file. */
+  /** Function to resample the input of the resampler together with some
+   * additional inputs, mapping each output voxel by the transform only once,
+   * and to write each result to its own file.
+   */
+  virtual void ResampleAndWriteResultImages( const char * filename,
+    const AdditionalInputContainerType & additionalInputs, const bool & showProgress = true );
+
+  /** Function to write the result output image to a file. The pixel type
+   * is the ResultImagePixelType, unless another one is given.
+   */
   virtual void WriteResultImage( OutputImageType * imageimage,
-    const char * filename, const bool & showProgress = true );
+    const char * filename, const bool & showProgress = true,
+    const std::string & pixelType = "" );
 
   /** Function to create the result image in the format of an itk::Image. */
   virtual void CreateItkResultImage( void );
@@ -191,9 +268,67 @@ protected:
   /** Method that sets the transform, the interpolator and the inputImage. */
   virtual void SetComponents( void );
 
+  /** Return a single affine transform that is equivalent to the given
+   * transform, if that is a chain of linear transforms, and a null pointer
+   * otherwise. The resampler evaluates the affine transform without the
+   * virtual calls and the point copies of the chain.
+   */
+  virtual LinearTransformPointer CreateFlattenedLinearTransform(
+    const TransformType * transform ) const;
+
+  /** Resample the image. A chain of linear transforms is flattened into a
+   * single affine transform, which stays set afterwards, so that the output
+   * of the resampler does not become out of date.
+   */
+  virtual void UpdateResampler( void );
+
+  /** Set the transform of the resampler, flattened if possible, without
+   * resampling. Called by UpdateResampler().
+   */
+  virtual void SetResamplerTransform( void );
+
+  /** Get the number of slabs in which the result image is resampled and
+   * written.
+   */
+  unsigned int GetNumberOfStreamDivisions( void ) const;
+
+  /** Resample the input of the resampler slice by slice, if the transform
+   * is a stack transform and ParallelStackResampling is enabled. Returns a
+   * null pointer otherwise.
+   */
+  typename OutputImageType::Pointer ResampleStack( void ) const;
+
+  /** Resample the input of the resampler as a label image with the given
+   * pixel type, and write it, for the LabelResampling parameter.
+   */
+  template< class TLabelPixel >
+  void ResampleAndWriteLabelImage( const char * filename,
+    const bool useMajorityVote, const bool & showProgress );
+
+  /** Create the interpolator of an additional input from its name. */
+  typename InterpolatorType::Pointer CreateAdditionalInterpolator(
+    const std::string & name ) const;
+
+  /** Resample and write the result image in a background thread, for the
+   * AsynchronousResultImageWriting parameter.
+   */
+  virtual void ResampleAndWriteResultImageInBackground( const std::string & filename );
+
   /** Variable that defines to print the progress or not. */
   bool m_ShowProgress;
 
+  /** Whether the result image is resampled and written in the background,
+   * in which case nothing is printed and the writer does not use the thread
+   * pool to compress the image.
+   */
+  bool m_IsWritingInBackground;
+
+  /** The flattened transform that is set by UpdateResampler(), and the
+   * transform that it replaces.
+   */
+  LinearTransformPointer               m_FlattenedLinearTransform;
+  typename TransformType::ConstPointer m_UnflattenedTransform;
+
 private:
 
   /** The private constructor. */
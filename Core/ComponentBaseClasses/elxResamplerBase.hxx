@@ -19,12 +19,25 @@
 #define __elxResamplerBase_hxx
 
 #include "elxResamplerBase.h"
+#include "elxElastixBase.h"
+#include "elxPixelType.h"
 
 #include "itkImageFileCastWriter.h"
 #include "itkChangeInformationImageFilter.h"
 #include "itkAdvancedRayCastInterpolateImageFunction.h"
+#include "itkAdvancedBSplineInterpolateImageFunction.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkNearestNeighborInterpolateImageFunction.h"
+#include "itkMultiInputResampleImageFilter.h"
+#include "itkLabelResampleImageFilter.h"
+#include "itkStackResampleImageFilter.h"
+#include "itkAdvancedCombinationTransform.h"
+#include "itkReducedDimensionBSplineInterpolateImageFunction.h"
 #include "itkTimeProbe.h"
 
+#include <algorithm>
+#include <sstream>
+
 namespace elastix
 {
 
@@ -36,7 +49,8 @@ template< class TElastix >
 ResamplerBase< TElastix >
 ::ResamplerBase()
 {
-  this->m_ShowProgress = true;
+  this->m_ShowProgress          = true;
+  this->m_IsWritingInBackground = false;
 } // end Constructor
 
 
@@ -243,6 +257,13 @@ ResamplerBase< TElastix >
   }
   else
   {
+    /** An intermediate result image may be written in the background. */
+    const bool isFinalElastixLevel = this->m_Configuration->GetElastixLevel() + 1
+      == this->m_Configuration->GetTotalNumberOfElastixLevels();
+    bool asynchronousWriting = false;
+    this->m_Configuration->ReadParameter( asynchronousWriting,
+      "AsynchronousResultImageWriting", 0, false );
+
     /** Writing result image. */
     if( writeResultImage == "true" )
     {
@@ -256,28 +277,36 @@ ResamplerBase< TElastix >
         << "result." << this->m_Configuration->GetElastixLevel()
         << "." << resultImageFormat;
 
-      /** Time the resampling. */
-      itk::TimeProbe timer;
-      timer.Start();
-
-      /** Apply the final transform, and save the result,
-       * by calling ResampleAndWriteResultImage.
-       */
-      elxout << "\nApplying final transform ..." << std::endl;
-      try
+      if( asynchronousWriting && !isFinalElastixLevel )
       {
-        this->ResampleAndWriteResultImage( makeFileName.str().c_str(), this->m_ShowProgress );
+        elxout << "\nApplying final transform in the background ..." << std::endl;
+        this->ResampleAndWriteResultImageInBackground( makeFileName.str() );
       }
-      catch( itk::ExceptionObject & excp )
+      else
       {
-        xl::xout[ "error" ] << "Exception caught: " << std::endl;
-        xl::xout[ "error" ] << excp << "Resuming elastix." << std::endl;
+        /** Time the resampling. */
+        itk::TimeProbe timer;
+        timer.Start();
+
+        /** Apply the final transform, and save the result,
+         * by calling ResampleAndWriteResultImage.
+         */
+        elxout << "\nApplying final transform ..." << std::endl;
+        try
+        {
+          this->ResampleAndWriteResultImage( makeFileName.str().c_str(), this->m_ShowProgress );
+        }
+        catch( itk::ExceptionObject & excp )
+        {
+          xl::xout[ "error" ] << "Exception caught: " << std::endl;
+          xl::xout[ "error" ] << excp << "Resuming elastix." << std::endl;
+        }
+
+        /** Print the elapsed time for the resampling. */
+        timer.Stop();
+        elxout << "  Applying final transform took "
+               << this->ConvertSecondsToDHMS( timer.GetMean(), 2 ) << std::endl;
       }
-
-      /** Print the elapsed time for the resampling. */
-      timer.Stop();
-      elxout << "  Applying final transform took "
-             << this->ConvertSecondsToDHMS( timer.GetMean(), 2 ) << std::endl;
     }
     else
     {
@@ -286,11 +315,69 @@ ResamplerBase< TElastix >
              << "Skipping applying final transform, no resulting output image generated."
              << std::endl;
     } // end if
+
+    /** The last registration waits for the result images of the former ones. */
+    if( isFinalElastixLevel )
+    {
+      ElastixBase::WaitForBackgroundTasks();
+    }
   }
 
 } // end AfterRegistrationBase()
 
 
+/**
+ * ******************* ResampleAndWriteResultImageInBackground ********************
+ */
+
+template< class TElastix >
+void
+ResamplerBase< TElastix >
+::ResampleAndWriteResultImageInBackground( const std::string & filename )
+{
+  /** The resampler gets a bounded number of threads. */
+  unsigned int numberOfThreads = 1;
+  this->m_Configuration->ReadParameter( numberOfThreads,
+    "AsynchronousResultImageWritingNumberOfThreads", 0, false );
+  ITKBaseType * resampler = this->GetAsITKBaseType();
+  resampler->SetNumberOfWorkUnits( std::max( numberOfThreads, 1u ) );
+
+  /** The next registration uses the moving image as well. The resampler gets
+   * its own image object, which shares the pixel buffer, so that the two
+   * pipelines do not update the same image object.
+   */
+  typename InputImageType::Pointer movingImage = InputImageType::New();
+  movingImage->Graft( resampler->GetInput() );
+  resampler->SetInput( movingImage );
+
+  /** The elastix object keeps this component, its transform and its
+   * configuration alive until the task is waited for.
+   */
+  this->m_IsWritingInBackground = true;
+  ElastixBase::RunInBackground( [ this, filename ]()
+    {
+      itk::TimeProbe timer;
+      timer.Start();
+      std::ostringstream message( "" );
+      try
+      {
+        this->ResampleAndWriteResultImage( filename.c_str(), false );
+        timer.Stop();
+        message << "Writing \"" << filename << "\" in the background took "
+                << this->ConvertSecondsToDHMS( timer.GetMean(), 2 );
+      }
+      catch( itk::ExceptionObject & excp )
+      {
+        message << "Exception caught while writing \"" << filename
+                << "\" in the background:\n" << excp;
+      }
+      return message.str();
+    },
+    this->GetElastix() );
+
+} // end ResampleAndWriteResultImageInBackground()
+
+
 /**
  * *********************** SetComponents ************************
  */
@@ -315,6 +402,341 @@ ResamplerBase< TElastix >
 } // end SetComponents()
 
 
+/**
+ * ******************* CreateFlattenedLinearTransform ********************
+ */
+
+template< class TElastix >
+typename ResamplerBase< TElastix >::LinearTransformPointer
+ResamplerBase< TElastix >
+::CreateFlattenedLinearTransform( const TransformType * transform ) const
+{
+  /** Transforms that are not linear, or already a single affine transform, are kept. */
+  if( transform == nullptr || transform->GetTransformCategory() != TransformType::Linear
+    || dynamic_cast< const LinearTransformType * >( transform ) != nullptr )
+  {
+    return nullptr;
+  }
+
+  /** A linear transform is determined by the images of the origin and of the unit vectors. */
+  typedef typename TransformType::InputPointType  InputPointType;
+  typedef typename TransformType::OutputPointType OutputPointType;
+  InputPointType point;
+  point.Fill( 0.0 );
+  const OutputPointType origin = transform->TransformPoint( point );
+
+  typename LinearTransformType::MatrixType       matrix;
+  typename LinearTransformType::OutputVectorType offset;
+  for( unsigned int j = 0; j < ImageDimension; ++j )
+  {
+    point.Fill( 0.0 );
+    point[ j ] = 1.0;
+    const OutputPointType column = transform->TransformPoint( point );
+    for( unsigned int i = 0; i < ImageDimension; ++i )
+    {
+      matrix( i, j ) = column[ i ] - origin[ i ];
+    }
+    offset[ j ] = origin[ j ];
+  }
+
+  LinearTransformPointer linearTransform = LinearTransformType::New();
+  linearTransform->SetMatrix( matrix );
+  linearTransform->SetOffset( offset );
+  return linearTransform;
+
+} // end CreateFlattenedLinearTransform()
+
+
+/**
+ * ******************* UpdateResampler ********************
+ */
+
+template< class TElastix >
+void
+ResamplerBase< TElastix >
+::UpdateResampler( void )
+{
+  this->SetResamplerTransform();
+  this->GetAsITKBaseType()->Update();
+
+} // end UpdateResampler()
+
+
+/**
+ * ******************* SetResamplerTransform ********************
+ */
+
+template< class TElastix >
+void
+ResamplerBase< TElastix >
+::SetResamplerTransform( void )
+{
+  /** The transform may have been replaced by a flattened transform at a
+   * previous call. The original transform may have changed since then.
+   */
+  ITKBaseType *         resampler = this->GetAsITKBaseType();
+  const TransformType * transform = resampler->GetTransform();
+  if( this->m_FlattenedLinearTransform.IsNotNull()
+    && transform == this->m_FlattenedLinearTransform.GetPointer() )
+  {
+    transform = this->m_UnflattenedTransform;
+  }
+
+  this->m_UnflattenedTransform     = transform;
+  this->m_FlattenedLinearTransform = this->CreateFlattenedLinearTransform( transform );
+  if( this->m_FlattenedLinearTransform.IsNotNull() )
+  {
+    resampler->SetTransform( this->m_FlattenedLinearTransform );
+  }
+  else
+  {
+    resampler->SetTransform( transform );
+  }
+
+} // end SetResamplerTransform()
+
+
+/**
+ * ******************* GetNumberOfStreamDivisions ********************
+ */
+
+template< class TElastix >
+unsigned int
+ResamplerBase< TElastix >
+::GetNumberOfStreamDivisions( void ) const
+{
+  unsigned int numberOfStreamDivisions = 1;
+  this->m_Configuration->ReadParameter( numberOfStreamDivisions, "NumberOfStreamDivisions", 0, false );
+  return std::max( numberOfStreamDivisions, 1u );
+
+} // end GetNumberOfStreamDivisions()
+
+
+/**
+ * ******************* ResampleStack ********************
+ */
+
+template< class TElastix >
+typename ResamplerBase< TElastix >::OutputImageType::Pointer
+ResamplerBase< TElastix >
+::ResampleStack( void ) const
+{
+  typedef itk::AdvancedCombinationTransform<
+    CoordRepType, ImageDimension >                 CombinationTransformType;
+  typedef itk::StackResampleImageFilter<
+    InputImageType, CoordRepType >                 StackResamplerType;
+  typedef typename StackResamplerType::StackTransformType StackTransformType;
+  typedef itk::ReducedDimensionBSplineInterpolateImageFunction<
+    InputImageType, CoordRepType, double >         ReducedDimensionInterpolatorType;
+
+  bool parallelStackResampling = true;
+  this->m_Configuration->ReadParameter( parallelStackResampling,
+    "ParallelStackResampling", 0, false );
+  if( !parallelStackResampling || ImageDimension < 3 )
+  {
+    return nullptr;
+  }
+
+  /** The transform must be a stack transform without initial transform, the
+   * interpolator reduced dimension B-spline, and the directions must keep
+   * the stack dimension separate.
+   */
+  const ITKBaseType *              resampler   = this->GetAsITKBaseType();
+  const CombinationTransformType * combination = dynamic_cast< const CombinationTransformType * >(
+    resampler->GetTransform() );
+  const ReducedDimensionInterpolatorType * interpolator
+    = dynamic_cast< const ReducedDimensionInterpolatorType * >( resampler->GetInterpolator() );
+  if( combination == nullptr || combination->GetInitialTransform() != nullptr
+    || interpolator == nullptr || resampler->GetInput() == nullptr
+    || !StackResamplerType::IsStackDirection( resampler->GetInput()->GetDirection() )
+    || !StackResamplerType::IsStackDirection( resampler->GetOutputDirection() ) )
+  {
+    return nullptr;
+  }
+  StackTransformType * stackTransform = dynamic_cast< StackTransformType * >(
+    const_cast< CombinationTransformType * >( combination )->GetModifiableCurrentTransform() );
+  if( stackTransform == nullptr || stackTransform->GetNumberOfSubTransforms() == 0 )
+  {
+    return nullptr;
+  }
+
+  typename StackResamplerType::Pointer stackResampler = StackResamplerType::New();
+  stackResampler->SetInput( resampler->GetInput() );
+  stackResampler->SetStackTransform( stackTransform );
+  stackResampler->SetSplineOrder( static_cast< unsigned int >( interpolator->GetSplineOrder() ) );
+  stackResampler->SetDefaultPixelValue( resampler->GetDefaultPixelValue() );
+  stackResampler->SetSize( resampler->GetSize() );
+  stackResampler->SetOutputStartIndex( resampler->GetOutputStartIndex() );
+  stackResampler->SetOutputSpacing( resampler->GetOutputSpacing() );
+  stackResampler->SetOutputOrigin( resampler->GetOutputOrigin() );
+  stackResampler->SetOutputDirection( resampler->GetOutputDirection() );
+  stackResampler->SetNumberOfWorkUnits( resampler->GetNumberOfWorkUnits() );
+
+  if( !this->m_IsWritingInBackground )
+  {
+    elxout << "  Resampling the " << stackTransform->GetNumberOfSubTransforms()
+           << " slices of the stack in parallel" << std::endl;
+  }
+  stackResampler->Update();
+
+  typename OutputImageType::Pointer stackImage = stackResampler->GetOutput();
+  stackImage->DisconnectPipeline();
+  return stackImage;
+
+} // end ResampleStack()
+
+
+/**
+ * ******************* ResampleAndWriteLabelImage ********************
+ */
+
+template< class TElastix >
+template< class TLabelPixel >
+void
+ResamplerBase< TElastix >
+::ResampleAndWriteLabelImage( const char * filename,
+  const bool useMajorityVote, const bool & showProgress )
+{
+  /** Typedef's for resampling and writing the label image. */
+  typedef itk::Image< TLabelPixel,
+    itkGetStaticConstMacro( ImageDimension ) >     LabelImageType;
+  typedef itk::LabelResampleImageFilter<
+    InputImageType, LabelImageType, CoordRepType > LabelResamplerType;
+  typedef itk::ChangeInformationImageFilter<
+    LabelImageType >                               ChangeInfoFilterType;
+  typedef itk::ImageFileCastWriter<
+    LabelImageType >                               WriterType;
+
+  /** The label resampler takes the settings of the resampler. */
+  ITKBaseType * resampler = this->GetAsITKBaseType();
+  this->SetResamplerTransform();
+  typename LabelResamplerType::Pointer labelResampler = LabelResamplerType::New();
+  labelResampler->SetInput( resampler->GetInput() );
+  labelResampler->SetTransform( resampler->GetTransform() );
+  labelResampler->SetSize( resampler->GetSize() );
+  labelResampler->SetOutputStartIndex( resampler->GetOutputStartIndex() );
+  labelResampler->SetOutputSpacing( resampler->GetOutputSpacing() );
+  labelResampler->SetOutputOrigin( resampler->GetOutputOrigin() );
+  labelResampler->SetOutputDirection( resampler->GetOutputDirection() );
+  labelResampler->SetDefaultPixelValue(
+    static_cast< TLabelPixel >( resampler->GetDefaultPixelValue() ) );
+  labelResampler->SetUseMajorityVote( useMajorityVote );
+  labelResampler->SetNumberOfWorkUnits( resampler->GetNumberOfWorkUnits() );
+
+  /** Read from the parameter file if compression is desired. */
+  bool doCompression = false;
+  this->m_Configuration->ReadParameter(
+    doCompression, "CompressResultImage", 0, false );
+
+  /** Possibly change direction cosines to their original value, as in
+   * WriteResultImage().
+   */
+  typename ChangeInfoFilterType::Pointer infoChanger = ChangeInfoFilterType::New();
+  DirectionType originalDirection;
+  bool          retdc = this->GetElastix()->GetOriginalFixedImageDirection( originalDirection );
+  infoChanger->SetOutputDirection( originalDirection );
+  infoChanger->SetChangeDirection( retdc & !this->GetElastix()->GetUseDirectionCosines() );
+  infoChanger->SetInput( labelResampler->GetOutput() );
+
+  /** The writer does not convert the labels, since they have the pixel type
+   * of the file already.
+   */
+  typename WriterType::Pointer writer = WriterType::New();
+  writer->SetInput( infoChanger->GetOutput() );
+  writer->SetFileName( filename );
+  writer->SetUseCompression( doCompression );
+  writer->SetUseParallelCompression( !this->m_IsWritingInBackground );
+  writer->SetNumberOfStreamDivisions( this->GetNumberOfStreamDivisions() );
+
+  /** Add a progress observer to the label resampler. */
+  const auto progressObserver = BaseComponent::IsElastixLibrary() ?
+    nullptr : ProgressCommandType::New();
+  if( showProgress && (progressObserver != nullptr) )
+  {
+    progressObserver->ConnectObserver( labelResampler );
+    progressObserver->SetStartString( "  Progress: " );
+    progressObserver->SetEndString( "%" );
+    xl::xout[ "coutonly" ] << "  Resampling label image ("
+                           << ( useMajorityVote ? "majority vote" : "nearest neighbor" )
+                           << ") ..." << std::endl;
+  }
+
+  /** Resample and write, in slabs if NumberOfStreamDivisions > 1. */
+  try
+  {
+    writer->Update();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    /** Add information to the exception. */
+    excp.SetLocation( "ResamplerBase - ResampleAndWriteLabelImage()" );
+    std::string err_str = excp.GetDescription();
+    err_str += "\nError occurred while resampling and writing the label image.\n";
+    excp.SetDescription( err_str );
+
+    /** Pass the exception to an higher level. */
+    throw excp;
+  }
+
+  if( showProgress && (progressObserver != nullptr) )
+  {
+    progressObserver->DisconnectObserver( labelResampler );
+  }
+
+} // end ResampleAndWriteLabelImage()
+
+
+/**
+ * ******************* CreateAdditionalInterpolator ********************
+ */
+
+template< class TElastix >
+typename ResamplerBase< TElastix >::InterpolatorType::Pointer
+ResamplerBase< TElastix >
+::CreateAdditionalInterpolator( const std::string & name ) const
+{
+  typedef itk::NearestNeighborInterpolateImageFunction<
+    InputImageType, CoordRepType >                 NearestNeighborInterpolatorType;
+  typedef itk::LinearInterpolateImageFunction<
+    InputImageType, CoordRepType >                 LinearInterpolatorType;
+  typedef itk::AdvancedBSplineInterpolateImageFunction<
+    InputImageType, CoordRepType, double >         BSplineInterpolatorType;
+
+  if( name == "nearest" )
+  {
+    return NearestNeighborInterpolatorType::New().GetPointer();
+  }
+  if( name.empty() || name == "linear" )
+  {
+    return LinearInterpolatorType::New().GetPointer();
+  }
+
+  /** "bspline" is of order 3, "bspline<order>" of the given order. */
+  if( name.compare( 0, 7, "bspline" ) == 0 )
+  {
+    unsigned int splineOrder = 3;
+    const std::string orderString = name.substr( 7 );
+    if( !orderString.empty() )
+    {
+      std::istringstream orderStream( orderString );
+      orderStream >> splineOrder;
+      if( orderStream.fail() || !orderStream.eof() || splineOrder > 5 )
+      {
+        itkExceptionMacro( << "ERROR: The interpolator "" << name
+          << "" should have a spline order from 0 to 5." );
+      }
+    }
+    typename BSplineInterpolatorType::Pointer interpolator = BSplineInterpolatorType::New();
+    interpolator->SetSplineOrder( splineOrder );
+    return interpolator.GetPointer();
+  }
+
+  itkExceptionMacro( << "ERROR: Unknown interpolator "" << name
+    << "". Choose from \"nearest\", \"linear\", \"bspline\" or \"bspline<order>\"." );
+
+} // end CreateAdditionalInterpolator()
+
+
 /**
  * ******************* ResampleAndWriteResultImage ********************
  */
@@ -324,6 +746,61 @@ void
 ResamplerBase< TElastix >
 ::ResampleAndWriteResultImage( const char * filename, const bool & showProgress )
 {
+  /** Label images may be resampled directly into their integer pixel type. */
+  std::string labelResampling = "false";
+  this->m_Configuration->ReadParameter( labelResampling, "LabelResampling", 0, false );
+  if( labelResampling != "false" )
+  {
+    if( labelResampling != "nearest" && labelResampling != "majority" )
+    {
+      itkExceptionMacro( << "ERROR: LabelResampling \"" << labelResampling
+        << "\" is not supported. Choose from \"false\", \"nearest\" or \"majority\"." );
+    }
+    const bool  useMajorityVote      = labelResampling == "majority";
+    std::string resultImagePixelType = "short";
+    this->m_Configuration->ReadParameter( resultImagePixelType,
+      "ResultImagePixelType", 0, false );
+    if( resultImagePixelType == "unsigned char" || resultImagePixelType == "unsigned_char" )
+    {
+      this->ResampleAndWriteLabelImage< unsigned char >( filename, useMajorityVote, showProgress );
+      return;
+    }
+    if( resultImagePixelType == "unsigned short" || resultImagePixelType == "unsigned_short" )
+    {
+      this->ResampleAndWriteLabelImage< unsigned short >( filename, useMajorityVote, showProgress );
+      return;
+    }
+    if( !this->m_IsWritingInBackground )
+    {
+      xl::xout[ "warning" ] << "WARNING: LabelResampling requires the ResultImagePixelType "
+                            << "\"unsigned char\" or \"unsigned short\".\n"
+                            << "  The image is resampled with the ResampleInterpolator." << std::endl;
+    }
+  }
+
+  /** The slices of a stack are resampled in parallel. */
+  typename OutputImageType::Pointer stackImage;
+  try
+  {
+    stackImage = this->ResampleStack();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    /** Add information to the exception. */
+    excp.SetLocation( "ResamplerBase - ResampleAndWriteResultImage()" );
+    std::string err_str = excp.GetDescription();
+    err_str += "\nError occurred while resampling the stack.\n";
+    excp.SetDescription( err_str );
+
+    /** Pass the exception to an higher level. */
+    throw excp;
+  }
+  if( stackImage.IsNotNull() )
+  {
+    this->WriteResultImage( stackImage, filename, showProgress );
+    return;
+  }
+
   /** Make sure the resampler is updated. */
   this->GetAsITKBaseType()->Modified();
 
@@ -337,10 +814,19 @@ ResamplerBase< TElastix >
     progressObserver->SetEndString( "%" );
   }
 
-  /** Do the resampling. */
+  /** Do the resampling. When the image is written in slabs, the writer
+   * resamples each slab before writing it.
+   */
   try
   {
-    this->GetAsITKBaseType()->Update();
+    if( this->GetNumberOfStreamDivisions() > 1 )
+    {
+      this->SetResamplerTransform();
+    }
+    else
+    {
+      this->UpdateResampler();
+    }
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -374,7 +860,8 @@ template< class TElastix >
 void
 ResamplerBase< TElastix >
 ::WriteResultImage( OutputImageType * image,
-  const char * filename, const bool & showProgress )
+  const char * filename, const bool & showProgress,
+  const std::string & pixelType )
 {
   /** Check if ResampleInterpolator is the RayCastResampleInterpolator  */
   typedef itk::AdvancedRayCastInterpolateImageFunction<  InputImageType,
@@ -396,6 +883,7 @@ ResamplerBase< TElastix >
   std::string resultImagePixelType = "short";
   this->m_Configuration->ReadParameter( resultImagePixelType,
     "ResultImagePixelType", 0, false );
+  if( !pixelType.empty() ) { resultImagePixelType = pixelType; }
   std::basic_string< char >::size_type       pos  = resultImagePixelType.find( " " );
   const std::basic_string< char >::size_type npos = std::basic_string< char >::npos;
   if( pos != npos ) { resultImagePixelType.replace( pos, 1, "_" ); }
@@ -430,6 +918,8 @@ ResamplerBase< TElastix >
   writer->SetFileName( filename );
   writer->SetOutputComponentType( resultImagePixelType.c_str() );
   writer->SetUseCompression( doCompression );
+  writer->SetUseParallelCompression( !this->m_IsWritingInBackground );
+  writer->SetNumberOfStreamDivisions( this->GetNumberOfStreamDivisions() );
 
   /** Do the writing. */
   if( showProgress )
@@ -455,6 +945,93 @@ ResamplerBase< TElastix >
 } // end WriteResultImage()
 
 
+/**
+ * ******************* ResampleAndWriteResultImages ********************
+ */
+
+template< class TElastix >
+void
+ResamplerBase< TElastix >
+::ResampleAndWriteResultImages( const char * filename,
+  const AdditionalInputContainerType & additionalInputs, const bool & showProgress )
+{
+  if( additionalInputs.empty() )
+  {
+    this->ResampleAndWriteResultImage( filename, showProgress );
+    return;
+  }
+
+  ITKBaseType * resampler = this->GetAsITKBaseType();
+
+  /** The RayCastResampleInterpolator replaces the transform of the resampler. */
+  typedef itk::AdvancedRayCastInterpolateImageFunction< InputImageType,
+    CoordRepType > RayCastInterpolatorType;
+  if( dynamic_cast< const RayCastInterpolatorType * >( resampler->GetInterpolator() ) != nullptr )
+  {
+    itkExceptionMacro( << "ERROR: Additional input images can not be resampled "
+      << "with the RayCastResampleInterpolator." );
+  }
+
+  /** All inputs are resampled on the output grid of the resampler, with its
+   * transform, flattened if possible, and its default pixel value.
+   */
+  typedef itk::MultiInputResampleImageFilter<
+    InputImageType, CoordRepType >                 MultiInputResamplerType;
+  typename MultiInputResamplerType::Pointer multiInputResampler
+    = MultiInputResamplerType::New();
+  this->SetResamplerTransform();
+  multiInputResampler->SetTransform( resampler->GetTransform() );
+  multiInputResampler->SetSize( resampler->GetSize() );
+  multiInputResampler->SetOutputStartIndex( resampler->GetOutputStartIndex() );
+  multiInputResampler->SetOutputSpacing( resampler->GetOutputSpacing() );
+  multiInputResampler->SetOutputOrigin( resampler->GetOutputOrigin() );
+  multiInputResampler->SetOutputDirection( resampler->GetOutputDirection() );
+  const OutputPixelType defaultPixelValue = resampler->GetDefaultPixelValue();
+
+  std::vector< std::string > fileNames( 1, filename );
+  std::vector< std::string > pixelTypes( 1, "" );
+  multiInputResampler->AddInputImage( resampler->GetInput(),
+    resampler->GetModifiableInterpolator(), defaultPixelValue );
+  for( const AdditionalInputType & additionalInput : additionalInputs )
+  {
+    multiInputResampler->AddInputImage( additionalInput.Image,
+      this->CreateAdditionalInterpolator( additionalInput.Interpolator ), defaultPixelValue );
+    fileNames.push_back( additionalInput.FileName );
+    pixelTypes.push_back( additionalInput.PixelType );
+  }
+
+  /** Resample all inputs in a single pass. */
+  if( showProgress )
+  {
+    xl::xout[ "coutonly" ] << "  Resampling " << fileNames.size()
+                           << " images in a single pass ..." << std::endl;
+  }
+  try
+  {
+    multiInputResampler->Update();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    /** Add information to the exception. */
+    excp.SetLocation( "ResamplerBase - ResampleAndWriteResultImages()" );
+    std::string err_str = excp.GetDescription();
+    err_str += "\nError occurred while resampling the images.\n";
+    excp.SetDescription( err_str );
+
+    /** Pass the exception to an higher level. */
+    throw excp;
+  }
+
+  /** Write each result with its own pixel type. */
+  for( unsigned int i = 0; i < fileNames.size(); ++i )
+  {
+    this->WriteResultImage( multiInputResampler->GetOutput( i ),
+      fileNames[ i ].c_str(), showProgress, pixelTypes[ i ] );
+  }
+
+} // end ResampleAndWriteResultImages()
+
+
 /*
  * ******************* CreateItkResultImage ********************
  * \todo: avoid code duplication with WriteResultImage function
@@ -476,7 +1053,7 @@ ResamplerBase< TElastix >
   /** Do the resampling. */
   try
   {
-    this->GetAsITKBaseType()->Update();
+    this->UpdateResampler();
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -547,15 +1124,26 @@ ResamplerBase< TElastix >
   typedef itk::CastImageFilter< InputImageType,
     itk::Image< double, InputImageType::ImageDimension > >          CastFilterDouble;
 
+  /** A result image of the pixel type of the resampler is returned as it
+   * is, instead of being copied by a cast filter. The resampler gets a new
+   * output, so that its buffer is not overwritten when it is updated again.
+   */
+  if( resultImagePixelType.compare( PixelType< OutputPixelType >::ToString() ) == 0 )
+  {
+    infoChanger->Update();
+    resultImage = infoChanger->GetOutput();
+    resultImage->DisconnectPipeline();
+    this->GetAsITKBaseType()->GetOutput()->DisconnectPipeline();
+  }
   /** cast the image to the correct output image Type */
-  if( resultImagePixelType.compare( "char" ) == 0 )
+  else if( resultImagePixelType.compare( "char" ) == 0 )
   {
     typename CastFilterChar::Pointer castFilter = CastFilterChar::New();
     castFilter->SetInput( infoChanger->GetOutput() );
     castFilter->Update();
     resultImage = castFilter->GetOutput();
   }
-  if( resultImagePixelType.compare( "unsigned char" ) == 0 )
+  else if( resultImagePixelType.compare( "unsigned char" ) == 0 )
   {
     typename CastFilterUChar::Pointer castFilter = CastFilterUChar::New();
     castFilter->SetInput( infoChanger->GetOutput() );
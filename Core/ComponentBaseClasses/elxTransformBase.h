@@ -24,6 +24,8 @@
 #include "elxBaseComponentSE.h"
 #include "itkAdvancedTransform.h"
 #include "itkAdvancedCombinationTransform.h"
+#include "itkBakedDisplacementFieldTransform.h"
+#include "itkImageSource.h"
 #include "elxComponentDatabase.h"
 #include "elxProgressCommand.h"
 
@@ -51,6 +53,55 @@ namespace elastix
  *   "Compose" by composition: \f$T(x) = T_1 ( T_0(x) )\f$.\n
  *   example: <tt>(HowToCombineTransforms "Add")</tt>\n
  *   Default: "Add".
+ * \parameter BakeInitialTransform: Whether to replace a non-linear initial transform
+ *   that is read from file (by -t0, or by InitialTransformParametersFileName) by a
+ *   displacement field, which is sampled once on a grid over the fixed image. The
+ *   displacement is then linearly interpolated, at a cost that is independent of the
+ *   length of the chain of initial transforms, but approximately: the error grows with
+ *   the grid spacing and with the curvature of the initial transform. Points outside the
+ *   grid are transformed by the original initial transform.\n
+ *   example: <tt>(BakeInitialTransform "true")</tt>\n
+ *   Default: "false".
+ * \parameter BakedInitialTransformGridSpacingFactor: The spacing of the grid of a baked
+ *   initial transform, relative to the voxel spacing of the fixed image.\n
+ *   example: <tt>(BakedInitialTransformGridSpacingFactor 2.0)</tt>\n
+ *   Default: 1.0.
+ * \parameter NumberOfStreamDivisions: The number of slabs in which the deformation field
+ *   (transformix -def all) and the spatial Jacobian images (-jac all, -jacmat all) are
+ *   generated and written. With more than one slab these images are written without
+ *   holding them in memory completely, if the ResultImageFormat supports streamed writing,
+ *   like "mhd" and "nii". The elastix library always keeps the deformation field in memory.\n
+ *   example: <tt>(NumberOfStreamDivisions 16)</tt>\n
+ *   Default: 1.
+ * \parameter OutputPointsFormat: The format of the points transformed by transformix -def
+ *   with an input point file. "text" writes outputpoints.txt with the input and output
+ *   indices, points and deformation of each point. "compact" writes only the output points,
+ *   as a transformix input point file in world coordinates. "binary" writes the output
+ *   points to outputpoints.bin, as raw little endian doubles, which is also accepted as input
+ *   point file. The input point file, a text file or a .bin file, is read and transformed in
+ *   chunks, by multiple threads. For a .vtk input file, "binary" writes a binary VTK file,
+ *   "text" and "compact" an ASCII one. Without this parameter, outputpoints.vtk has the
+ *   file type of the input.\n
+ *   example: <tt>(OutputPointsFormat "binary")</tt>\n
+ *   Default: "text".
+ * \parameter UseBinaryFormatForTransformationParameters: Whether to write the transform
+ *   parameters to a binary file next to the transform parameter file, instead of as text
+ *   in (TransformParameters ...), which then holds the name of the binary file. The file
+ *   holds the raw little endian values, and is read without parsing.\n
+ *   example: <tt>(UseBinaryFormatForTransformationParameters "true")</tt>\n
+ *   Default: "false".
+ * \parameter BinaryTransformParametersComponentType: The type of the values in the binary
+ *   file, "double" or "float". Floats halve the size of the file, at the cost of precision.\n
+ *   example: <tt>(BinaryTransformParametersComponentType "float")</tt>\n
+ *   Default: "double".
+ * \parameter InverseDeformationFieldMaximumNumberOfIterations: The maximum number of
+ *   Newton iterations per voxel of transformix -def inverse.\n
+ *   example: <tt>(InverseDeformationFieldMaximumNumberOfIterations 100)</tt>\n
+ *   Default: 50.
+ * \parameter InverseDeformationFieldTolerance: The maximum distance between the transformed
+ *   inverse and the voxel of transformix -def inverse, relative to the smallest voxel spacing.\n
+ *   example: <tt>(InverseDeformationFieldTolerance 0.01)</tt>\n
+ *   Default: 0.001.
  *
  * \transformparameter UseDirectionCosines: Controls whether to use or ignore the
  * direction cosines (world matrix, transform matrix) set in the images.
@@ -71,6 +122,16 @@ namespace elastix
  *   "Compose" by composition: \f$T(x) = T_1 ( T_0(x) )\f$.\n
  *   example: <tt>(HowToCombineTransforms "Add")</tt>\n
  *   Default: "Compose".
+ * \transformparameter UseBinaryFormatForTransformationParameters: Whether the
+ *   TransformParameters entry holds the name of a binary file with the parameters.
+ *   If the file is not found at this name, it is looked for in the directory of
+ *   the transform parameter file.\n
+ *   example: <tt>(UseBinaryFormatForTransformationParameters "true")</tt>\n
+ *   Default: "false".
+ * \transformparameter BinaryTransformParametersComponentType: The type of the values
+ *   in the binary file, "double" or "float".\n
+ *   example: <tt>(BinaryTransformParametersComponentType "float")</tt>\n
+ *   Default: "double".
  * \transformparameter Size: The size (number of voxels in each dimension) of the fixed image
  * that was used during registration, and which is used for resampling the deformed moving image.\n
  * example: <tt>(Size 100 90 90)</tt>\n
@@ -120,6 +181,9 @@ namespace elastix
  *    It is also possible to deform all points, thereby generating a deformation field
  *    image. This is done by:\n
  *    example: <tt>-def all</tt> \n
+ *    The deformation field of the inverse transform, on the same grid, is generated by
+ *    inverting the transform at each voxel, and written as inverseDeformationField:\n
+ *    example: <tt>-def inverse</tt> \n
  *
  * \ingroup Transforms
  * \ingroup ComponentBaseClasses
@@ -181,6 +245,8 @@ public:
     itkGetStaticConstMacro( FixedImageDimension ) >   CombinationTransformType;
   typedef typename
     CombinationTransformType::InitialTransformType InitialTransformType;
+  typedef itk::BakedDisplacementFieldTransform< CoordRepType,
+    itkGetStaticConstMacro( FixedImageDimension ) >   BakedInitialTransformType;
 
   /** Typedef's from Transform. */
   typedef typename ITKBaseType::ParametersType ParametersType;
@@ -195,6 +261,7 @@ public:
     float, FixedImageDimension >                      VectorPixelType;
   typedef itk::Image<
     VectorPixelType, FixedImageDimension >            DeformationFieldImageType;
+  typedef itk::ImageSource< DeformationFieldImageType > DeformationFieldSourceType;
 
   /** Typedefs needed for AutomaticScalesEstimation function */
   typedef typename RegistrationType::ITKBaseType      ITKRegistrationType;
@@ -287,6 +354,12 @@ public:
    */
   virtual void ReadInitialTransformFromVector( const size_t index );
 
+  /** Function to replace the initial transform by a BakedDisplacementFieldTransform,
+   * if BakeInitialTransform is true. The grid is the fixed image, or, if there is
+   * none, the image described by the current configuration.
+   */
+  virtual void BakeInitialTransform( void );
+
   /** Function to transform coordinates from fixed to moving image. */
   virtual void TransformPoints( void ) const;
 
@@ -306,17 +379,29 @@ public:
   /** Function to transform all coordinates from fixed to moving image. */
   typename DeformationFieldImageType::Pointer GenerateDeformationFieldImage( void ) const;
 
-  void WriteDeformationFieldImage( typename DeformationFieldImageType::Pointer ) const;
+  void WriteDeformationFieldImage( typename DeformationFieldImageType::Pointer,
+    const std::string & baseName = "deformationField" ) const;
 
   /** Legacy function that calls GenerateDeformationFieldImage and WriteDeformationFieldImage. */
   virtual void TransformPointsAllPoints(void) const;
 
+  /** Compute the displacement field of the inverse transform, by Newton
+   * iterations for each voxel, and write it as inverseDeformationField.
+   */
+  virtual void TransformPointsAllPointsInverse( void ) const;
+
   /** Function to compute the determinant of the spatial Jacobian. */
   virtual void ComputeDeterminantOfSpatialJacobian( void ) const;
 
   /** Function to compute the determinant of the spatial Jacobian. */
   virtual void ComputeSpatialJacobian( void ) const;
 
+  /** Compute a hash of the transform and of its initial transforms: their
+   * class names, parameters, fixed parameters and how they are combined.
+   * Used as part of the key of the transformix result cache.
+   */
+  itk::DataHash::HashType ComputeTransformHash( void ) const;
+
   /** Makes sure that the final parameters from the registration components
    * are copied, set, and stored.
    */
@@ -334,6 +419,8 @@ protected:
    * \li N=10000 points are sampled on a uniform grid on the fixed image.
    * \li Jacobians dT/dmu are computed
    * \li Scales_i = 1/N sum_x || dT / dmu_i ||^2
+   * The samples are divided over the threads, which only visit the nonzero
+   * Jacobian columns, see AccumulateSquaredJacobians().
    */
   void AutomaticScalesEstimation( ScalesType & scales ) const;
 
@@ -347,6 +434,18 @@ protected:
   void AutomaticScalesEstimationStackTransform(
     const unsigned int & numSubTransforms, ScalesType & scales ) const;
 
+  /** Create the pipeline that generates the deformation field, or that of
+   * the inverse transform, without updating it. The filter that computes the
+   * deformations is returned in generator, to be able to track its progress.
+   */
+  typename DeformationFieldSourceType::Pointer CreateDeformationFieldPipeline(
+    itk::ProcessObject::Pointer & generator, const bool inverse = false ) const;
+
+  /** Get the number of slabs in which the deformation field and the spatial
+   * Jacobian images are generated and written.
+   */
+  unsigned int GetNumberOfStreamDivisions( void ) const;
+
   /** Member variables. */
   ParametersType * m_TransformParametersPointer;
   std::string      m_TransformParametersFileName;
@@ -370,12 +469,87 @@ private:
     }
 
     const Self * t0 = dynamic_cast<const Self *>( this->GetInitialTransform() );
+
+    /** A baked initial transform was read from the file of the transform it replaces. */
+    if( !t0 )
+    {
+      const BakedInitialTransformType * baked
+        = dynamic_cast<const BakedInitialTransformType *>( this->GetInitialTransform() );
+      if( baked )
+      {
+        t0 = dynamic_cast<const Self *>( baked->GetBakedTransform() );
+      }
+    }
     return t0->GetTransformParametersFileName();
   }
 
   /** Boolean to decide whether or not the transform parameters are written in binary format. */
   bool m_UseBinaryFormatForTransformationParameters;
 
+  /** The formats of TransformPointsSomePoints(). */
+  enum OutputPointsFormatType { TextOutputPoints, CompactOutputPoints, BinaryOutputPoints };
+
+  /** The chunk of points that TransformPointsSomePoints() transforms, shared
+   * by the work units. Each work unit writes the text or the values of its
+   * points to its own buffer, which are written in order afterwards.
+   */
+  struct TransformPointsThreaderParameterType
+  {
+    const Self *                 m_Transform;
+    const FixedImageType *       m_FixedImage;
+    const MovingImageType *      m_MovingImage;
+    const InputPointType *       m_InputPoints;
+    bool                         m_PointsAreIndices;
+    OutputPointsFormatType       m_OutputPointsFormat;
+    unsigned long                m_FirstPointNumber;
+    unsigned long                m_NumberOfPoints;
+    unsigned long                m_PointsPerWorkUnit;
+    std::vector< std::string > * m_Texts;
+    double *                     m_OutputValues;
+  };
+
+  /** Transforms the points of a work unit of TransformPointsSomePoints(). */
+  static itk::ITK_THREAD_RETURN_TYPE TransformPointsThreaderCallback( void * arg );
+
+  /** The points of the mesh that TransformPointsSomePointsVTK() transforms
+   * in place, shared by the work units.
+   */
+  struct TransformMeshPointsThreaderParameterType
+  {
+    const Self *     m_Transform;
+    InputPointType * m_Points;
+    unsigned long    m_NumberOfPoints;
+    unsigned long    m_PointsPerWorkUnit;
+  };
+
+  /** Transforms the points of a work unit of TransformPointsSomePointsVTK(). */
+  static itk::ITK_THREAD_RETURN_TYPE TransformMeshPointsThreaderCallback( void * arg );
+
+  /** The sample points of the automatic scales estimation, shared by the
+   * work units. Each work unit sums the squared Jacobian columns of its
+   * points in its own vector, which are added in order afterwards.
+   */
+  struct ScalesEstimationThreaderParameterType
+  {
+    const Self *            m_Transform;
+    const InputPointType *  m_Points;
+    unsigned long           m_NumberOfPoints;
+    unsigned long           m_PointsPerWorkUnit;
+    std::vector< double > * m_SumsOfSquares;
+    unsigned int            m_NumberOfParameters;
+  };
+
+  /** Sums the squared Jacobian columns of the points of a work unit. */
+  static itk::ITK_THREAD_RETURN_TYPE ScalesEstimationThreaderCallback( void * arg );
+
+  /** Compute scales_i = 1/N sum_x || dT / dmu_i ||^2 over the given points,
+   * with the points divided over the threads. Only the nonzero Jacobian
+   * columns are visited, so the cost scales with their number, and not with
+   * the number of parameters.
+   */
+  void AccumulateSquaredJacobians( const std::vector< InputPointType > & points,
+    ScalesType & scales ) const;
+
 };
 
 } // end namespace elastix
@@ -25,18 +25,22 @@
 #include "itkTransformixInputPointFileReader.h"
 #include "vnl/vnl_math.h"
 #include <itksys/SystemTools.hxx>
+#include <algorithm>
+#include <cmath>
 #include "itkVector.h"
-#include "itkTransformToDisplacementFieldFilter.h"
+#include "itkAdvancedTransformToDisplacementFieldSource.h"
+#include "itkAdvancedTransformToInverseDisplacementFieldSource.h"
 #include "itkTransformToDeterminantOfSpatialJacobianSource.h"
 #include "itkTransformToSpatialJacobianSource.h"
 #include "itkImageFileWriter.h"
 #include "itkImageGridSampler.h"
 #include "itkContinuousIndex.h"
 #include "itkChangeInformationImageFilter.h"
+#include "itkByteSwapper.h"
 #include "itkMesh.h"
 #include "itkMeshFileReader.h"
 #include "itkMeshFileWriter.h"
-#include "itkTransformMeshFilter.h"
+#include "itkPersistentThreadPool.h"
 
 namespace itk
 {
@@ -421,13 +425,58 @@ TransformBase< TElastix >
     /** Read the TransformParameters. */
     std::size_t numberOfParametersFound = 0;
     std::vector< ValueType > vecPar;
-    if( useBinaryFormatForTransformationParameters )
+    const typename ConfigurationType::TransformParametersType & binaryParameters
+      = this->m_Configuration->GetTransformParameters();
+    if( useBinaryFormatForTransformationParameters && binaryParameters.GetSize() > 0 )
+    {
+      /** The parameters are given in memory, by the library interface. */
+      numberOfParametersFound = binaryParameters.GetSize();
+      if( numberOfParametersFound == numberOfParameters )
+      {
+        std::copy( binaryParameters.begin(), binaryParameters.end(),
+          this->m_TransformParametersPointer->begin() );
+      }
+    }
+    else if( useBinaryFormatForTransformationParameters )
     {
       std::string dataFileName = "";
       this->m_Configuration->ReadParameter( dataFileName, "TransformParameters", 0 );
+      std::string componentType = "double";
+      this->m_Configuration->ReadParameter( componentType,
+        "BinaryTransformParametersComponentType", 0, false );
+
+      /** The file may have been moved together with the transform parameter file. */
+      const std::string transformParametersFileName
+        = this->m_Configuration->GetCommandLineArgument( "-tp" );
+      if( !itksys::SystemTools::FileExists( dataFileName.c_str(), true ) && !transformParametersFileName.empty() )
+      {
+        const std::string nextToParameterFile
+          = itksys::SystemTools::GetFilenamePath( transformParametersFileName ) + "/"
+          + itksys::SystemTools::GetFilenameName( dataFileName );
+        if( itksys::SystemTools::FileExists( nextToParameterFile.c_str(), true ) )
+        {
+          dataFileName = nextToParameterFile;
+        }
+      }
+
+      /** Read the little endian values directly into the parameters. */
       std::ifstream infile( dataFileName.c_str(), std::ios::in | std::ios::binary );
-      infile.read( reinterpret_cast<char *>( this->m_TransformParametersPointer->data_block() ), sizeof( ValueType ) * numberOfParameters );
-      numberOfParametersFound = infile.gcount() / sizeof( ValueType ); // for sanity check
+      if( componentType == "float" )
+      {
+        std::vector< float > values( numberOfParameters );
+        infile.read( reinterpret_cast< char * >( values.data() ), sizeof( float ) * numberOfParameters );
+        numberOfParametersFound = infile.gcount() / sizeof( float ); // for sanity check
+        itk::ByteSwapper< float >::SwapRangeFromSystemToLittleEndian( values.data(), numberOfParametersFound );
+        std::copy( values.begin(), values.begin() + numberOfParametersFound,
+          this->m_TransformParametersPointer->begin() );
+      }
+      else
+      {
+        infile.read( reinterpret_cast< char * >( this->m_TransformParametersPointer->data_block() ), sizeof( ValueType ) * numberOfParameters );
+        numberOfParametersFound = infile.gcount() / sizeof( ValueType ); // for sanity check
+        itk::ByteSwapper< ValueType >::SwapRangeFromSystemToLittleEndian(
+          this->m_TransformParametersPointer->data_block(), numberOfParametersFound );
+      }
       infile.close();
     }
     else
@@ -591,6 +640,7 @@ TransformBase< TElastix >
     if( testPointer )
     {
       this->SetInitialTransform( testPointer );
+      this->BakeInitialTransform();
     }
 
   } // end if
@@ -653,6 +703,7 @@ TransformBase< TElastix >
     if( testPointer )
     {
       this->SetInitialTransform( testPointer );
+      this->BakeInitialTransform();
     }
 
   } // end if
@@ -660,6 +711,115 @@ TransformBase< TElastix >
 } // end ReadInitialTransformFromFile()
 
 
+/**
+ * ******************* BakeInitialTransform *************
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::BakeInitialTransform( void )
+{
+  /** Check if the initial transform should be baked. Linear transforms are
+   * cheaper to evaluate than a displacement field, so they are kept.
+   */
+  bool bakeInitialTransform = false;
+  this->m_Configuration->ReadParameter( bakeInitialTransform,
+    "BakeInitialTransform", 0, false );
+  const InitialTransformType * initialTransform = this->GetInitialTransform();
+  if( !bakeInitialTransform || initialTransform == 0 || initialTransform->IsLinear() )
+  {
+    return;
+  }
+
+  double gridSpacingFactor = 1.0;
+  this->m_Configuration->ReadParameter( gridSpacingFactor,
+    "BakedInitialTransformGridSpacingFactor", 0, false );
+  if( !( gridSpacingFactor > 0.0 ) )
+  {
+    itkExceptionMacro( << "ERROR: BakedInitialTransformGridSpacingFactor should be "
+                       << "positive, but is " << gridSpacingFactor );
+  }
+
+  /** Get the geometry of the fixed image. In transformix there is none, so
+   * it is read from the configuration, like the resampler does.
+   */
+  typedef typename BakedInitialTransformType::GridSizeType      GridSizeType;
+  typedef typename BakedInitialTransformType::GridSpacingType   GridSpacingType;
+  typedef typename BakedInitialTransformType::GridOriginType    GridOriginType;
+  typedef typename BakedInitialTransformType::GridDirectionType GridDirectionType;
+  typedef typename FixedImageType::IndexType                    FixedImageIndexType;
+
+  GridSizeType        size;
+  FixedImageIndexType index;
+  GridSpacingType     spacing;
+  GridOriginType      origin;
+  GridDirectionType   direction;
+  const FixedImageType * fixedImage = this->m_Elastix->GetFixedImage();
+  if( fixedImage )
+  {
+    size      = fixedImage->GetLargestPossibleRegion().GetSize();
+    index     = fixedImage->GetLargestPossibleRegion().GetIndex();
+    spacing   = fixedImage->GetSpacing();
+    origin    = fixedImage->GetOrigin();
+    direction = fixedImage->GetDirection();
+  }
+  else
+  {
+    direction.SetIdentity();
+    for( unsigned int i = 0; i < FixedImageDimension; i++ )
+    {
+      size[ i ] = 0;
+      this->m_Configuration->ReadParameter( size[ i ], "Size", i );
+      index[ i ] = 0;
+      this->m_Configuration->ReadParameter( index[ i ], "Index", i );
+      spacing[ i ] = 1.0;
+      this->m_Configuration->ReadParameter( spacing[ i ], "Spacing", i );
+      origin[ i ] = 0.0;
+      this->m_Configuration->ReadParameter( origin[ i ], "Origin", i );
+      for( unsigned int j = 0; j < FixedImageDimension; j++ )
+      {
+        this->m_Configuration->ReadParameter( direction( j, i ),
+          "Direction", i * FixedImageDimension + j );
+      }
+    }
+    if( !this->GetElastix()->GetUseDirectionCosines() )
+    {
+      direction.SetIdentity();
+    }
+  }
+
+  /** Cover the same extent with the coarser grid, starting at the first voxel. */
+  GridSizeType    gridSize;
+  GridSpacingType gridSpacing;
+  GridOriginType  gridOrigin = origin;
+  for( unsigned int i = 0; i < FixedImageDimension; i++ )
+  {
+    gridSpacing[ i ] = spacing[ i ] * gridSpacingFactor;
+    gridSize[ i ]    = size[ i ] == 0 ? 0 : static_cast< typename GridSizeType::SizeValueType >(
+      std::ceil( ( size[ i ] - 1 ) / gridSpacingFactor - 1e-6 ) ) + 1;
+    for( unsigned int j = 0; j < FixedImageDimension; j++ )
+    {
+      gridOrigin[ i ] += direction( i, j ) * spacing[ j ] * index[ j ];
+    }
+  }
+
+  elxout << "Baking the initial transform on a grid of size " << gridSize
+         << " and spacing " << gridSpacing << " ..." << std::endl;
+
+  typename BakedInitialTransformType::Pointer bakedTransform = BakedInitialTransformType::New();
+  bakedTransform->SetBakedTransform( initialTransform );
+  bakedTransform->SetGridSize( gridSize );
+  bakedTransform->SetGridSpacing( gridSpacing );
+  bakedTransform->SetGridOrigin( gridOrigin );
+  bakedTransform->SetGridDirection( direction );
+  bakedTransform->ComputeDisplacementField();
+
+  this->SetInitialTransform( bakedTransform );
+
+} // end BakeInitialTransform()
+
+
 /**
  * ******************* WriteToFile ******************************
  */
@@ -702,13 +862,35 @@ TransformBase< TElastix >
   {
     if( this->m_UseBinaryFormatForTransformationParameters )
     {
-      /** Writing in binary format is faster for large vectors, and slightly more accurate. */
+      /** Writing in binary format is faster for large vectors, and slightly more accurate.
+       * The values are written little endian, as doubles, or as floats on request.
+       */
+      std::string componentType = "double";
+      this->m_Configuration->ReadParameter( componentType,
+        "BinaryTransformParametersComponentType", 0, false );
+      if( componentType != "float" )
+      {
+        componentType = "double";
+      }
+
       std::string dataFileName = this->GetTransformParametersFileName();
       dataFileName += ".dat";
       xout[ "transpar" ] << "(TransformParameters \"" << dataFileName << "\")" << std::endl;
+      xout[ "transpar" ] << "(BinaryTransformParametersComponentType \""
+                         << componentType << "\")" << std::endl;
 
       std::ofstream outfile( dataFileName.c_str(), ios::out | ios::binary );
-      outfile.write( reinterpret_cast<const char *>( param.data_block() ), sizeof( ValueType ) * nrP );
+      if( componentType == "float" )
+      {
+        const std::vector< float > values( param.begin(), param.end() );
+        itk::ByteSwapper< float >::SwapWriteRangeFromSystemToLittleEndian(
+          const_cast< float * >( values.data() ), nrP, &outfile );
+      }
+      else
+      {
+        itk::ByteSwapper< ValueType >::SwapWriteRangeFromSystemToLittleEndian(
+          const_cast< ValueType * >( param.data_block() ), nrP, &outfile );
+      }
       outfile.close();
     }
     else
@@ -893,8 +1075,10 @@ TransformBase< TElastix >
   paramsMap->insert( make_pair( parameterName, parameterValues ) );
   parameterValues.clear();
 
-  /** Write the parameters of this transform. */
-  if( this->m_ReadWriteTransformParameters )
+  /** Write the parameters of this transform. In the binary format, the
+   * library interface passes them in memory, see ElastixFilter.
+   */
+  if( this->m_ReadWriteTransformParameters && !this->m_UseBinaryFormatForTransformationParameters )
   {
     /** In this case, write in a normal way to the parameter file. */
     parameterName = "TransformParameters";
@@ -930,6 +1114,12 @@ TransformBase< TElastix >
   paramsMap->insert( make_pair( parameterName, parameterValues ) );
   parameterValues.clear();
 
+  /** Write the way the transform parameters are passed. */
+  parameterName = "UseBinaryFormatForTransformationParameters";
+  parameterValues.push_back( this->m_UseBinaryFormatForTransformationParameters ? "true" : "false" );
+  paramsMap->insert( make_pair( parameterName, parameterValues ) );
+  parameterValues.clear();
+
   /** Write image specific things. */
 // xout["transpar"] << std::endl << "// Image specific" << std::endl;
 
@@ -1093,7 +1283,7 @@ TransformBase< TElastix >
   }
 
   /** If there is an input point-file? */
-  if( def != "" && def != "all" )
+  if( def != "" && def != "all" && def != "inverse" )
   {
     if( itksys::SystemTools::StringEndsWith( def.c_str(), ".vtk" )
       || itksys::SystemTools::StringEndsWith( def.c_str(), ".VTK" ) )
@@ -1115,6 +1305,12 @@ TransformBase< TElastix >
            << "The result is a deformation field." << std::endl;
     this->TransformPointsAllPoints();
   }
+  else if( def == "inverse" )
+  {
+    elxout << "  The transform is inverted on all points. "
+           << "The result is the deformation field of the inverse transform." << std::endl;
+    this->TransformPointsAllPointsInverse();
+  }
   else
   {
     // just a message
@@ -1132,10 +1328,14 @@ TransformBase< TElastix >
  * these fixed-image coordinates to moving-image
  * coordinates.
  *
- * Reads the inputpoints from a text file, either as index or as point.
- * Computes the transformed points, converts them back to an index and compute
- * the deformation vector as the difference between the outputpoint and
- * the input point. Save the results.
+ * Reads the inputpoints from a text file, either as index or as point,
+ * or from a binary file. Computes the transformed points, converts them back
+ * to an index and compute the deformation vector as the difference between
+ * the outputpoint and the input point. Save the results.
+ *
+ * The points are read, transformed and written in chunks, so that the memory
+ * use does not grow with the number of points. The points of a chunk are
+ * transformed and formatted by multiple threads.
  */
 
 template< class TElastix >
@@ -1147,15 +1347,7 @@ TransformBase< TElastix >
   typedef typename FixedImageType::RegionType           FixedImageRegionType;
   typedef typename FixedImageType::PointType            FixedImageOriginType;
   typedef typename FixedImageType::SpacingType          FixedImageSpacingType;
-  typedef typename FixedImageType::IndexType            FixedImageIndexType;
-  typedef typename FixedImageIndexType::IndexValueType  FixedImageIndexValueType;
-  typedef typename MovingImageType::IndexType           MovingImageIndexType;
-  typedef typename MovingImageIndexType::IndexValueType MovingImageIndexValueType;
-  typedef
-    itk::ContinuousIndex< double, FixedImageDimension >   FixedImageContinuousIndexType;
-  typedef
-    itk::ContinuousIndex< double, MovingImageDimension >  MovingImageContinuousIndexType;
-  typedef typename FixedImageType::DirectionType FixedImageDirectionType;
+  typedef typename FixedImageType::DirectionType        FixedImageDirectionType;
 
   typedef unsigned char DummyIPPPixelType;
   typedef itk::DefaultStaticMeshTraits<
@@ -1165,22 +1357,44 @@ TransformBase< TElastix >
     FixedImageDimension, MeshTraitsType >                PointSetType;
   typedef itk::TransformixInputPointFileReader<
     PointSetType >                                      IPPReaderType;
-  typedef itk::Vector< float, FixedImageDimension > DeformationVectorType;
+
+  /** The number of points that is read, transformed and written at once. */
+  const unsigned long pointsPerChunk = 1UL << 16;
+
+  /** Read the format of the output points. */
+  std::string outputPointsFormatString = "text";
+  this->m_Configuration->ReadParameter( outputPointsFormatString,
+    "OutputPointsFormat", 0, false );
+  OutputPointsFormatType outputPointsFormat = TextOutputPoints;
+  if( outputPointsFormatString == "compact" )
+  {
+    outputPointsFormat = CompactOutputPoints;
+  }
+  else if( outputPointsFormatString == "binary" )
+  {
+    outputPointsFormat = BinaryOutputPoints;
+  }
+  else if( outputPointsFormatString != "text" )
+  {
+    itkExceptionMacro( << "ERROR: OutputPointsFormat \"" << outputPointsFormatString
+                       << "\" is not supported. Use \"text\", \"compact\" or \"binary\"." );
+  }
 
   /** Construct an ipp-file reader. */
   typename IPPReaderType::Pointer ippReader = IPPReaderType::New();
   ippReader->SetFileName( filename.c_str() );
 
-  /** Read the input points. */
+  /** Read the header of the input point file. */
   elxout << "  Reading input point file: " << filename << std::endl;
   try
   {
-    ippReader->Update();
+    ippReader->UpdateOutputInformation();
   }
   catch( itk::ExceptionObject & err )
   {
     xl::xout[ "error" ] << "  Error while opening input point file." << std::endl;
     xl::xout[ "error" ] << err << std::endl;
+    return;
   }
 
   /** Some user-feedback. */
@@ -1192,20 +1406,9 @@ TransformBase< TElastix >
   {
     elxout << "  Input points are specified in world coordinates." << std::endl;
   }
-  unsigned int nrofpoints = ippReader->GetNumberOfPoints();
+  const unsigned long nrofpoints = ippReader->GetNumberOfPoints();
   elxout << "  Number of specified input points: " << nrofpoints << std::endl;
 
-  /** Get the set of input points. */
-  typename PointSetType::Pointer inputPointSet = ippReader->GetOutput();
-
-  /** Create the storage classes. */
-  std::vector< FixedImageIndexType >   inputindexvec(  nrofpoints );
-  std::vector< InputPointType >        inputpointvec(  nrofpoints );
-  std::vector< OutputPointType >       outputpointvec( nrofpoints );
-  std::vector< FixedImageIndexType >   outputindexfixedvec( nrofpoints );
-  std::vector< MovingImageIndexType >  outputindexmovingvec( nrofpoints );
-  std::vector< DeformationVectorType > deformationvec( nrofpoints );
-
   /** Make a temporary image with the right region info,
    * which we can use to convert between points and indices.
    * By taking the image from the resampler output, the UseDirectionCosines
@@ -1228,149 +1431,267 @@ TransformBase< TElastix >
   dummyImage->SetSpacing( spacing );
   dummyImage->SetDirection( direction );
 
-  /** Temp vars */
-  FixedImageContinuousIndexType  fixedcindex;
-  MovingImageContinuousIndexType movingcindex;
-
   /** Also output moving image indices if a moving image was supplied. */
-  bool alsoMovingIndices = false;
   typename MovingImageType::Pointer movingImage = this->GetElastix()->GetMovingImage();
-  if( movingImage.IsNotNull() )
+
+  /** Create filename and file stream. */
+  std::string outputPointsFileName = this->m_Configuration
+    ->GetCommandLineArgument( "-out" );
+  outputPointsFileName += outputPointsFormat == BinaryOutputPoints ?
+    "outputpoints.bin" : "outputpoints.txt";
+  std::ofstream outputPointsFile( outputPointsFileName.c_str(),
+    std::ios::out | std::ios::binary );
+  elxout << "  The transformed points are saved in: "
+         <<  outputPointsFileName << std::endl;
+
+  if( outputPointsFormat == CompactOutputPoints )
   {
-    alsoMovingIndices = true;
+    outputPointsFile << "point\n" << nrofpoints << "\n";
   }
 
-  /** Read the input points, as index or as point. */
-  if( !( ippReader->GetPointsAreIndices() ) )
+  /** Set the parameters that are the same for all chunks. */
+  const itk::PersistentThreadPool::Pointer pool = itk::PersistentThreadPool::GetInstance();
+  std::vector< std::string >               texts;
+  std::vector< InputPointType >            inputPoints;
+  std::vector< double >                    outputValues;
+
+  TransformPointsThreaderParameterType temp;
+  temp.m_Transform          = this;
+  temp.m_FixedImage         = dummyImage.GetPointer();
+  temp.m_MovingImage        = movingImage.GetPointer();
+  temp.m_PointsAreIndices   = ippReader->GetPointsAreIndices();
+  temp.m_OutputPointsFormat = outputPointsFormat;
+  temp.m_FirstPointNumber   = 0;
+  temp.m_Texts              = &texts;
+
+  /** Read, transform and write the points chunk by chunk. */
+  elxout << "  The input points are transformed." << std::endl;
+  while( true )
+  {
+    unsigned long numberOfPoints = 0;
+    try
+    {
+      numberOfPoints = ippReader->ReadPoints( inputPoints, pointsPerChunk );
+    }
+    catch( itk::ExceptionObject & err )
+    {
+      xl::xout[ "error" ] << "  Error while reading input point file." << std::endl;
+      xl::xout[ "error" ] << err << std::endl;
+      return;
+    }
+    if( numberOfPoints == 0 )
+    {
+      break;
+    }
+
+    const itk::ThreadIdType numberOfWorkUnits = static_cast< itk::ThreadIdType >( std::max< unsigned long >( 1,
+      std::min< unsigned long >( pool->GetMaximumNumberOfThreads(), numberOfPoints / 256 ) ) );
+    texts.assign( numberOfWorkUnits, std::string() );
+    if( outputPointsFormat == BinaryOutputPoints )
+    {
+      outputValues.resize( numberOfPoints * MovingImageDimension );
+    }
+
+    temp.m_InputPoints       = inputPoints.data();
+    temp.m_NumberOfPoints    = numberOfPoints;
+    temp.m_PointsPerWorkUnit = ( numberOfPoints + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+    temp.m_OutputValues      = outputValues.data();
+
+    pool->SingleMethodExecute( numberOfWorkUnits, Self::TransformPointsThreaderCallback, &temp );
+
+    /** Write the results of the work units in order. */
+    if( outputPointsFormat == BinaryOutputPoints )
+    {
+      outputPointsFile.write( reinterpret_cast< const char * >( outputValues.data() ),
+        static_cast< std::streamsize >( outputValues.size() * sizeof( double ) ) );
+    }
+    else
+    {
+      for( const auto & text : texts )
+      {
+        outputPointsFile << text;
+      }
+    }
+    temp.m_FirstPointNumber += numberOfPoints;
+  }
+
+} // end TransformPointsSomePoints()
+
+
+/**
+ * ************** TransformPointsThreaderCallback *********************
+ */
+
+template< class TElastix >
+itk::ITK_THREAD_RETURN_TYPE
+TransformBase< TElastix >
+::TransformPointsThreaderCallback( void * arg )
+{
+  /** Typedef's. */
+  typedef typename FixedImageType::IndexType            FixedImageIndexType;
+  typedef typename FixedImageIndexType::IndexValueType  FixedImageIndexValueType;
+  typedef typename MovingImageType::IndexType           MovingImageIndexType;
+  typedef typename MovingImageIndexType::IndexValueType MovingImageIndexValueType;
+  typedef
+    itk::ContinuousIndex< double, FixedImageDimension >   FixedImageContinuousIndexType;
+  typedef
+    itk::ContinuousIndex< double, MovingImageDimension >  MovingImageContinuousIndexType;
+  typedef itk::Vector< float, FixedImageDimension > DeformationVectorType;
+
+  const itk::PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< itk::PersistentThreadPool::WorkUnitInfo * >( arg );
+  const TransformPointsThreaderParameterType * temp
+    = static_cast< TransformPointsThreaderParameterType * >( infoStruct->UserData );
+
+  const unsigned long begin = std::min( infoStruct->WorkUnitID * temp->m_PointsPerWorkUnit, temp->m_NumberOfPoints );
+  const unsigned long end   = std::min( begin + temp->m_PointsPerWorkUnit, temp->m_NumberOfPoints );
+
+  const FixedImageType *  dummyImage  = temp->m_FixedImage;
+  const MovingImageType * movingImage = temp->m_MovingImage;
+
+  std::ostringstream outputPointsFile;
+  outputPointsFile << std::showpoint << std::fixed;
+
+  /** Temp vars */
+  FixedImageContinuousIndexType  fixedcindex;
+  MovingImageContinuousIndexType movingcindex;
+  FixedImageIndexType            inputindex;
+  InputPointType                 inputpoint;
+  FixedImageIndexType            outputindexfixed;
+  MovingImageIndexType           outputindexmoving;
+  DeformationVectorType          deformation;
+
+  for( unsigned long j = begin; j < end; ++j )
   {
-    for( unsigned int j = 0; j < nrofpoints; j++ )
+    /** Read the input point, as index or as point. */
+    if( !temp->m_PointsAreIndices )
     {
       /** Compute index of nearest voxel in fixed image. */
-      InputPointType point; point.Fill( 0.0f );
-      inputPointSet->GetPoint( j, &point );
-      inputpointvec[ j ] = point;
+      inputpoint = temp->m_InputPoints[ j ];
       dummyImage->TransformPhysicalPointToContinuousIndex(
-        point, fixedcindex );
+        inputpoint, fixedcindex );
       for( unsigned int i = 0; i < FixedImageDimension; i++ )
       {
-        inputindexvec[ j ][ i ] = static_cast< FixedImageIndexValueType >(
+        inputindex[ i ] = static_cast< FixedImageIndexValueType >(
           itk::Math::Round< double >( fixedcindex[ i ] ) );
       }
     }
-  }
-  else //so: inputasindex
-  {
-    for( unsigned int j = 0; j < nrofpoints; j++ )
+    else //so: inputasindex
     {
       /** The read point from the inutPointSet is actually an index
        * Cast to the proper type.
        */
-      InputPointType point; point.Fill( 0.0f );
-      inputPointSet->GetPoint( j, &point );
       for( unsigned int i = 0; i < FixedImageDimension; i++ )
       {
-        inputindexvec[ j ][ i ] = static_cast< FixedImageIndexValueType >(
-          itk::Math::Round< double >( point[ i ] ) );
+        inputindex[ i ] = static_cast< FixedImageIndexValueType >(
+          itk::Math::Round< double >( temp->m_InputPoints[ j ][ i ] ) );
       }
       /** Compute the input point in physical coordinates. */
-      dummyImage->TransformIndexToPhysicalPoint(
-        inputindexvec[ j ], inputpointvec[ j ] );
+      dummyImage->TransformIndexToPhysicalPoint( inputindex, inputpoint );
     }
-  }
 
-  /** Apply the transform. */
-  elxout << "  The input points are transformed." << std::endl;
-  for( unsigned int j = 0; j < nrofpoints; j++ )
-  {
     /** Call TransformPoint. */
-    outputpointvec[ j ] = this->GetAsITKBaseType()->TransformPoint( inputpointvec[ j ] );
+    const OutputPointType outputpoint
+      = temp->m_Transform->GetAsITKBaseType()->TransformPoint( inputpoint );
+
+    if( temp->m_OutputPointsFormat == BinaryOutputPoints )
+    {
+      double * values = temp->m_OutputValues + j * MovingImageDimension;
+      for( unsigned int i = 0; i < MovingImageDimension; i++ )
+      {
+        values[ i ] = outputpoint[ i ];
+      }
+      itk::ByteSwapper< double >::SwapRangeFromSystemToLittleEndian( values, MovingImageDimension );
+      continue;
+    }
+
+    if( temp->m_OutputPointsFormat == CompactOutputPoints )
+    {
+      for( unsigned int i = 0; i < MovingImageDimension; i++ )
+      {
+        outputPointsFile << outputpoint[ i ] << " ";
+      }
+      outputPointsFile << "\n";
+      continue;
+    }
 
     /** Transform back to index in fixed image domain. */
     dummyImage->TransformPhysicalPointToContinuousIndex(
-      outputpointvec[ j ], fixedcindex );
+      outputpoint, fixedcindex );
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputindexfixedvec[ j ][ i ] = static_cast< FixedImageIndexValueType >(
+      outputindexfixed[ i ] = static_cast< FixedImageIndexValueType >(
         itk::Math::Round< double >( fixedcindex[ i ] ) );
     }
 
-    if( alsoMovingIndices )
+    if( movingImage )
     {
       /** Transform back to index in moving image domain. */
       movingImage->TransformPhysicalPointToContinuousIndex(
-        outputpointvec[ j ], movingcindex );
+        outputpoint, movingcindex );
       for( unsigned int i = 0; i < MovingImageDimension; i++ )
       {
-        outputindexmovingvec[ j ][ i ] = static_cast< MovingImageIndexValueType >(
+        outputindexmoving[ i ] = static_cast< MovingImageIndexValueType >(
           itk::Math::Round< double >( movingcindex[ i ] ) );
       }
     }
 
     /** Compute displacement. */
-    deformationvec[ j ].CastFrom( outputpointvec[ j ] - inputpointvec[ j ] );
-  }
+    deformation.CastFrom( outputpoint - inputpoint );
 
-  /** Create filename and file stream. */
-  std::string outputPointsFileName = this->m_Configuration
-    ->GetCommandLineArgument( "-out" );
-  outputPointsFileName += "outputpoints.txt";
-  std::ofstream outputPointsFile( outputPointsFileName.c_str() );
-  outputPointsFile << std::showpoint << std::fixed;
-  elxout << "  The transformed points are saved in: "
-         <<  outputPointsFileName << std::endl;
-
-  /** Print the results. */
-  for( unsigned int j = 0; j < nrofpoints; j++ )
-  {
     /** The input index. */
-    outputPointsFile << "Point\t" << j << "\t; InputIndex = [ ";
+    outputPointsFile << "Point\t" << temp->m_FirstPointNumber + j << "\t; InputIndex = [ ";
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputPointsFile << inputindexvec[ j ][ i ] << " ";
+      outputPointsFile << inputindex[ i ] << " ";
     }
 
     /** The input point. */
     outputPointsFile << "]\t; InputPoint = [ ";
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputPointsFile << inputpointvec[ j ][ i ] << " ";
+      outputPointsFile << inputpoint[ i ] << " ";
     }
 
     /** The output index in fixed image. */
     outputPointsFile << "]\t; OutputIndexFixed = [ ";
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputPointsFile << outputindexfixedvec[ j ][ i ] << " ";
+      outputPointsFile << outputindexfixed[ i ] << " ";
     }
 
     /** The output point. */
     outputPointsFile << "]\t; OutputPoint = [ ";
     for( unsigned int i = 0; i < FixedImageDimension; i++ )
     {
-      outputPointsFile << outputpointvec[ j ][ i ] << " ";
+      outputPointsFile << outputpoint[ i ] << " ";
     }
 
     /** The output point minus the input point. */
     outputPointsFile << "]\t; Deformation = [ ";
     for( unsigned int i = 0; i < MovingImageDimension; i++ )
     {
-      outputPointsFile << deformationvec[ j ][ i ] << " ";
+      outputPointsFile << deformation[ i ] << " ";
     }
 
-    if( alsoMovingIndices )
+    if( movingImage )
     {
       /** The output index in moving image. */
       outputPointsFile << "]\t; OutputIndexMoving = [ ";
       for( unsigned int i = 0; i < MovingImageDimension; i++ )
       {
-        outputPointsFile << outputindexmovingvec[ j ][ i ] << " ";
+        outputPointsFile << outputindexmoving[ i ] << " ";
       }
     }
 
-    outputPointsFile << "]" << std::endl;
-  } // end for nrofpoints
+    outputPointsFile << "]\n";
+  } // end for points
 
-} // end TransformPointsSomePoints()
+  ( *temp->m_Texts )[ infoStruct->WorkUnitID ] = outputPointsFile.str();
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end TransformPointsThreaderCallback()
 
 
 /**
@@ -1398,8 +1719,6 @@ TransformBase< TElastix >
     DummyIPPPixelType, FixedImageDimension, MeshTraitsType > MeshType;
   typedef itk::MeshFileReader< MeshType > MeshReaderType;
   typedef itk::MeshFileWriter< MeshType > MeshWriterType;
-  typedef itk::TransformMeshFilter<
-    MeshType, MeshType, CombinationTransformType >       TransformMeshFilterType;
 
   /** Read the input points. */
   typename MeshReaderType::Pointer meshReader = MeshReaderType::New();
@@ -1413,27 +1732,57 @@ TransformBase< TElastix >
   {
     xl::xout[ "error" ] << "  Error while opening input point file." << std::endl;
     xl::xout[ "error" ] << err << std::endl;
+    return;
   }
 
   /** Some user-feedback. */
   elxout << "  Input points are specified in world coordinates." << std::endl;
-  unsigned long nrofpoints = meshReader->GetOutput()->GetNumberOfPoints();
+  typename MeshType::Pointer mesh = meshReader->GetOutput();
+  unsigned long nrofpoints = mesh->GetNumberOfPoints();
   elxout << "  Number of specified input points: " << nrofpoints << std::endl;
 
-  /** Apply the transform. */
+  /** Apply the transform to the points of the mesh, in place. The cells and
+   * the point and cell data are kept.
+   */
   elxout << "  The input points are transformed." << std::endl;
-  typename TransformMeshFilterType::Pointer meshTransformer = TransformMeshFilterType::New();
-  meshTransformer->SetTransform(
-    const_cast< CombinationTransformType * >( this->GetAsCombinationTransform() ) );
-  meshTransformer->SetInput( meshReader->GetOutput() );
-  try
+  if( nrofpoints > 0 )
   {
-    meshTransformer->Update();
+    const itk::PersistentThreadPool::Pointer pool = itk::PersistentThreadPool::GetInstance();
+    const itk::ThreadIdType                  numberOfWorkUnits = static_cast< itk::ThreadIdType >( std::max< unsigned long >( 1,
+      std::min< unsigned long >( pool->GetMaximumNumberOfThreads(), nrofpoints / 256 ) ) );
+
+    TransformMeshPointsThreaderParameterType temp;
+    temp.m_Transform         = this;
+    temp.m_Points            = &mesh->GetPoints()->ElementAt( 0 );
+    temp.m_NumberOfPoints    = nrofpoints;
+    temp.m_PointsPerWorkUnit = ( nrofpoints + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+
+    try
+    {
+      pool->SingleMethodExecute( numberOfWorkUnits, Self::TransformMeshPointsThreaderCallback, &temp );
+    }
+    catch( itk::ExceptionObject & err )
+    {
+      xl::xout[ "error" ] << "  Error while transforming points." << std::endl;
+      xl::xout[ "error" ] << err << std::endl;
+    }
   }
-  catch( itk::ExceptionObject & err )
+
+  /** Write the output points as binary if OutputPointsFormat is "binary",
+   * as ASCII if it is "text" or "compact", and otherwise like the input.
+   */
+  std::string outputPointsFormat = "";
+  this->m_Configuration->ReadParameter( outputPointsFormat,
+    "OutputPointsFormat", 0, false );
+  bool writeBinary = meshReader->GetMeshIO() != nullptr
+    && meshReader->GetMeshIO()->GetFileType() == itk::MeshIOBase::BINARY;
+  if( outputPointsFormat == "binary" )
   {
-    xl::xout[ "error" ] << "  Error while transforming points." << std::endl;
-    xl::xout[ "error" ] << err << std::endl;
+    writeBinary = true;
+  }
+  else if( outputPointsFormat == "text" || outputPointsFormat == "compact" )
+  {
+    writeBinary = false;
   }
 
   /** Create filename and file stream. */
@@ -1444,7 +1793,15 @@ TransformBase< TElastix >
          <<  outputPointsFileName << std::endl;
   typename MeshWriterType::Pointer meshWriter = MeshWriterType::New();
   meshWriter->SetFileName( outputPointsFileName.c_str() );
-  meshWriter->SetInput( meshTransformer->GetOutput() );
+  meshWriter->SetInput( mesh );
+  if( writeBinary )
+  {
+    meshWriter->SetFileTypeAsBINARY();
+  }
+  else
+  {
+    meshWriter->SetFileTypeAsASCII();
+  }
 
   try
   {
@@ -1459,6 +1816,34 @@ TransformBase< TElastix >
 } // end TransformPointsSomePointsVTK()
 
 
+/**
+ * ************** TransformMeshPointsThreaderCallback *********************
+ */
+
+template< class TElastix >
+itk::ITK_THREAD_RETURN_TYPE
+TransformBase< TElastix >
+::TransformMeshPointsThreaderCallback( void * arg )
+{
+  const itk::PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< itk::PersistentThreadPool::WorkUnitInfo * >( arg );
+  const TransformMeshPointsThreaderParameterType * temp
+    = static_cast< TransformMeshPointsThreaderParameterType * >( infoStruct->UserData );
+
+  const unsigned long begin = std::min( infoStruct->WorkUnitID * temp->m_PointsPerWorkUnit, temp->m_NumberOfPoints );
+  const unsigned long end   = std::min( begin + temp->m_PointsPerWorkUnit, temp->m_NumberOfPoints );
+
+  const ITKBaseType * transform = temp->m_Transform->GetAsITKBaseType();
+  for( unsigned long j = begin; j < end; ++j )
+  {
+    temp->m_Points[ j ] = transform->TransformPoint( temp->m_Points[ j ] );
+  }
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end TransformMeshPointsThreaderCallback()
+
+
 /**
  * ************** TransformPointsAllPoints **********************
  *
@@ -1472,6 +1857,16 @@ void
 TransformBase< TElastix >
 ::TransformPointsAllPoints( void ) const
 {
+  /** Write the deformation field in slabs, without keeping it in memory. */
+  if( !BaseComponent::IsElastixLibrary() && this->GetNumberOfStreamDivisions() > 1 )
+  {
+    itk::ProcessObject::Pointer                  generator;
+    typename DeformationFieldSourceType::Pointer deformationFieldSource
+      = this->CreateDeformationFieldPipeline( generator );
+    WriteDeformationFieldImage( deformationFieldSource->GetOutput() );
+    return;
+  }
+
   typename DeformationFieldImageType::Pointer deformationfield = this->GenerateDeformationFieldImage();
   //put deformation field in container
   this->m_Elastix->SetResultDeformationField( deformationfield.GetPointer() );
@@ -1485,35 +1880,108 @@ TransformBase< TElastix >
 
 
 /**
- * ************** GenerateDeformationFieldImage **********************
- *
- * This function transforms all indexes to a physical point.
- * The difference vector (= the deformation at that index) is
- * stored in an image of vectors (of floats).
+ * ************** TransformPointsAllPointsInverse **********************
  */
 
 template< class TElastix >
-typename TransformBase< TElastix >::DeformationFieldImageType::Pointer
+void
 TransformBase< TElastix >
-::GenerateDeformationFieldImage( void ) const
+::TransformPointsAllPointsInverse( void ) const
+{
+  typedef itk::AdvancedTransformToInverseDisplacementFieldSource<
+    DeformationFieldImageType, CoordRepType >         InverseGeneratorType;
+
+  itk::ProcessObject::Pointer                  generator;
+  typename DeformationFieldSourceType::Pointer deformationFieldSource
+    = this->CreateDeformationFieldPipeline( generator, true );
+
+  /** Track the progress of the inversion. */
+  const auto progressObserver = BaseComponent::IsElastixLibrary() ?
+    nullptr : ProgressCommandType::CreateAndConnect( *generator );
+
+  if( BaseComponent::IsElastixLibrary() )
+  {
+    try
+    {
+      deformationFieldSource->Update();
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      excp.SetLocation( "TransformBase - TransformPointsAllPointsInverse()" );
+      std::string err_str = excp.GetDescription();
+      err_str += "\nError occurred while generating the inverse deformation field image.\n";
+      excp.SetDescription( err_str );
+      throw excp;
+    }
+    typename DeformationFieldImageType::Pointer deformationfield = deformationFieldSource->GetOutput();
+    this->m_Elastix->SetResultDeformationField( deformationfield.GetPointer() );
+  }
+  else
+  {
+    this->WriteDeformationFieldImage( deformationFieldSource->GetOutput(), "inverseDeformationField" );
+  }
+
+  const InverseGeneratorType * inverseGenerator
+    = dynamic_cast< const InverseGeneratorType * >( generator.GetPointer() );
+  if( inverseGenerator != nullptr && inverseGenerator->GetNumberOfUnconvergedPoints() > 0 )
+  {
+    xout[ "warning" ] << "WARNING: The inverse did not reach the tolerance for "
+                      << inverseGenerator->GetNumberOfUnconvergedPoints()
+                      << " points, for example where the transform folds." << std::endl;
+  }
+
+} // end TransformPointsAllPointsInverse()
+
+
+/**
+ * ************** CreateDeformationFieldPipeline **********************
+ */
+
+template< class TElastix >
+typename TransformBase< TElastix >::DeformationFieldSourceType::Pointer
+TransformBase< TElastix >
+::CreateDeformationFieldPipeline( itk::ProcessObject::Pointer & generator, const bool inverse ) const
 {
   /** Typedef's. */
   typedef typename FixedImageType::DirectionType FixedImageDirectionType;
-  typedef itk::TransformToDisplacementFieldFilter<
+  typedef itk::AdvancedTransformToDisplacementFieldSource<
     DeformationFieldImageType, CoordRepType >         DeformationFieldGeneratorType;
+  typedef itk::AdvancedTransformToInverseDisplacementFieldSource<
+    DeformationFieldImageType, CoordRepType >         InverseGeneratorType;
   typedef itk::ChangeInformationImageFilter<
     DeformationFieldImageType >                       ChangeInfoFilterType;
 
-  /** Create an setup deformation field generator. */
-  typename DeformationFieldGeneratorType::Pointer defGenerator
-    = DeformationFieldGeneratorType::New();
-  defGenerator->SetSize(
+  /** Create an setup deformation field generator. It transforms the output
+   * image scanline by scanline, which is faster for B-spline transforms.
+   * The inverse is found by Newton iterations, see the
+   * AdvancedTransformToInverseDisplacementFieldSource.
+   */
+  typename DeformationFieldGeneratorType::Pointer defGenerator;
+  if( inverse )
+  {
+    unsigned int maximumNumberOfIterations = 50;
+    double       tolerance                 = 0.001;
+    this->m_Configuration->ReadParameter( maximumNumberOfIterations,
+      "InverseDeformationFieldMaximumNumberOfIterations", 0, false );
+    this->m_Configuration->ReadParameter( tolerance,
+      "InverseDeformationFieldTolerance", 0, false );
+
+    typename InverseGeneratorType::Pointer inverseGenerator = InverseGeneratorType::New();
+    inverseGenerator->SetMaximumNumberOfIterations( maximumNumberOfIterations );
+    inverseGenerator->SetTolerance( tolerance );
+    defGenerator = inverseGenerator.GetPointer();
+  }
+  else
+  {
+    defGenerator = DeformationFieldGeneratorType::New();
+  }
+  defGenerator->SetOutputSize(
     this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetSize() );
   defGenerator->SetOutputSpacing(
     this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputSpacing() );
   defGenerator->SetOutputOrigin(
     this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputOrigin() );
-  defGenerator->SetOutputStartIndex(
+  defGenerator->SetOutputIndex(
     this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputStartIndex() );
   defGenerator->SetOutputDirection(
     this->m_Elastix->GetElxResamplerBase()->GetAsITKBaseType()->GetOutputDirection() );
@@ -1529,13 +1997,98 @@ TransformBase< TElastix >
   infoChanger->SetChangeDirection( retdc & !this->GetElastix()->GetUseDirectionCosines() );
   infoChanger->SetInput( defGenerator->GetOutput() );
 
+  generator = defGenerator.GetPointer();
+  return infoChanger.GetPointer();
+
+} // end CreateDeformationFieldPipeline()
+
+
+/**
+ * ************** GetNumberOfStreamDivisions **********************
+ */
+
+template< class TElastix >
+unsigned int
+TransformBase< TElastix >
+::GetNumberOfStreamDivisions( void ) const
+{
+  unsigned int numberOfStreamDivisions = 1;
+  this->m_Configuration->ReadParameter( numberOfStreamDivisions, "NumberOfStreamDivisions", 0, false );
+  return std::max( numberOfStreamDivisions, 1u );
+
+} // end GetNumberOfStreamDivisions()
+
+
+/**
+ * ************** ComputeTransformHash **********************
+ */
+
+template< class TElastix >
+itk::DataHash::HashType
+TransformBase< TElastix >
+::ComputeTransformHash( void ) const
+{
+  typedef itk::DataHash HashType;
+  HashType::HashType hash = HashType::InitialValue;
+
+  const InitialTransformType * transform = this->GetAsITKBaseType();
+  while( transform != nullptr )
+  {
+    const CombinationTransformType * combination
+      = dynamic_cast< const CombinationTransformType * >( transform );
+    const InitialTransformType * initialTransform = nullptr;
+    if( combination != nullptr )
+    {
+      hash = HashType::CombineValue( hash, combination->GetUseComposition() );
+      hash = HashType::CombineValue( hash, combination->GetUseAddition() );
+      initialTransform = combination->GetInitialTransform();
+      transform        = combination->GetCurrentTransform();
+    }
+    if( transform != nullptr )
+    {
+      const std::string name = transform->GetNameOfClass();
+      hash = HashType::Combine( hash, name.c_str(), name.size() + 1 );
+      const ParametersType & parameters = transform->GetParameters();
+      hash = HashType::CombineValue( hash, static_cast< std::uint64_t >( parameters.Size() ) );
+      hash = HashType::Combine( hash, parameters.data_block(),
+        parameters.Size() * sizeof( *parameters.data_block() ) );
+      const typename InitialTransformType::FixedParametersType & fixedParameters
+        = transform->GetFixedParameters();
+      hash = HashType::CombineValue( hash, static_cast< std::uint64_t >( fixedParameters.Size() ) );
+      hash = HashType::Combine( hash, fixedParameters.data_block(),
+        fixedParameters.Size() * sizeof( *fixedParameters.data_block() ) );
+    }
+    transform = initialTransform;
+  }
+  return hash;
+
+} // end ComputeTransformHash()
+
+
+/**
+ * ************** GenerateDeformationFieldImage **********************
+ *
+ * This function transforms all indexes to a physical point.
+ * The difference vector (= the deformation at that index) is
+ * stored in an image of vectors (of floats).
+ */
+
+template< class TElastix >
+typename TransformBase< TElastix >::DeformationFieldImageType::Pointer
+TransformBase< TElastix >
+::GenerateDeformationFieldImage( void ) const
+{
+  itk::ProcessObject::Pointer                  generator;
+  typename DeformationFieldSourceType::Pointer deformationFieldSource
+    = this->CreateDeformationFieldPipeline( generator );
+
   /** Track the progress of the generation of the deformation field. */
   const auto progressObserver = BaseComponent::IsElastixLibrary() ?
-    nullptr : ProgressCommandType::CreateAndConnect(*defGenerator);
+    nullptr : ProgressCommandType::CreateAndConnect(*generator);
 
   try
   {
-    infoChanger->Update();
+    deformationFieldSource->Update();
   }
   catch ( itk::ExceptionObject & excp )
   {
@@ -1549,7 +2102,7 @@ TransformBase< TElastix >
     throw excp;
   }
 
-  return infoChanger->GetOutput();
+  return deformationFieldSource->GetOutput();
 } // end GenerateDeformationFieldImage()
 
 
@@ -1561,7 +2114,8 @@ template< class TElastix >
 void
 TransformBase< TElastix >::
 WriteDeformationFieldImage(
-  typename TransformBase< TElastix >::DeformationFieldImageType::Pointer deformationfield ) const
+  typename TransformBase< TElastix >::DeformationFieldImageType::Pointer deformationfield,
+  const std::string & baseName ) const
 {
   typedef itk::ImageFileWriter<
     DeformationFieldImageType >                       DeformationFieldWriterType;
@@ -1571,13 +2125,14 @@ WriteDeformationFieldImage(
   this->m_Configuration->ReadParameter( resultImageFormat, "ResultImageFormat", 0, false );
   std::ostringstream makeFileName( "" );
   makeFileName << this->m_Configuration->GetCommandLineArgument( "-out" )
-               << "deformationField." << resultImageFormat;
+               << baseName << "." << resultImageFormat;
 
   /** Write outputImage to disk. */
   typename DeformationFieldWriterType::Pointer defWriter
     = DeformationFieldWriterType::New();
   defWriter->SetInput( deformationfield );
   defWriter->SetFileName( makeFileName.str().c_str() );
+  defWriter->SetNumberOfStreamDivisions( this->GetNumberOfStreamDivisions() );
 
   /** Do the writing. */
   elxout << "  Computing and writing the deformation field ..." << std::endl;
@@ -1677,6 +2232,7 @@ TransformBase< TElastix >
   typename JacobianWriterType::Pointer jacWriter = JacobianWriterType::New();
   jacWriter->SetInput( infoChanger->GetOutput() );
   jacWriter->SetFileName( makeFileName.str().c_str() );
+  jacWriter->SetNumberOfStreamDivisions( this->GetNumberOfStreamDivisions() );
 
   /** Do the writing. */
   elxout << "  Computing and writing the spatial Jacobian determinant..." << std::endl;
@@ -1776,6 +2332,7 @@ TransformBase< TElastix >
   typename JacobianWriterType::Pointer jacWriter = JacobianWriterType::New();
   jacWriter->SetInput( infoChanger->GetOutput() );
   jacWriter->SetFileName( makeFileName.str().c_str() );
+  jacWriter->SetNumberOfStreamDivisions( this->GetNumberOfStreamDivisions() );
   /** Hack to change the pixel type to vector. Not necessary for mhd. */
   typename PixelTypeChangeCommandType::Pointer jacStartWriteCommand
     = PixelTypeChangeCommandType::New();
@@ -1866,14 +2423,7 @@ TransformBase< TElastix >
   typedef typename ImageSamplerType::Pointer      ImageSamplerPointer;
   typedef typename
     ImageSamplerType::ImageSampleContainerType ImageSampleContainerType;
-  typedef typename ImageSampleContainerType::Pointer       ImageSampleContainerPointer;
-  typedef typename ITKBaseType::JacobianType               JacobianType;
-  typedef typename ITKBaseType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
-
-  const ITKBaseType * const thisITK = this->GetAsITKBaseType();
-  const unsigned int        outdim  = MovingImageDimension;
-  const unsigned int        N       = thisITK->GetNumberOfParameters();
-  scales = ScalesType( N );
+  typedef typename ImageSampleContainerType::Pointer ImageSampleContainerPointer;
 
   /** Set up grid sampler. */
   ImageSamplerPointer sampler = ImageSamplerType::New();
@@ -1896,32 +2446,17 @@ TransformBase< TElastix >
     itkExceptionMacro( << "No valid voxels found to estimate the scales." );
   }
 
-  /** Create iterator over the sample container. */
+  /** Read the fixed coordinates, and sum the squared Jacobians. */
+  std::vector< InputPointType > points;
+  points.reserve( nrofsamples );
   typename ImageSampleContainerType::ConstIterator iter;
   typename ImageSampleContainerType::ConstIterator begin = sampleContainer->Begin();
   typename ImageSampleContainerType::ConstIterator end   = sampleContainer->End();
-
-  /** initialize */
-  scales.Fill( 0.0 );
-
-  /** Read fixed coordinates and get Jacobian. */
   for( iter = begin; iter != end; ++iter )
   {
-    const InputPointType & point = ( *iter ).Value().m_ImageCoordinates;
-    //const JacobianType & jacobian = thisITK->GetJacobian( point );
-    JacobianType jacobian; NonZeroJacobianIndicesType nzji;
-    thisITK->GetJacobian( point, jacobian, nzji );
-
-    /** Square each element of the Jacobian and add each row
-     * to the newscales.
-     */
-    for( unsigned int d = 0; d < outdim; ++d )
-    {
-      ScalesType jacd( jacobian[ d ], N, false );
-      scales += element_product( jacd, jacd );
-    }
+    points.push_back( ( *iter ).Value().m_ImageCoordinates );
   }
-  scales /= static_cast< double >( nrofsamples );
+  this->AccumulateSquaredJacobians( points, scales );
 
 } // end AutomaticScalesEstimation()
 
@@ -1944,18 +2479,11 @@ TransformBase< TElastix >
   typedef typename ImageSamplerType::Pointer      ImageSamplerPointer;
   typedef typename
     ImageSamplerType::ImageSampleContainerType ImageSampleContainerType;
-  typedef typename ImageSampleContainerType::Pointer       ImageSampleContainerPointer;
-  typedef typename ITKBaseType::JacobianType               JacobianType;
-  typedef typename ITKBaseType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+  typedef typename ImageSampleContainerType::Pointer ImageSampleContainerPointer;
 
   const ITKBaseType * const thisITK = this->GetAsITKBaseType();
-  const unsigned int        outdim  = FixedImageDimension;
   const unsigned int        N       = thisITK->GetNumberOfParameters();
 
-  /** initialize */
-  scales = ScalesType( N );
-  scales.Fill( 0.0 );
-
   /** Get fixed image region from registration. */
   const FixedImageRegionType & inputRegion = this->GetRegistration()->GetAsITKBaseType()->GetFixedImageRegion();
   SizeType                     size        = inputRegion.GetSize();
@@ -1993,28 +2521,17 @@ TransformBase< TElastix >
     itkExceptionMacro( << "No valid voxels found to estimate the scales." );
   }
 
-  /** Create iterator over the sample container. */
+  /** Read the fixed coordinates, and sum the squared Jacobians. */
+  std::vector< InputPointType > points;
+  points.reserve( nrofsamples );
   typename ImageSampleContainerType::ConstIterator iter;
   typename ImageSampleContainerType::ConstIterator begin = sampleContainer->Begin();
   typename ImageSampleContainerType::ConstIterator end   = sampleContainer->End();
-
-  /** Read fixed coordinates and get Jacobian. */
-  JacobianType               jacobian;
-  NonZeroJacobianIndicesType nzji;
   for( iter = begin; iter != end; ++iter )
   {
-    const InputPointType & point = ( *iter ).Value().m_ImageCoordinates;
-    //const JacobianType & jacobian = thisITK->GetJacobian( point );
-    thisITK->GetJacobian( point, jacobian, nzji );
-
-    /** Square each element of the Jacobian and add each row to the new scales. */
-    for( unsigned int d = 0; d < outdim; ++d )
-    {
-      ScalesType jacd( jacobian[ d ], N, false );
-      scales += element_product( jacd, jacd );
-    }
+    points.push_back( ( *iter ).Value().m_ImageCoordinates );
   }
-  scales /= static_cast< double >( nrofsamples );
+  this->AccumulateSquaredJacobians( points, scales );
 
   const unsigned int numberOfScalesSubTransform = N / numberOfSubTransforms; //(FixedImageDimension)*(FixedImageDimension - 1);
 
@@ -2029,6 +2546,99 @@ TransformBase< TElastix >
 } // end AutomaticScalesEstimationStackTransform()
 
 
+/**
+ * ************** AccumulateSquaredJacobians ***************
+ */
+
+template< class TElastix >
+void
+TransformBase< TElastix >
+::AccumulateSquaredJacobians( const std::vector< InputPointType > & points,
+  ScalesType & scales ) const
+{
+  const unsigned int  N           = this->GetAsITKBaseType()->GetNumberOfParameters();
+  const unsigned long nrofsamples = points.size();
+
+  const itk::PersistentThreadPool::Pointer pool = itk::PersistentThreadPool::GetInstance();
+  const itk::ThreadIdType                  numberOfWorkUnits = static_cast< itk::ThreadIdType >( std::max< unsigned long >( 1,
+    std::min< unsigned long >( pool->GetMaximumNumberOfThreads(), nrofsamples / 256 ) ) );
+  std::vector< std::vector< double > > sumsOfSquares( numberOfWorkUnits );
+
+  ScalesEstimationThreaderParameterType temp;
+  temp.m_Transform          = this;
+  temp.m_Points             = points.data();
+  temp.m_NumberOfPoints     = nrofsamples;
+  temp.m_PointsPerWorkUnit  = ( nrofsamples + numberOfWorkUnits - 1 ) / numberOfWorkUnits;
+  temp.m_SumsOfSquares      = sumsOfSquares.data();
+  temp.m_NumberOfParameters = N;
+
+  pool->SingleMethodExecute( numberOfWorkUnits, Self::ScalesEstimationThreaderCallback, &temp );
+
+  /** Add the sums of the work units in order, so that the result does not
+   * depend on the number of threads that executed them.
+   */
+  scales = ScalesType( N );
+  scales.Fill( 0.0 );
+  for( const std::vector< double > & sums : sumsOfSquares )
+  {
+    for( unsigned int i = 0; i < N; ++i )
+    {
+      scales[ i ] += sums[ i ];
+    }
+  }
+  scales /= static_cast< double >( nrofsamples );
+
+} // end AccumulateSquaredJacobians()
+
+
+/**
+ * ************** ScalesEstimationThreaderCallback *********************
+ */
+
+template< class TElastix >
+itk::ITK_THREAD_RETURN_TYPE
+TransformBase< TElastix >
+::ScalesEstimationThreaderCallback( void * arg )
+{
+  typedef typename ITKBaseType::JacobianType               JacobianType;
+  typedef typename ITKBaseType::NonZeroJacobianIndicesType NonZeroJacobianIndicesType;
+
+  const itk::PersistentThreadPool::WorkUnitInfo * infoStruct
+    = static_cast< itk::PersistentThreadPool::WorkUnitInfo * >( arg );
+  const ScalesEstimationThreaderParameterType * temp
+    = static_cast< ScalesEstimationThreaderParameterType * >( infoStruct->UserData );
+
+  const unsigned long begin = std::min( infoStruct->WorkUnitID * temp->m_PointsPerWorkUnit, temp->m_NumberOfPoints );
+  const unsigned long end   = std::min( begin + temp->m_PointsPerWorkUnit, temp->m_NumberOfPoints );
+
+  std::vector< double > & sums = temp->m_SumsOfSquares[ infoStruct->WorkUnitID ];
+  sums.assign( temp->m_NumberOfParameters, 0.0 );
+
+  const ITKBaseType *        transform = temp->m_Transform->GetAsITKBaseType();
+  JacobianType               jacobian;
+  NonZeroJacobianIndicesType nzji;
+  for( unsigned long j = begin; j < end; ++j )
+  {
+    transform->GetJacobian( temp->m_Points[ j ], jacobian, nzji );
+
+    /** Square each element of the Jacobian and add it to the sum of its
+     * parameter.
+     */
+    for( unsigned int d = 0; d < jacobian.rows(); ++d )
+    {
+      for( unsigned int k = 0; k < nzji.size(); ++k )
+      {
+        const double value = jacobian( d, k );
+        sums[ nzji[ k ] ] += value * value;
+      }
+    }
+  }
+
+  return itk::ITK_THREAD_RETURN_DEFAULT_VALUE;
+
+} // end ScalesEstimationThreaderCallback()
+
+
 } // end namespace elastix
 
 #endif // end #ifndef __elxTransformBase_hxx
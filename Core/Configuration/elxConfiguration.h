@@ -19,6 +19,7 @@
 #define __elxConfiguration_H__
 
 #include "itkObject.h"
+#include "itkArray.h"
 #include "elxBaseComponent.h"
 
 #include "itkParameterFileParser.h"
@@ -74,6 +75,9 @@ public:
   typedef itk::ParameterMapInterface         ParameterMapInterfaceType;
   typedef ParameterMapInterfaceType::Pointer ParameterMapInterfacePointer;
 
+  /** Typedef for transform parameters in binary form. */
+  typedef itk::Array< double > TransformParametersType;
+
   /** Get and Set CommandLine arguments into the argument map. */
   std::string GetCommandLineArgument( const std::string & key ) const;
 
@@ -98,6 +102,12 @@ public:
   /** True, if Initialize was successfully called. */
   virtual bool IsInitialized( void ) const; //to elxconfigurationbase
 
+  /** Get the parameter map that is read by ReadParameter(). */
+  const ParameterFileParserType::ParameterMapType & GetParameterMap( void ) const
+  {
+    return this->m_ParameterMapInterface->GetParameterMap();
+  }
+
   /** Other elastix related information. */
 
   /** Get and Set the elastix level. */
@@ -108,6 +118,24 @@ public:
   itkSetMacro( TotalNumberOfElastixLevels, unsigned int );
   itkGetConstMacro( TotalNumberOfElastixLevels, unsigned int );
 
+  /** Set/Get the parameters of the transform in this transform parameter
+   * map, in binary form. If they are given and the map specifies
+   * (UseBinaryFormatForTransformationParameters "true"), the transform reads
+   * them from this array, instead of from the .dat file. Used by the library
+   * interface, see ElastixFilter and TransformixFilter.
+   */
+  void SetTransformParameters( const TransformParametersType & parameters )
+  {
+    this->m_TransformParameters = parameters;
+  }
+
+
+  const TransformParametersType & GetTransformParameters( void ) const
+  {
+    return this->m_TransformParameters;
+  }
+
+
   /***/
   virtual bool GetPrintErrorMessages( void )
   {
@@ -261,6 +289,8 @@ private:
   unsigned int m_ElastixLevel;
   unsigned int m_TotalNumberOfElastixLevels;
 
+  TransformParametersType m_TransformParameters;
+
 };
 
 } // end namespace elastix
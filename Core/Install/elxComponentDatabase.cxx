@@ -89,6 +89,29 @@ ComponentDatabase::SetCreator(
 } // end SetCreator
 
 
+/**
+ * ******************** SetCreatorOfIndex ***********************
+ */
+
+int
+ComponentDatabase::SetCreatorOfIndex(
+  const ComponentDescriptionType & name,
+  PtrToCreatorOfIndex creatorOfIndex )
+{
+  /** Check if this component has been installed already.
+   * If not, insert the name + function in the map.
+   */
+  if( !this->CreatorOfIndexMap.insert( CreatorOfIndexMapEntryType( name, creatorOfIndex ) ).second )
+  {
+    xout[ "error" ] << "Error: " << std::endl;
+    xout[ "error" ] << name << " - This component has already been installed!" << std::endl;
+    return 1;
+  }
+  return 0;
+
+} // end SetCreatorOfIndex
+
+
 /**
  * *********************** SetIndex *****************************
  */
@@ -136,25 +159,29 @@ ComponentDatabase::GetCreator(
   const ComponentDescriptionType & name,
   IndexType i )
 {
-  /** Get the map */
-  CreatorMapType map = GetCreatorMap();
-
-  /** Make a key with the input arguments */
-  CreatorMapKeyType key( name, i );
-
   /** Check if this key has been defined. If yes, return the 'creator'
-   * that is linked to it.
+   * that is linked to it. The maps are not copied nor changed, so that
+   * lookups may be done by several threads.
    */
-  if( map.count( key ) == 0 )    // of gewoon !map.count( key ) als boven??
+  const CreatorMapType::const_iterator it = this->CreatorMap.find( CreatorMapKeyType( name, i ) );
+  if( it != this->CreatorMap.end() )
   {
-    xout[ "error" ] << "Error: " << std::endl;
-    xout[ "error" ] << name << "(index " << i << ") - This component is not installed!" << std::endl;
-    return 0;
+    return it->second;
   }
-  else
+
+  /** Otherwise ask the component for its creator of this index. */
+  const CreatorOfIndexMapType::const_iterator creatorOfIndex = this->CreatorOfIndexMap.find( name );
+  PtrToCreator                                creator        = nullptr;
+  if( creatorOfIndex != this->CreatorOfIndexMap.end() )
   {
-    return map[ key ];
+    creator = creatorOfIndex->second( i );
   }
+  if( creator == nullptr )
+  {
+    xout[ "error" ] << "Error: " << std::endl;
+    xout[ "error" ] << name << "(index " << i << ") - This component is not installed!" << std::endl;
+  }
+  return creator;
 
 } // end GetCreator
 
@@ -170,9 +197,6 @@ ComponentDatabase::GetIndex(
   const PixelTypeDescriptionType & movingPixelType,
   ImageDimensionType movingDimension )
 {
-  /** Get the map */
-  IndexMapType map = GetIndexMap();
-
   /** Make a key with the input arguments */
   ImageTypeDescriptionType fixedImage( fixedPixelType, fixedDimension );
   ImageTypeDescriptionType movingImage( movingPixelType, movingDimension );
@@ -181,7 +205,8 @@ ComponentDatabase::GetIndex(
   /** Check if this key has been defined. If yes, return the 'index'
    * that is linked to it.
    */
-  if( map.count( key ) == 0 )
+  const IndexMapType::const_iterator it = this->IndexMap.find( key );
+  if( it == this->IndexMap.end() )
   {
     xout[ "error" ] << "ERROR:\n"
                     << "  FixedImageType:  " << fixedDimension << "D " << fixedPixelType << std::endl
@@ -196,7 +221,7 @@ ComponentDatabase::GetIndex(
   }
   else
   {
-    return map[ key ];
+    return it->second;
   }
 
 } // end GetIndex
@@ -45,6 +45,12 @@ namespace elastix
  * known" by calling the elxInstallMacro, which is defined in
  * elxMacro.h .
  *
+ * The elxInstallMacro installs one function per component, that returns
+ * the creator for a given index, instead of a creator for every supported
+ * image type. The creator of the index is only looked up when the
+ * component is created, so that installing all components costs one map
+ * entry per component.
+ *
  * \sa elxInstallFunctions
  * \ingroup Install
  */
@@ -84,6 +90,15 @@ public:
     CreatorMapValueType >              CreatorMapType;
   typedef CreatorMapType::value_type CreatorMapEntryType;
 
+  /** PtrToCreatorOfIndex is a pointer to a function which outputs the
+   * creator of a component for the given index, or a null pointer.
+   */
+  typedef PtrToCreator (* PtrToCreatorOfIndex)( IndexType );
+  typedef std::map<
+    ComponentDescriptionType,
+    PtrToCreatorOfIndex >              CreatorOfIndexMapType;
+  typedef CreatorOfIndexMapType::value_type CreatorOfIndexMapEntryType;
+
   /** Typedefs for the IndexMap.*/
 
   /** The ImageTypeDescription contains the pixeltype (as a string)
@@ -118,6 +133,13 @@ public:
     IndexType i,
     PtrToCreator creator );
 
+  /** Install a component for all indices, by a function that returns its
+   * creator for an index.
+   */
+  int SetCreatorOfIndex(
+    const ComponentDescriptionType & name,
+    PtrToCreatorOfIndex creatorOfIndex );
+
   int SetIndex(
     const PixelTypeDescriptionType & fixedPixelType,
     ImageDimensionType fixedDimension,
@@ -125,7 +147,9 @@ public:
     ImageDimensionType movingDimension,
     IndexType i );
 
-  /** Functions to get an entry in a map */
+  /** Functions to get an entry in a map. GetCreator looks in the CreatorMap
+   * first, and otherwise asks the function installed by SetCreatorOfIndex.
+   */
   PtrToCreator GetCreator(
     const ComponentDescriptionType & name,
     IndexType i );
@@ -141,8 +165,9 @@ protected:
   ComponentDatabase(){}
   ~ComponentDatabase() override{}
 
-  CreatorMapType CreatorMap;
-  IndexMapType   IndexMap;
+  CreatorMapType        CreatorMap;
+  CreatorOfIndexMapType CreatorOfIndexMap;
+  IndexMapType          IndexMap;
 
 private:
 
@@ -24,6 +24,7 @@
 #include "elxInstallFunctions.h"
 #include "elxMacro.h"
 #include "elxInstallAllComponents.h"
+#include "itkTimeProbe.h"
 #include <iostream>
 #include <string>
 
@@ -141,6 +142,10 @@ ComponentLoader::LoadComponents( const char * /** argv0 */ )
 {
   int installReturnCode = 0;
 
+  /** Time the installation, which is part of the startup time of elastix and transformix. */
+  itk::TimeProbe timer;
+  timer.Start();
+
   /** Generate the mapping between indices and image types */
   if( !this->m_ImageTypeSupportInstalled )
   {
@@ -166,7 +171,9 @@ ComponentLoader::LoadComponents( const char * /** argv0 */ )
     return installReturnCode;
   }
 
-  elxout << "InstallingComponents was successful.\n" << std::endl;
+  timer.Stop();
+  elxout << "InstallingComponents was successful, it took "
+         << static_cast< long >( 1e6 * timer.GetMean() ) << " us.\n" << std::endl;
 
   return 0;
 
@@ -84,9 +84,11 @@
  *
  * Details: a function "int _classname##InstallComponent( _cdb )" is defined.
  * In this function a template is defined, _classname##_install<VIndex>.
- * It contains the ElastixTypedef<VIndex>, and recursive function DO(cdb).
- * DO installs the component for all defined ElastixTypedefs (so for all
- * supported image types).
+ * It contains the ElastixTypedef<VIndex>, and recursive function
+ * GetCreator(i), which returns the creator of the component for the
+ * ElastixTypedef<i>, so for one of the supported image types. Only this
+ * function is installed, once per component, and the creator of an image
+ * type is looked up when the component is created.
  *
  */
 #define elxInstallMacro( _classname ) \
@@ -96,28 +98,29 @@
 public: \
     typedef typename::elx::ElastixTypedef< VIndex >::ElastixType ElastixType; \
     typedef::elx::ComponentDatabase::ComponentDescriptionType    ComponentDescriptionType; \
-    static int DO( ::elx::ComponentDatabase * cdb ) \
+    static ComponentDescriptionType GetName( void ) \
+    { return ::elx::_classname< ElastixType >::elxGetClassNameStatic(); } \
+    static ::elx::ComponentDatabase::PtrToCreator GetCreator( const ::elx::ComponentDatabase::IndexType i ) \
     { \
-      ComponentDescriptionType name  = ::elx::_classname< ElastixType >::elxGetClassNameStatic(); \
-      int                      dummy = ::elx::InstallFunctions< ::elx::_classname< ElastixType > >::InstallComponent( name, VIndex, cdb ); \
+      if( i == VIndex ) \
+      { return ::elx::InstallFunctions< ::elx::_classname< ElastixType > >::Creator; } \
       if( ::elx::ElastixTypedef< VIndex + 1 >::Defined() ) \
-      { return _classname##_install< VIndex + 1 >::DO( cdb ); } \
-      return dummy;  \
+      { return _classname##_install< VIndex + 1 >::GetCreator( i ); } \
+      return nullptr; \
     } \
   }; \
   template< > \
   class _classname##_install< ::elx::NrOfSupportedImageTypes + 1 > \
   { \
 public: \
-    typedef::elx::ComponentDatabase::ComponentDescriptionType ComponentDescriptionType; \
-    static int DO( ::elx::ComponentDatabase * /** cdb */ ) \
-    { return 0; } \
+    static ::elx::ComponentDatabase::PtrToCreator GetCreator( const ::elx::ComponentDatabase::IndexType /** i */ ) \
+    { return nullptr; } \
   }; \
   extern "C" int _classname##InstallComponent( \
   ::elx::ComponentDatabase * _cdb ) \
   { \
-    int _InstallDummy##_classname = _classname##_install< 1 >::DO( _cdb  ); \
-    return _InstallDummy##_classname; \
+    return _cdb->SetCreatorOfIndex( _classname##_install< 1 >::GetName(), \
+      _classname##_install< 1 >::GetCreator ); \
   } //ignore semicolon
 
 /**
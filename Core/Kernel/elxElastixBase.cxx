@@ -17,11 +17,64 @@
  *=========================================================================*/
 #include "elxElastixBase.h"
 #include <sstream>
+#include <chrono>
 #include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itksys/Directory.hxx"
+#include "itksys/SystemTools.hxx"
 
 namespace elastix
 {
 
+namespace
+{
+
+/** Copy the files, not the subdirectories, of a directory to another
+ * directory. The name of the target directory ends with a '/'.
+ * Returns the number of files copied, or -1 if a copy failed.
+ */
+int
+CopyFilesOfDirectory( const std::string & source, const std::string & target )
+{
+  itksys::Directory directory;
+  if( !directory.Load( source ) ) { return -1; }
+  int numberOfFiles = 0;
+  for( unsigned long i = 0; i < directory.GetNumberOfFiles(); ++i )
+  {
+    const std::string name = directory.GetFile( i );
+    const std::string path = source + "/" + name;
+    if( name == "." || name == ".." || itksys::SystemTools::FileIsDirectory( path ) )
+    {
+      continue;
+    }
+    if( !itksys::SystemTools::CopyFileAlways( path, target + name ) ) { return -1; }
+    ++numberOfFiles;
+  }
+  return numberOfFiles;
+
+} // end CopyFilesOfDirectory()
+
+
+/** A task started by ElastixBase::RunInBackground(), and the object that
+ * it uses.
+ */
+struct BackgroundTaskType
+{
+  std::future< std::string > m_Message;
+  itk::Object::Pointer       m_KeepAlive;
+};
+
+
+/** The tasks that have not been waited for yet. */
+std::vector< BackgroundTaskType > &
+GetBackgroundTasks( void )
+{
+  static std::vector< BackgroundTaskType > backgroundTasks;
+  return backgroundTasks;
+}
+
+
+} // end namespace
+
 /**
  * ********************* Constructor ****************************
  */
@@ -69,6 +122,8 @@ ElastixBase::ElastixBase()
    * backward compatability. From Elastix 4.8: set it to true by default.*/
   this->m_UseDirectionCosines = true;
 
+  this->m_UseMemoryMappedImages = false;
+
 } // end Constructor
 
 
@@ -222,6 +277,13 @@ ElastixBase::BeforeAllBase( void )
     elxout << "-threads  " << check << std::endl;
   }
 
+  /** Check for appearance of -numa, which pins the threads to the NUMA nodes. */
+  check = this->GetConfiguration()->GetCommandLineArgument( "-numa" );
+  if( check != "" )
+  {
+    elxout << "-numa     " << check << std::endl;
+  }
+
   /** Check the very important UseDirectionCosines parameter. */
   bool retudc = this->GetConfiguration()->ReadParameter( this->m_UseDirectionCosines,
     "UseDirectionCosines", 0 );
@@ -234,6 +296,11 @@ ElastixBase::BeforeAllBase( void )
       << std::endl;
   }
 
+  /** Check whether the input images may be memory mapped. */
+  this->m_UseMemoryMappedImages = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseMemoryMappedImages,
+    "UseMemoryMappedImages", 0, false );
+
   /** Set the random seed. Use 121212 as a default, which is the same as
    * the default in the MersenneTwister code.
    * Use silent parameter file readout, to avoid annoying warning when
@@ -332,6 +399,11 @@ ElastixBase::BeforeAllTransformixBase( void )
       << std::endl;
   }
 
+  /** Check whether the input image may be memory mapped. */
+  this->m_UseMemoryMappedImages = false;
+  this->GetConfiguration()->ReadParameter( this->m_UseMemoryMappedImages,
+    "UseMemoryMappedImages", 0, false );
+
   return returndummy;
 
 } // end BeforeAllTransformixBase()
@@ -468,6 +540,128 @@ ElastixBase::GetUseDirectionCosines( void ) const
 }
 
 
+/**
+ * ******************** GetUseMemoryMappedImages ********************
+ */
+
+bool
+ElastixBase::GetUseMemoryMappedImages( void ) const
+{
+  return this->m_UseMemoryMappedImages;
+}
+
+
+/**
+ * ******************** ComputeParameterMapHash ********************
+ */
+
+ElastixBase::ResultCacheKeyType
+ElastixBase::ComputeParameterMapHash( void ) const
+{
+  /** The std::map is sorted by parameter name. Each string is hashed with a
+   * terminating zero, so that the boundaries between strings count.
+   */
+  ResultCacheKeyType hash = itk::DataHash::InitialValue;
+  const ParameterMapType & parameterMap = this->GetConfiguration()->GetParameterMap();
+  for( ParameterMapType::const_iterator it = parameterMap.begin(); it != parameterMap.end(); ++it )
+  {
+    if( it->first == "InitialTransformParametersFileName" ) { continue; }
+    hash = itk::DataHash::Combine( hash, it->first.c_str(), it->first.size() + 1 );
+    hash = itk::DataHash::CombineValue( hash, static_cast< std::uint64_t >( it->second.size() ) );
+    for( std::size_t i = 0; i < it->second.size(); ++i )
+    {
+      hash = itk::DataHash::Combine( hash, it->second[ i ].c_str(), it->second[ i ].size() + 1 );
+    }
+  }
+  return hash;
+
+} // end ComputeParameterMapHash()
+
+
+/**
+ * ******************** RunThroughResultCache ********************
+ */
+
+void
+ElastixBase::RunThroughResultCache( const std::string & outputName,
+  const ResultCacheKeyType key, const std::function< void( void ) > & produceOutput )
+{
+  Configuration * configuration = this->GetConfiguration();
+  std::string     cacheDirectory = configuration->GetCommandLineArgument( "-cache" );
+  if( cacheDirectory.empty() || BaseComponent::IsElastixLibrary() )
+  {
+    produceOutput();
+    return;
+  }
+
+  const char last = cacheDirectory[ cacheDirectory.size() - 1 ];
+  if( last != '/' && last != '\\' ) { cacheDirectory.append( "/" ); }
+  const std::string outputDirectory = configuration->GetCommandLineArgument( "-out" );
+
+  std::ostringstream entryName;
+  entryName << cacheDirectory << outputName << "."
+            << std::hex << std::setw( 16 ) << std::setfill( '0' ) << key;
+  const std::string entryDirectory = entryName.str();
+
+  /** Copy the files of an existing entry. */
+  if( itksys::SystemTools::FileIsDirectory( entryDirectory ) )
+  {
+    if( CopyFilesOfDirectory( entryDirectory, outputDirectory ) > 0 )
+    {
+      elxout << "  The " << outputName << " is copied from the result cache entry "
+             << entryDirectory << std::endl;
+      return;
+    }
+  }
+
+  /** Let produceOutput write to a directory of this process, so that other
+   * processes that share the cache never see a partial entry.
+   */
+  std::ostringstream temporaryName;
+  temporaryName << entryDirectory << ".tmp"
+                << std::chrono::high_resolution_clock::now().time_since_epoch().count()
+                << "." << static_cast< const void * >( this );
+  const std::string temporaryDirectory = temporaryName.str();
+  if( !itksys::SystemTools::MakeDirectory( temporaryDirectory ) )
+  {
+    xout[ "warning" ] << "WARNING: Could not create the result cache directory "
+                      << temporaryDirectory << ", the cache is not used." << std::endl;
+    produceOutput();
+    return;
+  }
+
+  configuration->SetCommandLineArgument( "-out", temporaryDirectory + "/" );
+  try
+  {
+    produceOutput();
+  }
+  catch( ... )
+  {
+    configuration->SetCommandLineArgument( "-out", outputDirectory );
+    itksys::SystemTools::RemoveADirectory( temporaryDirectory );
+    throw;
+  }
+  configuration->SetCommandLineArgument( "-out", outputDirectory );
+
+  /** Copy the output, and keep it as the entry, unless another process
+   * stored the same entry in the meantime.
+   */
+  const int numberOfFiles = CopyFilesOfDirectory( temporaryDirectory, outputDirectory );
+  if( numberOfFiles < 0 )
+  {
+    itksys::SystemTools::RemoveADirectory( temporaryDirectory );
+    itkGenericExceptionMacro( << "ERROR: Could not copy the " << outputName
+                              << " from " << temporaryDirectory << " to " << outputDirectory );
+  }
+  if( numberOfFiles == 0
+    || !itksys::SystemTools::RenameFile( temporaryDirectory, entryDirectory ) )
+  {
+    itksys::SystemTools::RemoveADirectory( temporaryDirectory );
+  }
+
+} // end RunThroughResultCache()
+
+
 /**
  * ******************** SetOriginalFixedImageDirectionFlat ********************
  */
@@ -491,4 +685,47 @@ ElastixBase::GetOriginalFixedImageDirectionFlat( void ) const
 }
 
 
+/**
+ * ******************** RunInBackground ********************
+ */
+
+void
+ElastixBase::RunInBackground( const std::function< std::string( void ) > & task,
+  itk::Object * keepAlive )
+{
+  BackgroundTaskType backgroundTask;
+  backgroundTask.m_Message   = std::async( std::launch::async, task );
+  backgroundTask.m_KeepAlive = keepAlive;
+  GetBackgroundTasks().push_back( std::move( backgroundTask ) );
+
+} // end RunInBackground()
+
+
+/**
+ * ******************** WaitForBackgroundTasks ********************
+ */
+
+void
+ElastixBase::WaitForBackgroundTasks( void )
+{
+  std::vector< BackgroundTaskType > & backgroundTasks = GetBackgroundTasks();
+  for( BackgroundTaskType & backgroundTask : backgroundTasks )
+  {
+    try
+    {
+      elxout << backgroundTask.m_Message.get() << std::endl;
+    }
+    catch( std::exception & excp )
+    {
+      xl::xout[ "error" ] << "Exception caught in a background task: "
+                          << excp.what() << std::endl;
+    }
+  }
+
+  /** Release the objects in the main thread, after all tasks have finished. */
+  backgroundTasks.clear();
+
+} // end WaitForBackgroundTasks()
+
+
 } // end namespace elastix
@@ -38,8 +38,13 @@
 #include "itkVectorContainer.h"
 #include "itkImageFileReader.h"
 #include "itkChangeInformationImageFilter.h"
+#include "itkImageIOBase.h"
+#include "itkMemoryMappedImageFileReader.h"
+#include "itkDataHash.h"
 
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iomanip>
 
 /** Like itkGet/SetObjectMacro, but in these macros the itkDebugMacro is
@@ -97,6 +102,14 @@ namespace elastix
  *   Most importantly, it affects the output precision of the parameters in the transform parameter file.\n
  *   example: <tt>(DefaultOutputPrecision 6)</tt>\n
  *   Default value: 6.
+ * \parameter UseMemoryMappedImages: Map uncompressed MetaImage input files
+ *   (.mha, or .mhd with a .raw file) into memory, instead of reading them,
+ *   if their pixel type is the internal pixel type and their byte order is
+ *   that of the system. The image is then read from the page cache when it
+ *   is accessed, and the pages are shared by processes that read the same
+ *   file. The file should not be changed while elastix runs.\n
+ *   example: <tt>(UseMemoryMappedImages "true")</tt>\n
+ *   Default value: "false".
  *
  * The command line arguments used by this class are:
  * \commandlinearg -f: mandatory argument for elastix with the file name of the fixed image. \n
@@ -125,6 +138,15 @@ namespace elastix
  *    example: <tt>-tp TransformParameters.txt</tt> \n
  *    In one such a transform parameter file a reference can be used to another
  *    transform parameter file, which is then used as an initial transform.
+ * \commandlinearg -cache: optional argument for transformix with the name of
+ *    a directory that caches the outputs of transformix. \n
+ *    example: <tt>-cache cachedirectory</tt> \n
+ *    The result image, deformation field and (full) spatial Jacobian are
+ *    stored there, under a hash of the transform, the transform parameter
+ *    file and, for the result image, the input image. When transformix is
+ *    called again with the same inputs, the stored outputs are copied to the
+ *    output directory instead of being computed. The directory may be shared
+ *    by several transformix processes.
  * \commandlinearg -priority: optional argument for both elastix and transformix to
  *    specify the priority setting of this process. Choose one from {belownormal, high}. \n
  *    example: <tt>-priority high</tt> \n
@@ -164,6 +186,9 @@ public:
   typedef itk::VectorContainer<
     unsigned int, std::string >               FileNameContainerType;
   typedef FileNameContainerType::Pointer FileNameContainerPointer;
+  typedef itk::ImageIOBase               ImageIOType;
+  typedef ImageIOType::Pointer           ImageIOPointer;
+  typedef itk::DataHash::HashType        ResultCacheKeyType;
 
   /** Other typedef's. */
   typedef ComponentDatabase                ComponentDatabaseType;
@@ -272,6 +297,14 @@ public:
   elxSetObjectMacro( FixedMaskFileNameContainer, FileNameContainerType );
   elxSetObjectMacro( MovingMaskFileNameContainer, FileNameContainerType );
 
+  /** Set/Get the ImageIO objects that have read the header of the first
+   * fixed and moving image file. If set, they are reused to read these images.
+   */
+  elxGetObjectMacro( FixedImageIO, ImageIOType );
+  elxGetObjectMacro( MovingImageIO, ImageIOType );
+  elxSetObjectMacro( FixedImageIO, ImageIOType );
+  elxSetObjectMacro( MovingImageIO, ImageIOType );
+
   /** Define some convenience functions: GetNumberOfMetrics() for example. */
   elxGetNumberOfMacro( Registration );
   elxGetNumberOfMacro( FixedImagePyramid );
@@ -348,6 +381,10 @@ public:
    * parameter. */
   virtual bool GetUseDirectionCosines( void ) const;
 
+  /** Get whether uncompressed input images may be memory mapped. This
+   * depends on the UseMemoryMappedImages parameter. */
+  virtual bool GetUseMemoryMappedImages( void ) const;
+
   /** Set/Get the original fixed image direction as a flat array
    * (d11 d21 d31 d21 d22 etc ) */
   virtual void SetOriginalFixedImageDirectionFlat(
@@ -364,6 +401,36 @@ public:
   /** Set configuration vector. Library only. */
   virtual void SetConfigurations( std::vector< ConfigurationPointer > & configurations ) = 0;
 
+  /** Compute a hash of the parameter map of the configuration, with the
+   * parameters sorted by name. The InitialTransformParametersFileName is
+   * left out, so that the hash does not depend on where the files are.
+   */
+  ResultCacheKeyType ComputeParameterMapHash( void ) const;
+
+  /** Call produceOutput, which writes the output named outputName to the
+   * "-out" directory, through the result cache given by the "-cache"
+   * command line argument. If the cache has an entry for the key, its files
+   * are copied to the output directory instead. Otherwise produceOutput
+   * writes to a new directory in the cache, which becomes the entry, and
+   * its files are copied to the output directory. Without "-cache", and in
+   * the library, produceOutput is just called.
+   */
+  void RunThroughResultCache( const std::string & outputName,
+    const ResultCacheKeyType key, const std::function< void( void ) > & produceOutput );
+
+  /** Run a task in a background thread, such as the resampling and writing
+   * of the result image of a registration, while the next registration runs.
+   * The object is kept alive until the task is waited for. The task returns
+   * a message for the log, which is printed by WaitForBackgroundTasks().
+   */
+  static void RunInBackground( const std::function< std::string( void ) > & task,
+    itk::Object * keepAlive );
+
+  /** Wait for all tasks started by RunInBackground(), and print their
+   * messages. Called by the main thread only.
+   */
+  static void WaitForBackgroundTasks( void );
+
 protected:
 
   ElastixBase();
@@ -386,6 +453,12 @@ protected:
    * The useDirection option is built in as a means to ignore the direction
    * cosines. Set it to false to force the direction cosines to identity.
    * The original direction cosines are returned separately.
+   *
+   * An ImageIO that has already read the header of the first file can be
+   * passed, so that the ImageIO factories are not probed again for it.
+   *
+   * With useMemoryMapping, uncompressed MetaImage files that store the pixel
+   * type of the image are memory mapped, see MemoryMappedImageFileReader.
    */
   template< class TImage >
   class MultipleImageLoader
@@ -402,7 +475,8 @@ public:
 
     static DataObjectContainerPointer GenerateImageContainer(
       FileNameContainerType * fileNameContainer, const std::string & imageDescription,
-      bool useDirectionCosines, DirectionType * originalDirectionCosines = nullptr )
+      bool useDirectionCosines, DirectionType * originalDirectionCosines = nullptr,
+      ImageIOType * firstImageIO = nullptr, const bool useMemoryMapping = false )
     {
       DataObjectContainerPointer imageContainer = DataObjectContainerType::New();
 
@@ -412,12 +486,31 @@ public:
         /** Setup reader. */
         ImageReaderPointer imageReader = ImageReaderType::New();
         imageReader->SetFileName( fileNameContainer->ElementAt( i ).c_str() );
+        if( i == 0 && firstImageIO != nullptr )
+        {
+          imageReader->SetImageIO( firstImageIO );
+        }
         ChangeInfoFilterPointer infoChanger = ChangeInfoFilterType::New();
         DirectionType           direction;
         direction.SetIdentity();
         infoChanger->SetOutputDirection( direction );
         infoChanger->SetChangeDirection( !useDirectionCosines );
-        infoChanger->SetInput( imageReader->GetOutput() );
+
+        /** Map the file, if possible, or read it. */
+        ImagePointer mappedImage;
+        if( useMemoryMapping )
+        {
+          mappedImage = itk::MemoryMappedImageFileReader< ImageType >::Read(
+            fileNameContainer->ElementAt( i ) );
+        }
+        if( mappedImage.IsNotNull() )
+        {
+          infoChanger->SetInput( mappedImage );
+        }
+        else
+        {
+          infoChanger->SetInput( imageReader->GetOutput() );
+        }
 
         /** Do the reading. */
         try
@@ -442,7 +535,7 @@ public:
         /** Store the original direction cosines */
         if( originalDirectionCosines )
         {
-          *originalDirectionCosines = imageReader->GetOutput()->GetDirection();
+          *originalDirectionCosines = infoChanger->GetInput()->GetDirection();
         }
 
       } // end for i
@@ -539,6 +632,10 @@ private:
   FileNameContainerPointer m_FixedMaskFileNameContainer;
   FileNameContainerPointer m_MovingMaskFileNameContainer;
 
+  /** The ImageIO objects of the first fixed and moving image file. */
+  ImageIOPointer m_FixedImageIO;
+  ImageIOPointer m_MovingImageIO;
+
   /** The initial and final transform. */
   ObjectPointer m_InitialTransform;
   ObjectPointer m_FinalTransform;
@@ -546,6 +643,9 @@ private:
   /** Use or ignore direction cosines. */
   bool m_UseDirectionCosines;
 
+  /** Memory map uncompressed input images. */
+  bool m_UseMemoryMappedImages;
+
   /** Read a series of command line options that satisfy the following syntax:
    * {-f,-f0} \<filename0\> [-f1 \<filename1\> [ -f2 \<filename2\> ... ] ]
    *
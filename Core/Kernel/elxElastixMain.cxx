@@ -28,6 +28,10 @@
 
 #include "elxMacro.h"
 #include "itkPlatformMultiThreader.h"
+#include "itkPersistentThreadPool.h"
+#include "itkReusableBufferPool.h"
+
+#include <string> // For to_string.
 
 #ifdef ELASTIX_USE_OPENCL
 #include "itkOpenCLSetup.h"
@@ -54,7 +58,9 @@ xoutsimple_type g_ErrorXout;
 xoutsimple_type g_StandardXout;
 xoutsimple_type g_CoutOnlyXout;
 xoutsimple_type g_LogOnlyXout;
-std::ofstream   g_LogFileStream;
+
+/** The logfile is written by a background thread. */
+xoutasyncofstream_type g_LogFileStream;
 
 /**
  * ********************* xoutSetup ******************************
@@ -123,6 +129,64 @@ xoutSetup( const char * logfilename, bool setupLogging, bool setupCout )
 } // end xoutSetup()
 
 
+/**
+ * ********************* ThreadXout ******************************
+ */
+
+ThreadXout::ThreadXout( const char * logfilename, bool setupLogging, bool setupCout ) :
+  m_ErrorCode( 0 )
+{
+  /** Open the logfile for writing. */
+  if( setupLogging )
+  {
+    this->m_LogFileStream.open( logfilename );
+    if( !this->m_LogFileStream.is_open() )
+    {
+      this->m_ErrorCode = 1;
+    }
+  }
+
+  /** Set up the fields like xoutSetup(). */
+  if( setupLogging )
+  {
+    this->m_Xout.AddOutput( "log", &this->m_LogFileStream );
+  }
+  if( setupCout )
+  {
+    this->m_Xout.AddOutput( "cout", &std::cout );
+  }
+  this->m_LogOnlyXout.AddOutput( "log", &this->m_LogFileStream );
+  this->m_CoutOnlyXout.AddOutput( "cout", &std::cout );
+
+  this->m_WarningXout.SetOutputs( this->m_Xout.GetCOutputs() );
+  this->m_ErrorXout.SetOutputs( this->m_Xout.GetCOutputs() );
+  this->m_StandardXout.SetOutputs( this->m_Xout.GetCOutputs() );
+
+  this->m_Xout.AddTargetCell( "warning", &this->m_WarningXout );
+  this->m_Xout.AddTargetCell( "error", &this->m_ErrorXout );
+  this->m_Xout.AddTargetCell( "standard", &this->m_StandardXout );
+  this->m_Xout.AddTargetCell( "logonly", &this->m_LogOnlyXout );
+  this->m_Xout.AddTargetCell( "coutonly", &this->m_CoutOnlyXout );
+
+  this->m_Xout[ "standard" ] << std::fixed;
+  this->m_Xout[ "standard" ] << std::showpoint;
+
+  /** The threads that are started by this thread use the global xout. */
+  if( !xout_valid() )
+  {
+    set_xout( &g_xout );
+  }
+  this->m_PreviousXout = set_thread_xout( &this->m_Xout );
+
+} // end ThreadXout()
+
+
+ThreadXout::~ThreadXout()
+{
+  set_thread_xout( this->m_PreviousXout );
+} // end ~ThreadXout()
+
+
 /**
  * ********************* Constructor ****************************
  */
@@ -164,6 +228,47 @@ ElastixMain::ElastixMain()
 // Both s_CDB and s_ComponentLoader are defaulted-constructed to null.
 ElastixMain::ComponentDatabasePointer ElastixMain::s_CDB;
 ElastixMain::ComponentLoaderPointer   ElastixMain::s_ComponentLoader;
+bool                                  ElastixMain::s_KeepOpenCLContext = false;
+unsigned int                          ElastixMain::RunCounter::s_NumberOfRuns = 0;
+
+
+/**
+ * ********************* GetComponentsMutex *********************
+ */
+
+std::mutex &
+ElastixMain::GetComponentsMutex( void )
+{
+  static std::mutex componentsMutex;
+  return componentsMutex;
+
+} // end GetComponentsMutex()
+
+
+/**
+ * ********************* RunCounter *****************************
+ */
+
+ElastixMain::RunCounter::RunCounter()
+{
+  std::lock_guard< std::mutex > lock( GetComponentsMutex() );
+  ++s_NumberOfRuns;
+} // end RunCounter()
+
+
+ElastixMain::RunCounter::~RunCounter()
+{
+  std::lock_guard< std::mutex > lock( GetComponentsMutex() );
+  --s_NumberOfRuns;
+} // end ~RunCounter()
+
+
+unsigned int
+ElastixMain::RunCounter::GetNumberOfRuns( void )
+{
+  std::lock_guard< std::mutex > lock( GetComponentsMutex() );
+  return s_NumberOfRuns;
+} // end GetNumberOfRuns()
 
 /**
  * ********************** Destructor ****************************
@@ -173,7 +278,7 @@ ElastixMain::~ElastixMain()
 {
 #ifdef ELASTIX_USE_OPENCL
   itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
-  if( context->IsCreated() )
+  if( context->IsCreated() && !s_KeepOpenCLContext )
   {
     context->Release();
   }
@@ -264,6 +369,8 @@ ElastixMain
 int
 ElastixMain::Run( void )
 {
+  /** Count this run during its lifetime. */
+  const RunCounter runCounter;
 
   /** Set process properties. */
   this->SetProcessPriority();
@@ -301,21 +408,39 @@ ElastixMain::Run( void )
   this->m_Configuration->ReadParameter( userSuppliedOpenCLDeviceID,
     "OpenCLDeviceID", 0, false );
 
-  std::string errorMessage              = "";
-  const bool  creatingContextSuccessful = itk::CreateOpenCLContext(
-    errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceID );
-  if( !creatingContextSuccessful )
+  /** The command line option "-gpu 0,1,2,3" selects several devices, on
+   * which the jobs are placed round-robin. It overrides OpenCLDeviceID. */
+  std::vector< int > userSuppliedOpenCLDeviceIDs( 1, userSuppliedOpenCLDeviceID );
+  const std::string  gpuArgument = this->m_Configuration->GetCommandLineArgument( "-gpu" );
+  if( !gpuArgument.empty()
+    && !itk::GetOpenCLDeviceIDs( gpuArgument, userSuppliedOpenCLDeviceIDs ) )
   {
-    /** Report and disable the GPU by releasing the context. */
-    elxout << errorMessage << std::endl;
-    elxout << "  OpenCL processing in elastix is disabled." << std::endl << std::endl;
-
-    itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
-    context->Release();
+    xl::xout[ "warning" ] << "WARNING: The command line option \"-gpu " << gpuArgument
+                          << "\" is not a comma separated list of device IDs, and is ignored." << std::endl;
+    userSuppliedOpenCLDeviceIDs.assign( 1, userSuppliedOpenCLDeviceID );
   }
 
-  /** Create a log file. */
-  itk::CreateOpenCLLogger( "elastix", this->m_Configuration->GetCommandLineArgument( "-out" ) );
+  {
+    /** The context is shared by the runs of all threads. */
+    static std::mutex             contextMutex;
+    std::lock_guard< std::mutex > contextLock( contextMutex );
+
+    std::string errorMessage              = "";
+    const bool  creatingContextSuccessful = itk::CreateOpenCLContext(
+      errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceIDs );
+    if( !creatingContextSuccessful )
+    {
+      /** Report and disable the GPU by releasing the context. */
+      elxout << errorMessage << std::endl;
+      elxout << "  OpenCL processing in elastix is disabled." << std::endl << std::endl;
+
+      itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+      context->Release();
+    }
+
+    /** Create a log file. */
+    itk::CreateOpenCLLogger( "elastix", this->m_Configuration->GetCommandLineArgument( "-out" ) );
+  }
 #endif
 
   /** Set some information in the ElastixBase. */
@@ -380,6 +505,10 @@ ElastixMain::Run( void )
   this->GetElastixBase()->SetMovingMaskContainer( this->GetModifiableMovingMaskContainer() );
   this->GetElastixBase()->SetResultImageContainer( this->GetModifiableResultImageContainer() );
 
+  /** Reuse the ImageIO objects that have read the image headers. */
+  this->GetElastixBase()->SetFixedImageIO( this->m_FixedImageIO );
+  this->GetElastixBase()->SetMovingImageIO( this->m_MovingImageIO );
+
   /** Set the initial transform, if it happens to be there. */
   this->GetElastixBase()->SetInitialTransform( this->GetModifiableInitialTransform() );
 
@@ -485,6 +614,8 @@ ElastixMain::InitDBIndex( void )
       this->m_FixedImagePixelType = "float"; // \note: this assumes elastix was compiled for float
       this->m_Configuration->ReadParameter( this->m_FixedImagePixelType,
         "FixedInternalImagePixelType", 0 );
+      AdaptInternalImagePixelType( this->m_FixedImagePixelType,
+        "FixedInternalImagePixelType" );
     }
 
     /** FixedImageDimension. */
@@ -512,7 +643,7 @@ ElastixMain::InitDBIndex( void )
         try
         {
           this->GetImageInformationFromFile( fixedImageFileName,
-            this->m_FixedImageDimension );
+            this->m_FixedImageDimension, this->m_FixedImageIO );
         }
         catch( itk::ExceptionObject & err )
         {
@@ -566,6 +697,8 @@ ElastixMain::InitDBIndex( void )
       this->m_MovingImagePixelType = "float"; // \note: this assumes elastix was compiled for float
       this->m_Configuration->ReadParameter( this->m_MovingImagePixelType,
         "MovingInternalImagePixelType", 0 );
+      AdaptInternalImagePixelType( this->m_MovingImagePixelType,
+        "MovingInternalImagePixelType" );
     }
 
     /** MovingImageDimension. */
@@ -593,7 +726,7 @@ ElastixMain::InitDBIndex( void )
         try
         {
           this->GetImageInformationFromFile( movingImageFileName,
-            this->m_MovingImageDimension );
+            this->m_MovingImageDimension, this->m_MovingImageIO );
         }
         catch( itk::ExceptionObject & err )
         {
@@ -640,7 +773,8 @@ ElastixMain::InitDBIndex( void )
       }
     }
 
-    /** Load the components. */
+    /** Load the components, once for the runs of all threads. */
+    std::unique_lock< std::mutex > loadLock( GetComponentsMutex() );
     if( this->s_CDB.IsNull() )
     {
       int loadReturnCode = this->LoadComponents();
@@ -650,6 +784,7 @@ ElastixMain::InitDBIndex( void )
         return loadReturnCode;
       }
     }
+    loadLock.unlock();
 
     if( this->s_CDB.IsNotNull() )
     {
@@ -773,16 +908,26 @@ ElastixMain::LoadComponents( void )
 void
 ElastixMain::UnloadComponents( void )
 {
+  /** Keep the components for the runs in progress in other threads. */
+  std::lock_guard< std::mutex > lock( GetComponentsMutex() );
+  if( RunCounter::s_NumberOfRuns > 0 )
+  {
+    return;
+  }
+
   s_CDB = 0;
-  s_ComponentLoader->SetComponentDatabase( 0 );
 
   if( s_ComponentLoader )
   {
+    s_ComponentLoader->SetComponentDatabase( 0 );
     s_ComponentLoader->UnloadComponents();
   }
 
   s_ComponentLoader = 0;
 
+  /** The buffers that the components kept over their stages are not needed anymore. */
+  itk::ReusableBufferPool::ReleaseCachedBuffers();
+
 } // end UnloadComponents()
 
 
@@ -983,6 +1128,29 @@ ElastixMain::SetMaximumNumberOfThreads( void ) const
   std::string maximumNumberOfThreadsString
     = this->m_Configuration->GetCommandLineArgument( "-threads" );
 
+  /** With -numa on, the threads of the pool are pinned to the NUMA nodes. */
+  const std::string numaString = this->m_Configuration->GetCommandLineArgument( "-numa" );
+  if( numaString != "" )
+  {
+    itk::PersistentThreadPool::GetInstance()->SetNUMAPlacement( numaString == "on" );
+  }
+
+  /** Concurrent runs share the threads: each uses its part of the global
+   * maximum for its metrics.
+   */
+  const unsigned int numberOfRuns = RunCounter::GetNumberOfRuns();
+  if( numberOfRuns > 1 )
+  {
+    if( maximumNumberOfThreadsString == "" )
+    {
+      const unsigned int globalMaximum
+        = itk::MultiThreaderBase::GetGlobalMaximumNumberOfThreads();
+      const unsigned int share = globalMaximum > numberOfRuns ? globalMaximum / numberOfRuns : 1;
+      this->m_Configuration->SetCommandLineArgument( "-threads", std::to_string( share ) );
+    }
+    return;
+  }
+
   /** If supplied, set the maximum number of threads. */
   if( maximumNumberOfThreadsString != "" )
   {
@@ -1028,6 +1196,41 @@ ElastixMain::GetTransformParametersMap( void ) const
 } // end GetTransformParametersMap()
 
 
+/**
+ * ******************** SetWarmStart ********************
+ */
+
+void
+ElastixMain::SetWarmStart( ParameterMapType & parameterMap,
+  const ParameterMapType & previousTransformParametersMap )
+{
+  const auto transformParameters = previousTransformParametersMap.find( "TransformParameters" );
+  if( transformParameters != previousTransformParametersMap.end() )
+  {
+    parameterMap[ "WarmStartTransformParameters" ] = transformParameters->second;
+  }
+
+  /** The settings that the AdaptiveStochasticGradientDescent estimated. */
+  const char * const stepSizeSettings[] = {
+    "SP_a", "SP_A", "SP_alpha", "SigmoidMax", "SigmoidMin", "SigmoidScale" };
+  bool foundStepSizeSettings = false;
+  for( const char * const name : stepSizeSettings )
+  {
+    const auto setting = previousTransformParametersMap.find( name );
+    if( setting != previousTransformParametersMap.end() && !setting->second.empty() )
+    {
+      parameterMap[ name ]  = setting->second;
+      foundStepSizeSettings = true;
+    }
+  }
+  if( foundStepSizeSettings )
+  {
+    parameterMap[ "AutomaticParameterEstimation" ] = std::vector< std::string >( 1, "false" );
+  }
+
+} // end SetWarmStart()
+
+
 /**
  * ******************** GetImageInformationFromFile ********************
  */
@@ -1035,7 +1238,8 @@ ElastixMain::GetTransformParametersMap( void ) const
 void
 ElastixMain::GetImageInformationFromFile(
   const std::string & filename,
-  ImageDimensionType & imageDimension ) const
+  ImageDimensionType & imageDimension,
+  ImageIOPointer & imageIO ) const
 {
   if( filename != "" )
   {
@@ -1053,7 +1257,7 @@ ElastixMain::GetImageInformationFromFile(
     testReader->UpdateOutputInformation();
 
     /** Extract the required information. */
-    itk::SmartPointer<const itk::ImageIOBase> testImageIO = testReader->GetImageIO();
+    ImageIOPointer testImageIO = testReader->GetModifiableImageIO();
     //itk::ImageIOBase::IOComponentType componentType = testImageIO->GetComponentType();
     //pixelType = itk::ImageIOBase::GetComponentTypeAsString( componentType );
     if( testImageIO.IsNull() )
@@ -1063,9 +1267,34 @@ ElastixMain::GetImageInformationFromFile(
       itkExceptionMacro( << "ERROR: ImageIO object was not created, but no exception was thrown." );
     }
     imageDimension = testImageIO->GetNumberOfDimensions();
+    imageIO        = testImageIO;
   } // end if
 
 } // end GetImageInformationFromFile()
 
 
+/**
+ * ******************* AdaptInternalImagePixelType *******************
+ */
+
+void
+ElastixMain::AdaptInternalImagePixelType( std::string & pixelType,
+  const std::string & parameterName )
+{
+#ifdef ELASTIX_FLOAT_INTERNAL_PIXEL_TYPE_ONLY
+  if( pixelType != "float" )
+  {
+    xout[ "warning" ] << "WARNING: elastix is only compiled for float internal images.\n"
+                      << "  The requested (" << parameterName << " \"" << pixelType
+                      << "\") is replaced by \"float\"." << std::endl;
+    pixelType = "float";
+  }
+#else
+  (void)pixelType;
+  (void)parameterName;
+#endif
+
+} // end AdaptInternalImagePixelType()
+
+
 } // end namespace elastix
@@ -26,6 +26,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <mutex>
 
 #include "itkParameterMapInterface.h"
 
@@ -54,6 +55,46 @@ namespace elastix
  */
 extern int xoutSetup( const char * logfilename, bool setupLogging, bool setupCout );
 
+/**
+ * \class ThreadXout
+ * \brief The xout of one thread, for running several registrations in
+ * one process, such as the jobs of the server mode of elastix, or several
+ * ElastixFilters in parallel threads.
+ *
+ * The constructor sets up the same fields as xoutSetup(), writing to the
+ * logfile and/or std::cout, and makes them the xout of the calling thread,
+ * until the object is destroyed. Messages of the threads that are started
+ * by the calling thread go to the xout of xoutSetup(), which is set up
+ * without outputs if it was not yet.
+ */
+class ThreadXout
+{
+public:
+
+  ThreadXout( const char * logfilename, bool setupLogging, bool setupCout );
+  ~ThreadXout();
+
+  /** Returns 0 if the logfile could be opened, 1 otherwise. */
+  int GetErrorCode( void ) const { return this->m_ErrorCode; }
+
+private:
+
+  ThreadXout( const ThreadXout & ) = delete;
+  ThreadXout & operator=( const ThreadXout & ) = delete;
+
+  xl::xoutbase_type   m_Xout;
+  xl::xoutsimple_type m_WarningXout;
+  xl::xoutsimple_type m_ErrorXout;
+  xl::xoutsimple_type m_StandardXout;
+  xl::xoutsimple_type m_CoutOnlyXout;
+  xl::xoutsimple_type m_LogOnlyXout;
+  int                 m_ErrorCode;
+  xl::xoutbase_type * m_PreviousXout;
+
+  /** The logfile, written by a background thread. */
+  xl::xoutasyncofstream_type m_LogFileStream;
+};
+
 /**
  * \class ElastixMain
  * \brief A class with all functionality to configure elastix.
@@ -76,6 +117,8 @@ extern int xoutSetup( const char * logfilename, bool setupLogging, bool setupCou
  * to this type.\n
  * example: <tt>(MovingInternalImagePixelType "float")</tt>\n
  * Default/recommended: "float"\n
+ * When elastix is compiled with ELASTIX_FLOAT_INTERNAL_PIXEL_TYPE_ONLY, the
+ * internal pixel types are always "float", whatever these parameters say.\n
  *
  * \transformparameter FixedImageDimension: the dimension of the fixed image. \n
  * example: <tt>(FixedImageDimension 2)</tt>\n
@@ -129,6 +172,7 @@ public:
   typedef ElastixBase::ObjectContainerPointer           ObjectContainerPointer;
   typedef ElastixBase::DataObjectContainerPointer       DataObjectContainerPointer;
   typedef ElastixBase::FlatDirectionCosinesType         FlatDirectionCosinesType;
+  typedef ElastixBase::ImageIOPointer                   ImageIOPointer;
 
   /** Typedefs for the database that holds pointers to New() functions.
    * Those functions are used to instantiate components, such as the metric etc.
@@ -272,6 +316,11 @@ public:
   /** Set maximum number of threads, which is read from the command line arguments.
    * Syntax:
    * -threads \<int\>
+   * While several runs are in progress in different threads, the global
+   * maximum is not changed, and without -threads a run uses its part of the
+   * global maximum for its metrics.
+   * With -numa on, the threads of the PersistentThreadPool are pinned to the
+   * NUMA nodes, and the metrics spread their images over the nodes.
    */
   virtual void SetMaximumNumberOfThreads( void ) const;
 
@@ -294,8 +343,31 @@ public:
   /** GetTransformParametersMap */
   virtual ParameterMapType GetTransformParametersMap( void ) const;
 
+  /** Let the next registration of a sequence start where the previous one
+   * ended: the transform parameters of the transform parameter map of the
+   * previous registration become the WarmStartTransformParameters of the
+   * parameter map, and the step size settings of the optimizer that it
+   * contains replace the automatic parameter estimation.
+   */
+  static void SetWarmStart( ParameterMapType & parameterMap,
+    const ParameterMapType & previousTransformParametersMap );
+
   static void UnloadComponents( void );
 
+  /** Keep the OpenCL context when an ElastixMain is destroyed, so that the
+   * next run uses it again. By default the context is released. */
+  static void SetKeepOpenCLContext( const bool keep )
+  {
+    s_KeepOpenCLContext = keep;
+  }
+
+
+  static bool GetKeepOpenCLContext( void )
+  {
+    return s_KeepOpenCLContext;
+  }
+
+
 protected:
 
   ElastixMain();
@@ -328,6 +400,10 @@ protected:
   DataObjectContainerPointer m_ResultImageContainer;
   DataObjectContainerPointer m_ResultDeformationFieldContainer;
 
+  /** The ImageIO objects that have read the fixed and moving image headers. */
+  ImageIOPointer m_FixedImageIO;
+  ImageIOPointer m_MovingImageIO;
+
   /** A transform that is the result of registration. */
   ObjectPointer m_FinalTransform;
 
@@ -342,8 +418,32 @@ protected:
 
   static ComponentDatabasePointer s_CDB;
   static ComponentLoaderPointer   s_ComponentLoader;
+  static bool                     s_KeepOpenCLContext;
   virtual int LoadComponents( void );
 
+  /** The mutex that protects loading and unloading the components, which
+   * are shared by the runs of all threads. */
+  static std::mutex & GetComponentsMutex( void );
+
+  /** Counts the runs in progress in all threads during its lifetime. The
+   * components are not unloaded while runs are in progress, and concurrent
+   * runs share the threads, see SetMaximumNumberOfThreads(). */
+  class RunCounter
+  {
+public:
+
+    RunCounter();
+    ~RunCounter();
+
+    /** The number of runs in progress. */
+    static unsigned int GetNumberOfRuns( void );
+
+private:
+
+    friend class ElastixMain;
+    static unsigned int s_NumberOfRuns;
+  };
+
   /** InitDBIndex sets m_DBIndex by asking the ImageTypes
    * from the Configuration object and obtaining the corresponding
    * DB index from the ComponentDatabase.
@@ -376,9 +476,19 @@ protected:
     int & errorcode,
     bool mandatoryComponent = true );
 
-  /** Helper function to obtain information from images on disk. */
+  /** Helper function to obtain information from images on disk. Only the
+   * header is read. The ImageIO that has read it is returned, so that it can
+   * be reused to read the image.
+   */
   void GetImageInformationFromFile( const std::string & filename,
-    ImageDimensionType & imageDimension ) const;
+    ImageDimensionType & imageDimension, ImageIOPointer & imageIO ) const;
+
+  /** Helper function that replaces a requested internal image pixel type by
+   * float, when elastix is compiled with ELASTIX_FLOAT_INTERNAL_PIXEL_TYPE_ONLY.
+   * The images are then converted to float while they are read.
+   */
+  static void AdaptInternalImagePixelType( std::string & pixelType,
+    const std::string & parameterName );
 
 private:
 
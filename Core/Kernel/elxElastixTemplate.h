@@ -38,10 +38,16 @@
 #include "elxResampleInterpolatorBase.h"
 #include "elxTransformBase.h"
 
+#include "itkMemoryUsage.h"
+#include "itkProfiler.h"
+#include "itkReusableBufferPool.h"
 #include "itkTimeProbe.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <sstream>
 #include <fstream>
+#include <vector>
 
 /**
  * Macro that defines to functions. In the case of
@@ -94,6 +100,49 @@ namespace elastix
  *    example: <tt>(WriteTransformParametersEachResolution "true")</tt>\n
  *    This parameter can not be specified for each resolution separately.
  *    Default value: "false".
+ * \parameter WriteCheckpointEachResolution: Controls whether to save a
+ *    checkpoint, Checkpoint.txt, in the output directory after every
+ *    resolution. It holds the elastix level, the resolution and the
+ *    transform parameters. An interrupted registration is continued after
+ *    its last finished resolution by running elastix again with the same
+ *    arguments and "-resume <out>/Checkpoint.txt". The random generator is
+ *    then restarted in every resolution with RandomSeed plus the resolution,
+ *    so that the resumed run gives the same result.\n
+ *    example: <tt>(WriteCheckpointEachResolution "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
+ * \parameter WriteIterationInfoBinary: Controls whether to save the table
+ *    with iteration info also in a compact binary file,
+ *    IterationInfo.<ElastixLevel>.R<Resolution>.bin, next to the text file.
+ *    The file starts with the magic string "ELXITER1", the number of columns
+ *    and the column names, each as a 32-bit length and its characters. Then
+ *    follows one record per iteration, with one double per column, in which
+ *    non-numeric entries are NaN. All numbers are little endian. The file
+ *    can be read with tools/elxReadIterationInfo.py.\n
+ *    example: <tt>(WriteIterationInfoBinary "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
+ * \parameter EnableProfiling: Controls whether to measure the time spent in
+ *    the image sampler, interpolator, transform, metric reduction and optimizer
+ *    update. The times are printed after each resolution and saved to
+ *    ProfilingInfo.<ElastixLevel>.json in the output directory.\n
+ *    example: <tt>(EnableProfiling "true")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "false".
+ * \parameter MaximumMemoryUsage: A budget for the memory of the registration,
+ *    like "8GB" or "512MB". Before the registration and before each
+ *    resolution, the memory of the images, the pyramid images, the B-spline
+ *    coefficients of the interpolators, and the per-thread derivatives and
+ *    histograms of the metrics is estimated. While the estimate exceeds the
+ *    budget, the pyramid images are computed per resolution, the histograms
+ *    of the metrics are accumulated in shared shards, and the number of
+ *    threads of the metrics is reduced, in that order. A strategy is not
+ *    applied if its own parameter, ComputePyramidImagesPerResolution or
+ *    PDFAccumulationMode, is given. The estimates, the strategies and the
+ *    peak memory usage are printed in the log.\n
+ *    example: <tt>(MaximumMemoryUsage "8GB")</tt>\n
+ *    This parameter can not be specified for each resolution separately.
+ *    Default value: "", no budget.
  * \parameter UseDirectionCosines: Controls whether to use or ignore the
  * direction cosines (world matrix, transform matrix) set in the images.
  * Voxel spacing and image origin are always taken into account, regardless
@@ -141,6 +190,8 @@ public:
   typedef Superclass2::ObjectContainerPointer     ObjectContainerPointer;
   typedef Superclass2::DataObjectContainerPointer DataObjectContainerPointer;
   typedef Superclass2::FileNameContainerPointer   FileNameContainerPointer;
+  typedef Superclass2::ImageIOType                ImageIOType;
+  typedef Superclass2::ResultCacheKeyType         ResultCacheKeyType;
 
   /** Typedef's for this class. */
   typedef TFixedImage                       FixedImageType;
@@ -356,6 +407,9 @@ protected:
   TimerType m_IterationTimer;
   TimerType m_ResolutionTimer;
 
+  /** The profiling results of the finished resolutions, as JSON objects. */
+  std::string m_ProfilingResolutions;
+
   /** Store the CurrentTransformParameterFileName. */
   std::string m_CurrentTransformParameterFileName;
 
@@ -365,6 +419,30 @@ protected:
   /** Count the number of iterations. */
   unsigned int m_IterationCounter;
 
+  /** The memory budget in bytes, or 0 when there is none. */
+  std::uint64_t m_MaximumMemoryUsage;
+
+  /** Read the memory budget and compute the pyramid images per resolution,
+   * if all of them do not fit. Called after the BeforeRegistration() of the
+   * components, since the pyramid images are computed after it.
+   */
+  virtual void InitializeMemoryBudget( void );
+
+  /** Reduce the memory of the metrics in this resolution, if the estimate
+   * does not fit the budget. Called after the BeforeEachResolution() of the
+   * components, when the number of transform parameters is known.
+   */
+  virtual void ApplyMemoryBudget( const unsigned int level );
+
+  /** Estimate the memory of the images, of the pyramid images in a
+   * resolution, and of the B-spline coefficients of the interpolators.
+   */
+  virtual std::uint64_t EstimateImageMemory( void ) const;
+
+  virtual std::uint64_t EstimatePyramidMemory( const unsigned int level ) const;
+
+  virtual std::uint64_t EstimateCoefficientMemory( const unsigned int level ) const;
+
   /** CreateTransformParameterFile. */
   virtual void CreateTransformParameterFile( const std::string FileName,
     const bool ToLog );
@@ -378,11 +456,32 @@ protected:
   /** Stores transformation parameters map. */
   ParameterMapType m_TransformParametersMap;
 
+  /** Write the checkpoint of a finished resolution to Checkpoint.txt in the
+   * output directory: the elastix level, the resolution and the transform
+   * parameters. The file is replaced atomically, so that it is complete
+   * when the registration is interrupted.
+   */
+  virtual void WriteCheckpoint( const unsigned long level );
+
+  /** Read the checkpoint given by the command line argument -resume, and
+   * let the registration skip the resolutions it covers, if it belongs to
+   * this elastix level.
+   */
+  virtual void ReadCheckpoint( void );
+
   /** Open the IterationInfoFile, where the table with iteration info is written to. */
   virtual void OpenIterationInfoFile( void );
 
   std::ofstream m_IterationInfoFile;
 
+  /** Write the iteration info of this iteration to the binary file, as one
+   * record of doubles. In the first iteration the header is written first.
+   */
+  virtual void WriteIterationInfoBinaryRecord( void );
+
+  std::ofstream              m_IterationInfoBinaryFile;
+  std::vector< std::string > m_IterationInfoBinaryNames;
+
   /** Used by the callback functions, BeforeEachResolution() etc.).
    * This method calls a function in each component, in the following order:
    * \li Registration
@@ -414,6 +513,35 @@ private:
   ElastixTemplate( const Self & ); // purposely not implemented
   void operator=( const Self & );  // purposely not implemented
 
+  /** The memory of the pyramid images of an input image in a resolution.
+   * Includes the images of all resolutions, unless they are computed per
+   * resolution.
+   */
+  template< class TImage >
+  static std::uint64_t GetPyramidMemory(
+    const itk::MultiResolutionPyramidImageFilter< TImage, TImage > * pyramid,
+    const TImage * image, const unsigned int level );
+
+  /** The number of pixels of the pyramid image of an input image in a
+   * resolution.
+   */
+  template< class TImage >
+  static std::uint64_t GetPyramidNumberOfPixels(
+    const itk::MultiResolutionPyramidImageFilter< TImage, TImage > * pyramid,
+    const TImage * image, const unsigned int level );
+
+  /** Whether a pyramid computes its images per resolution. */
+  template< class TImage >
+  static bool GetComputeOnlyForCurrentLevel(
+    const itk::MultiResolutionPyramidImageFilter< TImage, TImage > * pyramid );
+
+  /** Let a pyramid compute its images per resolution. Returns false if the
+   * pyramid does not support that.
+   */
+  template< class TImage >
+  static bool SetComputeOnlyForCurrentLevel(
+    itk::MultiResolutionPyramidImageFilter< TImage, TImage > * pyramid );
+
 };
 
 } // end namespace elastix
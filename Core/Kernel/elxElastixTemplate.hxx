@@ -20,6 +20,18 @@
 
 #include "elxElastixTemplate.h"
 
+#include "itkGenericMultiResolutionPyramidImageFilter.h"
+#include "itkMultiResolutionGaussianSmoothingPyramidImageFilter.h"
+#include "itkParzenWindowHistogramImageToImageMetric.h"
+#include "itkByteSwapper.h"
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkParameterMapInterface.h"
+#include "itksys/SystemTools.hxx"
+
+#include <cstdlib>
+#include <future>
+#include <limits>
+
 #define elxCheckAndSetComponentMacro( _name ) \
   _name##BaseType * base = this->GetElx##_name##Base( i ); \
   if( base != 0 ) \
@@ -60,6 +72,9 @@ ElastixTemplate< TFixedImage, TMovingImage >
   /** Initialize the this->m_IterationCounter. */
   this->m_IterationCounter = 0;
 
+  /** No memory budget, until it is read from the parameter file. */
+  this->m_MaximumMemoryUsage = 0;
+
   /** Initialize CurrentTransformParameterFileName. */
   this->m_CurrentTransformParameterFileName = "";
   this->m_TransformParametersMap.clear();
@@ -254,14 +269,69 @@ ElastixTemplate< TFixedImage, TMovingImage >
   this->m_Timer0.Start();
   elxout << "\nReading images..." << std::endl;
 
-  /** Read images and masks, if not set already. */
-  const bool              useDirCos = this->GetUseDirectionCosines();
+  /** Read images and masks, if not set already. The images and masks are
+   * read concurrently, each by its own thread. The headers of the first fixed
+   * and moving image have been read by ElastixMain already, so their ImageIO
+   * objects are reused. The futures are waited for before an exception of
+   * one of them is passed on.
+   */
+  typedef std::future< DataObjectContainerPointer > ContainerFutureType;
+  const bool              useDirCos        = this->GetUseDirectionCosines();
+  const bool              useMemoryMapping = this->GetUseMemoryMappedImages();
   FixedImageDirectionType fixDirCos;
+  ContainerFutureType     fixedImageFuture;
+  ContainerFutureType     movingImageFuture;
+  ContainerFutureType     fixedMaskFuture;
+  ContainerFutureType     movingMaskFuture;
   if( this->GetFixedImage() == 0 )
   {
-    this->SetFixedImageContainer(
-      FixedImageLoaderType::GenerateImageContainer(
-      this->GetFixedImageFileNameContainer(), "Fixed Image", useDirCos, &fixDirCos ) );
+    FileNameContainerType * fileNames = this->GetFixedImageFileNameContainer();
+    ImageIOType *           imageIO   = this->GetFixedImageIO();
+    fixedImageFuture = std::async( std::launch::async, [ =, &fixDirCos ]() {
+      return FixedImageLoaderType::GenerateImageContainer(
+        fileNames, "Fixed Image", useDirCos, &fixDirCos, imageIO, useMemoryMapping );
+    } );
+  }
+  if( this->GetMovingImage() == 0 )
+  {
+    FileNameContainerType * fileNames = this->GetMovingImageFileNameContainer();
+    ImageIOType *           imageIO   = this->GetMovingImageIO();
+    movingImageFuture = std::async( std::launch::async, [ = ]() {
+      return MovingImageLoaderType::GenerateImageContainer(
+        fileNames, "Moving Image", useDirCos, nullptr, imageIO, useMemoryMapping );
+    } );
+  }
+  if( this->GetFixedMask() == 0 )
+  {
+    FileNameContainerType * fileNames = this->GetFixedMaskFileNameContainer();
+    fixedMaskFuture = std::async( std::launch::async, [ = ]() {
+      return FixedMaskLoaderType::GenerateImageContainer(
+        fileNames, "Fixed Mask", useDirCos, nullptr, nullptr, useMemoryMapping );
+    } );
+  }
+  if( this->GetMovingMask() == 0 )
+  {
+    FileNameContainerType * fileNames = this->GetMovingMaskFileNameContainer();
+    movingMaskFuture = std::async( std::launch::async, [ = ]() {
+      return MovingMaskLoaderType::GenerateImageContainer(
+        fileNames, "Moving Mask", useDirCos, nullptr, nullptr, useMemoryMapping );
+    } );
+  }
+
+  ContainerFutureType * futures[ 4 ] = {
+    &fixedImageFuture, &movingImageFuture, &fixedMaskFuture, &movingMaskFuture
+  };
+  for( unsigned int i = 0; i < 4; ++i )
+  {
+    if( futures[ i ]->valid() )
+    {
+      futures[ i ]->wait();
+    }
+  }
+
+  if( fixedImageFuture.valid() )
+  {
+    this->SetFixedImageContainer( fixedImageFuture.get() );
     this->SetOriginalFixedImageDirection( fixDirCos );
   }
   else
@@ -277,23 +347,17 @@ ElastixTemplate< TFixedImage, TMovingImage >
     this->SetOriginalFixedImageDirection( fixDirCos );
   }
 
-  if( this->GetMovingImage() == 0 )
+  if( movingImageFuture.valid() )
   {
-    this->SetMovingImageContainer(
-      MovingImageLoaderType::GenerateImageContainer(
-      this->GetMovingImageFileNameContainer(), "Moving Image", useDirCos ) );
+    this->SetMovingImageContainer( movingImageFuture.get() );
   }
-  if( this->GetFixedMask() == 0 )
+  if( fixedMaskFuture.valid() )
   {
-    this->SetFixedMaskContainer(
-      FixedMaskLoaderType::GenerateImageContainer(
-      this->GetFixedMaskFileNameContainer(), "Fixed Mask", useDirCos ) );
+    this->SetFixedMaskContainer( fixedMaskFuture.get() );
   }
-  if( this->GetMovingMask() == 0 )
+  if( movingMaskFuture.valid() )
   {
-    this->SetMovingMaskContainer(
-      MovingMaskLoaderType::GenerateImageContainer(
-      this->GetMovingMaskFileNameContainer(), "Moving Mask", useDirCos ) );
+    this->SetMovingMaskContainer( movingMaskFuture.get() );
   }
 
   /** Print the time spent on reading images. */
@@ -304,9 +368,10 @@ ElastixTemplate< TFixedImage, TMovingImage >
   /** Give all components the opportunity to do some initialization. */
   this->BeforeRegistration();
 
-  /** START! */
+  /** START! Skip the resolutions that were finished before the checkpoint. */
   try
   {
+    this->ReadCheckpoint();
     ( this->GetElxRegistrationBase()->GetAsITKBaseType() )->StartRegistration();
   }
   catch( itk::ExceptionObject & excp )
@@ -399,7 +464,8 @@ ElastixTemplate< TFixedImage, TMovingImage >
     {
       this->SetMovingImageContainer(
         MovingImageLoaderType::GenerateImageContainer(
-        this->GetMovingImageFileNameContainer(), "Input Image", useDirCos ) );
+        this->GetMovingImageFileNameContainer(), "Input Image", useDirCos,
+        nullptr, nullptr, this->GetUseMemoryMappedImages() ) );
     } // end if !moving image
 
     /** Tell the user. */
@@ -424,6 +490,31 @@ ElastixTemplate< TFixedImage, TMovingImage >
          << timer.GetMean()
          << " s" << std::endl;
 
+  /** The outputs that are computed for all voxels go through the result
+   * cache, if "-cache" is given. Their key is a hash of the transform and of
+   * the transform parameter file, which includes the output settings.
+   */
+  const bool         useResultCache = !this->GetConfiguration()->GetCommandLineArgument( "-cache" ).empty();
+  ResultCacheKeyType resultCacheKey = 0;
+  if( useResultCache )
+  {
+    resultCacheKey = itk::DataHash::CombineValue( this->ComputeParameterMapHash(),
+      this->GetElxTransformBase()->ComputeTransformHash() );
+  }
+  const auto produceThroughResultCache = [ this, resultCacheKey ](
+    const std::string & option, const std::string & outputName,
+    const std::function< void( void ) > & produceOutput )
+    {
+      if( this->GetConfiguration()->GetCommandLineArgument( option ) == "all" )
+      {
+        this->RunThroughResultCache( outputName, resultCacheKey, produceOutput );
+      }
+      else
+      {
+        produceOutput();
+      }
+    };
+
   /** Call TransformPoints.
    * Actually we could loop over all transforms.
    * But for now, there seems to be no use yet for that.
@@ -433,7 +524,8 @@ ElastixTemplate< TFixedImage, TMovingImage >
   elxout << "Transforming points ..." << std::endl;
   try
   {
-    this->GetElxTransformBase()->TransformPoints();
+    produceThroughResultCache( "-def", "deformationField",
+      [ this ]() { this->GetElxTransformBase()->TransformPoints(); } );
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -453,7 +545,8 @@ ElastixTemplate< TFixedImage, TMovingImage >
   elxout << "Compute determinant of spatial Jacobian ..." << std::endl;
   try
   {
-    this->GetElxTransformBase()->ComputeDeterminantOfSpatialJacobian();
+    produceThroughResultCache( "-jac", "spatialJacobian",
+      [ this ]() { this->GetElxTransformBase()->ComputeDeterminantOfSpatialJacobian(); } );
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -473,7 +566,8 @@ ElastixTemplate< TFixedImage, TMovingImage >
   elxout << "Compute spatial Jacobian (full matrix) ..." << std::endl;
   try
   {
-    this->GetElxTransformBase()->ComputeSpatialJacobian();
+    produceThroughResultCache( "-jacmat", "fullSpatialJacobian",
+      [ this ]() { this->GetElxTransformBase()->ComputeSpatialJacobian(); } );
   }
   catch( itk::ExceptionObject & excp )
   {
@@ -495,17 +589,73 @@ ElastixTemplate< TFixedImage, TMovingImage >
     std::string resultImageFormat = "mhd";
     this->GetConfiguration()->ReadParameter( resultImageFormat,
       "ResultImageFormat", 0, false );
-    std::ostringstream makeFileName( "" );
-    makeFileName << this->GetConfiguration()->GetCommandLineArgument( "-out" )
-                 << "result." << resultImageFormat;
 
     /** Write the resampled image to disk.
      * Actually we could loop over all resamplers.
      * But for now, there seems to be no use yet for that.
      */
-    if (!BaseComponent::IsElastixLibrary())
+    if( !BaseComponent::IsElastixLibrary()
+      && !this->GetConfiguration()->GetCommandLineArgument( "-in1" ).empty() )
     {
-      this->GetElxResamplerBase()->ResampleAndWriteResultImage( makeFileName.str().c_str() );
+      /** The additional inputs "-in1", "-in2", etc. are resampled along with
+       * the input image, such that the transform is evaluated once per voxel.
+       */
+      typedef typename ResamplerBaseType::AdditionalInputType AdditionalInputType;
+      typename ResamplerBaseType::AdditionalInputContainerType additionalInputs;
+      const bool useDirCos = this->GetUseDirectionCosines();
+      for( unsigned int k = 1;; ++k )
+      {
+        std::ostringstream suffix( "" );
+        suffix << k;
+        const std::string fileName = this->GetConfiguration()->GetCommandLineArgument( "-in" + suffix.str() );
+        if( fileName.empty() ) { break; }
+
+        FileNameContainerPointer fileNameContainer = FileNameContainerType::New();
+        fileNameContainer->CreateElementAt( 0 ) = fileName;
+        DataObjectContainerPointer imageContainer = MovingImageLoaderType::GenerateImageContainer(
+          fileNameContainer, "Input Image " + suffix.str(), useDirCos );
+
+        AdditionalInputType additionalInput;
+        additionalInput.Image = dynamic_cast< const MovingImageType * >(
+          imageContainer->ElementAt( 0 ).GetPointer() );
+        additionalInput.Interpolator = this->GetConfiguration()->GetCommandLineArgument( "-interp" + suffix.str() );
+        additionalInput.PixelType    = this->GetConfiguration()->GetCommandLineArgument( "-pt" + suffix.str() );
+        additionalInput.FileName     = this->GetConfiguration()->GetCommandLineArgument( "-out" )
+          + "result." + suffix.str() + "." + resultImageFormat;
+        additionalInputs.push_back( additionalInput );
+      }
+
+      elxout << "  Resampling " << additionalInputs.size()
+             << " additional input image(s) along with the input image" << std::endl;
+      const std::string fileName = this->GetConfiguration()->GetCommandLineArgument( "-out" )
+        + "result." + resultImageFormat;
+      this->GetElxResamplerBase()->ResampleAndWriteResultImages( fileName.c_str(), additionalInputs );
+    }
+    else if (!BaseComponent::IsElastixLibrary())
+    {
+      /** The result image also depends on the input image. */
+      ResultCacheKeyType inputImageKey = resultCacheKey;
+      if( useResultCache )
+      {
+        const MovingImageType * inputImage = this->GetMovingImage();
+        inputImageKey = itk::DataHash::CombineValue( inputImageKey,
+          inputImage->GetLargestPossibleRegion().GetIndex() );
+        inputImageKey = itk::DataHash::CombineValue( inputImageKey,
+          inputImage->GetLargestPossibleRegion().GetSize() );
+        inputImageKey = itk::DataHash::CombineValue( inputImageKey, inputImage->GetSpacing() );
+        inputImageKey = itk::DataHash::CombineValue( inputImageKey, inputImage->GetOrigin() );
+        inputImageKey = itk::DataHash::CombineValue( inputImageKey, inputImage->GetDirection() );
+        inputImageKey = itk::DataHash::Combine( inputImageKey, inputImage->GetBufferPointer(),
+          inputImage->GetPixelContainer()->Size() * sizeof( typename MovingImageType::PixelType ) );
+      }
+      this->RunThroughResultCache( "result", inputImageKey,
+        [ this, &resultImageFormat ]()
+        {
+          std::ostringstream makeFileName( "" );
+          makeFileName << this->GetConfiguration()->GetCommandLineArgument( "-out" )
+                       << "result." << resultImageFormat;
+          this->GetElxResamplerBase()->ResampleAndWriteResultImage( makeFileName.str().c_str() );
+        } );
     }
     else
     {
@@ -601,11 +751,17 @@ ElastixTemplate< TFixedImage, TMovingImage >
   this->m_Timer0.Reset();
   this->m_Timer0.Start();
 
+  /** Count the buffer requests of the components from here on. */
+  itk::ReusableBufferPool::ResetStatistics();
+
   /** Call all the BeforeRegistration() functions. */
   this->BeforeRegistrationBase();
   CallInEachComponent( &BaseComponentType::BeforeRegistrationBase );
   CallInEachComponent( &BaseComponentType::BeforeRegistration );
 
+  /** Fit the pyramids in the memory budget, before they are computed. */
+  this->InitializeMemoryBudget();
+
   /** Add a column to iteration with the iteration number. */
   xout[ "iteration" ].AddTargetCell( "1:ItNr" );
 
@@ -657,25 +813,59 @@ ElastixTemplate< TFixedImage, TMovingImage >
   /** Print the current resolution. */
   elxout << "\nResolution: " << level << std::endl;
 
-  /** Create a TransformParameter-file for the current resolution. */
+  /** Restart the random generator in each resolution of a checkpointed or
+   * resumed registration, so that a resumed resolution draws the same
+   * samples as it did originally.
+   */
+  bool writeCheckpoint = false;
+  this->GetConfiguration()->ReadParameter( writeCheckpoint,
+    "WriteCheckpointEachResolution", 0, false );
+  if( writeCheckpoint || !this->GetConfiguration()->GetCommandLineArgument( "-resume" ).empty() )
+  {
+    typedef itk::Statistics::MersenneTwisterRandomVariateGenerator RandomGeneratorType;
+    unsigned int randomSeed = 121212;
+    this->GetConfiguration()->ReadParameter( randomSeed, "RandomSeed", 0, false );
+    RandomGeneratorType::GetInstance()->SetSeed(
+      static_cast< RandomGeneratorType::IntegerType >( randomSeed + level ) );
+  }
+
+  /** Create a TransformParameter-file for the current resolution. The
+   * resolutions restored from a checkpoint keep their original file.
+   */
+  const bool resumed = static_cast< long >( level )
+    <= this->GetElxRegistrationBase()->GetAsITKBaseType()->GetResumeLevel();
   bool writeIterationInfo = true;
   this->GetConfiguration()->ReadParameter( writeIterationInfo,
     "WriteIterationInfo", 0, false );
-  if( writeIterationInfo )
+  if( writeIterationInfo && !resumed )
   {
     this->OpenIterationInfoFile();
   }
+  if( resumed )
+  {
+    elxout << "This resolution is restored from the checkpoint." << std::endl;
+  }
 
   /** Call all the BeforeEachResolution() functions. */
   this->BeforeEachResolutionBase();
   CallInEachComponent( &BaseComponentType::BeforeEachResolutionBase );
   CallInEachComponent( &BaseComponentType::BeforeEachResolution );
 
+  /** Fit the metrics in the memory budget. */
+  this->ApplyMemoryBudget( level );
+
   /** Print the extra preparation time needed for this resolution. */
   this->m_Timer0.Stop();
   elxout << "Elastix initialization of all components (for this resolution) took: "
          << static_cast< unsigned long >( this->m_Timer0.GetMean() * 1000 ) << " ms.\n";
 
+  /** Start profiling the hot paths, if the user wanted it. */
+  bool enableProfiling = false;
+  this->GetConfiguration()->ReadParameter( enableProfiling,
+    "EnableProfiling", 0, false );
+  itk::Profiler::SetEnabled( enableProfiling );
+  itk::Profiler::Reset();
+
   /** Start ResolutionTimer, which measures the total iteration time in this resolution. */
   this->m_ResolutionTimer.Reset();
   this->m_ResolutionTimer.Start();
@@ -713,6 +903,42 @@ ElastixTemplate< TFixedImage, TMovingImage >
     << " s.\n";
   elxout << std::setprecision( this->GetDefaultOutputPrecision() );
 
+  /** Print the peak memory usage, if there is a memory budget. */
+  if( this->m_MaximumMemoryUsage > 0 )
+  {
+    elxout << "Peak memory usage after resolution " << level << ": "
+           << itk::MemoryUsage::FormatSize( itk::MemoryUsage::GetPeakResidentMemory() )
+           << " (budget " << itk::MemoryUsage::FormatSize( this->m_MaximumMemoryUsage )
+           << ").\n";
+  }
+
+  /** Print the profiling results of this resolution. */
+  if( itk::Profiler::GetEnabled() )
+  {
+    itk::Profiler::SetEnabled( false );
+    std::ostringstream table( "" );
+    itk::Profiler::WriteTable( table, this->m_ResolutionTimer.GetMean() );
+    itk::ReusableBufferPool::WriteStatistics( table );
+    elxout << "Profiling of resolution " << level << ":\n" << table.str();
+
+    std::ostringstream json( "" );
+    json << ( this->m_ProfilingResolutions.empty() ? "" : ",\n" )
+         << "    {\n"
+         << "      \"resolution\": " << level << ",\n"
+         << "      \"wallTimeSeconds\": " << this->m_ResolutionTimer.GetMean() << ",\n"
+         << "      \"categories\": {\n";
+    itk::Profiler::WriteJSONMembers( json, "        " );
+    json << "      },\n"
+         << "      \"buffers\": {\n";
+    itk::ReusableBufferPool::WriteJSONMembers( json, "        " );
+    json << "      }\n"
+         << "    }";
+    this->m_ProfilingResolutions += json.str();
+  }
+
+  /** The buffer requests of the next resolution include its initialization. */
+  itk::ReusableBufferPool::ResetStatistics();
+
   /** Call all the AfterEachResolution() functions. */
   this->AfterEachResolutionBase();
   CallInEachComponent( &BaseComponentType::AfterEachResolutionBase );
@@ -737,6 +963,15 @@ ElastixTemplate< TFixedImage, TMovingImage >
     this->CreateTransformParameterFile( fileName, false );
   }
 
+  /** Write the checkpoint of this resolution. */
+  bool writeCheckpoint = false;
+  this->GetConfiguration()->ReadParameter( writeCheckpoint,
+    "WriteCheckpointEachResolution", 0, false );
+  if( writeCheckpoint )
+  {
+    this->WriteCheckpoint( level );
+  }
+
   /** Start Timer0 here, to make it possible to measure the time needed for:
    *    - executing the BeforeEachResolution methods (if this was not the last resolution)
    *    - executing the AfterRegistration methods (if this was the last resolution)
@@ -747,6 +982,105 @@ ElastixTemplate< TFixedImage, TMovingImage >
 } // end AfterEachResolution()
 
 
+/**
+ * ************** WriteCheckpoint *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::WriteCheckpoint( const unsigned long level )
+{
+  const std::string fileName
+    = this->m_Configuration->GetCommandLineArgument( "-out" ) + "Checkpoint.txt";
+  const std::string temporaryFileName = fileName + ".tmp";
+
+  /** The registration copies the position of the optimizer after this
+   * event, so take it from the optimizer.
+   */
+  const itk::Optimizer::ParametersType & parameters
+    = this->GetElxOptimizerBase()->GetAsITKBaseType()->GetCurrentPosition();
+
+  std::ofstream file( temporaryFileName.c_str() );
+  file << "// elastix checkpoint, resume with -resume " << fileName << "\n"
+       << "(CheckpointElastixLevel " << this->GetConfiguration()->GetElastixLevel() << ")\n"
+       << "(CheckpointResolution " << level << ")\n"
+       << "(NumberOfParameters " << parameters.Size() << ")\n"
+       << "(TransformParameters";
+  file << std::setprecision( std::numeric_limits< double >::max_digits10 );
+  for( unsigned int i = 0; i < parameters.Size(); ++i )
+  {
+    file << ' ' << parameters[ i ];
+  }
+  file << ")\n";
+  file.close();
+
+  if( !file || !itksys::SystemTools::RenameFile( temporaryFileName, fileName ) )
+  {
+    xl::xout[ "error" ] << "ERROR: the checkpoint \"" << fileName
+                        << "\" could not be written." << std::endl;
+    return;
+  }
+  elxout << "The checkpoint of resolution " << level
+         << " is written to \"" << fileName << "\"." << std::endl;
+
+} // end WriteCheckpoint()
+
+
+/**
+ * ************** ReadCheckpoint *****************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ReadCheckpoint( void )
+{
+  const std::string fileName = this->GetConfiguration()->GetCommandLineArgument( "-resume" );
+  if( fileName.empty() )
+  {
+    return;
+  }
+
+  const auto parser = itk::ParameterFileParser::New();
+  parser->SetParameterFileName( fileName );
+  parser->ReadParameterFile();
+  const auto checkpoint = itk::ParameterMapInterface::New();
+  checkpoint->SetParameterMap( parser->GetParameterMap() );
+
+  /** The checkpoints of the other elastix levels are ignored: the earlier
+   * ones are skipped by elastix, the later ones run completely.
+   */
+  std::string  errorMessage;
+  unsigned int elastixLevel = 0;
+  checkpoint->ReadParameter( elastixLevel, "CheckpointElastixLevel", 0, errorMessage );
+  if( elastixLevel != this->GetConfiguration()->GetElastixLevel() )
+  {
+    return;
+  }
+
+  long         resolution         = -1;
+  unsigned int numberOfParameters = 0;
+  if( !checkpoint->ReadParameter( resolution, "CheckpointResolution", 0, errorMessage )
+    || !checkpoint->ReadParameter( numberOfParameters, "NumberOfParameters", 0, errorMessage )
+    || checkpoint->CountNumberOfParameterEntries( "TransformParameters" ) != numberOfParameters )
+  {
+    itkExceptionMacro( << "The checkpoint \"" << fileName << "\" is incomplete." );
+  }
+
+  itk::Optimizer::ParametersType parameters( numberOfParameters );
+  for( unsigned int i = 0; i < numberOfParameters; ++i )
+  {
+    checkpoint->ReadParameter( parameters[ i ], "TransformParameters", i, errorMessage );
+  }
+
+  elxout << "Resuming after resolution " << resolution
+         << " from the checkpoint \"" << fileName << "\".\n" << std::endl;
+  this->GetElxRegistrationBase()->GetAsITKBaseType()->SetResumeState( resolution, parameters );
+
+} // end ReadCheckpoint()
+
+
 /**
  * ************** AfterEachIteration *******************
  */
@@ -775,6 +1109,10 @@ ElastixTemplate< TFixedImage, TMovingImage >
   xout[ "iteration" ][ "Time[ms]" ] << this->m_IterationTimer.GetMean() * 1000.0;
 
   /** Write the iteration info of this iteration. */
+  if( this->m_IterationInfoBinaryFile.is_open() )
+  {
+    this->WriteIterationInfoBinaryRecord();
+  }
   xout[ "iteration" ].WriteBufferedData();
 
   /** Create a TransformParameter-file for the current iteration. */
@@ -861,10 +1199,36 @@ ElastixTemplate< TFixedImage, TMovingImage >
     this->CreateTransformParameterFile( FileName, true );
   }
 
-  if (BaseComponent::IsElastixLibrary())
+  /** Get the transform parameters, for the library, and for the sequence
+   * mode of the command line, which warm-starts the next frame with them.
+   */
+  if( BaseComponent::IsElastixLibrary()
+    || !this->GetConfiguration()->GetCommandLineArgument( "-frames" ).empty() )
   {
-    /** Get the transform parameters. */
-    this->CreateTransformParametersMap(); // only relevant for dll!
+    this->CreateTransformParametersMap();
+  }
+
+  /** Save the profiling results of all resolutions. */
+  if( !this->m_ProfilingResolutions.empty() )
+  {
+    std::ostringstream makeFileName( "" );
+    makeFileName << this->GetConfiguration()->GetCommandLineArgument( "-out" )
+                 << "ProfilingInfo."
+                 << this->GetConfiguration()->GetElastixLevel()
+                 << ".json";
+    std::ofstream profilingFile( makeFileName.str().c_str() );
+    if( profilingFile.is_open() )
+    {
+      profilingFile << "{\n  \"resolutions\": [\n"
+                    << this->m_ProfilingResolutions
+                    << "\n  ]\n}\n";
+    }
+    else
+    {
+      xout[ "warning" ] << "WARNING: the file " << makeFileName.str()
+                        << " could not be opened!" << std::endl;
+    }
+    this->m_ProfilingResolutions.clear();
   }
 
   timer.Stop();
@@ -993,10 +1357,427 @@ ElastixTemplate< TFixedImage, TMovingImage >
     &this->m_TransformParametersMap );
   this->GetElxResamplerBase()->CreateTransformParametersMap(
     &this->m_TransformParametersMap );
+  this->GetElxOptimizerBase()->CreateTransformParametersMap(
+    &this->m_TransformParametersMap );
 
 } // end CreateTransformParametersMap()
 
 
+/**
+ * ****************** InitializeMemoryBudget ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::InitializeMemoryBudget( void )
+{
+  /** Read the budget. */
+  std::string maximumMemoryUsage = "";
+  this->GetConfiguration()->ReadParameter( maximumMemoryUsage,
+    "MaximumMemoryUsage", 0, false );
+  this->m_MaximumMemoryUsage = 0;
+  if( maximumMemoryUsage == "" )
+  {
+    return;
+  }
+  std::uint64_t budget = 0;
+  if( !itk::MemoryUsage::ParseSize( maximumMemoryUsage, budget ) || budget == 0 )
+  {
+    itkExceptionMacro( << "ERROR: MaximumMemoryUsage \"" << maximumMemoryUsage
+                       << "\" is not a memory size, like \"8GB\"." );
+  }
+  this->m_MaximumMemoryUsage = budget;
+
+  /** The largest estimate over the resolutions, without the metrics. */
+  unsigned int numberOfLevels = 0;
+  if( this->GetElxFixedImagePyramidBase() )
+  {
+    numberOfLevels = this->GetElxFixedImagePyramidBase()->GetAsITKBaseType()->GetNumberOfLevels();
+  }
+  std::uint64_t estimate = 0;
+  for( unsigned int level = 0; level < numberOfLevels; ++level )
+  {
+    estimate = std::max( estimate, this->EstimateImageMemory()
+      + this->EstimatePyramidMemory( level ) + this->EstimateCoefficientMemory( level ) );
+  }
+
+  elxout << "Memory budget: " << itk::MemoryUsage::FormatSize( budget )
+         << ", estimated memory of the images, pyramids and B-spline coefficients: "
+         << itk::MemoryUsage::FormatSize( estimate ) << ".\n";
+
+  /** Compute the pyramid images per resolution, if they do not all fit. */
+  if( estimate > budget
+    && this->GetConfiguration()->CountNumberOfParameterEntries( "ComputePyramidImagesPerResolution" ) == 0 )
+  {
+    bool switched = false;
+    for( unsigned int i = 0; i < this->GetNumberOfFixedImagePyramids(); ++i )
+    {
+      switched |= SetComputeOnlyForCurrentLevel< FixedImageType >(
+        this->GetElxFixedImagePyramidBase( i )->GetAsITKBaseType() );
+    }
+    for( unsigned int i = 0; i < this->GetNumberOfMovingImagePyramids(); ++i )
+    {
+      switched |= SetComputeOnlyForCurrentLevel< MovingImageType >(
+        this->GetElxMovingImagePyramidBase( i )->GetAsITKBaseType() );
+    }
+
+    if( switched )
+    {
+      estimate = 0;
+      for( unsigned int level = 0; level < numberOfLevels; ++level )
+      {
+        estimate = std::max( estimate, this->EstimateImageMemory()
+          + this->EstimatePyramidMemory( level ) + this->EstimateCoefficientMemory( level ) );
+      }
+      elxout << "Memory budget: computing the pyramid images per resolution, "
+             << "which reduces the estimate to " << itk::MemoryUsage::FormatSize( estimate ) << ".\n";
+    }
+  }
+
+} // end InitializeMemoryBudget()
+
+
+/**
+ * ****************** ApplyMemoryBudget ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::ApplyMemoryBudget( const unsigned int level )
+{
+  if( this->m_MaximumMemoryUsage == 0 )
+  {
+    return;
+  }
+
+  typedef typename MetricBaseType::AdvancedMetricType AdvancedMetricType;
+  typedef itk::ParzenWindowHistogramImageToImageMetric<
+    FixedImageType, MovingImageType >                 ParzenWindowMetricType;
+
+  const std::uint64_t budget = this->m_MaximumMemoryUsage;
+  const std::uint64_t imageMemory = this->EstimateImageMemory()
+    + this->EstimatePyramidMemory( level );
+  const std::uint64_t coefficientMemory = this->EstimateCoefficientMemory( level );
+
+  /** The multi-threaded advanced metrics, which have a derivative per thread. */
+  std::vector< AdvancedMetricType * > metrics;
+  for( unsigned int i = 0; i < this->GetNumberOfMetrics(); ++i )
+  {
+    AdvancedMetricType * metric = dynamic_cast< AdvancedMetricType * >(
+      this->GetElxMetricBase( i )->GetAsITKBaseType() );
+    if( metric && metric->GetUseMultiThread() )
+    {
+      metrics.push_back( metric );
+    }
+  }
+
+  /** The memory of the metrics, for a maximum number of threads. */
+  const auto estimateMetricMemory = [ &metrics ]( const unsigned int maximumNumberOfThreads,
+    std::uint64_t & derivativeMemory, std::uint64_t & histogramMemory )
+  {
+    derivativeMemory = 0;
+    histogramMemory  = 0;
+    for( AdvancedMetricType * metric : metrics )
+    {
+      const std::uint64_t threads = std::min< std::uint64_t >(
+        metric->GetNumberOfWorkUnits(), maximumNumberOfThreads );
+      derivativeMemory += threads * metric->GetNumberOfParameters() * sizeof( double );
+
+      const ParzenWindowMetricType * parzen = dynamic_cast< const ParzenWindowMetricType * >( metric );
+      if( parzen )
+      {
+        const std::uint64_t histogram = static_cast< std::uint64_t >( parzen->GetNumberOfFixedHistogramBins() )
+          * parzen->GetNumberOfMovingHistogramBins() * sizeof( double );
+        histogramMemory += parzen->GetUseShardedPDFAccumulation() ? histogram : ( threads + 1 ) * histogram;
+      }
+    }
+  };
+
+  unsigned int maximumNumberOfThreads = 0;
+  for( AdvancedMetricType * metric : metrics )
+  {
+    maximumNumberOfThreads = std::max< unsigned int >( maximumNumberOfThreads, metric->GetNumberOfWorkUnits() );
+  }
+
+  std::uint64_t derivativeMemory = 0;
+  std::uint64_t histogramMemory  = 0;
+  estimateMetricMemory( maximumNumberOfThreads, derivativeMemory, histogramMemory );
+  const auto estimate = [ & ]()
+  {
+    return imageMemory + coefficientMemory + derivativeMemory + histogramMemory;
+  };
+
+  elxout << "Estimated memory usage of resolution " << level << ": "
+         << itk::MemoryUsage::FormatSize( estimate() )
+         << " (images and pyramids " << itk::MemoryUsage::FormatSize( imageMemory )
+         << ", B-spline coefficients " << itk::MemoryUsage::FormatSize( coefficientMemory )
+         << ", per-thread derivatives " << itk::MemoryUsage::FormatSize( derivativeMemory )
+         << ", histograms " << itk::MemoryUsage::FormatSize( histogramMemory )
+         << "), budget " << itk::MemoryUsage::FormatSize( budget ) << ".\n";
+
+  /** Accumulate the histograms in shared shards, instead of per thread. */
+  if( estimate() > budget && histogramMemory > 0
+    && this->GetConfiguration()->CountNumberOfParameterEntries( "PDFAccumulationMode" ) == 0 )
+  {
+    for( AdvancedMetricType * metric : metrics )
+    {
+      ParzenWindowMetricType * parzen = dynamic_cast< ParzenWindowMetricType * >( metric );
+      if( parzen )
+      {
+        parzen->SetUseShardedPDFAccumulation( true );
+      }
+    }
+    estimateMetricMemory( maximumNumberOfThreads, derivativeMemory, histogramMemory );
+    elxout << "Memory budget: accumulating the histograms in shared shards, "
+           << "which reduces the estimate to " << itk::MemoryUsage::FormatSize( estimate() ) << ".\n";
+  }
+
+  /** Use fewer threads in the metrics. */
+  if( estimate() > budget && maximumNumberOfThreads > 1 )
+  {
+    unsigned int numberOfThreads = maximumNumberOfThreads;
+    while( estimate() > budget && numberOfThreads > 1 )
+    {
+      --numberOfThreads;
+      estimateMetricMemory( numberOfThreads, derivativeMemory, histogramMemory );
+    }
+    for( AdvancedMetricType * metric : metrics )
+    {
+      if( metric->GetNumberOfWorkUnits() > numberOfThreads )
+      {
+        metric->SetNumberOfWorkUnits( numberOfThreads );
+      }
+    }
+    elxout << "Memory budget: using " << numberOfThreads << " instead of "
+           << maximumNumberOfThreads << " threads in the metrics, "
+           << "which reduces the estimate to " << itk::MemoryUsage::FormatSize( estimate() ) << ".\n";
+  }
+
+  if( estimate() > budget )
+  {
+    xl::xout[ "warning" ] << "WARNING: the estimated memory usage of resolution " << level
+                          << ", " << itk::MemoryUsage::FormatSize( estimate() )
+                          << ", exceeds the MaximumMemoryUsage of "
+                          << itk::MemoryUsage::FormatSize( budget ) << "." << std::endl;
+  }
+
+} // end ApplyMemoryBudget()
+
+
+/**
+ * ****************** EstimateImageMemory ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+std::uint64_t
+ElastixTemplate< TFixedImage, TMovingImage >
+::EstimateImageMemory( void ) const
+{
+  std::uint64_t memory = 0;
+  for( unsigned int i = 0; i < this->GetNumberOfFixedImages(); ++i )
+  {
+    memory += this->GetFixedImage( i )->GetBufferedRegion().GetNumberOfPixels()
+      * sizeof( typename FixedImageType::PixelType );
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfMovingImages(); ++i )
+  {
+    memory += this->GetMovingImage( i )->GetBufferedRegion().GetNumberOfPixels()
+      * sizeof( typename MovingImageType::PixelType );
+  }
+  return memory;
+
+} // end EstimateImageMemory()
+
+
+/**
+ * ****************** EstimatePyramidMemory ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+std::uint64_t
+ElastixTemplate< TFixedImage, TMovingImage >
+::EstimatePyramidMemory( const unsigned int level ) const
+{
+  /** Pyramid i smooths image i, or the first image if there are fewer images. */
+  std::uint64_t memory = 0;
+  for( unsigned int i = 0; i < this->GetNumberOfFixedImagePyramids(); ++i )
+  {
+    memory += GetPyramidMemory< FixedImageType >(
+      this->GetElxFixedImagePyramidBase( i )->GetAsITKBaseType(),
+      this->GetFixedImage( i < this->GetNumberOfFixedImages() ? i : 0 ), level );
+  }
+  for( unsigned int i = 0; i < this->GetNumberOfMovingImagePyramids(); ++i )
+  {
+    memory += GetPyramidMemory< MovingImageType >(
+      this->GetElxMovingImagePyramidBase( i )->GetAsITKBaseType(),
+      this->GetMovingImage( i < this->GetNumberOfMovingImages() ? i : 0 ), level );
+  }
+  return memory;
+
+} // end EstimatePyramidMemory()
+
+
+/**
+ * ****************** EstimateCoefficientMemory ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+std::uint64_t
+ElastixTemplate< TFixedImage, TMovingImage >
+::EstimateCoefficientMemory( const unsigned int level ) const
+{
+  /** A B-spline interpolator of metric i holds the coefficients of the
+   * moving pyramid image i in this resolution.
+   */
+  std::uint64_t memory = 0;
+  for( unsigned int i = 0; i < this->GetNumberOfInterpolators(); ++i )
+  {
+    std::string interpolator = "";
+    this->GetConfiguration()->ReadParameter( interpolator, "Interpolator", i, false );
+    std::uint64_t bytesPerCoefficient = 0;
+    if( interpolator == "BSplineInterpolator" )
+    {
+      bytesPerCoefficient = sizeof( double );
+    }
+    else if( interpolator == "BSplineInterpolatorFloat" )
+    {
+      bytesPerCoefficient = sizeof( float );
+    }
+
+    if( bytesPerCoefficient == 0 || this->GetNumberOfMovingImagePyramids() == 0 )
+    {
+      continue;
+    }
+
+    const unsigned int pyramidIndex
+      = i < this->GetNumberOfMovingImagePyramids() ? i : 0;
+    memory += bytesPerCoefficient * GetPyramidNumberOfPixels< MovingImageType >(
+      this->GetElxMovingImagePyramidBase( pyramidIndex )->GetAsITKBaseType(),
+      this->GetMovingImage( pyramidIndex < this->GetNumberOfMovingImages() ? pyramidIndex : 0 ),
+      level );
+  }
+  return memory;
+
+} // end EstimateCoefficientMemory()
+
+
+/**
+ * ****************** GetPyramidMemory ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TImage >
+std::uint64_t
+ElastixTemplate< TFixedImage, TMovingImage >
+::GetPyramidMemory(
+  const itk::MultiResolutionPyramidImageFilter< TImage, TImage > * pyramid,
+  const TImage * image, const unsigned int level )
+{
+  const bool perLevel = GetComputeOnlyForCurrentLevel< TImage >( pyramid );
+
+  std::uint64_t numberOfPixels = 0;
+  for( unsigned int l = 0; l < pyramid->GetNumberOfLevels(); ++l )
+  {
+    if( !perLevel || l == level )
+    {
+      numberOfPixels += GetPyramidNumberOfPixels< TImage >( pyramid, image, l );
+    }
+  }
+  return numberOfPixels * sizeof( typename TImage::PixelType );
+
+} // end GetPyramidMemory()
+
+
+/**
+ * ****************** GetPyramidNumberOfPixels ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TImage >
+std::uint64_t
+ElastixTemplate< TFixedImage, TMovingImage >
+::GetPyramidNumberOfPixels(
+  const itk::MultiResolutionPyramidImageFilter< TImage, TImage > * pyramid,
+  const TImage * image, const unsigned int level )
+{
+  typedef itk::MultiResolutionGaussianSmoothingPyramidImageFilter< TImage, TImage > SmoothingPyramidType;
+
+  /** The smoothing pyramid does not shrink its images. */
+  const bool shrinks = dynamic_cast< const SmoothingPyramidType * >( pyramid ) == nullptr;
+  const typename itk::MultiResolutionPyramidImageFilter< TImage, TImage >::ScheduleType & schedule
+    = pyramid->GetSchedule();
+
+  std::uint64_t numberOfPixels = 1;
+  for( unsigned int d = 0; d < TImage::ImageDimension; ++d )
+  {
+    const std::uint64_t factor = shrinks && level < schedule.rows()
+      ? std::max( 1u, schedule[ level ][ d ] ) : 1;
+    numberOfPixels *= std::max< std::uint64_t >( 1,
+      image->GetLargestPossibleRegion().GetSize( d ) / factor );
+  }
+  return numberOfPixels;
+
+} // end GetPyramidNumberOfPixels()
+
+
+/**
+ * ****************** GetComputeOnlyForCurrentLevel ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TImage >
+bool
+ElastixTemplate< TFixedImage, TMovingImage >
+::GetComputeOnlyForCurrentLevel(
+  const itk::MultiResolutionPyramidImageFilter< TImage, TImage > * pyramid )
+{
+  typedef itk::GenericMultiResolutionPyramidImageFilter< TImage, TImage >           GenericPyramidType;
+  typedef itk::MultiResolutionGaussianSmoothingPyramidImageFilter< TImage, TImage > SmoothingPyramidType;
+
+  if( const auto * generic = dynamic_cast< const GenericPyramidType * >( pyramid ) )
+  {
+    return generic->GetComputeOnlyForCurrentLevel();
+  }
+  if( const auto * smoothing = dynamic_cast< const SmoothingPyramidType * >( pyramid ) )
+  {
+    return smoothing->GetComputeOnlyForCurrentLevel();
+  }
+  return false;
+
+} // end GetComputeOnlyForCurrentLevel()
+
+
+/**
+ * ****************** SetComputeOnlyForCurrentLevel ***********************
+ */
+
+template< class TFixedImage, class TMovingImage >
+template< class TImage >
+bool
+ElastixTemplate< TFixedImage, TMovingImage >
+::SetComputeOnlyForCurrentLevel(
+  itk::MultiResolutionPyramidImageFilter< TImage, TImage > * pyramid )
+{
+  typedef itk::GenericMultiResolutionPyramidImageFilter< TImage, TImage >           GenericPyramidType;
+  typedef itk::MultiResolutionGaussianSmoothingPyramidImageFilter< TImage, TImage > SmoothingPyramidType;
+
+  if( auto * generic = dynamic_cast< GenericPyramidType * >( pyramid ) )
+  {
+    generic->SetComputeOnlyForCurrentLevel( true );
+    return true;
+  }
+  if( auto * smoothing = dynamic_cast< SmoothingPyramidType * >( pyramid ) )
+  {
+    smoothing->SetComputeOnlyForCurrentLevel( true );
+    return true;
+  }
+  return false;
+
+} // end SetComputeOnlyForCurrentLevel()
+
+
 /**
  * ****************** CallInEachComponent ***********************
  */
@@ -1222,9 +2003,109 @@ ElastixTemplate< TFixedImage, TMovingImage >
     xout[ "iteration" ].AddOutput( "IterationInfoFile", &( this->m_IterationInfoFile ) );
   }
 
+  /** Open the binary IterationInfo file, if the user wanted it. */
+  if( this->m_IterationInfoBinaryFile.is_open() )
+  {
+    this->m_IterationInfoBinaryFile.close();
+  }
+  bool writeIterationInfoBinary = false;
+  this->GetConfiguration()->ReadParameter( writeIterationInfoBinary,
+    "WriteIterationInfoBinary", 0, false );
+  if( writeIterationInfoBinary )
+  {
+    std::string binaryFileName = fileName;
+    binaryFileName.replace( binaryFileName.size() - 4, 4, ".bin" );
+    this->m_IterationInfoBinaryFile.open( binaryFileName.c_str(),
+      std::ios::out | std::ios::binary | std::ios::trunc );
+    if( !( this->m_IterationInfoBinaryFile.is_open() ) )
+    {
+      xout[ "error" ] << "ERROR: File \"" << binaryFileName << "\" could not be opened!" << std::endl;
+    }
+    this->m_IterationInfoBinaryNames.clear();
+  }
+
 } // end OpenIterationInfoFile()
 
 
+/**
+ * ************** WriteIterationInfoBinaryRecord ****************
+ *
+ * Write the buffered cells of xout["iteration"] as one record of
+ * little endian doubles, preceded by the header in the first call
+ * for this file.
+ */
+
+template< class TFixedImage, class TMovingImage >
+void
+ElastixTemplate< TFixedImage, TMovingImage >
+::WriteIterationInfoBinaryRecord( void )
+{
+  xl::xoutrow_type * iterationInfo
+    = dynamic_cast< xl::xoutrow_type * >( &xl::xout[ "iteration" ] );
+  if( iterationInfo == 0 )
+  {
+    return;
+  }
+
+  std::vector< std::string > names;
+  std::vector< std::string > data;
+  iterationInfo->GetBufferedData( names, data );
+
+  std::ofstream & file = this->m_IterationInfoBinaryFile;
+
+  /** Write the header. The columns are fixed once it is written. */
+  if( this->m_IterationInfoBinaryNames.empty() )
+  {
+    this->m_IterationInfoBinaryNames = names;
+
+    file.write( "ELXITER1", 8 );
+    std::uint32_t numberOfColumns = static_cast< std::uint32_t >( names.size() );
+    itk::ByteSwapper< std::uint32_t >::SwapFromSystemToLittleEndian( &numberOfColumns );
+    file.write( reinterpret_cast< const char * >( &numberOfColumns ), sizeof( numberOfColumns ) );
+    for( std::size_t i = 0; i < names.size(); ++i )
+    {
+      std::uint32_t length = static_cast< std::uint32_t >( names[ i ].size() );
+      itk::ByteSwapper< std::uint32_t >::SwapFromSystemToLittleEndian( &length );
+      file.write( reinterpret_cast< const char * >( &length ), sizeof( length ) );
+      file.write( names[ i ].data(), names[ i ].size() );
+    }
+  }
+
+  /** Convert the cells to doubles, in the order of the header. Cells that
+   * were added after the header was written are not stored.
+   */
+  const std::vector< std::string > & columns = this->m_IterationInfoBinaryNames;
+  std::vector< double >              record( columns.size(),
+    std::numeric_limits< double >::quiet_NaN() );
+  for( std::size_t i = 0, j = 0; i < columns.size() && j < names.size(); ++i )
+  {
+    while( j < names.size() && names[ j ] < columns[ i ] )
+    {
+      ++j;
+    }
+    if( j < names.size() && names[ j ] == columns[ i ] )
+    {
+      const char * begin = data[ j ].c_str();
+      char *       end   = 0;
+      const double value = std::strtod( begin, &end );
+      if( end != begin )
+      {
+        record[ i ] = value;
+      }
+    }
+  }
+
+  if( !record.empty() )
+  {
+    itk::ByteSwapper< double >::SwapRangeFromSystemToLittleEndian(
+      &record[ 0 ], record.size() );
+    file.write( reinterpret_cast< const char * >( &record[ 0 ] ),
+      record.size() * sizeof( double ) );
+  }
+
+} // end WriteIterationInfoBinaryRecord()
+
+
 /**
  * ************** GetOriginalFixedImageDirection *********************
  * Determine the original fixed image direction (it might have been
@@ -45,6 +45,9 @@ namespace elastix
 int
 TransformixMain::Run( void )
 {
+  /** Count this run during its lifetime. */
+  const RunCounter runCounter;
+
   /** Set process properties. */
   this->SetProcessPriority();
   this->SetMaximumNumberOfThreads();
@@ -81,9 +84,21 @@ TransformixMain::Run( void )
   this->m_Configuration->ReadParameter( userSuppliedOpenCLDeviceID,
     "OpenCLDeviceID", 0, false );
 
+  /** The command line option "-gpu 0,1,2,3" selects several devices, on
+   * which the jobs are placed round-robin. It overrides OpenCLDeviceID. */
+  std::vector< int > userSuppliedOpenCLDeviceIDs( 1, userSuppliedOpenCLDeviceID );
+  const std::string  gpuArgument = this->m_Configuration->GetCommandLineArgument( "-gpu" );
+  if( !gpuArgument.empty()
+    && !itk::GetOpenCLDeviceIDs( gpuArgument, userSuppliedOpenCLDeviceIDs ) )
+  {
+    xl::xout[ "warning" ] << "WARNING: The command line option \"-gpu " << gpuArgument
+                          << "\" is not a comma separated list of device IDs, and is ignored." << std::endl;
+    userSuppliedOpenCLDeviceIDs.assign( 1, userSuppliedOpenCLDeviceID );
+  }
+
   std::string errorMessage              = "";
   const bool  creatingContextSuccessful = itk::CreateOpenCLContext(
-    errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceID );
+    errorMessage, userSuppliedOpenCLDeviceType, userSuppliedOpenCLDeviceIDs );
   if( !creatingContextSuccessful )
   {
     /** Report and disable the GPU by releasing the context. */
@@ -202,6 +217,13 @@ TransformixMain::Run(
   const std::vector< ParameterMapType > & inputMaps )
 {
   this->EnterCommandLineArguments( argmap, inputMaps );
+
+  /** Pass the transform parameters that are given in binary form. */
+  for( std::size_t i = 0; i < this->m_TransformParameters.size() && i < this->m_Configurations.size(); ++i )
+  {
+    this->m_Configurations[ i ]->SetTransformParameters( this->m_TransformParameters[ i ] );
+  }
+
   return this->Run();
 } // end Run()
 
@@ -250,11 +272,15 @@ TransformixMain::InitDBIndex( void )
     this->m_MovingImagePixelType = "float"; // \note: this assumes elastix was compiled for float
     this->m_Configuration->ReadParameter( this->m_MovingImagePixelType,
       "MovingInternalImagePixelType", 0 );
+    AdaptInternalImagePixelType( this->m_MovingImagePixelType,
+      "MovingInternalImagePixelType" );
 
     /** Try to read FixedImagePixelType from the parameter file. */
     this->m_FixedImagePixelType = "float"; // \note: this assumes elastix was compiled for float
     this->m_Configuration->ReadParameter( this->m_FixedImagePixelType,
       "FixedInternalImagePixelType", 0 );
+    AdaptInternalImagePixelType( this->m_FixedImagePixelType,
+      "FixedInternalImagePixelType" );
 
     /** MovingImageDimension. */
     if( this->m_MovingImageDimension == 0 )
@@ -286,7 +312,8 @@ TransformixMain::InitDBIndex( void )
       }
     }
 
-    /** Load the components. */
+    /** Load the components, once for the runs of all threads. */
+    std::unique_lock< std::mutex > loadLock( GetComponentsMutex() );
     if( this->s_CDB.IsNull() )
     {
       int loadReturnCode = this->LoadComponents();
@@ -296,6 +323,7 @@ TransformixMain::InitDBIndex( void )
         return loadReturnCode;
       }
     }
+    loadLock.unlock();
 
     if( this->s_CDB.IsNotNull() )
     {
@@ -87,6 +87,9 @@ public:
   /** Typedef that is used in the elastix dll version. */
   typedef Superclass::ParameterMapType ParameterMapType;
 
+  /** Typedef for transform parameters in binary form. */
+  typedef ConfigurationType::TransformParametersType TransformParametersType;
+
   /** Overwrite Run() from base-class. */
   int Run( void ) override;
 
@@ -102,6 +105,15 @@ public:
   virtual void SetInputImageContainer(
     DataObjectContainerType * inputImageContainer );
 
+  /** Set the transform parameters of the input maps of
+   * Run( argmap, inputMaps ) in binary form, one array per map, which may be
+   * empty. See Configuration::SetTransformParameters().
+   */
+  void SetTransformParameters( const std::vector< TransformParametersType > & transformParameters )
+  {
+    this->m_TransformParameters = transformParameters;
+  }
+
 protected:
 
   TransformixMain(){}
@@ -117,6 +129,8 @@ private:
   TransformixMain( const Self & ); // purposely not implemented
   void operator=( const Self & );  // purposely not implemented
 
+  std::vector< TransformParametersType > m_TransformParameters;
+
 };
 
 } // end namespace elastix
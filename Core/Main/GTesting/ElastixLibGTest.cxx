@@ -200,3 +200,83 @@ GTEST_TEST(ElastixLib, ExampleFromManualRunningElastix)
 
   EXPECT_EQ(roundedTranslationOffset, translationOffset);
 }
+
+
+// Tests registering three translated moving images to one fixed image, at
+// the same time.
+GTEST_TEST(ElastixLib, RegisterImageBatchOfMovingImages)
+{
+  using elastix::ELASTIX;
+  using ITKImageType = itk::Image<float>;
+  constexpr auto ImageDimension = ITKImageType::ImageDimension;
+  using RegionType = itk::ImageRegion<ImageDimension>;
+  using SizeType = itk::Size<ImageDimension>;
+  using IndexType = itk::Index<ImageDimension>;
+  using OffsetType = itk::Offset<ImageDimension>;
+  using RegionIteratorType = itk::ImageRegionIterator<ITKImageType>;
+
+  const ELASTIX::ParameterMapType parameters =
+  {
+    { "FixedImageDimension", { std::to_string(ImageDimension) } },
+    { "ImageSampler", { "Full" } },
+    { "MaximumNumberOfIterations", { "2" } },
+    { "Metric", { "AdvancedNormalizedCorrelation" } },
+    { "MovingImageDimension", { std::to_string(ImageDimension) } },
+    { "NumberOfResolutions", { "2" } },
+    { "Optimizer", { "AdaptiveStochasticGradientDescent" } },
+    { "Transform", { "TranslationTransform" } },
+    { "AutomaticTransformInitialization", { "false" } },
+    { "FixedInternalImagePixelType", { "float" } },
+    { "MovingInternalImagePixelType", { "float" } },
+    { "WriteResultImage", { "false" } },
+  };
+
+  const auto regionSize = SizeType::Filled(2);
+  const SizeType imageSize{ { 5, 6 } };
+  const IndexType fixedImageRegionIndex{ { 1, 3 } };
+
+  const auto createImage = [&](const OffsetType& offset)
+  {
+    const auto image = ITKImageType::New();
+    image->SetRegions(imageSize);
+    image->Allocate(true);
+
+    for (RegionIteratorType it(image, RegionType{ fixedImageRegionIndex + offset, regionSize }); !it.IsAtEnd(); ++it)
+    {
+      it.Set(1);
+    }
+    return image;
+  };
+
+  const OffsetType translationOffsets[] = { { { 1, -2 } }, { { 0, -1 } }, { { 1, 0 } } };
+
+  ELASTIX::ImageListType fixedImages{ createImage(OffsetType()).GetPointer() };
+  ELASTIX::ImageListType movingImages;
+
+  for (const auto& translationOffset : translationOffsets)
+  {
+    movingImages.push_back(createImage(translationOffset).GetPointer());
+  }
+
+  ELASTIX elastix;
+  const int error = elastix.RegisterImageBatch(fixedImages, movingImages, { parameters }, {}, false, false, 2);
+  ASSERT_EQ(error, 0);
+
+  const auto transformParameterMapLists = elastix.GetTransformParameterMapLists();
+  ASSERT_EQ(transformParameterMapLists.size(), movingImages.size());
+
+  for (std::size_t i = 0; i < movingImages.size(); ++i)
+  {
+    ASSERT_EQ(transformParameterMapLists[i].size(), 1);
+
+    const auto& first = transformParameterMapLists[i].front();
+    const auto found = first.find("TransformParameters");
+    ASSERT_NE(found, first.cend());
+    ASSERT_EQ(found->second.size(), ImageDimension);
+
+    for (unsigned int d = 0; d < ImageDimension; ++d)
+    {
+      EXPECT_EQ(std::round(std::stod(found->second[d])), translationOffsets[i][d]);
+    }
+  }
+}
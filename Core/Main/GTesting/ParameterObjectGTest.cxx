@@ -0,0 +1,109 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+ // First include the header file to be tested:
+#include "elxParameterObject.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <string>
+
+
+// Tests that the transform parameters in binary form are written to a file
+// next to the parameter file, in the format that transformix reads.
+GTEST_TEST(ParameterObject, WritesTransformParametersInBinaryForm)
+{
+  using elastix::ParameterObject;
+
+  ParameterObject::ParameterMapType parameterMap;
+  parameterMap["Transform"] = { "TranslationTransform" };
+  parameterMap["NumberOfParameters"] = { "2" };
+  parameterMap["UseBinaryFormatForTransformationParameters"] = { "true" };
+
+  ParameterObject::TransformParametersType transformParameters(2);
+  transformParameters[0] = 1.5;
+  transformParameters[1] = -2.25;
+
+  const auto parameterObject = ParameterObject::New();
+  parameterObject->SetParameterMap(parameterMap);
+  parameterObject->SetTransformParameters({ transformParameters });
+
+  const std::string parameterFileName = "ParameterObjectGTest.txt";
+  parameterObject->WriteParameterFile(parameterFileName);
+
+  // The parameter map of the object itself is not changed.
+  EXPECT_EQ(parameterObject->GetParameterMap(0).count("TransformParameters"), 0);
+
+  double values[2] = {};
+  std::ifstream dataFile(parameterFileName + ".dat", std::ios::in | std::ios::binary);
+  dataFile.read(reinterpret_cast<char *>(values), sizeof(values));
+  ASSERT_EQ(dataFile.gcount(), static_cast<std::streamsize>(sizeof(values)));
+  EXPECT_EQ(values[0], 1.5);
+  EXPECT_EQ(values[1], -2.25);
+
+  const auto readParameterObject = ParameterObject::New();
+  readParameterObject->ReadParameterFile(parameterFileName);
+  const auto & transformParametersEntry = readParameterObject->GetParameterMap(0).at("TransformParameters");
+  ASSERT_EQ(transformParametersEntry.size(), 1);
+  EXPECT_EQ(transformParametersEntry[0], parameterFileName + ".dat");
+}
+
+
+// Tests that shared parameter maps are copied when one of their owners
+// modifies them, and that the other owner does not see the modification.
+GTEST_TEST(ParameterObject, SharedParameterMapIsCopiedOnWrite)
+{
+  using elastix::ParameterObject;
+
+  ParameterObject::ParameterMapType parameterMap;
+  parameterMap["Transform"] = { "TranslationTransform" };
+
+  const auto parameterObject = ParameterObject::New();
+  parameterObject->SetParameterMap(parameterMap);
+
+  const auto sharingParameterObject = ParameterObject::New();
+  sharingParameterObject->SetSharedParameterMap(parameterObject->GetSharedParameterMap());
+  EXPECT_EQ(sharingParameterObject->GetSharedParameterMap(), parameterObject->GetSharedParameterMap());
+  EXPECT_EQ(&sharingParameterObject->GetParameterMap(), &parameterObject->GetParameterMap());
+
+  // Reading an existing parameter does not copy the maps.
+  EXPECT_EQ(sharingParameterObject->GetParameter(0, "Transform"), parameterMap["Transform"]);
+  EXPECT_EQ(sharingParameterObject->GetSharedParameterMap(), parameterObject->GetSharedParameterMap());
+
+  sharingParameterObject->SetParameter(0, "Transform", "AffineTransform");
+  EXPECT_NE(sharingParameterObject->GetSharedParameterMap(), parameterObject->GetSharedParameterMap());
+  EXPECT_EQ(sharingParameterObject->GetParameterMap(0).at("Transform").front(), "AffineTransform");
+  EXPECT_EQ(parameterObject->GetParameterMap(0).at("Transform").front(), "TranslationTransform");
+
+  // A parameter object that owns its maps alone modifies them in place.
+  const auto * const parameterMapVector = &parameterObject->GetParameterMap();
+  parameterObject->AddParameterMap(parameterMap);
+  EXPECT_EQ(&parameterObject->GetParameterMap(), parameterMapVector);
+  EXPECT_EQ(parameterObject->GetNumberOfParameterMaps(), 2);
+  EXPECT_EQ(sharingParameterObject->GetNumberOfParameterMaps(), 1);
+
+  // The owner copies its maps as well, when it has handed them out.
+  sharingParameterObject->SetSharedParameterMap(parameterObject->GetSharedParameterMap());
+  parameterObject->SetParameter(0, "Transform", "BSplineTransform");
+  EXPECT_NE(&parameterObject->GetParameterMap(), parameterMapVector);
+  EXPECT_EQ(parameterObject->GetParameterMap(0).at("Transform").front(), "BSplineTransform");
+  EXPECT_EQ(sharingParameterObject->GetParameterMap(0).at("Transform").front(), "TranslationTransform");
+}
@@ -19,6 +19,9 @@
 // Elastix header files:
 #include "elastix.h"
 #include "elxElastixMain.h"
+#include "elxElastixServer.h"
+#include "itkParameterFileParser.h"
+#include "itkParameterMapInterface.h"
 #include "itkUseMevisDicomTiff.h"
 
 // ITK header files:
@@ -27,18 +30,37 @@
 #include <itksys/SystemTools.hxx>
 
 // Standard C++ header files:
+#include <algorithm> // For max.
 #include <cassert>
 #include <climits> // For UINT_MAX.
 #include <cstddef> // For size_t.
+#include <cstdlib> // For atoi.
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <queue>
 #include <vector>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 int
 main( int argc, char ** argv )
 {
 
+  /** Check if the server mode was asked for. */
+  if( argc >= 2 && std::string( argv[ 1 ] ) == "--serve" )
+  {
+    return Serve( argc, argv );
+  }
+
+  /** Check if the sequence mode was asked for. */
+  if( argc >= 2 && std::string( argv[ 1 ] ) == "--sequence" )
+  {
+    return RegisterSequence( argc, argv );
+  }
+
   /** Check if "--help" or "--version" was asked for. */
   if( argc == 1 )
   {
@@ -261,6 +283,37 @@ main( int argc, char ** argv )
   DataObjectContainerPointer movingMaskContainer  = nullptr;
   FlatDirectionCosinesType   fixedImageOriginalDirection;
 
+  /** Resume from a checkpoint. The parameter files before the one of the
+   * checkpoint are not run again: their results are read from the transform
+   * parameter files in the output directory.
+   */
+  unsigned int resumeElastixLevel = 0;
+  if( argMap.count( "-resume" ) > 0 )
+  {
+    const auto parser = itk::ParameterFileParser::New();
+    parser->SetParameterFileName( argMap[ "-resume" ] );
+    const auto checkpoint = itk::ParameterMapInterface::New();
+    std::string errorMessage;
+    try
+    {
+      parser->ReadParameterFile();
+      checkpoint->SetParameterMap( parser->GetParameterMap() );
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      xl::xout[ "error" ] << "ERROR: the checkpoint \"" << argMap[ "-resume" ]
+                          << "\" cannot be read.\n" << excp << std::endl;
+      return 1;
+    }
+    if( !checkpoint->ReadParameter( resumeElastixLevel, "CheckpointElastixLevel", 0, errorMessage )
+      || resumeElastixLevel >= parameterFileList.size() )
+    {
+      xl::xout[ "error" ] << "ERROR: the checkpoint \"" << argMap[ "-resume" ]
+                          << "\" does not belong to these parameter files." << std::endl;
+      return 1;
+    }
+  }
+
   /**
    * ********************* START REGISTRATION *********************
    *
@@ -272,6 +325,23 @@ main( int argc, char ** argv )
 
   for( unsigned i{}; i < static_cast<unsigned>(nrOfParameterFiles); ++i )
   {
+    /** Skip the parameter files that were finished before the checkpoint,
+     * and start the next one from the transform of the last of them.
+     */
+    if( i < resumeElastixLevel )
+    {
+      elxout << "Skipping parameter file " << i << ": \"" << parameterFileList.front()
+             << "\", which was finished before the checkpoint.\n" << std::endl;
+      parameterFileList.pop();
+      continue;
+    }
+    if( i == resumeElastixLevel && i > 0 )
+    {
+      std::ostringstream initialTransformFileName( "" );
+      initialTransformFileName << outFolder << "TransformParameters." << ( i - 1 ) << ".txt";
+      argMap[ "-t0" ] = initialTransformFileName.str();
+    }
+
     /** Create another instance of ElastixMain. */
     const auto elastixMain = ElastixMainType::New();
 
@@ -311,6 +381,7 @@ main( int argc, char ** argv )
     if( returndummy != 0 )
     {
       xl::xout[ "error" ] << "Errors occurred!" << std::endl;
+      elx::ElastixBase::WaitForBackgroundTasks();
       return returndummy;
     }
 
@@ -335,6 +406,11 @@ main( int argc, char ** argv )
            << ConvertSecondsToDHMS( timer.GetMean(), 1 ) << ".\n" << std::endl;
   } // end loop over registrations
 
+  /** Wait for the result images that are still being written, if the last
+   * registration has not done so.
+   */
+  elx::ElastixBase::WaitForBackgroundTasks();
+
   elxout << "-------------------------------------------------------------------------" << "\n" << std::endl;
 
   /** Stop totaltimer and print it. */
@@ -362,6 +438,327 @@ main( int argc, char ** argv )
 } // end main
 
 
+/**
+ * *********************** Serve ****************************
+ */
+
+int
+Serve( int argc, char ** argv )
+{
+  typedef elx::ElastixServer::ArgumentMapType ArgumentMapType;
+
+  /** Read the options of the server, the others are added to every job. */
+  if( ( argc - 2 ) % 2 != 0 )
+  {
+    std::cerr << "ERROR: the options of \"elastix --serve\" are not pairs of an option and a value." << std::endl;
+    return 1;
+  }
+
+  ArgumentMapType serverArguments;
+  std::string     pipeName;
+  unsigned int    numberOfJobs         = 1;
+  unsigned int    numberOfCachedImages = 4;
+  for( int i = 2; i + 1 < argc; i += 2 )
+  {
+    const std::string key( argv[ i ] );
+    const std::string value( argv[ i + 1 ] );
+    if( key == "-jobs" )
+    {
+      numberOfJobs = static_cast< unsigned int >( std::max( 1, atoi( value.c_str() ) ) );
+    }
+    else if( key == "-cache" )
+    {
+      numberOfCachedImages = static_cast< unsigned int >( std::max( 0, atoi( value.c_str() ) ) );
+    }
+    else if( key == "-pipe" )
+    {
+      pipeName = value;
+    }
+    else
+    {
+      serverArguments[ key ] = value;
+    }
+  }
+
+  /** The argv0 argument, required for finding the component.dll/so's. */
+  serverArguments[ "-argv0" ] = argv[ 0 ];
+
+  /** Support Mevis Dicom Tiff (if selected in cmake) */
+  RegisterMevisDicomTiff();
+
+  /** Set up xout for the messages that are not part of a job, which are not
+   * shown, since the standard output reports the status of the jobs.
+   */
+  elx::xoutSetup( "", false, false );
+
+  elx::ElastixServer server;
+  server.SetServerArguments( serverArguments );
+  server.SetNumberOfConcurrentJobs( numberOfJobs );
+  server.SetMaximumNumberOfCachedImages( numberOfCachedImages );
+
+  int returndummy = 0;
+  if( pipeName.empty() )
+  {
+    server.Serve( std::cin, std::cout );
+  }
+  else
+  {
+    /** A named pipe reaches its end when a client closes it, and is opened
+     * again for the next client.
+     */
+    bool isNamedPipe = false;
+#ifndef _WIN32
+    struct stat pipeStatus;
+    isNamedPipe = stat( pipeName.c_str(), &pipeStatus ) == 0 && S_ISFIFO( pipeStatus.st_mode );
+#endif
+    bool quit = false;
+    while( !quit )
+    {
+      std::ifstream pipe( pipeName.c_str() );
+      if( !pipe.is_open() )
+      {
+        std::cerr << "ERROR: the pipe \"" << pipeName << "\" cannot be opened." << std::endl;
+        returndummy = 1;
+        break;
+      }
+      quit = server.Serve( pipe, std::cout ) || !isNamedPipe;
+    }
+  }
+
+  /** Finish the jobs and close the modules. */
+  server.Stop();
+
+  return returndummy;
+
+} // end Serve()
+
+
+/**
+ * *********************** RegisterSequence ****************************
+ */
+
+int
+RegisterSequence( int argc, char ** argv )
+{
+  typedef elx::ElastixMain                            ElastixMainType;
+  typedef ElastixMainType::ObjectPointer              ObjectPointer;
+  typedef ElastixMainType::DataObjectContainerPointer DataObjectContainerPointer;
+  typedef ElastixMainType::FlatDirectionCosinesType   FlatDirectionCosinesType;
+  typedef ElastixMainType::ArgumentMapType            ArgumentMapType;
+  typedef ElastixMainType::ParameterMapType           ParameterMapType;
+
+  if( ( argc - 2 ) % 2 != 0 )
+  {
+    std::cerr << "ERROR: the options of \"elastix --sequence\" are not pairs of an option and a value." << std::endl;
+    return 1;
+  }
+
+  /** Read the options; the reference image, the frames, the parameter files
+   * and the output folder are handled here, the others are passed to every run.
+   */
+  ArgumentMapType            argMap;
+  std::vector< std::string > parameterFileNames;
+  std::string                framesFileName;
+  std::string                referenceImageFileName;
+  std::string                outFolder;
+  for( int i = 2; i + 1 < argc; i += 2 )
+  {
+    const std::string key( argv[ i ] );
+    std::string       value( argv[ i + 1 ] );
+    if( key == "-p" )
+    {
+      parameterFileNames.push_back( value );
+    }
+    else if( key == "-f" )
+    {
+      referenceImageFileName = value;
+    }
+    else if( key == "-out" )
+    {
+      const char last = value[ value.size() - 1 ];
+      if( last != '/' && last != '\\' ) { value.append( "/" ); }
+      outFolder = value;
+    }
+    else
+    {
+      if( key == "-frames" )
+      {
+        framesFileName = value;
+      }
+      argMap[ key ] = value;
+    }
+  }
+
+  /** The argv0 argument, required for finding the component.dll/so's. */
+  argMap[ "-argv0" ] = argv[ 0 ];
+
+  if( parameterFileNames.empty() || framesFileName.empty() || outFolder.empty() )
+  {
+    std::cerr << "ERROR: \"elastix --sequence\" requires the options \"-frames\", \"-p\" and \"-out\"." << std::endl;
+    return 1;
+  }
+  if( !itksys::SystemTools::FileIsDirectory( outFolder ) )
+  {
+    std::cerr << "ERROR: the output directory \"" << outFolder << "\" does not exist." << std::endl;
+    std::cerr << "You are responsible for creating it." << std::endl;
+    return -2;
+  }
+
+  /** Read the file names of the frames, one per line. */
+  std::vector< std::string > frames;
+  std::ifstream              framesFile( framesFileName.c_str() );
+  if( !framesFile.is_open() )
+  {
+    std::cerr << "ERROR: the file \"" << framesFileName << "\" cannot be opened." << std::endl;
+    return 1;
+  }
+  for( std::string line; std::getline( framesFile, line ); )
+  {
+    line = itksys::SystemTools::TrimWhitespace( line );
+    if( !line.empty() && line[ 0 ] != '#' )
+    {
+      frames.push_back( line );
+    }
+  }
+
+  const bool        toPredecessor = referenceImageFileName.empty();
+  const std::size_t firstFrame    = toPredecessor ? 1 : 0;
+  if( frames.size() <= firstFrame )
+  {
+    std::cerr << "ERROR: the file \"" << framesFileName << "\" lists too few frames." << std::endl;
+    return 1;
+  }
+
+  /** Read the parameter files. The transform parameters are passed to the
+   * next frame as strings, so the binary format is not used.
+   */
+  std::vector< ParameterMapType > parameterMaps;
+  for( const std::string & parameterFileName : parameterFileNames )
+  {
+    const auto parser = itk::ParameterFileParser::New();
+    parser->SetParameterFileName( parameterFileName );
+    try
+    {
+      parser->ReadParameterFile();
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      std::cerr << "ERROR: the parameter file \"" << parameterFileName << "\" cannot be read.\n"
+                << excp << std::endl;
+      return 1;
+    }
+    parameterMaps.push_back( parser->GetParameterMap() );
+    parameterMaps.back().erase( "UseBinaryFormatForTransformationParameters" );
+  }
+
+  /** Support Mevis Dicom Tiff (if selected in cmake) */
+  RegisterMevisDicomTiff();
+
+  /** Setup xout. */
+  const std::string logFileName = outFolder + "elastix.log";
+  if( elx::xoutSetup( logFileName.c_str(), true, true ) != 0 )
+  {
+    std::cerr << "ERROR while setting up xout." << std::endl;
+    return 1;
+  }
+  elxout << std::endl;
+
+  itk::TimeProbe totaltimer;
+  totaltimer.Start();
+  elxout << "elastix is started at " << GetCurrentDateAndTime() << ".\n" << std::endl;
+
+  /** The reference image and the masks are read once, and shared by all frames. */
+  DataObjectContainerPointer referenceImageContainer = nullptr;
+  DataObjectContainerPointer fixedMaskContainer      = nullptr;
+  DataObjectContainerPointer movingMaskContainer     = nullptr;
+  FlatDirectionCosinesType   referenceImageOriginalDirection;
+
+  int returndummy = 0;
+  for( std::size_t frame = firstFrame; frame < frames.size(); ++frame )
+  {
+    std::ostringstream frameOutFolder;
+    frameOutFolder << outFolder << "frame." << frame << "/";
+    itksys::SystemTools::MakeDirectory( frameOutFolder.str() );
+
+    argMap[ "-f" ]   = toPredecessor ? frames[ frame - 1 ] : referenceImageFileName;
+    argMap[ "-m" ]   = frames[ frame ];
+    argMap[ "-out" ] = frameOutFolder.str();
+
+    elxout << "-------------------------------------------------------------------------" << "\n" << std::endl;
+    elxout << "Registering frame " << frame << ": \"" << frames[ frame ]
+           << "\" to \"" << argMap[ "-f" ] << "\".\n" << std::endl;
+
+    itk::TimeProbe timer;
+    timer.Start();
+
+    ObjectPointer              transform                   = nullptr;
+    DataObjectContainerPointer fixedImageContainer         = toPredecessor ? nullptr : referenceImageContainer;
+    DataObjectContainerPointer movingImageContainer        = nullptr;
+    FlatDirectionCosinesType   fixedImageOriginalDirection = toPredecessor
+      ? FlatDirectionCosinesType() : referenceImageOriginalDirection;
+
+    for( unsigned int i = 0; i < parameterMaps.size(); ++i )
+    {
+      const auto elastixMain = ElastixMainType::New();
+
+      elastixMain->SetInitialTransform( transform );
+      elastixMain->SetFixedImageContainer( fixedImageContainer );
+      elastixMain->SetMovingImageContainer( movingImageContainer );
+      elastixMain->SetFixedMaskContainer( fixedMaskContainer );
+      elastixMain->SetMovingMaskContainer( movingMaskContainer );
+      elastixMain->SetOriginalFixedImageDirectionFlat( fixedImageOriginalDirection );
+      elastixMain->SetElastixLevel( i );
+      elastixMain->SetTotalNumberOfElastixLevels( static_cast< unsigned int >( parameterMaps.size() ) );
+
+      returndummy = elastixMain->Run( argMap, parameterMaps[ i ] );
+      if( returndummy != 0 )
+      {
+        xl::xout[ "error" ] << "Errors occurred in frame " << frame << "!" << std::endl;
+        break;
+      }
+
+      transform                   = elastixMain->GetModifiableFinalTransform();
+      fixedImageContainer         = elastixMain->GetModifiableFixedImageContainer();
+      movingImageContainer        = elastixMain->GetModifiableMovingImageContainer();
+      fixedMaskContainer          = elastixMain->GetModifiableFixedMaskContainer();
+      movingMaskContainer         = elastixMain->GetModifiableMovingMaskContainer();
+      fixedImageOriginalDirection = elastixMain->GetOriginalFixedImageDirectionFlat();
+      if( i == 0 && !toPredecessor )
+      {
+        referenceImageContainer         = fixedImageContainer;
+        referenceImageOriginalDirection = fixedImageOriginalDirection;
+      }
+
+      /** The next frame starts from the result of this one. */
+      ElastixMainType::SetWarmStart( parameterMaps[ i ], elastixMain->GetTransformParametersMap() );
+    }
+    if( returndummy != 0 )
+    {
+      break;
+    }
+
+    timer.Stop();
+    elxout << "Time used for registering frame " << frame << ": "
+           << ConvertSecondsToDHMS( timer.GetMean(), 3 ) << ".\n" << std::endl;
+  }
+
+  elxout << "-------------------------------------------------------------------------" << "\n" << std::endl;
+
+  totaltimer.Stop();
+  elxout << "Total time elapsed: "
+         << ConvertSecondsToDHMS( totaltimer.GetMean(), 1 ) << ".\n" << std::endl;
+
+  /** Make sure all the components are deleted before the modules are closed. */
+  referenceImageContainer = nullptr;
+  fixedMaskContainer      = nullptr;
+  movingMaskContainer     = nullptr;
+  ElastixMainType::UnloadComponents();
+
+  return returndummy;
+
+} // end RegisterSequence()
+
+
 /**
  * *********************** PrintHelp ****************************
  */
@@ -395,9 +792,36 @@ PrintHelp( void )
   std::cout << "  -fMask    mask for fixed image\n";
   std::cout << "  -mMask    mask for moving image\n";
   std::cout << "  -t0       parameter file for initial transform\n";
+  std::cout << "  -resume   the Checkpoint.txt of an interrupted registration with\n"
+            << "            (WriteCheckpointEachResolution \"true\"), to continue after\n"
+            << "            its last finished resolution with the same -out and -p\n";
   std::cout << "  -priority set the process priority to high, abovenormal, normal (default),\n"
             << "            belownormal, or idle (Windows only option)\n";
-  std::cout << "  -threads  set the maximum number of threads of elastix\n"
+  std::cout << "  -threads  set the maximum number of threads of elastix\n";
+  std::cout << "  -numa     use \"-numa on\" to pin the threads to the NUMA nodes, and to spread\n"
+            << "            the images over the nodes\n";
+  std::cout << "  -gpu      comma separated list of OpenCL device IDs, such as \"-gpu 0,1\",\n"
+            << "            the OpenCL jobs are placed on these devices in turn\n"
+            << std::endl;
+
+  /** Server mode.*/
+  std::cout << "Call elastix as a server with:\n";
+  std::cout << "  --serve   read jobs from the standard input, one line with the above\n"
+            << "            arguments per job, until the line \"quit\"\n";
+  std::cout << "  -pipe     read the jobs from this named pipe instead\n";
+  std::cout << "  -jobs     the number of jobs that run concurrently, default 1\n";
+  std::cout << "  -cache    the number of cached fixed images, default 4\n";
+  std::cout << "  The other arguments, such as -threads, are used for every job.\n"
+            << std::endl;
+
+  /** Sequence mode.*/
+  std::cout << "Call elastix on a sequence of images with:\n";
+  std::cout << "  --sequence register the frames in order, each starting from the result\n"
+            << "            of the previous one\n";
+  std::cout << "  -frames   text file with the file name of a frame on each line\n";
+  std::cout << "  -f        reference image; without it every frame is registered to\n"
+            << "            its predecessor\n";
+  std::cout << "  The results of frame i are written to the folder frame.i in -out.\n"
             << std::endl;
 
   /** The parameter file.*/
@@ -37,6 +37,25 @@
  */
 void PrintHelp( void );
 
+/** Run elastix as a server, which reads registration jobs from the standard
+ * input or a named pipe, see elastix::ElastixServer.
+ *
+ * \commandlinearg --serve: run elastix as a server. \n
+ *    example: <tt>elastix --serve -threads 4 -jobs 2 -pipe /tmp/elastix</tt> \n
+ */
+int Serve( int argc, char ** argv );
+
+/** Register a sequence of images, listed one file name per line in the file
+ * of the -frames argument, to the -f reference image, or, without -f, every
+ * frame to its predecessor. Each registration starts from the result of the
+ * previous one, see elastix::ElastixMain::SetWarmStart(). The results of
+ * frame i are written to the subfolder frame.i of the -out folder.
+ *
+ * \commandlinearg --sequence: register a sequence of images. \n
+ *    example: <tt>elastix --sequence -frames frames.txt -p par.txt -out out</tt> \n
+ */
+int RegisterSequence( int argc, char ** argv );
+
 /** ConvertSecondsToDHMS
  *
  */
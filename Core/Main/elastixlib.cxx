@@ -27,6 +27,7 @@
 
 // ITK header files:
 #include <itkDataObject.h>
+#include <itkLightObject.h>
 #include <itkObject.h>
 #include <itkTimeProbe.h>
 #include <itksys/SystemInformation.hxx>
@@ -35,8 +36,10 @@
 // Standard C++ header files:
 #include <cassert>
 #include <climits> // For UINT_MAX.
+#include <atomic>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace elastix
@@ -46,7 +49,8 @@ namespace elastix
  * ******************* Constructor ***********************
  */
 
-ELASTIX::ELASTIX()
+ELASTIX::ELASTIX() :
+  m_KeepComponentsLoaded( false )
 {
   BaseComponent::InitializeElastixLibrary();
   assert(BaseComponent::IsElastixLibrary());
@@ -94,6 +98,56 @@ ELASTIX::GetTransformParameterMapList( void )
 } // end GetTransformParameterMapList()
 
 
+/**
+ * ******************* GetResultImages ***********************
+ */
+
+ELASTIX::ImageListType
+ELASTIX::GetResultImages( void )
+{
+  return this->m_ResultImages;
+} // end GetResultImages()
+
+
+/**
+ * ******************* GetTransformParameterMapLists ***********************
+ */
+
+std::vector< ELASTIX::ParameterMapListType >
+ELASTIX::GetTransformParameterMapLists( void )
+{
+  return this->m_TransformParametersLists;
+} // end GetTransformParameterMapLists()
+
+
+/**
+ * ******************* ShareImage ***********************
+ *
+ * Returns a new image object that shares the pixel buffer of the image, so
+ * that registrations running at the same time do not change the requested
+ * region of one image object.
+ */
+
+static ELASTIX::ImagePointer
+ShareImage( const ELASTIX::ImagePointer & image )
+{
+  if( image.IsNull() )
+  {
+    return image;
+  }
+
+  const itk::LightObject::Pointer another = image->CreateAnother();
+  ELASTIX::ImagePointer           copy    = dynamic_cast< itk::DataObject * >( another.GetPointer() );
+  if( copy.IsNull() )
+  {
+    return image;
+  }
+
+  copy->Graft( image );
+  return copy;
+} // end ShareImage()
+
+
 /**
  * ******************* RegisterImages ***********************
  */
@@ -198,7 +252,8 @@ ELASTIX::RegisterImages(
 
   /** Setup xout. */
   const std::string logFileName = performLogging ? (outFolder + "elastix.log") : "";
-  int returndummy = elx::xoutSetup( logFileName.c_str(), performLogging, performCout );
+  elx::ThreadXout threadXout( logFileName.c_str(), performLogging, performCout );
+  int             returndummy = threadXout.GetErrorCode();
   if( ( returndummy != 0 ) && performCout )
   {
     if( performCout )
@@ -282,8 +337,13 @@ ELASTIX::RegisterImages(
     timer.Start();
     elxout << "Current time: " << GetCurrentDateAndTime() << "." << std::endl;
 
-    /** Start registration. */
-    returndummy = elastixMain->Run( argMap, parameterMaps[ i ] );
+    /** Start registration. The transform parameters are returned as
+     * strings in the transform parameter maps, as ELASTIX has no other way
+     * to return them; so the binary format is not used.
+     */
+    ParameterMapType parameterMap = parameterMaps[ i ];
+    parameterMap.erase( "UseBinaryFormatForTransformationParameters" );
+    returndummy = elastixMain->Run( argMap, parameterMap );
 
     /** Check for errors. */
     if( returndummy != 0 )
@@ -354,8 +414,11 @@ ELASTIX::RegisterImages(
   movingMaskContainer  = nullptr;
   resultImageContainer = nullptr;
 
-  /** Close the modules. */
-  ElastixMainType::UnloadComponents();
+  /** Close the modules, unless more registrations of a sequence follow. */
+  if( !this->m_KeepComponentsLoaded )
+  {
+    ElastixMainType::UnloadComponents();
+  }
 
   /** Exit and return the error code. */
   return 0;
@@ -363,4 +426,207 @@ ELASTIX::RegisterImages(
 } // end RegisterImages()
 
 
+/**
+ * ******************* RegisterImageBatch ***********************
+ */
+
+int
+ELASTIX::RegisterImageBatch(
+  const ImageListType & fixedImages,
+  const ImageListType & movingImages,
+  const std::vector< ParameterMapType > & parameterMaps,
+  const std::vector< std::string > & outputPaths,
+  bool performLogging,
+  bool performCout,
+  unsigned int numberOfConcurrentRegistrations,
+  ImagePointer fixedMask,
+  ImagePointer movingMask )
+{
+  this->m_ResultImages.clear();
+  this->m_TransformParametersLists.clear();
+
+  /** Check the number of images. */
+  const std::size_t numberOfRegistrations
+    = fixedImages.size() > movingImages.size() ? fixedImages.size() : movingImages.size();
+  if( fixedImages.empty() || movingImages.empty()
+    || ( fixedImages.size() != 1 && fixedImages.size() != numberOfRegistrations )
+    || ( movingImages.size() != 1 && movingImages.size() != numberOfRegistrations ) )
+  {
+    if( performCout )
+    {
+      std::cerr << "ERROR: give one fixed image and one moving image, "
+                << "or one for each registration." << std::endl;
+    }
+    return 1;
+  }
+  if( !outputPaths.empty() && outputPaths.size() != numberOfRegistrations )
+  {
+    if( performCout )
+    {
+      std::cerr << "ERROR: give one output path for each registration." << std::endl;
+    }
+    return 1;
+  }
+
+  if( numberOfConcurrentRegistrations == 0 )
+  {
+    numberOfConcurrentRegistrations = std::thread::hardware_concurrency();
+  }
+  if( numberOfConcurrentRegistrations == 0 || numberOfConcurrentRegistrations > numberOfRegistrations )
+  {
+    numberOfConcurrentRegistrations = static_cast< unsigned int >( numberOfRegistrations );
+  }
+
+  this->m_ResultImages.resize( numberOfRegistrations );
+  this->m_TransformParametersLists.resize( numberOfRegistrations );
+  std::vector< int > errorCodes( numberOfRegistrations, 0 );
+
+  /** Every worker takes the next registration, until all are done. Each
+   * registration has its own ELASTIX, and writes only its own results.
+   */
+  std::atomic< std::size_t > nextRegistration( 0 );
+  const auto worker = [&]()
+  {
+    for( std::size_t i = nextRegistration++; i < numberOfRegistrations; i = nextRegistration++ )
+    {
+      const ImagePointer & fixedImage  = fixedImages[ fixedImages.size() == 1 ? 0 : i ];
+      const ImagePointer & movingImage = movingImages[ movingImages.size() == 1 ? 0 : i ];
+
+      ELASTIX elastix;
+      try
+      {
+        errorCodes[ i ] = elastix.RegisterImages(
+          ShareImage( fixedImage ), ShareImage( movingImage ),
+          parameterMaps,
+          outputPaths.empty() ? std::string() : outputPaths[ i ],
+          performLogging, performCout,
+          ShareImage( fixedMask ), ShareImage( movingMask ) );
+      }
+      catch( itk::ExceptionObject & excp )
+      {
+        if( performCout )
+        {
+          std::cerr << "ERROR in registration " << i << ":\n" << excp << std::endl;
+        }
+        errorCodes[ i ] = 1;
+      }
+
+      this->m_ResultImages[ i ]             = elastix.GetResultImage();
+      this->m_TransformParametersLists[ i ] = elastix.GetTransformParameterMapList();
+    }
+  };
+
+  std::vector< std::thread > threads;
+  for( unsigned int t = 1; t < numberOfConcurrentRegistrations; ++t )
+  {
+    threads.emplace_back( worker );
+  }
+  worker();
+  for( auto & thread : threads )
+  {
+    thread.join();
+  }
+
+  /** Return the error code of the first registration that failed. */
+  for( const int errorCode : errorCodes )
+  {
+    if( errorCode != 0 )
+    {
+      return errorCode;
+    }
+  }
+  return 0;
+
+} // end RegisterImageBatch()
+
+
+/**
+ * ******************* RegisterImageSequence ***********************
+ */
+
+int
+ELASTIX::RegisterImageSequence(
+  const ImageListType & frames,
+  ImagePointer referenceImage,
+  const std::vector< ParameterMapType > & parameterMaps,
+  const std::vector< std::string > & outputPaths,
+  bool performLogging,
+  bool performCout,
+  ImagePointer fixedMask,
+  ImagePointer movingMask )
+{
+  this->m_ResultImages.clear();
+  this->m_TransformParametersLists.clear();
+
+  /** Without a reference image, the first frame is the fixed image of the
+   * first registration.
+   */
+  const bool        toPredecessor = referenceImage.IsNull();
+  const std::size_t firstFrame    = toPredecessor ? 1 : 0;
+  if( frames.size() <= firstFrame )
+  {
+    if( performCout )
+    {
+      std::cerr << "ERROR: give a reference image and at least one frame, "
+                << "or at least two frames." << std::endl;
+    }
+    return 1;
+  }
+  const std::size_t numberOfRegistrations = frames.size() - firstFrame;
+  if( !outputPaths.empty() && outputPaths.size() != numberOfRegistrations )
+  {
+    if( performCout )
+    {
+      std::cerr << "ERROR: give one output path for each registration." << std::endl;
+    }
+    return 1;
+  }
+
+  /** Register the frames in order, each starting from the result of the previous one. */
+  std::vector< ParameterMapType > warmStartMaps = parameterMaps;
+  int                             errorCode     = 0;
+  this->m_KeepComponentsLoaded = true;
+  for( std::size_t i = 0; i < numberOfRegistrations; ++i )
+  {
+    const std::size_t frame = firstFrame + i;
+    try
+    {
+      errorCode = this->RegisterImages(
+        toPredecessor ? frames[ frame - 1 ] : referenceImage, frames[ frame ],
+        warmStartMaps,
+        outputPaths.empty() ? std::string() : outputPaths[ i ],
+        performLogging, performCout,
+        fixedMask, movingMask );
+    }
+    catch( itk::ExceptionObject & excp )
+    {
+      if( performCout )
+      {
+        std::cerr << "ERROR in registration " << i << ":\n" << excp << std::endl;
+      }
+      errorCode = 1;
+    }
+    if( errorCode != 0 )
+    {
+      break;
+    }
+
+    this->m_ResultImages.push_back( this->m_ResultImage );
+    this->m_TransformParametersLists.push_back( this->m_TransformParametersList );
+    for( std::size_t j = 0; j < warmStartMaps.size() && j < this->m_TransformParametersList.size(); ++j )
+    {
+      elx::ElastixMain::SetWarmStart( warmStartMaps[ j ], this->m_TransformParametersList[ j ] );
+    }
+    this->m_ResultImage = nullptr;
+  }
+  this->m_KeepComponentsLoaded = false;
+
+  /** Close the modules. */
+  elx::ElastixMain::UnloadComponents();
+
+  return errorCode;
+
+} // end RegisterImageSequence()
+
+
 } // end namespace elastix
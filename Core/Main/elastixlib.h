@@ -41,8 +41,9 @@ class ELASTIXLIB_API ELASTIX
 public:
 
   //typedefs for images
-  typedef itk::DataObject Image;
-  typedef Image::Pointer  ImagePointer;
+  typedef itk::DataObject             Image;
+  typedef Image::Pointer              ImagePointer;
+  typedef std::vector< ImagePointer > ImageListType;
 
   //typedefs for parameter map
   typedef itk::ParameterFileParser::ParameterValuesType             ParameterValuesType;
@@ -102,6 +103,73 @@ public:
     ImagePointer movingMask = nullptr,
     ObjectPointer transform = nullptr);
 
+  /**
+   *  The batch registration interface, for example to register many atlases
+   *  to one target image. Registers one fixed image with each of the moving
+   *  images, or each of the fixed images with one moving image, running up
+   *  to numberOfConcurrentRegistrations registrations at the same time.
+   *  Params:
+   *    fixedImages one fixed image, or one per registration
+   *    movingImages  one moving image, or one per registration
+   *    parameterMaps the parameter maps of every registration
+   *    outputPaths one output folder per registration, where the
+   *      elastix.log and the results are written. May be empty when there
+   *      is no logging and no output files are written.
+   *    numberOfConcurrentRegistrations default (0) the number of cores
+   *    fixedMask, movingMask shared by all registrations, default no mask
+   *  The pixel buffers of the images and masks are shared by the
+   *  registrations, and not modified. The threads of the machine are
+   *  divided over the registrations that run at the same time.
+   *  return value: 0 if all registrations succeed, otherwise the error code
+   *    of the first registration that failed, see RegisterImages().
+   *  The results of registration i are available through
+   *  GetTransformParameterMapLists()[ i ] and GetResultImages()[ i ], also
+   *  when some of the other registrations failed.
+   */
+  int RegisterImageBatch( const ImageListType & fixedImages,
+    const ImageListType & movingImages,
+    const std::vector< ParameterMapType > & parameterMaps,
+    const std::vector< std::string > & outputPaths,
+    bool performLogging,
+    bool performCout,
+    unsigned int numberOfConcurrentRegistrations = 0,
+    ImagePointer fixedMask = nullptr,
+    ImagePointer movingMask = nullptr );
+
+  /**
+   *  The sequence registration interface, for example for 4D or cine images,
+   *  or intra-operative video. Registers every frame to a reference image, or,
+   *  if no reference image is given, every frame to its predecessor. Each
+   *  registration starts from the result of the previous one: the transform
+   *  parameters become its WarmStartTransformParameters, and the step size
+   *  settings that the AdaptiveStochasticGradientDescent estimated are used
+   *  instead of estimating them again. The components are kept loaded until
+   *  the last frame is registered.
+   *  Params:
+   *    frames  the moving images, in the order of the sequence
+   *    referenceImage  the fixed image of all registrations, default none,
+   *      in which case frame i is registered to frame i - 1, for i > 0
+   *    parameterMaps the parameter maps of every registration. For a warm
+   *      start the transform must have the same number of parameters in the
+   *      first resolution as after the last one, so a B-spline transform
+   *      should use the same grid in all resolutions.
+   *    outputPaths one output folder per registration, or empty, see
+   *      RegisterImageBatch()
+   *    fixedMask, movingMask shared by all registrations, default no mask
+   *  return value: 0 if all registrations succeed, otherwise the error code
+   *    of the registration that failed, after which the sequence stops.
+   *  The results of registration i are available through
+   *  GetTransformParameterMapLists()[ i ] and GetResultImages()[ i ].
+   */
+  int RegisterImageSequence( const ImageListType & frames,
+    ImagePointer referenceImage,
+    const std::vector< ParameterMapType > & parameterMaps,
+    const std::vector< std::string > & outputPaths,
+    bool performLogging,
+    bool performCout,
+    ImagePointer fixedMask = nullptr,
+    ImagePointer movingMask = nullptr );
+
   /** Getter for result image. */
   ImagePointer GetResultImage( void );
 
@@ -111,6 +179,14 @@ public:
   /** Get transform parameters of all registration steps. */
   ParameterMapListType GetTransformParameterMapList( void );
 
+  /** Get the result images of the last batch or sequence registration. */
+  ImageListType GetResultImages( void );
+
+  /** Get the transform parameters of all registration steps, of every
+   * registration of the last batch or sequence registration.
+   */
+  std::vector< ParameterMapListType > GetTransformParameterMapLists( void );
+
 private:
 
   /* the result images */
@@ -119,6 +195,13 @@ private:
   /* Final transformation*/
   ParameterMapListType m_TransformParametersList;
 
+  /* The results of the last batch or sequence registration. */
+  ImageListType                       m_ResultImages;
+  std::vector< ParameterMapListType > m_TransformParametersLists;
+
+  /* Do not unload the components after a registration, during a sequence. */
+  bool m_KeepComponentsLoaded;
+
 };
 
 // end class ELASTIX
@@ -19,6 +19,7 @@
 #define elxElastixFilter_h
 
 #include "itkImageSource.h"
+#include "itkTransformBase.h"
 
 #include "elxElastixMain.h"
 #include "elxParameterObject.h"
@@ -27,6 +28,15 @@
 /**
  * \class ElastixFilter
  * \brief ITK Filter interface to the Elastix registration library.
+ *
+ * Several filters may run at the same time, in different threads of one
+ * process, also with the same input images. Each filter logs to its own
+ * file, and the threads of the machine are divided over the running
+ * registrations, unless SetNumberOfThreads() is used.
+ *
+ * The input images are registered without a copy: the internal pixel types
+ * are those of TFixedImage and TMovingImage. The result image is returned
+ * without a copy as well, when it has the pixel type of the moving image.
  */
 
 namespace elastix
@@ -62,15 +72,18 @@ public:
   typedef ElastixMainType::DataObjectContainerPointer        DataObjectContainerPointer;
   typedef DataObjectContainerType::Iterator                  DataObjectContainerIterator;
   typedef itk::ProcessObject::DataObjectIdentifierType       DataObjectIdentifierType;
+  typedef itk::DataObject::Pointer                           DataObjectPointer;
   typedef itk::ProcessObject::DataObjectPointerArraySizeType DataObjectPointerArraySizeType;
   typedef itk::ProcessObject::NameArray                      NameArrayType;
 
-  typedef ParameterObject                               ParameterObjectType;
-  typedef ParameterObjectType::ParameterMapType         ParameterMapType;
-  typedef ParameterObjectType::ParameterMapVectorType   ParameterMapVectorType;
-  typedef ParameterObjectType::ParameterValueVectorType ParameterValueVectorType;
-  typedef ParameterObjectType::Pointer                  ParameterObjectPointer;
-  typedef ParameterObjectType::ConstPointer             ParameterObjectConstPointer;
+  typedef ParameterObject                                    ParameterObjectType;
+  typedef ParameterObjectType::ParameterMapType              ParameterMapType;
+  typedef ParameterObjectType::ParameterMapVectorType        ParameterMapVectorType;
+  typedef ParameterObjectType::ParameterValueVectorType      ParameterValueVectorType;
+  typedef ParameterObjectType::Pointer                       ParameterObjectPointer;
+  typedef ParameterObjectType::ConstPointer                  ParameterObjectConstPointer;
+  typedef ParameterObjectType::TransformParametersType       TransformParametersType;
+  typedef ParameterObjectType::TransformParametersVectorType TransformParametersVectorType;
 
   typedef typename TFixedImage::Pointer       FixedImagePointer;
   typedef typename TFixedImage::ConstPointer  FixedImageConstPointer;
@@ -185,6 +198,17 @@ private:
   /** GetNumberOfInputsOfType */
   unsigned int GetNumberOfInputsOfType( const DataObjectIdentifierType & intputType );
 
+  /** Sets an internal pixel type parameter to the pixel type of the input
+   * images, throwing an exception if the parameter has another value.
+   */
+  void SetInternalImagePixelType( ParameterMapType & parameterMap,
+    const std::string & parameterName, const std::string & pixelType );
+
+  /** Returns an object of the same type as the input, that shares its
+   * pixel buffer, so that the input is not modified by the registration.
+   */
+  DataObjectPointer ShareInput( const DataObjectIdentifierType & inputName );
+
   /** RemoveInputsOfType. */
   void RemoveInputsOfType( const DataObjectIdentifierType & inputName );
 
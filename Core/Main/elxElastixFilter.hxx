@@ -74,14 +74,15 @@ ElastixFilter< TFixedImage, TMovingImage >
   const unsigned int fixedImageDimension = FixedImageDimension;
   const unsigned int movingImageDimension = MovingImageDimension;
 
-  DataObjectContainerPointer fixedImageContainer  = DataObjectContainerType::New();
-  DataObjectContainerPointer movingImageContainer = DataObjectContainerType::New();
-  DataObjectContainerPointer fixedMaskContainer   = nullptr;
-  DataObjectContainerPointer movingMaskContainer  = nullptr;
-  DataObjectContainerPointer resultImageContainer = nullptr;
-  ElastixMainObjectPointer   transform            = nullptr;
-  ParameterMapVectorType     transformParameterMapVector;
-  FlatDirectionCosinesType   fixedImageOriginalDirection;
+  DataObjectContainerPointer    fixedImageContainer  = DataObjectContainerType::New();
+  DataObjectContainerPointer    movingImageContainer = DataObjectContainerType::New();
+  DataObjectContainerPointer    fixedMaskContainer   = nullptr;
+  DataObjectContainerPointer    movingMaskContainer  = nullptr;
+  DataObjectContainerPointer    resultImageContainer = nullptr;
+  ElastixMainObjectPointer      transform            = nullptr;
+  ParameterMapVectorType        transformParameterMapVector;
+  TransformParametersVectorType transformParametersVector;
+  FlatDirectionCosinesType      fixedImageOriginalDirection;
 
   // Split inputs into separate containers
   const NameArrayType inputNames = this->GetInputNames();
@@ -89,13 +90,13 @@ ElastixFilter< TFixedImage, TMovingImage >
   {
     if( this->IsInputOfType( "FixedImage", inputNames[ i ] ) )
     {
-      fixedImageContainer->push_back( this->GetInput( inputNames[ i ] ) );
+      fixedImageContainer->push_back( this->ShareInput( inputNames[ i ] ) );
       continue;
     }
 
     if( this->IsInputOfType( "MovingImage", inputNames[ i ] ) )
     {
-      movingImageContainer->push_back( this->GetInput( inputNames[ i ] ) );
+      movingImageContainer->push_back( this->ShareInput( inputNames[ i ] ) );
       continue;
     }
 
@@ -106,7 +107,7 @@ ElastixFilter< TFixedImage, TMovingImage >
         fixedMaskContainer = DataObjectContainerType::New();
       }
 
-      fixedMaskContainer->push_back( this->GetInput( inputNames[ i ] ) );
+      fixedMaskContainer->push_back( this->ShareInput( inputNames[ i ] ) );
       continue;
     }
 
@@ -117,7 +118,7 @@ ElastixFilter< TFixedImage, TMovingImage >
         movingMaskContainer = DataObjectContainerType::New();
       }
 
-      movingMaskContainer->push_back( this->GetInput( inputNames[ i ] ) );
+      movingMaskContainer->push_back( this->ShareInput( inputNames[ i ] ) );
     }
   }
 
@@ -198,8 +199,10 @@ ElastixFilter< TFixedImage, TMovingImage >
     argumentMap.insert( ArgumentMapEntryType( "-threads", std::to_string( this->m_NumberOfThreads ) ) );
   }
 
-  // Setup xout
-  if( elx::xoutSetup( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() ) )
+  // Setup the xout of this thread, so that filters in other threads log
+  // to their own files
+  elx::ThreadXout threadXout( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() );
+  if( threadXout.GetErrorCode() )
   {
     itkExceptionMacro( "Error while setting up xout" );
   }
@@ -215,6 +218,13 @@ ElastixFilter< TFixedImage, TMovingImage >
     parameterMapVector[ i ][ "ResultImagePixelType" ]
       = ParameterValueVectorType( 1, PixelType< typename TFixedImage::PixelType >::ToString() );
 
+    // The registration uses the buffers of the input images, so the internal
+    // pixel types are those of the inputs
+    this->SetInternalImagePixelType( parameterMapVector[ i ], "FixedInternalImagePixelType",
+      PixelType< typename TFixedImage::PixelType >::ToString() );
+    this->SetInternalImagePixelType( parameterMapVector[ i ], "MovingInternalImagePixelType",
+      PixelType< typename TMovingImage::PixelType >::ToString() );
+
     // Initial transform parameter files are handled via arguments and enclosing loop, not InitialTransformParametersFileName
     if( parameterMapVector[ i ].find( "InitialTransformParametersFileName" ) != parameterMapVector[ i ].end() )
     {
@@ -263,6 +273,17 @@ ElastixFilter< TFixedImage, TMovingImage >
     fixedImageOriginalDirection = elastix->GetOriginalFixedImageDirectionFlat();
 
     transformParameterMapVector.push_back( elastix->GetTransformParametersMap() );
+
+    // In the binary format, the transform parameters are taken from the
+    // final transform, instead of being converted to strings
+    transformParametersVector.push_back( TransformParametersType() );
+    const auto binaryFormat = transformParameterMapVector[ i ].find( "UseBinaryFormatForTransformationParameters" );
+    const itk::TransformBase * finalTransform = dynamic_cast< const itk::TransformBase * >( transform.GetPointer() );
+    if( binaryFormat != transformParameterMapVector[ i ].end() && !binaryFormat->second.empty()
+      && binaryFormat->second[ 0 ] == "true" && finalTransform != ITK_NULLPTR )
+    {
+      transformParametersVector[ i ] = finalTransform->GetParameters();
+    }
     if( i > 0 )
     {
       transformParameterMapVector[ i ][ "InitialTransformParametersFileName" ]
@@ -286,7 +307,8 @@ ElastixFilter< TFixedImage, TMovingImage >
 
   // Save parameter map
   ParameterObject::Pointer transformParameterObject = ParameterObject::New();
-  transformParameterObject->SetParameterMap( transformParameterMapVector );
+  transformParameterObject->SetParameterMap( std::move( transformParameterMapVector ) );
+  transformParameterObject->SetTransformParameters( transformParametersVector );
   this->SetOutput( "TransformParameterObject", transformParameterObject );
 }
 
@@ -822,6 +844,60 @@ ElastixFilter< TFixedImage, TMovingImage >
 } // end IsInputOfType()
 
 
+/**
+ * ********************* SetInternalImagePixelType *********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+void
+ElastixFilter< TFixedImage, TMovingImage >
+::SetInternalImagePixelType( ParameterMapType & parameterMap,
+  const std::string & parameterName, const std::string & pixelType )
+{
+  ParameterMapType::const_iterator found = parameterMap.find( parameterName );
+  if( found == parameterMap.end() || found->second.empty() )
+  {
+    parameterMap[ parameterName ] = ParameterValueVectorType( 1, pixelType );
+  }
+  else if( found->second[ 0 ] != pixelType )
+  {
+    itkExceptionMacro( << parameterName << " is \"" << found->second[ 0 ]
+                       << "\", but the pixel type of the input image is \"" << pixelType
+                       << "\". Remove the parameter, or cast the image." );
+  }
+} // end SetInternalImagePixelType()
+
+
+/**
+ * ********************* ShareInput *********************
+ */
+
+template< typename TFixedImage, typename TMovingImage >
+typename ElastixFilter< TFixedImage, TMovingImage >::DataObjectPointer
+ElastixFilter< TFixedImage, TMovingImage >
+::ShareInput( const DataObjectIdentifierType & inputName )
+{
+  // The registration sets the requested region of its images, so it gets a
+  // new image object that shares the pixel buffer of the input. The input
+  // itself is only read, and may be an input of filters in other threads.
+  itk::DataObject * input = this->GetInput( inputName );
+  if( input == ITK_NULLPTR )
+  {
+    return input;
+  }
+
+  itk::LightObject::Pointer another = input->CreateAnother();
+  DataObjectPointer         copy    = dynamic_cast< itk::DataObject * >( another.GetPointer() );
+  if( copy.IsNull() )
+  {
+    return input;
+  }
+
+  copy->Graft( input );
+  return copy;
+} // end ShareInput()
+
+
 /**
  * ********************* RemoveInputsOfType *********************
  */
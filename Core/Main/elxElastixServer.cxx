@@ -0,0 +1,615 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// Elastix header files:
+#include "elxElastixServer.h"
+#include "itkParameterFileParser.h"
+
+// ITK header files:
+#include <itksys/SystemTools.hxx>
+
+// Standard C++ header files:
+#include <sstream>
+
+namespace elastix
+{
+
+/**
+ * ******************* Constructor ***********************
+ */
+
+ElastixServer::ElastixServer() :
+  m_NumberOfConcurrentJobs( 1 ),
+  m_MaximumNumberOfCachedImages( 4 ),
+  m_NumberOfJobs( 0 ),
+  m_Output( nullptr ),
+  m_Stopping( false ),
+  m_Stopped( false )
+{
+  /** Keep the OpenCL context of the first job for the next ones. */
+  ElastixMainType::SetKeepOpenCLContext( true );
+
+} // end Constructor
+
+
+/**
+ * ******************* Destructor ***********************
+ */
+
+ElastixServer::~ElastixServer()
+{
+  this->Stop();
+
+} // end Destructor
+
+
+/**
+ * ******************* SetServerArguments ***********************
+ */
+
+void
+ElastixServer::SetServerArguments( const ArgumentMapType & arguments )
+{
+  this->m_ServerArguments = arguments;
+
+} // end SetServerArguments()
+
+
+/**
+ * ******************* SetNumberOfConcurrentJobs ***********************
+ */
+
+void
+ElastixServer::SetNumberOfConcurrentJobs( const unsigned int number )
+{
+  this->m_NumberOfConcurrentJobs = number > 0 ? number : 1;
+
+} // end SetNumberOfConcurrentJobs()
+
+
+/**
+ * ******************* SetMaximumNumberOfCachedImages ***********************
+ */
+
+void
+ElastixServer::SetMaximumNumberOfCachedImages( const unsigned int number )
+{
+  this->m_MaximumNumberOfCachedImages = number;
+
+} // end SetMaximumNumberOfCachedImages()
+
+
+/**
+ * ******************* Serve ***********************
+ */
+
+bool
+ElastixServer::Serve( std::istream & input, std::ostream & output )
+{
+  /** Start the worker threads. */
+  if( this->m_Workers.empty() )
+  {
+    this->m_Output = &output;
+    for( unsigned int i = 0; i < this->m_NumberOfConcurrentJobs; ++i )
+    {
+      this->m_Workers.push_back( std::thread( &ElastixServer::WorkerLoop, this ) );
+    }
+  }
+
+  /** Read the jobs line by line. */
+  std::string line;
+  while( std::getline( input, line ) )
+  {
+    const std::vector< std::string > arguments = SplitLine( line );
+    if( arguments.empty() || arguments[ 0 ][ 0 ] == '#' )
+    {
+      continue;
+    }
+    if( arguments.size() == 1 && arguments[ 0 ] == "quit" )
+    {
+      return true;
+    }
+
+    Job job;
+    job.m_ID = ++this->m_NumberOfJobs;
+    const std::string reason = this->ParseJob( arguments, job );
+
+    std::ostringstream status;
+    status << "job " << job.m_ID;
+    if( !reason.empty() )
+    {
+      status << " rejected: " << reason;
+      this->WriteStatus( status.str() );
+      continue;
+    }
+    status << " accepted";
+    this->WriteStatus( status.str() );
+
+    /** Queue the job for the workers. */
+    {
+      std::lock_guard< std::mutex > lock( this->m_JobMutex );
+      this->m_Jobs.push( job );
+    }
+    this->m_JobCondition.notify_one();
+  }
+
+  return false;
+
+} // end Serve()
+
+
+/**
+ * ******************* Stop ***********************
+ */
+
+void
+ElastixServer::Stop( void )
+{
+  if( this->m_Stopped )
+  {
+    return;
+  }
+  this->m_Stopped = true;
+
+  /** Let the workers finish the queued jobs. */
+  {
+    std::lock_guard< std::mutex > lock( this->m_JobMutex );
+    this->m_Stopping = true;
+  }
+  this->m_JobCondition.notify_all();
+  for( std::size_t i = 0; i < this->m_Workers.size(); ++i )
+  {
+    this->m_Workers[ i ].join();
+  }
+  this->m_Workers.clear();
+
+  /** Make sure that the cached images, which may be defined in a module,
+   * are deleted before the modules are closed.
+   */
+  this->m_Cache.clear();
+  this->m_CacheOrder.clear();
+
+#ifdef ELASTIX_USE_OPENCL
+  ElastixMainType::SetKeepOpenCLContext( false );
+  itk::OpenCLContext::Pointer context = itk::OpenCLContext::GetInstance();
+  if( context->IsCreated() )
+  {
+    context->Release();
+  }
+#endif
+
+  /** Close the modules. */
+  if( ElastixMainType::GetComponentDatabase() != nullptr )
+  {
+    ElastixMainType::UnloadComponents();
+  }
+
+} // end Stop()
+
+
+/**
+ * ******************* SplitLine ***********************
+ */
+
+std::vector< std::string >
+ElastixServer::SplitLine( const std::string & line )
+{
+  std::vector< std::string > arguments;
+  std::string                argument;
+  bool                       inArgument = false;
+  bool                       quoted     = false;
+
+  for( std::size_t i = 0; i < line.size(); ++i )
+  {
+    const char c = line[ i ];
+    if( c == '"' )
+    {
+      quoted     = !quoted;
+      inArgument = true;
+    }
+    else if( !quoted && ( c == ' ' || c == '\t' || c == '\r' ) )
+    {
+      if( inArgument )
+      {
+        arguments.push_back( argument );
+        argument.clear();
+        inArgument = false;
+      }
+    }
+    else
+    {
+      argument.push_back( c );
+      inArgument = true;
+    }
+  }
+  if( inArgument )
+  {
+    arguments.push_back( argument );
+  }
+
+  return arguments;
+
+} // end SplitLine()
+
+
+/**
+ * ******************* ParseJob ***********************
+ */
+
+std::string
+ElastixServer::ParseJob( const std::vector< std::string > & arguments, Job & job ) const
+{
+  if( arguments.size() % 2 != 0 )
+  {
+    return "the arguments are not pairs of an option and a value";
+  }
+
+  /** Put the arguments in the argument map, like elastix does. */
+  for( std::size_t i = 0; i < arguments.size(); i += 2 )
+  {
+    const std::string & key   = arguments[ i ];
+    std::string         value = arguments[ i + 1 ];
+
+    if( key == "-p" )
+    {
+      /** The different '-p' are stored with keys p(1), p(2), etc. */
+      job.m_ParameterFileList.push( value );
+      std::ostringstream tempPname;
+      tempPname << "-p(" << job.m_ParameterFileList.size() << ")";
+      job.m_ArgumentMap.insert( ArgumentMapType::value_type( tempPname.str(), value ) );
+      continue;
+    }
+
+    if( key == "-out" )
+    {
+      /** Make sure that last character of the output folder equals a '/' or '\'. */
+      const char last = value[ value.size() - 1 ];
+      if( last != '/' && last != '\\' ) { value.append( "/" ); }
+      value = itksys::SystemTools::ConvertToOutputPath( value );
+      if( itksys::SystemTools::StringStartsWith( value, "\"" )
+        && itksys::SystemTools::StringEndsWith(   value, "\"" ) )
+      {
+        value = value.substr( 1, value.length() - 2 );
+      }
+      job.m_OutFolder = value;
+    }
+
+    if( job.m_ArgumentMap.count( key ) != 0 )
+    {
+      return "the option " + key + " is given more than once";
+    }
+    job.m_ArgumentMap.insert( ArgumentMapType::value_type( key, value ) );
+  }
+
+  if( job.m_ParameterFileList.empty() )
+  {
+    return "no option -p given";
+  }
+  if( job.m_OutFolder.empty() )
+  {
+    return "no option -out given";
+  }
+  if( !itksys::SystemTools::FileIsDirectory( job.m_OutFolder ) )
+  {
+    return "the output directory \"" + job.m_OutFolder + "\" does not exist";
+  }
+
+  /** The arguments of the server override those of the job. */
+  for( ArgumentMapType::const_iterator it = this->m_ServerArguments.begin();
+    it != this->m_ServerArguments.end(); ++it )
+  {
+    job.m_ArgumentMap[ it->first ] = it->second;
+  }
+
+  return "";
+
+} // end ParseJob()
+
+
+/**
+ * ******************* RunJob ***********************
+ */
+
+int
+ElastixServer::RunJob( Job & job )
+{
+  /** The messages of this job go to its own log file. */
+  const std::string logFileName = job.m_OutFolder + "elastix.log";
+  ThreadXout        threadXout( logFileName.c_str(), true, false );
+  if( threadXout.GetErrorCode() != 0 )
+  {
+    return 1;
+  }
+
+  elxout << "elastix server job " << job.m_ID << std::endl;
+
+  /** Use the fixed images of an earlier job, if they are cached. */
+  const std::string key = this->GetCacheKey( job );
+  CachedImage       cachedImage;
+  const bool        cacheHit = !key.empty() && this->CheckOutImage( key, cachedImage );
+
+  ElastixMainType::ObjectPointer transform            = nullptr;
+  DataObjectContainerPointer     fixedImageContainer  = nullptr;
+  DataObjectContainerPointer     movingImageContainer = nullptr;
+  DataObjectContainerPointer     fixedMaskContainer   = nullptr;
+  DataObjectContainerPointer     movingMaskContainer  = nullptr;
+  FlatDirectionCosinesType       fixedImageOriginalDirection;
+  if( cacheHit )
+  {
+    elxout << "Using the cached fixed image." << std::endl;
+    fixedImageContainer         = cachedImage.m_Container;
+    fixedImageOriginalDirection = cachedImage.m_Direction;
+  }
+
+  /** Do the (possibly multiple) registration(s), like elastix does. */
+  const unsigned int nrOfParameterFiles
+    = static_cast< unsigned int >( job.m_ParameterFileList.size() );
+  int returndummy = 0;
+  for( unsigned int i = 0; i < nrOfParameterFiles; ++i )
+  {
+    const auto elastixMain = ElastixMainType::New();
+
+    elastixMain->SetInitialTransform( transform );
+    elastixMain->SetFixedImageContainer( fixedImageContainer );
+    elastixMain->SetMovingImageContainer( movingImageContainer );
+    elastixMain->SetFixedMaskContainer( fixedMaskContainer );
+    elastixMain->SetMovingMaskContainer( movingMaskContainer );
+    elastixMain->SetOriginalFixedImageDirectionFlat( fixedImageOriginalDirection );
+    elastixMain->SetElastixLevel( i );
+    elastixMain->SetTotalNumberOfElastixLevels( nrOfParameterFiles );
+
+    std::string & parameterFileName = job.m_ArgumentMap[ "-p" ];
+    parameterFileName.swap( job.m_ParameterFileList.front() );
+    job.m_ParameterFileList.pop();
+
+    elxout << "Running elastix with parameter file " << i
+           << ": \"" << parameterFileName << "\".\n" << std::endl;
+
+    returndummy = elastixMain->Run( job.m_ArgumentMap );
+    if( returndummy != 0 )
+    {
+      xl::xout[ "error" ] << "Errors occurred!" << std::endl;
+      break;
+    }
+
+    transform                   = elastixMain->GetModifiableFinalTransform();
+    fixedImageContainer         = elastixMain->GetModifiableFixedImageContainer();
+    movingImageContainer        = elastixMain->GetModifiableMovingImageContainer();
+    fixedMaskContainer          = elastixMain->GetModifiableFixedMaskContainer();
+    movingMaskContainer         = elastixMain->GetModifiableMovingMaskContainer();
+    fixedImageOriginalDirection = elastixMain->GetOriginalFixedImageDirectionFlat();
+
+    /** Keep the fixed images that the first registration read. */
+    if( i == 0 && !cacheHit )
+    {
+      cachedImage.m_Container = fixedImageContainer;
+      cachedImage.m_Direction = fixedImageOriginalDirection;
+    }
+  }
+
+  /** Return the fixed images to the cache. */
+  if( !key.empty() && cachedImage.m_Container.IsNotNull() )
+  {
+    this->CheckInImage( key, cachedImage );
+  }
+
+  elxout << "elastix server job " << job.m_ID << " has finished." << std::endl;
+
+  return returndummy;
+
+} // end RunJob()
+
+
+/**
+ * ******************* GetCacheKey ***********************
+ */
+
+std::string
+ElastixServer::GetCacheKey( const Job & job ) const
+{
+  if( this->m_MaximumNumberOfCachedImages == 0 )
+  {
+    return "";
+  }
+
+  /** The pixel type and dimension of the fixed images are those of the first
+   * parameter file, which is read again by the registration.
+   */
+  ArgumentMapType::const_iterator parameterFile = job.m_ArgumentMap.find( "-p(1)" );
+  if( parameterFile == job.m_ArgumentMap.end() )
+  {
+    return "";
+  }
+  itk::ParameterFileParser::ParameterMapType parameterMap;
+  try
+  {
+    itk::ParameterFileParser::Pointer parser = itk::ParameterFileParser::New();
+    parser->SetParameterFileName( parameterFile->second );
+    parser->ReadParameterFile();
+    parameterMap = parser->GetParameterMap();
+  }
+  catch( itk::ExceptionObject & )
+  {
+    return "";
+  }
+
+  /** The InfoChanger changes the direction of the cached images otherwise. */
+  itk::ParameterFileParser::ParameterMapType::const_iterator useDirectionCosines
+    = parameterMap.find( "UseDirectionCosines" );
+  if( useDirectionCosines != parameterMap.end()
+    && !useDirectionCosines->second.empty() && useDirectionCosines->second[ 0 ] == "false" )
+  {
+    return "";
+  }
+
+  std::ostringstream key;
+  const char *       parameters[ 2 ] = { "FixedInternalImagePixelType", "FixedImageDimension" };
+  for( unsigned int i = 0; i < 2; ++i )
+  {
+    itk::ParameterFileParser::ParameterMapType::const_iterator it = parameterMap.find( parameters[ i ] );
+    key << ( it != parameterMap.end() && !it->second.empty() ? it->second[ 0 ] : "" ) << ";";
+  }
+
+  /** The fixed images, with their modification times. */
+  bool hasFixedImage = false;
+  for( ArgumentMapType::const_iterator it = job.m_ArgumentMap.begin(); it != job.m_ArgumentMap.end(); ++it )
+  {
+    if( it->first.compare( 0, 2, "-f" ) == 0 && it->first != "-fMask" )
+    {
+      if( !itksys::SystemTools::FileExists( it->second ) )
+      {
+        return "";
+      }
+      key << it->first << "=" << it->second << "@"
+          << itksys::SystemTools::ModifiedTime( it->second ) << ";";
+      hasFixedImage = true;
+    }
+  }
+
+  return hasFixedImage ? key.str() : "";
+
+} // end GetCacheKey()
+
+
+/**
+ * ******************* CheckOutImage ***********************
+ */
+
+bool
+ElastixServer::CheckOutImage( const std::string & key, CachedImage & image )
+{
+  std::lock_guard< std::mutex > lock( this->m_CacheMutex );
+
+  std::map< std::string, CachedImage >::iterator it = this->m_Cache.find( key );
+  if( it == this->m_Cache.end() || it->second.m_InUse )
+  {
+    return false;
+  }
+
+  it->second.m_InUse = true;
+  image              = it->second;
+  this->m_CacheOrder.remove( key );
+  this->m_CacheOrder.push_back( key );
+  return true;
+
+} // end CheckOutImage()
+
+
+/**
+ * ******************* CheckInImage ***********************
+ */
+
+void
+ElastixServer::CheckInImage( const std::string & key, const CachedImage & image )
+{
+  /** Detach the images from their readers, so that jobs only read them. */
+  for( unsigned int i = 0; i < image.m_Container->Size(); ++i )
+  {
+    if( image.m_Container->ElementAt( i ).IsNotNull() )
+    {
+      image.m_Container->ElementAt( i )->DisconnectPipeline();
+    }
+  }
+
+  std::lock_guard< std::mutex > lock( this->m_CacheMutex );
+
+  std::map< std::string, CachedImage >::iterator it = this->m_Cache.find( key );
+  if( it != this->m_Cache.end() )
+  {
+    /** A concurrent job may have cached the same images meanwhile. */
+    if( it->second.m_InUse )
+    {
+      it->second         = image;
+      it->second.m_InUse = false;
+    }
+    return;
+  }
+
+  CachedImage & cachedImage = this->m_Cache[ key ];
+  cachedImage               = image;
+  cachedImage.m_InUse       = false;
+  this->m_CacheOrder.push_back( key );
+
+  /** Remove the least recently used images that are not in use. */
+  std::list< std::string >::iterator oldest = this->m_CacheOrder.begin();
+  while( this->m_Cache.size() > this->m_MaximumNumberOfCachedImages
+    && oldest != this->m_CacheOrder.end() )
+  {
+    if( this->m_Cache[ *oldest ].m_InUse )
+    {
+      ++oldest;
+      continue;
+    }
+    this->m_Cache.erase( *oldest );
+    oldest = this->m_CacheOrder.erase( oldest );
+  }
+
+} // end CheckInImage()
+
+
+/**
+ * ******************* WorkerLoop ***********************
+ */
+
+void
+ElastixServer::WorkerLoop( void )
+{
+  while( true )
+  {
+    Job job;
+    {
+      std::unique_lock< std::mutex > lock( this->m_JobMutex );
+      this->m_JobCondition.wait( lock, [this]()
+      {
+        return this->m_Stopping || !this->m_Jobs.empty();
+      } );
+      if( this->m_Jobs.empty() )
+      {
+        return;
+      }
+      job = this->m_Jobs.front();
+      this->m_Jobs.pop();
+    }
+
+    const int exitCode = this->RunJob( job );
+
+    std::ostringstream status;
+    status << "job " << job.m_ID << " finished with exit code " << exitCode;
+    this->WriteStatus( status.str() );
+  }
+
+} // end WorkerLoop()
+
+
+/**
+ * ******************* WriteStatus ***********************
+ */
+
+void
+ElastixServer::WriteStatus( const std::string & status )
+{
+  std::lock_guard< std::mutex > lock( this->m_OutputMutex );
+  if( this->m_Output != nullptr )
+  {
+    *this->m_Output << status << std::endl;
+  }
+
+} // end WriteStatus()
+
+
+} // end namespace elastix
@@ -0,0 +1,168 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __elxElastixServer_h
+#define __elxElastixServer_h
+
+#include "elxElastixMain.h"
+
+#include <condition_variable>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace elastix
+{
+
+/**
+ * \class ElastixServer
+ * \brief Runs registration jobs in a long-running elastix process.
+ *
+ * Every invocation of elastix loads the components, creates the OpenCL
+ * context and reads its images. The server keeps the components, the
+ * thread pool and the OpenCL context of the process between jobs, and
+ * caches the fixed images of recent jobs.
+ *
+ * A job is a line with the command line arguments of elastix, such as
+ * <tt>-f fixed.mhd -m moving.mhd -p parameters.txt -out result/</tt>.
+ * Arguments with spaces are enclosed in double quotes. The line
+ * <tt>quit</tt> stops the server after the running jobs. For each job the
+ * server writes <tt>job \<id\> accepted</tt> or
+ * <tt>job \<id\> rejected: \<reason\></tt> when the line is read, and
+ * <tt>job \<id\> finished with exit code \<code\></tt> when it is done. The
+ * messages of a job go to the elastix.log in its output directory only.
+ *
+ * Several jobs run concurrently, see SetNumberOfConcurrentJobs(), sharing
+ * the thread pool and the OpenCL context. The server arguments, such as
+ * <tt>-threads</tt>, override those of the jobs.
+ *
+ * A cached fixed image is used by one job at a time, and only for jobs with
+ * the same fixed image files, which have not changed, the same
+ * FixedInternalImagePixelType and FixedImageDimension, and
+ * UseDirectionCosines set to true.
+ */
+
+class ElastixServer
+{
+public:
+
+  typedef ElastixMain                                 ElastixMainType;
+  typedef ElastixMainType::ArgumentMapType            ArgumentMapType;
+  typedef ElastixMainType::DataObjectContainerPointer DataObjectContainerPointer;
+  typedef ElastixMainType::FlatDirectionCosinesType   FlatDirectionCosinesType;
+
+  /** Constructor and destructor. */
+  ElastixServer();
+  ~ElastixServer();
+
+  /** Set the arguments that are added to every job, overriding those of the
+   * job, such as "-threads" and "-gpu". They include "-argv0". */
+  void SetServerArguments( const ArgumentMapType & arguments );
+
+  /** Set the number of jobs that run concurrently. The default is 1. */
+  void SetNumberOfConcurrentJobs( const unsigned int number );
+
+  /** Set the number of cached fixed images. The default is 4, 0 disables
+   * the cache. */
+  void SetMaximumNumberOfCachedImages( const unsigned int number );
+
+  /** Read jobs from \a input and run them, until the end of the input or
+   * the line "quit", and write their status to \a output. The first call
+   * starts the worker threads, which keep writing to its \a output.
+   * Returns true if the server has to stop, so after "quit". */
+  bool Serve( std::istream & input, std::ostream & output );
+
+  /** Wait for the running jobs, release the cache, the OpenCL context and
+   * the components. */
+  void Stop( void );
+
+private:
+
+  ElastixServer( const ElastixServer & ) = delete;
+  ElastixServer & operator=( const ElastixServer & ) = delete;
+
+  /** A job: its id, and arguments like those of the command line. */
+  struct Job
+  {
+    unsigned int              m_ID;
+    ArgumentMapType           m_ArgumentMap;
+    std::queue< std::string > m_ParameterFileList;
+    std::string               m_OutFolder;
+  };
+
+  /** A cached fixed image container. */
+  struct CachedImage
+  {
+    DataObjectContainerPointer m_Container;
+    FlatDirectionCosinesType   m_Direction;
+    bool                       m_InUse;
+  };
+
+  /** Split a job line into arguments. */
+  static std::vector< std::string > SplitLine( const std::string & line );
+
+  /** Fill a job from its arguments. Returns an empty string if the job is
+   * valid, and the reason otherwise. */
+  std::string ParseJob( const std::vector< std::string > & arguments, Job & job ) const;
+
+  /** Run a job, and return its exit code. */
+  int RunJob( Job & job );
+
+  /** The key of the fixed images of a job in the cache, or an empty string
+   * if they are not cached. */
+  std::string GetCacheKey( const Job & job ) const;
+
+  /** Take a cached fixed image out of the cache, for one job, and return it
+   * to the cache. */
+  bool CheckOutImage( const std::string & key, CachedImage & image );
+  void CheckInImage( const std::string & key, const CachedImage & image );
+
+  /** The loop of a worker thread. */
+  void WorkerLoop( void );
+
+  /** Write a status line to the output. */
+  void WriteStatus( const std::string & status );
+
+  ArgumentMapType m_ServerArguments;
+  unsigned int    m_NumberOfConcurrentJobs;
+  unsigned int    m_MaximumNumberOfCachedImages;
+  unsigned int    m_NumberOfJobs;
+  std::ostream *  m_Output;
+  bool            m_Stopped;
+
+  std::vector< std::thread > m_Workers;
+  std::queue< Job >          m_Jobs;
+  bool                       m_Stopping;
+  std::mutex                 m_JobMutex;
+  std::condition_variable    m_JobCondition;
+  std::mutex                 m_OutputMutex;
+
+  std::map< std::string, CachedImage > m_Cache;
+  std::list< std::string >             m_CacheOrder;
+  std::mutex                           m_CacheMutex;
+};
+
+// end class ElastixServer
+
+} // end namespace elastix
+
+#endif // end #ifndef __elxElastixServer_h
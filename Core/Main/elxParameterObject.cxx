@@ -20,6 +20,7 @@
 
 #include "elxParameterObject.h"
 
+#include "itkByteSwapper.h"
 #include "itkFileTools.h"
 #include <fstream>
 #include <iostream>
@@ -28,6 +29,40 @@
 namespace elastix
 {
 
+/**
+ * ********************* Constructor *********************
+ */
+
+ParameterObject
+::ParameterObject()
+{
+  this->m_ParameterMap = std::make_shared< ParameterMapVectorType >();
+}
+
+
+/**
+ * ********************* GetWritableParameterMap *********************
+ */
+
+ParameterObject::ParameterMapVectorType &
+ParameterObject
+::GetWritableParameterMap( void )
+{
+  // Maps set by SetSharedParameterMap() are copied on the first write, and
+  // owned maps when GetSharedParameterMap() handed them out
+  if( !this->m_ParameterMap )
+  {
+    this->m_ParameterMap = std::make_shared< ParameterMapVectorType >( *this->m_SharedParameterMap );
+    this->m_SharedParameterMap.reset();
+  }
+  else if( this->m_ParameterMap.use_count() > 1 )
+  {
+    this->m_ParameterMap = std::make_shared< ParameterMapVectorType >( *this->m_ParameterMap );
+  }
+  return *this->m_ParameterMap;
+}
+
+
 /**
  * ********************* SetParameterMap *********************
  */
@@ -48,7 +83,7 @@ void
 ParameterObject
 ::SetParameterMap( const unsigned int& index, const ParameterMapType & parameterMap )
 {
-  this->m_ParameterMap[ index ] = parameterMap;
+  this->GetWritableParameterMap()[ index ] = parameterMap;
 }
 
 
@@ -60,14 +95,67 @@ void
 ParameterObject
 ::SetParameterMap( const ParameterMapVectorType & parameterMap )
 {
-  if( this->m_ParameterMap != parameterMap )
+  if( this->GetParameterMap() != parameterMap )
   {
-    this->m_ParameterMap = parameterMap;
+    this->m_ParameterMap = std::make_shared< ParameterMapVectorType >( parameterMap );
+    this->m_SharedParameterMap.reset();
     this->Modified();
   }
 }
 
 
+/**
+ * ********************* SetParameterMap *********************
+ */
+
+void
+ParameterObject
+::SetParameterMap( ParameterMapVectorType && parameterMap )
+{
+  this->m_ParameterMap = std::make_shared< ParameterMapVectorType >( std::move( parameterMap ) );
+  this->m_SharedParameterMap.reset();
+  this->Modified();
+}
+
+
+/**
+ * ********************* SetSharedParameterMap *********************
+ */
+
+void
+ParameterObject
+::SetSharedParameterMap( const ParameterMapVectorConstPointer & parameterMap )
+{
+  if( parameterMap == nullptr )
+  {
+    itkExceptionMacro( "The shared parameter maps are null." );
+  }
+
+  if( this->GetSharedParameterMap() != parameterMap )
+  {
+    this->m_ParameterMap.reset();
+    this->m_SharedParameterMap = parameterMap;
+    this->Modified();
+  }
+}
+
+
+/**
+ * ********************* GetSharedParameterMap *********************
+ */
+
+ParameterObject::ParameterMapVectorConstPointer
+ParameterObject
+::GetSharedParameterMap( void ) const
+{
+  if( this->m_ParameterMap )
+  {
+    return this->m_ParameterMap;
+  }
+  return this->m_SharedParameterMap;
+}
+
+
 /**
  * ********************* AddParameterMap *********************
  */
@@ -76,7 +164,20 @@ void
 ParameterObject
 ::AddParameterMap( const ParameterMapType & parameterMap )
 {
-  this->m_ParameterMap.push_back( parameterMap );
+  this->GetWritableParameterMap().push_back( parameterMap );
+  this->Modified();
+}
+
+
+/**
+ * ********************* SetTransformParameters *********************
+ */
+
+void
+ParameterObject
+::SetTransformParameters( const TransformParametersVectorType & transformParameters )
+{
+  this->m_TransformParameters = transformParameters;
   this->Modified();
 }
 
@@ -89,7 +190,7 @@ const ParameterObject::ParameterMapType &
 ParameterObject
 ::GetParameterMap( const unsigned int& index ) const
 {
-  return this->m_ParameterMap[ index ];
+  return this->GetParameterMap()[ index ];
 }
 
 
@@ -101,7 +202,7 @@ void
 ParameterObject
 ::SetParameter( const unsigned int& index, const ParameterKeyType& key, const ParameterValueType& value )
 {
-  this->m_ParameterMap[ index ][ key ] = ParameterValueVectorType(1, value);
+  this->GetWritableParameterMap()[ index ][ key ] = ParameterValueVectorType(1, value);
 }
 
 
@@ -113,7 +214,7 @@ void
 ParameterObject
 ::SetParameter( const unsigned int& index, const ParameterKeyType& key, const ParameterValueVectorType& value )
 {
-  this->m_ParameterMap[ index ][ key ] = value;
+  this->GetWritableParameterMap()[ index ][ key ] = value;
 }
 
 
@@ -153,7 +254,14 @@ const ParameterObject::ParameterValueVectorType&
 ParameterObject
 ::GetParameter( const unsigned int& index, const ParameterKeyType& key )
 {
-  return this->m_ParameterMap[ index ][ key ];
+  // Only a missing key, which is inserted, modifies the maps
+  const ParameterMapType &        parameterMap = this->GetParameterMap()[ index ];
+  const ParameterMapConstIterator found        = parameterMap.find( key );
+  if( found != parameterMap.end() )
+  {
+    return found->second;
+  }
+  return this->GetWritableParameterMap()[ index ][ key ];
 }
 
 
@@ -165,7 +273,10 @@ void
 ParameterObject
 ::RemoveParameter( const unsigned int& index, const ParameterKeyType& key )
 {
-  this->m_ParameterMap[ index ].erase( key );
+  if( this->GetParameterMap()[ index ].count( key ) > 0 )
+  {
+    this->GetWritableParameterMap()[ index ].erase( key );
+  }
 }
 
 
@@ -211,7 +322,8 @@ ParameterObject
     itkExceptionMacro( "Parameter filename container is empty." );
   }
 
-  this->m_ParameterMap.clear();
+  this->m_ParameterMap = std::make_shared< ParameterMapVectorType >();
+  this->m_SharedParameterMap.reset();
 
   for( unsigned int i = 0; i < parameterFileNameVector.size(); ++i )
   {
@@ -236,7 +348,7 @@ ParameterObject
   ParameterFileParserPointer parameterFileParser = ParameterFileParserType::New();
   parameterFileParser->SetParameterFileName( parameterFileName );
   parameterFileParser->ReadParameterFile();
-  this->m_ParameterMap.push_back( parameterFileParser->GetParameterMap() );
+  this->GetWritableParameterMap().push_back( parameterFileParser->GetParameterMap() );
 }
 
 
@@ -250,12 +362,12 @@ ParameterObject
 ::WriteParameterFile( void )
 {
   ParameterFileNameVectorType parameterFileNameVector;
-  for( unsigned int i = 0; i < m_ParameterMap.size(); ++i )
+  for( unsigned int i = 0; i < this->GetNumberOfParameterMaps(); ++i )
   {
     parameterFileNameVector.push_back( "ParametersFile." + std::to_string( i ) + ".txt" );
   }
 
-  this->WriteParameterFile( this->m_ParameterMap, parameterFileNameVector );
+  this->WriteParameterFile( this->WriteTransformParameters( parameterFileNameVector ), parameterFileNameVector );
 }
 
 
@@ -332,20 +444,21 @@ void
 ParameterObject
 ::WriteParameterFile( const ParameterFileNameType & parameterFileName )
 {
-  if( this->m_ParameterMap.size() == 0 )
+  if( this->GetNumberOfParameterMaps() == 0 )
   {
     itkExceptionMacro( "Error writing parameter map to disk: The parameter object is empty." );
   }
 
-  if( this->m_ParameterMap.size() > 1 )
+  if( this->GetNumberOfParameterMaps() > 1 )
   {
     itkExceptionMacro(
       << "Error writing to disk: The number of parameter maps ("
-      << this->m_ParameterMap.size() << ")"
+      << this->GetNumberOfParameterMaps() << ")"
       << " does not match the number of provided filenames (1). Please provide a vector of filenames." );
   }
 
-  this->WriteParameterFile( this->m_ParameterMap[ 0 ], parameterFileName );
+  this->WriteParameterFile( this->WriteTransformParameters( ParameterFileNameVectorType( 1, parameterFileName ) )[ 0 ],
+    parameterFileName );
 }
 
 
@@ -391,7 +504,43 @@ void
 ParameterObject
 ::WriteParameterFile( const ParameterFileNameVectorType & parameterFileNameVector )
 {
-  this->WriteParameterFile( this->m_ParameterMap, parameterFileNameVector );
+  this->WriteParameterFile( this->WriteTransformParameters( parameterFileNameVector ), parameterFileNameVector );
+}
+
+
+/**
+ * ********************* WriteTransformParameters *********************
+ */
+
+ParameterObject::ParameterMapVectorType
+ParameterObject
+::WriteTransformParameters( const ParameterFileNameVectorType & parameterFileNameVector ) const
+{
+  ParameterMapVectorType parameterMapVector = this->GetParameterMap();
+  for( unsigned int i = 0; i < parameterMapVector.size(); ++i )
+  {
+    if( i >= this->m_TransformParameters.size() || i >= parameterFileNameVector.size()
+      || this->m_TransformParameters[ i ].GetSize() == 0
+      || parameterMapVector[ i ].find( "TransformParameters" ) != parameterMapVector[ i ].end() )
+    {
+      continue;
+    }
+
+    // Same format as the binary file of TransformBase::WriteToFile()
+    const TransformParametersType & transformParameters = this->m_TransformParameters[ i ];
+    const std::string               dataFileName        = parameterFileNameVector[ i ] + ".dat";
+    std::ofstream                   dataFile( dataFileName.c_str(), std::ios::out | std::ios::binary );
+    itk::ByteSwapper< double >::SwapWriteRangeFromSystemToLittleEndian(
+      const_cast< double * >( transformParameters.data_block() ), transformParameters.GetSize(), &dataFile );
+    if( !dataFile )
+    {
+      itkExceptionMacro( "Error writing transform parameters to " << dataFileName );
+    }
+
+    parameterMapVector[ i ][ "TransformParameters" ] = ParameterValueVectorType( 1, dataFileName );
+  }
+
+  return parameterMapVector;
 }
 
 
@@ -517,11 +666,12 @@ ParameterObject
 {
   Superclass::PrintSelf( os, indent );
 
-  for( unsigned int i = 0; i < this->m_ParameterMap.size(); ++i )
+  const ParameterMapVectorType & parameterMapVector = this->GetParameterMap();
+  for( unsigned int i = 0; i < parameterMapVector.size(); ++i )
   {
     os << "ParameterMap " << i << ": " << std::endl;
-    ParameterMapConstIterator parameterMapIterator    = this->m_ParameterMap[ i ].begin();
-    ParameterMapConstIterator parameterMapIteratorEnd = this->m_ParameterMap[ i ].end();
+    ParameterMapConstIterator parameterMapIterator    = parameterMapVector[ i ].begin();
+    ParameterMapConstIterator parameterMapIteratorEnd = parameterMapVector[ i ].end();
     while( parameterMapIterator != parameterMapIteratorEnd )
     {
       os << "  (" << parameterMapIterator->first;
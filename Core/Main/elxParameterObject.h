@@ -20,10 +20,13 @@
 
 #include "itkObjectFactory.h"
 #include "itkDataObject.h"
+#include "itkArray.h"
 #include "elxMacro.h"
 
 #include "itkParameterFileParser.h"
 
+#include <memory>
+
 namespace elastix
 {
 
@@ -55,16 +58,28 @@ public:
   typedef ParameterFileNameVectorType::const_iterator            ParameterFileNameVectorConstIterator;
   typedef itk::ParameterFileParser                               ParameterFileParserType;
   typedef ParameterFileParserType::Pointer                       ParameterFileParserPointer;
-
-  /* Set/Get/Add parameter map or vector of parameter maps. */
+  typedef itk::Array< double >                                   TransformParametersType;
+  typedef std::vector< TransformParametersType >                 TransformParametersVectorType;
+  typedef std::shared_ptr< ParameterMapVectorType >              ParameterMapVectorPointer;
+  typedef std::shared_ptr< const ParameterMapVectorType >        ParameterMapVectorConstPointer;
+
+  /* Set/Get/Add parameter map or vector of parameter maps.
+   * The parameter maps are copied on write: parameter objects may share them,
+   * and only a modification of shared maps copies them.
+   * Get/SetSharedParameterMap() pass the maps to another parameter object,
+   * filter or thread in O(1), and setting a moved vector does not copy it. */
   // TODO: Use itkSetMacro for ParameterMapVectorType
   void SetParameterMap( const ParameterMapType & parameterMap );
   void SetParameterMap( const unsigned int& index, const ParameterMapType & parameterMap );
   void SetParameterMap( const ParameterMapVectorType & parameterMap );
+  void SetParameterMap( ParameterMapVectorType && parameterMap );
   void AddParameterMap( const ParameterMapType & parameterMap );
   const ParameterMapType& GetParameterMap( const unsigned int& index ) const;
-  itkGetConstReferenceMacro( ParameterMap, ParameterMapVectorType );
-  unsigned int GetNumberOfParameterMaps() const { return this->m_ParameterMap.size(); }
+  const ParameterMapVectorType & GetParameterMap( void ) const
+  { return this->m_ParameterMap ? *this->m_ParameterMap : *this->m_SharedParameterMap; }
+  unsigned int GetNumberOfParameterMaps() const { return this->GetParameterMap().size(); }
+  void SetSharedParameterMap( const ParameterMapVectorConstPointer & parameterMap );
+  ParameterMapVectorConstPointer GetSharedParameterMap( void ) const;
 
   void SetParameter( const unsigned int& index, const ParameterKeyType& key, const ParameterValueType& value );
   void SetParameter( const unsigned int& index, const ParameterKeyType& key, const ParameterValueVectorType& value );
@@ -74,6 +89,16 @@ public:
   void RemoveParameter( const unsigned int& index, const ParameterKeyType& key );
   void RemoveParameter( const ParameterKeyType& key );
 
+  /* Set/Get the transform parameters of the parameter maps in binary form,
+   * one array per map, which is empty for a map with "TransformParameters"
+   * strings. ElastixFilter sets them for the maps with
+   * (UseBinaryFormatForTransformationParameters "true"), and TransformixFilter
+   * passes them to transformix, so the parameters are never converted to
+   * strings. WriteParameterFile() writes each array to a binary file, next to
+   * the parameter file, which transformix reads back. */
+  void SetTransformParameters( const TransformParametersVectorType & transformParameters );
+  itkGetConstReferenceMacro( TransformParameters, TransformParametersVectorType );
+
   /* Read/Write parameter file or multiple parameter files to/from disk. */
   void ReadParameterFile( const ParameterFileNameType & parameterFileName );
   void ReadParameterFile( const ParameterFileNameVectorType & parameterFileNameVector );
@@ -91,11 +116,27 @@ public:
 
 protected:
 
+  ParameterObject();
+  ~ParameterObject() override {}
+
   void PrintSelf( std::ostream & os, itk::Indent indent ) const override;
 
 private:
 
-  ParameterMapVectorType m_ParameterMap;
+  /* Writes the transform parameters in binary form to a file next to each
+   * parameter file, and returns the parameter maps that refer to them. */
+  ParameterMapVectorType WriteTransformParameters( const ParameterFileNameVectorType & parameterFileNameVector ) const;
+
+  /* Returns the parameter maps for modification, after copying them if they
+   * are shared with another owner, or were set by SetSharedParameterMap(). */
+  ParameterMapVectorType & GetWritableParameterMap( void );
+
+  /* The parameter maps are either owned, in m_ParameterMap, which may also
+   * be handed out by GetSharedParameterMap(), or set by SetSharedParameterMap()
+   * as m_SharedParameterMap, which is only read. Exactly one of them is set. */
+  ParameterMapVectorPointer      m_ParameterMap;
+  ParameterMapVectorConstPointer m_SharedParameterMap;
+  TransformParametersVectorType  m_TransformParameters;
 
 };
 
@@ -154,8 +154,9 @@ TransformixFilter< TMovingImage >
     }
   }
 
-  // Setup xout
-  if( elx::xoutSetup( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() ) )
+  // Setup the xout of this thread
+  elx::ThreadXout threadXout( logFileName.c_str(), this->GetLogToFile(), this->GetLogToConsole() );
+  if( threadXout.GetErrorCode() )
   {
     itkExceptionMacro( "Error while setting up xout" );
   }
@@ -198,6 +199,9 @@ TransformixFilter< TMovingImage >
     }
   }
 
+  // Pass the transform parameters that ElastixFilter gave in binary form
+  transformix->SetTransformParameters( transformParameterObject->GetTransformParameters() );
+
   // Run transformix
   unsigned int isError = 0;
   try
@@ -281,7 +285,7 @@ TransformixFilter< TMovingImage >
 
   // Get world coordinate system from the last map
   const unsigned int lastIndex = transformParameterObjectPtr->GetNumberOfParameterMaps() - 1;
-  const ParameterMapType transformParameterMap = transformParameterObjectPtr->GetParameterMap( lastIndex );
+  const ParameterMapType & transformParameterMap = transformParameterObjectPtr->GetParameterMap( lastIndex );
 
   ParameterMapType::const_iterator spacingMapIter = transformParameterMap.find( "Spacing" );
   if( spacingMapIter == transformParameterMap.end() )
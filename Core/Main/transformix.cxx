@@ -267,17 +267,31 @@ PrintHelp( void )
   /** Optional arguments. */
   std::cout << "Optional extra commands:\n";
   std::cout << "  -in       input image to deform\n";
+  std::cout << "  -in1, -in2, ... additional input images, that are deformed along with \"-in\",\n"
+            << "            evaluating the transform only once per voxel, and written to\n"
+            << "            result.1.mhd, result.2.mhd, etc.\n";
+  std::cout << "  -interp1, -interp2, ... interpolator of an additional input image: nearest,\n"
+            << "            linear (default), bspline, or bspline<order>, such as bspline1\n";
+  std::cout << "  -pt1, -pt2, ... pixel type of an additional result image, such as\n"
+            << "            \"unsigned char\" (default: ResultImagePixelType)\n";
   std::cout << "  -def      file containing input-image points; the point are transformed\n"
             << "            according to the specified transform-parameter file\n";
   std::cout << "            use \"-def all\" to transform all points from the input-image, which\n"
             << "            effectively generates a deformation field.\n";
+  std::cout << "            use \"-def inverse\" to generate the deformation field of the inverse\n"
+            << "            transform, on the same grid.\n";
   std::cout << "  -jac      use \"-jac all\" to generate an image with the determinant of the\n"
             << "            spatial Jacobian\n";
   std::cout << "  -jacmat   use \"-jacmat all\" to generate an image with the spatial Jacobian\n"
             << "            matrix at each voxel\n";
+  std::cout << "  -cache    directory in which the result image, deformation field and Jacobian\n"
+            << "            images are cached; outputs that were computed before for the same\n"
+            << "            transform (and input image) are copied from there\n";
   std::cout << "  -priority set the process priority to high, abovenormal, normal (default),\n"
             << "            belownormal, or idle (Windows only option)\n";
   std::cout << "  -threads  set the maximum number of threads of transformix\n";
+  std::cout << "  -gpu      comma separated list of OpenCL device IDs, such as \"-gpu 0,1\",\n"
+            << "            the OpenCL jobs are placed on these devices in turn\n";
   std::cout << "\nAt least one of the options \"-in\", \"-def\", \"-jac\", or \"-jacmat\" should be given.\n"
             << std::endl;
 
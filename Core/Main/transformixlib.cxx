@@ -173,7 +173,8 @@ TRANSFORMIX::TransformImage(
   argMap.insert( ArgumentMapEntryType( "-argv0", "transformix" ) );
 
   /** Setup xout. */
-  int returndummy2 = elx::xoutSetup( logFileName.c_str(), performLogging, performCout );
+  elx::ThreadXout threadXout( logFileName.c_str(), performLogging, performCout );
+  int             returndummy2 = threadXout.GetErrorCode();
   if( returndummy2 && performCout )
   {
     if( performCout )
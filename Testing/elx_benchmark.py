@@ -0,0 +1,271 @@
+import sys
+import os
+import os.path
+import json
+import shutil
+import subprocess
+import time
+from optparse import OptionParser
+
+#-------------------------------------------------------------------------------
+# The reference workloads: the fixed and moving image, the parameter files and
+# the initial transform, relative to the data directory (Testing/Data).
+workloads = [
+  { "name"       : "3DCT_lung.MI.euler.ASGD",
+    "fixed"      : "3DCT_lung_baseline.mha",
+    "moving"     : "3DCT_lung_followup.mha",
+    "parameters" : [ "parameters.3D.MI.euler.ASGD.001.txt" ] },
+  { "name"       : "3DCT_lung.NC.affine.ASGD",
+    "fixed"      : "3DCT_lung_baseline.mha",
+    "moving"     : "3DCT_lung_followup.mha",
+    "parameters" : [ "parameters.3D.NC.affine.ASGD.001.txt" ] },
+  { "name"       : "3DCT_lung.MI.bspline.ASGD",
+    "fixed"      : "3DCT_lung_baseline.mha",
+    "moving"     : "3DCT_lung_followup.mha",
+    "initial"    : "transformparameters.3DCT_lung.affine.txt",
+    "parameters" : [ "parameters.3D.MI.bspline.ASGD.001.txt" ] },
+]
+
+#-------------------------------------------------------------------------------
+# Read the header of a MetaImage file as a dictionary of strings.
+def readMetaImageHeader( fileName ) :
+
+  header = {};
+  f = open( fileName, 'rb' );
+  for line in f :
+    line = line.decode( 'latin-1' ).strip();
+    if line.find( '=' ) == -1 :
+      continue;
+    key, value = [ part.strip() for part in line.split( '=', 1 ) ];
+    header[ key ] = value;
+    if key == "ElementDataFile" :
+      break;
+  f.close();
+  return header;
+
+#-------------------------------------------------------------------------------
+# Resample an image to the given scale of its size, with the same physical
+# extent, by running transformix with an identity transform.
+def resampleImage( transformix, inputFile, scale, outputDir ) :
+
+  header = readMetaImageHeader( inputFile );
+  dim = int( header[ "NDims" ] );
+  size = [ int( s ) for s in header[ "DimSize" ].split() ];
+  spacing = [ float( s ) for s in header[ "ElementSpacing" ].split() ];
+  origin = [ float( s ) for s in header.get( "Offset", header.get( "Origin", "0 " * dim ) ).split() ];
+  direction = [ float( s ) for s in header.get( "TransformMatrix",
+    " ".join( [ "1" if i % ( dim + 1 ) == 0 else "0" for i in range( dim * dim ) ] ) ).split() ];
+
+  # The rows of the TransformMatrix are the axes of the image.
+  newSize = [ max( 1, int( round( size[ d ] * scale ) ) ) for d in range( dim ) ];
+  newSpacing = [ spacing[ d ] * size[ d ] / newSize[ d ] for d in range( dim ) ];
+  newOrigin = list( origin );
+  for axis in range( dim ) :
+    shift = 0.5 * ( newSpacing[ axis ] - spacing[ axis ] );
+    for d in range( dim ) :
+      newOrigin[ d ] += direction[ axis * dim + d ] * shift;
+
+  if not os.path.exists( outputDir ) :
+    os.makedirs( outputDir );
+  tpFileName = os.path.join( outputDir, "TransformParameters.resample.txt" );
+  tpFile = open( tpFileName, 'w' );
+  tpFile.write( '(Transform "TranslationTransform")\n' );
+  tpFile.write( '(NumberOfParameters ' + str( dim ) + ')\n' );
+  tpFile.write( '(TransformParameters' + ' 0' * dim + ')\n' );
+  tpFile.write( '(InitialTransformParametersFileName "NoInitialTransform")\n' );
+  tpFile.write( '(HowToCombineTransforms "Compose")\n' );
+  tpFile.write( '(FixedImageDimension ' + str( dim ) + ')\n' );
+  tpFile.write( '(MovingImageDimension ' + str( dim ) + ')\n' );
+  tpFile.write( '(FixedInternalImagePixelType "float")\n' );
+  tpFile.write( '(MovingInternalImagePixelType "float")\n' );
+  tpFile.write( '(Size ' + " ".join( [ str( s ) for s in newSize ] ) + ')\n' );
+  tpFile.write( '(Index' + ' 0' * dim + ')\n' );
+  tpFile.write( '(Spacing ' + " ".join( [ repr( s ) for s in newSpacing ] ) + ')\n' );
+  tpFile.write( '(Origin ' + " ".join( [ repr( o ) for o in newOrigin ] ) + ')\n' );
+  tpFile.write( '(Direction ' + " ".join( [ repr( d ) for d in direction ] ) + ')\n' );
+  tpFile.write( '(UseDirectionCosines "true")\n' );
+  tpFile.write( '(ResampleInterpolator "FinalBSplineInterpolator")\n' );
+  tpFile.write( '(FinalBSplineInterpolationOrder 1)\n' );
+  tpFile.write( '(Resampler "DefaultResampler")\n' );
+  tpFile.write( '(DefaultPixelValue 0)\n' );
+  tpFile.write( '(ResultImageFormat "mha")\n' );
+  tpFile.write( '(ResultImagePixelType "short")\n' );
+  tpFile.write( '(CompressResultImage "false")\n' );
+  tpFile.close();
+
+  log = open( os.path.join( outputDir, "resample.log" ), 'w' );
+  returnCode = subprocess.call( [ transformix, "-in", inputFile, "-tp", tpFileName,
+    "-out", outputDir ], stdout = log, stderr = subprocess.STDOUT );
+  log.close();
+  if returnCode != 0 :
+    raise RuntimeError( "transformix could not resample " + inputFile );
+  return os.path.join( outputDir, "result.mha" );
+
+#-------------------------------------------------------------------------------
+# Run a command, and return its exit code, wall time and peak resident memory
+# in bytes. The peak memory is only available on systems with os.wait4.
+def runAndMeasure( command, logFileName ) :
+
+  log = open( logFileName, 'w' );
+  start = time.time();
+  process = subprocess.Popen( command, stdout = log, stderr = subprocess.STDOUT );
+  peakMemory = None;
+  if hasattr( os, "wait4" ) :
+    pid, status, usage = os.wait4( process.pid, 0 );
+    wallTime = time.time() - start;
+    if os.WIFEXITED( status ) :
+      returnCode = os.WEXITSTATUS( status );
+    else :
+      returnCode = -os.WTERMSIG( status );
+    # ru_maxrss is in kilobytes on Linux, and in bytes on macOS
+    peakMemory = usage.ru_maxrss * ( 1 if sys.platform == "darwin" else 1024 );
+  else :
+    returnCode = process.wait();
+    wallTime = time.time() - start;
+  log.close();
+  return returnCode, wallTime, peakMemory;
+
+#-------------------------------------------------------------------------------
+# Sum the profiling categories of the ProfilingInfo.<ElastixLevel>.json files
+# in the output directory, over all elastix levels and resolutions.
+def readProfilingInfo( outputDir ) :
+
+  components = {};
+  for fileName in sorted( os.listdir( outputDir ) ) :
+    if not fileName.startswith( "ProfilingInfo." ) or not fileName.endswith( ".json" ) :
+      continue;
+    f = open( os.path.join( outputDir, fileName ) );
+    info = json.load( f );
+    f.close();
+    for resolution in info[ "resolutions" ] :
+      for name, category in resolution[ "categories" ].items() :
+        entry = components.setdefault( name, { "seconds" : 0.0, "count" : 0 } );
+        entry[ "seconds" ] += category[ "seconds" ];
+        entry[ "count" ] += category[ "count" ];
+  return components;
+
+#-------------------------------------------------------------------------------
+# the main function
+# python elx_benchmark.py -e <elastix> -t <transformix> -d <Testing/Data> -o <dir>
+# runs each workload at each image scale and thread count, and writes the
+# results to <dir>/benchmark.json
+def main() :
+  # usage, parse parameters
+  usage = "usage: %prog [options]";
+  parser = OptionParser( usage );
+  parser.add_option( "-e", "--elastix", dest="elastix", help="the elastix executable" );
+  parser.add_option( "-t", "--transformix", dest="transformix", help="the transformix executable" );
+  parser.add_option( "-d", "--data", dest="data", help="the directory of the test data" );
+  parser.add_option( "-o", "--output", dest="output", help="the output directory" );
+  parser.add_option( "--threads", dest="threads", default="1,2,4",
+    help="comma separated thread counts, default: 1,2,4" );
+  parser.add_option( "--scales", dest="scales", default="0.5,1",
+    help="comma separated scales of the image size, default: 0.5,1" );
+  parser.add_option( "--workloads", dest="workloads", default="",
+    help="comma separated names of the workloads to run, default: all" );
+  parser.add_option( "-r", "--repeat", dest="repeat", type="int", default=1,
+    help="the number of runs of each configuration; the fastest is reported" );
+  parser.add_option( "-j", "--json", dest="json", default="",
+    help="the result file, default: <output>/benchmark.json" );
+
+  (options, args) = parser.parse_args();
+  if not options.elastix or not options.transformix or not options.data or not options.output :
+    parser.print_help();
+    return 1;
+
+  threadCounts = [ int( t ) for t in options.threads.split( "," ) ];
+  scales = [ float( s ) for s in options.scales.split( "," ) ];
+  selected = [ w for w in options.workloads.split( "," ) if w != "" ];
+  for name in selected :
+    if name not in [ w[ "name" ] for w in workloads ] :
+      print( "ERROR: unknown workload '" + name + "'" );
+      return 1;
+
+  if not os.path.exists( options.output ) :
+    os.makedirs( options.output );
+
+  # The parameter files, with profiling enabled
+  def profilingParameterFile( fileName ) :
+    copyName = os.path.join( options.output, "profiling." + fileName );
+    if not os.path.exists( copyName ) :
+      shutil.copyfile( os.path.join( options.data, fileName ), copyName );
+      f = open( copyName, 'a' );
+      f.write( '\n(EnableProfiling "true")\n' );
+      f.close();
+    return copyName;
+
+  # The resampled images, one per image and scale
+  resampled = {};
+  def imageAtScale( fileName, scale ) :
+    if scale == 1.0 :
+      return os.path.join( options.data, fileName );
+    key = ( fileName, scale );
+    if key not in resampled :
+      resampleDir = os.path.join( options.output, "images", fileName + ".scale" + str( scale ) );
+      resampled[ key ] = resampleImage( options.transformix,
+        os.path.join( options.data, fileName ), scale, resampleDir );
+    return resampled[ key ];
+
+  results = [];
+  failed = False;
+  for workload in workloads :
+    if selected and workload[ "name" ] not in selected :
+      continue;
+    for scale in scales :
+      fixedImage = imageAtScale( workload[ "fixed" ], scale );
+      movingImage = imageAtScale( workload[ "moving" ], scale );
+      runs = [];
+      for threads in threadCounts :
+        outputDir = os.path.join( options.output, workload[ "name" ],
+          "scale" + str( scale ) + ".threads" + str( threads ) );
+        if not os.path.exists( outputDir ) :
+          os.makedirs( outputDir );
+        command = [ options.elastix, "-f", fixedImage, "-m", movingImage,
+          "-threads", str( threads ), "-out", outputDir ];
+        if "initial" in workload :
+          command += [ "-t0", os.path.join( options.data, workload[ "initial" ] ) ];
+        for parameterFile in workload[ "parameters" ] :
+          command += [ "-p", profilingParameterFile( parameterFile ) ];
+
+        best = None;
+        for r in range( options.repeat ) :
+          returnCode, wallTime, peakMemory = runAndMeasure( command,
+            os.path.join( outputDir, "benchmark.log" ) );
+          if returnCode != 0 :
+            print( "ERROR: " + workload[ "name" ] + " failed with exit code " + str( returnCode )
+              + ", see " + os.path.join( outputDir, "elastix.log" ) );
+            failed = True;
+            break;
+          if best is None or wallTime < best[ "wallTimeSeconds" ] :
+            best = { "threads" : threads, "wallTimeSeconds" : wallTime,
+              "peakResidentMemoryBytes" : peakMemory,
+              "components" : readProfilingInfo( outputDir ) };
+        if best is None :
+          continue;
+        print( workload[ "name" ] + " scale " + str( scale ) + " threads " + str( threads )
+          + ": " + ( "%.3f" % best[ "wallTimeSeconds" ] ) + " s" );
+        runs.append( best );
+
+      # The scaling efficiency relative to the run with the fewest threads
+      if runs :
+        reference = min( runs, key = lambda run : run[ "threads" ] );
+        for run in runs :
+          run[ "scalingEfficiency" ] = ( reference[ "wallTimeSeconds" ] * reference[ "threads" ]
+            / ( run[ "wallTimeSeconds" ] * run[ "threads" ] ) );
+      results.append( { "workload" : workload[ "name" ], "scale" : scale, "runs" : runs } );
+
+  jsonFileName = options.json if options.json else os.path.join( options.output, "benchmark.json" );
+  f = open( jsonFileName, 'w' );
+  json.dump( { "benchmarks" : results }, f, indent = 2, sort_keys = True );
+  f.write( "\n" );
+  f.close();
+  print( "The results are written to '" + jsonFileName + "'" );
+
+  # Exit
+  if failed :
+    return 1;
+  return 0
+
+#-------------------------------------------------------------------------------
+if __name__ == '__main__':
+    sys.exit(main())
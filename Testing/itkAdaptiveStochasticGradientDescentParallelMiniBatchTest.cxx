@@ -0,0 +1,324 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkAdaptiveStochasticGradientDescentOptimizer.h"
+
+#include "itkMersenneTwisterRandomVariateGenerator.h"
+#include "itkPersistentThreadPool.h"
+#include "itkSingleValuedCostFunction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+//------------------------------------------------------------------------------
+// Definition of the types used by the test
+typedef itk::AdaptiveStochasticGradientDescentOptimizer OptimizerType;
+typedef OptimizerType::ParametersType                   ParametersType;
+typedef OptimizerType::DerivativeType                   DerivativeType;
+typedef OptimizerType::MeasureType                      MeasureType;
+typedef OptimizerType::NonZeroIndicesType               NonZeroIndicesType;
+
+//------------------------------------------------------------------------------
+// A quadratic cost function that is the mean of the terms of its samples:
+// sample i has the weight w_i = 1 + i % 3 and the term
+// 0.5 w_i ( x_p - t_p )^2 of parameter p = i % P. All samples of a parameter
+// have the same target t_p, so that the minimum of any mini-batch is at the
+// targets of the parameters it contains.
+class QuadraticCostFunction : public itk::SingleValuedCostFunction
+{
+public:
+
+  typedef QuadraticCostFunction         Self;
+  typedef itk::SingleValuedCostFunction Superclass;
+  typedef itk::SmartPointer< Self >     Pointer;
+
+  itkNewMacro( Self );
+
+  void SetNumberOfParameters( const unsigned int numberOfParameters )
+  {
+    this->m_Targets.SetSize( numberOfParameters );
+    for( unsigned int p = 0; p < numberOfParameters; ++p )
+    {
+      this->m_Targets[ p ] = std::sin( 0.7 * p ) + 0.5;
+    }
+  }
+
+
+  unsigned int GetNumberOfParameters( void ) const override
+  {
+    return this->m_Targets.GetSize();
+  }
+
+
+  itkSetMacro( NumberOfSamples, itk::SizeValueType );
+  itkGetConstMacro( NumberOfSamples, itk::SizeValueType );
+
+  const ParametersType & GetTargets( void ) const
+  {
+    return this->m_Targets;
+  }
+
+
+  MeasureType GetValue( const ParametersType & parameters ) const override
+  {
+    MeasureType    value = 0.0;
+    DerivativeType derivative;
+    this->GetValueAndDerivative( parameters, value, derivative );
+    return value;
+  }
+
+
+  void GetDerivative( const ParametersType & parameters, DerivativeType & derivative ) const override
+  {
+    MeasureType value = 0.0;
+    this->GetValueAndDerivative( parameters, value, derivative );
+  }
+
+
+  void GetValueAndDerivative( const ParametersType & parameters,
+    MeasureType & value, DerivativeType & derivative ) const override
+  {
+    const unsigned int numberOfParameters = this->GetNumberOfParameters();
+    derivative.SetSize( numberOfParameters );
+    derivative.Fill( 0.0 );
+    value = 0.0;
+    for( itk::SizeValueType i = 0; i < this->m_NumberOfSamples; ++i )
+    {
+      this->AddSample( parameters, i, value, derivative );
+    }
+    value /= static_cast< double >( this->m_NumberOfSamples );
+    derivative /= static_cast< double >( this->m_NumberOfSamples );
+  }
+
+
+  /** The mini-batch functions of the optimizer. */
+  itk::SizeValueType InitializeParallelMiniBatches( const ParametersType & parameters )
+  {
+    this->m_MiniBatchParameters = &parameters;
+    return this->m_NumberOfSamples;
+  }
+
+
+  void GetValueAndSparseDerivativeOfSamples( const itk::SizeValueType * sampleIds,
+    const itk::SizeValueType numberOfSampleIds, MeasureType & value,
+    DerivativeType & derivative, NonZeroIndicesType & indices ) const
+  {
+    const unsigned int numberOfParameters = this->GetNumberOfParameters();
+    value = 0.0;
+    indices.clear();
+    for( itk::SizeValueType s = 0; s < numberOfSampleIds; ++s )
+    {
+      this->AddSample( *this->m_MiniBatchParameters, sampleIds[ s ], value, derivative );
+      indices.push_back( sampleIds[ s ] % numberOfParameters );
+    }
+    std::sort( indices.begin(), indices.end() );
+    indices.erase( std::unique( indices.begin(), indices.end() ), indices.end() );
+
+    value /= static_cast< double >( numberOfSampleIds );
+    for( const unsigned long j : indices )
+    {
+      derivative[ j ] /= static_cast< double >( numberOfSampleIds );
+    }
+  }
+
+
+protected:
+
+  QuadraticCostFunction()
+  {
+    this->m_NumberOfSamples     = 0;
+    this->m_MiniBatchParameters = nullptr;
+  }
+
+
+  ~QuadraticCostFunction() override {}
+
+private:
+
+  /** Add the term of sample i to the value and the derivative. */
+  void AddSample( const ParametersType & parameters, const itk::SizeValueType i,
+    MeasureType & value, DerivativeType & derivative ) const
+  {
+    const unsigned int p        = static_cast< unsigned int >( i % this->GetNumberOfParameters() );
+    const double       weight   = 1.0 + static_cast< double >( i % 3 );
+    const double       residual = parameters[ p ] - this->m_Targets[ p ];
+    value           += 0.5 * weight * residual * residual;
+    derivative[ p ] += weight * residual;
+  }
+
+
+  ParametersType         m_Targets;
+  itk::SizeValueType     m_NumberOfSamples;
+  const ParametersType * m_MiniBatchParameters;
+
+};
+
+//------------------------------------------------------------------------------
+// The settings of one optimizer configuration.
+struct OptimizerSettings
+{
+  unsigned long      m_NumberOfIterations;
+  double             m_Param_a;
+  double             m_Param_A;
+  double             m_Param_alpha;
+  bool               m_UseParallelMiniBatches;
+  itk::SizeValueType m_MiniBatchSize;
+  itk::ThreadIdType  m_NumberOfMiniBatchWorkUnits;
+};
+
+//------------------------------------------------------------------------------
+// Run the optimizer from zero with the given settings, and return the final
+// position. The generator of the mini-batches is seeded first.
+ParametersType
+RunOptimizer( QuadraticCostFunction * costFunction, const OptimizerSettings & settings )
+{
+  itk::Statistics::MersenneTwisterRandomVariateGenerator::GetInstance()->SetSeed( 1234 );
+
+  ParametersType initialPosition( costFunction->GetNumberOfParameters() );
+  initialPosition.Fill( 0.0 );
+
+  OptimizerType::Pointer optimizer = OptimizerType::New();
+  optimizer->SetCostFunction( costFunction );
+  optimizer->SetInitialPosition( initialPosition );
+  optimizer->SetNumberOfIterations( settings.m_NumberOfIterations );
+  optimizer->SetParam_a( settings.m_Param_a );
+  optimizer->SetParam_A( settings.m_Param_A );
+  optimizer->SetParam_alpha( settings.m_Param_alpha );
+  optimizer->SetUseAdaptiveStepSizes( false );
+  optimizer->SetMiniBatchSize( settings.m_MiniBatchSize );
+  optimizer->SetNumberOfMiniBatchWorkUnits( settings.m_NumberOfMiniBatchWorkUnits );
+  optimizer->SetUseParallelMiniBatches( settings.m_UseParallelMiniBatches );
+  optimizer->SetMiniBatchInitializeFunction(
+    [ costFunction ]( const ParametersType & parameters )
+    {
+      return costFunction->InitializeParallelMiniBatches( parameters );
+    } );
+  optimizer->SetMiniBatchGradientFunction(
+    [ costFunction ]( const itk::SizeValueType * sampleIds, const itk::SizeValueType numberOfSampleIds,
+    MeasureType & value, DerivativeType & derivative, NonZeroIndicesType & indices )
+    {
+      costFunction->GetValueAndSparseDerivativeOfSamples( sampleIds, numberOfSampleIds, value, derivative, indices );
+    } );
+  optimizer->StartOptimization();
+
+  return optimizer->GetCurrentPosition();
+
+} // end RunOptimizer()
+
+//------------------------------------------------------------------------------
+// Compare two positions exactly, or up to the given tolerance.
+bool
+ComparePositions( const ParametersType & position, const ParametersType & reference,
+  const double tolerance, const std::string & description )
+{
+  double maxDifference = 0.0;
+  for( unsigned int j = 0; j < reference.GetSize(); ++j )
+  {
+    maxDifference = std::max( maxDifference, std::abs( position[ j ] - reference[ j ] ) );
+  }
+  if( !( maxDifference <= tolerance ) )
+  {
+    std::cerr << "ERROR: " << description << ":\n"
+              << "  the maximum difference is " << maxDifference
+              << ", with a tolerance of " << tolerance << std::endl;
+    return false;
+  }
+  return true;
+
+} // end ComparePositions()
+
+//------------------------------------------------------------------------------
+
+int
+main( void )
+{
+  QuadraticCostFunction::Pointer costFunction = QuadraticCostFunction::New();
+  costFunction->SetNumberOfParameters( 40 );
+  costFunction->SetNumberOfSamples( 4000 );
+  const unsigned int numberOfParameters = costFunction->GetNumberOfParameters();
+
+  bool success = true;
+  try
+  {
+    /** The iterations without mini-batches and adaptive step sizes:
+     * x_{k+1} = x_k - a / ( A + t_k + 1 )^alpha g( x_k ), t_{k+1} = t_k + E_0.
+     */
+    const OptimizerSettings fullBatch = { 50, 2.0, 10.0, 0.602, false, 100, 4 };
+    ParametersType          expected( numberOfParameters );
+    expected.Fill( 0.0 );
+    const double   E_0  = ( 1.0 + -0.8 ) / 2.0;
+    double         time = 0.0;
+    DerivativeType gradient;
+    for( unsigned long k = 0; k < fullBatch.m_NumberOfIterations; ++k )
+    {
+      MeasureType value = 0.0;
+      costFunction->GetValueAndDerivative( expected, value, gradient );
+      const double learningRate = fullBatch.m_Param_a
+        / std::pow( fullBatch.m_Param_A + time + 1.0, fullBatch.m_Param_alpha );
+      for( unsigned int j = 0; j < numberOfParameters; ++j )
+      {
+        expected[ j ] = expected[ j ] - learningRate * gradient[ j ];
+      }
+      time += E_0;
+    }
+
+    /** Without the parallel mini-batches, their settings are ignored. */
+    success &= ComparePositions( RunOptimizer( costFunction, fullBatch ), expected, 0.0,
+      "the optimizer differs from the plain iterations" );
+    for( const itk::ThreadIdType workUnits : { 1, 2, 3, 4, 7 } )
+    {
+      OptimizerSettings settings = fullBatch;
+      settings.m_MiniBatchSize              = 37;
+      settings.m_NumberOfMiniBatchWorkUnits = workUnits;
+      success &= ComparePositions( RunOptimizer( costFunction, settings ), expected, 0.0,
+        "the optimizer depends on the mini-batch settings" );
+    }
+
+    /** The parallel mini-batches converge to the minimum, at the targets, and
+     * do not depend on the scheduling of the work units.
+     */
+    itk::PersistentThreadPool::Pointer pool           = itk::PersistentThreadPool::GetInstance();
+    const itk::ThreadIdType            maximumThreads = pool->GetMaximumNumberOfThreads();
+    for( const itk::ThreadIdType workUnits : { 1, 2, 3, 4, 7 } )
+    {
+      const OptimizerSettings miniBatches = { 300, 8.0, 1.0, 0.0, true, 100, workUnits };
+      const ParametersType    position    = RunOptimizer( costFunction, miniBatches );
+      success &= ComparePositions( position, costFunction->GetTargets(), 1e-6,
+        "the mini-batches of " + std::to_string( workUnits ) + " work units do not converge" );
+
+      pool->SetMaximumNumberOfThreads( 1 );
+      success &= ComparePositions( RunOptimizer( costFunction, miniBatches ), position, 0.0,
+        "the mini-batches of " + std::to_string( workUnits ) + " work units depend on the threads" );
+      pool->SetMaximumNumberOfThreads( maximumThreads );
+    }
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    std::cerr << "ERROR: the optimizer could not be run:\n" << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( !success )
+  {
+    return EXIT_FAILURE;
+  }
+  std::cout << "The parallel mini-batches converge, and the optimizer without them is unchanged." << std::endl;
+  return EXIT_SUCCESS;
+
+} // end main()
@@ -0,0 +1,302 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkAdvancedLocalNormalizedCorrelationImageToImageMetric.h"
+
+#include "itkMetricTestHelper.h"
+
+#include "itkBSplineInterpolateImageFunction.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+//------------------------------------------------------------------------------
+// Definition of the types used by the test
+typedef itk::Image< double, Dimension >        RealImageType;
+typedef itk::Image< unsigned char, Dimension > MaskImageType;
+
+typedef itk::BSplineInterpolateImageFunction< ImageType, ScalarType, double >             BSplineInterpolatorType;
+typedef itk::ImageFullSampler< ImageType >                                                ImageSamplerType;
+typedef itk::AdvancedLocalNormalizedCorrelationImageToImageMetric< ImageType, ImageType > MetricType;
+typedef MetricType::InterpolatorType                                                      InterpolatorType;
+
+//------------------------------------------------------------------------------
+// Create a metric for one configuration.
+MetricType::Pointer
+CreateMetric( const ImageType * fixedImage, const ImageType * movingImage,
+  const ImageType::RegionType & fixedImageRegion, CombinationTransformType * transform,
+  InterpolatorType * interpolator, const MetricType::RadiusType & radius,
+  const bool useMultiThread, const unsigned int threads, const bool useSparseDerivativeAccumulation )
+{
+  MetricType::Pointer metric = MetricType::New();
+  metric->SetFixedImage( fixedImage );
+  metric->SetMovingImage( movingImage );
+  metric->SetFixedImageRegion( fixedImageRegion );
+  metric->SetTransform( transform );
+  metric->SetInterpolator( interpolator );
+  metric->SetImageSampler( ImageSamplerType::New() );
+  metric->SetRadius( radius );
+  metric->SetUseSparseDerivativeAccumulation( useSparseDerivativeAccumulation );
+  metric->SetNumberOfWorkUnits( threads );
+  metric->SetUseMultiThread( useMultiThread );
+  metric->Initialize();
+  return metric;
+} // end CreateMetric()
+
+
+//------------------------------------------------------------------------------
+// Compute the local normalized correlation by brute force: for each voxel of
+// the fixed image region that maps inside the moving image, the centered sums
+// are computed over the voxels of its window that map inside the moving image.
+double
+ComputeBruteForceValue( const ImageType * fixedImage, const ImageType * movingImage,
+  const ImageType::RegionType & fixedImageRegion, const CombinationTransformType * transform,
+  const MetricType::RadiusType & radius )
+{
+  LinearInterpolatorType::Pointer interpolator = LinearInterpolatorType::New();
+  interpolator->SetInputImage( movingImage );
+
+  /** Resample the moving image at the voxels of the region. */
+  RealImageType::Pointer movingValues = RealImageType::New();
+  MaskImageType::Pointer validVoxels  = MaskImageType::New();
+  movingValues->CopyInformation( fixedImage );
+  validVoxels->CopyInformation( fixedImage );
+  movingValues->SetRegions( fixedImageRegion );
+  validVoxels->SetRegions( fixedImageRegion );
+  movingValues->Allocate();
+  validVoxels->Allocate();
+
+  itk::ImageRegionConstIteratorWithIndex< ImageType > it( fixedImage, fixedImageRegion );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    ImageType::PointType fixedPoint;
+    fixedImage->TransformIndexToPhysicalPoint( it.GetIndex(), fixedPoint );
+    const ImageType::PointType mappedPoint = transform->TransformPoint( fixedPoint );
+
+    itk::ContinuousIndex< ScalarType, Dimension > cindex;
+    movingImage->TransformPhysicalPointToContinuousIndex( mappedPoint, cindex );
+    const bool valid = interpolator->IsInsideBuffer( cindex );
+    validVoxels->SetPixel( it.GetIndex(), valid ? 1 : 0 );
+    movingValues->SetPixel( it.GetIndex(), valid ? interpolator->EvaluateAtContinuousIndex( cindex ) : 0.0 );
+  }
+
+  /** Sum the local correlations over the valid voxels. */
+  double        sum                   = 0.0;
+  unsigned long numberOfPixelsCounted = 0;
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const ImageType::IndexType center = it.GetIndex();
+    if( !validVoxels->GetPixel( center ) )
+    {
+      continue;
+    }
+    ++numberOfPixelsCounted;
+
+    /** The window around the voxel, clipped by the region. */
+    ImageType::IndexType windowIndex;
+    ImageType::SizeType  windowSize;
+    for( unsigned int d = 0; d < Dimension; ++d )
+    {
+      const long first = std::max< long >( center[ d ] - static_cast< long >( radius[ d ] ),
+        fixedImageRegion.GetIndex()[ d ] );
+      const long last = std::min< long >( center[ d ] + static_cast< long >( radius[ d ] ),
+        fixedImageRegion.GetIndex()[ d ] + static_cast< long >( fixedImageRegion.GetSize()[ d ] ) - 1 );
+      windowIndex[ d ] = first;
+      windowSize[ d ]  = static_cast< ImageType::SizeValueType >( last - first + 1 );
+    }
+    const ImageType::RegionType window( windowIndex, windowSize );
+
+    /** The means of the valid voxels of the window. */
+    double n = 0.0, fixedMean = 0.0, movingMean = 0.0;
+    itk::ImageRegionConstIteratorWithIndex< ImageType > wit( fixedImage, window );
+    for( wit.GoToBegin(); !wit.IsAtEnd(); ++wit )
+    {
+      if( validVoxels->GetPixel( wit.GetIndex() ) )
+      {
+        n          += 1.0;
+        fixedMean  += wit.Get();
+        movingMean += movingValues->GetPixel( wit.GetIndex() );
+      }
+    }
+    fixedMean  /= n;
+    movingMean /= n;
+
+    /** The centered sums of the valid voxels of the window. */
+    double sff = 0.0, smm = 0.0, sfm = 0.0;
+    for( wit.GoToBegin(); !wit.IsAtEnd(); ++wit )
+    {
+      if( validVoxels->GetPixel( wit.GetIndex() ) )
+      {
+        const double f = wit.Get() - fixedMean;
+        const double m = movingValues->GetPixel( wit.GetIndex() ) - movingMean;
+        sff += f * f;
+        smm += m * m;
+        sfm += f * m;
+      }
+    }
+    if( sff * smm >= 1e-14 )
+    {
+      sum += sfm * sfm / ( sff * smm );
+    }
+  }
+
+  return -sum / static_cast< double >( numberOfPixelsCounted );
+} // end ComputeBruteForceValue()
+
+
+//------------------------------------------------------------------------------
+// Check that the value of the metric equals the brute force computation, for
+// a transform that maps part of the border voxels outside the moving image.
+bool
+TestBruteForceValue( const ImageType * fixedImage, const ImageType * movingImage,
+  const MetricType::RadiusType & radius )
+{
+  BSplineTransformType::ParametersType    parameters;
+  const CombinationTransformType::Pointer transform = CreateTransform( fixedImage, 6, parameters, 4.0 );
+  const ImageType::RegionType             region    = fixedImage->GetBufferedRegion();
+  const double                            expected  = ComputeBruteForceValue(
+    fixedImage, movingImage, region, transform, radius );
+
+  bool passed = true;
+  for( unsigned int multiThread = 0; multiThread < 2; ++multiThread )
+  {
+    LinearInterpolatorType::Pointer interpolator = LinearInterpolatorType::New();
+    MetricType::Pointer             metric       = CreateMetric( fixedImage, movingImage, region,
+      transform, interpolator, radius, multiThread == 1, 3, false );
+
+    MetricType::DerivativeType derivative;
+    MetricType::MeasureType    valueOfDerivative = 0.0;
+    const double               value             = metric->GetValue( parameters );
+    metric->GetValueAndDerivative( parameters, valueOfDerivative, derivative );
+
+    const double tolerance = 1e-8 * std::abs( expected );
+    if( !( std::abs( value - expected ) <= tolerance ) || !( std::abs( valueOfDerivative - expected ) <= tolerance ) )
+    {
+      std::cerr << "ERROR: the " << ( multiThread == 1 ? "multi" : "single" ) << "-threaded value "
+                << value << " and " << valueOfDerivative << " differ from the brute force value "
+                << expected << " for radius " << radius << std::endl;
+      passed = false;
+    }
+  }
+  return passed;
+} // end TestBruteForceValue()
+
+
+//------------------------------------------------------------------------------
+// Check that the derivative of the metric equals the central finite
+// differences of its value. The fixed image region keeps a margin, so that
+// all voxels map inside the moving image for the perturbed parameters too,
+// and the moving image is interpolated by a cubic B-spline, so that the value
+// is smooth in the parameters.
+bool
+TestFiniteDifferenceDerivative( const ImageType * fixedImage, const ImageType * movingImage,
+  const MetricType::RadiusType & radius )
+{
+  BSplineTransformType::ParametersType    parameters;
+  const CombinationTransformType::Pointer transform = CreateTransform( fixedImage, 6, parameters, 1.0 );
+
+  ImageType::RegionType region = fixedImage->GetBufferedRegion();
+  region.ShrinkByRadius( 2 );
+
+  bool passed = true;
+  for( unsigned int configuration = 0; configuration < 3; ++configuration )
+  {
+    const bool                       useMultiThread = configuration > 0;
+    const bool                       useSparse      = configuration == 2;
+    BSplineInterpolatorType::Pointer interpolator   = BSplineInterpolatorType::New();
+    MetricType::Pointer              metric         = CreateMetric( fixedImage, movingImage, region,
+      transform, interpolator, radius, useMultiThread, 4, useSparse );
+
+    MetricType::DerivativeType derivative;
+    MetricType::MeasureType    value = 0.0;
+    metric->GetValueAndDerivative( parameters, value, derivative );
+
+    double maximumDerivative = 0.0;
+    for( unsigned int i = 0; i < derivative.GetSize(); ++i )
+    {
+      maximumDerivative = std::max( maximumDerivative, std::abs( derivative[ i ] ) );
+    }
+
+    /** Compare with the central differences. */
+    const double                         delta = 1e-3;
+    double                               maximumDifference = 0.0;
+    BSplineTransformType::ParametersType perturbed = parameters;
+    for( unsigned int i = 0; i < parameters.GetSize(); ++i )
+    {
+      perturbed[ i ] = parameters[ i ] + delta;
+      const double valuePlus = metric->GetValue( perturbed );
+      perturbed[ i ] = parameters[ i ] - delta;
+      const double valueMinus = metric->GetValue( perturbed );
+      perturbed[ i ] = parameters[ i ];
+
+      const double finiteDifference = ( valuePlus - valueMinus ) / ( 2.0 * delta );
+      maximumDifference = std::max( maximumDifference, std::abs( finiteDifference - derivative[ i ] ) );
+    }
+
+    if( !( maximumDerivative > 0.0 ) || !( maximumDifference <= 1e-4 * maximumDerivative ) )
+    {
+      std::cerr << "ERROR: the " << ( useSparse ? "sparse " : "" ) << ( useMultiThread ? "multi" : "single" )
+                << "-threaded derivative differs from the finite differences by " << maximumDifference
+                << ", maximum derivative " << maximumDerivative << ", for radius " << radius << std::endl;
+      passed = false;
+    }
+  }
+  return passed;
+} // end TestFiniteDifferenceDerivative()
+
+
+//------------------------------------------------------------------------------
+// This test checks the AdvancedLocalNormalizedCorrelationImageToImageMetric on
+// a small image. Its value must equal a brute force computation of the local
+// normalized correlation, in which only the voxels that map inside the moving
+// image count in the windows. Its derivative, which includes the contribution
+// of each moving image value to all windows that contain its voxel, must equal
+// the finite differences of the value. Both are checked for an isotropic and
+// an anisotropic window.
+int
+main( void )
+{
+  const ImageType::Pointer fixedImage  = CreateImage( 12, 0.0, 4.0, 8.0 );
+  const ImageType::Pointer movingImage = CreateImage( 12, 3.0, 4.0, 8.0 );
+
+  MetricType::RadiusType radii[ 2 ];
+  radii[ 0 ].Fill( 2 );
+  radii[ 1 ][ 0 ] = 1;
+  radii[ 1 ][ 1 ] = 2;
+  radii[ 1 ][ 2 ] = 3;
+
+  bool passed = true;
+  try
+  {
+    for( unsigned int r = 0; r < 2; ++r )
+    {
+      passed = TestBruteForceValue( fixedImage, movingImage, radii[ r ] ) && passed;
+      passed = TestFiniteDifferenceDerivative( fixedImage, movingImage, radii[ r ] ) && passed;
+    }
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    std::cerr << "ERROR: the metric could not be evaluated:\n" << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( !passed )
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "The local normalized correlation and its derivative are correct." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -25,6 +25,7 @@
 
 #include <fstream>
 #include <iomanip>
+#include <vector>
 
 //-------------------------------------------------------------------------------------
 
@@ -224,6 +225,23 @@ main( int argc, char * argv[] )
   }
   timeCollector.Stop( "JacobianGradient recursive new" );
 
+  /** Time the recursive batch way, processing a batch of points per call. */
+  const unsigned int                        batchSize = 64;
+  std::vector< InputPointType >             batchPoints( batchSize, inputPoint );
+  std::vector< MovingImageGradientType >    batchGradients( batchSize, movingImageGradient );
+  std::vector< DerivativeType >             batchImageJacobians( batchSize, DerivativeType( nnzji ) );
+  std::vector< NonZeroJacobianIndicesType > batchNzjis( batchSize, NonZeroJacobianIndicesType( nnzji ) );
+  timeCollector.Start( "JacobianGradient recursive batch" );
+  for( unsigned int i = 0; i < N; i += batchSize )
+  {
+    recursiveTransform->EvaluateJacobianWithImageGradientProductBatch(
+      batchPoints.data(), batchGradients.data(),
+      batchImageJacobians.data(), batchNzjis.data(), batchSize );
+
+    sum += batchImageJacobians[ 0 ]( 0 ); // just to avoid compiler to optimize away
+  }
+  timeCollector.Stop( "JacobianGradient recursive batch" );
+
   /** Report timings. */
   timeCollector.Report();
 
@@ -252,6 +270,14 @@ main( int argc, char * argv[] )
     return EXIT_FAILURE;
   }
 
+  double batchDiffNorm = ( imageJacobian_new - batchImageJacobians[ batchSize - 1 ] ).magnitude();
+  std::cerr << "Recursive B-spline batch MSD with previous: " << batchDiffNorm << std::endl;
+  if( batchDiffNorm > 1e-10 || batchNzjis[ batchSize - 1 ] != nzji )
+  {
+    std::cerr << "ERROR: Recursive B-spline EvaluateJacobianWithImageGradientProductBatch() returning incorrect result." << std::endl;
+    return EXIT_FAILURE;
+  }
+
   /** Return a value. */
   return EXIT_SUCCESS;
 
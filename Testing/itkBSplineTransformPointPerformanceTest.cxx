@@ -16,6 +16,7 @@
  *
  *=========================================================================*/
 #include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkRecursiveBSplineTransform.h"
 
 #include "itkImageRegionIterator.h"
 
@@ -24,6 +25,7 @@
 
 #include <fstream>
 #include <iomanip>
+#include <vector>
 
 //-------------------------------------------------------------------------------------
 // Create a class that inherits from the B-spline transform,
@@ -197,6 +199,8 @@ main( int argc, char * argv[] )
   /** Typedefs. */
   typedef itk::BSplineTransform_TEST<
     CoordinateRepresentationType, Dimension, SplineOrder >    TransformType;
+  typedef itk::RecursiveBSplineTransform<
+    CoordinateRepresentationType, Dimension, SplineOrder >    RecursiveTransformType;
 
   typedef TransformType::InputPointType  InputPointType;
   typedef TransformType::OutputPointType OutputPointType;
@@ -243,6 +247,12 @@ main( int argc, char * argv[] )
   transform->SetGridRegion( gridRegion );
   transform->SetGridDirection( gridDirection );
 
+  RecursiveTransformType::Pointer recursiveTransform = RecursiveTransformType::New();
+  recursiveTransform->SetGridOrigin( gridOrigin );
+  recursiveTransform->SetGridSpacing( gridSpacing );
+  recursiveTransform->SetGridRegion( gridRegion );
+  recursiveTransform->SetGridDirection( gridDirection );
+
   /** Now read the parameters as defined in the file par.txt. */
   ParametersType parameters( transform->GetNumberOfParameters() );
   std::ifstream  input( argv[ 1 ] );
@@ -260,11 +270,12 @@ main( int argc, char * argv[] )
     return 1;
   }
   transform->SetParameters( parameters );
+  recursiveTransform->SetParameters( parameters );
 
   /** Declare variables. */
   InputPointType  inputPoint; inputPoint.Fill( 4.1 );
   OutputPointType outputPoint; double sum = 0.0;
-  itk::TimeProbe  timeProbeOLD, timeProbeNEW;
+  itk::TimeProbe  timeProbeOLD, timeProbeNEW, timeProbeRecursive, timeProbeBatch;
 
   /** Time the TransformPoint with the old region iterator. */
   timeProbeOLD.Start();
@@ -286,6 +297,28 @@ main( int argc, char * argv[] )
   timeProbeNEW.Stop();
   const double newTime = timeProbeNEW.GetMean();
 
+  /** Time the recursive TransformPoint, one point at a time. */
+  timeProbeRecursive.Start();
+  for( unsigned int i = 0; i < N; ++i )
+  {
+    outputPoint = recursiveTransform->TransformPoint( inputPoint );
+    sum        += outputPoint[ 0 ]; sum += outputPoint[ 1 ]; sum += outputPoint[ 2 ];
+  }
+  timeProbeRecursive.Stop();
+  const double recursiveTime = timeProbeRecursive.GetMean();
+
+  /** Time the recursive TransformPoints, processing all points in one batch. */
+  std::vector< InputPointType >  inputPoints( N, inputPoint );
+  std::vector< OutputPointType > outputPoints( N );
+  timeProbeBatch.Start();
+  recursiveTransform->TransformPoints( inputPoints.data(), outputPoints.data(), N );
+  for( unsigned int i = 0; i < N; ++i )
+  {
+    sum += outputPoints[ i ][ 0 ]; sum += outputPoints[ i ][ 1 ]; sum += outputPoints[ i ][ 2 ];
+  }
+  timeProbeBatch.Stop();
+  const double batchTime = timeProbeBatch.GetMean();
+
   // Avoid compiler optimizations, so use sum
   std::cerr << sum << std::endl; // works but ugly on screen
   //  volatile double a = sum; // works but gives unused variable warning
@@ -297,6 +330,19 @@ main( int argc, char * argv[] )
   std::cerr << "Time OLD = " << oldTime << " " << timeProbeOLD.GetUnit() << std::endl;
   std::cerr << "Time NEW = " << newTime << " " << timeProbeNEW.GetUnit() << std::endl;
   std::cerr << "Speedup factor = " << oldTime / newTime << std::endl;
+  std::cerr << "Time recursive = " << recursiveTime << " " << timeProbeRecursive.GetUnit() << std::endl;
+  std::cerr << "Time recursive batch = " << batchTime << " " << timeProbeBatch.GetUnit() << std::endl;
+  std::cerr << "Speedup factor batch = " << recursiveTime / batchTime << std::endl;
+
+  /** Test accuracy of the batch version. */
+  const OutputPointType recursiveOutputPoint = recursiveTransform->TransformPoint( inputPoint );
+  const double          batchDiff = ( recursiveOutputPoint - outputPoints[ N - 1 ] ).GetNorm();
+  std::cerr << "Recursive B-spline TransformPoints() difference: " << batchDiff << std::endl;
+  if( batchDiff > 1e-10 )
+  {
+    std::cerr << "ERROR: Recursive B-spline TransformPoints() returning incorrect result." << std::endl;
+    return EXIT_FAILURE;
+  }
 
   /** Return a value. */
   return 0;
@@ -0,0 +1,280 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkCommandLineArgumentParser.h"
+#include "itkDenseLinearAlgebra.h"
+#include "itkTimeProbe.h"
+
+#include "vnl/vnl_matrix.h"
+#include "vnl/vnl_matrix_exp.h"
+#include "vnl/algo/vnl_qr.h"
+#include "vnl/algo/vnl_svd.h"
+#include "vnl/algo/vnl_symmetric_eigensystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip> // setprecision, etc.
+#include <sstream>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Compares the dense matrix operations of the matrix-heavy components, done
+// by vnl and by the itk::DenseLinearAlgebra layer, for the sizes that occur
+// in practice: the L matrix of the KernelTransform2 (three rows per landmark),
+// the covariance and eigensystem of the PCA metrics (one row per sample, one
+// column per time point), and the 6x6 matrix exponentials of the
+// AffineLogTransform. Without ELASTIX_USE_EIGEN the layer calls vnl, so the
+// speedup is about one.
+
+typedef vnl_matrix< double > MatrixType;
+
+//------------------------------------------------------------------------------
+// GetHelpString
+std::string
+GetHelpString( void )
+{
+  std::stringstream ss;
+
+  ss << "Usage:" << std::endl
+     << "itkDenseLinearAlgebraBenchmark" << std::endl
+     << "  [-landmarks]  the numbers of landmarks of the kernel transform, default 50 100 200\n"
+     << "  [-timepoints] the numbers of time points of the PCA metric, default 10 50 100\n"
+     << "  [-samples]    the number of samples of the PCA metric, default 20000\n"
+     << "  [-runs]       number of timed runs per operation, default 3\n"
+     << "  [-threads]    the number of threads of the Eigen products, default of Eigen\n";
+  return ss.str();
+} // end GetHelpString()
+
+
+//------------------------------------------------------------------------------
+// A rows x cols matrix with reproducible values, diagonally dominant when square.
+MatrixType
+CreateMatrix( const unsigned int rows, const unsigned int cols )
+{
+  MatrixType A( rows, cols );
+  for( unsigned int i = 0; i < rows; ++i )
+  {
+    for( unsigned int j = 0; j < cols; ++j )
+    {
+      A( i, j ) = std::sin( 1.7 * i + 0.3 * j * j ) + ( i == j ? 4.0 : 0.0 );
+    }
+  }
+  return A;
+} // end CreateMatrix()
+
+
+//------------------------------------------------------------------------------
+// The largest absolute difference of two matrices, relative to the largest
+// absolute element of the first, or infinity if their sizes differ.
+double
+RelativeDifference( const MatrixType & A, const MatrixType & B )
+{
+  if( A.rows() != B.rows() || A.cols() != B.cols() )
+  {
+    return HUGE_VAL;
+  }
+  const double scale = std::max( A.absolute_value_max(), 1e-300 );
+  return ( A - B ).absolute_value_max() / scale;
+} // end RelativeDifference()
+
+
+//------------------------------------------------------------------------------
+// The mean time of a number of runs of a function, in seconds.
+double
+Time( const std::function< void( void ) > & function, const unsigned int runs )
+{
+  function(); // warm up
+  itk::TimeProbe timer;
+  for( unsigned int run = 0; run < runs; ++run )
+  {
+    timer.Start();
+    function();
+    timer.Stop();
+  }
+  return timer.GetMean();
+} // end Time()
+
+
+//------------------------------------------------------------------------------
+// Time an operation with vnl and with the layer, print the times, and check
+// that both gave the same result.
+bool
+Compare( const std::string & operation, const std::string & size,
+  const std::function< void( MatrixType & ) > & vnlFunction,
+  const std::function< void( MatrixType & ) > & layerFunction,
+  const unsigned int runs, const double tolerance )
+{
+  MatrixType vnlResult;
+  MatrixType layerResult;
+  const double vnlTime   = Time( [&]() { vnlFunction( vnlResult ); }, runs );
+  const double layerTime = Time( [&]() { layerFunction( layerResult ); }, runs );
+
+  const double difference = RelativeDifference( vnlResult, layerResult );
+  std::cout << std::left << std::setw( 22 ) << operation << std::setw( 12 ) << size
+            << std::right << std::setw( 12 ) << vnlTime << std::setw( 12 ) << layerTime
+            << std::setw( 10 ) << vnlTime / std::max( layerTime, 1e-12 )
+            << std::setw( 14 ) << difference << std::endl;
+
+  if( !( difference <= tolerance ) )
+  {
+    std::cerr << "ERROR: the results of " << operation << " differ by " << difference << std::endl;
+    return false;
+  }
+  return true;
+} // end Compare()
+
+
+//------------------------------------------------------------------------------
+int
+main( int argc, char * argv[] )
+{
+  // Create a command line argument parser
+  itk::CommandLineArgumentParser::Pointer parser = itk::CommandLineArgumentParser::New();
+  parser->SetCommandLineArguments( argc, argv );
+  parser->SetProgramHelpText( GetHelpString() );
+
+  itk::CommandLineArgumentParser::ReturnValue validateArguments = parser->CheckForRequiredArguments();
+  if( validateArguments == itk::CommandLineArgumentParser::FAILED )
+  {
+    return EXIT_FAILURE;
+  }
+  else if( validateArguments == itk::CommandLineArgumentParser::HELPREQUESTED )
+  {
+    return EXIT_SUCCESS;
+  }
+
+  // Get command line arguments
+  std::vector< unsigned int > landmarks;
+  parser->GetCommandLineArgument( "-landmarks", landmarks );
+  if( landmarks.empty() )
+  {
+    landmarks.push_back( 50 );
+    landmarks.push_back( 100 );
+    landmarks.push_back( 200 );
+  }
+
+  std::vector< unsigned int > timePoints;
+  parser->GetCommandLineArgument( "-timepoints", timePoints );
+  if( timePoints.empty() )
+  {
+    timePoints.push_back( 10 );
+    timePoints.push_back( 50 );
+    timePoints.push_back( 100 );
+  }
+
+  unsigned int samples = 20000;
+  parser->GetCommandLineArgument( "-samples", samples );
+
+  unsigned int runs = 3;
+  parser->GetCommandLineArgument( "-runs", runs );
+  runs = std::max( runs, 1u );
+
+  unsigned int threads = 0;
+  if( parser->GetCommandLineArgument( "-threads", threads ) )
+  {
+    itk::DenseLinearAlgebra::SetNumberOfThreads( threads );
+  }
+
+  std::cout << std::showpoint << std::setprecision( 4 );
+  std::cout << "Dense linear algebra with "
+            << ( itk::DenseLinearAlgebra::IsUsingEigen() ? "Eigen" : "vnl" ) << ", "
+            << itk::DenseLinearAlgebra::GetNumberOfThreads() << " threads, "
+            << runs << " runs.\n\n";
+  std::cout << std::left << std::setw( 22 ) << "operation" << std::setw( 12 ) << "size"
+            << std::right << std::setw( 12 ) << "vnl" << std::setw( 12 ) << "layer"
+            << std::setw( 10 ) << "speedup" << std::setw( 14 ) << "difference" << std::endl;
+
+  bool ok = true;
+
+  // The L matrix of the kernel transform: its inverse by SVD and by QR, and
+  // the solve for the W matrix.
+  for( const unsigned int numberOfLandmarks : landmarks )
+  {
+    const unsigned int n = 3 * ( numberOfLandmarks + 4 );
+    const MatrixType   L = CreateMatrix( n, n );
+    const MatrixType   Y = CreateMatrix( n, 1 );
+    const std::string  size = std::to_string( n ) + "x" + std::to_string( n );
+
+    ok &= Compare( "KernelTransformSVD", size,
+      [&L]( MatrixType & inverse ) { inverse = vnl_svd< double >( L, 1e-8 ).pinverse(); },
+      [&L]( MatrixType & inverse ) { itk::DenseLinearAlgebra::PseudoInverse( L, 1e-8, inverse ); },
+      runs, 1e-8 );
+    ok &= Compare( "KernelTransformQR", size,
+      [&L]( MatrixType & inverse ) { inverse = vnl_qr< double >( L ).inverse(); },
+      [&L]( MatrixType & inverse ) { itk::DenseLinearAlgebra::QRInverse( L, inverse ); },
+      runs, 1e-8 );
+    ok &= Compare( "Multiply", size,
+      [&L]( MatrixType & C ) { C = L * L; },
+      [&L]( MatrixType & C ) { itk::DenseLinearAlgebra::Multiply( L, L, C ); },
+      runs, 1e-12 );
+  }
+
+  // The covariance and the eigenvalues of the PCA metrics.
+  for( const unsigned int G : timePoints )
+  {
+    const MatrixType  A    = CreateMatrix( samples, G );
+    const MatrixType  C    = A.transpose() * A;
+    const std::string size = std::to_string( samples ) + "x" + std::to_string( G );
+
+    ok &= Compare( "PCACovariance", size,
+      [&A]( MatrixType & covariance ) { covariance = A.transpose() * A; },
+      [&A]( MatrixType & covariance ) { itk::DenseLinearAlgebra::TransposeMultiply( A, A, covariance ); },
+      runs, 1e-12 );
+
+    // Compare the eigenvalues, the eigenvectors may differ in sign.
+    ok &= Compare( "SymmetricEigensystem", std::to_string( G ) + "x" + std::to_string( G ),
+      [&C]( MatrixType & eigenValues )
+      {
+        const vnl_symmetric_eigensystem< double > eigensystem( C );
+        eigenValues = MatrixType( eigensystem.D.diagonal().data_block(), C.rows(), 1 );
+      },
+      [&C]( MatrixType & eigenValues )
+      {
+        vnl_vector< double > values;
+        MatrixType           vectors;
+        itk::DenseLinearAlgebra::SymmetricEigensystem( C, values, vectors );
+        eigenValues = MatrixType( values.data_block(), C.rows(), 1 );
+      },
+      runs, 1e-10 );
+  }
+
+  // The matrix exponentials of the AffineLogTransform: in 3D one of the 3x3
+  // matrix and nine of the 6x6 block matrices of the Jacobian, per SetParameters().
+  const unsigned int numberOfExponentials = 1000;
+  const MatrixType   logMatrix = CreateMatrix( 6, 6 ) * 0.1;
+  ok &= Compare( "MatrixExponential", "1000x6x6",
+    [&logMatrix]( MatrixType & exponential )
+    {
+      for( unsigned int i = 0; i < numberOfExponentials; ++i )
+      {
+        exponential = vnl_matrix_exp( logMatrix );
+      }
+    },
+    [&logMatrix]( MatrixType & exponential )
+    {
+      for( unsigned int i = 0; i < numberOfExponentials; ++i )
+      {
+        itk::DenseLinearAlgebra::MatrixExponential( logMatrix, exponential );
+      }
+    },
+    runs, 1e-10 );
+
+  // End program.
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+
+} // end main
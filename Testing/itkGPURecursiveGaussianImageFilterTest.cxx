@@ -193,9 +193,14 @@ main( int argc, char * argv[] )
   std::cout << "\n\nTesting directions switch, CPU vs GPU:\n";
   std::cout << "CPU/GPU sigma direction #threads time speedup RMSE\n";
 
-  // Check directions
-  for( direction = 0; direction < ImageDimension; direction++ )
+  // Check directions, with the FIR convolution of the default and with the
+  // recursion only
+  const double firSigma = gpuFilter->GetMaximumFIRSigma();
+  for( unsigned int i = 0; i < 2 * ImageDimension; i++ )
   {
+    direction = i % ImageDimension;
+    gpuFilter->SetMaximumFIRSigma( i < ImageDimension ? firSigma : 0.0 );
+
     cputimer.Start();
     cpuFilter->SetNumberOfWorkUnits( maximumNumberOfThreads );
     cpuFilter->SetInput( reader->GetOutput() );
@@ -217,7 +222,8 @@ main( int argc, char * argv[] )
     gpuFilter->Update();
     gputimer.Stop();
 
-    std::cout << "GPU " << sigma << " " << direction << " x "
+    std::cout << "GPU" << ( i < ImageDimension ? " " : " recursive " )
+              << sigma << " " << direction << " x "
               << gputimer.GetMean()
               << " " << cputimer.GetMean() / gputimer.GetMean();
 
@@ -0,0 +1,246 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkAdvancedTransformToDisplacementFieldSource.h"
+#include "itkAdvancedTransformToInverseDisplacementFieldSource.h"
+#include "itkIterativeInverseDisplacementFieldImageFilter.h"
+
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+// Report timings
+#include "itkTimeProbe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+//-------------------------------------------------------------------------------------
+// Compute the largest distance between T( y + v( y ) ) and y, over all voxels y of
+// the inverse displacement field v.
+
+template< class TTransform, class TField >
+double
+ComputeMaximumInverseError( const TTransform * transform, const TField * inverseField )
+{
+  typedef typename TTransform::InputPointType InputPointType;
+
+  double maximumError = 0.0;
+  itk::ImageRegionConstIteratorWithIndex< TField > it(
+    inverseField, inverseField->GetLargestPossibleRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    typename TField::PointType point;
+    inverseField->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+    InputPointType x;
+    for( unsigned int j = 0; j < TField::ImageDimension; j++ )
+    {
+      x[ j ] = point[ j ] + it.Get()[ j ];
+    }
+    const typename TTransform::OutputPointType tx = transform->TransformPoint( x );
+    double error = 0.0;
+    for( unsigned int j = 0; j < TField::ImageDimension; j++ )
+    {
+      error += ( tx[ j ] - point[ j ] ) * ( tx[ j ] - point[ j ] );
+    }
+    maximumError = std::max( maximumError, std::sqrt( error ) );
+  }
+  return maximumError;
+
+} // end ComputeMaximumInverseError()
+
+
+//-------------------------------------------------------------------------------------
+
+int
+main( int argc, char * argv[] )
+{
+  /** Some basic type definitions.
+   * NOTE: don't change the dimension or the spline order, since the
+   * hard-coded grid depends on this.
+   */
+  const unsigned int Dimension   = 3;
+  const unsigned int SplineOrder = 3;
+  typedef double CoordinateRepresentationType;
+
+  /** The size of the inverted field. Distinguish between Debug and Release mode. */
+#ifndef NDEBUG
+  const unsigned int N = 16;
+#else
+  const unsigned int N = 64;
+#endif
+  std::cerr << "N = " << N << "^3" << std::endl;
+
+  /** Check. */
+  if( argc != 2 )
+  {
+    std::cerr << "ERROR: You should specify a text file with the B-spline "
+              << "transformation parameters." << std::endl;
+    return 1;
+  }
+
+  /** Typedefs. */
+  typedef itk::AdvancedBSplineDeformableTransform<
+    CoordinateRepresentationType, Dimension, SplineOrder >    TransformType;
+  typedef TransformType::ParametersType ParametersType;
+
+  typedef itk::Vector< float, Dimension >        VectorType;
+  typedef itk::Image< VectorType, Dimension >    FieldType;
+  typedef FieldType::RegionType                  RegionType;
+  typedef FieldType::SizeType                    SizeType;
+  typedef FieldType::IndexType                   IndexType;
+  typedef FieldType::SpacingType                 SpacingType;
+  typedef FieldType::PointType                   OriginType;
+  typedef FieldType::DirectionType               DirectionType;
+  typedef itk::AdvancedTransformToDisplacementFieldSource<
+    FieldType, CoordinateRepresentationType >           ForwardSourceType;
+  typedef itk::AdvancedTransformToInverseDisplacementFieldSource<
+    FieldType, CoordinateRepresentationType >           InverseSourceType;
+  typedef itk::IterativeInverseDisplacementFieldImageFilter<
+    FieldType, FieldType >                              IterativeInverseFilterType;
+
+  /** Setup the B-spline transform, as in the BSplineTransformPointPerformanceTest:
+   * (GridSize 44 43 35)
+   * (GridIndex 0 0 0)
+   * (GridSpacing 10.7832773148 11.2116431394 11.8648235177)
+   * (GridOrigin -237.6759555555 -239.9488431747 -344.2315805162)
+   */
+  TransformType::Pointer transform = TransformType::New();
+  SizeType gridSize;
+  gridSize[ 0 ] = 44; gridSize[ 1 ] = 43; gridSize[ 2 ] = 35;
+  IndexType gridIndex;
+  gridIndex.Fill( 0 );
+  RegionType gridRegion;
+  gridRegion.SetSize( gridSize );
+  gridRegion.SetIndex( gridIndex );
+  SpacingType gridSpacing;
+  gridSpacing[ 0 ] = 10.7832773148;
+  gridSpacing[ 1 ] = 11.2116431394;
+  gridSpacing[ 2 ] = 11.8648235177;
+  OriginType gridOrigin;
+  gridOrigin[ 0 ] = -237.6759555555;
+  gridOrigin[ 1 ] = -239.9488431747;
+  gridOrigin[ 2 ] = -344.2315805162;
+  DirectionType gridDirection;
+  gridDirection.SetIdentity();
+
+  transform->SetGridOrigin( gridOrigin );
+  transform->SetGridSpacing( gridSpacing );
+  transform->SetGridRegion( gridRegion );
+  transform->SetGridDirection( gridDirection );
+
+  /** Now read the parameters as defined in the file par.txt. */
+  ParametersType parameters( transform->GetNumberOfParameters() );
+  std::ifstream  input( argv[ 1 ] );
+  if( input.is_open() )
+  {
+    for( unsigned int i = 0; i < parameters.GetSize(); ++i )
+    {
+      input >> parameters[ i ];
+    }
+  }
+  else
+  {
+    std::cerr << "ERROR: could not open the text file containing the "
+              << "parameter values." << std::endl;
+    return 1;
+  }
+  transform->SetParameters( parameters );
+
+  /** The grid of the inverse, inside the support of the B-spline grid. */
+  SizeType size;
+  size.Fill( N );
+  SpacingType spacing;
+  spacing.Fill( 256.0 / N );
+  OriginType origin;
+  origin[ 0 ] = -180.0; origin[ 1 ] = -180.0; origin[ 2 ] = -300.0;
+  DirectionType direction;
+  direction.SetIdentity();
+  const double tolerance = 0.001;
+
+  /** Time the Newton inversion. */
+  itk::TimeProbe timeProbeNewton, timeProbeIterative;
+  InverseSourceType::Pointer inverseSource = InverseSourceType::New();
+  inverseSource->SetTransform( transform );
+  inverseSource->SetOutputSize( size );
+  inverseSource->SetOutputSpacing( spacing );
+  inverseSource->SetOutputOrigin( origin );
+  inverseSource->SetOutputDirection( direction );
+  inverseSource->SetTolerance( tolerance );
+  try
+  {
+    timeProbeNewton.Start();
+    inverseSource->Update();
+    timeProbeNewton.Stop();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Time the iterative inversion of the forward displacement field by ITK. The
+   * registration based inversion of elxInvertTransform runs elastix, and takes
+   * minutes for a single case.
+   */
+  ForwardSourceType::Pointer forwardSource = ForwardSourceType::New();
+  forwardSource->SetTransform( transform );
+  forwardSource->SetOutputSize( size );
+  forwardSource->SetOutputSpacing( spacing );
+  forwardSource->SetOutputOrigin( origin );
+  forwardSource->SetOutputDirection( direction );
+  IterativeInverseFilterType::Pointer iterativeInverse = IterativeInverseFilterType::New();
+  iterativeInverse->SetInput( forwardSource->GetOutput() );
+  iterativeInverse->SetNumberOfIterations( 20 );
+  iterativeInverse->SetStopValue( tolerance * spacing[ 0 ] );
+  try
+  {
+    timeProbeIterative.Start();
+    iterativeInverse->Update();
+    timeProbeIterative.Stop();
+  }
+  catch( itk::ExceptionObject & excp )
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const double newtonError    = ComputeMaximumInverseError( transform.GetPointer(), inverseSource->GetOutput() );
+  const double iterativeError = ComputeMaximumInverseError( transform.GetPointer(), iterativeInverse->GetOutput() );
+
+  /** Report timings and errors. */
+  std::cerr << std::setprecision( 4 );
+  std::cerr << "Time Newton inversion = " << timeProbeNewton.GetMean() << " "
+            << timeProbeNewton.GetUnit() << ", maximum error = " << newtonError << std::endl;
+  std::cerr << "Time IterativeInverseDisplacementFieldImageFilter = " << timeProbeIterative.GetMean() << " "
+            << timeProbeIterative.GetUnit() << ", maximum error = " << iterativeError << std::endl;
+  std::cerr << "Speedup factor = " << timeProbeIterative.GetMean() / timeProbeNewton.GetMean() << std::endl;
+  std::cerr << "Unconverged points = " << inverseSource->GetNumberOfUnconvergedPoints() << std::endl;
+
+  /** Test the accuracy of the Newton inversion, up to float rounding of the field. */
+  if( inverseSource->GetNumberOfUnconvergedPoints() > 0
+    || newtonError > tolerance * spacing[ 0 ] + 1e-4 )
+  {
+    std::cerr << "ERROR: The Newton inversion did not reach the tolerance." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** Return a value. */
+  return 0;
+
+} // end main
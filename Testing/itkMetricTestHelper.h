@@ -0,0 +1,234 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef __itkMetricTestHelper_h
+#define __itkMetricTestHelper_h
+
+#include "itkAdvancedBSplineDeformableTransform.h"
+#include "itkAdvancedCombinationTransform.h"
+#include "itkAdvancedLinearInterpolateImageFunction.h"
+#include "itkImageFullSampler.h"
+#include "itkSingleValuedCostFunction.h"
+
+#include "itkImage.h"
+#include "itkImageRegionIteratorWithIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+
+//------------------------------------------------------------------------------
+// Definition of the types shared by the metric tests
+const unsigned int Dimension = 3;
+typedef float                              PixelType;
+typedef itk::Image< PixelType, Dimension > ImageType;
+typedef double                             ScalarType;
+
+typedef itk::AdvancedCombinationTransform< ScalarType, Dimension >           CombinationTransformType;
+typedef itk::AdvancedBSplineDeformableTransform< ScalarType, Dimension, 3 >  BSplineTransformType;
+typedef itk::AdvancedLinearInterpolateImageFunction< ImageType, ScalarType > LinearInterpolatorType;
+typedef itk::SingleValuedCostFunction::DerivativeType                        MetricDerivativeType;
+
+//------------------------------------------------------------------------------
+// The threading settings of one metric configuration. The settings that are
+// specific to a metric are applied by the configure function of CreateMetric().
+struct MetricSettings
+{
+  bool         m_UseMultiThread;
+  unsigned int m_Threads;
+  bool         m_UseSparseDerivativeAccumulation;
+};
+
+//------------------------------------------------------------------------------
+// The results of one metric configuration.
+struct MetricResults
+{
+  double               m_Value;
+  MetricDerivativeType m_Derivative;
+};
+
+//------------------------------------------------------------------------------
+// Create a cubic image of the given size and spacing with a smooth synthetic
+// pattern of the given wavelength, shifted over the given distance.
+ImageType::Pointer
+CreateImage( const unsigned int size, const double shift,
+  const double spacing = 4.0, const double wavelength = 16.0 )
+{
+  ImageType::SizeType imageSize;
+  imageSize.Fill( size );
+  ImageType::SpacingType imageSpacing;
+  imageSpacing.Fill( spacing );
+
+  ImageType::Pointer image = ImageType::New();
+  image->SetRegions( ImageType::RegionType( imageSize ) );
+  image->SetSpacing( imageSpacing );
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, image->GetBufferedRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    ImageType::PointType point;
+    image->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+    const double value = 100.0 + 100.0 * std::sin( ( point[ 0 ] + shift ) / wavelength )
+      * std::cos( ( point[ 1 ] - shift ) / ( 1.5 * wavelength ) ) + 0.25 * point[ 2 ];
+    it.Set( static_cast< PixelType >( value ) );
+  }
+
+  return image;
+} // end CreateImage()
+
+
+//------------------------------------------------------------------------------
+// Create a B-spline transform with the given number of control points per
+// dimension covering the image, with deterministic coefficients of the given
+// amplitude. With many control points the support of each sample is small
+// compared to the grid, so that the Jacobian of the transform is sparse.
+BSplineTransformType::Pointer
+CreateBSplineTransform( const ImageType * image, const unsigned int numberOfNodes,
+  BSplineTransformType::ParametersType & parameters, const double amplitude = 2.0 )
+{
+  const ImageType::SizeType    imageSize = image->GetLargestPossibleRegion().GetSize();
+  const ImageType::SpacingType spacing   = image->GetSpacing();
+
+  BSplineTransformType::OriginType    gridOrigin;
+  BSplineTransformType::SpacingType   gridSpacing;
+  BSplineTransformType::SizeType      gridRegionSize;
+  BSplineTransformType::DirectionType gridDirection;
+  gridDirection.SetIdentity();
+
+  // Three control points lie outside the image, to support the B-spline
+  for( unsigned int d = 0; d < Dimension; ++d )
+  {
+    gridRegionSize[ d ] = numberOfNodes;
+    gridSpacing[ d ]    = ( imageSize[ d ] - 1 ) * spacing[ d ] / ( numberOfNodes - 3 );
+    gridOrigin[ d ]     = image->GetOrigin()[ d ] - gridSpacing[ d ];
+  }
+
+  BSplineTransformType::Pointer bsplineTransform = BSplineTransformType::New();
+  bsplineTransform->SetGridOrigin( gridOrigin );
+  bsplineTransform->SetGridSpacing( gridSpacing );
+  bsplineTransform->SetGridRegion( BSplineTransformType::RegionType( gridRegionSize ) );
+  bsplineTransform->SetGridDirection( gridDirection );
+
+  parameters.SetSize( bsplineTransform->GetNumberOfParameters() );
+  for( unsigned int i = 0; i < parameters.GetSize(); ++i )
+  {
+    parameters[ i ] = amplitude * std::sin( 0.37 * i );
+  }
+  bsplineTransform->SetParameters( parameters );
+  return bsplineTransform;
+} // end CreateBSplineTransform()
+
+
+//------------------------------------------------------------------------------
+// Create a combination transform with a B-spline current transform, see
+// CreateBSplineTransform().
+CombinationTransformType::Pointer
+CreateTransform( const ImageType * image, const unsigned int numberOfNodes,
+  BSplineTransformType::ParametersType & parameters, const double amplitude = 2.0 )
+{
+  CombinationTransformType::Pointer transform = CombinationTransformType::New();
+  transform->SetCurrentTransform( CreateBSplineTransform( image, numberOfNodes, parameters, amplitude ) );
+  return transform;
+} // end CreateTransform()
+
+
+//------------------------------------------------------------------------------
+// Create and initialize a metric for one configuration, which samples the
+// full fixed image and interpolates the moving image linearly. The configure
+// function sets the settings that are specific to the metric.
+template< class TMetric >
+typename TMetric::Pointer
+CreateMetric( const ImageType * fixedImage, const ImageType * movingImage,
+  CombinationTransformType * transform, const MetricSettings & settings,
+  const std::function< void( TMetric * ) > & configure = std::function< void( TMetric * ) >() )
+{
+  typename TMetric::Pointer metric = TMetric::New();
+  metric->SetFixedImage( fixedImage );
+  metric->SetMovingImage( movingImage );
+  metric->SetFixedImageRegion( fixedImage->GetBufferedRegion() );
+  metric->SetTransform( transform );
+  metric->SetInterpolator( LinearInterpolatorType::New() );
+  metric->SetImageSampler( itk::ImageFullSampler< ImageType >::New() );
+  metric->SetUseSparseDerivativeAccumulation( settings.m_UseSparseDerivativeAccumulation );
+  metric->SetNumberOfWorkUnits( settings.m_Threads );
+  metric->SetUseMultiThread( settings.m_UseMultiThread );
+  if( configure )
+  {
+    configure( metric );
+  }
+  metric->Initialize();
+  return metric;
+} // end CreateMetric()
+
+
+//------------------------------------------------------------------------------
+// Evaluate the value and the derivative of a metric for one configuration.
+template< class TMetric >
+MetricResults
+EvaluateMetric( const ImageType * fixedImage, const ImageType * movingImage,
+  CombinationTransformType * transform, const BSplineTransformType::ParametersType & parameters,
+  const MetricSettings & settings,
+  const std::function< void( TMetric * ) > & configure = std::function< void( TMetric * ) >() )
+{
+  const typename TMetric::Pointer metric
+    = CreateMetric< TMetric >( fixedImage, movingImage, transform, settings, configure );
+
+  MetricResults results;
+  metric->GetValueAndDerivative( parameters, results.m_Value, results.m_Derivative );
+  return results;
+} // end EvaluateMetric()
+
+
+//------------------------------------------------------------------------------
+// Compare the value and derivative of a configuration with those of the
+// reference, up to the given relative tolerance. The derivative must not be
+// zero, so that the comparison tests something.
+bool
+CompareResults( const MetricResults & reference, const MetricResults & results,
+  const double tolerance, const std::string & description, const std::string & referenceDescription )
+{
+  bool equal = reference.m_Derivative.GetSize() == results.m_Derivative.GetSize();
+
+  double maximumDerivative           = 0.0;
+  double maximumDerivativeDifference = 0.0;
+  for( unsigned int i = 0; equal && i < reference.m_Derivative.GetSize(); ++i )
+  {
+    maximumDerivative           = std::max( maximumDerivative, std::abs( reference.m_Derivative[ i ] ) );
+    maximumDerivativeDifference = std::max( maximumDerivativeDifference,
+      std::abs( reference.m_Derivative[ i ] - results.m_Derivative[ i ] ) );
+  }
+
+  equal = equal
+    && maximumDerivative > 0.0
+    && std::abs( reference.m_Value - results.m_Value ) <= tolerance * std::abs( reference.m_Value )
+    && maximumDerivativeDifference <= tolerance * maximumDerivative;
+
+  if( !equal )
+  {
+    std::cerr << "ERROR: " << description << " differs from " << referenceDescription << ":\n"
+              << "  value " << results.m_Value << " instead of " << reference.m_Value << "\n"
+              << "  maximum derivative difference " << maximumDerivativeDifference
+              << ", maximum derivative " << maximumDerivative << std::endl;
+  }
+  return equal;
+} // end CompareResults()
+
+
+#endif // end #ifndef __itkMetricTestHelper_h
@@ -0,0 +1,424 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkCommandLineArgumentParser.h"
+
+// The metrics that are benchmarked
+#include "itkAdvancedKappaStatisticImageToImageMetric.h"
+#include "itkAdvancedLocalNormalizedCorrelationImageToImageMetric.h"
+#include "itkParzenWindowMutualInformationImageToImageMetric.h"
+#include "itkAdvancedMeanSquaresImageToImageMetric.h"
+#include "itkAdvancedNormalizedCorrelationImageToImageMetric.h"
+#include "itkParzenWindowNormalizedMutualInformationImageToImageMetric.h"
+#include "itkSumSquaredTissueVolumeDifferenceImageToImageMetric.h"
+#include "itkViolaWellsMutualInformationImageToImageMetric.h"
+
+#include "itkMetricTestHelper.h"
+
+#include "itkImageRandomSampler.h"
+#include "itkMultiThreaderBase.h"
+#include "itkTimeProbe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip> // setprecision, etc.
+#include <sstream>
+
+#if defined( __linux__ )
+#include <dirent.h>
+#include <cstring>
+#endif
+
+//------------------------------------------------------------------------------
+// Definition of the types used by the benchmark
+typedef itk::ImageRandomSampler< ImageType > ImageSamplerType;
+
+//------------------------------------------------------------------------------
+// The result of one configuration: the mean time of one call to
+// GetValueAndDerivative(), or to GetValue(), for a metric, a number of
+// threads, a number of transform parameters and a number of samples.
+struct BenchmarkResult
+{
+  std::string   m_Metric;
+  std::string   m_Function;
+  unsigned int  m_Threads;
+  unsigned long m_Parameters;
+  unsigned long m_Samples;
+  double        m_Seconds;
+  double        m_Speedup;
+  double        m_Efficiency;
+};
+
+typedef std::vector< BenchmarkResult > BenchmarkResults;
+
+//------------------------------------------------------------------------------
+// The settings shared by all configurations.
+struct BenchmarkSettings
+{
+  ImageType::Pointer          m_FixedImage;
+  ImageType::Pointer          m_MovingImage;
+  std::vector< unsigned int > m_Threads;
+  std::vector< unsigned int > m_GridSizes;
+  std::vector< unsigned int > m_Samples;
+  unsigned int                m_Runs;
+  std::vector< std::string >  m_Metrics;
+  std::vector< std::string >  m_Functions;
+};
+
+//------------------------------------------------------------------------------
+// GetHelpString
+std::string
+GetHelpString( void )
+{
+  std::stringstream ss;
+
+  ss << "Usage:" << std::endl
+     << "itkMetricThreadScalingBenchmark" << std::endl
+     << "  [-threads]    maximum number of threads, default maximum\n"
+     << "  [-parameters] the B-spline grid sizes per dimension, default 5 9 17\n"
+     << "  [-samples]    the numbers of samples, default 2000 20000 100000\n"
+     << "  [-size]       the size of the cubic test images, default 64\n"
+     << "  [-runs]       number of timed runs per configuration, default 3\n"
+     << "  [-metrics]    only benchmark these metrics, default all\n"
+     << "  [-value]      also benchmark the value-only GetValue()\n"
+     << "  [-label]      a label that is written to the results, for example\n"
+     << "                the numactl policy the benchmark was started with\n"
+     << "  [-csv]        write the results to this CSV file\n"
+     << "  [-json]       write the results to this JSON file\n";
+  return ss.str();
+} // end GetHelpString()
+
+
+//------------------------------------------------------------------------------
+// Count the NUMA nodes of the machine, or return zero if unknown.
+unsigned int
+GetNumberOfNUMANodes( void )
+{
+  unsigned int numberOfNodes = 0;
+#if defined( __linux__ )
+  DIR * dir = opendir( "/sys/devices/system/node" );
+  if( dir != NULL )
+  {
+    struct dirent * entry = NULL;
+    while( ( entry = readdir( dir ) ) != NULL )
+    {
+      if( std::strncmp( entry->d_name, "node", 4 ) == 0
+        && entry->d_name[ 4 ] >= '0' && entry->d_name[ 4 ] <= '9' )
+      {
+        ++numberOfNodes;
+      }
+    }
+    closedir( dir );
+  }
+#endif
+  return numberOfNodes;
+} // end GetNumberOfNUMANodes()
+
+
+//------------------------------------------------------------------------------
+// Benchmark one metric over all thread counts, parameter counts and sample
+// counts. A metric that cannot be initialized for the synthetic setup is
+// reported and skipped.
+template< typename TMetric >
+void
+BenchmarkMetric( const std::string & name, const BenchmarkSettings & settings,
+  BenchmarkResults & results )
+{
+  if( !settings.m_Metrics.empty()
+    && std::find( settings.m_Metrics.begin(), settings.m_Metrics.end(), name ) == settings.m_Metrics.end() )
+  {
+    return;
+  }
+
+  typedef typename TMetric::DerivativeType DerivativeType;
+  typedef typename TMetric::MeasureType    MeasureType;
+
+  for( std::size_t g = 0; g < settings.m_GridSizes.size(); ++g )
+  {
+    BSplineTransformType::ParametersType parameters;
+    CombinationTransformType::Pointer    transform
+      = CreateTransform( settings.m_FixedImage, std::max( settings.m_GridSizes[ g ], 4u ), parameters );
+
+    for( std::size_t s = 0; s < settings.m_Samples.size(); ++s )
+    {
+      for( std::size_t f = 0; f < settings.m_Functions.size(); ++f )
+      {
+        const bool valueOnly           = settings.m_Functions[ f ] == "GetValue";
+        double     singleThreadSeconds = 0.0;
+        for( std::size_t t = 0; t < settings.m_Threads.size(); ++t )
+        {
+          const unsigned int threads = settings.m_Threads[ t ];
+          itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads( threads );
+
+          BenchmarkResult result = { name, settings.m_Functions[ f ], threads,
+                                     parameters.GetSize(), settings.m_Samples[ s ], 0.0, 0.0, 0.0 };
+          try
+          {
+            ImageSamplerType::Pointer sampler = ImageSamplerType::New();
+            sampler->SetNumberOfSamples( settings.m_Samples[ s ] );
+
+            LinearInterpolatorType::Pointer interpolator = LinearInterpolatorType::New();
+
+            typename TMetric::Pointer metric = TMetric::New();
+            metric->SetFixedImage( settings.m_FixedImage );
+            metric->SetMovingImage( settings.m_MovingImage );
+            metric->SetFixedImageRegion( settings.m_FixedImage->GetBufferedRegion() );
+            metric->SetTransform( transform );
+            metric->SetInterpolator( interpolator );
+            metric->SetImageSampler( sampler );
+            metric->SetNumberOfWorkUnits( threads );
+            metric->SetUseMultiThread( threads > 1 );
+            metric->Initialize();
+
+            // The first call allocates the buffers and draws the samples
+            MeasureType    value = 0.0;
+            DerivativeType derivative;
+            metric->GetValueAndDerivative( parameters, value, derivative );
+
+            itk::TimeProbe probe;
+            probe.Start();
+            for( unsigned int r = 0; r < settings.m_Runs; ++r )
+            {
+              if( valueOnly )
+              {
+                value = metric->GetValue( parameters );
+              }
+              else
+              {
+                metric->GetValueAndDerivative( parameters, value, derivative );
+              }
+            }
+            probe.Stop();
+            result.m_Seconds = probe.GetTotal() / settings.m_Runs;
+          }
+          catch( itk::ExceptionObject & e )
+          {
+            std::cerr << "WARNING: skipping " << name << ", it could not be evaluated:\n"
+                      << e.GetDescription() << std::endl;
+            return;
+          }
+
+          // The speedup and efficiency are relative to the first, smallest,
+          // number of threads
+          if( t == 0 )
+          {
+            singleThreadSeconds = result.m_Seconds * threads;
+          }
+          if( result.m_Seconds > 0.0 )
+          {
+            result.m_Efficiency = singleThreadSeconds / ( threads * result.m_Seconds );
+            result.m_Speedup    = result.m_Efficiency * threads;
+          }
+
+          std::cout << name << " " << result.m_Function << " " << result.m_Threads
+                    << " " << result.m_Parameters << " " << result.m_Samples << " " << result.m_Seconds
+                    << " " << result.m_Speedup << " " << result.m_Efficiency << std::endl;
+          results.push_back( result );
+        }
+      }
+    }
+  }
+} // end BenchmarkMetric()
+
+
+//------------------------------------------------------------------------------
+// Write the results as CSV, one line per configuration.
+bool
+WriteCSV( const std::string & fileName, const std::string & label,
+  const unsigned int numberOfNUMANodes, const BenchmarkResults & results )
+{
+  std::ofstream file( fileName.c_str() );
+  if( !file.is_open() )
+  {
+    std::cerr << "ERROR: could not open " << fileName << " for writing." << std::endl;
+    return false;
+  }
+
+  file << "label,numa_nodes,metric,function,threads,parameters,samples,seconds,speedup,efficiency\n";
+  for( std::size_t i = 0; i < results.size(); ++i )
+  {
+    const BenchmarkResult & result = results[ i ];
+    file << "\"" << label << "\"," << numberOfNUMANodes << ",\"" << result.m_Metric << "\",\""
+         << result.m_Function << "\"," << result.m_Threads << "," << result.m_Parameters << "," << result.m_Samples << ","
+         << result.m_Seconds << "," << result.m_Speedup << "," << result.m_Efficiency << "\n";
+  }
+  return true;
+} // end WriteCSV()
+
+
+//------------------------------------------------------------------------------
+// Write the results as JSON, an object with the label, the number of NUMA
+// nodes and the list of configurations.
+bool
+WriteJSON( const std::string & fileName, const std::string & label,
+  const unsigned int numberOfNUMANodes, const BenchmarkResults & results )
+{
+  std::ofstream file( fileName.c_str() );
+  if( !file.is_open() )
+  {
+    std::cerr << "ERROR: could not open " << fileName << " for writing." << std::endl;
+    return false;
+  }
+
+  file << "{\n  \"label\": \"" << label << "\",\n  \"numa_nodes\": " << numberOfNUMANodes
+       << ",\n  \"benchmarks\": [\n";
+  for( std::size_t i = 0; i < results.size(); ++i )
+  {
+    const BenchmarkResult & result = results[ i ];
+    file << "    { \"metric\": \"" << result.m_Metric << "\", \"function\": \"" << result.m_Function
+         << "\", \"threads\": " << result.m_Threads
+         << ", \"parameters\": " << result.m_Parameters << ", \"samples\": " << result.m_Samples
+         << ", \"seconds\": " << result.m_Seconds << ", \"speedup\": " << result.m_Speedup
+         << ", \"efficiency\": " << result.m_Efficiency
+         << ( i + 1 < results.size() ? " },\n" : " }\n" );
+  }
+  file << "  ]\n}\n";
+  return true;
+} // end WriteJSON()
+
+
+//------------------------------------------------------------------------------
+// This program measures how GetValueAndDerivative() of the metrics that
+// derive from the AdvancedImageToImageMetric, and with -value also their
+// value-only GetValue(), scales with the number of threads, for B-spline transforms with several numbers of parameters and for
+// several numbers of samples. The threads are swept over 1, 2, 4, ... up to
+// the maximum. The speedup and the parallel efficiency are relative to one
+// thread. The groupwise metrics, which need a stack transform, and the
+// pattern intensity metric, which needs a ray cast interpolator, are not
+// included.
+//
+// To see the effect of the memory placement on a NUMA machine, run the
+// benchmark several times under different policies, for example
+//   numactl --cpunodebind=0 --membind=0 itkMetricThreadScalingBenchmark -label node0
+//   numactl --interleave=all itkMetricThreadScalingBenchmark -label interleave
+// and compare the results, which record the label and the number of nodes.
+int
+main( int argc, char * argv[] )
+{
+  // Create a command line argument parser
+  itk::CommandLineArgumentParser::Pointer parser = itk::CommandLineArgumentParser::New();
+  parser->SetCommandLineArguments( argc, argv );
+  parser->SetProgramHelpText( GetHelpString() );
+
+  itk::CommandLineArgumentParser::ReturnValue validateArguments = parser->CheckForRequiredArguments();
+  if( validateArguments == itk::CommandLineArgumentParser::FAILED )
+  {
+    return EXIT_FAILURE;
+  }
+  else if( validateArguments == itk::CommandLineArgumentParser::HELPREQUESTED )
+  {
+    return EXIT_SUCCESS;
+  }
+
+  // Get command line arguments
+  BenchmarkSettings settings;
+
+  unsigned int maximumNumberOfThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+  parser->GetCommandLineArgument( "-threads", maximumNumberOfThreads );
+  maximumNumberOfThreads = std::max( maximumNumberOfThreads, 1u );
+  for( unsigned int threads = 1; threads < maximumNumberOfThreads; threads *= 2 )
+  {
+    settings.m_Threads.push_back( threads );
+  }
+  settings.m_Threads.push_back( maximumNumberOfThreads );
+
+  parser->GetCommandLineArgument( "-parameters", settings.m_GridSizes );
+  if( settings.m_GridSizes.empty() )
+  {
+    settings.m_GridSizes.push_back( 5 );
+    settings.m_GridSizes.push_back( 9 );
+    settings.m_GridSizes.push_back( 17 );
+  }
+
+  parser->GetCommandLineArgument( "-samples", settings.m_Samples );
+  if( settings.m_Samples.empty() )
+  {
+    settings.m_Samples.push_back( 2000 );
+    settings.m_Samples.push_back( 20000 );
+    settings.m_Samples.push_back( 100000 );
+  }
+
+  unsigned int size = 64;
+  parser->GetCommandLineArgument( "-size", size );
+
+  settings.m_Runs = 3;
+  parser->GetCommandLineArgument( "-runs", settings.m_Runs );
+  settings.m_Runs = std::max( settings.m_Runs, 1u );
+
+  parser->GetCommandLineArgument( "-metrics", settings.m_Metrics );
+
+  settings.m_Functions.push_back( "GetValueAndDerivative" );
+  if( parser->ArgumentExists( "-value" ) )
+  {
+    settings.m_Functions.push_back( "GetValue" );
+  }
+
+  std::string label = "";
+  parser->GetCommandLineArgument( "-label", label );
+  std::string csvFileName = "";
+  parser->GetCommandLineArgument( "-csv", csvFileName );
+  std::string jsonFileName = "";
+  parser->GetCommandLineArgument( "-json", jsonFileName );
+
+  const unsigned int numberOfNUMANodes = GetNumberOfNUMANodes();
+  std::cout << std::showpoint << std::setprecision( 4 );
+  std::cout << "Benchmarking up to " << maximumNumberOfThreads << " threads on "
+            << numberOfNUMANodes << " NUMA nodes, " << size << "^3 images, "
+            << settings.m_Runs << " runs.\n";
+
+  settings.m_FixedImage  = CreateImage( size, 0.0, 256.0 / size );
+  settings.m_MovingImage = CreateImage( size, 6.0, 256.0 / size );
+
+  // Run the benchmarks
+  std::cout << "\nmetric function threads parameters samples seconds speedup efficiency\n";
+  BenchmarkResults results;
+  BenchmarkMetric< itk::AdvancedMeanSquaresImageToImageMetric< ImageType, ImageType > >(
+    "AdvancedMeanSquares", settings, results );
+  BenchmarkMetric< itk::AdvancedNormalizedCorrelationImageToImageMetric< ImageType, ImageType > >(
+    "AdvancedNormalizedCorrelation", settings, results );
+  BenchmarkMetric< itk::ParzenWindowMutualInformationImageToImageMetric< ImageType, ImageType > >(
+    "AdvancedMattesMutualInformation", settings, results );
+  BenchmarkMetric< itk::ParzenWindowNormalizedMutualInformationImageToImageMetric< ImageType, ImageType > >(
+    "NormalizedMutualInformation", settings, results );
+  BenchmarkMetric< itk::AdvancedKappaStatisticImageToImageMetric< ImageType, ImageType > >(
+    "AdvancedKappaStatistic", settings, results );
+  BenchmarkMetric< itk::AdvancedLocalNormalizedCorrelationImageToImageMetric< ImageType, ImageType > >(
+    "AdvancedLocalNormalizedCorrelation", settings, results );
+  BenchmarkMetric< itk::SumSquaredTissueVolumeDifferenceImageToImageMetric< ImageType, ImageType > >(
+    "SumSquaredTissueVolumeDifference", settings, results );
+  BenchmarkMetric< itk::ViolaWellsMutualInformationImageToImageMetric< ImageType, ImageType > >(
+    "ViolaWellsMutualInformation", settings, results );
+
+  if( results.empty() )
+  {
+    std::cerr << "ERROR: no metric was benchmarked." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  bool written = true;
+  if( !csvFileName.empty() )
+  {
+    written = WriteCSV( csvFileName, label, numberOfNUMANodes, results ) && written;
+  }
+  if( !jsonFileName.empty() )
+  {
+    written = WriteJSON( jsonFileName, label, numberOfNUMANodes, results ) && written;
+  }
+
+  return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
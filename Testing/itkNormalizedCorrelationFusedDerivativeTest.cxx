@@ -0,0 +1,113 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkAdvancedNormalizedCorrelationImageToImageMetric.h"
+
+#include "itkMetricTestHelper.h"
+
+#include <sstream>
+
+//------------------------------------------------------------------------------
+// Definition of the metric used by the test
+typedef itk::AdvancedNormalizedCorrelationImageToImageMetric< ImageType, ImageType > MetricType;
+
+//------------------------------------------------------------------------------
+// Evaluate the value and the derivative of the normalized correlation for
+// one configuration.
+MetricResults
+EvaluateNormalizedCorrelation( const ImageType * fixedImage, const ImageType * movingImage,
+  CombinationTransformType * transform, const BSplineTransformType::ParametersType & parameters,
+  const MetricSettings & settings, const bool subtractMean, const bool useFusedDerivativeAccumulation )
+{
+  return EvaluateMetric< MetricType >( fixedImage, movingImage, transform, parameters, settings,
+    [ subtractMean, useFusedDerivativeAccumulation ]( MetricType * metric )
+    {
+      metric->SetSubtractMean( subtractMean );
+      metric->SetUseFusedDerivativeAccumulation( useFusedDerivativeAccumulation );
+    } );
+} // end EvaluateNormalizedCorrelation()
+
+
+//------------------------------------------------------------------------------
+// This test checks that the fused derivative accumulation of the
+// AdvancedNormalizedCorrelationImageToImageMetric, which first computes the
+// sums of the NC in a value-only pass and then accumulates a single weighted
+// Jacobian term per sample, gives the same value and derivative as the
+// threaded computation with three derivative vectors per thread and as the
+// single-threaded computation. This is checked with and without subtracting
+// the mean, with dense and sparse accumulation, and for several numbers of
+// threads.
+int
+main( void )
+{
+  const ImageType::Pointer fixedImage  = CreateImage( 16, 0.0 );
+  const ImageType::Pointer movingImage = CreateImage( 16, 6.0 );
+
+  BSplineTransformType::ParametersType    parameters;
+  const CombinationTransformType::Pointer transform = CreateTransform( fixedImage, 6, parameters );
+
+  const unsigned int numberOfThreads[] = { 1, 2, 3, 4, 7 };
+  const double       tolerance         = 1e-10;
+  const std::string  reference         = "the single-threaded computation";
+
+  bool passed = true;
+  try
+  {
+    for( unsigned int m = 0; m < 2; ++m )
+    {
+      const bool           subtractMean      = m == 1;
+      const MetricSettings referenceSettings = { false, 1, false };
+      const MetricResults  referenceResults  = EvaluateNormalizedCorrelation(
+        fixedImage, movingImage, transform, parameters, referenceSettings, subtractMean, false );
+
+      for( unsigned int t = 0; t < sizeof( numberOfThreads ) / sizeof( numberOfThreads[ 0 ] ); ++t )
+      {
+        const MetricSettings denseSettings  = { true, numberOfThreads[ t ], false };
+        const MetricSettings sparseSettings = { true, numberOfThreads[ t ], true };
+        const MetricResults  threaded       = EvaluateNormalizedCorrelation(
+          fixedImage, movingImage, transform, parameters, denseSettings, subtractMean, false );
+        const MetricResults  fused          = EvaluateNormalizedCorrelation(
+          fixedImage, movingImage, transform, parameters, denseSettings, subtractMean, true );
+        const MetricResults  fusedSparse    = EvaluateNormalizedCorrelation(
+          fixedImage, movingImage, transform, parameters, sparseSettings, subtractMean, true );
+
+        std::ostringstream description;
+        description << "with " << numberOfThreads[ t ] << " threads "
+                    << ( subtractMean ? "with" : "without" ) << " subtracting the mean";
+        passed = CompareResults( referenceResults, threaded, tolerance,
+          "The threaded computation " + description.str(), reference ) && passed;
+        passed = CompareResults( referenceResults, fused, tolerance,
+          "The fused accumulation " + description.str(), reference ) && passed;
+        passed = CompareResults( referenceResults, fusedSparse, tolerance,
+          "The fused sparse accumulation " + description.str(), reference ) && passed;
+      }
+    }
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    std::cerr << "ERROR: the metric could not be evaluated:\n" << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( !passed )
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "The fused derivative accumulation equals the existing computation." << std::endl;
+  return EXIT_SUCCESS;
+}
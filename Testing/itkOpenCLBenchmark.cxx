@@ -0,0 +1,668 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkTestHelper.h"
+#include "itkCommandLineArgumentParser.h"
+#include "itkOpenCLProfilingTimeProbe.h"
+
+// GPU copiers
+#include "itkGPUTransformCopier.h"
+#include "itkGPUInterpolatorCopier.h"
+
+// GPU factory includes
+#include "itkGPUImageFactory.h"
+#include "itkGPUBSplineDecompositionImageFilterFactory.h"
+#include "itkGPUCastImageFilterFactory.h"
+#include "itkGPURecursiveGaussianImageFilterFactory.h"
+#include "itkGPUResampleImageFilterFactory.h"
+#include "itkGPUShrinkImageFilterFactory.h"
+#include "itkGPUAffineTransformFactory.h"
+#include "itkGPUBSplineTransformFactory.h"
+#include "itkGPUIdentityTransformFactory.h"
+#include "itkGPUTranslationTransformFactory.h"
+#include "itkGPUNearestNeighborInterpolateImageFunctionFactory.h"
+#include "itkGPULinearInterpolateImageFunctionFactory.h"
+#include "itkGPUBSplineInterpolateImageFunctionFactory.h"
+
+// GPU filters without a factory
+#include "itkGPUAdvancedMeanSquaresImageToImageMetric.h"
+
+// ITK include files
+#include "itkAffineTransform.h"
+#include "itkBSplineDecompositionImageFilter.h"
+#include "itkBSplineInterpolateImageFunction.h"
+#include "itkBSplineTransform.h"
+#include "itkCastImageFilter.h"
+#include "itkIdentityTransform.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkNearestNeighborInterpolateImageFunction.h"
+#include "itkRecursiveGaussianImageFilter.h"
+#include "itkResampleImageFilter.h"
+#include "itkShrinkImageFilter.h"
+#include "itkTranslationTransform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip> // setprecision, etc.
+#include <sstream>
+
+//------------------------------------------------------------------------------
+// Definition of the types used by the benchmark
+const unsigned int Dimension = 3;
+typedef short                                   InputPixelType;
+typedef float                                   FloatPixelType;
+typedef itk::Image< InputPixelType, Dimension > InputImageType;
+typedef itk::Image< FloatPixelType, Dimension > FloatImageType;
+typedef typelist::MakeTypeList< short, float >::Type OCLImageTypes;
+
+typedef float                                                              ScalarType;
+typedef itk::ResampleImageFilter< InputImageType, InputImageType, ScalarType > ResampleFilterType;
+typedef ResampleFilterType::TransformType                                  TransformType;
+typedef ResampleFilterType::InterpolatorType                               InterpolatorType;
+typedef itk::IdentityTransform< ScalarType, Dimension >                    IdentityTransformType;
+typedef itk::TranslationTransform< ScalarType, Dimension >                 TranslationTransformType;
+typedef itk::AffineTransform< ScalarType, Dimension >                      AffineTransformType;
+typedef itk::BSplineTransform< ScalarType, Dimension, 3 >                  BSplineTransformType;
+typedef itk::GPUTransformCopier< OCLImageTypes, OCLImageDims, TransformType, ScalarType >
+  TransformCopierType;
+typedef itk::GPUInterpolatorCopier< OCLImageTypes, OCLImageDims, InterpolatorType, ScalarType >
+  InterpolatorCopierType;
+
+//------------------------------------------------------------------------------
+// The result of one benchmark, for one image size. The GPU time is zero
+// until the GPU phase has run, the CPU time is zero if the benchmark has no
+// CPU counterpart.
+struct BenchmarkResult
+{
+  std::string  m_Name;
+  std::string  m_Kernels;
+  unsigned int m_Size;
+  double       m_CPUTime;
+  double       m_GPUTime;
+
+  double GetSpeedup( void ) const
+  {
+    return ( this->m_CPUTime > 0.0 && this->m_GPUTime > 0.0 )
+           ? this->m_CPUTime / this->m_GPUTime : 0.0;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Collects the results. The CPU phase adds them, the GPU phase visits them in
+// the same order and fills in the GPU times.
+class BenchmarkResults
+{
+public:
+
+  BenchmarkResults() : m_GPUPhase( false ), m_Next( 0 ) {}
+
+  void StartGPUPhase( void )
+  {
+    this->m_GPUPhase = true;
+    this->m_Next     = 0;
+  }
+
+  bool IsGPUPhase( void ) const { return this->m_GPUPhase; }
+
+  void Add( const std::string & name, const std::string & kernels,
+    const unsigned int size, const double seconds )
+  {
+    if( !this->m_GPUPhase )
+    {
+      BenchmarkResult result = { name, kernels, size, seconds, 0.0 };
+      this->m_Results.push_back( result );
+      return;
+    }
+
+    // GPU only benchmarks are not run in the CPU phase
+    if( this->m_Next == this->m_Results.size()
+      || this->m_Results[ this->m_Next ].m_Name != name
+      || this->m_Results[ this->m_Next ].m_Size != size )
+    {
+      BenchmarkResult result = { name, kernels, size, 0.0, seconds };
+      this->m_Results.insert( this->m_Results.begin() + this->m_Next, result );
+    }
+    else
+    {
+      this->m_Results[ this->m_Next ].m_GPUTime = seconds;
+    }
+    ++this->m_Next;
+  }
+
+  const std::vector< BenchmarkResult > & GetResults( void ) const { return this->m_Results; }
+
+private:
+
+  std::vector< BenchmarkResult > m_Results;
+  bool                           m_GPUPhase;
+  std::size_t                    m_Next;
+};
+
+//------------------------------------------------------------------------------
+// GetHelpString
+std::string
+GetHelpString( void )
+{
+  std::stringstream ss;
+
+  ss << "Usage:" << std::endl
+     << "itkOpenCLBenchmark" << std::endl
+     << "  [-sizes]      the sizes of the cubic test images, default 64 128 256\n"
+     << "  [-runs]       number of timed runs per benchmark, default 3\n"
+     << "  [-csv]        write the results to this CSV file\n"
+     << "  [-json]       write the results to this JSON file\n"
+     << "  [-threads]    number of CPU threads, default maximum\n";
+  return ss.str();
+} // end GetHelpString()
+
+
+//------------------------------------------------------------------------------
+// Create a cubic image of the given size with a smooth synthetic pattern.
+// After the GPU image factory has been registered this creates a GPUImage.
+template< typename ImageType >
+typename ImageType::Pointer
+CreateImage( const unsigned int size )
+{
+  typename ImageType::SizeType imageSize;
+  imageSize.Fill( size );
+  typename ImageType::SpacingType spacing;
+  spacing.Fill( 256.0 / size );
+
+  typename ImageType::Pointer image = ImageType::New();
+  image->SetRegions( typename ImageType::RegionType( imageSize ) );
+  image->SetSpacing( spacing );
+  image->Allocate();
+
+  itk::ImageRegionIteratorWithIndex< ImageType > it( image, image->GetBufferedRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    typename ImageType::PointType point;
+    image->TransformIndexToPhysicalPoint( it.GetIndex(), point );
+    const double value = 1000.0 * std::sin( point[ 0 ] / 16.0 )
+      * std::cos( point[ 1 ] / 24.0 ) + 4.0 * point[ 2 ];
+    it.Set( static_cast< typename ImageType::PixelType >( value ) );
+  }
+
+  return image;
+} // end CreateImage()
+
+
+//------------------------------------------------------------------------------
+// Time the filter, including copying its output back to the host, and return
+// the mean time of one run. The first run is not timed, it allocates the
+// buffers and copies the input to the device.
+template< typename FilterType >
+double
+TimeFilter( FilterType * filter, const std::string & message,
+  const unsigned int runs, const bool gpu )
+{
+  filter->Update();
+  filter->GetOutput()->GetBufferPointer();
+
+  itk::OpenCLContext::Pointer   context = itk::OpenCLContext::GetInstance();
+  itk::OpenCLProfilingTimeProbe probe( ( gpu ? "GPU " : "CPU " ) + message,
+    gpu ? context->GetActiveDevice() : itk::OpenCLDevice() );
+  for( unsigned int i = 0; i < runs; ++i )
+  {
+    filter->Modified();
+    filter->Update();
+    filter->GetOutput()->GetBufferPointer(); // updates the CPU buffer of a GPUImage
+  }
+  return probe.Stop() / runs;
+} // end TimeFilter()
+
+
+//------------------------------------------------------------------------------
+// Benchmark the image filters that run one kernel each.
+void
+BenchmarkImageFilters( const unsigned int size, const unsigned int runs,
+  BenchmarkResults & results )
+{
+  const bool         gpu = results.IsGPUPhase();
+  std::ostringstream sizeString;
+  sizeString << " " << size << "^3";
+
+  InputImageType::Pointer inputImage = CreateImage< InputImageType >( size );
+  FloatImageType::Pointer floatImage = CreateImage< FloatImageType >( size );
+
+  typedef itk::CastImageFilter< InputImageType, FloatImageType > CastFilterType;
+  CastFilterType::Pointer cast = CastFilterType::New();
+  cast->SetInput( inputImage );
+  results.Add( "CastImageFilter", "GPUCastImageFilter.cl", size,
+    TimeFilter( cast.GetPointer(), "CastImageFilter" + sizeString.str(), runs, gpu ) );
+
+  typedef itk::ShrinkImageFilter< FloatImageType, FloatImageType > ShrinkFilterType;
+  ShrinkFilterType::Pointer shrink = ShrinkFilterType::New();
+  shrink->SetInput( floatImage );
+  shrink->SetShrinkFactors( 2 );
+  results.Add( "ShrinkImageFilter", "GPUShrinkImageFilter.cl", size,
+    TimeFilter( shrink.GetPointer(), "ShrinkImageFilter" + sizeString.str(), runs, gpu ) );
+
+  typedef itk::RecursiveGaussianImageFilter< FloatImageType, FloatImageType > RecursiveGaussianFilterType;
+  RecursiveGaussianFilterType::Pointer gaussian = RecursiveGaussianFilterType::New();
+  gaussian->SetInput( floatImage );
+  gaussian->SetSigma( 3.0 );
+  gaussian->SetDirection( 0 );
+  results.Add( "RecursiveGaussianImageFilter", "GPURecursiveGaussianImageFilter.cl", size,
+    TimeFilter( gaussian.GetPointer(), "RecursiveGaussianImageFilter" + sizeString.str(), runs, gpu ) );
+
+  typedef itk::BSplineDecompositionImageFilter< FloatImageType, FloatImageType > DecompositionFilterType;
+  DecompositionFilterType::Pointer decomposition = DecompositionFilterType::New();
+  decomposition->SetInput( floatImage );
+  decomposition->SetSplineOrder( 3 );
+  results.Add( "BSplineDecompositionImageFilter", "GPUBSplineDecompositionImageFilter.cl", size,
+    TimeFilter( decomposition.GetPointer(), "BSplineDecompositionImageFilter" + sizeString.str(), runs, gpu ) );
+} // end BenchmarkImageFilters()
+
+
+//------------------------------------------------------------------------------
+// Create a B-spline transform with a grid of 8^3 cells over an image of the
+// given size. The parameters are stored in \a bsplineParameters, because the
+// transform does not copy them.
+BSplineTransformType::Pointer
+CreateBSplineTransform( const unsigned int size,
+  BSplineTransformType::ParametersType & bsplineParameters )
+{
+  BSplineTransformType::Pointer transform = BSplineTransformType::New();
+  BSplineTransformType::OriginType origin;
+  origin.Fill( 0.0 );
+  BSplineTransformType::PhysicalDimensionsType physicalDimensions;
+  physicalDimensions.Fill( 256.0 * ( size - 1.0 ) / size );
+  BSplineTransformType::MeshSizeType meshSize;
+  meshSize.Fill( 8 );
+  transform->SetTransformDomainOrigin( origin );
+  transform->SetTransformDomainPhysicalDimensions( physicalDimensions );
+  transform->SetTransformDomainMeshSize( meshSize );
+
+  bsplineParameters.SetSize( transform->GetNumberOfParameters() );
+  for( unsigned int i = 0; i < bsplineParameters.GetSize(); ++i )
+  {
+    bsplineParameters[ i ] = 4.0 * std::sin( 0.37 * i );
+  }
+  transform->SetParameters( bsplineParameters );
+  return transform;
+} // end CreateBSplineTransform()
+
+
+//------------------------------------------------------------------------------
+// Create a transform with a small deformation of an image of the given size.
+// The B-spline parameters are stored in \a bsplineParameters.
+TransformType::Pointer
+CreateTransform( const std::string & transformName, const unsigned int size,
+  BSplineTransformType::ParametersType & bsplineParameters )
+{
+  const double physicalSize = 256.0 * ( size - 1.0 ) / size;
+  if( transformName == "Identity" )
+  {
+    return IdentityTransformType::New().GetPointer();
+  }
+  else if( transformName == "Translation" )
+  {
+    TranslationTransformType::Pointer transform = TranslationTransformType::New();
+    TranslationTransformType::OutputVectorType translation;
+    translation[ 0 ] = 7.5; translation[ 1 ] = -3.25; translation[ 2 ] = 1.5;
+    transform->Translate( translation );
+    return transform.GetPointer();
+  }
+  else if( transformName == "Affine" )
+  {
+    AffineTransformType::Pointer transform = AffineTransformType::New();
+    AffineTransformType::InputPointType center;
+    center.Fill( physicalSize / 2.0 );
+    transform->SetCenter( center );
+    transform->Rotate( 0, 1, 0.1 );
+    transform->Scale( 1.05 );
+    AffineTransformType::OutputVectorType translation;
+    translation.Fill( 2.5 );
+    transform->Translate( translation );
+    return transform.GetPointer();
+  }
+
+  return CreateBSplineTransform( size, bsplineParameters ).GetPointer();
+} // end CreateTransform()
+
+
+//------------------------------------------------------------------------------
+// Create an interpolator.
+InterpolatorType::Pointer
+CreateInterpolator( const std::string & interpolatorName )
+{
+  if( interpolatorName == "NearestNeighbor" )
+  {
+    return itk::NearestNeighborInterpolateImageFunction< InputImageType, ScalarType >::New().GetPointer();
+  }
+  else if( interpolatorName == "Linear" )
+  {
+    return itk::LinearInterpolateImageFunction< InputImageType, ScalarType >::New().GetPointer();
+  }
+
+  typedef itk::BSplineInterpolateImageFunction< InputImageType, ScalarType, ScalarType > BSplineInterpolatorType;
+  BSplineInterpolatorType::Pointer interpolator = BSplineInterpolatorType::New();
+  interpolator->SetSplineOrder( 3 );
+  return interpolator.GetPointer();
+} // end CreateInterpolator()
+
+
+//------------------------------------------------------------------------------
+// Benchmark the resampler end-to-end, for all combinations of the transforms
+// and interpolators.
+void
+BenchmarkResampling( const unsigned int size, const unsigned int runs,
+  BenchmarkResults & results )
+{
+  const bool gpu = results.IsGPUPhase();
+  const char * transformNames[] = { "Identity", "Translation", "Affine", "BSpline" };
+  const char * transformKernels[] = { "GPUIdentityTransform.cl", "GPUTranslationTransformBase.cl",
+                                      "GPUMatrixOffsetTransformBase.cl", "GPUBSplineTransform.cl" };
+  const char * interpolatorNames[] = { "NearestNeighbor", "Linear", "BSpline" };
+  const char * interpolatorKernels[] = { "GPUNearestNeighborInterpolateImageFunction.cl",
+                                         "GPULinearInterpolateImageFunction.cl",
+                                         "GPUBSplineInterpolateImageFunction.cl" };
+
+  InputImageType::Pointer inputImage = CreateImage< InputImageType >( size );
+
+  for( unsigned int t = 0; t < 4; ++t )
+  {
+    for( unsigned int i = 0; i < 3; ++i )
+    {
+      BSplineTransformType::ParametersType bsplineParameters;
+      TransformType::Pointer    transform    = CreateTransform( transformNames[ t ], size, bsplineParameters );
+      InterpolatorType::Pointer interpolator = CreateInterpolator( interpolatorNames[ i ] );
+      if( gpu )
+      {
+        TransformCopierType::Pointer transformCopier = TransformCopierType::New();
+        transformCopier->SetInputTransform( transform );
+        transformCopier->SetExplicitMode( false );
+        transformCopier->Update();
+        transform = transformCopier->GetModifiableOutput();
+
+        InterpolatorCopierType::Pointer interpolatorCopier = InterpolatorCopierType::New();
+        interpolatorCopier->SetInputInterpolator( interpolator );
+        interpolatorCopier->SetExplicitMode( false );
+        interpolatorCopier->Update();
+        interpolator = interpolatorCopier->GetModifiableOutput();
+      }
+
+      ResampleFilterType::Pointer resampler = ResampleFilterType::New();
+      resampler->SetInput( inputImage );
+      resampler->SetTransform( transform );
+      resampler->SetInterpolator( interpolator );
+      resampler->SetDefaultPixelValue( -1 );
+      resampler->SetOutputParametersFromImage( inputImage );
+
+      const std::string name = std::string( "ResampleImageFilter " )
+        + transformNames[ t ] + " " + interpolatorNames[ i ];
+      const std::string kernels = std::string( "GPUResampleImageFilter.cl;" )
+        + transformKernels[ t ] + ";" + interpolatorKernels[ i ];
+      std::ostringstream message;
+      message << name << " " << size << "^3";
+      results.Add( name, kernels, size,
+        TimeFilter( resampler.GetPointer(), message.str(), runs, gpu ) );
+    }
+  }
+} // end BenchmarkResampling()
+
+
+//------------------------------------------------------------------------------
+// Benchmark the value and derivative of the mean squares metric for a
+// B-spline transform. There is no CPU counterpart in ITK, so this benchmark
+// only has a GPU time.
+void
+BenchmarkMetric( const unsigned int size, const unsigned int runs,
+  BenchmarkResults & results )
+{
+  typedef itk::GPUAdvancedMeanSquaresImageToImageMetric< FloatImageType, FloatImageType > MetricType;
+
+  FloatImageType::Pointer image = CreateImage< FloatImageType >( size );
+
+  // Sample every second voxel in each dimension
+  std::vector< FloatImageType::PointType > points;
+  std::vector< float >                     values;
+  itk::ImageRegionIteratorWithIndex< FloatImageType > it( image, image->GetBufferedRegion() );
+  for( it.GoToBegin(); !it.IsAtEnd(); ++it )
+  {
+    const FloatImageType::IndexType index = it.GetIndex();
+    if( index[ 0 ] % 2 == 0 && index[ 1 ] % 2 == 0 && index[ 2 ] % 2 == 0 )
+    {
+      FloatImageType::PointType point;
+      image->TransformIndexToPhysicalPoint( index, point );
+      points.push_back( point );
+      values.push_back( it.Get() );
+    }
+  }
+
+  BSplineTransformType::ParametersType bsplineParameters;
+  BSplineTransformType::Pointer        bsplineTransform = CreateBSplineTransform( size, bsplineParameters );
+
+  MetricType::Pointer metric = MetricType::New();
+  metric->SetMovingImage( image );
+  metric->SetFixedSamples( points, values );
+  metric->SetGrid( bsplineTransform->GetCoefficientImages()[ 0 ].GetPointer(), 3 );
+
+  MetricType::ParametersType parameters( bsplineParameters.GetSize() );
+  for( unsigned int i = 0; i < parameters.GetSize(); ++i )
+  {
+    parameters[ i ] = bsplineParameters[ i ];
+  }
+
+  double                     measure = 0.0;
+  MetricType::DerivativeType derivative;
+  itk::SizeValueType         numberOfPixelsCounted = 0;
+  metric->GetValueAndDerivative( parameters, measure, derivative, numberOfPixelsCounted );
+
+  std::ostringstream message;
+  message << "GPU AdvancedMeanSquaresImageToImageMetric " << size << "^3";
+  itk::OpenCLProfilingTimeProbe probe( message.str(),
+    itk::OpenCLContext::GetInstance()->GetActiveDevice() );
+  for( unsigned int i = 0; i < runs; ++i )
+  {
+    metric->GetValueAndDerivative( parameters, measure, derivative, numberOfPixelsCounted );
+  }
+  results.Add( "AdvancedMeanSquaresImageToImageMetric",
+    "GPUAdvancedMeanSquaresImageToImageMetric.cl;GPUBSplineTransform.cl", size,
+    probe.Stop() / runs );
+} // end BenchmarkMetric()
+
+
+//------------------------------------------------------------------------------
+// Write the results as CSV, one line per benchmark and image size.
+bool
+WriteCSV( const std::string & fileName, const std::string & deviceName,
+  const BenchmarkResults & results )
+{
+  std::ofstream file( fileName.c_str() );
+  if( !file.is_open() )
+  {
+    std::cerr << "ERROR: could not open " << fileName << " for writing." << std::endl;
+    return false;
+  }
+
+  file << "device,benchmark,kernels,size,cpu_seconds,gpu_seconds,speedup\n";
+  const std::vector< BenchmarkResult > & benchmarks = results.GetResults();
+  for( std::size_t i = 0; i < benchmarks.size(); ++i )
+  {
+    const BenchmarkResult & result = benchmarks[ i ];
+    file << "\"" << deviceName << "\",\"" << result.m_Name << "\",\"" << result.m_Kernels << "\","
+         << result.m_Size << "," << result.m_CPUTime << "," << result.m_GPUTime << ","
+         << result.GetSpeedup() << "\n";
+  }
+  return true;
+} // end WriteCSV()
+
+
+//------------------------------------------------------------------------------
+// Write the results as JSON, an object with the device and the list of
+// benchmarks.
+bool
+WriteJSON( const std::string & fileName, const std::string & deviceName,
+  const BenchmarkResults & results )
+{
+  std::ofstream file( fileName.c_str() );
+  if( !file.is_open() )
+  {
+    std::cerr << "ERROR: could not open " << fileName << " for writing." << std::endl;
+    return false;
+  }
+
+  file << "{\n  \"device\": \"" << deviceName << "\",\n  \"benchmarks\": [\n";
+  const std::vector< BenchmarkResult > & benchmarks = results.GetResults();
+  for( std::size_t i = 0; i < benchmarks.size(); ++i )
+  {
+    const BenchmarkResult & result = benchmarks[ i ];
+    file << "    { \"benchmark\": \"" << result.m_Name << "\", \"kernels\": \"" << result.m_Kernels
+         << "\", \"size\": " << result.m_Size << ", \"cpu_seconds\": " << result.m_CPUTime
+         << ", \"gpu_seconds\": " << result.m_GPUTime << ", \"speedup\": " << result.GetSpeedup()
+         << ( i + 1 < benchmarks.size() ? " },\n" : " }\n" );
+  }
+  file << "  ]\n}\n";
+  return true;
+} // end WriteJSON()
+
+
+//------------------------------------------------------------------------------
+// This program benchmarks the OpenCL kernels of elastix against the CPU
+// versions of the filters, on synthetic images of several sizes:
+// the cast, shrink, recursive Gaussian and B-spline decomposition filters,
+// the mean squares metric, and the resampler end-to-end for the identity,
+// translation, affine and B-spline transforms with the nearest neighbor,
+// linear and B-spline interpolators. The times include copying the output
+// back to the host. The results are printed, and can be written as CSV or
+// JSON to track them over time.
+int
+main( int argc, char * argv[] )
+{
+  // Setup for debugging
+  itk::SetupForDebugging();
+
+  // Create and check OpenCL context
+  if( !itk::CreateContext() )
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Create a command line argument parser
+  itk::CommandLineArgumentParser::Pointer parser = itk::CommandLineArgumentParser::New();
+  parser->SetCommandLineArguments( argc, argv );
+  parser->SetProgramHelpText( GetHelpString() );
+
+  itk::CommandLineArgumentParser::ReturnValue validateArguments = parser->CheckForRequiredArguments();
+  if( validateArguments == itk::CommandLineArgumentParser::FAILED )
+  {
+    itk::ReleaseContext();
+    return EXIT_FAILURE;
+  }
+  else if( validateArguments == itk::CommandLineArgumentParser::HELPREQUESTED )
+  {
+    itk::ReleaseContext();
+    return EXIT_SUCCESS;
+  }
+
+  // Get command line arguments
+  std::vector< unsigned int > sizes;
+  parser->GetCommandLineArgument( "-sizes", sizes );
+  if( sizes.empty() )
+  {
+    sizes.push_back( 64 );
+    sizes.push_back( 128 );
+    sizes.push_back( 256 );
+  }
+
+  unsigned int runs = 3;
+  parser->GetCommandLineArgument( "-runs", runs );
+  runs = std::max( runs, 1u );
+
+  std::string csvFileName = "";
+  parser->GetCommandLineArgument( "-csv", csvFileName );
+  std::string jsonFileName = "";
+  parser->GetCommandLineArgument( "-json", jsonFileName );
+
+  unsigned int maximumNumberOfThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+  parser->GetCommandLineArgument( "-threads", maximumNumberOfThreads );
+  itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads( maximumNumberOfThreads );
+
+  const std::string deviceName = itk::OpenCLContext::GetInstance()->GetDefaultDevice().GetName();
+  std::cout << std::showpoint << std::setprecision( 4 );
+  std::cout << "Benchmarking device " << deviceName << " against "
+            << maximumNumberOfThreads << " CPU threads, " << runs << " runs.\n";
+
+  BenchmarkResults results;
+  try
+  {
+    // Run the CPU phase
+    for( std::size_t s = 0; s < sizes.size(); ++s )
+    {
+      BenchmarkImageFilters( sizes[ s ], runs, results );
+      BenchmarkResampling( sizes[ s ], runs, results );
+    }
+
+    // Register the GPU factories, from now on the filters, images, transforms
+    // and interpolators that are created are the GPU versions.
+    itk::GPUImageFactory2< OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+    itk::GPUCastImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+    itk::GPUShrinkImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+    itk::GPURecursiveGaussianImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+    itk::GPUBSplineDecompositionImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+    itk::GPUResampleImageFilterFactory2< OCLImageTypes, OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+    itk::GPUIdentityTransformFactory2< OCLImageDims >::RegisterOneFactory();
+    itk::GPUTranslationTransformFactory2< OCLImageDims >::RegisterOneFactory();
+    itk::GPUAffineTransformFactory2< OCLImageDims >::RegisterOneFactory();
+    itk::GPUBSplineTransformFactory2< OCLImageDims >::RegisterOneFactory();
+    itk::GPUNearestNeighborInterpolateImageFunctionFactory2< OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+    itk::GPULinearInterpolateImageFunctionFactory2< OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+    itk::GPUBSplineInterpolateImageFunctionFactory2< OCLImageTypes, OCLImageDims >::RegisterOneFactory();
+
+    // Run the GPU phase
+    results.StartGPUPhase();
+    for( std::size_t s = 0; s < sizes.size(); ++s )
+    {
+      BenchmarkImageFilters( sizes[ s ], runs, results );
+      BenchmarkMetric( sizes[ s ], runs, results );
+      BenchmarkResampling( sizes[ s ], runs, results );
+    }
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    std::cerr << "ERROR: " << e << std::endl;
+    itk::ReleaseContext();
+    return EXIT_FAILURE;
+  }
+
+  // Print the results
+  std::cout << "\nbenchmark size CPU GPU speedup\n";
+  const std::vector< BenchmarkResult > & benchmarks = results.GetResults();
+  for( std::size_t i = 0; i < benchmarks.size(); ++i )
+  {
+    std::cout << benchmarks[ i ].m_Name << " " << benchmarks[ i ].m_Size
+              << " " << benchmarks[ i ].m_CPUTime << " " << benchmarks[ i ].m_GPUTime
+              << " " << benchmarks[ i ].GetSpeedup() << std::endl;
+  }
+
+  bool written = true;
+  if( !csvFileName.empty() )
+  {
+    written = WriteCSV( csvFileName, deviceName, results ) && written;
+  }
+  if( !jsonFileName.empty() )
+  {
+    written = WriteJSON( jsonFileName, deviceName, results ) && written;
+  }
+
+  itk::ReleaseContext();
+  return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
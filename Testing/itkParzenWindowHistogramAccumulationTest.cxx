@@ -0,0 +1,192 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkParzenWindowMutualInformationImageToImageMetric.h"
+
+#include "itkMetricTestHelper.h"
+
+#include <sstream>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// The metric under test, which gives access to its joint histogram.
+class TestMetric :
+  public itk::ParzenWindowMutualInformationImageToImageMetric< ImageType, ImageType >
+{
+public:
+
+  typedef TestMetric                                                                  Self;
+  typedef itk::ParzenWindowMutualInformationImageToImageMetric< ImageType, ImageType > Superclass;
+  typedef itk::SmartPointer< Self >                                                   Pointer;
+  typedef Superclass::JointPDFType                                                    JointPDFType;
+
+  itkNewMacro( Self );
+  itkTypeMacro( TestMetric, ParzenWindowMutualInformationImageToImageMetric );
+
+  /** The normalized joint histogram of the last evaluation. */
+  const JointPDFType * GetJointPDF( void ) const { return this->m_JointPDF.GetPointer(); }
+
+protected:
+
+  TestMetric() {}
+  ~TestMetric() override {}
+
+};
+
+//------------------------------------------------------------------------------
+// The results of one metric configuration: the joint histogram and the value
+// of GetValue(), and the results of GetValueAndDerivative().
+struct HistogramResults
+{
+  std::vector< double > m_JointPDF;
+  double                m_Value;
+  MetricResults         m_ValueAndDerivative;
+};
+
+//------------------------------------------------------------------------------
+// Evaluate the value, the joint histogram and the derivative of the mutual
+// information for one configuration. The derivative is computed from the
+// joint histogram, without explicit joint histogram derivatives, so that it
+// depends on the accumulation of the histogram.
+HistogramResults
+EvaluateHistogram( const ImageType * fixedImage, const ImageType * movingImage,
+  CombinationTransformType * transform, const BSplineTransformType::ParametersType & parameters,
+  const MetricSettings & settings, const bool useShardedPDFAccumulation,
+  const unsigned int fixedKernelBSplineOrder, const unsigned int movingKernelBSplineOrder )
+{
+  const std::function< void( TestMetric * ) > configure
+    = [ useShardedPDFAccumulation, fixedKernelBSplineOrder, movingKernelBSplineOrder ]( TestMetric * metric )
+    {
+      metric->SetUseDerivative( true );
+      metric->SetUseExplicitPDFDerivatives( false );
+      metric->SetFixedKernelBSplineOrder( fixedKernelBSplineOrder );
+      metric->SetMovingKernelBSplineOrder( movingKernelBSplineOrder );
+      metric->SetUseShardedPDFAccumulation( useShardedPDFAccumulation );
+    };
+  const TestMetric::Pointer metric
+    = CreateMetric< TestMetric >( fixedImage, movingImage, transform, settings, configure );
+
+  HistogramResults results;
+  results.m_Value = metric->GetValue( parameters );
+
+  const TestMetric::JointPDFType * jointPDF = metric->GetJointPDF();
+  results.m_JointPDF.assign( jointPDF->GetBufferPointer(),
+    jointPDF->GetBufferPointer() + jointPDF->GetBufferedRegion().GetNumberOfPixels() );
+
+  metric->GetValueAndDerivative( parameters,
+    results.m_ValueAndDerivative.m_Value, results.m_ValueAndDerivative.m_Derivative );
+  return results;
+} // end EvaluateHistogram()
+
+
+//------------------------------------------------------------------------------
+// Compare the results of a configuration with the reference results, up to
+// the rounding differences of summing in another order. The sharded joint
+// histogram adds the samples to each bin in the original order, so with
+// exactPDF its joint histogram and value must be equal to the reference.
+bool
+CompareHistogramResults( const HistogramResults & reference, const HistogramResults & results,
+  const bool exactPDF, const std::string & description )
+{
+  const double tolerance    = 1e-10;
+  const double pdfTolerance = exactPDF ? 0.0 : tolerance;
+  bool         equal        = reference.m_JointPDF.size() == results.m_JointPDF.size();
+
+  double maximumPDFDifference = 0.0;
+  for( std::size_t i = 0; equal && i < reference.m_JointPDF.size(); ++i )
+  {
+    maximumPDFDifference = std::max( maximumPDFDifference,
+      std::abs( reference.m_JointPDF[ i ] - results.m_JointPDF[ i ] ) );
+  }
+
+  equal = equal
+    && maximumPDFDifference <= pdfTolerance
+    && std::abs( reference.m_Value - results.m_Value ) <= pdfTolerance * std::abs( reference.m_Value );
+
+  if( !equal )
+  {
+    std::cerr << "ERROR: " << description << " differs from the single-threaded computation:\n"
+              << "  value " << results.m_Value << " instead of " << reference.m_Value << "\n"
+              << "  maximum joint histogram difference " << maximumPDFDifference << std::endl;
+  }
+  return CompareResults( reference.m_ValueAndDerivative, results.m_ValueAndDerivative,
+    tolerance, description, "the single-threaded computation" ) && equal;
+} // end CompareHistogramResults()
+
+
+//------------------------------------------------------------------------------
+// This test checks that the threaded joint histogram accumulation of the
+// ParzenWindowHistogramImageToImageMetric, both with thread-private joint
+// histograms filled in blocks of samples and with the sharded joint
+// histogram, gives the same joint histogram, value and derivative as the
+// single-threaded computation, which fills one joint histogram sample by
+// sample. The sharded joint histogram and value must be exactly equal. This
+// is checked for several numbers of threads and kernel orders.
+int
+main( void )
+{
+  const ImageType::Pointer fixedImage  = CreateImage( 16, 0.0 );
+  const ImageType::Pointer movingImage = CreateImage( 16, 6.0 );
+
+  BSplineTransformType::ParametersType    parameters;
+  const CombinationTransformType::Pointer transform = CreateTransform( fixedImage, 6, parameters );
+
+  const unsigned int numberOfThreads[] = { 1, 2, 3, 4, 7 };
+  const unsigned int kernelOrders[][ 2 ] = { { 0, 3 }, { 3, 3 }, { 1, 2 } };
+
+  bool passed = true;
+  try
+  {
+    for( unsigned int k = 0; k < sizeof( kernelOrders ) / sizeof( kernelOrders[ 0 ] ); ++k )
+    {
+      const unsigned int     fixedOrder        = kernelOrders[ k ][ 0 ];
+      const unsigned int     movingOrder       = kernelOrders[ k ][ 1 ];
+      const MetricSettings   referenceSettings = { false, 1, false };
+      const HistogramResults reference         = EvaluateHistogram( fixedImage, movingImage,
+        transform, parameters, referenceSettings, false, fixedOrder, movingOrder );
+
+      for( unsigned int t = 0; t < sizeof( numberOfThreads ) / sizeof( numberOfThreads[ 0 ] ); ++t )
+      {
+        for( unsigned int sharded = 0; sharded < 2; ++sharded )
+        {
+          const MetricSettings   settings = { true, numberOfThreads[ t ], false };
+          const HistogramResults results  = EvaluateHistogram( fixedImage, movingImage,
+            transform, parameters, settings, sharded == 1, fixedOrder, movingOrder );
+
+          std::ostringstream description;
+          description << "The " << ( sharded == 1 ? "sharded" : "thread-private" )
+                      << " accumulation with " << numberOfThreads[ t ] << " threads and kernel orders "
+                      << fixedOrder << " and " << movingOrder;
+          passed = CompareHistogramResults( reference, results, sharded == 1, description.str() ) && passed;
+        }
+      }
+    }
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    std::cerr << "ERROR: the metric could not be evaluated:\n" << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( !passed )
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "The threaded joint histograms equal the single-threaded one." << std::endl;
+  return EXIT_SUCCESS;
+}
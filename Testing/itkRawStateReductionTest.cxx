@@ -0,0 +1,92 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkAdvancedMeanSquaresImageToImageMetric.h"
+
+#include "itkMetricTestHelper.h"
+
+//------------------------------------------------------------------------------
+// Definition of the metric used by the test
+typedef itk::AdvancedMeanSquaresImageToImageMetric< ImageType, ImageType > MetricType;
+
+//------------------------------------------------------------------------------
+// This test checks the RawStateReductionFunction of the
+// AdvancedMeanSquaresImageToImageMetric. The reduction simulates two
+// processes that hold the same samples, by doubling each entry of the raw
+// state. The metric normalizes the reduced sums, so that the value and the
+// derivative must equal those of one process, and it must reduce its sums
+// and its derivative in one call each. This is checked for the
+// single-threaded and the multi-threaded evaluation.
+int
+main( void )
+{
+  const ImageType::Pointer fixedImage  = CreateImage( 16, 0.0 );
+  const ImageType::Pointer movingImage = CreateImage( 16, 6.0 );
+
+  BSplineTransformType::ParametersType    parameters;
+  const CombinationTransformType::Pointer transform = CreateTransform( fixedImage, 6, parameters );
+
+  bool passed = true;
+  try
+  {
+    for( unsigned int m = 0; m < 2; ++m )
+    {
+      const MetricSettings settings  = { m == 1, 4, false };
+      const MetricResults  reference = EvaluateMetric< MetricType >(
+        fixedImage, movingImage, transform, parameters, settings );
+
+      unsigned int numberOfReductions = 0;
+      const std::function< void( MetricType * ) > configure = [ &numberOfReductions ]( MetricType * metric )
+      {
+        metric->SetRawStateReductionFunction(
+          [ &numberOfReductions ]( double * rawState, const itk::SizeValueType size )
+          {
+            ++numberOfReductions;
+            for( itk::SizeValueType i = 0; i < size; ++i )
+            {
+              rawState[ i ] *= 2.0;
+            }
+          } );
+      };
+      const MetricResults reduced = EvaluateMetric< MetricType >(
+        fixedImage, movingImage, transform, parameters, settings, configure );
+
+      const std::string description = m == 1
+        ? "The multi-threaded reduced evaluation" : "The single-threaded reduced evaluation";
+      passed = CompareResults( reference, reduced, 1e-12, description, "the evaluation of one process" ) && passed;
+      if( numberOfReductions != 2 )
+      {
+        std::cerr << "ERROR: " << description << " reduced its raw state "
+                  << numberOfReductions << " times instead of 2" << std::endl;
+        passed = false;
+      }
+    }
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    std::cerr << "ERROR: the metric could not be evaluated:\n" << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( !passed )
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "The metric reduces its raw state before the normalization." << std::endl;
+  return EXIT_SUCCESS;
+}
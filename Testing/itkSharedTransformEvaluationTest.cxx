@@ -0,0 +1,252 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkCombinationImageToImageMetric.h"
+#include "itkAdvancedMeanSquaresImageToImageMetric.h"
+
+#include "itkMetricTestHelper.h"
+
+#include <atomic>
+
+//------------------------------------------------------------------------------
+// Definition of the types used by the test
+typedef itk::ImageFullSampler< ImageType >                                 ImageSamplerType;
+typedef itk::AdvancedMeanSquaresImageToImageMetric< ImageType, ImageType > MetricType;
+typedef itk::CombinationImageToImageMetric< ImageType, ImageType >         CombinationMetricType;
+
+//------------------------------------------------------------------------------
+// A combination transform that counts how many points it maps, and how many
+// sparse Jacobians it evaluates, so that the test can check which of them
+// are looked up in the shared transform evaluation instead.
+class CountingTransform :
+  public CombinationTransformType
+{
+public:
+
+  /** Standard class typedefs. */
+  typedef CountingTransform               Self;
+  typedef CombinationTransformType        Superclass;
+  typedef itk::SmartPointer< Self >       Pointer;
+  typedef itk::SmartPointer< const Self > ConstPointer;
+
+  /** Some stuff that is needed to get this class functional. */
+  itkNewMacro( Self );
+  itkTypeMacro( CountingTransform, AdvancedCombinationTransform );
+
+  /** The evaluations of the transform, which are counted. */
+  OutputPointType TransformPoint( const InputPointType & point ) const override
+  {
+    ++this->m_NumberOfTransformedPoints;
+    return Superclass::TransformPoint( point );
+  }
+
+
+  void TransformPoints( const InputPointType * inputPoints,
+    OutputPointType * outputPoints, const SizeValueType n ) const override
+  {
+    this->m_NumberOfTransformedPoints += n;
+    Superclass::TransformPoints( inputPoints, outputPoints, n );
+  }
+
+
+  void GetJacobian( const InputPointType & ipp, JacobianType & j,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override
+  {
+    ++this->m_NumberOfJacobians;
+    Superclass::GetJacobian( ipp, j, nonZeroJacobianIndices );
+  }
+
+
+  void EvaluateJacobianWithImageGradientProduct( const InputPointType & ipp,
+    const MovingImageGradientType & movingImageGradient, DerivativeType & imageJacobian,
+    NonZeroJacobianIndicesType & nonZeroJacobianIndices ) const override
+  {
+    ++this->m_NumberOfJacobians;
+    Superclass::EvaluateJacobianWithImageGradientProduct(
+      ipp, movingImageGradient, imageJacobian, nonZeroJacobianIndices );
+  }
+
+
+  void ResetCounters( void )
+  {
+    this->m_NumberOfTransformedPoints = 0;
+    this->m_NumberOfJacobians         = 0;
+  }
+
+
+  SizeValueType GetNumberOfTransformedPoints( void ) const { return this->m_NumberOfTransformedPoints; }
+  SizeValueType GetNumberOfJacobians( void ) const { return this->m_NumberOfJacobians; }
+
+protected:
+
+  CountingTransform() : m_NumberOfTransformedPoints( 0 ), m_NumberOfJacobians( 0 ) {}
+  ~CountingTransform() override {}
+
+private:
+
+  CountingTransform( const Self & ) = delete;
+  void operator=( const Self & ) = delete;
+
+  /** The samples are transformed by several threads. */
+  mutable std::atomic< SizeValueType > m_NumberOfTransformedPoints;
+  mutable std::atomic< SizeValueType > m_NumberOfJacobians;
+};
+
+//------------------------------------------------------------------------------
+// The results of one evaluation of the combination metric, with the numbers
+// of transform evaluations it needed.
+struct CountedResults
+{
+  MetricResults      m_Results;
+  itk::SizeValueType m_NumberOfTransformedPoints;
+  itk::SizeValueType m_NumberOfJacobians;
+};
+
+//------------------------------------------------------------------------------
+// Create a counting transform with a B-spline current transform covering the
+// image, see CreateBSplineTransform().
+CountingTransform::Pointer
+CreateCountingTransform( const ImageType * image, const unsigned int numberOfNodes,
+  BSplineTransformType::ParametersType & parameters )
+{
+  CountingTransform::Pointer transform = CountingTransform::New();
+  transform->SetCurrentTransform( CreateBSplineTransform( image, numberOfNodes, parameters ) );
+  return transform;
+} // end CreateCountingTransform()
+
+
+//------------------------------------------------------------------------------
+// Evaluate a combination of two mean squares metrics, which use the same image
+// sampler and transform, and count the transform evaluations it needs.
+CountedResults
+EvaluateCombination( const ImageType * fixedImage, const ImageType * movingImage,
+  CountingTransform * transform, const BSplineTransformType::ParametersType & parameters,
+  const bool useMultiThread, const bool useSharedTransformEvaluation )
+{
+  ImageSamplerType::Pointer      sampler     = ImageSamplerType::New();
+  CombinationMetricType::Pointer combination = CombinationMetricType::New();
+  combination->SetNumberOfMetrics( 2 );
+  for( unsigned int i = 0; i < 2; ++i )
+  {
+    MetricType::Pointer metric = MetricType::New();
+    metric->SetImageSampler( sampler );
+    metric->SetUseMultiThread( useMultiThread );
+    combination->SetMetric( metric, i );
+    combination->SetMetricWeight( 1.0 / ( i + 1.0 ), i );
+  }
+  combination->SetUseAllMetrics();
+  combination->SetFixedImage( fixedImage );
+  combination->SetMovingImage( movingImage );
+  combination->SetFixedImageRegion( fixedImage->GetBufferedRegion() );
+  combination->SetTransform( transform );
+  combination->SetInterpolator( LinearInterpolatorType::New() );
+  combination->SetNumberOfWorkUnits( 4 );
+  combination->SetUseSharedTransformEvaluation( useSharedTransformEvaluation );
+  combination->Initialize();
+
+  /** Update the sampler first, so that only the evaluations of the metrics are counted. */
+  sampler->Update();
+  transform->ResetCounters();
+
+  CountedResults results;
+  combination->GetValueAndDerivative( parameters, results.m_Results.m_Value, results.m_Results.m_Derivative );
+  results.m_NumberOfTransformedPoints = transform->GetNumberOfTransformedPoints();
+  results.m_NumberOfJacobians         = transform->GetNumberOfJacobians();
+  return results;
+} // end EvaluateCombination()
+
+
+//------------------------------------------------------------------------------
+// This test checks that the metrics of a CombinationImageToImageMetric that
+// use the same image sampler and transform really look up the shared
+// transform evaluation. The transform counts its point and Jacobian
+// evaluations: with sharing, the samples are mapped, and their Jacobians
+// evaluated, once for both metrics by ComputeSharedTransformEvaluation(),
+// while without sharing each metric maps every sample itself. This is
+// checked for the single-threaded and the multi-threaded metric loops, which
+// also must give the same value and derivative with and without sharing.
+int
+main( void )
+{
+  const ImageType::Pointer fixedImage  = CreateImage( 16, 0.0 );
+  const ImageType::Pointer movingImage = CreateImage( 16, 6.0 );
+
+  BSplineTransformType::ParametersType parameters;
+  const CountingTransform::Pointer     transform = CreateCountingTransform( fixedImage, 8, parameters );
+
+  const itk::SizeValueType numberOfSamples = fixedImage->GetBufferedRegion().GetNumberOfPixels();
+
+  bool passed = true;
+  try
+  {
+    for( unsigned int m = 0; m < 2; ++m )
+    {
+      const bool           useMultiThread = m == 1;
+      const CountedResults separate       = EvaluateCombination(
+        fixedImage, movingImage, transform, parameters, useMultiThread, false );
+      const CountedResults shared         = EvaluateCombination(
+        fixedImage, movingImage, transform, parameters, useMultiThread, true );
+
+      const std::string description = useMultiThread
+        ? "The multi-threaded shared evaluation" : "The single-threaded shared evaluation";
+
+      /** The Jacobian products are computed from the stored Jacobians, so
+       * only rounding differences are allowed.
+       */
+      passed = CompareResults( separate.m_Results, shared.m_Results, 1e-12,
+        description, "the separate evaluations" ) && passed;
+
+      /** Each metric maps every sample, and evaluates a Jacobian for each
+       * sample that maps inside the moving image.
+       */
+      if( separate.m_NumberOfTransformedPoints != 2 * numberOfSamples
+        || separate.m_NumberOfJacobians == 0 )
+      {
+        std::cerr << "ERROR: the separate evaluations transformed "
+                  << separate.m_NumberOfTransformedPoints << " points instead of "
+                  << 2 * numberOfSamples << std::endl;
+        passed = false;
+      }
+
+      /** The shared evaluation maps every sample, and evaluates its Jacobian,
+       * once; the metrics look up all of them.
+       */
+      if( shared.m_NumberOfTransformedPoints != numberOfSamples
+        || shared.m_NumberOfJacobians != numberOfSamples )
+      {
+        std::cerr << "ERROR: " << description << " transformed "
+                  << shared.m_NumberOfTransformedPoints << " points and evaluated "
+                  << shared.m_NumberOfJacobians << " Jacobians, instead of "
+                  << numberOfSamples << " of both" << std::endl;
+        passed = false;
+      }
+    }
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    std::cerr << "ERROR: the metric could not be evaluated:\n" << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( !passed )
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "The metrics look up the shared transform evaluation." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/*=========================================================================
+ *
+ *  Copyright UMC Utrecht and contributors
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#include "itkAdvancedMeanSquaresImageToImageMetric.h"
+
+#include "itkMetricTestHelper.h"
+
+#include <sstream>
+
+//------------------------------------------------------------------------------
+// Definition of the metric used by the test
+typedef itk::AdvancedMeanSquaresImageToImageMetric< ImageType, ImageType > MetricType;
+
+//------------------------------------------------------------------------------
+// Compare the results of a configuration with the reference results. The
+// sparse accumulation adds the same contributions in another order, so only
+// rounding differences are allowed, and entries outside the support of all
+// samples must stay exactly zero.
+bool
+CompareSparseResults( const MetricResults & reference, const MetricResults & results,
+  const std::string & description )
+{
+  bool equal = CompareResults( reference, results, 1e-12, description, "the dense accumulation" );
+  for( unsigned int i = 0; equal && i < reference.m_Derivative.GetSize(); ++i )
+  {
+    if( reference.m_Derivative[ i ] == 0.0 && results.m_Derivative[ i ] != 0.0 )
+    {
+      std::cerr << "ERROR: " << description << " fills entry " << i
+                << " outside the support of all samples" << std::endl;
+      equal = false;
+    }
+  }
+  return equal;
+} // end CompareSparseResults()
+
+
+//------------------------------------------------------------------------------
+// This test checks that the sparse derivative accumulation of the
+// AdvancedImageToImageMetric, in which each thread stores the (index, value)
+// pairs of its samples and AccumulateDerivativesThreaderCallback() merges them
+// per parameter range, gives the same value and derivative as the dense
+// accumulation in full-length derivatives per thread. The B-spline grids are
+// fine enough for the Jacobian to be sparse, while neighbouring threads still
+// touch the same control points, because the samples of adjacent slices share
+// their support. This is checked for several numbers of threads.
+int
+main( void )
+{
+  const ImageType::Pointer fixedImage  = CreateImage( 16, 0.0 );
+  const ImageType::Pointer movingImage = CreateImage( 16, 6.0 );
+
+  const unsigned int numberOfNodes[]   = { 6, 12 };
+  const unsigned int numberOfThreads[] = { 1, 2, 3, 4, 7 };
+
+  bool passed = true;
+  try
+  {
+    for( unsigned int n = 0; n < sizeof( numberOfNodes ) / sizeof( numberOfNodes[ 0 ] ); ++n )
+    {
+      BSplineTransformType::ParametersType    parameters;
+      const CombinationTransformType::Pointer transform
+        = CreateTransform( fixedImage, numberOfNodes[ n ], parameters );
+
+      const MetricSettings referenceSettings = { false, 1, false };
+      const MetricResults  reference         = EvaluateMetric< MetricType >(
+        fixedImage, movingImage, transform, parameters, referenceSettings );
+
+      for( unsigned int t = 0; t < sizeof( numberOfThreads ) / sizeof( numberOfThreads[ 0 ] ); ++t )
+      {
+        const MetricSettings denseSettings  = { true, numberOfThreads[ t ], false };
+        const MetricSettings sparseSettings = { true, numberOfThreads[ t ], true };
+        const MetricResults  dense          = EvaluateMetric< MetricType >(
+          fixedImage, movingImage, transform, parameters, denseSettings );
+        const MetricResults  sparse         = EvaluateMetric< MetricType >(
+          fixedImage, movingImage, transform, parameters, sparseSettings );
+
+        std::ostringstream description;
+        description << "with " << numberOfThreads[ t ] << " threads and "
+                    << numberOfNodes[ n ] << " control points per dimension";
+        passed = CompareSparseResults( reference, dense, "The dense accumulation " + description.str() ) && passed;
+        passed = CompareSparseResults( dense, sparse, "The sparse accumulation " + description.str() ) && passed;
+      }
+    }
+  }
+  catch( itk::ExceptionObject & e )
+  {
+    std::cerr << "ERROR: the metric could not be evaluated:\n" << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if( !passed )
+  {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "The sparse derivative accumulation equals the dense one." << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -22,6 +22,7 @@
 #include "itkTimeProbe.h"
 #include "itkTimeProbesCollectorBase.h"
 
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 
@@ -363,6 +364,49 @@ main( int argc, char * argv[] )
       return 1;
     }
 
+    //
+    // Test the matrix-free CG solution against QR
+
+    PointsContainerPointer targetLandmarkPoints = PointsContainerType::New();
+    PointSetType::Pointer  targetLandmarks      = PointSetType::New();
+    for( unsigned long j = 0; j < numberOfLandmarks; j++ )
+    {
+      PointType tmp = usedLandmarkPoints->ElementAt( j );
+      for( unsigned int dim = 0; dim < Dimension; dim++ )
+      {
+        tmp[ dim ] += 2.0 * std::sin( 0.1 * tmp[ ( dim + 1 ) % Dimension ] );
+      }
+      targetLandmarkPoints->push_back( tmp );
+    }
+    targetLandmarks->SetPoints( targetLandmarkPoints );
+
+    TransformType::Pointer kernelTransformQR = TransformType::New();
+    kernelTransformQR->SetStiffness( 0.0 );
+    kernelTransformQR->SetMatrixInversionMethod( "QR" );
+    timeCollector.Start( "ComputeWMatrixByQR" );
+    kernelTransformQR->SetSourceLandmarks( usedLandmarks );
+    kernelTransformQR->SetTargetLandmarks( targetLandmarks );
+    kernelTransformQR->ComputeWMatrix();
+    timeCollector.Stop( "ComputeWMatrixByQR" );
+
+    TransformType::Pointer kernelTransformCG = TransformType::New();
+    kernelTransformCG->SetStiffness( 0.0 );
+    kernelTransformCG->SetMatrixInversionMethod( "CG" );
+    timeCollector.Start( "ComputeWMatrixByCG" );
+    kernelTransformCG->SetSourceLandmarks( usedLandmarks );
+    kernelTransformCG->SetTargetLandmarks( targetLandmarks );
+    kernelTransformCG->ComputeWMatrix();
+    timeCollector.Stop( "ComputeWMatrixByCG" );
+
+    const double diff_cg
+      = ( kernelTransformQR->TransformPoint( p ) - kernelTransformCG->TransformPoint( p ) ).GetNorm();
+    std::cerr << "Difference of the CG and QR transformed points: " << diff_cg << std::endl;
+    if( diff_cg > 1e-6 )
+    {
+      std::cerr << "ERROR: difference of the CG and QR transformed points too big: " << diff_cg << std::endl;
+      return 1;
+    }
+
     // Report timings
     timeCollector.Report();
     std::cout << std::endl;
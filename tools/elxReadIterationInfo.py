@@ -0,0 +1,71 @@
+import sys
+import struct
+import math
+
+#-------------------------------------------------------------------------------
+# Read an IterationInfo.<ElastixLevel>.R<Resolution>.bin file, written by
+# elastix with (WriteIterationInfoBinary "true").
+# Returns the column names and a list of records, one tuple per iteration.
+def readIterationInfo( fileName ) :
+
+  data = open( fileName, 'rb' ).read();
+  if data[ 0:8 ] != b'ELXITER1' :
+    raise ValueError( fileName + " is not a binary IterationInfo file" );
+
+  offset = 8;
+  numberOfColumns, = struct.unpack_from( '<I', data, offset );
+  offset += 4;
+  names = [];
+  for i in range( numberOfColumns ) :
+    length, = struct.unpack_from( '<I', data, offset );
+    offset += 4;
+    names.append( data[ offset : offset + length ].decode( 'latin-1' ) );
+    offset += length;
+
+  recordSize = 8 * numberOfColumns;
+  records = [];
+  if recordSize > 0 :
+    numberOfRecords = ( len( data ) - offset ) // recordSize;
+    recordFormat = '<' + str( numberOfColumns ) + 'd';
+    for i in range( numberOfRecords ) :
+      records.append( struct.unpack_from( recordFormat, data, offset + i * recordSize ) );
+
+  return names, records;
+
+#-------------------------------------------------------------------------------
+# the main function
+# python elxReadIterationInfo.py IterationInfo.0.R0.bin [column ...]
+# prints the table, or only the given columns, separated by tabs
+def main() :
+
+  if len( sys.argv ) < 2 :
+    print( "Usage: python elxReadIterationInfo.py <file.bin> [column ...]" );
+    return 1;
+
+  names, records = readIterationInfo( sys.argv[ 1 ] );
+
+  columns = list( range( len( names ) ) );
+  if len( sys.argv ) > 2 :
+    columns = [];
+    for name in sys.argv[ 2: ] :
+      if name not in names :
+        print( "Unknown column: " + name + ", the columns are: " + ", ".join( names ) );
+        return 1;
+      columns.append( names.index( name ) );
+
+  print( "\t".join( [ names[ c ] for c in columns ] ) );
+  for record in records :
+    values = [];
+    for c in columns :
+      if math.isnan( record[ c ] ) :
+        values.append( "" );
+      else :
+        values.append( repr( record[ c ] ) );
+    print( "\t".join( values ) );
+
+  # Exit
+  return 0
+
+#-------------------------------------------------------------------------------
+if __name__ == '__main__':
+    sys.exit(main())